@@ -30,9 +30,12 @@
 
 #ifdef __cplusplus
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 
 #include "easylogging++.h"
+#include "thread_name.h"
 
 #undef LOKI_DEFAULT_LOG_CATEGORY
 #define LOKI_DEFAULT_LOG_CATEGORY "default"
@@ -43,8 +46,33 @@
 #define CLOG_ENABLED(level, cat) ELPP->vRegistry()->allowed(el::Level::level, cat)
 #define LOG_ENABLED(level) CLOG_ENABLED(level, LOKI_DEFAULT_LOG_CATEGORY)
 
+namespace epee
+{
+  // Bumped (skipping 0) whenever the log categories change, invalidating the call site caches below
+  extern std::atomic<uint32_t> mlog_categories_generation;
+  uint32_t mlog_refresh_site_levels(std::atomic<uint32_t>& site_levels, const std::string& cat);
+
+  // Whether `level` is enabled for `cat`, for a log call site that always logs to the same category.
+  // `site_levels` caches [generation << 8 | the enabled el::Level bits] for the site, so that the
+  // check doesn't go to easylogging++'s registry (a std::string category, a lock and a map lookup)
+  // until the categories change.
+  inline bool mlog_enabled(std::atomic<uint32_t>& site_levels, el::Level level, const char* cat)
+  {
+    uint32_t levels = site_levels.load(std::memory_order_relaxed);
+    if ((levels >> 8) != (mlog_categories_generation.load(std::memory_order_acquire) & 0xffffff))
+      levels = mlog_refresh_site_levels(site_levels, cat);
+    return levels & static_cast<uint32_t>(level);
+  }
+  inline bool mlog_enabled(std::atomic<uint32_t>& site_levels, el::Level level, const std::string& cat)
+  {
+    return mlog_enabled(site_levels, level, cat.c_str());
+  }
+}
+
+// The category must be the same every time a given MCLOG_TYPE runs (see epee::mlog_enabled)
 #define MCLOG_TYPE(level, cat, type, x) do { \
-    if (ELPP->vRegistry()->allowed(level, cat)) { \
+    static std::atomic<uint32_t> mlog_site_levels{0}; \
+    if (epee::mlog_enabled(mlog_site_levels, level, cat)) { \
       el::base::Writer(level, __FILE__, __LINE__, ELPP_FUNC, type).construct(cat) << x; \
     } \
   } while (0)
@@ -107,7 +135,7 @@
 #define LOG_PRINT_L3(x) MTRACE(x)
 #define LOG_PRINT_L4(x) MTRACE(x)
 
-#define MLOG_SET_THREAD_NAME(x) el::Helpers::setThreadName(x)
+#define MLOG_SET_THREAD_NAME(x) epee::set_thread_name(x)
 
 #ifndef LOCAL_ASSERT
 #include <assert.h>
@@ -125,6 +153,10 @@ void mlog_set_categories(const char *categories);
 std::string mlog_get_categories();
 void mlog_set_log_level(int level);
 void mlog_set_log(const char *log);
+// Moves the writing of log lines to files and the console to a background thread (see mlog.cpp);
+// mlog_flush() waits until everything logged so far has been written.
+void mlog_set_async(bool async);
+void mlog_flush();
 
 namespace epee
 {
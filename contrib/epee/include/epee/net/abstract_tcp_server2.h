@@ -41,6 +41,7 @@
 #include <vector>
 #include <atomic>
 #include <cassert>
+#include <functional>
 #include <map>
 #include <memory>
 
@@ -54,6 +55,8 @@
 #define LOKI_DEFAULT_LOG_CATEGORY "net"
 
 #define ABSTRACT_SERVER_SEND_QUE_MAX_COUNT 1000
+#define ABSTRACT_SERVER_SEND_GATHER_MAX_COUNT 64          // max queued buffers written with one (gathering) write
+#define ABSTRACT_SERVER_SEND_GATHER_MAX_BYTES (256*1024)  // max bytes written with one write, unless a single buffer is larger
 
 namespace epee
 {
@@ -127,6 +130,7 @@ namespace net_utils
   private:
     //----------------- i_service_endpoint ---------------------
     virtual bool do_send(shared_sv message); ///< (see do_send from i_service_endpoint)
+    virtual bool do_send_bulk(std::vector<shared_sv> fragments); ///< (see do_send_bulk from i_service_endpoint)
     virtual bool send_done();
     virtual bool close();
     virtual bool call_run_once_service_io();
@@ -150,6 +154,13 @@ namespace net_utils
     /// Handle completion of a write operation.
     void handle_write(const boost::system::error_code& e, size_t cb);
 
+    /// Moves m_bulk_que fragments (up to one gathered write's worth) into the empty m_send_que;
+    /// m_send_que_lock must be held.
+    void refill_from_bulk();
+
+    /// Starts writing the queued buffers; m_send_que_lock must be held, with no write in progress.
+    void start_write(std::shared_ptr<connection<t_protocol_handler>> self);
+
     /// reset connection timeout timer and callback
     void reset_timer(std::chrono::milliseconds ms, bool add);
     std::chrono::milliseconds get_default_timeout();
@@ -227,6 +238,15 @@ namespace net_utils
     /// Run the server's io_service loop.
     bool run_server(size_t threads_count, bool wait = true);
 
+    /// Runs connections on `count` io_services of their own, each with a single dedicated thread,
+    /// instead of on the shared io_service.  Each new connection (accepted or opened by us) is
+    /// assigned to the next one in turn, so that all of its I/O and handlers stay on one thread
+    /// rather than contending with every other connection's.  The shared io_service (and its
+    /// `threads_count` threads) still runs the acceptors, idle handlers and async_call()s.  Must be
+    /// called before init_server(); 0 (the default) disables this.  Not supported for a server
+    /// using an external io_service.
+    void set_io_shards(size_t count);
+
     /// wait for service workers stop
     bool server_stop();
 
@@ -239,6 +259,10 @@ namespace net_utils
 
     void set_threads_prefix(const std::string& prefix_name);
 
+    /// Sets a callback that each worker thread started by run_server() calls first, e.g. to pin
+    /// itself to particular CPUs
+    void set_thread_init(std::function<void()> init) { m_thread_init = std::move(init); }
+
     bool deinit_server(){return true;}
 
     size_t get_threads_count(){return m_threads_count;}
@@ -326,7 +350,11 @@ namespace net_utils
 
   private:
     /// Run the server's io_service loop.
-    bool worker_thread();
+    bool worker_thread(boost::asio::io_service& io_service);
+    /// Returns the io_service to use for a new connection
+    boost::asio::io_service& next_connection_io_service();
+    /// True if the given io_service is ours or one of our shards
+    bool owns_io_service(boost::asio::io_service& io_service);
     /// Handle completion of an asynchronous accept operation.
     void handle_accept_ipv4(const boost::system::error_code& e);
     void handle_accept_ipv6(const boost::system::error_code& e);
@@ -348,6 +376,9 @@ namespace net_utils
     };
     std::unique_ptr<worker> m_io_service_local_instance;
     boost::asio::io_service& io_service_;    
+    /// Per-thread io_services for connections; see set_io_shards()
+    std::vector<std::unique_ptr<worker>> m_io_shards;
+    std::atomic<size_t> m_next_io_shard;
 
     /// Acceptor used to listen for incoming connections.
     boost::asio::ip::tcp::acceptor acceptor_;
@@ -362,6 +393,7 @@ namespace net_utils
     bool m_use_ipv6;
     bool m_require_ipv4;
     std::string m_thread_name_prefix; //TODO: change to enum server_type, now used
+    std::function<void()> m_thread_init;
     size_t m_threads_count;
     std::vector<std::thread> m_threads;
     std::thread::id m_main_thread_id;
@@ -556,39 +556,28 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 
     m_send_que.push_back(std::move(chunk));
 
-    if(m_send_que.size() > 1)
-    { // active operation should be in progress, nothing to do, just wait last operation callback
+    if(m_send_que_writing)
+    { // active operation should be in progress, nothing to do: its callback writes this along with
+      // whatever else got queued meanwhile
         auto size_now = m_send_que.back().size();
         MDEBUG("do_send_chunk() NOW just queues: packet="<<size_now<<" B, is added to queue-size="<<m_send_que.size());
-        //do_send_handler_delayed( ptr , size_now ); // (((H))) // empty function
-      
+
       LOG_TRACE_CC(context, "[sock " << socket().native_handle() << "] Async send requested " << m_send_que.front().size());
     }
     else
     { // no active operation
-
         if(m_send_que.size()!=1)
         {
             MERROR("Looks like no active operations, but send que size != 1!!");
             return false;
         }
 
-        auto size_now = m_send_que.front().size();
-        MDEBUG("do_send_chunk() NOW SENSD: packet="<<size_now<<" B");
+        MDEBUG("do_send_chunk() NOW SENSD: packet="<<m_send_que.front().size()<<" B");
         if (speed_limit_is_enabled())
 			do_send_handler_write( m_send_que.back().data(), m_send_que.back().size() ); // (((H)))
 
-        CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), false, "Unexpected queue size");
         reset_timer(get_default_timeout(), false);
-        using namespace boost::placeholders;
-        boost::asio::async_write(socket(), boost::asio::buffer(m_send_que.front().data(), size_now ) ,
-                                 strand_.wrap(
-                                 boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
-                                 )
-                                 );
-        //MTRACE("(chunk): " << size_now);
-        //logger_handle_net_write(size_now);
-        //MINFO("[sock " << socket().native_handle() << "] Async send requested " << m_send_que.front().size());
+        start_write(std::move(self));
     }
     
     //do_send_handler_stop( ptr , cb ); // empty function
@@ -599,6 +588,68 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   } // do_send_chunk
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send_bulk(std::vector<shared_sv> fragments)
+  {
+    TRY_ENTRY();
+    auto self = safe_shared_from_this();
+    if(!self)
+      return false;
+    if(m_was_shutdown)
+      return false;
+
+    size_t bytes = 0;
+    for (auto& f : fragments)
+      bytes += f.size();
+    double current_speed_up;
+    {
+      std::lock_guard lock{m_throttle_speed_out_mutex};
+      m_throttle_speed_out.handle_trafic_exact(bytes);
+      current_speed_up = m_throttle_speed_out.get_current_speed();
+    }
+    context.m_current_speed_up = current_speed_up;
+    context.m_max_speed_up = std::max(context.m_max_speed_up, current_speed_up);
+    context.m_last_send = std::chrono::steady_clock::now();
+    context.m_send_cnt += bytes;
+
+    std::lock_guard lock{m_send_que_lock};
+    if (m_bulk_que.size() + fragments.size() > ABSTRACT_SERVER_SEND_QUE_MAX_COUNT)
+    {
+      MWARNING("bulk send que size is more than ABSTRACT_SERVER_SEND_QUE_MAX_COUNT(" << ABSTRACT_SERVER_SEND_QUE_MAX_COUNT << "), shutting down connection");
+      shutdown();
+      return false;
+    }
+    for (auto& f : fragments)
+      m_bulk_que.push_back(std::move(f));
+
+    // If a write is in progress then handle_write gets to the bulk queue once everything ahead of
+    // it has been written.
+    if (!m_send_que_writing)
+    {
+      refill_from_bulk();
+      MDEBUG("do_send_bulk() NOW SENDS: " << m_send_que.size() << " of " << fragments.size() << " fragments, " << bytes << " B");
+      reset_timer(get_default_timeout(), false);
+      start_write(std::move(self));
+    }
+    return true;
+
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_bulk", false);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::refill_from_bulk()
+  {
+    // Only a gathered write's worth at a time, so that a message do_send()ed while bulk data is
+    // being written waits behind at most that much of it rather than behind the whole response.
+    size_t bytes = 0;
+    while (!m_bulk_que.empty() && (m_send_que.empty() || bytes + m_bulk_que.front().size() <= ABSTRACT_SERVER_SEND_GATHER_MAX_BYTES))
+    {
+      bytes += m_bulk_que.front().size();
+      m_send_que.push_back(std::move(m_bulk_que.front()));
+      m_bulk_que.pop_front();
+    }
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   std::chrono::milliseconds connection<t_protocol_handler>::get_default_timeout()
   {
     unsigned count;
@@ -756,13 +807,16 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 
     bool do_shutdown = false;
     std::unique_lock lock{m_send_que_lock};
-    if(m_send_que.empty())
+    if(!m_send_que_writing || m_send_que.size() < m_send_que_writing)
     {
-      MERROR("[sock " << socket().native_handle() << "] m_send_que.size() == 0 at handle_write!");
+      MERROR("[sock " << socket().native_handle() << "] m_send_que.size() == " << m_send_que.size() << " at handle_write of " << m_send_que_writing << " buffers!");
       return;
     }
 
-    m_send_que.pop_front();
+    m_send_que.erase(m_send_que.begin(), m_send_que.begin() + m_send_que_writing);
+    m_send_que_writing = 0;
+    if(m_send_que.empty())
+      refill_from_bulk();
     if(m_send_que.empty())
     {
       if(m_want_close_connection)
@@ -773,18 +827,10 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     {
       //have more data to send
 		reset_timer(get_default_timeout(), false);
-		auto size_now = m_send_que.front().size();
-		MDEBUG("handle_write() NOW SENDS: packet="<<size_now<<" B" <<", from  queue size="<<m_send_que.size());
+		MDEBUG("handle_write() NOW SENDS: packet="<<m_send_que.front().size()<<" B" <<", from  queue size="<<m_send_que.size());
 		if (speed_limit_is_enabled())
 			do_send_handler_write_from_queue(e, m_send_que.front().size() , m_send_que.size()); // (((H)))
-		CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), void(), "Unexpected queue size");
-        using namespace boost::placeholders;
-        boost::asio::async_write(socket(), boost::asio::buffer(m_send_que.front().data(), size_now) , 
-           strand_.wrap(
-            boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2)
-			  )
-          );
-      //MTRACE("(normal)" << size_now);
+		start_write(connection<t_protocol_handler>::shared_from_this());
     }
     lock.unlock();
 
@@ -795,6 +841,33 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     CATCH_ENTRY_L0("connection<t_protocol_handler>::handle_write", void());
   }
 
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_write(std::shared_ptr<connection<t_protocol_handler>> self)
+  {
+    // Write as many of the queued buffers as we reasonably can with one (gathering) write, so that
+    // a burst of small messages (e.g. tx notifications) queued while the previous write was in
+    // progress costs one syscall, and fills TCP segments, instead of costing a write each.  This
+    // adds no latency: a buffer queued while nothing is being written is written right away.
+    std::vector<boost::asio::const_buffer> buffers;
+    size_t bytes = 0;
+    for (auto& buf : m_send_que)
+    {
+      if (!buffers.empty() && (buffers.size() >= ABSTRACT_SERVER_SEND_GATHER_MAX_COUNT || bytes + buf.size() > ABSTRACT_SERVER_SEND_GATHER_MAX_BYTES))
+        break;
+      buffers.emplace_back(buf.data(), buf.size());
+      bytes += buf.size();
+    }
+    m_send_que_writing = buffers.size();
+    LOG_TRACE_CC(context, "[sock " << socket().native_handle() << "] Async write of " << buffers.size() << " buffers, " << bytes << " B");
+
+    using namespace boost::placeholders;
+    boost::asio::async_write(socket(), buffers,
+      strand_.wrap(
+        boost::bind(&connection<t_protocol_handler>::handle_write, std::move(self), _1, _2)
+      )
+    );
+  }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
   void connection<t_protocol_handler>::setRpcStation()
@@ -818,6 +891,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     m_state(std::make_shared<typename connection<t_protocol_handler>::shared_state>()),
     m_io_service_local_instance(new worker()),
     io_service_(m_io_service_local_instance->io_service),
+    m_next_io_shard(0),
     acceptor_(io_service_),
     acceptor_ipv6(io_service_),
     default_remote(),
@@ -836,6 +910,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   boosted_tcp_server<t_protocol_handler>::boosted_tcp_server(boost::asio::io_service& extarnal_io_service, t_connection_type connection_type) :
     m_state(std::make_shared<typename connection<t_protocol_handler>::shared_state>()),
     io_service_(extarnal_io_service),
+    m_next_io_shard(0),
     acceptor_(io_service_),
     acceptor_ipv6(io_service_),
     default_remote(),
@@ -894,7 +969,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       boost::asio::ip::tcp::endpoint binded_endpoint = acceptor_.local_endpoint();
       m_port = binded_endpoint.port();
       MDEBUG("start accept (IPv4)");
-      new_connection_.reset(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type));
+      new_connection_.reset(new connection<t_protocol_handler>(next_connection_io_service(), m_state, m_connection_type));
       acceptor_.async_accept(new_connection_->socket(),
 	boost::bind(&boosted_tcp_server<t_protocol_handler>::handle_accept_ipv4, this,
 	boost::asio::placeholders::error));
@@ -931,7 +1006,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         boost::asio::ip::tcp::endpoint binded_endpoint = acceptor_ipv6.local_endpoint();
         m_port_ipv6 = binded_endpoint.port();
         MDEBUG("start accept (IPv6)");
-        new_connection_ipv6.reset(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type));
+        new_connection_ipv6.reset(new connection<t_protocol_handler>(next_connection_io_service(), m_state, m_connection_type));
         acceptor_ipv6.async_accept(new_connection_ipv6->socket(),
             boost::bind(&boosted_tcp_server<t_protocol_handler>::handle_accept_ipv6, this,
               boost::asio::placeholders::error));
@@ -988,7 +1063,7 @@ DISABLE_GCC_WARNING(maybe-uninitialized)
 POP_WARNINGS
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
-  bool boosted_tcp_server<t_protocol_handler>::worker_thread()
+  bool boosted_tcp_server<t_protocol_handler>::worker_thread(boost::asio::io_service& io_service)
   {
     TRY_ENTRY();
     uint32_t local_thr_index = m_thread_index++;
@@ -996,11 +1071,13 @@ POP_WARNINGS
     thread_name += std::to_string(local_thr_index) + "]";
     MLOG_SET_THREAD_NAME(thread_name);
     //   MDEBUG("Thread name: " << m_thread_name_prefix);
+    if (m_thread_init)
+      m_thread_init();
     while(!m_stop_signal_sent)
     {
       try
       {
-        io_service_.run();
+        io_service.run();
         return true;
       }
       catch(const std::exception& ex)
@@ -1035,6 +1112,34 @@ POP_WARNINGS
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  void boosted_tcp_server<t_protocol_handler>::set_io_shards(size_t count)
+  {
+    CHECK_AND_ASSERT_THROW_MES(m_io_service_local_instance || !count, "io shards require the server's own io_service");
+    m_io_shards.clear();
+    for (size_t i = 0; i < count; ++i)
+      m_io_shards.push_back(std::make_unique<worker>());
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  boost::asio::io_service& boosted_tcp_server<t_protocol_handler>::next_connection_io_service()
+  {
+    if (m_io_shards.empty())
+      return io_service_;
+    return m_io_shards[m_next_io_shard++ % m_io_shards.size()]->io_service;
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  bool boosted_tcp_server<t_protocol_handler>::owns_io_service(boost::asio::io_service& io_service)
+  {
+    if (std::addressof(io_service) == std::addressof(io_service_))
+      return true;
+    for (auto& shard : m_io_shards)
+      if (std::addressof(io_service) == std::addressof(shard->io_service))
+        return true;
+    return false;
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   bool boosted_tcp_server<t_protocol_handler>::run_server(size_t threads_count, bool wait)
   {
     TRY_ENTRY();
@@ -1049,9 +1154,13 @@ POP_WARNINGS
         std::lock_guard lock{m_threads_lock};
         for (std::size_t i = 0; i < threads_count; ++i)
         {
-          m_threads.emplace_back([this] { worker_thread(); });
+          m_threads.emplace_back([this] { worker_thread(io_service_); });
           MDEBUG("Run server thread name: " << m_thread_name_prefix);
         }
+        for (auto& shard : m_io_shards)
+          m_threads.emplace_back([this, &io = shard->io_service] { worker_thread(io); });
+        if (!m_io_shards.empty())
+          MDEBUG("Running " << m_io_shards.size() << " connection io shards");
       }
       // Wait for all threads in the pool to exit.
       if (wait)
@@ -1127,6 +1236,8 @@ POP_WARNINGS
     connections_.clear();
     connections_mutex.unlock();
     io_service_.stop();
+    for (auto& shard : m_io_shards)
+      shard->io_service.stop();
     CATCH_ENTRY_L0("boosted_tcp_server<t_protocol_handler>::send_stop_signal()", void());
   }
   //---------------------------------------------------------------------------------
@@ -1166,7 +1277,7 @@ POP_WARNINGS
         (*current_new_connection)->setRpcStation(); // hopefully this is not needed actually
       }
       connection_ptr conn(std::move((*current_new_connection)));
-      (*current_new_connection).reset(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type));
+      (*current_new_connection).reset(new connection<t_protocol_handler>(next_connection_io_service(), m_state, m_connection_type));
       current_acceptor->async_accept((*current_new_connection)->socket(),
           boost::bind(accept_function_pointer, this,
             boost::asio::placeholders::error));
@@ -1201,7 +1312,7 @@ POP_WARNINGS
     assert(m_state != nullptr); // always set in constructor
     MERROR("Some problems at accept: " << e.message() << ", connections_count = " << m_state->sock_count);
     misc_utils::sleep_no_w(100);
-    (*current_new_connection).reset(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type));
+    (*current_new_connection).reset(new connection<t_protocol_handler>(next_connection_io_service(), m_state, m_connection_type));
     current_acceptor->async_accept((*current_new_connection)->socket(),
         boost::bind(accept_function_pointer, this,
           boost::asio::placeholders::error));
@@ -1210,7 +1321,7 @@ POP_WARNINGS
   template<class t_protocol_handler>
   bool boosted_tcp_server<t_protocol_handler>::add_connection(t_connection_context& out, boost::asio::ip::tcp::socket&& sock, network_address real_remote)
   {
-    if(std::addressof(get_io_service()) == std::addressof(GET_IO_SERVICE(sock)))
+    if(owns_io_service(GET_IO_SERVICE(sock)))
     {
       connection_ptr conn(new connection<t_protocol_handler>(std::move(sock), m_state, m_connection_type));
       if(conn->start(false, 1 < m_threads_count, std::move(real_remote)))
@@ -1310,7 +1421,7 @@ POP_WARNINGS
   {
     TRY_ENTRY();
 
-    connection_ptr new_connection_l(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type) );
+    connection_ptr new_connection_l(new connection<t_protocol_handler>(next_connection_io_service(), m_state, m_connection_type) );
     connections_mutex.lock();
     connections_.insert(new_connection_l);
     MDEBUG("connections_ size now " << connections_.size());
@@ -1426,7 +1537,7 @@ POP_WARNINGS
   bool boosted_tcp_server<t_protocol_handler>::connect_async(const std::string& adr, const std::string& port, uint32_t conn_timeout, const t_callback &cb, const std::string& bind_ip)
   {
     TRY_ENTRY();    
-    connection_ptr new_connection_l(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type) );
+    connection_ptr new_connection_l(new connection<t_protocol_handler>(next_connection_io_service(), m_state, m_connection_type) );
     connections_mutex.lock();
     connections_.insert(new_connection_l);
     MDEBUG("connections_ size now " << connections_.size());
@@ -1505,7 +1616,7 @@ POP_WARNINGS
       }
     }
     
-    std::shared_ptr<boost::asio::steady_timer> sh_deadline(new boost::asio::steady_timer(io_service_));
+    std::shared_ptr<boost::asio::steady_timer> sh_deadline(new boost::asio::steady_timer(new_connection_l->get_io_service()));
     //start deadline
     sh_deadline->expires_from_now(std::chrono::milliseconds(conn_timeout));
     sh_deadline->async_wait([=](const boost::system::error_code& error)
@@ -42,12 +42,25 @@ namespace epee
 {
 namespace net_utils
 {
+// Large storage (see buffer::reserve()) comes from, and goes back to, a pool shared by all buffers,
+// so that receiving a large message (e.g. a span of blocks) into a buffer doesn't reallocate its
+// way up to the message size, and doesn't leave the connection holding on to that much memory once
+// the message has been handled.
 class buffer
 {
 public:
-  buffer(size_t reserve = 0): offset(0) { storage.reserve(reserve); }
+  buffer(size_t reserve = 0): offset(0), initial_reserve(reserve) { storage.reserve(reserve); }
+  buffer(const buffer&) = default;
+  buffer& operator=(const buffer&) = default;
+  ~buffer();
 
   void append(const void *data, size_t sz);
+  // makes room for `sz` more bytes in a single (re)allocation, so that appending them doesn't move
+  // the buffered data more than once
+  void reserve(size_t sz);
+  // if the buffer is empty, hands large storage back to the pool; call once carved spans are no
+  // longer in use
+  void trim();
   void erase(size_t sz) { NET_BUFFER_LOG("erasing " << sz << "/" << size()); CHECK_AND_ASSERT_THROW_MES(offset + sz <= storage.size(), "erase: sz too large"); offset += sz; if (offset == storage.size()) { storage.resize(0); offset = 0; } }
   epee::span<const uint8_t> span(size_t sz) const { CHECK_AND_ASSERT_THROW_MES(sz <= size(), "span is too large"); return epee::span<const uint8_t>(storage.data() + offset, sz); }
   // carve must keep the data in scope till next call, other API calls (such as append, erase) can invalidate the carved buffer
@@ -55,8 +68,12 @@ public:
   size_t size() const { return storage.size() - offset; }
 
 private:
+  // moves the buffered data to storage of at least `capacity` bytes
+  void reallocate(size_t capacity);
+
   std::vector<uint8_t> storage;
   size_t offset;
+  size_t initial_reserve;
 };
 }
 }
@@ -32,6 +32,7 @@
 #include <cstdint>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "net_utils_base.h"
 #include "../span.h"
@@ -146,6 +147,17 @@ namespace levin
       Otherwise, a levin notification message OR 2+ levin fragment messages.
       Each message is `noise.size()` in length. */
   std::string make_fragmented_notify(const std::string_view noise, int command, epee::span<const std::uint8_t> payload);
+
+  /*! Splits a complete levin message (header included) into levin fragments
+      that are reassembled by the receiver, so that other messages can be sent
+      in between them.
+
+   \param message A levin message, e.g. from `make_notify`.
+   \param fragment_size Maximum number of bytes of `message` in each fragment;
+      each fragment also has its own levin header.
+   \return `message` alone if it is no larger than `fragment_size`,
+      otherwise 2+ levin fragment messages. */
+  std::vector<std::string> make_fragments(std::string_view message, std::size_t fragment_size);
 }
 }
 
@@ -29,6 +29,7 @@
 #include <boost/uuid/uuid_generators.hpp>
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <atomic>
 #include <memory>
@@ -91,6 +92,9 @@ public:
   typedef t_connection_context connection_context;
   uint64_t m_max_packet_size; 
   uint64_t m_invoke_timeout;
+  /// Commands whose (large) messages are sent as fragments behind any other queued messages, so
+  /// that e.g. a block sync response doesn't hold up the relaying of a new block or tx.
+  std::unordered_set<uint32_t> m_bulk_commands;
 
   int invoke(int command, const epee::span<const uint8_t> in_buff, std::string& buff_out, boost::uuids::uuid connection_id);
   template<class callback_t>
@@ -126,6 +130,8 @@ class async_protocol_handler
 {
   std::string m_fragment_buffer;
 
+  static constexpr size_t BULK_FRAGMENT_SIZE = 32 * 1024;
+
   bool send_message(uint32_t command, epee::span<const uint8_t> in_buff, uint32_t flags, bool expect_response)
   {
     const bucket_head2 head = make_header(command, in_buff.size(), flags, expect_response);
@@ -133,7 +139,15 @@ class async_protocol_handler
     data.reserve(sizeof(head) + in_buff.size());
     data.append(reinterpret_cast<const char*>(&head), sizeof(head));
     data.append(reinterpret_cast<const char*>(in_buff.data()), in_buff.size());
-    if(!m_pservice_endpoint->do_send(shared_sv{std::move(data)}))
+    if (data.size() > BULK_FRAGMENT_SIZE && m_config.m_bulk_commands.count(command))
+    {
+      std::vector<shared_sv> fragments;
+      for (auto& f : make_fragments(data, BULK_FRAGMENT_SIZE))
+        fragments.emplace_back(std::move(f));
+      if(!m_pservice_endpoint->do_send_bulk(std::move(fragments)))
+        return false;
+    }
+    else if(!m_pservice_endpoint->do_send(shared_sv{std::move(data)}))
       return false;
 
     MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << head.m_cb
@@ -593,6 +607,10 @@ public:
               << ", connection will be closed.");
             return false;
           }
+          // make room for the whole body at once, so that e.g. a many MB block span isn't copied
+          // over and over as the buffer grows to hold it
+          if(m_current_head.m_cb > m_cache_in_buffer.size())
+            m_cache_in_buffer.reserve(m_current_head.m_cb - m_cache_in_buffer.size());
         }
         break;
       default:
@@ -601,6 +619,8 @@ public:
       }
     }
 
+    // everything carved from the buffer has been handled by now
+    m_cache_in_buffer.trim();
     return true;
   }
 
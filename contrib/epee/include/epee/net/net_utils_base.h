@@ -34,6 +34,7 @@
 #include <boost/asio/ip/address_v6.hpp>
 #include <typeinfo>
 #include <type_traits>
+#include <vector>
 #include "../shared_sv.h"
 #include "enums.h"
 #include "../misc_log_ex.h"
@@ -420,6 +421,15 @@ namespace net_utils
 	struct i_service_endpoint
 	{
     virtual bool do_send(shared_sv message)=0;
+    //! Queues `fragments` (consecutive pieces of one low priority message) to be sent behind anything
+    //! passed to do_send, including messages do_send()ed after this call.
+    virtual bool do_send_bulk(std::vector<shared_sv> fragments)
+    {
+      for (auto& f : fragments)
+        if (!do_send(std::move(f)))
+          return false;
+      return true;
+    }
     virtual bool close()=0;
     virtual bool send_done()=0;
     virtual bool call_run_once_service_io()=0;
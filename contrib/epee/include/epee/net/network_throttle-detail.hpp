@@ -64,6 +64,7 @@ class network_throttle : public i_network_throttle {
 		// TODO for big window size, for performance better the substract on change of m_last_sample_time instead of recalculating average of eg >100 elements
 
 		boost::circular_buffer< packet_info > m_history; // the history of bw usage
+		size_t m_history_bytes; // sum of m_size over m_history, kept up to date so we don't re-add it for every packet
 		network_time_seconds m_last_sample_time; // time of last history[0] - so we know when to rotate the buffer
 		network_time_seconds m_start_time; // when we were created
 		bool m_any_packet_yet; // did we yet got any packet to count
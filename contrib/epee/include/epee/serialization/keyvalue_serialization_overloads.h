@@ -186,7 +186,7 @@ namespace epee
         for (const auto &v : container)
           mb.append(reinterpret_cast<const char*>(&v), sizeof(T));
       }
-      return stg.set_value(pname, mb, parent_section);
+      return stg.set_value(pname, std::move(mb), parent_section);
     }
     //--------------------------------------------------------------------------------------------------------------------
     template<class stl_container, class t_storage>
@@ -196,9 +196,16 @@ namespace epee
       assert_blob_serializable<T>();
 
       container.clear();
-      std::string buff;
-      if (!stg.get_value(pname, buff, parent_section))
-        return false;
+      const std::string* stored = stg.get_string(pname, parent_section);
+      std::string converted;
+      if (!stored)
+      {
+        // Not stored as a string, but perhaps as something convertible to one
+        if (!stg.get_value(pname, converted, parent_section))
+          return false;
+        stored = &converted;
+      }
+      const std::string& buff = *stored;
 
       CHECK_AND_ASSERT_MES(buff.size() % sizeof(T) == 0,
         false, 
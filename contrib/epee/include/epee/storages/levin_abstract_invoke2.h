@@ -199,13 +199,16 @@ namespace epee
     template<class t_owner, class t_in_type, class t_context, class callback_t>
     int buff_to_t_adapter(t_owner* powner, int command, const epee::span<const uint8_t> in_buff, callback_t cb, t_context& context)
     {
+      t_in_type in_struct{};
+      if constexpr (serialization::has_direct_binary_codec<t_in_type>)
+        if (serialization::load_direct_binary(in_struct, std::string_view{reinterpret_cast<const char*>(in_buff.data()), in_buff.size()}))
+          return cb(command, in_struct, context);
       serialization::portable_storage strg;
       if(!strg.load_from_binary(in_buff))
       {
         LOG_ERROR("Failed to load_from_binary in notify " << command);
         return -1;
       }
-      t_in_type in_struct{};
       if (!in_struct.load(strg))
       {
         LOG_ERROR("Failed to load in_struct in notify " << command);
@@ -55,6 +55,17 @@ namespace epee
       bool       get_value(const std::string& value_name, storage_entry& val, section* parent_section);
       template <class T>
       bool       set_value(const std::string& value_name, const T& target, section* parent_section);
+      /// Same as above, but moves the string into the storage rather than copying it
+      bool       set_value(const std::string& value_name, std::string&& target, section* parent_section);
+
+      /// Accesses an existing string value without copying it.  Returns nullptr if the value does
+      /// not exist or is not a string.
+      const std::string* get_string(const std::string& value_name, section* parent_section) {
+        if (!parent_section) parent_section = &m_root;
+        if (storage_entry* pentry = find_storage_entry(value_name, parent_section))
+          return std::get_if<std::string>(pentry);
+        return nullptr;
+      }
 
       // Class for iterating through a type with automatic conversion to `T` when dereferencing.
       template <typename T>
@@ -212,6 +223,19 @@ namespace epee
       CATCH_ENTRY("portable_storage::template<>set_value", false);
     }
     //---------------------------------------------------------------------------------------------------------------
+    inline bool portable_storage::set_value(const std::string& value_name, std::string&& v, section* parent_section)
+    {
+      TRY_ENTRY();
+      if(!parent_section)
+        parent_section = &m_root;
+      if (storage_entry* pentry = find_storage_entry(value_name, parent_section))
+        *pentry = std::move(v);
+      else
+        parent_section->m_entries.emplace(value_name, std::move(v));
+      return true;
+      CATCH_ENTRY("portable_storage::set_value", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
     template<class entry_type>
     storage_entry* portable_storage::insert_new_entry_get_storage_entry(const std::string& pentry_name, section* psection, const entry_type& entry)
     {
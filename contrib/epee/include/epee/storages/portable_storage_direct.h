@@ -0,0 +1,411 @@
+#pragma once
+
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <boost/endian/conversion.hpp>
+
+#include "../misc_log_ex.h"
+#include "../span.h"
+#include "portable_storage_base.h"
+#include "portable_storage_from_bin.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    // Reads and writes the portable_storage binary format directly, without building the
+    // intermediate section/storage_entry tree, for types with hand-written codecs (see
+    // KV_MAP_DIRECT_BINARY).  The reader only handles the encoding our own serializer produces:
+    // anything else it isn't sure about (duplicate keys, values of unexpected types, blobs of the
+    // wrong size) throws, and load_t_from_binary() then falls back to the generic portable_storage
+    // path, so a direct codec can never accept or reject input differently from the generic one.
+    class direct_reader
+    {
+    public:
+      explicit direct_reader(std::string_view data) : m_data{data} {}
+
+      // Reads and verifies the storage header; must be called once, before the root section
+      void read_header();
+      // Reads the entry count of a section
+      size_t read_section_size() { return read_varint(); }
+      std::string_view read_name();
+      uint8_t read_type() { return read_int<uint8_t>(); }
+
+      std::string_view read_string(uint8_t type);
+      template <typename T> T read_integer(uint8_t type);
+      bool read_bool(uint8_t type);
+      template <typename T> void read_pod_blob(uint8_t type, T& val);
+      template <typename Container> void read_pod_blob_container(uint8_t type, Container& c);
+      // Requires `type` to be a section, whose entry count is returned
+      size_t read_section(uint8_t type);
+      // Requires `type` to be an array of `elem_type`; returns the element count, after which each
+      // element follows without a type tag (strings are then read with read_array_string())
+      size_t read_array(uint8_t type, uint8_t elem_type);
+      std::string_view read_array_string();
+      // Skips over the value of an entry we don't know
+      void skip(uint8_t type);
+
+      // Marks field `i` (< 64) of the current section as seen, throwing if it was already: the
+      // generic path silently keeps the first of duplicate keys, which we leave to it.
+      static void once(uint64_t& seen, unsigned i)
+      {
+        CHECK_AND_ASSERT_THROW_MES(!(seen & (uint64_t{1} << i)), "duplicate key");
+        seen |= uint64_t{1} << i;
+      }
+
+    private:
+      uint64_t read_varint();
+      std::string_view read_bytes(size_t count);
+      template <typename T> T read_int();
+      void skip_value(uint8_t type, size_t depth);
+
+      std::string_view m_data;
+    };
+
+    class direct_writer
+    {
+    public:
+      // Appends to `out`, starting with the storage header
+      explicit direct_writer(std::string& out);
+
+      void reserve(size_t extra) { m_out.reserve(m_out.size() + extra); }
+
+      void begin_section(size_t count) { write_varint(count); }
+      void write_string(std::string_view name, std::string_view val);
+      template <typename T> void write_integer(std::string_view name, T val);
+      void write_bool(std::string_view name, bool val);
+      template <typename T> void write_pod_blob(std::string_view name, const T& val);
+      template <typename Container> void write_pod_blob_container(std::string_view name, const Container& c);
+      // Starts a child section; follow with begin_section() and its entries
+      void begin_object(std::string_view name) { write_name(name); write_tag(SERIALIZE_TYPE_TAG<section>); }
+      // Starts an array of `count` elements of `elem_type`; follow with each element (sections
+      // starting with begin_section(), strings written with write_array_string())
+      void begin_array(std::string_view name, uint8_t elem_type, size_t count);
+      void write_array_string(std::string_view val);
+
+    private:
+      void write_name(std::string_view name);
+      void write_tag(uint8_t tag) { m_out += static_cast<char>(tag); }
+      void write_varint(uint64_t val);
+      template <typename T> void write_int(T val);
+
+      std::string& m_out;
+    };
+
+    //---------------------------------------------------------------------------------------------
+    inline void direct_reader::read_header()
+    {
+      CHECK_AND_ASSERT_THROW_MES(read_int<uint32_t>() == SWAP32LE(PORTABLE_STORAGE_SIGNATUREA), "signature mismatch");
+      CHECK_AND_ASSERT_THROW_MES(read_int<uint32_t>() == SWAP32LE(PORTABLE_STORAGE_SIGNATUREB), "signature mismatch");
+      CHECK_AND_ASSERT_THROW_MES(read_int<uint8_t>() == PORTABLE_STORAGE_FORMAT_VER, "unknown format version");
+    }
+
+    inline std::string_view direct_reader::read_bytes(size_t count)
+    {
+      CHECK_AND_ASSERT_THROW_MES(m_data.size() >= count, "attempt to read " << count << " bytes from buffer with " << m_data.size() << " bytes remaining");
+      auto result = m_data.substr(0, count);
+      m_data.remove_prefix(count);
+      return result;
+    }
+
+    template <typename T>
+    T direct_reader::read_int()
+    {
+      static_assert(std::is_integral_v<T>);
+      T v;
+      std::memcpy(&v, read_bytes(sizeof(T)).data(), sizeof(T));
+      if constexpr (sizeof(T) > 1)
+        boost::endian::little_to_native_inplace(v);
+      return v;
+    }
+
+    inline uint64_t direct_reader::read_varint()
+    {
+      CHECK_AND_ASSERT_THROW_MES(!m_data.empty(), "empty buff, expected place for varint");
+      uint64_t v = 0;
+      switch (static_cast<uint8_t>(m_data[0]) & PORTABLE_RAW_SIZE_MARK_MASK)
+      {
+        case PORTABLE_RAW_SIZE_MARK_6BIT:  v = read_int<uint8_t>();  break;
+        case PORTABLE_RAW_SIZE_MARK_14BIT: v = read_int<uint16_t>(); break;
+        case PORTABLE_RAW_SIZE_MARK_30BIT: v = read_int<uint32_t>(); break;
+        case PORTABLE_RAW_SIZE_MARK_62BIT: v = read_int<uint64_t>(); break;
+      }
+      return v >> 2;
+    }
+
+    inline std::string_view direct_reader::read_name()
+    {
+      return read_bytes(read_int<uint8_t>());
+    }
+
+    inline std::string_view direct_reader::read_array_string()
+    {
+      uint64_t len = read_varint();
+      CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "too big string len value in storage: " << len);
+      return read_bytes(len);
+    }
+
+    inline std::string_view direct_reader::read_string(uint8_t type)
+    {
+      CHECK_AND_ASSERT_THROW_MES(type == SERIALIZE_TYPE_TAG<std::string>, "expected a string");
+      return read_array_string();
+    }
+
+    template <typename T>
+    T direct_reader::read_integer(uint8_t type)
+    {
+      static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>);
+      auto check = [](auto v) {
+        using From = decltype(v);
+        bool in_range;
+        if constexpr (std::is_signed_v<From> == std::is_signed_v<T>)
+          in_range = v >= std::numeric_limits<T>::min() && v <= std::numeric_limits<T>::max();
+        else if constexpr (std::is_signed_v<T>)
+          in_range = v <= static_cast<std::make_unsigned_t<T>>(std::numeric_limits<T>::max());
+        else
+          in_range = v >= 0 && static_cast<std::make_unsigned_t<From>>(v) <= std::numeric_limits<T>::max();
+        CHECK_AND_ASSERT_THROW_MES(in_range, "int value overflow");
+        return static_cast<T>(v);
+      };
+      switch (type)
+      {
+        case SERIALIZE_TYPE_TAG<uint64_t>: return check(read_int<uint64_t>());
+        case SERIALIZE_TYPE_TAG<uint32_t>: return check(read_int<uint32_t>());
+        case SERIALIZE_TYPE_TAG<uint16_t>: return check(read_int<uint16_t>());
+        case SERIALIZE_TYPE_TAG<uint8_t>:  return check(read_int<uint8_t>());
+        case SERIALIZE_TYPE_TAG<int64_t>:  return check(read_int<int64_t>());
+        case SERIALIZE_TYPE_TAG<int32_t>:  return check(read_int<int32_t>());
+        case SERIALIZE_TYPE_TAG<int16_t>:  return check(read_int<int16_t>());
+        case SERIALIZE_TYPE_TAG<int8_t>:   return check(read_int<int8_t>());
+        default: ASSERT_MES_AND_THROW("expected an integer, got type " << +type);
+      }
+    }
+
+    inline bool direct_reader::read_bool(uint8_t type)
+    {
+      CHECK_AND_ASSERT_THROW_MES(type == SERIALIZE_TYPE_TAG<bool>, "expected a bool");
+      return read_int<uint8_t>() != 0;
+    }
+
+    template <typename T>
+    void direct_reader::read_pod_blob(uint8_t type, T& val)
+    {
+      static_assert(is_byte_spannable<T>);
+      auto blob = read_string(type);
+      CHECK_AND_ASSERT_THROW_MES(blob.size() == sizeof(T), "blob size mismatch");
+      std::memcpy(&val, blob.data(), sizeof(T));
+    }
+
+    template <typename Container>
+    void direct_reader::read_pod_blob_container(uint8_t type, Container& c)
+    {
+      using T = typename Container::value_type;
+      static_assert(is_byte_spannable<T>);
+      auto blob = read_string(type);
+      CHECK_AND_ASSERT_THROW_MES(blob.size() % sizeof(T) == 0, "blob size is not a multiple of the element size");
+      c.resize(blob.size() / sizeof(T));
+      std::memcpy((void*) c.data(), blob.data(), blob.size());
+    }
+
+    inline size_t direct_reader::read_section(uint8_t type)
+    {
+      CHECK_AND_ASSERT_THROW_MES(type == SERIALIZE_TYPE_TAG<section>, "expected a section");
+      return read_section_size();
+    }
+
+    inline size_t direct_reader::read_array(uint8_t type, uint8_t elem_type)
+    {
+      CHECK_AND_ASSERT_THROW_MES(type == (SERIALIZE_FLAG_ARRAY | elem_type), "expected an array of type " << +elem_type);
+      uint64_t count = read_varint();
+      CHECK_AND_ASSERT_THROW_MES(count <= m_data.size(), "Size sanity check failed");
+      return count;
+    }
+
+    inline void direct_reader::skip(uint8_t type)
+    {
+      skip_value(type, 0);
+    }
+
+    inline void direct_reader::skip_value(uint8_t type, size_t depth)
+    {
+      CHECK_AND_ASSERT_THROW_MES(depth < RECURSION_LIMIT, "recursion limit exceeded");
+      bool array = type & SERIALIZE_FLAG_ARRAY;
+      type &= ~SERIALIZE_FLAG_ARRAY;
+      uint64_t count = 1;
+      if (array)
+      {
+        count = read_varint();
+        CHECK_AND_ASSERT_THROW_MES(count <= m_data.size(), "Size sanity check failed");
+      }
+      while (count--)
+      {
+        switch (type)
+        {
+          case SERIALIZE_TYPE_TAG<int64_t>: case SERIALIZE_TYPE_TAG<uint64_t>: read_bytes(8); break;
+          case SERIALIZE_TYPE_TAG<int32_t>: case SERIALIZE_TYPE_TAG<uint32_t>: read_bytes(4); break;
+          case SERIALIZE_TYPE_TAG<int16_t>: case SERIALIZE_TYPE_TAG<uint16_t>: read_bytes(2); break;
+          case SERIALIZE_TYPE_TAG<int8_t>: case SERIALIZE_TYPE_TAG<uint8_t>:
+          case SERIALIZE_TYPE_TAG<bool>: read_bytes(1); break;
+          case SERIALIZE_TYPE_TAG<std::string>: read_array_string(); break;
+          case SERIALIZE_TYPE_TAG<section>:
+            for (size_t n = read_section_size(); n; n--)
+            {
+              read_name();
+              skip_value(read_type(), depth + 1);
+            }
+            break;
+          default: ASSERT_MES_AND_THROW("unknown entry_type code = " << +type);
+        }
+      }
+    }
+
+    //---------------------------------------------------------------------------------------------
+    inline direct_writer::direct_writer(std::string& out) : m_out{out}
+    {
+      write_int<uint32_t>(SWAP32LE(PORTABLE_STORAGE_SIGNATUREA));
+      write_int<uint32_t>(SWAP32LE(PORTABLE_STORAGE_SIGNATUREB));
+      write_int<uint8_t>(PORTABLE_STORAGE_FORMAT_VER);
+    }
+
+    template <typename T>
+    void direct_writer::write_int(T val)
+    {
+      if constexpr (sizeof(T) > 1)
+        boost::endian::native_to_little_inplace(val);
+      m_out.append(reinterpret_cast<const char*>(&val), sizeof(T));
+    }
+
+    inline void direct_writer::write_varint(uint64_t val)
+    {
+      if (val < (1ULL << 6))
+        write_int<uint8_t>((val << 2) | PORTABLE_RAW_SIZE_MARK_6BIT);
+      else if (val < (1ULL << 14))
+        write_int<uint16_t>((val << 2) | PORTABLE_RAW_SIZE_MARK_14BIT);
+      else if (val < (1ULL << 30))
+        write_int<uint32_t>((val << 2) | PORTABLE_RAW_SIZE_MARK_30BIT);
+      else if (val < (1ULL << 62))
+        write_int<uint64_t>((val << 2) | PORTABLE_RAW_SIZE_MARK_62BIT);
+      else
+        ASSERT_MES_AND_THROW("failed to pack varint -- integer value too large: " << val << " >= 2^62");
+    }
+
+    inline void direct_writer::write_name(std::string_view name)
+    {
+      CHECK_AND_ASSERT_THROW_MES(name.size() < std::numeric_limits<uint8_t>::max(), "storage_entry_name is too long: " << name.size());
+      write_int<uint8_t>(name.size());
+      m_out += name;
+    }
+
+    inline void direct_writer::write_array_string(std::string_view val)
+    {
+      CHECK_AND_ASSERT_THROW_MES(val.size() < MAX_STRING_LEN_POSSIBLE, "string to store is too large: " << val.size());
+      write_varint(val.size());
+      m_out += val;
+    }
+
+    inline void direct_writer::write_string(std::string_view name, std::string_view val)
+    {
+      write_name(name);
+      write_tag(SERIALIZE_TYPE_TAG<std::string>);
+      write_array_string(val);
+    }
+
+    template <typename T>
+    void direct_writer::write_integer(std::string_view name, T val)
+    {
+      static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>);
+      write_name(name);
+      write_tag(SERIALIZE_TYPE_TAG<T>);
+      write_int(val);
+    }
+
+    inline void direct_writer::write_bool(std::string_view name, bool val)
+    {
+      write_name(name);
+      write_tag(SERIALIZE_TYPE_TAG<bool>);
+      write_int<uint8_t>(val);
+    }
+
+    template <typename T>
+    void direct_writer::write_pod_blob(std::string_view name, const T& val)
+    {
+      static_assert(is_byte_spannable<T>);
+      write_string(name, {reinterpret_cast<const char*>(&val), sizeof(T)});
+    }
+
+    template <typename Container>
+    void direct_writer::write_pod_blob_container(std::string_view name, const Container& c)
+    {
+      using T = typename Container::value_type;
+      static_assert(is_byte_spannable<T>);
+      write_string(name, {reinterpret_cast<const char*>(c.data()), c.size() * sizeof(T)});
+    }
+
+    inline void direct_writer::begin_array(std::string_view name, uint8_t elem_type, size_t count)
+    {
+      write_name(name);
+      write_tag(SERIALIZE_FLAG_ARRAY | elem_type);
+      write_varint(count);
+    }
+
+    //---------------------------------------------------------------------------------------------
+    template <typename T, typename = void>
+    constexpr bool has_direct_binary_codec = false;
+    template <typename T>
+    constexpr bool has_direct_binary_codec<T, std::void_t<decltype(
+        std::declval<T&>().load_direct(std::declval<direct_reader&>(), size_t{}),
+        std::declval<const T&>().store_direct(std::declval<direct_writer&>()))>> = true;
+
+    // Loads `out` with its direct codec; returns false (leaving `out` untouched) if the codec
+    // couldn't handle the input, which the caller should then load the generic way.
+    template <typename T>
+    bool load_direct_binary(T& out, std::string_view buff)
+    {
+      try
+      {
+        direct_reader in{buff};
+        in.read_header();
+        T result{out};
+        result.load_direct(in, in.read_section_size());
+        out = std::move(result);
+        return true;
+      }
+      catch (const std::exception& e)
+      {
+        MDEBUG("Direct binary load failed (" << e.what() << "), falling back to portable_storage");
+      }
+      return false;
+    }
+
+    template <typename T>
+    bool store_direct_binary(const T& in, std::string& buff)
+    {
+      try
+      {
+        buff.clear();
+        direct_writer out{buff};
+        in.store_direct(out);
+        return true;
+      }
+      catch (const std::exception& e)
+      {
+        LOG_ERROR("Direct binary store failed: " << e.what());
+      }
+      return false;
+    }
+  }
+}
+
+/// Declares a hand-written direct binary codec for a KV_MAP_SERIALIZABLE type, which
+/// load_t_from_binary()/store_t_to_binary() (and so levin notifications) then use instead of
+/// going through a portable_storage.  load_direct() reads the `count` entries of the type's
+/// section (the entry count itself having been read by the caller) and store_direct() writes the
+/// section's entry count and entries, in the same key order and with the same omitted values as
+/// the generic serializer, so that both produce identical bytes.
+#define KV_MAP_DIRECT_BINARY \
+public: \
+  void load_direct(epee::serialization::direct_reader& in, size_t count); \
+  void store_direct(epee::serialization::direct_writer& out) const;
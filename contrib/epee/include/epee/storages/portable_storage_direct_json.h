@@ -0,0 +1,331 @@
+#pragma once
+
+#include <charconv>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "../misc_log_ex.h"
+#include "parserse_base_utils.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    // Pulls values straight out of JSON text into a struct, without building the intermediate
+    // section/storage_entry tree, for types with hand-written codecs (see KV_MAP_DIRECT_JSON).
+    // Like direct_reader, it only handles the plain subset of JSON that the generic parser is sure
+    // to read the same way: strings without escapes, integers, true/false/null, objects without
+    // duplicate keys, and arrays of a single kind of (non-array, non-bool) value.  Anything else
+    // throws, and load_t_from_json() then falls back to the generic portable_storage path, so a
+    // direct codec can never accept or reject input differently from the generic one.
+    class direct_json_reader
+    {
+    public:
+      explicit direct_json_reader(std::string_view json) : m_data{json} {}
+
+      // Opens the top-level object.  An input of only whitespace is, as for the generic parser, an
+      // object without keys.
+      void begin();
+      // Requires that nothing but whitespace follows the top-level object
+      void end();
+      // Returns the next key of the current object, or nullopt once the object has ended.  Each
+      // key must be followed by reading (or skipping) its value.
+      std::optional<std::string_view> next_key();
+      // The first character of the next value
+      char peek();
+
+      // Consumes a null value, if that is what is next: the generic parser treats these as though
+      // the key were absent.
+      bool read_null();
+      std::string_view read_string();
+      template <typename T> T read_integer();
+      bool read_bool();
+      // Reads an array, calling `f()` to read each element.  An empty array reads nothing (the
+      // generic parser doesn't store it at all).
+      template <typename F> void read_array(F&& f);
+      // Skips over a value we don't know, returning its text
+      std::string_view skip();
+
+    private:
+      enum class kind { object, array, string, unsigned_number, signed_number, word };
+      // Well under the generic parser's own limit
+      static constexpr size_t MAX_DEPTH = 50;
+
+      void skip_space();
+      char next();
+      void expect(char c);
+      std::string_view read_number(bool& is_signed);
+      std::string_view read_word();
+      kind skip_value(size_t depth);
+      void open_object();
+
+      std::string_view m_data;
+      // Keys of the objects currently open (to reject duplicates), and where each one's keys start
+      std::vector<std::string_view> m_keys;
+      std::vector<size_t> m_key_starts;
+    };
+
+    //---------------------------------------------------------------------------------------------
+    inline void direct_json_reader::skip_space()
+    {
+      while (!m_data.empty() && misc_utils::parse::isspace(m_data.front()))
+        m_data.remove_prefix(1);
+    }
+
+    inline char direct_json_reader::peek()
+    {
+      skip_space();
+      CHECK_AND_ASSERT_THROW_MES(!m_data.empty(), "unexpected end of JSON");
+      return m_data.front();
+    }
+
+    inline char direct_json_reader::next()
+    {
+      char c = peek();
+      m_data.remove_prefix(1);
+      return c;
+    }
+
+    inline void direct_json_reader::expect(char c)
+    {
+      CHECK_AND_ASSERT_THROW_MES(next() == c, "expected '" << c << "'");
+    }
+
+    inline void direct_json_reader::open_object()
+    {
+      expect('{');
+      m_key_starts.push_back(m_keys.size());
+    }
+
+    inline void direct_json_reader::begin()
+    {
+      skip_space();
+      if (!m_data.empty())
+        open_object();
+    }
+
+    inline void direct_json_reader::end()
+    {
+      CHECK_AND_ASSERT_THROW_MES(m_key_starts.empty(), "unterminated object");
+      skip_space();
+      CHECK_AND_ASSERT_THROW_MES(m_data.empty(), "trailing data after JSON object");
+    }
+
+    inline std::optional<std::string_view> direct_json_reader::next_key()
+    {
+      if (m_key_starts.empty())
+        return std::nullopt;
+      const size_t start = m_key_starts.back();
+      const bool first = m_keys.size() == start;
+      const char c = first ? peek() : next();
+      if (c == '}')
+      {
+        if (first)
+          m_data.remove_prefix(1);
+        m_keys.resize(start);
+        m_key_starts.pop_back();
+        return std::nullopt;
+      }
+      // (The generic parser also allows a trailing comma before the '}'; we leave that to it.)
+      CHECK_AND_ASSERT_THROW_MES(first || c == ',', "expected ',' or '}'");
+      auto key = read_string();
+      for (size_t i = start; i < m_keys.size(); i++)
+        CHECK_AND_ASSERT_THROW_MES(m_keys[i] != key, "duplicate key");
+      m_keys.push_back(key);
+      expect(':');
+      return key;
+    }
+
+    inline std::string_view direct_json_reader::read_string()
+    {
+      expect('"');
+      size_t i = 0;
+      while (i < m_data.size() && !(misc_utils::parse::lut[static_cast<uint8_t>(m_data[i])] & 32))
+        i++;
+      CHECK_AND_ASSERT_THROW_MES(i < m_data.size() && m_data[i] == '"', "unterminated or escaped string");
+      auto result = m_data.substr(0, i);
+      m_data.remove_prefix(i + 1);
+      return result;
+    }
+
+    // A number is the run of characters the generic parser takes as one, which we only accept if
+    // it is a plain integer.
+    inline std::string_view direct_json_reader::read_number(bool& is_signed)
+    {
+      skip_space();
+      size_t i = 0;
+      while (i < m_data.size() && (misc_utils::parse::lut[static_cast<uint8_t>(m_data[i])] & 16))
+        i++;
+      auto num = m_data.substr(0, i);
+      is_signed = !num.empty() && num.front() == '-';
+      auto digits = num.substr(is_signed ? 1 : 0);
+      CHECK_AND_ASSERT_THROW_MES(!digits.empty() && digits.find_first_not_of("0123456789") == std::string_view::npos,
+          "not an integer: " << num);
+      m_data.remove_prefix(i);
+      return num;
+    }
+
+    inline std::string_view direct_json_reader::read_word()
+    {
+      skip_space();
+      size_t i = 0;
+      while (i < m_data.size() && (misc_utils::parse::lut[static_cast<uint8_t>(m_data[i])] & 4))
+        i++;
+      auto word = m_data.substr(0, i);
+      m_data.remove_prefix(i);
+      return word;
+    }
+
+    inline bool direct_json_reader::read_null()
+    {
+      if (peek() != 'n')
+        return false;
+      CHECK_AND_ASSERT_THROW_MES(read_word() == "null", "unknown value keyword");
+      return true;
+    }
+
+    template <typename T>
+    T direct_json_reader::read_integer()
+    {
+      static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>);
+      bool is_signed;
+      auto num = read_number(is_signed);
+      // Negative values go into signed types only; other conversions are left to the generic path
+      CHECK_AND_ASSERT_THROW_MES(!is_signed || std::is_signed_v<T>, "negative value for an unsigned field");
+      T val;
+      auto [p, ec] = std::from_chars(num.data(), num.data() + num.size(), val);
+      CHECK_AND_ASSERT_THROW_MES(ec == std::errc{} && p == num.data() + num.size(), "int value overflow: " << num);
+      return val;
+    }
+
+    inline bool direct_json_reader::read_bool()
+    {
+      auto word = read_word();
+      CHECK_AND_ASSERT_THROW_MES(word == "true" || word == "false", "expected a bool");
+      return word == "true";
+    }
+
+    template <typename F>
+    void direct_json_reader::read_array(F&& f)
+    {
+      expect('[');
+      if (peek() == ']')
+      {
+        m_data.remove_prefix(1);
+        return;
+      }
+      char c;
+      do
+        f();
+      while ((c = next()) == ',');
+      CHECK_AND_ASSERT_THROW_MES(c == ']', "expected ',' or ']'");
+    }
+
+    inline std::string_view direct_json_reader::skip()
+    {
+      skip_space();
+      const char* begin = m_data.data();
+      skip_value(0);
+      return {begin, static_cast<size_t>(m_data.data() - begin)};
+    }
+
+    inline direct_json_reader::kind direct_json_reader::skip_value(size_t depth)
+    {
+      CHECK_AND_ASSERT_THROW_MES(depth < MAX_DEPTH, "recursion limit exceeded");
+      const char c = peek();
+      if (c == '"')
+      {
+        read_string();
+        return kind::string;
+      }
+      if (c == '-' || misc_utils::parse::isdigit(c))
+      {
+        bool is_signed;
+        auto num = read_number(is_signed);
+        // Must also fit the integer type the generic parser would store it as
+        uint64_t u;
+        int64_t i;
+        auto [p, ec] = is_signed
+          ? std::from_chars(num.data(), num.data() + num.size(), i)
+          : std::from_chars(num.data(), num.data() + num.size(), u);
+        CHECK_AND_ASSERT_THROW_MES(ec == std::errc{} && p == num.data() + num.size(), "int value overflow: " << num);
+        return is_signed ? kind::signed_number : kind::unsigned_number;
+      }
+      if (c == '{')
+      {
+        open_object();
+        while (next_key())
+          skip_value(depth + 1);
+        return kind::object;
+      }
+      if (c == '[')
+      {
+        // Only arrays of a single kind of value: the generic parser rejects mixed ones, and
+        // mishandles arrays of bools.
+        m_data.remove_prefix(1);
+        if (peek() == ']')
+        {
+          m_data.remove_prefix(1);
+          return kind::array;
+        }
+        std::optional<kind> elements;
+        char next_c;
+        do
+        {
+          auto k = skip_value(depth + 1);
+          CHECK_AND_ASSERT_THROW_MES(k != kind::array && k != kind::word, "array of arrays or keywords");
+          CHECK_AND_ASSERT_THROW_MES(!elements || *elements == k, "array of mixed values");
+          elements = k;
+        }
+        while ((next_c = next()) == ',');
+        CHECK_AND_ASSERT_THROW_MES(next_c == ']', "expected ',' or ']'");
+        return kind::array;
+      }
+      auto word = read_word();
+      CHECK_AND_ASSERT_THROW_MES(word == "true" || word == "false" || word == "null", "unknown value keyword");
+      return kind::word;
+    }
+
+    //---------------------------------------------------------------------------------------------
+    template <typename T, typename = void>
+    constexpr bool has_direct_json_codec = false;
+    template <typename T>
+    constexpr bool has_direct_json_codec<T, std::void_t<decltype(
+        std::declval<T&>().load_direct_json(std::declval<direct_json_reader&>()))>> = true;
+
+    // Loads `out` from a JSON object with its direct codec; returns false (leaving `out` untouched)
+    // if the codec couldn't handle the input, which the caller should then load the generic way.
+    template <typename T>
+    bool load_direct_json(T& out, std::string_view json)
+    {
+      try
+      {
+        direct_json_reader in{json};
+        in.begin();
+        T result{out};
+        result.load_direct_json(in);
+        in.end();
+        out = std::move(result);
+        return true;
+      }
+      catch (const std::exception& e)
+      {
+        MDEBUG("Direct JSON load failed (" << e.what() << "), falling back to portable_storage");
+      }
+      return false;
+    }
+  }
+}
+
+/// Declares a hand-written direct JSON loader for a KV_MAP_SERIALIZABLE type, which
+/// load_t_from_json() (and so JSON RPC requests) then tries before going through a
+/// portable_storage.  load_direct_json() reads keys with next_key() until the object ends,
+/// skipping unknown ones, and must leave fields that are absent (or null) exactly as the generic
+/// loader would: untouched for plain KV_SERIALIZE fields, cleared for containers and optionals,
+/// and defaulted for KV_SERIALIZE_OPT ones.
+#define KV_MAP_DIRECT_JSON \
+public: \
+  void load_direct_json(epee::serialization::direct_json_reader& in);
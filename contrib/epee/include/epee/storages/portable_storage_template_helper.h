@@ -31,6 +31,8 @@
 
 #include "parserse_base_utils.h"
 #include "portable_storage.h"
+#include "portable_storage_direct.h"
+#include "portable_storage_direct_json.h"
 
 namespace epee
 {
@@ -40,6 +42,9 @@ namespace epee
     template <typename T>
     bool load_t_from_json(T& out, std::string_view json_buff)
     {
+      if constexpr (has_direct_json_codec<T>)
+        if (load_direct_json(out, json_buff))
+          return true;
       portable_storage ps;
       bool rs = ps.load_from_json(json_buff);
       if(!rs)
@@ -68,6 +73,9 @@ namespace epee
     template<class t_struct>
     bool load_t_from_binary(t_struct& out, const epee::span<const uint8_t> binary_buff)
     {
+      if constexpr (has_direct_binary_codec<t_struct>)
+        if (load_direct_binary(out, std::string_view{reinterpret_cast<const char*>(binary_buff.data()), binary_buff.size()}))
+          return true;
       portable_storage ps;
       bool rs = ps.load_from_binary(binary_buff);
       if(!rs)
@@ -79,6 +87,9 @@ namespace epee
     template<class t_struct>
     bool load_t_from_binary(t_struct& out, std::string_view binary_buff)
     {
+      if constexpr (has_direct_binary_codec<t_struct>)
+        if (load_direct_binary(out, binary_buff))
+          return true;
       portable_storage ps;
       if (!ps.load_from_binary(binary_buff))
         return false;
@@ -89,6 +100,8 @@ namespace epee
     template<class t_struct>
     bool store_t_to_binary(t_struct& str_in, std::string& binary_buff, size_t indent = 0)
     {
+      if constexpr (has_direct_binary_codec<std::remove_const_t<t_struct>>)
+        return store_direct_binary(str_in, binary_buff);
       portable_storage ps;
       str_in.store(ps);
       return ps.store_to_binary(binary_buff);
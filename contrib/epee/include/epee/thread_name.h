@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace epee
+{
+  struct thread_info
+  {
+    char name[32];      // nul-terminated, truncated if longer
+    uintptr_t stack_lo; // bounds of the thread's stack, or 0 if unknown
+    uintptr_t stack_hi;
+  };
+
+  // Names the calling thread: in log lines, for the OS (so it shows up in top -H, perf and gdb,
+  // truncated to 15 characters), and in the samples of the built-in profiler (common/profiler.h),
+  // which also uses the stack bounds recorded here to unwind the thread's stack safely.
+  void set_thread_name(std::string_view name);
+
+  // The calling thread's info; all zeroes for threads that never called set_thread_name().  Safe to
+  // call from a signal handler.
+  const thread_info& this_thread_info();
+}
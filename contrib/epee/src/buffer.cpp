@@ -30,6 +30,7 @@
 #include <cstring>
 #include <limits>
 #include <cstdint>
+#include <mutex>
 #include <vector>
 
 #undef LOKI_DEFAULT_LOG_CATEGORY
@@ -40,6 +41,96 @@ namespace epee
 namespace net_utils
 {
 
+namespace
+{
+  constexpr size_t POOL_MIN_CAPACITY = 256 * 1024;    // smaller storage isn't worth pooling
+  constexpr size_t POOL_MAX_BYTES = 64 * 1024 * 1024; // total capacity the pool keeps around
+
+  std::mutex pool_mutex;
+  std::vector<std::vector<uint8_t>> pool;
+  size_t pool_bytes = 0;
+
+  std::vector<uint8_t> take_storage(size_t capacity)
+  {
+    std::vector<uint8_t> storage;
+    if (capacity >= POOL_MIN_CAPACITY)
+    {
+      std::lock_guard lock{pool_mutex};
+      auto best = pool.end();
+      for (auto it = pool.begin(); it != pool.end(); ++it)
+        if (it->capacity() >= capacity && (best == pool.end() || it->capacity() < best->capacity()))
+          best = it;
+      if (best != pool.end())
+      {
+        storage = std::move(*best);
+        pool_bytes -= storage.capacity();
+        pool.erase(best);
+        return storage;
+      }
+    }
+    storage.reserve(capacity);
+    return storage;
+  }
+
+  void give_storage(std::vector<uint8_t>&& storage)
+  {
+    if (storage.capacity() < POOL_MIN_CAPACITY)
+      return;
+    storage.clear();
+    std::lock_guard lock{pool_mutex};
+    if (pool_bytes + storage.capacity() > POOL_MAX_BYTES)
+      return;
+    pool_bytes += storage.capacity();
+    pool.push_back(std::move(storage));
+  }
+}
+
+buffer::~buffer()
+{
+  give_storage(std::move(storage));
+}
+
+void buffer::reallocate(size_t capacity)
+{
+  std::vector<uint8_t> new_storage = take_storage(capacity);
+  new_storage.resize(size());
+  if (size() > 0)
+    memcpy(new_storage.data(), storage.data() + offset, storage.size() - offset);
+  offset = 0;
+  std::swap(storage, new_storage);
+  give_storage(std::move(new_storage));
+}
+
+void buffer::reserve(size_t sz)
+{
+  CHECK_AND_ASSERT_THROW_MES(size() < std::numeric_limits<size_t>::max() - sz, "Too much data to reserve");
+  if (sz <= storage.capacity() - storage.size())
+    return;
+  if (size() + sz <= storage.capacity())
+  {
+    NET_BUFFER_LOG("reserving " << sz << " from " << size() << " by moving " << size() << " from offset " << offset);
+    memmove(storage.data(), storage.data() + offset, size());
+    storage.resize(size());
+    offset = 0;
+  }
+  else
+  {
+    NET_BUFFER_LOG("reserving " << sz << " from " << size() << " by reallocating");
+    reallocate(((size() + sz) + 4095) & ~size_t{4095});
+  }
+}
+
+void buffer::trim()
+{
+  if (size() > 0 || storage.capacity() < POOL_MIN_CAPACITY)
+    return;
+  NET_BUFFER_LOG("trimming, returning " << storage.capacity() << " to the pool");
+  give_storage(std::move(storage));
+  storage = std::vector<uint8_t>{};
+  storage.reserve(initial_reserve);
+  offset = 0;
+}
+
 void buffer::append(const void *data, size_t sz)
 {
   const size_t capacity = storage.capacity();
@@ -63,14 +154,7 @@ void buffer::append(const void *data, size_t sz)
     else
     {
       NET_BUFFER_LOG("appending " << sz << " from " << size() << " by reallocating");
-      std::vector<uint8_t> new_storage;
-      size_t reserve = (((size() + sz) * 3 / 2) + 4095) & ~4095;
-      new_storage.reserve(reserve);
-      new_storage.resize(size());
-      if (size() > 0)
-        memcpy(new_storage.data(), storage.data() + offset, storage.size() - offset);
-      offset = 0;
-      std::swap(storage, new_storage);
+      reallocate((((size() + sz) * 3 / 2) + 4095) & ~size_t{4095});
     }
   }
   else
@@ -131,5 +131,33 @@ namespace levin
 
     return result;
   }
+
+  std::vector<std::string> make_fragments(const std::string_view message, const std::size_t fragment_size)
+  {
+    std::vector<std::string> result;
+    if (message.size() <= fragment_size || fragment_size == 0)
+    {
+      result.emplace_back(message);
+      return result;
+    }
+
+    result.reserve((message.size() - 1) / fragment_size + 1);
+    for (std::size_t pos = 0; pos < message.size(); pos += fragment_size)
+    {
+      const std::string_view piece = message.substr(pos, fragment_size);
+      std::uint32_t flags = 0;
+      if (pos == 0)
+        flags |= LEVIN_PACKET_BEGIN;
+      if (pos + piece.size() == message.size())
+        flags |= LEVIN_PACKET_END;
+
+      const bucket_head2 head = make_header(0, piece.size(), flags, false);
+      std::string& fragment = result.emplace_back();
+      fragment.reserve(sizeof(head) + piece.size());
+      fragment.append(reinterpret_cast<const char*>(&head), sizeof(head));
+      fragment.append(piece);
+    }
+    return result;
+  }
 } // levin
 } // epee
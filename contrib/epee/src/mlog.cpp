@@ -35,8 +35,16 @@
 #endif
 #endif
 
+#include <algorithm>
 #include <ctime>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <boost/algorithm/string.hpp>
 #include "epee/string_tools.h"
 #include "epee/misc_os_dependent.h"
@@ -152,8 +160,261 @@ bool EnableVTMode()
 }
 #endif
 
+namespace {
+
+// Set while the pre-roll-out callback runs: the thread then holds the rolled file's lock, which the
+// async writer also needs, so it mustn't wait for the writer to make room (see async_log_writer::push)
+thread_local bool in_pre_roll_out = false;
+
+struct pending_log_line
+{
+  el::Logger* logger;
+  el::Level level;
+  std::string file_line;    // empty if not going to the log file
+  std::string console_line; // empty if not going to the console
+};
+
+// Writes log lines handed over by the logging threads from a background thread.  Formatting still
+// happens on the logging thread (the LogMessage only lives for the duration of the log call), but
+// the file writes, flushes and console output happen here, in batches, with one flush per file and
+// one console flush per batch instead of per line.  Lines are passed through a bounded lock-free
+// queue; a logging thread only ever waits if the writer has fallen a full queue behind.
+//
+// The writer only takes the file's TypedConfigurations lock (which is also what easylogging++'s log
+// rolling takes), never easylogging++'s global lock: the logging threads hold that one while
+// handing lines over.
+class async_log_writer
+{
+public:
+  async_log_writer()
+  {
+    for (uint64_t i = 0; i < QUEUE_SIZE; ++i)
+      m_slots[i].seq.store(i, std::memory_order_relaxed);
+    m_thread = std::thread{[this] { run(); }};
+  }
+
+  ~async_log_writer()
+  {
+    {
+      std::lock_guard lock{m_mutex};
+      m_stop = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+  }
+
+  void push(pending_log_line&& line)
+  {
+    uint64_t pos = m_head.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      slot& s = m_slots[pos % QUEUE_SIZE];
+      const uint64_t seq = s.seq.load(std::memory_order_acquire);
+      if (seq == pos)
+      {
+        if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+        {
+          s.line = std::move(line);
+          s.seq.store(pos + 1, std::memory_order_release);
+          break;
+        }
+      }
+      else if (seq < pos)
+      {
+        // Full: wait for the writer to free a slot
+        if (in_pre_roll_out)
+        {
+          std::cerr << (line.file_line.empty() ? line.console_line : line.file_line);
+          return;
+        }
+        wake();
+        std::this_thread::yield();
+        pos = m_head.load(std::memory_order_relaxed);
+      }
+      else
+        pos = m_head.load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_relaxed))
+      wake();
+  }
+
+  // Waits until everything pushed before the call has been written and flushed
+  void flush()
+  {
+    const uint64_t target = m_head.load(std::memory_order_acquire);
+    wake();
+    std::unique_lock lock{m_mutex};
+    m_written_cv.wait(lock, [&] { return m_written >= target; });
+  }
+
+private:
+  static constexpr uint64_t QUEUE_SIZE = 8192;
+  static constexpr size_t MAX_BATCH = 1024;
+
+  struct slot
+  {
+    std::atomic<uint64_t> seq;
+    pending_log_line line;
+  };
+
+  void wake()
+  {
+    std::lock_guard lock{m_mutex};
+    m_wake.notify_one();
+  }
+
+  bool next_ready(uint64_t tail) const
+  {
+    return m_slots[tail % QUEUE_SIZE].seq.load(std::memory_order_acquire) == tail + 1;
+  }
+
+  void run()
+  {
+    uint64_t tail = 0;
+    std::vector<pending_log_line> batch;
+    batch.reserve(MAX_BATCH);
+    for (;;)
+    {
+      while (batch.size() < MAX_BATCH && next_ready(tail))
+      {
+        slot& s = m_slots[tail % QUEUE_SIZE];
+        batch.push_back(std::move(s.line));
+        s.seq.store(tail + QUEUE_SIZE, std::memory_order_release);
+        ++tail;
+      }
+
+      if (!batch.empty())
+      {
+        write(batch);
+        batch.clear();
+        std::lock_guard lock{m_mutex};
+        m_written = tail;
+        m_written_cv.notify_all();
+        continue;
+      }
+
+      std::unique_lock lock{m_mutex};
+      if (m_stop)
+        return;
+      m_sleeping.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      // The timeout covers a line published between the check and a producer seeing m_sleeping
+      if (!next_ready(tail))
+        m_wake.wait_for(lock, std::chrono::milliseconds(100));
+      m_sleeping.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  void write(std::vector<pending_log_line>& batch)
+  {
+    std::vector<std::pair<el::base::TypedConfigurations*, el::Level>> to_flush;
+    bool console = false;
+    for (auto& line : batch)
+    {
+      if (!line.file_line.empty())
+      {
+        el::base::TypedConfigurations* tc = line.logger->typedConfigurations();
+        el::base::threading::ScopedLock lock{tc->lock()};
+        if (el::base::type::fstream_t* fs = tc->fileStream(line.level))
+        {
+          fs->write(line.file_line.data(), line.file_line.size());
+          if (fs->fail())
+            std::cerr << "Unable to write log to file " << tc->filename(line.level) << "\n";
+          else if (std::find(to_flush.begin(), to_flush.end(), std::make_pair(tc, line.level)) == to_flush.end())
+            to_flush.emplace_back(tc, line.level);
+        }
+      }
+      if (!line.console_line.empty())
+      {
+        std::cout << line.console_line;
+        console = true;
+      }
+    }
+    for (auto& [tc, level] : to_flush)
+    {
+      el::base::threading::ScopedLock lock{tc->lock()};
+      if (el::base::type::fstream_t* fs = tc->fileStream(level))
+        fs->flush();
+    }
+    if (console)
+      std::cout.flush();
+  }
+
+  slot m_slots[QUEUE_SIZE];
+  alignas(64) std::atomic<uint64_t> m_head{0};
+  alignas(64) std::atomic<bool> m_sleeping{false};
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_written_cv;
+  uint64_t m_written = 0;
+  bool m_stop = false;
+  std::thread m_thread;
+};
+
+std::unique_ptr<async_log_writer> async_writer;
+
+char level_char(el::Level level)
+{
+  switch (level)
+  {
+    case el::Level::Fatal: return 'F';
+    case el::Level::Error: return 'E';
+    case el::Level::Warning: return 'W';
+    case el::Level::Info: return 'I';
+    case el::Level::Debug: return 'D';
+    case el::Level::Trace: return 'T';
+    case el::Level::Verbose: return 'V';
+    default: return '?';
+  }
+}
+
+// Replaces easylogging++'s DefaultLogDispatchCallback while async logging is on: builds the same
+// file and console lines, but hands them to async_writer instead of writing them.
+class async_log_dispatch_callback : public el::LogDispatchCallback
+{
+protected:
+  void handle(const el::LogDispatchData* data) override
+  {
+    const auto action = data->dispatchAction();
+    if (action != el::base::DispatchAction::NormalLog && action != el::base::DispatchAction::FileOnlyLog)
+      return;
+    const el::LogMessage* msg = data->logMessage();
+    el::Logger* logger = msg->logger();
+    el::base::TypedConfigurations* tc = logger->typedConfigurations();
+    const el::Level level = msg->level();
+
+    pending_log_line line{logger, level};
+    if (tc->toFile(level))
+      line.file_line = logger->logBuilder()->build(msg, true);
+    if (action == el::base::DispatchAction::NormalLog && tc->toStandardOutput(level))
+    {
+      line.console_line = el::base::utils::DateTime::getDateTime(tc->logFormat(level).dateTimeFormat().c_str(), &tc->subsecondPrecision(level));
+      line.console_line += '\t';
+      line.console_line += level_char(level);
+      line.console_line += ' ';
+      line.console_line += msg->message();
+      line.console_line += '\n';
+      if (ELPP->hasFlag(el::LoggingFlag::ColoredTerminalOutput))
+        logger->logBuilder()->convertToColoredOutput(&line.console_line, level);
+    }
+    if (line.file_line.empty() && line.console_line.empty())
+      return;
+
+    async_writer->push(std::move(line));
+    if (level == el::Level::Fatal)
+      async_writer->flush();
+  }
+};
+
+}
+
 void mlog_configure(const std::string &filename_base, bool console, const std::size_t max_log_file_size, const std::size_t max_log_files)
 {
+  // Reconfiguring replaces the loggers' files, so get everything already logged into the old ones
+  mlog_flush();
+
   el::Configurations c;
   c.setGlobally(el::ConfigurationType::Filename, filename_base);
   c.setGlobally(el::ConfigurationType::ToFile, "true");
@@ -171,6 +432,10 @@ void mlog_configure(const std::string &filename_base, bool console, const std::s
   el::Loggers::addFlag(el::LoggingFlag::ColoredTerminalOutput);
   el::Loggers::addFlag(el::LoggingFlag::StrictLogFileSizeCheck);
   el::Helpers::installPreRollOutCallback([filename_base, max_log_files](const char *name, size_t){
+    struct roll_out_scope {
+      roll_out_scope() { in_pre_roll_out = true; }
+      ~roll_out_scope() { in_pre_roll_out = false; }
+    } roll_out_scope;
     std::string rname = generate_log_filename(filename_base.c_str());
     int ret = rename(name, rname.c_str());
     if (ret < 0)
@@ -252,6 +517,10 @@ void mlog_set_categories(const char *categories)
     }
   }
   el::Loggers::setCategories(new_categories.c_str(), true);
+  uint32_t gen = mlog_categories_generation.load(std::memory_order_relaxed) + 1;
+  if ((gen & 0xffffff) == 0)
+    ++gen;
+  mlog_categories_generation.store(gen, std::memory_order_release);
   MLOG_LOG("New log categories: " << el::Loggers::getCategories());
 }
 
@@ -299,9 +568,63 @@ void mlog_set_log(const char *log)
   }
 }
 
+void mlog_set_async(bool async)
+{
+  if (async == bool(async_writer))
+    return;
+
+  std::unique_ptr<async_log_writer> old_writer;
+  if (async)
+  {
+    async_writer = std::make_unique<async_log_writer>();
+    static bool registered_exit_handler = false;
+    if (!registered_exit_handler)
+    {
+      std::atexit([] { mlog_set_async(false); });
+      registered_exit_handler = true;
+    }
+  }
+  {
+    // Log calls dispatch while holding this, so no dispatch is in progress while we swap callbacks
+    el::base::threading::ScopedLock lock{ELPP->lock()};
+    if (async)
+    {
+      el::Helpers::uninstallLogDispatchCallback<el::base::DefaultLogDispatchCallback>("DefaultLogDispatchCallback");
+      el::Helpers::installLogDispatchCallback<async_log_dispatch_callback>("AsyncLogDispatchCallback");
+    }
+    else
+    {
+      el::Helpers::uninstallLogDispatchCallback<async_log_dispatch_callback>("AsyncLogDispatchCallback");
+      el::Helpers::installLogDispatchCallback<el::base::DefaultLogDispatchCallback>("DefaultLogDispatchCallback");
+      old_writer = std::move(async_writer);
+    }
+  }
+  // Destroying the writer writes out whatever is still queued
+  old_writer.reset();
+}
+
+void mlog_flush()
+{
+  if (async_writer)
+    async_writer->flush();
+}
+
 namespace epee
 {
 
+std::atomic<uint32_t> mlog_categories_generation{1};
+
+uint32_t mlog_refresh_site_levels(std::atomic<uint32_t>& site_levels, const std::string& cat)
+{
+  const uint32_t gen = mlog_categories_generation.load(std::memory_order_acquire) & 0xffffff;
+  uint32_t levels = gen << 8;
+  for (auto level : {el::Level::Fatal, el::Level::Error, el::Level::Warning, el::Level::Info, el::Level::Debug, el::Level::Trace})
+    if (ELPP->vRegistry()->allowed(level, cat))
+      levels |= static_cast<uint32_t>(level);
+  site_levels.store(levels, std::memory_order_relaxed);
+  return levels;
+}
+
 bool is_stdout_a_tty()
 {
   static std::atomic<bool> initialized(false);
@@ -482,10 +805,9 @@ static bool mlog(el::Level level, const char *category, const char *format, va_l
 
   try
   {
-    /* TODO(loki): when pulling upstream epee changes change this to:
-    MCLOG(level, category, el::Color::Default, p);
-    */
-    MCLOG(level, category, p);
+    // Not MCLOG: its cached level check assumes the call site always logs to the same category
+    if (ELPP->vRegistry()->allowed(level, category))
+      el::base::Writer(level, __FILE__, __LINE__, ELPP_FUNC, el::base::DispatchAction::NormalLog).construct(category) << p;
   }
   catch(...)
   {
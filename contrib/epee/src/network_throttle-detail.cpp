@@ -123,6 +123,7 @@ network_throttle::network_throttle(const std::string &nameshort, const std::stri
 	m_target_speed = 16 * 1024; // other defaults are probably defined in the command-line parsing code when this class is used e.g. as main global throttle
 	m_last_sample_time = 0;
 	m_history.resize(m_window_size);
+	m_history_bytes = 0;
 	m_total_packets = 0;
 	m_total_bytes = 0;
 }
@@ -151,6 +152,17 @@ void network_throttle::tick()
 	network_time_seconds current_sample_time_slot = time_to_slot( time_now ); // T=13.7 --> 13  (for 1-second smallwindow)
 	network_time_seconds last_sample_time_slot = time_to_slot( m_last_sample_time );
 
+	if (m_any_packet_yet && current_sample_time_slot - last_sample_time_slot >= m_window_size)
+	{
+		// Idle for longer than the whole window: every slot would be rotated out, so just empty them
+		// rather than stepping through each second of the gap
+		for (auto& sample : m_history)
+			sample.m_size = 0;
+		m_history_bytes = 0;
+		m_last_sample_time = time_now;
+		return;
+	}
+
 	// moving to next position, and filling gaps
 	// !! during this loop the m_last_sample_time and last_sample_time_slot mean the variable moved in +1
 	// TODO optimize when moving few slots at once
@@ -158,6 +170,8 @@ void network_throttle::tick()
 	{
 		MTRACE("Moving counter buffer by 1 second " << last_sample_time_slot << " < " << current_sample_time_slot << " (last time " << m_last_sample_time<<")");
 		// rotate buffer 
+		if (m_history.full())
+			m_history_bytes -= m_history.back().m_size;
 		m_history.push_front(packet_info());
 		if (! m_any_packet_yet) 
 		{
@@ -178,12 +192,17 @@ void network_throttle::_handle_trafic_exact(size_t packet_size, size_t orginal_s
 {
 	tick();
 
-	calculate_times_struct cts ;  calculate_times(packet_size, cts , false, -1);
-	calculate_times_struct cts2;  calculate_times(packet_size, cts2, false, 5);
 	m_history.front().m_size += packet_size;
+	m_history_bytes += packet_size;
 	m_total_packets++;
 	m_total_bytes += packet_size;
 
+	// This is called for every packet, so only work out what to log if it'll actually be logged
+	if (!LOG_ENABLED(Trace))
+		return;
+
+	calculate_times_struct cts ;  calculate_times(packet_size, cts , false, -1);
+	calculate_times_struct cts2;  calculate_times(packet_size, cts2, false, 5);
 	std::ostringstream oss; oss << "["; 	for (auto sample: m_history) oss << sample.m_size << " ";	 oss << "]" << std::ends;
 	std::string history_str = oss.str();
 
@@ -252,8 +271,7 @@ void network_throttle::calculate_times(size_t packet_size, calculate_times_struc
 	// also at least slot size (e.g. 1 second) to not be ridiculous
 	// window_len e.g. 5.7 because takes into account current slot time
 
-	size_t Epast = 0; // summ of traffic till now
-	for (auto sample : m_history) Epast += sample.m_size; 
+	const size_t Epast = m_history_bytes; // summ of traffic till now
 
 	const size_t E = Epast;
 	const size_t Enow = Epast + packet_size ; // including the data we're about to send now
@@ -276,7 +294,7 @@ void network_throttle::calculate_times(size_t packet_size, calculate_times_struc
         cts.recomendetDataSize = M*cts.window - E;
     }
 
-	if (dbg) {
+	if (dbg && LOG_ENABLED(Trace)) {
 		std::ostringstream oss; oss << "["; 	for (auto sample: m_history) oss << sample.m_size << " ";	 oss << "]" << std::ends;
 		std::string history_str = oss.str();
 		MTRACE((cts.delay > 0 ? "SLEEP" : "")
@@ -329,17 +347,11 @@ size_t network_throttle::get_recommended_size_of_planned_transport() const {
 }
 
 double network_throttle::get_current_speed() const {
-	unsigned int bytes_transferred = 0;
-	if (m_history.size() == 0 || m_slot_size == 0)
+	if (m_history.size() <= 1 || m_slot_size == 0)
 		return 0;
-		
-	auto it = m_history.begin();
-	while (it < m_history.end() - 1)
-	{
-		bytes_transferred += it->m_size;
-		it ++;
-	}
-	
+
+	// Everything but the oldest slot
+	const size_t bytes_transferred = m_history_bytes - m_history.back().m_size;
 	return bytes_transferred / ((m_history.size() - 1) * m_slot_size);
 }
 
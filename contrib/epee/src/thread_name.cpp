@@ -0,0 +1,58 @@
+#include "epee/thread_name.h"
+
+#include <algorithm>
+#include <string>
+
+#include "easylogging++.h"
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <pthread.h>
+#endif
+
+namespace epee
+{
+  namespace
+  {
+    // initial-exec so that reading it from a signal handler can't trigger a lazy TLS allocation
+#if defined(__GNUC__) && !defined(_WIN32)
+    thread_local thread_info this_thread __attribute__((tls_model("initial-exec"))) {};
+#else
+    thread_local thread_info this_thread{};
+#endif
+  }
+
+  void set_thread_name(std::string_view name)
+  {
+    const size_t len = std::min(name.size(), sizeof(this_thread.name) - 1);
+    std::copy_n(name.data(), len, this_thread.name);
+    this_thread.name[len] = 0;
+
+#if defined(__linux__)
+    pthread_setname_np(pthread_self(), std::string{name.substr(0, 15)}.c_str());
+    pthread_attr_t attr;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0)
+    {
+      void* addr;
+      size_t size;
+      if (pthread_attr_getstack(&attr, &addr, &size) == 0)
+      {
+        this_thread.stack_lo = reinterpret_cast<uintptr_t>(addr);
+        this_thread.stack_hi = this_thread.stack_lo + size;
+      }
+      pthread_attr_destroy(&attr);
+    }
+#elif defined(__APPLE__)
+    pthread_setname_np(std::string{name.substr(0, 15)}.c_str());
+    // pthread_get_stackaddr_np returns the top (highest address) of the stack
+    this_thread.stack_hi = reinterpret_cast<uintptr_t>(pthread_get_stackaddr_np(pthread_self()));
+    this_thread.stack_lo = this_thread.stack_hi - pthread_get_stacksize_np(pthread_self());
+#endif
+
+    el::Helpers::setThreadName(std::string{name});
+  }
+
+  const thread_info& this_thread_info()
+  {
+    return this_thread;
+  }
+}
@@ -0,0 +1,178 @@
+#include "blob_compression.h"
+
+#include <atomic>
+#include <numeric>
+#include <stdexcept>
+
+#ifdef ENABLE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+namespace cryptonote
+{
+
+#ifdef ENABLE_ZSTD
+
+namespace
+{
+  constexpr int COMPRESSION_LEVEL = 3;
+
+  struct cctx_deleter { void operator()(ZSTD_CCtx* c) const { ZSTD_freeCCtx(c); } };
+  struct dctx_deleter { void operator()(ZSTD_DCtx* d) const { ZSTD_freeDCtx(d); } };
+
+  ZSTD_CCtx* thread_cctx()
+  {
+    thread_local std::unique_ptr<ZSTD_CCtx, cctx_deleter> ctx{ZSTD_createCCtx()};
+    return ctx.get();
+  }
+
+  ZSTD_DCtx* thread_dctx()
+  {
+    thread_local std::unique_ptr<ZSTD_DCtx, dctx_deleter> ctx{ZSTD_createDCtx()};
+    return ctx.get();
+  }
+
+  void check(size_t result, const char* what)
+  {
+    if (ZSTD_isError(result))
+      throw std::runtime_error{std::string{what} + ": " + ZSTD_getErrorName(result)};
+  }
+}
+
+struct blob_compressor::dictionary
+{
+  std::string data;
+  ZSTD_CDict* cdict = nullptr;
+  ZSTD_DDict* ddict = nullptr;
+  unsigned id = 0;
+
+  explicit dictionary(std::string d) : data{std::move(d)}
+  {
+    id = ZDICT_getDictID(data.data(), data.size());
+    if (id == 0)
+      throw std::runtime_error{"Invalid zstd dictionary"};
+    cdict = ZSTD_createCDict(data.data(), data.size(), COMPRESSION_LEVEL);
+    ddict = ZSTD_createDDict(data.data(), data.size());
+    if (!cdict || !ddict)
+    {
+      ZSTD_freeCDict(cdict);
+      ZSTD_freeDDict(ddict);
+      throw std::runtime_error{"Failed to load zstd dictionary"};
+    }
+  }
+  ~dictionary()
+  {
+    ZSTD_freeCDict(cdict);
+    ZSTD_freeDDict(ddict);
+  }
+  dictionary(const dictionary&) = delete;
+  dictionary& operator=(const dictionary&) = delete;
+};
+
+bool blob_compressor::supported() { return true; }
+
+std::string blob_compressor::compress(std::string_view blob, bool use_dictionary) const
+{
+  std::shared_ptr<const dictionary> dict;
+  if (use_dictionary)
+    dict = std::atomic_load(&m_dict);
+
+  std::string result;
+  result.resize(ZSTD_compressBound(blob.size()));
+  size_t size = dict
+    ? ZSTD_compress_usingCDict(thread_cctx(), result.data(), result.size(), blob.data(), blob.size(), dict->cdict)
+    : ZSTD_compressCCtx(thread_cctx(), result.data(), result.size(), blob.data(), blob.size(), COMPRESSION_LEVEL);
+  check(size, "zstd compression failed");
+  result.resize(size);
+  return result;
+}
+
+std::string blob_compressor::decompress(std::string_view compressed) const
+{
+  unsigned long long const content_size = ZSTD_getFrameContentSize(compressed.data(), compressed.size());
+  if (content_size == ZSTD_CONTENTSIZE_ERROR || content_size == ZSTD_CONTENTSIZE_UNKNOWN)
+    throw std::runtime_error{"Invalid compressed blob"};
+
+  std::shared_ptr<const dictionary> dict;
+  if (unsigned const dict_id = ZSTD_getDictID_fromFrame(compressed.data(), compressed.size()))
+  {
+    dict = std::atomic_load(&m_dict);
+    if (!dict || dict->id != dict_id)
+      throw std::runtime_error{"Compressed blob requires an unavailable zstd dictionary (id " + std::to_string(dict_id) + ")"};
+  }
+
+  std::string result;
+  result.resize(content_size);
+  size_t size = dict
+    ? ZSTD_decompress_usingDDict(thread_dctx(), result.data(), result.size(), compressed.data(), compressed.size(), dict->ddict)
+    : ZSTD_decompressDCtx(thread_dctx(), result.data(), result.size(), compressed.data(), compressed.size());
+  check(size, "zstd decompression failed");
+  if (size != result.size())
+    throw std::runtime_error{"Compressed blob has an incorrect content size"};
+  return result;
+}
+
+void blob_compressor::set_dictionary(std::string dict)
+{
+  std::atomic_store(&m_dict, std::shared_ptr<const dictionary>{std::make_shared<dictionary>(std::move(dict))});
+}
+
+void blob_compressor::clear_dictionary()
+{
+  std::atomic_store(&m_dict, std::shared_ptr<const dictionary>{});
+}
+
+bool blob_compressor::has_dictionary() const
+{
+  return static_cast<bool>(std::atomic_load(&m_dict));
+}
+
+std::string blob_compressor::train_dictionary(const std::vector<std::string>& samples, size_t max_size)
+{
+  std::string concatenated;
+  std::vector<size_t> sizes;
+  concatenated.reserve(std::accumulate(samples.begin(), samples.end(), size_t{0},
+        [](size_t total, const std::string& s) { return total + s.size(); }));
+  sizes.reserve(samples.size());
+  for (auto& s : samples)
+  {
+    concatenated += s;
+    sizes.push_back(s.size());
+  }
+
+  std::string dict;
+  dict.resize(max_size);
+  size_t size = ZDICT_trainFromBuffer(dict.data(), dict.size(), concatenated.data(), sizes.data(), sizes.size());
+  if (ZDICT_isError(size))
+    throw std::runtime_error{std::string{"zstd dictionary training failed: "} + ZDICT_getErrorName(size)};
+  dict.resize(size);
+  return dict;
+}
+
+#else // !ENABLE_ZSTD
+
+struct blob_compressor::dictionary {};
+
+namespace
+{
+  [[noreturn]] void unsupported()
+  {
+    throw std::runtime_error{"This build does not support blob compression (built without zstd)"};
+  }
+}
+
+bool blob_compressor::supported() { return false; }
+std::string blob_compressor::compress(std::string_view, bool) const { unsupported(); }
+std::string blob_compressor::decompress(std::string_view) const { unsupported(); }
+void blob_compressor::set_dictionary(std::string) { unsupported(); }
+void blob_compressor::clear_dictionary() {}
+bool blob_compressor::has_dictionary() const { return false; }
+std::string blob_compressor::train_dictionary(const std::vector<std::string>&, size_t) { unsupported(); }
+
+#endif
+
+blob_compressor::blob_compressor() = default;
+blob_compressor::~blob_compressor() = default;
+
+}
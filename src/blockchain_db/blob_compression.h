@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cryptonote
+{
+
+// zstd compression of the block and transaction blobs stored in the blockchain database.  Pruned
+// transaction blobs (i.e. prefixes) are small and highly repetitive so, once one has been trained,
+// they are compressed against a shared dictionary, which is where most of the saving comes from;
+// everything else is compressed on its own.
+//
+// Compressed values are self-describing zstd frames (the frame records the id of the dictionary it
+// needs, if any), so decompress() works on either kind.  Compression and decompression contexts are
+// per-thread, so a single compressor can be used concurrently from any number of readers; only
+// set_dictionary() must not race with compress()/decompress() calls that expect the new dictionary.
+//
+// Without zstd support compiled in, supported() returns false and everything else throws.
+class blob_compressor
+{
+public:
+  blob_compressor();
+  ~blob_compressor();
+
+  // Whether this build can compress and decompress at all
+  static bool supported();
+
+  std::string compress(std::string_view blob, bool use_dictionary = false) const;
+  std::string decompress(std::string_view compressed) const;
+
+  // Install a dictionary (as produced by train_dictionary()) to be used by compress(blob, true)
+  // and by decompress() of values compressed with it.  Throws if the dictionary is not valid.
+  void set_dictionary(std::string dict);
+  void clear_dictionary();
+  bool has_dictionary() const;
+
+  // Trains a dictionary of at most `max_size` bytes from sample blobs.  Throws on failure (e.g. if
+  // there are too few samples for zstd to produce a useful dictionary).
+  static std::string train_dictionary(const std::vector<std::string>& samples, size_t max_size);
+
+private:
+  struct dictionary;
+  std::shared_ptr<const dictionary> m_dict;
+};
+
+}
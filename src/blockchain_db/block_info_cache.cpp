@@ -0,0 +1,215 @@
+#include "block_info_cache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+namespace cryptonote
+{
+
+namespace
+{
+  // Appends the values of `column` (followed, for the writer, by `staged(i)` for the staged heights
+  // above `keep`) from `start_height` to `out`; the caller holds the lock.
+  template <typename T, typename Staged>
+  bool column_range(const std::vector<T>& column, uint64_t keep, size_t staged_size, Staged staged,
+      uint64_t start_height, size_t count, std::vector<T>& out, bool writer)
+  {
+    uint64_t const end_committed = writer ? keep : column.size();
+    uint64_t const end = writer ? keep + staged_size : end_committed;
+    if (start_height >= end)
+      return false;
+
+    count = std::min<uint64_t>(count, end - start_height);
+    out.reserve(out.size() + count);
+    uint64_t const committed_end = std::min<uint64_t>(start_height + count, end_committed);
+    if (start_height < committed_end)
+      out.insert(out.end(), column.begin() + start_height, column.begin() + committed_end);
+    for (uint64_t h = std::max(start_height, end_committed); h < start_height + count; h++)
+      out.push_back(staged(h - keep));
+    return true;
+  }
+}
+
+uint64_t block_info_cache::hash_key(const crypto::hash& hash)
+{
+  uint64_t key;
+  std::memcpy(&key, hash.data, sizeof(key));
+  return key;
+}
+
+void block_info_cache::append(const entry& e, const crypto::hash& hash)
+{
+  m_staged.push_back(e);
+  m_staged_hashes.push_back(hash);
+}
+
+void block_info_cache::pop()
+{
+  if (!m_staged.empty())
+  {
+    m_staged.pop_back();
+    m_staged_hashes.pop_back();
+  }
+  else
+  {
+    uint64_t keep = m_keep.value_or(committed_size());
+    if (keep > 0)
+      m_keep = keep - 1;
+  }
+}
+
+void block_info_cache::commit()
+{
+  if (!m_keep && m_staged.empty())
+    return;
+  std::unique_lock lock{m_mutex};
+  for (size_t f = 0; f < NUM_FIELDS; f++)
+  {
+    auto& column = m_columns[f];
+    if (m_keep)
+      column.resize(*m_keep);
+    column.reserve(column.size() + m_staged.size());
+    for (auto& e : m_staged)
+      column.push_back(e[f]);
+  }
+
+  if (m_keep)
+  {
+    for (uint64_t h = *m_keep; h < m_hashes.size(); h++)
+      if (auto it = m_heights.find(hash_key(m_hashes[h])); it != m_heights.end() && it->second == h)
+        m_heights.erase(it);
+    m_hashes.resize(*m_keep);
+  }
+  m_hashes.reserve(m_hashes.size() + m_staged_hashes.size());
+  for (auto& hash : m_staged_hashes)
+  {
+    if (!m_heights.emplace(hash_key(hash), m_hashes.size()).second)
+      m_heights_complete = false;
+    m_hashes.push_back(hash);
+  }
+
+  m_keep.reset();
+  m_staged.clear();
+  m_staged_hashes.clear();
+}
+
+void block_info_cache::abort()
+{
+  m_keep.reset();
+  m_staged.clear();
+  m_staged_hashes.clear();
+}
+
+void block_info_cache::clear()
+{
+  std::unique_lock lock{m_mutex};
+  for (auto& column : m_columns)
+  {
+    column.clear();
+    column.shrink_to_fit();
+  }
+  m_hashes.clear();
+  m_hashes.shrink_to_fit();
+  m_heights.clear();
+  m_heights_complete = true;
+  m_keep.reset();
+  m_staged.clear();
+  m_staged_hashes.clear();
+}
+
+uint64_t block_info_cache::size(bool writer) const
+{
+  if (writer)
+    return m_keep.value_or(committed_size()) + m_staged.size();
+  std::shared_lock lock{m_mutex};
+  return committed_size();
+}
+
+std::optional<uint64_t> block_info_cache::get(field f, uint64_t height, bool writer) const
+{
+  if (writer)
+  {
+    uint64_t const keep = m_keep.value_or(committed_size());
+    if (height >= keep)
+    {
+      if (height - keep < m_staged.size())
+        return m_staged[height - keep][f];
+      return std::nullopt;
+    }
+  }
+  std::shared_lock lock{m_mutex};
+  auto& column = m_columns[f];
+  if (height >= column.size())
+    return std::nullopt;
+  return column[height];
+}
+
+bool block_info_cache::get_range(field f, uint64_t start_height, size_t count, std::vector<uint64_t>& out, bool writer) const
+{
+  uint64_t const keep = writer ? m_keep.value_or(committed_size()) : 0;
+  std::shared_lock lock{m_mutex};
+  return column_range(m_columns[f], keep, m_staged.size(), [this, f](size_t i) { return m_staged[i][f]; },
+      start_height, count, out, writer);
+}
+
+std::optional<crypto::hash> block_info_cache::get_hash(uint64_t height, bool writer) const
+{
+  if (writer)
+  {
+    uint64_t const keep = m_keep.value_or(committed_size());
+    if (height >= keep)
+    {
+      if (height - keep < m_staged_hashes.size())
+        return m_staged_hashes[height - keep];
+      return std::nullopt;
+    }
+  }
+  std::shared_lock lock{m_mutex};
+  if (height >= m_hashes.size())
+    return std::nullopt;
+  return m_hashes[height];
+}
+
+bool block_info_cache::get_hashes(uint64_t start_height, size_t count, std::vector<crypto::hash>& out, bool writer) const
+{
+  uint64_t const keep = writer ? m_keep.value_or(committed_size()) : 0;
+  std::shared_lock lock{m_mutex};
+  return column_range(m_hashes, keep, m_staged_hashes.size(), [this](size_t i) { return m_staged_hashes[i]; },
+      start_height, count, out, writer);
+}
+
+std::optional<bool> block_info_cache::find_hash(const crypto::hash& hash, uint64_t* height, bool writer) const
+{
+  uint64_t limit;
+  if (writer)
+  {
+    limit = m_keep.value_or(committed_size());
+    for (size_t i = 0; i < m_staged_hashes.size(); i++)
+    {
+      if (m_staged_hashes[i] == hash)
+      {
+        if (height)
+          *height = limit + i;
+        return true;
+      }
+    }
+  }
+  std::shared_lock lock{m_mutex};
+  if (!writer)
+    limit = committed_size();
+  if (auto it = m_heights.find(hash_key(hash)); it != m_heights.end() && m_hashes[it->second] == hash)
+  {
+    // A committed block the writer has popped (and not re-added) is no longer in its chain
+    if (it->second >= limit)
+      return false;
+    if (height)
+      *height = it->second;
+    return true;
+  }
+  if (!m_heights_complete)
+    return std::nullopt;
+  return false;
+}
+
+}
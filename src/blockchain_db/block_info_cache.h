@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+
+// In-memory copy of the per-height block_info fields, stored a column per field, so that the loops
+// over heights in difficulty, weight median and block header calculations are array scans instead
+// of an LMDB lookup per height.  The block hashes are kept too, in a column of their own plus an
+// index back to their heights, for chain history queries (find_blockchain_supplement and friends).
+//
+// The writer stages its changes with append() and pop(), then commit()s or abort()s them along with
+// the write txn they were made in.  Lookups only see committed heights (i.e. what other threads'
+// LMDB read txns can see), except that the writer, whose own txn sees its uncommitted changes, passes
+// `writer = true` to see the staged changes as well.  Lookups of heights the cache doesn't have
+// return nullopt/false and should be answered from the database.
+//
+// Lookups are thread-safe; append/pop/commit/abort must only be called by the (single) writer.
+class block_info_cache
+{
+public:
+  enum field : uint8_t
+  {
+    timestamp,
+    weight,
+    long_term_weight,
+    cumulative_difficulty,
+    coins,
+    cumulative_rct_outs,
+    NUM_FIELDS,
+  };
+
+  using entry = std::array<uint64_t, NUM_FIELDS>;
+
+  void append(const entry& e, const crypto::hash& hash);
+  // Removes the top height (committed or staged)
+  void pop();
+  void commit();
+  void abort();
+  // Drops everything, including staged changes
+  void clear();
+
+  // Number of heights visible to a lookup
+  uint64_t size(bool writer) const;
+
+  std::optional<uint64_t> get(field f, uint64_t height, bool writer) const;
+  // Appends up to `count` values of `f` from `start_height` (fewer if the cache ends first) to
+  // `out`.  Returns false, without touching `out`, if `start_height` is not in the cache.
+  bool get_range(field f, uint64_t start_height, size_t count, std::vector<uint64_t>& out, bool writer) const;
+
+  std::optional<crypto::hash> get_hash(uint64_t height, bool writer) const;
+  // Same as get_range, for block hashes
+  bool get_hashes(uint64_t start_height, size_t count, std::vector<crypto::hash>& out, bool writer) const;
+  // Looks up the height of block `hash`.  Returns true (setting `height`, if given) if it is in the
+  // chain, false if it is not, or nullopt if the cache can't tell and the database must be asked.
+  std::optional<bool> find_hash(const crypto::hash& hash, uint64_t* height, bool writer) const;
+
+private:
+  mutable std::shared_mutex m_mutex;
+  std::array<std::vector<uint64_t>, NUM_FIELDS> m_columns;
+  std::vector<crypto::hash> m_hashes;
+  // Committed heights by the first 8 bytes of their hash (checked against m_hashes on lookup).  A
+  // block whose prefix is already taken isn't indexed, and m_heights_complete is cleared so that
+  // misses are no longer taken as conclusive.
+  std::unordered_map<uint64_t, uint64_t> m_heights;
+  bool m_heights_complete = true;
+
+  // Writer-only staging: the number of committed heights still in the chain, and the entries
+  // added above them, since the last commit/abort.
+  std::optional<uint64_t> m_keep;
+  std::vector<entry> m_staged;
+  std::vector<crypto::hash> m_staged_hashes;
+
+  uint64_t committed_size() const { return m_columns[0].size(); }
+  static uint64_t hash_key(const crypto::hash& hash);
+};
+
+}
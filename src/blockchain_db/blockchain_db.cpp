@@ -47,7 +47,9 @@ namespace cryptonote
 
 const command_line::arg_descriptor<std::string> arg_db_sync_mode = {
   "db-sync-mode"
-, "Specify sync option, using format [safe|fast|fastest]:[sync|async]:[<nblocks_per_sync>[blocks]|<nbytes_per_sync>[bytes]]." 
+, "Specify sync option, using format [safe|fast|fastest]:[sync|async]:[<nblocks_per_sync>[blocks]|<nbytes_per_sync>[bytes]], "
+  "or [fast|fastest]:group[:<max_delay>ms][:<max_bytes>bytes] to sync at most max_delay (default 5000) after a write or once max_bytes (default 64MB) are waiting, "
+  "together with the service node list and ONS database." 
 , "fast:async:250000000bytes"
 };
 const command_line::arg_descriptor<bool> arg_db_salvage  = {
@@ -55,6 +57,27 @@ const command_line::arg_descriptor<bool> arg_db_salvage  = {
 , "Try to salvage a blockchain database if it seems corrupted"
 , false
 };
+const command_line::arg_descriptor<bool> arg_db_compress  = {
+  "db-compress"
+, "Store block and transaction blobs zstd-compressed when creating a new blockchain database. Has no effect on an existing database"
+, false
+};
+
+const command_line::arg_descriptor<std::string> arg_db_prewarm_tables  = {
+  "db-prewarm-tables"
+, "Comma-separated blockchain database tables (e.g. block_info,output_amounts,spent_keys,tx_indices) to read into the page cache in the background after startup"
+, ""
+};
+const command_line::arg_descriptor<uint64_t> arg_db_prewarm_blocks  = {
+  "db-prewarm-blocks"
+, "Number of most recent blocks whose block and transaction data to read into the page cache in the background after startup, before any --db-prewarm-tables"
+, 0
+};
+const command_line::arg_descriptor<uint64_t> arg_db_prewarm_rate  = {
+  "db-prewarm-rate"
+, "Maximum rate (in MB/s) at which --db-prewarm-tables and --db-prewarm-blocks read the database"
+, 16
+};
 
 BlockchainDB *new_db()
 {
@@ -65,6 +88,10 @@ void BlockchainDB::init_options(boost::program_options::options_description& des
 {
   command_line::add_arg(desc, arg_db_sync_mode);
   command_line::add_arg(desc, arg_db_salvage);
+  command_line::add_arg(desc, arg_db_compress);
+  command_line::add_arg(desc, arg_db_prewarm_tables);
+  command_line::add_arg(desc, arg_db_prewarm_blocks);
+  command_line::add_arg(desc, arg_db_prewarm_rate);
 }
 
 void BlockchainDB::pop_block()
@@ -101,7 +128,7 @@ void BlockchainDB::add_transaction(const crypto::hash& blk_hash, const std::pair
 
     crypto::secret_key secret_tx_key;
     cryptonote::account_public_address address;
-    if (get_tx_secret_key_from_tx_extra(tx.extra, secret_tx_key) && get_service_node_contributor_from_tx_extra(tx.extra, address))
+    if (get_tx_secret_key_from_tx_extra(tx, secret_tx_key) && get_service_node_contributor_from_tx_extra(tx, address))
       has_blacklisted_outputs = true;
   }
 
@@ -304,6 +331,29 @@ transaction BlockchainDB::get_tx(const crypto::hash& h) const
   return tx;
 }
 
+std::vector<std::vector<std::vector<uint64_t>>> BlockchainDB::get_blocks_tx_amount_output_indices(uint64_t tx_id, const std::vector<size_t>& block_txes, bool miner_txes) const
+{
+  size_t total = 0;
+  for (size_t n : block_txes)
+    total += 1 + n;
+  auto indices = get_tx_amount_output_indices(tx_id, total);
+  if (indices.size() != total)
+    throw TX_DNE("tx output indices not found in db for all txs from tx id " + std::to_string(tx_id));
+
+  std::vector<std::vector<std::vector<uint64_t>>> result;
+  result.reserve(block_txes.size());
+  auto it = indices.begin();
+  for (size_t n : block_txes)
+  {
+    auto& block = result.emplace_back();
+    if (!miner_txes)
+      ++it;
+    block.assign(std::make_move_iterator(it), std::make_move_iterator(it + n + miner_txes));
+    it += n + miner_txes;
+  }
+  return result;
+}
+
 uint64_t BlockchainDB::get_output_unlock_time(const uint64_t amount, const uint64_t amount_index) const
 {
   output_data_t odata = get_output_key(amount, amount_index);
@@ -421,6 +471,40 @@ bool BlockchainDB::get_alt_block_header(const crypto::hash &blkid, alt_block_dat
   return true;
 }
 
+std::vector<uint64_t> BlockchainDB::get_cumulative_rct_outputs(uint64_t start_height, size_t count) const
+{
+  std::vector<uint64_t> heights;
+  uint64_t const end = std::min<uint64_t>(height(), start_height + count);
+  if (start_height >= end)
+    return {};
+  heights.reserve(end - start_height);
+  for (uint64_t h = start_height; h < end; h++)
+    heights.push_back(h);
+  return get_block_cumulative_rct_outputs(heights);
+}
+
+std::vector<uint64_t> BlockchainDB::get_block_timestamps(uint64_t start_height, size_t count) const
+{
+  std::vector<uint64_t> result;
+  uint64_t const end = std::min<uint64_t>(height(), start_height + count);
+  if (start_height < end)
+    result.reserve(end - start_height);
+  for (uint64_t h = start_height; h < end; h++)
+    result.push_back(get_block_timestamp(h));
+  return result;
+}
+
+std::vector<difficulty_type> BlockchainDB::get_block_cumulative_difficulties(uint64_t start_height, size_t count) const
+{
+  std::vector<difficulty_type> result;
+  uint64_t const end = std::min<uint64_t>(height(), start_height + count);
+  if (start_height < end)
+    result.reserve(end - start_height);
+  for (uint64_t h = start_height; h < end; h++)
+    result.push_back(get_block_cumulative_difficulty(h));
+  return result;
+}
+
 void BlockchainDB::fill_timestamps_and_difficulties_for_pow(cryptonote::network_type nettype,
                                                             std::vector<uint64_t> &timestamps,
                                                             std::vector<uint64_t> &difficulties,
@@ -451,10 +535,12 @@ void BlockchainDB::fill_timestamps_and_difficulties_for_pow(cryptonote::network_
     uint64_t start_height = chain_height - std::min<size_t>(chain_height, block_count);
     start_height          = std::max<uint64_t>(start_height, 1);
 
-    for (uint64_t block_height = start_height; block_height < (chain_height - 1) /*skip latest block*/; block_height++)
+    if (start_height < chain_height - 1 /*skip latest block*/)
     {
-      timestamps.push_back(get_block_timestamp(block_height));
-      difficulties.push_back(get_block_cumulative_difficulty(block_height));
+      auto range_timestamps = get_block_timestamps(start_height, chain_height - 1 - start_height);
+      auto range_difficulties = get_block_cumulative_difficulties(start_height, chain_height - 1 - start_height);
+      timestamps.insert(timestamps.end(), range_timestamps.begin(), range_timestamps.end());
+      difficulties.insert(difficulties.end(), range_difficulties.begin(), range_difficulties.end());
     }
   }
 
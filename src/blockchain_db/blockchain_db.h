@@ -31,6 +31,8 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <functional>
 #include <exception>
 #include <boost/program_options.hpp>
 #include "common/command_line.h"
@@ -109,6 +111,10 @@ typedef std::pair<crypto::hash, uint64_t> tx_out_index;
 
 extern const command_line::arg_descriptor<std::string> arg_db_sync_mode;
 extern const command_line::arg_descriptor<bool, false> arg_db_salvage;
+extern const command_line::arg_descriptor<bool, false> arg_db_compress;
+extern const command_line::arg_descriptor<std::string> arg_db_prewarm_tables;
+extern const command_line::arg_descriptor<uint64_t> arg_db_prewarm_blocks;
+extern const command_line::arg_descriptor<uint64_t> arg_db_prewarm_rate;
 
 #pragma pack(push, 1)
 
@@ -178,6 +184,7 @@ struct txpool_tx_meta_t
 #define DBF_FASTEST    4
 #define DBF_RDONLY     8
 #define DBF_SALVAGE 0x10
+#define DBF_COMPRESS 0x20
 
 /***********************************
  * Exception Definitions
@@ -661,6 +668,22 @@ public:
    */
   virtual std::vector<fs::path> get_filenames() const = 0;
 
+  /**
+   * @brief write a compacted copy of the database into another folder
+   *
+   * The copy is taken from a consistent snapshot of the database, so this can be done while the
+   * database is open (and being written to, here or by another process).  The copy contains no
+   * free pages and its B-trees are stored in key order, so it is as small as this data can be
+   * and sequential scans of it (in particular of a pruned node's prunable data) are sequential
+   * reads.  The folder must exist and must not already contain a database.
+   *
+   * If this cannot be done, the subclass should throw the corresponding
+   * subclass of DB_EXCEPTION
+   *
+   * @param folder the folder to write the copy into
+   */
+  virtual void copy_compacted(const fs::path& folder) const = 0;
+
   /**
    * @brief remove file(s) storing the database
    *
@@ -964,6 +987,20 @@ public:
    */
   virtual std::vector<uint64_t> get_block_cumulative_rct_outputs(const std::vector<uint64_t> &heights) const = 0;
 
+  /**
+   * @brief fetch the cumulative number of rct outputs of a range of blocks
+   *
+   * If there are fewer than count blocks from start_height, the returned array will be smaller
+   * than count.  The default implementation calls get_block_cumulative_rct_outputs() with every
+   * height in the range.
+   *
+   * @param start_height the height of the first block
+   * @param count the number of blocks requested
+   *
+   * @return the cumulative numbers of rct outputs
+   */
+  virtual std::vector<uint64_t> get_cumulative_rct_outputs(uint64_t start_height, size_t count) const;
+
   /**
    * @brief fetch the top block's timestamp
    *
@@ -1062,6 +1099,33 @@ public:
    */
   virtual std::vector<uint64_t> get_long_term_block_weights(uint64_t start_height, size_t count) const = 0;
 
+  /**
+   * @brief fetch the timestamps of a range of blocks
+   *
+   * If there are fewer than count blocks from start_height, the returned array will be smaller
+   * than count.  The default implementation calls get_block_timestamp() for each height.
+   *
+   * @param start_height the height of the first block
+   * @param count the number of blocks requested
+   *
+   * @return the timestamps
+   */
+  virtual std::vector<uint64_t> get_block_timestamps(uint64_t start_height, size_t count) const;
+
+  /**
+   * @brief fetch the cumulative difficulties of a range of blocks
+   *
+   * If there are fewer than count blocks from start_height, the returned array will be smaller
+   * than count.  The default implementation calls get_block_cumulative_difficulty() for each
+   * height.
+   *
+   * @param start_height the height of the first block
+   * @param count the number of blocks requested
+   *
+   * @return the cumulative difficulties
+   */
+  virtual std::vector<difficulty_type> get_block_cumulative_difficulties(uint64_t start_height, size_t count) const;
+
   /**
    * @brief fetch a block's hash
    *
@@ -1298,6 +1362,33 @@ public:
    */
   virtual bool get_pruned_tx_blobs_from(const crypto::hash& h, size_t count, std::vector<cryptonote::blobdata> &bd) const = 0;
 
+  /**
+   * @brief hint that a range of blocks and their transactions are about to be read
+   *
+   * Used when serving sync requests to start fetching the span a peer is likely to ask for next
+   * before it asks.  The subclass may start reading the data in the background and return
+   * without waiting for it; heights beyond the top of the chain are ignored.  The default
+   * implementation does nothing.
+   *
+   * @param start_height the height of the first block
+   * @param count the number of blocks
+   */
+  virtual void prefetch_blocks(uint64_t start_height, size_t count) const {}
+
+  /**
+   * @brief starts reading data into the page cache in the background after opening
+   *
+   * So that the first queries after a restart don't all wait on the disk.  Reads the data of the
+   * most recent `recent_blocks` blocks first, then the whole of each named table, at no more than
+   * `bytes_per_second` so as not to starve other I/O; stops early if the database is closed.  The
+   * default implementation does nothing.
+   *
+   * @param tables the names of the tables to read (unknown names are skipped with a warning)
+   * @param recent_blocks the number of blocks from the top of the chain to read
+   * @param bytes_per_second the rate limit
+   */
+  virtual void start_prewarm(const std::vector<std::string>& tables, uint64_t recent_blocks, uint64_t bytes_per_second) {}
+
   /**
    * @brief fetches the prunable transaction blob with the given hash
    *
@@ -1435,6 +1526,20 @@ public:
    */
   virtual tx_out_index get_output_tx_and_index_from_global(const uint64_t& index) const = 0;
 
+  /**
+   * @brief gets some outputs' tx hashes and indices
+   *
+   * This function is a mirror of
+   * get_output_tx_and_index_from_global(const uint64_t& index),
+   * but for a list of outputs rather than just one.  The lookups are done in
+   * sorted order, so this is much cheaper than one call per output.
+   *
+   * @param global_indices a list of output global indices
+   * @param tx_out_indices return-by-reference a list of tx hashes and output indices (as pairs),
+   * in the same order as global_indices
+   */
+  virtual void get_output_tx_and_index_from_global(const std::vector<uint64_t> &global_indices, std::vector<tx_out_index> &tx_out_indices) const = 0;
+
   /**
    * @brief gets an output's tx hash and index
    *
@@ -1456,11 +1561,11 @@ public:
    * get_output_tx_and_index(const uint64_t& amount, const uint64_t& index),
    * but for a list of outputs rather than just one.
    *
-   * @param amount an output amount
+   * @param amounts an output amount, or as many as offsets
    * @param offsets a list of amount-specific output indices
    * @param indices return-by-reference a list of tx hashes and output indices (as pairs)
    */
-  virtual void get_output_tx_and_index(const uint64_t& amount, const std::vector<uint64_t> &offsets, std::vector<tx_out_index> &indices) const = 0;
+  virtual void get_output_tx_and_index(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<tx_out_index> &indices) const = 0;
 
   /**
    * @brief gets outputs' data
@@ -1471,7 +1576,8 @@ public:
    *
    * @param amounts an output amount, or as many as offsets
    * @param offsets a list of amount-specific output indices
-   * @param outputs return-by-reference a list of outputs' metadata
+   * @param outputs return-by-reference a list of outputs' metadata, in the same order as offsets
+   * (the outputs are looked up in sorted order, so callers needn't sort them)
    */
   virtual void get_output_key(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial = false) const = 0;
   
@@ -1498,6 +1604,24 @@ public:
    */
   virtual std::vector<std::vector<uint64_t>> get_tx_amount_output_indices(const uint64_t tx_id, size_t n_txes = 1) const = 0;
 
+  /**
+   * @brief gets output indices (amount-specific) for the txs of consecutive blocks
+   *
+   * A block's txs have consecutive IDs (its miner tx, then the others in order), following on
+   * from the previous block's, so those of a run of blocks can be read in one go rather than
+   * looked up per block or per tx.  The default implementation splits up the result of
+   * get_tx_amount_output_indices().
+   *
+   * If a transaction does not exist, the subclass should throw TX_DNE.
+   *
+   * @param tx_id the ID of the first block's miner transaction
+   * @param block_txes the number of (non-miner) transactions of each block
+   * @param miner_txes whether to include the miner transactions' indices, first in each block's
+   *
+   * @return for each block, the amount-specific output indices of its transactions
+   */
+  virtual std::vector<std::vector<std::vector<uint64_t>>> get_blocks_tx_amount_output_indices(uint64_t tx_id, const std::vector<size_t>& block_txes, bool miner_txes) const;
+
   /**
    * @brief check if a key image is stored as spent
    *
@@ -1588,6 +1712,20 @@ public:
    */
   virtual bool prune_blockchain(uint32_t pruning_seed = 0) = 0;
 
+  /**
+   * @brief prunes the next part of the blockchain, in its own short write transaction
+   *
+   * Sets the pruning seed on the first call, so that new blocks are stored pruned from then on,
+   * and remembers where it got to, so that repeated calls (even across restarts) go through the
+   * whole chain once, like prune_blockchain() does in one go.
+   *
+   * @param pruning_seed the seed to use, 0 for default (highly recommended); ignored once set
+   * @param max_records the most txs to go through in this call
+   *
+   * @return true if the blockchain is now fully pruned, false if there is more to do
+   */
+  virtual bool prune_blockchain_batch(uint32_t pruning_seed, size_t max_records) = 0;
+
   /**
    * @brief prunes recent blockchain changes as needed, iff pruning is enabled
    * @return success iff true
@@ -1805,10 +1943,22 @@ public:
 
   virtual void get_output_blacklist(std::vector<uint64_t> &blacklist) const   = 0;
   virtual void add_output_blacklist(std::vector<uint64_t> const &blacklist)   = 0;
-  virtual void set_service_node_data(const std::string& data, bool long_term) = 0;
   virtual bool get_service_node_data(std::string &data, bool long_term) const = 0;
   virtual void clear_service_node_data()                                      = 0;
 
+  /// Service node data records, keyed by record type (1-255) and block height.  Records of each
+  /// type are independent of each other; for_each_service_node_record visits those of the given
+  /// type in ascending height order until `f` returns false.  clear_service_node_data() removes
+  /// all records as well as the legacy blobs returned by get_service_node_data().
+  virtual void set_service_node_record(uint8_t type, uint64_t height, std::string_view data) = 0;
+  virtual void remove_service_node_record(uint8_t type, uint64_t height) = 0;
+  virtual void for_each_service_node_record(uint8_t type, std::function<bool(uint64_t height, std::string_view data)> f) const = 0;
+
+  /// Uptime proof data lives in a store of its own, apart from the chain data, so that the steady
+  /// stream of proofs doesn't compete with block commits for the database write lock.  The proof
+  /// methods don't take part in the caller's (batch) transaction, don't need the blockchain lock,
+  /// and their writes aren't synced along with the chain (a lost proof is replaced by the next one).
+
   /// Updates the given proof data with the latest stored info for the given service node.  Returns
   /// true if found (and fields updated), false otherwise.
   virtual bool get_service_node_proof(const crypto::public_key &pubkey, service_nodes::proof_info &proof) const = 0;
@@ -1823,6 +1973,10 @@ public:
   /// found, false if not found.
   virtual bool remove_service_node_proof(const crypto::public_key &pubkey) = 0;
 
+  /// Batch versions of the above, each written in a single transaction.
+  virtual void set_service_node_proofs(const std::vector<std::pair<crypto::public_key, service_nodes::proof_info>> &proofs) = 0;
+  virtual void remove_service_node_proofs(const std::vector<crypto::public_key> &pubkeys) = 0;
+
   // This function accepts an empty timestamps/difficulties array to fill, or
   // a prior timestamps/difficulties array that was filled by a previous call to
   // this same function in which case it will optimally insert and remove the
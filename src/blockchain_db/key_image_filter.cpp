@@ -0,0 +1,53 @@
+#include "key_image_filter.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cryptonote
+{
+
+key_image_filter::key_image_filter(size_t capacity)
+  : m_capacity{capacity},
+    m_num_blocks{std::max<size_t>(1, (capacity * BITS_PER_ELEMENT + BLOCK_WORDS * 64 - 1) / (BLOCK_WORDS * 64))},
+    m_words{new std::atomic<uint64_t>[m_num_blocks * BLOCK_WORDS]}
+{
+  for (size_t i = 0; i < m_num_blocks * BLOCK_WORDS; i++)
+    m_words[i].store(0, std::memory_order_relaxed);
+}
+
+size_t key_image_filter::block_index(const crypto::key_image& ki) const
+{
+  uint64_t h;
+  std::memcpy(&h, ki.data, sizeof(h));
+  return h % m_num_blocks;
+}
+
+// The bit positions within the block come from the next 64 bits of the key image, 9 bits (one of
+// 512 positions) at a time.
+static uint64_t bit_source(const crypto::key_image& ki)
+{
+  uint64_t h;
+  std::memcpy(&h, ki.data + 8, sizeof(h));
+  return h;
+}
+
+void key_image_filter::insert(const crypto::key_image& ki)
+{
+  std::atomic<uint64_t>* block = &m_words[block_index(ki) * BLOCK_WORDS];
+  uint64_t bits = bit_source(ki);
+  for (size_t i = 0; i < HASHES; i++, bits >>= 9)
+    block[(bits >> 6) & 7].fetch_or(uint64_t{1} << (bits & 63), std::memory_order_release);
+  m_size.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool key_image_filter::maybe_contains(const crypto::key_image& ki) const
+{
+  const std::atomic<uint64_t>* block = &m_words[block_index(ki) * BLOCK_WORDS];
+  uint64_t bits = bit_source(ki);
+  for (size_t i = 0; i < HASHES; i++, bits >>= 9)
+    if (!(block[(bits >> 6) & 7].load(std::memory_order_acquire) & (uint64_t{1} << (bits & 63))))
+      return false;
+  return true;
+}
+
+}
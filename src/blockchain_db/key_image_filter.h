@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include "crypto/crypto.h"
+
+namespace cryptonote
+{
+
+// Blocked Bloom filter of spent key images, kept in front of the spent_keys table so that the
+// (overwhelmingly common) answer "not spent" doesn't need an LMDB lookup.  A key image is mapped
+// to one 512-bit (i.e. cache line) block in which HASHES bits are set, so a query touches a single
+// cache line.  Key images are already uniformly distributed, so their bytes are used directly
+// rather than being hashed.
+//
+// Key images can't be removed: a removed (e.g. popped block) key image just becomes a false
+// positive until the filter is next rebuilt, which is harmless since positives are always
+// confirmed against the database.
+//
+// insert() may be called concurrently with maybe_contains(), but not with another insert().
+class key_image_filter
+{
+public:
+  static constexpr size_t BITS_PER_ELEMENT = 16;
+  static constexpr size_t HASHES = 7;
+
+  // Creates a filter sized for `capacity` key images (at the intended false positive rate; it
+  // keeps working beyond that, just with more false positives).
+  explicit key_image_filter(size_t capacity);
+
+  void insert(const crypto::key_image& ki);
+  // Returns false if `ki` has definitely not been inserted
+  bool maybe_contains(const crypto::key_image& ki) const;
+
+  size_t capacity() const { return m_capacity; }
+  size_t size() const { return m_size.load(std::memory_order_relaxed); }
+
+private:
+  static constexpr size_t BLOCK_WORDS = 8; // 8 × 64 bits
+
+  size_t block_index(const crypto::key_image& ki) const;
+
+  size_t m_capacity;
+  size_t m_num_blocks;
+  std::unique_ptr<std::atomic<uint64_t>[]> m_words;
+  std::atomic<size_t> m_size{0};
+};
+
+}
@@ -31,16 +31,24 @@
 #include <boost/format.hpp>
 #include <boost/circular_buffer.hpp>
 #include <boost/endian/conversion.hpp>
+#include <algorithm>
 #include <memory>
 #include <cstring>
+#include <numeric>
 #include <type_traits>
 #include <variant>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #include "cryptonote_basic/hardfork.h"
 #include "epee/string_tools.h"
 #include "common/file.h"
 #include "common/pruning.h"
 #include "common/hex.h"
+#include "common/perf_timer.h"
+#include "common/string_util.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "crypto/crypto.h"
 #include "epee/profile_tools.h"
@@ -251,7 +259,7 @@ const char* const LMDB_ALT_BLOCKS = "alt_blocks";
 const char* const LMDB_HF_STARTING_HEIGHTS = "hf_starting_heights";
 const char* const LMDB_HF_VERSIONS = "hf_versions";
 const char* const LMDB_SERVICE_NODE_DATA = "service_node_data";
-const char* const LMDB_SERVICE_NODE_LATEST = "service_node_proofs"; // contains the latest data sent with a proof: time, aux keys, ip, ports
+const char* const LMDB_SERVICE_NODE_LATEST = "service_node_proofs"; // legacy location of the latest proof data; now moved into SERVICE_NODE_PROOFS_FILENAME on open
 
 const char* const LMDB_PROPERTIES = "properties";
 
@@ -621,11 +629,22 @@ void BlockchainLMDB::check_open() const
     throw0(DB_ERROR("DB operation attempted on a not-open DB instance"));
 }
 
-void BlockchainLMDB::do_resize(uint64_t increase_size)
+bool BlockchainLMDB::do_resize(uint64_t increase_size, bool wait_for_readers)
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   std::lock_guard lock{*this};
-  const uint64_t add_size = 1LL << 30;
+
+  MDB_envinfo mei;
+
+  mdb_env_info(m_env, &mei);
+
+  MDB_stat mst;
+
+  mdb_env_stat(m_env, &mst);
+
+  // add at least 1GB (or increase_size, if given: this is currently used for increasing by an
+  // estimated size at start of a new batch txn).
+  uint64_t add_size = std::max<uint64_t>(increase_size, 1LL << 30);
 
   // check disk capacity
   try
@@ -635,8 +654,14 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
     {
       MERROR("!! WARNING: Insufficient free space to extend database !!: " <<
           (si.available >> 20L) << " MB available, " << (add_size >> 20L) << " MB needed");
-      return;
+      return false;
     }
+    // Beyond what is needed, grow geometrically (as far as free space allows) so that a growing
+    // database doesn't have to stop every reader for a resize every GB.  The map is only address
+    // space until it is written to, so this costs nothing on 64-bit platforms.
+    if (sizeof(size_t) >= 8)
+      add_size = std::max(add_size, std::min<uint64_t>(
+            static_cast<uint64_t>(mei.me_mapsize * RESIZE_GROWTH_FACTOR), si.available));
   }
   catch(...)
   {
@@ -644,29 +669,15 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
     MWARNING("Unable to query free disk space.");
   }
 
-  MDB_envinfo mei;
-
-  mdb_env_info(m_env, &mei);
-
-  MDB_stat mst;
-
-  mdb_env_stat(m_env, &mst);
-
-  // add 1Gb per resize, instead of doing a percentage increase
   uint64_t new_mapsize = (uint64_t) mei.me_mapsize + add_size;
 
-  // If given, use increase_size instead of above way of resizing.
-  // This is currently used for increasing by an estimated size at start of new
-  // batch txn.
-  if (increase_size > 0)
-    new_mapsize = mei.me_mapsize + increase_size;
-
   new_mapsize += (new_mapsize % mst.ms_psize);
 
   mdb_txn_safe::prevent_new_txns();
 
   if (m_write_txn != nullptr)
   {
+    mdb_txn_safe::allow_new_txns();
     if (m_batch_active)
     {
       throw0(DB_ERROR("lmdb resizing not yet supported when batch transactions enabled!"));
@@ -677,15 +688,60 @@ void BlockchainLMDB::do_resize(uint64_t increase_size)
     }
   }
 
+  if (!wait_for_readers && mdb_txn_safe::num_active_txns > 0)
+  {
+    mdb_txn_safe::allow_new_txns();
+    MDEBUG("Skipping early LMDB resize: read txns are active");
+    return false;
+  }
+
   mdb_txn_safe::wait_no_active_txns();
 
   int result = mdb_env_set_mapsize(m_env, new_mapsize);
   if (result)
+  {
+    mdb_txn_safe::allow_new_txns();
     throw0(DB_ERROR(lmdb_error("Failed to set new mapsize: ", result).c_str()));
+  }
 
   MGINFO("LMDB Mapsize increased." << "  Old: " << mei.me_mapsize / (1024 * 1024) << "MiB" << ", New: " << new_mapsize / (1024 * 1024) << "MiB");
 
   mdb_txn_safe::allow_new_txns();
+  return true;
+}
+
+uint64_t BlockchainLMDB::map_size_used() const
+{
+  MDB_envinfo mei;
+  mdb_env_info(m_env, &mei);
+  MDB_stat mst;
+  mdb_env_stat(m_env, &mst);
+  return mst.ms_psize * mei.me_last_pgno;
+}
+
+void BlockchainLMDB::update_growth_estimate()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  const uint64_t h = height();
+  const uint64_t used = map_size_used();
+  if (m_growth_height == 0 || h < m_growth_height || used < m_growth_size_used)
+  {
+    // First sample, or the chain was popped/reset: start measuring again from here
+    m_growth_height = h;
+    m_growth_size_used = used;
+    return;
+  }
+  if (h - m_growth_height < GROWTH_SAMPLE_BLOCKS)
+    return;
+
+  // me_last_pgno only moves once freed pages run out, so this measures what the next blocks will
+  // actually cost in map space rather than their raw size.
+  double rate = static_cast<double>(used - m_growth_size_used) / (h - m_growth_height);
+  m_growth_per_block = m_growth_per_block > 0 ? 0.7 * m_growth_per_block + 0.3 * rate : rate;
+  MDEBUG("DB growth: " << static_cast<uint64_t>(rate) << " bytes/block over the last " << h - m_growth_height
+      << " blocks, average " << static_cast<uint64_t>(m_growth_per_block));
+  m_growth_height = h;
+  m_growth_size_used = used;
 }
 
 // threshold_size is used for batch transactions
@@ -697,15 +753,11 @@ bool BlockchainLMDB::need_resize(uint64_t threshold_size) const
 
   mdb_env_info(m_env, &mei);
 
-  MDB_stat mst;
-
-  mdb_env_stat(m_env, &mst);
-
   // size_used doesn't include data yet to be committed, which can be
   // significant size during batch transactions. For that, we estimate the size
   // needed at the beginning of the batch transaction and pass in the
   // additional size needed.
-  uint64_t size_used = mst.ms_psize * mei.me_last_pgno;
+  uint64_t size_used = map_size_used();
 
   MDEBUG("DB map size:     " << mei.me_mapsize);
   MDEBUG("Space used:      " << size_used);
@@ -743,21 +795,27 @@ void BlockchainLMDB::check_and_resize_for_batch(uint64_t batch_num_blocks, uint6
   const uint64_t min_increase_size = 512 * (1 << 20);
   uint64_t threshold_size = 0;
   uint64_t increase_size = 0;
+  update_growth_estimate();
   if (batch_num_blocks > 0)
   {
     threshold_size = get_estimated_batch_size(batch_num_blocks, batch_bytes);
     MDEBUG("calculated batch size: " << threshold_size);
 
-    // The increased DB size could be a multiple of threshold_size, a fixed
-    // size increase (> threshold_size), or other variations.
-    //
-    // Currently we use the greater of threshold size and a minimum size. The
-    // minimum size increase is used to avoid frequent resizes when the batch
+    // Grow by enough for at least the next couple of batches (do_resize adds geometric growth on
+    // top of this).  The minimum size increase is used to avoid frequent resizes when the batch
     // size is set to a very small numbers of blocks.
-    increase_size = (threshold_size > min_increase_size) ? threshold_size : min_increase_size;
+    increase_size = std::max(2 * threshold_size, min_increase_size);
     MDEBUG("increase size: " << increase_size);
   }
 
+  // A resize has to wait for every reader to finish, so if we are getting close (within two
+  // batches) try to do it now, while nobody is reading, rather than stalling on it later.
+  if (threshold_size > 0 && !need_resize(threshold_size) && need_resize(2 * threshold_size))
+  {
+    if (do_resize(increase_size, false /*wait_for_readers*/))
+      return;
+  }
+
   // if threshold_size is 0 (i.e. number of blocks for batch not passed in), it
   // will fall back to the percent-based threshold check instead of the
   // size-based check
@@ -832,6 +890,18 @@ uint64_t BlockchainLMDB::get_estimated_batch_size(uint64_t batch_num_blocks, uin
     MDEBUG("average block size across recent " << num_blocks_used << " blocks: " << avg_block_size);
   }
 estim:
+  if (m_growth_per_block > 0)
+  {
+    // We know how much space blocks have actually been taking up: use that (uplifted if this
+    // batch's blocks are bigger than average) instead of guessing at the expansion from raw blocks.
+    double per_block = m_growth_per_block;
+    if (batch_bytes)
+      per_block = std::max(per_block, avg_block_size * 2.0);
+    threshold_size = per_block * batch_safety_factor * std::max<float>(batch_num_blocks, 1000.0f);
+    MDEBUG("estimated batch size from observed growth of " << static_cast<uint64_t>(m_growth_per_block) << " bytes/block: " << threshold_size);
+    return threshold_size;
+  }
+
   if (avg_block_size < min_block_size)
     avg_block_size = min_block_size;
   MDEBUG("estimated average block size for batch: " << avg_block_size);
@@ -843,6 +913,76 @@ estim:
   return threshold_size;
 }
 
+std::string_view BlockchainLMDB::blob_value(const MDB_val& v, std::string& buffer) const
+{
+  std::string_view blob{static_cast<const char*>(v.mv_data), v.mv_size};
+  if (!m_compress)
+    return blob;
+  try {
+    buffer = m_compressor.decompress(blob);
+  } catch (const std::exception& e) {
+    throw0(DB_ERROR("Failed to decompress blob retrieved from the db: "s + e.what()));
+  }
+  return buffer;
+}
+
+cryptonote::blobdata BlockchainLMDB::blob_string(const MDB_val& v) const
+{
+  std::string buffer;
+  std::string_view blob = blob_value(v, buffer);
+  if (m_compress)
+    return buffer;
+  return cryptonote::blobdata{blob};
+}
+
+MDB_val BlockchainLMDB::compressed_value(std::string_view blob, std::string& buffer, bool tx_prefix)
+{
+  if (!m_compress)
+    return MDB_val{blob.size(), const_cast<char*>(blob.data())};
+  bool const use_dictionary = tx_prefix && m_compressor.has_dictionary();
+  if (tx_prefix && !use_dictionary && m_tx_prefix_samples.size() < TX_PREFIX_DICTIONARY_SAMPLES)
+    m_tx_prefix_samples.emplace_back(blob);
+  try {
+    buffer = m_compressor.compress(blob, use_dictionary);
+  } catch (const std::exception& e) {
+    throw0(DB_ERROR("Failed to compress blob: "s + e.what()));
+  }
+  return MDB_val{buffer.size(), buffer.data()};
+}
+
+void BlockchainLMDB::maybe_train_tx_prefix_dictionary()
+{
+  if (!m_compress || m_tx_prefix_samples.size() < TX_PREFIX_DICTIONARY_SAMPLES || m_compressor.has_dictionary())
+    return;
+
+  std::string dict;
+  try {
+    dict = blob_compressor::train_dictionary(m_tx_prefix_samples, TX_PREFIX_DICTIONARY_SIZE);
+  } catch (const std::exception& e) {
+    // Not fatal: prefixes just keep being compressed without a dictionary, and we retry once
+    // another full set of samples has been collected.
+    MWARNING("Failed to train tx prefix compression dictionary: " << e.what());
+    m_tx_prefix_samples.clear();
+    return;
+  }
+  m_tx_prefix_samples.clear();
+  m_tx_prefix_samples.shrink_to_fit();
+
+  // The dictionary has to be durable before anything is compressed with it, so it gets its own txn
+  // rather than riding along with whatever batch is about to start.
+  mdb_txn_safe txn;
+  if (auto result = lmdb_txn_begin(m_env, NULL, 0, txn))
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  MDB_val_str(k, "tx_prefix_dictionary");
+  MDB_val_sized(v, dict);
+  if (auto result = mdb_put(txn, m_properties, &k, &v, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to store tx prefix compression dictionary: ", result).c_str()));
+  txn.commit();
+
+  MINFO("Trained " << dict.size() << " byte tx prefix compression dictionary");
+  m_compressor.set_dictionary(std::move(dict));
+}
+
 void BlockchainLMDB::add_block(const block& blk, size_t block_weight, uint64_t long_term_block_weight, const difficulty_type& cumulative_difficulty, const uint64_t& coins_generated,
     uint64_t num_rct_outs, const crypto::hash& blk_hash)
 {
@@ -881,7 +1021,8 @@ void BlockchainLMDB::add_block(const block& blk, size_t block_weight, uint64_t l
 
   // this call to mdb_cursor_put will change height()
   cryptonote::blobdata block_blob(block_to_blob(blk));
-  MDB_val_sized(blob, block_blob);
+  std::string compressed;
+  MDB_val blob = compressed_value(block_blob, compressed);
   result = mdb_cursor_put(m_cur_blocks, &key, &blob, MDB_APPEND);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add block blob to db transaction: ", result).c_str()));
@@ -909,6 +1050,13 @@ void BlockchainLMDB::add_block(const block& blk, size_t block_weight, uint64_t l
   result = mdb_cursor_put(m_cur_block_info, (MDB_val *)&zerokval, &val, MDB_APPENDDUP);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add block info to db transaction: ", result).c_str()));
+  if (m_block_info_cache)
+    m_block_info_cache->append({bi.bi_timestamp, bi.bi_weight, bi.bi_long_term_block_weight, bi.bi_diff, bi.bi_coins, bi.bi_cum_rct}, bi.bi_hash);
+  if (m_parsed_cache)
+  {
+    m_parsed_cache->add_block(blk_hash, std::make_shared<const block>(blk), block_blob.size());
+    update_parsed_cache_size();
+  }
 
   result = mdb_cursor_put(m_cur_block_heights, (MDB_val *)&zerokval, &val_h, 0);
   if (result)
@@ -955,11 +1103,19 @@ void BlockchainLMDB::remove_block()
 
   if ((result = mdb_cursor_del(m_cur_block_info, 0)))
       throw1(DB_ERROR(lmdb_error("Failed to add removal of block info to db transaction: ", result).c_str()));
+  if (m_block_info_cache)
+    m_block_info_cache->pop();
+  if (m_parsed_cache)
+  {
+    m_parsed_cache->remove_block(bh.bh_hash);
+    update_parsed_cache_size();
+  }
 }
 
 uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, const std::pair<transaction, blobdata>& txp, const crypto::hash& tx_hash, const crypto::hash& tx_prunable_hash)
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  PERF_TIMER(add_transaction_data);
   check_open();
   mdb_txn_cursors *m_cursors = &m_wcursors;
   uint64_t m_height = height();
@@ -1015,12 +1171,13 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
   if (unprunable_size > blob.size())
     throw0(DB_ERROR("pruned tx size is larger than tx size"));
 
-  MDB_val pruned_blob = {unprunable_size, (void*)blob.data()};
+  std::string compressed;
+  MDB_val pruned_blob = compressed_value(std::string_view{blob}.substr(0, unprunable_size), compressed, true);
   result = mdb_cursor_put(m_cur_txs_pruned, &val_tx_id, &pruned_blob, MDB_APPEND);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add pruned tx blob to db transaction: ", result).c_str()));
 
-  MDB_val prunable_blob = {blob.size() - unprunable_size, (void*)(blob.data() + unprunable_size)};
+  MDB_val prunable_blob = compressed_value(std::string_view{blob}.substr(unprunable_size), compressed);
   result = mdb_cursor_put(m_cur_txs_prunable, &val_tx_id, &prunable_blob, MDB_APPEND);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add prunable tx blob to db transaction: ", result).c_str()));
@@ -1041,6 +1198,12 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
       throw0(DB_ERROR(lmdb_error("Failed to add prunable tx prunable hash to db transaction: ", result).c_str()));
   }
 
+  if (m_parsed_cache)
+  {
+    m_parsed_cache->add_tx(tx_hash, std::make_shared<const transaction>(tx), blob.size());
+    update_parsed_cache_size();
+  }
+
   return tx_id;
 }
 
@@ -1065,6 +1228,11 @@ void BlockchainLMDB::remove_transaction_data(const crypto::hash& tx_hash, const
 
   if (mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &val_h, MDB_GET_BOTH))
       throw1(TX_DNE("Attempting to remove transaction that isn't in the db"));
+  if (m_parsed_cache)
+  {
+    m_parsed_cache->remove_tx(tx_hash);
+    update_parsed_cache_size();
+  }
   txindex *tip = (txindex *)val_h.mv_data;
   MDB_val_set(val_tx_id, tip->data.tx_id);
 
@@ -1341,6 +1509,14 @@ void BlockchainLMDB::add_spent_key(const crypto::key_image& k_image)
     else
       throw1(DB_ERROR(lmdb_error("Error adding spent key image to db transaction: ", result).c_str()));
   }
+
+  // If this txn gets aborted the filter is left with a false positive, which is harmless
+  if (auto filter = std::atomic_load(&m_key_image_filter))
+  {
+    filter->insert(k_image);
+    if (filter->size() > filter->capacity())
+      rebuild_key_image_filter(2 * filter->capacity());
+  }
 }
 
 void BlockchainLMDB::remove_spent_key(const crypto::key_image& k_image)
@@ -1361,6 +1537,7 @@ void BlockchainLMDB::remove_spent_key(const crypto::key_image& k_image)
     if (result)
         throw1(DB_ERROR(lmdb_error("Error adding removal of key image to db transaction", result).c_str()));
   }
+  // Nothing to do for m_key_image_filter: the key image just becomes a false positive
 }
 
 BlockchainLMDB::~BlockchainLMDB()
@@ -1390,6 +1567,9 @@ BlockchainLMDB::BlockchainLMDB(bool batch_transactions): BlockchainDB()
   m_batch_active = false;
   m_cum_size = 0;
   m_cum_count = 0;
+  m_growth_height = 0;
+  m_growth_size_used = 0;
+  m_growth_per_block = 0;
 
   // reset may also need changing when initialize things here
 }
@@ -1593,6 +1773,7 @@ void BlockchainLMDB::open(const fs::path& filename, cryptonote::network_type net
         txn.commit();
         m_open = true;
         migrate(db_version, nettype);
+        open_proofs_env();
         return;
       }
     }
@@ -1625,15 +1806,69 @@ void BlockchainLMDB::open(const fs::path& filename, cryptonote::network_type net
     }
   }
 
+  // Whether blobs are compressed is fixed when the database is created: either every block and tx
+  // blob in it is compressed or none are.
+  m_compress = false;
+  MDB_val_str(k_compression, "blob_compression");
+  if (mdb_get(txn, m_properties, &k_compression, &v) == MDB_SUCCESS)
+  {
+    if (!blob_compressor::supported())
+    {
+      txn.abort();
+      mdb_env_close(m_env);
+      m_open = false;
+      MFATAL("Existing lmdb database stores compressed blobs, but this build does not support compression (it was built without zstd).");
+      return;
+    }
+    m_compress = true;
+    MDB_val_str(k_dict, "tx_prefix_dictionary");
+    if (mdb_get(txn, m_properties, &k_dict, &v) == MDB_SUCCESS)
+      m_compressor.set_dictionary(std::string{static_cast<const char*>(v.mv_data), v.mv_size});
+  }
+  else if (db_flags & DBF_COMPRESS)
+  {
+    if (m_height > 0)
+      MWARNING("Ignoring --db-compress: the existing lmdb database stores uncompressed blobs. Resync into a new database to use compression.");
+    else if (!blob_compressor::supported())
+      MWARNING("Ignoring --db-compress: this build does not support compression (it was built without zstd).");
+    else if (!(mdb_flags & MDB_RDONLY))
+    {
+      MDB_val_copy<uint32_t> v_compression(1);
+      if (auto put_result = mdb_put(txn, m_properties, &k_compression, &v_compression, 0))
+      {
+        txn.abort();
+        mdb_env_close(m_env);
+        m_open = false;
+        MERROR("Failed to write blob compression flag to database: " << mdb_strerror(put_result));
+        return;
+      }
+      m_compress = true;
+      MINFO("Creating lmdb database with compressed block and transaction blobs");
+    }
+  }
+
   // commit the transaction
   txn.commit();
   m_open = true;
+  open_proofs_env();
+
+  if (!(mdb_flags & MDB_RDONLY))
+  {
+    rebuild_key_image_filter();
+    load_block_info_cache();
+    m_parsed_cache = std::make_unique<parsed_block_cache>(PARSED_CACHE_BLOCKS, PARSED_CACHE_TXS);
+    m_parsed_cache_budget = tools::cache_budget::add("parsed_blocks", tools::cache_budget::priority::parsed_blocks, [this](size_t bytes) {
+      m_parsed_cache->evict(bytes);
+      update_parsed_cache_size();
+    });
+  }
   // from here, init should be finished
 }
 
 void BlockchainLMDB::close()
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  stop_prewarm();
   if (m_batch_active)
   {
     LOG_PRINT_L3("close() first calling batch_abort() due to active batch transaction");
@@ -1641,6 +1876,7 @@ void BlockchainLMDB::close()
   }
   this->sync();
   m_tinfo.reset();
+  close_proofs_env();
 
   // FIXME: not yet thread safe!!!  Use with care.
   mdb_env_close(m_env);
@@ -1719,10 +1955,36 @@ void BlockchainLMDB::reset()
   MDB_val_copy<uint32_t> v(static_cast<uint32_t>(VERSION));
   if (auto result = mdb_put(txn, m_properties, &k, &v, 0))
     throw0(DB_ERROR(lmdb_error("Failed to write version to database: ", result).c_str()));
+  // Keep storing compressed blobs, but train a new dictionary since the old one went with
+  // m_properties
+  if (m_compress)
+  {
+    MDB_val_str(k_compression, "blob_compression");
+    MDB_val_copy<uint32_t> v_compression(1);
+    if (auto result = mdb_put(txn, m_properties, &k_compression, &v_compression, 0))
+      throw0(DB_ERROR(lmdb_error("Failed to write blob compression flag to database: ", result).c_str()));
+  }
 
   txn.commit();
   m_cum_size = 0;
   m_cum_count = 0;
+  m_growth_height = 0;
+  m_growth_size_used = 0;
+  m_growth_per_block = 0;
+  if (m_compress)
+  {
+    m_compressor.clear_dictionary();
+    m_tx_prefix_samples.clear();
+  }
+  if (std::atomic_load(&m_key_image_filter))
+    std::atomic_store(&m_key_image_filter, std::make_shared<key_image_filter>(MIN_KEY_IMAGE_FILTER_CAPACITY));
+  if (m_block_info_cache)
+    m_block_info_cache->clear();
+  if (m_parsed_cache)
+  {
+    m_parsed_cache->clear();
+    update_parsed_cache_size();
+  }
 }
 
 std::vector<fs::path> BlockchainLMDB::get_filenames() const
@@ -1731,9 +1993,25 @@ std::vector<fs::path> BlockchainLMDB::get_filenames() const
   std::vector<fs::path> paths;
   paths.push_back(m_folder / CRYPTONOTE_BLOCKCHAINDATA_FILENAME);
   paths.push_back(m_folder / CRYPTONOTE_BLOCKCHAINDATA_LOCK_FILENAME);
+  paths.push_back(m_folder / SERVICE_NODE_PROOFS_FILENAME);
+  paths.push_back(m_folder / (SERVICE_NODE_PROOFS_FILENAME "-lock"));
   return paths;
 }
 
+void BlockchainLMDB::copy_compacted(const fs::path& folder) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  if (fs::exists(folder / CRYPTONOTE_BLOCKCHAINDATA_FILENAME))
+    throw0(DB_ERROR(("Refusing to overwrite existing database in " + folder.u8string()).c_str()));
+
+  // MDB_CP_COMPACT walks the B-trees of a read snapshot and writes their pages out renumbered
+  // and in order, omitting free pages.
+  if (auto result = mdb_env_copy2(m_env, folder.string().c_str(), MDB_CP_COMPACT))
+    throw0(DB_ERROR(lmdb_error("Failed to copy database: ", result).c_str()));
+}
+
 bool BlockchainLMDB::remove_data_file(const fs::path& folder) const
 {
   auto filename = folder / CRYPTONOTE_BLOCKCHAINDATA_FILENAME;
@@ -2032,7 +2310,7 @@ uint32_t BlockchainLMDB::get_blockchain_pruning_seed() const
   return pruning_seed;
 }
 
-static bool is_v1_tx(MDB_cursor *c_txs_pruned, MDB_val *tx_id)
+bool BlockchainLMDB::is_v1_tx(MDB_cursor *c_txs_pruned, MDB_val *tx_id) const
 {
   MDB_val v;
   int ret = mdb_cursor_get(c_txs_pruned, tx_id, &v, MDB_SET);
@@ -2040,7 +2318,8 @@ static bool is_v1_tx(MDB_cursor *c_txs_pruned, MDB_val *tx_id)
     throw0(DB_ERROR(lmdb_error("Failed to find transaction pruned data: ", ret).c_str()));
   if (v.mv_size == 0)
     throw0(DB_ERROR("Invalid transaction pruned data"));
-  return cryptonote::is_v1_tx(std::string_view{(const char*)v.mv_data, v.mv_size});
+  std::string buffer;
+  return cryptonote::is_v1_tx(blob_value(v, buffer));
 }
 
 enum { prune_mode_prune, prune_mode_update, prune_mode_check };
@@ -2317,6 +2596,15 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
   mdb_cursor_close(c_txs_prunable);
   mdb_cursor_close(c_txs_pruned);
 
+  if (mode == prune_mode_prune)
+  {
+    // This went through every tx, so it also finished any background pruning
+    MDB_val_str(k_progress, "pruning_progress");
+    result = mdb_del(txn, m_properties, &k_progress, NULL);
+    if (result && result != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error("Failed to remove pruning progress: ", result).c_str()));
+  }
+
   txn.commit();
 
   TIME_MEASURE_FINISH(t);
@@ -2328,6 +2616,154 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
   return true;
 }
 
+bool BlockchainLMDB::prune_blockchain_batch(uint32_t pruning_seed, size_t max_records)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  const uint32_t log_stripes = tools::get_pruning_log_stripes(pruning_seed);
+  if (log_stripes && log_stripes != CRYPTONOTE_PRUNING_LOG_STRIPES)
+    throw0(DB_ERROR("Pruning seed not in range"));
+  pruning_seed = tools::get_pruning_stripe(pruning_seed);
+  if (pruning_seed > (1ul << CRYPTONOTE_PRUNING_LOG_STRIPES))
+    throw0(DB_ERROR("Pruning seed not in range"));
+  check_open();
+
+  mdb_txn_safe txn;
+  auto result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+  // The hash of the next tx (in tx_indices order) to go through, kept from one batch to the next
+  // for as long as the pruning is incomplete
+  MDB_val_str(k_progress, "pruning_progress");
+  crypto::hash next{};
+
+  MDB_val_str(k, "pruning_seed");
+  MDB_val v;
+  result = mdb_get(txn, m_properties, &k, &v);
+  if (result == MDB_NOTFOUND)
+  {
+    // not pruned yet: set the seed now, so that new txs go straight into the prunable tip table
+    if (pruning_seed == 0)
+      pruning_seed = tools::get_random_stripe();
+    pruning_seed = tools::make_pruning_seed(pruning_seed, CRYPTONOTE_PRUNING_LOG_STRIPES);
+    v.mv_data = &pruning_seed;
+    v.mv_size = sizeof(pruning_seed);
+    if ((result = mdb_put(txn, m_properties, &k, &v, 0)))
+      throw0(DB_ERROR("Failed to save pruning seed"));
+    MINFO("Starting background blockchain pruning, seed " << epee::string_tools::to_string_hex(pruning_seed));
+  }
+  else if (result == 0)
+  {
+    if (v.mv_size != sizeof(uint32_t))
+      throw0(DB_ERROR("Failed to retrieve pruning seed: unexpected value size"));
+    const uint32_t data = *(const uint32_t*)v.mv_data;
+    if (pruning_seed != 0 && tools::get_pruning_stripe(data) != pruning_seed)
+      throw0(DB_ERROR("Blockchain already pruned with different seed"));
+    if (tools::get_pruning_log_stripes(data) != CRYPTONOTE_PRUNING_LOG_STRIPES)
+      throw0(DB_ERROR("Blockchain already pruned with different base"));
+    pruning_seed = data;
+
+    result = mdb_get(txn, m_properties, &k_progress, &v);
+    if (result == MDB_NOTFOUND)
+    {
+      txn.abort();
+      return true; // pruned already
+    }
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to retrieve pruning progress: ", result).c_str()));
+    if (v.mv_size != sizeof(next))
+      throw0(DB_ERROR("Failed to retrieve pruning progress: unexpected value size"));
+    memcpy(&next, v.mv_data, sizeof(next));
+  }
+  else
+  {
+    throw0(DB_ERROR(lmdb_error("Failed to retrieve or create pruning seed: ", result).c_str()));
+  }
+
+  MDB_cursor *c_txs_pruned, *c_txs_prunable, *c_txs_prunable_tip, *c_tx_indices;
+  if ((result = mdb_cursor_open(txn, m_txs_pruned, &c_txs_pruned)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_pruned: ", result).c_str()));
+  if ((result = mdb_cursor_open(txn, m_txs_prunable, &c_txs_prunable)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunable: ", result).c_str()));
+  if ((result = mdb_cursor_open(txn, m_txs_prunable_tip, &c_txs_prunable_tip)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunable_tip: ", result).c_str()));
+  if ((result = mdb_cursor_open(txn, m_tx_indices, &c_tx_indices)))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor for tx_indices: ", result).c_str()));
+  const uint64_t blockchain_height = height();
+
+  size_t n_records = 0, n_pruned_records = 0;
+  MDB_val_set(vi, next);
+  MDB_cursor_op op = MDB_GET_BOTH_RANGE;
+  bool done = false;
+  while (true)
+  {
+    result = mdb_cursor_get(c_tx_indices, (MDB_val *)&zerokval, &vi, op);
+    op = MDB_NEXT_DUP;
+    if (result == MDB_NOTFOUND)
+    {
+      done = true;
+      break;
+    }
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to enumerate transactions: ", result).c_str()));
+
+    txindex ti;
+    memcpy(&ti, vi.mv_data, sizeof(ti));
+    if (n_records == max_records)
+    {
+      next = ti.key;
+      break;
+    }
+    ++n_records;
+
+    // The same as a full prune_blockchain() does for each tx; txs added since the seed was set are
+    // already in the tip table, and putting them again is a no-op
+    const uint64_t block_height = ti.data.block_id;
+    MDB_val_set(kp, ti.data.tx_id);
+    if (block_height + CRYPTONOTE_PRUNING_TIP_BLOCKS >= blockchain_height)
+    {
+      MDB_val_set(vp, block_height);
+      if ((result = mdb_cursor_put(c_txs_prunable_tip, &kp, &vp, 0)))
+        throw0(DB_ERROR(lmdb_error("Failed to add transaction to prunable tip table: ", result).c_str()));
+    }
+    else if (!tools::has_unpruned_block(block_height, blockchain_height, pruning_seed) && !is_v1_tx(c_txs_pruned, &kp))
+    {
+      result = mdb_cursor_get(c_txs_prunable, &kp, &v, MDB_SET);
+      if (result && result != MDB_NOTFOUND)
+        throw0(DB_ERROR(lmdb_error("Error looking for transaction prunable data: ", result).c_str()));
+      if (result == 0)
+      {
+        if ((result = mdb_cursor_del(c_txs_prunable, 0)))
+          throw0(DB_ERROR(lmdb_error("Failed to delete transaction prunable data: ", result).c_str()));
+        ++n_pruned_records;
+      }
+    }
+  }
+
+  mdb_cursor_close(c_tx_indices);
+  mdb_cursor_close(c_txs_prunable_tip);
+  mdb_cursor_close(c_txs_prunable);
+  mdb_cursor_close(c_txs_pruned);
+
+  if (done)
+  {
+    result = mdb_del(txn, m_properties, &k_progress, NULL);
+    if (result && result != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error("Failed to remove pruning progress: ", result).c_str()));
+    MINFO("Background blockchain pruning finished");
+  }
+  else
+  {
+    MDB_val_set(vn, next);
+    if ((result = mdb_put(txn, m_properties, &k_progress, &vn, 0)))
+      throw0(DB_ERROR(lmdb_error("Failed to save pruning progress: ", result).c_str()));
+  }
+
+  txn.commit();
+  MDEBUG("Pruned " << n_pruned_records << " of " << n_records << " records");
+  return done;
+}
+
 bool BlockchainLMDB::prune_blockchain(uint32_t pruning_seed)
 {
   return prune_worker(prune_mode_prune, pruning_seed);
@@ -2503,6 +2939,10 @@ bool BlockchainLMDB::block_exists(const crypto::hash& h, uint64_t *height) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  if (m_block_info_cache)
+    if (auto found = m_block_info_cache->find_hash(h, height, is_writer()))
+      return *found;
+
   TXN_PREFIX_RDONLY();
   RCURSOR(block_heights);
 
@@ -2555,7 +2995,11 @@ T BlockchainLMDB::get_and_convert_block_blob_from_height(uint64_t height) const
   else if (get_result)
     throw0(DB_ERROR("Error attempting to retrieve a block from the db"));
 
-  std::string_view blob{reinterpret_cast<const char *>(value.mv_data), value.mv_size};
+  if constexpr (std::is_same_v<T, cryptonote::blobdata>)
+    return blob_string(value);
+
+  std::string buffer;
+  std::string_view blob = blob_value(value, buffer);
 
   T result;
   if constexpr (std::is_same_v<T, cryptonote::block>)
@@ -2568,10 +3012,6 @@ T BlockchainLMDB::get_and_convert_block_blob_from_height(uint64_t height) const
     serialization::binary_string_unarchiver ba{blob};
     serialization::value(ba, result);
   }
-  else if constexpr (std::is_same_v<T, cryptonote::blobdata>)
-  {
-    result = blob;
-  }
 
   return result;
 }
@@ -2579,6 +3019,8 @@ T BlockchainLMDB::get_and_convert_block_blob_from_height(uint64_t height) const
 block BlockchainLMDB::get_block_from_height(uint64_t height) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  if (auto cached = cached_block(height))
+    return *cached;
   block result = get_and_convert_block_blob_from_height<block>(height);
   return result;
 }
@@ -2596,6 +3038,17 @@ uint64_t BlockchainLMDB::get_block_height(const crypto::hash& h) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  if (m_block_info_cache)
+  {
+    uint64_t height;
+    if (auto found = m_block_info_cache->find_hash(h, &height, is_writer()))
+    {
+      if (!*found)
+        throw1(BLOCK_DNE("Attempted to retrieve non-existent block height from hash " + tools::type_to_hex(h)));
+      return height;
+    }
+  }
+
   TXN_PREFIX_RDONLY();
   RCURSOR(block_heights);
 
@@ -2613,6 +3066,8 @@ uint64_t BlockchainLMDB::get_block_height(const crypto::hash& h) const
 
 block_header BlockchainLMDB::get_block_header_from_height(uint64_t height) const
 {
+  if (auto cached = cached_block(height))
+    return *cached;
   block_header result = get_and_convert_block_blob_from_height<cryptonote::block_header>(height);
   return result;
 }
@@ -2629,6 +3084,9 @@ uint64_t BlockchainLMDB::get_block_timestamp(const uint64_t& height) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  if (auto cached = cached_block_info(block_info_cache::timestamp, height))
+    return *cached;
+
   TXN_PREFIX_RDONLY();
   RCURSOR(block_info);
 
@@ -2657,6 +3115,21 @@ std::vector<uint64_t> BlockchainLMDB::get_block_cumulative_rct_outputs(const std
     return {};
   res.reserve(heights.size());
 
+  if (m_block_info_cache)
+  {
+    const bool writer = is_writer();
+    for (uint64_t height : heights)
+    {
+      auto cum_rct = m_block_info_cache->get(block_info_cache::cumulative_rct_outs, height, writer);
+      if (!cum_rct)
+        break;
+      res.push_back(*cum_rct);
+    }
+    if (res.size() == heights.size())
+      return res;
+    res.clear();
+  }
+
   TXN_PREFIX_RDONLY();
   RCURSOR(block_info);
 
@@ -2727,6 +3200,9 @@ size_t BlockchainLMDB::get_block_weight(const uint64_t& height) const
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  if (auto cached = cached_block_info(block_info_cache::weight, height))
+    return *cached;
+
   TXN_PREFIX_RDONLY();
   RCURSOR(block_info);
 
@@ -2744,11 +3220,18 @@ size_t BlockchainLMDB::get_block_weight(const uint64_t& height) const
   return ret;
 }
 
-std::vector<uint64_t> BlockchainLMDB::get_block_info_64bit_fields(uint64_t start_height, size_t count, uint64_t (*extract)(const mdb_block_info* bi_data)) const
+std::vector<uint64_t> BlockchainLMDB::get_block_info_64bit_fields(uint64_t start_height, size_t count, block_info_cache::field cached, uint64_t (*extract)(const mdb_block_info* bi_data)) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  if (m_block_info_cache)
+  {
+    std::vector<uint64_t> ret;
+    if (m_block_info_cache->get_range(cached, start_height, count, ret, is_writer()))
+      return ret;
+  }
+
   TXN_PREFIX_RDONLY();
   RCURSOR(block_info);
 
@@ -2848,21 +3331,42 @@ void BlockchainLMDB::add_max_block_size(uint64_t sz)
 
 std::vector<uint64_t> BlockchainLMDB::get_block_weights(uint64_t start_height, size_t count) const
 {
-  return get_block_info_64bit_fields(start_height, count,
+  return get_block_info_64bit_fields(start_height, count, block_info_cache::weight,
       [](const mdb_block_info* bi) { return bi->bi_weight; });
 }
 
 std::vector<uint64_t> BlockchainLMDB::get_long_term_block_weights(uint64_t start_height, size_t count) const
 {
-  return get_block_info_64bit_fields(start_height, count,
+  return get_block_info_64bit_fields(start_height, count, block_info_cache::long_term_weight,
       [](const mdb_block_info* bi) { return bi->bi_long_term_block_weight; });
 }
 
+std::vector<uint64_t> BlockchainLMDB::get_cumulative_rct_outputs(uint64_t start_height, size_t count) const
+{
+  return get_block_info_64bit_fields(start_height, count, block_info_cache::cumulative_rct_outs,
+      [](const mdb_block_info* bi) { return bi->bi_cum_rct; });
+}
+
+std::vector<uint64_t> BlockchainLMDB::get_block_timestamps(uint64_t start_height, size_t count) const
+{
+  return get_block_info_64bit_fields(start_height, count, block_info_cache::timestamp,
+      [](const mdb_block_info* bi) { return bi->bi_timestamp; });
+}
+
+std::vector<difficulty_type> BlockchainLMDB::get_block_cumulative_difficulties(uint64_t start_height, size_t count) const
+{
+  return get_block_info_64bit_fields(start_height, count, block_info_cache::cumulative_difficulty,
+      [](const mdb_block_info* bi) { return bi->bi_diff; });
+}
+
 difficulty_type BlockchainLMDB::get_block_cumulative_difficulty(const uint64_t& height) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__ << "  height: " << height);
   check_open();
 
+  if (auto cached = cached_block_info(block_info_cache::cumulative_difficulty, height))
+    return *cached;
+
   TXN_PREFIX_RDONLY();
   RCURSOR(block_info);
 
@@ -2902,6 +3406,9 @@ uint64_t BlockchainLMDB::get_block_already_generated_coins(const uint64_t& heigh
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  if (auto cached = cached_block_info(block_info_cache::coins, height))
+    return *cached;
+
   TXN_PREFIX_RDONLY();
   RCURSOR(block_info);
 
@@ -2924,6 +3431,9 @@ uint64_t BlockchainLMDB::get_block_long_term_weight(const uint64_t& height) cons
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  if (auto cached = cached_block_info(block_info_cache::long_term_weight, height))
+    return *cached;
+
   TXN_PREFIX_RDONLY();
   RCURSOR(block_info);
 
@@ -2946,6 +3456,10 @@ crypto::hash BlockchainLMDB::get_block_hash_from_height(const uint64_t& height)
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  if (m_block_info_cache)
+    if (auto cached = m_block_info_cache->get_hash(height, is_writer()))
+      return *cached;
+
   TXN_PREFIX_RDONLY();
   RCURSOR(block_info);
 
@@ -2982,6 +3496,15 @@ std::vector<crypto::hash> BlockchainLMDB::get_hashes_range(const uint64_t& h1, c
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
   std::vector<crypto::hash> v;
+  if (h1 > h2)
+    return v;
+
+  if (m_block_info_cache && m_block_info_cache->get_hashes(h1, h2 - h1 + 1, v, is_writer()))
+  {
+    if (v.size() == h2 - h1 + 1)
+      return v;
+    v.clear();
+  }
 
   for (uint64_t height = h1; height <= h2; ++height)
   {
@@ -3139,10 +3662,58 @@ uint64_t BlockchainLMDB::get_tx_unlock_time(const crypto::hash& h) const
   return ret;
 }
 
-bool BlockchainLMDB::get_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd) const
+bool BlockchainLMDB::get_tx(const crypto::hash& h, cryptonote::transaction &tx) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
-  check_open();
+  if (!m_parsed_cache)
+    return BlockchainDB::get_tx(h, tx);
+
+  if (auto cached = m_parsed_cache->find_tx(h))
+  {
+    // The tx may have been popped or pruned since it was cached, which only the db can tell (but
+    // without having to read and parse the blobs)
+    check_open();
+    TXN_PREFIX_RDONLY();
+    RCURSOR(tx_indices);
+    RCURSOR(txs_prunable);
+
+    MDB_val_set(v, h);
+    auto get_result = mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+    if (get_result == 0)
+    {
+      txindex *tip = (txindex *)v.mv_data;
+      MDB_val_set(val_tx_id, tip->data.tx_id);
+      MDB_val unused;
+      get_result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &unused, MDB_SET);
+    }
+    if (get_result == MDB_NOTFOUND)
+    {
+      m_parsed_cache->remove_tx(h);
+      update_parsed_cache_size();
+      return false;
+    }
+    else if (get_result)
+      throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
+    tx = *cached;
+    return true;
+  }
+
+  blobdata bd;
+  if (!get_tx_blob(h, bd))
+    return false;
+  auto parsed = std::make_shared<transaction>();
+  if (!parse_and_validate_tx_from_blob(bd, *parsed))
+    throw DB_ERROR("Failed to parse transaction from blob retrieved from the db");
+  tx = *parsed;
+  m_parsed_cache->add_tx(h, std::move(parsed), bd.size());
+  update_parsed_cache_size();
+  return true;
+}
+
+bool BlockchainLMDB::get_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
 
   TXN_PREFIX_RDONLY();
   RCURSOR(tx_indices);
@@ -3167,9 +3738,11 @@ bool BlockchainLMDB::get_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
-  bd.reserve(result0.mv_size + result1.mv_size);
-  bd.append(reinterpret_cast<char*>(result0.mv_data), result0.mv_size);
-  bd.append(reinterpret_cast<char*>(result1.mv_data), result1.mv_size);
+  std::string buffer0, buffer1;
+  std::string_view pruned = blob_value(result0, buffer0), prunable = blob_value(result1, buffer1);
+  bd.reserve(pruned.size() + prunable.size());
+  bd.append(pruned);
+  bd.append(prunable);
 
   return true;
 }
@@ -3197,7 +3770,7 @@ bool BlockchainLMDB::get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobd
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
-  bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+  bd = blob_string(result);
 
   return true;
 }
@@ -3236,12 +3809,240 @@ bool BlockchainLMDB::get_pruned_tx_blobs_from(const crypto::hash& h, size_t coun
       return false;
     if (res)
       throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx blob", res).c_str()));
-    bd.emplace_back(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+    bd.push_back(blob_string(result));
   }
 
   return true;
 }
 
+// Looking a value up faults in the B-tree pages on the way to it, but a value bigger than a page
+// lives in overflow pages of which only the first has been read; has the kernel read the rest in
+// the background.
+static void will_need(const MDB_val& v)
+{
+#ifndef _WIN32
+  static const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  uintptr_t const begin = reinterpret_cast<uintptr_t>(v.mv_data) & ~(page_size - 1);
+  uintptr_t const end = reinterpret_cast<uintptr_t>(v.mv_data) + v.mv_size;
+  madvise(reinterpret_cast<void*>(begin), end - begin, MADV_WILLNEED);
+#endif
+}
+
+void BlockchainLMDB::prefetch_blocks(uint64_t start_height, size_t count) const
+{
+  prefetch_block_range(start_height, count);
+}
+
+size_t BlockchainLMDB::prefetch_block_range(uint64_t start_height, size_t count) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(blocks);
+  RCURSOR(tx_indices);
+  RCURSOR(txs_pruned);
+  RCURSOR(txs_prunable);
+
+  size_t bytes = 0;
+  MDB_val_copy<uint64_t> key(start_height);
+  MDB_val k = key, v;
+  MDB_cursor_op op = MDB_SET;
+  for (size_t i = 0; i < count; i++, op = MDB_NEXT)
+  {
+    int ret = mdb_cursor_get(m_cur_blocks, &k, &v, op);
+    if (ret == MDB_NOTFOUND)
+      break;
+    if (ret)
+      throw0(DB_ERROR(lmdb_error("Failed to enumerate blocks: ", ret).c_str()));
+    will_need(v);
+    bytes += v.mv_size;
+
+    std::string buffer;
+    block b;
+    if (!parse_and_validate_block_from_blob(blob_value(v, buffer), b))
+      throw0(DB_ERROR("Failed to parse block from blob retrieved from the db"));
+    if (b.tx_hashes.empty())
+      continue;
+
+    // A block's txs are stored under consecutive tx ids, so only the first needs an index lookup
+    MDB_val_set(idx, b.tx_hashes.front());
+    if (mdb_cursor_get(m_cur_tx_indices, (MDB_val *)&zerokval, &idx, MDB_GET_BOTH))
+      continue;
+    uint64_t const first_tx_id = ((const txindex *)idx.mv_data)->data.tx_id;
+    MDB_val_set(tx_id, first_tx_id);
+    for (MDB_cursor* cur : {m_cur_txs_pruned, m_cur_txs_prunable})
+    {
+      MDB_val tk = tx_id, tv;
+      MDB_cursor_op tx_op = MDB_SET;
+      for (size_t t = 0; t < b.tx_hashes.size(); t++, tx_op = MDB_NEXT)
+      {
+        if (mdb_cursor_get(cur, &tk, &tv, tx_op))
+          break;
+        will_need(tv);
+        bytes += tv.mv_size;
+      }
+    }
+  }
+  return bytes;
+}
+
+size_t BlockchainLMDB::prewarm_table(MDB_dbi dbi, prewarm_position& pos, size_t budget) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  unsigned int flags;
+  if (int ret = mdb_dbi_flags(m_txn, dbi, &flags))
+    throw0(DB_ERROR(lmdb_error("Failed to get table flags: ", ret).c_str()));
+  MDB_cursor *cur;
+  if (int ret = mdb_cursor_open(m_txn, dbi, &cur))
+    throw0(DB_ERROR(lmdb_error("Failed to open a cursor: ", ret).c_str()));
+  std::unique_ptr<MDB_cursor, void(*)(MDB_cursor*)> close_cur{cur, mdb_cursor_close};
+
+  // Carry on from the last record read by the previous call (in a txn since reset, so as not to
+  // hold on to a snapshot for the whole walk).  Tables such as block_info keep everything under a
+  // single key, so in DUPSORT tables that means the last value as well.
+  MDB_val k{pos.key.size(), pos.key.data()}, v{pos.value.size(), pos.value.data()};
+  int ret;
+  if (!pos.started)
+    ret = mdb_cursor_get(cur, &k, &v, MDB_FIRST);
+  else if (flags & MDB_DUPSORT)
+  {
+    ret = mdb_cursor_get(cur, &k, &v, MDB_GET_BOTH_RANGE);
+    if (ret == MDB_NOTFOUND)
+    {
+      // That key has no values left from there: go on to the next key
+      k = {pos.key.size(), pos.key.data()};
+      ret = mdb_cursor_get(cur, &k, &v, MDB_SET_RANGE);
+      if (ret == 0 && std::string_view{static_cast<const char*>(k.mv_data), k.mv_size} == pos.key)
+        ret = mdb_cursor_get(cur, &k, &v, MDB_NEXT_NODUP);
+    }
+  }
+  else
+    ret = mdb_cursor_get(cur, &k, &v, MDB_SET_RANGE);
+  auto is_last_read = [&] {
+    return std::string_view{static_cast<const char*>(k.mv_data), k.mv_size} == pos.key
+      && ((flags & MDB_DUPSORT) == 0 || std::string_view{static_cast<const char*>(v.mv_data), v.mv_size} == pos.value);
+  };
+  if (pos.started && ret == 0 && is_last_read())
+    ret = mdb_cursor_get(cur, &k, &v, MDB_NEXT);
+
+  size_t bytes = 0;
+  for (; ret == 0 && bytes < budget; ret = mdb_cursor_get(cur, &k, &v, MDB_NEXT))
+  {
+    will_need(v);
+    bytes += k.mv_size + v.mv_size;
+    pos.key.assign(static_cast<const char*>(k.mv_data), k.mv_size);
+    pos.value.assign(static_cast<const char*>(v.mv_data), v.mv_size);
+  }
+  if (ret == MDB_NOTFOUND)
+    pos.done = true;
+  else if (ret)
+    throw0(DB_ERROR(lmdb_error("Failed to enumerate table: ", ret).c_str()));
+  pos.started = true;
+  return bytes;
+}
+
+void BlockchainLMDB::start_prewarm(const std::vector<std::string>& tables, uint64_t recent_blocks, uint64_t bytes_per_second)
+{
+  static const std::pair<const char*, MDB_dbi BlockchainLMDB::*> TABLES[] = {
+    {LMDB_BLOCKS, &BlockchainLMDB::m_blocks},
+    {LMDB_BLOCK_HEIGHTS, &BlockchainLMDB::m_block_heights},
+    {LMDB_BLOCK_INFO, &BlockchainLMDB::m_block_info},
+    {LMDB_TXS_PRUNED, &BlockchainLMDB::m_txs_pruned},
+    {LMDB_TXS_PRUNABLE, &BlockchainLMDB::m_txs_prunable},
+    {LMDB_TXS_PRUNABLE_HASH, &BlockchainLMDB::m_txs_prunable_hash},
+    {LMDB_TX_INDICES, &BlockchainLMDB::m_tx_indices},
+    {LMDB_TX_OUTPUTS, &BlockchainLMDB::m_tx_outputs},
+    {LMDB_OUTPUT_TXS, &BlockchainLMDB::m_output_txs},
+    {LMDB_OUTPUT_AMOUNTS, &BlockchainLMDB::m_output_amounts},
+    {LMDB_SPENT_KEYS, &BlockchainLMDB::m_spent_keys},
+    {LMDB_SERVICE_NODE_DATA, &BlockchainLMDB::m_service_node_data},
+  };
+
+  check_open();
+  stop_prewarm();
+  std::vector<std::pair<std::string, MDB_dbi>> dbis;
+  for (auto& name : tables)
+  {
+    if (name.empty())
+      continue;
+    auto it = std::find_if(std::begin(TABLES), std::end(TABLES), [&](auto& t) { return name == t.first; });
+    if (it == std::end(TABLES))
+      MWARNING("Not prewarming unknown table " << name);
+    else
+      dbis.emplace_back(name, this->*(it->second));
+  }
+  if ((dbis.empty() && recent_blocks == 0) || bytes_per_second == 0)
+    return;
+
+  m_prewarm_stop = false;
+  m_prewarm_thread = std::thread{&BlockchainLMDB::prewarm, this, std::move(dbis), recent_blocks, bytes_per_second};
+}
+
+void BlockchainLMDB::prewarm(std::vector<std::pair<std::string, MDB_dbi>> tables, uint64_t recent_blocks, uint64_t bytes_per_second)
+{
+  // Each step reads about a tenth of a second's worth, then sleeps until the rate allows more
+  const size_t step = std::max<size_t>(bytes_per_second / 10, 64 * 1024);
+  const auto started = std::chrono::steady_clock::now();
+  uint64_t total = 0;
+  auto throttle = [&](size_t bytes) {
+    total += bytes;
+    auto until = started + std::chrono::microseconds{static_cast<uint64_t>(total * 1'000'000.0 / bytes_per_second)};
+    std::unique_lock lock{m_prewarm_mutex};
+    return !m_prewarm_cv.wait_until(lock, until, [this] { return m_prewarm_stop; });
+  };
+
+  try
+  {
+    bool go = true;
+    const uint64_t top = height();
+    uint64_t h = top > recent_blocks ? top - recent_blocks : 0;
+    MINFO("Prewarming the last " << top - h << " blocks and " << tables.size() << " tables at up to " << bytes_per_second << " bytes/s");
+    // A block and its txs are several kB, so a few at a time
+    constexpr size_t BLOCKS_PER_STEP = 16;
+    for (; go && h < top; h += BLOCKS_PER_STEP)
+      go = throttle(prefetch_block_range(h, std::min<uint64_t>(BLOCKS_PER_STEP, top - h)));
+
+    for (auto& [name, dbi] : tables)
+    {
+      prewarm_position pos;
+      uint64_t table_bytes = 0;
+      while (go && !pos.done)
+      {
+        size_t bytes = prewarm_table(dbi, pos, step);
+        table_bytes += bytes;
+        go = throttle(bytes);
+      }
+      if (!go)
+        break;
+      MDEBUG("Prewarmed table " << name << " (" << table_bytes << " bytes)");
+    }
+    if (go)
+      MINFO("Prewarming done: read " << total << " bytes in " << tools::friendly_duration(std::chrono::steady_clock::now() - started));
+  }
+  catch (const std::exception& e)
+  {
+    MWARNING("Prewarming stopped: " << e.what());
+  }
+  // This thread's read txn and cursors, which would otherwise outlive it
+  m_tinfo.reset();
+}
+
+void BlockchainLMDB::stop_prewarm()
+{
+  if (!m_prewarm_thread.joinable())
+    return;
+  {
+    std::lock_guard lock{m_prewarm_mutex};
+    m_prewarm_stop = true;
+  }
+  m_prewarm_cv.notify_all();
+  m_prewarm_thread.join();
+}
+
 bool BlockchainLMDB::get_prunable_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3265,7 +4066,7 @@ bool BlockchainLMDB::get_prunable_tx_blob(const crypto::hash& h, cryptonote::blo
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
-  bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+  bd = blob_string(result);
 
   return true;
 }
@@ -3434,7 +4235,7 @@ tx_out_index BlockchainLMDB::get_output_tx_and_index(const uint64_t& amount, con
   std::vector < uint64_t > offsets;
   std::vector<tx_out_index> indices;
   offsets.push_back(index);
-  get_output_tx_and_index(amount, offsets, indices);
+  get_output_tx_and_index(epee::span<const uint64_t>(&amount, 1), offsets, indices);
   if (!indices.size())
     throw1(OUTPUT_DNE("Attempting to get an output index by amount and amount index, but amount not found"));
 
@@ -3483,11 +4284,53 @@ std::vector<std::vector<uint64_t>> BlockchainLMDB::get_tx_amount_output_indices(
   return amount_output_indices_set;
 }
 
+std::vector<std::vector<std::vector<uint64_t>>> BlockchainLMDB::get_blocks_tx_amount_output_indices(uint64_t tx_id, const std::vector<size_t>& block_txes, bool miner_txes) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(tx_outputs);
+
+  // One scan along tx_outputs, whose keys are the tx IDs: copied straight into each block's list,
+  // with the miner txs' entries skipped over rather than copied and discarded.
+  std::vector<std::vector<std::vector<uint64_t>>> result;
+  result.reserve(block_txes.size());
+  uint64_t key = tx_id;
+  MDB_val_set(k_tx_id, key);
+  MDB_val v;
+  MDB_cursor_op op = MDB_SET;
+  for (size_t n : block_txes)
+  {
+    auto& block = result.emplace_back();
+    block.reserve(n + miner_txes);
+    for (size_t i = 0; i <= n; i++, tx_id++)
+    {
+      int ret = mdb_cursor_get(m_cur_tx_outputs, &k_tx_id, &v, op);
+      op = MDB_NEXT;
+      if (ret == MDB_NOTFOUND || (ret == 0 && *(const uint64_t*)k_tx_id.mv_data != tx_id))
+        throw1(TX_DNE(("tx output indices of tx id " + std::to_string(tx_id) + " not found in db").c_str()));
+      if (ret)
+        throw0(DB_ERROR(lmdb_error("DB error attempting to get data for tx_outputs[tx_index]", ret).c_str()));
+      if (i == 0 && !miner_txes)
+        continue;
+      const uint64_t* indices = (const uint64_t*)v.mv_data;
+      block.emplace_back(indices, indices + v.mv_size / sizeof(uint64_t));
+    }
+  }
+
+  return result;
+}
+
 bool BlockchainLMDB::has_key_image(const crypto::key_image& img) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
+  if (auto filter = std::atomic_load(&m_key_image_filter); filter && !filter->maybe_contains(img))
+    return false;
+
   bool ret;
 
   TXN_PREFIX_RDONLY();
@@ -3530,6 +4373,91 @@ bool BlockchainLMDB::for_all_key_images(std::function<bool(const crypto::key_ima
   return fret;
 }
 
+void BlockchainLMDB::rebuild_key_image_filter(size_t min_capacity)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  TIME_MEASURE_START(t);
+
+  size_t count;
+  {
+    TXN_PREFIX_RDONLY();
+    MDB_stat db_stats;
+    if (auto result = mdb_stat(m_txn, m_spent_keys, &db_stats))
+      throw0(DB_ERROR(lmdb_error("Failed to query m_spent_keys: ", result).c_str()));
+    count = db_stats.ms_entries;
+  }
+
+  auto filter = std::make_shared<key_image_filter>(std::max({min_capacity, 2 * count, MIN_KEY_IMAGE_FILTER_CAPACITY}));
+  for_all_key_images([&filter](const crypto::key_image& ki) { filter->insert(ki); return true; });
+  std::atomic_store(&m_key_image_filter, std::move(filter));
+
+  TIME_MEASURE_FINISH(t);
+  MINFO("Built spent key image filter of " << count << " key images in " << t << "ms");
+}
+
+void BlockchainLMDB::load_block_info_cache()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  TIME_MEASURE_START(t);
+
+  auto cache = std::make_unique<block_info_cache>();
+  {
+    TXN_PREFIX_RDONLY();
+    RCURSOR(block_info);
+
+    MDB_val k, v;
+    MDB_cursor_op op = MDB_FIRST;
+    int result;
+    while ((result = mdb_cursor_get(m_cur_block_info, &k, &v, op)) == 0)
+    {
+      op = MDB_NEXT;
+      const mdb_block_info *bi = static_cast<const mdb_block_info *>(v.mv_data);
+      cache->append({bi->bi_timestamp, bi->bi_weight, bi->bi_long_term_block_weight, bi->bi_diff, bi->bi_coins, bi->bi_cum_rct}, bi->bi_hash);
+    }
+    if (result != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error("Failed to enumerate block info: ", result).c_str()));
+  }
+  cache->commit();
+  uint64_t const count = cache->size(false);
+  m_block_info_cache = std::move(cache);
+
+  TIME_MEASURE_FINISH(t);
+  MINFO("Loaded block info cache of " << count << " blocks in " << t << "ms");
+}
+
+std::optional<uint64_t> BlockchainLMDB::cached_block_info(block_info_cache::field f, uint64_t height) const
+{
+  if (!m_block_info_cache)
+    return std::nullopt;
+  return m_block_info_cache->get(f, height, is_writer());
+}
+
+std::shared_ptr<const block> BlockchainLMDB::cached_block(uint64_t height) const
+{
+  if (!m_parsed_cache)
+    return nullptr;
+  check_open();
+  if (auto hash = m_block_info_cache->get_hash(height, is_writer()))
+    if (auto b = m_parsed_cache->find_block(*hash))
+      return b;
+
+  auto blob = get_block_blob_from_height(height);
+  auto b = std::make_shared<block>();
+  if (!parse_and_validate_block_from_blob(blob, *b))
+    throw DB_ERROR("Failed to parse block from blob retrieved from the db");
+  // Keyed by the hash of what was actually read, as the block at `height` may have changed since
+  // the lookup above
+  crypto::hash hash = get_block_hash(*b);
+  m_parsed_cache->add_block(hash, b, blob.size());
+  update_parsed_cache_size();
+  return b;
+}
+
+void BlockchainLMDB::update_parsed_cache_size() const
+{
+  m_parsed_cache_budget.set_size(m_parsed_cache->bytes());
+}
+
 bool BlockchainLMDB::for_blocks_range(const uint64_t& h1, const uint64_t& h2, std::function<bool(uint64_t, const crypto::hash&, const cryptonote::block&)> f) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -3560,8 +4488,8 @@ bool BlockchainLMDB::for_blocks_range(const uint64_t& h1, const uint64_t& h2, st
     if (ret)
       throw0(DB_ERROR("Failed to enumerate blocks"));
     uint64_t height = *(const uint64_t*)k.mv_data;
-    blobdata bd;
-    bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
+    blobdata buffer;
+    std::string_view bd = blob_value(v, buffer);
     block b;
     if (!parse_and_validate_block_from_blob(bd, b))
       throw0(DB_ERROR("Failed to parse block from blob retrieved from the db"));
@@ -3614,8 +4542,8 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
     if (ret)
       throw0(DB_ERROR(lmdb_error("Failed to enumerate transactions: ", ret).c_str()));
     transaction tx;
-    blobdata bd;
-    bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
+    blobdata bd = blob_string(v);
+    std::string buffer;
     if (pruned)
     {
       if (!parse_and_validate_tx_base_from_blob(bd, tx))
@@ -3626,7 +4554,7 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
       ret = mdb_cursor_get(m_cur_txs_prunable, &k, &v, MDB_SET);
       if (ret)
         throw0(DB_ERROR(lmdb_error("Failed to get prunable tx data the db: ", ret).c_str()));
-      bd.append(reinterpret_cast<char*>(v.mv_data), v.mv_size);
+      bd.append(blob_value(v, buffer));
       if (!parse_and_validate_tx_from_blob(bd, tx))
         throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
     }
@@ -3724,6 +4652,8 @@ bool BlockchainLMDB::batch_start(uint64_t batch_num_blocks, uint64_t batch_bytes
     throw0(DB_ERROR("batch transaction attempted, but m_write_txn already in use"));
   check_open();
 
+  maybe_train_tx_prefix_dictionary();
+
   m_writer = boost::this_thread::get_id();
   check_and_resize_for_batch(batch_num_blocks, batch_bytes);
 
@@ -3774,6 +4704,8 @@ void BlockchainLMDB::batch_commit()
   TIME_MEASURE_FINISH(time1);
   time_commit1 += time1;
   LOG_PRINT_L3("batch transaction: committed");
+  if (m_block_info_cache)
+    m_block_info_cache->commit();
 
   m_write_txn = nullptr;
   delete m_write_batch_txn;
@@ -3810,10 +4742,14 @@ void BlockchainLMDB::batch_stop()
     m_write_txn->commit();
     TIME_MEASURE_FINISH(time1);
     time_commit1 += time1;
+    if (m_block_info_cache)
+      m_block_info_cache->commit();
     cleanup_batch();
   }
   catch (const std::exception &e)
   {
+    if (m_block_info_cache)
+      m_block_info_cache->abort();
     cleanup_batch();
     throw;
   }
@@ -3839,6 +4775,8 @@ void BlockchainLMDB::batch_abort()
   delete m_write_batch_txn;
   m_write_batch_txn = nullptr;
   m_batch_active = false;
+  if (m_block_info_cache)
+    m_block_info_cache->abort();
   memset(&m_wcursors, 0, sizeof(m_wcursors));
   LOG_PRINT_L3("batch transaction: aborted");
 }
@@ -3920,6 +4858,12 @@ void BlockchainLMDB::block_wtxn_start()
     throw0(DB_ERROR_TXN_START((std::string("Attempted to start new write txn when write txn already exists in ")+__FUNCTION__).c_str()));
   if (! m_batch_active)
   {
+    maybe_train_tx_prefix_dictionary();
+    // Between write txns is the only time we can resize; do it ahead of need if the last stretch
+    // of blocks says we'll need it soon and nothing is reading.  Otherwise add_block() resizes
+    // (waiting for readers) once the map is nearly full.
+    if (need_resize(static_cast<uint64_t>(m_growth_per_block * GROWTH_SAMPLE_BLOCKS)))
+      do_resize(0, false /*wait_for_readers*/);
     m_writer = boost::this_thread::get_id();
     m_write_txn = new mdb_txn_safe();
     if (auto mdb_res = lmdb_txn_begin(m_env, NULL, 0, *m_write_txn))
@@ -3950,9 +4894,20 @@ void BlockchainLMDB::block_wtxn_stop()
     if (! m_batch_active)
 	{
       TIME_MEASURE_START(time1);
-      m_write_txn->commit();
+      try
+      {
+        m_write_txn->commit();
+      }
+      catch (...)
+      {
+        if (m_block_info_cache)
+          m_block_info_cache->abort();
+        throw;
+      }
       TIME_MEASURE_FINISH(time1);
       time_commit1 += time1;
+      if (m_block_info_cache)
+        m_block_info_cache->commit();
 
       delete m_write_txn;
       m_write_txn = nullptr;
@@ -3974,6 +4929,8 @@ void BlockchainLMDB::block_wtxn_abort()
     delete m_write_txn;
     m_write_txn = nullptr;
     memset(&m_wcursors, 0, sizeof(m_wcursors));
+    if (m_block_info_cache)
+      m_block_info_cache->abort();
   }
 }
 
@@ -3993,6 +4950,8 @@ uint64_t BlockchainLMDB::add_block(const std::pair<block, blobdata>& blk, size_t
 
   if (m_height % 1024 == 0)
   {
+    if (! m_batch_active)
+      update_growth_estimate();
     // for batch mode, DB resize check is done at start of batch transaction
     if (! m_batch_active && need_resize())
     {
@@ -4156,88 +5115,53 @@ bool BlockchainLMDB::get_top_checkpoint(checkpoint_t &checkpoint) const
 
 std::vector<checkpoint_t> BlockchainLMDB::get_checkpoints_range(uint64_t start, uint64_t end, size_t num_desired_checkpoints) const
 {
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   std::vector<checkpoint_t> result;
-  checkpoint_t top_checkpoint    = {};
-  checkpoint_t bottom_checkpoint = {};
-  if (!get_top_checkpoint(top_checkpoint)) return result;
-  if (!get_block_checkpoint_internal(0, bottom_checkpoint, MDB_FIRST)) return result;
-
-  start = std::clamp(start, bottom_checkpoint.height, top_checkpoint.height);
-  end   = std::clamp(end, bottom_checkpoint.height, top_checkpoint.height);
-  if (start > end)
-  {
-    if (start < bottom_checkpoint.height) return result;
-  }
-  else
-  {
-    if (start > top_checkpoint.height) return result;
-  }
-
   if (num_desired_checkpoints == BlockchainDB::GET_ALL_CHECKPOINTS)
     num_desired_checkpoints = std::numeric_limits<decltype(num_desired_checkpoints)>::max();
   else
     result.reserve(num_desired_checkpoints);
 
-  // NOTE: Get the first checkpoint and then use LMDB's cursor as an iterator to
-  // find subsequent checkpoints so we don't waste time querying every-single-height
-  checkpoint_t first_checkpoint = {};
-  bool found_a_checkpoint       = false;
-  for (uint64_t height = start;
-       height != end && result.size() < num_desired_checkpoints;
-       )
-  {
-    if (get_block_checkpoint(height, first_checkpoint))
-    {
-      result.push_back(first_checkpoint);
-      found_a_checkpoint = true;
-      break;
-    }
+  check_open();
+  TXN_PREFIX_RDONLY();
+  RCURSOR(block_checkpoints);
 
-    if (end >= start) height++;
-    else height--;
-  }
+  // NOTE: Seek straight to the checkpoint nearest `start` in the direction of `end` and walk the
+  // cursor from there, all in the one read txn, rather than looking up every height in between.
+  bool const ascending = end >= start;
+  uint64_t const min   = std::min(start, end);
+  uint64_t const max   = std::max(start, end);
 
-  // Get inclusive of end if we couldn't find a checkpoint in all the other heights leading up to the end height
-  if (!found_a_checkpoint && result.size() < num_desired_checkpoints && get_block_checkpoint(end, first_checkpoint))
+  auto key_height = [](MDB_val const &key) {
+    uint64_t height;
+    std::memcpy(&height, key.mv_data, sizeof(height));
+    return height;
+  };
+
+  MDB_val_set(key, start);
+  MDB_val value = {};
+  int ret       = mdb_cursor_get(m_cursors->block_checkpoints, &key, &value, MDB_SET_RANGE);
+  if (!ascending)
   {
-    result.push_back(first_checkpoint);
-    found_a_checkpoint = true;
+    if (ret == MDB_NOTFOUND)
+      ret = mdb_cursor_get(m_cursors->block_checkpoints, &key, &value, MDB_LAST);
+    else if (ret == MDB_SUCCESS && key_height(key) > start)
+      ret = mdb_cursor_get(m_cursors->block_checkpoints, &key, &value, MDB_PREV);
   }
 
-  if (found_a_checkpoint && result.size() < num_desired_checkpoints)
+  MDB_cursor_op const op = ascending ? MDB_NEXT : MDB_PREV;
+  for (; ret == MDB_SUCCESS && result.size() < num_desired_checkpoints;
+       ret = mdb_cursor_get(m_cursors->block_checkpoints, &key, &value, op))
   {
-    check_open();
-    TXN_PREFIX_RDONLY();
-    RCURSOR(block_checkpoints);
-
-    MDB_val_set(key, first_checkpoint.height);
-    int ret = mdb_cursor_get(m_cursors->block_checkpoints, &key, nullptr, MDB_SET_KEY);
-    if (ret != MDB_SUCCESS)
-      throw0(DB_ERROR(lmdb_error("Unexpected failure to get checkpoint we just queried: ", ret).c_str()));
-
-    uint64_t min = start;
-    uint64_t max = end;
-    if (min > max) std::swap(min, max);
-    MDB_cursor_op const op = (end >= start) ? MDB_NEXT : MDB_PREV;
-
-    for (; result.size() < num_desired_checkpoints;)
-    {
-      MDB_val value = {};
-      ret           = mdb_cursor_get(m_cursors->block_checkpoints, nullptr, &value, op);
-
-      if (ret == MDB_NOTFOUND) break;
-      if (ret != MDB_SUCCESS)
-        throw0(DB_ERROR(lmdb_error("Failed to query block checkpoint range: ", ret).c_str()));
-
-      auto const *header = static_cast<blk_checkpoint_header const *>(value.mv_data);
-      if (header->height >= min && header->height <= max)
-      {
-        checkpoint_t checkpoint = convert_mdb_val_to_checkpoint(value);
-        result.push_back(checkpoint);
-      }
-    }
+    uint64_t height = key_height(key);
+    if (height < min || height > max)
+      break;
+    result.push_back(convert_mdb_val_to_checkpoint(value));
   }
 
+  if (ret != MDB_SUCCESS && ret != MDB_NOTFOUND)
+    throw0(DB_ERROR(lmdb_error("Failed to query block checkpoint range: ", ret).c_str()));
+
   return result;
 }
 
@@ -4260,30 +5184,87 @@ void BlockchainLMDB::pop_block(block& blk, std::vector<transaction>& txs)
   }
 }
 
+namespace {
+
+// Looks up (key, index) pairs in a dupsort table whose duplicates start with a sorted uint64_t
+// index (output_amounts, output_txs).  Rather than searching from the root for each pair in
+// request order, the pairs are visited in sorted order with one cursor: consecutive lookups then
+// hit the same pages, and a short hop forward (common for ring members, since indices are dense)
+// is made by stepping through the duplicates.  Calls `found(i, v)` for each requests[i] that
+// exists and returns the (ascending) positions of those that don't.
+template <typename Found>
+std::vector<size_t> sorted_dup_lookup(MDB_cursor* cur, const std::vector<std::pair<uint64_t, uint64_t>>& requests, Found&& found)
+{
+  constexpr uint64_t MAX_STEPS = 16;
+
+  std::vector<size_t> order(requests.size());
+  std::iota(order.begin(), order.end(), size_t{0});
+  std::sort(order.begin(), order.end(), [&requests](size_t a, size_t b) { return requests[a] < requests[b]; });
+
+  std::vector<size_t> missing;
+  bool positioned = false; // whether the cursor (and `v`) is on the duplicate `at` of `key`
+  uint64_t key = 0, at = 0;
+  MDB_val k, v;
+  for (size_t i : order)
+  {
+    uint64_t want_key = requests[i].first, want = requests[i].second;
+    int result;
+    if (positioned && want_key == key && want >= at && want - at <= MAX_STEPS)
+    {
+      result = 0;
+      while (at < want && (result = mdb_cursor_get(cur, &k, &v, MDB_NEXT_DUP)) == 0)
+        memcpy(&at, v.mv_data, sizeof(at));
+      if (result == 0 && at != want)
+        result = MDB_NOTFOUND; // stepped over where it would be
+      else if (result)
+        positioned = false;
+    }
+    else
+    {
+      k = MDB_val{sizeof(want_key), &want_key};
+      v = MDB_val{sizeof(want), &want};
+      result = mdb_cursor_get(cur, &k, &v, MDB_GET_BOTH);
+      positioned = result == 0;
+      key = want_key;
+      at = want;
+    }
+
+    if (result == MDB_NOTFOUND)
+      missing.push_back(i);
+    else if (result)
+      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve outputs from the db: ", result).c_str()));
+    else
+      found(i, v);
+  }
+
+  std::sort(missing.begin(), missing.end());
+  return missing;
+}
+
+}
+
 void BlockchainLMDB::get_output_tx_and_index_from_global(const std::vector<uint64_t> &global_indices,
     std::vector<tx_out_index> &tx_out_indices) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
   tx_out_indices.clear();
-  tx_out_indices.reserve(global_indices.size());
+  tx_out_indices.resize(global_indices.size());
 
   TXN_PREFIX_RDONLY();
   RCURSOR(output_txs);
 
+  std::vector<std::pair<uint64_t, uint64_t>> requests;
+  requests.reserve(global_indices.size());
   for (const uint64_t &output_id : global_indices)
-  {
-    MDB_val_set(v, output_id);
-
-    auto get_result = mdb_cursor_get(m_cur_output_txs, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
-    if (get_result == MDB_NOTFOUND)
-      throw1(OUTPUT_DNE("output with given index not in db"));
-    else if (get_result)
-      throw0(DB_ERROR("DB error attempting to fetch output tx hash"));
+    requests.emplace_back(0, output_id); // output_txs is keyed by zerokval
 
+  auto missing = sorted_dup_lookup(m_cur_output_txs, requests, [&tx_out_indices](size_t i, const MDB_val& v) {
     const outtx *ot = (const outtx *)v.mv_data;
-    tx_out_indices.push_back(tx_out_index(ot->tx_hash, ot->local_index));
-  }
+    tx_out_indices[i] = tx_out_index(ot->tx_hash, ot->local_index);
+  });
+  if (!missing.empty())
+    throw1(OUTPUT_DNE(("output with given index (" + std::to_string(global_indices[missing.front()]) + ") not in db").c_str()));
 }
 
 void BlockchainLMDB::get_output_key(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial) const
@@ -4295,76 +5276,77 @@ void BlockchainLMDB::get_output_key(const epee::span<const uint64_t> &amounts, c
   TIME_MEASURE_START(db3);
   check_open();
   outputs.clear();
-  outputs.reserve(offsets.size());
+  outputs.resize(offsets.size());
 
   TXN_PREFIX_RDONLY();
 
   RCURSOR(output_amounts);
 
+  std::vector<std::pair<uint64_t, uint64_t>> requests;
+  requests.reserve(offsets.size());
   for (size_t i = 0; i < offsets.size(); ++i)
-  {
-    const uint64_t amount = amounts.size() == 1 ? amounts[0] : amounts[i];
-    MDB_val_set(k, amount);
-    MDB_val_set(v, offsets[i]);
-
-    auto get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
-    if (get_result == MDB_NOTFOUND)
-    {
-      if (allow_partial)
-      {
-        MDEBUG("Partial result: " << outputs.size() << "/" << offsets.size());
-        break;
-      }
-      throw1(OUTPUT_DNE((std::string("Attempting to get output pubkey by global index (amount ") + std::to_string(amount) + ", index " + std::to_string(offsets[i]) + ", count " + std::to_string(get_num_outputs(amount)) + "), but key does not exist (current height " + std::to_string(height()) + ")").c_str()));
-    }
-    else if (get_result)
-      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve an output pubkey from the db", get_result).c_str()));
+    requests.emplace_back(amounts.size() == 1 ? amounts[0] : amounts[i], offsets[i]);
 
+  auto missing = sorted_dup_lookup(m_cur_output_amounts, requests, [&](size_t i, const MDB_val& v) {
+    const uint64_t amount = requests[i].first;
     if (amount == 0)
     {
       const outkey *okp = (const outkey *)v.mv_data;
-      outputs.push_back(okp->data);
+      outputs[i] = okp->data;
     }
     else
     {
       const pre_rct_outkey *okp = (const pre_rct_outkey *)v.mv_data;
-      outputs.resize(outputs.size() + 1);
-      output_data_t &data = outputs.back();
+      output_data_t &data = outputs[i];
       memcpy(&data, &okp->data, sizeof(pre_rct_output_data_t));
       data.commitment = rct::zeroCommit(amount);
     }
+  });
+
+  if (!missing.empty())
+  {
+    // As if we had looked them up in order: everything up to the first missing output
+    if (allow_partial)
+    {
+      outputs.resize(missing.front());
+      MDEBUG("Partial result: " << outputs.size() << "/" << offsets.size());
+    }
+    else
+    {
+      const auto [amount, index] = requests[missing.front()];
+      throw1(OUTPUT_DNE((std::string("Attempting to get output pubkey by global index (amount ") + std::to_string(amount) + ", index " + std::to_string(index) + ", count " + std::to_string(get_num_outputs(amount)) + "), but key does not exist (current height " + std::to_string(height()) + ")").c_str()));
+    }
   }
 
   TIME_MEASURE_FINISH(db3);
   LOG_PRINT_L3("db3: " << db3);
 }
 
-void BlockchainLMDB::get_output_tx_and_index(const uint64_t& amount, const std::vector<uint64_t> &offsets, std::vector<tx_out_index> &indices) const
+void BlockchainLMDB::get_output_tx_and_index(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<tx_out_index> &indices) const
 {
+  if (amounts.size() != 1 && amounts.size() != offsets.size())
+    throw0(DB_ERROR("Invalid sizes of amounts and offets"));
+
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
   indices.clear();
 
-  std::vector <uint64_t> tx_indices;
-  tx_indices.reserve(offsets.size());
+  std::vector<uint64_t> tx_indices(offsets.size());
   TXN_PREFIX_RDONLY();
 
   RCURSOR(output_amounts);
 
-  MDB_val_set(k, amount);
-  for (const uint64_t &index : offsets)
-  {
-    MDB_val_set(v, index);
-
-    auto get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
-    if (get_result == MDB_NOTFOUND)
-      throw1(OUTPUT_DNE("Attempting to get output by index, but key does not exist"));
-    else if (get_result)
-      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve an output from the db", get_result).c_str()));
+  std::vector<std::pair<uint64_t, uint64_t>> requests;
+  requests.reserve(offsets.size());
+  for (size_t i = 0; i < offsets.size(); ++i)
+    requests.emplace_back(amounts.size() == 1 ? amounts[0] : amounts[i], offsets[i]);
 
+  auto missing = sorted_dup_lookup(m_cur_output_amounts, requests, [&tx_indices](size_t i, const MDB_val& v) {
     const outkey *okp = (const outkey *)v.mv_data;
-    tx_indices.push_back(okp->output_id);
-  }
+    tx_indices[i] = okp->output_id;
+  });
+  if (!missing.empty())
+    throw1(OUTPUT_DNE("Attempting to get output by index, but key does not exist"));
 
   TIME_MEASURE_START(db3);
   if(tx_indices.size() > 0)
@@ -4375,6 +5357,43 @@ void BlockchainLMDB::get_output_tx_and_index(const uint64_t& amount, const std::
   LOG_PRINT_L3("db3: " << db3);
 }
 
+void BlockchainLMDB::get_rct_histogram_counts(uint64_t blockchain_height, uint64_t num_outputs, uint64_t recent_cutoff, uint64_t& unlocked, uint64_t& recent) const
+{
+  unlocked = recent = 0;
+  if (blockchain_height < CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE)
+    return;
+  const uint64_t top = blockchain_height - CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE;
+  unlocked = std::min(num_outputs, get_block_cumulative_rct_outputs({top})[0]);
+  if (recent_cutoff == 0)
+    return;
+
+  // The recent outputs are those above the first block, going down from `top`, that has outputs
+  // and is older than the cutoff.  Checked a chunk of heights at a time.
+  constexpr uint64_t CHUNK = 1024;
+  for (uint64_t end = top + 1; end > 0;)
+  {
+    const uint64_t start = end > CHUNK ? end - CHUNK : 0;
+    // (plus the height below, to tell whether the lowest block has outputs of its own)
+    const uint64_t from = start > 0 ? start - 1 : 0;
+    const auto timestamps = get_block_timestamps(start, end - start);
+    const auto cum_rct = get_block_info_64bit_fields(from, end - from, block_info_cache::cumulative_rct_outs,
+        [](const mdb_block_info* bi) { return bi->bi_cum_rct; });
+    if (timestamps.size() != end - start || cum_rct.size() != end - from)
+      throw0(DB_ERROR("Failed to get block info for the output histogram"));
+    for (uint64_t h = end; h-- > start;)
+    {
+      const uint64_t below = h > 0 ? cum_rct[h - 1 - from] : 0;
+      if (cum_rct[h - from] > below && timestamps[h - start] < recent_cutoff)
+      {
+        recent = unlocked - std::min(unlocked, cum_rct[h - from]);
+        return;
+      }
+    }
+    end = start;
+  }
+  recent = unlocked;
+}
+
 std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> BlockchainLMDB::get_output_histogram(const std::vector<uint64_t> &amounts, bool unlocked, uint64_t recent_cutoff, uint64_t min_count) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -4435,6 +5454,11 @@ std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>> BlockchainLMDB::get
     for (std::map<uint64_t, std::tuple<uint64_t, uint64_t, uint64_t>>::iterator i = histogram.begin(); i != histogram.end(); ++i) {
       uint64_t amount = i->first;
       uint64_t num_elems = std::get<0>(i->second);
+      if (amount == 0)
+      {
+        get_rct_histogram_counts(blockchain_height, num_elems, recent_cutoff, std::get<1>(i->second), std::get<2>(i->second));
+        continue;
+      }
       while (num_elems > 0) {
         const tx_out_index toi = get_output_tx_and_index(amount, num_elems - 1);
         const uint64_t height = get_tx_block_height(toi.first);
@@ -5698,7 +6722,7 @@ void BlockchainLMDB::migrate_3_4()
             continue;
 
           crypto::secret_key secret_tx_key;
-          if (!cryptonote::get_tx_secret_key_from_tx_extra(tx.extra, secret_tx_key))
+          if (!cryptonote::get_tx_secret_key_from_tx_extra(tx, secret_tx_key))
             continue;
 
           std::vector<std::vector<uint64_t>> outputs = get_tx_amount_output_indices(tx_index->data.tx_id, 1);
@@ -6134,23 +7158,6 @@ void BlockchainLMDB::migrate(const uint32_t oldversion, cryptonote::network_type
 
 uint64_t constexpr SERVICE_NODE_BLOB_SHORT_TERM_KEY = 1;
 uint64_t constexpr SERVICE_NODE_BLOB_LONG_TERM_KEY  = 2;
-void BlockchainLMDB::set_service_node_data(const std::string& data, bool long_term)
-{
-  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
-  check_open();
-
-  mdb_txn_cursors *m_cursors = &m_wcursors;
-  CURSOR(service_node_data);
-
-  const uint64_t key = (long_term) ? SERVICE_NODE_BLOB_LONG_TERM_KEY : SERVICE_NODE_BLOB_SHORT_TERM_KEY;
-  MDB_val_set(k, key);
-  MDB_val_sized(blob, data);
-  int result;
-  result = mdb_cursor_put(m_cursors->service_node_data, &k, &blob, 0);
-  if (result)
-    throw0(DB_ERROR(lmdb_error("Failed to add service node data to db transaction: ", result).c_str()));
-}
-
 bool BlockchainLMDB::get_service_node_data(std::string& data, bool long_term) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -6189,20 +7196,87 @@ void BlockchainLMDB::clear_service_node_data()
   mdb_txn_cursors *m_cursors = &m_wcursors;
   CURSOR(service_node_data);
 
-  uint64_t constexpr BLOB_KEYS[] = {
-      SERVICE_NODE_BLOB_SHORT_TERM_KEY,
-      SERVICE_NODE_BLOB_LONG_TERM_KEY,
-  };
-
-  for (uint64_t const key : BLOB_KEYS)
+  MDB_val k, v;
+  int result;
+  while ((result = mdb_cursor_get(m_cursors->service_node_data, &k, &v, MDB_FIRST)) == MDB_SUCCESS)
   {
-    MDB_val_set(k, key);
-    int result;
-    if ((result = mdb_cursor_get(m_cursors->service_node_data, &k, NULL, MDB_SET)))
-        return;
     if ((result = mdb_cursor_del(m_cursors->service_node_data, 0)))
       throw1(DB_ERROR(lmdb_error("Failed to add removal of service node data to db transaction: ", result).c_str()));
   }
+  if (result != MDB_NOTFOUND)
+    throw1(DB_ERROR(lmdb_error("Failed to enumerate service node data: ", result).c_str()));
+}
+
+// Service node records share the service node data table with the legacy blobs: the record type
+// goes in the top byte of the key (the blob keys have it 0) and the height in the rest, so that
+// records of one type are contiguous and in height order.
+static uint64_t service_node_record_key(uint8_t type, uint64_t height)
+{
+  assert(type != 0 && height < (uint64_t{1} << 56));
+  return (uint64_t{type} << 56) | height;
+}
+
+void BlockchainLMDB::set_service_node_record(uint8_t type, uint64_t height, std::string_view data)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  mdb_txn_cursors *m_cursors = &m_wcursors;
+  CURSOR(service_node_data);
+
+  const uint64_t key = service_node_record_key(type, height);
+  MDB_val_set(k, key);
+  MDB_val blob{data.size(), const_cast<char*>(data.data())};
+  int result = mdb_cursor_put(m_cursors->service_node_data, &k, &blob, 0);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to add service node record to db transaction: ", result).c_str()));
+}
+
+void BlockchainLMDB::remove_service_node_record(uint8_t type, uint64_t height)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  mdb_txn_cursors *m_cursors = &m_wcursors;
+  CURSOR(service_node_data);
+
+  const uint64_t key = service_node_record_key(type, height);
+  MDB_val_set(k, key);
+  int result = mdb_cursor_get(m_cursors->service_node_data, &k, NULL, MDB_SET);
+  if (result == MDB_NOTFOUND)
+    return;
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to lookup service node record: ", result).c_str()));
+  if ((result = mdb_cursor_del(m_cursors->service_node_data, 0)))
+    throw1(DB_ERROR(lmdb_error("Failed to add removal of service node record to db transaction: ", result).c_str()));
+}
+
+void BlockchainLMDB::for_each_service_node_record(uint8_t type, std::function<bool(uint64_t height, std::string_view data)> f) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(service_node_data);
+
+  const uint64_t first_key = service_node_record_key(type, 0);
+  MDB_val_set(k, first_key);
+  MDB_val v;
+  for (MDB_cursor_op op = MDB_SET_RANGE;; op = MDB_NEXT)
+  {
+    int result = mdb_cursor_get(m_cursors->service_node_data, &k, &v, op);
+    if (result == MDB_NOTFOUND)
+      break;
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to enumerate service node records: ", result).c_str()));
+
+    uint64_t key;
+    std::memcpy(&key, k.mv_data, sizeof(key));
+    if ((key >> 56) != type)
+      break;
+    if (!f(key & ((uint64_t{1} << 56) - 1), std::string_view{reinterpret_cast<const char*>(v.mv_data), v.mv_size}))
+      break;
+  }
 }
 
 template <typename C>
@@ -6291,17 +7365,130 @@ struct service_node_proof_serialized : service_node_proof_serialized_old {
 
 static_assert(sizeof(service_node_proof_serialized) == 72, "service node serialization struct has unexpected size and/or padding");
 
+namespace {
+
+// Transactions on the proofs environment: plain LMDB transactions (the main environment's
+// mdb_txn_safe bookkeeping is for its map resizing, which the proofs environment never does).
+using proofs_txn = std::unique_ptr<MDB_txn, decltype(&mdb_txn_abort)>;
+
+proofs_txn begin_proofs_txn(MDB_env* env, unsigned int flags)
+{
+  MDB_txn* txn;
+  if (auto result = mdb_txn_begin(env, nullptr, flags, &txn))
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the proofs db: ", result)));
+  return {txn, mdb_txn_abort};
+}
+
+void commit_proofs_txn(proofs_txn& txn)
+{
+  int result = mdb_txn_commit(txn.release());
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to commit a transaction to the proofs db: ", result)));
+}
+
+void put_proof(MDB_txn* txn, MDB_dbi dbi, const crypto::public_key& pubkey, const service_nodes::proof_info& proof)
+{
+  service_node_proof_serialized data{proof};
+  MDB_val k{sizeof(pubkey), (void*) &pubkey},
+          v{sizeof(data), &data};
+  if (auto result = mdb_put(txn, dbi, &k, &v, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to add service node latest proof data to db transaction: ", result)));
+}
+
+bool del_proof(MDB_txn* txn, MDB_dbi dbi, const crypto::public_key& pubkey)
+{
+  MDB_val k{sizeof(pubkey), (void*) &pubkey};
+  auto result = mdb_del(txn, dbi, &k, nullptr);
+  if (result == MDB_NOTFOUND)
+    return false;
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Error remove service node proof", result)));
+  return true;
+}
+
+}
+
+void BlockchainLMDB::open_proofs_env()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  const bool read_only = is_read_only();
+  const auto path = m_folder / SERVICE_NODE_PROOFS_FILENAME;
+  if (read_only && !fs::exists(path))
+    return;
+
+  if (auto result = mdb_env_create(&m_proofs_env))
+    throw0(DB_ERROR(lmdb_error("Failed to create lmdb environment for proofs: ", result)));
+  // A few thousand 72-byte records that are overwritten in place: this never comes close to full.
+  mdb_env_set_mapsize(m_proofs_env, 64 * 1024 * 1024);
+  // Losing the last few seconds of proofs in a crash is harmless (they are rebroadcast every few
+  // minutes), so don't fsync each one; close() syncs.
+  unsigned int flags = MDB_NOSUBDIR | MDB_NOTLS | (read_only ? MDB_RDONLY : MDB_NOSYNC);
+  if (auto result = mdb_env_open(m_proofs_env, path.string().c_str(), flags, 0644))
+  {
+    mdb_env_close(m_proofs_env);
+    m_proofs_env = nullptr;
+    throw0(DB_ERROR(lmdb_error("Failed to open lmdb environment for proofs: ", result)));
+  }
+
+  auto txn = begin_proofs_txn(m_proofs_env, read_only ? MDB_RDONLY : 0);
+  if (auto result = mdb_dbi_open(txn.get(), nullptr, read_only ? 0 : MDB_CREATE, &m_proofs))
+    throw0(DB_ERROR(lmdb_error("Failed to open db handle for proofs: ", result)));
+  mdb_set_compare(txn.get(), m_proofs, compare_hash32);
+  if (read_only)
+    return;
+
+  // Proofs used to be stored in the main environment; move any that are still there.
+  mdb_txn_safe main_txn;
+  if (auto result = mdb_txn_begin(m_env, NULL, 0, main_txn))
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result)));
+  MDB_stat st;
+  if (auto result = mdb_stat(main_txn, m_service_node_proofs, &st))
+    throw0(DB_ERROR(lmdb_error("Failed to query m_service_node_proofs: ", result)));
+  if (st.ms_entries > 0)
+  {
+    MDB_cursor* cursor;
+    if (auto result = mdb_cursor_open(main_txn, m_service_node_proofs, &cursor))
+      throw0(DB_ERROR(lmdb_error("Failed to open cursor: ", result)));
+    for (const auto &pair : iterable_db<crypto::public_key, service_node_proof_serialized, service_node_proof_serialized_old>(cursor))
+    {
+      service_nodes::proof_info proof;
+      if (std::holds_alternative<service_node_proof_serialized*>(pair.second))
+        var::get<service_node_proof_serialized*>(pair.second)->update(proof);
+      else
+        var::get<service_node_proof_serialized_old*>(pair.second)->update(proof);
+      put_proof(txn.get(), m_proofs, *pair.first, proof);
+    }
+    mdb_cursor_close(cursor);
+    if (auto result = mdb_drop(main_txn, m_service_node_proofs, 0))
+      throw0(DB_ERROR(lmdb_error("Failed to empty m_service_node_proofs: ", result)));
+    MGINFO("Moved " << st.ms_entries << " stored uptime proofs to " << path.u8string());
+  }
+  commit_proofs_txn(txn);
+  mdb_env_sync(m_proofs_env, 1);
+  main_txn.commit();
+}
+
+void BlockchainLMDB::close_proofs_env()
+{
+  if (!m_proofs_env)
+    return;
+  if (!is_read_only())
+    mdb_env_sync(m_proofs_env, 1);
+  mdb_env_close(m_proofs_env);
+  m_proofs_env = nullptr;
+}
+
 bool BlockchainLMDB::get_service_node_proof(const crypto::public_key &pubkey, service_nodes::proof_info &proof) const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
+  if (!m_proofs_env)
+    return false;
 
-  TXN_PREFIX_RDONLY();
-
-  RCURSOR(service_node_proofs);
+  auto txn = begin_proofs_txn(m_proofs_env, MDB_RDONLY);
   MDB_val v, k{sizeof(pubkey), (void*) &pubkey};
 
-  int result = mdb_cursor_get(m_cursors->service_node_proofs, &k, &v, MDB_SET_KEY);
+  int result = mdb_get(txn.get(), m_proofs, &k, &v);
   if (result == MDB_NOTFOUND)
     return false;
   else if (result != MDB_SUCCESS)
@@ -6319,17 +7506,27 @@ void BlockchainLMDB::set_service_node_proof(const crypto::public_key &pubkey, co
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
+  if (!m_proofs_env)
+    throw0(DB_ERROR("Cannot store service node proofs in a read-only database"));
 
-  service_node_proof_serialized data{proof};
+  auto txn = begin_proofs_txn(m_proofs_env, 0);
+  put_proof(txn.get(), m_proofs, pubkey, proof);
+  commit_proofs_txn(txn);
+}
 
-  TXN_BLOCK_PREFIX(0);
-  MDB_val k{sizeof(pubkey), (void*) &pubkey},
-          v{sizeof(data), &data};
-  int result = mdb_put(*txn_ptr, m_service_node_proofs, &k, &v, 0);
-  if (result)
-    throw0(DB_ERROR(lmdb_error("Failed to add service node latest proof data to db transaction: ", result)));
+void BlockchainLMDB::set_service_node_proofs(const std::vector<std::pair<crypto::public_key, service_nodes::proof_info>>& proofs)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  if (proofs.empty())
+    return;
+  if (!m_proofs_env)
+    throw0(DB_ERROR("Cannot store service node proofs in a read-only database"));
 
-  TXN_BLOCK_POSTFIX_SUCCESS();
+  auto txn = begin_proofs_txn(m_proofs_env, 0);
+  for (const auto& [pubkey, proof] : proofs)
+    put_proof(txn.get(), m_proofs, pubkey, proof);
+  commit_proofs_txn(txn);
 }
 
 std::unordered_map<crypto::public_key, service_nodes::proof_info> BlockchainLMDB::get_all_service_node_proofs() const
@@ -6337,17 +7534,21 @@ std::unordered_map<crypto::public_key, service_nodes::proof_info> BlockchainLMDB
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
 
-  TXN_PREFIX_RDONLY();
-  RCURSOR(service_node_proofs);
-
   std::unordered_map<crypto::public_key, service_nodes::proof_info> result;
-  for (const auto &pair : iterable_db<crypto::public_key, service_node_proof_serialized, service_node_proof_serialized_old>(
-        m_cursors->service_node_proofs)) {
+  if (!m_proofs_env)
+    return result;
+
+  auto txn = begin_proofs_txn(m_proofs_env, MDB_RDONLY);
+  MDB_cursor* cursor;
+  if (auto ret = mdb_cursor_open(txn.get(), m_proofs, &cursor))
+    throw0(DB_ERROR(lmdb_error("Failed to open cursor: ", ret)));
+  for (const auto &pair : iterable_db<crypto::public_key, service_node_proof_serialized, service_node_proof_serialized_old>(cursor)) {
     if (std::holds_alternative<service_node_proof_serialized*>(pair.second))
       result.emplace(*pair.first, *var::get<service_node_proof_serialized*>(pair.second));
     else
       result.emplace(*pair.first, service_node_proof_serialized{*var::get<service_node_proof_serialized_old*>(pair.second)});
   }
+  mdb_cursor_close(cursor);
 
   return result;
 }
@@ -6356,19 +7557,27 @@ bool BlockchainLMDB::remove_service_node_proof(const crypto::public_key& pubkey)
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   check_open();
-  mdb_txn_cursors *m_cursors = &m_wcursors;
-  CURSOR(service_node_proofs)
-
-  MDB_val k{sizeof(pubkey), (void*) &pubkey};
-  auto result = mdb_cursor_get(m_cursors->service_node_proofs, &k, NULL, MDB_SET);
-  if (result == MDB_NOTFOUND)
+  if (!m_proofs_env)
     return false;
-  if (result != MDB_SUCCESS)
-    throw0(DB_ERROR(lmdb_error("Error finding service node proof to remove", result)));
-  result = mdb_cursor_del(m_cursors->service_node_proofs, 0);
-  if (result)
-    throw0(DB_ERROR(lmdb_error("Error remove service node proof", result)));
-  return true;
+
+  auto txn = begin_proofs_txn(m_proofs_env, 0);
+  bool removed = del_proof(txn.get(), m_proofs, pubkey);
+  if (removed)
+    commit_proofs_txn(txn);
+  return removed;
+}
+
+void BlockchainLMDB::remove_service_node_proofs(const std::vector<crypto::public_key>& pubkeys)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  if (pubkeys.empty() || !m_proofs_env)
+    return;
+
+  auto txn = begin_proofs_txn(m_proofs_env, 0);
+  for (const auto& pubkey : pubkeys)
+    del_proof(txn.get(), m_proofs, pubkey);
+  commit_proofs_txn(txn);
 }
 
 
@@ -27,8 +27,15 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
+#include <thread>
 
 #include "blockchain_db/blockchain_db.h"
+#include "blockchain_db/blob_compression.h"
+#include "blockchain_db/block_info_cache.h"
+#include "blockchain_db/key_image_filter.h"
+#include "blockchain_db/parsed_block_cache.h"
+#include "common/cache_budget.h"
 #include "cryptonote_basic/blobdatatype.h" // for type blobdata
 #include "ringct/rctTypes.h"
 #include "common/fs.h"
@@ -190,6 +197,8 @@ public:
 
   std::vector<fs::path> get_filenames() const override;
 
+  void copy_compacted(const fs::path& folder) const override;
+
   bool remove_data_file(const fs::path& folder) const override;
 
   std::string get_db_name() const override;
@@ -214,6 +223,8 @@ public:
 
   std::vector<uint64_t> get_block_cumulative_rct_outputs(const std::vector<uint64_t> &heights) const override;
 
+  std::vector<uint64_t> get_cumulative_rct_outputs(uint64_t start_height, size_t count) const override;
+
   uint64_t get_block_timestamp(const uint64_t& height) const override;
 
   uint64_t get_top_block_timestamp() const override;
@@ -232,6 +243,10 @@ public:
 
   std::vector<uint64_t> get_long_term_block_weights(uint64_t start_height, size_t count) const override;
 
+  std::vector<uint64_t> get_block_timestamps(uint64_t start_height, size_t count) const override;
+
+  std::vector<difficulty_type> get_block_cumulative_difficulties(uint64_t start_height, size_t count) const override;
+
   crypto::hash get_block_hash_from_height(const uint64_t& height) const override;
 
   std::vector<block> get_blocks_range(const uint64_t& h1, const uint64_t& h2) const override;
@@ -249,9 +264,14 @@ public:
 
   uint64_t get_tx_unlock_time(const crypto::hash& h) const override;
 
+  using BlockchainDB::get_tx;
+  bool get_tx(const crypto::hash& h, transaction &tx) const override;
+
   bool get_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const override;
   bool get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const override;
   bool get_pruned_tx_blobs_from(const crypto::hash& h, size_t count, std::vector<cryptonote::blobdata> &bd) const override;
+  void prefetch_blocks(uint64_t start_height, size_t count) const override;
+  void start_prewarm(const std::vector<std::string>& tables, uint64_t recent_blocks, uint64_t bytes_per_second) override;
   bool get_prunable_tx_blob(const crypto::hash& h, cryptonote::blobdata &tx) const override;
   bool get_prunable_tx_hash(const crypto::hash& tx_hash, crypto::hash &prunable_hash) const override;
 
@@ -268,12 +288,13 @@ public:
 
   tx_out_index get_output_tx_and_index_from_global(const uint64_t& index) const override;
   void get_output_tx_and_index_from_global(const std::vector<uint64_t> &global_indices,
-      std::vector<tx_out_index> &tx_out_indices) const;
+      std::vector<tx_out_index> &tx_out_indices) const override;
 
   tx_out_index get_output_tx_and_index(const uint64_t& amount, const uint64_t& index) const override;
-  void get_output_tx_and_index(const uint64_t& amount, const std::vector<uint64_t> &offsets, std::vector<tx_out_index> &indices) const override;
+  void get_output_tx_and_index(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<tx_out_index> &indices) const override;
 
   std::vector<std::vector<uint64_t>> get_tx_amount_output_indices(const uint64_t tx_id, size_t n_txes) const override;
+  std::vector<std::vector<std::vector<uint64_t>>> get_blocks_tx_amount_output_indices(uint64_t tx_id, const std::vector<size_t>& block_txes, bool miner_txes) const override;
 
   bool has_key_image(const crypto::key_image& img) const override;
 
@@ -287,6 +308,7 @@ public:
   cryptonote::blobdata get_txpool_tx_blob(const crypto::hash& txid) const override;
   uint32_t get_blockchain_pruning_seed() const override;
   bool prune_blockchain(uint32_t pruning_seed = 0) override;
+  bool prune_blockchain_batch(uint32_t pruning_seed, size_t max_records) override;
   bool update_pruning() override;
   bool check_pruning() override;
 
@@ -359,11 +381,17 @@ public:
   static int compare_string(const MDB_val *a, const MDB_val *b);
 
 private:
-  void do_resize(uint64_t size_increase=0);
+  // Grows the map by at least size_increase (and geometrically, see RESIZE_GROWTH_FACTOR).  If
+  // wait_for_readers is false the resize is skipped (returning false) rather than waiting for
+  // active read txns to finish.
+  bool do_resize(uint64_t size_increase=0, bool wait_for_readers=true);
 
   bool need_resize(uint64_t threshold_size=0) const;
   void check_and_resize_for_batch(uint64_t batch_num_blocks, uint64_t batch_bytes);
   uint64_t get_estimated_batch_size(uint64_t batch_num_blocks, uint64_t batch_bytes) const;
+  uint64_t map_size_used() const;
+  // Updates the observed on-disk bytes per block from the growth since the last call
+  void update_growth_estimate();
 
   void add_block( const block& blk
                 , size_t block_weight
@@ -411,7 +439,7 @@ private:
 
   uint64_t get_database_size() const override;
 
-  std::vector<uint64_t> get_block_info_64bit_fields(uint64_t start_height, size_t count, uint64_t (*extract)(const mdb_block_info*)) const;
+  std::vector<uint64_t> get_block_info_64bit_fields(uint64_t start_height, size_t count, block_info_cache::field cached, uint64_t (*extract)(const mdb_block_info*)) const;
 
   uint64_t get_max_block_size() override;
   void add_max_block_size(uint64_t sz) override;
@@ -433,14 +461,18 @@ private:
   void cleanup_batch();
 
   bool get_block_checkpoint_internal(uint64_t height, checkpoint_t &checkpoint, MDB_cursor_op op) const;
-  void set_service_node_data(const std::string& data, bool long_term) override;
   bool get_service_node_data(std::string& data, bool long_term) const override;
   void clear_service_node_data() override;
+  void set_service_node_record(uint8_t type, uint64_t height, std::string_view data) override;
+  void remove_service_node_record(uint8_t type, uint64_t height) override;
+  void for_each_service_node_record(uint8_t type, std::function<bool(uint64_t height, std::string_view data)> f) const override;
 
   bool get_service_node_proof(const crypto::public_key& pubkey, service_nodes::proof_info& proof) const override;
   void set_service_node_proof(const crypto::public_key& pubkey, const service_nodes::proof_info& proof) override;
   std::unordered_map<crypto::public_key, service_nodes::proof_info> get_all_service_node_proofs() const override;
   bool remove_service_node_proof(const crypto::public_key& pubkey) override;
+  void set_service_node_proofs(const std::vector<std::pair<crypto::public_key, service_nodes::proof_info>>& proofs) override;
+  void remove_service_node_proofs(const std::vector<crypto::public_key>& pubkeys) override;
 
 private:
   template <typename T,
@@ -449,6 +481,53 @@ private:
                              std::is_same_v<T, cryptonote::blobdata>, int> = 0>
   T get_and_convert_block_blob_from_height(uint64_t height) const;
 
+  // Returns the block/tx blob stored in `v`, decompressing it into `buffer` first if this database
+  // stores compressed blobs.  The returned view points into either `v` or `buffer`.
+  std::string_view blob_value(const MDB_val& v, std::string& buffer) const;
+  // Same as blob_value, but returns an owned copy of the blob.  When the value has to be
+  // decompressed the decompressed buffer is returned as is, rather than copied a second time.
+  cryptonote::blobdata blob_string(const MDB_val& v) const;
+  // Stores `blob` into `buffer` compressed (if this database stores compressed blobs) and
+  // returns the MDB_val to write
+  MDB_val compressed_value(std::string_view blob, std::string& buffer, bool tx_prefix = false);
+  bool is_v1_tx(MDB_cursor* c_txs_pruned, MDB_val* tx_id) const;
+  // Trains and stores the tx prefix dictionary once enough samples have been collected.  Must be
+  // called without an open write txn.
+  void maybe_train_tx_prefix_dictionary();
+
+  // (Re)builds the spent key image filter from the spent_keys table, sized for at least
+  // `min_capacity` key images
+  void rebuild_key_image_filter(size_t min_capacity = 0);
+
+  // Loads m_block_info_cache from the block_info table
+  void load_block_info_cache();
+
+  // prefetch_blocks(), returning the number of bytes of block and tx data it read
+  size_t prefetch_block_range(uint64_t start_height, size_t count) const;
+  // Where start_prewarm() has got to in a table
+  struct prewarm_position
+  {
+    std::string key, value; // of the last record read (the value only matters for DUPSORT tables)
+    bool started = false;
+    bool done = false;
+  };
+  // Reads about `budget` bytes of `dbi` from `pos` on, in a read txn of its own; returns the
+  // bytes read.
+  size_t prewarm_table(MDB_dbi dbi, prewarm_position& pos, size_t budget) const;
+  void prewarm(std::vector<std::pair<std::string, MDB_dbi>> tables, uint64_t recent_blocks, uint64_t bytes_per_second);
+  // Stops (and waits for) the start_prewarm() thread, if any
+  void stop_prewarm();
+  // Whether the calling thread is the one with the open write txn
+  bool is_writer() const { return m_write_txn && m_writer == boost::this_thread::get_id(); }
+  std::optional<uint64_t> cached_block_info(block_info_cache::field f, uint64_t height) const;
+  // The parsed block at `height`, from m_parsed_cache or else read (and added to it); null if
+  // there is no m_parsed_cache
+  std::shared_ptr<const block> cached_block(uint64_t height) const;
+  void update_parsed_cache_size() const;
+  // The unlocked and recent counts of get_output_histogram() for amount 0, from the blocks'
+  // cumulative RCT output counts rather than by looking up the outputs one at a time
+  void get_rct_histogram_counts(uint64_t blockchain_height, uint64_t num_outputs, uint64_t recent_cutoff, uint64_t& unlocked, uint64_t& recent) const;
+
   MDB_env* m_env;
 
   MDB_dbi m_blocks;
@@ -479,12 +558,24 @@ private:
   MDB_dbi m_hf_versions;
 
   MDB_dbi m_service_node_data;
-  MDB_dbi m_service_node_proofs;
+  MDB_dbi m_service_node_proofs; // legacy: proofs now live in m_proofs_env (moved there on open)
+
+  // Uptime proofs are kept in an environment of their own (sn_proofs.mdb in the db folder), opened
+  // MDB_NOSYNC and written with their own short transactions, so that they never wait for (or hold
+  // up) the main environment's write lock.  Null for read-only databases.
+  MDB_env* m_proofs_env = nullptr;
+  MDB_dbi m_proofs;
+  void open_proofs_env();
+  void close_proofs_env();
 
   MDB_dbi m_properties;
 
   mutable uint64_t m_cum_size;	// used in batch size estimation
   mutable unsigned int m_cum_count;
+  // Observed database growth, used to size resizes before they are needed
+  uint64_t m_growth_height;
+  uint64_t m_growth_size_used;
+  double m_growth_per_block; // bytes per block (moving average), 0 until measured
   fs::path m_folder;
   mdb_txn_safe* m_write_txn; // may point to either a short-lived txn or a batch txn
   mdb_txn_safe* m_write_batch_txn; // persist batch txn outside of BlockchainLMDB
@@ -496,6 +587,24 @@ private:
   mdb_txn_cursors m_wcursors;
   mutable boost::thread_specific_ptr<mdb_threadinfo> m_tinfo;
 
+  bool m_compress = false; // whether block and tx blobs are stored compressed (fixed at db creation)
+  blob_compressor m_compressor;
+  std::vector<std::string> m_tx_prefix_samples; // collected until the tx prefix dictionary is trained
+
+  // Null until built after opening (and never built for read-only databases), in which case every
+  // lookup goes to LMDB.  Accessed with std::atomic_load/atomic_store: the writer replaces it when
+  // it outgrows its capacity while readers may be using it.
+  std::shared_ptr<key_image_filter> m_key_image_filter;
+
+  // Null (and every lookup goes to LMDB) for read-only databases, which may be written to by
+  // another process.  Set up by open() before any concurrent use.
+  std::unique_ptr<block_info_cache> m_block_info_cache;
+
+  // Recently used blocks and txs, already parsed.  Looked up by height through m_block_info_cache,
+  // so set up (and null) along with it.
+  std::unique_ptr<parsed_block_cache> m_parsed_cache;
+  tools::cache_budget::handle m_parsed_cache_budget;
+
 #if defined(__arm__)
   // force a value so it can compile with 32-bit ARM
   constexpr static uint64_t DEFAULT_MAPSIZE = 1LL << 31;
@@ -510,7 +619,26 @@ private:
   // Guards LMDB resize
   std::mutex m_synchronization_lock;
 
+  std::thread m_prewarm_thread;
+  std::mutex m_prewarm_mutex;
+  std::condition_variable m_prewarm_cv;
+  bool m_prewarm_stop = false;
+
   constexpr static float RESIZE_PERCENT = 0.9f;
+  // Each resize grows the map by at least this fraction of its current size, so that the number of
+  // resizes (each of which has to wait for every reader) grows logarithmically with the chain.
+  constexpr static double RESIZE_GROWTH_FACTOR = 0.25;
+  // Blocks between samples of the on-disk growth rate
+  constexpr static uint64_t GROWTH_SAMPLE_BLOCKS = 500;
+
+  constexpr static size_t TX_PREFIX_DICTIONARY_SAMPLES = 10000;
+  constexpr static size_t TX_PREFIX_DICTIONARY_SIZE = 64 * 1024;
+
+  constexpr static size_t MIN_KEY_IMAGE_FILTER_CAPACITY = 1'000'000;
+
+  // Most blocks and txs kept in m_parsed_cache: about a day of blocks, and their txs
+  constexpr static size_t PARSED_CACHE_BLOCKS = 720;
+  constexpr static size_t PARSED_CACHE_TXS = 8192;
 };
 
 }  // namespace cryptonote
@@ -32,25 +32,25 @@
 
 namespace cryptonote
 {
-    // This class is meant to create a batch when none currently exists.
-    // If a batch exists, it can't be from another thread, since we can
-    // only be called with the txpool lock taken, and it is held during
-    // the whole prepare/handle/cleanup incoming block sequence.
+    // Groups changes to the tx pool so that they can be undone together with abort(), as when
+    // they were made directly in a database batch.  If a group already exists (which can't be from
+    // another thread, since we can only be called with the txpool lock taken), the changes become
+    // part of it.  The changes reach the database later, with Blockchain::flush_txpool().
     class LockedTXN {
     public:
-      LockedTXN(Blockchain &b): m_db{b.get_db()} {
-        m_batch = m_db.batch_start();
+      LockedTXN(Blockchain &b): m_store{b.get_txpool_store()} {
+        m_group = m_store.begin();
       }
       LockedTXN(const LockedTXN &) = delete;
       LockedTXN &operator=(const LockedTXN &) = delete;
-      LockedTXN(LockedTXN &&o) : m_db{o.m_db}, m_batch{o.m_batch} { o.m_batch = false; }
+      LockedTXN(LockedTXN &&o) : m_store{o.m_store}, m_group{o.m_group} { o.m_group = false; }
       LockedTXN &operator=(LockedTXN &&) = delete;
 
-      void commit() { try { if (m_batch) { m_db.batch_stop(); m_batch = false; } } catch (const std::exception &e) { MWARNING("LockedTXN::commit filtering exception: " << e.what()); } }
-      void abort() { try { if (m_batch) { m_db.batch_abort(); m_batch = false; } } catch (const std::exception &e) { MWARNING("LockedTXN::abort filtering exception: " << e.what()); } }
+      void commit() { if (m_group) { m_store.commit(); m_group = false; } }
+      void abort() { if (m_group) { m_store.abort(); m_group = false; } }
       ~LockedTXN() { this->abort(); }
     private:
-      BlockchainDB &m_db;
-      bool m_batch;
+      txpool_store &m_store;
+      bool m_group;
     };
 }
@@ -0,0 +1,135 @@
+#include "parsed_block_cache.h"
+
+namespace cryptonote
+{
+
+template <typename T>
+void parsed_block_cache::lru<T>::add(const crypto::hash& hash, std::shared_ptr<const T> value, size_t bytes)
+{
+  if (max == 0)
+    return;
+  remove(hash);
+  entries.push_front({hash, std::move(value), bytes});
+  index.emplace(hash, entries.begin());
+  this->bytes += bytes;
+  while (entries.size() > max)
+    pop_oldest();
+}
+
+template <typename T>
+std::shared_ptr<const T> parsed_block_cache::lru<T>::find(const crypto::hash& hash)
+{
+  auto it = index.find(hash);
+  if (it == index.end())
+    return nullptr;
+  entries.splice(entries.begin(), entries, it->second);
+  return it->second->value;
+}
+
+template <typename T>
+void parsed_block_cache::lru<T>::remove(const crypto::hash& hash)
+{
+  auto it = index.find(hash);
+  if (it == index.end())
+    return;
+  bytes -= it->second->bytes;
+  entries.erase(it->second);
+  index.erase(it);
+}
+
+template <typename T>
+void parsed_block_cache::lru<T>::pop_oldest()
+{
+  auto& e = entries.back();
+  bytes -= e.bytes;
+  index.erase(e.hash);
+  entries.pop_back();
+}
+
+template <typename T>
+void parsed_block_cache::lru<T>::clear()
+{
+  entries.clear();
+  index.clear();
+  bytes = 0;
+}
+
+void parsed_block_cache::add_block(const crypto::hash& hash, std::shared_ptr<const block> b, size_t bytes)
+{
+  std::lock_guard lock{m_mutex};
+  m_blocks.add(hash, std::move(b), bytes);
+}
+
+std::shared_ptr<const block> parsed_block_cache::find_block(const crypto::hash& hash)
+{
+  std::lock_guard lock{m_mutex};
+  return m_blocks.find(hash);
+}
+
+void parsed_block_cache::remove_block(const crypto::hash& hash)
+{
+  std::lock_guard lock{m_mutex};
+  m_blocks.remove(hash);
+}
+
+void parsed_block_cache::add_tx(const crypto::hash& hash, std::shared_ptr<const transaction> tx, size_t bytes)
+{
+  std::lock_guard lock{m_mutex};
+  m_txs.add(hash, std::move(tx), bytes);
+}
+
+std::shared_ptr<const transaction> parsed_block_cache::find_tx(const crypto::hash& hash)
+{
+  std::lock_guard lock{m_mutex};
+  return m_txs.find(hash);
+}
+
+void parsed_block_cache::remove_tx(const crypto::hash& hash)
+{
+  std::lock_guard lock{m_mutex};
+  m_txs.remove(hash);
+}
+
+void parsed_block_cache::clear()
+{
+  std::lock_guard lock{m_mutex};
+  m_blocks.clear();
+  m_txs.clear();
+}
+
+void parsed_block_cache::clear_txs()
+{
+  std::lock_guard lock{m_mutex};
+  m_txs.clear();
+}
+
+size_t parsed_block_cache::bytes() const
+{
+  std::lock_guard lock{m_mutex};
+  return m_blocks.bytes + m_txs.bytes;
+}
+
+void parsed_block_cache::evict(size_t bytes)
+{
+  std::lock_guard lock{m_mutex};
+  size_t const target = bytes < m_blocks.bytes + m_txs.bytes ? m_blocks.bytes + m_txs.bytes - bytes : 0;
+  // Txs first: a block is worth more, as it is what the repeated lookups by height are for
+  while (!m_txs.entries.empty() && m_blocks.bytes + m_txs.bytes > target)
+    m_txs.pop_oldest();
+  while (!m_blocks.entries.empty() && m_blocks.bytes + m_txs.bytes > target)
+    m_blocks.pop_oldest();
+}
+
+size_t parsed_block_cache::num_blocks() const
+{
+  std::lock_guard lock{m_mutex};
+  return m_blocks.entries.size();
+}
+
+size_t parsed_block_cache::num_txs() const
+{
+  std::lock_guard lock{m_mutex};
+  return m_txs.entries.size();
+}
+
+}
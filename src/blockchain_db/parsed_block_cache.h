@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "crypto/hash.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+
+namespace cryptonote
+{
+
+// Bounded, least recently used cache of parsed blocks and transactions, so that the callers that
+// keep going back to the last few hundred blocks (service node list, quorum checks, RPC) don't
+// decompress and parse them from the database every time.
+//
+// Entries are keyed by block or tx hash, whose contents never change, so an entry can't go stale:
+// a block popped from the chain just stops being found by height (the height -> hash lookup goes
+// through the block_info_cache, which only shows committed heights to readers), and a popped or
+// pruned tx is checked for (or dropped) by the database before its cached copy is used.  That is
+// also why the writer can add entries as it writes them without staging them until commit.
+//
+// Thread safe.
+class parsed_block_cache
+{
+public:
+  parsed_block_cache(size_t max_blocks, size_t max_txs) : m_blocks{max_blocks}, m_txs{max_txs} {}
+
+  // `bytes` is the size of the blob it was parsed from, as an estimate of its size in memory
+  void add_block(const crypto::hash& hash, std::shared_ptr<const block> b, size_t bytes);
+  std::shared_ptr<const block> find_block(const crypto::hash& hash);
+  void remove_block(const crypto::hash& hash);
+
+  void add_tx(const crypto::hash& hash, std::shared_ptr<const transaction> tx, size_t bytes);
+  std::shared_ptr<const transaction> find_tx(const crypto::hash& hash);
+  void remove_tx(const crypto::hash& hash);
+
+  void clear();
+  void clear_txs();
+
+  // Estimated size of the cached blocks and txs, and the least recently used entries to drop to
+  // free (at least) `bytes` of it
+  size_t bytes() const;
+  void evict(size_t bytes);
+
+  size_t num_blocks() const;
+  size_t num_txs() const;
+
+private:
+  template <typename T>
+  struct lru
+  {
+    struct entry
+    {
+      crypto::hash hash;
+      std::shared_ptr<const T> value;
+      size_t bytes;
+    };
+    explicit lru(size_t max) : max{max} {}
+
+    void add(const crypto::hash& hash, std::shared_ptr<const T> value, size_t bytes);
+    std::shared_ptr<const T> find(const crypto::hash& hash);
+    void remove(const crypto::hash& hash);
+    void pop_oldest();
+    void clear();
+
+    size_t max;
+    size_t bytes = 0;
+    std::list<entry> entries; // most recently used first
+    std::unordered_map<crypto::hash, typename std::list<entry>::iterator> index;
+  };
+
+  mutable std::mutex m_mutex;
+  lru<block> m_blocks;
+  lru<transaction> m_txs;
+};
+
+}
@@ -49,6 +49,7 @@ public:
   virtual void safesyncmode(const bool onoff) override {}
   virtual void reset() override {}
   virtual std::vector<fs::path> get_filenames() const override { return {}; }
+  virtual void copy_compacted(const fs::path& folder) const override {}
   virtual bool remove_data_file(const fs::path& folder) const override { return true; }
   virtual std::string get_db_name() const override { return std::string(); }
   virtual void lock() override { }
@@ -104,7 +105,8 @@ public:
   virtual cryptonote::output_data_t get_output_key(const uint64_t& amount, const uint64_t& index, bool include_commitmemt) const override { return cryptonote::output_data_t(); }
   virtual cryptonote::tx_out_index get_output_tx_and_index_from_global(const uint64_t& index) const override { return cryptonote::tx_out_index(); }
   virtual cryptonote::tx_out_index get_output_tx_and_index(const uint64_t& amount, const uint64_t& index) const override { return cryptonote::tx_out_index(); }
-  virtual void get_output_tx_and_index(const uint64_t& amount, const std::vector<uint64_t> &offsets, std::vector<cryptonote::tx_out_index> &indices) const override {}
+  virtual void get_output_tx_and_index_from_global(const std::vector<uint64_t> &global_indices, std::vector<cryptonote::tx_out_index> &tx_out_indices) const override {}
+  virtual void get_output_tx_and_index(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<cryptonote::tx_out_index> &indices) const override {}
   virtual void get_output_key(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<cryptonote::output_data_t> &outputs, bool allow_partial = false) const override {}
   virtual bool can_thread_bulk_indices() const override { return false; }
   virtual std::vector<std::vector<uint64_t>> get_tx_amount_output_indices(const uint64_t tx_index, size_t n_txes) const override { return std::vector<std::vector<uint64_t>>(); }
@@ -149,6 +151,7 @@ public:
 
   virtual uint32_t get_blockchain_pruning_seed() const override { return 0; }
   virtual bool prune_blockchain(uint32_t pruning_seed = 0) override { return true; }
+  virtual bool prune_blockchain_batch(uint32_t pruning_seed, size_t max_records) override { return true; }
   virtual bool update_pruning() override { return true; }
   virtual bool check_pruning() override { return true; }
   virtual void prune_outputs(uint64_t amount) override {}
@@ -164,14 +167,18 @@ public:
 
   virtual void get_output_blacklist   (std::vector<uint64_t> &blacklist)       const override { }
   virtual void add_output_blacklist   (std::vector<uint64_t> const &blacklist)       override { }
-  virtual void set_service_node_data  (const std::string& data, bool long_term)      override { }
   virtual bool get_service_node_data  (std::string& data, bool long_term)      const override { return false; }
   virtual void clear_service_node_data()                                             override { }
+  virtual void set_service_node_record(uint8_t type, uint64_t height, std::string_view data) override { }
+  virtual void remove_service_node_record(uint8_t type, uint64_t height)                    override { }
+  virtual void for_each_service_node_record(uint8_t type, std::function<bool(uint64_t height, std::string_view data)> f) const override { }
 
   bool get_service_node_proof(const crypto::public_key &pubkey, service_nodes::proof_info &proof) const override { return false; }
   std::unordered_map<crypto::public_key, service_nodes::proof_info> get_all_service_node_proofs() const override { return {}; }
   void set_service_node_proof(const crypto::public_key &pubkey, const service_nodes::proof_info &proof) override { }
   bool remove_service_node_proof(const crypto::public_key &pubkey) override { return false; }
+  void set_service_node_proofs(const std::vector<std::pair<crypto::public_key, service_nodes::proof_info>> &proofs) override { }
+  void remove_service_node_proofs(const std::vector<crypto::public_key> &pubkeys) override { }
 
   virtual void add_alt_block(const crypto::hash &blkid, const cryptonote::alt_block_data_t &data, const cryptonote::blobdata &blob, const cryptonote::blobdata *checkpoint) override {}
   virtual bool get_alt_block(const crypto::hash &blkid, alt_block_data_t *data, cryptonote::blobdata *blob, cryptonote::blobdata *checkpoint) const override { return false; }
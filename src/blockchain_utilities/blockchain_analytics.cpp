@@ -0,0 +1,457 @@
+// Copyright (c) 2021, The Oxen Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Exports per-block and per-tx data from the blockchain db as columnar files, for analysis with
+// Arrow/pandas/numpy etc. rather than by scraping the RPC.  Block ranges are read concurrently by
+// the threadpool's threads (each with its own LMDB read txn) and written out in height order.
+
+#include <numeric>
+#include <boost/endian/conversion.hpp>
+#include "common/command_line.h"
+#include "common/signal_handler.h"
+#include "common/threadpool.h"
+#include "common/fs.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "blockchain_objects.h"
+#include "blockchain_db/blockchain_db.h"
+#include "version.h"
+#include "cryptonote_core/uptime_proof.h"
+
+#undef OXEN_DEFAULT_LOG_CATEGORY
+#define OXEN_DEFAULT_LOG_CATEGORY "bcutil"
+
+namespace po = boost::program_options;
+using namespace cryptonote;
+
+static bool stop_requested = false;
+
+namespace {
+
+struct block_row
+{
+  uint64_t height;
+  uint64_t timestamp;
+  uint8_t major_version;
+  uint8_t minor_version;
+  uint8_t pulse;
+  uint32_t tx_count;
+  uint64_t size;
+  uint64_t weight;
+  uint64_t difficulty;
+  uint64_t fees;
+  uint64_t burned;
+  uint64_t reward; // everything the miner tx pays out
+  uint64_t miner_reward;
+  uint64_t sn_reward;
+  uint64_t governance_reward;
+};
+
+struct tx_row
+{
+  crypto::hash hash;
+  uint64_t height;
+  uint16_t version;
+  uint16_t type;
+  uint32_t inputs;
+  uint32_t outputs;
+  uint32_t ring_size; // of the first input; 0 for txs without key inputs
+  uint64_t size; // of the full tx; 0 if the db has it pruned
+  uint64_t weight;
+  uint64_t fee;
+  uint64_t burned;
+};
+
+struct range_rows
+{
+  std::vector<block_row> blocks;
+  std::vector<tx_row> txs;
+};
+
+template <typename T> constexpr std::string_view arrow_type();
+template <> constexpr std::string_view arrow_type<uint8_t>() { return "uint8"; }
+template <> constexpr std::string_view arrow_type<uint16_t>() { return "uint16"; }
+template <> constexpr std::string_view arrow_type<uint32_t>() { return "uint32"; }
+template <> constexpr std::string_view arrow_type<uint64_t>() { return "uint64"; }
+template <> constexpr std::string_view arrow_type<crypto::hash>() { return "fixed_size_binary[32]"; }
+
+// Writes a table as one file per column (<dir>/<column>.bin) holding the column's values,
+// little-endian and back to back: the layout of an Arrow (or numpy) array of those values, so the
+// files can be memory mapped as is.
+class table_writer
+{
+public:
+  explicit table_writer(fs::path dir) : m_dir{std::move(dir)}
+  {
+    fs::create_directories(m_dir);
+  }
+
+  // Appends the `field` of each of `rows` to the column `name`.  Every column must get the same
+  // rows, and always in the same order.
+  template <typename Row, typename T>
+  void append(const std::string& name, const std::vector<Row>& rows, T Row::*field)
+  {
+    auto it = std::find_if(m_columns.begin(), m_columns.end(), [&](const auto& c) { return c.name == name; });
+    if (it == m_columns.end())
+    {
+      auto& c = m_columns.emplace_back();
+      c.name = name;
+      c.type = arrow_type<T>();
+      c.out.open(m_dir / (name + ".bin"), std::ios::binary | std::ios::trunc);
+      if (!c.out)
+        throw std::runtime_error("Failed to create " + (m_dir / (name + ".bin")).u8string());
+      it = std::prev(m_columns.end());
+    }
+    for (const auto& row : rows)
+    {
+      T v = row.*field;
+      if constexpr (std::is_integral_v<T>)
+        boost::endian::native_to_little_inplace(v);
+      it->out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+    }
+    if (!it->out)
+      throw std::runtime_error("Failed to write " + (m_dir / (name + ".bin")).u8string());
+  }
+
+  void add_rows(size_t n) { m_rows += n; }
+  void flush() { for (auto& c : m_columns) c.out.flush(); }
+
+  // Describes the table as a JSON object: {"rows": N, "columns": [{"name": ..., "type": ...}, ...]}
+  void write_schema(std::ostream& o) const
+  {
+    o << "{\"rows\": " << m_rows << ", \"columns\": [";
+    for (size_t i = 0; i < m_columns.size(); i++)
+      o << (i ? ", " : "") << "{\"name\": \"" << m_columns[i].name << "\", \"type\": \"" << m_columns[i].type << "\"}";
+    o << "]}";
+  }
+
+private:
+  struct column
+  {
+    std::string name;
+    std::string_view type;
+    fs::ofstream out;
+  };
+  fs::path m_dir;
+  std::vector<column> m_columns;
+  uint64_t m_rows = 0;
+};
+
+void write_blocks(table_writer& w, const std::vector<block_row>& rows)
+{
+  w.append("height", rows, &block_row::height);
+  w.append("timestamp", rows, &block_row::timestamp);
+  w.append("major_version", rows, &block_row::major_version);
+  w.append("minor_version", rows, &block_row::minor_version);
+  w.append("pulse", rows, &block_row::pulse);
+  w.append("tx_count", rows, &block_row::tx_count);
+  w.append("size", rows, &block_row::size);
+  w.append("weight", rows, &block_row::weight);
+  w.append("difficulty", rows, &block_row::difficulty);
+  w.append("fees", rows, &block_row::fees);
+  w.append("burned", rows, &block_row::burned);
+  w.append("reward", rows, &block_row::reward);
+  w.append("miner_reward", rows, &block_row::miner_reward);
+  w.append("sn_reward", rows, &block_row::sn_reward);
+  w.append("governance_reward", rows, &block_row::governance_reward);
+  w.add_rows(rows.size());
+}
+
+void write_txs(table_writer& w, const std::vector<tx_row>& rows)
+{
+  w.append("hash", rows, &tx_row::hash);
+  w.append("height", rows, &tx_row::height);
+  w.append("version", rows, &tx_row::version);
+  w.append("type", rows, &tx_row::type);
+  w.append("inputs", rows, &tx_row::inputs);
+  w.append("outputs", rows, &tx_row::outputs);
+  w.append("ring_size", rows, &tx_row::ring_size);
+  w.append("size", rows, &tx_row::size);
+  w.append("weight", rows, &tx_row::weight);
+  w.append("fee", rows, &tx_row::fee);
+  w.append("burned", rows, &tx_row::burned);
+  w.add_rows(rows.size());
+}
+
+void read_tx(const BlockchainDB& db, const crypto::hash& hash, const block& blk, uint64_t height, range_rows& out)
+{
+  auto& row = out.txs.emplace_back();
+  row.hash = hash;
+  row.height = height;
+
+  transaction tx;
+  blobdata bd;
+  if (db.get_tx_blob(hash, bd))
+  {
+    if (!parse_and_validate_tx_from_blob(bd, tx))
+      throw std::runtime_error("Bad tx " + tools::type_to_hex(hash) + " in db");
+    row.size = bd.size();
+    row.weight = get_transaction_weight(tx, bd.size());
+  }
+  else
+  {
+    // Pruned: the weight of the full tx is all we can tell
+    if (!db.get_pruned_tx_blob(hash, bd) || !parse_and_validate_tx_base_from_blob(bd, tx))
+      throw std::runtime_error("Tx " + tools::type_to_hex(hash) + " not found in db");
+    row.size = 0;
+    row.weight = get_pruned_transaction_weight(tx);
+  }
+
+  row.version = static_cast<uint16_t>(tx.version);
+  row.type = static_cast<uint16_t>(tx.type);
+  row.inputs = tx.vin.size();
+  row.outputs = tx.vout.size();
+  const auto* in = tx.vin.empty() ? nullptr : std::get_if<txin_to_key>(&tx.vin[0]);
+  row.ring_size = in ? in->key_offsets.size() : 0;
+  row.fee = row.burned = 0;
+  if (!get_tx_miner_fee(tx, row.fee, blk.major_version >= HF_VERSION_FEE_BURNING, &row.burned))
+    row.fee = row.burned = 0;
+}
+
+void read_block(const BlockchainDB& db, network_type nettype, uint64_t height, range_rows& out)
+{
+  const blobdata bd = db.get_block_blob_from_height(height);
+  block blk;
+  if (!parse_and_validate_block_from_blob(bd, blk))
+    throw std::runtime_error("Bad block at height " + std::to_string(height) + " in db");
+
+  auto& row = out.blocks.emplace_back();
+  row.height = height;
+  row.timestamp = blk.timestamp;
+  row.major_version = blk.major_version;
+  row.minor_version = blk.minor_version;
+  row.pulse = block_has_pulse_components(blk);
+  row.tx_count = blk.tx_hashes.size();
+  row.size = bd.size();
+  row.weight = db.get_block_weight(height);
+  row.difficulty = db.get_block_difficulty(height);
+
+  // The miner tx pays the miner first (unless the block is a pulse block, where service nodes get
+  // it all), then the service nodes, and governance last on the heights that pay it.
+  row.reward = row.miner_reward = row.sn_reward = row.governance_reward = 0;
+  const auto& vout = blk.miner_tx.vout;
+  for (const auto& o : vout)
+    row.reward += o.amount;
+  size_t first = 0, last = vout.size();
+  if (height > 0 && first < last && block_has_governance_output(nettype, blk))
+    row.governance_reward = vout[--last].amount;
+  if (!row.pulse && first < last)
+    row.miner_reward = vout[first++].amount;
+  if (blk.major_version >= network_version_9_service_nodes)
+    for (size_t i = first; i < last; i++)
+      row.sn_reward += vout[i].amount;
+  else
+    row.miner_reward += std::accumulate(vout.begin() + first, vout.begin() + last, uint64_t{0},
+        [](uint64_t a, const tx_out& o) { return a + o.amount; });
+
+  row.fees = row.burned = 0;
+  const size_t first_tx = out.txs.size();
+  for (const auto& hash : blk.tx_hashes)
+    read_tx(db, hash, blk, height, out);
+  for (size_t i = first_tx; i < out.txs.size(); i++)
+  {
+    row.fees += out.txs[i].fee;
+    row.burned += out.txs[i].burned;
+  }
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+
+  epee::string_tools::set_module_name_and_folder(argv[0]);
+
+  uint32_t log_level = 0;
+  uint64_t block_start = 0;
+  uint64_t block_stop = 0;
+
+  tools::on_startup();
+
+  auto opt_size = command_line::boost_option_sizes();
+
+  po::options_description desc_cmd_only("Command line options", opt_size.first, opt_size.second);
+  po::options_description desc_cmd_sett("Command line options and settings options", opt_size.first, opt_size.second);
+  const command_line::arg_descriptor<std::string> arg_log_level  = {"log-level",  "0-4 or categories", ""};
+  const command_line::arg_descriptor<uint64_t> arg_block_start  = {"block-start", "start at block number", block_start};
+  const command_line::arg_descriptor<uint64_t> arg_block_stop = {"block-stop", "Stop at block number", block_stop};
+  const command_line::arg_descriptor<std::string, true> arg_output_dir = {"output-dir", "Write the blocks/ and txs/ column files and schema.json to this directory"};
+  const command_line::arg_descriptor<uint64_t> arg_range_size = {"range-size", "Blocks read by each thread at a time", 1000};
+
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_data_dir);
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_testnet_on);
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_devnet_on);
+  command_line::add_arg(desc_cmd_sett, arg_log_level);
+  command_line::add_arg(desc_cmd_sett, arg_block_start);
+  command_line::add_arg(desc_cmd_sett, arg_block_stop);
+  command_line::add_arg(desc_cmd_sett, arg_output_dir);
+  command_line::add_arg(desc_cmd_sett, arg_range_size);
+  command_line::add_arg(desc_cmd_only, command_line::arg_help);
+
+  po::options_description desc_options("Allowed options");
+  desc_options.add(desc_cmd_only).add(desc_cmd_sett);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    auto parser = po::command_line_parser(argc, argv).options(desc_options);
+    po::store(parser.run(), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (! r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << "Oxen '" << OXEN_RELEASE_NAME << "' (v" << OXEN_VERSION_FULL << ")\n\n";
+    std::cout << desc_options << std::endl;
+    return 1;
+  }
+
+  mlog_configure(mlog_get_default_log_path("oxen-blockchain-analytics.log"), true);
+  if (!command_line::is_arg_defaulted(vm, arg_log_level))
+    mlog_set_log(command_line::get_arg(vm, arg_log_level).c_str());
+  else
+    mlog_set_log(std::string(std::to_string(log_level) + ",bcutil:INFO").c_str());
+
+  LOG_PRINT_L0("Starting...");
+
+  std::string opt_data_dir = command_line::get_arg(vm, cryptonote::arg_data_dir);
+  bool opt_testnet = command_line::get_arg(vm, cryptonote::arg_testnet_on);
+  bool opt_devnet = command_line::get_arg(vm, cryptonote::arg_devnet_on);
+  network_type net_type = opt_testnet ? TESTNET : opt_devnet ? DEVNET : MAINNET;
+  block_start = command_line::get_arg(vm, arg_block_start);
+  block_stop = command_line::get_arg(vm, arg_block_stop);
+  const fs::path output_dir = fs::u8path(command_line::get_arg(vm, arg_output_dir));
+  const uint64_t range_size = std::max<uint64_t>(1, command_line::get_arg(vm, arg_range_size));
+
+  LOG_PRINT_L0("Initializing source blockchain (BlockchainDB)");
+  blockchain_objects_t blockchain_objects = {};
+  Blockchain *core_storage = &blockchain_objects.m_blockchain;
+  BlockchainDB *db = new_db();
+  if (db == NULL)
+  {
+    LOG_ERROR("Failed to initialize a database");
+    throw std::runtime_error("Failed to initialize a database");
+  }
+
+  const fs::path filename = fs::u8path(opt_data_dir) / db->get_db_name();
+  LOG_PRINT_L0("Loading blockchain from folder " << filename << " ...");
+
+  try
+  {
+    db->open(filename, core_storage->nettype(), DBF_RDONLY);
+  }
+  catch (const std::exception& e)
+  {
+    LOG_PRINT_L0("Error opening database: " << e.what());
+    return 1;
+  }
+  r = core_storage->init(db, nullptr /*ons_db*/, net_type);
+
+  CHECK_AND_ASSERT_MES(r, 1, "Failed to initialize source blockchain storage");
+  LOG_PRINT_L0("Source blockchain storage initialized OK");
+
+  tools::signal_handler::install([](int type) {
+    stop_requested = true;
+  });
+
+  const uint64_t db_height = db->height();
+  if (!block_stop || block_stop > db_height)
+      block_stop = db_height;
+  MINFO("Starting from height " << block_start << ", stopping at height " << block_stop);
+
+  table_writer blocks{output_dir / "blocks"};
+  table_writer txs{output_dir / "txs"};
+
+  // Each round reads one range of blocks per thread, then writes them out in order, so that the
+  // files come out sorted by height without holding more than a round's rows in memory.
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  const size_t threads = tpool.get_max_concurrency();
+  std::vector<range_rows> ranges(threads);
+  std::vector<std::string> errors(threads);
+  uint64_t height = block_start;
+  while (height < block_stop && !stop_requested)
+  {
+    tools::threadpool::waiter waiter;
+    size_t n = 0;
+    for (; n < threads && height < block_stop; n++, height = std::min(height + range_size, block_stop))
+    {
+      tpool.submit(&waiter, [&, n, begin = height, end = std::min(height + range_size, block_stop)] {
+        try
+        {
+          for (uint64_t h = begin; h < end; h++)
+            read_block(*db, net_type, h, ranges[n]);
+        }
+        catch (const std::exception& e)
+        {
+          errors[n] = e.what();
+        }
+      }, true);
+    }
+    waiter.wait(&tpool);
+
+    for (size_t i = 0; i < n; i++)
+    {
+      if (!errors[i].empty())
+      {
+        LOG_ERROR(errors[i]);
+        return 1;
+      }
+      write_blocks(blocks, ranges[i].blocks);
+      write_txs(txs, ranges[i].txs);
+      ranges[i].blocks.clear();
+      ranges[i].txs.clear();
+    }
+    std::cout << "\r" << height << "/" << block_stop << "         \r" << std::flush;
+  }
+  blocks.flush();
+  txs.flush();
+
+  // Written last, so that it only ever describes complete column files
+  fs::ofstream schema{output_dir / "schema.json", std::ios::trunc};
+  schema << "{\"blocks\": ";
+  blocks.write_schema(schema);
+  schema << ", \"txs\": ";
+  txs.write_schema(schema);
+  schema << "}\n";
+  if (!schema)
+  {
+    LOG_ERROR("Failed to write " << output_dir / "schema.json");
+    return 1;
+  }
+
+  LOG_PRINT_L0("Exported blocks " << block_start << " to " << height << " to " << output_dir);
+  core_storage->deinit();
+  return 0;
+
+  CATCH_ENTRY("Analytics export error", 1);
+}
@@ -37,6 +37,7 @@
 #include "common/varint.h"
 #include "common/file.h"
 #include "common/signal_handler.h"
+#include "common/threadpool.h"
 #include "common/hex.h"
 #include "serialization/crypto.h"
 #include "cryptonote_basic/cryptonote_boost_serialization.h"
@@ -721,31 +722,16 @@ static void get_per_amount_outputs(MDB_txn *txn, uint64_t amount, uint64_t &tota
   mdb_cursor_close(cur);
 }
 
-static void inc_per_amount_outputs(MDB_txn *txn, uint64_t amount, uint64_t total, uint64_t spent)
+static void set_per_amount_outputs(MDB_txn *txn, uint64_t amount, uint64_t total, uint64_t spent)
 {
-  MDB_cursor *cur;
-  int dbr = mdb_cursor_open(txn, dbi_per_amount, &cur);
-  CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to open cursor for per amount outputs: " + std::string(mdb_strerror(dbr)));
   MDB_val k, v;
-  mdb_size_t count = 0;
   k.mv_size = sizeof(uint64_t);
   k.mv_data = (void*)&amount;
-  dbr = mdb_cursor_get(cur, &k, &v, MDB_SET);
-  if (dbr == 0)
-  {
-    total += ((const uint64_t*)v.mv_data)[0];
-    spent += ((const uint64_t*)v.mv_data)[1];
-  }
-  else
-  {
-    CHECK_AND_ASSERT_THROW_MES(dbr == MDB_NOTFOUND, "Failed to get per amount outputs: " + std::string(mdb_strerror(dbr)));
-  }
   uint64_t data[2] = {total, spent};
   v.mv_size = 2 * sizeof(uint64_t);
   v.mv_data = (void*)data;
-  dbr = mdb_cursor_put(cur, &k, &v, 0);
+  int dbr = mdb_put(txn, dbi_per_amount, &k, &v, 0);
   CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to write record for per amount outputs: " + std::string(mdb_strerror(dbr)));
-  mdb_cursor_close(cur);
 }
 
 static uint64_t get_processed_txidx(const std::string &name)
@@ -821,12 +807,16 @@ static std::string keep_under_511(const std::string &s)
   return std::string((const char*)&hash, 32);
 }
 
-static uint64_t get_ring_instances(MDB_txn *txn, uint64_t amount, const std::vector<uint64_t> &ring)
+static std::string ring_instances_key(uint64_t amount, const std::vector<uint64_t> &ring)
+{
+  return keep_under_511(compress_ring(amount, ring));
+}
+
+static uint64_t get_ring_instances(MDB_txn *txn, const std::string &key)
 {
-  const std::string sring = keep_under_511(compress_ring(amount, ring));
   MDB_val k, v;
-  k.mv_data = (void*)sring.data();
-  k.mv_size = sring.size();
+  k.mv_data = (void*)key.data();
+  k.mv_size = key.size();
   int dbr = mdb_get(txn, dbi_ring_instances, &k, &v);
   if (dbr == MDB_NOTFOUND)
     return 0;
@@ -834,13 +824,26 @@ static uint64_t get_ring_instances(MDB_txn *txn, uint64_t amount, const std::vec
   return *(const uint64_t*)v.mv_data;
 }
 
-static uint64_t get_ring_subset_instances(MDB_txn *txn, uint64_t amount, const std::vector<uint64_t> &ring)
+static void set_ring_instances(MDB_txn *txn, const std::string &key, uint64_t count)
 {
-  uint64_t instances = get_ring_instances(txn, amount, ring);
+  MDB_val k, v;
+  k.mv_data = (void*)key.data();
+  k.mv_size = key.size();
+  v.mv_data = &count;
+  v.mv_size = sizeof(count);
+  int dbr = mdb_put(txn, dbi_ring_instances, &k, &v, 0);
+  CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to set ring instances: " + std::string(mdb_strerror(dbr)));
+}
+
+// The keys of the ring's proper, non empty subsets (none for rings of more than 11, which have too
+// many to check)
+static std::vector<std::string> ring_subset_keys(uint64_t amount, const std::vector<uint64_t> &ring)
+{
+  std::vector<std::string> keys;
   if (ring.size() > 11)
-    return instances;
+    return keys;
 
-  uint64_t extra = 0;
+  keys.reserve((((uint64_t)1) << ring.size()) - 2);
   std::vector<uint64_t> subset;
   subset.reserve(ring.size());
   for (uint64_t mask = 1; mask < (((uint64_t)1) << ring.size()) - 1; ++mask)
@@ -849,33 +852,9 @@ static uint64_t get_ring_subset_instances(MDB_txn *txn, uint64_t amount, const s
     for (size_t i = 0; i < ring.size(); ++i)
       if ((mask >> i) & 1)
         subset.push_back(ring[i]);
-    extra += get_ring_instances(txn, amount, subset);
+    keys.push_back(ring_instances_key(amount, subset));
   }
-  return instances + extra;
-}
-
-static uint64_t inc_ring_instances(MDB_txn *txn, uint64_t amount, const std::vector<uint64_t> &ring)
-{
-  const std::string sring = keep_under_511(compress_ring(amount, ring));
-  MDB_val k, v;
-  k.mv_data = (void*)sring.data();
-  k.mv_size = sring.size();
-
-  int dbr = mdb_get(txn, dbi_ring_instances, &k, &v);
-  CHECK_AND_ASSERT_THROW_MES(!dbr || dbr == MDB_NOTFOUND, "Failed to get ring instances: " + std::string(mdb_strerror(dbr)));
-
-  uint64_t count;
-  if (dbr == MDB_NOTFOUND)
-    count = 1;
-  else
-    count = 1 + *(const uint64_t*)v.mv_data;
-
-  v.mv_data = &count;
-  v.mv_size = sizeof(count);
-  dbr = mdb_put(txn, dbi_ring_instances, &k, &v, 0);
-  CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to set ring instances: " + std::string(mdb_strerror(dbr)));
-
-  return count;
+  return keys;
 }
 
 static std::vector<crypto::key_image> get_key_images(MDB_txn *txn, const output_data &od)
@@ -951,6 +930,104 @@ static void inc_stat(MDB_txn *txn, const char *key)
   set_stat(txn, key, data);
 }
 
+// The parts of the analysis of a tx input which only depend on the input itself, worked out for a
+// whole batch of txs at once on all threads, before the batch goes through the rings db in order.
+struct ring_input
+{
+  const txin_to_key *in;
+  std::vector<uint64_t> absolute;
+  std::vector<uint64_t> new_ring; // canonical relative offsets
+  std::string key; // of new_ring, in the ring instances db
+  std::vector<std::string> subset_keys; // with --check-subsets
+};
+
+static std::vector<ring_input> get_ring_inputs(const cryptonote::transaction_prefix &tx, bool rct_only, bool check_subsets)
+{
+  std::vector<ring_input> ring_inputs;
+  for (const auto &in: tx.vin)
+  {
+    const auto* txinp = std::get_if<txin_to_key>(&in);
+    if (!txinp || (rct_only && txinp->amount != 0))
+      continue;
+    auto &ri = ring_inputs.emplace_back();
+    ri.in = txinp;
+    ri.absolute = cryptonote::relative_output_offsets_to_absolute(txinp->key_offsets);
+    ri.new_ring = canonicalize(txinp->key_offsets);
+    ri.key = ring_instances_key(txinp->amount, ri.new_ring);
+    if (check_subsets)
+      ri.subset_keys = ring_subset_keys(txinp->amount, ri.new_ring);
+  }
+  return ring_inputs;
+}
+
+// The ring instance and per amount output counts, and the stats, as updated by a batch of txs:
+// every input reads and updates some of them, so they are kept here until the batch is committed
+// and then written out once each, in key order.
+class batch_counts
+{
+public:
+  uint64_t ring_instances(MDB_txn *txn, const std::string &key) const
+  {
+    auto it = rings.find(key);
+    return it != rings.end() ? it->second : get_ring_instances(txn, key);
+  }
+
+  uint64_t inc_ring_instances(MDB_txn *txn, const std::string &key)
+  {
+    auto [it, inserted] = rings.emplace(key, 0);
+    if (inserted)
+      it->second = get_ring_instances(txn, key);
+    return ++it->second;
+  }
+
+  void per_amount_outputs(MDB_txn *txn, uint64_t amount, uint64_t &total, uint64_t &spent)
+  {
+    auto &pa = get_per_amount(txn, amount);
+    total = pa.first;
+    spent = pa.second;
+  }
+
+  void inc_per_amount_outputs(MDB_txn *txn, uint64_t amount, uint64_t total, uint64_t spent)
+  {
+    auto &pa = get_per_amount(txn, amount);
+    pa.first += total;
+    pa.second += spent;
+  }
+
+  void inc_stat(const char *key) { ++stats[key]; }
+
+  void flush(MDB_txn *txn)
+  {
+    for (const auto &[key, count]: rings)
+      set_ring_instances(txn, key, count);
+    for (const auto &[amount, pa]: per_amount)
+      set_per_amount_outputs(txn, amount, pa.first, pa.second);
+    for (const auto &[key, inc]: stats)
+    {
+      uint64_t data;
+      if (!get_stat(txn, key.c_str(), data))
+        data = 0;
+      set_stat(txn, key.c_str(), data + inc);
+    }
+    rings.clear();
+    per_amount.clear();
+    stats.clear();
+  }
+
+private:
+  std::pair<uint64_t, uint64_t> &get_per_amount(MDB_txn *txn, uint64_t amount)
+  {
+    auto [it, inserted] = per_amount.emplace(amount, std::make_pair(0, 0));
+    if (inserted)
+      get_per_amount_outputs(txn, amount, it->second.first, it->second.second);
+    return it->second;
+  }
+
+  std::map<std::string, uint64_t> rings;
+  std::map<uint64_t, std::pair<uint64_t, uint64_t>> per_amount; // total, spent
+  std::map<std::string, uint64_t> stats;
+};
+
 static void open_db(const fs::path& filename, MDB_env** env, MDB_txn** txn, MDB_cursor** cur, MDB_dbi* dbi)
 {
   std::error_code ec;
@@ -1420,177 +1497,205 @@ int main(int argc, char* argv[])
     MDB_cursor *cur;
     dbr = mdb_cursor_open(txn, dbi_spent, &cur);
     CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to open LMDB cursor: " + std::string(mdb_strerror(dbr)));
-    size_t records = 0;
     std::vector<std::pair<uint64_t, uint64_t>> blackballs;
     uint64_t n_txes;
-    for_all_transactions(inputs[n], start_idx, n_txes, [&](const cryptonote::transaction_prefix &tx)->bool
+    std::vector<std::pair<uint64_t, cryptonote::transaction_prefix>> batch; // tx idx, tx
+    batch_counts counts;
+    // Goes through the txs read since the last one, and commits them along with the index to resume
+    // from, so that a run stopped (or killed) in the middle picks up from the last batch committed.
+    const auto process_batch = [&]
     {
-      std::cout << "\r" << start_idx << "/" << n_txes << "         \r" << std::flush;
-      for (const auto &in: tx.vin)
+      if (batch.empty())
+        return;
+
+      std::vector<std::vector<ring_input>> ring_inputs(batch.size());
+      tools::threadpool& tpool = tools::threadpool::getInstance();
+      tools::threadpool::waiter waiter;
+      const size_t threads = std::min<size_t>(tpool.get_max_concurrency(), batch.size());
+      for (size_t t = 0; t < threads; ++t)
+        tpool.submit(&waiter, [&, t] {
+          for (size_t i = t; i < batch.size(); i += threads)
+            ring_inputs[i] = get_ring_inputs(batch[i].second, opt_rct_only, opt_check_subsets);
+        }, true);
+      waiter.wait(&tpool);
+
+      for (size_t i = 0; i < batch.size(); ++i)
       {
-        const auto* txinp = std::get_if<txin_to_key>(&in);
-        if (!txinp || (opt_rct_only && txinp->amount != 0))
-          continue;
-        auto& txin = *txinp;
-
-        const std::vector<uint64_t> absolute = cryptonote::relative_output_offsets_to_absolute(txin.key_offsets);
-        if (n == 0)
-          for (uint64_t out: absolute)
-            add_key_image(txn, output_data(txin.amount, out), txin.k_image);
-
-        std::vector<uint64_t> relative_ring;
-        std::vector<uint64_t> new_ring = canonicalize(txin.key_offsets);
-        const uint32_t ring_size = txin.key_offsets.size();
-        const uint64_t instances = inc_ring_instances(txn, txin.amount, new_ring);
-        uint64_t pa_total = 0, pa_spent = 0;
-        if (!opt_rct_only)
-          get_per_amount_outputs(txn, txin.amount, pa_total, pa_spent);
-        if (n == 0 && ring_size == 1)
-        {
-          const std::pair<uint64_t, uint64_t> output = std::make_pair(txin.amount, absolute[0]);
-          if (opt_verbose)
-          {
-            MINFO("Marking output " << output.first << "/" << output.second << " as spent, due to being used in a 1-ring");
-            std::cout << "\r" << start_idx << "/" << n_txes << "         \r" << std::flush;
-          }
-          blackballs.push_back(output);
-          if (add_spent_output(cur, output_data(txin.amount, absolute[0])))
-            inc_stat(txn, txin.amount ? "pre-rct-ring-size-1" : "rct-ring-size-1");
-        }
-        else if (n == 0 && instances == new_ring.size())
+        const uint64_t tx_idx = batch[i].first;
+        const cryptonote::transaction_prefix &tx = batch[i].second;
+        for (auto &ri: ring_inputs[i])
         {
-          for (size_t o = 0; o < new_ring.size(); ++o)
+          auto& txin = *ri.in;
+          const std::vector<uint64_t> &absolute = ri.absolute;
+          if (n == 0)
+            for (uint64_t out: absolute)
+              add_key_image(txn, output_data(txin.amount, out), txin.k_image);
+
+          std::vector<uint64_t> relative_ring;
+          std::vector<uint64_t> &new_ring = ri.new_ring;
+          const uint32_t ring_size = txin.key_offsets.size();
+          const uint64_t instances = counts.inc_ring_instances(txn, ri.key);
+          uint64_t pa_total = 0, pa_spent = 0;
+          if (!opt_rct_only)
+            counts.per_amount_outputs(txn, txin.amount, pa_total, pa_spent);
+          const auto subset_instances = [&] {
+            uint64_t total = counts.ring_instances(txn, ri.key);
+            for (const auto &key: ri.subset_keys)
+              total += counts.ring_instances(txn, key);
+            return total;
+          };
+          if (n == 0 && ring_size == 1)
           {
-            const std::pair<uint64_t, uint64_t> output = std::make_pair(txin.amount, absolute[o]);
+            const std::pair<uint64_t, uint64_t> output = std::make_pair(txin.amount, absolute[0]);
             if (opt_verbose)
             {
-              MINFO("Marking output " << output.first << "/" << output.second << " as spent, due to being used in " << new_ring.size() << " identical " << new_ring.size() << "-rings");
-              std::cout << "\r" << start_idx << "/" << n_txes << "         \r" << std::flush;
+              MINFO("Marking output " << output.first << "/" << output.second << " as spent, due to being used in a 1-ring");
+              std::cout << "\r" << tx_idx << "/" << n_txes << "         \r" << std::flush;
             }
             blackballs.push_back(output);
-            if (add_spent_output(cur, output_data(txin.amount, absolute[o])))
-              inc_stat(txn, txin.amount ? "pre-rct-duplicate-rings" : "rct-duplicate-rings");
+            if (add_spent_output(cur, output_data(txin.amount, absolute[0])))
+              counts.inc_stat(txin.amount ? "pre-rct-ring-size-1" : "rct-ring-size-1");
           }
-        }
-        else if (n == 0 && !opt_rct_only && pa_spent + 1 == pa_total)
-        {
-          for (size_t o = 0; o < pa_total; ++o)
+          else if (n == 0 && instances == new_ring.size())
           {
-            const std::pair<uint64_t, uint64_t> output = std::make_pair(txin.amount, o);
-            if (opt_verbose)
+            for (size_t o = 0; o < new_ring.size(); ++o)
             {
-              MINFO("Marking output " << output.first << "/" << output.second << " as spent, due to as many outputs of that amount being spent as exist so far");
-              std::cout << "\r" << start_idx << "/" << n_txes << "         \r" << std::flush;
+              const std::pair<uint64_t, uint64_t> output = std::make_pair(txin.amount, absolute[o]);
+              if (opt_verbose)
+              {
+                MINFO("Marking output " << output.first << "/" << output.second << " as spent, due to being used in " << new_ring.size() << " identical " << new_ring.size() << "-rings");
+                std::cout << "\r" << tx_idx << "/" << n_txes << "         \r" << std::flush;
+              }
+              blackballs.push_back(output);
+              if (add_spent_output(cur, output_data(txin.amount, absolute[o])))
+                counts.inc_stat(txin.amount ? "pre-rct-duplicate-rings" : "rct-duplicate-rings");
             }
-            blackballs.push_back(output);
-            if (add_spent_output(cur, output_data(txin.amount, o)))
-              inc_stat(txn, txin.amount ? "pre-rct-full-count" : "rct-full-count");
           }
-        }
-        else if (n == 0 && opt_check_subsets && get_ring_subset_instances(txn, txin.amount, new_ring) >= new_ring.size())
-        {
-          for (size_t o = 0; o < new_ring.size(); ++o)
+          else if (n == 0 && !opt_rct_only && pa_spent + 1 == pa_total)
           {
-            const std::pair<uint64_t, uint64_t> output = std::make_pair(txin.amount, absolute[o]);
-            if (opt_verbose)
+            for (size_t o = 0; o < pa_total; ++o)
             {
-              MINFO("Marking output " << output.first << "/" << output.second << " as spent, due to being used in " << new_ring.size() << " subsets of " << new_ring.size() << "-rings");
-              std::cout << "\r" << start_idx << "/" << n_txes << "         \r" << std::flush;
+              const std::pair<uint64_t, uint64_t> output = std::make_pair(txin.amount, o);
+              if (opt_verbose)
+              {
+                MINFO("Marking output " << output.first << "/" << output.second << " as spent, due to as many outputs of that amount being spent as exist so far");
+                std::cout << "\r" << tx_idx << "/" << n_txes << "         \r" << std::flush;
+              }
+              blackballs.push_back(output);
+              if (add_spent_output(cur, output_data(txin.amount, o)))
+                counts.inc_stat(txin.amount ? "pre-rct-full-count" : "rct-full-count");
             }
-            blackballs.push_back(output);
-            if (add_spent_output(cur, output_data(txin.amount, absolute[o])))
-              inc_stat(txn, txin.amount ? "pre-rct-subset-rings" : "rct-subset-rings");
           }
-        }
-        else if (n > 0 && get_relative_ring(txn, txin.k_image, relative_ring))
-        {
-          MDEBUG("Key image " << txin.k_image << " already seen: "
-              "rings " << tools::join(" ", relative_ring) << ", " << tools::join(" ", txin.key_offsets));
-          std::cout << "\r" << start_idx << "/" << n_txes << "         \r" << std::flush;
-          if (relative_ring != txin.key_offsets)
+          else if (n == 0 && opt_check_subsets && subset_instances() >= new_ring.size())
           {
-            MDEBUG("Rings are different");
-            std::cout << "\r" << start_idx << "/" << n_txes << "         \r" << std::flush;
-            const std::vector<uint64_t> r0 = cryptonote::relative_output_offsets_to_absolute(relative_ring);
-            const std::vector<uint64_t> r1 = cryptonote::relative_output_offsets_to_absolute(txin.key_offsets);
-            std::vector<uint64_t> common;
-            for (uint64_t out: r0)
-            {
-              if (std::find(r1.begin(), r1.end(), out) != r1.end())
-                common.push_back(out);
-            }
-            if (common.empty())
+            for (size_t o = 0; o < new_ring.size(); ++o)
             {
-              MERROR("Rings for the same key image are disjoint");
-              std::cout << "\r" << start_idx << "/" << n_txes << "         \r" << std::flush;
-            }
-            else if (common.size() == 1)
-            {
-              const std::pair<uint64_t, uint64_t> output = std::make_pair(txin.amount, common[0]);
+              const std::pair<uint64_t, uint64_t> output = std::make_pair(txin.amount, absolute[o]);
               if (opt_verbose)
               {
-                MINFO("Marking output " << output.first << "/" << output.second << " as spent, due to being used in rings with a single common element");
-                std::cout << "\r" << start_idx << "/" << n_txes << "         \r" << std::flush;
+                MINFO("Marking output " << output.first << "/" << output.second << " as spent, due to being used in " << new_ring.size() << " subsets of " << new_ring.size() << "-rings");
+                std::cout << "\r" << tx_idx << "/" << n_txes << "         \r" << std::flush;
               }
               blackballs.push_back(output);
-              if (add_spent_output(cur, output_data(txin.amount, common[0])))
-                inc_stat(txn, txin.amount ? "pre-rct-key-image-attack" : "rct-key-image-attack");
+              if (add_spent_output(cur, output_data(txin.amount, absolute[o])))
+                counts.inc_stat(txin.amount ? "pre-rct-subset-rings" : "rct-subset-rings");
             }
-            else
+          }
+          else if (n > 0 && get_relative_ring(txn, txin.k_image, relative_ring))
+          {
+            MDEBUG("Key image " << txin.k_image << " already seen: "
+                "rings " << tools::join(" ", relative_ring) << ", " << tools::join(" ", txin.key_offsets));
+            std::cout << "\r" << tx_idx << "/" << n_txes << "         \r" << std::flush;
+            if (relative_ring != txin.key_offsets)
             {
-              MDEBUG("The intersection has more than one element, it's still ok");
-              std::cout << "\r" << start_idx << "/" << n_txes << "         \r" << std::flush;
-              for (const auto &out: r0)
-                if (std::find(common.begin(), common.end(), out) != common.end())
-                  new_ring.push_back(out);
-              new_ring = cryptonote::absolute_output_offsets_to_relative(new_ring);
+              MDEBUG("Rings are different");
+              std::cout << "\r" << tx_idx << "/" << n_txes << "         \r" << std::flush;
+              const std::vector<uint64_t> r0 = cryptonote::relative_output_offsets_to_absolute(relative_ring);
+              const std::vector<uint64_t> r1 = cryptonote::relative_output_offsets_to_absolute(txin.key_offsets);
+              std::vector<uint64_t> common;
+              for (uint64_t out: r0)
+              {
+                if (std::find(r1.begin(), r1.end(), out) != r1.end())
+                  common.push_back(out);
+              }
+              if (common.empty())
+              {
+                MERROR("Rings for the same key image are disjoint");
+                std::cout << "\r" << tx_idx << "/" << n_txes << "         \r" << std::flush;
+              }
+              else if (common.size() == 1)
+              {
+                const std::pair<uint64_t, uint64_t> output = std::make_pair(txin.amount, common[0]);
+                if (opt_verbose)
+                {
+                  MINFO("Marking output " << output.first << "/" << output.second << " as spent, due to being used in rings with a single common element");
+                  std::cout << "\r" << tx_idx << "/" << n_txes << "         \r" << std::flush;
+                }
+                blackballs.push_back(output);
+                if (add_spent_output(cur, output_data(txin.amount, common[0])))
+                  counts.inc_stat(txin.amount ? "pre-rct-key-image-attack" : "rct-key-image-attack");
+              }
+              else
+              {
+                MDEBUG("The intersection has more than one element, it's still ok");
+                std::cout << "\r" << tx_idx << "/" << n_txes << "         \r" << std::flush;
+                for (const auto &out: r0)
+                  if (std::find(common.begin(), common.end(), out) != common.end())
+                    new_ring.push_back(out);
+                new_ring = cryptonote::absolute_output_offsets_to_relative(new_ring);
+              }
             }
           }
+          if (n == 0)
+          {
+            set_relative_ring(txn, txin.k_image, new_ring);
+            if (!opt_rct_only)
+              counts.inc_per_amount_outputs(txn, txin.amount, 0, 1);
+          }
         }
-        if (n == 0)
-        {
-          set_relative_ring(txn, txin.k_image, new_ring);
-          if (!opt_rct_only)
-            inc_per_amount_outputs(txn, txin.amount, 0, 1);
-        }
-      }
-      set_processed_txidx(txn, canonical, start_idx+1);
-      if (!opt_rct_only)
-      {
-        const bool miner_tx = tx.vin.size() == 1 && std::holds_alternative<txin_gen>(tx.vin[0]);
-        for (const auto &out: tx.vout)
+        if (!opt_rct_only)
         {
-          uint64_t amount = out.amount;
-          if (miner_tx && tx.version >= cryptonote::txversion::v2_ringct)
-            amount = 0;
-
-          if (opt_rct_only && amount != 0)
-            continue;
-          if (!std::holds_alternative<txout_to_key>(out.target))
-            continue;
-          inc_per_amount_outputs(txn, amount, 1, 0);
+          const bool miner_tx = tx.vin.size() == 1 && std::holds_alternative<txin_gen>(tx.vin[0]);
+          for (const auto &out: tx.vout)
+          {
+            uint64_t amount = out.amount;
+            if (miner_tx && tx.version >= cryptonote::txversion::v2_ringct)
+              amount = 0;
+
+            if (opt_rct_only && amount != 0)
+              continue;
+            if (!std::holds_alternative<txout_to_key>(out.target))
+              continue;
+            counts.inc_per_amount_outputs(txn, amount, 1, 0);
+          }
         }
       }
 
-      ++records;
-      if (records >= records_per_sync)
+      counts.flush(txn);
+      set_processed_txidx(txn, canonical, batch.back().first + 1);
+      batch.clear();
+      if (!blackballs.empty())
       {
-        if (!blackballs.empty())
-        {
-          ringdb.blackball(blackballs);
-          blackballs.clear();
-        }
-        mdb_cursor_close(cur);
-        dbr = mdb_txn_commit(txn);
-        CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to commit txn creating/opening database: " + std::string(mdb_strerror(dbr)));
-        int dbr = resize_env(cache_dir.string().c_str());
-        CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to resize LMDB database: " + std::string(mdb_strerror(dbr)));
-        dbr = mdb_txn_begin(env, NULL, 0, &txn);
-        CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
-        dbr = mdb_cursor_open(txn, dbi_spent, &cur);
-        CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to open LMDB cursor: " + std::string(mdb_strerror(dbr)));
-        records = 0;
+        ringdb.blackball(blackballs);
+        blackballs.clear();
       }
+      mdb_cursor_close(cur);
+      int dbr = mdb_txn_commit(txn);
+      CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to commit txn creating/opening database: " + std::string(mdb_strerror(dbr)));
+      dbr = resize_env(cache_dir.string().c_str());
+      CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to resize LMDB database: " + std::string(mdb_strerror(dbr)));
+      dbr = mdb_txn_begin(env, NULL, 0, &txn);
+      CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+      dbr = mdb_cursor_open(txn, dbi_spent, &cur);
+      CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to open LMDB cursor: " + std::string(mdb_strerror(dbr)));
+    };
+
+    for_all_transactions(inputs[n], start_idx, n_txes, [&](const cryptonote::transaction_prefix &tx)->bool
+    {
+      std::cout << "\r" << start_idx << "/" << n_txes << "         \r" << std::flush;
+      batch.emplace_back(start_idx, tx);
+      if (batch.size() >= records_per_sync)
+        process_batch();
 
       if (stop_requested)
       {
@@ -1599,6 +1704,7 @@ int main(int argc, char* argv[])
       }
       return true;
     });
+    process_batch();
     mdb_cursor_close(cur);
     dbr = mdb_txn_commit(txn);
     CHECK_AND_ASSERT_THROW_MES(!dbr, "Failed to commit txn creating/opening database: " + std::string(mdb_strerror(dbr)));
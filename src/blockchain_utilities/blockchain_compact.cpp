@@ -0,0 +1,156 @@
+// Copyright (c) 2021, The Oxen Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Writes a compacted copy of the blockchain database.  Pruning (and, in general, popping blocks
+// and the churn of the tx pool) leaves the database full of free pages and its B-trees scattered
+// over the file; the copy has neither.  The copy is taken from a read snapshot, so the daemon can
+// keep running while it is made; the daemon then has to be stopped to swap the copy in.
+
+#include "common/command_line.h"
+#include "common/fs.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "blockchain_db/blockchain_db.h"
+#include "version.h"
+
+#undef OXEN_DEFAULT_LOG_CATEGORY
+#define OXEN_DEFAULT_LOG_CATEGORY "bcutil"
+
+namespace po = boost::program_options;
+using namespace cryptonote;
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+
+  epee::string_tools::set_module_name_and_folder(argv[0]);
+
+  uint32_t log_level = 0;
+
+  tools::on_startup();
+
+  auto opt_size = command_line::boost_option_sizes();
+
+  po::options_description desc_cmd_only("Command line options", opt_size.first, opt_size.second);
+  po::options_description desc_cmd_sett("Command line options and settings options", opt_size.first, opt_size.second);
+  const command_line::arg_descriptor<std::string> arg_log_level  = {"log-level",  "0-4 or categories", ""};
+  const command_line::arg_descriptor<std::string> arg_output_dir = {"output-dir", "Directory to write the compacted database to, default <data-dir>/lmdb-compact", ""};
+
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_data_dir);
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_testnet_on);
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_devnet_on);
+  command_line::add_arg(desc_cmd_sett, arg_log_level);
+  command_line::add_arg(desc_cmd_sett, arg_output_dir);
+  command_line::add_arg(desc_cmd_only, command_line::arg_help);
+
+  po::options_description desc_options("Allowed options");
+  desc_options.add(desc_cmd_only).add(desc_cmd_sett);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (! r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << "Oxen '" << OXEN_RELEASE_NAME << "' (v" << OXEN_VERSION_FULL << ")\n\n";
+    std::cout << desc_options << std::endl;
+    return 1;
+  }
+
+  mlog_configure(mlog_get_default_log_path("oxen-blockchain-compact.log"), true);
+  if (!command_line::is_arg_defaulted(vm, arg_log_level))
+    mlog_set_log(command_line::get_arg(vm, arg_log_level).c_str());
+  else
+    mlog_set_log(std::string(std::to_string(log_level) + ",bcutil:INFO").c_str());
+
+  MINFO("Starting...");
+
+  bool opt_testnet = command_line::get_arg(vm, cryptonote::arg_testnet_on);
+  bool opt_devnet = command_line::get_arg(vm, cryptonote::arg_devnet_on);
+  if (opt_testnet && opt_devnet)
+  {
+    std::cerr << "Can't specify more than one of --testnet and --devnet" << std::endl;
+    return 1;
+  }
+  network_type net_type = opt_testnet ? TESTNET : opt_devnet ? DEVNET : MAINNET;
+
+  auto config_folder = fs::u8path(command_line::get_arg(vm, cryptonote::arg_data_dir));
+
+  std::unique_ptr<BlockchainDB> db{new_db()};
+  if (!db)
+  {
+    MERROR("Failed to initialize a database");
+    return 1;
+  }
+
+  fs::path output_dir = command_line::is_arg_defaulted(vm, arg_output_dir)
+    ? config_folder / (db->get_db_name() + "-compact")
+    : fs::u8path(command_line::get_arg(vm, arg_output_dir));
+  if (fs::exists(output_dir) ? !fs::is_directory(output_dir) : !fs::create_directories(output_dir))
+  {
+    MERROR("LMDB needs a directory path, but " << output_dir << " is not and could not be created as one");
+    return 1;
+  }
+
+  auto filename = config_folder / db->get_db_name();
+  MINFO("Loading blockchain from folder " << filename << " ...");
+  try
+  {
+    db->open(filename, net_type, DBF_RDONLY);
+  }
+  catch (const std::exception& e)
+  {
+    MERROR("Error opening database: " << e.what());
+    return 1;
+  }
+
+  uint64_t const size_before = fs::file_size(filename / CRYPTONOTE_BLOCKCHAINDATA_FILENAME);
+  MINFO("Writing compacted copy of the " << size_before / (1024 * 1024) << " MiB database to " << output_dir << " ...");
+  try
+  {
+    db->copy_compacted(output_dir);
+  }
+  catch (const std::exception& e)
+  {
+    MERROR("Error compacting database: " << e.what());
+    return 1;
+  }
+  db->close();
+
+  uint64_t const size_after = fs::file_size(output_dir / CRYPTONOTE_BLOCKCHAINDATA_FILENAME);
+  MINFO("Compacted database written OK (" << size_after / (1024 * 1024) << " MiB).  Stop the daemon, then replace "
+      << filename << " with " << output_dir << " to use it");
+  return 0;
+
+  CATCH_ENTRY("Compaction error", 1);
+}
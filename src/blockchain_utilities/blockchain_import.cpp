@@ -28,12 +28,22 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <algorithm>
+#include <deque>
 #include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <optional>
+#include <thread>
 
 #include <boost/algorithm/string.hpp>
 #include <unistd.h>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 #include "cryptonote_protocol/quorumnet.h"
 #include "epee/misc_log_ex.h"
 #include "bootstrap_file.h"
@@ -44,6 +54,9 @@
 #include "cryptonote_core/uptime_proof.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "common/hex.h"
+#include "common/threadpool.h"
+#include "common/metrics.h"
+#include "common/util.h"
 
 #undef OXEN_DEFAULT_LOG_CATEGORY
 #define OXEN_DEFAULT_LOG_CATEGORY "bcutil"
@@ -56,6 +69,7 @@ bool opt_verify  = true; // use add_new_block, which does verification before ca
 bool opt_resume  = true;
 bool opt_testnet = true;
 bool opt_devnet = true;
+bool opt_benchmark = false;
 
 // number of blocks per batch transaction
 // adjustable through command-line argument according to available RAM
@@ -72,6 +86,25 @@ uint64_t db_batch_size_verify = 5000;
 
 std::string refresh_string = "\r                                    \r";
 
+// Time spent in each stage of a verified import, reported by --benchmark
+struct stage_timings
+{
+  std::chrono::nanoseconds parse{0};   // reading and deserializing the file (and reserializing for the core)
+  std::chrono::nanoseconds prepare{0}; // prepare_handle_incoming_blocks: block parsing, PoW and hash checks
+  std::chrono::nanoseconds txs{0};     // handle_incoming_txs: tx parsing and ring sig/range proof checks
+  std::chrono::nanoseconds blocks{0};  // handle_incoming_block: adding to the db, SN list and ONS
+  std::chrono::nanoseconds commit{0};  // cleanup_handle_incoming_blocks: committing the batch
+};
+stage_timings timings;
+
+template <typename F>
+auto timed(std::chrono::nanoseconds& total, F&& f)
+{
+  const auto start = std::chrono::steady_clock::now();
+  OXEN_DEFER { total += std::chrono::steady_clock::now() - start; };
+  return f();
+}
+
 const command_line::arg_descriptor<bool> arg_recalculate_difficulty = {
   "recalculate-difficulty",
   "Recalculate per-block difficulty starting from the height specified",
@@ -124,94 +157,252 @@ int pop_blocks(cryptonote::core& core, int num_blocks)
   return num_blocks;
 }
 
-int check_flush(cryptonote::core &core, std::vector<block_complete_entry> &blocks, bool force)
+// Verifies and adds the blocks read from the file on its own thread, a batch at a time, so that
+// reading and deserializing the next batch from the file overlaps with verifying this one.  As
+// when syncing from the network, the PoW of the next batch (if it has been read already) is
+// started as soon as this one is prepared, and each block's txs are parsed and checked together.
+class block_verifier
 {
-  if (blocks.empty())
-    return 0;
-  if (!force && blocks.size() < db_batch_size)
-    return 0;
+public:
+  explicit block_verifier(cryptonote::core& core) : core{core}, thread{[this] { run(); }} {}
+  ~block_verifier() { finish(); }
 
-  // wait till we can verify a full HOH without extra, for speed
-  uint64_t new_height = core.get_blockchain_storage().get_db().height() + blocks.size();
-  if (!force && new_height % HASH_OF_HASHES_STEP)
-    return 0;
+  // Queues a batch of blocks (and their hashes), waiting while the verifier is a batch behind;
+  // returns false (dropping the batch) once verifying has failed.
+  bool push(std::vector<block_complete_entry> blocks, std::vector<crypto::hash> hashes)
+  {
+    std::unique_lock lock{mutex};
+    cv.wait(lock, [this] { return queue.size() < MAX_QUEUED || result; });
+    if (result)
+      return false;
+    queue.push_back({std::move(blocks), std::move(hashes)});
+    cv.notify_all();
+    return true;
+  }
 
-  std::vector<crypto::hash> hashes;
-  for (const auto &b: blocks)
+  // Waits for the queued batches to be added; returns 0, or 1 if one of them failed.
+  int finish()
   {
-    cryptonote::block block;
-    if (!parse_and_validate_block_from_blob(b.block, block))
     {
-      MERROR("Failed to parse block: "
-          << tools::type_to_hex(get_blob_hash(b.block)));
-      core.cleanup_handle_incoming_blocks();
-      return 1;
+      std::lock_guard lock{mutex};
+      done = true;
+      cv.notify_all();
     }
-    hashes.push_back(cryptonote::get_block_hash(block));
+    if (thread.joinable())
+      thread.join();
+    return result;
   }
-  core.prevalidate_block_hashes(core.get_blockchain_storage().get_db().height(), hashes);
 
-  // TODO(doyle): Checkpointing
-  std::vector<block> pblocks;
-  if (!core.prepare_handle_incoming_blocks(blocks, pblocks))
+private:
+  struct batch
   {
-    MERROR("Failed to prepare to add blocks");
-    return 1;
-  }
-  if (!pblocks.empty() && pblocks.size() != blocks.size())
-  {
-    MERROR("Unexpected parsed blocks size");
-    core.cleanup_handle_incoming_blocks();
-    return 1;
-  }
+    std::vector<block_complete_entry> blocks;
+    std::vector<crypto::hash> hashes;
+  };
 
-  size_t blockidx = 0;
-  for(const block_complete_entry& block_entry: blocks)
+  // Batches read ahead, on top of the one being verified
+  static constexpr size_t MAX_QUEUED = 1;
+
+  void run()
   {
-    // process transactions
-    for(auto& tx_blob: block_entry.txs)
+    std::unique_lock lock{mutex};
+    while (!result)
     {
-      tx_verification_context tvc{};
-      core.handle_incoming_tx(tx_blob, tvc, tx_pool_options::from_block());
-      if(tvc.m_verifivation_failed)
-      {
-        MERROR("transaction verification failed, tx_id = "
-            << tools::type_to_hex(get_blob_hash(tx_blob)));
-        core.cleanup_handle_incoming_blocks();
-        return 1;
-      }
+      cv.wait(lock, [this] { return !queue.empty() || done; });
+      if (queue.empty())
+        break;
+      batch b = std::move(queue.front());
+      queue.pop_front();
+      cv.notify_all();
+      lock.unlock();
+      int r = add_batch(b);
+      lock.lock();
+      result = r;
     }
+    cv.notify_all();
+  }
 
-    // process block
-
-    block_verification_context bvc{};
-
-    core.handle_incoming_block(block_entry.block, pblocks.empty() ? NULL : &pblocks[blockidx++], bvc, nullptr /*checkpoint*/, false); // <--- process block
+  int add_batch(batch& b)
+  {
+    const uint64_t height = core.get_blockchain_storage().get_db().height();
+    core.prevalidate_block_hashes(height, b.hashes);
 
-    if(bvc.m_verifivation_failed)
+    // TODO(doyle): Checkpointing
+    std::vector<block> pblocks;
+    if (!timed(timings.prepare, [&] { return core.prepare_handle_incoming_blocks(b.blocks, pblocks); }))
     {
-      MERROR("Block verification failed, id = "
-          << tools::type_to_hex(get_blob_hash(block_entry.block)));
-      core.cleanup_handle_incoming_blocks();
+      MERROR("Failed to prepare to add blocks");
       return 1;
     }
-    if(bvc.m_marked_as_orphaned)
+    OXEN_DEFER { timed(timings.commit, [this] { core.cleanup_handle_incoming_blocks(); }); };
+    if (!pblocks.empty() && pblocks.size() != b.blocks.size())
     {
-      MERROR("Block received at sync phase was marked as orphaned");
-      core.cleanup_handle_incoming_blocks();
+      MERROR("Unexpected parsed blocks size");
       return 1;
     }
 
-  } // each download block
-  if (!core.cleanup_handle_incoming_blocks())
-    return 1;
+    // Overlap the PoW hashing of the next batch (if we already have it) with adding this one
+    {
+      std::lock_guard lock{mutex};
+      if (!pblocks.empty() && !queue.empty())
+        core.precompute_block_longhashes(height + b.blocks.size(), queue.front().blocks);
+    }
+
+    size_t blockidx = 0;
+    for (const block_complete_entry& block_entry: b.blocks)
+    {
+      // process transactions
+      auto parsed_txs = timed(timings.txs, [&] { return core.handle_incoming_txs(block_entry.txs, tx_pool_options::from_block()); });
+      for (size_t i = 0; i < parsed_txs.size(); i++)
+      {
+        if (parsed_txs[i].tvc.m_verifivation_failed)
+        {
+          MERROR("transaction verification failed, tx_id = "
+              << tools::type_to_hex(get_blob_hash(block_entry.txs[i])));
+          return 1;
+        }
+      }
 
-  blocks.clear();
+      // process block
+
+      block_verification_context bvc{};
+
+      timed(timings.blocks, [&] {
+        core.handle_incoming_block(block_entry.block, pblocks.empty() ? NULL : &pblocks[blockidx++], bvc, nullptr /*checkpoint*/, false); // <--- process block
+      });
+
+      if(bvc.m_verifivation_failed)
+      {
+        MERROR("Block verification failed, id = "
+            << tools::type_to_hex(get_blob_hash(block_entry.block)));
+        return 1;
+      }
+      if(bvc.m_marked_as_orphaned)
+      {
+        MERROR("Block received at sync phase was marked as orphaned");
+        return 1;
+      }
+
+    } // each download block
+    return 0;
+  }
+
+  cryptonote::core& core;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<batch> queue;
+  bool done = false;
+  int result = 0;
+  std::thread thread; // Last, so that it starts once the rest is set up
+};
+
+// Chunks read (and parsed) at once from an indexed file
+constexpr uint64_t PARSE_AHEAD_CHUNKS = 1000;
+
+// The number of bytes of the `n` chunks from `begin` (or up to the end of the file)
+uint64_t indexed_bytes(const std::vector<BootstrapFile::chunk_location>& index, uint64_t begin, uint64_t n)
+{
+  if (begin >= index.size() || n == 0)
+    return 0;
+  const auto& last = index[std::min<uint64_t>(index.size(), begin + n) - 1];
+  return last.offset + last.size - (index[begin].offset - sizeof(uint32_t));
+}
+
+// Reads the chunks [begin, end) of an indexed file in one go, and parses them in parallel
+std::vector<bootstrap::block_package> read_indexed_chunks(fs::ifstream& import_file,
+    const std::vector<BootstrapFile::chunk_location>& index, uint64_t begin, uint64_t end)
+{
+  const uint64_t from = index[begin].offset;
+  std::string data(index[end - 1].offset + index[end - 1].size - from, '\0');
+  import_file.seekg(from);
+  import_file.read(data.data(), data.size());
+  if (!import_file)
+    throw std::runtime_error("Error reading chunks " + std::to_string(begin) + "-" + std::to_string(end - 1));
+
+  std::vector<bootstrap::block_package> result(end - begin);
+  std::atomic<bool> failed = false;
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  const size_t per_thread = (result.size() + tpool.get_max_concurrency() - 1) / tpool.get_max_concurrency();
+  tools::threadpool::waiter waiter;
+  for (size_t first = 0; first < result.size(); first += per_thread)
+  {
+    tpool.submit(&waiter, [&, first] {
+      for (size_t i = first; i < std::min(result.size(), first + per_thread) && !failed; i++)
+      {
+        const auto& chunk = index[begin + i];
+        try {
+          serialization::parse_binary(std::string_view{data}.substr(chunk.offset - from, chunk.size), result[i]);
+        } catch (const std::exception& e) {
+          MERROR("Error in deserialization of chunk " << begin + i << ": " << e.what());
+          failed = true;
+        }
+      }
+    }, true);
+  }
+  waiter.wait(&tpool);
+  if (failed)
+    throw std::runtime_error("Error in deserialization of chunk");
+  return result;
+}
+
+// Peak resident set size of this process in bytes, or 0 if unknown
+uint64_t peak_rss()
+{
+#ifndef _WIN32
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return usage.ru_maxrss * uint64_t{1024};
+#endif
+#endif
   return 0;
 }
 
+void print_benchmark(uint64_t num_blocks, std::chrono::steady_clock::duration elapsed)
+{
+  auto secs = [](auto d) { return std::chrono::duration<double>(d).count(); };
+  std::cout << std::fixed << std::setprecision(3)
+    << "\nImported " << num_blocks << " blocks in " << secs(elapsed) << "s: "
+    << std::setprecision(1) << (elapsed.count() ? num_blocks / secs(elapsed) : 0) << " blocks/s\n\n"
+    << std::setprecision(3)
+    << "Stage               " << std::setw(10) << "Time (s)" << "\n"
+    << "parse               " << std::setw(10) << secs(timings.parse) << "\n"
+    << "prepare (PoW)       " << std::setw(10) << secs(timings.prepare) << "\n"
+    << "txs (sigs, proofs)  " << std::setw(10) << secs(timings.txs) << "\n"
+    << "blocks (db, SN, ONS)" << std::setw(10) << secs(timings.blocks) << "\n"
+    << "db commit           " << std::setw(10) << secs(timings.commit) << "\n";
+
+  // Every PERF_TIMER feeds a histogram in the metrics registry, which gives the breakdown within
+  // (and across, e.g. for work on the threadpool) the stages above
+  struct timer { std::string name; uint64_t count, sum; };
+  std::vector<timer> timers;
+  tools::metrics::for_each_histogram([&](std::string_view name, std::string_view category, const tools::metrics::histogram& h) {
+    if (h.count())
+      timers.push_back({std::string{category} + "/" + std::string{name}, h.count(), h.sum()});
+  });
+  std::sort(timers.begin(), timers.end(), [](const timer& a, const timer& b) { return a.sum > b.sum; });
+  if (timers.size() > 25)
+    timers.resize(25);
+  if (!timers.empty())
+  {
+    std::cout << "\n" << std::left << std::setw(48) << "Performance timer" << std::right
+      << std::setw(12) << "Count" << std::setw(14) << "Total (s)" << std::setw(12) << "Mean (ms)" << "\n";
+    for (const auto& t : timers)
+      std::cout << std::left << std::setw(48) << t.name << std::right << std::setw(12) << t.count
+        << std::setw(14) << t.sum / 1e9 << std::setw(12) << t.sum / 1e6 / t.count << "\n";
+  }
+
+  if (uint64_t rss = peak_rss())
+    std::cout << "\nPeak RSS: " << std::setprecision(1) << rss / 1048576.0 << " MiB\n";
+  std::cout << std::defaultfloat << std::flush;
+}
+
 int import_from_file(cryptonote::core& core, const fs::path& import_file_path, uint64_t block_stop=0)
 {
+  const auto import_start = std::chrono::steady_clock::now();
+
   // Reset stats, in case we're using newly created db, accumulating stats
   // from addition of genesis block.
   // This aligns internal db counts with importer counts.
@@ -231,7 +422,18 @@ int import_from_file(cryptonote::core& core, const fs::path& import_file_path, u
   BootstrapFile bootstrap;
   std::streampos pos;
   // BootstrapFile bootstrap(import_file_path);
-  uint64_t total_source_blocks = bootstrap.count_blocks(import_file_path, pos, seek_height);
+  // With an index we can go straight to any height, and read and parse many chunks at once;
+  // otherwise we have to scan the file (and then read it a chunk at a time).
+  const auto index = BootstrapFile::load_index(import_file_path);
+  uint64_t total_source_blocks;
+  if (!index.empty())
+  {
+    total_source_blocks = index.size() * NUM_BLOCKS_PER_CHUNK;
+    if (seek_height < index.size())
+      pos = index[seek_height].offset - sizeof(uint32_t);
+  }
+  else
+    total_source_blocks = bootstrap.count_blocks(import_file_path, pos, seek_height);
   MINFO("bootstrap file last block number: " << total_source_blocks-1 << " (zero-based height)  total blocks: " << total_source_blocks);
 
   if (total_source_blocks-1 <= start_height)
@@ -278,11 +480,23 @@ int import_from_file(cryptonote::core& core, const fs::path& import_file_path, u
   std::cout << "\n";
 
   std::vector<block_complete_entry> blocks;
+  std::vector<crypto::hash> block_hashes;
+  std::deque<bootstrap::block_package> parsed; // read ahead from an indexed file
+  std::optional<block_verifier> verifier;
+  if (opt_verify)
+    verifier.emplace(core);
 
   uint64_t h = 0;
   uint64_t num_imported = 0;
 
   // Skip to start_height before we start adding.
+  if (!index.empty())
+  {
+    import_file.seekg(pos);
+    bytes_read = pos;
+    h = start_height;
+  }
+  else
   {
     bool q2 = false;
     import_file.seekg(pos);
@@ -299,64 +513,91 @@ int import_from_file(cryptonote::core& core, const fs::path& import_file_path, u
   {
     uint64_t bytes, h2;
     bool q2;
-    pos = import_file.tellg();
-    bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
-    if (import_file.eof())
-      import_file.clear();
-    import_file.seekg(pos);
+    if (!index.empty())
+      bytes = indexed_bytes(index, h, db_batch_size);
+    else
+    {
+      pos = import_file.tellg();
+      bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
+      if (import_file.eof())
+        import_file.clear();
+      import_file.seekg(pos);
+    }
     core.get_blockchain_storage().get_db().batch_start(db_batch_size, bytes);
   }
   while (! quit)
   {
-    uint32_t chunk_size;
-    import_file.read(buffer1, sizeof(chunk_size));
-    // TODO: bootstrap.read_chunk();
-    if (! import_file) {
-      std::cout << refresh_string;
-      MINFO("End of file reached");
-      quit = 1;
-      break;
-    }
-    bytes_read += sizeof(chunk_size);
-
-    try {
-      serialization::parse_binary(std::string_view{buffer1, sizeof(chunk_size)}, chunk_size);
-    } catch (const std::exception& e) {
-      throw std::runtime_error("Error in deserialization of chunk size: "s + e.what());
-    }
-    MDEBUG("chunk_size: " << chunk_size);
-
-    if (chunk_size > BUFFER_SIZE)
+    uint32_t chunk_size = 0;
+    if (!index.empty())
     {
-      MWARNING("WARNING: chunk_size " << chunk_size << " > BUFFER_SIZE " << BUFFER_SIZE);
-      throw std::runtime_error("Aborting: chunk size exceeds buffer size");
+      if (parsed.empty() && h < index.size() && h <= block_stop)
+      {
+        auto chunks = timed(timings.parse, [&] {
+          return read_indexed_chunks(import_file, index, h, std::min<uint64_t>({index.size(), block_stop + 1, h + PARSE_AHEAD_CHUNKS}));
+        });
+        bytes_read += indexed_bytes(index, h, chunks.size());
+        for (auto& bp : chunks)
+          parsed.push_back(std::move(bp));
+      }
+      if (parsed.empty() && h >= index.size())
+      {
+        std::cout << refresh_string;
+        MINFO("End of file reached");
+        quit = 1;
+        break;
+      }
     }
-    if (chunk_size > CHUNK_SIZE_WARNING_THRESHOLD)
+    else
     {
-      MINFO("NOTE: chunk_size " << chunk_size << " > " << CHUNK_SIZE_WARNING_THRESHOLD);
-    }
-    else if (chunk_size == 0) {
-      MFATAL("ERROR: chunk_size == 0");
-      return 2;
-    }
-    import_file.read(buffer_block, chunk_size);
-    if (! import_file) {
-      if (import_file.eof())
-      {
+      import_file.read(buffer1, sizeof(chunk_size));
+      // TODO: bootstrap.read_chunk();
+      if (! import_file) {
         std::cout << refresh_string;
-        MINFO("End of file reached - file was truncated");
+        MINFO("End of file reached");
         quit = 1;
         break;
       }
-      else
+      bytes_read += sizeof(chunk_size);
+
+      try {
+        serialization::parse_binary(std::string_view{buffer1, sizeof(chunk_size)}, chunk_size);
+      } catch (const std::exception& e) {
+        throw std::runtime_error("Error in deserialization of chunk size: "s + e.what());
+      }
+      MDEBUG("chunk_size: " << chunk_size);
+
+      if (chunk_size > BUFFER_SIZE)
+      {
+        MWARNING("WARNING: chunk_size " << chunk_size << " > BUFFER_SIZE " << BUFFER_SIZE);
+        throw std::runtime_error("Aborting: chunk size exceeds buffer size");
+      }
+      if (chunk_size > CHUNK_SIZE_WARNING_THRESHOLD)
       {
-        MFATAL("ERROR: unexpected end of file: bytes read before error: "
-            << import_file.gcount() << " of chunk_size " << chunk_size);
+        MINFO("NOTE: chunk_size " << chunk_size << " > " << CHUNK_SIZE_WARNING_THRESHOLD);
+      }
+      else if (chunk_size == 0) {
+        MFATAL("ERROR: chunk_size == 0");
         return 2;
       }
+      import_file.read(buffer_block, chunk_size);
+      if (! import_file) {
+        if (import_file.eof())
+        {
+          std::cout << refresh_string;
+          MINFO("End of file reached - file was truncated");
+          quit = 1;
+          break;
+        }
+        else
+        {
+          MFATAL("ERROR: unexpected end of file: bytes read before error: "
+              << import_file.gcount() << " of chunk_size " << chunk_size);
+          return 2;
+        }
+      }
+      bytes_read += chunk_size;
+      MDEBUG("Total bytes read: " << bytes_read);
     }
-    bytes_read += chunk_size;
-    MDEBUG("Total bytes read: " << bytes_read);
 
     if (h > block_stop)
     {
@@ -371,10 +612,18 @@ int import_from_file(cryptonote::core& core, const fs::path& import_file_path, u
     try
     {
       bootstrap::block_package bp;
-      try {
-        serialization::parse_binary(std::string_view{buffer_block, chunk_size}, bp);
-      } catch (const std::exception& e) {
-        throw std::runtime_error("Error in deserialization of chunk"s + e.what());
+      if (!index.empty())
+      {
+        bp = std::move(parsed.front());
+        parsed.pop_front();
+      }
+      else
+      {
+        try {
+          timed(timings.parse, [&] { serialization::parse_binary(std::string_view{buffer_block, chunk_size}, bp); });
+        } catch (const std::exception& e) {
+          throw std::runtime_error("Error in deserialization of chunk"s + e.what());
+        }
       }
 
       int display_interval = 1000;
@@ -405,19 +654,29 @@ int import_from_file(cryptonote::core& core, const fs::path& import_file_path, u
         if (opt_verify)
         {
           cryptonote::blobdata block;
-          cryptonote::block_to_blob(bp.block, block);
           std::vector<cryptonote::blobdata> txs;
-          for (const auto &tx: bp.txs)
-          {
-            txs.push_back(cryptonote::blobdata());
-            cryptonote::tx_to_blob(tx, txs.back());
-          }
+          timed(timings.parse, [&] {
+            cryptonote::block_to_blob(bp.block, block);
+            for (const auto &tx: bp.txs)
+            {
+              txs.push_back(cryptonote::blobdata());
+              cryptonote::tx_to_blob(tx, txs.back());
+            }
+          });
           blocks.push_back({block, txs});
-          int ret = check_flush(core, blocks, false);
-          if (ret)
+          block_hashes.push_back(get_block_hash(bp.block));
+
+          // Hand over full batches, ending where we can verify a full HOH without extra, for speed
+          // (h blocks is the chain height once this one is added)
+          if (blocks.size() >= db_batch_size && h % HASH_OF_HASHES_STEP == 0)
           {
-            quit = 2; // make sure we don't commit partial block data
-            break;
+            if (!verifier->push(std::move(blocks), std::move(block_hashes)))
+            {
+              quit = 2; // make sure we don't commit partial block data
+              break;
+            }
+            blocks.clear();
+            block_hashes.clear();
           }
         }
         else
@@ -473,9 +732,14 @@ int import_from_file(cryptonote::core& core, const fs::path& import_file_path, u
               // zero-based height
               std::cout << "\n[- batch commit at height " << h-1 << " -]\n";
               core.get_blockchain_storage().get_db().batch_stop();
-              pos = import_file.tellg();
-              bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
-              import_file.seekg(pos);
+              if (!index.empty())
+                bytes = indexed_bytes(index, h, db_batch_size);
+              else
+              {
+                pos = import_file.tellg();
+                bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
+                import_file.seekg(pos);
+              }
               core.get_blockchain_storage().get_db().batch_start(db_batch_size, bytes);
               std::cout << "\n";
               core.get_blockchain_storage().get_db().show_stats();
@@ -496,10 +760,11 @@ int import_from_file(cryptonote::core& core, const fs::path& import_file_path, u
 quitting:
   import_file.close();
 
-  if (opt_verify)
+  if (verifier)
   {
-    int ret = check_flush(core, blocks, true);
-    if (ret)
+    if (quit <= 1 && !blocks.empty())
+      verifier->push(std::move(blocks), std::move(block_hashes));
+    if (int ret = verifier->finish())
       return ret;
   }
 
@@ -518,6 +783,8 @@ quitting:
 
   core.get_blockchain_storage().get_db().show_stats();
   MINFO("Number of blocks imported: " << num_imported);
+  if (opt_benchmark)
+    print_benchmark(num_imported, std::chrono::steady_clock::now() - import_start);
   if (h > 0)
     // TODO: if there was an error, the last added block is probably at zero-based height h-2
     MINFO("Finished at block: " << h-1 << "  total blocks: " << h);
@@ -560,17 +827,23 @@ int main(int argc, char* argv[])
     "Batch transactions for faster import", true};
   const command_line::arg_descriptor<bool> arg_resume =  {"resume",
     "Resume from current height if output database already exists", true};
+  const command_line::arg_descriptor<bool> arg_benchmark = {"benchmark",
+    "Report the import rate, the time spent in each stage and the peak memory use once done", false};
+  const command_line::arg_descriptor<unsigned> arg_max_concurrency = {"max-concurrency",
+    "Max number of threads to use for verification", 0};
 
   command_line::add_arg(desc_cmd_sett, arg_input_file);
   command_line::add_arg(desc_cmd_sett, arg_log_level);
   command_line::add_arg(desc_cmd_sett, arg_batch_size);
   command_line::add_arg(desc_cmd_sett, arg_block_stop);
+  command_line::add_arg(desc_cmd_sett, arg_max_concurrency);
 
   command_line::add_arg(desc_cmd_only, arg_count_blocks);
   command_line::add_arg(desc_cmd_only, arg_pop_blocks);
   command_line::add_arg(desc_cmd_only, command_line::arg_help);
 
   command_line::add_arg(desc_cmd_only, arg_recalculate_difficulty);
+  command_line::add_arg(desc_cmd_only, arg_benchmark);
 
   // call add_options() directly for these arguments since
   // command_line helpers support only boolean switch, not boolean argument
@@ -599,6 +872,9 @@ int main(int argc, char* argv[])
   opt_resume    = command_line::get_arg(vm, arg_resume);
   block_stop    = command_line::get_arg(vm, arg_block_stop);
   db_batch_size = command_line::get_arg(vm, arg_batch_size);
+  opt_benchmark = command_line::get_arg(vm, arg_benchmark);
+  if (!command_line::is_arg_defaulted(vm, arg_max_concurrency))
+    tools::set_max_concurrency(command_line::get_arg(vm, arg_max_concurrency));
 
   if (command_line::get_arg(vm, command_line::arg_help))
   {
@@ -673,6 +949,7 @@ int main(int argc, char* argv[])
     MINFO("batch:   " << std::boolalpha << opt_batch << std::noboolalpha);
   }
   MINFO("resume:  " << std::boolalpha << opt_resume  << std::noboolalpha);
+  MINFO("threads: " << tools::get_max_concurrency());
   MINFO("nettype: " << (opt_testnet ? "testnet" : opt_devnet ? "devnet" : "mainnet"));
 
   MINFO("bootstrap file path: " << import_file_path);
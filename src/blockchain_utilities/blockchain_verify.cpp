@@ -0,0 +1,359 @@
+// Copyright (c) 2021, The Oxen Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Checks that the blockchain db's tables agree with each other and with the blocks and txs they
+// were built from, e.g. after a hardware fault, without a resync.  For every block in range:
+//
+// - the block parses, and its hash and height map to each other (blocks, block_heights);
+// - each of its txs (and its miner tx) is in the db at that height (tx_indices, txs);
+// - the tx's output indices (tx_outputs) lead back to the tx and output (output_txs,
+//   output_amounts), with the output's key;
+// - the key image of each input is spent (spent_keys).
+//
+// When the whole chain is checked, the tx, output (per amount) and key image counts must also
+// match those of the tables.  Height ranges are checked in parallel, each thread with its own
+// read txn.
+
+#include <atomic>
+#include <map>
+#include "common/command_line.h"
+#include "common/signal_handler.h"
+#include "common/threadpool.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "blockchain_objects.h"
+#include "blockchain_db/blockchain_db.h"
+#include "version.h"
+#include "cryptonote_core/uptime_proof.h"
+
+#undef OXEN_DEFAULT_LOG_CATEGORY
+#define OXEN_DEFAULT_LOG_CATEGORY "bcutil"
+
+namespace po = boost::program_options;
+using namespace cryptonote;
+
+static std::atomic<bool> stop_requested = false;
+
+namespace {
+
+struct verify_results
+{
+  std::vector<std::string> errors;
+  uint64_t txs = 0;
+  uint64_t key_images = 0;
+  std::map<uint64_t, uint64_t> outputs; // per amount
+
+  void error(uint64_t height, const std::string& what)
+  {
+    MERROR("Height " << height << ": " << what);
+    errors.push_back("height " + std::to_string(height) + ": " + what);
+  }
+};
+
+void verify_tx(const BlockchainDB& db, const transaction& tx, const crypto::hash& hash, uint64_t height, verify_results& res)
+{
+  const std::string txid = tools::type_to_hex(hash);
+  uint64_t tx_id;
+  if (!db.tx_exists(hash, tx_id))
+  {
+    res.error(height, "tx " + txid + " missing from tx_indices");
+    return;
+  }
+  ++res.txs;
+  if (uint64_t tx_height = db.get_tx_block_height(hash); tx_height != height)
+    res.error(height, "tx " + txid + " is indexed at height " + std::to_string(tx_height));
+
+  const bool miner_tx = tx.vin.size() == 1 && std::holds_alternative<txin_gen>(tx.vin[0]);
+  for (const auto& in : tx.vin)
+  {
+    if (const auto* in_to_key = std::get_if<txin_to_key>(&in))
+    {
+      ++res.key_images;
+      if (!db.has_key_image(in_to_key->k_image))
+        res.error(height, "key image " + tools::type_to_hex(in_to_key->k_image) + " of tx " + txid + " missing from spent_keys");
+    }
+  }
+
+  std::vector<uint64_t> indices;
+  try
+  {
+    indices = db.get_tx_amount_output_indices(tx_id).front();
+  }
+  catch (const std::exception& e)
+  {
+    res.error(height, "tx " + txid + " output indices not found: " + e.what());
+    return;
+  }
+  if (indices.size() != tx.vout.size())
+  {
+    res.error(height, "tx " + txid + " has " + std::to_string(tx.vout.size()) + " outputs but " + std::to_string(indices.size()) + " output indices");
+    return;
+  }
+
+  for (size_t i = 0; i < tx.vout.size(); i++)
+  {
+    // As BlockchainDB::add_transaction stores them: v2+ miner tx outputs go in with the rct outputs
+    const uint64_t amount = miner_tx && tx.version >= txversion::v2_ringct ? 0 : tx.vout[i].amount;
+    ++res.outputs[amount];
+    const std::string out = "output " + std::to_string(amount) + "/" + std::to_string(indices[i]) + " of tx " + txid;
+    try
+    {
+      const tx_out_index ti = db.get_output_tx_and_index(amount, indices[i]);
+      if (ti.first != hash || ti.second != i)
+        res.error(height, out + " leads to " + tools::type_to_hex(ti.first) + "/" + std::to_string(ti.second));
+      if (const auto* to_key = std::get_if<txout_to_key>(&tx.vout[i].target))
+        if (db.get_output_key(amount, indices[i], false).pubkey != to_key->key)
+          res.error(height, out + " has the wrong key in output_amounts");
+    }
+    catch (const std::exception& e)
+    {
+      res.error(height, out + " not found: " + e.what());
+    }
+  }
+}
+
+void verify_block(const BlockchainDB& db, uint64_t height, verify_results& res)
+{
+  block blk;
+  crypto::hash hash;
+  try
+  {
+    if (!parse_and_validate_block_from_blob(db.get_block_blob_from_height(height), blk, hash))
+    {
+      res.error(height, "block failed to parse");
+      return;
+    }
+  }
+  catch (const std::exception& e)
+  {
+    res.error(height, std::string{"block not found: "} + e.what());
+    return;
+  }
+
+  try
+  {
+    if (db.get_block_hash_from_height(height) != hash)
+      res.error(height, "block hash " + tools::type_to_hex(hash) + " does not match the hash stored for the height");
+    if (uint64_t h = db.get_block_height(hash); h != height)
+      res.error(height, "block hash " + tools::type_to_hex(hash) + " is indexed at height " + std::to_string(h));
+  }
+  catch (const std::exception& e)
+  {
+    res.error(height, "block " + tools::type_to_hex(hash) + " not indexed: " + e.what());
+  }
+
+  verify_tx(db, blk.miner_tx, get_transaction_hash(blk.miner_tx), height, res);
+
+  for (const auto& tx_hash : blk.tx_hashes)
+  {
+    blobdata bd;
+    transaction tx;
+    if (!db.get_pruned_tx_blob(tx_hash, bd) || !parse_and_validate_tx_base_from_blob(bd, tx))
+    {
+      res.error(height, "tx " + tools::type_to_hex(tx_hash) + " missing from txs or failed to parse");
+      continue;
+    }
+    verify_tx(db, tx, tx_hash, height, res);
+  }
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+
+  epee::string_tools::set_module_name_and_folder(argv[0]);
+
+  uint32_t log_level = 0;
+  uint64_t block_start = 0;
+  uint64_t block_stop = 0;
+
+  tools::on_startup();
+
+  auto opt_size = command_line::boost_option_sizes();
+
+  po::options_description desc_cmd_only("Command line options", opt_size.first, opt_size.second);
+  po::options_description desc_cmd_sett("Command line options and settings options", opt_size.first, opt_size.second);
+  const command_line::arg_descriptor<std::string> arg_log_level  = {"log-level",  "0-4 or categories", ""};
+  const command_line::arg_descriptor<uint64_t> arg_block_start  = {"block-start", "start at block number", block_start};
+  const command_line::arg_descriptor<uint64_t> arg_block_stop = {"block-stop", "Stop at block number", block_stop};
+  const command_line::arg_descriptor<uint64_t> arg_range_size = {"range-size", "Blocks checked by each thread at a time", 1000};
+
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_data_dir);
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_testnet_on);
+  command_line::add_arg(desc_cmd_sett, cryptonote::arg_devnet_on);
+  command_line::add_arg(desc_cmd_sett, arg_log_level);
+  command_line::add_arg(desc_cmd_sett, arg_block_start);
+  command_line::add_arg(desc_cmd_sett, arg_block_stop);
+  command_line::add_arg(desc_cmd_sett, arg_range_size);
+  command_line::add_arg(desc_cmd_only, command_line::arg_help);
+
+  po::options_description desc_options("Allowed options");
+  desc_options.add(desc_cmd_only).add(desc_cmd_sett);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    auto parser = po::command_line_parser(argc, argv).options(desc_options);
+    po::store(parser.run(), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (! r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << "Oxen '" << OXEN_RELEASE_NAME << "' (v" << OXEN_VERSION_FULL << ")\n\n";
+    std::cout << desc_options << std::endl;
+    return 1;
+  }
+
+  mlog_configure(mlog_get_default_log_path("oxen-blockchain-verify.log"), true);
+  if (!command_line::is_arg_defaulted(vm, arg_log_level))
+    mlog_set_log(command_line::get_arg(vm, arg_log_level).c_str());
+  else
+    mlog_set_log(std::string(std::to_string(log_level) + ",bcutil:INFO").c_str());
+
+  LOG_PRINT_L0("Starting...");
+
+  std::string opt_data_dir = command_line::get_arg(vm, cryptonote::arg_data_dir);
+  bool opt_testnet = command_line::get_arg(vm, cryptonote::arg_testnet_on);
+  bool opt_devnet = command_line::get_arg(vm, cryptonote::arg_devnet_on);
+  network_type net_type = opt_testnet ? TESTNET : opt_devnet ? DEVNET : MAINNET;
+  block_start = command_line::get_arg(vm, arg_block_start);
+  block_stop = command_line::get_arg(vm, arg_block_stop);
+  const uint64_t range_size = std::max<uint64_t>(1, command_line::get_arg(vm, arg_range_size));
+
+  LOG_PRINT_L0("Initializing source blockchain (BlockchainDB)");
+  blockchain_objects_t blockchain_objects = {};
+  Blockchain *core_storage = &blockchain_objects.m_blockchain;
+  BlockchainDB *db = new_db();
+  if (db == NULL)
+  {
+    LOG_ERROR("Failed to initialize a database");
+    throw std::runtime_error("Failed to initialize a database");
+  }
+
+  const fs::path filename = fs::u8path(opt_data_dir) / db->get_db_name();
+  LOG_PRINT_L0("Loading blockchain from folder " << filename << " ...");
+
+  try
+  {
+    db->open(filename, core_storage->nettype(), DBF_RDONLY);
+  }
+  catch (const std::exception& e)
+  {
+    LOG_PRINT_L0("Error opening database: " << e.what());
+    return 1;
+  }
+  r = core_storage->init(db, nullptr /*ons_db*/, net_type);
+
+  CHECK_AND_ASSERT_MES(r, 1, "Failed to initialize source blockchain storage");
+  LOG_PRINT_L0("Source blockchain storage initialized OK");
+
+  tools::signal_handler::install([](int type) {
+    stop_requested = true;
+  });
+
+  const uint64_t db_height = db->height();
+  if (!block_stop || block_stop > db_height)
+      block_stop = db_height;
+  const bool whole_chain = block_start == 0 && block_stop == db_height;
+  MINFO("Verifying from height " << block_start << " to height " << block_stop);
+
+  // The threads take the next range to check until there are none left
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  const size_t threads = tpool.get_max_concurrency();
+  std::vector<verify_results> results(threads);
+  std::atomic<uint64_t> next_range = block_start;
+  tools::threadpool::waiter waiter;
+  for (size_t t = 0; t < threads; t++)
+  {
+    tpool.submit(&waiter, [&, t] {
+      for (uint64_t begin; !stop_requested && (begin = next_range.fetch_add(range_size)) < block_stop; )
+      {
+        const uint64_t end = std::min(begin + range_size, block_stop);
+        for (uint64_t h = begin; h < end; h++)
+          verify_block(*db, h, results[t]);
+        MINFO("Verified blocks " << begin << " to " << end - 1);
+      }
+    }, true);
+  }
+
+  // Meanwhile, count the spent_keys table, to check against the key images of every tx
+  uint64_t spent_keys = 0;
+  if (whole_chain)
+    tpool.submit(&waiter, [&] {
+      db->for_all_key_images([&](const crypto::key_image&) { ++spent_keys; return !stop_requested; });
+    }, true);
+  waiter.wait(&tpool);
+
+  if (stop_requested)
+  {
+    LOG_PRINT_L0("Stopped before finishing");
+    return 1;
+  }
+
+  verify_results total;
+  for (auto& res : results)
+  {
+    total.errors.insert(total.errors.end(), res.errors.begin(), res.errors.end());
+    total.txs += res.txs;
+    total.key_images += res.key_images;
+    for (const auto& [amount, count] : res.outputs)
+      total.outputs[amount] += count;
+  }
+
+  if (whole_chain)
+  {
+    const auto mismatch = [&](const std::string& what, uint64_t counted, uint64_t in_db) {
+      if (counted == in_db)
+        return;
+      MERROR(what << ": " << counted << " in blocks, " << in_db << " in the db");
+      total.errors.push_back(what + " mismatch");
+    };
+    mismatch("Tx count", total.txs, db->get_tx_count());
+    mismatch("Key image count", total.key_images, spent_keys);
+    for (const auto& [amount, count] : total.outputs)
+      mismatch("Output count for amount " + std::to_string(amount), count, db->get_num_outputs(amount));
+  }
+
+  core_storage->deinit();
+
+  if (!total.errors.empty())
+  {
+    LOG_PRINT_L0("Blockchain db verification FAILED: " << total.errors.size() << " inconsistencies found");
+    return 1;
+  }
+  LOG_PRINT_L0("Blockchain db verified OK: " << total.txs << " txs, " << total.key_images << " key images");
+  return 0;
+
+  CATCH_ENTRY("Verification error", 1);
+}
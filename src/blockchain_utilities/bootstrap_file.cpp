@@ -32,6 +32,9 @@
 
 #include "bootstrap_file.h"
 
+#include <boost/endian/conversion.hpp>
+#include <cstring>
+
 #undef OXEN_DEFAULT_LOG_CATEGORY
 #define OXEN_DEFAULT_LOG_CATEGORY "bcutil"
 
@@ -46,9 +49,107 @@ namespace
   const uint32_t blockchain_raw_magic = 0x28721586;
   const uint32_t header_size = 1024;
 
+  // Index files are this, then a little-endian (offset: u64, size: u32) record for each chunk
+  const uint32_t blockchain_raw_index_magic = 0x28721587;
+  constexpr size_t index_record_size = sizeof(uint64_t) + sizeof(uint32_t);
+
+  void write_index_record(std::ostream& out, uint64_t offset, uint32_t size)
+  {
+    char record[index_record_size];
+    boost::endian::native_to_little_inplace(offset);
+    boost::endian::native_to_little_inplace(size);
+    std::memcpy(record, &offset, sizeof(offset));
+    std::memcpy(record + sizeof(offset), &size, sizeof(size));
+    out.write(record, sizeof(record));
+  }
+
   std::string refresh_string = "\r                                    \r";
 }
 
+fs::path BootstrapFile::index_path(const fs::path& file_path)
+{
+  auto path = file_path;
+  path += ".index";
+  return path;
+}
+
+std::vector<BootstrapFile::chunk_location> BootstrapFile::load_index(const fs::path& file_path)
+{
+  std::vector<chunk_location> index;
+  std::error_code ec;
+  const auto file_size = fs::file_size(file_path, ec);
+  if (ec)
+    return index;
+  fs::ifstream in{index_path(file_path), std::ios::binary};
+  if (in.fail())
+    return index;
+  std::string data{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+
+  uint32_t magic;
+  if (data.size() < sizeof(magic) || (data.size() - sizeof(magic)) % index_record_size != 0)
+    return index;
+  std::memcpy(&magic, data.data(), sizeof(magic));
+  if (boost::endian::little_to_native(magic) != blockchain_raw_index_magic)
+    return index;
+
+  index.resize((data.size() - sizeof(magic)) / index_record_size);
+  uint64_t end = 0;
+  for (size_t i = 0; i < index.size(); i++)
+  {
+    const char* record = data.data() + sizeof(magic) + i * index_record_size;
+    std::memcpy(&index[i].offset, record, sizeof(index[i].offset));
+    std::memcpy(&index[i].size, record + sizeof(index[i].offset), sizeof(index[i].size));
+    boost::endian::little_to_native_inplace(index[i].offset);
+    boost::endian::little_to_native_inplace(index[i].size);
+    // Each chunk is its size then its data, right after the previous one
+    if (index[i].offset < end + sizeof(uint32_t) || index[i].size == 0 || index[i].size > BUFFER_SIZE)
+    {
+      index.clear();
+      return index;
+    }
+    end = index[i].offset + index[i].size;
+  }
+  if (index.empty() || end != file_size)
+  {
+    MWARNING("Ignoring bootstrap index " << index_path(file_path) << ", which doesn't match the file");
+    index.clear();
+  }
+  return index;
+}
+
+uint64_t BootstrapFile::build_index(const fs::path& file_path)
+{
+  fs::ifstream import_file{file_path, std::ios::binary};
+  if (import_file.fail())
+  {
+    MFATAL("import_file.open() fail");
+    throw std::runtime_error("Aborting");
+  }
+  seek_to_first_chunk(import_file);
+
+  std::ofstream out{index_path(file_path).string(), std::ios::binary | std::ios::trunc};
+  std::string blob = serialization::dump_binary(blockchain_raw_index_magic);
+  out << blob;
+
+  uint64_t chunks = 0;
+  uint32_t chunk_size;
+  char buf1[sizeof(chunk_size)];
+  while (import_file.read(buf1, sizeof(chunk_size)))
+  {
+    serialization::parse_binary(std::string_view{buf1, sizeof(chunk_size)}, chunk_size);
+    if (chunk_size == 0 || chunk_size > BUFFER_SIZE)
+      throw std::runtime_error("Aborting: invalid chunk size " + std::to_string(chunk_size));
+    write_index_record(out, import_file.tellg(), chunk_size);
+    import_file.seekg(chunk_size, std::ios_base::cur);
+    chunks++;
+  }
+  out.flush();
+  if (out.fail())
+    throw std::runtime_error("Error writing bootstrap index");
+  MINFO("Indexed " << chunks << " chunks of " << file_path);
+  return chunks;
+}
+
 
 
 bool BootstrapFile::open_writer(const fs::path& file_path)
@@ -87,11 +188,17 @@ bool BootstrapFile::open_writer(const fs::path& file_path)
   }
   else
   {
-    num_blocks = count_blocks(file_path.string());
+    // Files exported before there were indexes get one now
+    auto index = load_index(file_path);
+    num_blocks = index.empty() ? build_index(file_path) * NUM_BLOCKS_PER_CHUNK : index.size() * NUM_BLOCKS_PER_CHUNK;
     MDEBUG("appending to existing file with height: " << num_blocks-1 << "  total blocks: " << num_blocks);
   }
   m_height = num_blocks;
 
+  m_index_file.open(index_path(file_path).string(), std::ios_base::binary | std::ios_base::out | (do_initialize_file ? std::ios::trunc : std::ios::app));
+  if (m_index_file.fail())
+    return false;
+
   if (do_initialize_file)
     m_raw_data_file->open(file_path.string(), std::ios_base::binary | std::ios_base::out | std::ios::trunc);
   else
@@ -122,6 +229,7 @@ bool BootstrapFile::initialize_file()
     throw std::runtime_error("Error in serialization of file magic: "s + e.what());
   }
   *m_raw_data_file << blob;
+  m_index_file << serialization::dump_binary(blockchain_raw_index_magic);
 
   bootstrap::file_info bfi;
   bfi.major_version = 0;
@@ -203,6 +311,7 @@ void BootstrapFile::flush_chunk()
     MFATAL("Error writing chunk:  height: " << m_cur_height << "  chunk_size: " << chunk_size << "  num chars written: " << num_chars_written);
     throw std::runtime_error("Error writing chunk");
   }
+  write_index_record(m_index_file, pos_before, chunk_size);
 
   m_buffer.clear();
   delete m_output_stream;
@@ -257,6 +366,9 @@ bool BootstrapFile::close()
   if (m_raw_data_file->fail())
     return false;
 
+  m_index_file.flush();
+  if (m_index_file.fail())
+    return false;
   m_raw_data_file->flush();
   delete m_output_stream;
   delete m_raw_data_file;
@@ -39,6 +39,7 @@
 #include <algorithm>
 #include <cstdio>
 #include <fstream>
+#include <vector>
 #include <boost/iostreams/copy.hpp>
 #include <atomic>
 
@@ -61,6 +62,20 @@ public:
   uint64_t count_blocks(const fs::path& dir_path);
   uint64_t seek_to_first_chunk(fs::ifstream& import_file);
 
+  // Exports also write an index of the chunks next to the file (see index_path()), so that
+  // importers can find any height, and the size of a run of chunks, without scanning the file.
+  struct chunk_location
+  {
+    uint64_t offset; // of the chunk's data, i.e. just after its size
+    uint32_t size;
+  };
+  static fs::path index_path(const fs::path& file_path);
+  // Returns the location of each chunk of the file, from its index, or an empty vector if it has
+  // none (e.g. it was exported before indexes were) or the index doesn't match it.
+  static std::vector<chunk_location> load_index(const fs::path& file_path);
+  // Scans the file and writes its index; returns the number of chunks.
+  uint64_t build_index(const fs::path& file_path);
+
   bool store_blockchain_raw(cryptonote::Blockchain* cs, cryptonote::tx_memory_pool* txp,
       fs::path& output_file, uint64_t use_block_height=0);
 
@@ -71,6 +86,7 @@ protected:
   tx_memory_pool* m_tx_pool;
   typedef std::vector<char> buffer_type;
   std::ofstream * m_raw_data_file;
+  std::ofstream m_index_file;
   buffer_type m_buffer;
   boost::iostreams::stream<boost::iostreams::back_insert_device<buffer_type>>* m_output_stream;
 
@@ -90,6 +90,16 @@ namespace cryptonote
     return result;
   }
 
+  std::vector<height_to_hash> get_hardcoded_checkpoints(cryptonote::network_type nettype)
+  {
+    std::vector<height_to_hash> result;
+#if !defined(OXEN_ENABLE_INTEGRATION_TEST_HOOKS)
+    if (nettype == MAINNET)
+      result.assign(std::begin(HARDCODED_MAINNET_CHECKPOINTS), std::end(HARDCODED_MAINNET_CHECKPOINTS));
+#endif
+    return result;
+  }
+
   bool load_checkpoints_from_json(const fs::path& json_hashfile_fullpath, std::vector<height_to_hash>& checkpoint_hashes)
   {
     if (std::error_code ec; !fs::exists(json_hashfile_fullpath, ec))
@@ -101,6 +101,7 @@ namespace cryptonote
   };
 
   crypto::hash get_newest_hardcoded_checkpoint(cryptonote::network_type nettype, uint64_t *height);
+  std::vector<height_to_hash> get_hardcoded_checkpoints(cryptonote::network_type nettype);
   bool         load_checkpoints_from_json     (const fs::path& json_hashfile_fullpath, std::vector<height_to_hash>& checkpoint_hashes);
 
   /**
@@ -0,0 +1,181 @@
+#include "cache_budget.h"
+
+#include <algorithm>
+#include <mutex>
+
+#include "epee/misc_log_ex.h"
+#include "common/metrics.h"
+
+#undef OXEN_DEFAULT_LOG_CATEGORY
+#define OXEN_DEFAULT_LOG_CATEGORY "cache_budget"
+
+namespace tools::cache_budget
+{
+
+struct entry
+{
+  entry(std::string name, int priority, std::function<void(size_t bytes)> evict, metrics::gauge& gauge)
+    : name{std::move(name)}, priority{priority}, evict{std::move(evict)}, gauge{gauge} {}
+
+  std::string name;
+  int priority;
+  std::function<void(size_t bytes)> evict;
+  metrics::gauge& gauge;
+  std::atomic<size_t> bytes{0};
+};
+
+namespace
+{
+  // Function-local statics, so that they outlive caches that are themselves static
+  struct registry
+  {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<entry>> entries;
+    // Held for the whole of an enforce(), so that a cache can't unregister (and go away) while it
+    // is being evicted from
+    std::mutex evict_mutex;
+    std::atomic<size_t> limit{0};
+  };
+
+  registry& get_registry()
+  {
+    static registry r;
+    return r;
+  }
+
+  size_t sum(const std::vector<std::shared_ptr<entry>>& entries)
+  {
+    size_t total = 0;
+    for (auto& e : entries)
+      total += e->bytes.load(std::memory_order_relaxed);
+    return total;
+  }
+}
+
+handle add(std::string name, int priority, std::function<void(size_t bytes)> evict)
+{
+  auto& gauge = metrics::get_gauge(name, "cache_bytes");
+  gauge.set(0);
+  auto e = std::make_shared<entry>(std::move(name), priority, std::move(evict), gauge);
+  auto& r = get_registry();
+  std::lock_guard lock{r.mutex};
+  r.entries.push_back(e);
+  return handle{std::move(e)};
+}
+
+handle& handle::operator=(handle&& h) noexcept
+{
+  if (this != &h)
+  {
+    reset();
+    m_entry = std::move(h.m_entry);
+  }
+  return *this;
+}
+
+handle::~handle()
+{
+  reset();
+}
+
+void handle::reset()
+{
+  if (!m_entry)
+    return;
+  auto& r = get_registry();
+  {
+    std::lock_guard evicting{r.evict_mutex};
+    std::lock_guard lock{r.mutex};
+    r.entries.erase(std::remove(r.entries.begin(), r.entries.end(), m_entry), r.entries.end());
+  }
+  m_entry->gauge.set(0);
+  m_entry.reset();
+}
+
+void handle::set_size(size_t bytes) const
+{
+  if (!m_entry)
+    return;
+  m_entry->bytes.store(bytes, std::memory_order_relaxed);
+  m_entry->gauge.set(bytes);
+}
+
+size_t handle::size() const
+{
+  return m_entry ? m_entry->bytes.load(std::memory_order_relaxed) : 0;
+}
+
+void set_limit(size_t bytes)
+{
+  get_registry().limit = bytes;
+  metrics::get_gauge("limit", "cache_budget").set(bytes);
+}
+
+size_t limit()
+{
+  return get_registry().limit;
+}
+
+size_t total()
+{
+  auto& r = get_registry();
+  std::lock_guard lock{r.mutex};
+  return sum(r.entries);
+}
+
+size_t enforce()
+{
+  auto& r = get_registry();
+  const size_t lim = r.limit;
+  if (lim == 0)
+    return 0;
+  std::unique_lock evicting{r.evict_mutex, std::try_to_lock};
+  if (!evicting)
+    return 0;
+
+  std::vector<std::shared_ptr<entry>> entries;
+  {
+    std::lock_guard lock{r.mutex};
+    entries = r.entries;
+  }
+  const size_t before = sum(entries);
+  if (before <= lim)
+    return 0;
+
+  std::stable_sort(entries.begin(), entries.end(), [](auto& a, auto& b) { return a->priority < b->priority; });
+  size_t current = before;
+  for (auto& e : entries)
+  {
+    if (current <= lim)
+      break;
+    if (!e->evict || e->bytes.load(std::memory_order_relaxed) == 0)
+      continue;
+    try
+    {
+      e->evict(current - lim);
+    }
+    catch (const std::exception& ex)
+    {
+      MERROR("Failed to evict from the " << e->name << " cache: " << ex.what());
+    }
+    metrics::get_counter(e->name, "cache_evictions").inc();
+    current = sum(entries);
+  }
+
+  const size_t freed = before > current ? before - current : 0;
+  MDEBUG("Caches over their " << lim << " byte budget by " << before - lim << " bytes; evicted " << freed << " bytes");
+  return freed;
+}
+
+std::vector<cache_info> caches()
+{
+  auto& r = get_registry();
+  std::lock_guard lock{r.mutex};
+  std::vector<cache_info> result;
+  result.reserve(r.entries.size());
+  for (auto& e : r.entries)
+    result.push_back({e->name, e->priority, e->bytes.load(std::memory_order_relaxed), static_cast<bool>(e->evict)});
+  return result;
+}
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Process-wide memory budget shared by the daemon's caches (`--cache-budget-mb`).  Each cache
+// registers with a name, a priority and an eviction callback, and reports its current size in
+// bytes as it changes; enforce() (called periodically) then asks caches to shrink, lowest priority
+// first, until their total is back within the limit.
+//
+// Sizes are the caches' own estimates, so the budget bounds roughly what the caches hold rather
+// than exact heap usage.  Each cache's size is also published as the metrics gauge
+// (name, "cache_bytes"), and the limit as ("limit", "cache_budget").
+namespace tools::cache_budget
+{
+
+// Priorities of the daemon's caches: lower ones are evicted first, so these go from the cheapest
+// to rebuild (and least likely to be hit again) to the most valuable.
+namespace priority
+{
+  constexpr int rpc_compressed = 0;
+  constexpr int rpc_response = 10;
+  constexpr int txpool_parsed = 20;
+  constexpr int parsed_blocks = 25;
+  constexpr int ons_resolve = 30;
+  constexpr int recent_outputs = 35;
+  constexpr int scan_table = 40;
+}
+
+// Rough size of one element of a node-based container (std::unordered_map, std::list, ...): the
+// element plus the node's pointers, cached hash and allocator overhead.
+template <typename Container>
+constexpr size_t node_bytes = sizeof(typename Container::value_type) + 4 * sizeof(void*);
+
+struct entry;
+
+// A cache's registration, which it keeps for as long as it exists; destroying (or resetting) it
+// unregisters the cache, waiting for any eviction in progress to finish.  Declare it after the
+// members its eviction callback uses, so that it is destroyed before them.
+class handle
+{
+public:
+  handle() = default;
+  handle(handle&&) noexcept = default;
+  handle& operator=(handle&& h) noexcept;
+  ~handle();
+
+  // Records the cache's current size.  Cheap (an atomic store), so it can be called with the
+  // cache's own lock held.
+  void set_size(size_t bytes) const;
+  size_t size() const;
+
+  void reset();
+  explicit operator bool() const { return static_cast<bool>(m_entry); }
+
+private:
+  friend handle add(std::string name, int priority, std::function<void(size_t bytes)> evict);
+  explicit handle(std::shared_ptr<entry> e) : m_entry{std::move(e)} {}
+
+  std::shared_ptr<entry> m_entry;
+};
+
+// Registers a cache.  `evict(bytes)` is asked to free at least `bytes` bytes (freeing less, or
+// everything, is fine), reporting its new size through set_size(); it is called from enforce()
+// without any lock of the registry held, so it can take the cache's own locks.  A cache that
+// can't give memory back (e.g. one only filled while in use) passes an empty `evict`: it still
+// counts against the budget, leaving the others less room.
+handle add(std::string name, int priority, std::function<void(size_t bytes)> evict);
+
+// Sets the limit on the total size of the registered caches; 0 (the default) for no limit.
+void set_limit(size_t bytes);
+size_t limit();
+
+// Total reported size of the registered caches
+size_t total();
+
+// Evicts from the registered caches, lowest priority first, until their total is within the limit
+// (or nothing more can be evicted).  Returns the number of bytes freed.  Must not be called with a
+// cache's lock held, as evicting it takes that lock.  Concurrent calls return 0 rather than wait.
+size_t enforce();
+
+struct cache_info
+{
+  std::string name;
+  int priority;
+  size_t bytes;
+  bool evictable;
+};
+
+// The registered caches, in registration order
+std::vector<cache_info> caches();
+
+}
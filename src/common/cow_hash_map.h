@@ -0,0 +1,240 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+namespace tools
+{
+
+// Hash map with cheap copies: the elements are spread over a fixed number of shards, each an
+// independently reference-counted std::unordered_map.  Copying the map copies only the shard
+// pointers, so copies share all their elements; a shard is duplicated ("copy on write") the first
+// time a copy modifies it.  Keeping many slightly different versions of a large map (e.g. one per
+// block) thus costs memory proportional to the number of changes, not versions × size.
+//
+// The interface is a subset of std::unordered_map with one notable difference: begin()/end()
+// always give `const_iterator`s (iterating never duplicates shards).  The mutable `iterator`
+// returned by the non-const find() and emplace() refers to an element of a shard owned solely by
+// this map, so it can be used to modify or erase that element (until the map is next copied), but
+// it cannot be incremented.
+//
+// Not thread-safe, except that distinct copies may be used from different threads.
+template <typename Key, typename T, typename Hash = std::hash<Key>, size_t Shards = 64>
+class cow_hash_map
+{
+  static_assert(Shards > 0 && (Shards & (Shards - 1)) == 0, "Shard count must be a power of 2");
+
+public:
+  using shard_type      = std::unordered_map<Key, T, Hash>;
+  using key_type        = Key;
+  using mapped_type     = T;
+  using value_type      = typename shard_type::value_type;
+  using size_type       = size_t;
+  using difference_type = ptrdiff_t;
+
+private:
+  using shard_ptr   = std::shared_ptr<shard_type>;
+  using shard_array = std::array<shard_ptr, Shards>;
+
+public:
+  class const_iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = typename cow_hash_map::value_type;
+    using difference_type   = ptrdiff_t;
+    using pointer           = const value_type*;
+    using reference         = const value_type&;
+
+    const_iterator() = default;
+
+    reference operator*() const { return *m_it; }
+    pointer operator->() const { return &*m_it; }
+
+    const_iterator& operator++() { ++m_it; skip_exhausted(); return *this; }
+    const_iterator operator++(int) { auto copy = *this; ++*this; return copy; }
+
+    friend bool operator==(const const_iterator& a, const const_iterator& b)
+    {
+      return a.m_index == b.m_index && (a.m_index == Shards || a.m_it == b.m_it);
+    }
+    friend bool operator!=(const const_iterator& a, const const_iterator& b) { return !(a == b); }
+
+  private:
+    friend class cow_hash_map;
+    const_iterator(const shard_array* shards, size_t index, typename shard_type::const_iterator it)
+      : m_shards{shards}, m_index{index}, m_it{it} {}
+
+    // Moves to the first element of the next non-empty shard if the current shard is exhausted
+    void skip_exhausted()
+    {
+      while (m_index < Shards && m_it == (*m_shards)[m_index]->cend())
+      {
+        while (++m_index < Shards && !(*m_shards)[m_index]) {}
+        if (m_index < Shards)
+          m_it = (*m_shards)[m_index]->cbegin();
+      }
+    }
+
+    const shard_array* m_shards = nullptr;
+    size_t m_index = Shards;
+    typename shard_type::const_iterator m_it{};
+  };
+
+  class iterator
+  {
+  public:
+    using value_type = typename cow_hash_map::value_type;
+    using pointer    = value_type*;
+    using reference  = value_type&;
+
+    iterator() = default;
+
+    reference operator*() const { return *m_it; }
+    pointer operator->() const { return &*m_it; }
+
+    operator const_iterator() const { return m_shards ? const_iterator{m_shards, m_index, m_it} : const_iterator{}; }
+
+  private:
+    friend class cow_hash_map;
+    iterator(const shard_array* shards, size_t index, typename shard_type::iterator it)
+      : m_shards{shards}, m_index{index}, m_it{it} {}
+
+    const shard_array* m_shards = nullptr;
+    size_t m_index = Shards;
+    typename shard_type::iterator m_it{};
+  };
+
+  size_t size() const { return m_size; }
+  bool empty() const { return m_size == 0; }
+  void clear() { *this = {}; }
+
+  const_iterator begin() const
+  {
+    for (size_t i = 0; i < Shards; i++)
+      if (m_shards[i] && !m_shards[i]->empty())
+        return {&m_shards, i, m_shards[i]->cbegin()};
+    return end();
+  }
+  const_iterator end() const { return {}; }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  const_iterator find(const Key& key) const
+  {
+    size_t const index = shard_index(key);
+    if (auto& shard = m_shards[index])
+      if (auto it = shard->find(key); it != shard->end())
+        return {&m_shards, index, it};
+    return end();
+  }
+
+  iterator find(const Key& key)
+  {
+    size_t const index = shard_index(key);
+    if (!m_shards[index] || !m_shards[index]->count(key))
+      return {};
+    auto& shard = writable_shard(index);
+    return {&m_shards, index, shard.find(key)};
+  }
+
+  size_t count(const Key& key) const
+  {
+    auto& shard = m_shards[shard_index(key)];
+    return shard ? shard->count(key) : 0;
+  }
+
+  const T& at(const Key& key) const
+  {
+    auto it = find(key);
+    if (it == end())
+      throw std::out_of_range{"cow_hash_map::at: key not found"};
+    return it->second;
+  }
+
+  T& at(const Key& key)
+  {
+    auto it = find(key);
+    if (it == end())
+      throw std::out_of_range{"cow_hash_map::at: key not found"};
+    return it->second;
+  }
+
+  T& operator[](const Key& key)
+  {
+    auto [it, inserted] = writable_shard(shard_index(key)).try_emplace(key);
+    if (inserted)
+      m_size++;
+    return it->second;
+  }
+
+  template <typename... Args>
+  std::pair<iterator, bool> emplace(Args&&... args)
+  {
+    value_type value{std::forward<Args>(args)...};
+    size_t const index = shard_index(value.first);
+    auto [it, inserted] = writable_shard(index).emplace(std::move(value));
+    if (inserted)
+      m_size++;
+    return {iterator{&m_shards, index, it}, inserted};
+  }
+
+  size_t erase(const Key& key)
+  {
+    size_t const index = shard_index(key);
+    if (!m_shards[index] || !m_shards[index]->count(key))
+      return 0;
+    writable_shard(index).erase(key);
+    m_size--;
+    return 1;
+  }
+
+  void erase(iterator it)
+  {
+    if (m_shards[it.m_index].use_count() > 1)
+    {
+      // The map was copied since `it` was obtained, so its shard is shared again
+      Key key = it->first;
+      erase(key);
+      return;
+    }
+    m_shards[it.m_index]->erase(it.m_it);
+    m_size--;
+  }
+
+private:
+  static size_t shard_index(const Key& key)
+  {
+    // Fibonacci hashing of the (64-bit extended) hash: takes the high bits so that the shard
+    // doesn't correlate with the bucket the shard's own unordered_map picks from the low bits.
+    constexpr int shard_bits = [] { int b = 0; for (size_t s = Shards; s > 1; s >>= 1) b++; return b; }();
+    if constexpr (shard_bits == 0)
+      return 0;
+    else
+      return static_cast<size_t>((static_cast<uint64_t>(Hash{}(key)) * 0x9E3779B97F4A7C15ull) >> (64 - shard_bits));
+  }
+
+  // Returns the shard, creating it or duplicating it first if it is shared with another copy
+  shard_type& writable_shard(size_t index)
+  {
+    auto& shard = m_shards[index];
+    if (!shard)
+      shard = std::make_shared<shard_type>();
+    else if (shard.use_count() > 1)
+      shard = std::make_shared<shard_type>(*shard);
+    return *shard;
+  }
+
+  shard_array m_shards;
+  size_t m_size = 0;
+};
+
+}
@@ -45,6 +45,7 @@
 #define OXEN_DEFAULT_LOG_CATEGORY "net.dns"
 
 using namespace std::literals;
+static constexpr auto DNS_CACHE_MAX_TTL = 1h;
 static constexpr std::array DEFAULT_DNS_PUBLIC_ADDR =
 {
   "194.150.168.168"sv,    // CCC (Germany)
@@ -270,6 +271,37 @@ DNSResolver::DNSResolver()
   }
 }
 
+std::optional<DNSResolver::cached_record> DNSResolver::get_cached(int record_type, const std::string& name)
+{
+  std::lock_guard lock{m_cache_mutex};
+  auto it = m_cache.find({record_type, name});
+  if (it == m_cache.end())
+    return std::nullopt;
+  if (it->second.expiry <= std::chrono::steady_clock::now())
+  {
+    m_cache.erase(it);
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+void DNSResolver::cache(int record_type, const std::string& name, std::vector<std::string> records, bool secure, bool bogus, int ttl)
+{
+  if (ttl <= 0)
+    return;
+  const auto expiry = std::chrono::steady_clock::now() + std::min<std::chrono::seconds>(std::chrono::seconds{ttl}, DNS_CACHE_MAX_TTL);
+  std::lock_guard lock{m_cache_mutex};
+  // Drop expired entries while we're here so that the cache stays the size of what's in use
+  for (auto it = m_cache.begin(); it != m_cache.end(); )
+  {
+    if (it->second.expiry <= std::chrono::steady_clock::now())
+      it = m_cache.erase(it);
+    else
+      ++it;
+  }
+  m_cache[{record_type, name}] = {std::move(records), secure, bogus, expiry};
+}
+
 std::vector<std::string> DNSResolver::get_record(const std::string& url, int record_type, std::optional<std::string> (*reader)(const char *,size_t), bool& dnssec_available, bool& dnssec_valid)
 {
   std::vector<std::string> addresses;
@@ -281,6 +313,14 @@ std::vector<std::string> DNSResolver::get_record(const std::string& url, int rec
     return addresses;
   }
 
+  if (auto cached = get_cached(record_type, url))
+  {
+    MDEBUG("Using cached " << get_record_name(record_type) << " record(s) for " << url);
+    dnssec_available = cached->secure || cached->bogus;
+    dnssec_valid = cached->secure && !cached->bogus;
+    return std::move(cached->records);
+  }
+
   ub_result* result_raw = nullptr;
   // call DNS resolver, blocking.  if return value not zero, something went wrong
   if (!ub_resolve(m_ctx, url.c_str(), record_type, DNS_CLASS_IN, &result_raw))
@@ -300,6 +340,7 @@ std::vector<std::string> DNSResolver::get_record(const std::string& url, int rec
           addresses.push_back(*res);
         }
       }
+      cache(record_type, url, addresses, result->secure, result->bogus, result->ttl);
     }
   }
 
@@ -333,6 +374,10 @@ namespace {
     bool done{false};
     bool dnssec;
     bool dnssec_required;
+    // Set for a successful lookup (whether or not it passed the dnssec checks), for caching:
+    std::optional<std::vector<std::string>> records;
+    bool secure{false}, bogus{false};
+    int ttl{0};
 
     dns_results(int& a, const std::string& h, const char* rn, std::vector<std::string>& r, std::optional<std::string> (*rdr)(const char*, size_t), bool dnssec, bool dnssec_req)
       : all_done{a}, hostname{h}, record_name{rn}, results{r}, reader{rdr}, dnssec{dnssec}, dnssec_required{dnssec_req}
@@ -347,22 +392,33 @@ extern "C" void DNSResolver_async_callback(void* data, int err, ub_result* resul
   res.all_done++;
   res.done = true;
   if (err)
+  {
     MWARNING("resolution of " << res.hostname << " failed: " << ub_strerror(err));
-  else if ((res.dnssec || res.dnssec_required) && result->bogus)
-    MWARNING("resolution of " << res.hostname << " failed DNSSEC validation: " << result->why_bogus);
-  else if (res.dnssec_required && !result->secure)
-    MWARNING("resolution of " << res.hostname << " failed: DNSSEC validate is required but is not available");
-  else if (result->havedata)
+    return;
+  }
+
+  if (result->havedata)
   {
+    auto& records = res.records.emplace();
     for (size_t i = 0; result->data[i] != NULL; i++)
     {
       if (auto r = (*res.reader)(result->data[i], result->len[i]))
       {
         MINFO("Found \"" << *r << "\" in " << res.record_name << " record for " << res.hostname);
-        res.results.push_back(*r);
+        records.push_back(std::move(*r));
       }
     }
+    res.secure = result->secure;
+    res.bogus = result->bogus;
+    res.ttl = result->ttl;
   }
+
+  if ((res.dnssec || res.dnssec_required) && result->bogus)
+    MWARNING("resolution of " << res.hostname << " failed DNSSEC validation: " << result->why_bogus);
+  else if (res.dnssec_required && !result->secure)
+    MWARNING("resolution of " << res.hostname << " failed: DNSSEC validate is required but is not available");
+  else if (res.records)
+    res.results = *res.records;
 }
 
 std::vector<std::vector<std::string>> DNSResolver::get_many(int type, const std::vector<std::string>& hostnames, std::chrono::milliseconds timeout, bool dnssec, bool dnssec_required)
@@ -385,6 +441,15 @@ std::vector<std::vector<std::string>> DNSResolver::get_many(int type, const std:
   for (auto& host : hostnames)
   {
     auto& pack = result_packs.emplace_back(num_done, host, get_record_name(type), results.emplace_back(), reader, dnssec, dnssec_required);
+    if (auto cached = get_cached(type, host))
+    {
+      MDEBUG("Using cached " << pack.record_name << " record(s) for " << host);
+      if (!((dnssec || dnssec_required) && cached->bogus) && !(dnssec_required && !cached->secure))
+        pack.results = std::move(cached->records);
+      num_done++;
+      pack.done = true;
+      continue;
+    }
     int err = ub_resolve_async(m_ctx, host.c_str(), type, DNS_CLASS_IN, static_cast<void*>(&pack), DNSResolver_async_callback, &pack.async_id);
     if (err)
     {
@@ -407,11 +472,13 @@ std::vector<std::vector<std::string>> DNSResolver::get_many(int type, const std:
     }
   }
 
-  // Cancel any outstanding requests
+  // Cancel any outstanding requests, and cache the completed ones
   for (auto& pack : result_packs)
   {
     if (!pack.done)
       ub_cancel(m_ctx, pack.async_id);
+    else if (pack.records)
+      cache(type, pack.hostname, std::move(*pack.records), pack.secure, pack.bogus, pack.ttl);
   }
 
   return results;
@@ -562,7 +629,7 @@ bool load_txt_records_from_dns(std::vector<std::string> &good_records, const std
 
   // send all requests in parallel
   std::deque<bool> avail(dns_urls.size(), false), valid(dns_urls.size(), false);
-  tools::threadpool& tpool = tools::threadpool::getInstance();
+  tools::threadpool& tpool = tools::threadpool::getInstance(tools::threadpool::domain::background);
   tools::threadpool::waiter waiter;
   for (size_t n = 0; n < dns_urls.size(); ++n)
   {
@@ -32,6 +32,8 @@
 #include <functional>
 #include <optional>
 #include <chrono>
+#include <map>
+#include <mutex>
 #include <string_view>
 
 struct ub_ctx;
@@ -55,6 +57,9 @@ struct ub_ctx_deleter { void operator()(ub_ctx*); };
  * This class is designed to provide a high-level abstraction to DNS resolution
  * functionality, including access to TXT records and such.  It will also
  * handle DNSSEC validation of the results.
+ *
+ * Successful lookups are cached for the record TTL (up to an hour), so repeated lookups of the
+ * same name (e.g. resolving and then confirming an OpenAlias address) don't wait on the network.
  */
 class DNSResolver
 {
@@ -165,7 +170,22 @@ private:
   // TODO: modify this to accommodate DNSSEC
   std::vector<std::string> get_record(const std::string& url, int record_type, std::optional<std::string> (*reader)(const char *,size_t), bool& dnssec_available, bool& dnssec_valid);
 
+  struct cached_record
+  {
+    std::vector<std::string> records;
+    bool secure;
+    bool bogus;
+    std::chrono::steady_clock::time_point expiry;
+  };
+
+  // Returns the unexpired cached result of a lookup, if there is one
+  std::optional<cached_record> get_cached(int record_type, const std::string& name);
+  // Caches a successful lookup for `ttl` seconds (capped at an hour); does nothing if ttl <= 0
+  void cache(int record_type, const std::string& name, std::vector<std::string> records, bool secure, bool bogus, int ttl);
+
   ub_ctx* m_ctx = nullptr;
+  std::map<std::pair<int, std::string>, cached_record> m_cache;
+  std::mutex m_cache_mutex;
 }; // class DNSResolver
 
 namespace dns_utils
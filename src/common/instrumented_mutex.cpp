@@ -0,0 +1,38 @@
+#include "instrumented_mutex.h"
+
+#include <sstream>
+
+#include "epee/misc_log_ex.h"
+#include "epee/thread_name.h"
+#include "profiler.h"
+
+#if defined(__GLIBC__)
+#include <execinfo.h>
+#endif
+
+#undef OXEN_DEFAULT_LOG_CATEGORY
+#define OXEN_DEFAULT_LOG_CATEGORY "locks"
+
+namespace tools::detail
+{
+
+void report_long_hold(std::string_view name, std::chrono::nanoseconds held, metrics::counter& long_holds)
+{
+  long_holds.inc();
+
+  std::ostringstream where;
+  const char* thread = epee::this_thread_info().name;
+  where << (thread[0] ? thread : "(unnamed)");
+#if defined(__GLIBC__)
+  // The releasing thread is the one that held it, so its callers (past unlock(), if that didn't get
+  // inlined) are where the lock was held.
+  void* frames[10];
+  const int n = backtrace(frames, 10);
+  for (int i = 1; i < n; i++)
+    where << (i == 1 ? " in " : " < ") << profiler::describe_address(reinterpret_cast<uintptr_t>(frames[i]) - 1);
+#endif
+  MWARNING("Lock " << name << " was held for "
+      << std::chrono::duration_cast<std::chrono::milliseconds>(held).count() << "ms by " << where.str());
+}
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "metrics.h"
+
+namespace tools
+{
+
+namespace detail
+{
+  inline std::atomic<int64_t> lock_hold_warning_ns{5'000'000'000};
+
+  void report_long_hold(std::string_view name, std::chrono::nanoseconds held, metrics::counter& long_holds);
+}
+
+// Holds of an instrumented_mutex longer than this are counted and logged (with the stack of the
+// thread releasing it, i.e. the holder).  0 disables the warnings.  Defaults to 5s.
+inline void set_lock_hold_warning(std::chrono::milliseconds threshold)
+{
+  detail::lock_hold_warning_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(threshold).count();
+}
+
+// Drop-in replacement for a (recursive) mutex that records, in the metrics registry (category
+// "locks", so also in `admin.get_metrics`):
+// - lock_NAME_wait: how long each acquisition waited for the mutex (0 if it was free);
+// - lock_NAME_hold: how long it was held, from outermost lock() to final unlock() for recursive
+//   acquisitions;
+// - lock_NAME_long_holds: how many holds went over set_lock_hold_warning().
+//
+// Re-entrant acquisitions by the holding thread aren't recorded.  Uncontended locking costs two
+// clock reads and two histogram records on top of the mutex itself.
+template <typename Mutex = std::recursive_mutex>
+class instrumented_mutex
+{
+  using clock = std::chrono::steady_clock;
+
+public:
+  explicit instrumented_mutex(std::string_view name)
+    : m_name{name},
+      m_wait{metrics::get_histogram("lock_" + m_name + "_wait", "locks")},
+      m_hold{metrics::get_histogram("lock_" + m_name + "_hold", "locks")},
+      m_long_holds{metrics::get_counter("lock_" + m_name + "_long_holds", "locks")}
+  {}
+
+  instrumented_mutex(const instrumented_mutex&) = delete;
+  instrumented_mutex& operator=(const instrumented_mutex&) = delete;
+
+  void lock()
+  {
+    if (m_mutex.try_lock())
+      return acquired(clock::duration::zero());
+    const auto start = clock::now();
+    m_mutex.lock();
+    acquired(clock::now() - start);
+  }
+
+  bool try_lock()
+  {
+    if (!m_mutex.try_lock())
+      return false;
+    acquired(clock::duration::zero());
+    return true;
+  }
+
+  void unlock()
+  {
+    if (--m_depth > 0)
+      return m_mutex.unlock();
+    const auto held = clock::now() - m_acquired;
+    m_mutex.unlock();
+    m_hold.record(std::chrono::duration_cast<std::chrono::nanoseconds>(held).count());
+    if (const auto warn = detail::lock_hold_warning_ns.load(std::memory_order_relaxed); warn > 0 && held > std::chrono::nanoseconds{warn})
+      detail::report_long_hold(m_name, held, m_long_holds);
+  }
+
+private:
+  // Only touched by the thread holding the mutex
+  void acquired(clock::duration waited)
+  {
+    if (m_depth++ > 0)
+      return;
+    m_acquired = clock::now();
+    m_wait.record(std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count());
+  }
+
+  Mutex m_mutex;
+  std::string m_name;
+  metrics::histogram& m_wait;
+  metrics::histogram& m_hold;
+  metrics::counter& m_long_holds;
+  unsigned int m_depth = 0;
+  clock::time_point m_acquired;
+};
+
+}
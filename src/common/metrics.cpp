@@ -0,0 +1,192 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+
+namespace tools::metrics
+{
+
+namespace
+{
+  using key = std::pair<std::string, std::string>; // category, name
+
+  // std::map so that the dump is sorted and stable between scrapes
+  std::shared_mutex registry_mutex;
+  std::map<key, std::unique_ptr<histogram>, std::less<>> histograms;
+  std::map<key, std::unique_ptr<counter>, std::less<>> counters;
+  std::map<key, std::unique_ptr<gauge>, std::less<>> gauges;
+
+  template <typename T>
+  T& get_or_create(std::map<key, std::unique_ptr<T>, std::less<>>& map, std::string_view name, std::string_view category)
+  {
+    key k{category, name};
+    {
+      std::shared_lock lock{registry_mutex};
+      if (auto it = map.find(k); it != map.end())
+        return *it->second;
+    }
+    std::unique_lock lock{registry_mutex};
+    auto& ptr = map[std::move(k)];
+    if (!ptr)
+      ptr = std::make_unique<T>();
+    return *ptr;
+  }
+
+  int highest_bit(uint64_t v)
+  {
+    int result = 0;
+    while (v >>= 1)
+      ++result;
+    return result;
+  }
+
+  // Prometheus label values only need backslash, double quote and newline escaped
+  std::string escape_label(std::string_view value)
+  {
+    std::string result;
+    result.reserve(value.size());
+    for (char c : value)
+    {
+      if (c == '\\' || c == '"')
+        result += '\\';
+      if (c == '\n')
+        result += "\\n";
+      else
+        result += c;
+    }
+    return result;
+  }
+
+  std::string seconds(uint64_t ns)
+  {
+    std::ostringstream ss;
+    ss.precision(9);
+    ss << ns / 1e9;
+    return ss.str();
+  }
+}
+
+size_t histogram::bucket_index(uint64_t ns)
+{
+  if (ns < SUB_BUCKETS)
+    return ns;
+  int const exponent = highest_bit(ns);
+  if (exponent > MAX_EXPONENT)
+    return NUM_BUCKETS - 1;
+  uint64_t const sub = (ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+  return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t histogram::bucket_lower_bound(size_t index)
+{
+  if (index < SUB_BUCKETS)
+    return index;
+  int const exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+  uint64_t const sub = index % SUB_BUCKETS;
+  return (SUB_BUCKETS + sub) << (exponent - SUB_BUCKET_BITS);
+}
+
+uint64_t histogram::bucket_width(size_t index)
+{
+  if (index < SUB_BUCKETS)
+    return 1;
+  int const exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+  return uint64_t{1} << (exponent - SUB_BUCKET_BITS);
+}
+
+void histogram::record(uint64_t ns)
+{
+  m_buckets[bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+  m_count.fetch_add(1, std::memory_order_relaxed);
+  m_sum.fetch_add(ns, std::memory_order_relaxed);
+  uint64_t prev = m_max.load(std::memory_order_relaxed);
+  while (prev < ns && !m_max.compare_exchange_weak(prev, ns, std::memory_order_relaxed))
+    ;
+}
+
+uint64_t histogram::quantile(double q) const
+{
+  // Sum the buckets rather than using m_count, which concurrent recorders may have updated
+  // without their bucket increment being visible yet.
+  uint64_t total = 0;
+  for (auto& b : m_buckets)
+    total += b.load(std::memory_order_relaxed);
+  if (total == 0)
+    return 0;
+
+  q = std::min(std::max(q, 0.0), 1.0);
+  uint64_t const rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * total)));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < NUM_BUCKETS; i++)
+  {
+    seen += m_buckets[i].load(std::memory_order_relaxed);
+    if (seen >= rank)
+      return std::min(bucket_lower_bound(i) + bucket_width(i) / 2, max());
+  }
+  return max();
+}
+
+histogram& get_histogram(std::string_view name, std::string_view category)
+{
+  return get_or_create(histograms, name, category);
+}
+
+counter& get_counter(std::string_view name, std::string_view category)
+{
+  return get_or_create(counters, name, category);
+}
+
+gauge& get_gauge(std::string_view name, std::string_view category)
+{
+  return get_or_create(gauges, name, category);
+}
+
+void for_each_histogram(const std::function<void(std::string_view name, std::string_view category, const histogram& h)>& f)
+{
+  std::shared_lock lock{registry_mutex};
+  for (auto& [k, h] : histograms)
+    f(k.second, k.first, *h);
+}
+
+std::string prometheus()
+{
+  static constexpr std::array<std::pair<double, std::string_view>, 4> QUANTILES{{{0.5, "0.5"}, {0.9, "0.9"}, {0.99, "0.99"}, {0.999, "0.999"}}};
+
+  std::ostringstream out;
+  std::shared_lock lock{registry_mutex};
+
+  out << "# HELP oxen_perf_timer_seconds Latency of PERF_TIMER instrumented code since startup\n"
+         "# TYPE oxen_perf_timer_seconds summary\n";
+  for (auto& [k, h] : histograms)
+  {
+    std::string const labels = "category=\"" + escape_label(k.first) + "\",timer=\"" + escape_label(k.second) + "\"";
+    for (auto& [q, q_str] : QUANTILES)
+      out << "oxen_perf_timer_seconds{" << labels << ",quantile=\"" << q_str << "\"} " << seconds(h->quantile(q)) << '\n';
+    out << "oxen_perf_timer_seconds_sum{" << labels << "} " << seconds(h->sum()) << '\n';
+    out << "oxen_perf_timer_seconds_count{" << labels << "} " << h->count() << '\n';
+  }
+
+  out << "# HELP oxen_perf_timer_max_seconds Longest PERF_TIMER measurement since startup\n"
+         "# TYPE oxen_perf_timer_max_seconds gauge\n";
+  for (auto& [k, h] : histograms)
+    out << "oxen_perf_timer_max_seconds{category=\"" << escape_label(k.first) << "\",timer=\"" << escape_label(k.second) << "\"} " << seconds(h->max()) << '\n';
+
+  out << "# HELP oxen_events_total Number of events since startup\n"
+         "# TYPE oxen_events_total counter\n";
+  for (auto& [k, c] : counters)
+    out << "oxen_events_total{category=\"" << escape_label(k.first) << "\",event=\"" << escape_label(k.second) << "\"} " << c->value() << '\n';
+
+  out << "# HELP oxen_gauge Current value of a quantity, such as a cache's size in bytes\n"
+         "# TYPE oxen_gauge gauge\n";
+  for (auto& [k, g] : gauges)
+    out << "oxen_gauge{category=\"" << escape_label(k.first) << "\",gauge=\"" << escape_label(k.second) << "\"} " << g->value() << '\n';
+
+  return out.str();
+}
+
+}
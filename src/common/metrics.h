@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// In-memory registry of latency histograms and event counters for dashboards.  Every PERF_TIMER
+// feeds a histogram here (regardless of log level), and the whole registry can be dumped in
+// Prometheus text exposition format (e.g. via the `admin.get_metrics` OMQ command).
+//
+// Entries are created on first use and live for the lifetime of the process, so references
+// returned by get_histogram()/get_counter()/get_gauge() can be cached (PERF_TIMER keeps one in a function-local
+// static).  Recording is lock-free.
+namespace tools::metrics
+{
+
+// HDR-style log-linear histogram of nanosecond values: each power-of-two range is split into
+// SUB_BUCKETS linear buckets, giving quantiles with a worst-case relative error of 1/SUB_BUCKETS
+// from ~16ns up to ~9 hours (larger values are clamped into the last bucket).  Values accumulate
+// since startup.
+class histogram
+{
+public:
+  static constexpr int SUB_BUCKET_BITS = 4;
+  static constexpr uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static constexpr int MAX_EXPONENT = 45;
+  static constexpr size_t NUM_BUCKETS = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+  void record(uint64_t ns);
+
+  uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+  uint64_t sum() const { return m_sum.load(std::memory_order_relaxed); }
+  uint64_t max() const { return m_max.load(std::memory_order_relaxed); }
+
+  // Returns the approximate value (midpoint of its bucket) at quantile q in [0, 1], or 0 if
+  // nothing has been recorded.
+  uint64_t quantile(double q) const;
+
+  static size_t bucket_index(uint64_t ns);
+  static uint64_t bucket_lower_bound(size_t index);
+  static uint64_t bucket_width(size_t index);
+
+private:
+  std::array<std::atomic<uint64_t>, NUM_BUCKETS> m_buckets{};
+  std::atomic<uint64_t> m_count{0};
+  std::atomic<uint64_t> m_sum{0};
+  std::atomic<uint64_t> m_max{0};
+};
+
+class counter
+{
+public:
+  void inc(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+  uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> m_value{0};
+};
+
+class gauge
+{
+public:
+  void set(uint64_t v) { m_value.store(v, std::memory_order_relaxed); }
+  uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> m_value{0};
+};
+
+// Returns the histogram/counter/gauge with the given name and category, creating it if needed.
+histogram& get_histogram(std::string_view name, std::string_view category);
+counter& get_counter(std::string_view name, std::string_view category);
+gauge& get_gauge(std::string_view name, std::string_view category);
+
+// Calls `f` with the name, category and histogram of everything in the registry, sorted by category
+// then name.  `f` must not create new entries.
+void for_each_histogram(const std::function<void(std::string_view name, std::string_view category, const histogram& h)>& f);
+
+// Dumps everything in the registry in Prometheus text format: histograms as the summary family
+// `oxen_perf_timer_seconds` (quantiles 0.5, 0.9, 0.99 and 0.999, plus _sum and _count) and the
+// gauge `oxen_perf_timer_max_seconds`, counters as the counter family `oxen_events_total`, and
+// gauges as the gauge family `oxen_gauge`.
+std::string prometheus();
+
+}
@@ -79,4 +79,69 @@ int Notify::notify(const char *tag, const char *s, ...)
   return tools::spawn(filename, margs, false);
 }
 
+int Notify::notify(const std::vector<std::pair<std::string, std::string>> &replacements)
+{
+  std::vector<std::string> margs = args;
+
+  for (const auto &[tag, s]: replacements)
+    replace(margs, tag.c_str(), s.c_str());
+
+  return tools::spawn(filename, margs, false);
+}
+
+AsyncNotify::AsyncNotify(std::shared_ptr<Notify> notify, bool coalesce)
+  : m_notify{std::move(notify)}, m_coalesce{coalesce}
+{
+  CHECK_AND_ASSERT_THROW_MES(m_notify, "Null notify");
+  m_thread = std::thread{&AsyncNotify::run, this};
+}
+
+AsyncNotify::~AsyncNotify()
+{
+  {
+    std::lock_guard lock{m_mutex};
+    m_stop = true;
+  }
+  m_cv.notify_one();
+  m_thread.join();
+}
+
+void AsyncNotify::notify(std::vector<std::pair<std::string, std::string>> replacements)
+{
+  {
+    std::lock_guard lock{m_mutex};
+    if (m_coalesce && !m_queue.empty())
+    {
+      MDEBUG("Replacing a notification that hasn't run yet");
+      m_queue.back() = std::move(replacements);
+    }
+    else
+      m_queue.push_back(std::move(replacements));
+  }
+  m_cv.notify_one();
+}
+
+void AsyncNotify::run()
+{
+  std::unique_lock lock{m_mutex};
+  for (;;)
+  {
+    m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+    if (m_queue.empty())
+      return;
+    auto replacements = std::move(m_queue.front());
+    m_queue.pop_front();
+    lock.unlock();
+    try
+    {
+      m_notify->notify(replacements);
+    }
+    catch (const std::exception &e)
+    {
+      MERROR("Failed to run notification: " << e.what());
+    }
+    lock.lock();
+  }
+}
+
 }
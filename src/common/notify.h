@@ -28,7 +28,13 @@
 
 #pragma once 
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 #include "fs.h"
 
@@ -41,10 +47,38 @@ public:
   Notify(const char *spec);
 
   int notify(const char *tag, const char *s, ...);
+  // Same, with the [tag, replacement] pairs given as a list
+  int notify(const std::vector<std::pair<std::string, std::string>> &replacements);
 
 private:
   fs::path filename;
   std::vector<std::string> args;
 };
 
+// Runs a Notify from a background thread, so that whatever triggers the notification never waits on
+// the fork/exec.  Notifications run one at a time, in the order they were queued.  With `coalesce`,
+// a notification queued while an earlier one is still waiting to run replaces it, so that a burst
+// of them (e.g. one per block while syncing) only runs the program for the latest.
+//
+// Whatever is still queued is run before the destructor returns.
+class AsyncNotify
+{
+public:
+  AsyncNotify(std::shared_ptr<Notify> notify, bool coalesce);
+  ~AsyncNotify();
+
+  void notify(std::vector<std::pair<std::string, std::string>> replacements);
+
+private:
+  void run();
+
+  std::shared_ptr<Notify> m_notify;
+  bool m_coalesce;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<std::vector<std::pair<std::string, std::string>>> m_queue;
+  bool m_stop = false;
+  std::thread m_thread;
+};
+
 }
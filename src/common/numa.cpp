@@ -0,0 +1,189 @@
+#include "numa.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "epee/misc_log_ex.h"
+#include "common/fs.h"
+
+#undef OXEN_DEFAULT_LOG_CATEGORY
+#define OXEN_DEFAULT_LOG_CATEGORY "numa"
+
+namespace tools::numa
+{
+
+namespace
+{
+  constexpr size_t num_roles = static_cast<size_t>(role::_count);
+  constexpr std::array<std::string_view, num_roles> role_names{{"verify", "background", "p2p"}};
+
+  std::mutex placement_mutex;
+  std::array<std::vector<int>, num_roles> role_nodes;
+
+  int parse_id(std::string_view s)
+  {
+    int id;
+    auto [p, ec] = std::from_chars(s.data(), s.data() + s.size(), id);
+    if (s.empty() || ec != std::errc{} || p != s.data() + s.size() || id < 0)
+      throw std::invalid_argument{"invalid id '" + std::string{s} + "'"};
+    return id;
+  }
+
+  // The inverse of parse_list()
+  std::string format_list(const std::vector<int>& ids)
+  {
+    std::string result;
+    for (size_t i = 0; i < ids.size();)
+    {
+      size_t j = i;
+      while (j + 1 < ids.size() && ids[j + 1] == ids[j] + 1)
+        j++;
+      if (!result.empty())
+        result += ',';
+      result += std::to_string(ids[i]);
+      if (j > i)
+        result += '-' + std::to_string(ids[j]);
+      i = j + 1;
+    }
+    return result;
+  }
+
+  std::vector<node> read_nodes()
+  {
+    std::vector<node> result;
+#ifdef __linux__
+    std::error_code ec;
+    for (fs::directory_iterator it{"/sys/devices/system/node", ec}, end; !ec && it != end; it.increment(ec))
+    {
+      auto name = it->path().filename().string();
+      if (name.size() <= 4 || name.compare(0, 4, "node") != 0)
+        continue;
+      try
+      {
+        node n{parse_id(std::string_view{name}.substr(4)), {}};
+        std::ifstream cpulist{it->path() / "cpulist"};
+        std::string line;
+        std::getline(cpulist, line);
+        while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back())))
+          line.pop_back();
+        n.cpus = parse_list(line);
+        result.push_back(std::move(n));
+      }
+      catch (const std::exception& e)
+      {
+        MWARNING("Ignoring NUMA node " << name << ": " << e.what());
+      }
+    }
+    std::sort(result.begin(), result.end(), [](const node& a, const node& b) { return a.id < b.id; });
+#endif
+    return result;
+  }
+
+  const node* find_node(int id)
+  {
+    for (auto& n : nodes())
+      if (n.id == id)
+        return &n;
+    return nullptr;
+  }
+}
+
+const std::vector<node>& nodes()
+{
+  static const std::vector<node> result = read_nodes();
+  return result;
+}
+
+std::vector<int> parse_list(std::string_view list)
+{
+  std::vector<int> result;
+  for (bool more = !list.empty(); more;)
+  {
+    auto comma = list.find(',');
+    auto item = list.substr(0, comma);
+    more = comma != std::string_view::npos;
+    list.remove_prefix(more ? comma + 1 : list.size());
+    if (item.empty())
+      throw std::invalid_argument{"empty item in list"};
+    auto dash = item.find('-');
+    int first = parse_id(item.substr(0, dash));
+    int last = dash == std::string_view::npos ? first : parse_id(item.substr(dash + 1));
+    if (last < first)
+      throw std::invalid_argument{"invalid range '" + std::string{item} + "'"};
+    for (int i = first; i <= last; i++)
+      result.push_back(i);
+  }
+  std::sort(result.begin(), result.end());
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+  return result;
+}
+
+void set_nodes(role r, std::vector<int> node_ids)
+{
+  for (int id : node_ids)
+    if (!find_node(id))
+      throw std::invalid_argument{"no NUMA node " + std::to_string(id) + " on this machine"};
+  std::lock_guard lock{placement_mutex};
+  role_nodes[static_cast<size_t>(r)] = std::move(node_ids);
+}
+
+bool place_current_thread(role r)
+{
+  std::vector<int> node_ids;
+  {
+    std::lock_guard lock{placement_mutex};
+    node_ids = role_nodes[static_cast<size_t>(r)];
+  }
+  if (node_ids.empty())
+    return true;
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int id : node_ids)
+    if (auto* n = find_node(id))
+      for (int cpu : n->cpus)
+        if (cpu < CPU_SETSIZE)
+          CPU_SET(cpu, &set);
+  // (0 is the calling thread, not the whole process)
+  if (sched_setaffinity(0, sizeof(set), &set) != 0)
+  {
+    MWARNING("Failed to pin " << role_names[static_cast<size_t>(r)] << " thread to NUMA node(s) " << format_list(node_ids));
+    return false;
+  }
+  MDEBUG("Pinned " << role_names[static_cast<size_t>(r)] << " thread to NUMA node(s) " << format_list(node_ids));
+  return true;
+#else
+  return false;
+#endif
+}
+
+std::string describe()
+{
+  auto& all = nodes();
+  if (all.empty())
+    return "NUMA topology unavailable; threads are not pinned";
+  std::string result = std::to_string(all.size()) + " NUMA node(s):";
+  for (auto& n : all)
+    result += " node " + std::to_string(n.id) + " (CPUs " + format_list(n.cpus) + ");";
+  std::lock_guard lock{placement_mutex};
+  for (size_t i = 0; i < num_roles; i++)
+  {
+    result += ' ';
+    result += role_names[i];
+    result += " threads on ";
+    result += role_nodes[i].empty() ? "any node" : "node(s) " + format_list(role_nodes[i]);
+    result += i + 1 < num_roles ? ',' : '.';
+  }
+  return result;
+}
+
+}
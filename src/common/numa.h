@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// NUMA-aware placement of the daemon's threads (`--numa-verify-nodes` and friends).  Each kind of
+// thread can be restricted to the CPUs of a set of NUMA nodes, so that, e.g., verification workers
+// stay on the node closest to the memory and devices they use instead of bouncing between sockets.
+// Memory follows: with the kernel's default first-touch policy, what a pinned thread allocates
+// (its stack, RandomX VM, scratch buffers) ends up on its own node.
+//
+// The topology is read from /sys/devices/system/node, so this only does anything on Linux; on
+// other platforms (or a machine with a single node) nodes() is empty and placement is a no-op.
+namespace tools::numa
+{
+
+struct node
+{
+  int id;
+  std::vector<int> cpus;
+};
+
+// The machine's NUMA nodes, in id order; read once, on first use
+const std::vector<node>& nodes();
+
+// Parses a list of ids in the kernel's cpulist format, e.g. "0", "0-3" or "0,2,8-11", into the
+// sorted ids.  Throws std::invalid_argument if it is malformed.
+std::vector<int> parse_list(std::string_view list);
+
+// Kinds of threads that can be placed
+enum class role { verify, background, p2p, _count };
+
+// Restricts threads of `r` to the CPUs of `node_ids` (empty: no restriction).  Applies to threads
+// placed (see place_current_thread()) from then on, so it is meant for startup, before the threads
+// are created.  Throws std::invalid_argument if a node doesn't exist.
+void set_nodes(role r, std::vector<int> node_ids);
+
+// Pins the calling thread to the CPUs of its role's nodes, if set.  Returns false (after logging
+// why) if it couldn't be pinned.
+bool place_current_thread(role r);
+
+// One-line description of the topology and of where each kind of thread runs, for logging at
+// startup
+std::string describe();
+
+}
@@ -67,7 +67,7 @@ PerformanceTimer::PerformanceTimer(bool paused): started(true), paused(paused)
     ticks = epee::misc_utils::get_ns_count();
 }
 
-LoggingPerformanceTimer::LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, el::Level l): PerformanceTimer(), name(s), cat(cat), unit(unit), level(l)
+LoggingPerformanceTimer::LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, el::Level l, metrics::histogram *histogram): PerformanceTimer(), name(s), cat(cat), unit(unit), level(l), histogram(histogram)
 {
   const bool log = ELPP->vRegistry()->allowed(level, cat.c_str());
   if (!performance_timers)
@@ -96,6 +96,8 @@ LoggingPerformanceTimer::LoggingPerformanceTimer(const std::string &s, const std
 LoggingPerformanceTimer::~LoggingPerformanceTimer()
 {
   pause();
+  if (histogram)
+    histogram->record(ticks);
   performance_timers->pop_back();
   const bool log = ELPP->vRegistry()->allowed(level, cat.c_str());
   if (log)
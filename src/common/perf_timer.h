@@ -33,6 +33,7 @@
 #include <cstdio>
 #include <cstdint>
 #include "epee/misc_log_ex.h"
+#include "metrics.h"
 
 namespace tools
 {
@@ -60,7 +61,8 @@ protected:
 class LoggingPerformanceTimer: public PerformanceTimer
 {
 public:
-  LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, el::Level l = el::Level::Info);
+  // If `histogram` is given the measured time (in ns) is also recorded into it on destruction.
+  LoggingPerformanceTimer(const std::string &s, const std::string &cat, uint64_t unit, el::Level l = el::Level::Info, metrics::histogram *histogram = nullptr);
   ~LoggingPerformanceTimer();
 
 private:
@@ -68,15 +70,21 @@ private:
   std::string cat;
   uint64_t unit;
   el::Level level;
+  metrics::histogram *histogram;
 };
 
+// Looks up (once per call site) the metrics histogram of a PERF_TIMER
+#define PERF_TIMER_HISTOGRAM(name) ([]() -> tools::metrics::histogram* { \
+    static tools::metrics::histogram &h = tools::metrics::get_histogram(#name, OXEN_DEFAULT_LOG_CATEGORY); \
+    return &h; }())
+
 void set_performance_timer_log_level(el::Level level);
 
-#define PERF_TIMER_UNIT(name, unit) tools::LoggingPerformanceTimer pt_##name(#name, "perf." OXEN_DEFAULT_LOG_CATEGORY, unit, tools::performance_timer_log_level)
-#define PERF_TIMER_UNIT_L(name, unit, l) tools::LoggingPerformanceTimer pt_##name(#name, "perf." OXEN_DEFAULT_LOG_CATEGORY, unit, l)
+#define PERF_TIMER_UNIT(name, unit) tools::LoggingPerformanceTimer pt_##name(#name, "perf." OXEN_DEFAULT_LOG_CATEGORY, unit, tools::performance_timer_log_level, PERF_TIMER_HISTOGRAM(name))
+#define PERF_TIMER_UNIT_L(name, unit, l) tools::LoggingPerformanceTimer pt_##name(#name, "perf." OXEN_DEFAULT_LOG_CATEGORY, unit, l, PERF_TIMER_HISTOGRAM(name))
 #define PERF_TIMER(name) PERF_TIMER_UNIT(name, 1000000)
 #define PERF_TIMER_L(name, l) PERF_TIMER_UNIT_L(name, 1000000, l)
-#define PERF_TIMER_START_UNIT(name, unit) std::unique_ptr<tools::LoggingPerformanceTimer> pt_##name(new tools::LoggingPerformanceTimer(#name, "perf." OXEN_DEFAULT_LOG_CATEGORY, unit, el::Level::Info))
+#define PERF_TIMER_START_UNIT(name, unit) std::unique_ptr<tools::LoggingPerformanceTimer> pt_##name(new tools::LoggingPerformanceTimer(#name, "perf." OXEN_DEFAULT_LOG_CATEGORY, unit, el::Level::Info, PERF_TIMER_HISTOGRAM(name)))
 #define PERF_TIMER_START(name) PERF_TIMER_START_UNIT(name, 1000000)
 #define PERF_TIMER_STOP(name) do { pt_##name.reset(NULL); } while(0)
 #define PERF_TIMER_PAUSE(name) pt_##name->pause()
@@ -0,0 +1,323 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "epee/misc_log_ex.h"
+#include "epee/thread_name.h"
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__aarch64__))
+#define PROFILER_SUPPORTED
+#include <cerrno>
+#include <csignal>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#endif
+
+#undef OXEN_DEFAULT_LOG_CATEGORY
+#define OXEN_DEFAULT_LOG_CATEGORY "profiler"
+
+namespace tools::profiler
+{
+
+#ifdef PROFILER_SUPPORTED
+
+using namespace std::literals;
+
+namespace
+{
+  constexpr size_t MAX_FRAMES = 64;
+  // The signal handler writes samples into a ring of this many slots, which the drain thread empties
+  // every DRAIN_INTERVAL; samples arriving while the ring is full are counted and dropped.
+  constexpr size_t RING_SIZE = 8192;
+  constexpr auto DRAIN_INTERVAL = 50ms;
+
+  struct sample
+  {
+    std::atomic<bool> ready{false};
+    uint32_t depth;
+    char thread[sizeof(epee::thread_info::name)];
+    uintptr_t pcs[MAX_FRAMES]; // innermost first
+  };
+
+  // Everything the signal handler touches
+  std::atomic<sample*> ring{nullptr};
+  std::atomic<size_t> next_slot{0};
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<int> in_handler{0};
+
+  std::mutex control_mutex; // start/stop
+  bool sampling = false;
+  std::thread drainer;
+  std::condition_variable drainer_cv;
+  bool stopping = false;
+
+  std::mutex stacks_mutex;
+  std::map<std::pair<std::string, std::vector<uintptr_t>>, uint64_t> stacks;
+
+  void on_sigprof(int, siginfo_t*, void* context)
+  {
+    const int saved_errno = errno;
+    // (seq_cst, so that stop() either sees us in here or we see the ring gone)
+    in_handler.fetch_add(1);
+    if (sample* r = ring.load())
+    {
+      sample& s = r[next_slot.fetch_add(1, std::memory_order_relaxed) % RING_SIZE];
+      if (s.ready.load(std::memory_order_acquire))
+        dropped.fetch_add(1, std::memory_order_relaxed);
+      else
+      {
+        const auto& mc = static_cast<const ucontext_t*>(context)->uc_mcontext;
+#if defined(__x86_64__)
+        uintptr_t pc = mc.gregs[REG_RIP], fp = mc.gregs[REG_RBP], sp = mc.gregs[REG_RSP];
+#else
+        uintptr_t pc = mc.pc, fp = mc.regs[29], sp = mc.sp;
+#endif
+        const auto& info = epee::this_thread_info();
+        std::memcpy(s.thread, info.name, sizeof(s.thread));
+        size_t depth = 0;
+        s.pcs[depth++] = pc;
+        // Each frame starts with the caller's frame pointer followed by the return address.  Frames
+        // live between the stack pointer and the top of the stack, further out the further out the
+        // caller is; anything else means this frame doesn't have a frame pointer, so stop there.
+        if (info.stack_hi)
+        {
+          const uintptr_t lo = std::max(sp, info.stack_lo);
+          while (depth < MAX_FRAMES && fp >= lo && fp % alignof(uintptr_t) == 0
+              && fp + 2 * sizeof(uintptr_t) <= info.stack_hi)
+          {
+            const auto* frame = reinterpret_cast<const uintptr_t*>(fp);
+            if (!frame[1])
+              break;
+            s.pcs[depth++] = frame[1];
+            if (frame[0] <= fp)
+              break;
+            fp = frame[0];
+          }
+        }
+        s.depth = depth;
+        s.ready.store(true, std::memory_order_release);
+      }
+    }
+    in_handler.fetch_sub(1, std::memory_order_release);
+    errno = saved_errno;
+  }
+
+  void drain(sample* r)
+  {
+    std::lock_guard lock{stacks_mutex};
+    for (size_t i = 0; i < RING_SIZE; i++)
+    {
+      sample& s = r[i];
+      if (!s.ready.load(std::memory_order_acquire))
+        continue;
+      std::string thread{s.thread, strnlen(s.thread, sizeof(s.thread))};
+      stacks[{std::move(thread), std::vector<uintptr_t>(s.pcs, s.pcs + s.depth)}]++;
+      s.ready.store(false, std::memory_order_release);
+    }
+  }
+
+  // describe_address(), cached for the life of the process as the same few thousand addresses keep
+  // coming up.  Only called with control_mutex held.
+  const std::string& symbol(uintptr_t pc)
+  {
+    static std::unordered_map<uintptr_t, std::string> cache;
+    auto [it, inserted] = cache.try_emplace(pc);
+    if (inserted)
+    {
+      it->second = describe_address(pc);
+      std::replace(it->second.begin(), it->second.end(), ';', ':');
+    }
+    return it->second;
+  }
+
+  // Takes (and clears) the collected stacks in collapsed format.  Called with control_mutex held.
+  std::string take_stacks()
+  {
+    decltype(stacks) raw;
+    {
+      std::lock_guard lock{stacks_mutex};
+      raw.swap(stacks);
+    }
+    // Different return addresses within the same functions collapse to the same stack
+    std::map<std::string, uint64_t> collapsed;
+    for (const auto& [key, count] : raw)
+    {
+      const auto& [thread, pcs] = key;
+      std::string stack = thread.empty() ? "(unnamed)" : thread;
+      std::replace(stack.begin(), stack.end(), ';', ':');
+      std::replace(stack.begin(), stack.end(), ' ', '_');
+      for (size_t i = pcs.size(); i-- > 0; )
+      {
+        stack += ';';
+        // Return addresses point just after the call, which could be the start of the next function
+        stack += symbol(i == 0 ? pcs[i] : pcs[i] - 1);
+      }
+      collapsed[std::move(stack)] += count;
+    }
+    if (auto n = dropped.exchange(0))
+      collapsed["(dropped)"] += n;
+
+    std::string out;
+    for (const auto& [stack, count] : collapsed)
+    {
+      out += stack;
+      out += ' ';
+      out += std::to_string(count);
+      out += '\n';
+    }
+    return out;
+  }
+
+  bool set_timer(unsigned int hz)
+  {
+    itimerval timer{};
+    if (hz)
+    {
+      const long period_us = 1'000'000 / hz;
+      timer.it_interval.tv_sec = period_us / 1'000'000;
+      timer.it_interval.tv_usec = period_us % 1'000'000;
+      timer.it_value = timer.it_interval;
+    }
+    return setitimer(ITIMER_PROF, &timer, nullptr) == 0;
+  }
+}
+
+std::string describe_address(uintptr_t pc)
+{
+  std::ostringstream name;
+  Dl_info dl;
+  if (dladdr(reinterpret_cast<void*>(pc), &dl) && dl.dli_sname)
+  {
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(dl.dli_sname, nullptr, nullptr, &status);
+    name << (status == 0 && demangled ? demangled : dl.dli_sname);
+    std::free(demangled);
+  }
+  else if (dl.dli_fname)
+  {
+    const char* base = std::strrchr(dl.dli_fname, '/');
+    name << (base ? base + 1 : dl.dli_fname) << "+0x" << std::hex << pc - reinterpret_cast<uintptr_t>(dl.dli_fbase);
+  }
+  else
+    name << "0x" << std::hex << pc;
+  return name.str();
+}
+
+bool start(unsigned int hz)
+{
+  std::lock_guard lock{control_mutex};
+  if (sampling)
+    return false;
+  hz = std::clamp(hz, 1u, 1000u);
+
+  // Installed once and left in place: a SIGPROF still pending after stop() must not hit the default
+  // action (which is to terminate), and the handler does nothing while there's no ring.
+  static bool installed = false;
+  if (!installed)
+  {
+    struct sigaction sa{};
+    sa.sa_sigaction = on_sigprof;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGPROF, &sa, nullptr) != 0)
+    {
+      MERROR("Unable to install the profiler's SIGPROF handler: " << std::strerror(errno));
+      return false;
+    }
+    installed = true;
+  }
+
+  ring.store(new sample[RING_SIZE], std::memory_order_release);
+  if (!set_timer(hz))
+  {
+    MERROR("Unable to start the profiling timer: " << std::strerror(errno));
+    delete[] ring.exchange(nullptr);
+    return false;
+  }
+
+  stopping = false;
+  drainer = std::thread{[] {
+    epee::set_thread_name("[profiler]");
+    while (true)
+    {
+      {
+        std::unique_lock wait_lock{stacks_mutex};
+        if (drainer_cv.wait_for(wait_lock, DRAIN_INTERVAL, [] { return stopping; }))
+          return;
+      }
+      drain(ring.load(std::memory_order_acquire));
+    }
+  }};
+  sampling = true;
+  MINFO("Started the sampling profiler at " << hz << "Hz");
+  return true;
+}
+
+bool running()
+{
+  std::lock_guard lock{control_mutex};
+  return sampling;
+}
+
+std::string collect()
+{
+  std::lock_guard lock{control_mutex};
+  if (!sampling)
+    return "";
+  drain(ring.load(std::memory_order_acquire));
+  return take_stacks();
+}
+
+std::string stop()
+{
+  std::lock_guard lock{control_mutex};
+  if (!sampling)
+    return "";
+  set_timer(0);
+  {
+    std::lock_guard stacks_lock{stacks_mutex};
+    stopping = true;
+  }
+  drainer_cv.notify_all();
+  drainer.join();
+
+  // Wait out any handler that picked up the ring before we took it away
+  sample* r = ring.exchange(nullptr);
+  while (in_handler.load())
+    std::this_thread::yield();
+  drain(r);
+  delete[] r;
+  sampling = false;
+  MINFO("Stopped the sampling profiler");
+  return take_stacks();
+}
+
+#else
+
+bool start(unsigned int) { return false; }
+bool running() { return false; }
+std::string collect() { return ""; }
+std::string stop() { return ""; }
+std::string describe_address(uintptr_t pc)
+{
+  std::ostringstream name;
+  name << "0x" << std::hex << pc;
+  return name.str();
+}
+
+#endif
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Built-in sampling CPU profiler, for slow nodes that can't easily have perf attached (e.g. in
+// containers).  While running, SIGPROF fires every 1/hz seconds of process CPU time and the
+// signalled thread's stack is unwound by following frame pointers; the samples are collected by a
+// background thread and returned in the collapsed-stack format of flamegraph.pl / inferno:
+//
+//     THREAD;OUTERMOST_FRAME;...;INNERMOST_FRAME COUNT
+//
+// Only threads named with epee::set_thread_name() (or MLOG_SET_THREAD_NAME) have their stacks
+// unwound, as that is where the stack bounds needed to do so safely are recorded; samples of other
+// threads just have the function that was executing, under "(unnamed)".  Full stacks need a build
+// with frame pointers, and frame names need exported symbols (the FRAME_POINTERS cmake option does
+// both); frames that can't be named are given as `module+0xOFFSET`, for addr2line.
+//
+// Only supported on Linux x86-64 and arm64; elsewhere start() returns false.
+namespace tools::profiler
+{
+
+// Starts sampling at `hz` samples per second of CPU time.  Returns false if already running, if
+// unsupported, or if the timer or signal handler couldn't be set up.
+bool start(unsigned int hz = 99);
+
+bool running();
+
+// Returns the samples taken since start() or the last collect() as collapsed stacks, and clears
+// them, without stopping.  Empty if not running.
+std::string collect();
+
+// Stops sampling and returns the remaining samples as collect() does.
+std::string stop();
+
+// The (demangled) name of the function containing code address `pc`, or `module+0xOFFSET` if it
+// has no symbol, as used for the frames of collected stacks.
+std::string describe_address(uintptr_t pc);
+
+}
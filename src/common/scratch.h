@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace tools
+{
+
+namespace detail
+{
+  inline std::atomic<uint64_t> scratch_generation{0};
+}
+
+// Reusable per-thread temporaries for hot validation paths.  Constructing a scratch<T> checks out a
+// T from the calling thread's pool of idle ones (or makes a new one if there are none) and the
+// destructor returns it, so a vector used for every transaction of a block keeps its capacity
+// rather than being reallocated each time.  The object is *not* cleared on checkout: callers clear
+// (or resize) it as needed, which leaves the allocations in place.
+//
+// Nested or reentrant use on one thread is fine (e.g. a threadpool job run by a thread waiting in
+// the middle of using a scratch): each live scratch<T> has its own object.
+//
+// release_scratch() drops every idle object on every thread, e.g. once a block has been handled.
+// Threads discard their idle objects the next time they check one out, so memory held by a thread
+// that is no longer validating anything is only freed at thread exit.
+template <typename T>
+class scratch
+{
+public:
+  scratch()
+  {
+    auto& p = local();
+    if (p.idle.empty())
+      m_obj = std::make_unique<T>();
+    else
+    {
+      m_obj = std::move(p.idle.back());
+      p.idle.pop_back();
+    }
+  }
+
+  ~scratch()
+  {
+    try { local().idle.push_back(std::move(m_obj)); }
+    catch (...) {} // Out of memory: just free it
+  }
+
+  scratch(const scratch&) = delete;
+  scratch& operator=(const scratch&) = delete;
+
+  T& operator*() { return *m_obj; }
+  T* operator->() { return m_obj.get(); }
+
+private:
+  struct pool
+  {
+    std::vector<std::unique_ptr<T>> idle;
+    uint64_t generation = 0;
+  };
+
+  static pool& local()
+  {
+    thread_local pool p;
+    if (auto gen = detail::scratch_generation.load(std::memory_order_relaxed); gen != p.generation)
+    {
+      p.idle.clear();
+      p.generation = gen;
+    }
+    return p;
+  }
+
+  std::unique_ptr<T> m_obj;
+};
+
+// Frees all idle scratch objects (lazily, on each thread's next use); see scratch<T>.
+inline void release_scratch() { detail::scratch_generation.fetch_add(1, std::memory_order_relaxed); }
+
+}
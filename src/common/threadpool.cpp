@@ -25,18 +25,69 @@
 // INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#include <array>
+
 #include "epee/misc_log_ex.h"
 #include "common/threadpool.h"
 
 #include "cryptonote_config.h"
 #include "common/util.h"
+#include "common/metrics.h"
+#include "common/numa.h"
 
 static thread_local int depth = 0;
 static thread_local bool is_leaf = false;
+// The pool (and queue index) of the worker thread we are, if any
+static thread_local const tools::threadpool* worker_pool = nullptr;
+static thread_local size_t worker_index = 0;
 
 namespace tools
 {
-threadpool::threadpool(unsigned int max_threads) : running(true), active(0) {
+namespace
+{
+  constexpr size_t num_domains = static_cast<size_t>(threadpool::domain::_count);
+  std::array<std::atomic<unsigned int>, num_domains> domain_threads{};
+  std::array<std::atomic<threadpool*>, num_domains> domain_pools{};
+
+  unsigned int threads_for(threadpool::domain d) {
+    if (unsigned int n = domain_threads[static_cast<size_t>(d)])
+      return n;
+    if (d == threadpool::domain::background)
+      return std::max(2u, tools::get_max_concurrency() / 2);
+    return 0;
+  }
+}
+
+threadpool& threadpool::getInstance(domain d) {
+  if (d == domain::background) {
+    static threadpool background{threads_for(d), "background", d};
+    [[maybe_unused]] static bool registered = (domain_pools[static_cast<size_t>(d)] = &background);
+    return background;
+  }
+  static threadpool verify{threads_for(domain::verify), "verify", domain::verify};
+  [[maybe_unused]] static bool registered = (domain_pools[static_cast<size_t>(domain::verify)] = &verify);
+  return verify;
+}
+
+void threadpool::set_threads(domain d, unsigned int threads) {
+  domain_threads[static_cast<size_t>(d)] = threads;
+  if (threadpool* pool = domain_pools[static_cast<size_t>(d)]) {
+    pool->destroy();
+    pool->create(threads_for(d));
+  }
+}
+
+void threadpool::set_numa_nodes(domain d, std::vector<int> nodes) {
+  numa::set_nodes(d == domain::background ? numa::role::background : numa::role::verify, std::move(nodes));
+  if (threadpool* pool = domain_pools[static_cast<size_t>(d)])
+    pool->recycle();
+}
+
+threadpool::threadpool(unsigned int max_threads, const std::string& name, std::optional<domain> dom) : active(0), running(true), name(name), dom(dom),
+  jobs_queued{metrics::get_counter("threadpool_" + name + "_jobs_queued", "threadpool")},
+  jobs_started{metrics::get_counter("threadpool_" + name + "_jobs_started", "threadpool")},
+  queue_wait{metrics::get_histogram("threadpool_" + name + "_queue_wait", "threadpool")}
+{
   create(max_threads);
 }
 
@@ -74,18 +125,25 @@ void threadpool::create(unsigned int max_threads) {
   const std::unique_lock lock{mutex};
   max = max_threads ? max_threads : tools::get_max_concurrency();
   running = true;
-  for (size_t i = max ? max : 1; i > 0; i--) {
-    threads.emplace_back([this] { run(false); });
+  const size_t count = max ? max : 1;
+  // Queues are kept (with any jobs still in them) when recycling
+  while (queues.size() < count)
+    queues.push_back(std::make_unique<worker_queue>());
+  for (size_t i = 0; i < count; i++) {
+    threads.emplace_back([this, i] {
+      MLOG_SET_THREAD_NAME("[" + name + std::to_string(i) + "]");
+      if (dom)
+        numa::place_current_thread(*dom == domain::background ? numa::role::background : numa::role::verify);
+      run(false, i);
+    });
   }
 }
 
-void threadpool::submit(waiter *obj, std::function<void()> f, bool leaf) {
+void threadpool::submit(waiter *obj, task f, bool leaf) {
   CHECK_AND_ASSERT_THROW_MES(!is_leaf, "A leaf routine is using a thread pool");
-  std::unique_lock lock{mutex};
-  if (!leaf && ((active == max && !queue.empty()) || depth > 0)) {
+  if (!leaf && ((active == max && pending > 0) || depth > 0)) {
     // if all available threads are already running
     // and there's work waiting, just run in current thread
-    lock.unlock();
     ++depth;
     is_leaf = leaf;
     f();
@@ -94,11 +152,23 @@ void threadpool::submit(waiter *obj, std::function<void()> f, bool leaf) {
   } else {
     if (obj)
       obj->inc();
-    if (leaf)
-      queue.push_front({obj, f, leaf});
-    else
-      queue.push_back({obj, f, leaf});
-    has_work.notify_one();
+    auto& q = *queues[worker_pool == this ? worker_index : next_queue++ % queues.size()];
+    {
+      const std::unique_lock lock{q.mutex};
+      const auto now = std::chrono::steady_clock::now();
+      if (leaf)
+        q.jobs.push_front({obj, std::move(f), leaf, now});
+      else
+        q.jobs.push_back({obj, std::move(f), leaf, now});
+    }
+    jobs_queued.inc();
+    // Pairs with run()'s idle increment then pending check: either it sees this job, or we see it
+    // idle (and it is waiting, or about to check pending, by the time we have the lock).
+    ++pending;
+    if (idle > 0) {
+      const std::unique_lock lock{mutex};
+      has_work.notify_one();
+    }
   }
 }
 
@@ -145,22 +215,49 @@ void threadpool::waiter::dec() {
     cv.notify_all();
 }
 
-void threadpool::run(bool flush) {
-  std::unique_lock lock{mutex};
+bool threadpool::try_pop(entry& e) {
+  if (pending == 0)
+    return false;
+  // Our own queue first (if we're a worker), then the others'.  Jobs are taken from the front
+  // either way, which is where leaf jobs go, so that they (which the thread that submitted them is
+  // usually waiting on) run before the rest.
+  const size_t n = queues.size();
+  const size_t start = worker_pool == this ? worker_index : next_queue.load(std::memory_order_relaxed) % n;
+  for (size_t i = 0; i < n; i++) {
+    auto& q = *queues[(start + i) % n];
+    const std::unique_lock lock{q.mutex};
+    if (q.jobs.empty())
+      continue;
+    e = std::move(q.jobs.front());
+    q.jobs.pop_front();
+    --pending;
+    return true;
+  }
+  return false;
+}
+
+void threadpool::run(bool flush, size_t index) {
+  if (!flush) {
+    worker_pool = this;
+    worker_index = index;
+  }
   while (running) {
     entry e;
-    while(queue.empty() && running)
+    if (!try_pop(e))
     {
       if (flush)
         return;
-      has_work.wait(lock);
+      std::unique_lock lock{mutex};
+      ++idle;
+      has_work.wait(lock, [this] { return !running || pending > 0; });
+      --idle;
+      continue;
     }
-    if (!running) break;
+
+    jobs_started.inc();
+    queue_wait.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - e.queued).count());
 
     active++;
-    e = std::move(queue.front());
-    queue.pop_front();
-    lock.unlock();
     ++depth;
     is_leaf = e.leaf;
     e.f();
@@ -169,7 +266,6 @@ void threadpool::run(bool flush) {
 
     if (e.wo)
       e.wo->dec();
-    lock.lock();
     active--;
   }
 }
@@ -27,30 +27,53 @@
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
 #include <utility>
 #include <vector>
 #include <deque>
 #include <stdexcept>
 #include <thread>
 #include <mutex>
+#include <optional>
 #include <condition_variable>
+#include <string>
 
 namespace tools
 {
+namespace metrics { class counter; class histogram; }
+
 //! A global thread pool
 class threadpool
 {
 public:
-  static threadpool& getInstance() {
-    static threadpool instance;
-    return instance;
-  }
+  // Independent global pools, so that jobs of one kind can't hold up another's: `verify` for block,
+  // tx and signature verification (and anything else latency sensitive), `background` for work
+  // that ends up waiting on the network or is done on behalf of RPC clients, such as DNS lookups
+  // and parallel RPC reads.
+  enum class domain { verify, background, _count };
+
+  static threadpool& getInstance(domain d = domain::verify);
   static threadpool *getNewForUnitTests(unsigned max_threads = 0) {
-    return new threadpool(max_threads);
+    return new threadpool(max_threads, "unit_test");
   }
 
+  // Sets the number of threads of a domain's pool (0 for the default: the max concurrency for
+  // `verify`, half of it (but at least 2) for `background`).  Meant for startup: if the pool has
+  // already been created its threads are recreated, which must not race with jobs being submitted.
+  static void set_threads(domain d, unsigned int threads);
+
+  // Pins a domain's worker threads to the CPUs of the given NUMA nodes (see tools::numa); empty
+  // for no restriction.  Like set_threads(), meant for startup: an existing pool's threads are
+  // recreated to apply it.  Throws std::invalid_argument if a node doesn't exist.
+  static void set_numa_nodes(domain d, std::vector<int> nodes);
+
   // The waiter lets the caller know when all of its
   // tasks are completed.
   class waiter {
@@ -65,10 +88,101 @@ public:
     ~waiter();
   };
 
+  // A move-only void() callable that stores callables of up to `inline_size` bytes (such as the
+  // usual lambda capturing a few references) in place, rather than allocating them the way a
+  // std::function with more than a couple of pointers' worth of captures does.
+  class task {
+  public:
+    static constexpr size_t inline_size = 64;
+
+    task() = default;
+    template <typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, task>>>
+    task(F&& f) {
+      using T = std::decay_t<F>;
+      if constexpr (sizeof(T) <= inline_size && alignof(T) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible_v<T>) {
+        new (buf) T(std::forward<F>(f));
+        ops = &inline_ops<T>;
+      } else {
+        new (buf) T*(new T(std::forward<F>(f)));
+        ops = &heap_ops<T>;
+      }
+    }
+    task(task&& t) noexcept : ops{t.ops} {
+      if (ops) {
+        ops->move(t.buf, buf);
+        t.ops = nullptr;
+      }
+    }
+    task& operator=(task&& t) noexcept {
+      if (this != &t) {
+        reset();
+        if ((ops = t.ops)) {
+          ops->move(t.buf, buf);
+          t.ops = nullptr;
+        }
+      }
+      return *this;
+    }
+    ~task() { reset(); }
+
+    void operator()() { ops->call(buf); }
+    explicit operator bool() const { return ops; }
+
+  private:
+    struct operations {
+      void (*call)(void* f);
+      void (*move)(void* from, void* to); // also destroys `from`
+      void (*destroy)(void* f);
+    };
+    template <typename T>
+    static constexpr operations inline_ops{
+      [](void* f) { (*static_cast<T*>(f))(); },
+      [](void* from, void* to) { new (to) T(std::move(*static_cast<T*>(from))); static_cast<T*>(from)->~T(); },
+      [](void* f) { static_cast<T*>(f)->~T(); }};
+    template <typename T>
+    static constexpr operations heap_ops{
+      [](void* f) { (**static_cast<T**>(f))(); },
+      [](void* from, void* to) { new (to) T*(*static_cast<T**>(from)); },
+      [](void* f) { delete *static_cast<T**>(f); }};
+
+    void reset() {
+      if (ops)
+        ops->destroy(buf);
+      ops = nullptr;
+    }
+
+    alignas(std::max_align_t) unsigned char buf[inline_size];
+    const operations* ops = nullptr;
+  };
+
   // Submit a task to the pool. The waiter pointer may be
   // NULL if the caller doesn't care to wait for the
   // task to finish.
-  void submit(waiter *waiter, std::function<void()> f, bool leaf = false);
+  void submit(waiter *waiter, task f, bool leaf = false);
+
+  // Calls f(i) for each i in [begin, end), in chunks of at least `min_chunk` indices spread over
+  // the pool (and the calling thread, which works through chunks while it waits), returning once
+  // all have been called.
+  template <typename F>
+  void parallel_for(size_t begin, size_t end, F&& f, size_t min_chunk = 1) {
+    if (end <= begin)
+      return;
+    const size_t n = end - begin;
+    const size_t chunks = std::max<size_t>(1, std::min<size_t>(n / std::max<size_t>(min_chunk, 1), 4 * (size_t{max} + 1)));
+    if (chunks == 1) {
+      for (size_t i = begin; i < end; ++i)
+        f(i);
+      return;
+    }
+    waiter w;
+    const size_t per = n / chunks, extra = n % chunks;
+    for (size_t c = 0, lo = begin; c < chunks; ++c) {
+      const size_t hi = lo + per + (c < extra ? 1 : 0);
+      submit(&w, [&f, lo, hi] { for (size_t i = lo; i < hi; ++i) f(i); });
+      lo = hi;
+    }
+    w.wait(this);
+  }
 
   // destroy and recreate threads
   void recycle();
@@ -80,22 +194,41 @@ public:
   void start(unsigned int max_threads = 0);
 
   private:
-    threadpool(unsigned int max_threads = 0);
+    threadpool(unsigned int max_threads, const std::string& name, std::optional<domain> dom = std::nullopt);
     void destroy();
     void create(unsigned int max_threads);
     typedef struct entry {
       waiter *wo;
-      std::function<void()> f;
+      task f;
       bool leaf;
+      std::chrono::steady_clock::time_point queued;
     } entry;
-    std::deque<entry> queue;
+    // Each worker thread has its own queue, to which the jobs it submits (i.e. nested leaf jobs) go
+    // and from which it takes jobs first; jobs submitted from other threads are dealt out to the
+    // queues in turn.  A thread whose queue is empty takes (steals) jobs from the others'.
+    struct worker_queue {
+      std::mutex mutex;
+      std::deque<entry> jobs;
+    };
+    std::vector<std::unique_ptr<worker_queue>> queues;
+    std::atomic<size_t> next_queue{0};
+    std::atomic<size_t> pending{0}; // total jobs in all queues
+    std::atomic<unsigned int> idle{0}; // workers waiting on has_work (or about to)
     std::condition_variable has_work;
-    std::mutex mutex;
+    std::mutex mutex; // only for waiting on has_work
     std::vector<std::thread> threads;
-    unsigned int active;
+    std::atomic<unsigned int> active;
     unsigned int max;
-    bool running;
-    void run(bool flush = false);
+    std::atomic<bool> running;
+    std::string name; // "verify" or "background"; worker threads are named "[NAME3]" etc.
+    std::optional<domain> dom; // unset for unit test pools, whose threads aren't placed
+    // Jobs queued and taken off the queues (the difference being the queue depth), and how long
+    // they waited, as "threadpool_<name>_..." in the metrics registry
+    metrics::counter& jobs_queued;
+    metrics::counter& jobs_started;
+    metrics::histogram& queue_wait;
+    bool try_pop(entry& e);
+    void run(bool flush = false, size_t index = SIZE_MAX);
 };
 
 }
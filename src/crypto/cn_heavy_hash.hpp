@@ -122,6 +122,23 @@ public:
 			software_hash(in, len, out, prehashed);
 	}
 
+	// Hashes in[i] into out[i] with ctx[i], for i < n.  With hardware AES on x86 the main loops of
+	// up to MAX_LANES hashes are interleaved: each one is a chain of dependent scratchpad loads,
+	// AES rounds and multiplies, so a single hash leaves most of the core idle.
+	static constexpr size_t MAX_LANES = 4;
+	static void hash_multi(cn_heavy_hash* const* ctx, size_t n, const void* const* in, const size_t* len, void* const* out)
+	{
+#if defined(HAS_INTEL_HW)
+		if(cpu_aes_enabled && n > 1)
+		{
+			hardware_hash_multi(ctx, n, in, len, out);
+			return;
+		}
+#endif
+		for(size_t i = 0; i < n; i++)
+			ctx[i]->hash(in[i], len[i], out[i]);
+	}
+
 	void software_hash(const void* in, size_t len, void* out, bool prehashed);
 	
 #if !defined(HAS_INTEL_HW) && !defined(HAS_ARM_HW)
@@ -130,6 +147,10 @@ public:
 	void hardware_hash(const void* in, size_t len, void* out, bool prehashed);
 #endif
 
+#if defined(HAS_INTEL_HW)
+	static void hardware_hash_multi(cn_heavy_hash* const* ctx, size_t n, const void* const* in, const size_t* len, void* const* out);
+#endif
+
 private:
 	static constexpr size_t MASK = ((MEMORY-1) >> 4) << 4;
 	friend cn_heavy_hash_v1;
@@ -167,6 +188,11 @@ private:
 	void implode_scratchpad_hard();
 #endif
 
+#if defined(HAS_INTEL_HW)
+	template<size_t N>
+	static void hardware_hash_lanes(cn_heavy_hash* const* ctx, const void* const* in, const size_t* len, void* const* out, bool prehashed);
+#endif
+
 	void explode_scratchpad_soft();
 	void implode_scratchpad_soft();
 
@@ -354,75 +354,122 @@ inline uint64_t xmm_extract_64(__m128i x)
 }
 
 template<size_t MEMORY, size_t ITER, size_t VERSION>
-void cn_heavy_hash<MEMORY,ITER,VERSION>::hardware_hash(const void* in, size_t len, void* out, bool prehashed)
+template<size_t N>
+void cn_heavy_hash<MEMORY,ITER,VERSION>::hardware_hash_lanes(cn_heavy_hash* const* ctx, const void* const* in, const size_t* len, void* const* out, bool prehashed)
 {
-	if (!prehashed)
-		keccak((const uint8_t *)in, len, spad.as_byte(), 200);
+	uint8_t* pad[N];
+	uint64_t al0[N], ah0[N], idx0[N];
+	__m128i bx0[N];
 
-	explode_scratchpad_hard();
-	
-	uint64_t* h0 = spad.as_uqword();
+	for(size_t j = 0; j < N; j++)
+	{
+		if (!prehashed)
+			keccak((const uint8_t *)in[j], len[j], ctx[j]->spad.as_byte(), 200);
 
-	uint64_t al0 = h0[0] ^ h0[4];
-	uint64_t ah0 = h0[1] ^ h0[5];
-	__m128i bx0 = _mm_set_epi64x(h0[3] ^ h0[7], h0[2] ^ h0[6]);
+		ctx[j]->explode_scratchpad_hard();
 
-	uint64_t idx0 = h0[0] ^ h0[4];
+		uint64_t* h0 = ctx[j]->spad.as_uqword();
+
+		al0[j] = h0[0] ^ h0[4];
+		ah0[j] = h0[1] ^ h0[5];
+		bx0[j] = _mm_set_epi64x(h0[3] ^ h0[7], h0[2] ^ h0[6]);
+
+		idx0[j] = h0[0] ^ h0[4];
+		pad[j] = ctx[j]->lpad.as_byte();
+	}
 
 	// Optim - 90% time boundary
 	for(size_t i = 0; i < ITER; i++)
 	{
-		__m128i cx;
-		cx = _mm_load_si128(as_xmm(scratchpad_ptr(idx0)));
-
-		cx = _mm_aesenc_si128(cx, _mm_set_epi64x(ah0, al0));
-
-		_mm_store_si128(as_xmm(scratchpad_ptr(idx0)), _mm_xor_si128(bx0, cx));
-		idx0 = xmm_extract_64(cx);
-		bx0 = cx;
+		for(size_t j = 0; j < N; j++)
+		{
+			cn_sptr p = pad[j] + (idx0[j] & MASK);
+			__m128i cx;
+			cx = _mm_load_si128(as_xmm(p));
+
+			cx = _mm_aesenc_si128(cx, _mm_set_epi64x(ah0[j], al0[j]));
+
+			_mm_store_si128(as_xmm(p), _mm_xor_si128(bx0[j], cx));
+			idx0[j] = xmm_extract_64(cx);
+			bx0[j] = cx;
+
+			p = pad[j] + (idx0[j] & MASK);
+			uint64_t hi, lo, cl, ch;
+			cl = p.as_uqword(0);
+			ch = p.as_uqword(1);
+
+			lo = _umul128(idx0[j], cl, &hi);
+
+			al0[j] += hi;
+			ah0[j] += lo;
+			p.as_uqword(0) = al0[j];
+			p.as_uqword(1) = ah0[j];
+			ah0[j] ^= ch;
+			al0[j] ^= cl;
+			idx0[j] = al0[j];
+
+			if(VERSION > 0)
+			{
+				p = pad[j] + (idx0[j] & MASK);
+				int64_t n  = p.as_qword(0);
+				int32_t d  = p.as_dword(2);
+				int64_t q = n / (d | 5);
+				p.as_qword(0) = n ^ q;
+				idx0[j] = d ^ q;
+			}
+		}
+	}
 
-		uint64_t hi, lo, cl, ch;
-		cl = scratchpad_ptr(idx0).as_uqword(0);
-		ch = scratchpad_ptr(idx0).as_uqword(1);
+	for(size_t j = 0; j < N; j++)
+	{
+		ctx[j]->implode_scratchpad_hard();
 
-		lo = _umul128(idx0, cl, &hi);
+		cn_sptr& spad = ctx[j]->spad;
+		keccakf(spad.as_uqword(), 24);
 
-		al0 += hi;
-		ah0 += lo;
-		scratchpad_ptr(idx0).as_uqword(0) = al0;
-		scratchpad_ptr(idx0).as_uqword(1) = ah0;
-		ah0 ^= ch;
-		al0 ^= cl;
-		idx0 = al0;
-		
-		if(VERSION > 0)
+		switch(spad.as_byte(0) & 3)
 		{
-			int64_t n  = scratchpad_ptr(idx0).as_qword(0);
-			int32_t d  = scratchpad_ptr(idx0).as_dword(2);
-			int64_t q = n / (d | 5);
-			scratchpad_ptr(idx0).as_qword(0) = n ^ q;
-			idx0 = d ^ q;
+		case 0:
+			blake256_hash((uint8_t*)out[j], spad.as_byte(), 200);
+			break;
+		case 1:
+			groestl(spad.as_byte(), 200 * 8, (uint8_t*)out[j]);
+			break;
+		case 2:
+			jh_hash(32 * 8, spad.as_byte(), 8 * 200, (uint8_t*)out[j]);
+			break;
+		case 3:
+			skein_hash(8 * 32, spad.as_byte(), 8 * 200, (uint8_t*)out[j]);
+			break;
 		}
 	}
+}
 
-	implode_scratchpad_hard();
-
-	keccakf(spad.as_uqword(), 24);
+template<size_t MEMORY, size_t ITER, size_t VERSION>
+void cn_heavy_hash<MEMORY,ITER,VERSION>::hardware_hash(const void* in, size_t len, void* out, bool prehashed)
+{
+	cn_heavy_hash* self = this;
+	hardware_hash_lanes<1>(&self, &in, &len, &out, prehashed);
+}
 
-	switch(spad.as_byte(0) & 3)
+template<size_t MEMORY, size_t ITER, size_t VERSION>
+void cn_heavy_hash<MEMORY,ITER,VERSION>::hardware_hash_multi(cn_heavy_hash* const* ctx, size_t n, const void* const* in, const size_t* len, void* const* out)
+{
+	while(n > 0)
 	{
-	case 0:
-		blake256_hash((uint8_t*)out, spad.as_byte(), 200);
-		break;
-	case 1:
-		groestl(spad.as_byte(), 200 * 8, (uint8_t*)out);
-		break;
-	case 2:
-		jh_hash(32 * 8, spad.as_byte(), 8 * 200, (uint8_t*)out);
-		break;
-	case 3:
-		skein_hash(8 * 32, spad.as_byte(), 8 * 200, (uint8_t*)out);
-		break;
+		size_t lanes = n < MAX_LANES ? n : MAX_LANES;
+		switch(lanes)
+		{
+		case 1: hardware_hash_lanes<1>(ctx, in, len, out, false); break;
+		case 2: hardware_hash_lanes<2>(ctx, in, len, out, false); break;
+		case 3: hardware_hash_lanes<3>(ctx, in, len, out, false); break;
+		default: hardware_hash_lanes<MAX_LANES>(ctx, in, len, out, false); break;
+		}
+		ctx += lanes;
+		in += lanes;
+		len += lanes;
+		out += lanes;
+		n -= lanes;
 	}
 }
 
@@ -35,6 +35,12 @@
 
 DISABLE_VS_WARNINGS(4146 4244)
 
+/* Build fe_mul, fe_sq and fe_sq2 on 51 bit limbs where the compiler has a 128 bit integer type
+   (all 64 bit gcc/clang targets); define CRYPTO_OPS_FE_REF10 to use the ref10 versions anyway. */
+#if defined(__SIZEOF_INT128__) && !defined(CRYPTO_OPS_FE_REF10)
+#define FE_RADIX51
+#endif
+
 /* Predeclarations */
 
 static void fe_mul(fe, const fe, const fe);
@@ -340,6 +346,104 @@ static int fe_isnonzero(const fe f) {
     s[27] | s[28] | s[29] | s[30] | s[31]) - 1) >> 8) + 1;
 }
 
+#ifdef FE_RADIX51
+
+/*
+fe_mul, fe_sq and fe_sq2 using 64x64->128 bit multiplies: the 10 limbs of f and g are combined
+pairwise into 5 limbs of (nominally) 51 bits, multiplied with 25 instead of 100 products, and the
+result is carried and split back into 10 limbs.  Same pre and postconditions as the ref10 versions
+below; nothing else in this file depends on which ones are used.
+*/
+
+typedef __int128 fe51_acc;
+
+static inline void fe51_load(int64_t out[5], const fe f) {
+  out[0] = (int64_t) f[0] + ((int64_t) f[1] << 26);
+  out[1] = (int64_t) f[2] + ((int64_t) f[3] << 26);
+  out[2] = (int64_t) f[4] + ((int64_t) f[5] << 26);
+  out[3] = (int64_t) f[6] + ((int64_t) f[7] << 26);
+  out[4] = (int64_t) f[8] + ((int64_t) f[9] << 26);
+}
+
+/* Carries (rounding, as ref10 does, so that limbs can be negative) h0..h4 to 51 bits each, then
+   splits each into a 26 and a 25 bit limb. */
+static inline void fe51_store(fe h, fe51_acc h0, fe51_acc h1, fe51_acc h2, fe51_acc h3, fe51_acc h4) {
+  const fe51_acc round = (fe51_acc) 1 << 50;
+  fe51_acc carry;
+  int64_t r[5];
+  int i;
+
+  carry = (h0 + round) >> 51; h1 += carry; h0 -= carry << 51;
+  carry = (h1 + round) >> 51; h2 += carry; h1 -= carry << 51;
+  carry = (h2 + round) >> 51; h3 += carry; h2 -= carry << 51;
+  carry = (h3 + round) >> 51; h4 += carry; h3 -= carry << 51;
+  carry = (h4 + round) >> 51; h0 += carry * 19; h4 -= carry << 51;
+  carry = (h0 + round) >> 51; h1 += carry; h0 -= carry << 51;
+
+  r[0] = (int64_t) h0;
+  r[1] = (int64_t) h1;
+  r[2] = (int64_t) h2;
+  r[3] = (int64_t) h3;
+  r[4] = (int64_t) h4;
+  for (i = 0; i < 5; i++) {
+    int64_t hi = (r[i] + ((int64_t) 1 << 25)) >> 26;
+    h[2 * i] = (int32_t) (r[i] - (hi << 26));
+    h[2 * i + 1] = (int32_t) hi;
+  }
+}
+
+static void fe_mul(fe h, const fe f, const fe g) {
+  int64_t F[5], G[5];
+  int64_t G1_19, G2_19, G3_19, G4_19;
+  fe51_acc h0, h1, h2, h3, h4;
+
+  fe51_load(F, f);
+  fe51_load(G, g);
+  G1_19 = 19 * G[1];
+  G2_19 = 19 * G[2];
+  G3_19 = 19 * G[3];
+  G4_19 = 19 * G[4];
+
+  h0 = (fe51_acc) F[0] * G[0] + (fe51_acc) F[1] * G4_19 + (fe51_acc) F[2] * G3_19 + (fe51_acc) F[3] * G2_19 + (fe51_acc) F[4] * G1_19;
+  h1 = (fe51_acc) F[0] * G[1] + (fe51_acc) F[1] * G[0]  + (fe51_acc) F[2] * G4_19 + (fe51_acc) F[3] * G3_19 + (fe51_acc) F[4] * G2_19;
+  h2 = (fe51_acc) F[0] * G[2] + (fe51_acc) F[1] * G[1]  + (fe51_acc) F[2] * G[0]  + (fe51_acc) F[3] * G4_19 + (fe51_acc) F[4] * G3_19;
+  h3 = (fe51_acc) F[0] * G[3] + (fe51_acc) F[1] * G[2]  + (fe51_acc) F[2] * G[1]  + (fe51_acc) F[3] * G[0]  + (fe51_acc) F[4] * G4_19;
+  h4 = (fe51_acc) F[0] * G[4] + (fe51_acc) F[1] * G[3]  + (fe51_acc) F[2] * G[2]  + (fe51_acc) F[3] * G[1]  + (fe51_acc) F[4] * G[0];
+
+  fe51_store(h, h0, h1, h2, h3, h4);
+}
+
+static inline void fe51_sq(fe51_acc h[5], const fe f) {
+  int64_t F[5];
+  int64_t F0_2, F1_2, F3_19, F4_19;
+
+  fe51_load(F, f);
+  F0_2 = 2 * F[0];
+  F1_2 = 2 * F[1];
+  F3_19 = 19 * F[3];
+  F4_19 = 19 * F[4];
+
+  h[0] = (fe51_acc) F[0] * F[0] + (fe51_acc) F1_2 * F4_19 + (fe51_acc) (2 * F[2]) * F3_19;
+  h[1] = (fe51_acc) F0_2 * F[1] + (fe51_acc) (2 * F[2]) * F4_19 + (fe51_acc) F[3] * F3_19;
+  h[2] = (fe51_acc) F0_2 * F[2] + (fe51_acc) F[1] * F[1] + (fe51_acc) (2 * F[3]) * F4_19;
+  h[3] = (fe51_acc) F0_2 * F[3] + (fe51_acc) F1_2 * F[2] + (fe51_acc) F[4] * F4_19;
+  h[4] = (fe51_acc) F0_2 * F[4] + (fe51_acc) F1_2 * F[3] + (fe51_acc) F[2] * F[2];
+}
+
+static void fe_sq(fe h, const fe f) {
+  fe51_acc s[5];
+  fe51_sq(s, f);
+  fe51_store(h, s[0], s[1], s[2], s[3], s[4]);
+}
+
+static void fe_sq2(fe h, const fe f) {
+  fe51_acc s[5];
+  fe51_sq(s, f);
+  fe51_store(h, 2 * s[0], 2 * s[1], 2 * s[2], 2 * s[3], 2 * s[4]);
+}
+
+#endif
+
 /* From fe_mul.c */
 
 /*
@@ -374,6 +478,7 @@ Can get away with 11 carries, but then data flow is much deeper.
 With tighter constraints on inputs can squeeze carries into int32.
 */
 
+#ifndef FE_RADIX51
 static void fe_mul(fe h, const fe f, const fe g) {
   int32_t f0 = f[0];
   int32_t f1 = f[1];
@@ -591,6 +696,7 @@ static void fe_mul(fe h, const fe f, const fe g) {
   h[8] = h8;
   h[9] = h9;
 }
+#endif
 
 /* From fe_neg.c */
 
@@ -654,6 +760,7 @@ Postconditions:
 See fe_mul.c for discussion of implementation strategy.
 */
 
+#ifndef FE_RADIX51
 static void fe_sq(fe h, const fe f) {
   int32_t f0 = f[0];
   int32_t f1 = f[1];
@@ -784,6 +891,7 @@ static void fe_sq(fe h, const fe f) {
   h[8] = h8;
   h[9] = h9;
 }
+#endif
 
 /* From fe_sq2.c */
 
@@ -802,6 +910,7 @@ Postconditions:
 See fe_mul.c for discussion of implementation strategy.
 */
 
+#ifndef FE_RADIX51
 static void fe_sq2(fe h, const fe f) {
   int32_t f0 = f[0];
   int32_t f1 = f[1];
@@ -943,6 +1052,7 @@ static void fe_sq2(fe h, const fe f) {
   h[8] = h8;
   h[9] = h9;
 }
+#endif
 
 /* From fe_sub.c */
 
@@ -1193,16 +1303,23 @@ B is the Ed25519 base point (x,4/5) with x positive.
 */
 
 void ge_double_scalarmult_base_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
+  ge_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
+
+  ge_dsm_precomp(Ai, A);
+  ge_double_scalarmult_base_precomp_vartime(r, a, Ai, b);
+}
+
+/* ge_double_scalarmult_base_vartime() with A given as ge_dsm_precomp(A), for A used over and over */
+
+void ge_double_scalarmult_base_precomp_vartime(ge_p2 *r, const unsigned char *a, const ge_dsmp Ai, const unsigned char *b) {
   signed char aslide[256];
   signed char bslide[256];
-  ge_dsmp Ai; /* A, 3A, 5A, 7A, 9A, 11A, 13A, 15A */
   ge_p1p1 t;
   ge_p3 u;
   int i;
 
   slide(aslide, a);
   slide(bslide, b);
-  ge_dsm_precomp(Ai, A);
 
   ge_p2_0(r);
 
@@ -1712,6 +1829,38 @@ void ge_tobytes(unsigned char *s, const ge_p2 *h) {
   s[31] ^= fe_isnegative(x) << 7;
 }
 
+/* ge_tobytes() for n points at once, sharing a single field inversion between them (Montgomery's
+   trick); `scratch` must have room for n field elements. */
+
+void ge_tobytes_batch(unsigned char *s, const ge_p2 *h, size_t n, fe *scratch) {
+  fe inv;
+  fe recip;
+  fe x;
+  fe y;
+  size_t i;
+
+  if (n == 0) {
+    return;
+  }
+  fe_copy(scratch[0], h[0].Z);
+  for (i = 1; i < n; i++) {
+    fe_mul(scratch[i], scratch[i - 1], h[i].Z);
+  }
+  fe_invert(inv, scratch[n - 1]);
+  for (i = n - 1; i > 0; i--) {
+    fe_mul(recip, inv, scratch[i - 1]);
+    fe_mul(inv, inv, h[i].Z);
+    fe_mul(x, h[i].X, recip);
+    fe_mul(y, h[i].Y, recip);
+    fe_tobytes(s + 32 * i, y);
+    s[32 * i + 31] ^= fe_isnegative(x) << 7;
+  }
+  fe_mul(x, h[0].X, inv);
+  fe_mul(y, h[0].Y, inv);
+  fe_tobytes(s, y);
+  s[31] ^= fe_isnegative(x) << 7;
+}
+
 /* From sc_reduce.c */
 
 /*
@@ -29,6 +29,7 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 
 /* From fe.h */
@@ -80,6 +81,7 @@ typedef ge_cached ge_dsmp[8];
 extern const ge_precomp ge_Bi[8];
 void ge_dsm_precomp(ge_dsmp r, const ge_p3 *s);
 void ge_double_scalarmult_base_vartime(ge_p2 *, const unsigned char *, const ge_p3 *, const unsigned char *);
+void ge_double_scalarmult_base_precomp_vartime(ge_p2 *, const unsigned char *, const ge_dsmp, const unsigned char *);
 void ge_triple_scalarmult_base_vartime(ge_p2 *, const unsigned char *, const unsigned char *, const ge_dsmp, const unsigned char *, const ge_dsmp);
 void ge_double_scalarmult_base_vartime_p3(ge_p3 *, const unsigned char *, const ge_p3 *, const unsigned char *);
 
@@ -122,6 +124,7 @@ void ge_scalarmult_base(ge_p3 *, const unsigned char *);
 /* From ge_tobytes.c */
 
 void ge_tobytes(unsigned char *, const ge_p2 *);
+void ge_tobytes_batch(unsigned char *, const ge_p2 *, size_t, fe *);
 
 /* From sc_reduce.c */
 
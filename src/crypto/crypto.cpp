@@ -45,6 +45,7 @@ extern "C" {
 #include "keccak.h"
 }
 #include "hash.h"
+#include "hash_to_point_cache.h"
 
 namespace {
   void local_abort(const char *msg)
@@ -271,6 +272,66 @@ namespace crypto {
     return true;
   }
 
+  namespace {
+    // Encodes `points` into the elements of `out` flagged in `ok` (in order)
+    template <typename T>
+    void batch_tobytes(const std::vector<ge_p2> &points, const std::vector<bool> &ok, std::vector<T> &out) {
+      static_assert(sizeof(T) == 32);
+      std::vector<T> encoded(points.size());
+      std::unique_ptr<fe[]> scratch{new fe[points.size()]};
+      ge_tobytes_batch(reinterpret_cast<unsigned char *>(encoded.data()), points.data(), points.size(), scratch.get());
+      out.resize(ok.size());
+      for (size_t i = 0, j = 0; i < ok.size(); i++)
+        if (ok[i])
+          out[i] = encoded[j++];
+    }
+  }
+
+  std::vector<bool> generate_key_derivations(const std::vector<public_key> &keys, const secret_key &sec, std::vector<key_derivation> &derivations) {
+    assert(sc_check(&sec) == 0);
+    std::vector<bool> ok(keys.size());
+    std::vector<ge_p2> points;
+    points.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      ge_p3 point;
+      ge_p2 point2;
+      ge_p1p1 point3;
+      if (ge_frombytes_vartime(&point, &keys[i]) != 0)
+        continue;
+      ge_scalarmult(&point2, &unwrap(sec), &point);
+      ge_mul8(&point3, &point2);
+      ge_p1p1_to_p2(&points.emplace_back(), &point3);
+      ok[i] = true;
+    }
+    batch_tobytes(points, ok, derivations);
+    return ok;
+  }
+
+  std::vector<bool> derive_subaddress_public_keys(const std::vector<public_key> &out_keys, const std::vector<key_derivation> &derivations,
+      const std::vector<size_t> &output_indices, std::vector<public_key> &results) {
+    assert(out_keys.size() == derivations.size() && out_keys.size() == output_indices.size());
+    std::vector<bool> ok(out_keys.size());
+    std::vector<ge_p2> points;
+    points.reserve(out_keys.size());
+    for (size_t i = 0; i < out_keys.size(); i++) {
+      ec_scalar scalar;
+      ge_p3 point1;
+      ge_p3 point2;
+      ge_cached point3;
+      ge_p1p1 point4;
+      if (ge_frombytes_vartime(&point1, &out_keys[i]) != 0)
+        continue;
+      derivation_to_scalar(derivations[i], output_indices[i], scalar);
+      ge_scalarmult_base(&point2, &scalar);
+      ge_p3_to_cached(&point3, &point2);
+      ge_sub(&point4, &point1, &point3);
+      ge_p1p1_to_p2(&points.emplace_back(), &point4);
+      ok[i] = true;
+    }
+    batch_tobytes(points, ok, results);
+    return ok;
+  }
+
   struct s_comm {
     hash h;
     ec_point key;
@@ -338,6 +399,72 @@ namespace crypto {
     return sc_isnonzero(&c) == 0;
   }
 
+  std::optional<prepared_public_key> prepared_public_key::prepare(const public_key &pub) {
+    static_assert(sizeof(ge_dsmp) == sizeof(precomp));
+    ge_p3 point;
+    if (ge_frombytes_vartime(&point, &pub) != 0)
+      return std::nullopt;
+    prepared_public_key result;
+    result.pub = pub;
+    ge_dsm_precomp(*reinterpret_cast<ge_dsmp *>(result.precomp), &point);
+    return result;
+  }
+
+  bool check_signature(const hash &prefix_hash, const prepared_public_key &pub, const signature &sig) {
+    ge_p2 tmp2;
+    ec_scalar c;
+    s_comm buf;
+    buf.h = prefix_hash;
+    buf.key = pub.pub;
+    if (sc_check(&sig.c) != 0 || sc_check(&sig.r) != 0 || !sc_isnonzero(&sig.c)) {
+      return false;
+    }
+    ge_double_scalarmult_base_precomp_vartime(&tmp2, &sig.c, *reinterpret_cast<const ge_dsmp *>(pub.precomp), &sig.r);
+    ge_tobytes(&buf.comm, &tmp2);
+    if (memcmp(&buf.comm, &infinity, 32) == 0)
+      return false;
+    hash_to_scalar(&buf, sizeof(s_comm), c);
+    sc_sub(&c, &c, &sig.c);
+    return sc_isnonzero(&c) == 0;
+  }
+
+  std::vector<bool> check_signatures(const hash &prefix_hash, const std::vector<public_key> &pubs, const std::vector<signature> &sigs) {
+    assert(pubs.size() == sigs.size());
+    std::vector<bool> ok(pubs.size());
+    std::vector<ge_p2> points;
+    points.reserve(pubs.size());
+    for (size_t i = 0; i < pubs.size(); i++) {
+      ge_p3 tmp3;
+      assert(check_key(pubs[i]));
+      if (ge_frombytes_vartime(&tmp3, &pubs[i]) != 0)
+        continue;
+      if (sc_check(&sigs[i].c) != 0 || sc_check(&sigs[i].r) != 0 || !sc_isnonzero(&sigs[i].c))
+        continue;
+      ge_double_scalarmult_base_vartime(&points.emplace_back(), &sigs[i].c, &tmp3, &sigs[i].r);
+      ok[i] = true;
+    }
+    std::vector<ec_point> comms;
+    batch_tobytes(points, ok, comms);
+
+    for (size_t i = 0; i < pubs.size(); i++) {
+      if (!ok[i])
+        continue;
+      s_comm buf;
+      ec_scalar c;
+      buf.h = prefix_hash;
+      buf.key = pubs[i];
+      buf.comm = comms[i];
+      if (memcmp(&buf.comm, &infinity, 32) == 0) {
+        ok[i] = false;
+        continue;
+      }
+      hash_to_scalar(&buf, sizeof(s_comm), c);
+      sc_sub(&c, &c, &sigs[i].c);
+      ok[i] = sc_isnonzero(&c) == 0;
+    }
+    return ok;
+  }
+
   void generate_tx_proof(const hash &prefix_hash, const public_key &R, const public_key &A, const std::optional<public_key> &B, const public_key &D, const secret_key &r, signature &sig) {
     // sanity check
     ge_p3 R_p3;
@@ -636,7 +763,7 @@ namespace crypto {
       }
       ge_double_scalarmult_base_vartime(&tmp2, &sig[i].c, &tmp3, &sig[i].r);
       ge_tobytes(&rs.ab[i].first, &tmp2);
-      hash_to_ec(*pubs[i], tmp3);
+      hash_to_point_cached(*pubs[i], tmp3);
       ge_double_scalarmult_precomp_vartime(&tmp2, &sig[i].r, &tmp3, &sig[i].c, image_pre);
       ge_tobytes(&rs.ab[i].second, &tmp2);
       sc_add(&sum, &sum, &sig[i].c);
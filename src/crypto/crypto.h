@@ -202,6 +202,15 @@ namespace crypto {
   void derive_secret_key(const key_derivation &derivation, std::size_t output_index, const secret_key &base, secret_key &derived_key);
   bool derive_subaddress_public_key(const public_key &out_key, const key_derivation &derivation, std::size_t output_index, public_key &result);
 
+  /* Batched generate_key_derivation() and derive_subaddress_public_key(), for scanning many txs or
+   * outputs at once: each result is the same as the single version's, and the returned flags are
+   * what each single call would have returned (results for false ones are left unset).  The point
+   * encodings of a batch share a single field inversion rather than doing one each.
+   */
+  std::vector<bool> generate_key_derivations(const std::vector<public_key> &keys, const secret_key &sec, std::vector<key_derivation> &derivations);
+  std::vector<bool> derive_subaddress_public_keys(const std::vector<public_key> &out_keys, const std::vector<key_derivation> &derivations,
+      const std::vector<size_t> &output_indices, std::vector<public_key> &results);
+
   /* Generation and checking of a non-standard Monero curve 25519 signature.  This is a custom
    * scheme that is not Ed25519 because it uses a random "r" (unlike Ed25519's use of a
    * deterministic value), it requires pre-hashing the message (Ed25519 does not), and produces
@@ -240,6 +249,28 @@ namespace crypto {
   void generate_signature(const hash &prefix_hash, const public_key &pub, const secret_key &sec, signature &sig);
   // See above.
   bool check_signature(const hash &prefix_hash, const public_key &pub, const signature &sig);
+  // Checks sigs[i] against pubs[i] for each i, all of the same prefix_hash (e.g. the votes of a
+  // quorum), returning what check_signature would for each; like the batched derivations above,
+  // the signatures' commitments are encoded with a single field inversion between them.
+  std::vector<bool> check_signatures(const hash &prefix_hash, const std::vector<public_key> &pubs, const std::vector<signature> &sigs);
+
+  /* A public key with its point decompressed and the multiples of it that check_signature needs
+   * precomputed, for keys whose signatures get checked over and over (such as service nodes').
+   * Checking a signature with one gives the same result as with the key itself.
+   */
+  class prepared_public_key {
+  public:
+    // Returns nullopt if `pub` is not a valid point
+    static std::optional<prepared_public_key> prepare(const public_key &pub);
+    const public_key &key() const { return pub; }
+
+  private:
+    friend bool check_signature(const hash &prefix_hash, const prepared_public_key &pub, const signature &sig);
+    prepared_public_key() = default;
+    public_key pub;
+    alignas(int32_t) unsigned char precomp[8 * 4 * 10 * sizeof(int32_t)]; // ge_dsmp of pub
+  };
+  bool check_signature(const hash &prefix_hash, const prepared_public_key &pub, const signature &sig);
 
   /* Generation and checking of a tx proof; given a tx pubkey R, the recipient's view pubkey A, and the key
    * derivation D, the signature proves the knowledge of the tx secret key r such that R=r*G and D=r*A
@@ -62,6 +62,7 @@ enum
 
 #define CN_TURTLE_PAGE_SIZE 262144
 void cn_fast_hash(const void *data, size_t length, char *hash);
+void cn_fast_hash_multi(size_t count, const void *const data[], const size_t length[], char *const hash[]);
 void cn_turtle_hash(const void *data, size_t length, char *hash, int light, int variant, int prehashed, uint32_t scratchpad, uint32_t iterations);
 #ifdef ENABLE_MONERO_SLOW_HASH
 void cn_monero_hash(const void *data, size_t length, char *hash, int variant, int prehashed);
@@ -79,4 +80,13 @@ void rx_slow_hash_free_state(void);
 uint64_t rx_seedheight(const uint64_t height);
 void rx_seedheights(const uint64_t height, uint64_t *seed_height, uint64_t *next_height);
 void rx_slow_hash(const uint64_t mainheight, const uint64_t seedheight, const char *seedhash, const void *data, size_t length, char *hash, int miners, int is_alt);
+/* Mainchain rx_slow_hash of `count` copies of `data` with the 4-byte little-endian nonce at
+ * `nonce_offset` replaced by each of `nonces`, writing `count` hashes to `hashes`.  Consecutive
+ * hashes are pipelined through the VM, so this is faster than hashing one at a time. */
+void rx_slow_hash_batch(const uint64_t mainheight, const uint64_t seedheight, const char *seedhash, const void *data, size_t length, size_t nonce_offset, const uint32_t *nonces, char *hashes, size_t count, int miners);
+/* Sets the NUMA node the calling (mining) thread is pinned to; its full-memory VM then uses a
+ * dataset copy local to that node. */
+void rx_set_numa_node(int node);
 void rx_reorg(const uint64_t split_height);
+void rx_prepare_seedhash(const uint64_t seedheight, const char *seedhash, int threads);
+void rx_set_dataset_file(const char *path);
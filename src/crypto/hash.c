@@ -56,3 +56,7 @@ void cn_fast_hash(const void *data, size_t length, char *hash) {
   hash_process(&state, data, length);
   memcpy(hash, &state, HASH_SIZE);
 }
+
+void cn_fast_hash_multi(size_t count, const void *const data[], const size_t length[], char *const hash[]) {
+  keccak256_multi(count, (const uint8_t *const *) data, length, (uint8_t *const *) hash);
+}
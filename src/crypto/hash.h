@@ -30,8 +30,11 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
+#include <memory>
 #include <ostream>
+#include <string_view>
 
 #include "generic-ops.h"
 #include "common/hex.h"
@@ -69,6 +72,25 @@ namespace crypto {
     return h;
   }
 
+  // Computes hashes[i] = cn_fast_hash(data[i]) for `count` buffers, hashing several at a time; faster
+  // than separate cn_fast_hash calls for two or more buffers.
+  inline void cn_fast_hash_multi(const std::string_view *data, hash *hashes, std::size_t count) {
+    constexpr size_t BATCH = 16;
+    const void *ptrs[BATCH];
+    std::size_t lengths[BATCH];
+    char *outs[BATCH];
+    for (std::size_t done = 0; done < count; ) {
+      std::size_t n = std::min(BATCH, count - done);
+      for (std::size_t i = 0; i < n; i++) {
+        ptrs[i] = data[done + i].data();
+        lengths[i] = data[done + i].size();
+        outs[i] = hashes[done + i].data;
+      }
+      cn_fast_hash_multi(n, ptrs, lengths, outs);
+      done += n;
+    }
+  }
+
   enum struct cn_slow_hash_type
   {
 #ifdef ENABLE_MONERO_SLOW_HASH
@@ -83,17 +105,31 @@ namespace crypto {
     turtle_lite_v2,
   };
 
+  namespace detail {
+    struct cn_heavy_context {
+      cn_heavy_hash_v2 v2;
+      cn_heavy_hash_v1 v1 = cn_heavy_hash_v1::make_borrowed(v2);
+    };
+
+    // This thread's heavy hash contexts (4MB of scratchpad each), created on first use; lane 0 is
+    // used by cn_slow_hash, the others only by cn_slow_hash_multi.
+    inline cn_heavy_context &cn_heavy_lane(std::size_t lane) {
+      static thread_local std::unique_ptr<cn_heavy_context> lanes[cn_heavy_hash_v2::MAX_LANES];
+      if (!lanes[lane])
+        lanes[lane] = std::make_unique<cn_heavy_context>();
+      return *lanes[lane];
+    }
+  }
+
   inline void cn_slow_hash(const void *data, std::size_t length, hash &hash, cn_slow_hash_type type) {
     switch(type)
     {
       case cn_slow_hash_type::heavy_v1:
       case cn_slow_hash_type::heavy_v2:
       {
-        static thread_local cn_heavy_hash_v2 v2;
-        static thread_local cn_heavy_hash_v1 v1 = cn_heavy_hash_v1::make_borrowed(v2);
-
-        if (type == cn_slow_hash_type::heavy_v1) v1.hash(data, length, hash.data);
-        else                                     v2.hash(data, length, hash.data);
+        auto &ctx = detail::cn_heavy_lane(0);
+        if (type == cn_slow_hash_type::heavy_v1) ctx.v1.hash(data, length, hash.data);
+        else                                     ctx.v2.hash(data, length, hash.data);
       }
       break;
 
@@ -134,6 +170,39 @@ namespace crypto {
     }
   }
 
+  // cn_slow_hash of each of `data`, into `hashes`.  Heavy hashes are computed up to
+  // cn_heavy_hash_v2::MAX_LANES at a time, interleaved (see cn_heavy_hash::hash_multi), which is
+  // considerably faster on one thread than computing them one after another; other types are
+  // simply hashed in turn.
+  inline void cn_slow_hash_multi(const std::string_view *data, hash *hashes, std::size_t count, cn_slow_hash_type type) {
+    if (type != cn_slow_hash_type::heavy_v1 && type != cn_slow_hash_type::heavy_v2) {
+      for (std::size_t i = 0; i < count; i++)
+        cn_slow_hash(data[i].data(), data[i].size(), hashes[i], type);
+      return;
+    }
+
+    constexpr std::size_t LANES = cn_heavy_hash_v2::MAX_LANES;
+    cn_heavy_hash_v1 *v1[LANES];
+    cn_heavy_hash_v2 *v2[LANES];
+    const void *ptrs[LANES];
+    std::size_t lengths[LANES];
+    void *outs[LANES];
+    for (std::size_t done = 0; done < count; ) {
+      std::size_t n = std::min(LANES, count - done);
+      for (std::size_t i = 0; i < n; i++) {
+        auto &ctx = detail::cn_heavy_lane(i);
+        v1[i] = &ctx.v1;
+        v2[i] = &ctx.v2;
+        ptrs[i] = data[done + i].data();
+        lengths[i] = data[done + i].size();
+        outs[i] = hashes[done + i].data;
+      }
+      if (type == cn_slow_hash_type::heavy_v1) cn_heavy_hash_v1::hash_multi(v1, n, ptrs, lengths, outs);
+      else                                     cn_heavy_hash_v2::hash_multi(v2, n, ptrs, lengths, outs);
+      done += n;
+    }
+  }
+
   inline void tree_hash(const hash *hashes, std::size_t count, hash &root_hash) {
     tree_hash(reinterpret_cast<const char (*)[HASH_SIZE]>(hashes), count, reinterpret_cast<char *>(&root_hash));
   }
@@ -0,0 +1,171 @@
+// Copyright (c) 2021, The Oxen Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "hash_to_point_cache.h"
+
+namespace crypto {
+
+  namespace {
+
+    constexpr size_t DEFAULT_CAPACITY = 32768; // ~8MB
+    constexpr size_t SHARDS = 16;
+
+    // Ring members are chosen by whoever makes the tx, so the bucket a key lands in mustn't be
+    // predictable: hash with a random per-process salt.
+    struct salted_hash {
+      uint64_t salt;
+      size_t operator()(const public_key& k) const {
+        uint64_t x;
+        std::memcpy(&x, k.data, sizeof(x));
+        x ^= salt;
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdULL;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ULL;
+        x ^= x >> 33;
+        return x;
+      }
+    };
+
+    struct entry {
+      public_key key;
+      ge_p3 point;
+    };
+
+    struct shard {
+      std::mutex mutex;
+      size_t capacity;
+      std::list<entry> lru; // most recently used first
+      std::unordered_map<public_key, std::list<entry>::iterator, salted_hash> index;
+
+      shard(const salted_hash& h) : capacity{DEFAULT_CAPACITY / SHARDS}, index{0, h} {}
+    };
+
+    struct point_cache {
+      salted_hash hasher;
+      std::array<std::unique_ptr<shard>, SHARDS> shards;
+      std::atomic<uint64_t> hits{0}, misses{0};
+
+      point_cache() {
+        generate_random_bytes_thread_safe(sizeof(hasher.salt), reinterpret_cast<uint8_t*>(&hasher.salt));
+        for (auto& s : shards)
+          s = std::make_unique<shard>(hasher);
+      }
+
+      shard& shard_for(const public_key& key) {
+        return *shards[(hasher(key) >> 56) % SHARDS];
+      }
+    };
+
+    point_cache& cache() {
+      static point_cache c;
+      return c;
+    }
+
+    void hash_to_point(const public_key& key, ge_p3& res) {
+      hash h;
+      ge_p2 point;
+      ge_p1p1 point2;
+      cn_fast_hash(&key, sizeof(public_key), h);
+      ge_fromfe_frombytes_vartime(&point, reinterpret_cast<const unsigned char*>(&h));
+      ge_mul8(&point2, &point);
+      ge_p1p1_to_p3(&res, &point2);
+    }
+
+  }
+
+  void hash_to_point_cached(const public_key& key, ge_p3& res) {
+    auto& c = cache();
+    auto& s = c.shard_for(key);
+    {
+      std::lock_guard lock{s.mutex};
+      if (auto it = s.index.find(key); it != s.index.end()) {
+        s.lru.splice(s.lru.begin(), s.lru, it->second);
+        res = it->second->point;
+        c.hits.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    }
+    c.misses.fetch_add(1, std::memory_order_relaxed);
+
+    // Compute without the lock held; if another thread adds the same key meanwhile, keep theirs
+    hash_to_point(key, res);
+
+    std::lock_guard lock{s.mutex};
+    if (s.index.count(key))
+      return;
+    if (s.lru.size() < s.capacity) {
+      s.lru.push_front({key, res});
+      s.index.emplace(key, s.lru.begin());
+    } else {
+      // Reuse the least recently used entry's list and index nodes rather than reallocating
+      auto oldest = std::prev(s.lru.end());
+      auto node = s.index.extract(oldest->key);
+      oldest->key = key;
+      oldest->point = res;
+      s.lru.splice(s.lru.begin(), s.lru, oldest);
+      node.key() = key;
+      s.index.insert(std::move(node));
+    }
+  }
+
+  hash_to_point_cache_stats get_hash_to_point_cache_stats() {
+    auto& c = cache();
+    hash_to_point_cache_stats stats{c.hits.load(), c.misses.load(), 0, 0};
+    for (auto& s : c.shards) {
+      std::lock_guard lock{s->mutex};
+      stats.size += s->lru.size();
+      stats.capacity += s->capacity;
+    }
+    return stats;
+  }
+
+  void clear_hash_to_point_cache(size_t capacity) {
+    auto& c = cache();
+    if (capacity == 0)
+      capacity = DEFAULT_CAPACITY;
+    for (auto& s : c.shards) {
+      std::lock_guard lock{s->mutex};
+      s->index.clear();
+      s->lru.clear();
+      s->capacity = (capacity + SHARDS - 1) / SHARDS;
+    }
+    c.hits = 0;
+    c.misses = 0;
+  }
+
+}
@@ -0,0 +1,61 @@
+// Copyright (c) 2021, The Oxen Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "crypto.h"
+
+extern "C" {
+#include "crypto-ops.h"
+}
+
+namespace crypto {
+
+  // Computes 8 Hp(key), the hash-to-point of a public key that ring signatures (and CLSAGs and
+  // MLSAGs) use for each ring member, through a bounded, thread-safe LRU cache of recently used
+  // keys.  The same outputs get used as decoys over and over, and mempool and block verification
+  // both check the same txs, so many of these are repeats.  Only for verification: the cache
+  // makes the time taken depend on which keys were used recently.
+  void hash_to_point_cached(const public_key& key, ge_p3& res);
+
+  struct hash_to_point_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    size_t size;     // number of keys currently cached
+    size_t capacity; // maximum number of keys cached
+  };
+  hash_to_point_cache_stats get_hash_to_point_cache_stats();
+
+  // Empties the cache and resets the stats and capacity (mainly for tests)
+  void clear_hash_to_point_cache(size_t capacity = 0);
+
+}
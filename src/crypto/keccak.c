@@ -218,3 +218,150 @@ void keccak_finish(KECCAK_CTX * ctx, uint8_t *md){
         memcpy_swap64le(md, ctx->hash, KECCAK_DIGESTSIZE / sizeof(uint64_t));
     }
 }
+
+#if defined(__GNUC__) || defined(__clang__)
+
+// keccak-f[1600] on KECCAK_LANES independent states at once: each of the 25 state words is a vector
+// holding that word of every lane, so the same code as keccakf() above works each lane in parallel.
+#define KECCAK_LANES 4
+typedef uint64_t keccak_lanes_t __attribute__((vector_size(8 * KECCAK_LANES)));
+
+static inline __attribute__((always_inline)) void keccakf_lanes_impl(keccak_lanes_t st[25])
+{
+    int i, j, round;
+    keccak_lanes_t t, bc[5];
+
+    for (round = 0; round < KECCAK_ROUNDS; round++) {
+
+        // Theta
+        for (i = 0; i < 5; i++)
+            bc[i] = st[i] ^ st[i + 5] ^ st[i + 10] ^ st[i + 15] ^ st[i + 20];
+
+        for (i = 0; i < 5; i++) {
+            t = bc[(i + 4) % 5] ^ ROTL64(bc[(i + 1) % 5], 1);
+            for (j = 0; j < 25; j += 5)
+                st[j + i] ^= t;
+        }
+
+        // Rho Pi
+        t = st[1];
+        for (i = 0; i < 24; i++) {
+            j = keccakf_piln[i];
+            bc[0] = st[j];
+            st[j] = ROTL64(t, keccakf_rotc[i]);
+            t = bc[0];
+        }
+
+        //  Chi
+        for (j = 0; j < 25; j += 5) {
+            for (i = 0; i < 5; i++)
+                bc[i] = st[j + i];
+            for (i = 0; i < 5; i++)
+                st[j + i] ^= (~bc[(i + 1) % 5]) & bc[(i + 2) % 5];
+        }
+
+        //  Iota
+        st[0] ^= keccakf_rndc[round];
+    }
+}
+
+// Baseline build: on x86-64 each vector op becomes two SSE2 ones
+static void keccakf_lanes_generic(keccak_lanes_t st[25])
+{
+    keccakf_lanes_impl(st);
+}
+
+#if defined(__x86_64__) && !defined(__AVX2__)
+__attribute__((target("avx2"))) static void keccakf_lanes_avx2(keccak_lanes_t st[25])
+{
+    keccakf_lanes_impl(st);
+}
+
+static void keccakf_lanes(keccak_lanes_t st[25])
+{
+    static int avx2 = -1;
+    if (avx2 < 0)
+        avx2 = __builtin_cpu_supports("avx2");
+    if (avx2)
+        keccakf_lanes_avx2(st);
+    else
+        keccakf_lanes_generic(st);
+}
+#else
+#define keccakf_lanes keccakf_lanes_generic
+#endif
+
+void keccak256_multi(size_t count, const uint8_t *const in[], const size_t inlen[], uint8_t *const md[])
+{
+    keccak_lanes_t st[25];
+    const uint8_t *pos[KECCAK_LANES];
+    size_t left[KECCAK_LANES], job[KECCAK_LANES];
+    bool active[KECCAK_LANES] = {false}, last[KECCAK_LANES];
+    uint64_t block[KECCAK_WORDS];
+    size_t next = 0;
+    int lane, i, busy;
+
+    if (count == 1) {
+        keccak(in[0], inlen[0], md[0], KECCAK_DIGESTSIZE);
+        return;
+    }
+
+    for (;;) {
+        // Start the next messages on idle lanes, then absorb one block of each lane's message
+        busy = 0;
+        for (lane = 0; lane < KECCAK_LANES; lane++) {
+            if (!active[lane] && next < count) {
+                job[lane] = next++;
+                pos[lane] = in[job[lane]];
+                left[lane] = inlen[job[lane]];
+                for (i = 0; i < 25; i++)
+                    st[i][lane] = 0;
+                active[lane] = true;
+            }
+            if (!active[lane])
+                continue;
+            busy = 1;
+
+            if (left[lane] >= KECCAK_BLOCKLEN) {
+                memcpy(block, pos[lane], KECCAK_BLOCKLEN);
+                pos[lane] += KECCAK_BLOCKLEN;
+                left[lane] -= KECCAK_BLOCKLEN;
+                last[lane] = false;
+            } else {
+                memset(block, 0, KECCAK_BLOCKLEN);
+                if (left[lane] > 0)
+                    memcpy(block, pos[lane], left[lane]);
+                ((uint8_t *) block)[left[lane]] |= 0x01;
+                ((uint8_t *) block)[KECCAK_BLOCKLEN - 1] |= 0x80;
+                last[lane] = true;
+            }
+            for (i = 0; i < KECCAK_WORDS; i++)
+                st[i][lane] ^= swap64le(block[i]);
+        }
+        if (!busy)
+            break;
+
+        keccakf_lanes(st);
+
+        for (lane = 0; lane < KECCAK_LANES; lane++) {
+            if (active[lane] && last[lane]) {
+                uint64_t digest[KECCAK_DIGESTSIZE / sizeof(uint64_t)];
+                for (i = 0; i < (int) (KECCAK_DIGESTSIZE / sizeof(uint64_t)); i++)
+                    digest[i] = st[i][lane];
+                memcpy_swap64le(md[job[lane]], digest, KECCAK_DIGESTSIZE / sizeof(uint64_t));
+                active[lane] = false;
+            }
+        }
+    }
+}
+
+#else
+
+void keccak256_multi(size_t count, const uint8_t *const in[], const size_t inlen[], uint8_t *const md[])
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+        keccak(in[i], inlen[i], md[i], KECCAK_DIGESTSIZE);
+}
+
+#endif
@@ -34,6 +34,10 @@ void keccakf(uint64_t st[25], int norounds);
 
 void keccak1600(const uint8_t *in, size_t inlen, uint8_t *md);
 
+// Computes the 32-byte keccak hashes of `count` messages, several at a time (with SIMD where the
+// CPU has it).  md[i] receives the hash of the inlen[i] bytes at in[i].
+void keccak256_multi(size_t count, const uint8_t *const in[], const size_t inlen[], uint8_t *const md[]);
+
 void keccak_init(KECCAK_CTX * ctx);
 void keccak_update(KECCAK_CTX * ctx, const uint8_t *in, size_t inlen);
 void keccak_finish(KECCAK_CTX * ctx, uint8_t *md);
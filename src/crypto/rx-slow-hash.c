@@ -62,7 +62,40 @@ static rx_state rx_s[2] = {{CTHR_MUTEX_INIT,{0},0,0},{CTHR_MUTEX_INIT,{0},0,0}};
 static randomx_dataset *rx_dataset;
 static int rx_dataset_nomem;
 static uint64_t rx_dataset_height;
+static char rx_dataset_hash[HASH_SIZE];
 static THREADV randomx_vm *rx_vm = NULL;
+/* the dataset rx_vm was created with or last switched to */
+static THREADV randomx_dataset *rx_vm_dataset = NULL;
+
+/* spare dataset prepared in the background for the upcoming seed, swapped in at the epoch switch */
+static randomx_dataset *rx_dataset_next;
+static uint64_t rx_dataset_next_height = 1;
+static char rx_dataset_next_hash[HASH_SIZE];
+
+/* node-local copies of rx_dataset for miner threads pinned to NUMA nodes other than 0 (see
+ * rx_local_dataset), guarded by rx_dataset_mutex */
+#define RX_MAX_NUMA_NODES	64
+static randomx_dataset *rx_node_dataset[RX_MAX_NUMA_NODES];
+static uint64_t rx_node_dataset_height[RX_MAX_NUMA_NODES];
+static char rx_node_dataset_hash[RX_MAX_NUMA_NODES][HASH_SIZE];
+static THREADV int rx_numa_node = 0;
+
+/* optional on-disk copy of the mining dataset, reloaded instead of recomputed at startup */
+static char *rx_dataset_file;
+
+typedef struct rx_prepare_job {
+  uint64_t pj_height;
+  char pj_hash[HASH_SIZE];
+  int pj_threads;
+} rx_prepare_job;
+
+/* rx_prepare_mutex serializes starting/joining the worker, rx_prepare_done_mutex guards rx_prepare_done */
+static CTHR_MUTEX_TYPE rx_prepare_mutex = CTHR_MUTEX_INIT;
+static CTHR_MUTEX_TYPE rx_prepare_done_mutex = CTHR_MUTEX_INIT;
+static CTHR_THREAD_TYPE rx_prepare_thread;
+static int rx_prepare_started;
+static int rx_prepare_done;
+static rx_prepare_job rx_prepare_current = {1,{0},0};
 
 static void local_abort(const char *msg)
 {
@@ -124,6 +157,8 @@ void rx_reorg(const uint64_t split_height) {
       rx_s[i].rs_height = 1;	/* set to an invalid seed height */
     }
   }
+  if (split_height <= rx_dataset_next_height)
+    rx_dataset_next_height = 1;
   CTHR_MUTEX_UNLOCK(rx_mutex);
 }
 
@@ -139,6 +174,7 @@ void rx_seedheights(const uint64_t height, uint64_t *seedheight, uint64_t *nexth
 }
 
 typedef struct seedinfo {
+  randomx_dataset *si_dataset;
   randomx_cache *si_cache;
   unsigned long si_start;
   unsigned long si_count;
@@ -146,11 +182,11 @@ typedef struct seedinfo {
 
 static CTHR_THREAD_RTYPE rx_seedthread(void *arg) {
   seedinfo *si = arg;
-  randomx_init_dataset(rx_dataset, si->si_cache, si->si_start, si->si_count);
+  randomx_init_dataset(si->si_dataset, si->si_cache, si->si_start, si->si_count);
   CTHR_THREAD_RETURN;
 }
 
-static void rx_initdata(randomx_cache *rs_cache, const int miners, const uint64_t seedheight) {
+static void rx_initdata(randomx_dataset *dataset, randomx_cache *rs_cache, const int miners) {
   if (miners > 1) {
     unsigned long delta = randomx_dataset_item_count() / miners;
     unsigned long start = 0;
@@ -166,76 +202,196 @@ static void rx_initdata(randomx_cache *rs_cache, const int miners, const uint64_
       local_abort("Couldn't allocate RandomX mining threadlist");
     }
     for (i=0; i<miners-1; i++) {
+      si[i].si_dataset = dataset;
       si[i].si_cache = rs_cache;
       si[i].si_start = start;
       si[i].si_count = delta;
       start += delta;
     }
+    si[i].si_dataset = dataset;
     si[i].si_cache = rs_cache;
     si[i].si_start = start;
     si[i].si_count = randomx_dataset_item_count() - start;
     for (i=1; i<miners; i++) {
       CTHR_THREAD_CREATE(st[i], rx_seedthread, &si[i]);
     }
-    randomx_init_dataset(rx_dataset, rs_cache, 0, si[0].si_count);
+    randomx_init_dataset(dataset, rs_cache, 0, si[0].si_count);
     for (i=1; i<miners; i++) {
       CTHR_THREAD_JOIN(st[i]);
     }
     free(st);
     free(si);
   } else {
-    randomx_init_dataset(rx_dataset, rs_cache, 0, randomx_dataset_item_count());
+    randomx_init_dataset(dataset, rs_cache, 0, randomx_dataset_item_count());
   }
+}
+
+static randomx_dataset *rx_alloc_dataset(void) {
+  randomx_dataset *dataset = randomx_alloc_dataset(RANDOMX_FLAG_LARGE_PAGES);
+  if (dataset == NULL) {
+    mdebug(RX_LOGCAT, "Couldn't use largePages for RandomX dataset");
+    dataset = randomx_alloc_dataset(RANDOMX_FLAG_DEFAULT);
+  }
+  return dataset;
+}
+
+#define RX_DATASET_FILE_MAGIC	"oxenrxds"
+#define RX_DATASET_FILE_MAGIC_SIZE	8
+
+static size_t rx_dataset_size(void) {
+  return (size_t)randomx_dataset_item_count() * RANDOMX_DATASET_ITEM_SIZE;
+}
+
+/* Must be called with rx_dataset_mutex held */
+static int rx_save_dataset_file(void) {
+  FILE *f;
+  int ok;
+  if (rx_dataset_file == NULL || rx_dataset == NULL || rx_dataset_height == 1)
+    return 0;
+  f = fopen(rx_dataset_file, "wb");
+  if (f == NULL) {
+    mwarning(RX_LOGCAT, "Couldn't open RandomX dataset file for writing");
+    return 0;
+  }
+  ok = fwrite(RX_DATASET_FILE_MAGIC, RX_DATASET_FILE_MAGIC_SIZE, 1, f) == 1 &&
+       fwrite(&rx_dataset_height, sizeof(rx_dataset_height), 1, f) == 1 &&
+       fwrite(rx_dataset_hash, HASH_SIZE, 1, f) == 1 &&
+       fwrite(randomx_get_dataset_memory(rx_dataset), rx_dataset_size(), 1, f) == 1;
+  if (fclose(f) != 0)
+    ok = 0;
+  if (!ok) {
+    mwarning(RX_LOGCAT, "Couldn't write RandomX dataset file");
+    remove(rx_dataset_file);
+  }
+  return ok;
+}
+
+/* Must be called with rx_dataset_mutex held; rx_dataset must be allocated */
+static int rx_load_dataset_file(const uint64_t seedheight, const char *seedhash) {
+  FILE *f;
+  char magic[RX_DATASET_FILE_MAGIC_SIZE];
+  uint64_t height;
+  char hash[HASH_SIZE];
+  int ok;
+  if (rx_dataset_file == NULL)
+    return 0;
+  f = fopen(rx_dataset_file, "rb");
+  if (f == NULL)
+    return 0;
+  ok = fread(magic, sizeof(magic), 1, f) == 1 && !memcmp(magic, RX_DATASET_FILE_MAGIC, sizeof(magic)) &&
+       fread(&height, sizeof(height), 1, f) == 1 && height == seedheight &&
+       fread(hash, HASH_SIZE, 1, f) == 1 && !memcmp(hash, seedhash, HASH_SIZE);
+  if (ok)
+    ok = fread(randomx_get_dataset_memory(rx_dataset), rx_dataset_size(), 1, f) == 1;
+  fclose(f);
+  if (!ok)
+    return 0;
   rx_dataset_height = seedheight;
+  memcpy(rx_dataset_hash, seedhash, HASH_SIZE);
+  mdebug(RX_LOGCAT, "Loaded RandomX dataset from file");
+  return 1;
 }
 
-void rx_slow_hash(const uint64_t mainheight, const uint64_t seedheight, const char *seedhash, const void *data, size_t length,
-  char *hash, int miners, int is_alt) {
+/* Brings rx_dataset up to date for the given seed, swapping in the background-prepared
+ * dataset when it matches. Must be called with rx_dataset_mutex held. */
+static void rx_update_dataset(randomx_cache *rs_cache, const int miners, const uint64_t seedheight, const char *seedhash) {
+  if (rx_dataset_height == seedheight && !memcmp(rx_dataset_hash, seedhash, HASH_SIZE))
+    return;
+  if (rx_dataset_next != NULL && rx_dataset_next_height == seedheight && !memcmp(rx_dataset_next_hash, seedhash, HASH_SIZE)) {
+    randomx_dataset *rd = rx_dataset;
+    rx_dataset = rx_dataset_next;
+    rx_dataset_next = rd;
+    rx_dataset_next_height = 1;
+    mdebug(RX_LOGCAT, "Switched to prepared RandomX dataset");
+  } else {
+    rx_initdata(rx_dataset, rs_cache, miners);
+  }
+  rx_dataset_height = seedheight;
+  memcpy(rx_dataset_hash, seedhash, HASH_SIZE);
+  rx_save_dataset_file();
+}
+
+static randomx_cache *rx_alloc_cache(randomx_flags flags) {
+  randomx_cache *cache = randomx_alloc_cache(flags | RANDOMX_FLAG_LARGE_PAGES);
+  if (cache == NULL) {
+    mdebug(RX_LOGCAT, "Couldn't use largePages for RandomX cache");
+    cache = randomx_alloc_cache(flags);
+  }
+  if (cache == NULL)
+    local_abort("Couldn't allocate RandomX cache");
+  return cache;
+}
+
+/* Must be called with rx_sp->rs_mutex held */
+static void rx_update_cache(rx_state *rx_sp, const uint64_t seedheight, const char *seedhash) {
+  randomx_cache *cache = rx_sp->rs_cache;
+  if (cache == NULL)
+    cache = rx_alloc_cache(enabled_flags() & ~disabled_flags());
+  if (rx_sp->rs_height != seedheight || rx_sp->rs_cache == NULL || memcmp(seedhash, rx_sp->rs_hash, HASH_SIZE)) {
+    randomx_init_cache(cache, seedhash, HASH_SIZE);
+    rx_sp->rs_cache = cache;
+    rx_sp->rs_height = seedheight;
+    memcpy(rx_sp->rs_hash, seedhash, HASH_SIZE);
+  }
+}
+
+/* The dataset for this thread's NUMA node: rx_dataset itself on node 0, otherwise a node-local copy
+ * of it, refreshed when rx_dataset changes.  The copy is made by a thread pinned to the node, so its
+ * pages get placed there.  Falls back to rx_dataset if the copy can't be allocated.  Must be called
+ * with rx_dataset_mutex held and rx_dataset allocated. */
+static randomx_dataset *rx_local_dataset(void) {
+  const int node = rx_numa_node;
+  if (node == 0)
+    return rx_dataset;
+  if (rx_node_dataset[node] == NULL) {
+    rx_node_dataset[node] = rx_alloc_dataset();
+    rx_node_dataset_height[node] = 1;
+    if (rx_node_dataset[node] == NULL) {
+      mwarning(RX_LOGCAT, "Couldn't allocate NUMA node-local RandomX dataset, using the shared one");
+      return rx_dataset;
+    }
+  }
+  if (rx_node_dataset_height[node] != rx_dataset_height || memcmp(rx_node_dataset_hash[node], rx_dataset_hash, HASH_SIZE)) {
+    memcpy(randomx_get_dataset_memory(rx_node_dataset[node]), randomx_get_dataset_memory(rx_dataset), rx_dataset_size());
+    rx_node_dataset_height[node] = rx_dataset_height;
+    memcpy(rx_node_dataset_hash[node], rx_dataset_hash, HASH_SIZE);
+    mdebug(RX_LOGCAT, "Copied RandomX dataset to a NUMA node");
+  }
+  return rx_node_dataset[node];
+}
+
+/* Brings this thread's rx_vm up to date for hashing with the given seed.  Returns the seed state
+ * used, whose rs_mutex is still held if *is_alt is set on return (and must be released by the
+ * caller once it is done hashing). */
+static rx_state *rx_setup_vm(const uint64_t mainheight, const uint64_t seedheight, const char *seedhash, int miners, int *is_alt) {
   uint64_t s_height = rx_seedheight(mainheight);
   int toggle = (s_height & SEEDHASH_EPOCH_BLOCKS) != 0;
   randomx_flags flags = enabled_flags() & ~disabled_flags();
+  randomx_dataset *dataset = NULL;
   rx_state *rx_sp;
-  randomx_cache *cache;
 
   CTHR_MUTEX_LOCK(rx_mutex);
 
   /* if alt block but with same seed as mainchain, no need for alt cache */
-  if (is_alt) {
+  if (*is_alt) {
     if (s_height == seedheight && !memcmp(rx_s[toggle].rs_hash, seedhash, HASH_SIZE))
-      is_alt = 0;
+      *is_alt = 0;
   } else {
   /* RPC could request an earlier block on mainchain */
     if (s_height > seedheight)
-      is_alt = 1;
+      *is_alt = 1;
     /* miner can be ahead of mainchain */
     else if (s_height < seedheight)
       toggle ^= 1;
   }
 
-  toggle ^= (is_alt != 0);
+  toggle ^= (*is_alt != 0);
 
   rx_sp = &rx_s[toggle];
   CTHR_MUTEX_LOCK(rx_sp->rs_mutex);
   CTHR_MUTEX_UNLOCK(rx_mutex);
 
-  cache = rx_sp->rs_cache;
-  if (cache == NULL) {
-    if (cache == NULL) {
-      cache = randomx_alloc_cache(flags | RANDOMX_FLAG_LARGE_PAGES);
-      if (cache == NULL) {
-        mdebug(RX_LOGCAT, "Couldn't use largePages for RandomX cache");
-        cache = randomx_alloc_cache(flags);
-      }
-      if (cache == NULL)
-        local_abort("Couldn't allocate RandomX cache");
-    }
-  }
-  if (rx_sp->rs_height != seedheight || rx_sp->rs_cache == NULL || memcmp(seedhash, rx_sp->rs_hash, HASH_SIZE)) {
-    randomx_init_cache(cache, seedhash, HASH_SIZE);
-    rx_sp->rs_cache = cache;
-    rx_sp->rs_height = seedheight;
-    memcpy(rx_sp->rs_hash, seedhash, HASH_SIZE);
-  }
+  rx_update_cache(rx_sp, seedheight, seedhash);
   if (rx_vm == NULL) {
     if ((flags & RANDOMX_FLAG_JIT) && !miners) {
         flags |= RANDOMX_FLAG_SECURE & ~disabled_flags();
@@ -247,18 +403,18 @@ void rx_slow_hash(const uint64_t mainheight, const uint64_t seedheight, const ch
       CTHR_MUTEX_LOCK(rx_dataset_mutex);
       if (!rx_dataset_nomem) {
         if (rx_dataset == NULL) {
-          rx_dataset = randomx_alloc_dataset(RANDOMX_FLAG_LARGE_PAGES);
-          if (rx_dataset == NULL) {
-            mdebug(RX_LOGCAT, "Couldn't use largePages for RandomX dataset");
-            rx_dataset = randomx_alloc_dataset(RANDOMX_FLAG_DEFAULT);
-          }
-          if (rx_dataset != NULL)
-            rx_initdata(rx_sp->rs_cache, miners, seedheight);
+          rx_dataset = rx_alloc_dataset();
+          rx_dataset_height = 1;
+          if (rx_dataset != NULL && !rx_load_dataset_file(seedheight, seedhash))
+            rx_update_dataset(rx_sp->rs_cache, miners, seedheight, seedhash);
+        } else {
+          rx_update_dataset(rx_sp->rs_cache, miners, seedheight, seedhash);
         }
       }
-      if (rx_dataset != NULL)
+      if (rx_dataset != NULL) {
         flags |= RANDOMX_FLAG_FULL_MEM;
-      else {
+        dataset = rx_local_dataset();
+      } else {
         miners = 0;
         if (!rx_dataset_nomem) {
           rx_dataset_nomem = 1;
@@ -267,22 +423,29 @@ void rx_slow_hash(const uint64_t mainheight, const uint64_t seedheight, const ch
       }
       CTHR_MUTEX_UNLOCK(rx_dataset_mutex);
     }
-    rx_vm = randomx_create_vm(flags | RANDOMX_FLAG_LARGE_PAGES, rx_sp->rs_cache, rx_dataset);
+    rx_vm = randomx_create_vm(flags | RANDOMX_FLAG_LARGE_PAGES, rx_sp->rs_cache, dataset);
     if(rx_vm == NULL) { //large pages failed
       mdebug(RX_LOGCAT, "Couldn't use largePages for RandomX VM");
-      rx_vm = randomx_create_vm(flags, rx_sp->rs_cache, rx_dataset);
+      rx_vm = randomx_create_vm(flags, rx_sp->rs_cache, dataset);
     }
     if(rx_vm == NULL) {//fallback if everything fails
       flags = RANDOMX_FLAG_DEFAULT | (miners ? RANDOMX_FLAG_FULL_MEM : 0);
-      rx_vm = randomx_create_vm(flags, rx_sp->rs_cache, rx_dataset);
+      rx_vm = randomx_create_vm(flags, rx_sp->rs_cache, dataset);
     }
     if (rx_vm == NULL)
       local_abort("Couldn't allocate RandomX VM");
+    rx_vm_dataset = (flags & RANDOMX_FLAG_FULL_MEM) ? dataset : NULL;
   } else if (miners) {
     CTHR_MUTEX_LOCK(rx_dataset_mutex);
-    if (rx_dataset != NULL && rx_dataset_height != seedheight)
-      rx_initdata(cache, miners, seedheight);
-    else if (rx_dataset == NULL) {
+    if (rx_dataset != NULL) {
+      rx_update_dataset(rx_sp->rs_cache, miners, seedheight, seedhash);
+      /* another thread may have swapped in the prepared dataset */
+      dataset = rx_local_dataset();
+      if (rx_vm_dataset != NULL && rx_vm_dataset != dataset) {
+        randomx_vm_set_dataset(rx_vm, dataset);
+        rx_vm_dataset = dataset;
+      }
+    } else if (rx_dataset == NULL) {
       /* this is a no-op if the cache hasn't changed */
       randomx_vm_set_cache(rx_vm, rx_sp->rs_cache);
     }
@@ -292,14 +455,60 @@ void rx_slow_hash(const uint64_t mainheight, const uint64_t seedheight, const ch
     randomx_vm_set_cache(rx_vm, rx_sp->rs_cache);
   }
   /* mainchain users can run in parallel */
-  if (!is_alt)
+  if (!*is_alt)
     CTHR_MUTEX_UNLOCK(rx_sp->rs_mutex);
+  return rx_sp;
+}
+
+void rx_slow_hash(const uint64_t mainheight, const uint64_t seedheight, const char *seedhash, const void *data, size_t length,
+  char *hash, int miners, int is_alt) {
+  rx_state *rx_sp = rx_setup_vm(mainheight, seedheight, seedhash, miners, &is_alt);
   randomx_calculate_hash(rx_vm, data, length, hash);
   /* altchain slot users always get fully serialized */
   if (is_alt)
     CTHR_MUTEX_UNLOCK(rx_sp->rs_mutex);
 }
 
+static void rx_set_nonce(unsigned char *data, const uint32_t nonce) {
+  data[0] = nonce & 0xff;
+  data[1] = (nonce >> 8) & 0xff;
+  data[2] = (nonce >> 16) & 0xff;
+  data[3] = (nonce >> 24) & 0xff;
+}
+
+void rx_slow_hash_batch(const uint64_t mainheight, const uint64_t seedheight, const char *seedhash, const void *data, size_t length,
+  size_t nonce_offset, const uint32_t *nonces, char *hashes, size_t count, int miners) {
+  int is_alt = 0;
+  unsigned char *blob;
+  rx_state *rx_sp;
+  size_t i;
+  if (count == 0)
+    return;
+  if (nonce_offset + sizeof(uint32_t) > length)
+    local_abort("RandomX batch nonce offset is out of range");
+  blob = malloc(length);
+  if (blob == NULL)
+    local_abort("Couldn't allocate RandomX batch input");
+  memcpy(blob, data, length);
+  rx_sp = rx_setup_vm(mainheight, seedheight, seedhash, miners, &is_alt);
+  /* each _next call hashes the following input while finishing the previous one, which keeps the
+   * scratchpad fill for one nonce overlapped with the program execution of the previous one */
+  rx_set_nonce(blob + nonce_offset, nonces[0]);
+  randomx_calculate_hash_first(rx_vm, blob, length);
+  for (i = 1; i < count; i++) {
+    rx_set_nonce(blob + nonce_offset, nonces[i]);
+    randomx_calculate_hash_next(rx_vm, blob, length, hashes + (i - 1) * HASH_SIZE);
+  }
+  randomx_calculate_hash_last(rx_vm, hashes + (count - 1) * HASH_SIZE);
+  if (is_alt)
+    CTHR_MUTEX_UNLOCK(rx_sp->rs_mutex);
+  free(blob);
+}
+
+void rx_set_numa_node(int node) {
+  rx_numa_node = (node > 0 && node < RX_MAX_NUMA_NODES) ? node : 0;
+}
+
 void rx_slow_hash_allocate_state(void) {
 }
 
@@ -307,16 +516,119 @@ void rx_slow_hash_free_state(void) {
   if (rx_vm != NULL) {
     randomx_destroy_vm(rx_vm);
     rx_vm = NULL;
+    rx_vm_dataset = NULL;
+  }
+}
+
+static CTHR_THREAD_RTYPE rx_prepare_worker(void *arg) {
+  rx_prepare_job *job = arg;
+  rx_state *rx_sp = &rx_s[(job->pj_height & SEEDHASH_EPOCH_BLOCKS) != 0];
+  randomx_dataset *dataset = NULL;
+
+  CTHR_MUTEX_LOCK(rx_sp->rs_mutex);
+  rx_update_cache(rx_sp, job->pj_height, job->pj_hash);
+
+  if (job->pj_threads > 0) {
+    /* only worth it while mining with a full dataset of a different seed */
+    CTHR_MUTEX_LOCK(rx_dataset_mutex);
+    if (rx_dataset != NULL && rx_dataset_height != job->pj_height &&
+        !(rx_dataset_next_height == job->pj_height && !memcmp(rx_dataset_next_hash, job->pj_hash, HASH_SIZE))) {
+      if (rx_dataset_next == NULL)
+        rx_dataset_next = rx_alloc_dataset();
+      dataset = rx_dataset_next;
+      rx_dataset_next_height = 1;
+    }
+    CTHR_MUTEX_UNLOCK(rx_dataset_mutex);
+  }
+  if (dataset != NULL) {
+    rx_initdata(dataset, rx_sp->rs_cache, job->pj_threads);
+    CTHR_MUTEX_LOCK(rx_dataset_mutex);
+    if (rx_dataset_next == dataset) {
+      rx_dataset_next_height = job->pj_height;
+      memcpy(rx_dataset_next_hash, job->pj_hash, HASH_SIZE);
+    }
+    CTHR_MUTEX_UNLOCK(rx_dataset_mutex);
+  }
+  CTHR_MUTEX_UNLOCK(rx_sp->rs_mutex);
+
+  CTHR_MUTEX_LOCK(rx_prepare_done_mutex);
+  rx_prepare_done = 1;
+  CTHR_MUTEX_UNLOCK(rx_prepare_done_mutex);
+  CTHR_THREAD_RETURN;
+}
+
+void rx_prepare_seedhash(const uint64_t seedheight, const char *seedhash, int threads) {
+  int done;
+  CTHR_MUTEX_LOCK(rx_prepare_mutex);
+  if (rx_prepare_started) {
+    CTHR_MUTEX_LOCK(rx_prepare_done_mutex);
+    done = rx_prepare_done;
+    CTHR_MUTEX_UNLOCK(rx_prepare_done_mutex);
+    /* never block the caller on a preparation still in progress; it will be retried on a later block */
+    if (!done) {
+      CTHR_MUTEX_UNLOCK(rx_prepare_mutex);
+      return;
+    }
+    CTHR_THREAD_JOIN(rx_prepare_thread);
+    rx_prepare_started = 0;
+  }
+  if (rx_prepare_current.pj_height == seedheight && !memcmp(rx_prepare_current.pj_hash, seedhash, HASH_SIZE) &&
+      rx_prepare_current.pj_threads >= threads) {
+    CTHR_MUTEX_UNLOCK(rx_prepare_mutex);
+    return;
   }
+  rx_prepare_current.pj_height = seedheight;
+  memcpy(rx_prepare_current.pj_hash, seedhash, HASH_SIZE);
+  rx_prepare_current.pj_threads = threads;
+  CTHR_MUTEX_LOCK(rx_prepare_done_mutex);
+  rx_prepare_done = 0;
+  CTHR_MUTEX_UNLOCK(rx_prepare_done_mutex);
+  rx_prepare_started = 1;
+  CTHR_THREAD_CREATE(rx_prepare_thread, rx_prepare_worker, &rx_prepare_current);
+  CTHR_MUTEX_UNLOCK(rx_prepare_mutex);
+}
+
+void rx_set_dataset_file(const char *path) {
+  CTHR_MUTEX_LOCK(rx_dataset_mutex);
+  free(rx_dataset_file);
+  rx_dataset_file = NULL;
+  if (path != NULL && *path) {
+    rx_dataset_file = malloc(strlen(path) + 1);
+    if (rx_dataset_file != NULL)
+      strcpy(rx_dataset_file, path);
+  }
+  CTHR_MUTEX_UNLOCK(rx_dataset_mutex);
 }
 
 void rx_stop_mining(void) {
+  int i;
+  /* the worker may be filling rx_dataset_next */
+  CTHR_MUTEX_LOCK(rx_prepare_mutex);
+  if (rx_prepare_started) {
+    CTHR_THREAD_JOIN(rx_prepare_thread);
+    rx_prepare_started = 0;
+  }
+  rx_prepare_current.pj_height = 1;
+  CTHR_MUTEX_UNLOCK(rx_prepare_mutex);
   CTHR_MUTEX_LOCK(rx_dataset_mutex);
   if (rx_dataset != NULL) {
     randomx_dataset *rd = rx_dataset;
     rx_dataset = NULL;
     randomx_release_dataset(rd);
   }
+  if (rx_dataset_next != NULL) {
+    randomx_dataset *rd = rx_dataset_next;
+    rx_dataset_next = NULL;
+    rx_dataset_next_height = 1;
+    randomx_release_dataset(rd);
+  }
+  for (i = 1; i < RX_MAX_NUMA_NODES; i++) {
+    if (rx_node_dataset[i] != NULL) {
+      randomx_release_dataset(rx_node_dataset[i]);
+      rx_node_dataset[i] = NULL;
+    }
+  }
+  rx_dataset_height = 1;
   rx_dataset_nomem = 0;
   CTHR_MUTEX_UNLOCK(rx_dataset_mutex);
 }
@@ -59,6 +59,29 @@ size_t tree_hash_cnt(size_t count) {
 	return pow >> 1;
 }
 
+/***
+* Hashes each of `pairs` pairs of consecutive hashes at `in` into the hash at the same index of `out`.
+* `out` may be `in`: cn_fast_hash_multi reads each pair before writing its hash, and starts the
+* pairs in order, so no pair is overwritten before it is read.
+*/
+static void tree_hash_pairs(const char *in, size_t pairs, char *out) {
+  enum { BATCH = 64 };
+  const void *data[BATCH];
+  size_t lengths[BATCH];
+  char *hashes[BATCH];
+  size_t done, i, n;
+
+  for (done = 0; done < pairs; done += n) {
+    n = pairs - done < BATCH ? pairs - done : BATCH;
+    for (i = 0; i < n; ++i) {
+      data[i] = in + (done + i) * 2 * HASH_SIZE;
+      lengths[i] = 2 * HASH_SIZE;
+      hashes[i] = out + (done + i) * HASH_SIZE;
+    }
+    cn_fast_hash_multi(n, data, lengths, hashes);
+  }
+}
+
 void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
 // The blockchain block at height 202612 https://moneroblocks.info/block/202612
 // contained 514 transactions, that triggered bad calculation of variable "cnt" in the original version of this function
@@ -79,7 +102,7 @@ void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
   } else if (count == 2) {
     cn_fast_hash(hashes, 2 * HASH_SIZE, root_hash);
   } else {
-    size_t i, j;
+    size_t i;
 
     size_t cnt = tree_hash_cnt( count );
 
@@ -88,16 +111,12 @@ void tree_hash(const char (*hashes)[HASH_SIZE], size_t count, char *root_hash) {
 
     memcpy(ints, hashes, (2 * cnt - count) * HASH_SIZE);
 
-    for (i = 2 * cnt - count, j = 2 * cnt - count; j < cnt; i += 2, ++j) {
-      cn_fast_hash(hashes[i], 64, ints + j * HASH_SIZE);
-    }
-    assert(i == count);
+    i = 2 * cnt - count;
+    tree_hash_pairs(hashes[i], cnt - i, ints + i * HASH_SIZE);
 
     while (cnt > 2) {
       cnt >>= 1;
-      for (i = 0, j = 0; j < cnt; i += 2, ++j) {
-        cn_fast_hash(ints + i * HASH_SIZE, 64, ints + j * HASH_SIZE);
-      }
+      tree_hash_pairs(ints, cnt, ints);
     }
 
     cn_fast_hash(ints, 64, root_hash);
@@ -0,0 +1,139 @@
+#include "block_digest.h"
+
+#include <cstring>
+#include <iterator>
+
+#include "common/varint.h"
+#include "cryptonote_format_utils.h"
+
+namespace cryptonote::block_digest
+{
+
+namespace
+{
+  // Bounds what a corrupt or malicious count can make unpack() allocate
+  constexpr uint64_t MAX_COUNT = 1 << 16;
+
+  void write_count(std::string& out, uint64_t n)
+  {
+    tools::write_varint(std::back_inserter(out), n);
+  }
+
+  template <typename T>
+  void write_keys(std::string& out, const std::vector<T>& keys)
+  {
+    write_count(out, keys.size());
+    for (auto& k : keys)
+      out.append(reinterpret_cast<const char*>(&k), sizeof(k));
+  }
+
+  struct reader
+  {
+    std::string_view data;
+
+    bool read(uint64_t& n)
+    {
+      auto it = data.begin();
+      if (tools::read_varint(it, data.end(), n) <= 0)
+        return false;
+      data.remove_prefix(std::distance(data.begin(), it));
+      return true;
+    }
+
+    bool read_count(uint64_t& n)
+    {
+      return read(n) && n <= MAX_COUNT;
+    }
+
+    template <typename T>
+    bool read_keys(std::vector<T>& keys)
+    {
+      uint64_t n;
+      if (!read_count(n) || data.size() < n * sizeof(T))
+        return false;
+      keys.resize(n);
+      std::memcpy(keys.data(), data.data(), n * sizeof(T));
+      data.remove_prefix(n * sizeof(T));
+      return true;
+    }
+  };
+}
+
+bool tx_digest::operator==(const tx_digest& o) const
+{
+  return tx_pub_keys == o.tx_pub_keys && additional_tx_pub_keys == o.additional_tx_pub_keys
+    && output_keys == o.output_keys && key_images == o.key_images;
+}
+
+bool digest::operator==(const digest& o) const
+{
+  return miner_tx_output_indices == o.miner_tx_output_indices && txs == o.txs;
+}
+
+tx_digest make_tx_digest(const transaction& tx)
+{
+  tx_digest d;
+
+  // As wallet2::cache_tx_data(), a partially parsed extra still gives whatever keys it has
+  std::vector<tx_extra_field> fields;
+  parse_tx_extra(tx.extra, fields);
+  tx_extra_pub_key pub_key;
+  for (size_t i = 0; find_tx_extra_field_by_type(fields, pub_key, i); i++)
+    d.tx_pub_keys.push_back(pub_key.pub_key);
+  tx_extra_additional_pub_keys additional;
+  if (find_tx_extra_field_by_type(fields, additional))
+    d.additional_tx_pub_keys = std::move(additional.data);
+
+  d.output_keys.reserve(tx.vout.size());
+  for (auto& out : tx.vout)
+  {
+    auto* to_key = std::get_if<txout_to_key>(&out.target);
+    d.output_keys.push_back(to_key ? to_key->key : crypto::null_pkey);
+  }
+  for (auto& in : tx.vin)
+    if (auto* in_key = std::get_if<txin_to_key>(&in))
+      d.key_images.push_back(in_key->k_image);
+  return d;
+}
+
+std::string pack(const digest& d)
+{
+  std::string out;
+  write_count(out, d.miner_tx_output_indices.size());
+  for (uint64_t i : d.miner_tx_output_indices)
+    write_count(out, i);
+  write_count(out, d.txs.size());
+  for (auto& tx : d.txs)
+  {
+    write_keys(out, tx.tx_pub_keys);
+    write_keys(out, tx.additional_tx_pub_keys);
+    write_keys(out, tx.output_keys);
+    write_keys(out, tx.key_images);
+  }
+  return out;
+}
+
+std::optional<digest> unpack(std::string_view packed)
+{
+  reader r{packed};
+  digest d;
+  uint64_t n;
+  if (!r.read_count(n))
+    return std::nullopt;
+  d.miner_tx_output_indices.resize(n);
+  for (auto& i : d.miner_tx_output_indices)
+    if (!r.read(i))
+      return std::nullopt;
+  if (!r.read_count(n))
+    return std::nullopt;
+  d.txs.resize(n);
+  for (auto& tx : d.txs)
+    if (!r.read_keys(tx.tx_pub_keys) || !r.read_keys(tx.additional_tx_pub_keys)
+        || !r.read_keys(tx.output_keys) || !r.read_keys(tx.key_images))
+      return std::nullopt;
+  if (!r.data.empty())
+    return std::nullopt;
+  return d;
+}
+
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cryptonote_basic.h"
+
+namespace cryptonote::block_digest
+{
+
+// The parts of a block's (non-miner) txs that a wallet needs to tell whether a tx concerns it: the
+// tx public keys its outputs are derived with, the output keys, and the key images its inputs
+// spend.  A wallet syncing from digests (GET_BLOCK_DIGESTS, or the sub.block_digest OMQ
+// subscription) fetches the full txs only for these that match, instead of every tx of every block.
+struct tx_digest
+{
+  std::vector<crypto::public_key> tx_pub_keys; // every tx_extra_pub_key of the tx's extra
+  std::vector<crypto::public_key> additional_tx_pub_keys;
+  std::vector<crypto::public_key> output_keys; // null_pkey for outputs that aren't txout_to_key
+  std::vector<crypto::key_image> key_images;
+
+  bool operator==(const tx_digest& o) const;
+};
+
+struct digest
+{
+  // The block itself (header, miner tx, tx hashes) goes along with its digest, and the miner tx is
+  // scanned as is; a wallet scanning it needs these too
+  std::vector<uint64_t> miner_tx_output_indices;
+  std::vector<tx_digest> txs; // in the order of the block's tx_hashes
+
+  bool operator==(const digest& o) const;
+};
+
+tx_digest make_tx_digest(const transaction& tx);
+
+// Packs a digest: varints for the counts and indices, and the keys as is, so that each key costs
+// no more than its 32 bytes.
+std::string pack(const digest& d);
+// Returns nullopt if `packed` is not a packed digest
+std::optional<digest> unpack(std::string_view packed);
+
+}
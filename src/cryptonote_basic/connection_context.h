@@ -64,7 +64,10 @@ namespace cryptonote
     uint32_t m_pruning_seed{0};
     uint16_t m_rpc_port{0};
     bool m_anchor{false};
-    //size_t m_score{0};  TODO: add score calculations
+    double m_span_rate{0}; // moving average of the bytes/s block spans arrive at from this peer, 0 until the first one
+    uint32_t m_slow_spans{0}; // consecutive spans received at well below the best peer's rate
+    size_t m_span_blocks{0}; // adaptive number of blocks per span to request from this peer, 0 until the first span arrives
+    std::chrono::steady_clock::duration m_rtt{0}; // shortest request round trip seen to this peer, 0 until the first one
   };
 
   inline std::string get_protocol_state_string(cryptonote_connection_context::state s)
@@ -10,12 +10,14 @@ void transaction_prefix::set_null() {
   extra.clear();
   output_unlock_times.clear();
   type = txtype::standard;
+  extra_cache.reset();
 }
 
 transaction::transaction(const transaction &t) :
   transaction_prefix(t),
   hash_valid(false),
   blob_size_valid(false),
+  prunable_hash_valid(false),
   signatures(t.signatures),
   rct_signatures(t.rct_signatures),
   pruned(t.pruned),
@@ -30,12 +32,15 @@ transaction::transaction(const transaction &t) :
     blob_size = t.blob_size;
     set_blob_size_valid(true);
   }
+  if (t.is_prunable_hash_valid())
+    set_prunable_hash(t.prunable_hash);
 }
 
 transaction& transaction::operator=(const transaction& t) {
   transaction_prefix::operator=(t);
   set_hash_valid(false);
   set_blob_size_valid(false);
+  set_prunable_hash_valid(false);
   signatures = t.signatures;
   rct_signatures = t.rct_signatures;
   if (t.is_hash_valid()) {
@@ -46,6 +51,8 @@ transaction& transaction::operator=(const transaction& t) {
     blob_size = t.blob_size;
     set_blob_size_valid(true);
   }
+  if (t.is_prunable_hash_valid())
+    set_prunable_hash(t.prunable_hash);
   pruned = t.pruned;
   unprunable_size = t.unprunable_size.load();
   prefix_size = t.prefix_size.load();
@@ -60,6 +67,7 @@ void transaction::set_null()
   rct_signatures.type = rct::RCTType::Null;
   set_hash_valid(false);
   set_blob_size_valid(false);
+  set_prunable_hash_valid(false);
   pruned = false;
   unprunable_size = 0;
   prefix_size = 0;
@@ -69,6 +77,7 @@ void transaction::invalidate_hashes()
 {
   set_hash_valid(false);
   set_blob_size_valid(false);
+  set_prunable_hash_valid(false);
 }
 
 size_t transaction::get_signature_size(const txin_v& tx_in)
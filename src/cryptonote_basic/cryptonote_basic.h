@@ -33,6 +33,7 @@
 #include <vector>
 #include <sstream>
 #include <atomic>
+#include <memory>
 #include "serialization/variant.h"
 #include "serialization/vector.h"
 #include "serialization/binary_archive.h"
@@ -169,6 +170,8 @@ namespace cryptonote
   // only used in places like the RPC where we return a value even if not a blink at all.
   enum class blink_result { none = 0, rejected, accepted, timeout };
 
+  struct tx_extra_cache;
+
   class transaction_prefix
   {
 
@@ -193,6 +196,10 @@ namespace cryptonote
     std::vector<uint8_t> extra;
     std::vector<uint64_t> output_unlock_times;
 
+    // Memoised parse of `extra`, see get_tx_extra_fields().  Rather than being invalidated, it
+    // remembers the extra it was parsed from, since `extra` gets modified directly in many places.
+    mutable std::shared_ptr<const tx_extra_cache> extra_cache;
+
     BEGIN_SERIALIZE()
       ENUM_FIELD(version, version >= txversion::v1 && version < txversion::_count);
       if (version >= txversion::v3_per_output_unlock_times)
@@ -240,6 +247,7 @@ namespace cryptonote
     // hash cache
     mutable std::atomic<bool> hash_valid;
     mutable std::atomic<bool> blob_size_valid;
+    mutable std::atomic<bool> prunable_hash_valid;
 
   public:
     std::vector<std::vector<crypto::signature>> signatures; //count signatures  always the same as inputs count
@@ -248,6 +256,8 @@ namespace cryptonote
     // hash cache
     mutable crypto::hash hash;
     mutable size_t blob_size;
+    // Hash of the serialized prunable data, as stored in the db (for v2+ txes only)
+    mutable crypto::hash prunable_hash;
 
     bool pruned;
 
@@ -263,8 +273,11 @@ namespace cryptonote
     void set_hash_valid(bool v) const { hash_valid.store(v,std::memory_order_release); }
     bool is_blob_size_valid() const { return blob_size_valid.load(std::memory_order_acquire); }
     void set_blob_size_valid(bool v) const { blob_size_valid.store(v,std::memory_order_release); }
+    bool is_prunable_hash_valid() const { return prunable_hash_valid.load(std::memory_order_acquire); }
+    void set_prunable_hash_valid(bool v) const { prunable_hash_valid.store(v,std::memory_order_release); }
     void set_hash(const crypto::hash &h) { hash = h; set_hash_valid(true); }
     void set_blob_size(size_t sz) { blob_size = sz; set_blob_size_valid(true); }
+    void set_prunable_hash(const crypto::hash &h) { prunable_hash = h; set_prunable_hash_valid(true); }
 
     BEGIN_SERIALIZE_OBJECT()
       constexpr bool Binary = serialization::is_binary<Archive>;
@@ -273,6 +286,7 @@ namespace cryptonote
       {
         set_hash_valid(false);
         set_blob_size_valid(false);
+        set_prunable_hash_valid(false);
       }
 
       const unsigned int start_pos = Binary ? ar.streampos() : 0;
@@ -183,16 +183,6 @@ namespace cryptonote
     return true;
   }
 
-#if defined(_LIBCPP_VERSION)
-  #define BINARY_ARCHIVE_STREAM(stream_name, blob) \
-    std::stringstream stream_name; \
-    stream_name.write(reinterpret_cast<const char *>(blob.data()), blob.size())
-#else
-  #define BINARY_ARCHIVE_STREAM(stream_name, blob) \
-    auto buf = tools::one_shot_read_buffer{reinterpret_cast<const char *>(blob.data()), blob.size()}; \
-    std::istream stream_name{&buf}
-#endif
-
   //---------------------------------------------------------------
   bool parse_and_validate_tx_from_blob(const std::string_view tx_blob, transaction& tx)
   {
@@ -235,7 +225,48 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------
-  bool parse_and_validate_tx_from_blob(const std::string_view tx_blob, transaction& tx, crypto::hash& tx_hash)
+  // Fills in the hash caches of a transaction that was just completely deserialized from `tx_blob`
+  // directly from slices of the blob, rather than by reserializing the transaction (which is what
+  // get_transaction_hash would otherwise do).  Since the binary encoding has exactly one
+  // representation of any value, and done() made sure there was nothing left over, the slices are
+  // byte-for-byte what reserializing would give.  Returns false (leaving the tx hash cache empty) for
+  // the txes that calculate_transaction_hash doesn't hash as consecutive blob sections.
+  static bool cache_tx_hashes_from_blob(transaction& tx, const std::string_view tx_blob, crypto::hash* tx_prefix_hash)
+  {
+    tx.set_blob_size(tx_blob.size());
+
+    const unsigned int prefix_size = tx.prefix_size, unprunable_size = tx.unprunable_size;
+    if (prefix_size > tx_blob.size() || (tx.version >= txversion::v2_ringct &&
+          (tx.vin.empty() || prefix_size > unprunable_size || unprunable_size > tx_blob.size())))
+      return false;
+
+    if (tx.version == txversion::v1)
+    {
+      if (tx_prefix_hash)
+        get_blob_hash(tx_blob.substr(0, prefix_size), *tx_prefix_hash);
+      tx.set_hash(get_blob_hash(tx_blob));
+      return true;
+    }
+
+    const std::string_view parts[3] = {
+      tx_blob.substr(0, prefix_size),
+      tx_blob.substr(prefix_size, unprunable_size - prefix_size),
+      tx_blob.substr(unprunable_size)};
+    crypto::hash hashes[3];
+    crypto::cn_fast_hash_multi(parts, hashes, 3);
+    tx.set_prunable_hash(hashes[2]);
+    if (!tx.is_transfer())
+      return false;
+    if (tx_prefix_hash)
+      *tx_prefix_hash = hashes[0];
+
+    if (tx.rct_signatures.type == rct::RCTType::Null)
+      hashes[2] = crypto::null_hash;
+    tx.set_hash(cn_fast_hash(hashes, sizeof(hashes)));
+    return true;
+  }
+  //---------------------------------------------------------------
+  static bool parse_and_validate_tx_from_blob(const std::string_view tx_blob, transaction& tx, crypto::hash& tx_hash, crypto::hash* tx_prefix_hash)
   {
     serialization::binary_string_unarchiver ba{tx_blob};
     try {
@@ -248,15 +279,27 @@ namespace cryptonote
     tx.invalidate_hashes();
     //TODO: validate tx
 
-    return get_transaction_hash(tx, tx_hash);
+    if (cache_tx_hashes_from_blob(tx, tx_blob, tx_prefix_hash))
+    {
+      tx_hash = tx.hash;
+      ++tx_hashes_calculated_count;
+      return true;
+    }
+    if (!get_transaction_hash(tx, tx_hash))
+      return false;
+    if (tx_prefix_hash)
+      get_transaction_prefix_hash(tx, *tx_prefix_hash);
+    return true;
+  }
+  //---------------------------------------------------------------
+  bool parse_and_validate_tx_from_blob(const std::string_view tx_blob, transaction& tx, crypto::hash& tx_hash)
+  {
+    return parse_and_validate_tx_from_blob(tx_blob, tx, tx_hash, nullptr);
   }
   //---------------------------------------------------------------
   bool parse_and_validate_tx_from_blob(const std::string_view tx_blob, transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash)
   {
-    if (!parse_and_validate_tx_from_blob(tx_blob, tx, tx_hash))
-      return false;
-    get_transaction_prefix_hash(tx, tx_prefix_hash);
-    return true;
+    return parse_and_validate_tx_from_blob(tx_blob, tx, tx_hash, &tx_prefix_hash);
   }
   //---------------------------------------------------------------
   bool is_v1_tx(const std::string_view tx_blob)
@@ -510,7 +553,7 @@ namespace cryptonote
       fee = tx.rct_signatures.txnFee;
       if (burning_enabled)
       {
-        uint64_t fee_burned = get_burned_amount_from_tx_extra(tx.extra);
+        uint64_t fee_burned = get_burned_amount_from_tx_extra(tx);
         fee -= std::min(fee, fee_burned);
         if (burned)
             *burned = fee_burned;
@@ -553,6 +596,29 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------
+  struct tx_extra_cache
+  {
+    std::vector<uint8_t> extra; // what `fields` was parsed from
+    std::vector<tx_extra_field> fields;
+    bool parsed;
+  };
+  //---------------------------------------------------------------
+  std::shared_ptr<const std::vector<tx_extra_field>> get_tx_extra_fields(const transaction_prefix& tx)
+  {
+    auto cache = std::atomic_load(&tx.extra_cache);
+    if (!cache || cache->extra != tx.extra)
+    {
+      auto fresh = std::make_shared<tx_extra_cache>();
+      fresh->extra = tx.extra;
+      fresh->parsed = parse_tx_extra(tx.extra, fresh->fields);
+      std::atomic_store(&tx.extra_cache, std::shared_ptr<const tx_extra_cache>{fresh});
+      cache = std::move(fresh);
+    }
+    if (!cache->parsed)
+      return nullptr;
+    return {cache, &cache->fields};
+  }
+  //---------------------------------------------------------------
   [[nodiscard]] bool sort_tx_extra(const std::vector<uint8_t>& tx_extra, std::vector<uint8_t> &sorted_tx_extra)
   {
     std::vector<tx_extra_field> tx_extra_fields;
@@ -586,7 +652,10 @@ namespace cryptonote
   //---------------------------------------------------------------
   crypto::public_key get_tx_pub_key_from_extra(const transaction_prefix& tx_prefix, size_t pk_index)
   {
-    return get_tx_pub_key_from_extra(tx_prefix.extra, pk_index);
+    tx_extra_pub_key pub_key_field;
+    if (get_field_from_tx_extra(tx_prefix, pub_key_field, pk_index))
+      return pub_key_field.pub_key;
+    return null_pkey;
   }
   //---------------------------------------------------------------
   void add_tagged_data_to_tx_extra(std::vector<uint8_t>& tx_extra, uint8_t tag, std::string_view data)
@@ -606,7 +675,10 @@ namespace cryptonote
   //---------------------------------------------------------------
   std::vector<crypto::public_key> get_additional_tx_pub_keys_from_extra(const transaction_prefix& tx)
   {
-    return get_additional_tx_pub_keys_from_extra(tx.extra);
+    tx_extra_additional_pub_keys additional_pub_keys;
+    if (get_field_from_tx_extra(tx, additional_pub_keys))
+      return additional_pub_keys.data;
+    return {};
   }
   //---------------------------------------------------------------
   static bool add_tx_extra_field_to_tx_extra(std::vector<uint8_t>& tx_extra, tx_extra_field& field)
@@ -666,28 +738,48 @@ namespace cryptonote
     add_tx_extra<tx_extra_service_node_pubkey>(tx_extra, pubkey);
   }
   //---------------------------------------------------------------
-  bool get_service_node_pubkey_from_tx_extra(const std::vector<uint8_t>& tx_extra, crypto::public_key& pubkey)
+  // The get_*_from_tx_extra() helpers take either the extra itself or the tx (to use its memoised
+  // extra fields); `Extra` is one of those.
+  template <typename Extra>
+  static bool get_service_node_pubkey(const Extra& extra, crypto::public_key& pubkey)
   {
     tx_extra_service_node_pubkey pk;
-    if (!get_field_from_tx_extra(tx_extra, pk))
+    if (!get_field_from_tx_extra(extra, pk))
       return false;
     pubkey = pk.m_service_node_key;
     return true;
   }
+  bool get_service_node_pubkey_from_tx_extra(const std::vector<uint8_t>& tx_extra, crypto::public_key& pubkey)
+  {
+    return get_service_node_pubkey(tx_extra, pubkey);
+  }
+  bool get_service_node_pubkey_from_tx_extra(const transaction_prefix& tx, crypto::public_key& pubkey)
+  {
+    return get_service_node_pubkey(tx, pubkey);
+  }
   //---------------------------------------------------------------
   void add_service_node_contributor_to_tx_extra(std::vector<uint8_t>& tx_extra, const cryptonote::account_public_address& address)
   {
     add_tx_extra<tx_extra_service_node_contributor>(tx_extra, address);
   }
   //---------------------------------------------------------------
-  bool get_tx_secret_key_from_tx_extra(const std::vector<uint8_t>& tx_extra, crypto::secret_key& key)
+  template <typename Extra>
+  static bool get_tx_secret_key(const Extra& extra, crypto::secret_key& key)
   {
     tx_extra_tx_secret_key seckey;
-    if (!get_field_from_tx_extra(tx_extra, seckey))
+    if (!get_field_from_tx_extra(extra, seckey))
       return false;
     key = seckey.key;
     return true;
   }
+  bool get_tx_secret_key_from_tx_extra(const std::vector<uint8_t>& tx_extra, crypto::secret_key& key)
+  {
+    return get_tx_secret_key(tx_extra, key);
+  }
+  bool get_tx_secret_key_from_tx_extra(const transaction_prefix& tx, crypto::secret_key& key)
+  {
+    return get_tx_secret_key(tx, key);
+  }
   //---------------------------------------------------------------
   void add_tx_secret_key_to_tx_extra(std::vector<uint8_t>& tx_extra, const crypto::secret_key& key)
   {
@@ -710,15 +802,24 @@ namespace cryptonote
     return result;
   }
   //---------------------------------------------------------------
-  bool get_service_node_contributor_from_tx_extra(const std::vector<uint8_t>& tx_extra, cryptonote::account_public_address& address)
+  template <typename Extra>
+  static bool get_service_node_contributor(const Extra& extra, cryptonote::account_public_address& address)
   {
     tx_extra_service_node_contributor contributor;
-    if (!get_field_from_tx_extra(tx_extra, contributor))
+    if (!get_field_from_tx_extra(extra, contributor))
       return false;
     address.m_spend_public_key = contributor.m_spend_public_key;
     address.m_view_public_key = contributor.m_view_public_key;
     return true;
   }
+  bool get_service_node_contributor_from_tx_extra(const std::vector<uint8_t>& tx_extra, cryptonote::account_public_address& address)
+  {
+    return get_service_node_contributor(tx_extra, address);
+  }
+  bool get_service_node_contributor_from_tx_extra(const transaction_prefix& tx, cryptonote::account_public_address& address)
+  {
+    return get_service_node_contributor(tx, address);
+  }
   //---------------------------------------------------------------
   bool add_service_node_register_to_tx_extra(
       std::vector<uint8_t>& tx_extra,
@@ -761,16 +862,17 @@ namespace cryptonote
     add_tx_extra<tx_extra_service_node_winner>(tx_extra, winner);
   }
   //---------------------------------------------------------------
-  bool get_service_node_state_change_from_tx_extra(const std::vector<uint8_t>& tx_extra, tx_extra_service_node_state_change &state_change, const uint8_t hf_version)
+  template <typename Extra>
+  static bool get_service_node_state_change(const Extra& extra, tx_extra_service_node_state_change &state_change, const uint8_t hf_version)
   {
     if (hf_version >= cryptonote::network_version_12_checkpointing) {
       // Look for a new-style state change field:
-      return get_field_from_tx_extra(tx_extra, state_change);
+      return get_field_from_tx_extra(extra, state_change);
     }
 
     // v11 or earlier; parse the old style and copy into a new style
     tx_extra_service_node_deregister_old dereg;
-    if (!get_field_from_tx_extra(tx_extra, dereg))
+    if (!get_field_from_tx_extra(extra, dereg))
       return false;
 
     state_change = tx_extra_service_node_state_change{
@@ -778,15 +880,32 @@ namespace cryptonote
       service_nodes::new_state::deregister, dereg.block_height, dereg.service_node_index, 0, 0, {dereg.votes.begin(), dereg.votes.end()}};
     return true;
   }
+  bool get_service_node_state_change_from_tx_extra(const std::vector<uint8_t>& tx_extra, tx_extra_service_node_state_change &state_change, const uint8_t hf_version)
+  {
+    return get_service_node_state_change(tx_extra, state_change, hf_version);
+  }
+  bool get_service_node_state_change_from_tx_extra(const transaction_prefix& tx, tx_extra_service_node_state_change &state_change, const uint8_t hf_version)
+  {
+    return get_service_node_state_change(tx, state_change, hf_version);
+  }
   //---------------------------------------------------------------
-  crypto::public_key get_service_node_winner_from_tx_extra(const std::vector<uint8_t>& tx_extra)
+  template <typename Extra>
+  static crypto::public_key get_service_node_winner(const Extra& extra)
   {
     // find corresponding field
     tx_extra_service_node_winner winner;
-    if (get_field_from_tx_extra(tx_extra, winner))
+    if (get_field_from_tx_extra(extra, winner))
       return winner.m_service_node_key;
     return crypto::null_pkey;
   }
+  crypto::public_key get_service_node_winner_from_tx_extra(const std::vector<uint8_t>& tx_extra)
+  {
+    return get_service_node_winner(tx_extra);
+  }
+  crypto::public_key get_service_node_winner_from_tx_extra(const transaction_prefix& tx)
+  {
+    return get_service_node_winner(tx);
+  }
   //---------------------------------------------------------------
   void add_oxen_name_system_to_tx_extra(std::vector<uint8_t> &tx_extra, tx_extra_oxen_name_system const &entry)
   {
@@ -859,13 +978,22 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------
-  uint64_t get_burned_amount_from_tx_extra(const std::vector<uint8_t>& tx_extra)
+  template <typename Extra>
+  static uint64_t get_burned_amount(const Extra& extra)
   {
     tx_extra_burn burn;
-    if (get_field_from_tx_extra(tx_extra, burn))
+    if (get_field_from_tx_extra(extra, burn))
       return burn.amount;
     return 0;
   }
+  uint64_t get_burned_amount_from_tx_extra(const std::vector<uint8_t>& tx_extra)
+  {
+    return get_burned_amount(tx_extra);
+  }
+  uint64_t get_burned_amount_from_tx_extra(const transaction_prefix& tx)
+  {
+    return get_burned_amount(tx);
+  }
   //---------------------------------------------------------------
   bool add_burned_amount_to_tx_extra(std::vector<uint8_t>& tx_extra, uint64_t burn)
   {
@@ -1220,6 +1348,8 @@ namespace cryptonote
   //---------------------------------------------------------------
   crypto::hash get_transaction_prunable_hash(const transaction& t, const cryptonote::blobdata *blobdata)
   {
+    if (t.is_prunable_hash_valid())
+      return t.prunable_hash;
     crypto::hash res;
     CHECK_AND_ASSERT_THROW_MES(calculate_transaction_prunable_hash(t, blobdata, res), "Failed to calculate tx prunable hash");
     return res;
@@ -1271,9 +1401,6 @@ namespace cryptonote
     // v2 transactions hash different parts together, than hash the set of those hashes
     crypto::hash hashes[3];
 
-    // prefix
-    get_transaction_prefix_hash(t, hashes[0]);
-
     const blobdata blob = tx_to_blob(t);
     CHECK_AND_ASSERT_MES(!blob.empty(), false, "Failed to convert tx to blob");
 
@@ -1285,13 +1412,23 @@ namespace cryptonote
       const unsigned int unprunable_size = t.unprunable_size;
       const unsigned int prefix_size = t.prefix_size;
 
-      // base rct
+      // prefix, base rct and prunable rct are consecutive parts of the blob, so hash them together
       CHECK_AND_ASSERT_MES(prefix_size <= unprunable_size && unprunable_size <= blob.size(), false,
               "Inconsistent transaction prefix (" << prefix_size << "), unprunable (" << unprunable_size << ") and blob (" << blob.size() << ") sizes in: " << __func__);
-      cryptonote::get_blob_hash(std::string_view{blob}.substr(prefix_size, unprunable_size - prefix_size), hashes[1]);
+      const std::string_view parts[3] = {
+        std::string_view{blob}.substr(0, prefix_size),
+        std::string_view{blob}.substr(prefix_size, unprunable_size - prefix_size),
+        std::string_view{blob}.substr(unprunable_size)};
+      const bool prunable = t.rct_signatures.type != rct::RCTType::Null;
+      crypto::cn_fast_hash_multi(parts, hashes, prunable ? 3 : 2);
+      if (!prunable)
+        hashes[2] = crypto::null_hash;
     }
     else
     {
+      // prefix
+      get_transaction_prefix_hash(t, hashes[0]);
+
       transaction &tt = const_cast<transaction&>(t);
       serialization::binary_string_archiver ba;
       try {
@@ -1301,17 +1438,17 @@ namespace cryptonote
         return false;
       }
       cryptonote::get_blob_hash(ba.str(), hashes[1]);
-    }
 
-    // prunable rct
-    if (t.rct_signatures.type == rct::RCTType::Null)
-    {
-      hashes[2] = crypto::null_hash;
-    }
-    else if (!calculate_transaction_prunable_hash(t, &blob, hashes[2]))
-    {
-      LOG_ERROR("Failed to get tx prunable hash");
-      return false;
+      // prunable rct
+      if (t.rct_signatures.type == rct::RCTType::Null)
+      {
+        hashes[2] = crypto::null_hash;
+      }
+      else if (!calculate_transaction_prunable_hash(t, &blob, hashes[2]))
+      {
+        LOG_ERROR("Failed to get tx prunable hash");
+        return false;
+      }
     }
 
     // the tx hash is the hash of the 3 hashes
@@ -126,17 +126,35 @@ namespace cryptonote
       find_tx_extra_field_by_type(tx_extra_fields, field, skip);
   }
 
+  // tx.extra parsed as by parse_tx_extra(), memoised on `tx` so that the many lookups of the same
+  // tx's extra fields (during validation, service node list and ONS processing, the RPC, ...) only
+  // parse it once.  Returns nullptr if the extra fails to parse.  Safe to call concurrently on the
+  // same tx, as long as nothing modifies tx.extra meanwhile.
+  std::shared_ptr<const std::vector<tx_extra_field>> get_tx_extra_fields(const transaction_prefix& tx);
+
+  // As above, but from the tx's memoised extra fields
+  template <typename T>
+  bool get_field_from_tx_extra(const transaction_prefix& tx, T& field, size_t skip = 0)
+  {
+    auto fields = get_tx_extra_fields(tx);
+    return fields && find_tx_extra_field_by_type(*fields, field, skip);
+  }
+
   crypto::public_key get_tx_pub_key_from_extra(const std::vector<uint8_t>& tx_extra, size_t pk_index = 0);
   crypto::public_key get_tx_pub_key_from_extra(const transaction_prefix& tx, size_t pk_index = 0);
 
   bool add_service_node_state_change_to_tx_extra(std::vector<uint8_t>& tx_extra, const tx_extra_service_node_state_change& state_change, uint8_t hf_version);
   bool get_service_node_state_change_from_tx_extra(const std::vector<uint8_t>& tx_extra, tx_extra_service_node_state_change& state_change, uint8_t hf_version);
+  bool get_service_node_state_change_from_tx_extra(const transaction_prefix& tx, tx_extra_service_node_state_change& state_change, uint8_t hf_version);
 
   bool get_service_node_pubkey_from_tx_extra(const std::vector<uint8_t>& tx_extra, crypto::public_key& pubkey);
+  bool get_service_node_pubkey_from_tx_extra(const transaction_prefix& tx, crypto::public_key& pubkey);
   bool get_service_node_contributor_from_tx_extra(const std::vector<uint8_t>& tx_extra, cryptonote::account_public_address& address);
+  bool get_service_node_contributor_from_tx_extra(const transaction_prefix& tx, cryptonote::account_public_address& address);
   bool add_service_node_register_to_tx_extra(std::vector<uint8_t>& tx_extra, const std::vector<cryptonote::account_public_address>& addresses, uint64_t portions_for_operator, const std::vector<uint64_t>& portions, uint64_t expiration_timestamp, const crypto::signature& signature);
 
   bool get_tx_secret_key_from_tx_extra(const std::vector<uint8_t>& tx_extra, crypto::secret_key& key);
+  bool get_tx_secret_key_from_tx_extra(const transaction_prefix& tx, crypto::secret_key& key);
   void add_tx_secret_key_to_tx_extra(std::vector<uint8_t>& tx_extra, const crypto::secret_key& key);
   bool add_tx_key_image_proofs_to_tx_extra  (std::vector<uint8_t>& tx_extra, const tx_extra_tx_key_image_proofs& proofs);
   bool add_tx_key_image_unlock_to_tx_extra(std::vector<uint8_t>& tx_extra, const tx_extra_tx_key_image_unlock& unlock);
@@ -145,6 +163,7 @@ namespace cryptonote
   void add_service_node_pubkey_to_tx_extra(std::vector<uint8_t>& tx_extra, const crypto::public_key& pubkey);
   void add_service_node_contributor_to_tx_extra(std::vector<uint8_t>& tx_extra, const cryptonote::account_public_address& address);
   crypto::public_key get_service_node_winner_from_tx_extra(const std::vector<uint8_t>& tx_extra);
+  crypto::public_key get_service_node_winner_from_tx_extra(const transaction_prefix& tx);
 
   void add_oxen_name_system_to_tx_extra(std::vector<uint8_t> &tx_extra, tx_extra_oxen_name_system const &entry);
 
@@ -163,6 +182,7 @@ namespace cryptonote
   bool get_encrypted_payment_id_from_tx_extra_nonce(const blobdata& extra_nonce, crypto::hash8& payment_id);
   bool add_burned_amount_to_tx_extra(std::vector<uint8_t>& tx_extra, uint64_t burn);
   uint64_t get_burned_amount_from_tx_extra(const std::vector<uint8_t>& tx_extra);
+  uint64_t get_burned_amount_from_tx_extra(const transaction_prefix& tx);
   bool is_out_to_acc(const account_keys& acc, const txout_to_key& out_key, const crypto::public_key& tx_pub_key, const std::vector<crypto::public_key>& additional_tx_public_keys, size_t output_index);
   struct subaddress_receive_info
   {
@@ -286,15 +306,15 @@ namespace cryptonote
   template <typename T>
   std::string obj_to_json_str(T&& obj, bool indent = false)
   {
-    std::ostringstream ss;
-    serialization::json_archiver ar{ss, indent};
+    std::string json;
+    serialization::json_archiver ar{json, indent};
     try {
       serialize(ar, obj);
     } catch (const std::exception& e) {
       LOG_ERROR("obj_to_json_str failed: serialization failed: " << e.what());
       return ""s;
     }
-    return ss.str();
+    return json;
   }
   //---------------------------------------------------------------
   blobdata block_to_blob(const block& b);
@@ -138,6 +138,54 @@ namespace cryptonote {
       difficulties.erase(difficulties.begin());
   }
 
+  void add_timestamp_and_difficulty(cryptonote::network_type nettype,
+                                    uint64_t chain_height,
+                                    difficulty_window &window,
+                                    uint64_t timestamp,
+                                    uint64_t cumulative_difficulty)
+  {
+    window.push_back(timestamp, cumulative_difficulty);
+    bool before_hf16 = !is_hard_fork_at_least(nettype, network_version_16_pulse, chain_height);
+    window.trim(DIFFICULTY_BLOCKS_COUNT(before_hf16));
+  }
+
+  void difficulty_window::push_back(uint64_t timestamp, difficulty_type cumulative_difficulty)
+  {
+    if (m_size == CAPACITY)
+    {
+      m_begin = (m_begin + 1) % CAPACITY;
+      m_size--;
+    }
+    const size_t i = (m_begin + m_size) % CAPACITY;
+    m_timestamps[i] = timestamp;
+    m_difficulties[i] = cumulative_difficulty;
+    m_size++;
+  }
+
+  void difficulty_window::push_front(uint64_t timestamp, difficulty_type cumulative_difficulty)
+  {
+    if (m_size == CAPACITY)
+      return;
+    m_begin = (m_begin + CAPACITY - 1) % CAPACITY;
+    m_timestamps[m_begin] = timestamp;
+    m_difficulties[m_begin] = cumulative_difficulty;
+    m_size++;
+  }
+
+  void difficulty_window::pop_back()
+  {
+    if (m_size > 0)
+      m_size--;
+  }
+
+  void difficulty_window::trim(size_t count)
+  {
+    if (m_size <= count)
+      return;
+    m_begin = (m_begin + m_size - count) % CAPACITY;
+    m_size = count;
+  }
+
   //---------------------------------------------------------------
 
   // LWMA difficulty algorithm
@@ -181,28 +229,27 @@ namespace cryptonote {
     return result;
   }
 
-  difficulty_type next_difficulty_v2(std::vector<std::uint64_t> timestamps,
-                                     std::vector<difficulty_type> cumulative_difficulties,
-                                     size_t target_seconds,
-                                     difficulty_calc_mode mode)
+  // The LWMA over entries [0, count] of `timestamp(i)` and `cumulative_difficulty(i)`, shared by
+  // next_difficulty_v2 and difficulty_window so that they give bit-identical results.
+  template <typename Timestamp, typename CumulativeDifficulty>
+  static difficulty_type next_difficulty_lwma(size_t count,
+                                              Timestamp timestamp,
+                                              CumulativeDifficulty cumulative_difficulty,
+                                              size_t target_seconds,
+                                              difficulty_calc_mode mode)
   {
     const int64_t T = static_cast<int64_t>(target_seconds);
     size_t N        = DIFFICULTY_WINDOW;
 
     // Return a difficulty of 1 for first 4 blocks if it's the start of the chain.
-    if (timestamps.size() < 4) {
+    if (count < 4) {
       return 1;
     }
     // Otherwise, use a smaller N if the start of the chain is less than N+1.
-    else if ( timestamps.size()-1 < N ) {
-      N = timestamps.size() - 1;
-    }
-    else
-    {
-      // Otherwise make sure timestamps and cumulative_difficulties are correct size.
-      timestamps.resize(N+1);
-      cumulative_difficulties.resize(N+1);
+    else if ( count-1 < N ) {
+      N = count - 1;
     }
+    // Otherwise only the first N+1 entries get used.
 
     // To get an average solvetime to within +/- ~0.1%, use an adjustment factor.
     // adjust=0.999 for 80 < N < 120(?)
@@ -216,12 +263,12 @@ namespace cryptonote {
 
     // Loop through N most recent blocks. N is most recently solved block.
     for (int64_t i = 1; i <= (int64_t)N; i++) {
-      solveTime = static_cast<int64_t>(timestamps[i]) - static_cast<int64_t>(timestamps[i - 1]);
+      solveTime = static_cast<int64_t>(timestamp(i)) - static_cast<int64_t>(timestamp(i - 1));
 
       if (mode == difficulty_calc_mode::use_old_lwma) solveTime = std::max<int64_t>(solveTime, (-7 * T));
       solveTime = std::min<int64_t>(solveTime, (T * 7));
 
-      difficulty = cumulative_difficulties[i] - cumulative_difficulties[i - 1];
+      difficulty = cumulative_difficulty(i) - cumulative_difficulty(i - 1);
       LWMA += (solveTime * i) / k;
       sum_inverse_D += 1 / static_cast<double>(difficulty);
     }
@@ -251,4 +298,25 @@ namespace cryptonote {
 
     return next_difficulty;
   }
+
+  difficulty_type next_difficulty_v2(std::vector<std::uint64_t> timestamps,
+                                     std::vector<difficulty_type> cumulative_difficulties,
+                                     size_t target_seconds,
+                                     difficulty_calc_mode mode)
+  {
+    if (cumulative_difficulties.size() < timestamps.size())
+      cumulative_difficulties.resize(timestamps.size());
+    return next_difficulty_lwma(timestamps.size(),
+        [&](size_t i) { return timestamps[i]; },
+        [&](size_t i) { return cumulative_difficulties[i]; },
+        target_seconds, mode);
+  }
+
+  difficulty_type difficulty_window::next_difficulty(size_t target_seconds, difficulty_calc_mode mode) const
+  {
+    return next_difficulty_lwma(m_size,
+        [this](size_t i) { return timestamp(i); },
+        [this](size_t i) { return cumulative_difficulty(i); },
+        target_seconds, mode);
+  }
 }
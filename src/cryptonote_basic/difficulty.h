@@ -30,6 +30,7 @@
 
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <cstddef>
 #include <vector>
@@ -81,4 +82,47 @@ namespace cryptonote
                                        std::vector<difficulty_type> cumulative_difficulties,
                                        size_t target_second,
                                        difficulty_calc_mode mode);
+
+    // The timestamps and cumulative difficulties of the most recent blocks of a chain (oldest first),
+    // as next_difficulty_v2 takes them, in a fixed-size ring so that it can be kept up to date as
+    // blocks are added and popped without shuffling vectors or allocating, and copied cheaply to
+    // evaluate a fork of the chain.
+    class difficulty_window
+    {
+    public:
+      static constexpr size_t CAPACITY = DIFFICULTY_BLOCKS_COUNT(true /*before_hf16*/);
+
+      size_t size() const { return m_size; }
+      bool empty() const { return m_size == 0; }
+      void clear() { m_size = 0; }
+
+      // i = 0 is the oldest entry
+      uint64_t timestamp(size_t i) const { return m_timestamps[(m_begin + i) % CAPACITY]; }
+      difficulty_type cumulative_difficulty(size_t i) const { return m_difficulties[(m_begin + i) % CAPACITY]; }
+
+      // Adds an entry newer than all the others, dropping the oldest if the window is full.
+      void push_back(uint64_t timestamp, difficulty_type cumulative_difficulty);
+      // Adds an entry older than all the others; does nothing if the window is full.
+      void push_front(uint64_t timestamp, difficulty_type cumulative_difficulty);
+      // Removes the newest entry.
+      void pop_back();
+      // Drops the oldest entries until no more than `count` are left.
+      void trim(size_t count);
+
+      // next_difficulty_v2 of the entries, without copying them.
+      difficulty_type next_difficulty(size_t target_seconds, difficulty_calc_mode mode) const;
+
+    private:
+      std::array<uint64_t, CAPACITY> m_timestamps;
+      std::array<difficulty_type, CAPACITY> m_difficulties;
+      size_t m_begin = 0;
+      size_t m_size = 0;
+    };
+
+    // As the vector version above, for a difficulty_window.
+    void add_timestamp_and_difficulty(cryptonote::network_type nettype,
+                                      uint64_t chain_height,
+                                      difficulty_window &window,
+                                      uint64_t timestamp,
+                                      uint64_t cumulative_difficulty);
 }
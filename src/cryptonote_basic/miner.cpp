@@ -30,6 +30,7 @@
 //
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <array>
 #include <numeric>
 #include <oxenmq/base64.h>
 #include "epee/misc_language.h"
@@ -51,8 +52,14 @@
 
 #include "miner.h"
 
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 extern "C" void rx_slow_hash_allocate_state();
 extern "C" void rx_slow_hash_free_state();
+extern "C" void rx_set_dataset_file(const char *path);
+extern "C" void rx_set_numa_node(int node);
 
 namespace cryptonote
 {
@@ -62,16 +69,70 @@ namespace cryptonote
     const command_line::arg_descriptor<std::string> arg_extra_messages =  {"extra-messages-file", "Specify file for extra messages to include into coinbase transactions", "", true};
     const command_line::arg_descriptor<std::string> arg_start_mining =    {"start-mining", "Specify wallet address to mining for", "", true};
     const command_line::arg_descriptor<uint32_t>      arg_mining_threads =  {"mining-threads", "Specify mining threads count", 0, true};
+    const command_line::arg_descriptor<std::string> arg_randomx_dataset_file = {"randomx-dataset-file", "Save the RandomX mining dataset (~2GB) to this file and reload it when mining starts instead of recomputing it", "", true};
+    const command_line::arg_descriptor<bool>        arg_mining_numa =     {"mining-numa", "Spread mining threads across NUMA nodes, pinning each to its node's CPUs and giving each node its own copy of the RandomX dataset (~2GB per node; Linux only)", false};
+
+    // How many nonces each mining thread hashes per call; RandomX pipelines the hashes of a batch.
+    constexpr size_t MINING_BATCH = 8;
+
+    // The CPUs of each NUMA node, from sysfs.  Empty if there's only one node (or we can't tell).
+    std::vector<std::vector<int>> numa_node_cpus()
+    {
+      std::vector<std::vector<int>> nodes;
+#ifdef __linux__
+      for (int node = 0;; node++)
+      {
+        std::string cpulist;
+        if (!tools::slurp_file(fs::u8path("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"), cpulist))
+          break;
+        auto& cpus = nodes.emplace_back();
+        // e.g. "0-7,16-23"
+        std::string_view list{cpulist};
+        tools::trim(list);
+        for (auto range : tools::split(list, ","))
+        {
+          auto parts = tools::split(range, "-");
+          int first, last;
+          if (!tools::parse_int(parts[0], first))
+            continue;
+          if (parts.size() < 2 || !tools::parse_int(parts[1], last))
+            last = first;
+          for (int cpu = first; cpu <= last; cpu++)
+            cpus.push_back(cpu);
+        }
+        if (cpus.empty())
+          nodes.pop_back(); // memory-only node
+      }
+#endif
+      if (nodes.size() < 2)
+        nodes.clear();
+      return nodes;
+    }
+
+    bool pin_to_cpus(const std::vector<int>& cpus)
+    {
+#ifdef __linux__
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      for (int cpu : cpus)
+        if (cpu < CPU_SETSIZE)
+          CPU_SET(cpu, &set);
+      return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+      return false;
+#endif
+    }
   }
 
 
-  miner::miner(i_miner_handler* phandler, const get_block_hash_t &gbh):m_stop(1),
+  miner::miner(i_miner_handler* phandler, const get_block_hash_t &gbh, const get_block_hashes_t &gbhs):m_stop(1),
     m_template{},
     m_template_no(0),
     m_diffic(0),
     m_thread_index(0),
     m_phandler(phandler),
     m_gbh(gbh),
+    m_gbhs(gbhs),
     m_height(0),
     m_pausers_count(0),
     m_threads_total(0),
@@ -238,6 +299,8 @@ namespace cryptonote
     command_line::add_arg(desc, arg_extra_messages);
     command_line::add_arg(desc, arg_start_mining);
     command_line::add_arg(desc, arg_mining_threads);
+    command_line::add_arg(desc, arg_randomx_dataset_file);
+    command_line::add_arg(desc, arg_mining_numa);
   }
   //-----------------------------------------------------------------------------------------------------
   bool miner::init(const boost::program_options::variables_map& vm, network_type nettype)
@@ -294,6 +357,18 @@ namespace cryptonote
       }
     }
 
+    if(command_line::has_arg(vm, arg_randomx_dataset_file))
+      rx_set_dataset_file(command_line::get_arg(vm, arg_randomx_dataset_file).c_str());
+
+    if (command_line::get_arg(vm, arg_mining_numa))
+    {
+      m_numa_nodes = numa_node_cpus();
+      if (m_numa_nodes.empty())
+        MWARNING("--" << arg_mining_numa.name << " given, but this system doesn't have multiple NUMA nodes; ignoring it");
+      else
+        MGINFO("Mining threads will be spread across " << m_numa_nodes.size() << " NUMA nodes");
+    }
+
     return true;
   }
   //-----------------------------------------------------------------------------------------------------
@@ -450,6 +525,14 @@ namespace cryptonote
     difficulty_type local_diff = 0;
     uint32_t local_template_ver = 0;
     block b;
+    if (!m_numa_nodes.empty())
+    {
+      const size_t node = th_local_index % m_numa_nodes.size();
+      if (pin_to_cpus(m_numa_nodes[node]))
+        rx_set_numa_node(node);
+      else
+        MWARNING("Couldn't pin miner thread " << th_local_index << " to NUMA node " << node);
+    }
     rx_slow_hash_allocate_state();
     bool call_stop = false;
 
@@ -488,13 +571,28 @@ namespace cryptonote
         break;
       }
 
-      b.nonce = nonce;
-      crypto::hash h;
-      m_gbh(b, height, slow_mining ? 0 : tools::get_max_concurrency(), h);
+      const uint32_t stride = m_threads_total;
+      std::array<uint32_t, MINING_BATCH> nonces;
+      std::array<crypto::hash, MINING_BATCH> hashes;
+      const unsigned int hash_threads = slow_mining ? 0 : tools::get_max_concurrency();
+      size_t batch = m_gbhs ? nonces.size() : 1;
+      for (size_t i = 0; i < batch; i++)
+        nonces[i] = nonce + i * stride;
+      if (m_gbhs)
+        m_gbhs(b, height, hash_threads, nonces.data(), hashes.data(), batch);
+      else
+      {
+        b.nonce = nonce;
+        m_gbh(b, height, hash_threads, hashes[0]);
+      }
 
-      if(check_hash(h, local_diff))
+      for (size_t i = 0; i < batch; i++)
       {
+        if(!check_hash(hashes[i], local_diff))
+          continue;
         //we lucky!
+        b.nonce = nonces[i];
+        b.invalidate_hashes();
         ++m_config.current_extra_message_index;
         MGINFO_GREEN("Found block " << get_block_hash(b) << " at height " << height << " for difficulty: " << local_diff);
         cryptonote::block_verification_context bvc;
@@ -504,11 +602,14 @@ namespace cryptonote
           //success update, lets update config
           if (std::string json; epee::serialization::store_t_to_json(m_config, json))
             tools::dump_file(m_config_dir / fs::u8path(MINER_CONFIG_FILE_NAME), json);
+        // The rest of the batch is for a stale template
+        batch = i + 1;
+        break;
       }
 
-      nonce+=m_threads_total;
-      ++m_hashes;
-      ++m_total_hashes;
+      nonce += batch * stride;
+      m_hashes += batch;
+      m_total_hashes += batch;
     }
     rx_slow_hash_free_state();
     MGINFO("Miner thread stopped ["<< th_local_index << "]");
@@ -57,6 +57,8 @@ namespace cryptonote
   };
 
   typedef std::function<bool(const cryptonote::block&, uint64_t, unsigned int, crypto::hash&)> get_block_hash_t;
+  // Hashes the block with each of `count` nonces (in place of its own), writing `count` hashes.
+  typedef std::function<bool(const cryptonote::block&, uint64_t, unsigned int, const uint32_t* nonces, crypto::hash* hashes, size_t count)> get_block_hashes_t;
 
   /************************************************************************/
   /*                                                                      */
@@ -64,7 +66,9 @@ namespace cryptonote
   class miner
   {
   public: 
-    miner(i_miner_handler* phandler, const get_block_hash_t& gbh);
+    // `gbhs`, if given, is used by the mining threads to hash several nonces at a time instead of
+    // calling `gbh` for each.
+    miner(i_miner_handler* phandler, const get_block_hash_t& gbh, const get_block_hashes_t& gbhs = nullptr);
     ~miner();
     bool init(const boost::program_options::variables_map& vm, network_type nettype);
     static void init_options(boost::program_options::options_description& desc);
@@ -118,6 +122,8 @@ namespace cryptonote
     std::mutex m_threads_lock;
     i_miner_handler* m_phandler;
     get_block_hash_t m_gbh;
+    get_block_hashes_t m_gbhs;
+    std::vector<std::vector<int>> m_numa_nodes; // CPUs of each NUMA node to spread threads over, if enabled
     account_public_address m_mine_address;
     tools::periodic_task m_update_block_template_interval{5s};
     tools::periodic_task m_update_merge_hr_interval{2s};
@@ -0,0 +1,226 @@
+#include "tx_view.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "common/varint.h"
+#include "cryptonote_basic.h"
+#include "cryptonote_format_utils.h"
+
+namespace cryptonote
+{
+
+namespace
+{
+  // Walks a blob the way binary_unarchiver reads it, but can skip over data without copying it.
+  struct reader
+  {
+    std::string_view blob;
+    size_t pos = 0;
+
+    size_t remaining() const { return blob.size() - pos; }
+
+    void require(size_t len) const
+    {
+      if (remaining() < len)
+        throw std::runtime_error{"deserialization failed: unexpected end of data"};
+    }
+
+    uint8_t byte()
+    {
+      require(1);
+      return static_cast<uint8_t>(blob[pos++]);
+    }
+
+    uint64_t varint()
+    {
+      uint64_t v;
+      auto it = blob.begin() + pos;
+      if (tools::read_varint(it, blob.end(), v) < 0)
+        throw std::runtime_error{"deserialization of varint failed"};
+      pos = it - blob.begin();
+      return v;
+    }
+
+    void skip(size_t len)
+    {
+      require(len);
+      pos += len;
+    }
+
+    // Skips `count` elements of `size` bytes each
+    void skip(uint64_t count, size_t size)
+    {
+      if (count > remaining() / size)
+        throw std::runtime_error{"deserialization failed: unexpected end of data"};
+      pos += count * size;
+    }
+
+    // A std::vector<uint8_t> (or other vector of bytes): a varint size, then the bytes
+    void skip_bytes() { skip(varint(), 1); }
+
+    template <typename T>
+    void read(T& val)
+    {
+      require(sizeof(T));
+      std::memcpy(&val, blob.data() + pos, sizeof(T));
+      pos += sizeof(T);
+    }
+  };
+
+  template <typename Enum>
+  Enum read_enum(reader& r, Enum end)
+  {
+    uint64_t v = r.varint();
+    if (v >= static_cast<uint64_t>(end))
+      throw std::out_of_range{"Invalid integer or enum value during deserialization"};
+    return static_cast<Enum>(v);
+  }
+}
+
+transaction_view::transaction_view(std::string_view blob) : m_blob{blob}
+{
+  // This must decode exactly as transaction::serialize() (via transaction_prefix's and
+  // rctSigBase's serializers) does; anything it doesn't need is skipped rather than checked.
+  reader r{blob};
+
+  version = read_enum(r, txversion::_count);
+  if (version < txversion::v1)
+    throw std::out_of_range{"Invalid integer or enum value during deserialization"};
+
+  uint64_t unlock_times = 0;
+  if (version >= txversion::v3_per_output_unlock_times)
+  {
+    unlock_times = r.varint();
+    for (uint64_t i = 0; i < unlock_times; ++i)
+      r.varint();
+    if (version == txversion::v3_per_output_unlock_times)
+      type = r.byte() ? txtype::state_change : txtype::standard;
+  }
+  unlock_time = r.varint();
+
+  vin_count = r.varint();
+  key_images.reserve(std::min<uint64_t>(vin_count, r.remaining() / sizeof(crypto::key_image)));
+  for (size_t i = 0; i < vin_count; ++i)
+  {
+    switch (r.byte())
+    {
+      case 0xff: // txin_gen
+        r.varint();
+        break;
+      case 0x0: // txin_to_script
+        r.skip(sizeof(crypto::hash));
+        r.varint();
+        r.skip_bytes();
+        break;
+      case 0x1: // txin_to_scripthash
+        r.skip(sizeof(crypto::hash));
+        r.varint();
+        r.skip(r.varint(), sizeof(crypto::public_key));
+        r.skip_bytes();
+        r.skip_bytes();
+        break;
+      case 0x2: // txin_to_key
+      {
+        r.varint();
+        for (uint64_t n = r.varint(); n > 0; --n)
+          r.varint();
+        r.read(key_images.emplace_back());
+        break;
+      }
+      default:
+        throw std::runtime_error{"failed to find appropriate variant type"};
+    }
+  }
+
+  vout_count = r.varint();
+  m_output_key_offsets.reserve(std::min<uint64_t>(vout_count, r.remaining()));
+  for (size_t i = 0; i < vout_count; ++i)
+  {
+    r.varint();
+    switch (r.byte())
+    {
+      case 0x0: // txout_to_script
+        m_output_key_offsets.push_back(0);
+        r.skip(r.varint(), sizeof(crypto::public_key));
+        r.skip_bytes();
+        break;
+      case 0x1: // txout_to_scripthash
+        m_output_key_offsets.push_back(0);
+        r.skip(sizeof(crypto::hash));
+        break;
+      case 0x2: // txout_to_key
+        m_output_key_offsets.push_back(r.pos);
+        r.skip(sizeof(crypto::public_key));
+        break;
+      default:
+        throw std::runtime_error{"failed to find appropriate variant type"};
+    }
+  }
+  if (version >= txversion::v3_per_output_unlock_times && vout_count != unlock_times)
+    throw std::invalid_argument{"v3 tx without correct unlock times"};
+
+  const uint64_t extra_size = r.varint();
+  m_extra_begin = r.pos;
+  r.skip(extra_size, 1);
+  m_extra_end = r.pos;
+
+  if (version >= txversion::v4_tx_types)
+    type = read_enum(r, txtype::_count);
+
+  m_prefix_end = m_base_end = r.pos;
+  if (version == txversion::v1 || vin_count == 0)
+    return;
+
+  rct_type = read_enum(r, static_cast<rct::RCTType>(static_cast<uint8_t>(rct::RCTType::CLSAG) + 1));
+  if (rct_type == rct::RCTType::Null)
+  {
+    m_base_end = r.pos;
+    return;
+  }
+  if (!tools::equals_any(rct_type, rct::RCTType::Full, rct::RCTType::Simple, rct::RCTType::Bulletproof, rct::RCTType::Bulletproof2, rct::RCTType::CLSAG))
+    throw std::invalid_argument{"invalid ringct type"};
+  rct_fee = r.varint();
+  if (rct_type == rct::RCTType::Simple)
+    r.skip(vin_count, sizeof(rct::key)); // pseudoOuts
+  if (tools::equals_any(rct_type, rct::RCTType::Bulletproof2, rct::RCTType::CLSAG))
+    r.skip(vout_count, sizeof(crypto::hash8)); // ecdhInfo, amount only
+  else
+    r.skip(vout_count, 2 * sizeof(rct::key)); // ecdhInfo
+  r.skip(vout_count, sizeof(rct::key)); // outPk
+  m_base_end = r.pos;
+}
+
+crypto::public_key transaction_view::output_key(size_t i) const
+{
+  crypto::public_key key = crypto::null_pkey;
+  if (i < m_output_key_offsets.size() && m_output_key_offsets[i])
+    std::memcpy(key.data, m_blob.data() + m_output_key_offsets[i], sizeof(key.data));
+  return key;
+}
+
+crypto::hash transaction_view::prefix_hash() const
+{
+  auto p = prefix();
+  return crypto::cn_fast_hash(p.data(), p.size());
+}
+
+bool transaction_view::materialise(transaction& tx) const
+{
+  return parse_and_validate_tx_from_blob(m_blob, tx);
+}
+
+bool parse_tx_view_from_blob(std::string_view blob, std::optional<transaction_view>& view)
+{
+  try {
+    view.emplace(blob);
+  } catch (const std::exception& e) {
+    LOG_ERROR("Failed to parse transaction view from blob: " << e.what());
+    view.reset();
+    return false;
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "ringct/rctTypes.h"
+#include "txtypes.h"
+
+namespace cryptonote
+{
+
+class transaction;
+
+// A read-only view of a serialized transaction that decodes only what the pool and the key image
+// checks look at: the fixed prefix fields, the key images, and where each section of the blob
+// starts, without materialising the inputs' key offsets, the outputs, the extra or any of the rct
+// data.  Use materialise() (i.e. parse_and_validate_tx_from_blob) for anything that needs the full
+// transaction, such as verifying signatures.
+//
+// The view points into the blob it was parsed from, which the caller must keep alive (and
+// unchanged) for as long as the view is used.
+class transaction_view
+{
+public:
+  txversion version = txversion::v1;
+  txtype type = txtype::standard;
+  uint64_t unlock_time = 0;
+  size_t vin_count = 0;
+  size_t vout_count = 0;
+  std::vector<crypto::key_image> key_images; // of the txin_to_key inputs, in input order
+  rct::RCTType rct_type = rct::RCTType::Null;
+  uint64_t rct_fee = 0;
+
+  // Parses the prefix and (for v2+) the rct base of `blob`, leaving the prunable part unchecked.
+  // Throws (std::runtime_error, std::invalid_argument or std::out_of_range, like the binary
+  // unarchiver) if those are malformed or truncated.
+  explicit transaction_view(std::string_view blob);
+
+  bool is_transfer() const { return type == txtype::standard || type == txtype::stake || type == txtype::oxen_name_system; }
+
+  // True if every input is a txin_to_key (so that key_images has one key image per input).
+  bool only_key_inputs() const { return key_images.size() == vin_count; }
+
+  // The output key of output `i`, or null_pkey if it isn't a txout_to_key.
+  crypto::public_key output_key(size_t i) const;
+
+  std::string_view blob() const { return m_blob; }
+  // The serialized transaction_prefix; cn_fast_hash of this is the tx prefix hash
+  std::string_view prefix() const { return m_blob.substr(0, m_prefix_end); }
+  std::string_view extra() const { return m_blob.substr(m_extra_begin, m_extra_end - m_extra_begin); }
+  // The rct base (type, fee, ecdh info and output commitments); empty for v1 txes
+  std::string_view rct_base() const { return m_blob.substr(m_prefix_end, m_base_end - m_prefix_end); }
+  // Everything after the unprunable part: the rct prunable data, or the signatures for v1 txes
+  std::string_view prunable() const { return m_blob.substr(m_base_end); }
+
+  crypto::hash prefix_hash() const;
+
+  // Fully parses the blob into `tx`; returns false (after logging why) if it fails to parse.
+  bool materialise(transaction& tx) const;
+
+private:
+  std::string_view m_blob;
+  size_t m_extra_begin = 0, m_extra_end = 0;
+  size_t m_prefix_end = 0;
+  size_t m_base_end = 0;
+  // Offset of each output's key in the blob, or 0 for outputs that aren't txout_to_key
+  std::vector<uint32_t> m_output_key_offsets;
+};
+
+// Wraps the transaction_view constructor, logging and returning false (rather than throwing) if the
+// blob can't be parsed.
+bool parse_tx_view_from_blob(std::string_view blob, std::optional<transaction_view>& view);
+
+}
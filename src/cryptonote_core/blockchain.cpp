@@ -32,6 +32,7 @@
 #include <algorithm>
 #include <chrono>
 #include <cstdio>
+#include <numeric>
 #include <boost/endian/conversion.hpp>
 
 #include "common/rules.h"
@@ -65,6 +66,7 @@
 #include "common/lock.h"
 #include "common/meta.h"
 #include "common/sha256sum.h"
+#include "common/scratch.h"
 
 #ifdef ENABLE_SYSTEMD
 extern "C" {
@@ -76,6 +78,7 @@ extern "C" {
 #define OXEN_DEFAULT_LOG_CATEGORY "blockchain"
 
 #define FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE (100*1024*1024) // 100 MB
+#define SERVED_BLOCKS_CACHE_MAX_SIZE (64*1024*1024) // 64 MB
 
 using namespace crypto;
 
@@ -96,6 +99,34 @@ DISABLE_VS_WARNINGS(4267)
 // used to overestimate the block reward when estimating a per kB to use
 #define BLOCK_REWARD_OVERESTIMATE (10 * 1000000000000)
 
+namespace {
+  // Digest of the ring members an rctSig was expanded with; used to make sure a precomputed ring
+  // signature result applies to exactly the same ring that check_tx_inputs resolved.
+  crypto::hash mix_ring_digest(const rct::rctSig &rv)
+  {
+    tools::scratch<std::vector<rct::ctkey>> flat_scratch;
+    auto& flat = *flat_scratch;
+    flat.clear();
+    for (const auto &ring : rv.mixRing)
+      flat.insert(flat.end(), ring.begin(), ring.end());
+    crypto::hash h;
+    crypto::cn_fast_hash(flat.data(), flat.size() * sizeof(rct::ctkey), h);
+    return h;
+  }
+
+  // The ring members of each input of a tx, as resolved from the db
+  using ring_members = std::vector<std::vector<rct::ctkey>>;
+
+  // Gives (reused, scratch) `rings` one empty ring per input, keeping the rings' allocations
+  ring_members& clear_rings(ring_members& rings, size_t inputs)
+  {
+    rings.resize(inputs);
+    for (auto& ring : rings)
+      ring.clear();
+    return rings;
+  }
+}
+
 Blockchain::block_extended_info::block_extended_info(const alt_block_data_t &src, block const &blk, checkpoint_t const *checkpoint)
 {
   assert((src.checkpointed) == (checkpoint != nullptr));
@@ -118,11 +149,25 @@ Blockchain::Blockchain(tx_memory_pool& tx_pool, service_nodes::service_node_list
   m_long_term_block_weights_cache_tip_hash(crypto::null_hash),
   m_long_term_block_weights_cache_rolling_median(CRYPTONOTE_LONG_TERM_BLOCK_WEIGHT_WINDOW_SIZE),
   m_service_node_list(service_node_list),
-  m_btc_valid(false),
+  m_served_blocks(SERVED_BLOCKS_CACHE_MAX_SIZE),
+  m_recent_outputs(0),
   m_batch_success(true),
   m_prepare_height(0)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
+  m_scan_table_budget = tools::cache_budget::add("scan_table", tools::cache_budget::priority::scan_table, [this](size_t) {
+    // The tables are in use for as long as a span is being handled (with the lock held throughout)
+    std::unique_lock lock{m_blockchain_lock, std::try_to_lock};
+    if (!lock)
+      return;
+    m_scan_table.release();
+    m_prefetched_rings.release();
+    update_scan_table_size();
+  });
+  m_recent_outputs_budget = tools::cache_budget::add("recent_outputs", tools::cache_budget::priority::recent_outputs, [this](size_t bytes) {
+    m_recent_outputs.drop_oldest((bytes + recent_outputs_cache::OUTPUT_BYTES - 1) / recent_outputs_cache::OUTPUT_BYTES);
+    update_recent_outputs_size();
+  });
 }
 //------------------------------------------------------------------
 Blockchain::~Blockchain()
@@ -151,11 +196,22 @@ bool Blockchain::have_tx_keyimg_as_spent(const crypto::key_image &key_im) const
   return  m_db->has_key_image(key_im);
 }
 //------------------------------------------------------------------
+void Blockchain::have_tx_keyimgs_as_spent(const std::vector<crypto::key_image> &key_images, std::vector<bool> &spent) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  // As have_tx_keyimg_as_spent, this doesn't take m_blockchain_lock
+  spent.clear();
+  spent.reserve(key_images.size());
+  db_rtxn_guard rtxn_guard(m_db);
+  for (const auto &key_im : key_images)
+    spent.push_back(m_db->has_key_image(key_im));
+}
+//------------------------------------------------------------------
 // This function makes sure that each "input" in an input (mixins) exists
 // and collects the public key for each from the transaction it was included in
 // via the visitor passed to it.
 template <class visitor_t>
-bool Blockchain::scan_outputkeys_for_indexes(const txin_to_key& tx_in_to_key, visitor_t &vis, const crypto::hash &tx_prefix_hash, uint64_t* pmax_related_block_height) const
+bool Blockchain::scan_outputkeys_for_indexes(const txin_to_key& tx_in_to_key, visitor_t &vis, epee::span<const output_data_t> prefetched, uint64_t* pmax_related_block_height) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
 
@@ -171,26 +227,26 @@ bool Blockchain::scan_outputkeys_for_indexes(const txin_to_key& tx_in_to_key, vi
   // #1 plus relative offset #2.
   // TODO: Investigate if this is necessary / why this is done.
   std::vector<uint64_t> absolute_offsets = relative_output_offsets_to_absolute(tx_in_to_key.key_offsets);
-  std::vector<output_data_t> outputs;
+  if (prefetched.size() > absolute_offsets.size())
+    prefetched = {};
 
-  bool found = false;
-  auto it = m_scan_table.find(tx_prefix_hash);
-  if (it != m_scan_table.end())
+  // look up whatever m_scan_table didn't already have
+  tools::scratch<std::vector<output_data_t>> outputs_scratch;
+  auto& outputs = *outputs_scratch;
+  outputs.clear();
+  if (prefetched.size() < absolute_offsets.size())
   {
-    auto its = it->second.find(tx_in_to_key.k_image);
-    if (its != it->second.end())
+    std::vector<uint64_t> add_offsets;
+    if (!prefetched.empty())
     {
-      outputs = its->second;
-      found = true;
+      MDEBUG("Additional outputs needed: " << absolute_offsets.size() - prefetched.size());
+      add_offsets.assign(absolute_offsets.begin() + prefetched.size(), absolute_offsets.end());
     }
-  }
-
-  if (!found)
-  {
     try
     {
-      m_db->get_output_key(epee::span<const uint64_t>(&tx_in_to_key.amount, 1), absolute_offsets, outputs, true);
-      if (absolute_offsets.size() != outputs.size())
+      m_db->get_output_key(epee::span<const uint64_t>(&tx_in_to_key.amount, 1),
+          prefetched.empty() ? absolute_offsets : add_offsets, outputs, true);
+      if (absolute_offsets.size() != prefetched.size() + outputs.size())
       {
         MERROR_VER("Output does not exist! amount = " << tx_in_to_key.amount);
         return false;
@@ -202,34 +258,6 @@ bool Blockchain::scan_outputkeys_for_indexes(const txin_to_key& tx_in_to_key, vi
       return false;
     }
   }
-  else
-  {
-    // check for partial results and add the rest if needed;
-    if (outputs.size() < absolute_offsets.size() && outputs.size() > 0)
-    {
-      MDEBUG("Additional outputs needed: " << absolute_offsets.size() - outputs.size());
-      std::vector < uint64_t > add_offsets;
-      std::vector<output_data_t> add_outputs;
-      add_outputs.reserve(absolute_offsets.size() - outputs.size());
-      for (size_t i = outputs.size(); i < absolute_offsets.size(); i++)
-        add_offsets.push_back(absolute_offsets[i]);
-      try
-      {
-        m_db->get_output_key(epee::span<const uint64_t>(&tx_in_to_key.amount, 1), add_offsets, add_outputs, true);
-        if (add_offsets.size() != add_outputs.size())
-        {
-          MERROR_VER("Output does not exist! amount = " << tx_in_to_key.amount);
-          return false;
-        }
-      }
-      catch (...)
-      {
-        MERROR_VER("Output does not exist! amount = " << tx_in_to_key.amount);
-        return false;
-      }
-      outputs.insert(outputs.end(), add_outputs.begin(), add_outputs.end());
-    }
-  }
 
   size_t count = 0;
   for (const uint64_t& i : absolute_offsets)
@@ -240,8 +268,10 @@ bool Blockchain::scan_outputkeys_for_indexes(const txin_to_key& tx_in_to_key, vi
       try
       {
         // get tx hash and output index for output
-        if (count < outputs.size())
-          output_index = outputs.at(count);
+        if (count < prefetched.size())
+          output_index = prefetched[count];
+        else if (count - prefetched.size() < outputs.size())
+          output_index = outputs[count - prefetched.size()];
         else
           output_index = m_db->get_output_key(tx_in_to_key.amount, i);
 
@@ -317,10 +347,45 @@ bool Blockchain::load_missing_blocks_into_oxen_subsystems()
   auto scan_start               = work_start;
   work_time ons_duration{}, snl_duration{}, ons_iteration_duration{}, snl_iteration_duration{};
 
-  std::vector<cryptonote::block> blocks;
-  std::vector<cryptonote::transaction> txs;
-  std::vector<crypto::hash> missed_txs;
+  // The service node list and ONS are independent of each other, so each batch of blocks is fed
+  // to ONS on the threadpool while the service node list processes it here, and the next batch is
+  // read from the db meanwhile.  The workers use the db directly because the blockchain lock is
+  // held by this thread.
+  struct replay_batch
+  {
+    std::vector<cryptonote::block> blocks;
+    std::vector<std::vector<cryptonote::transaction>> txs;
+  };
+  auto read_batch = [this, end_height](uint64_t height, replay_batch &batch) {
+    batch.blocks.clear();
+    batch.txs.clear();
+    try
+    {
+      for (uint64_t h = height; h < std::min(end_height, height + BLOCK_COUNT); h++)
+      {
+        batch.blocks.push_back(m_db->get_block_from_height(h));
+        batch.txs.push_back(m_db->get_tx_list(batch.blocks.back().tx_hashes));
+      }
+    }
+    catch (const std::exception &e)
+    {
+      LOG_ERROR("Unable to get checkpointed historical blocks for updating oxen subsystems: " << e.what());
+      return false;
+    }
+    return true;
+  };
 
+  replay_batch batch, next_batch;
+  if (!read_batch(start_height, batch))
+    return false;
+
+  // A long ONS replay (such as a rebuild) goes much faster in the ONS db's bulk loading mode
+  int64_t constexpr ONS_BULK_LOAD_MIN_BLOCKS = 10 * BLOCK_COUNT;
+  if (m_ons_db.db && static_cast<int64_t>(end_height) - static_cast<int64_t>(ons_height) >= ONS_BULK_LOAD_MIN_BLOCKS)
+    m_ons_db.begin_bulk_load();
+  OXEN_DEFER { if (m_ons_db.bulk_loading) m_ons_db.end_bulk_load(); };
+
+  tools::threadpool& tpool = tools::threadpool::getInstance();
   for (int64_t block_count = total_blocks,
                index       = 0;
        block_count > 0;
@@ -343,54 +408,57 @@ bool Blockchain::load_missing_blocks_into_oxen_subsystems()
       ons_iteration_duration = snl_iteration_duration = {};
     }
 
-    blocks.clear();
-    uint64_t height = start_height + (index * BLOCK_COUNT);
-    if (!get_blocks_only(height, static_cast<uint64_t>(BLOCK_COUNT), blocks))
+    bool next_ok = true, ons_ok = true, snl_ok = true;
+    tools::threadpool::waiter waiter;
+    if (block_count > BLOCK_COUNT)
+      tpool.submit(&waiter, [&, height = start_height + (index + 1) * BLOCK_COUNT] { next_ok = read_batch(height, next_batch); }, true);
+
+    if (m_ons_db.db && get_block_height(batch.blocks.back()) >= ons_height)
     {
-      LOG_ERROR("Unable to get checkpointed historical blocks for updating oxen subsystems");
-      return false;
+      tpool.submit(&waiter, [&] {
+        auto ons_start = clock::now();
+        for (size_t i = 0; i < batch.blocks.size() && ons_ok; i++)
+        {
+          cryptonote::block const &blk = batch.blocks[i];
+          if (get_block_height(blk) < ons_height)
+            continue;
+          if (!m_ons_db.add_block(blk, batch.txs[i]))
+          {
+            MFATAL("Unable to process block for updating ONS DB: " << cryptonote::get_block_hash(blk));
+            ons_ok = false;
+          }
+        }
+        ons_iteration_duration += clock::now() - ons_start;
+      }, true);
     }
 
-    for (cryptonote::block const &blk : blocks)
+    for (size_t i = 0; i < batch.blocks.size(); i++)
     {
+      cryptonote::block const &blk = batch.blocks[i];
       uint64_t block_height = get_block_height(blk);
+      if (block_height < snl_height)
+        continue;
 
-      txs.clear();
-      missed_txs.clear();
-      if (!get_transactions(blk.tx_hashes, txs, missed_txs))
-      {
-        MERROR("Unable to get transactions for block for updating ONS DB: " << cryptonote::get_block_hash(blk));
-        return false;
-      }
-
-      if (block_height >= snl_height)
-      {
-        auto snl_start = clock::now();
-
-        checkpoint_t *checkpoint_ptr = nullptr;
-        checkpoint_t checkpoint;
-        if (blk.major_version >= cryptonote::network_version_13_enforce_checkpoints && get_checkpoint(block_height, checkpoint))
-            checkpoint_ptr = &checkpoint;
+      auto snl_start = clock::now();
 
-        if (!m_service_node_list.block_added(blk, txs, checkpoint_ptr))
-        {
-          MFATAL("Unable to process block for updating service node list: " << cryptonote::get_block_hash(blk));
-          return false;
-        }
-        snl_iteration_duration += clock::now() - snl_start;
-      }
+      checkpoint_t *checkpoint_ptr = nullptr;
+      checkpoint_t checkpoint;
+      if (blk.major_version >= cryptonote::network_version_13_enforce_checkpoints && get_checkpoint(block_height, checkpoint))
+          checkpoint_ptr = &checkpoint;
 
-      if (m_ons_db.db && (block_height >= ons_height))
+      if (!m_service_node_list.block_added(blk, batch.txs[i], checkpoint_ptr))
       {
-        auto ons_start = clock::now();
-        if (!m_ons_db.add_block(blk, txs))
-        {
-          MFATAL("Unable to process block for updating ONS DB: " << cryptonote::get_block_hash(blk));
-          return false;
-        }
-        ons_iteration_duration += clock::now() - ons_start;
+        MFATAL("Unable to process block for updating service node list: " << cryptonote::get_block_hash(blk));
+        snl_ok = false;
+        break;
       }
+      snl_iteration_duration += clock::now() - snl_start;
     }
+
+    waiter.wait(&tpool);
+    if (!next_ok || !ons_ok || !snl_ok)
+      return false;
+    std::swap(batch, next_batch);
   }
 
   if (total_blocks > 1)
@@ -428,6 +496,7 @@ bool Blockchain::init(BlockchainDB* db, sqlite3 *ons_db, const network_type nett
   }
 
   m_db = db;
+  m_txpool_store.load(*m_db);
 
 #if defined(OXEN_ENABLE_INTEGRATION_TEST_HOOKS)
   // NOTE(doyle): Passing in test options in integration mode means we're
@@ -559,6 +628,8 @@ bool Blockchain::init(BlockchainDB* db, sqlite3 *ons_db, const network_type nett
     MFATAL("ONS failed to initialise");
     return false;
   }
+  if (m_db_sync_mode == db_group)
+    m_ons_db.set_auto_checkpoint(false);
 
   hook_block_added(m_checkpoints);
   hook_blockchain_detached(m_checkpoints);
@@ -571,6 +642,15 @@ bool Blockchain::init(BlockchainDB* db, sqlite3 *ons_db, const network_type nett
     return false;
   }
 
+  if (const size_t max_outputs = m_recent_outputs.max_outputs())
+  {
+    db_rtxn_guard rtxn_guard(m_db);
+    const uint64_t num_outputs = m_db->get_num_outputs(0);
+    cache_recent_outputs(num_outputs > max_outputs ? num_outputs - max_outputs : 0);
+    MINFO("Cached the last " << m_recent_outputs.size() << " RCT outputs");
+  }
+
+  publish_chain_tip_snapshot();
   return true;
 }
 //------------------------------------------------------------------
@@ -611,10 +691,14 @@ bool Blockchain::deinit()
   MTRACE("Stopping blockchain read/write activity");
 
  // stop async service
+  m_async_service.post([this] { m_group_sync_timer.cancel(); m_group_sync_armed = false; });
   m_async_work_idle.reset();
   m_async_thread.join();
   m_async_service.stop();
 
+  // don't leave PoW lookahead work referencing us in the threadpool
+  m_blocks_longhash_lookahead_waiter.wait(nullptr);
+
   // as this should be called if handling a SIGSEGV, need to check
   // if m_db is a NULL pointer (and thus may have caused the illegal
   // memory operation), otherwise we may cause a loop.
@@ -622,6 +706,7 @@ bool Blockchain::deinit()
   {
     if (m_db)
     {
+      flush_txpool();
       m_db->close();
       MTRACE("Local blockchain read/write activity stopped successfully");
     }
@@ -685,6 +770,8 @@ void Blockchain::pop_blocks(uint64_t nblocks)
 
   if (stop_batch)
     m_db->batch_stop();
+  publish_chain_tip_snapshot();
+  m_async_service.post([this] { m_tx_pool.revalidate(); });
 }
 //------------------------------------------------------------------
 // This function tells BlockchainDB to remove the top block from the
@@ -695,7 +782,7 @@ block Blockchain::pop_block_from_blockchain()
   LOG_PRINT_L3("Blockchain::" << __func__);
   std::unique_lock lock{*this};
 
-  m_cache.m_timestamps_and_difficulties_height = 0;
+  m_served_blocks.clear();
 
   block popped_block;
   std::vector<transaction> popped_txs;
@@ -705,6 +792,8 @@ block Blockchain::pop_block_from_blockchain()
   try
   {
     m_db->pop_block(popped_block, popped_txs);
+    truncate_recent_outputs();
+    truncate_governance_sums(m_db->height());
   }
   // anything that could cause this to throw is likely catastrophic,
   // so we re-throw
@@ -720,6 +809,7 @@ block Blockchain::pop_block_from_blockchain()
   }
 
   m_ons_db.block_detach(*this, m_db->height());
+  difficulty_window_block_popped(m_db->height());
 
   // return transactions from popped block to the tx_pool
   size_t pruned = 0;
@@ -753,22 +843,112 @@ block Blockchain::pop_block_from_blockchain()
 
   m_blocks_longhash_table.clear();
   m_scan_table.clear();
+  m_prefetched_rings.clear();
+  m_rct_ver_table.clear();
+  m_rct_semantics_verified.clear();
   m_blocks_txs_check.clear();
 
   CHECK_AND_ASSERT_THROW_MES(update_next_cumulative_weight_limit(), "Error updating next cumulative weight limit");
+  static auto& blocks_popped = tools::metrics::get_counter("main_chain_blocks_popped", OXEN_DEFAULT_LOG_CATEGORY);
+  blocks_popped.inc();
   m_tx_pool.on_blockchain_dec();
   invalidate_block_template_cache();
   return popped_block;
 }
 //------------------------------------------------------------------
+void Blockchain::pop_blocks_to_height(uint64_t height, std::list<block_and_checkpoint>* disconnected)
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  std::unique_lock lock{*this};
+
+  CHECK_AND_ASSERT_THROW_MES(height >= 1, "Cannot pop the genesis block");
+  if (m_db->height() <= height)
+    return;
+
+  m_served_blocks.clear();
+
+  // Popped txes, oldest block first, to be returned to the pool together
+  std::vector<transaction> returned_txs;
+  uint64_t popped = 0;
+  bool stop_batch = m_db->batch_start();
+  try
+  {
+    while (m_db->height() > height)
+    {
+      block_and_checkpoint entry = {};
+      std::vector<transaction> popped_txs;
+      m_db->pop_block(entry.block, popped_txs);
+      truncate_recent_outputs();
+      truncate_governance_sums(m_db->height());
+      difficulty_window_block_popped(m_db->height());
+      if (disconnected)
+      {
+        entry.checkpointed = m_db->get_block_checkpoint(cryptonote::get_block_height(entry.block), entry.checkpoint);
+        disconnected->push_front(std::move(entry));
+      }
+      returned_txs.insert(returned_txs.begin(), std::make_move_iterator(popped_txs.begin()), std::make_move_iterator(popped_txs.end()));
+      popped++;
+    }
+  }
+  // anything that could cause this to throw is likely catastrophic,
+  // so we re-throw
+  catch (const std::exception& e)
+  {
+    LOG_ERROR("Error popping blocks from blockchain: " << e.what());
+    if (stop_batch)
+      m_db->batch_abort();
+    throw;
+  }
+  if (stop_batch)
+    m_db->batch_stop();
+
+  m_ons_db.block_detach(*this, m_db->height());
+
+  size_t pruned = 0;
+  uint8_t const version = get_network_version(m_db->height());
+  for (transaction& tx : returned_txs)
+  {
+    if (tx.pruned)
+    {
+      ++pruned;
+      continue;
+    }
+    if (is_coinbase(tx))
+      continue;
+    // As in pop_block_from_blockchain(), these were already relayed when they got mined
+    cryptonote::tx_verification_context tvc{};
+    if (!m_tx_pool.add_tx(tx, tvc, tx_pool_options::from_block(), version))
+      LOG_ERROR("Error returning transaction to tx_pool");
+  }
+  if (pruned)
+    MWARNING(pruned << " pruned txes could not be added back to the txpool");
+
+  m_blocks_longhash_table.clear();
+  m_scan_table.clear();
+  m_prefetched_rings.clear();
+  m_blocks_txs_check.clear();
+
+  CHECK_AND_ASSERT_THROW_MES(update_next_cumulative_weight_limit(), "Error updating next cumulative weight limit");
+  static auto& blocks_popped = tools::metrics::get_counter("main_chain_blocks_popped", OXEN_DEFAULT_LOG_CATEGORY);
+  blocks_popped.inc(popped);
+  m_tx_pool.on_blockchain_dec();
+  invalidate_block_template_cache();
+}
+//------------------------------------------------------------------
 bool Blockchain::reset_and_set_genesis_block(const block& b)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   std::unique_lock lock{*this};
   m_cache.m_timestamps_and_difficulties_height = 0;
+  m_served_blocks.clear();
+  m_recent_outputs.clear();
+  update_recent_outputs_size();
+  m_governance_sums.clear();
   invalidate_block_template_cache();
   m_db->reset();
+  m_txpool_store.clear();
   m_db->drop_alt_blocks();
+  m_alt_blocks_cache.clear();
 
   for (InitHook* hook : m_init_hooks)
     hook->init();
@@ -948,14 +1128,17 @@ difficulty_type Blockchain::get_difficulty_for_next_block(bool pulse)
   top_hash                  = get_tail_id(top_block_height); // get it again now that we have the lock
   uint64_t chain_height     = top_block_height + 1;
 
-  m_db->fill_timestamps_and_difficulties_for_pow(
-      m_nettype, m_cache.m_timestamps, m_cache.m_difficulties, chain_height, m_cache.m_timestamps_and_difficulties_height);
-  uint64_t diff = next_difficulty_v2(m_cache.m_timestamps,
-                                     m_cache.m_difficulties,
-                                     tools::to_seconds(TARGET_BLOCK_TIME),
-                                     difficulty_mode(m_nettype, chain_height));
-
-  m_cache.m_timestamps_and_difficulties_height = chain_height;
+  if (m_cache.m_timestamps_and_difficulties_height != chain_height)
+  {
+    // Normally kept up to date as blocks are added and popped, so this only happens on startup or
+    // after the chain changed underneath us.
+    bool const before_hf16   = !is_hard_fork_at_least(m_nettype, network_version_16_pulse, chain_height);
+    uint64_t const start     = std::max<uint64_t>(chain_height - std::min<uint64_t>(chain_height, DIFFICULTY_BLOCKS_COUNT(before_hf16)), 1);
+    m_cache.m_difficulty_window = get_difficulty_window(start, chain_height);
+    m_cache.m_timestamps_and_difficulties_height = chain_height;
+  }
+  uint64_t diff = m_cache.m_difficulty_window.next_difficulty(tools::to_seconds(TARGET_BLOCK_TIME),
+                                                              difficulty_mode(m_nettype, chain_height));
 
   std::unique_lock diff_lock{m_cache.m_difficulty_lock};
   m_cache.m_difficulty_for_next_block_top_hash = top_hash;
@@ -963,15 +1146,70 @@ difficulty_type Blockchain::get_difficulty_for_next_block(bool pulse)
   return diff;
 }
 //------------------------------------------------------------------
+difficulty_window Blockchain::get_difficulty_window(uint64_t start_height, uint64_t stop_height) const
+{
+  difficulty_window window;
+  if (stop_height <= start_height)
+    return window;
+  start_height = std::max(start_height, stop_height - std::min<uint64_t>(stop_height, difficulty_window::CAPACITY));
+
+  uint64_t const cached_height = m_cache.m_timestamps_and_difficulties_height;
+  if (cached_height && stop_height <= cached_height && stop_height > cached_height - m_cache.m_difficulty_window.size())
+  {
+    // Fork the cached window at stop_height, then extend it back to start_height from the DB
+    window = m_cache.m_difficulty_window;
+    for (uint64_t h = cached_height; h > stop_height; h--)
+      window.pop_back();
+    for (uint64_t h = stop_height - window.size(); h > start_height; h--)
+      window.push_front(m_db->get_block_timestamp(h - 1), m_db->get_block_cumulative_difficulty(h - 1));
+    window.trim(stop_height - start_height);
+    return window;
+  }
+
+  auto timestamps   = m_db->get_block_timestamps(start_height, stop_height - start_height);
+  auto difficulties = m_db->get_block_cumulative_difficulties(start_height, stop_height - start_height);
+  for (size_t i = 0; i < timestamps.size() && i < difficulties.size(); i++)
+    window.push_back(timestamps[i], difficulties[i]);
+  return window;
+}
+//------------------------------------------------------------------
+void Blockchain::difficulty_window_block_added(uint64_t timestamp, difficulty_type cumulative_difficulty, uint64_t chain_height)
+{
+  if (m_cache.m_timestamps_and_difficulties_height + 1 != chain_height || chain_height < 2)
+  {
+    m_cache.m_timestamps_and_difficulties_height = 0;
+    return;
+  }
+  add_timestamp_and_difficulty(m_nettype, chain_height, m_cache.m_difficulty_window, timestamp, cumulative_difficulty);
+  m_cache.m_timestamps_and_difficulties_height = chain_height;
+}
+//------------------------------------------------------------------
+void Blockchain::difficulty_window_block_popped(uint64_t chain_height)
+{
+  if (m_cache.m_timestamps_and_difficulties_height != chain_height + 1)
+  {
+    m_cache.m_timestamps_and_difficulties_height = 0;
+    return;
+  }
+  auto& window = m_cache.m_difficulty_window;
+  window.pop_back();
+  // The window now ends at the new top block; refill its oldest end as far as this height wants.
+  bool const before_hf16 = !is_hard_fork_at_least(m_nettype, network_version_16_pulse, chain_height);
+  uint64_t const count   = DIFFICULTY_BLOCKS_COUNT(before_hf16);
+  uint64_t const start   = std::max<uint64_t>(chain_height - std::min<uint64_t>(chain_height, count), 1);
+  for (uint64_t h = chain_height - std::min<uint64_t>(chain_height, window.size()); h > start; h--)
+    window.push_front(m_db->get_block_timestamp(h - 1), m_db->get_block_cumulative_difficulty(h - 1));
+  window.trim(count);
+  m_cache.m_timestamps_and_difficulties_height = chain_height;
+}
+//------------------------------------------------------------------
 std::vector<time_t> Blockchain::get_last_block_timestamps(unsigned int blocks) const
 {
   uint64_t height = m_db->height();
   if (blocks > height)
     blocks = height;
-  std::vector<time_t> timestamps(blocks);
-  while (blocks--)
-    timestamps[blocks] = m_db->get_block_timestamp(height - blocks - 1);
-  return timestamps;
+  auto db_timestamps = m_db->get_block_timestamps(height - blocks, blocks);
+  return std::vector<time_t>(db_timestamps.begin(), db_timestamps.end());
 }
 //------------------------------------------------------------------
 // This function removes blocks from the blockchain until it gets to the
@@ -988,13 +1226,8 @@ bool Blockchain::rollback_blockchain_switching(const std::list<block_and_checkpo
     return true;
   }
 
-  m_cache.m_timestamps_and_difficulties_height = 0;
-
   // remove blocks from blockchain until we get back to where we should be.
-  while (m_db->height() != rollback_height)
-  {
-    pop_block_from_blockchain();
-  }
+  pop_blocks_to_height(rollback_height);
 
   // Revert all changes from switching to the alt chain before adding the original chain back in
   for (BlockchainDetachedHook* hook : m_blockchain_detached_hooks)
@@ -1025,6 +1258,7 @@ bool Blockchain::blink_rollback(uint64_t rollback_height)
   bool ret = rollback_blockchain_switching({}, rollback_height);
   if (stop_batch)
     m_db->batch_stop();
+  m_async_service.post([this] { m_tx_pool.revalidate(); });
   return ret;
 }
 //------------------------------------------------------------------
@@ -1035,8 +1269,6 @@ bool Blockchain::switch_to_alternative_blockchain(const std::list<block_extended
   LOG_PRINT_L3("Blockchain::" << __func__);
   std::unique_lock lock{*this};
 
-  m_cache.m_timestamps_and_difficulties_height = 0;
-
   // if empty alt chain passed (not sure how that could happen), return false
   CHECK_AND_ASSERT_MES(alt_chain.size(), false, "switch_to_alternative_blockchain: empty chain passed");
 
@@ -1050,19 +1282,32 @@ bool Blockchain::switch_to_alternative_blockchain(const std::list<block_extended
   // pop blocks from the blockchain until the top block is the parent
   // of the front block of the alt chain.
   std::list<block_and_checkpoint> disconnected_chain; // TODO(oxen): use a vector and rbegin(), rend() because we don't have push_front
-  while (m_db->top_block_hash() != alt_chain.front().bl.prev_id)
-  {
-    block_and_checkpoint entry = {};
-    entry.block                = pop_block_from_blockchain();
-    entry.checkpointed         = m_db->get_block_checkpoint(cryptonote::get_block_height(entry.block), entry.checkpoint);
-    disconnected_chain.push_front(entry);
-  }
+  pop_blocks_to_height(m_db->get_block_height(alt_chain.front().bl.prev_id) + 1, &disconnected_chain);
 
   auto split_height = m_db->height();
   for (BlockchainDetachedHook* hook : m_blockchain_detached_hooks)
     hook->blockchain_detached(split_height, false /*by_pop_blocks*/);
   load_missing_blocks_into_oxen_subsystems();
 
+  // Verify the ring signatures of the alt chain's txes (which are in the pool) together across the
+  // threadpool, for check_tx_inputs to pick up as each alt block gets added, rather than one tx at a
+  // time.  Txes spending outputs of earlier alt blocks can't be resolved yet and are left out.
+  {
+    std::vector<blobdata> alt_tx_blobs;
+    for (const auto &bei : alt_chain)
+      for (const auto &txid : bei.bl.tx_hashes)
+        if (blobdata blob; m_tx_pool.get_transaction(txid, blob))
+          alt_tx_blobs.push_back(std::move(blob));
+    if (!alt_tx_blobs.empty())
+    {
+      std::vector<const blobdata*> blobs;
+      blobs.reserve(alt_tx_blobs.size());
+      for (const auto &blob : alt_tx_blobs)
+        blobs.push_back(&blob);
+      add_ring_signature_results(verify_ring_signatures(blobs));
+    }
+  }
+
   //connecting new alternative chain
   for(auto alt_ch_iter = alt_chain.begin(); alt_ch_iter != alt_chain.end(); alt_ch_iter++)
   {
@@ -1085,14 +1330,14 @@ bool Blockchain::switch_to_alternative_blockchain(const std::list<block_extended
       const crypto::hash blkid = cryptonote::get_block_hash(bei.bl);
       add_block_as_invalid(bei.bl);
       MERROR("The block was inserted as invalid while connecting new alternative chain, block_id: " << blkid);
-      m_db->remove_alt_block(blkid);
+      remove_alt_block(blkid);
       alt_ch_iter++;
 
       for(auto alt_ch_to_orph_iter = alt_ch_iter; alt_ch_to_orph_iter != alt_chain.end(); )
       {
         const auto &bei = *alt_ch_to_orph_iter++;
         add_block_as_invalid(bei.bl);
-        m_db->remove_alt_block(blkid);
+        remove_alt_block(cryptonote::get_block_hash(bei.bl));
       }
       return false;
     }
@@ -1116,22 +1361,23 @@ bool Blockchain::switch_to_alternative_blockchain(const std::list<block_extended
   //removing alt_chain entries from alternative chains container
   for (const auto &bei: alt_chain)
   {
-    m_db->remove_alt_block(cryptonote::get_block_hash(bei.bl));
+    remove_alt_block(cryptonote::get_block_hash(bei.bl));
   }
 
   get_block_longhash_reorg(split_height);
 
-  std::shared_ptr<tools::Notify> reorg_notify = m_reorg_notify;
+  std::shared_ptr<tools::AsyncNotify> reorg_notify = m_reorg_notify;
   if (reorg_notify)
-    reorg_notify->notify("%s", std::to_string(split_height).c_str(), "%h", std::to_string(m_db->height()).c_str(),
-        "%n", std::to_string(m_db->height() - split_height).c_str(), NULL);
+    reorg_notify->notify({{"%s", std::to_string(split_height)}, {"%h", std::to_string(m_db->height())},
+        {"%n", std::to_string(m_db->height() - split_height)}});
 
-  std::shared_ptr<tools::Notify> block_notify = m_block_notify;
+  std::shared_ptr<tools::AsyncNotify> block_notify = m_block_notify;
   if (block_notify)
     for (const auto &bei: alt_chain)
-      block_notify->notify("%s", tools::type_to_hex(get_block_hash(bei.bl)).c_str(), NULL);
+      block_notify->notify({{"%s", tools::type_to_hex(get_block_hash(bei.bl))}});
 
   MGINFO_GREEN("REORGANIZE SUCCESS! on height: " << split_height << ", new blockchain size: " << m_db->height());
+  m_async_service.post([this] { m_tx_pool.revalidate(); });
   return true;
 }
 //------------------------------------------------------------------
@@ -1160,8 +1406,7 @@ difficulty_type Blockchain::get_difficulty_for_alternative_chain(const std::list
     block_count = DIFFICULTY_BLOCKS_COUNT(before_hf16);
   }
 
-  std::vector<uint64_t> timestamps;
-  std::vector<difficulty_type> cumulative_difficulties;
+  difficulty_window window;
   // if the alt chain isn't long enough to calculate the difficulty target
   // based on its blocks alone, need to get more blocks from the main chain
   if(alt_chain.size() < block_count)
@@ -1177,48 +1422,30 @@ difficulty_type Blockchain::get_difficulty_for_alternative_chain(const std::list
     if(!main_chain_start_offset)
       ++main_chain_start_offset; //skip genesis block
 
-    // get difficulties and timestamps from relevant main chain blocks
-    for(; main_chain_start_offset < main_chain_stop_offset; ++main_chain_start_offset)
-    {
-      timestamps.push_back(m_db->get_block_timestamp(main_chain_start_offset));
-      cumulative_difficulties.push_back(m_db->get_block_cumulative_difficulty(main_chain_start_offset));
-    }
+    // get difficulties and timestamps from relevant main chain blocks, forking the cached main
+    // chain window when the alt chain branches off near the top
+    window = get_difficulty_window(main_chain_start_offset, main_chain_stop_offset);
 
     // make sure we haven't accidentally grabbed too many blocks...maybe don't need this check?
-    CHECK_AND_ASSERT_MES((alt_chain.size() + timestamps.size()) <= block_count, false, "Internal error, alt_chain.size()[" << alt_chain.size() << "] + vtimestampsec.size()[" << timestamps.size() << "] NOT <= DIFFICULTY_WINDOW[]" << block_count);
+    CHECK_AND_ASSERT_MES((alt_chain.size() + window.size()) <= block_count, false, "Internal error, alt_chain.size()[" << alt_chain.size() << "] + window.size()[" << window.size() << "] NOT <= DIFFICULTY_WINDOW[]" << block_count);
 
     for (const auto &bei : alt_chain)
-    {
-      timestamps.push_back(bei.bl.timestamp);
-      cumulative_difficulties.push_back(bei.cumulative_difficulty);
-    }
+      window.push_back(bei.bl.timestamp, bei.cumulative_difficulty);
   }
   // if the alt chain is long enough for the difficulty calc, grab difficulties
   // and timestamps from it alone
   else
   {
-    timestamps.resize(static_cast<size_t>(block_count));
-    cumulative_difficulties.resize(static_cast<size_t>(block_count));
-    size_t count = 0;
-    size_t max_i = timestamps.size()-1;
     // get difficulties and timestamps from most recent blocks in alt chain
-    for (auto it = alt_chain.rbegin(); it != alt_chain.rend(); ++it)
-    {
-      const auto& bei = *it;
-      timestamps[max_i - count] = bei.bl.timestamp;
-      cumulative_difficulties[max_i - count] = bei.cumulative_difficulty;
-      count++;
-      if(count >= block_count)
-        break;
-    }
+    auto it = alt_chain.end();
+    std::advance(it, -static_cast<ptrdiff_t>(block_count));
+    for (; it != alt_chain.end(); ++it)
+      window.push_back(it->bl.timestamp, it->cumulative_difficulty);
   }
 
   // calculate the difficulty target for the block and return it
   uint64_t height = (alt_chain.size() ? alt_chain.front().height : alt_block_height) + alt_chain.size() + 1;
-  return next_difficulty_v2(timestamps,
-                            cumulative_difficulties,
-                            tools::to_seconds(TARGET_BLOCK_TIME),
-                            difficulty_mode(m_nettype, height));
+  return window.next_difficulty(tools::to_seconds(TARGET_BLOCK_TIME), difficulty_mode(m_nettype, height));
 }
 //------------------------------------------------------------------
 // This function does a sanity check on basic things that all miner
@@ -1445,7 +1672,7 @@ uint64_t Blockchain::get_current_cumulative_block_weight_median() const
 //      unchanged for the time being.
 //
 // This function makes a new block for a miner to mine the hash for
-bool Blockchain::create_block_template_internal(block& b, const crypto::hash *from_block, const block_template_info& info, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce)
+bool Blockchain::create_block_template_internal(block& b, const crypto::hash *from_block, const block_template_info& info, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce, block_template_blobs* blobs)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   size_t median_weight;
@@ -1453,26 +1680,43 @@ bool Blockchain::create_block_template_internal(block& b, const crypto::hash *fr
   uint64_t pool_cookie;
 
   auto lock = tools::unique_locks(m_tx_pool, *this);
-  if (m_btc_valid && !from_block)
+  // Only miner templates are cached: a pulse template's payout depends on the round's producer.
+  if (!m_btc.empty() && !from_block && info.is_miner)
   {
     // The pool cookie is atomic. The lack of locking is OK, as if it changes
     // just as we compare it, we'll just use a slightly old template, but
     // this would be the case anyway if we'd lock, and the change happened
     // just after the block template was created
-    if (info.miner_address != m_btc_address && m_btc_nonce == ex_nonce
-      && m_btc_pool_cookie == m_tx_pool.cookie() && m_btc.prev_id == get_tail_id()) {
-      MDEBUG("Using cached template");
-      const uint64_t now = time(NULL);
-      if (m_btc.timestamp < now /*ensures it can't get below the median of the last few blocks*/ || !info.is_miner)
-        m_btc.timestamp = now;
-      b = m_btc;
-      diffic = get_difficulty_for_next_block(!info.is_miner);
-      height = m_btc_height;
-      expected_reward = m_btc_expected_reward;
-      return true;
+    if (m_btc_pool_cookie == m_tx_pool.cookie() && m_btc.back().b.prev_id == get_tail_id())
+    {
+      auto it = std::find_if(m_btc.begin(), m_btc.end(), [&](const cached_block_template& t) {
+        return t.address == info.miner_address && t.nonce == ex_nonce;
+      });
+      if (it != m_btc.end())
+      {
+        MDEBUG("Using cached template");
+        std::rotate(it, it + 1, m_btc.end());
+        auto& t = m_btc.back();
+        const uint64_t now = time(NULL);
+        if (t.b.timestamp < now) // ensures it can't get below the median of the last few blocks
+        {
+          t.b.timestamp = now;
+          t.b.invalidate_hashes();
+        }
+        b = t.b;
+        diffic = get_difficulty_for_next_block(!info.is_miner);
+        height = t.height;
+        expected_reward = t.expected_reward;
+        if (blobs)
+          get_block_template_blobs(t, *blobs);
+        return true;
+      }
+    }
+    else
+    {
+      MDEBUG("Not using cached templates: cookie " << (m_btc_pool_cookie == m_tx_pool.cookie()) << ", tail " << (m_btc.back().b.prev_id == get_tail_id()));
+      invalidate_block_template_cache();
     }
-    MDEBUG("Not using cached template: address " << (bool)(info.miner_address != m_btc_address) << ", nonce " << (m_btc_nonce == ex_nonce) << ", cookie " << (m_btc_pool_cookie == m_tx_pool.cookie()) << ", from_block " << (!!from_block));
-    invalidate_block_template_cache();
   }
 
   if (from_block)
@@ -1480,8 +1724,8 @@ bool Blockchain::create_block_template_internal(block& b, const crypto::hash *fr
     //build alternative subchain, front -> mainchain, back -> alternative head
     //block is not related with head of main chain
     //first of all - look in alternative chains container
-    alt_block_data_t prev_data;
-    bool parent_in_alt = m_db->get_alt_block(*from_block, &prev_data, NULL, nullptr /*checkpoint*/);
+    auto const prev_alt = get_alt_block(*from_block);
+    bool parent_in_alt = prev_alt != nullptr;
     bool parent_in_main = m_db->block_exists(*from_block);
     if (!parent_in_alt && !parent_in_main)
     {
@@ -1521,14 +1765,14 @@ bool Blockchain::create_block_template_internal(block& b, const crypto::hash *fr
     }
     else
     {
-      median_weight = prev_data.cumulative_weight - prev_data.cumulative_weight / 20;
+      median_weight = prev_alt->block_cumulative_weight - prev_alt->block_cumulative_weight / 20;
       already_generated_coins = alt_chain.back().already_generated_coins;
     }
 
     // FIXME: consider moving away from block_extended_info at some point
     block_extended_info bei{};
     bei.bl = b;
-    bei.height = alt_chain.size() ? prev_data.height + 1 : m_db->get_block_height(*from_block) + 1;
+    bei.height = alt_chain.size() ? prev_alt->height + 1 : m_db->get_block_height(*from_block) + 1;
 
     diffic = get_difficulty_for_alternative_chain(alt_chain, bei.height, !info.is_miner);
   }
@@ -1614,20 +1858,29 @@ bool Blockchain::create_block_template_internal(block& b, const crypto::hash *fr
     }
     CHECK_AND_ASSERT_MES(cumulative_weight == txs_weight + get_transaction_weight(b.miner_tx), false, "unexpected case: cumulative_weight=" << cumulative_weight << " is not equal txs_cumulative_weight=" << txs_weight << " + get_transaction_weight(b.miner_tx)=" << get_transaction_weight(b.miner_tx));
 
-    if (!from_block)
-      cache_block_template(b, info.miner_address, ex_nonce, diffic, height, expected_reward, pool_cookie);
+    if (!from_block && info.is_miner)
+    {
+      auto& t = cache_block_template(b, info.miner_address, ex_nonce, height, expected_reward, pool_cookie);
+      if (blobs)
+        get_block_template_blobs(t, *blobs);
+    }
+    else if (blobs)
+    {
+      blobs->block_blob = t_serializable_object_to_blob(b);
+      blobs->hashing_blob = get_block_hashing_blob(b);
+    }
     return true;
   }
   LOG_ERROR("Failed to create_block_template with " << 10 << " tries");
   return false;
 }
 //------------------------------------------------------------------
-bool Blockchain::create_miner_block_template(block& b, const crypto::hash *from_block, const account_public_address& miner_address, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce)
+bool Blockchain::create_miner_block_template(block& b, const crypto::hash *from_block, const account_public_address& miner_address, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce, block_template_blobs* blobs)
 {
   block_template_info info = {};
   info.is_miner            = true;
   info.miner_address       = miner_address;
-  return create_block_template_internal(b, from_block, info, diffic, height, expected_reward, ex_nonce);
+  return create_block_template_internal(b, from_block, info, diffic, height, expected_reward, ex_nonce, blobs);
 }
 //------------------------------------------------------------------
 bool Blockchain::create_next_miner_block_template(block& b, const account_public_address& miner_address, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce)
@@ -1679,25 +1932,15 @@ bool Blockchain::build_alt_chain(const crypto::hash &prev_id,
                                  int *num_checkpoints)
 {
     //build alternative subchain, front -> mainchain, back -> alternative head
-    cryptonote::alt_block_data_t data;
-    cryptonote::blobdata blob;
     timestamps.clear();
 
     int alt_checkpoint_count = 0;
     int checkpoint_count     = 0;
-    crypto::hash prev_hash = crypto::null_hash;
-    block_extended_info bei = {};
-    blobdata checkpoint_blob;
-    for(bool found = m_db->get_alt_block(prev_id, &data, &blob, &checkpoint_blob);
-        found;
-        found = m_db->get_alt_block(prev_hash, &data, &blob, &checkpoint_blob))
-    {
-      CHECK_AND_ASSERT_MES(cryptonote::parse_and_validate_block_from_blob(blob, bei.bl), false, "Failed to parse alt block");
-      if (data.checkpointed) // Take checkpoint from blob stored alongside alt block
-      {
-        CHECK_AND_ASSERT_MES(t_serializable_object_from_blob(bei.checkpoint, checkpoint_blob), false, "Failed to parse alt checkpoint from blob");
+    for (auto cached = get_alt_block(prev_id); cached; cached = get_alt_block(cached->bl.prev_id))
+    {
+      block_extended_info bei = *cached;
+      if (bei.checkpointed) // Take checkpoint from blob stored alongside alt block
         alt_checkpoint_count++;
-      }
 
       // NOTE: If we receive or pre-define a checkpoint for a historical block
       // that conflicts with current blocks on the blockchain, upon receipt of
@@ -1708,16 +1951,16 @@ bool Blockchain::build_alt_chain(const crypto::hash &prev_id,
       // Which can form checkpoints retrospectively, that may conflict with
       // your canonical chain.
       bool height_is_checkpointed = false;
-      bool alt_block_matches_checkpoint = m_checkpoints.check_block(data.height, get_block_hash(bei.bl), &height_is_checkpointed, nullptr);
+      bool alt_block_matches_checkpoint = m_checkpoints.check_block(bei.height, get_block_hash(bei.bl), &height_is_checkpointed, nullptr);
 
       if (height_is_checkpointed)
       {
         if (alt_block_matches_checkpoint)
         {
-          if (!data.checkpointed)
+          if (!bei.checkpointed)
           {
-            data.checkpointed = true;
-            CHECK_AND_ASSERT_MES(get_checkpoint(data.height, bei.checkpoint), false, "Unexpected failure to retrieve checkpoint after checking it existed");
+            bei.checkpointed = true;
+            CHECK_AND_ASSERT_MES(get_checkpoint(bei.height, bei.checkpoint), false, "Unexpected failure to retrieve checkpoint after checking it existed");
             alt_checkpoint_count++;
           }
         }
@@ -1725,16 +1968,8 @@ bool Blockchain::build_alt_chain(const crypto::hash &prev_id,
           checkpoint_count++; // One of our stored-checkpoints references another block that's not this alt block.
       }
 
-      bei.height                  = data.height;
-      bei.block_cumulative_weight = data.cumulative_weight;
-      bei.cumulative_difficulty   = data.cumulative_difficulty;
-      bei.already_generated_coins = data.already_generated_coins;
-      bei.checkpointed            = data.checkpointed;
-
-      prev_hash = bei.bl.prev_id;
       timestamps.push_back(bei.bl.timestamp);
       alt_chain.push_front(std::move(bei));
-      bei = {};
     }
 
     if (num_alt_checkpoints) *num_alt_checkpoints = alt_checkpoint_count;
@@ -1780,7 +2015,7 @@ bool Blockchain::build_alt_chain(const crypto::hash &prev_id,
         // Cleanup alt chain, it's invalid
         bvc.m_verifivation_failed = true;
         for (auto const &bei : alt_chain)
-          m_db->remove_alt_block(cryptonote::get_block_hash(bei.bl));
+          remove_alt_block(cryptonote::get_block_hash(bei.bl));
 
         return false;
       }
@@ -1801,6 +2036,60 @@ bool Blockchain::build_alt_chain(const crypto::hash &prev_id,
     return true;
 }
 //------------------------------------------------------------------
+std::shared_ptr<const Blockchain::block_extended_info> Blockchain::get_alt_block(const crypto::hash &id) const
+{
+  std::unique_lock lock{*this};
+  if (auto it = m_alt_blocks_cache.find(id); it != m_alt_blocks_cache.end())
+    return it->second;
+
+  alt_block_data_t data;
+  blobdata blob, checkpoint_blob;
+  if (!m_db->get_alt_block(id, &data, &blob, &checkpoint_blob))
+    return nullptr;
+
+  auto bei = std::make_shared<block_extended_info>();
+  if (!cryptonote::parse_and_validate_block_from_blob(blob, bei->bl))
+  {
+    MERROR("Failed to parse alt block " << id);
+    return nullptr;
+  }
+  if (data.checkpointed && !t_serializable_object_from_blob(bei->checkpoint, checkpoint_blob))
+  {
+    MERROR("Failed to parse the checkpoint of alt block " << id);
+    return nullptr;
+  }
+  bei->checkpointed            = data.checkpointed;
+  bei->height                  = data.height;
+  bei->block_cumulative_weight = data.cumulative_weight;
+  bei->cumulative_difficulty   = data.cumulative_difficulty;
+  bei->already_generated_coins = data.already_generated_coins;
+
+  if (m_alt_blocks_cache.size() >= ALT_BLOCKS_CACHE_MAX)
+    m_alt_blocks_cache.clear();
+  m_alt_blocks_cache.emplace(id, bei);
+  return bei;
+}
+//------------------------------------------------------------------
+void Blockchain::add_alt_block(const crypto::hash &id, const alt_block_data_t &data, const block &b, const checkpoint_t *checkpoint)
+{
+  std::unique_lock lock{*this};
+  cryptonote::blobdata checkpoint_blob;
+  if (checkpoint)
+    checkpoint_blob = t_serializable_object_to_blob(*checkpoint);
+  m_db->add_alt_block(id, data, cryptonote::block_to_blob(b), checkpoint ? &checkpoint_blob : nullptr);
+
+  if (m_alt_blocks_cache.size() >= ALT_BLOCKS_CACHE_MAX)
+    m_alt_blocks_cache.clear();
+  m_alt_blocks_cache[id] = std::make_shared<block_extended_info>(data, b, checkpoint);
+}
+//------------------------------------------------------------------
+void Blockchain::remove_alt_block(const crypto::hash &id)
+{
+  std::unique_lock lock{*this};
+  m_alt_blocks_cache.erase(id);
+  m_db->remove_alt_block(id);
+}
+//------------------------------------------------------------------
 // If a block is to be added and its parent block is not the current
 // main chain top block, then we need to see if we know about its parent block.
 // If its parent block is part of a known forked chain, then we need to see
@@ -1816,8 +2105,8 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
   uint64_t const chain_height = get_current_blockchain_height();
 
   // NOTE: Check block parent's existence
-  alt_block_data_t prev_data = {};
-  bool parent_in_alt  = m_db->get_alt_block(b.prev_id, &prev_data, NULL, nullptr /*checkpoint_blob*/);
+  auto const prev_alt = get_alt_block(b.prev_id);
+  bool parent_in_alt  = prev_alt != nullptr;
   bool parent_in_main = m_db->block_exists(b.prev_id);
   if (!(parent_in_main || parent_in_alt))
   {
@@ -1835,9 +2124,6 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
     return false;
   }
 
-  // NOTE: Reset timestamp/difficulty cache
-  m_cache.m_timestamps_and_difficulties_height = 0;
-
   // NOTE: Build the alternative chain for checking reorg-ability
   std::list<block_extended_info> alt_chain;
   std::vector<uint64_t> timestamps;
@@ -1882,20 +2168,18 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
   {
     alt_data.cumulative_difficulty = current_diff;
     if (alt_chain.size())
-      alt_data.cumulative_difficulty += prev_data.cumulative_difficulty;
+      alt_data.cumulative_difficulty += prev_alt->cumulative_difficulty;
     else // passed-in block's previous block's cumulative difficulty, found on the main chain
       alt_data.cumulative_difficulty += m_db->get_block_cumulative_difficulty(m_db->get_block_height(b.prev_id));
   }
 
   // NOTE: Add alt block to DB storage and alt chain
   {
-    CHECK_AND_ASSERT_MES(!m_db->get_alt_block(id, NULL, NULL, NULL), false, "insertion of new alternative block returned as it already exists");
+    CHECK_AND_ASSERT_MES(!get_alt_block(id), false, "insertion of new alternative block returned as it already exists");
 
-    cryptonote::blobdata checkpoint_blob;
     if (checkpoint)
     {
       alt_data.checkpointed = true;
-      checkpoint_blob       = t_serializable_object_to_blob(*checkpoint);
       num_checkpoints_on_alt_chain++;
     }
 
@@ -1929,9 +2213,9 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
     }
 
     uint64_t block_reward = get_outs_money_amount(b.miner_tx);
-    const uint64_t prev_generated_coins = alt_chain.size() ? prev_data.already_generated_coins : m_db->get_block_already_generated_coins(blk_height - 1);
+    const uint64_t prev_generated_coins = alt_chain.size() ? prev_alt->already_generated_coins : m_db->get_block_already_generated_coins(blk_height - 1);
     alt_data.already_generated_coins = (block_reward < (MONEY_SUPPLY - prev_generated_coins)) ? prev_generated_coins + block_reward : MONEY_SUPPLY;
-    m_db->add_alt_block(id, alt_data, cryptonote::block_to_blob(b), checkpoint_blob.empty() ? nullptr : &checkpoint_blob);
+    add_alt_block(id, alt_data, b, checkpoint);
 
     // Check current height for pre-existing checkpoint
     bool height_is_checkpointed = false;
@@ -2221,8 +2505,6 @@ bool Blockchain::handle_get_blocks(NOTIFY_REQUEST_GET_BLOCKS::request& arg, NOTI
 
   db_rtxn_guard rtxn_guard (m_db);
   rsp.current_blockchain_height = get_current_blockchain_height();
-  std::vector<std::pair<cryptonote::blobdata,block>> blocks;
-  get_blocks(arg.blocks, blocks, rsp.missed_ids);
 
   uint64_t const top_height = (m_db->height() - 1);
   uint64_t const earliest_height_to_sync_checkpoints_granularly =
@@ -2230,15 +2512,45 @@ bool Blockchain::handle_get_blocks(NOTIFY_REQUEST_GET_BLOCKS::request& arg, NOTI
           ? 0
           : top_height - service_nodes::CHECKPOINT_STORE_PERSISTENTLY_INTERVAL;
 
-  for (auto& bl: blocks)
+  std::optional<uint64_t> last_height;
+  for (auto& block_hash : arg.blocks)
   {
-    auto &block_blob = bl.first;
-    auto &block = bl.second;
+    // Syncing peers tend to ask for the same spans, so repeats come from the entries recently sent
+    if (auto* cached = m_served_blocks.find(block_hash))
+    {
+      rsp.blocks.push_back(cached->block);
+      last_height = std::max(last_height.value_or(0), cached->height);
+      continue;
+    }
+
+    uint64_t block_height = 0;
+    blobdata block_blob;
+    try
+    {
+      if (!m_db->block_exists(block_hash, &block_height))
+      {
+        rsp.missed_ids.push_back(block_hash);
+        continue;
+      }
+      block_blob = m_db->get_block_blob_from_height(block_height);
+    }
+    catch (const std::exception& e)
+    {
+      MERROR("Failed to retrieve block " << block_hash << " from the db: " << e.what());
+      break;
+    }
+
+    block block;
+    if (!parse_and_validate_block_from_blob(block_blob, block))
+    {
+      LOG_ERROR("Invalid block: " << block_hash);
+      rsp.missed_ids.push_back(block_hash);
+      continue;
+    }
 
     rsp.blocks.push_back(block_complete_entry());
     block_complete_entry& block_entry = rsp.blocks.back();
 
-    uint64_t const block_height  = get_block_height(block);
     uint64_t checkpoint_interval = service_nodes::CHECKPOINT_STORE_PERSISTENTLY_INTERVAL;
     if (block_height >= earliest_height_to_sync_checkpoints_granularly)
       checkpoint_interval = service_nodes::CHECKPOINT_INTERVAL;
@@ -2276,10 +2588,10 @@ bool Blockchain::handle_get_blocks(NOTIFY_REQUEST_GET_BLOCKS::request& arg, NOTI
     if (missed_tx_ids.size() != 0)
     {
       // do not display an error if the peer asked for an unpruned block which we are not meant to have
-      if (tools::has_unpruned_block(get_block_height(block), get_current_blockchain_height(), get_blockchain_pruning_seed()))
+      if (tools::has_unpruned_block(block_height, get_current_blockchain_height(), get_blockchain_pruning_seed()))
       {
         LOG_ERROR("Error retrieving blocks, missed " << missed_tx_ids.size()
-            << " transactions for block with hash: " << get_block_hash(block)
+            << " transactions for block with hash: " << block_hash
             << std::endl
         );
       }
@@ -2290,6 +2602,29 @@ bool Blockchain::handle_get_blocks(NOTIFY_REQUEST_GET_BLOCKS::request& arg, NOTI
 
     //pack block
     block_entry.block = std::move(block_blob);
+
+    // Only blocks below the granular checkpointing window are cached: above it a checkpoint (or
+    // blink signatures) can still arrive after the entry was built.
+    if (block_height < earliest_height_to_sync_checkpoints_granularly && block_entry.blinks.empty())
+      m_served_blocks.insert(block_hash, block_height, block_entry);
+    last_height = std::max(last_height.value_or(0), block_height);
+  }
+
+  // Peers sync by asking for consecutive spans: start reading the one after this in the
+  // background so that it's in memory by the time it is (by this peer or another) asked for.
+  if (last_height && *last_height < top_height && *last_height + 1 != m_served_blocks_prefetch_height)
+  {
+    uint64_t const next_height = m_served_blocks_prefetch_height = *last_height + 1;
+    m_async_service.post([this, next_height, count = arg.blocks.size()] {
+      try
+      {
+        m_db->prefetch_blocks(next_height, count);
+      }
+      catch (const std::exception& e)
+      {
+        MWARNING("Failed to prefetch blocks from height " << next_height << ": " << e.what());
+      }
+    });
   }
 
   return true;
@@ -2361,6 +2696,13 @@ uint64_t Blockchain::get_num_mature_outputs(uint64_t amount) const
   // ensure we don't include outputs that aren't yet eligible to be used
   // outpouts are sorted by height
   const uint64_t blockchain_height = m_db->height();
+  if (amount == 0)
+  {
+    // RCT outputs are counted per block, so we don't need to look them up one by one
+    if (blockchain_height < CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE)
+      return 0;
+    return std::min(num_outs, m_db->get_block_cumulative_rct_outputs({blockchain_height - CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE})[0]);
+  }
   while (num_outs > 0)
   {
     const tx_out_index toi = m_db->get_output_tx_and_index(amount, num_outs - 1);
@@ -2379,42 +2721,113 @@ crypto::public_key Blockchain::get_output_key(uint64_t amount, uint64_t global_i
   return data.pubkey;
 }
 
+//------------------------------------------------------------------
+void Blockchain::cache_recent_outputs(uint64_t from_index)
+{
+  const uint64_t num_outputs = m_db->get_num_outputs(0);
+  from_index = std::max(from_index, num_outputs - std::min<uint64_t>(num_outputs, m_recent_outputs.max_outputs()));
+  if (from_index >= num_outputs)
+    return;
+
+  std::vector<uint64_t> offsets(num_outputs - from_index);
+  std::iota(offsets.begin(), offsets.end(), from_index);
+  const uint64_t amount = 0;
+  std::vector<output_data_t> data;
+  std::vector<tx_out_index> toi;
+  m_db->get_output_key({&amount, 1}, offsets, data);
+  m_db->get_output_tx_and_index({&amount, 1}, offsets, toi);
+  CHECK_AND_ASSERT_THROW_MES(data.size() == offsets.size() && toi.size() == offsets.size(), "Unexpected output data size");
+
+  std::vector<recent_outputs_cache::output> outputs;
+  outputs.reserve(offsets.size());
+  for (size_t i = 0; i < offsets.size(); i++)
+    outputs.push_back({data[i], toi[i].first});
+  m_recent_outputs.append(from_index, std::move(outputs));
+  update_recent_outputs_size();
+}
+//------------------------------------------------------------------
+void Blockchain::truncate_recent_outputs()
+{
+  m_recent_outputs.truncate(m_db->get_num_outputs(0));
+  update_recent_outputs_size();
+}
 //------------------------------------------------------------------
 bool Blockchain::get_outs(const rpc::GET_OUTPUTS_BIN::request& req, rpc::GET_OUTPUTS_BIN::response& res) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  std::unique_lock lock{*this};
+  static auto& cache_hits = tools::metrics::get_counter("recent_outputs_hits", OXEN_DEFAULT_LOG_CATEGORY);
+  static auto& cache_misses = tools::metrics::get_counter("recent_outputs_misses", OXEN_DEFAULT_LOG_CATEGORY);
 
   res.outs.clear();
-  res.outs.reserve(req.outputs.size());
+  res.outs.resize(req.outputs.size());
+
+  // Recent RCT outputs (which most ring members are) come from m_recent_outputs; the rest from the db
+  std::vector<bool> cached(req.outputs.size(), false);
+  size_t num_cached = 0;
+  {
+    std::vector<uint64_t> rct_indices;
+    std::vector<size_t> rct_positions;
+    for (size_t i = 0; i < req.outputs.size(); ++i)
+    {
+      if (req.outputs[i].amount != 0)
+        continue;
+      rct_indices.push_back(req.outputs[i].index);
+      rct_positions.push_back(i);
+    }
+    auto found = m_recent_outputs.find(rct_indices);
+    for (size_t j = 0; j < found.size(); ++j)
+    {
+      if (!found[j])
+        continue;
+      const auto& o = *found[j];
+      res.outs[rct_positions[j]] = {o.data.pubkey, o.data.commitment, is_output_spendtime_unlocked(o.data.unlock_time), o.data.height, req.get_txid ? o.txid : crypto::null_hash};
+      cached[rct_positions[j]] = true;
+      num_cached++;
+    }
+  }
+  cache_hits.inc(num_cached);
+  cache_misses.inc(req.outputs.size() - num_cached);
+  if (num_cached == req.outputs.size())
+    return true;
+
+  // Only reads the db, so a read txn gives us a consistent view without holding up the blockchain
+  // lock (and so without serializing concurrent RPC readers).
+  db_rtxn_guard rtxn_guard(m_db);
 
   std::vector<cryptonote::output_data_t> data;
   try
   {
     std::vector<uint64_t> amounts, offsets;
-    amounts.reserve(req.outputs.size());
-    offsets.reserve(req.outputs.size());
-    for (const auto &i: req.outputs)
-    {
-      amounts.push_back(i.amount);
-      offsets.push_back(i.index);
+    std::vector<size_t> positions;
+    amounts.reserve(req.outputs.size() - num_cached);
+    offsets.reserve(req.outputs.size() - num_cached);
+    positions.reserve(req.outputs.size() - num_cached);
+    for (size_t i = 0; i < req.outputs.size(); ++i)
+    {
+      if (cached[i])
+        continue;
+      amounts.push_back(req.outputs[i].amount);
+      offsets.push_back(req.outputs[i].index);
+      positions.push_back(i);
     }
     m_db->get_output_key(epee::span<const uint64_t>(amounts.data(), amounts.size()), offsets, data);
-    if (data.size() != req.outputs.size())
+    if (data.size() != offsets.size())
     {
-      MERROR("Unexpected output data size: expected " << req.outputs.size() << ", got " << data.size());
+      MERROR("Unexpected output data size: expected " << offsets.size() << ", got " << data.size());
       return false;
     }
-    for (const auto &t: data)
-      res.outs.push_back({t.pubkey, t.commitment, is_output_spendtime_unlocked(t.unlock_time), t.height, crypto::null_hash});
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+      const auto& t = data[i];
+      res.outs[positions[i]] = {t.pubkey, t.commitment, is_output_spendtime_unlocked(t.unlock_time), t.height, crypto::null_hash};
+    }
 
     if (req.get_txid)
     {
-      for (size_t i = 0; i < req.outputs.size(); ++i)
-      {
-        tx_out_index toi = m_db->get_output_tx_and_index(req.outputs[i].amount, req.outputs[i].index);
-        res.outs[i].txid = toi.first;
-      }
+      std::vector<tx_out_index> toi;
+      m_db->get_output_tx_and_index(epee::span<const uint64_t>(amounts.data(), amounts.size()), offsets, toi);
+      for (size_t i = 0; i < toi.size(); ++i)
+        res.outs[positions[i]].txid = toi[i].first;
     }
   }
   catch (const std::exception &e)
@@ -2453,12 +2866,10 @@ bool Blockchain::get_output_distribution(uint64_t amount, uint64_t from_height,
 
   if (amount == 0)
   {
-    std::vector<uint64_t> heights;
-    heights.reserve(to_height + 1 - start_height);
     const uint64_t real_start_height = start_height > 0 ? start_height-1 : start_height;
-    for (uint64_t h = real_start_height; h <= to_height; ++h)
-      heights.push_back(h);
-    distribution = m_db->get_block_cumulative_rct_outputs(heights);
+    if (to_height < real_start_height)
+      return false;
+    distribution = m_db->get_cumulative_rct_outputs(real_start_height, to_height + 1 - real_start_height);
     if (start_height > 0)
     {
       base = distribution[0];
@@ -2641,7 +3052,7 @@ size_t get_transaction_version(const cryptonote::blobdata &bd)
 bool Blockchain::get_split_transactions_blobs(const std::vector<crypto::hash>& txs_ids, std::vector<std::tuple<crypto::hash, cryptonote::blobdata, crypto::hash, cryptonote::blobdata>>& txs, std::vector<crypto::hash>& missed_txs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  std::unique_lock lock{*this};
+  db_rtxn_guard rtxn_guard(m_db);
 
   txs.reserve(txs_ids.size());
   for (const auto& tx_hash : txs_ids)
@@ -2726,11 +3137,11 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
     start_height = tools::get_next_unpruned_block_height(start_height, current_height, pruning_seed);
     stop_height = tools::get_next_pruned_block_height(start_height, current_height, pruning_seed);
   }
-  size_t count = 0;
-  hashes.reserve(std::min((size_t)(stop_height - start_height), (size_t)BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT));
-  for(size_t i = start_height; i < stop_height && count < BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT; i++, count++)
+  stop_height = std::min<uint64_t>(stop_height, start_height + BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT);
+  if (start_height < stop_height)
   {
-    hashes.push_back(m_db->get_block_hash_from_height(i));
+    auto range = m_db->get_hashes_range(start_height, stop_height - 1);
+    hashes.insert(hashes.end(), range.begin(), range.end());
   }
 
   return true;
@@ -2915,7 +3326,7 @@ bool Blockchain::check_for_double_spend(const transaction& tx, key_images_contai
 bool Blockchain::get_tx_outputs_gindexs(const crypto::hash& tx_id, size_t n_txes, std::vector<std::vector<uint64_t>>& indexs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  std::unique_lock lock{*this};
+  db_rtxn_guard rtxn_guard(m_db);
   uint64_t tx_index;
   if (!m_db->tx_exists(tx_id, tx_index))
   {
@@ -2928,10 +3339,27 @@ bool Blockchain::get_tx_outputs_gindexs(const crypto::hash& tx_id, size_t n_txes
   return true;
 }
 //------------------------------------------------------------------
+bool Blockchain::get_blocks_tx_outputs_gindexs(const crypto::hash& tx_id, size_t tx_offset, const std::vector<size_t>& block_txes, bool miner_txes, std::vector<std::vector<std::vector<uint64_t>>>& indexs) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  db_rtxn_guard rtxn_guard(m_db);
+  uint64_t tx_index;
+  if (!m_db->tx_exists(tx_id, tx_index))
+  {
+    MERROR_VER("get_blocks_tx_outputs_gindexs failed to find transaction with id = " << tx_id);
+    return false;
+  }
+  CHECK_AND_ASSERT_MES(tx_index >= tx_offset, false, "Invalid tx offset");
+  indexs = m_db->get_blocks_tx_amount_output_indices(tx_index - tx_offset, block_txes, miner_txes);
+  CHECK_AND_ASSERT_MES(block_txes.size() == indexs.size(), false, "Wrong indexs size");
+
+  return true;
+}
+//------------------------------------------------------------------
 bool Blockchain::get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
-  std::unique_lock lock{*this};
+  db_rtxn_guard rtxn_guard(m_db);
   uint64_t tx_index;
   if (!m_db->tx_exists(tx_id, tx_index))
   {
@@ -2948,7 +3376,7 @@ void Blockchain::on_new_tx_from_block(const cryptonote::transaction &tx)
 {
 #if defined(PER_BLOCK_CHECKPOINT)
   // check if we're doing per-block checkpointing
-  if (m_db->height() < m_blocks_hash_check.size())
+  if (m_db->height() < blocks_hash_check_end())
   {
     TIME_MEASURE_START(a);
     m_blocks_txs_check.push_back(get_transaction_hash(tx));
@@ -2979,7 +3407,7 @@ bool Blockchain::check_tx_inputs(transaction& tx, uint64_t& max_used_block_heigh
 
 #if defined(PER_BLOCK_CHECKPOINT)
   // check if we're doing per-block checkpointing
-  if (m_db->height() < m_blocks_hash_check.size() && kept_by_block)
+  if (m_db->height() < blocks_hash_check_end() && kept_by_block)
   {
     max_used_block_id = null_hash;
     max_used_block_height = 0;
@@ -3116,6 +3544,16 @@ bool Blockchain::have_tx_keyimges_as_spent(const transaction &tx) const
   }
   return false;
 }
+//------------------------------------------------------------------
+bool Blockchain::have_tx_keyimges_as_spent(const transaction_view &view) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  if (!view.only_key_inputs())
+    return true;
+  std::vector<bool> spent;
+  have_tx_keyimgs_as_spent(view.key_images, spent);
+  return std::find(spent.begin(), spent.end(), true) != spent.end();
+}
 bool Blockchain::expand_transaction_2(transaction &tx, const crypto::hash &tx_prefix_hash, const std::vector<std::vector<rct::ctkey>> &pubkeys) const
 {
   PERF_TIMER(expand_transaction_2);
@@ -3240,7 +3678,15 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
 
     crypto::hash tx_prefix_hash = get_transaction_prefix_hash(tx);
 
-    std::vector<std::vector<rct::ctkey>> pubkeys(tx.vin.size());
+    tools::scratch<ring_members> pubkeys_scratch;
+    auto& pubkeys = clear_rings(*pubkeys_scratch, tx.vin.size());
+    const scan_table *prefetch_table = &m_scan_table;
+    auto prefetched_rings = m_scan_table.find(tx_prefix_hash, tx.vin.size());
+    if (prefetched_rings.empty())
+    {
+      prefetch_table = &m_prefetched_rings;
+      prefetched_rings = m_prefetched_rings.find(tx_prefix_hash, tx.vin.size());
+    }
     size_t sig_index = 0;
     const crypto::key_image *last_key_image = NULL;
     for (size_t sig_index = 0; sig_index < tx.vin.size(); sig_index++)
@@ -3290,7 +3736,10 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
 
         // make sure that output being spent matches up correctly with the
         // signature spending it.
-        if (!check_tx_input(in_to_key, tx_prefix_hash, pubkeys[sig_index], pmax_used_block_height))
+        epee::span<const output_data_t> prefetched;
+        if (!prefetched_rings.empty())
+          prefetched = prefetch_table->members(prefetched_rings[sig_index]);
+        if (!check_tx_input(in_to_key, prefetched, pubkeys[sig_index], pmax_used_block_height))
         {
           MERROR_VER("Failed to check ring signature for tx " << get_transaction_hash(tx) << "  vin key with k_image: " << in_to_key.k_image << "  sig_index: " << sig_index);
           if (pmax_used_block_height) // a default value of NULL is used when called from Blockchain::handle_block_to_main_chain()
@@ -3410,7 +3859,14 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
         }
       }
 
-      if (!rct::verRctNonSemanticsSimple(rv))
+      // Use the result precomputed for the whole incoming span, if there is one for this exact ring
+      bool ring_sigs_valid;
+      if (auto it = m_rct_ver_table.find(get_transaction_hash(tx)); it != m_rct_ver_table.end() && it->second.first == mix_ring_digest(rv))
+        ring_sigs_valid = it->second.second;
+      else
+        ring_sigs_valid = rct::verRctNonSemanticsSimple(rv);
+
+      if (!ring_sigs_valid)
       {
         MERROR_VER("Failed to check ringct signatures!");
         return false;
@@ -3521,7 +3977,7 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
     if (tx.type == txtype::state_change)
     {
       tx_extra_service_node_state_change state_change;
-      if (!get_service_node_state_change_from_tx_extra(tx.extra, state_change, hf_version))
+      if (!get_service_node_state_change_from_tx_extra(tx, state_change, hf_version))
       {
         MERROR_VER("TX did not have the state change metadata in the tx_extra");
         return false;
@@ -3565,7 +4021,7 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
     else if (tx.type == txtype::key_image_unlock)
     {
       cryptonote::tx_extra_tx_key_image_unlock unlock;
-      if (!cryptonote::get_field_from_tx_extra(tx.extra, unlock))
+      if (!cryptonote::get_field_from_tx_extra(tx, unlock))
       {
         MERROR("TX extra didn't have key image unlock in the tx_extra");
         return false;
@@ -3608,7 +4064,9 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
 //------------------------------------------------------------------
 void Blockchain::check_ring_signature(const crypto::hash &tx_prefix_hash, const crypto::key_image &key_image, const std::vector<rct::ctkey> &pubkeys, const std::vector<crypto::signature>& sig, uint64_t &result) const
 {
-  std::vector<const crypto::public_key *> p_output_keys;
+  tools::scratch<std::vector<const crypto::public_key *>> p_output_keys_scratch;
+  auto& p_output_keys = *p_output_keys_scratch;
+  p_output_keys.clear();
   p_output_keys.reserve(pubkeys.size());
   for (auto &key : pubkeys)
   {
@@ -3800,7 +4258,7 @@ bool Blockchain::is_output_spendtime_unlocked(uint64_t unlock_time) const
 //------------------------------------------------------------------
 // This function locates all outputs associated with a given input (mixins)
 // and validates that they exist and are usable.
-bool Blockchain::check_tx_input(const txin_to_key& txin, const crypto::hash& tx_prefix_hash, std::vector<rct::ctkey> &output_keys, uint64_t* pmax_related_block_height)
+bool Blockchain::check_tx_input(const txin_to_key& txin, epee::span<const output_data_t> prefetched, std::vector<rct::ctkey> &output_keys, uint64_t* pmax_related_block_height)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
 
@@ -3839,7 +4297,7 @@ bool Blockchain::check_tx_input(const txin_to_key& txin, const crypto::hash& tx_
 
   // collect output keys
   outputs_visitor vi(output_keys, *this);
-  if (!scan_outputkeys_for_indexes(txin, vi, tx_prefix_hash, pmax_related_block_height))
+  if (!scan_outputkeys_for_indexes(txin, vi, prefetched, pmax_related_block_height))
   {
     MERROR_VER("Failed to get output keys for tx with amount = " << print_money(txin.amount) << " and count indexes " << txin.key_offsets.size());
     return false;
@@ -4001,9 +4459,9 @@ Blockchain::block_pow_verified Blockchain::verify_block_pow(cryptonote::block co
     // be a parameter?
     // validate proof_of_work versus difficulty target
 #if defined(PER_BLOCK_CHECKPOINT)
-    if (chain_height < m_blocks_hash_check.size())
+    if (chain_height >= m_blocks_hash_check_start && chain_height < blocks_hash_check_end())
     {
-      const auto &expected_hash = m_blocks_hash_check[chain_height];
+      const auto &expected_hash = m_blocks_hash_check[chain_height - m_blocks_hash_check_start];
       if (expected_hash != crypto::null_hash)
       {
         if (blk_hash != expected_hash)
@@ -4156,6 +4614,7 @@ bool Blockchain::basic_block_checks(cryptonote::block const &blk, bool alt_block
 bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash& id, block_verification_context& bvc, checkpoint_t const *checkpoint, bool notify)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
+  PERF_TIMER(handle_block_to_main_chain);
 
   TIME_MEASURE_START(block_processing_time);
   std::unique_lock lock{*this};
@@ -4361,7 +4820,18 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
     {
       uint64_t long_term_block_weight = get_next_long_term_block_weight(block_weight);
       cryptonote::blobdata bd = cryptonote::block_to_blob(bl);
+      const uint64_t num_rct_outputs = m_recent_outputs.max_outputs() ? m_db->get_num_outputs(0) : 0;
+      const uint8_t hf_version = bl.major_version;
+      const uint64_t governance = hf_version >= network_version_10_bulletproofs && hf_version < network_version_15_ons
+        ? derive_governance_from_block_reward(nettype(), bl, hf_version) : 0;
       new_height = m_db->add_block(std::make_pair(std::move(bl), std::move(bd)), block_weight, long_term_block_weight, cumulative_difficulty, already_generated_coins, txs);
+      if (m_recent_outputs.max_outputs())
+        cache_recent_outputs(num_rct_outputs);
+      if (hf_version < network_version_15_ons)
+        governance_sums_block_added(new_height - 1, governance);
+      else
+        m_governance_sums.clear();
+      difficulty_window_block_added(bl.timestamp, cumulative_difficulty, new_height);
     }
     catch (const KEY_IMAGE_EXISTS& e)
     {
@@ -4475,26 +4945,51 @@ bool Blockchain::handle_block_to_main_chain(const block& bl, const crypto::hash&
 
   bvc.m_added_to_main_chain = true;
   ++m_sync_counter;
+  static auto& blocks_added = tools::metrics::get_counter("main_chain_blocks_added", OXEN_DEFAULT_LOG_CATEGORY);
+  blocks_added.inc();
+  if (miner.blk_pow.per_block_checkpointed)
+  {
+    // Added against the compiled-in block hashes, without PoW or ringct verification
+    static auto& fast_synced = tools::metrics::get_counter("fast_synced_blocks", OXEN_DEFAULT_LOG_CATEGORY);
+    fast_synced.inc();
+  }
 
   m_tx_pool.on_blockchain_inc(bl);
   invalidate_block_template_cache();
+  publish_chain_tip_snapshot();
 
   if (notify)
   {
-    std::shared_ptr<tools::Notify> block_notify = m_block_notify;
+    std::shared_ptr<tools::AsyncNotify> block_notify = m_block_notify;
     if (block_notify)
-      block_notify->notify("%s", tools::type_to_hex(id).c_str(), NULL);
+      block_notify->notify({{"%s", tools::type_to_hex(id)}});
   }
 
   return true;
 }
 //------------------------------------------------------------------
+void Blockchain::set_block_notify(const std::shared_ptr<tools::Notify> &notify, bool coalesce)
+{
+  m_block_notify = notify ? std::make_shared<tools::AsyncNotify>(notify, coalesce) : nullptr;
+}
+//------------------------------------------------------------------
+void Blockchain::set_reorg_notify(const std::shared_ptr<tools::Notify> &notify)
+{
+  m_reorg_notify = notify ? std::make_shared<tools::AsyncNotify>(notify, false) : nullptr;
+}
+//------------------------------------------------------------------
 bool Blockchain::prune_blockchain(uint32_t pruning_seed)
 {
   auto lock = tools::unique_locks(m_tx_pool, *this);
   return m_db->prune_blockchain(pruning_seed);
 }
 //------------------------------------------------------------------
+bool Blockchain::prune_blockchain_batch(uint32_t pruning_seed, size_t max_records)
+{
+  auto lock = tools::unique_locks(m_tx_pool, *this);
+  return m_db->prune_blockchain_batch(pruning_seed, max_records);
+}
+//------------------------------------------------------------------
 bool Blockchain::update_blockchain_pruning()
 {
   auto lock = tools::unique_locks(m_tx_pool, *this);
@@ -4638,6 +5133,8 @@ bool Blockchain::add_new_block(const block& bl, block_verification_context& bvc,
   if(bl.prev_id == get_tail_id()) //check that block refers to chain tail
   {
     result = handle_block_to_main_chain(bl, id, bvc, checkpoint);
+    // Drop the validation temporaries the block's txes left behind
+    tools::release_scratch();
   }
   else
   {
@@ -4739,18 +5236,142 @@ void Blockchain::block_longhash_worker(uint64_t height, const epee::span<const b
 {
   TIME_MEASURE_START(t);
 
+  // Blocks that still need hashing get hashed cn_heavy_hash_v2::MAX_LANES at a time, so that
+  // CryptoNight Heavy blocks get interleaved (see get_block_longhashes)
+  constexpr size_t LANES = cn_heavy_hash_v2::MAX_LANES;
+  const block* pending[LANES];
+  randomx_longhash_context contexts[LANES];
+  uint64_t heights[LANES];
+  crypto::hash ids[LANES];
+  size_t npending = 0;
+  auto hash_pending = [&] {
+    crypto::hash pows[LANES];
+    get_block_longhashes(m_nettype, pending, contexts, heights, pows, npending);
+    for (size_t i = 0; i < npending; i++)
+      map.emplace(ids[i], pows[i]);
+    npending = 0;
+  };
+
   for (const auto & block : blocks)
   {
     if (m_cancel)
       break;
     crypto::hash id = get_block_hash(block);
-    crypto::hash pow = get_block_longhash_w_blockchain(m_nettype, this, block, height++, 0);
-    map.emplace(id, pow);
+    randomx_longhash_context randomx_context{this, block, height};
+
+    // Reuse the hash computed by the lookahead stage if it was made with the same seed
+    {
+      std::lock_guard lock{m_blocks_longhash_lookahead_mutex};
+      if (auto it = m_blocks_longhash_lookahead.find(id); it != m_blocks_longhash_lookahead.end() && it->second.seed_hash == randomx_context.seed_block_hash)
+      {
+        map.emplace(id, it->second.pow);
+        ++height;
+        continue;
+      }
+    }
+
+    pending[npending] = &block;
+    contexts[npending] = randomx_context;
+    heights[npending] = height;
+    ids[npending] = id;
+    if (++npending == LANES)
+      hash_pending();
+    ++height;
   }
+  if (npending > 0 && !m_cancel)
+    hash_pending();
 
   TIME_MEASURE_FINISH(t);
 }
 
+//------------------------------------------------------------------
+void Blockchain::precompute_block_longhashes(uint64_t height, const std::vector<block_complete_entry> &blocks_entry)
+{
+  MTRACE("Blockchain::" << __func__);
+  if (blocks_entry.empty())
+    return;
+
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+
+  // The previous lookahead is normally already consumed by prepare_handle_incoming_blocks; if it
+  // hasn't been (e.g. the span got dropped) wait for it here so that at most one span's worth of
+  // lookahead work is ever in flight.
+  m_blocks_longhash_lookahead_waiter.wait(&tpool);
+
+  struct lookahead_block { block bl; uint64_t height; randomx_longhash_context ctx; };
+  std::vector<lookahead_block> work;
+  work.reserve(blocks_entry.size());
+  {
+    std::unique_lock lock{*this};
+    const uint64_t db_height = m_db->height();
+    // No PoW needed for blocks covered by the compiled-in block hashes
+    if (height >= m_blocks_hash_check_start && height + blocks_entry.size() < blocks_hash_check_end())
+      return;
+
+    for (size_t i = 0; i < blocks_entry.size(); ++i)
+    {
+      block b;
+      if (!parse_and_validate_block_from_blob(blocks_entry[i].block, b))
+        return;
+      if (block_has_pulse_components(b))
+        continue;
+      const uint64_t block_height = height + i;
+      // We can only hash blocks whose RandomX seed block is already in the chain; anything else
+      // (which is rare: only just after a seed epoch change) gets hashed by the prepare stage.
+      if (b.major_version >= network_version_12_checkpointing && m_nettype != FAKECHAIN && rx_seedheight(block_height) >= db_height)
+        continue;
+      randomx_longhash_context ctx{this, b, block_height};
+      work.push_back({std::move(b), block_height, ctx});
+    }
+  }
+
+  {
+    std::lock_guard lock{m_blocks_longhash_lookahead_mutex};
+    m_blocks_longhash_lookahead.clear();
+  }
+
+  if (work.empty())
+    return;
+
+  MDEBUG("Starting PoW lookahead for " << work.size() << " blocks from height " << height);
+  auto shared_work = std::make_shared<std::vector<lookahead_block>>(std::move(work));
+  auto started = std::make_shared<std::chrono::steady_clock::time_point>(std::chrono::steady_clock::now());
+  auto remaining = std::make_shared<std::atomic<size_t>>(shared_work->size());
+  for (size_t i = 0; i < shared_work->size(); )
+  {
+    // CryptoNight Heavy blocks go several per job, to be interleaved (see get_block_longhashes);
+    // anything else gets a job of its own.
+    size_t n = 1;
+    auto cn_type = get_block_longhash_cn_type(m_nettype, (*shared_work)[i].bl.major_version);
+    if (cn_type == crypto::cn_slow_hash_type::heavy_v1 || cn_type == crypto::cn_slow_hash_type::heavy_v2)
+      n = std::min(shared_work->size() - i, cn_heavy_hash_v2::MAX_LANES);
+    tpool.submit(&m_blocks_longhash_lookahead_waiter, [this, shared_work, i, n, height, started, remaining] {
+      if (m_cancel)
+        return;
+      std::vector<const block*> blocks;
+      std::vector<randomx_longhash_context> contexts;
+      std::vector<uint64_t> heights;
+      for (size_t j = i; j < i + n; j++)
+      {
+        const auto &work = (*shared_work)[j];
+        blocks.push_back(&work.bl);
+        contexts.push_back(work.ctx);
+        heights.push_back(work.height);
+      }
+      std::vector<crypto::hash> pows(n);
+      get_block_longhashes(m_nettype, blocks.data(), contexts.data(), heights.data(), pows.data(), n);
+      {
+        std::lock_guard lock{m_blocks_longhash_lookahead_mutex};
+        for (size_t j = 0; j < n; j++)
+          m_blocks_longhash_lookahead[get_block_hash(*blocks[j])] = {contexts[j].seed_block_hash, pows[j]};
+      }
+      if ((*remaining -= n) == 0 && m_show_time_stats)
+        MDEBUG("PoW lookahead for " << shared_work->size() << " blocks from height " << height << " took "
+            << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - *started).count() << " ms");
+    }, true);
+    i += n;
+  }
+}
 //------------------------------------------------------------------
 bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
 {
@@ -4772,6 +5393,9 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
     MERROR("Exception in cleanup_handle_incoming_blocks: " << e.what());
   }
 
+  if (success)
+    flush_txpool();
+
   if (success && m_sync_counter > 0)
   {
     if (force_sync)
@@ -4780,6 +5404,10 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
         store_blockchain();
       m_sync_counter = 0;
     }
+    else if (m_db_sync_mode == db_group)
+    {
+      m_async_service.post([this, now = m_bytes_to_sync >= m_group_sync_max_bytes] { schedule_group_sync(now); });
+    }
     else if (m_db_sync_threshold && ((m_db_sync_on_blocks && m_sync_counter >= m_db_sync_threshold) || (!m_db_sync_on_blocks && m_bytes_to_sync >= m_db_sync_threshold)))
     {
       MDEBUG("Sync threshold met, syncing");
@@ -4803,12 +5431,14 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
   TIME_MEASURE_FINISH(t1);
   m_blocks_longhash_table.clear();
   m_scan_table.clear();
+  m_rct_ver_table.clear();
+  m_rct_semantics_verified.clear();
   m_blocks_txs_check.clear();
 
   // when we're well clear of the precomputed hashes, free the memory
-  if (!m_blocks_hash_check.empty() && m_db->height() > m_blocks_hash_check.size() + 4096)
+  if (!m_blocks_hash_check.empty() && m_db->height() > blocks_hash_check_end() + 4096)
   {
-    MINFO("Dumping block hashes, we're now 4k past " << m_blocks_hash_check.size());
+    MINFO("Dumping block hashes, we're now 4k past " << blocks_hash_check_end());
     m_blocks_hash_check.clear();
     m_blocks_hash_check.shrink_to_fit();
   }
@@ -4838,6 +5468,149 @@ void Blockchain::output_scan_worker(const uint64_t amount, const std::vector<uin
   }
 }
 
+// Lays out `table` with one ring per input of each of `txes` (tx, prefix hash), each with room for
+// all of its members, looks up all the ring members with one sorted bulk query per amount (threaded
+// per amount if the db allows it), and then fills in each ring, in parallel, with the leading
+// members that were found; check_tx_inputs looks up the rest (e.g. outputs created by an earlier
+// tx of the same span).  Txes with anything other than txin_to_key inputs are left out.
+bool Blockchain::build_scan_table(scan_table &table, const std::vector<std::pair<const transaction*, crypto::hash>> &txes) const
+{
+  table.clear();
+
+  // [input] stores all unique amounts found
+  std::vector<uint64_t> amounts;
+  // [input] stores all absolute_offsets for each amount
+  std::map<uint64_t, std::vector<uint64_t>> offset_map;
+  // [output] stores all output_data_t for each absolute_offset
+  std::map<uint64_t, std::vector<output_data_t>> tx_map;
+
+  std::vector<uint64_t> member_offsets; // absolute offset of each ring member, parallel to table.outputs
+  std::vector<std::pair<const transaction*, size_t>> scanned; // tx, index of its first ring in table.rings
+  scanned.reserve(txes.size());
+  for (const auto &[tx, tx_prefix_hash] : txes)
+  {
+    if (m_cancel)
+      return false;
+
+    if (!std::all_of(tx->vin.begin(), tx->vin.end(), [](const txin_v &in) { return std::holds_alternative<txin_to_key>(in); }))
+      continue;
+
+    if (!table.txs.emplace(tx_prefix_hash, table.rings.size()).second)
+      return false;
+    scanned.emplace_back(tx, table.rings.size());
+
+    for (const auto &txin : tx->vin)
+    {
+      const auto &in_to_key = var::get<txin_to_key>(txin);
+      amounts.push_back(in_to_key.amount);
+      tx_map[in_to_key.amount];
+
+      // no need to check for duplicate here.
+      auto absolute_offsets = relative_output_offsets_to_absolute(in_to_key.key_offsets);
+      auto &amount_offsets = offset_map[in_to_key.amount];
+      amount_offsets.insert(amount_offsets.end(), absolute_offsets.begin(), absolute_offsets.end());
+
+      table.rings.push_back({member_offsets.size(), 0});
+      member_offsets.insert(member_offsets.end(), absolute_offsets.begin(), absolute_offsets.end());
+    }
+  }
+
+  // sort and remove duplicate amounts and absolute_offsets
+  std::sort(amounts.begin(), amounts.end());
+  amounts.erase(std::unique(amounts.begin(), amounts.end()), amounts.end());
+  for (auto &offsets : offset_map)
+  {
+    std::sort(offsets.second.begin(), offsets.second.end());
+    auto last = std::unique(offsets.second.begin(), offsets.second.end());
+    offsets.second.erase(last, offsets.second.end());
+  }
+
+  // gather all the output keys
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  unsigned threads = tpool.get_max_concurrency();
+  if (!m_db->can_thread_bulk_indices())
+    threads = 1;
+
+  if (threads > 1 && amounts.size() > 1)
+  {
+    tools::threadpool::waiter waiter;
+
+    for (size_t i = 0; i < amounts.size(); i++)
+    {
+      uint64_t amount = amounts[i];
+      tpool.submit(&waiter, [this, amount, &offsets=offset_map[amount], &outputs=tx_map[amount]]
+          { output_scan_worker(amount, offsets, outputs); }, true);
+    }
+    waiter.wait(&tpool);
+  }
+  else
+  {
+    for (size_t i = 0; i < amounts.size(); i++)
+    {
+      uint64_t amount = amounts[i];
+      output_scan_worker(amount, offset_map[amount], tx_map[amount]);
+    }
+  }
+
+  // now fill in each input's ring from the per-amount results
+  table.outputs.resize(member_offsets.size());
+  auto fill_rings = [&table, &scanned, &offset_map, &tx_map, &member_offsets](size_t begin, size_t end)
+  {
+    for (size_t t = begin; t < end; ++t)
+    {
+      auto *ring = &table.rings[scanned[t].second];
+      for (const auto &txin : scanned[t].first->vin)
+      {
+        const auto &in_to_key = var::get<txin_to_key>(txin);
+        const auto &offsets_found = offset_map.at(in_to_key.amount);
+        const auto &outputs_found = tx_map.at(in_to_key.amount);
+        for (; ring->size < in_to_key.key_offsets.size(); ++ring->size)
+        {
+          const size_t member = ring->begin + ring->size;
+          auto found = std::lower_bound(offsets_found.begin(), offsets_found.end(), member_offsets[member]);
+          const size_t pos = found - offsets_found.begin();
+          if (found == offsets_found.end() || *found != member_offsets[member] || pos >= outputs_found.size())
+            break;
+          table.outputs[member] = outputs_found[pos];
+        }
+        ++ring;
+      }
+    }
+  };
+  if (threads > 1 && scanned.size() > 1)
+  {
+    tools::threadpool::waiter waiter;
+    const size_t chunk = (scanned.size() + threads - 1) / threads;
+    for (size_t begin = 0; begin < scanned.size(); begin += chunk)
+      tpool.submit(&waiter, [&fill_rings, begin, end=std::min(begin + chunk, scanned.size())] { fill_rings(begin, end); }, true);
+    waiter.wait(&tpool);
+  }
+  else
+    fill_rings(0, scanned.size());
+
+  return true;
+}
+
+void Blockchain::prefetch_ring_members(const std::vector<const transaction*> &txs)
+{
+  std::vector<std::pair<const transaction*, crypto::hash>> scan_txes;
+  scan_txes.reserve(txs.size());
+  for (const auto *tx : txs)
+    scan_txes.emplace_back(tx, get_transaction_prefix_hash(*tx));
+
+  std::unique_lock lock{*this};
+  db_rtxn_guard rtxn_guard(m_db);
+  if (!build_scan_table(m_prefetched_rings, scan_txes))
+    m_prefetched_rings.clear();
+  update_scan_table_size();
+}
+
+void Blockchain::clear_prefetched_ring_members()
+{
+  std::unique_lock lock{*this};
+  m_prefetched_rings.clear();
+}
+
 uint64_t Blockchain::prevalidate_block_hashes(uint64_t height, const std::vector<crypto::hash> &hashes)
 {
   // new: . . . . . X X X X X . . . . . .
@@ -4913,11 +5686,12 @@ uint64_t Blockchain::prevalidate_block_hashes(uint64_t height, const std::vector
       }
 
       size_t end = n * HASH_OF_HASHES_STEP + HASH_OF_HASHES_STEP;
-      for (size_t i = n * HASH_OF_HASHES_STEP; i < end; ++i)
+      for (size_t i = std::max<size_t>(n * HASH_OF_HASHES_STEP, m_blocks_hash_check_start); i < end; ++i)
       {
-        CHECK_AND_ASSERT_MES(m_blocks_hash_check[i] == crypto::null_hash || m_blocks_hash_check[i] == data[i - first_index * HASH_OF_HASHES_STEP],
+        auto& check = m_blocks_hash_check[i - m_blocks_hash_check_start];
+        CHECK_AND_ASSERT_MES(check == crypto::null_hash || check == data[i - first_index * HASH_OF_HASHES_STEP],
             0, "Consistency failure in m_blocks_hash_check construction");
-        m_blocks_hash_check[i] = data[i - first_index * HASH_OF_HASHES_STEP];
+        check = data[i - first_index * HASH_OF_HASHES_STEP];
       }
       usable += HASH_OF_HASHES_STEP;
     }
@@ -4973,6 +5747,14 @@ bool Blockchain::calc_batched_governance_reward(uint64_t height, uint64_t &rewar
     num_blocks   = height;
   }
 
+  // The sums cover the interval unless we (re)started part way through it
+  if (!m_governance_sums.empty() && start_height >= m_governance_sums_height &&
+      height - m_governance_sums_height < m_governance_sums.size())
+  {
+    reward = m_governance_sums[height - m_governance_sums_height] - m_governance_sums[start_height - m_governance_sums_height];
+    return true;
+  }
+
   std::vector<cryptonote::block> blocks;
   if (!get_blocks_only(start_height, num_blocks, blocks))
   {
@@ -4989,11 +5771,39 @@ bool Blockchain::calc_batched_governance_reward(uint64_t height, uint64_t &rewar
   return true;
 }
 
+void Blockchain::governance_sums_block_added(uint64_t height, uint64_t governance)
+{
+  if (m_governance_sums.empty() || height != m_governance_sums_height + m_governance_sums.size() - 1)
+  {
+    m_governance_sums.assign(1, 0);
+    m_governance_sums_height = height;
+  }
+  m_governance_sums.push_back(m_governance_sums.back() + governance);
+
+  // A payout only ever needs the last interval's worth
+  const size_t max_size = cryptonote::get_config(nettype()).GOVERNANCE_REWARD_INTERVAL_IN_BLOCKS + 1;
+  while (m_governance_sums.size() > max_size)
+  {
+    m_governance_sums.pop_front();
+    m_governance_sums_height++;
+  }
+}
+
+void Blockchain::truncate_governance_sums(uint64_t height)
+{
+  if (m_governance_sums.empty() || height >= m_governance_sums_height + m_governance_sums.size() - 1)
+    return;
+  if (height <= m_governance_sums_height)
+    m_governance_sums.clear();
+  else
+    m_governance_sums.resize(height - m_governance_sums_height + 1);
+}
+
 //------------------------------------------------------------------
 // ND: Speedups:
 // 1. Thread long_hash computations if possible (m_max_prepare_blocks_threads = nthreads, default = 4)
-// 2. Group all amounts (from txs) and related absolute offsets and form a table of tx_prefix_hash
-//    vs [k_image, output_keys] (m_scan_table). This is faster because it takes advantage of bulk queries
+// 2. Group all amounts (from txs) and related absolute offsets and form a table of the ring members
+//    of each input of each tx (m_scan_table). This is faster because it takes advantage of bulk queries
 //    and is threaded if possible. The table (m_scan_table) will be used later when querying output
 //    keys.
 bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete_entry> &blocks_entry, std::vector<block> &blocks)
@@ -5043,7 +5853,7 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
   m_batch_success = true;
 
   const uint64_t height = m_db->height();
-  if ((height + blocks_entry.size()) < m_blocks_hash_check.size())
+  if (height >= m_blocks_hash_check_start && (height + blocks_entry.size()) < blocks_hash_check_end())
     return true;
 
   bool blocks_exist = false;
@@ -5107,6 +5917,14 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
 
     if (!blocks_exist)
     {
+      // Let the lookahead stage for this span (started while the previous span was being added)
+      // finish so its hashes can be picked up by the workers below.
+      TIME_MEASURE_START(lookahead_wait);
+      m_blocks_longhash_lookahead_waiter.wait(&tpool);
+      TIME_MEASURE_FINISH(lookahead_wait);
+      if (lookahead_wait > 0 && m_show_time_stats)
+        MDEBUG("Waited " << lookahead_wait << " ms for the PoW lookahead stage");
+
       m_blocks_longhash_table.clear();
       uint64_t thread_height = height;
       tools::threadpool::waiter waiter;
@@ -5149,6 +5967,8 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
   m_fake_pow_calc_time = 0;
 
   m_scan_table.clear();
+  m_rct_ver_table.clear();
+  m_rct_semantics_verified.clear();
 
   TIME_MEASURE_FINISH(prepare);
   m_fake_pow_calc_time = prepare / blocks_entry.size();
@@ -5158,23 +5978,20 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
 
   TIME_MEASURE_START(scantable);
 
-  // [input] stores all unique amounts found
-  std::vector < uint64_t > amounts;
-  // [input] stores all absolute_offsets for each amount
-  std::map<uint64_t, std::vector<uint64_t>> offset_map;
-  // [output] stores all output_data_t for each absolute_offset
-  std::map<uint64_t, std::vector<output_data_t>> tx_map;
   std::vector<std::pair<cryptonote::transaction, crypto::hash>> txes(total_txs);
 
 #define SCAN_TABLE_QUIT(m) \
   do { \
     MERROR_VER(m) ;\
     m_scan_table.clear(); \
+    m_rct_ver_table.clear(); \
+    m_rct_semantics_verified.clear(); \
     return false; \
   } while(0); \
 
-  // generate sorted tables for all amounts and absolute offsets
-  size_t tx_index = 0, block_index = 0;
+  size_t tx_index = 0;
+  std::vector<std::pair<const transaction*, crypto::hash>> scan_txes;
+  scan_txes.reserve(total_txs);
   for (const auto &entry : blocks_entry)
   {
     if (m_cancel)
@@ -5191,192 +6008,290 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
       if (!parse_and_validate_tx_base_from_blob(tx_blob, tx))
         SCAN_TABLE_QUIT("Could not parse tx from incoming blocks.");
       cryptonote::get_transaction_prefix_hash(tx, tx_prefix_hash);
+      scan_txes.emplace_back(&tx, tx_prefix_hash);
+    }
+  }
 
-      auto its = m_scan_table.find(tx_prefix_hash);
-      if (its != m_scan_table.end())
-        SCAN_TABLE_QUIT("Duplicate tx found from incoming blocks.");
+  if (!build_scan_table(m_scan_table, scan_txes))
+  {
+    if (m_cancel)
+      return false;
+    SCAN_TABLE_QUIT("Duplicate tx found from incoming blocks.");
+  }
+  update_scan_table_size();
 
-      m_scan_table.emplace(tx_prefix_hash, std::unordered_map<crypto::key_image, std::vector<output_data_t>>());
-      its = m_scan_table.find(tx_prefix_hash);
-      assert(its != m_scan_table.end());
+  TIME_MEASURE_FINISH(scantable);
+  if (total_txs > 0)
+  {
+    m_fake_scan_time = scantable / total_txs;
+    if(m_show_time_stats)
+      MDEBUG("Prepare scantable took: " << scantable << " ms");
 
-      // get all amounts from tx.vin(s)
-      for (const auto &txin : tx.vin)
-      {
-        const auto& in_to_key = var::get<txin_to_key>(txin);
+    TIME_MEASURE_START(rctsigs);
+    batch_verify_incoming_txs(blocks_entry);
+    TIME_MEASURE_FINISH(rctsigs);
+    if(m_show_time_stats)
+      MDEBUG("Prepare rct signatures (" << m_rct_ver_table.size() << " ring, " << m_rct_semantics_verified.size() << " range proof / " << total_txs << " txes) took: " << rctsigs << " ms");
+  }
 
-        // check for duplicate
-        auto it = its->second.find(in_to_key.k_image);
-        if (it != its->second.end())
-          SCAN_TABLE_QUIT("Duplicate key_image found from incoming blocks.");
+  return true;
+}
 
-        amounts.push_back(in_to_key.amount);
-      }
+//------------------------------------------------------------------
+// Batch verifies the rct signatures of all the txes of an incoming span:
+//
+// - the ring signatures of every tx whose ring members were fully resolved into m_scan_table are
+//   checked as one combined threadpool work queue, rather than one small fan-out per tx inside
+//   check_tx_inputs.  Results are recorded in m_rct_ver_table and consumed by check_tx_inputs; any
+//   tx that can't be prepared here (e.g. it spends outputs created earlier in the same span) is
+//   simply left out and gets verified individually as before.
+// - the bulletproofs of the whole span go into a single batched multiexp.  If that passes the txes
+//   are recorded in m_rct_semantics_verified so that the per-block semantics check can skip them; if
+//   it fails nothing is recorded and each block's txes get checked as they normally would be.
+void Blockchain::batch_verify_incoming_txs(const std::vector<block_complete_entry> &blocks_entry)
+{
+  PERF_TIMER(batch_verify_incoming_txs);
+  m_rct_ver_table.clear();
+  m_rct_semantics_verified.clear();
+
+  std::vector<const blobdata*> blobs;
+  for (const auto &entry : blocks_entry)
+    for (const auto &tx_blob : entry.txs)
+      blobs.push_back(&tx_blob);
 
-      // sort and remove duplicate amounts from amounts list
-      std::sort(amounts.begin(), amounts.end());
-      auto last = std::unique(amounts.begin(), amounts.end());
-      amounts.erase(last, amounts.end());
+  std::vector<transaction> txs(blobs.size());
+  std::vector<crypto::hash> tx_hashes(blobs.size());
+  std::deque<bool> usable(blobs.size(), false), bulletproof(blobs.size(), false);
 
-      // add amount to the offset_map and tx_map
-      for (const uint64_t &amount : amounts)
-      {
-        if (offset_map.find(amount) == offset_map.end())
-          offset_map.emplace(amount, std::vector<uint64_t>());
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter;
+  for (size_t i = 0; i < blobs.size(); ++i)
+  {
+    tpool.submit(&waiter, [this, i, &blobs, &txs, &tx_hashes, &usable, &bulletproof] {
+      transaction &tx = txs[i];
+      crypto::hash tx_prefix_hash;
+      if (!parse_and_validate_tx_from_blob(*blobs[i], tx, tx_hashes[i], tx_prefix_hash))
+        return;
+      if (!tx.is_transfer() || tx.pruned || tx.version < txversion::v2_ringct || !rct::is_rct_simple(tx.rct_signatures.type))
+        return;
+      bulletproof[i] = rct::is_rct_bulletproof(tx.rct_signatures.type);
 
-        if (tx_map.find(amount) == tx_map.end())
-          tx_map.emplace(amount, std::vector<output_data_t>());
-      }
+      const auto rings = m_scan_table.find(tx_prefix_hash, tx.vin.size());
+      if (rings.empty())
+        return;
 
-      // add new absolute_offsets to offset_map
-      for (const auto &txin : tx.vin)
+      tools::scratch<ring_members> pubkeys_scratch;
+      auto& pubkeys = clear_rings(*pubkeys_scratch, tx.vin.size());
+      for (size_t n = 0; n < tx.vin.size(); ++n)
       {
-        const auto& in_to_key = var::get<txin_to_key>(txin);
-        // no need to check for duplicate here.
-        auto absolute_offsets = relative_output_offsets_to_absolute(in_to_key.key_offsets);
-        for (const auto & offset : absolute_offsets)
-          offset_map[in_to_key.amount].push_back(offset);
-
+        const auto *in_to_key = std::get_if<txin_to_key>(&tx.vin[n]);
+        if (!in_to_key)
+          return;
+        const auto members = m_scan_table.members(rings[n]);
+        if (members.size() != in_to_key->key_offsets.size())
+          return;
+        pubkeys[n].reserve(members.size());
+        for (const output_data_t &out : members)
+          pubkeys[n].push_back(rct::ctkey{rct::pk2rct(out.pubkey), out.commitment});
       }
-    }
-    ++block_index;
-  }
 
-  // sort and remove duplicate absolute_offsets in offset_map
-  for (auto &offsets : offset_map)
-  {
-    std::sort(offsets.second.begin(), offsets.second.end());
-    auto last = std::unique(offsets.second.begin(), offsets.second.end());
-    offsets.second.erase(last, offsets.second.end());
+      if (!expand_transaction_2(tx, tx_prefix_hash, pubkeys))
+        return;
+      usable[i] = true;
+    }, true);
   }
+  waiter.wait(&tpool);
 
-  // gather all the output keys
-  threads = tpool.get_max_concurrency();
-  if (!m_db->can_thread_bulk_indices())
-    threads = 1;
-
-  if (threads > 1 && amounts.size() > 1)
+  std::vector<const rct::rctSig*> rvv, bp_rvv;
+  std::vector<size_t> rv_index;
+  for (size_t i = 0; i < txs.size(); ++i)
   {
-    tools::threadpool::waiter waiter;
-
-    for (size_t i = 0; i < amounts.size(); i++)
-    {
-      uint64_t amount = amounts[i];
-      tpool.submit(&waiter, [this, amount, &offsets=offset_map[amount], &outputs=tx_map[amount]]
-          { output_scan_worker(amount, offsets, outputs); }, true);
-    }
-    waiter.wait(&tpool);
+    if (bulletproof[i])
+      bp_rvv.push_back(&txs[i].rct_signatures);
+    if (!usable[i])
+      continue;
+    rvv.push_back(&txs[i].rct_signatures);
+    rv_index.push_back(i);
   }
-  else
+
+  if (!bp_rvv.empty())
   {
-    for (size_t i = 0; i < amounts.size(); i++)
+    if (rct::verRctSemanticsSimple(bp_rvv))
     {
-      uint64_t amount = amounts[i];
-      output_scan_worker(amount, offset_map[amount], tx_map[amount]);
+      for (size_t i = 0; i < txs.size(); ++i)
+        if (bulletproof[i])
+          m_rct_semantics_verified.insert(tx_hashes[i]);
     }
+    else
+      MDEBUG("Batched range proof verification of " << bp_rvv.size() << " incoming txes failed, falling back to per-block checks");
   }
 
-  // now generate a table for each tx_prefix and k_image hashes
-  tx_index = 0;
-  for (const auto &entry : blocks_entry)
-  {
-    if (m_cancel)
-      return false;
+  if (rvv.empty())
+    return;
 
-    for (const auto &tx_blob : entry.txs)
-    {
-      if (tx_index >= txes.size())
-        SCAN_TABLE_QUIT("tx_index is out of sync");
-      const transaction &tx = txes[tx_index].first;
-      const crypto::hash &tx_prefix_hash = txes[tx_index].second;
-      ++tx_index;
+  std::vector<bool> valid;
+  rct::verRctNonSemanticsSimple(rvv, &valid);
+  for (size_t j = 0; j < rvv.size(); ++j)
+    m_rct_ver_table[tx_hashes[rv_index[j]]] = {mix_ring_digest(*rvv[j]), valid[j]};
+}
 
-      auto its = m_scan_table.find(tx_prefix_hash);
-      if (its == m_scan_table.end())
-        SCAN_TABLE_QUIT("Tx not found on scan table from incoming blocks.");
+//------------------------------------------------------------------
+// Verifies the ring signatures of a set of txes (the tx pool's, after a reorg) spread over the
+// threadpool, looking up each tx's ring members as it goes.  Takes no lock: a result is only valid
+// for the exact mix ring it was computed with, which check_tx_inputs compares, so it doesn't
+// matter if the chain changes meanwhile.  Txes that can't be prepared (e.g. a ring member isn't
+// in the chain) are left out.
+Blockchain::ring_signature_results Blockchain::verify_ring_signatures(const std::vector<const blobdata*> &blobs) const
+{
+  PERF_TIMER(verify_ring_signatures);
+  std::vector<transaction> txs(blobs.size());
+  std::vector<crypto::hash> tx_hashes(blobs.size());
+  std::deque<bool> usable(blobs.size(), false);
 
-      for (const auto &txin : tx.vin)
-      {
-        const txin_to_key &in_to_key = var::get<txin_to_key>(txin);
-        auto needed_offsets = relative_output_offsets_to_absolute(in_to_key.key_offsets);
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter;
+  for (size_t i = 0; i < blobs.size(); ++i)
+  {
+    tpool.submit(&waiter, [this, i, &blobs, &txs, &tx_hashes, &usable] {
+      transaction &tx = txs[i];
+      crypto::hash tx_prefix_hash;
+      if (!parse_and_validate_tx_from_blob(*blobs[i], tx, tx_hashes[i], tx_prefix_hash))
+        return;
+      if (!tx.is_transfer() || tx.pruned || tx.version < txversion::v2_ringct || !rct::is_rct_simple(tx.rct_signatures.type))
+        return;
 
-        std::vector<output_data_t> outputs;
-        for (const uint64_t & offset_needed : needed_offsets)
+      tools::scratch<ring_members> pubkeys_scratch;
+      auto& pubkeys = clear_rings(*pubkeys_scratch, tx.vin.size());
+      tools::scratch<std::vector<output_data_t>> outputs_scratch;
+      auto& outputs = *outputs_scratch;
+      try
+      {
+        for (size_t n = 0; n < tx.vin.size(); ++n)
         {
-          size_t pos = 0;
-          bool found = false;
-
-          for (const uint64_t &offset_found : offset_map[in_to_key.amount])
-          {
-            if (offset_needed == offset_found)
-            {
-              found = true;
-              break;
-            }
-
-            ++pos;
-          }
-
-          if (found && pos < tx_map[in_to_key.amount].size())
-            outputs.push_back(tx_map[in_to_key.amount].at(pos));
-          else
-            break;
+          const auto *in_to_key = std::get_if<txin_to_key>(&tx.vin[n]);
+          if (!in_to_key)
+            return;
+          outputs.clear();
+          m_db->get_output_key(epee::span<const uint64_t>(&in_to_key->amount, 1), relative_output_offsets_to_absolute(in_to_key->key_offsets), outputs, true);
+          if (outputs.size() != in_to_key->key_offsets.size())
+            return;
+          pubkeys[n].reserve(outputs.size());
+          for (const output_data_t &out : outputs)
+            pubkeys[n].push_back(rct::ctkey{rct::pk2rct(out.pubkey), out.commitment});
         }
-
-        its->second.emplace(in_to_key.k_image, outputs);
       }
-    }
+      catch (const std::exception &e)
+      {
+        MDEBUG("Unable to look up the ring members of " << tx_hashes[i] << ": " << e.what());
+        return;
+      }
+
+      if (!expand_transaction_2(tx, tx_prefix_hash, pubkeys))
+        return;
+      usable[i] = true;
+    }, true);
   }
+  waiter.wait(&tpool);
 
-  TIME_MEASURE_FINISH(scantable);
-  if (total_txs > 0)
+  std::vector<const rct::rctSig*> rvv;
+  std::vector<size_t> rv_index;
+  for (size_t i = 0; i < txs.size(); ++i)
   {
-    m_fake_scan_time = scantable / total_txs;
-    if(m_show_time_stats)
-      MDEBUG("Prepare scantable took: " << scantable << " ms");
+    if (!usable[i])
+      continue;
+    rvv.push_back(&txs[i].rct_signatures);
+    rv_index.push_back(i);
   }
 
-  return true;
+  ring_signature_results results;
+  if (rvv.empty())
+    return results;
+
+  std::vector<bool> valid;
+  rct::verRctNonSemanticsSimple(rvv, &valid);
+  for (size_t j = 0; j < rvv.size(); ++j)
+    results[tx_hashes[rv_index[j]]] = {mix_ring_digest(*rvv[j]), valid[j]};
+  return results;
+}
+
+void Blockchain::add_ring_signature_results(ring_signature_results results)
+{
+  std::unique_lock lock{*this};
+  m_rct_ver_table.merge(results);
+}
+
+bool Blockchain::rct_semantics_preverified(const crypto::hash &txid) const
+{
+  std::unique_lock lock{*this};
+  return m_rct_semantics_verified.count(txid) > 0;
 }
 
 void Blockchain::add_txpool_tx(const crypto::hash &txid, const cryptonote::blobdata &blob, const txpool_tx_meta_t &meta)
 {
-  m_db->add_txpool_tx(txid, blob, meta);
+  m_txpool_store.add(txid, blob, meta);
 }
 
 void Blockchain::update_txpool_tx(const crypto::hash &txid, const txpool_tx_meta_t &meta)
 {
-  m_db->update_txpool_tx(txid, meta);
+  m_txpool_store.update(txid, meta);
 }
 
 void Blockchain::remove_txpool_tx(const crypto::hash &txid)
 {
-  m_db->remove_txpool_tx(txid);
+  m_txpool_store.remove(txid);
 }
 
 uint64_t Blockchain::get_txpool_tx_count(bool include_unrelayed_txes) const
 {
-  return m_db->get_txpool_tx_count(include_unrelayed_txes);
+  return m_txpool_store.count(include_unrelayed_txes);
+}
+
+bool Blockchain::txpool_has_tx(const crypto::hash& txid) const
+{
+  return m_txpool_store.has(txid);
 }
 
 bool Blockchain::get_txpool_tx_meta(const crypto::hash& txid, txpool_tx_meta_t &meta) const
 {
-  return m_db->get_txpool_tx_meta(txid, meta);
+  return m_txpool_store.get_meta(txid, meta);
 }
 
 bool Blockchain::get_txpool_tx_blob(const crypto::hash& txid, cryptonote::blobdata &bd) const
 {
-  return m_db->get_txpool_tx_blob(txid, bd);
+  return m_txpool_store.get_blob(txid, bd);
 }
 
 cryptonote::blobdata Blockchain::get_txpool_tx_blob(const crypto::hash& txid) const
 {
-  return m_db->get_txpool_tx_blob(txid);
+  cryptonote::blobdata bd;
+  if (!m_txpool_store.get_blob(txid, bd))
+    throw DB_ERROR("Tx not found in txpool: ");
+  return bd;
 }
 
 bool Blockchain::for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata*)> f, bool include_blob, bool include_unrelayed_txes) const
 {
-  return m_db->for_all_txpool_txes(f, include_blob, include_unrelayed_txes);
+  return m_txpool_store.for_all(f, include_blob, include_unrelayed_txes);
+}
+
+void Blockchain::flush_txpool()
+{
+  std::unique_lock lock{*this};
+  if (m_txpool_store.pending() == 0 || m_db->is_read_only())
+    return;
+  bool const stop_batch = m_db->batch_start();
+  try
+  {
+    m_txpool_store.flush(*m_db);
+    if (stop_batch)
+      m_db->batch_stop();
+  }
+  catch (const std::exception& e)
+  {
+    MERROR("Failed to write tx pool changes to the database: " << e.what());
+    if (stop_batch)
+      m_db->batch_abort();
+  }
 }
 
 uint64_t Blockchain::get_immutable_height() const
@@ -5402,6 +6317,59 @@ void Blockchain::set_user_options(uint64_t maxthreads, bool sync_on_blocks, uint
   m_max_prepare_blocks_threads = maxthreads;
 }
 
+void Blockchain::set_group_sync(std::chrono::milliseconds max_delay, uint64_t max_bytes)
+{
+  m_group_sync_max_delay = max_delay;
+  m_group_sync_max_bytes = max_bytes;
+}
+
+void Blockchain::schedule_group_sync(bool now)
+{
+  if (now)
+  {
+    if (m_group_sync_armed)
+    {
+      m_group_sync_timer.cancel();
+      m_group_sync_armed = false;
+      m_group_sync_generation++;
+    }
+    run_group_sync();
+  }
+  else if (!m_group_sync_armed)
+  {
+    m_group_sync_armed = true;
+    m_group_sync_timer.expires_after(m_group_sync_max_delay);
+    m_group_sync_timer.async_wait([this, gen = m_group_sync_generation](const boost::system::error_code& ec) {
+      if (ec || gen != m_group_sync_generation)
+        return;
+      m_group_sync_armed = false;
+      m_group_sync_generation++;
+      run_group_sync();
+    });
+  }
+}
+
+void Blockchain::run_group_sync()
+{
+  try
+  {
+    {
+      std::unique_lock lock{*this};
+      if (m_sync_counter == 0)
+        return; // an earlier flush already covered everything
+      m_sync_counter = 0;
+      m_bytes_to_sync = 0;
+      m_service_node_list.store();
+      m_ons_db.checkpoint();
+    }
+    store_blockchain();
+  }
+  catch (const std::exception& e)
+  {
+    MERROR("Group sync failed: " << e.what());
+  }
+}
+
 void Blockchain::safesyncmode(const bool onoff)
 {
   /* all of this is no-op'd if the user set a specific
@@ -5492,85 +6460,85 @@ void Blockchain::load_compiled_in_block_hashes(const GetCheckpointsCallback& get
     return;
   }
   std::string_view checkpoints = get_checkpoints(m_nettype);
-  if (!checkpoints.empty())
+  if (checkpoints.size() > 4)
   {
-    MINFO("Loading precomputed blocks (" << checkpoints.size() << " bytes)");
-    if (m_nettype == MAINNET)
+    uint32_t nblocks;
+    std::memcpy(&nblocks, checkpoints.data(), 4);
+    boost::endian::little_to_native_inplace(nblocks);
+    if (nblocks > (std::numeric_limits<uint32_t>::max() - 4) / sizeof(crypto::hash))
     {
-      // first check hash
-      crypto::hash hash;
-      if (!tools::sha256sum_str(checkpoints, hash))
+      MERROR("Block hash data is too large");
+      return;
+    }
+    const size_t size_needed = 4 + (nblocks * sizeof(crypto::hash));
+    if(checkpoints.size() != size_needed)
+    {
+      MERROR("Failed to load hashes - unexpected data size " << checkpoints.size() << ", expected " << size_needed);
+      return;
+    }
+    // Once the chain is past them (i.e. on every restart of a synced node) the hashes are of no use,
+    // so don't even check them
+    else if(nblocks > 0 && nblocks > (m_db->height() + HASH_OF_HASHES_STEP - 1) / HASH_OF_HASHES_STEP)
+    {
+      MINFO("Loading precomputed blocks (" << checkpoints.size() << " bytes)");
+      if (m_nettype == MAINNET)
       {
-        MERROR("Failed to hash precomputed blocks data");
-        return;
-      }
+        // The data is compiled in, so it only needs checking once however many times it is loaded
+        static std::atomic<const char*> verified_data{nullptr};
+        if (verified_data.load() != checkpoints.data())
+        {
+          crypto::hash hash;
+          if (!tools::sha256sum_str(checkpoints, hash))
+          {
+            MERROR("Failed to hash precomputed blocks data");
+            return;
+          }
 
-      constexpr auto EXPECTED_SHA256_HASH = "d5772a74dadb64a439b60312f9dc3e5243157c5477037a318840b8c36da9644b"sv;
-      MINFO("Precomputed blocks hash: " << hash << ", expected " << EXPECTED_SHA256_HASH);
+          constexpr auto EXPECTED_SHA256_HASH = "d5772a74dadb64a439b60312f9dc3e5243157c5477037a318840b8c36da9644b"sv;
+          MINFO("Precomputed blocks hash: " << hash << ", expected " << EXPECTED_SHA256_HASH);
 
-      crypto::hash expected_hash;
-      if (!tools::hex_to_type(EXPECTED_SHA256_HASH, expected_hash))
-      {
-        MERROR("Failed to parse expected block hashes hash");
-        return;
-      }
+          crypto::hash expected_hash;
+          if (!tools::hex_to_type(EXPECTED_SHA256_HASH, expected_hash))
+          {
+            MERROR("Failed to parse expected block hashes hash");
+            return;
+          }
 
-      if (hash != expected_hash)
-      {
-        MERROR("Block hash data does not match expected hash");
-        return;
+          if (hash != expected_hash)
+          {
+            MERROR("Block hash data does not match expected hash");
+            return;
+          }
+          verified_data = checkpoints.data();
+        }
       }
-    }
 
-    if (checkpoints.size() > 4)
-    {
-      uint32_t nblocks;
-      std::memcpy(&nblocks, checkpoints.data(), 4);
-      boost::endian::little_to_native_inplace(nblocks);
-      if (nblocks > (std::numeric_limits<uint32_t>::max() - 4) / sizeof(hash))
-      {
-        MERROR("Block hash data is too large");
-        return;
-      }
-      const size_t size_needed = 4 + (nblocks * sizeof(crypto::hash));
-      if(checkpoints.size() != size_needed)
+      checkpoints.remove_prefix(4);
+      m_blocks_hash_of_hashes = epee::span<const crypto::hash>{reinterpret_cast<const crypto::hash*>(checkpoints.data()), nblocks};
+      // Only the heights from the group the chain is in onwards can still be checked
+      m_blocks_hash_check_start = m_db->height() / HASH_OF_HASHES_STEP * HASH_OF_HASHES_STEP;
+      m_blocks_hash_check.resize(uint64_t{nblocks} * HASH_OF_HASHES_STEP - m_blocks_hash_check_start, crypto::null_hash);
+      MINFO(nblocks << " block hashes loaded");
+
+      // FIXME: clear tx_pool because the process might have been
+      // terminated and caused it to store txs kept by blocks.
+      // The core will not call check_tx_inputs(..) for these
+      // transactions in this case. Consequently, the sanity check
+      // for tx hashes will fail in handle_block_to_main_chain(..)
+      std::unique_lock lock{m_tx_pool};
+
+      std::vector<transaction> txs;
+      m_tx_pool.get_transactions(txs);
+
+      size_t tx_weight;
+      uint64_t fee;
+      bool relayed, do_not_relay, double_spend_seen;
+      transaction pool_tx;
+      blobdata txblob;
+      for(const transaction &tx : txs)
       {
-        MERROR("Failed to load hashes - unexpected data size " << checkpoints.size() << ", expected " << size_needed);
-        return;
-      }
-      else if(nblocks > 0 && nblocks > (m_db->height() + HASH_OF_HASHES_STEP - 1) / HASH_OF_HASHES_STEP)
-      {
-        checkpoints.remove_prefix(4);
-        m_blocks_hash_of_hashes.reserve(nblocks);
-        for (uint32_t i = 0; i < nblocks; i++)
-        {
-          crypto::hash& hash = m_blocks_hash_of_hashes.emplace_back();
-          std::memcpy(hash.data, checkpoints.data(), sizeof(hash.data));
-          checkpoints.remove_prefix(sizeof(hash.data));
-        }
-        m_blocks_hash_check.resize(m_blocks_hash_of_hashes.size() * HASH_OF_HASHES_STEP, crypto::null_hash);
-        MINFO(nblocks << " block hashes loaded");
-
-        // FIXME: clear tx_pool because the process might have been
-        // terminated and caused it to store txs kept by blocks.
-        // The core will not call check_tx_inputs(..) for these
-        // transactions in this case. Consequently, the sanity check
-        // for tx hashes will fail in handle_block_to_main_chain(..)
-        std::unique_lock lock{m_tx_pool};
-
-        std::vector<transaction> txs;
-        m_tx_pool.get_transactions(txs);
-
-        size_t tx_weight;
-        uint64_t fee;
-        bool relayed, do_not_relay, double_spend_seen;
-        transaction pool_tx;
-        blobdata txblob;
-        for(const transaction &tx : txs)
-        {
-          crypto::hash tx_hash = get_transaction_hash(tx);
-          m_tx_pool.take_tx(tx_hash, pool_tx, txblob, tx_weight, fee, relayed, do_not_relay, double_spend_seen);
-        }
+        crypto::hash tx_hash = get_transaction_hash(tx);
+        m_tx_pool.take_tx(tx_hash, pool_tx, txblob, tx_weight, fee, relayed, do_not_relay, double_spend_seen);
       }
     }
   }
@@ -5614,17 +6582,61 @@ bool Blockchain::for_all_outputs(uint64_t amount, std::function<bool(uint64_t he
 void Blockchain::invalidate_block_template_cache()
 {
   MDEBUG("Invalidating block template cache");
-  m_btc_valid = false;
+  m_btc.clear();
 }
 
-void Blockchain::cache_block_template(const block &b, const cryptonote::account_public_address &address, const blobdata &nonce, const difficulty_type &diff, uint64_t height, uint64_t expected_reward, uint64_t pool_cookie)
+void Blockchain::publish_chain_tip_snapshot()
+{
+  auto snapshot = std::make_shared<chain_tip_snapshot>();
+  uint64_t top_height;
+  snapshot->top_hash = m_db->top_block_hash(&top_height);
+  snapshot->height = top_height + 1;
+  snapshot->top_timestamp = m_db->get_block_timestamp(top_height);
+  snapshot->cumulative_difficulty = m_db->get_block_cumulative_difficulty(top_height);
+  // primes m_cache, which verification of the next block would fill anyway
+  snapshot->next_difficulty = get_difficulty_for_next_block(false /*pulse*/);
+  snapshot->block_weight_limit = m_current_block_cumul_weight_limit;
+  snapshot->block_weight_median = m_current_block_cumul_weight_median;
+  snapshot->tx_count = m_db->get_tx_count();
+  snapshot->hf_version = get_network_version(snapshot->height);
+  std::atomic_store(&m_chain_tip_snapshot, std::shared_ptr<const chain_tip_snapshot>{std::move(snapshot)});
+}
+
+Blockchain::cached_block_template& Blockchain::cache_block_template(const block &b, const cryptonote::account_public_address &address, const blobdata &nonce, uint64_t height, uint64_t expected_reward, uint64_t pool_cookie)
 {
   MDEBUG("Setting block template cache");
-  m_btc = b;
-  m_btc_address = address;
-  m_btc_nonce = nonce;
-  m_btc_height = height;
-  m_btc_expected_reward = expected_reward;
+  // Templates built on another tip or other pool contents than the ones already cached replace them
+  if (!m_btc.empty() && (m_btc_pool_cookie != pool_cookie || m_btc.back().b.prev_id != b.prev_id))
+    m_btc.clear();
+  else if (m_btc.size() >= BLOCK_TEMPLATE_CACHE_SIZE)
+    m_btc.erase(m_btc.begin());
   m_btc_pool_cookie = pool_cookie;
-  m_btc_valid = true;
+  auto& t = m_btc.emplace_back();
+  t.b = b;
+  t.address = address;
+  t.nonce = nonce;
+  t.height = height;
+  t.expected_reward = expected_reward;
+  return t;
+}
+
+void Blockchain::get_block_template_blobs(cached_block_template& t, block_template_blobs& blobs)
+{
+  auto header_head = [](const block& b) {
+    std::string head;
+    head += tools::get_varint_data(b.major_version);
+    head += tools::get_varint_data(b.minor_version);
+    head += tools::get_varint_data(b.timestamp);
+    return head;
+  };
+  if (t.block_tail.empty())
+  {
+    const size_t skip = header_head(t.b).size();
+    t.block_tail = t_serializable_object_to_blob(t.b).substr(skip);
+    t.hashing_tail = get_block_hashing_blob(t.b).substr(skip);
+  }
+  blobs.block_blob = header_head(t.b);
+  blobs.hashing_blob = blobs.block_blob;
+  blobs.block_blob += t.block_tail;
+  blobs.hashing_blob += t.hashing_tail;
 }
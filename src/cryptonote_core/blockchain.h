@@ -30,6 +30,7 @@
 
 #pragma once
 #include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/serialization/serialization.hpp>
 #include <boost/serialization/version.hpp>
 
@@ -45,7 +46,9 @@
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
 #include <atomic>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -54,20 +57,27 @@
 #include "epee/rolling_median.h"
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "common/util.h"
+#include "common/threadpool.h"
+#include "common/instrumented_mutex.h"
+#include "common/cache_budget.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "cryptonote_basic/difficulty.h"
 #include "cryptonote_tx_utils.h"
 #include "cryptonote_basic/verification_context.h"
+#include "cryptonote_basic/tx_view.h"
 #include "crypto/hash.h"
 #include "checkpoints/checkpoints.h"
 #include "blockchain_db/blockchain_db.h"
 #include "cryptonote_core/oxen_name_system.h"
+#include "cryptonote_core/served_blocks_cache.h"
+#include "cryptonote_core/recent_outputs_cache.h"
+#include "cryptonote_core/txpool_store.h"
 #include "pulse.h"
 
 struct sqlite3;
 namespace service_nodes { class service_node_list; };
-namespace tools { class Notify; }
+namespace tools { class Notify; class AsyncNotify; }
 
 namespace cryptonote
 {
@@ -90,7 +100,8 @@ namespace cryptonote
     db_defaultsync, //!< user didn't specify, use db_async
     db_sync,  //!< handle syncing calls instead of the backing db, synchronously
     db_async, //!< handle syncing calls instead of the backing db, asynchronously
-    db_nosync //!< Leave syncing up to the backing db (safest, but slowest because of disk I/O)
+    db_nosync, //!< Leave syncing up to the backing db (safest, but slowest because of disk I/O)
+    db_group //!< asynchronously, at most every so many ms or bytes, together with the SN list and ONS db
   };
 
   /** 
@@ -252,6 +263,20 @@ namespace cryptonote
      */
     bool prepare_handle_incoming_blocks(const std::vector<block_complete_entry>  &blocks_entry, std::vector<block> &blocks);
 
+    /**
+     * @brief starts computing, in the background, the PoW hashes of a span of blocks that will be
+     * handled after the span currently being added
+     *
+     * This lets the PoW stage of span N+1 overlap with the validation and DB commit of span N; the
+     * results are picked up by prepare_handle_incoming_blocks when span N+1 is prepared.  Intended
+     * to be called right after span N has been prepared: at most one span of lookahead is kept, and
+     * only blocks whose RandomX seed is already in the chain are hashed.
+     *
+     * @param height the height of the first block of the span
+     * @param blocks_entry the blocks of the span
+     */
+    void precompute_block_longhashes(uint64_t height, const std::vector<block_complete_entry> &blocks_entry);
+
     /**
      * @brief incoming blocks post-processing, cleanup, and disk sync
      *
@@ -279,6 +304,18 @@ namespace cryptonote
      */
     bool have_tx_keyimges_as_spent(const transaction &tx) const;
 
+    /**
+     * @brief check if any key image in a transaction has already been spent
+     *
+     * As above, but for a tx that hasn't been fully parsed; the lookups all share one read txn.
+     *
+     * @param view the view of the transaction to check
+     *
+     * @return true if any key image is already spent in the blockchain (or if the tx has an input
+     * that isn't a txin_to_key), else false
+     */
+    bool have_tx_keyimges_as_spent(const transaction_view &view) const;
+
     /**
      * @brief check if a key image is already spent on the blockchain
      *
@@ -293,6 +330,16 @@ namespace cryptonote
      */
     bool have_tx_keyimg_as_spent(const crypto::key_image &key_im) const;
 
+    /**
+     * @brief check if each of several key images is already spent on the blockchain
+     *
+     * As have_tx_keyimg_as_spent(), but the lookups all share one read txn.
+     *
+     * @param key_images the key images to search for
+     * @param spent return-by-reference whether each of key_images is spent
+     */
+    void have_tx_keyimgs_as_spent(const std::vector<crypto::key_image> &key_images, std::vector<bool> &spent) const;
+
     /**
      * @brief get the current height of the blockchain
      *
@@ -318,6 +365,32 @@ namespace cryptonote
      */
     crypto::hash get_tail_id(uint64_t& height) const;
 
+    /**
+     * @brief immutable summary of the chain tip, republished whenever the main chain changes
+     */
+    struct chain_tip_snapshot
+    {
+      uint64_t height;                       // blockchain height, i.e. top block height + 1
+      crypto::hash top_hash;
+      uint64_t top_timestamp;
+      difficulty_type cumulative_difficulty; // of the top block
+      difficulty_type next_difficulty;       // PoW difficulty of the next (non-pulse) block
+      uint64_t block_weight_limit;
+      uint64_t block_weight_median;
+      uint64_t tx_count;
+      uint8_t hf_version;                    // network version of the next block
+    };
+
+    /**
+     * @brief get the most recently published chain tip snapshot
+     *
+     * Does not take the blockchain lock, so read-only callers such as RPC can use it without
+     * contending with block processing.  The snapshot may lag a block being added concurrently.
+     *
+     * @return the snapshot; null only before init() has finished
+     */
+    std::shared_ptr<const chain_tip_snapshot> get_chain_tip_snapshot() const { return std::atomic_load(&m_chain_tip_snapshot); }
+
     /**
      * @brief returns the difficulty target the next block to be added must meet
      *
@@ -352,6 +425,15 @@ namespace cryptonote
      */
     bool reset_and_set_genesis_block(const block& b);
 
+    /**
+     * @brief the serialized forms of a block template, as handed out to pool software
+     */
+    struct block_template_blobs
+    {
+      blobdata block_blob;   // the serialized block
+      blobdata hashing_blob; // get_block_hashing_blob() of the block
+    };
+
     /**
      * @brief creates a new block to mine against
      *
@@ -362,10 +444,13 @@ namespace cryptonote
      * @param height return-by-reference tells the miner what height it's mining against
      * @param expected_reward return-by-reference the total reward awarded to the miner finding this block, including transaction fees
      * @param ex_nonce extra data to be added to the miner transaction's extra
+     * @param blobs if given, filled with the serialized block and its hashing blob; for a template
+     * served from the template cache these are patched from cached serializations rather than
+     * serialized and hashed again
      *
      * @return true if block template filled in successfully, else false
      */
-    bool create_miner_block_template     (block& b, const crypto::hash *from_block, const account_public_address& miner_address, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce);
+    bool create_miner_block_template     (block& b, const crypto::hash *from_block, const account_public_address& miner_address, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce, block_template_blobs* blobs = nullptr);
     bool create_next_miner_block_template(block& b, const account_public_address& miner_address, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce);
 
     /**
@@ -583,6 +668,24 @@ namespace cryptonote
     bool get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs) const;
     bool get_tx_outputs_gindexs(const crypto::hash& tx_id, size_t n_txes, std::vector<std::vector<uint64_t>>& indexs) const;
 
+    /**
+     * @brief gets the global indices for the outputs of the transactions of consecutive blocks
+     *
+     * One transaction lookup and a single scan for the whole run of blocks, rather than a lookup
+     * per block or transaction (see BlockchainDB::get_blocks_tx_amount_output_indices).
+     *
+     * @param tx_id the hash of a transaction of the first block with any to find by
+     * @param tx_offset the position of `tx_id` among the blocks' transactions, counting from the
+     * first block's miner transaction (0 if it is that miner transaction)
+     * @param block_txes the number of (non-miner) transactions of each block
+     * @param miner_txes whether to include the miner transactions' indices, first in each block's
+     * @param indexs return-by-reference, for each block, the global indices of its transactions'
+     * outputs
+     *
+     * @return false if the transaction does not exist, otherwise true
+     */
+    bool get_blocks_tx_outputs_gindexs(const crypto::hash& tx_id, size_t tx_offset, const std::vector<size_t>& block_txes, bool miner_txes, std::vector<std::vector<std::vector<uint64_t>>>& indexs) const;
+
     /**
      * @brief stores the blockchain
      *
@@ -776,19 +879,53 @@ namespace cryptonote
     void set_user_options(uint64_t maxthreads, bool sync_on_blocks, uint64_t sync_threshold,
         blockchain_db_sync_mode sync_mode, bool fast_sync);
 
+    /**
+     * @brief sets the limits of the db_group sync mode
+     *
+     * In db_group mode, written blocks are made durable by a single background flush that also
+     * stores the service node list and checkpoints the ONS database, instead of each of them
+     * syncing on their own schedule.  A flush starts at most `max_delay` after the first write
+     * since the last one, or as soon as `max_bytes` of block data are waiting, whichever is first.
+     *
+     * @param max_delay the longest a written block waits for a flush
+     * @param max_bytes the most block data that waits for a flush
+     */
+    void set_group_sync(std::chrono::milliseconds max_delay, uint64_t max_bytes);
+
+    /**
+     * @brief sets how many of the most recent RCT outputs get_outs() answers from memory
+     *
+     * Meant to be set before init(), which loads them; 0 disables the cache.
+     *
+     * @param max_outputs the number of outputs to cache
+     */
+    void set_recent_outputs_cache_size(size_t max_outputs) { m_recent_outputs.set_max_outputs(max_outputs); update_recent_outputs_size(); }
+
+    /**
+     * @brief whether db_group mode is on, in which case the service node list is stored by the
+     * group flushes and doesn't need storing on its own timer
+     */
+    bool group_sync() const { return m_db_sync_mode == db_group; }
+
     /**
      * @brief sets a block notify object to call for every new block
      *
+     * The notifications run from a background thread, so they never hold up adding blocks.
+     *
      * @param notify the notify object to call at every new block
+     * @param coalesce if a block is added before the notification for the previous one has run,
+     * only notify for the newer one (as happens for most blocks while syncing)
      */
-    void set_block_notify(const std::shared_ptr<tools::Notify> &notify) { m_block_notify = notify; }
+    void set_block_notify(const std::shared_ptr<tools::Notify> &notify, bool coalesce = true);
 
     /**
      * @brief sets a reorg notify object to call for every reorg
      *
+     * Like block notifications, these run from a background thread; they are never coalesced.
+     *
      * @param notify the notify object to call at every reorg
      */
-    void set_reorg_notify(const std::shared_ptr<tools::Notify> &notify) { m_reorg_notify = notify; }
+    void set_reorg_notify(const std::shared_ptr<tools::Notify> &notify);
 
     /**
      * @brief Put DB in safe sync mode
@@ -924,6 +1061,55 @@ namespace cryptonote
     void output_scan_worker(const uint64_t amount,const std::vector<uint64_t> &offsets,
         std::vector<output_data_t> &outputs) const;
 
+    /**
+     * @brief verifies the ring signatures and range proofs of all txes of an incoming block span in
+     * batches
+     *
+     * Must be called after m_scan_table has been populated for the span; the per-tx ring signature
+     * results are stored in m_rct_ver_table for check_tx_inputs to use, and txes whose range proofs
+     * passed the span-wide batch are stored in m_rct_semantics_verified.
+     *
+     * @param blocks_entry the incoming blocks, as passed to prepare_handle_incoming_blocks
+     */
+    void batch_verify_incoming_txs(const std::vector<block_complete_entry> &blocks_entry);
+
+    /**
+     * @brief looks up the ring members of a batch of incoming txes in bulk
+     *
+     * Does the same bulk, sorted per-amount lookup that is done for the txes of incoming blocks,
+     * so that check_tx_inputs() doesn't have to look up each of these txes' inputs on its own.  The
+     * results stay around until clear_prefetched_ring_members() is called (or a block is popped).
+     *
+     * @param txs the txes about to be added to the pool
+     */
+    void prefetch_ring_members(const std::vector<const transaction*> &txs);
+
+    /**
+     * @brief drops the ring members stored by prefetch_ring_members()
+     */
+    void clear_prefetched_ring_members();
+
+    /// txid => { digest of the mix ring the signatures were checked against, whether they're valid }
+    using ring_signature_results = std::unordered_map<crypto::hash, std::pair<crypto::hash, bool>>;
+
+    /**
+     * @brief verifies the ring signatures of a set of txes in parallel, without taking the
+     * blockchain lock
+     *
+     * Txes that aren't rct, or whose ring members can't all be found, are left out of the results.
+     *
+     * @param blobs the tx blobs
+     *
+     * @return the results, for add_ring_signature_results()
+     */
+    ring_signature_results verify_ring_signatures(const std::vector<const blobdata*> &blobs) const;
+
+    /**
+     * @brief makes results of verify_ring_signatures() available to check_tx_inputs, until the
+     * next incoming block span or pop replaces them
+     */
+    void add_ring_signature_results(ring_signature_results results);
+
     /**
      * @brief computes the "short" and "long" hashes for a set of blocks
      *
@@ -945,16 +1131,40 @@ namespace cryptonote
     void update_txpool_tx(const crypto::hash &txid, const txpool_tx_meta_t &meta);
     void remove_txpool_tx(const crypto::hash &txid);
     uint64_t get_txpool_tx_count(bool include_unrelayed_txes = true) const;
+    bool txpool_has_tx(const crypto::hash &txid) const;
     bool get_txpool_tx_meta(const crypto::hash& txid, txpool_tx_meta_t &meta) const;
     bool get_txpool_tx_blob(const crypto::hash& txid, cryptonote::blobdata &bd) const;
     cryptonote::blobdata get_txpool_tx_blob(const crypto::hash& txid) const;
     bool for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata*)>, bool include_blob = false, bool include_unrelayed_txes = true) const;
 
+    /**
+     * @brief writes the tx pool changes made since the last call to the database
+     *
+     * The txpool_* methods above work on an in-memory copy of the pool (see txpool_store); this
+     * carries their changes over to the database in one write txn.  Called after each batch of
+     * incoming blocks, periodically by core, and on shutdown.
+     */
+    void flush_txpool();
+
+    /// @brief the in-memory tx pool store; only for LockedTXN to group changes
+    txpool_store& get_txpool_store() { return m_txpool_store; }
+
     bool is_within_compiled_block_hash_area(uint64_t height) const;
     bool is_within_compiled_block_hash_area() const { return is_within_compiled_block_hash_area(m_db->height()); }
+
+    /**
+     * @brief checks whether a tx's rct semantics were already verified while preparing the
+     * incoming block span it belongs to
+     *
+     * @param txid the tx hash
+     *
+     * @return true if the tx passed the span-wide batched range proof verification
+     */
+    bool rct_semantics_preverified(const crypto::hash &txid) const;
     uint64_t prevalidate_block_hashes(uint64_t height, const std::vector<crypto::hash> &hashes);
     uint32_t get_blockchain_pruning_seed() const { return m_db->get_blockchain_pruning_seed(); }
     bool prune_blockchain(uint32_t pruning_seed = 0);
+    bool prune_blockchain_batch(uint32_t pruning_seed, size_t max_records);
     bool update_blockchain_pruning();
     bool check_blockchain_pruning();
 
@@ -1038,7 +1248,7 @@ namespace cryptonote
       service_nodes::payout  service_node_payout;
     };
 
-    bool create_block_template_internal(block& b, const crypto::hash *from_block, block_template_info const &info, difficulty_type& di, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce);
+    bool create_block_template_internal(block& b, const crypto::hash *from_block, block_template_info const &info, difficulty_type& di, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce, block_template_blobs* blobs = nullptr);
 
     bool load_missing_blocks_into_oxen_subsystems();
 
@@ -1056,19 +1266,83 @@ namespace cryptonote
     service_nodes::service_node_list& m_service_node_list;
     ons::name_system_db               m_ons_db;
 
-    mutable std::recursive_mutex m_blockchain_lock; // TODO: add here reader/writer lock
+    mutable tools::instrumented_mutex<> m_blockchain_lock{"blockchain"}; // TODO: add here reader/writer lock
 
     // main chain
     size_t m_current_block_cumul_weight_limit;
     size_t m_current_block_cumul_weight_median;
 
     // metadata containers
-    std::unordered_map<crypto::hash, std::unordered_map<crypto::key_image, std::vector<output_data_t>>> m_scan_table;
+    // Ring members of the txes of the span being handled, looked up in bulk by
+    // prepare_handle_incoming_blocks so that check_tx_inputs doesn't have to go to the db for them.
+    // All the rings are stored back to back in one buffer; a tx is looked up once, by prefix hash,
+    // and its inputs' rings are then indexed by input.
+    struct scan_table
+    {
+      struct ring
+      {
+        size_t begin; // index of the first ring member in `outputs`
+        size_t size;  // ring members found; less than the ring size if the rest weren't in the db yet
+      };
+
+      std::vector<output_data_t> outputs;
+      std::vector<ring> rings;
+      // tx prefix hash -> index of the tx's first input in `rings`
+      std::unordered_map<crypto::hash, size_t> txs;
+
+      void clear() { outputs.clear(); rings.clear(); txs.clear(); }
+      // Frees the memory that clear() keeps for the next span
+      void release() { outputs = {}; rings = {}; txs = {}; }
+      // Heap memory held, including what clear() kept
+      size_t bytes() const
+      {
+        return outputs.capacity() * sizeof(output_data_t) + rings.capacity() * sizeof(ring)
+          + txs.size() * tools::cache_budget::node_bytes<decltype(txs)> + txs.bucket_count() * sizeof(void*);
+      }
+
+      // Returns the rings of the `inputs` inputs of the given tx, or an empty span if the tx isn't
+      // in the table (or has a different number of inputs).
+      epee::span<const ring> find(const crypto::hash &tx_prefix_hash, size_t inputs) const
+      {
+        auto it = txs.find(tx_prefix_hash);
+        if (it == txs.end() || it->second + inputs > rings.size())
+          return {};
+        return {rings.data() + it->second, inputs};
+      }
+
+      epee::span<const output_data_t> members(const ring &r) const { return {outputs.data() + r.begin, r.size}; }
+    };
+    scan_table m_scan_table;
+    // The same for a batch of incoming mempool txes; see prefetch_ring_members()
+    scan_table m_prefetched_rings;
+
+    // Fills `table` with the ring members of the given (tx, tx prefix hash)es; returns false if two
+    // of them have the same prefix hash or the blockchain is being cancelled.
+    bool build_scan_table(scan_table &table, const std::vector<std::pair<const transaction*, crypto::hash>> &txes) const;
+    // Registration of m_scan_table and m_prefetched_rings with the daemon's cache budget.  Their
+    // memory is only given back between spans (when nothing holds the blockchain lock).
+    tools::cache_budget::handle m_scan_table_budget;
+    void update_scan_table_size() const { m_scan_table_budget.set_size(m_scan_table.bytes() + m_prefetched_rings.bytes()); }
     std::unordered_map<crypto::hash, crypto::hash> m_blocks_longhash_table;
-
-    // Keccak hashes for each block and for fast pow checking
-    std::vector<crypto::hash> m_blocks_hash_of_hashes;
+    // tx hash -> (digest of the ring members checked, ring signatures valid) for the span being handled
+    ring_signature_results m_rct_ver_table;
+    // txes of the span being handled whose rct semantics (range proofs) passed the span-wide batch
+    std::unordered_set<crypto::hash> m_rct_semantics_verified;
+
+    // PoW hashes computed ahead of time for the next incoming span (see precompute_block_longhashes)
+    struct longhash_lookahead_entry { crypto::hash seed_hash; crypto::hash pow; };
+    std::unordered_map<crypto::hash, longhash_lookahead_entry> m_blocks_longhash_lookahead;
+    mutable std::mutex m_blocks_longhash_lookahead_mutex;
+    tools::threadpool::waiter m_blocks_longhash_lookahead_waiter;
+
+    // Keccak hashes for each block and for fast pow checking.  m_blocks_hash_of_hashes points into
+    // the compiled-in data, which lives as long as the process; m_blocks_hash_check holds the
+    // (prevalidated) block hashes from height m_blocks_hash_check_start on.
+    epee::span<const crypto::hash> m_blocks_hash_of_hashes;
     std::vector<crypto::hash> m_blocks_hash_check;
+    uint64_t m_blocks_hash_check_start = 0;
+    // The height below which blocks are covered by m_blocks_hash_check (0 once it has been freed)
+    uint64_t blocks_hash_check_end() const { return m_blocks_hash_check.empty() ? 0 : m_blocks_hash_check_start + m_blocks_hash_check.size(); }
     std::vector<crypto::hash> m_blocks_txs_check;
 
     blockchain_db_sync_mode m_db_sync_mode;
@@ -1082,6 +1356,8 @@ namespace cryptonote
     uint64_t m_fake_scan_time;
     uint64_t m_sync_counter;
     uint64_t m_bytes_to_sync;
+    std::chrono::milliseconds m_group_sync_max_delay{5000};
+    uint64_t m_group_sync_max_bytes{64 * 1024 * 1024};
 
     uint64_t m_long_term_block_weights_window;
     uint64_t m_long_term_effective_median_block_weight;
@@ -1097,9 +1373,9 @@ namespace cryptonote
     {
       std::mutex m_difficulty_lock;
 
-      // NOTE: PoW Difficulty Calculation Metadata
-      std::vector<uint64_t> m_timestamps;
-      std::vector<difficulty_type> m_difficulties;
+      // NOTE: PoW Difficulty Calculation Metadata, kept up to date as main chain blocks are added
+      // and popped; valid when m_timestamps_and_difficulties_height is the chain height.
+      difficulty_window m_difficulty_window;
 
       // NOTE: Cache Invalidation Checks
       uint64_t m_timestamps_and_difficulties_height{0};
@@ -1107,10 +1383,62 @@ namespace cryptonote
       difficulty_type m_difficulty_for_next_miner_block{1};
     } m_cache;
 
+    // Entries recently sent in NOTIFY_RESPONSE_GET_BLOCKS for blocks old enough that their entry
+    // won't change, and the start of the span last handed to BlockchainDB::prefetch_blocks.
+    served_blocks_cache m_served_blocks;
+    uint64_t m_served_blocks_prefetch_height = 0;
+
+    // The most recent RCT outputs, which most ring members requested through get_outs() are.  Kept
+    // in step with the chain: loaded in init(), appended to as blocks are added and truncated as
+    // they are popped.
+    recent_outputs_cache m_recent_outputs;
+    tools::cache_budget::handle m_recent_outputs_budget;
+    void update_recent_outputs_size() const { m_recent_outputs_budget.set_size(m_recent_outputs.size() * recent_outputs_cache::OUTPUT_BYTES); }
+    // Adds the RCT outputs from global index `from_index` to the end of the chain (or the last
+    // ones of those, up to the cache's size) to m_recent_outputs
+    void cache_recent_outputs(uint64_t from_index);
+    // Drops the outputs of popped blocks from m_recent_outputs
+    void truncate_recent_outputs();
+
+    // Running sums of the governance share of recent pre-HF15 blocks, for the batched payouts of
+    // calc_batched_governance_reward(): entry i is the sum over the blocks from
+    // m_governance_sums_height up to (not including) m_governance_sums_height + i, so that a payout
+    // is the difference of two entries instead of a re-read of the whole interval.  Appended to as
+    // blocks are added and truncated as they are popped; stays empty from HF15 on (fixed payouts).
+    std::deque<uint64_t> m_governance_sums;
+    uint64_t m_governance_sums_height = 0;
+    void governance_sums_block_added(uint64_t height, uint64_t governance);
+    // Drops the sums of blocks at `height` and above
+    void truncate_governance_sums(uint64_t height);
+
+    // Parsed copies of the alternative blocks in the DB, so that extending a long fork doesn't
+    // re-read and re-parse the whole fork from the DB for every new block on it.  Only ever holds
+    // blocks that are in the DB's alt_blocks (which stays the authority: a miss falls back to it),
+    // and gets emptied if it grows past ALT_BLOCKS_CACHE_MAX.
+    static constexpr size_t ALT_BLOCKS_CACHE_MAX = 1000;
+    mutable std::unordered_map<crypto::hash, std::shared_ptr<const block_extended_info>> m_alt_blocks_cache;
+
+    txpool_store m_txpool_store;
+
+    std::shared_ptr<const chain_tip_snapshot> m_chain_tip_snapshot; // only accessed via std::atomic_load/store
+
     boost::asio::io_service m_async_service;
     std::thread m_async_thread;
     std::unique_ptr<boost::asio::io_service::work> m_async_work_idle;
 
+    // db_group state; only used from the m_async_service thread.  The generation lets a timer
+    // handler that was already queued when its timer got cancelled tell that it is stale.
+    boost::asio::steady_timer m_group_sync_timer{m_async_service};
+    bool m_group_sync_armed = false;
+    uint64_t m_group_sync_generation = 0;
+
+    // Called (on the async thread) after blocks were written in db_group mode: arms the flush
+    // timer, or flushes right away if `now`.
+    void schedule_group_sync(bool now);
+    // The coordinated flush: stores the service node list and checkpoints the ONS database under
+    // the blockchain lock, then syncs the blockchain db (which makes the SN list durable too).
+    void run_group_sync();
+
     // some invalid blocks
     std::set<crypto::hash> m_invalid_blocks;
 
@@ -1128,20 +1456,31 @@ namespace cryptonote
 
     std::atomic<bool> m_cancel;
 
-    // block template cache
-    block m_btc;
-    account_public_address m_btc_address;
-    blobdata m_btc_nonce;
-    uint64_t m_btc_height;
+    // block template cache: the miner templates built on the current tip with the current pool
+    // contents, one per (address, extra nonce), so that pools asking for several reserve sizes or
+    // payout addresses each get theirs back without a rebuild.
+    struct cached_block_template
+    {
+      block b;
+      account_public_address address;
+      blobdata nonce;
+      uint64_t height;
+      uint64_t expected_reward;
+      // The serialized block and hashing blob, minus the leading version and timestamp varints:
+      // the timestamp is all that changes when a cached template is handed out again.  Empty until
+      // first asked for.
+      blobdata block_tail;
+      blobdata hashing_tail;
+    };
+    static constexpr size_t BLOCK_TEMPLATE_CACHE_SIZE = 8;
+    std::vector<cached_block_template> m_btc; // most recently used last
     uint64_t m_btc_pool_cookie;
-    uint64_t m_btc_expected_reward;
-    bool m_btc_valid;
 
 
     bool m_batch_success;
 
-    std::shared_ptr<tools::Notify> m_block_notify;
-    std::shared_ptr<tools::Notify> m_reorg_notify;
+    std::shared_ptr<tools::AsyncNotify> m_block_notify;
+    std::shared_ptr<tools::AsyncNotify> m_reorg_notify;
 
     // for prepare_handle_incoming_blocks
     uint64_t m_prepare_height;
@@ -1164,14 +1503,14 @@ namespace cryptonote
      * @tparam visitor_t a class encapsulating tx is unlocked and collect tx key
      * @param tx_in_to_key a transaction input instance
      * @param vis an instance of the visitor to use
-     * @param tx_prefix_hash the hash of the associated transaction_prefix
+     * @param prefetched the leading ring members already looked up in m_scan_table, if any
      * @param pmax_related_block_height return-by-pointer the height of the most recent block in the input set
      * @param tx_version version of the tx, if > 1 we also get commitments
      *
      * @return false if any keys are not found or any inputs are not unlocked, otherwise true
      */
     template<class visitor_t>
-    bool scan_outputkeys_for_indexes(const txin_to_key& tx_in_to_key, visitor_t &vis, const crypto::hash &tx_prefix_hash, uint64_t* pmax_related_block_height = NULL) const;
+    bool scan_outputkeys_for_indexes(const txin_to_key& tx_in_to_key, visitor_t &vis, epee::span<const output_data_t> prefetched, uint64_t* pmax_related_block_height = NULL) const;
 
     /**
      * @brief collect output public keys of a transaction input set
@@ -1184,13 +1523,13 @@ namespace cryptonote
      * of the most recent block which contains an output used in the input set
      *
      * @param txin the transaction input
-     * @param tx_prefix_hash the transaction prefix hash, for caching organization
+     * @param prefetched the leading ring members already looked up in m_scan_table, if any
      * @param output_keys return-by-reference the public keys of the outputs in the input set
      * @param pmax_related_block_height return-by-pointer the height of the most recent block in the input set
      *
      * @return false if any output is not yet unlocked, or is missing, otherwise true
      */
-    bool check_tx_input(const txin_to_key& txin, const crypto::hash& tx_prefix_hash, std::vector<rct::ctkey> &output_keys, uint64_t* pmax_related_block_height);
+    bool check_tx_input(const txin_to_key& txin, epee::span<const output_data_t> prefetched, std::vector<rct::ctkey> &output_keys, uint64_t* pmax_related_block_height);
 
     /**
      * @brief validate a transaction's inputs and their keys
@@ -1239,6 +1578,19 @@ namespace cryptonote
      */
     block pop_block_from_blockchain();
 
+    /**
+     * @brief removes main chain blocks until the chain height is `height`, for a reorg
+     *
+     * Does what repeated pop_block_from_blockchain() calls would, but in one DB batch and with the
+     * per-block work done once for the whole span: the popped txes go back to the pool together,
+     * ONS gets a single detach to `height`, and the ring signature results gathered for the
+     * incoming blocks are kept (they are only used for exactly matching rings).
+     *
+     * @param height the chain height to pop back to
+     * @param disconnected if given, the popped blocks (oldest first) get put here
+     */
+    void pop_blocks_to_height(uint64_t height, std::list<block_and_checkpoint>* disconnected = nullptr);
+
     /**
      * @brief validate and add a new block to the end of the blockchain
      *
@@ -1282,6 +1634,17 @@ namespace cryptonote
      */
     bool build_alt_chain(const crypto::hash &prev_id, std::list<block_extended_info>& alt_chain, std::vector<uint64_t> &timestamps, block_verification_context& bvc, int *num_alt_checkpoints, int *num_checkpoints);
 
+    /**
+     * @brief looks up a block in the DB's alternative blocks, parsed, via m_alt_blocks_cache
+     *
+     * @return the block (with its alt_block_data_t and checkpoint), or nullptr if it isn't an alt block
+     */
+    std::shared_ptr<const block_extended_info> get_alt_block(const crypto::hash &id) const;
+
+    // Add/remove alternative blocks to/from both the DB and m_alt_blocks_cache
+    void add_alt_block(const crypto::hash &id, const alt_block_data_t &data, const block &b, const checkpoint_t *checkpoint);
+    void remove_alt_block(const crypto::hash &id);
+
     /**
      * @brief gets the difficulty requirement for a new block on an alternate chain
      *
@@ -1449,6 +1812,19 @@ namespace cryptonote
      * @return true
      */
     bool update_next_cumulative_weight_limit(uint64_t *long_term_effective_median_block_weight = NULL);
+
+    /**
+     * @brief the timestamps and cumulative difficulties of the main chain blocks [start_height,
+     * stop_height), or as many of the most recent of those as fit in a difficulty_window
+     *
+     * Uses the cached window of the top blocks (and reads whatever it doesn't cover from the DB)
+     * so that evaluating a fork near the top of the chain needs few or no DB reads.
+     */
+    difficulty_window get_difficulty_window(uint64_t start_height, uint64_t stop_height) const;
+
+    // Keeps m_cache.m_difficulty_window in step with the main chain; the blockchain lock must be held.
+    void difficulty_window_block_added(uint64_t timestamp, difficulty_type cumulative_difficulty, uint64_t chain_height);
+    void difficulty_window_block_popped(uint64_t chain_height);
     void return_tx_to_pool(std::vector<std::pair<transaction, blobdata>> &txs);
 
     /**
@@ -1498,11 +1874,23 @@ namespace cryptonote
      */
     void invalidate_block_template_cache();
 
+    /**
+     * @brief builds a chain_tip_snapshot of the current top block and publishes it for lock-free
+     * readers.  Must be called with the blockchain lock held.
+     */
+    void publish_chain_tip_snapshot();
+
     /**
      * @brief stores a new cached block template
      *
      * At some point, may be used to push an update to miners
      */
-    void cache_block_template(const block &b, const cryptonote::account_public_address &address, const blobdata &nonce, const difficulty_type &diff, uint64_t height, uint64_t expected_reward, uint64_t pool_cookie);
+    cached_block_template& cache_block_template(const block &b, const cryptonote::account_public_address &address, const blobdata &nonce, uint64_t height, uint64_t expected_reward, uint64_t pool_cookie);
+
+    /**
+     * @brief fills `blobs` from a cached template, serializing it on first use and afterwards only
+     * writing the (varint) version and timestamp fields in front of the cached serializations
+     */
+    static void get_block_template_blobs(cached_block_template& t, block_template_blobs& blobs);
   };
 }  // namespace cryptonote
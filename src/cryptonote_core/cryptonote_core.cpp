@@ -53,6 +53,9 @@ extern "C" {
 #include "common/file.h"
 #include "common/sha256sum.h"
 #include "common/threadpool.h"
+#include "common/metrics.h"
+#include "common/cache_budget.h"
+#include "common/instrumented_mutex.h"
 #include "common/command_line.h"
 #include "common/hex.h"
 #include "common/base58.h"
@@ -67,6 +70,8 @@ extern "C" {
 #include "ringct/rctTypes.h"
 #include "blockchain_db/blockchain_db.h"
 #include "ringct/rctSigs.h"
+#include "ringct/bulletproofs.h"
+#include "ringct/multiexp_backend.h"
 #include "common/notify.h"
 #include "version.h"
 #include "epee/memwipe.h"
@@ -83,6 +88,7 @@ DISABLE_VS_WARNINGS(4355)
 #define MERROR_VER(x) MCERROR("verify", x)
 
 #define BAD_SEMANTICS_TXES_MAX_SIZE 100
+#define INCOMING_TX_CACHE_MAX_SIZE 16384
 
 // basically at least how many bytes the block itself serializes to without the miner tx
 #define BLOCK_SIZE_SANITY_LEEWAY 100
@@ -141,6 +147,16 @@ namespace cryptonote
   , "Set maximum size of block download queue in bytes (0 for default)"
   , 0
   };
+  const command_line::arg_descriptor<bool> arg_block_download_spill  = {
+    "block-download-spill"
+  , "Move downloaded blocks that are waiting to be verified to a temporary file in the data directory, rather than holding them in memory, once the block download queue reaches its maximum size"
+  , false
+  };
+  const command_line::arg_descriptor<size_t> arg_tx_verify_threads  = {
+    "tx-verify-threads"
+  , "Number of threads verifying transactions received from peers, rather than the p2p network threads (0 to verify them on the network threads)"
+  , 1
+  };
 
   static const command_line::arg_descriptor<bool> arg_test_drop_download = {
     "test-drop-download"
@@ -171,6 +187,36 @@ namespace cryptonote
   , "How many blocks to sync at once during chain synchronization (0 = adaptive)."
   , 0
   };
+  static const command_line::arg_descriptor<size_t> arg_bp_cache_mb  = {
+    "bp-cache-mb"
+  , "Memory (in MB) to use for precomputed bulletproof verification tables; the default covers the largest transaction batches."
+  , BULLETPROOF_DEFAULT_CACHE_SIZE >> 20
+  };
+  static const command_line::arg_descriptor<std::string> arg_multiexp_backend  = {
+    "multiexp-backend"
+  , "Implementation of the multiexp that batch bulletproof verification ends in: cpu, or another backend compiled into this build."
+  , "cpu"
+  };
+  static const command_line::arg_descriptor<size_t> arg_multiexp_backend_check  = {
+    "multiexp-backend-check"
+  , "With a --multiexp-backend other than cpu, recompute 1 in this many of its results on the CPU, dropping the backend if one differs (0 to not check)."
+  , 100
+  };
+  static const command_line::arg_descriptor<size_t> arg_cache_budget_mb  = {
+    "cache-budget-mb"
+  , "Memory (in MB) that the daemon's caches (parsed tx pool transactions, ring member lookups, recent outputs, ONS lookups and RPC responses) may use in total before the least valuable are evicted; 0 for no overall limit."
+  , 0
+  };
+  static const command_line::arg_descriptor<size_t> arg_recent_outputs_cache  = {
+    "recent-outputs-cache"
+  , "Number of the most recent RCT outputs to keep in memory for answering ring member (get_outs) requests without reading the database; 0 to disable."
+  , 100000
+  };
+  static const command_line::arg_descriptor<uint64_t> arg_lock_hold_warning_ms  = {
+    "lock-hold-warning-ms"
+  , "Log a warning, with the holder's call site, whenever the blockchain, tx pool or service node list lock is held for longer than this many milliseconds (0 = never)."
+  , 5000
+  };
   static const command_line::arg_descriptor<bool> arg_pad_transactions  = {
     "pad-transactions"
   , "Pad relayed transactions to help defend against traffic volume analysis"
@@ -218,6 +264,13 @@ namespace cryptonote
   , "Run a program for each new block, '%s' will be replaced by the block hash"
   , ""
   };
+  static const command_line::arg_descriptor<bool> arg_block_notify_every_block = {
+    "block-notify-every-block"
+  , "Run the --block-notify program for every block.  By default, when blocks are added faster than "
+    "the program runs (e.g. while syncing), notifications still waiting to run are replaced by the "
+    "one for the newest block"
+  , false
+  };
   static const command_line::arg_descriptor<bool> arg_prune_blockchain  = {
     "prune-blockchain"
   , "Prune blockchain"
@@ -245,6 +298,28 @@ namespace cryptonote
   , "Keep alternative blocks on restart"
   , false
   };
+  static const command_line::arg_descriptor<bool> arg_randomx_prewarm  = {
+    "randomx-prewarm"
+  , "Prepare the RandomX cache for the next seed epoch in the background once its seed block is known, "
+    "so the epoch switch does not stall block verification.  When mining, the next mining dataset is "
+    "prepared as well (requires memory for a second dataset)."
+  , false
+  };
+
+  static const command_line::arg_descriptor<bool> arg_light_wallet_scanner = {
+    "light-wallet-scanner"
+  , "Scan the blockchain for the outputs of accounts registered by light wallets, and serve the light "
+    "wallet RPC calls (login, get_address_info, get_unspent_outs, ...).  Registered accounts' view "
+    "keys are stored in the data directory."
+  , false
+  };
+
+  static const command_line::arg_descriptor<std::string> arg_restore_snapshot = {
+    "restore-snapshot",
+    "Start from the snapshot (made with the create_snapshot RPC command) in the given directory instead "
+    "of syncing from scratch.  The snapshot is checked against its manifest and the compiled-in block "
+    "hashes and checkpoints first.  The data directory must not already have a blockchain.",
+    ""};
 
   static const command_line::arg_descriptor<uint64_t> arg_store_quorum_history = {
     "store-quorum-history",
@@ -275,6 +350,9 @@ namespace cryptonote
   , m_miner(this, [this](const cryptonote::block &b, uint64_t height, unsigned int threads, crypto::hash &hash) {
     hash = cryptonote::get_block_longhash_w_blockchain(m_nettype, &m_blockchain_storage, b, height, threads);
     return true;
+  }, [this](const cryptonote::block &b, uint64_t height, unsigned int threads, const uint32_t *nonces, crypto::hash *hashes, size_t count) {
+    cryptonote::get_block_longhashes_w_blockchain(m_nettype, &m_blockchain_storage, b, height, threads, nonces, hashes, count);
+    return true;
   })
   , m_pprotocol(&m_protocol_stub)
   , m_starter_message_showed(false)
@@ -283,7 +361,9 @@ namespace cryptonote
   , m_nettype(UNDEFINED)
   , m_last_storage_server_ping(0)
   , m_last_lokinet_ping(0)
+  , m_incoming_tx_cache(INCOMING_TX_CACHE_MAX_SIZE)
   , m_pad_transactions(false)
+  , m_randomx_prewarm(false)
   , ss_version{0}
   , lokinet_version{0}
   {
@@ -341,22 +421,34 @@ namespace cryptonote
     command_line::add_arg(desc, arg_fast_block_sync);
     command_line::add_arg(desc, arg_show_time_stats);
     command_line::add_arg(desc, arg_block_sync_size);
+    command_line::add_arg(desc, arg_bp_cache_mb);
+    command_line::add_arg(desc, arg_multiexp_backend);
+    command_line::add_arg(desc, arg_multiexp_backend_check);
+    command_line::add_arg(desc, arg_cache_budget_mb);
+    command_line::add_arg(desc, arg_recent_outputs_cache);
     command_line::add_arg(desc, arg_offline);
     command_line::add_arg(desc, arg_block_download_max_size);
+    command_line::add_arg(desc, arg_block_download_spill);
+    command_line::add_arg(desc, arg_tx_verify_threads);
     command_line::add_arg(desc, arg_max_txpool_weight);
     command_line::add_arg(desc, arg_service_node);
     command_line::add_arg(desc, arg_public_ip);
     command_line::add_arg(desc, arg_storage_server_port);
     command_line::add_arg(desc, arg_quorumnet_port);
 
+    command_line::add_arg(desc, arg_lock_hold_warning_ms);
     command_line::add_arg(desc, arg_pad_transactions);
     command_line::add_arg(desc, arg_block_notify);
+    command_line::add_arg(desc, arg_block_notify_every_block);
 #if 0 // TODO(oxen): Pruning not supported because of Service Node List
     command_line::add_arg(desc, arg_prune_blockchain);
 #endif
     command_line::add_arg(desc, arg_reorg_notify);
     command_line::add_arg(desc, arg_block_rate_notify);
     command_line::add_arg(desc, arg_keep_alt_blocks);
+    command_line::add_arg(desc, arg_randomx_prewarm);
+    command_line::add_arg(desc, arg_light_wallet_scanner);
+    command_line::add_arg(desc, arg_restore_snapshot);
 
     command_line::add_arg(desc, arg_store_quorum_history);
 #if defined(OXEN_ENABLE_INTEGRATION_TEST_HOOKS)
@@ -384,6 +476,7 @@ namespace cryptonote
     test_drop_download_height(command_line::get_arg(vm, arg_test_drop_download_height));
     m_pad_transactions = get_arg(vm, arg_pad_transactions);
     m_offline = get_arg(vm, arg_offline);
+    m_randomx_prewarm = get_arg(vm, arg_randomx_prewarm);
     if (command_line::get_arg(vm, arg_test_drop_download) == true)
       test_drop_download();
 
@@ -613,6 +706,7 @@ namespace cryptonote
 
     std::string db_sync_mode = command_line::get_arg(vm, cryptonote::arg_db_sync_mode);
     bool db_salvage = command_line::get_arg(vm, cryptonote::arg_db_salvage) != 0;
+    bool db_compress = command_line::get_arg(vm, cryptonote::arg_db_compress) != 0;
     bool fast_sync = command_line::get_arg(vm, arg_fast_block_sync) != 0;
     uint64_t blocks_threads = command_line::get_arg(vm, arg_prep_blocks_threads);
     size_t max_txpool_weight = command_line::get_arg(vm, arg_max_txpool_weight);
@@ -646,6 +740,12 @@ namespace cryptonote
       return false;
     }
 
+    if (auto snapshot_dir = command_line::get_arg(vm, arg_restore_snapshot); !snapshot_dir.empty())
+    {
+      if (!restore_snapshot(fs::u8path(snapshot_dir), folder, db->get_db_name(), get_checkpoints))
+        return false;
+    }
+
     auto ons_db_file_path = folder / "ons.db";
     if(fs::exists(folder / "lns.db"))
       ons_db_file_path = folder / "lns.db";
@@ -658,6 +758,8 @@ namespace cryptonote
     blockchain_db_sync_mode sync_mode = db_defaultsync;
     bool sync_on_blocks = true;
     uint64_t sync_threshold = 1;
+    std::chrono::milliseconds group_sync_delay{5000};
+    uint64_t group_sync_bytes = 64 * 1024 * 1024;
 
 #if !defined(OXEN_ENABLE_INTEGRATION_TEST_HOOKS) // In integration mode, don't delete the DB. This should be explicitly done in the tests. Otherwise the more likely behaviour is persisting the DB across multiple daemons in the same test.
     if (m_nettype == FAKECHAIN && !keep_fakechain)
@@ -723,9 +825,29 @@ namespace cryptonote
           sync_mode = db_sync_mode_is_default ? db_defaultsync : db_sync;
         else if(options[1] == "async")
           sync_mode = db_sync_mode_is_default ? db_defaultsync : db_async;
+        else if(options[1] == "group")
+          sync_mode = db_group;
       }
 
-      if(options.size() >= 3 && !safemode)
+      if (sync_mode == db_group)
+      {
+        // group[:<ms>ms][:<bytes>bytes]: flush at most that long after a write, or once that much is waiting
+        for (size_t i = 2; i < options.size(); i++)
+        {
+          char *endptr;
+          uint64_t value = strtoull(options[i].c_str(), &endptr, 0);
+          if (!strcmp(endptr, "ms"))
+            group_sync_delay = std::chrono::milliseconds{value};
+          else if (!strcmp(endptr, "bytes"))
+            group_sync_bytes = value;
+          else
+          {
+            LOG_ERROR("Invalid db sync mode: " << options[i]);
+            return false;
+          }
+        }
+      }
+      else if(options.size() >= 3 && !safemode)
       {
         char *endptr;
         uint64_t threshold = strtoull(options[2].c_str(), &endptr, 0);
@@ -748,10 +870,18 @@ namespace cryptonote
 
       if (db_salvage)
         db_flags |= DBF_SALVAGE;
+      if (db_compress)
+        db_flags |= DBF_COMPRESS;
 
       db->open(folder, m_nettype, db_flags);
       if(!db->m_open)
         return false;
+
+      std::vector<std::string> prewarm_tables;
+      if (auto tables = command_line::get_arg(vm, cryptonote::arg_db_prewarm_tables); !tables.empty())
+        boost::split(prewarm_tables, tables, boost::is_any_of(", "), boost::token_compress_on);
+      db->start_prewarm(prewarm_tables, command_line::get_arg(vm, cryptonote::arg_db_prewarm_blocks),
+          command_line::get_arg(vm, cryptonote::arg_db_prewarm_rate) << 20);
     }
     catch (const DB_ERROR& e)
     {
@@ -761,11 +891,14 @@ namespace cryptonote
 
     m_blockchain_storage.set_user_options(blocks_threads,
         sync_on_blocks, sync_threshold, sync_mode, fast_sync);
+    m_blockchain_storage.set_group_sync(group_sync_delay, group_sync_bytes);
+    m_blockchain_storage.set_recent_outputs_cache_size(command_line::get_arg(vm, arg_recent_outputs_cache));
 
     try
     {
       if (!command_line::is_arg_defaulted(vm, arg_block_notify))
-        m_blockchain_storage.set_block_notify(std::shared_ptr<tools::Notify>(new tools::Notify(command_line::get_arg(vm, arg_block_notify).c_str())));
+        m_blockchain_storage.set_block_notify(std::shared_ptr<tools::Notify>(new tools::Notify(command_line::get_arg(vm, arg_block_notify).c_str())),
+            !command_line::get_arg(vm, arg_block_notify_every_block));
     }
     catch (const std::exception &e)
     {
@@ -817,6 +950,13 @@ namespace cryptonote
       m_blockchain_storage.hook_blockchain_detached(m_quorum_cop);
     }
 
+    if (command_line::get_arg(vm, arg_light_wallet_scanner))
+    {
+      m_light_wallet_scanner = std::make_unique<light_wallet_scanner>(m_blockchain_storage);
+      m_blockchain_storage.hook_block_added(*m_light_wallet_scanner);
+      m_blockchain_storage.hook_blockchain_detached(*m_light_wallet_scanner);
+    }
+
     // Checkpoints
     m_checkpoints_path = m_config_folder / fs::u8path(JSON_HASH_FILE_NAME);
 
@@ -832,6 +972,16 @@ namespace cryptonote
     r = m_mempool.init(max_txpool_weight);
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize memory pool");
 
+    if (m_light_wallet_scanner)
+    {
+      try {
+        m_light_wallet_scanner->start(folder / "light_wallet");
+      } catch (const std::exception& e) {
+        MERROR("Failed to start the light wallet scanner: " << e.what());
+        return false;
+      }
+    }
+
     // now that we have a valid m_blockchain_storage, we can clean out any
     // transactions in the pool that do not conform to the current fork
     m_mempool.validate(m_blockchain_storage.get_network_version());
@@ -843,6 +993,23 @@ namespace cryptonote
     if (block_sync_size > BLOCKS_SYNCHRONIZING_MAX_COUNT)
       MERROR("Error --block-sync-size cannot be greater than " << BLOCKS_SYNCHRONIZING_MAX_COUNT);
 
+    rct::bulletproof_set_cache_size(command_line::get_arg(vm, arg_bp_cache_mb) << 20);
+    try
+    {
+      rct::select_multiexp_backend(command_line::get_arg(vm, arg_multiexp_backend), command_line::get_arg(vm, arg_multiexp_backend_check));
+    }
+    catch (const std::invalid_argument &e)
+    {
+      std::string available;
+      for (const auto &name : rct::multiexp_backend_names())
+        available += (available.empty() ? "" : ", ") + name;
+      MERROR("Invalid --" << arg_multiexp_backend.name << ": " << e.what() << " (available: " << available << ")");
+      return false;
+    }
+    tools::cache_budget::set_limit(command_line::get_arg(vm, arg_cache_budget_mb) << 20);
+
+    tools::set_lock_hold_warning(std::chrono::milliseconds(command_line::get_arg(vm, arg_lock_hold_warning_ms)));
+
     MGINFO("Loading checkpoints");
     CHECK_AND_ASSERT_MES(update_checkpoints_from_json_file(), false, "One or more checkpoints loaded from json conflicted with existing checkpoints.");
 
@@ -866,6 +1033,10 @@ namespace cryptonote
       }
     }
 
+    // Resume a background pruning the last run didn't finish; on a chain that is fully pruned
+    // already, the first step just finds that out.
+    m_background_pruning = m_blockchain_storage.get_blockchain_pruning_seed() != 0 && !m_blockchain_storage.get_db().is_read_only();
+
     return true;
   }
 
@@ -1118,6 +1289,8 @@ namespace cryptonote
     m_omq.reset();
     m_service_node_list.store();
     m_miner.stop();
+    if (m_light_wallet_scanner)
+      m_light_wallet_scanner->stop();
     m_mempool.deinit();
     m_blockchain_storage.deinit();
   }
@@ -1148,7 +1321,7 @@ namespace cryptonote
     return false;
   }
   //-----------------------------------------------------------------------------------------------
-  void core::parse_incoming_tx_pre(tx_verification_batch_info &tx_info)
+  void core::parse_incoming_tx_pre(tx_verification_batch_info &tx_info, bool use_cache)
   {
     if(tx_info.blob->size() > get_max_tx_size())
     {
@@ -1158,11 +1331,34 @@ namespace cryptonote
       return;
     }
 
+    tx_info.blob_hash = incoming_tx_cache::blob_hash(*tx_info.blob);
+    if (use_cache)
+    {
+      static auto& hits = tools::metrics::get_counter("incoming_tx_cache_hits", OXEN_DEFAULT_LOG_CATEGORY);
+      static auto& misses = tools::metrics::get_counter("incoming_tx_cache_misses", OXEN_DEFAULT_LOG_CATEGORY);
+      if (auto cached = m_incoming_tx_cache.find(tx_info.blob_hash))
+      {
+        hits.inc();
+        if (cached->rejected)
+        {
+          LOG_PRINT_L1("Transaction blob already seen and rejected, rejected");
+          tx_info.tvc.m_verifivation_failed = true;
+          return;
+        }
+        // Whether we still have it gets checked by the caller; if we don't, it gets parsed then.
+        tx_info.tx_hash = cached->tx_hash;
+        tx_info.result = true;
+        return;
+      }
+      misses.inc();
+    }
+
     tx_info.parsed = parse_and_validate_tx_from_blob(*tx_info.blob, tx_info.tx, tx_info.tx_hash);
     if(!tx_info.parsed)
     {
       LOG_PRINT_L1("WRONG TRANSACTION BLOB, Failed to parse, rejected");
       tx_info.tvc.m_verifivation_failed = true;
+      m_incoming_tx_cache.reject(tx_info.blob_hash);
       return;
     }
     //std::cout << "!"<< tx.vin.size() << std::endl;
@@ -1177,12 +1373,15 @@ namespace cryptonote
         return;
       }
     }
+    m_incoming_tx_cache.add(tx_info.blob_hash, tx_info.tx_hash);
     tx_info.result = true;
   }
   //-----------------------------------------------------------------------------------------------
-  void core::set_semantics_failed(const crypto::hash &tx_hash)
+  void core::set_semantics_failed(const tx_verification_batch_info &tx_info)
   {
+    const crypto::hash &tx_hash = tx_info.tx_hash;
     LOG_PRINT_L1("WRONG TRANSACTION BLOB, Failed to check tx " << tx_hash << " semantic, rejected");
+    m_incoming_tx_cache.reject(tx_info.blob_hash, tx_hash);
     bad_semantics_txes_lock.lock();
     bad_semantics_txes[0].insert(tx_hash);
     if (bad_semantics_txes[0].size() >= BAD_SEMANTICS_TXES_MAX_SIZE)
@@ -1219,7 +1418,7 @@ namespace cryptonote
 
       if (!check_tx_semantic(tx_info[n].tx, kept_by_block))
       {
-        set_semantics_failed(tx_info[n].tx_hash);
+        set_semantics_failed(tx_info[n]);
         tx_info[n].tvc.m_verifivation_failed = true;
         tx_info[n].result = false;
         continue;
@@ -1232,7 +1431,7 @@ namespace cryptonote
         case rct::RCTType::Null:
           // coinbase should not come here, so we reject for all other types
           MERROR_VER("Unexpected Null rctSig type");
-          set_semantics_failed(tx_info[n].tx_hash);
+          set_semantics_failed(tx_info[n]);
           tx_info[n].tvc.m_verifivation_failed = true;
           tx_info[n].result = false;
           break;
@@ -1240,7 +1439,7 @@ namespace cryptonote
           if (!rct::verRctSemanticsSimple(rv))
           {
             MERROR_VER("rct signature semantics check failed");
-            set_semantics_failed(tx_info[n].tx_hash);
+            set_semantics_failed(tx_info[n]);
             tx_info[n].tvc.m_verifivation_failed = true;
             tx_info[n].result = false;
             break;
@@ -1250,7 +1449,7 @@ namespace cryptonote
           if (!rct::verRct(rv, true))
           {
             MERROR_VER("rct signature semantics check failed");
-            set_semantics_failed(tx_info[n].tx_hash);
+            set_semantics_failed(tx_info[n]);
             tx_info[n].tvc.m_verifivation_failed = true;
             tx_info[n].result = false;
             break;
@@ -1262,16 +1461,18 @@ namespace cryptonote
           if (!is_canonical_bulletproof_layout(rv.p.bulletproofs))
           {
             MERROR_VER("Bulletproof does not have canonical form");
-            set_semantics_failed(tx_info[n].tx_hash);
+            set_semantics_failed(tx_info[n]);
             tx_info[n].tvc.m_verifivation_failed = true;
             tx_info[n].result = false;
             break;
           }
+          if (kept_by_block && m_blockchain_storage.rct_semantics_preverified(tx_info[n].tx_hash))
+            break; // already verified in the batch covering the whole incoming block span
           rvv.push_back(&rv); // delayed batch verification
           break;
         default:
           MERROR_VER("Unknown rct type: " << (int)rv.type);
-          set_semantics_failed(tx_info[n].tx_hash);
+          set_semantics_failed(tx_info[n]);
           tx_info[n].tvc.m_verifivation_failed = true;
           tx_info[n].result = false;
           break;
@@ -1289,7 +1490,7 @@ namespace cryptonote
           continue;
         if (assumed_bad || !rct::verRctSemanticsSimple(tx_info[n].tx.rct_signatures))
         {
-          set_semantics_failed(tx_info[n].tx_hash);
+          set_semantics_failed(tx_info[n]);
           tx_info[n].tvc.m_verifivation_failed = true;
           tx_info[n].result = false;
         }
@@ -1306,11 +1507,22 @@ namespace cryptonote
     tools::threadpool& tpool = tools::threadpool::getInstance();
     tools::threadpool::waiter waiter;
     for (size_t i = 0; i < tx_blobs.size(); i++) {
+      if (opts.kept_by_block)
+      {
+        if (auto it = m_fast_sync_txs.find(&tx_blobs[i]); it != m_fast_sync_txs.end())
+        {
+          tx_info[i] = std::move(it->second);
+          m_fast_sync_txs.erase(it);
+          continue;
+        }
+      }
       tx_info[i].blob = &tx_blobs[i];
-      tpool.submit(&waiter, [this, &info = tx_info[i]] {
+      // Txs kept by block need the parsed tx (for Blockchain::on_new_tx_from_block), so never
+      // come from the cache.
+      tpool.submit(&waiter, [this, &info = tx_info[i], use_cache = !opts.kept_by_block] {
         try
         {
-          parse_incoming_tx_pre(info);
+          parse_incoming_tx_pre(info, use_cache);
         }
         catch (const std::exception &e)
         {
@@ -1335,6 +1547,20 @@ namespace cryptonote
         LOG_PRINT_L2("tx " << info.tx_hash << " already have transaction in blockchain");
         info.already_have = true;
       }
+      else if (!info.parsed)
+      {
+        // Seen before (so found in the incoming tx cache) but since dropped: it needs parsing after all
+        info.result = false;
+        try
+        {
+          parse_incoming_tx_pre(info, false);
+        }
+        catch (const std::exception &e)
+        {
+          MERROR_VER("Exception in handle_incoming_tx_pre: " << e.what());
+          info.tvc.m_verifivation_failed = true;
+        }
+      }
     }
 
 
@@ -1353,6 +1579,21 @@ namespace cryptonote
     bool tx_pool_changed = false;
     if (blink_rollback_height)
       *blink_rollback_height = 0;
+
+    // Look up the ring members of the whole batch up front, in one sorted sweep per amount, rather
+    // than separately for each tx as it gets verified.  (Txes kept by block are already covered by
+    // the blockchain's own scan table of the blocks being added).
+    if (!opts.kept_by_block)
+    {
+      std::vector<const transaction*> prefetch;
+      for (const auto &info : parsed_txs)
+        if (info.result && !info.already_have)
+          prefetch.push_back(&info.tx);
+      if (prefetch.size() > 1)
+        m_blockchain_storage.prefetch_ring_members(prefetch);
+    }
+    OXEN_DEFER { m_blockchain_storage.clear_prefetched_ring_members(); };
+
     tx_pool_options tx_opts;
     for (size_t i = 0; i < parsed_txs.size(); i++) {
       auto &info = parsed_txs[i];
@@ -1718,26 +1959,20 @@ namespace cryptonote
   //-----------------------------------------------------------------------------------------------
   bool core::are_key_images_spent(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent) const
   {
-    spent.clear();
-    for(auto& ki: key_im)
-    {
-      spent.push_back(m_blockchain_storage.have_tx_keyimg_as_spent(ki));
-    }
+    m_blockchain_storage.have_tx_keyimgs_as_spent(key_im, spent);
     return true;
   }
   //-----------------------------------------------------------------------------------------------
   size_t core::get_block_sync_size(uint64_t height) const
   {
-    if (block_sync_size > 0)
-      return block_sync_size;
-    return BLOCKS_SYNCHRONIZING_DEFAULT_COUNT;
+    return block_sync_size;
   }
   //-----------------------------------------------------------------------------------------------
-  bool core::are_key_images_spent_in_pool(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent) const
+  bool core::are_key_images_spent_in_pool(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent, bool include_unrelayed) const
   {
     spent.clear();
 
-    return m_mempool.check_for_key_images(key_im, spent);
+    return m_mempool.check_for_key_images(key_im, spent, include_unrelayed);
   }
   //-----------------------------------------------------------------------------------------------
   std::optional<std::tuple<uint64_t, uint64_t, uint64_t>> core::get_coinbase_tx_sum(uint64_t start_offset, size_t count)
@@ -1828,7 +2063,7 @@ namespace cryptonote
         tx_fee_amount += get_tx_miner_fee(tx, b.major_version >= HF_VERSION_FEE_BURNING);
         if(b.major_version >= HF_VERSION_FEE_BURNING)
         {
-          burnt_oxen += get_burned_amount_from_tx_extra(tx.extra);
+          burnt_oxen += get_burned_amount_from_tx_extra(tx);
         }
       }
 
@@ -1979,6 +2214,63 @@ namespace cryptonote
     return result;
   }
   //-----------------------------------------------------------------------------------------------
+  // More than there are service nodes, so that a full round of proofs fits
+  static constexpr size_t MAX_QUEUED_UPTIME_PROOFS = 10000;
+  void core::queue_btencoded_uptime_proof(NOTIFY_BTENCODED_UPTIME_PROOF::request proof)
+  {
+    std::lock_guard lock{m_uptime_proof_queue_mutex};
+    if (m_uptime_proof_queue.size() >= MAX_QUEUED_UPTIME_PROOFS)
+    {
+      MDEBUG("Uptime proof queue is full, dropping proof");
+      return;
+    }
+    m_uptime_proof_queue.push_back(std::move(proof));
+  }
+  //-----------------------------------------------------------------------------------------------
+  void core::flush_uptime_proofs()
+  {
+    std::vector<NOTIFY_BTENCODED_UPTIME_PROOF::request> reqs;
+    {
+      std::lock_guard lock{m_uptime_proof_queue_mutex};
+      reqs.swap(m_uptime_proof_queue);
+    }
+    if (reqs.empty())
+      return;
+
+    std::vector<std::unique_ptr<uptime_proof::Proof>> proofs;
+    proofs.reserve(reqs.size());
+    for (auto &req : reqs)
+    {
+      auto &proof = proofs.emplace_back(std::make_unique<uptime_proof::Proof>(req.proof));
+      proof->sig = tools::make_from_guts<crypto::signature>(req.sig);
+      proof->sig_ed25519 = tools::make_from_guts<crypto::ed25519_signature>(req.ed_sig);
+    }
+    std::vector<crypto::public_key> pubkeys;
+    pubkeys.reserve(proofs.size());
+    for (auto &proof : proofs)
+      pubkeys.push_back(proof->pubkey);
+
+    auto results = m_service_node_list.handle_btencoded_uptime_proofs(std::move(proofs));
+
+    oxenmq::pubkey_set added;
+    cryptonote_connection_context empty_context{};
+    for (size_t i = 0; i < results.size(); i++)
+    {
+      auto &result = results[i];
+      if (!result.accepted)
+        continue;
+      if (result.x25519_pkey && m_service_node_list.is_service_node(pubkeys[i], true /*require_active*/))
+        added.insert(tools::copy_guts(result.x25519_pkey));
+      // Confirmations of our own proof don't get relayed (see
+      // cryptonote_protocol_handler::handle_btencoded_uptime_proof).  Others are sent to every
+      // synchronized peer, including the one that sent it to us, so it knows we got it.
+      if (!result.my_uptime_proof_confirmation)
+        get_protocol()->relay_btencoded_uptime_proof(reqs[i], empty_context);
+    }
+    if (!added.empty())
+      m_omq->update_active_sns(added, {} /*removed*/);
+  }
+  //-----------------------------------------------------------------------------------------------
   crypto::hash core::on_transaction_relayed(const cryptonote::blobdata& tx_blob)
   {
     std::vector<std::pair<crypto::hash, cryptonote::blobdata>> txs;
@@ -2024,9 +2316,9 @@ namespace cryptonote
     return m_blockchain_storage.create_next_miner_block_template(b, adr, diffic, height, expected_reward, ex_nonce);
   }
   //-----------------------------------------------------------------------------------------------
-  bool core::create_miner_block_template(block& b, const crypto::hash *prev_block, const account_public_address& adr, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce)
+  bool core::create_miner_block_template(block& b, const crypto::hash *prev_block, const account_public_address& adr, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce, Blockchain::block_template_blobs* blobs)
   {
-    return m_blockchain_storage.create_miner_block_template(b, prev_block, adr, diffic, height, expected_reward, ex_nonce);
+    return m_blockchain_storage.create_miner_block_template(b, prev_block, adr, diffic, height, expected_reward, ex_nonce, blobs);
   }
   //-----------------------------------------------------------------------------------------------
   bool core::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp) const
@@ -2064,6 +2356,11 @@ namespace cryptonote
     return m_blockchain_storage.get_tx_outputs_gindexs(tx_id, n_txes, indexs);
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::get_blocks_tx_outputs_gindexs(const crypto::hash& tx_id, size_t tx_offset, const std::vector<size_t>& block_txes, bool miner_txes, std::vector<std::vector<std::vector<uint64_t>>>& indexs) const
+  {
+    return m_blockchain_storage.get_blocks_tx_outputs_gindexs(tx_id, tx_offset, block_txes, miner_txes, indexs);
+  }
+  //-----------------------------------------------------------------------------------------------
   void core::pause_mine()
   {
     m_miner.pause();
@@ -2156,10 +2453,30 @@ namespace cryptonote
   {
     bool result = m_blockchain_storage.add_new_block(b, bvc, checkpoint);
     if (result)
+    {
       relay_service_node_votes(); // NOTE: nop if synchronising due to not accepting votes whilst syncing
+      if (bvc.m_added_to_main_chain && b.major_version >= network_version_12_checkpointing)
+        prewarm_next_randomx_seed();
+    }
     return result;
   }
   //-----------------------------------------------------------------------------------------------
+  void core::prewarm_next_randomx_seed()
+  {
+    if (!m_randomx_prewarm || m_nettype == FAKECHAIN)
+      return;
+
+    uint64_t const height = m_blockchain_storage.get_current_blockchain_height();
+    uint64_t seed_height, next_height;
+    crypto::rx_seedheights(height, &seed_height, &next_height);
+    if (next_height == seed_height || next_height >= height)
+      return;
+
+    crypto::hash const seed_hash = m_blockchain_storage.get_block_id_by_height(next_height);
+    int const threads = m_miner.is_mining() ? static_cast<int>(m_miner.get_threads_count()) : 0;
+    crypto::rx_prepare_seedhash(next_height, seed_hash.data, threads);
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::prepare_handle_incoming_blocks(const std::vector<block_complete_entry> &blocks_entry, std::vector<block> &blocks)
   {
     m_incoming_tx_lock.lock();
@@ -2168,13 +2485,65 @@ namespace cryptonote
       cleanup_handle_incoming_blocks(false);
       return false;
     }
+    if (m_blockchain_storage.is_within_compiled_block_hash_area(m_blockchain_storage.get_current_blockchain_height() + blocks_entry.size()))
+      parse_fast_sync_span_txs(blocks_entry);
     return true;
   }
 
+  //-----------------------------------------------------------------------------------------------
+  void core::parse_fast_sync_span_txs(const std::vector<block_complete_entry> &blocks_entry)
+  {
+    // The blocks' tx hashes get checked against the compiled-in hashes as each block is added (and
+    // the txs' ringct signatures not at all), which leaves parsing and hashing the txs as the bulk
+    // of the work; do it for the whole span at once rather than one (often near-empty) block at a
+    // time.
+    m_fast_sync_txs.clear();
+    for (const auto &entry : blocks_entry)
+      for (const auto &blob : entry.txs)
+        m_fast_sync_txs[&blob].blob = &blob;
+    if (m_fast_sync_txs.empty())
+      return;
+
+    std::vector<tx_verification_batch_info*> infos;
+    infos.reserve(m_fast_sync_txs.size());
+    for (auto &[blob, info] : m_fast_sync_txs)
+      infos.push_back(&info);
+
+    tools::threadpool& tpool = tools::threadpool::getInstance();
+    tools::threadpool::waiter waiter;
+    const size_t threads = std::max<size_t>(1, tpool.get_max_concurrency());
+    const size_t chunk = (infos.size() + threads - 1) / threads;
+    for (size_t begin = 0; begin < infos.size(); begin += chunk)
+    {
+      tpool.submit(&waiter, [this, &infos, begin, end = std::min(infos.size(), begin + chunk)] {
+        for (size_t i = begin; i < end; i++)
+        {
+          try
+          {
+            parse_incoming_tx_pre(*infos[i], false);
+          }
+          catch (const std::exception &e)
+          {
+            MERROR_VER("Exception in handle_incoming_tx_pre: " << e.what());
+            infos[i]->tvc.m_verifivation_failed = true;
+          }
+        }
+      }, true);
+    }
+    waiter.wait(&tpool);
+  }
+
+  //-----------------------------------------------------------------------------------------------
+  void core::precompute_block_longhashes(uint64_t height, const std::vector<block_complete_entry> &blocks_entry)
+  {
+    m_blockchain_storage.precompute_block_longhashes(height, blocks_entry);
+  }
+
   //-----------------------------------------------------------------------------------------------
   bool core::cleanup_handle_incoming_blocks(bool force_sync)
   {
     bool success = false;
+    m_fast_sync_txs.clear();
     try {
       success = m_blockchain_storage.cleanup_handle_incoming_blocks(force_sync);
     }
@@ -2391,9 +2760,18 @@ namespace cryptonote
 
     m_txpool_auto_relayer.do_call([this] { return relay_txpool_transactions(); });
     m_service_node_vote_relayer.do_call([this] { return relay_service_node_votes(); });
+    flush_uptime_proofs();
     m_check_disk_space_interval.do_call([this] { return check_disk_space(); });
     m_block_rate_interval.do_call([this] { return check_block_rate(); });
     m_sn_proof_cleanup_interval.do_call([&snl=m_service_node_list] { snl.cleanup_proofs(); return true; });
+    m_sn_state_store_interval.do_call([this] {
+      if (m_blockchain_storage.group_sync())
+        return true; // stored by the group syncs instead
+      std::unique_lock lock{m_blockchain_storage};
+      return m_service_node_list.store();
+    });
+    m_txpool_flush_interval.do_call([this] { m_blockchain_storage.flush_txpool(); return true; });
+    m_cache_budget_interval.do_call([] { tools::cache_budget::enforce(); return true; });
 
     std::chrono::seconds lifetime{time(nullptr) - get_start_time()};
     if (m_service_node && lifetime > get_net_config().UPTIME_PROOF_STARTUP_DELAY) // Give us some time to connect to peers before sending uptimes
@@ -2402,6 +2780,7 @@ namespace cryptonote
     }
 
     m_blockchain_pruning_interval.do_call([this] { return update_blockchain_pruning(); });
+    m_background_pruning_interval.do_call([this] { return background_pruning_step(); });
     m_miner.on_idle();
     m_mempool.on_idle();
 
@@ -2516,6 +2895,40 @@ namespace cryptonote
   {
     m_blockchain_storage.flush_invalid_blocks();
   }
+  bool core::start_background_pruning()
+  {
+    try
+    {
+      // Sets the pruning seed (if it isn't already), without pruning anything yet
+      m_background_pruning = !m_blockchain_storage.prune_blockchain_batch(0, 0);
+    }
+    catch (const std::exception& e)
+    {
+      MERROR("Failed to start background blockchain pruning: " << e.what());
+      return false;
+    }
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::background_pruning_step()
+  {
+    // Blocks being synced take priority; pruning picks up again once we have caught up
+    if (!m_background_pruning || get_current_blockchain_height() < get_target_blockchain_height())
+      return true;
+    try
+    {
+      if (m_blockchain_storage.prune_blockchain_batch(0, CRYPTONOTE_PRUNING_BACKGROUND_BATCH))
+        m_background_pruning = false;
+    }
+    catch (const std::exception& e)
+    {
+      MERROR("Background blockchain pruning failed: " << e.what());
+      m_background_pruning = false;
+      return false;
+    }
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::update_blockchain_pruning()
   {
     return m_blockchain_storage.update_blockchain_pruning();
@@ -2576,6 +2989,159 @@ namespace cryptonote
     return get_blockchain_storage().get_blockchain_pruning_seed();
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::create_snapshot(const fs::path& dir, snapshot::manifest& manifest)
+  {
+    std::unique_lock snapshot_lock{m_snapshot_mutex, std::try_to_lock};
+    if (!snapshot_lock)
+    {
+      MERROR("Failed to create snapshot: a snapshot is already being created");
+      return false;
+    }
+
+    const auto& db = m_blockchain_storage.get_db();
+    const std::string db_file = db.get_db_name() + "/" CRYPTONOTE_BLOCKCHAINDATA_FILENAME;
+    const auto db_dir = dir / fs::u8path(db.get_db_name());
+    try
+    {
+      if (fs::exists(dir / fs::u8path(snapshot::MANIFEST_FILENAME)))
+        throw std::runtime_error{"there is already a snapshot in " + dir.u8string()};
+      fs::create_directories(db_dir);
+
+      manifest = {};
+      manifest.nettype = m_nettype;
+
+      // ONS is only written to while the blockchain is locked.  Its db is small, so we copy it
+      // under the lock; the blocks it is missing compared to the LMDB copy below (which is taken
+      // later) get loaded into it when the snapshot is restored.
+      {
+        std::unique_lock lock{m_blockchain_storage};
+        auto& ons_db = m_blockchain_storage.name_system_db();
+        if (!ons_db.db)
+          throw std::runtime_error{"the ONS database is not open"};
+        snapshot::copy_sqlite(ons_db.db, dir / fs::u8path(snapshot::ONS_FILENAME));
+        manifest.ons_height = ons_db.height();
+      }
+
+      // The compacting copy reads everything within a single LMDB read txn, so it is consistent
+      // without holding up new blocks; the height and top block are then read back from the copy.
+      MGINFO("Copying the blockchain database to " << db_dir << " ...");
+      db.copy_compacted(db_dir);
+      {
+        std::unique_ptr<BlockchainDB> copy{new_db()};
+        copy->open(db_dir, m_nettype, DBF_RDONLY);
+        manifest.top_hash = copy->top_block_hash();
+        manifest.height = copy->height();
+        copy->close();
+      }
+      std::error_code ec;
+      fs::remove(db_dir / CRYPTONOTE_BLOCKCHAINDATA_LOCK_FILENAME, ec);
+
+      manifest.chunks = snapshot::hash_chunks(dir, {std::string{snapshot::ONS_FILENAME}, db_file});
+      snapshot::write_manifest(dir, manifest);
+    }
+    catch (const std::exception& e)
+    {
+      MERROR("Failed to create snapshot in " << dir << ": " << e.what());
+      return false;
+    }
+
+    MGINFO("Created snapshot of " << manifest.height << " blocks (top block " << manifest.top_hash << ") in " << dir);
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::restore_snapshot(const fs::path& snapshot_dir, const fs::path& folder, const std::string& db_name, const GetCheckpointsCallback& get_checkpoints)
+  {
+    const std::string db_file = db_name + "/" CRYPTONOTE_BLOCKCHAINDATA_FILENAME;
+    if (fs::exists(folder / fs::u8path(db_file)))
+    {
+      MERROR("Refusing to restore a snapshot over the existing blockchain in " << folder);
+      return false;
+    }
+
+    MGINFO("Verifying the snapshot in " << snapshot_dir << " ...");
+    try
+    {
+      auto manifest = snapshot::read_manifest(snapshot_dir);
+      if (manifest.nettype != m_nettype)
+      {
+        MERROR("The snapshot is of " << network_type_str(manifest.nettype) << ", not " << network_type_str(m_nettype));
+        return false;
+      }
+
+      // Only the files a snapshot is made of get restored: a manifest naming anything else (such
+      // as a service node key) is refused.
+      bool have_db = false, have_ons = false;
+      for (const auto& c : manifest.chunks)
+      {
+        have_db |= c.file == db_file;
+        have_ons |= c.file == snapshot::ONS_FILENAME;
+        if (c.file != db_file && c.file != snapshot::ONS_FILENAME)
+        {
+          MERROR("The snapshot has an unexpected file: " << c.file);
+          return false;
+        }
+      }
+      if (!have_db)
+      {
+        MERROR("The snapshot has no blockchain database");
+        return false;
+      }
+
+      auto bad = snapshot::verify_chunks(snapshot_dir, manifest);
+      for (const auto& b : bad)
+        MERROR("Bad snapshot file " << b);
+      if (!bad.empty())
+        return false;
+
+      std::string error;
+      uint64_t hashed = 0, checkpointed = 0;
+      {
+        std::unique_ptr<BlockchainDB> db{new_db()};
+        db->open(snapshot_dir / fs::u8path(db_name), m_nettype, DBF_RDONLY);
+        if (db->height() != manifest.height || db->top_block_hash() != manifest.top_hash)
+          error = "the blockchain database doesn't match the manifest's height and top block";
+        if (error.empty() && get_checkpoints)
+          hashed = snapshot::check_hash_of_hashes(*db, get_checkpoints(m_nettype), error);
+        if (error.empty())
+          checkpointed = snapshot::check_checkpoints(*db, m_nettype, error);
+        db->close();
+      }
+      std::error_code ec;
+      fs::remove(snapshot_dir / fs::u8path(db_name) / CRYPTONOTE_BLOCKCHAINDATA_LOCK_FILENAME, ec);
+      if (!error.empty())
+      {
+        MERROR("Snapshot verification failed: " << error);
+        return false;
+      }
+      MGINFO("Snapshot verified: " << manifest.height << " blocks, " << hashed << " of them against the compiled-in block hashes, and " << checkpointed << " checkpoints");
+
+      // Each file is copied under a temporary name and then renamed, and the blockchain db goes
+      // last, so an interrupted restore leaves no blockchain behind and can simply be rerun.
+      auto install = [&](const std::string& file) {
+        auto dest = folder / fs::u8path(file);
+        auto partial = dest;
+        partial += ".partial";
+        fs::create_directories(dest.parent_path());
+        fs::copy_file(snapshot_dir / fs::u8path(file), partial, fs::copy_options::overwrite_existing);
+        fs::rename(partial, dest);
+      };
+      if (have_ons)
+      {
+        fs::remove(folder / "lns.db", ec);
+        install(std::string{snapshot::ONS_FILENAME});
+      }
+      install(db_file);
+    }
+    catch (const std::exception& e)
+    {
+      MERROR("Failed to restore the snapshot in " << snapshot_dir << ": " << e.what());
+      return false;
+    }
+
+    MGINFO("Restored the snapshot in " << snapshot_dir << " to " << folder);
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::prune_blockchain(uint32_t pruning_seed)
   {
     return get_blockchain_storage().prune_blockchain(pruning_seed);
@@ -34,6 +34,7 @@
 #include <future>
 #include <chrono>
 #include <mutex>
+#include <unordered_map>
 
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
@@ -44,11 +45,14 @@
 #include "epee/storages/portable_storage_template_helper.h"
 #include "common/command_line.h"
 #include "tx_pool.h"
+#include "incoming_tx_cache.h"
 #include "blockchain.h"
 #include "service_node_voting.h"
 #include "service_node_list.h"
 #include "service_node_quorum_cop.h"
 #include "pulse.h"
+#include "light_wallet_scanner.h"
+#include "snapshot.h"
 #include "cryptonote_basic/miner.h"
 #include "cryptonote_basic/connection_context.h"
 #include "epee/warnings.h"
@@ -73,6 +77,8 @@ namespace cryptonote
   extern const command_line::arg_descriptor<bool> arg_dev_allow_local;
   extern const command_line::arg_descriptor<bool> arg_offline;
   extern const command_line::arg_descriptor<size_t> arg_block_download_max_size;
+  extern const command_line::arg_descriptor<bool> arg_block_download_spill;
+  extern const command_line::arg_descriptor<size_t> arg_tx_verify_threads;
 
   // Function pointers that are set to throwing stubs and get replaced by the actual functions in
   // cryptonote_protocol/quorumnet.cpp's quorumnet::init_core_callbacks().  This indirection is here
@@ -169,6 +175,15 @@ namespace cryptonote
       */
      bool handle_btencoded_uptime_proof(const NOTIFY_BTENCODED_UPTIME_PROOF::request &proof, bool &my_uptime_proof_confirmation);
 
+     /**
+      * @brief queues a B-encoded uptime proof received from a peer
+      *
+      * The queued proofs are handled together, about once a second (see flush_uptime_proofs()),
+      * and those accepted that aren't our own relayed on.  Proofs beyond what the queue holds are
+      * dropped.
+      */
+     void queue_btencoded_uptime_proof(NOTIFY_BTENCODED_UPTIME_PROOF::request proof);
+
      /**
       * @brief handles an incoming transaction
       *
@@ -195,8 +210,9 @@ namespace cryptonote
        bool already_have = false; // Indicates that the tx was found to already exist (in mempool or blockchain)
        bool approved_blink = false; // Can be set between the parse and handle calls to make this a blink tx (that replaces conflicting non-blink txes)
        const blobdata *blob = nullptr; // Will be set to a pointer to the incoming blobdata (i.e. string). caller must keep it alive!
-       crypto::hash tx_hash; // The transaction hash (only set if `parsed`)
-       transaction tx; // The parsed transaction (only set if `parsed`)
+       crypto::hash blob_hash; // Hash of the blob, for the incoming tx cache
+       crypto::hash tx_hash; // The transaction hash (only set if `parsed`, or `already_have`)
+       transaction tx; // The parsed transaction (only set if `parsed`, which an `already_have` tx recognized by the incoming tx cache isn't)
      };
 
      /// Returns an RAII unique lock holding the incoming tx mutex.
@@ -333,6 +349,13 @@ namespace cryptonote
       */
      bool prepare_handle_incoming_blocks(const std::vector<block_complete_entry> &blocks_entry, std::vector<block> &blocks);
 
+     /**
+      * @copydoc Blockchain::precompute_block_longhashes
+      *
+      * @note see Blockchain::precompute_block_longhashes
+      */
+     void precompute_block_longhashes(uint64_t height, const std::vector<block_complete_entry> &blocks_entry);
+
      /**
       * @copydoc Blockchain::cleanup_handle_incoming_blocks
       *
@@ -382,7 +405,7 @@ namespace cryptonote
       * @note see Blockchain::create_block_template
       */
      virtual bool create_next_miner_block_template(block& b, const account_public_address& adr, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce);
-     virtual bool create_miner_block_template(block& b, const crypto::hash *prev_block, const account_public_address& adr, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce);
+     virtual bool create_miner_block_template(block& b, const crypto::hash *prev_block, const account_public_address& adr, difficulty_type& diffic, uint64_t& height, uint64_t& expected_reward, const blobdata& ex_nonce, Blockchain::block_template_blobs* blobs = nullptr);
 
      /**
       * @brief called when a transaction is relayed; return the hash of the parsed tx, or null_hash
@@ -630,6 +653,13 @@ namespace cryptonote
      bool get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs) const;
      bool get_tx_outputs_gindexs(const crypto::hash& tx_id, size_t n_txes, std::vector<std::vector<uint64_t>>& indexs) const;
 
+     /**
+      * @copydoc Blockchain::get_blocks_tx_outputs_gindexs
+      *
+      * @note see Blockchain::get_blocks_tx_outputs_gindexs
+      */
+     bool get_blocks_tx_outputs_gindexs(const crypto::hash& tx_id, size_t tx_offset, const std::vector<size_t>& block_txes, bool miner_txes, std::vector<std::vector<std::vector<uint64_t>>>& indexs) const;
+
      /**
       * @copydoc Blockchain::get_tail_id
       *
@@ -693,6 +723,13 @@ namespace cryptonote
      /// @brief return a reference to the service node list
      service_nodes::service_node_list &get_service_node_list() { return m_service_node_list; }
 
+     /**
+      * @brief get the light wallet scanner
+      *
+      * @return the scanner, or nullptr if it isn't enabled (with --light-wallet-scanner)
+      */
+     light_wallet_scanner* get_light_wallet_scanner() { return m_light_wallet_scanner.get(); }
+
      /// @brief return a reference to the tx pool
      const tx_memory_pool &get_pool() const { return m_mempool; }
      /// @brief return a reference to the service node list
@@ -787,15 +824,18 @@ namespace cryptonote
       *
       * @param key_im list of key images to check
       * @param spent return-by-reference result for each image checked
+      * @param include_unrelayed if false, key images spent only by txes that have not been relayed
+      * count as unspent
       *
       * @return true
       */
-     bool are_key_images_spent_in_pool(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent) const;
+     bool are_key_images_spent_in_pool(const std::vector<crypto::key_image>& key_im, std::vector<bool> &spent, bool include_unrelayed = true) const;
 
      /**
       * @brief get the number of blocks to sync in one go
       *
-      * @return the number of blocks to sync in one go
+      * @return the number of blocks to sync in one go, or 0 if the span size should be adapted to
+      * each peer's throughput (i.e. --block-sync-size was not given)
       */
      size_t get_block_sync_size(uint64_t height) const;
 
@@ -951,6 +991,16 @@ namespace cryptonote
       */
      bool prune_blockchain(uint32_t pruning_seed = 0);
 
+     /**
+      * @brief starts pruning the blockchain in the background, a small batch at a time while the
+      * daemon is otherwise idle, rather than all at once as prune_blockchain() does
+      *
+      * Pruning carries on where it left off if the daemon is restarted before it finishes.
+      *
+      * @return true iff success
+      */
+     bool start_background_pruning();
+
      /**
       * @brief incrementally prunes blockchain
       *
@@ -958,6 +1008,18 @@ namespace cryptonote
       */
      bool update_blockchain_pruning();
 
+     /**
+      * @brief writes a snapshot of the blockchain database, including the service node list, and
+      * of the ONS database to `dir` (see snapshot.h), from which a new node can be started with
+      * --restore-snapshot.  Blocks keep being processed while the blockchain database is copied.
+      *
+      * @param dir the directory to write the snapshot to; it must not already hold one
+      * @param manifest set to the manifest of the written snapshot
+      *
+      * @return true iff success
+      */
+     bool create_snapshot(const fs::path& dir, snapshot::manifest& manifest);
+
      /**
       * @brief checks the blockchain pruning if enabled
       *
@@ -972,6 +1034,20 @@ namespace cryptonote
       */
      bool relay_service_node_votes();
 
+     /**
+      * @brief handles the uptime proofs queued by queue_btencoded_uptime_proof() as one batch, and
+      * relays those accepted
+      */
+     void flush_uptime_proofs();
+
+     /**
+      * @brief if enabled, starts preparing the RandomX cache (and mining dataset, when mining) of
+      * the next seed epoch in the background once the chain is within the seed lag of the switch.
+      * Cheap to call on every block: does nothing outside that window or while a preparation is
+      * already running.
+      */
+     void prewarm_next_randomx_seed();
+
      /**
       * @brief sets the given votes to relayed; generally called automatically when
       * relay_service_node_votes() is called.
@@ -1038,10 +1114,11 @@ namespace cryptonote
       */
      bool check_tx_semantic(const transaction& tx, bool kept_by_block) const;
      bool check_service_node_time();
-     void set_semantics_failed(const crypto::hash &tx_hash);
+     void set_semantics_failed(const tx_verification_batch_info &tx_info);
 
-     void parse_incoming_tx_pre(tx_verification_batch_info &tx_info);
+     void parse_incoming_tx_pre(tx_verification_batch_info &tx_info, bool use_cache);
      void parse_incoming_tx_accumulated_batch(std::vector<tx_verification_batch_info> &tx_info, bool kept_by_block);
+     void parse_fast_sync_span_txs(const std::vector<block_complete_entry> &blocks_entry);
 
      /**
       * @brief act on a set of command line options given
@@ -1097,6 +1174,18 @@ namespace cryptonote
       */
      bool init_service_keys();
 
+     /**
+      * @brief verifies the snapshot in `snapshot_dir` (its chunk hashes, and its blocks against the
+      * compiled-in block hashes and the checkpoints) and installs it into the data directory
+      * `folder`, which must not already have a blockchain
+      *
+      * @param db_name the name of the blockchain database's subdirectory
+      * @param get_checkpoints gives the compiled-in block hashes, if any
+      *
+      * @return true on success, false otherwise
+      */
+     bool restore_snapshot(const fs::path& snapshot_dir, const fs::path& folder, const std::string& db_name, const GetCheckpointsCallback& get_checkpoints);
+
      /**
       * Checks the given x25519 pubkey against the configured access lists and, if allowed, returns
       * the access level; otherwise returns `denied`.
@@ -1152,6 +1241,14 @@ namespace cryptonote
       */
      bool check_block_rate();
 
+     /**
+      * @brief prunes the next batch of a background pruning, if one is running and the daemon
+      * isn't syncing
+      *
+      * @return true on success, false otherwise
+      */
+     bool background_pruning_step();
+
      bool m_test_drop_download = true; //!< whether or not to drop incoming blocks (for testing)
 
      uint64_t m_test_drop_download_height = 0; //!< height under which to drop incoming blocks, if doing so
@@ -1162,11 +1259,19 @@ namespace cryptonote
      service_nodes::service_node_list m_service_node_list;
      service_nodes::quorum_cop        m_quorum_cop;
 
+     std::unique_ptr<light_wallet_scanner> m_light_wallet_scanner; //!< only if --light-wallet-scanner
+
      i_cryptonote_protocol* m_pprotocol; //!< cryptonote protocol instance
      cryptonote_protocol_stub m_protocol_stub; //!< cryptonote protocol stub instance
 
      std::recursive_mutex m_incoming_tx_lock; //!< incoming transaction lock
 
+     /// The txs of a span of blocks within the compiled-in block hash area, parsed (and hashed) all
+     /// at once by prepare_handle_incoming_blocks() so that parse_incoming_txs() doesn't have to
+     /// parse them a block at a time.  Keyed by the address of the span's tx blob; guarded by
+     /// m_incoming_tx_lock and emptied by cleanup_handle_incoming_blocks().
+     std::unordered_map<const blobdata*, tx_verification_batch_info> m_fast_sync_txs;
+
      //m_miner and m_miner_addres are probably temporary here
      miner m_miner; //!< miner instance
 
@@ -1181,12 +1286,23 @@ namespace cryptonote
      tools::periodic_task m_check_uptime_proof_interval{30s}; //!< interval for checking our own uptime proof (will be set to get_net_config().UPTIME_PROOF_CHECK_INTERVAL after init)
      tools::periodic_task m_block_rate_interval{90s, false}; //!< interval for checking block rate
      tools::periodic_task m_blockchain_pruning_interval{5h}; //!< interval for incremental blockchain pruning
+     tools::periodic_task m_background_pruning_interval{1s}; //!< interval for pruning the next batch of a background pruning
      tools::periodic_task m_service_node_vote_relayer{2min, false};
      tools::periodic_task m_sn_proof_cleanup_interval{1h, false};
+     tools::periodic_task m_sn_state_store_interval{5min, false}; //!< interval for persisting the service node list state, bounding the replay needed after a crash
+     tools::periodic_task m_txpool_flush_interval{30s, false}; //!< interval for writing tx pool changes not made alongside a block to the database
+     tools::periodic_task m_cache_budget_interval{10s, false}; //!< interval for evicting from caches over the --cache-budget-mb limit
      tools::periodic_task m_systemd_notify_interval{10s};
 
+     std::mutex m_uptime_proof_queue_mutex;
+     std::vector<NOTIFY_BTENCODED_UPTIME_PROOF::request> m_uptime_proof_queue; //!< proofs received from peers, waiting for flush_uptime_proofs()
+
      std::atomic<bool> m_starter_message_showed; //!< has the "daemon will sync now" message been shown?
 
+     std::atomic<bool> m_background_pruning{false}; //!< is a background pruning (start_background_pruning()) unfinished?
+
+     std::mutex m_snapshot_mutex; //!< held while create_snapshot() runs
+
      uint64_t m_target_blockchain_height; //!< blockchain height target
 
      network_type m_nettype; //!< which network are we on?
@@ -1221,8 +1337,11 @@ namespace cryptonote
      std::unordered_set<crypto::hash> bad_semantics_txes[2];
      std::mutex bad_semantics_txes_lock;
 
+     incoming_tx_cache m_incoming_tx_cache;
+
      bool m_offline;
      bool m_pad_transactions;
+     bool m_randomx_prewarm;
 
      std::shared_ptr<tools::Notify> m_block_rate_notify;
 
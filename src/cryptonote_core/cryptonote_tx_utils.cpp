@@ -33,6 +33,7 @@
 #include "epee/string_tools.h"
 #include "common/apply_permutation.h"
 #include "common/hex.h"
+#include "common/varint.h"
 #include "cryptonote_tx_utils.h"
 #include "cryptonote_config.h"
 #include "blockchain.h"
@@ -1088,44 +1089,72 @@ namespace cryptonote
     }
   }
 
+  std::optional<crypto::cn_slow_hash_type> get_block_longhash_cn_type(cryptonote::network_type nettype, uint8_t hf_version)
+  {
+    if (nettype == FAKECHAIN)
+      return cn_slow_hash_type::turtle_lite_v2;
+    if (hf_version >= network_version_12_checkpointing)
+      return std::nullopt;
+    if (hf_version >= network_version_11_infinite_staking)
+      return cn_slow_hash_type::turtle_lite_v2;
+    if (hf_version >= network_version_7)
+      return cn_slow_hash_type::heavy_v2;
+    return cn_slow_hash_type::heavy_v1;
+  }
+
   crypto::hash get_block_longhash(cryptonote::network_type nettype, randomx_longhash_context const &randomx_context, const block& b, uint64_t height, int miners)
   {
     crypto::hash result      = {};
     const blobdata bd        = get_block_hashing_blob(b);
-    const uint8_t hf_version = b.major_version;
 
 #if defined(OXEN_INTEGRATION_TESTS)
     miners = 0;
 #endif
 
-    crypto::cn_slow_hash_type cn_type = cn_slow_hash_type::heavy_v1;
-    if (nettype == FAKECHAIN)
+    if (auto cn_type = get_block_longhash_cn_type(nettype, b.major_version))
     {
-      cn_type = cn_slow_hash_type::turtle_lite_v2;
+      crypto::cn_slow_hash(bd.data(), bd.size(), result, *cn_type);
+      return result;
     }
-    else
+
+    rx_slow_hash(randomx_context.current_blockchain_height,
+                 randomx_context.seed_height,
+                 randomx_context.seed_block_hash.data,
+                 bd.data(),
+                 bd.size(),
+                 result.data,
+                 miners,
+                 0);
+    return result;
+  }
+
+  void get_block_longhashes(cryptonote::network_type nettype, const block* const* blocks, const randomx_longhash_context* contexts, const uint64_t* heights, crypto::hash* hashes, size_t count)
+  {
+    std::vector<blobdata> blobs;
+    std::vector<std::string_view> views;
+    for (size_t i = 0; i < count; )
     {
-      if (hf_version >= network_version_12_checkpointing)
+      auto cn_type = get_block_longhash_cn_type(nettype, blocks[i]->major_version);
+      if (cn_type != cn_slow_hash_type::heavy_v1 && cn_type != cn_slow_hash_type::heavy_v2)
       {
-        rx_slow_hash(randomx_context.current_blockchain_height,
-                     randomx_context.seed_height,
-                     randomx_context.seed_block_hash.data,
-                     bd.data(),
-                     bd.size(),
-                     result.data,
-                     miners,
-                     0);
-        return result;
+        hashes[i] = get_block_longhash(nettype, contexts[i], *blocks[i], heights[i], 0);
+        ++i;
+        continue;
       }
 
-      if (hf_version >= network_version_11_infinite_staking)
-        cn_type = cn_slow_hash_type::turtle_lite_v2;
-      else if (hf_version >= network_version_7)
-        cn_type = crypto::cn_slow_hash_type::heavy_v2;
+      size_t end = i + 1;
+      while (end < count && get_block_longhash_cn_type(nettype, blocks[end]->major_version) == cn_type)
+        ++end;
+
+      blobs.clear();
+      views.clear();
+      for (size_t j = i; j < end; j++)
+        blobs.push_back(get_block_hashing_blob(*blocks[j]));
+      for (auto &blob : blobs)
+        views.emplace_back(blob);
+      crypto::cn_slow_hash_multi(views.data(), hashes + i, views.size(), *cn_type);
+      i = end;
     }
-
-    crypto::cn_slow_hash(bd.data(), bd.size(), result, cn_type);
-    return result;
   }
 
   crypto::hash get_block_longhash_w_blockchain(cryptonote::network_type nettype, const Blockchain *pbc, const block& b, uint64_t height, int miners)
@@ -1134,6 +1163,40 @@ namespace cryptonote
     return result;
   }
 
+  void get_block_longhashes_w_blockchain(cryptonote::network_type nettype, const Blockchain *pbc, block b, uint64_t height, int miners, const uint32_t* nonces, crypto::hash* hashes, size_t count)
+  {
+    const randomx_longhash_context randomx_context{pbc, b, height};
+    if (get_block_longhash_cn_type(nettype, b.major_version))
+    {
+      for (size_t i = 0; i < count; i++)
+      {
+        b.nonce = nonces[i];
+        hashes[i] = get_block_longhash(nettype, randomx_context, b, height, miners);
+      }
+      return;
+    }
+
+#if defined(OXEN_INTEGRATION_TESTS)
+    miners = 0;
+#endif
+
+    // The nonce is the only thing that differs between the hashing blobs: it follows the version,
+    // timestamp varints and prev_id in the header.
+    const size_t nonce_offset = tools::get_varint_data(b.major_version).size() + tools::get_varint_data(b.minor_version).size() +
+      tools::get_varint_data(b.timestamp).size() + sizeof(b.prev_id);
+    const blobdata bd = get_block_hashing_blob(b);
+    rx_slow_hash_batch(randomx_context.current_blockchain_height,
+                       randomx_context.seed_height,
+                       randomx_context.seed_block_hash.data,
+                       bd.data(),
+                       bd.size(),
+                       nonce_offset,
+                       nonces,
+                       reinterpret_cast<char*>(hashes),
+                       count,
+                       miners);
+  }
+
   void get_block_longhash_reorg(const uint64_t split_height)
   {
     rx_reorg(split_height);
@@ -29,6 +29,7 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #pragma once
+#include <optional>
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/utility.hpp>
@@ -253,9 +254,18 @@ namespace cryptonote
   };
 
   class Blockchain;
+  // The CryptoNight variant of the PoW of a block with the given major version, or nullopt if its PoW is RandomX
+  std::optional<crypto::cn_slow_hash_type> get_block_longhash_cn_type(cryptonote::network_type nettype, uint8_t hf_version);
   crypto::hash get_block_longhash(cryptonote::network_type nettype, randomx_longhash_context const &randomx_context, const block& b, uint64_t height, int miners);
+  // get_block_longhash() of each of `count` blocks, with contexts[i] and heights[i] for blocks[i]:
+  // runs of CryptoNight Heavy blocks get hashed several at a time on this thread (see
+  // crypto::cn_slow_hash_multi), other blocks one by one.
+  void get_block_longhashes(cryptonote::network_type nettype, const block* const* blocks, const randomx_longhash_context* contexts, const uint64_t* heights, crypto::hash* hashes, size_t count);
   crypto::hash get_altblock_longhash(cryptonote::network_type nettype, randomx_longhash_context const &randomx_context, const block& b, uint64_t height);
   crypto::hash get_block_longhash_w_blockchain(cryptonote::network_type nettype, const Blockchain *pb, const block& b, uint64_t height, int miners);
+  // get_block_longhash_w_blockchain() of `b` with each of the `count` nonces in `nonces`; RandomX
+  // hashes get pipelined (see rx_slow_hash_batch), which is what the miner uses.
+  void get_block_longhashes_w_blockchain(cryptonote::network_type nettype, const Blockchain *pb, block b, uint64_t height, int miners, const uint32_t* nonces, crypto::hash* hashes, size_t count);
   void get_block_longhash_reorg(const uint64_t split_height);
 
 }
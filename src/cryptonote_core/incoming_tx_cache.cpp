@@ -0,0 +1,67 @@
+#include "incoming_tx_cache.h"
+
+#include <algorithm>
+
+namespace cryptonote
+{
+
+incoming_tx_cache::incoming_tx_cache(size_t max_size)
+  : m_max_generation_size{std::max<size_t>(1, max_size / NUM_SHARDS / 2)}
+{}
+
+crypto::hash incoming_tx_cache::blob_hash(std::string_view blob)
+{
+  crypto::hash h;
+  crypto::cn_fast_hash(blob.data(), blob.size(), h);
+  return h;
+}
+
+std::optional<incoming_tx_cache::entry> incoming_tx_cache::find(const crypto::hash& blob_hash) const
+{
+  auto& s = shard_for(blob_hash);
+  std::lock_guard lock{s.mutex};
+  for (auto& gen : s.generations)
+    if (auto it = gen.find(blob_hash); it != gen.end())
+      return it->second;
+  return std::nullopt;
+}
+
+void incoming_tx_cache::insert(shard& s, const crypto::hash& blob_hash, const entry& e)
+{
+  s.generations[0].insert_or_assign(blob_hash, e);
+  s.generations[1].erase(blob_hash);
+  if (s.generations[0].size() >= m_max_generation_size)
+  {
+    std::swap(s.generations[0], s.generations[1]);
+    s.generations[0].clear();
+  }
+}
+
+void incoming_tx_cache::add(const crypto::hash& blob_hash, const crypto::hash& tx_hash)
+{
+  auto& s = shard_for(blob_hash);
+  std::lock_guard lock{s.mutex};
+  for (auto& gen : s.generations)
+    if (auto it = gen.find(blob_hash); it != gen.end() && it->second.rejected)
+      return;
+  insert(s, blob_hash, entry{tx_hash, false});
+}
+
+void incoming_tx_cache::reject(const crypto::hash& blob_hash, const crypto::hash& tx_hash)
+{
+  auto& s = shard_for(blob_hash);
+  std::lock_guard lock{s.mutex};
+  insert(s, blob_hash, entry{tx_hash, true});
+}
+
+void incoming_tx_cache::clear()
+{
+  for (auto& s : m_shards)
+  {
+    std::lock_guard lock{s.mutex};
+    for (auto& gen : s.generations)
+      gen.clear();
+  }
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+
+// Remembers recently received tx blobs by the (keccak) hash of the blob itself, so that when the
+// same tx arrives again (from other peers, or again over RPC) it needn't be parsed and hashed to
+// find out that we already have it or that it was already rejected as malformed.  Only intrinsic
+// failures (unparseable blobs, bad semantics) are remembered as rejections: anything depending on
+// the chain or the pool gets checked again as usual.
+//
+// Entries live in two generations, as with core's bad_semantics_txes: when the newer one fills up
+// it becomes the older one and the old older one is dropped, so entries are short-lived and the
+// size is bounded.  Thread-safe; the entries are spread over independently locked shards because
+// the lookups happen in parallel on the threadpool.
+class incoming_tx_cache
+{
+public:
+  struct entry
+  {
+    crypto::hash tx_hash; // null if the blob was rejected before it could be hashed
+    bool rejected;
+  };
+
+  // `max_size` is the (approximate) maximum number of entries
+  explicit incoming_tx_cache(size_t max_size);
+
+  static crypto::hash blob_hash(std::string_view blob);
+
+  std::optional<entry> find(const crypto::hash& blob_hash) const;
+  // Records a blob that parsed to tx `tx_hash`; does not override a rejection
+  void add(const crypto::hash& blob_hash, const crypto::hash& tx_hash);
+  void reject(const crypto::hash& blob_hash, const crypto::hash& tx_hash = crypto::null_hash);
+  void clear();
+
+private:
+  static constexpr size_t NUM_SHARDS = 16;
+  struct shard
+  {
+    mutable std::mutex mutex;
+    std::unordered_map<crypto::hash, entry> generations[2];
+  };
+
+  shard& shard_for(const crypto::hash& blob_hash) { return m_shards[static_cast<unsigned char>(blob_hash.data[0]) % NUM_SHARDS]; }
+  const shard& shard_for(const crypto::hash& blob_hash) const { return m_shards[static_cast<unsigned char>(blob_hash.data[0]) % NUM_SHARDS]; }
+  void insert(shard& s, const crypto::hash& blob_hash, const entry& e);
+
+  std::array<shard, NUM_SHARDS> m_shards;
+  size_t m_max_generation_size;
+};
+
+}
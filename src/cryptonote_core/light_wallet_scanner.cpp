@@ -0,0 +1,600 @@
+#include "light_wallet_scanner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "blockchain.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "device/device.hpp"
+#include "lmdb/database.h"
+#include "lmdb/error.h"
+#include "lmdb/table.h"
+#include "lmdb/util.h"
+#include "ringct/rctSigs.h"
+
+#undef OXEN_DEFAULT_LOG_CATEGORY
+#define OXEN_DEFAULT_LOG_CATEGORY "light_wallet"
+
+namespace cryptonote
+{
+
+namespace
+{
+  // Most blocks scanned (and held in memory) at once when catching up
+  constexpr uint64_t SCAN_BATCH_BLOCKS = 100;
+
+  struct account_record
+  {
+    account_public_address address;
+    crypto::secret_key view_key;
+    uint64_t start_height;
+    uint64_t scanned_height;
+  };
+
+  // Outputs and spends are stored as dups of their account id, in the order of their bytes: they are
+  // put back in chain order when loaded.
+  constexpr lmdb::table accounts_table{"accounts", MDB_CREATE | MDB_INTEGERKEY, nullptr, nullptr};
+  constexpr lmdb::table outputs_table{"outputs", MDB_CREATE | MDB_INTEGERKEY | MDB_DUPSORT, nullptr, nullptr};
+  constexpr lmdb::table spends_table{"spends", MDB_CREATE | MDB_INTEGERKEY | MDB_DUPSORT, nullptr, nullptr};
+
+  template <typename T>
+  expect<void> put(MDB_txn& txn, MDB_dbi dbi, const uint32_t& id, const T& value)
+  {
+    MDB_val key = lmdb::to_val(id);
+    MDB_val val = lmdb::to_val(value);
+    MONERO_LMDB_CHECK(mdb_put(&txn, dbi, &key, &val, 0));
+    return success();
+  }
+
+  expect<void> del(MDB_txn& txn, MDB_dbi dbi, const uint32_t& id)
+  {
+    MDB_val key = lmdb::to_val(id);
+    const int err = mdb_del(&txn, dbi, &key, nullptr);
+    if (err && err != MDB_NOTFOUND)
+      return {lmdb::error(err)};
+    return success();
+  }
+
+  // Calls f(id, value) for each record of `dbi`
+  template <typename T, typename F>
+  expect<void> for_each(MDB_txn& txn, MDB_dbi dbi, F f)
+  {
+    auto cursor = lmdb::open_cursor<lmdb::close_cursor>(txn, dbi);
+    if (!cursor)
+      return cursor.error();
+
+    MDB_val key, val;
+    int err = mdb_cursor_get(cursor->get(), &key, &val, MDB_FIRST);
+    for (; !err; err = mdb_cursor_get(cursor->get(), &key, &val, MDB_NEXT))
+    {
+      if (key.mv_size != sizeof(uint32_t) || val.mv_size != sizeof(T))
+        return {lmdb::error(MDB_CORRUPTED)};
+      uint32_t id;
+      T value;
+      std::memcpy(&id, key.mv_data, sizeof(id));
+      std::memcpy(&value, val.mv_data, sizeof(value));
+      f(id, value);
+    }
+    if (err != MDB_NOTFOUND)
+      return {lmdb::error(err)};
+    return success();
+  }
+
+  // What a scan of a tx found for one account
+  struct tx_matches
+  {
+    uint32_t account;
+    std::vector<light_wallet_scanner::output> outputs;
+  };
+
+  // A RingCT input of a scanned block, with its ring as absolute global indices
+  struct ring_input
+  {
+    crypto::hash tx_hash;
+    crypto::key_image key_image;
+    std::vector<uint64_t> ring;
+  };
+
+  struct scanned_block
+  {
+    uint64_t height;
+    uint64_t timestamp;
+    std::vector<tx_matches> matches;
+    std::vector<ring_input> inputs;
+  };
+
+  struct scan_target
+  {
+    uint32_t id;
+    account_public_address address;
+    crypto::secret_key view_key;
+  };
+
+  uint32_t get_mixin(const transaction& tx)
+  {
+    for (auto& in : tx.vin)
+      if (auto* in_key = std::get_if<txin_to_key>(&in); in_key && !in_key->key_offsets.empty())
+        return in_key->key_offsets.size() - 1;
+    return 0;
+  }
+
+  // Looks for the outputs of `tx` that belong to `target`.  `tx_pub_keys` are the tx's main tx
+  // public key followed by its additional ones (which, if present, go with the output of the same
+  // index); the derivations for them are computed once for all the outputs.
+  std::vector<light_wallet_scanner::output> scan_tx(
+      const transaction& tx,
+      const crypto::hash& tx_hash,
+      const std::vector<uint64_t>& global_indices,
+      const std::vector<crypto::public_key>& tx_pub_keys,
+      const scan_target& target,
+      uint64_t height,
+      uint64_t timestamp,
+      bool coinbase)
+  {
+    std::vector<light_wallet_scanner::output> found;
+
+    std::vector<std::optional<crypto::key_derivation>> derivations(tx_pub_keys.size());
+    auto get_derivation = [&](size_t k) -> const crypto::key_derivation* {
+      if (!derivations[k])
+      {
+        crypto::key_derivation d;
+        if (!crypto::generate_key_derivation(tx_pub_keys[k], target.view_key, d))
+          return nullptr;
+        derivations[k] = d;
+      }
+      return &*derivations[k];
+    };
+
+    for (size_t i = 0; i < tx.vout.size() && i < global_indices.size(); i++)
+    {
+      auto* out_key = std::get_if<txout_to_key>(&tx.vout[i].target);
+      if (!out_key)
+        continue;
+
+      // Outputs of txs with additional tx public keys can be to either key
+      size_t key_index = 0;
+      const crypto::key_derivation* derivation = nullptr;
+      for (size_t k : {size_t{0}, i + 1})
+      {
+        if (k >= tx_pub_keys.size())
+          break;
+        crypto::public_key derived;
+        const crypto::key_derivation* d = get_derivation(k);
+        if (d && crypto::derive_public_key(*d, i, target.address.m_spend_public_key, derived) && derived == out_key->key)
+        {
+          key_index = k;
+          derivation = d;
+          break;
+        }
+      }
+      if (!derivation)
+        continue;
+
+      auto& o = found.emplace_back();
+      o.height = height;
+      o.timestamp = timestamp;
+      o.global_index = global_indices[i];
+      o.unlock_time = tx.get_unlock_time(i);
+      o.tx_unlock_time = tx.unlock_time;
+      o.tx_hash = tx_hash;
+      o.tx_prefix_hash = get_transaction_prefix_hash(tx);
+      o.key = out_key->key;
+      o.tx_pub_key = tx_pub_keys[key_index];
+      o.index = i;
+      o.mixin = get_mixin(tx);
+      o.coinbase = coinbase;
+      o.rct = tx.version >= txversion::v2_ringct;
+      o.ecdh_info = {};
+      o.amount = tx.vout[i].amount;
+      o.commitment = rct::zeroCommit(o.amount);
+
+      const auto rct_type = tx.rct_signatures.type;
+      if (o.rct && rct_type != rct::RCTType::Null)
+      {
+        hw::device& hwdev = hw::get_device("default");
+        crypto::secret_key scalar;
+        hwdev.derivation_to_scalar(*derivation, i, scalar);
+        rct::key mask;
+        try
+        {
+          o.amount = rct::is_rct_simple(rct_type)
+            ? rct::decodeRctSimple(tx.rct_signatures, rct::sk2rct(scalar), i, mask, hwdev)
+            : rct::decodeRct(tx.rct_signatures, rct::sk2rct(scalar), i, mask, hwdev);
+        }
+        catch (const std::exception& e)
+        {
+          MWARNING("Failed to decode the amount of output " << i << " of tx " << tx_hash << ": " << e.what());
+          found.pop_back();
+          continue;
+        }
+        o.commitment = tx.rct_signatures.outPk[i].mask;
+        // The light wallet API has the mask encrypted the way it was before Bulletproof2 txs (which
+        // derive it instead), whatever the tx's type
+        sc_add(o.ecdh_info.mask.bytes, mask.bytes, rct::hash_to_scalar(rct::sk2rct(scalar)).bytes);
+        o.ecdh_info.amount = tx.rct_signatures.ecdhInfo[i].amount;
+      }
+    }
+    return found;
+  }
+
+  void scan_tx(
+      const transaction& tx,
+      const std::vector<uint64_t>& global_indices,
+      const std::vector<scan_target>& targets,
+      scanned_block& result,
+      bool coinbase)
+  {
+    const crypto::hash tx_hash = get_transaction_hash(tx);
+
+    std::vector<crypto::public_key> tx_pub_keys;
+    tx_pub_keys.push_back(get_tx_pub_key_from_extra(tx));
+    for (auto& k : get_additional_tx_pub_keys_from_extra(tx))
+      tx_pub_keys.push_back(k);
+
+    if (!tx.vout.empty() && global_indices.size() == tx.vout.size())
+      for (auto& target : targets)
+        if (auto outputs = scan_tx(tx, tx_hash, global_indices, tx_pub_keys, target, result.height, result.timestamp, coinbase); !outputs.empty())
+          result.matches.push_back({target.id, std::move(outputs)});
+
+    for (auto& in : tx.vin)
+    {
+      auto* in_key = std::get_if<txin_to_key>(&in);
+      if (!in_key || in_key->amount != 0)
+        continue;
+      result.inputs.push_back({tx_hash, in_key->k_image, relative_output_offsets_to_absolute(in_key->key_offsets)});
+    }
+  }
+}
+
+//---------------------------------------------------------------
+light_wallet_scanner::light_wallet_scanner(Blockchain& blockchain)
+  : m_blockchain{blockchain}
+{}
+//---------------------------------------------------------------
+light_wallet_scanner::~light_wallet_scanner()
+{
+  stop();
+}
+//---------------------------------------------------------------
+void light_wallet_scanner::start(const fs::path& dir)
+{
+  std::error_code ec;
+  if (!fs::exists(dir, ec))
+    fs::create_directories(dir, ec);
+  if (ec)
+    throw std::runtime_error{"Failed to create light wallet scanner directory " + dir.u8string() + ": " + ec.message()};
+
+  auto env = lmdb::open_environment(dir.u8string().c_str(), 3);
+  if (!env)
+    throw std::runtime_error{"Failed to open light wallet scanner database in " + dir.u8string() + ": " + env.error().message()};
+  m_db = std::make_unique<lmdb::database>(std::move(*env));
+
+  std::unique_lock lock{m_mutex};
+  auto loaded = m_db->try_write([this](MDB_txn& txn) -> expect<void> {
+    m_accounts.clear();
+    m_ids.clear();
+    m_owned.clear();
+    m_next_id = 0;
+
+    for (auto [table, dbi] : {std::pair{&accounts_table, &m_accounts_dbi}, {&outputs_table, &m_outputs_dbi}, {&spends_table, &m_spends_dbi}})
+    {
+      auto opened = table->open(txn);
+      if (!opened)
+        return opened.error();
+      *dbi = *opened;
+    }
+
+    MONERO_CHECK(for_each<account_record>(txn, m_accounts_dbi, [this](uint32_t id, const account_record& r) {
+      auto& a = m_accounts[id];
+      a.address = r.address;
+      a.view_key = r.view_key;
+      a.info.start_height = r.start_height;
+      a.info.scanned_height = r.scanned_height;
+      m_ids[r.address] = id;
+      m_next_id = std::max(m_next_id, id + 1);
+    }));
+    MONERO_CHECK(for_each<output>(txn, m_outputs_dbi, [this](uint32_t id, const output& o) {
+      if (auto it = m_accounts.find(id); it != m_accounts.end())
+        it->second.info.outputs.push_back(o);
+    }));
+    MONERO_CHECK(for_each<spend>(txn, m_spends_dbi, [this](uint32_t id, const spend& s) {
+      if (auto it = m_accounts.find(id); it != m_accounts.end())
+        it->second.info.spends.push_back(s);
+    }));
+    return success();
+  });
+  if (!loaded)
+    throw std::runtime_error{"Failed to load light wallet scanner database: " + loaded.error().message()};
+
+  for (auto& [id, a] : m_accounts)
+  {
+    auto& outs = a.info.outputs;
+    std::sort(outs.begin(), outs.end(), [](const output& x, const output& y) {
+      return std::tie(x.height, x.global_index) < std::tie(y.height, y.global_index); });
+    for (auto& o : outs)
+      if (o.rct)
+        m_owned[o.global_index] = id;
+    std::stable_sort(a.info.spends.begin(), a.info.spends.end(), [](const spend& x, const spend& y) {
+      return x.height < y.height; });
+  }
+  MGINFO("Light wallet scanner loaded " << m_accounts.size() << " accounts from " << dir);
+
+  m_chain_height = m_blockchain.get_current_blockchain_height();
+  m_stop = false;
+  m_thread = std::thread{[this] { scan_loop(); }};
+}
+//---------------------------------------------------------------
+void light_wallet_scanner::stop()
+{
+  {
+    std::lock_guard lock{m_mutex};
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  if (m_thread.joinable())
+    m_thread.join();
+}
+//---------------------------------------------------------------
+const light_wallet_scanner::account* light_wallet_scanner::find(const account_public_address& address, const crypto::secret_key& view_key) const
+{
+  auto it = m_ids.find(address);
+  if (it == m_ids.end())
+    return nullptr;
+  const account& a = m_accounts.at(it->second);
+  if (a.view_key != view_key)
+    return nullptr;
+  return &a;
+}
+//---------------------------------------------------------------
+light_wallet_scanner::login_result light_wallet_scanner::login(const account_public_address& address, const crypto::secret_key& view_key, bool create)
+{
+  crypto::public_key view_pub;
+  if (!crypto::secret_key_to_public_key(view_key, view_pub) || view_pub != address.m_view_public_key)
+    return login_result::wrong_view_key;
+
+  std::unique_lock lock{m_mutex};
+  if (!m_db)
+    return login_result::not_found;
+  if (m_ids.count(address))
+    return find(address, view_key) ? login_result::found : login_result::wrong_view_key;
+  if (!create)
+    return login_result::not_found;
+
+  const uint32_t id = m_next_id++;
+  auto& a = m_accounts[id];
+  a.address = address;
+  a.view_key = view_key;
+  a.info.start_height = a.info.scanned_height = m_chain_height;
+  m_ids[address] = id;
+  store({{id, change{}}});
+  MINFO("Registered light wallet account " << id << " at height " << a.info.start_height);
+  return login_result::created;
+}
+//---------------------------------------------------------------
+bool light_wallet_scanner::rescan(const account_public_address& address, const crypto::secret_key& view_key)
+{
+  {
+    std::unique_lock lock{m_mutex};
+    auto* found = find(address, view_key);
+    if (!found)
+      return false;
+    const uint32_t id = m_ids.at(address);
+    auto& a = m_accounts.at(id);
+    for (auto& o : a.info.outputs)
+      if (o.rct)
+        m_owned.erase(o.global_index);
+    a.info.outputs.clear();
+    a.info.spends.clear();
+    a.info.start_height = a.info.scanned_height = 0;
+    store({{id, change{0, 0, true}}});
+  }
+  m_wake.notify_all();
+  return true;
+}
+//---------------------------------------------------------------
+std::optional<light_wallet_scanner::account_info> light_wallet_scanner::get_account(const account_public_address& address, const crypto::secret_key& view_key) const
+{
+  std::unique_lock lock{m_mutex};
+  if (auto* a = find(address, view_key))
+    return a->info;
+  return std::nullopt;
+}
+//---------------------------------------------------------------
+bool light_wallet_scanner::block_added(const block& block, const std::vector<transaction>&, checkpoint_t const*)
+{
+  // The scanning thread reads the block back from the blockchain: we don't want to hold up adding
+  // blocks with the scan.
+  m_chain_height = get_block_height(block) + 1;
+  m_wake.notify_all();
+  return true;
+}
+//---------------------------------------------------------------
+void light_wallet_scanner::blockchain_detached(uint64_t height, bool /*by_pop_blocks*/)
+{
+  std::unique_lock lock{m_mutex};
+  m_chain_height = height;
+  m_generation++;
+  if (!m_db)
+    return;
+
+  std::unordered_map<uint32_t, change> changes;
+  for (auto& [id, a] : m_accounts)
+  {
+    if (a.info.scanned_height <= height)
+      continue;
+    auto& outs = a.info.outputs;
+    auto first_out = std::find_if(outs.begin(), outs.end(), [height](const output& o) { return o.height >= height; });
+    for (auto it = first_out; it != outs.end(); ++it)
+      if (it->rct)
+        m_owned.erase(it->global_index);
+    outs.erase(first_out, outs.end());
+    auto& spends = a.info.spends;
+    spends.erase(std::find_if(spends.begin(), spends.end(), [height](const spend& s) { return s.height >= height; }), spends.end());
+    a.info.scanned_height = height;
+    a.info.start_height = std::min(a.info.start_height, height);
+    changes.emplace(id, change{0, 0, true});
+  }
+  if (!changes.empty())
+  {
+    try { store(changes); }
+    catch (const std::exception& e) { MERROR(e.what()); }
+  }
+}
+//---------------------------------------------------------------
+void light_wallet_scanner::store(const std::unordered_map<uint32_t, change>& changes)
+{
+  auto written = m_db->try_write([&](MDB_txn& txn) -> expect<void> {
+    for (auto& [id, ch] : changes)
+    {
+      const auto& a = m_accounts.at(id);
+      account_record r{a.address, a.view_key, a.info.start_height, a.info.scanned_height};
+      MONERO_CHECK(put(txn, m_accounts_dbi, id, r));
+      if (ch.rewrite)
+      {
+        MONERO_CHECK(del(txn, m_outputs_dbi, id));
+        MONERO_CHECK(del(txn, m_spends_dbi, id));
+      }
+      for (size_t i = ch.rewrite ? 0 : ch.outputs_from; i < a.info.outputs.size(); i++)
+        MONERO_CHECK(put(txn, m_outputs_dbi, id, a.info.outputs[i]));
+      for (size_t i = ch.rewrite ? 0 : ch.spends_from; i < a.info.spends.size(); i++)
+        MONERO_CHECK(put(txn, m_spends_dbi, id, a.info.spends[i]));
+    }
+    return success();
+  });
+  if (!written)
+    throw std::runtime_error{"Failed to write light wallet scanner database: " + written.error().message()};
+}
+//---------------------------------------------------------------
+void light_wallet_scanner::scan_loop()
+{
+  std::unique_lock lock{m_mutex};
+  while (!m_stop)
+  {
+    // Take the accounts furthest along that still have blocks to scan: that keeps those at the tip
+    // current, with accounts still catching up going a batch at a time in between.
+    const uint64_t chain_height = m_chain_height;
+    std::optional<uint64_t> start;
+    for (auto& [id, a] : m_accounts)
+      if (a.info.scanned_height < chain_height && (!start || a.info.scanned_height > *start))
+        start = a.info.scanned_height;
+    if (!start)
+    {
+      m_wake.wait(lock);
+      continue;
+    }
+
+    const uint64_t end = std::min(chain_height, *start + SCAN_BATCH_BLOCKS);
+    std::vector<scan_target> targets;
+    for (auto& [id, a] : m_accounts)
+      if (a.info.scanned_height == *start)
+        targets.push_back({id, a.address, a.view_key});
+    const uint64_t generation = m_generation;
+    lock.unlock();
+
+    std::vector<scanned_block> scanned;
+    std::vector<std::pair<blobdata, block>> blocks;
+    std::vector<blobdata> tx_blobs;
+    bool ok = m_blockchain.get_blocks(*start, end - *start, blocks, tx_blobs);
+    size_t tx_pos = 0;
+    for (size_t b = 0; ok && b < blocks.size(); b++)
+    {
+      const block& blk = blocks[b].second;
+      auto& result = scanned.emplace_back();
+      result.height = *start + b;
+      result.timestamp = blk.timestamp;
+
+      std::vector<std::vector<uint64_t>> indices;
+      if (!m_blockchain.get_tx_outputs_gindexs(get_transaction_hash(blk.miner_tx), blk.tx_hashes.size() + 1, indices)
+          || indices.size() != blk.tx_hashes.size() + 1
+          || tx_pos + blk.tx_hashes.size() > tx_blobs.size())
+      {
+        ok = false;
+        break;
+      }
+
+      scan_tx(blk.miner_tx, indices[0], targets, result, true);
+      for (size_t t = 0; t < blk.tx_hashes.size(); t++)
+      {
+        transaction tx;
+        if (!parse_and_validate_tx_base_from_blob(tx_blobs[tx_pos++], tx))
+        {
+          ok = false;
+          break;
+        }
+        scan_tx(tx, indices[t + 1], targets, result, false);
+      }
+    }
+    if (!ok)
+      scanned.clear();
+
+    lock.lock();
+    if (m_stop)
+      break;
+    if (scanned.empty())
+    {
+      // The blocks went away (or could not be read): try again once something changes
+      m_wake.wait_for(lock, std::chrono::seconds{10});
+      continue;
+    }
+    if (generation != m_generation)
+      continue;
+
+    std::unordered_map<uint32_t, change> changes;
+    for (auto& t : targets)
+    {
+      auto it = m_accounts.find(t.id);
+      // Skip accounts that were reset while we were scanning
+      if (it != m_accounts.end() && it->second.info.scanned_height == *start)
+        changes.emplace(t.id, change{it->second.info.outputs.size(), it->second.info.spends.size(), false});
+    }
+
+    for (auto& result : scanned)
+    {
+      for (auto& m : result.matches)
+      {
+        if (!changes.count(m.account))
+          continue;
+        auto& outs = m_accounts.at(m.account).info.outputs;
+        for (auto& o : m.outputs)
+        {
+          if (o.rct)
+            m_owned[o.global_index] = m.account;
+          outs.push_back(std::move(o));
+        }
+      }
+      for (auto& in : result.inputs)
+      {
+        for (uint64_t gi : in.ring)
+        {
+          auto it = m_owned.find(gi);
+          if (it == m_owned.end() || !changes.count(it->second))
+            continue;
+          auto& s = m_accounts.at(it->second).info.spends.emplace_back();
+          s.height = result.height;
+          s.timestamp = result.timestamp;
+          s.out_global_index = gi;
+          s.tx_hash = in.tx_hash;
+          s.key_image = in.key_image;
+          s.mixin = in.ring.size() - 1;
+        }
+      }
+    }
+
+    const uint64_t scanned_to = *start + scanned.size();
+    for (auto& [id, ch] : changes)
+      m_accounts.at(id).info.scanned_height = scanned_to;
+
+    try
+    {
+      store(changes);
+    }
+    catch (const std::exception& e)
+    {
+      MERROR(e.what() << "; stopping the light wallet scanner");
+      m_stop = true;
+    }
+  }
+}
+
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common/fs.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/cryptonote_basic_impl.h"
+#include "ringct/rctTypes.h"
+
+namespace lmdb { class database; }
+
+namespace cryptonote
+{
+
+class Blockchain;
+
+// Server side scanning for light wallets (the MyMonero-style API of wallet/wallet_light_rpc.h): a
+// light wallet registers its address and view key, and the daemon finds the outputs received by
+// the address, and the inputs that might spend them, so that the wallet doesn't have to pull and
+// scan every block itself.
+//
+// All scanning happens in a background thread, which BlockAddedHook wakes up.  Each block is
+// scanned once for all the accounts that have reached its height, accounts that are further behind
+// (newly imported ones) being caught up in batches read from the blockchain, in turns with keeping
+// the others at the tip.  What is found is kept in memory for the RPC calls and in the scanner's
+// own LMDB database, which is written once per batch.
+//
+// Only the primary address of an account is scanned for, and only RingCT inputs are checked for
+// spends (which, without the spend key, can only be candidates: the wallet works out which of the
+// key images are its own).
+//
+// Thread-safe.
+class light_wallet_scanner : public BlockAddedHook, public BlockchainDetachedHook
+{
+public:
+  // What is stored, as is, for a received output
+  struct output
+  {
+    uint64_t height;
+    uint64_t timestamp;
+    uint64_t global_index; // RingCT (amount 0) index, or the index among outputs of `amount` if !rct
+    uint64_t amount;
+    uint64_t unlock_time;  // of this output
+    uint64_t tx_unlock_time;
+    crypto::hash tx_hash;
+    crypto::hash tx_prefix_hash;
+    crypto::public_key key;
+    crypto::public_key tx_pub_key; // the one the output was found with
+    rct::key commitment;
+    rct::ecdhTuple ecdh_info; // with the mask encrypted as it was before Bulletproof2 txs
+    uint32_t index; // in the tx
+    uint32_t mixin; // of the tx
+    bool coinbase;
+    bool rct;
+  };
+
+  // An input that might spend one of the account's outputs: that output is one of its ring members
+  struct spend
+  {
+    uint64_t height;
+    uint64_t timestamp;
+    uint64_t out_global_index; // of the account's output
+    crypto::hash tx_hash;
+    crypto::key_image key_image;
+    uint32_t mixin;
+  };
+
+  struct account_info
+  {
+    uint64_t start_height;
+    uint64_t scanned_height; // blocks below this height have been scanned
+    std::vector<output> outputs; // in chain order
+    std::vector<spend> spends;   // in chain order
+  };
+
+  explicit light_wallet_scanner(Blockchain& blockchain);
+  ~light_wallet_scanner();
+
+  // Opens (creating it if needed) the database in directory `dir`, and starts the scanning thread.
+  // Throws on error.
+  void start(const fs::path& dir);
+  void stop();
+
+  enum class login_result { found, created, not_found, wrong_view_key };
+
+  // Looks up the account of `address`, registering it (to be scanned from the current height) if
+  // there isn't one and `create` is set.  `view_key` must be the address's view key.
+  login_result login(const account_public_address& address, const crypto::secret_key& view_key, bool create);
+
+  // Forgets what was found for the account and scans it again from the genesis block; returns false
+  // (and does nothing) if there is no such account, or `view_key` is not its view key.
+  bool rescan(const account_public_address& address, const crypto::secret_key& view_key);
+
+  // Returns what was found for the account so far, or nullopt if there is no such account or
+  // `view_key` is not its view key.
+  std::optional<account_info> get_account(const account_public_address& address, const crypto::secret_key& view_key) const;
+
+  bool block_added(const block& block, const std::vector<transaction>& txs, checkpoint_t const *checkpoint) override;
+  void blockchain_detached(uint64_t height, bool by_pop_blocks) override;
+
+private:
+  struct account
+  {
+    account_public_address address;
+    crypto::secret_key view_key;
+    account_info info;
+  };
+
+  // What of an account store() has to write: its record, and its outputs and spends from these
+  // indices on; or, if `rewrite`, all of them after deleting those stored.
+  struct change
+  {
+    size_t outputs_from = 0;
+    size_t spends_from = 0;
+    bool rewrite = false;
+  };
+
+  // Scans blocks for the accounts furthest along that aren't at the tip, until stopped
+  void scan_loop();
+  // Writes `changes` in one write txn.  Throws on error.  The caller must hold m_mutex.
+  void store(const std::unordered_map<uint32_t, change>& changes);
+  const account* find(const account_public_address& address, const crypto::secret_key& view_key) const;
+
+  Blockchain& m_blockchain;
+  std::unique_ptr<lmdb::database> m_db;
+  unsigned m_accounts_dbi = 0, m_outputs_dbi = 0, m_spends_dbi = 0;
+
+  mutable std::mutex m_mutex;
+  std::condition_variable m_wake;
+  bool m_stop = false;
+  std::unordered_map<uint32_t, account> m_accounts; // by id
+  std::unordered_map<account_public_address, uint32_t> m_ids;
+  std::unordered_map<uint64_t, uint32_t> m_owned; // accounts of RingCT outputs, by global index
+  uint32_t m_next_id = 0;
+  uint64_t m_generation = 0; // bumped whenever blocks are detached, to invalidate scans in progress
+  std::atomic<uint64_t> m_chain_height{0};
+  std::thread m_thread;
+};
+
+}
@@ -4,6 +4,8 @@
 #include <vector>
 #include <algorithm>
 #include "common/hex.h"
+#include "common/metrics.h"
+#include "common/cache_budget.h"
 #include "oxen_name_system.h"
 
 #include "common/oxen.h"
@@ -528,13 +530,15 @@ bool mapping_record::active(uint64_t blockchain_height) const
   return !expiration_height || blockchain_height <= *expiration_height;
 }
 
+sql_compiled_statement::sql_compiled_statement(name_system_db& nsdb) : db{nsdb.db} {}
+
 bool sql_compiled_statement::compile(std::string_view query, bool optimise_for_multiple_usage)
 {
   sqlite3_stmt* st;
 #if SQLITE_VERSION_NUMBER >= 3020000
-  int prepare_result = sqlite3_prepare_v3(nsdb.db, query.data(), query.size(), optimise_for_multiple_usage ? SQLITE_PREPARE_PERSISTENT : 0, &st, nullptr /*pzTail*/);
+  int prepare_result = sqlite3_prepare_v3(db, query.data(), query.size(), optimise_for_multiple_usage ? SQLITE_PREPARE_PERSISTENT : 0, &st, nullptr /*pzTail*/);
 #else
-  int prepare_result = sqlite3_prepare_v2(nsdb.db, query.data(), query.size(), &st, nullptr /*pzTail*/);
+  int prepare_result = sqlite3_prepare_v2(db, query.data(), query.size(), &st, nullptr /*pzTail*/);
 #endif
 
   if (prepare_result != SQLITE_OK) {
@@ -1191,7 +1195,7 @@ bool name_system_db::validate_ons_tx(uint8_t hf_version, uint64_t blockchain_hei
     if (check_condition(tx.type != cryptonote::txtype::oxen_name_system, reason, tx, ", uses wrong tx type, expected=", cryptonote::txtype::oxen_name_system))
       return false;
 
-    if (check_condition(!cryptonote::get_field_from_tx_extra(tx.extra, ons_extra), reason, tx, ", didn't have oxen name service in the tx_extra"))
+    if (check_condition(!cryptonote::get_field_from_tx_extra(tx, ons_extra), reason, tx, ", didn't have oxen name service in the tx_extra"))
       return false;
   }
 
@@ -1262,7 +1266,7 @@ bool name_system_db::validate_ons_tx(uint8_t hf_version, uint64_t blockchain_hei
   // Burn Validation
   // -----------------------------------------------------------------------------------------------
   {
-    uint64_t burn                = cryptonote::get_burned_amount_from_tx_extra(tx.extra);
+    uint64_t burn                = cryptonote::get_burned_amount_from_tx_extra(tx);
     uint64_t const burn_required = (ons_extra.is_buying() || ons_extra.is_renewing()) ? burn_needed(hf_version, ons_extra.type) : 0;
     if (hf_version == cryptonote::network_version_18 && burn > burn_required && blockchain_height < 524'000) {
         // Testnet sync fix: PR #1433 merged that lowered fees for HF18 while testnet was already on
@@ -1681,6 +1685,21 @@ struct scoped_db_transaction
 scoped_db_transaction::scoped_db_transaction(name_system_db &ons_db)
 : ons_db(ons_db)
 {
+  if (ons_db.bulk_loading)
+  {
+    // Nested inside the bulk load's transaction: a savepoint still lets us roll back just this
+    // block's changes.
+    char *sql_err = nullptr;
+    if (sqlite3_exec(ons_db.db, "SAVEPOINT ons_block;", nullptr, nullptr, &sql_err) != SQLITE_OK)
+    {
+      MERROR("Failed to begin savepoint, reason=" << (sql_err ? sql_err : "??"));
+      sqlite3_free(sql_err);
+      return;
+    }
+    initialised = true;
+    return;
+  }
+
   if (ons_db.transaction_begun)
   {
     MERROR("Failed to begin transaction, transaction exists previously that was not closed properly");
@@ -1702,6 +1721,17 @@ scoped_db_transaction::scoped_db_transaction(name_system_db &ons_db)
 scoped_db_transaction::~scoped_db_transaction()
 {
   if (!initialised) return;
+  if (ons_db.bulk_loading)
+  {
+    char *sql_err = nullptr;
+    if (sqlite3_exec(ons_db.db, commit ? "RELEASE ons_block;" : "ROLLBACK TO ons_block; RELEASE ons_block;", nullptr, nullptr, &sql_err) != SQLITE_OK)
+    {
+      MERROR("Failed to " << (commit ? "release" : "rollback to") << " savepoint in ONS DB, reason=" << (sql_err ? sql_err : "??"));
+      sqlite3_free(sql_err);
+    }
+    return;
+  }
+
   if (!ons_db.transaction_begun)
   {
     MERROR("Trying to apply non-existent transaction (no prior history of a db transaction beginning) to the ONS DB");
@@ -1725,32 +1755,110 @@ auto constexpr DB_VERSION = db_version::v2_full_rows;
 
 constexpr auto EXPIRATION = " (expiration_height IS NULL OR expiration_height >= ?) "sv;
 
+// The statements of each reader
+const std::string GET_MAPPINGS_BY_OWNER_STR = sql_select_mappings_and_owners_prefix
+  + "WHERE ? IN (o1.address, o2.address)"
+  + sql_select_mappings_and_owners_suffix;
+
+const std::string GET_MAPPING_COUNTS_STR = R"(
+  SELECT type, COUNT(*) FROM (
+    SELECT DISTINCT type, name_hash FROM mappings WHERE )" + std::string{EXPIRATION} + R"(
+  )
+  GROUP BY type)";
+
+const std::string RESOLVE_STR = R"(
+SELECT encrypted_value, MAX(update_height), expiration_height
+FROM mappings
+WHERE type = ? AND name_hash = ? AND)" + std::string{EXPIRATION};
+
 } // anon. namespace
 
+bool name_system_db::reader::compile()
+{
+  return resolve_sql.compile(RESOLVE_STR) &&
+         get_mappings_by_owner_sql.compile(GET_MAPPINGS_BY_OWNER_STR) &&
+         get_mapping_counts_sql.compile(GET_MAPPING_COUNTS_STR);
+}
+
+name_system_db::pooled_reader::~pooled_reader()
+{
+  // As in ~name_system_db, the connection goes once the statements are finalized, right after this
+  sqlite3_close_v2(db);
+}
+
+struct name_system_db::reader_lease
+{
+  name_system_db& nsdb;
+  std::unique_ptr<pooled_reader> pooled; // nullptr if using the writable connection
+
+  reader* operator->() { return pooled ? pooled.get() : &nsdb.writer_reader; }
+  ~reader_lease() { if (pooled) nsdb.release_reader(std::move(pooled)); }
+};
+
+std::unique_ptr<name_system_db::pooled_reader> name_system_db::open_reader()
+{
+  auto r = std::make_unique<pooled_reader>();
+  // Each reader is used by one thread at a time, so sqlite needn't serialize access to it
+  int const flags = SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX;
+  if (int sql_open = sqlite3_open_v2(readers_path.c_str(), &r->db, flags, nullptr); sql_open != SQLITE_OK)
+  {
+    MERROR("Failed to open ONS db reader connection at: " << readers_path << ", reason: " << sqlite3_errstr(sql_open));
+    return nullptr;
+  }
+  if (!r->compile())
+    return nullptr;
+  return r;
+}
+
+name_system_db::reader_lease name_system_db::lease_reader()
+{
+  {
+    std::lock_guard lock{readers_mutex};
+    if (!readers_enabled)
+      return {*this, nullptr};
+    if (!idle_readers.empty())
+    {
+      auto r = std::move(idle_readers.back());
+      idle_readers.pop_back();
+      return {*this, std::move(r)};
+    }
+  }
+  return {*this, open_reader()};
+}
+
+void name_system_db::release_reader(std::unique_ptr<pooled_reader> r)
+{
+  std::lock_guard lock{readers_mutex};
+  if (readers_enabled && idle_readers.size() < MAX_IDLE_READERS)
+    idle_readers.push_back(std::move(r));
+}
+
+void name_system_db::set_readers_enabled(bool enabled)
+{
+  std::lock_guard lock{readers_mutex};
+  readers_enabled = enabled && !readers_path.empty();
+  if (!readers_enabled)
+    idle_readers.clear();
+}
+
 bool name_system_db::init(cryptonote::Blockchain const *blockchain, cryptonote::network_type nettype, sqlite3 *db)
 {
   if (!db) return false;
   this->db      = db;
   this->nettype = nettype;
+  if (!resolve_cache_budget)
+  {
+    resolve_cache_budget = tools::cache_budget::add("ons_resolve", tools::cache_budget::priority::ons_resolve, [this](size_t bytes) {
+      std::lock_guard lock{resolve_cache_mutex};
+      for (size_t target = resolve_cache_bytes > bytes ? resolve_cache_bytes - bytes : 0; resolve_cache_bytes > target && !resolve_cache.empty();)
+        resolve_cache_drop(std::prev(resolve_cache.end()));
+    });
+  }
 
-  std::string const GET_MAPPINGS_BY_OWNER_STR = sql_select_mappings_and_owners_prefix
-    + "WHERE ? IN (o1.address, o2.address)"
-    + sql_select_mappings_and_owners_suffix;
   std::string const GET_MAPPING_STR           = sql_select_mappings_and_owners_prefix
     + "WHERE type = ? AND name_hash = ?"
     + sql_select_mappings_and_owners_suffix;
 
-  const std::string GET_MAPPING_COUNTS_STR = R"(
-    SELECT type, COUNT(*) FROM (
-      SELECT DISTINCT type, name_hash FROM mappings WHERE )" + std::string{EXPIRATION} + R"(
-    )
-    GROUP BY type)";
-
-  std::string const RESOLVE_STR = R"(
-SELECT encrypted_value, MAX(update_height)
-FROM mappings
-WHERE type = ? AND name_hash = ? AND)" + std::string{EXPIRATION};
-
   constexpr auto GET_SETTINGS_STR     = "SELECT * FROM settings WHERE id = 1"sv;
   constexpr auto GET_OWNER_BY_ID_STR  = "SELECT * FROM owner WHERE id = ?"sv;
   constexpr auto GET_OWNER_BY_KEY_STR = "SELECT * FROM owner WHERE address = ?"sv;
@@ -1851,10 +1959,9 @@ AND NOT EXISTS   (SELECT * FROM mappings WHERE owner.id = mappings.backup_owner_
   // Prepare commonly executed sql statements
   //
   // ---------------------------------------------------------------------------
-  if (!get_mappings_by_owner_sql.compile(GET_MAPPINGS_BY_OWNER_STR) ||
+  writer_reader.db = db;
+  if (!writer_reader.compile() ||
       !get_mapping_sql.compile(GET_MAPPING_STR) ||
-      !get_mapping_counts_sql.compile(GET_MAPPING_COUNTS_STR) ||
-      !resolve_sql.compile(RESOLVE_STR) ||
       !get_owner_by_id_sql.compile(GET_OWNER_BY_ID_STR) ||
       !get_owner_by_key_sql.compile(GET_OWNER_BY_KEY_STR) ||
       !prune_mappings_sql.compile(PRUNE_MAPPINGS_STR) ||
@@ -1866,6 +1973,10 @@ AND NOT EXISTS   (SELECT * FROM mappings WHERE owner.id = mappings.backup_owner_
     return false;
   }
 
+  if (const char* filename = sqlite3_db_filename(db, "main"))
+    readers_path = filename;
+  set_readers_enabled(true);
+
   // ---------------------------------------------------------------------------
   //
   // Check settings
@@ -1923,6 +2034,7 @@ AND NOT EXISTS   (SELECT * FROM mappings WHERE owner.id = mappings.backup_owner_
 name_system_db::~name_system_db()
 {
   if (!db) return;
+  if (bulk_loading) end_bulk_load();
 
   {
     scoped_db_transaction db_transaction(*this);
@@ -2097,12 +2209,123 @@ bool add_ons_entry(ons::name_system_db &ons_db, uint64_t height, cryptonote::tx_
 
 } // anon namespace
 
+static bool exec_sql(sqlite3 *db, char const *sql)
+{
+  char *sql_err = nullptr;
+  if (sqlite3_exec(db, sql, nullptr /*callback*/, nullptr /*callback context*/, &sql_err) != SQLITE_OK)
+  {
+    MERROR("Failed to execute \"" << sql << "\" on ONS DB, reason=" << (sql_err ? sql_err : "??"));
+    sqlite3_free(sql_err);
+    return false;
+  }
+  return true;
+}
+
+// Number of blocks committed per SQLite transaction while bulk loading
+constexpr uint64_t BULK_LOAD_BLOCKS_PER_TRANSACTION = 5000;
+
+bool name_system_db::begin_bulk_load()
+{
+  if (bulk_loading) return true;
+
+  // Leaving WAL mode needs the db to ourselves; lookups meanwhile go through this connection.
+  set_readers_enabled(false);
+
+  // Durably mark the db as being rebuilt first: should we not get to end_bulk_load() (which
+  // stores the real top block), init() won't find the top hash in the blockchain and drops the
+  // tables and rescans, rather than trusting data written without a journal.
+  {
+    scoped_db_transaction db_transaction(*this);
+    if (!db_transaction) return false;
+    if (!save_settings(last_processed_height, crypto::null_hash, static_cast<int>(DB_VERSION))) return false;
+    db_transaction.commit = true;
+  }
+
+  // The lookup indexes aren't needed by add_block (name_type_update and owner.address cover its
+  // queries) and are much cheaper to build once at the end than to maintain per insert.
+  if (!exec_sql(db, "PRAGMA journal_mode = OFF") ||
+      !exec_sql(db, "PRAGMA synchronous = OFF") ||
+      !exec_sql(db, "DROP INDEX IF EXISTS owner_id_index; DROP INDEX IF EXISTS mapping_type_name_exp;") ||
+      !exec_sql(db, "BEGIN;"))
+  {
+    end_bulk_load();
+    return false;
+  }
+
+  MGINFO("ONS DB bulk load started at height " << last_processed_height);
+  transaction_begun = true;
+  bulk_loading      = true;
+  bulk_load_blocks  = 0;
+  return true;
+}
+
+bool name_system_db::end_bulk_load()
+{
+  bool result = true;
+  if (bulk_loading)
+  {
+    result = save_settings(last_processed_height, last_processed_hash, static_cast<int>(DB_VERSION)) && exec_sql(db, "END;");
+    bulk_loading      = false;
+    transaction_begun = false;
+    MGINFO("ONS DB bulk load finished at height " << last_processed_height << ", rebuilding indexes");
+  }
+
+  // Restores what bulk loading changed (also cleans up after a begin_bulk_load() that failed
+  // halfway); must match build_default_tables() and sqlite_init().
+  result = exec_sql(db, "CREATE INDEX IF NOT EXISTS owner_id_index ON mappings(owner_id);"
+                        "CREATE INDEX IF NOT EXISTS mapping_type_name_exp ON mappings (type, name_hash, expiration_height DESC);") &&
+           exec_sql(db, "PRAGMA journal_mode = WAL") &&
+           exec_sql(db, "PRAGMA synchronous = NORMAL") &&
+           result;
+  set_readers_enabled(true);
+  return result;
+}
+
+void name_system_db::set_auto_checkpoint(bool on)
+{
+  if (db)
+    sqlite3_wal_autocheckpoint(db, on ? 1000 /* sqlite's default, in pages */ : 0);
+}
+
+bool name_system_db::checkpoint()
+{
+  if (!db || bulk_loading)
+    return true;
+  int ret = sqlite3_wal_checkpoint_v2(db, nullptr, SQLITE_CHECKPOINT_PASSIVE, nullptr, nullptr);
+  if (ret != SQLITE_OK)
+  {
+    MERROR("Failed to checkpoint the ONS db: " << sqlite3_errstr(ret));
+    return false;
+  }
+  return true;
+}
+
+static std::string resolve_cache_key(mapping_type type, std::string_view name_hash_b64)
+{
+  std::string key;
+  key.reserve(1 + name_hash_b64.size());
+  key += static_cast<char>(db_mapping_type(type));
+  key += name_hash_b64;
+  return key;
+}
+
 bool name_system_db::add_block(const cryptonote::block &block, const std::vector<cryptonote::transaction> &txs)
 {
   uint64_t height = cryptonote::get_block_height(block);
   if (last_processed_height >= height)
       return true;
 
+  if (bulk_loading && ++bulk_load_blocks % BULK_LOAD_BLOCKS_PER_TRANSACTION == 0)
+  {
+    if (!exec_sql(db, "END;") || !exec_sql(db, "BEGIN;"))
+      return false;
+  }
+
+  // Readers see the changes once they are committed, which is after the transaction (declared
+  // after this) ends; so as well as when they're made, the cached names go again then.
+  std::vector<std::string> changed_names;
+  OXEN_DEFER { resolve_cache_erase(changed_names); };
+
   scoped_db_transaction db_transaction(*this);
   if (!db_transaction)
    return false;
@@ -2125,6 +2348,8 @@ bool name_system_db::add_block(const cryptonote::block &block, const std::vector
       }
 
       crypto::hash const &tx_hash = cryptonote::get_transaction_hash(tx);
+      changed_names.push_back(resolve_cache_key(entry.type, hash_to_base64(entry.name_hash)));
+      resolve_cache_erase({changed_names.back()});
       if (!add_ons_entry(*this, height, entry, tx_hash))
         return false;
 
@@ -2136,7 +2361,8 @@ bool name_system_db::add_block(const cryptonote::block &block, const std::vector
   last_processed_hash   = cryptonote::get_block_hash(block);
   if (ons_parsed_from_block)
   {
-    save_settings(last_processed_height, last_processed_hash, static_cast<int>(DB_VERSION));
+    if (!bulk_loading) // Bulk loading saves the settings at the end (and keeps the marker until then)
+      save_settings(last_processed_height, last_processed_hash, static_cast<int>(DB_VERSION));
     db_transaction.commit = ons_parsed_from_block;
   }
   return true;
@@ -2224,7 +2450,10 @@ bool name_system_db::save_settings(uint64_t top_height, crypto::hash const &top_
 
 bool name_system_db::prune_db(uint64_t height)
 {
-  if (!bind_and_run(ons_sql_type::pruning, prune_mappings_sql, nullptr, height)) return false;
+  bool pruned = bind_and_run(ons_sql_type::pruning, prune_mappings_sql, nullptr, height);
+  // After the delete, for readers that looked before it
+  resolve_cache_prune(height);
+  if (!pruned) return false;
   if (!sql_run_statement(ons_sql_type::pruning, prune_owners_sql, nullptr)) return false;
 
   this->last_processed_height = (height - 1);
@@ -2276,24 +2505,220 @@ mapping_record name_system_db::get_mapping(mapping_type type, std::string_view n
   return result;
 }
 
+void name_system_db::resolve_cache_erase(const std::vector<std::string>& keys)
+{
+  if (keys.empty())
+    return;
+  std::lock_guard lock{resolve_cache_mutex};
+  resolve_cache_generation++;
+  for (auto& key : keys)
+  {
+    if (auto it = resolve_cache_index.find(key); it != resolve_cache_index.end())
+      resolve_cache_drop(it->second);
+  }
+}
+
+void name_system_db::resolve_cache_prune(uint64_t height)
+{
+  // Rows from `height` on are going away: whatever was resolved from one of them is stale.  (Values
+  // resolved to nothing at a later height stay valid for that height, and aren't used below it).
+  std::lock_guard lock{resolve_cache_mutex};
+  resolve_cache_generation++;
+  for (auto it = resolve_cache.begin(); it != resolve_cache.end();)
+  {
+    if (it->update_height && *it->update_height >= height)
+      it = resolve_cache_drop(it);
+    else
+      ++it;
+  }
+}
+
+bool name_system_db::resolve_cache_get(const std::string& key, uint64_t blockchain_height, std::optional<mapping_value>& value)
+{
+  auto it = resolve_cache_index.find(key);
+  if (it == resolve_cache_index.end())
+    return false;
+  auto &entry = *it->second;
+  if (blockchain_height < entry.min_height || blockchain_height > entry.max_height)
+    return false;
+  resolve_cache.splice(resolve_cache.begin(), resolve_cache, it->second);
+  value = entry.value;
+  return true;
+}
+
+size_t name_system_db::resolve_cache_entry_bytes(const resolve_cache_entry& entry)
+{
+  // The entry's list node, its index node and the key
+  return tools::cache_budget::node_bytes<decltype(resolve_cache)> + tools::cache_budget::node_bytes<decltype(resolve_cache_index)> + entry.key.capacity();
+}
+
+std::list<name_system_db::resolve_cache_entry>::iterator name_system_db::resolve_cache_drop(std::list<resolve_cache_entry>::iterator it)
+{
+  resolve_cache_bytes -= resolve_cache_entry_bytes(*it);
+  resolve_cache_index.erase(it->key);
+  it = resolve_cache.erase(it);
+  resolve_cache_budget.set_size(resolve_cache_bytes);
+  return it;
+}
+
+void name_system_db::resolve_cache_put(resolve_cache_entry entry)
+{
+  if (auto it = resolve_cache_index.find(entry.key); it != resolve_cache_index.end())
+    resolve_cache_drop(it->second);
+  resolve_cache.push_front(std::move(entry));
+  resolve_cache_index.emplace(resolve_cache.front().key, resolve_cache.begin());
+  resolve_cache_bytes += resolve_cache_entry_bytes(resolve_cache.front());
+  if (resolve_cache.size() > RESOLVE_CACHE_SIZE)
+    resolve_cache_drop(std::prev(resolve_cache.end()));
+  else
+    resolve_cache_budget.set_size(resolve_cache_bytes);
+}
+
+void name_system_db::read_resolved(sql_compiled_statement& statement, int column, resolve_cache_entry& entry)
+{
+  // Columns: encrypted_value, MAX(update_height), expiration_height
+  if (auto blob = get<std::optional<blob_view>>(statement, column))
+  {
+    auto& r = entry.value.emplace();
+    assert(blob->data.size() <= r.buffer.size());
+    r.len = blob->data.size();
+    r.encrypted = true;
+    std::copy(blob->data.begin(), blob->data.end(), r.buffer.begin());
+  }
+
+  // The row found stays the newest unexpired one, at any height, until it expires or the name's
+  // mappings change.  If none was found then that holds from here on up.
+  if (auto update_height = get<std::optional<uint64_t>>(statement, column + 1))
+  {
+    entry.update_height = update_height;
+    entry.min_height    = 0;
+    if (auto expiration = get<std::optional<uint64_t>>(statement, column + 2))
+      entry.max_height = *expiration;
+  }
+}
+
 std::optional<mapping_value> name_system_db::resolve(mapping_type type, std::string_view name_hash_b64, uint64_t blockchain_height)
 {
   assert(name_hash_b64.size() == 44 && name_hash_b64.back() == '=' && oxenmq::is_base64(name_hash_b64));
-  std::optional<mapping_value> result;
-  bind_all(resolve_sql, db_mapping_type(type), name_hash_b64, blockchain_height);
-  if (step(resolve_sql) == SQLITE_ROW)
+  static auto &cache_hits   = tools::metrics::get_counter("ons_resolve_cache_hits", OXEN_DEFAULT_LOG_CATEGORY);
+  static auto &cache_misses = tools::metrics::get_counter("ons_resolve_cache_misses", OXEN_DEFAULT_LOG_CATEGORY);
+
+  resolve_cache_entry entry{resolve_cache_key(type, name_hash_b64), std::nullopt, blockchain_height, std::numeric_limits<uint64_t>::max(), std::nullopt};
+  uint64_t generation;
   {
-    if (auto blob = get<std::optional<blob_view>>(resolve_sql, 0))
+    std::lock_guard lock{resolve_cache_mutex};
+    generation = resolve_cache_generation;
+    if (std::optional<mapping_value> value; resolve_cache_get(entry.key, blockchain_height, value))
     {
-      auto& r = result.emplace();
-      assert(blob->data.size() <= r.buffer.size());
-      r.len = blob->data.size();
-      r.encrypted = true;
-      std::copy(blob->data.begin(), blob->data.end(), r.buffer.begin());
+      cache_hits.inc();
+      return value;
     }
   }
+  cache_misses.inc();
+
+  auto reader = lease_reader();
+  auto& resolve_sql = reader->resolve_sql;
+  bind_all(resolve_sql, db_mapping_type(type), name_hash_b64, blockchain_height);
+  if (step(resolve_sql) == SQLITE_ROW)
+    read_resolved(resolve_sql, 0, entry);
   reset(resolve_sql);
   clear_bindings(resolve_sql);
+
+  std::optional<mapping_value> result = entry.value;
+  std::lock_guard lock{resolve_cache_mutex};
+  if (generation == resolve_cache_generation)
+    resolve_cache_put(std::move(entry));
+  return result;
+}
+
+std::vector<std::optional<mapping_value>> name_system_db::resolve(std::vector<std::pair<mapping_type, std::string>> const &names, uint64_t blockchain_height)
+{
+  static auto &cache_hits   = tools::metrics::get_counter("ons_resolve_cache_hits", OXEN_DEFAULT_LOG_CATEGORY);
+  static auto &cache_misses = tools::metrics::get_counter("ons_resolve_cache_misses", OXEN_DEFAULT_LOG_CATEGORY);
+
+  std::vector<std::optional<mapping_value>> result(names.size());
+  // The names that aren't cached: name hash -> indices in `names`, by type
+  std::map<mapping_type, std::unordered_map<std::string_view, std::vector<size_t>>> lookups;
+  uint64_t generation;
+  {
+    std::lock_guard lock{resolve_cache_mutex};
+    generation = resolve_cache_generation;
+    for (size_t i = 0; i < names.size(); i++)
+    {
+      auto& [type, name_hash_b64] = names[i];
+      assert(name_hash_b64.size() == 44 && name_hash_b64.back() == '=' && oxenmq::is_base64(name_hash_b64));
+      if (resolve_cache_get(resolve_cache_key(type, name_hash_b64), blockchain_height, result[i]))
+        cache_hits.inc();
+      else
+      {
+        cache_misses.inc();
+        lookups[type][name_hash_b64].push_back(i);
+      }
+    }
+  }
+  if (lookups.empty())
+    return result;
+
+  // Kept well under sqlite's limit on the number of parameters of a statement
+  constexpr size_t MAX_NAMES_PER_QUERY = 500;
+  std::vector<resolve_cache_entry> entries;
+  auto reader = lease_reader();
+  // So that every query reads the same snapshot.  The writable connection (with no pool) may be in
+  // the middle of add_block's transaction, and is left alone.
+  bool const snapshot = reader.pooled && exec_sql(reader->db, "BEGIN;");
+  for (auto& [type, hashes] : lookups)
+  {
+    std::vector<std::string_view> pending;
+    pending.reserve(hashes.size());
+    for (auto& [name_hash, indices] : hashes)
+      pending.push_back(name_hash);
+
+    for (size_t begin = 0; begin < pending.size(); begin += MAX_NAMES_PER_QUERY)
+    {
+      size_t const end = std::min(pending.size(), begin + MAX_NAMES_PER_QUERY);
+      std::string sql_statement = "SELECT name_hash, encrypted_value, MAX(update_height), expiration_height FROM mappings WHERE type = ? AND name_hash IN (";
+      std::vector<std::variant<uint16_t, uint64_t, std::string_view>> bind;
+      bind.emplace_back(db_mapping_type(type));
+      for (size_t i = begin; i < end; i++)
+      {
+        sql_statement += i > begin ? ", ?" : "?";
+        bind.emplace_back(pending[i]);
+      }
+      sql_statement += ") AND";
+      sql_statement += EXPIRATION;
+      sql_statement += "GROUP BY name_hash";
+      bind.emplace_back(blockchain_height);
+
+      sql_compiled_statement statement{reader->db};
+      if (!statement.compile(sql_statement, false /*optimise_for_multiple_usage*/)
+          || !bind_container(statement, bind))
+        continue;
+
+      while (step(statement) == SQLITE_ROW)
+      {
+        auto it = hashes.find(get<std::string_view>(statement, 0));
+        if (it == hashes.end() || it->second.empty())
+          continue;
+        auto& entry = entries.emplace_back(resolve_cache_entry{resolve_cache_key(type, it->first), std::nullopt, blockchain_height, std::numeric_limits<uint64_t>::max(), std::nullopt});
+        read_resolved(statement, 1, entry);
+        for (size_t i : it->second)
+          result[i] = entry.value;
+        it->second.clear();
+      }
+    }
+
+    // Whatever is left has no unexpired mapping
+    for (auto& [name_hash, indices] : hashes)
+      if (!indices.empty())
+        entries.push_back(resolve_cache_entry{resolve_cache_key(type, name_hash), std::nullopt, blockchain_height, std::numeric_limits<uint64_t>::max(), std::nullopt});
+  }
+  if (snapshot)
+    exec_sql(reader->db, "END;");
+
+  std::lock_guard lock{resolve_cache_mutex};
+  if (generation == resolve_cache_generation)
+    for (auto& entry : entries)
+      resolve_cache_put(std::move(entry));
   return result;
 }
 
@@ -2335,7 +2760,8 @@ std::vector<mapping_record> name_system_db::get_mappings(std::vector<mapping_typ
   sql_statement += sql_select_mappings_and_owners_suffix;
 
   // Compile Statement
-  sql_compiled_statement statement{*this};
+  auto reader = lease_reader();
+  sql_compiled_statement statement{reader->db};
   if (!statement.compile(sql_statement, false /*optimise_for_multiple_usage*/)
       || !bind_container(statement, bind))
     return result;
@@ -2388,7 +2814,8 @@ std::vector<mapping_record> name_system_db::get_mappings_by_owners(std::vector<g
 
   // Compile Statement
   std::vector<mapping_record> result;
-  sql_compiled_statement statement{*this};
+  auto reader = lease_reader();
+  sql_compiled_statement statement{reader->db};
   if (!statement.compile(sql_statement, false /*optimise_for_multiple_usage*/)
       || !bind_container(statement, bind))
     return result;
@@ -2402,7 +2829,7 @@ std::vector<mapping_record> name_system_db::get_mappings_by_owner(generic_owner
 {
   std::vector<mapping_record> result = {};
   blob_view ownerblob{reinterpret_cast<const char*>(&owner), sizeof(owner)};
-  bind_and_run(ons_sql_type::get_mappings_by_owner, get_mappings_by_owner_sql, &result,
+  bind_and_run(ons_sql_type::get_mappings_by_owner, lease_reader()->get_mappings_by_owner_sql, &result,
       ownerblob, ownerblob);
   if (blockchain_height)
   {
@@ -2414,7 +2841,7 @@ std::vector<mapping_record> name_system_db::get_mappings_by_owner(generic_owner
 
 std::map<mapping_type, int> name_system_db::get_mapping_counts(uint64_t blockchain_height) {
   std::map<mapping_type, int> result;
-  bind_and_run(ons_sql_type::get_mapping_counts, get_mapping_counts_sql, &result, blockchain_height);
+  bind_and_run(ons_sql_type::get_mapping_counts, lease_reader()->get_mapping_counts_sql, &result, blockchain_height);
   return result;
 }
 
@@ -6,10 +6,16 @@
 #include "epee/span.h"
 #include "cryptonote_basic/tx_extra.h"
 #include "common/fs.h"
+#include "common/cache_budget.h"
 #include <oxenmq/hex.h>
 
 #include <cassert>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 struct sqlite3;
 struct sqlite3_stmt;
@@ -242,13 +248,15 @@ struct name_system_db;
 class sql_compiled_statement final
 {
 public:
-  /// The name_system_db upon which this object operates
-  name_system_db& nsdb;
+  /// The connection upon which this object operates
+  sqlite3*& db;
   /// The stored, owned statement
   sqlite3_stmt* statement = nullptr;
 
-  /// Constructor; takes a reference to the name_system_db.
-  explicit sql_compiled_statement(name_system_db& nsdb) : nsdb{nsdb} {}
+  /// Constructor; takes a reference to the name_system_db, to operate on its (writable) connection.
+  explicit sql_compiled_statement(name_system_db& nsdb);
+  /// Constructor for a statement on some other connection, such as one of the db's readers.
+  explicit sql_compiled_statement(sqlite3*& db) : db{db} {}
 
   /// Non-copyable (because we own an internal sqlite3 statement handle)
   sql_compiled_statement(const sql_compiled_statement&) = delete;
@@ -256,9 +264,9 @@ public:
 
   /// Move construction; ownership of the internal statement handle, if present, is transferred to
   /// the new object.
-  sql_compiled_statement(sql_compiled_statement&& from) : nsdb{from.nsdb}, statement{from.statement} { from.statement = nullptr; }
+  sql_compiled_statement(sql_compiled_statement&& from) : db{from.db}, statement{from.statement} { from.statement = nullptr; }
 
-  /// Move copying.  The referenced name_system_db must be the same.  Ownership of the internal
+  /// Move copying.  The referenced connection must be the same.  Ownership of the internal
   /// statement handle is transferred.  If the target already has a statement handle then it is
   /// destroyed.
   sql_compiled_statement& operator=(sql_compiled_statement&& from);
@@ -280,6 +288,21 @@ struct name_system_db
   bool                        init        (cryptonote::Blockchain const *blockchain, cryptonote::network_type nettype, sqlite3 *db);
   bool                        add_block   (const cryptonote::block& block, const std::vector<cryptonote::transaction>& txs);
 
+  // Bulk loading mode for replaying many blocks (e.g. rebuilding the db): blocks added between
+  // begin_bulk_load() and end_bulk_load() are committed thousands at a time with the journal and
+  // syncing turned off and the mapping_type_name_exp and owner_id_index indexes dropped;
+  // end_bulk_load() rebuilds the indexes and restores WAL mode.  If the daemon dies in between, the
+  // next init() drops and rebuilds the db from scratch.
+  bool                        begin_bulk_load();
+  bool                        end_bulk_load();
+
+  // With automatic checkpoints off, committing never triggers a WAL checkpoint (and its fsyncs);
+  // the owner then has to call checkpoint() itself, e.g. when it syncs the blockchain db.
+  void                        set_auto_checkpoint(bool on);
+  // Copies the committed WAL contents into the database file, syncing both; returns false (after
+  // logging) on failure.  Doesn't wait for readers, so may leave part of the WAL in place.
+  bool                        checkpoint();
+
   cryptonote::network_type    network_type() const { return nettype; }
   uint64_t                    height      () const { return last_processed_height; }
 
@@ -292,6 +315,10 @@ struct name_system_db
   // Delete all mappings that are registered on height or newer followed by deleting all owners no longer referenced in the DB
   bool                        prune_db(uint64_t height);
 
+  // get_owner_by_*() and get_mapping() read through the writable connection: add_block() and
+  // validate_ons_tx() need them to see changes not yet committed.  The other lookups (which is what
+  // RPC requests use) each take one of a pool of read-only connections, when the db is a file in
+  // WAL mode, and so see the last committed block without waiting on the writer or each other.
   owner_record                get_owner_by_key      (generic_owner const &owner);
   owner_record                get_owner_by_id       (int64_t owner_id);
   // Returns a wallet address from the passed ONS name in "str"
@@ -309,8 +336,13 @@ struct name_system_db
   std::map<mapping_type, int> get_mapping_counts(uint64_t blockchain_height);
 
   // Resolves a mapping of the given type and name hash. Returns a null optional if the value was
-  // not found or expired, otherwise returns the encrypted value.
+  // not found or expired, otherwise returns the encrypted value.  Recently resolved names are
+  // answered from memory; add_block() and prune_db() drop the ones they change.
   std::optional<mapping_value> resolve(mapping_type type, std::string_view name_hash_b64, uint64_t blockchain_height);
+  // Resolves many names at once, like resolve() does each (type, name hash) pair, returning the
+  // values in the order of `names`.  Those not cached are looked up with a query per type, all on
+  // the same snapshot of the db.
+  std::vector<std::optional<mapping_value>> resolve(std::vector<std::pair<mapping_type, std::string>> const &names, uint64_t blockchain_height);
 
   // Validates an ONS transaction.  If the function returns true then entry will be populated with
   // the ONS details.  On a false return, `reason` is instead populated with the failure reason.
@@ -321,7 +353,9 @@ struct name_system_db
 
   sqlite3 *db               = nullptr;
   bool    transaction_begun = false;
+  bool    bulk_loading      = false;
 private:
+  uint64_t bulk_load_blocks = 0;
   cryptonote::network_type nettype;
   uint64_t last_processed_height = 0;
   crypto::hash last_processed_hash = crypto::null_hash;
@@ -331,13 +365,68 @@ private:
   sql_compiled_statement get_owner_by_key_sql{*this};
   sql_compiled_statement get_owner_by_id_sql{*this};
   sql_compiled_statement get_mapping_sql{*this};
-  sql_compiled_statement resolve_sql{*this};
   sql_compiled_statement get_settings_sql{*this};
   sql_compiled_statement prune_mappings_sql{*this};
   sql_compiled_statement prune_owners_sql{*this};
-  sql_compiled_statement get_mappings_by_owner_sql{*this};
-  sql_compiled_statement get_mapping_counts_sql{*this};
   sql_compiled_statement get_mappings_on_height_and_newer_sql{*this};
+
+  // A connection for the pooled lookups, with the statements they use
+  struct reader
+  {
+    sqlite3* db = nullptr;
+    sql_compiled_statement resolve_sql{db};
+    sql_compiled_statement get_mappings_by_owner_sql{db};
+    sql_compiled_statement get_mapping_counts_sql{db};
+    bool compile();
+  };
+  // A read-only connection of the pool, which it closes when destroyed
+  struct pooled_reader : reader
+  {
+    ~pooled_reader();
+  };
+  struct reader_lease;
+  // Returns an idle reader (opening a new one if there are none), or the writable connection's if
+  // there is no pool (or it is suspended for a bulk load).
+  reader_lease lease_reader();
+  std::unique_ptr<pooled_reader> open_reader();
+  void release_reader(std::unique_ptr<pooled_reader> r);
+  void set_readers_enabled(bool enabled);
+
+  reader writer_reader; // on `db`
+  static constexpr size_t MAX_IDLE_READERS = 8;
+  std::string readers_path; // Empty if the db can't be opened again (e.g. it's in memory)
+  std::mutex readers_mutex;
+  bool readers_enabled = false;
+  std::vector<std::unique_ptr<pooled_reader>> idle_readers;
+
+  struct resolve_cache_entry
+  {
+    std::string                  key;        // db mapping type byte followed by the base64 name hash
+    std::optional<mapping_value> value;
+    uint64_t                     min_height; // The heights resolving at gives `value` (until the
+    uint64_t                     max_height; // name's mappings change)
+    std::optional<uint64_t>      update_height; // Of the row `value` came from, if any
+  };
+  static constexpr size_t RESOLVE_CACHE_SIZE = 10000;
+  std::mutex resolve_cache_mutex;
+  std::list<resolve_cache_entry> resolve_cache; // Most recently used first
+  std::unordered_map<std::string_view, std::list<resolve_cache_entry>::iterator> resolve_cache_index;
+  // Bumped by each invalidation, so that a value read before one (from a reader that didn't see the
+  // change yet) doesn't get stored after it.
+  uint64_t resolve_cache_generation = 0;
+  size_t resolve_cache_bytes = 0; // Approximate memory used by the entries of resolve_cache
+  static size_t resolve_cache_entry_bytes(const resolve_cache_entry& entry);
+  void resolve_cache_erase(const std::vector<std::string>& keys);
+  // These three are called with resolve_cache_mutex held
+  bool resolve_cache_get(const std::string& key, uint64_t blockchain_height, std::optional<mapping_value>& value);
+  void resolve_cache_put(resolve_cache_entry entry);
+  std::list<resolve_cache_entry>::iterator resolve_cache_drop(std::list<resolve_cache_entry>::iterator it);
+  // Reads the value, and the heights it holds for, from a resolve query's row
+  static void read_resolved(sql_compiled_statement& statement, int column, resolve_cache_entry& entry);
+  void resolve_cache_prune(uint64_t height);
+  // Registration of resolve_cache with the daemon's cache budget, which evicts the least recently
+  // used entries (last, so that it goes before the cache does)
+  tools::cache_budget::handle resolve_cache_budget;
 };
 
 }; // namespace service_nodes
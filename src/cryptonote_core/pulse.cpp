@@ -1,4 +1,5 @@
 #include <array>
+#include <deque>
 #include <mutex>
 #include <chrono>
 
@@ -154,6 +155,13 @@ struct round_context
     pulse::time_point     start_time;           // When the round starts
   } prepare_for_round;
 
+  struct
+  {
+    cryptonote::block block;       // Our block template as producer, built while waiting for the round; the round, validator bitset and timestamp get filled in when it is sent
+    crypto::hash      top_hash;    // The block it builds on, or null if there is none
+    uint64_t          pool_cookie; // The tx pool's cookie when it was built, to rebuild it when the pool changes
+  } speculative_template;
+
   struct
   {
     struct
@@ -216,9 +224,70 @@ struct round_context
 };
 
 static round_context context;
+
+// Timings of the round in progress, if we are taking part in it; moved into `round_traces` when the
+// round ends.  Like `context`, only touched from the pulse thread.
+static std::optional<pulse::round_trace> current_trace;
+static std::array<uint16_t, 7> current_trace_arrivals; // Bitset of the positions traced per message type
+
+constexpr size_t MAX_ROUND_TRACES = 32;
+static std::mutex round_traces_mutex;
+static std::deque<pulse::round_trace> round_traces;
+
 namespace
 {
 
+void trace_state_change(round_state from, round_context const &context)
+{
+  auto now = pulse::clock::now();
+  if (!current_trace)
+  {
+    if (from != round_state::prepare_for_round || context.state != round_state::wait_for_round ||
+        context.prepare_for_round.participant == sn_type::none)
+      return;
+
+    current_trace                 = pulse::round_trace{};
+    current_trace->height         = context.wait_for_next_block.height;
+    current_trace->round          = context.prepare_for_round.round;
+    current_trace->node_name      = context.prepare_for_round.node_name;
+    current_trace->start_time     = context.prepare_for_round.start_time;
+    current_trace->stale_messages = 0;
+    current_trace_arrivals        = {};
+  }
+  else
+  {
+    current_trace->stages.back().exit = now;
+  }
+
+  if (context.state == round_state::wait_for_next_block || context.state == round_state::prepare_for_round)
+  {
+    std::lock_guard lock{round_traces_mutex};
+    round_traces.push_back(std::move(*current_trace));
+    if (round_traces.size() > MAX_ROUND_TRACES)
+      round_traces.pop_front();
+    current_trace.reset();
+    return;
+  }
+
+  current_trace->stages.push_back({round_state_string(context.state), now, now});
+}
+
+void trace_arrival(pulse::message const &msg, pulse_wait_stage const &stage)
+{
+  if (!current_trace || msg.quorum_position >= service_nodes::PULSE_QUORUM_NUM_VALIDATORS)
+    return;
+
+  // Early messages come back through here when we reach their stage; only the first time counts.
+  uint16_t &traced = current_trace_arrivals[static_cast<size_t>(msg.type)];
+  uint16_t const bit = (1 << msg.quorum_position);
+  if (traced & bit)
+    return;
+  traced |= bit;
+
+  auto now = pulse::clock::now();
+  current_trace->arrivals.push_back({msg.type, msg.quorum_position, now, now > stage.end_time});
+}
+
 crypto::hash blake2b_hash(void const *data, size_t size)
 {
   crypto::hash result = {};
@@ -523,6 +592,8 @@ void pulse::handle_message(void *quorumnet_state, pulse::message const &msg)
         // marked an error, just ignored.
 
         print_err = false;
+        if (current_trace)
+          current_trace->stale_messages++;
         MTRACE(log_prefix(context) << "Received valid message from the past (round " << +msg.round  << "), ignoring");
         break;
       } // else: Message has unknown origins, it is not something we know how to validate.
@@ -551,6 +622,8 @@ void pulse::handle_message(void *quorumnet_state, pulse::message const &msg)
     case pulse::message_type::signed_block:      stage = &context.transient.signed_block.wait.stage;            break;
   }
 
+  trace_arrival(msg, *stage);
+
   bool msg_received_early = false;
   switch(msg.type)
   {
@@ -1089,6 +1162,7 @@ round_state wait_for_next_block(uint64_t hf16_height, round_context &context, cr
   context.wait_for_next_block.height             = chain_height;
   context.wait_for_next_block.top_hash           = prev_hash;
   context.prepare_for_round                      = {};
+  context.speculative_template                   = {};
 
   return round_state::prepare_for_round;
 }
@@ -1422,6 +1496,16 @@ round_state send_block_template(round_context &context, void *quorumnet_state, s
 
   // Block
   cryptonote::block block = {};
+  if (auto &spec = context.speculative_template; spec.top_hash == context.wait_for_next_block.top_hash)
+  {
+    block         = std::move(spec.block);
+    spec.top_hash = crypto::null_hash;
+    block.pulse.round            = context.prepare_for_round.round;
+    block.pulse.validator_bitset = context.transient.wait_for_handshake_bitsets.best_bitset;
+    block.timestamp              = std::max<uint64_t>(block.timestamp, time(nullptr)); // Must fall in the round
+    block.invalidate_hashes();
+  }
+  else
   {
     uint64_t height                              = 0;
     service_nodes::payout block_producer_payouts = service_nodes::service_node_info_to_payout(key.pub, *info);
@@ -1454,6 +1538,34 @@ round_state send_block_template(round_context &context, void *quorumnet_state, s
   return goto_preparing_for_next_round(context);
 }
 
+// Builds (or rebuilds, if the pool changed since) our block template as the round's producer ahead
+// of send_block_template, using the time spent waiting for the round to start and for the
+// validators' handshake bitsets.  A template that can't be built now is left to
+// send_block_template, which reports why.
+void update_speculative_template(round_context &context, service_nodes::service_node_keys const &key, cryptonote::Blockchain &blockchain, cryptonote::tx_memory_pool const &pool)
+{
+  auto &spec                 = context.speculative_template;
+  uint64_t const pool_cookie = pool.cookie(); // Before building: a change while we build gets another rebuild
+  if (spec.top_hash == context.wait_for_next_block.top_hash && spec.pool_cookie == pool_cookie)
+    return;
+
+  std::vector<service_nodes::service_node_pubkey_info> list_state = blockchain.get_service_node_list().get_service_node_list_state({key.pub});
+  if (list_state.empty() || !list_state[0].info->is_active())
+    return;
+
+  cryptonote::block block = {};
+  uint64_t height         = 0;
+  service_nodes::payout block_producer_payouts = service_nodes::service_node_info_to_payout(key.pub, *list_state[0].info);
+  if (!blockchain.create_next_pulse_block_template(block, block_producer_payouts, context.prepare_for_round.round, 0 /*validator_bitset*/, height) ||
+      block.prev_id != context.wait_for_next_block.top_hash)
+    return;
+
+  MDEBUG(log_prefix(context) << "Prepared block template with " << block.tx_hashes.size() << " txs ahead of sending it");
+  spec.block       = std::move(block);
+  spec.top_hash    = context.wait_for_next_block.top_hash;
+  spec.pool_cookie = pool_cookie;
+}
+
 round_state wait_for_block_template(round_context &context, service_nodes::service_node_list &node_list, void *quorumnet_state, service_nodes::service_node_keys const &key, cryptonote::Blockchain &blockchain)
 {
   handle_messages_received_early_for(context.transient.wait_for_block_template.stage, quorumnet_state);
@@ -1753,6 +1865,18 @@ void pulse::main(void *quorumnet_state, cryptonote::core &core)
         context.state = send_and_wait_for_signed_blocks(context, node_list, quorumnet_state, key, core);
         break;
     }
+
+    if (context.state != last_state)
+      trace_state_change(last_state, context);
   }
+
+  if (context.prepare_for_round.participant == sn_type::producer &&
+      (context.state == round_state::wait_for_round || context.state == round_state::wait_for_handshake_bitsets))
+    update_speculative_template(context, key, blockchain, core.get_pool());
 }
 
+std::vector<pulse::round_trace> pulse::get_round_traces()
+{
+  std::lock_guard lock{round_traces_mutex};
+  return {round_traces.begin(), round_traces.end()};
+}
@@ -3,7 +3,9 @@
 #include <atomic>
 #include <cstdint>
 #include <condition_variable>
+#include <string>
 #include <string_view>
+#include <vector>
 
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 #include "crypto/crypto.h"
@@ -106,4 +108,35 @@ struct timings
 bool convert_time_to_round(pulse::time_point const &time, pulse::time_point const &r0_timestamp, uint8_t *round);
 bool get_round_timings(cryptonote::Blockchain const &blockchain, uint64_t height, uint64_t prev_timestamp, pulse::timings &times);
 
+// The timings of a round this node took part in (as producer or validator), as seen from here: when
+// it entered and left each stage, and when each validator's messages got to us.
+struct round_trace
+{
+  struct stage
+  {
+    std::string_view name;
+    pulse::time_point enter;
+    pulse::time_point exit;
+  };
+
+  struct arrival
+  {
+    message_type      type;
+    uint16_t          quorum_position;
+    pulse::time_point received;
+    bool              late; // Received after the end of the stage the message is for
+  };
+
+  uint64_t             height;
+  uint8_t              round;
+  std::string          node_name;
+  pulse::time_point    start_time; // When the round was due to start
+  std::vector<stage>   stages;
+  std::vector<arrival> arrivals;   // The first (valid) message of each type from each validator
+  uint32_t             stale_messages; // Valid messages for earlier rounds received during this one
+};
+
+// Returns the traces of the most recent rounds this node took part in, oldest first.
+std::vector<round_trace> get_round_traces();
+
 } // namespace pulse
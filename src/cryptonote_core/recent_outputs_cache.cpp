@@ -0,0 +1,103 @@
+#include "recent_outputs_cache.h"
+
+#include <iterator>
+#include <mutex>
+
+namespace cryptonote
+{
+
+void recent_outputs_cache::trim()
+{
+  while (m_outputs.size() > m_max)
+  {
+    m_outputs.pop_front();
+    m_first++;
+  }
+  if (m_outputs.empty())
+    std::deque<output>{}.swap(m_outputs);
+}
+
+void recent_outputs_cache::set_max_outputs(size_t max_outputs)
+{
+  std::unique_lock lock{m_mutex};
+  m_max = max_outputs;
+  trim();
+}
+
+size_t recent_outputs_cache::max_outputs() const
+{
+  std::shared_lock lock{m_mutex};
+  return m_max;
+}
+
+void recent_outputs_cache::append(uint64_t first_index, std::vector<output> outputs)
+{
+  std::unique_lock lock{m_mutex};
+  if (m_max == 0 || outputs.empty())
+    return;
+  if (m_outputs.empty() || first_index != m_first + m_outputs.size())
+  {
+    m_outputs.clear();
+    m_first = first_index;
+  }
+  // Only the last m_max of a large batch could stay anyway
+  size_t skip = outputs.size() > m_max ? outputs.size() - m_max : 0;
+  if (skip > 0)
+  {
+    m_outputs.clear();
+    m_first = first_index + skip;
+  }
+  m_outputs.insert(m_outputs.end(), std::make_move_iterator(outputs.begin() + skip), std::make_move_iterator(outputs.end()));
+  trim();
+}
+
+void recent_outputs_cache::truncate(uint64_t end_index)
+{
+  std::unique_lock lock{m_mutex};
+  if (end_index <= m_first)
+    m_outputs.clear();
+  else if (end_index - m_first < m_outputs.size())
+    m_outputs.resize(end_index - m_first);
+}
+
+void recent_outputs_cache::clear()
+{
+  std::unique_lock lock{m_mutex};
+  std::deque<output>{}.swap(m_outputs);
+}
+
+void recent_outputs_cache::drop_oldest(size_t count)
+{
+  std::unique_lock lock{m_mutex};
+  if (count >= m_outputs.size())
+  {
+    std::deque<output>{}.swap(m_outputs);
+    return;
+  }
+  m_outputs.erase(m_outputs.begin(), m_outputs.begin() + count);
+  m_first += count;
+}
+
+std::vector<std::optional<recent_outputs_cache::output>> recent_outputs_cache::find(const std::vector<uint64_t>& indices) const
+{
+  std::vector<std::optional<output>> result(indices.size());
+  std::shared_lock lock{m_mutex};
+  for (size_t i = 0; i < indices.size(); i++)
+    if (indices[i] >= m_first && indices[i] - m_first < m_outputs.size())
+      result[i] = m_outputs[indices[i] - m_first];
+  return result;
+}
+
+size_t recent_outputs_cache::size() const
+{
+  std::shared_lock lock{m_mutex};
+  return m_outputs.size();
+}
+
+uint64_t recent_outputs_cache::end_index() const
+{
+  std::shared_lock lock{m_mutex};
+  return m_outputs.empty() ? 0 : m_first + m_outputs.size();
+}
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <shared_mutex>
+#include <vector>
+
+#include "blockchain_db/blockchain_db.h"
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+
+// The most recent RCT (amount 0) outputs, by global index, with what GET_OUTPUTS_BIN returns for
+// them.  Decoy selection favours recent outputs, so most ring member lookups are of the same few
+// hundred thousand outputs, which this answers without going to the db.
+//
+// The cached outputs are always a contiguous run of indices: Blockchain appends each new block's
+// outputs and truncates it when blocks are popped (after which the popped indices get reused by
+// other outputs).  Thread safe: lookups come from RPC threads without the blockchain lock.
+class recent_outputs_cache
+{
+public:
+  struct output
+  {
+    output_data_t data;
+    crypto::hash txid;
+  };
+
+  explicit recent_outputs_cache(size_t max_outputs) : m_max{max_outputs} {}
+
+  // Sets the maximum number of outputs kept (0 to disable the cache), dropping the oldest outputs
+  // beyond it
+  void set_max_outputs(size_t max_outputs);
+  size_t max_outputs() const;
+
+  // Appends outputs starting at global index `first_index`.  If that doesn't follow on from the
+  // cached outputs, those are dropped and the cache restarts from `first_index`.  The oldest
+  // outputs are dropped as needed to stay within the maximum.
+  void append(uint64_t first_index, std::vector<output> outputs);
+
+  // Drops the outputs with an index of `end_index` or more, i.e. keeps those of the chain with
+  // `end_index` RCT outputs
+  void truncate(uint64_t end_index);
+
+  void clear();
+
+  // Drops the `count` oldest outputs (to give memory back)
+  void drop_oldest(size_t count);
+
+  // Looks up each of `indices`, returning nullopt for those not cached
+  std::vector<std::optional<output>> find(const std::vector<uint64_t>& indices) const;
+
+  // The number of cached outputs, and the index following the last one (0 if empty)
+  size_t size() const;
+  uint64_t end_index() const;
+
+  static constexpr size_t OUTPUT_BYTES = sizeof(output);
+
+private:
+  void trim();
+
+  mutable std::shared_mutex m_mutex;
+  std::deque<output> m_outputs;
+  uint64_t m_first = 0; // index of m_outputs.front()
+  size_t m_max;
+};
+
+}
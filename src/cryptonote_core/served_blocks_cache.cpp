@@ -0,0 +1,49 @@
+#include "served_blocks_cache.h"
+
+namespace cryptonote
+{
+
+const served_blocks_cache::entry* served_blocks_cache::find(const crypto::hash& block_hash)
+{
+  auto it = m_index.find(block_hash);
+  if (it == m_index.end())
+    return nullptr;
+  m_entries.splice(m_entries.begin(), m_entries, it->second);
+  return &it->second->second;
+}
+
+void served_blocks_cache::insert(const crypto::hash& block_hash, uint64_t height, const block_complete_entry& block)
+{
+  size_t const bytes = entry_bytes(block);
+  if (bytes > m_max_bytes || m_index.count(block_hash))
+    return;
+
+  while (m_bytes + bytes > m_max_bytes)
+  {
+    auto& oldest = m_entries.back();
+    m_bytes -= entry_bytes(oldest.second.block);
+    m_index.erase(oldest.first);
+    m_entries.pop_back();
+  }
+
+  m_entries.emplace_front(block_hash, entry{height, block});
+  m_index.emplace(block_hash, m_entries.begin());
+  m_bytes += bytes;
+}
+
+void served_blocks_cache::clear()
+{
+  m_entries.clear();
+  m_index.clear();
+  m_bytes = 0;
+}
+
+size_t served_blocks_cache::entry_bytes(const block_complete_entry& block)
+{
+  size_t bytes = block.block.size() + block.checkpoint.size();
+  for (auto& tx : block.txs)
+    bytes += tx.size();
+  return bytes;
+}
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+#include "crypto/hash.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+
+namespace cryptonote
+{
+
+// Least-recently-used cache, bounded by total blob size, of the block_complete_entry's most
+// recently sent in response to NOTIFY_REQUEST_GET_BLOCKS.  Peers syncing at the same time tend to
+// request the same spans one after another, and each entry saves re-reading and re-parsing the
+// block and looking up each of its txs.
+//
+// Entries are only valid while their block stays in the main chain, so the cache must be cleared
+// whenever blocks are popped.  Not thread-safe: Blockchain only uses it under its own lock.
+class served_blocks_cache
+{
+public:
+  struct entry
+  {
+    uint64_t height;
+    block_complete_entry block;
+  };
+
+  explicit served_blocks_cache(size_t max_bytes) : m_max_bytes{max_bytes} {}
+
+  // Returns the cached entry for the block, or nullptr.  The pointer is valid until the next
+  // insert() or clear().
+  const entry* find(const crypto::hash& block_hash);
+
+  // Adds (a copy of) the entry, evicting the least recently used entries as needed to stay within
+  // the size limit.  Entries larger than the whole limit are not cached.
+  void insert(const crypto::hash& block_hash, uint64_t height, const block_complete_entry& block);
+
+  void clear();
+
+  size_t size() const { return m_index.size(); }
+  size_t bytes() const { return m_bytes; }
+
+private:
+  static size_t entry_bytes(const block_complete_entry& block);
+
+  using entries = std::list<std::pair<crypto::hash, entry>>;
+  entries m_entries; // most recently used first
+  std::unordered_map<crypto::hash, entries::iterator> m_index;
+  size_t m_bytes = 0;
+  size_t const m_max_bytes;
+};
+
+}
@@ -51,6 +51,8 @@ extern "C" {
 #include "common/random.h"
 #include "common/lock.h"
 #include "common/hex.h"
+#include "common/perf_timer.h"
+#include "common/threadpool.h"
 #include "epee/misc_os_dependent.h"
 #include "blockchain.h"
 #include "service_node_quorum_cop.h"
@@ -96,6 +98,7 @@ namespace service_nodes
     if (m_blockchain.get_network_version() < cryptonote::network_version_9_service_nodes)
     {
       reset(true);
+      publish_registered();
       return;
     }
 
@@ -106,8 +109,52 @@ namespace service_nodes
       loaded = false; // Either we don't have stored history or the history is very short, so recalculation is necessary or cheap.
     }
 
-    if (!loaded || m_state.height > current_height)
+    if (!loaded || !rewind_to_chain(current_height))
       reset(true);
+    publish_registered();
+  }
+
+  bool service_node_list::rewind_to_chain(uint64_t current_height)
+  {
+    // The stored state commits to the hash of the block it was built from.  If the chain doesn't
+    // have that block (e.g. after a crash the blocks the state got to weren't all written, or they
+    // were popped since) fall back to the newest full state still on the chain and let the rest be
+    // replayed, rather than rescanning everything.
+    auto on_chain = [this, current_height](state_t const &state) {
+      return state.height < current_height && !state.only_loaded_quorums &&
+             state.block_hash == m_blockchain.get_block_id_by_height(state.height);
+    };
+    if (on_chain(m_state))
+      return true;
+
+    bool found = false;
+    for (state_set *states : {&m_transient.state_history, &m_transient.state_archive})
+    {
+      auto it = std::find_if(states->rbegin(), states->rend(), on_chain);
+      if (it == states->rend())
+        continue;
+
+      auto state = std::prev(it.base());
+      m_state    = std::move(const_cast<state_t &>(*state)); // safe: the state is erased below
+      states->erase(state, states->end());
+      if (states == &m_transient.state_archive)
+        m_transient.state_history.clear();
+      found = true;
+      break;
+    }
+
+    if (!found)
+    {
+      LOG_PRINT_L0("No stored service node state matches the blockchain, rescanning");
+      return false;
+    }
+
+    while (!m_transient.old_quorum_states.empty() && m_transient.old_quorum_states.back().height > m_state.height)
+      m_transient.old_quorum_states.pop_back();
+    m_transient.state_history.erase(m_transient.state_history.upper_bound(m_state.height), m_transient.state_history.end());
+    m_transient.state_archive.erase(m_transient.state_archive.upper_bound(m_state.height), m_transient.state_archive.end());
+    MGINFO("Stored service node state is not on the blockchain, rewound to height " << m_state.height);
+    return true;
   }
 
   template <typename UnaryPredicate>
@@ -126,9 +173,168 @@ namespace service_nodes
   }
 
   std::vector<pubkey_and_sninfo> service_node_list::state_t::active_service_nodes_infos() const {
+    if (sorted_active)
+      return *sorted_active;
     return sort_and_filter(service_nodes_infos, [](const service_node_info &info) { return info.is_active(); }, /*reserve=*/ true);
   }
 
+  std::shared_ptr<const std::vector<pubkey_and_sninfo>> service_node_list::state_t::active_nodes() const {
+    if (sorted_active)
+      return sorted_active;
+    return std::make_shared<const std::vector<pubkey_and_sninfo>>(active_service_nodes_infos());
+  }
+
+  static swarm_snode_map_t swarms_of(const std::vector<pubkey_and_sninfo> &active)
+  {
+    swarm_snode_map_t swarms;
+    for (const auto &key_info : active)
+      swarms[key_info.second->swarm_id].push_back(key_info.first);
+    return swarms;
+  }
+
+  std::shared_ptr<const swarm_index> service_node_list::state_t::get_swarms() const {
+    if (swarms)
+      return swarms;
+    return make_swarm_index(swarms_of(*active_nodes()));
+  }
+
+  template <typename F>
+  static void for_each_locked_key_image(const service_node_info &info, F &&f)
+  {
+    for (const auto &contributor : info.contributors)
+      for (const auto &contribution : contributor.locked_contributions)
+        f(contribution.key_image);
+  }
+
+  static std::shared_ptr<const locked_key_image_index> make_locked_key_image_index(const service_nodes_infos_t &infos)
+  {
+    auto index = std::make_shared<locked_key_image_index>();
+    for (const auto &pubkey_info : infos)
+      for_each_locked_key_image(*pubkey_info.second, [&](const crypto::key_image &ki) { index->emplace(ki, pubkey_info.first); });
+    return index;
+  }
+
+  static bool same_locked_key_images(const service_node_info &a, const service_node_info &b)
+  {
+    std::vector<const crypto::key_image *> kis;
+    for_each_locked_key_image(a, [&](const crypto::key_image &ki) { kis.push_back(&ki); });
+    size_t i = 0;
+    bool same = true;
+    for_each_locked_key_image(b, [&](const crypto::key_image &ki) { same = same && i < kis.size() && *kis[i++] == ki; });
+    return same && i == kis.size();
+  }
+
+  // Returns the index of `after`'s locked key images, given `index`, that of `before`: `index`
+  // itself if no node's stakes changed in between, otherwise an updated copy.
+  static std::shared_ptr<const locked_key_image_index> update_locked_key_image_index(
+      std::shared_ptr<const locked_key_image_index> index, const service_nodes_infos_t &before, const service_nodes_infos_t &after)
+  {
+    std::vector<const crypto::key_image *> removed;
+    std::vector<std::pair<const crypto::key_image *, const crypto::public_key *>> added;
+    size_t kept = 0;
+    for (const auto &pubkey_info : after)
+    {
+      const service_node_info &info = *pubkey_info.second;
+      auto it = before.find(pubkey_info.first);
+      if (it != before.end())
+      {
+        kept++;
+        if (it->second == pubkey_info.second || same_locked_key_images(*it->second, info))
+          continue;
+        for_each_locked_key_image(*it->second, [&](const crypto::key_image &ki) { removed.push_back(&ki); });
+      }
+      for_each_locked_key_image(info, [&](const crypto::key_image &ki) { added.emplace_back(&ki, &pubkey_info.first); });
+    }
+    if (kept < before.size()) // Some nodes are gone
+      for (const auto &pubkey_info : before)
+        if (!after.count(pubkey_info.first))
+          for_each_locked_key_image(*pubkey_info.second, [&](const crypto::key_image &ki) { removed.push_back(&ki); });
+
+    if (removed.empty() && added.empty())
+      return index;
+    auto updated = std::make_shared<locked_key_image_index>(*index);
+    for (auto *ki : removed)
+      updated->erase(*ki);
+    for (auto &[ki, pubkey] : added)
+      (*updated)[*ki] = *pubkey;
+    return updated;
+  }
+
+  static block_leader_queue::value_type leader_queue_entry(const crypto::public_key &pubkey, const service_node_info &info)
+  {
+    return {info.last_reward_block_height, info.last_reward_transaction_index, pubkey};
+  }
+
+  static std::shared_ptr<const block_leader_queue> make_block_leader_queue(const service_nodes_infos_t &infos)
+  {
+    auto queue = std::make_shared<block_leader_queue>();
+    for (const auto &pubkey_info : infos)
+      if (pubkey_info.second->is_active())
+        queue->insert(leader_queue_entry(pubkey_info.first, *pubkey_info.second));
+    return queue;
+  }
+
+  // Returns the block leader queue of `after`, given `queue`, that of `before`: like
+  // update_locked_key_image_index(), only the nodes whose infos were replaced in between are looked
+  // at, and `queue` itself is returned if none of them moved.
+  static std::shared_ptr<const block_leader_queue> update_block_leader_queue(
+      std::shared_ptr<const block_leader_queue> queue, const service_nodes_infos_t &before, const service_nodes_infos_t &after)
+  {
+    std::vector<block_leader_queue::value_type> removed, added;
+    size_t kept = 0;
+    for (const auto &pubkey_info : after)
+    {
+      const service_node_info &info = *pubkey_info.second;
+      std::optional<block_leader_queue::value_type> old_entry, new_entry;
+      if (auto it = before.find(pubkey_info.first); it != before.end())
+      {
+        kept++;
+        if (it->second == pubkey_info.second)
+          continue;
+        if (it->second->is_active())
+          old_entry = leader_queue_entry(pubkey_info.first, *it->second);
+      }
+      if (info.is_active())
+        new_entry = leader_queue_entry(pubkey_info.first, info);
+      if (old_entry == new_entry)
+        continue;
+      if (old_entry)
+        removed.push_back(*old_entry);
+      if (new_entry)
+        added.push_back(*new_entry);
+    }
+    if (kept < before.size()) // Some nodes are gone
+      for (const auto &pubkey_info : before)
+        if (pubkey_info.second->is_active() && !after.count(pubkey_info.first))
+          removed.push_back(leader_queue_entry(pubkey_info.first, *pubkey_info.second));
+
+    if (removed.empty() && added.empty())
+      return queue;
+    auto updated = std::make_shared<block_leader_queue>(*queue);
+    for (auto &entry : removed)
+      updated->erase(entry);
+    updated->insert(added.begin(), added.end());
+    return updated;
+  }
+
+  std::shared_ptr<const locked_key_image_index> service_node_list::state_t::get_locked_key_images() const {
+    if (locked_key_images)
+      return locked_key_images;
+    return make_locked_key_image_index(service_nodes_infos);
+  }
+
+  std::optional<swarm_index::swarm> service_node_list::get_swarm_for_pubkey(std::string_view pubkey) const
+  {
+    std::shared_ptr<const swarm_index> swarms;
+    {
+      std::lock_guard lock(m_sn_mutex);
+      swarms = m_state.get_swarms();
+    }
+    if (auto *swarm = swarms->closest(pubkey_to_swarm_space(pubkey)))
+      return *swarm;
+    return std::nullopt;
+  }
+
   std::vector<pubkey_and_sninfo> service_node_list::state_t::decommissioned_service_nodes_infos() const {
     return sort_and_filter(service_nodes_infos, [](const service_node_info &info) { return info.is_decommissioned() && info.is_fully_funded(); }, /*reserve=*/ false);
   }
@@ -139,17 +345,17 @@ namespace service_nodes
     std::lock_guard lock(m_sn_mutex);
     quorum_manager const *quorums = nullptr;
     if (height == m_state.height)
-      quorums = &m_state.quorums;
+      quorums = &m_state.get_quorums();
     else // NOTE: Search m_transient.state_history && m_transient.state_archive
     {
       auto it = m_transient.state_history.find(height);
       if (it != m_transient.state_history.end())
-        quorums = &it->quorums;
+        quorums = &it->get_quorums();
 
       if (!quorums)
       {
         auto it = m_transient.state_archive.find(height);
-        if (it != m_transient.state_archive.end()) quorums = &it->quorums;
+        if (it != m_transient.state_archive.end()) quorums = &it->get_quorums();
       }
     }
 
@@ -171,7 +377,7 @@ namespace service_nodes
       {
         if (alt_state.height == height)
         {
-          std::shared_ptr<const quorum> alt_result = alt_state.quorums.get(type);
+          std::shared_ptr<const quorum> alt_result = alt_state.get_quorums().get(type);
           if (alt_result) alt_quorums->push_back(alt_result);
         }
       }
@@ -271,19 +477,24 @@ namespace service_nodes
 
   bool service_node_list::is_key_image_locked(crypto::key_image const &check_image, uint64_t *unlock_height, service_node_info::contribution_t *the_locked_contribution) const
   {
-    for (const auto& pubkey_info : m_state.service_nodes_infos)
+    auto index = m_state.get_locked_key_images();
+    auto locked = index->find(check_image);
+    if (locked == index->end())
+      return false;
+    auto it = m_state.service_nodes_infos.find(locked->second);
+    if (it == m_state.service_nodes_infos.end())
+      return false;
+
+    const service_node_info &info = *it->second;
+    for (const service_node_info::contributor_t &contributor : info.contributors)
     {
-      const service_node_info &info = *pubkey_info.second;
-      for (const service_node_info::contributor_t &contributor : info.contributors)
+      for (const service_node_info::contribution_t &contribution : contributor.locked_contributions)
       {
-        for (const service_node_info::contribution_t &contribution : contributor.locked_contributions)
+        if (check_image == contribution.key_image)
         {
-          if (check_image == contribution.key_image)
-          {
-            if (the_locked_contribution) *the_locked_contribution = contribution;
-            if (unlock_height) *unlock_height = info.requested_unlock_height;
-            return true;
-          }
+          if (the_locked_contribution) *the_locked_contribution = contribution;
+          if (unlock_height) *unlock_height = info.requested_unlock_height;
+          return true;
         }
       }
     }
@@ -293,9 +504,9 @@ namespace service_nodes
   bool reg_tx_extract_fields(const cryptonote::transaction& tx, contributor_args_t &contributor_args, uint64_t& expiration_timestamp, crypto::public_key& service_node_key, crypto::signature& signature)
   {
     cryptonote::tx_extra_service_node_register registration;
-    if (!get_field_from_tx_extra(tx.extra, registration))
+    if (!get_field_from_tx_extra(tx, registration))
       return false;
-    if (!cryptonote::get_service_node_pubkey_from_tx_extra(tx.extra, service_node_key))
+    if (!cryptonote::get_service_node_pubkey_from_tx_extra(tx, service_node_key))
       return false;
 
     contributor_args.addresses.clear();
@@ -414,13 +625,13 @@ namespace service_nodes
   {
     staking_components contribution_unused_ = {};
     if (!contribution) contribution = &contribution_unused_;
-    if (!cryptonote::get_service_node_pubkey_from_tx_extra(tx.extra, contribution->service_node_pubkey))
+    if (!cryptonote::get_service_node_pubkey_from_tx_extra(tx, contribution->service_node_pubkey))
       return false; // Is not a contribution TX don't need to check it.
 
-    if (!cryptonote::get_service_node_contributor_from_tx_extra(tx.extra, contribution->address))
+    if (!cryptonote::get_service_node_contributor_from_tx_extra(tx, contribution->address))
       return false;
 
-    if (!cryptonote::get_tx_secret_key_from_tx_extra(tx.extra, contribution->tx_key))
+    if (!cryptonote::get_tx_secret_key_from_tx_extra(tx, contribution->tx_key))
     {
       LOG_PRINT_L1("TX: There was a service node contributor but no secret key in the tx extra for tx: " << txid);
       return false;
@@ -485,7 +696,7 @@ namespace service_nodes
       // would be generated, when they want to spend it in the future.
 
       cryptonote::tx_extra_tx_key_image_proofs key_image_proofs;
-      if (!get_field_from_tx_extra(tx.extra, key_image_proofs))
+      if (!get_field_from_tx_extra(tx, key_image_proofs))
       {
         LOG_PRINT_L1("TX: Didn't have key image proofs in the tx_extra, rejected on height: " << block_height << " for tx: " << cryptonote::get_transaction_hash(tx));
         stake_decoded = false;
@@ -601,7 +812,7 @@ namespace service_nodes
 
     uint8_t const hf_version = block.major_version;
     cryptonote::tx_extra_service_node_state_change state_change;
-    if (!cryptonote::get_service_node_state_change_from_tx_extra(tx.extra, state_change, hf_version))
+    if (!cryptonote::get_service_node_state_change_from_tx_extra(tx, state_change, hf_version))
     {
       MERROR("Transaction: " << cryptonote::get_transaction_hash(tx) << ", did not have valid state change data in tx extra rejecting malformed tx");
       return false;
@@ -621,7 +832,7 @@ namespace service_nodes
       }
     }
 
-    quorum_manager const *quorums = &it->quorums;
+    quorum_manager const *quorums = &it->get_quorums();
     cryptonote::tx_verification_context tvc = {};
     if (!verify_tx_state_change(
             state_change, cryptonote::get_block_height(block), tvc, *quorums->obligations, hf_version))
@@ -631,7 +842,7 @@ namespace service_nodes
       {
         if (alt_state.height != state_change.block_height) continue;
 
-        quorums = &alt_state.quorums;
+        quorums = &alt_state.get_quorums();
         if (!verify_tx_state_change(state_change, cryptonote::get_block_height(block), tvc, *quorums->obligations, hf_version))
         {
           quorums = nullptr;
@@ -720,9 +931,10 @@ namespace service_nodes
 
         if (sn_list && !sn_list->m_rescanning)
         {
-          auto &proof = sn_list->proofs[key];
-          proof.timestamp = proof.effective_timestamp = 0;
-          proof.store(key, sn_list->m_blockchain);
+          sn_list->proofs.update(key, [](proof_info &proof) {
+            proof.timestamp = proof.effective_timestamp = 0;
+            return proof.stored_copy();
+          }).store(key, sn_list->m_blockchain);
         }
         return true;
 
@@ -762,12 +974,13 @@ namespace service_nodes
         // next actual proof from being sent/relayed.
         if (sn_list)
         {
-          auto &proof = sn_list->proofs[key];
-          proof.effective_timestamp = block.timestamp;
-          proof.checkpoint_participation.reset();
-          proof.pulse_participation.reset();
-          proof.timestamp_participation.reset();
-          proof.timesync_status.reset();
+          sn_list->proofs.update(key, [&block](proof_info &proof) {
+            proof.effective_timestamp = block.timestamp;
+            proof.checkpoint_participation.reset();
+            proof.pulse_participation.reset();
+            proof.timestamp_participation.reset();
+            proof.timesync_status.reset();
+          });
         }
         return true;
       }
@@ -804,7 +1017,7 @@ namespace service_nodes
   bool service_node_list::state_t::process_key_image_unlock_tx(cryptonote::network_type nettype, uint64_t block_height, const cryptonote::transaction &tx)
   {
     crypto::public_key snode_key;
-    if (!cryptonote::get_service_node_pubkey_from_tx_extra(tx.extra, snode_key))
+    if (!cryptonote::get_service_node_pubkey_from_tx_extra(tx, snode_key))
       return false;
 
     auto it = service_nodes_infos.find(snode_key);
@@ -821,7 +1034,7 @@ namespace service_nodes
     }
 
     cryptonote::tx_extra_tx_key_image_unlock unlock;
-    if (!cryptonote::get_field_from_tx_extra(tx.extra, unlock))
+    if (!cryptonote::get_field_from_tx_extra(tx, unlock))
     {
       LOG_PRINT_L1("Unlock TX: Didn't have key image unlock in the tx_extra, rejected on height: "
                    << block_height << " for tx: " << cryptonote::get_transaction_hash(tx));
@@ -1016,9 +1229,10 @@ namespace service_nodes
       // re-registration: we want to wipe out any data from the previous registration.
       if (sn_list && !sn_list->m_rescanning)
       {
-        auto &proof = sn_list->proofs[key];
-        proof = {};
-        proof.store(key, sn_list->m_blockchain);
+        sn_list->proofs.update(key, [](proof_info &proof) {
+          proof = {};
+          return proof.stored_copy();
+        }).store(key, sn_list->m_blockchain);
       }
 
       if (my_keys && my_keys->pub == key) MGINFO_GREEN("Service node registered (yours): " << key << " on height: " << block_height);
@@ -1104,7 +1318,7 @@ namespace service_nodes
       return false;
     }
 
-    if (!cryptonote::get_tx_secret_key_from_tx_extra(tx.extra, stake.tx_key))
+    if (!cryptonote::get_tx_secret_key_from_tx_extra(tx, stake.tx_key))
     {
       LOG_PRINT_L1("TX: Failed to get tx secret key from contribution received on height: "  << block_height << " for tx: " << cryptonote::get_transaction_hash(tx));
       return false;
@@ -1453,6 +1667,51 @@ namespace service_nodes
   }
 
 
+  static crypto::hash checkpoint_digest(uint8_t hf_version, const cryptonote::checkpoint_t &checkpoint, const quorum &quorum)
+  {
+    std::string buf;
+    buf.reserve(1 + 8 + sizeof(crypto::hash) + checkpoint.signatures.size() * (2 + sizeof(crypto::signature)) + quorum.validators.size() * sizeof(crypto::public_key));
+    buf += static_cast<char>(hf_version);
+    buf += tools::view_guts(boost::endian::native_to_little(checkpoint.height));
+    buf += tools::view_guts(checkpoint.block_hash);
+    for (auto const &sig : checkpoint.signatures)
+    {
+      buf += tools::view_guts(boost::endian::native_to_little(sig.voter_index));
+      buf += tools::view_guts(sig.signature);
+    }
+    for (auto const &validator : quorum.validators)
+      buf += tools::view_guts(validator);
+
+    crypto::hash result;
+    crypto::cn_fast_hash(buf.data(), buf.size(), result);
+    return result;
+  }
+
+  bool service_node_list::verify_checkpoint_cached(uint8_t hf_version, const cryptonote::checkpoint_t &checkpoint, const quorum &quorum)
+  {
+    auto digest = checkpoint_digest(hf_version, checkpoint, quorum);
+    {
+      std::lock_guard lock{m_verified_checkpoints_mutex};
+      if (m_verified_checkpoints.count(digest))
+        return true;
+    }
+
+    if (!service_nodes::verify_checkpoint(hf_version, checkpoint, quorum))
+      return false;
+
+    std::lock_guard lock{m_verified_checkpoints_mutex};
+    if (m_verified_checkpoints.insert(digest).second)
+    {
+      m_verified_checkpoints_order.push_back(digest);
+      if (m_verified_checkpoints_order.size() > MAX_VERIFIED_CHECKPOINTS)
+      {
+        m_verified_checkpoints.erase(m_verified_checkpoints_order.front());
+        m_verified_checkpoints_order.pop_front();
+      }
+    }
+    return true;
+  }
+
   bool service_node_list::verify_block(const cryptonote::block &block, bool alt_block, cryptonote::checkpoint_t const *checkpoint)
   {
     if (block.major_version < cryptonote::network_version_9_service_nodes)
@@ -1474,12 +1733,12 @@ namespace service_nodes
         return false;
       }
 
-      bool failed_checkpoint_verify = !service_nodes::verify_checkpoint(block.major_version, *checkpoint, *quorum);
+      bool failed_checkpoint_verify = !verify_checkpoint_cached(block.major_version, *checkpoint, *quorum);
       if (alt_block && failed_checkpoint_verify)
       {
         for (std::shared_ptr<const service_nodes::quorum> alt_quorum : alt_quorums)
         {
-          if (service_nodes::verify_checkpoint(block.major_version, *checkpoint, *alt_quorum))
+          if (verify_checkpoint_cached(block.major_version, *checkpoint, *alt_quorum))
           {
             failed_checkpoint_verify = false;
             break;
@@ -1589,6 +1848,7 @@ namespace service_nodes
     if (block.major_version < cryptonote::network_version_9_service_nodes)
       return true;
 
+    PERF_TIMER(block_added);
     std::lock_guard lock(m_sn_mutex);
     process_block(block, txs);
     bool result = verify_block(block, false /*alt_block*/, checkpoint);
@@ -1860,7 +2120,7 @@ namespace service_nodes
     return result;
   }
 
-  static void generate_other_quorums(service_node_list::state_t &state, std::vector<pubkey_and_sninfo> const &active_snode_list, cryptonote::network_type nettype, uint8_t hf_version)
+  static void generate_other_quorums(service_node_list::state_t const &state, std::vector<pubkey_and_sninfo> const &active_snode_list, cryptonote::network_type nettype, uint8_t hf_version)
   {
     assert(state.block_hash != crypto::null_hash);
 
@@ -1975,6 +2235,17 @@ namespace service_nodes
     }
   }
 
+  const quorum_manager& service_node_list::state_t::get_quorums() const
+  {
+    if (quorums_pending_hf)
+    {
+      uint8_t hf_version = quorums_pending_hf;
+      quorums_pending_hf = 0;
+      generate_other_quorums(*this, *active_nodes(), quorums_nettype, hf_version);
+    }
+    return quorums;
+  }
+
   void service_node_list::state_t::update_from_block(cryptonote::BlockchainDB const &db,
                                                      cryptonote::network_type nettype,
                                                      state_set const &state_history,
@@ -1986,9 +2257,13 @@ namespace service_nodes
   {
     ++height;
     bool need_swarm_update = false;
+    // Only blocks with staking or state change txs, or expiring nodes, can change the locked stakes
+    bool need_key_image_update = false;
+    const service_nodes_infos_t prev_infos = locked_key_images || leader_queue ? service_nodes_infos : service_nodes_infos_t{};
     uint64_t block_height  = cryptonote::get_block_height(block);
     assert(height == block_height);
     quorums                  = {};
+    quorums_pending_hf       = 0;
     block_hash               = cryptonote::get_block_hash(block);
     uint8_t const hf_version = block.major_version;
 
@@ -1998,11 +2273,11 @@ namespace service_nodes
     // TX's included in the block were applied
     //   i.e. before any deregistrations, registrations, decommissions, recommissions.
     //
-    crypto::public_key winner_pubkey = cryptonote::get_service_node_winner_from_tx_extra(block.miner_tx.extra);
+    crypto::public_key winner_pubkey = cryptonote::get_service_node_winner_from_tx_extra(block.miner_tx);
     if (hf_version >= cryptonote::network_version_16_pulse)
     {
       std::vector<crypto::hash> entropy = get_pulse_entropy_for_next_block(db, block.prev_id, block.pulse.round);
-      quorum pulse_quorum = generate_pulse_quorum(nettype, winner_pubkey, hf_version, active_service_nodes_infos(), entropy, block.pulse.round);
+      quorum pulse_quorum = generate_pulse_quorum(nettype, winner_pubkey, hf_version, *active_nodes(), entropy, block.pulse.round);
       if (verify_pulse_quorum_sizes(pulse_quorum))
       {
         // NOTE: Send candidate to the back of the list
@@ -2019,6 +2294,9 @@ namespace service_nodes
       }
     }
 
+    // The infos change from here on; the list gets rebuilt once they are done
+    sorted_active.reset();
+
     //
     // Remove expired blacklisted key images
     //
@@ -2045,6 +2323,7 @@ namespace service_nodes
         else                                   LOG_PRINT_L1("Service node expired: " << pubkey << " at block height: " << block_height);
 
         need_swarm_update += i->second->is_active();
+        need_key_image_update = true;
         service_nodes_infos.erase(i);
       }
     }
@@ -2073,11 +2352,13 @@ namespace service_nodes
       const cryptonote::transaction& tx = txs[index];
       if (tx.type == staking_tx_type)
       {
+        need_key_image_update = true;
         process_registration_tx(nettype, block, tx, index, my_keys);
         need_swarm_update += process_contribution_tx(nettype, block, tx, index);
       }
       else if (tx.type == cryptonote::txtype::state_change)
       {
+        need_key_image_update = true;
         need_swarm_update += process_state_change_tx(state_history, state_archive, alt_states, nettype, block, tx, my_keys);
       }
       else if (tx.type == cryptonote::txtype::key_image_unlock)
@@ -2087,7 +2368,7 @@ namespace service_nodes
     }
 
     // Filtered pubkey-sorted vector of service nodes that are active (fully funded and *not* decommissioned).
-    std::vector<pubkey_and_sninfo> active_snode_list = sort_and_filter(service_nodes_infos, [](const service_node_info &info) { return info.is_active(); });
+    auto active_snode_list = std::make_shared<std::vector<pubkey_and_sninfo>>(sort_and_filter(service_nodes_infos, [](const service_node_info &info) { return info.is_active(); }));
 
     if (need_swarm_update)
     {
@@ -2096,11 +2377,10 @@ namespace service_nodes
       std::memcpy(&seed, block_hash.data, sizeof(seed));
 
       /// Gather existing swarms from infos
-      swarm_snode_map_t existing_swarms;
-      for (const auto &key_info : active_snode_list)
-        existing_swarms[key_info.second->swarm_id].push_back(key_info.first);
+      swarm_snode_map_t existing_swarms = swarms_of(*active_snode_list);
 
       calc_swarm_changes(existing_swarms, seed);
+      swarms = make_swarm_index(existing_swarms);
 
       /// Apply changes
       for (const auto& [swarm_id, snodes] : existing_swarms) {
@@ -2110,9 +2390,30 @@ namespace service_nodes
           duplicate_info(sn_info_ptr).swarm_id = swarm_id;
         }
       }
+
+      // The moved nodes' infos got replaced, so point the list at the new ones
+      for (auto &key_info : *active_snode_list)
+        key_info.second = service_nodes_infos.at(key_info.first);
     }
+    else if (!swarms)
+    {
+      swarms = make_swarm_index(swarms_of(*active_snode_list));
+    }
+
+    if (!locked_key_images)
+      locked_key_images = make_locked_key_image_index(service_nodes_infos);
+    else if (need_key_image_update)
+      locked_key_images = update_locked_key_image_index(std::move(locked_key_images), prev_infos, service_nodes_infos);
 
-    generate_other_quorums(*this, active_snode_list, nettype, hf_version);
+    // Every block pays a leader (and so moves it), so unlike the above there's always an update
+    if (!leader_queue)
+      leader_queue = make_block_leader_queue(service_nodes_infos);
+    else
+      leader_queue = update_block_leader_queue(std::move(leader_queue), prev_infos, service_nodes_infos);
+
+    sorted_active      = std::move(active_snode_list);
+    quorums_pending_hf = hf_version;
+    quorums_nettype    = nettype;
   }
 
   void service_node_list::process_block(const cryptonote::block& block, const std::vector<cryptonote::transaction>& txs)
@@ -2130,18 +2431,22 @@ namespace service_nodes
       for (auto it = m_transient.state_history.begin(); it != end_it; it++)
       {
         if (m_store_quorum_history)
-          m_transient.old_quorum_states.emplace_back(it->height, it->quorums);
+          m_transient.old_quorum_states.emplace_back(it->height, it->get_quorums());
 
         uint64_t next_long_term_state         = ((it->height / STORE_LONG_TERM_STATE_INTERVAL) + 1) * STORE_LONG_TERM_STATE_INTERVAL;
         uint64_t dist_to_next_long_term_state = next_long_term_state - it->height;
         bool need_quorum_for_future_states    = (dist_to_next_long_term_state <= VOTE_LIFETIME + VOTE_OR_TX_VERIFY_HEIGHT_BUFFER);
         if ((it->height % STORE_LONG_TERM_STATE_INTERVAL) == 0 || need_quorum_for_future_states)
         {
-          m_transient.state_added_to_archive = true;
           if (need_quorum_for_future_states) // Preserve just quorum
           {
             state_t &state            = const_cast<state_t &>(*it); // safe: set order only depends on state_t.height
+            state.get_quorums(); // while we still have the infos to generate them from
             state.service_nodes_infos = {};
+            state.sorted_active.reset();
+            state.swarms.reset();
+            state.locked_key_images.reset();
+            state.leader_queue.reset();
             state.key_image_blacklist = {};
             state.only_loaded_quorums = true;
           }
@@ -2166,6 +2471,7 @@ namespace service_nodes
     cryptonote::network_type nettype = m_blockchain.nettype();
     m_transient.state_history.insert(m_transient.state_history.end(), m_state);
     m_state.update_from_block(m_blockchain.get_db(), nettype, m_transient.state_history, m_transient.state_archive, {}, block, txs, m_service_node_keys);
+    publish_registered();
   }
 
   void service_node_list::blockchain_detached(uint64_t height, bool /*by_pop_blocks*/)
@@ -2208,6 +2514,7 @@ namespace service_nodes
     auto it = std::prev(history.end());
     m_state = std::move(*it);
     history.erase(it);
+    publish_registered();
   }
 
   std::vector<crypto::public_key> service_node_list::state_t::get_expired_nodes(cryptonote::BlockchainDB const &db,
@@ -2287,6 +2594,15 @@ namespace service_nodes
 
   service_nodes::payout service_node_list::state_t::get_block_leader() const
   {
+    if (leader_queue)
+    {
+      if (leader_queue->empty())
+        return service_nodes::null_payout;
+      const auto &key = std::get<2>(*leader_queue->begin());
+      return service_node_info_to_payout(key, *service_nodes_infos.at(key));
+    }
+
+    // No queue (yet) for a state just loaded from the db: find the oldest waiting node the long way
     crypto::public_key key = crypto::null_pkey;
     service_node_info const *info = nullptr;
     {
@@ -2385,7 +2701,7 @@ namespace service_nodes
     // adjusted base reward post hardfork 10).
     payout const block_leader = m_state.get_block_leader();
     {
-      auto const check_block_leader_pubkey = cryptonote::get_service_node_winner_from_tx_extra(miner_tx.extra);
+      auto const check_block_leader_pubkey = cryptonote::get_service_node_winner_from_tx_extra(miner_tx);
       if (block_leader.key != check_block_leader_pubkey)
       {
         MGINFO_RED("Service node reward winner is incorrect! Expected " << block_leader.key << ", block has " << check_block_leader_pubkey);
@@ -2409,7 +2725,7 @@ namespace service_nodes
     if (cryptonote::block_has_pulse_components(block))
     {
       std::vector<crypto::hash> entropy = get_pulse_entropy_for_next_block(m_blockchain.get_db(), block.prev_id, block.pulse.round);
-      quorum pulse_quorum = generate_pulse_quorum(m_blockchain.nettype(), block_leader.key, hf_version, m_state.active_service_nodes_infos(), entropy, block.pulse.round);
+      quorum pulse_quorum = generate_pulse_quorum(m_blockchain.nettype(), block_leader.key, hf_version, *m_state.active_nodes(), entropy, block.pulse.round);
       if (!verify_pulse_quorum_sizes(pulse_quorum))
       {
         MGINFO_RED("Pulse block received but Pulse has insufficient nodes for quorum, block hash " << cryptonote::get_block_hash(block) << ", height " << height);
@@ -2646,7 +2962,7 @@ namespace service_nodes
     service_node_list::state_serialized result = {};
     result.version                             = service_node_list::state_serialized::get_version(hf_version);
     result.height                              = state.height;
-    result.quorums                             = serialize_quorum_state(hf_version, state.height, state.quorums);
+    result.quorums                             = serialize_quorum_state(hf_version, state.height, state.get_quorums());
     result.only_stored_quorums                 = state.only_loaded_quorums || only_serialize_quorums;
 
     if (only_serialize_quorums)
@@ -2661,6 +2977,43 @@ namespace service_nodes
     return result;
   }
 
+  // Returns a copy of `state` with only the service nodes added or changed since `prev` (the state
+  // at the previous height), appending the ones that have gone away to `removed`.  Unchanged
+  // entries are shared between consecutive states, so comparing pointers finds the changes.
+  static service_node_list::state_serialized serialize_service_node_state_delta(uint8_t hf_version,
+                                                                               service_node_list::state_t const &prev,
+                                                                               service_node_list::state_t const &state,
+                                                                               std::vector<crypto::public_key> &removed)
+  {
+    service_node_list::state_serialized result = serialize_service_node_state_object(hf_version, state, true /*only_serialize_quorums*/);
+    result.only_stored_quorums                 = false;
+    for (const auto &kv_pair : state.service_nodes_infos)
+    {
+      auto it = prev.service_nodes_infos.find(kv_pair.first);
+      if (it == prev.service_nodes_infos.end() || it->second != kv_pair.second)
+        result.infos.emplace_back(kv_pair);
+    }
+    for (const auto &kv_pair : prev.service_nodes_infos)
+      if (!state.service_nodes_infos.count(kv_pair.first))
+        removed.push_back(kv_pair.first);
+
+    result.key_image_blacklist = state.key_image_blacklist;
+    result.block_hash          = state.block_hash;
+    return result;
+  }
+
+  template <typename T>
+  static std::string serialize_record(T &record)
+  {
+    serialization::binary_string_archiver ba;
+    serialization::serialize(ba, record);
+    return ba.str();
+  }
+
+  // How far the base of the delta chain leading to the newest short-term record may fall behind the
+  // stored short-term history before store() writes a new base.
+  constexpr uint64_t SHORT_TERM_STATE_REBASE_INTERVAL = VOTE_LIFETIME;
+
   bool service_node_list::store()
   {
     if (!m_blockchain.has_db())
@@ -2670,80 +3023,172 @@ namespace service_nodes
     if (hf_version < cryptonote::network_version_9_service_nodes)
       return true;
 
-    data_for_serialization *data[] = {&m_transient.cache_long_term_data, &m_transient.cache_short_term_data};
-    auto const serialize_version   = data_for_serialization::get_version(hf_version);
     std::lock_guard lock(m_sn_mutex);
+    auto &db = m_blockchain.get_db();
 
-    for (data_for_serialization *serialize_entry : data)
+    // The state is stored as independent per-height records so that each store only writes (and
+    // deletes) the records that changed since the last one: the quorum history, the archived
+    // states and the short-term states.
+    try
     {
-      if (serialize_entry->version != serialize_version) m_transient.state_added_to_archive = true;
-      serialize_entry->version = serialize_version;
-      serialize_entry->clear();
-    }
+      cryptonote::db_wtxn_guard txn_guard{db};
+      if (!m_transient.records_stored)
+      {
+        db.clear_service_node_data();
+        m_transient.stored_quorum_heights.clear();
+        m_transient.stored_archive.clear();
+        m_transient.stored_short_term.clear();
+        m_transient.records_stored = true;
+      }
+
+      // Quorum history only grows at the top and gets trimmed at the bottom
+      {
+        auto &stored = m_transient.stored_quorum_heights;
+        auto const &quorum_states = m_transient.old_quorum_states;
+        auto keep = quorum_states.empty() ? stored.end() : stored.lower_bound(quorum_states.front().height);
+        for (auto it = stored.begin(); it != keep; it++)
+          db.remove_service_node_record(static_cast<uint8_t>(record_type::quorums), *it);
+        stored.erase(stored.begin(), keep);
+
+        for (const quorums_by_height &entry : quorum_states)
+        {
+          if (!stored.insert(entry.height).second)
+            continue;
+          auto serialized = serialize_quorum_state(hf_version, entry.height, entry.quorums);
+          db.set_service_node_record(static_cast<uint8_t>(record_type::quorums), entry.height, serialize_record(serialized));
+        }
+      }
 
-    m_transient.cache_short_term_data.quorum_states.reserve(m_transient.old_quorum_states.size());
-    for (const quorums_by_height &entry : m_transient.old_quorum_states)
-      m_transient.cache_short_term_data.quorum_states.push_back(serialize_quorum_state(hf_version, entry.height, entry.quorums));
+      // Archived states are written once, and only rewritten or removed if a reorg replaced them
+      {
+        auto &stored = m_transient.stored_archive;
+        auto const &archive = m_transient.state_archive;
+        for (auto it = stored.begin(); it != stored.end();)
+        {
+          auto state = archive.find(it->first);
+          if (state == archive.end() || state->block_hash != it->second.block_hash || state->only_loaded_quorums != it->second.only_quorums)
+          {
+            db.remove_service_node_record(static_cast<uint8_t>(record_type::archive_state), it->first);
+            it = stored.erase(it);
+          }
+          else
+            it++;
+        }
 
+        for (state_t const &state : archive)
+        {
+          if (stored.count(state.height))
+            continue;
+          auto serialized = serialize_service_node_state_object(hf_version, state);
+          db.set_service_node_record(static_cast<uint8_t>(record_type::archive_state), state.height, serialize_record(serialized));
+          stored.emplace(state.height, stored_state_record{state.block_hash, state.only_loaded_quorums, false, false});
+        }
+      }
 
-    if (m_transient.state_added_to_archive)
-    {
-      for (auto const &it : m_transient.state_archive)
-        m_transient.cache_long_term_data.states.push_back(serialize_service_node_state_object(hf_version, it));
-    }
+      // NOTE: A state_t may reference quorums up to (VOTE_LIFETIME
+      // + VOTE_OR_TX_VERIFY_HEIGHT_BUFFER) blocks back. So in the
+      // (MAX_SHORT_TERM_STATE_HISTORY | 2nd oldest checkpoint) window of states we store, the
+      // first (VOTE_LIFETIME + VOTE_OR_TX_VERIFY_HEIGHT_BUFFER) states we only
+      // need their quorums, such that the following states have quorum
+      // information preceeding it.  Each record holds the quorums, but only what changed in the
+      // service node list since the previous height; the last state loaded is rebuilt from the
+      // most recent base (full) record and the deltas after it.
+      {
+        auto &stored = m_transient.stored_short_term;
+        auto const &history = m_transient.state_history;
+        uint64_t const max_short_term_height = short_term_state_cull_height(hf_version, (m_state.height - 1)) + VOTE_LIFETIME + VOTE_OR_TX_VERIFY_HEIGHT_BUFFER;
+        uint64_t const history_start = history.empty() ? m_state.height : history.begin()->height;
+        auto const history_end = history.upper_bound(max_short_term_height);
+
+        // Records of states that have since been popped or reorged away, and all records after
+        // them (which could be deltas on top of them), have to go
+        auto stale = std::find_if(stored.lower_bound(history_start), stored.end(), [&history](auto const &record) {
+          auto state = history.find(record.first);
+          return state == history.end() || state->block_hash != record.second.block_hash;
+        });
+        for (auto it = stale; it != stored.end(); it++)
+          db.remove_service_node_record(static_cast<uint8_t>(record_type::short_term_state), it->first);
+        stored.erase(stale, stored.end());
 
-    // NOTE: A state_t may reference quorums up to (VOTE_LIFETIME
-    // + VOTE_OR_TX_VERIFY_HEIGHT_BUFFER) blocks back. So in the
-    // (MAX_SHORT_TERM_STATE_HISTORY | 2nd oldest checkpoint) window of states we store, the
-    // first (VOTE_LIFETIME + VOTE_OR_TX_VERIFY_HEIGHT_BUFFER) states we only
-    // store their quorums, such that the following states have quorum
-    // information preceeding it.
+        for (auto it = history.begin(); it != history_end; it++)
+        {
+          if (stored.count(it->height))
+            continue;
 
-    uint64_t const max_short_term_height = short_term_state_cull_height(hf_version, (m_state.height - 1)) + VOTE_LIFETIME + VOTE_OR_TX_VERIFY_HEIGHT_BUFFER;
-    for (auto it = m_transient.state_history.begin();
-         it != m_transient.state_history.end() && it->height <= max_short_term_height;
-         it++)
-    {
-      // TODO(oxen): There are 2 places where we convert a state_t to be a serialized state_t without quorums. We should only do this in one location for clarity.
-      m_transient.cache_short_term_data.states.push_back(serialize_service_node_state_object(hf_version, *it, it->height < max_short_term_height /*only_serialize_quorums*/));
-    }
+          state_delta_serialized record = {};
+          record.version                = state_delta_serialized::get_version(hf_version);
+          record.history_start          = history_start;
+          stored_state_record info      = {it->block_hash, it->only_loaded_quorums, false, false};
 
-    m_transient.cache_data_blob.clear();
-    if (m_transient.state_added_to_archive)
-    {
-      serialization::binary_string_archiver ba;
-      try {
-        serialization::serialize(ba, m_transient.cache_long_term_data);
-      } catch (const std::exception& e) {
-        LOG_ERROR("Failed to store service node info: failed to serialize long term data: " << e.what());
-        return false;
-      }
-      m_transient.cache_data_blob.append(ba.str());
-      {
-        auto &db = m_blockchain.get_db();
-        cryptonote::db_wtxn_guard txn_guard{db};
-        db.set_service_node_data(m_transient.cache_data_blob, true /*long_term*/);
+          auto prev_record = stored.find(it->height - 1);
+          auto prev_state  = it == history.begin() ? history.end() : std::prev(it);
+          if (it->only_loaded_quorums)
+          {
+            record.state            = serialize_service_node_state_object(hf_version, *it, true /*only_serialize_quorums*/);
+            record.state.block_hash = it->block_hash;
+          }
+          else if (prev_record != stored.end() && prev_record->second.chained &&
+                   prev_state != history.end() && prev_state->height == it->height - 1 && !prev_state->only_loaded_quorums)
+          {
+            record.state = serialize_service_node_state_delta(hf_version, *prev_state, *it, record.removed);
+            info.chained = true;
+          }
+          else
+          {
+            record.base  = true;
+            record.state = serialize_service_node_state_object(hf_version, *it);
+            info.base = info.chained = true;
+          }
+
+          db.set_service_node_record(static_cast<uint8_t>(record_type::short_term_state), it->height, serialize_record(record));
+          stored.emplace(it->height, info);
+        }
+
+        // Compaction: restart the delta chain with a full record of the newest state once its base
+        // has fallen too far behind, then drop the records nothing needs anymore.
+        if (!stored.empty())
+        {
+          auto newest = std::prev(stored.end());
+          auto base   = std::find_if(stored.rbegin(), stored.rend(), [](auto const &record) { return record.second.base; });
+          uint64_t chain_start = (newest->second.chained && base != stored.rend()) ? base->first : history_start;
+
+          auto newest_state = history.find(newest->first);
+          if (chain_start + SHORT_TERM_STATE_REBASE_INTERVAL <= history_start && !newest->second.base &&
+              newest_state != history.end() && !newest_state->only_loaded_quorums)
+          {
+            state_delta_serialized record = {};
+            record.version                = state_delta_serialized::get_version(hf_version);
+            record.history_start          = history_start;
+            record.base                   = true;
+            record.state                  = serialize_service_node_state_object(hf_version, *newest_state);
+            db.set_service_node_record(static_cast<uint8_t>(record_type::short_term_state), newest->first, serialize_record(record));
+            newest->second.base = newest->second.chained = true;
+            chain_start = newest->first;
+          }
+
+          auto keep = stored.lower_bound(std::min(chain_start, history_start));
+          for (auto it = stored.begin(); it != keep; it++)
+            db.remove_service_node_record(static_cast<uint8_t>(record_type::short_term_state), it->first);
+          stored.erase(stored.begin(), keep);
+
+          // Deltas whose chain has been cut off above can't be built on any further
+          for (auto it = stored.begin(); it != stored.end(); it++)
+          {
+            if (it->second.base || it->second.only_quorums)
+              continue;
+            auto prev = it == stored.begin() ? stored.end() : std::prev(it);
+            it->second.chained = prev != stored.end() && prev->first == it->first - 1 && prev->second.chained;
+          }
+        }
       }
     }
-
-    m_transient.cache_data_blob.clear();
+    catch (const std::exception &e)
     {
-      serialization::binary_string_archiver ba;
-      try {
-        serialization::serialize(ba, m_transient.cache_short_term_data);
-      } catch (const std::exception& e) {
-        LOG_ERROR("Failed to store service node info: failed to serialize short term data: " << e.what());
-        return false;
-      }
-      m_transient.cache_data_blob.append(ba.str());
-      {
-        auto &db = m_blockchain.get_db();
-        cryptonote::db_wtxn_guard txn_guard{db};
-        db.set_service_node_data(m_transient.cache_data_blob, false /*long_term*/);
-      }
+      LOG_ERROR("Failed to store service node info: " << e.what());
+      m_transient.records_stored = false; // Don't know what made it to the db, so rewrite it all next time
+      return false;
     }
 
-    m_transient.state_added_to_archive = false;
     return true;
   }
 
@@ -2815,9 +3260,30 @@ namespace service_nodes
   void proof_info::store(const crypto::public_key &pubkey, cryptonote::Blockchain &blockchain)
   {
     if (!proof) proof = std::unique_ptr<uptime_proof::Proof>(new uptime_proof::Proof());
-    std::unique_lock lock{blockchain};
-    auto &db = blockchain.get_db();
-    db.set_service_node_proof(pubkey, *this);
+    // Proofs have their own store in the db, outside the chain's transactions: no blockchain lock
+    blockchain.get_db().set_service_node_proof(pubkey, *this);
+  }
+
+  proof_info proof_info::stored_copy() const
+  {
+    proof_info copy;
+    copy.timestamp = timestamp;
+    copy.effective_timestamp = effective_timestamp;
+    if (proof)
+      *copy.proof = *proof;
+    copy.pubkey_x25519 = pubkey_x25519;
+    return copy;
+  }
+
+  void proof_map::assign(std::unordered_map<crypto::public_key, proof_info> proofs)
+  {
+    for (auto &s : m_shards)
+    {
+      std::lock_guard lock{s.mutex};
+      s.proofs.clear();
+    }
+    for (auto &[pubkey, proof] : proofs)
+      update(pubkey, [&proof](proof_info &p) { p = std::move(proof); });
   }
 
   bool proof_info::update(uint64_t ts, std::unique_ptr<uptime_proof::Proof> new_proof, const crypto::x25519_public_key &pk_x2)
@@ -2932,7 +3398,7 @@ namespace service_nodes
     crypto::hash hash = hash_uptime_proof(proof);
 
 
-    if (!crypto::check_signature(hash, proof.pubkey, proof.sig))
+    if (!check_service_node_signature(hash, proof.pubkey, proof.sig))
       REJECT_PROOF("signature validation failed");
 
     crypto::x25519_public_key derived_x25519_pubkey = crypto::x25519_public_key::null();
@@ -2949,15 +3415,21 @@ namespace service_nodes
     if (proof.qnet_port == 0)
       REJECT_PROOF("invalid quorumnet port in uptime proof");
 
-    auto locks = tools::unique_locks(m_blockchain, m_sn_mutex, m_x25519_map_mutex);
-    auto it = m_state.service_nodes_infos.find(proof.pubkey);
-    if (it == m_state.service_nodes_infos.end())
+    if (!is_registered(proof.pubkey))
       REJECT_PROOF("no such service node is currently registered");
 
-    auto &iproof = proofs[proof.pubkey];
-
-
-    if (now <= std::chrono::system_clock::from_time_t(iproof.timestamp) + std::chrono::seconds{netconf.UPTIME_PROOF_FREQUENCY} / 2)
+    std::optional<proof_info> to_store;
+    std::unique_lock x25519_lock{m_x25519_map_mutex};
+    crypto::x25519_public_key old_x25519;
+    bool recent = proofs.update(proof.pubkey, [&](proof_info &iproof) {
+      if (now <= std::chrono::system_clock::from_time_t(iproof.timestamp) + std::chrono::seconds{netconf.UPTIME_PROOF_FREQUENCY} / 2)
+        return true;
+      old_x25519 = iproof.pubkey_x25519;
+      if (iproof.update(std::chrono::system_clock::to_time_t(now), proof.public_ip, proof.storage_https_port, proof.storage_omq_port, proof.qnet_port, proof.snode_version, proof.pubkey_ed25519, derived_x25519_pubkey))
+        to_store = iproof.stored_copy();
+      return false;
+    });
+    if (recent)
       REJECT_PROOF("already received one uptime proof for this node recently");
 
     if (m_service_node_keys && proof.pubkey == m_service_node_keys->pub)
@@ -2975,10 +3447,6 @@ namespace service_nodes
             "this is likely to lead to deregistration of one or both service nodes.");
     }
 
-    auto old_x25519 = iproof.pubkey_x25519;
-    if (iproof.update(std::chrono::system_clock::to_time_t(now), proof.public_ip, proof.storage_https_port, proof.storage_omq_port, proof.qnet_port, proof.snode_version, proof.pubkey_ed25519, derived_x25519_pubkey))
-      iproof.store(proof.pubkey, m_blockchain);
-
     if (now - x25519_map_last_pruned >= X25519_MAP_PRUNING_INTERVAL)
     {
       time_t cutoff = std::chrono::system_clock::to_time_t(now - X25519_MAP_PRUNING_LAG);
@@ -2995,17 +3463,19 @@ namespace service_nodes
     if (derived_x25519_pubkey && (old_x25519 != derived_x25519_pubkey))
       x25519_pkey = derived_x25519_pubkey;
 
+    x25519_lock.unlock();
+    if (to_store)
+      to_store->store(proof.pubkey, m_blockchain);
+
     return true;
   }
 
 #undef REJECT_PROOF
 #define REJECT_PROOF(log) do { LOG_PRINT_L2("Rejecting uptime proof from " << proof->pubkey << ": " log); return false; } while (0)
 
-  bool service_node_list::handle_btencoded_uptime_proof(std::unique_ptr<uptime_proof::Proof> proof, bool &my_uptime_proof_confirmation, crypto::x25519_public_key &x25519_pkey)
+  bool service_node_list::verify_btencoded_uptime_proof(const std::unique_ptr<uptime_proof::Proof> &proof, std::pair<uint8_t, uint8_t> vers, std::chrono::system_clock::time_point now, crypto::x25519_public_key &derived_x25519_pubkey) const
   {
-    auto vers = get_network_version_revision(m_blockchain.nettype(), m_blockchain.get_current_blockchain_height());
     auto& netconf = get_config(m_blockchain.nettype());
-    auto now = std::chrono::system_clock::now();
 
     // Validate proof version, timestamp range,
     auto time_deviation = now - std::chrono::system_clock::from_time_t(proof->timestamp);
@@ -3031,10 +3501,10 @@ namespace service_nodes
     //
     crypto::hash hash = proof->hash_uptime_proof();
 
-    if (!crypto::check_signature(hash, proof->pubkey, proof->sig))
+    if (!check_service_node_signature(hash, proof->pubkey, proof->sig))
       REJECT_PROOF("signature validation failed");
 
-    crypto::x25519_public_key derived_x25519_pubkey = crypto::x25519_public_key::null();
+    derived_x25519_pubkey = crypto::x25519_public_key::null();
     if (!proof->pubkey_ed25519)
       REJECT_PROOF("required ed25519 auxiliary pubkey " << proof->pubkey_ed25519 << " not included in proof");
 
@@ -3048,37 +3518,47 @@ namespace service_nodes
     if (proof->qnet_port == 0)
       REJECT_PROOF("invalid quorumnet port in uptime proof");
 
-    auto locks = tools::unique_locks(m_blockchain, m_sn_mutex, m_x25519_map_mutex);
-    auto it = m_state.service_nodes_infos.find(proof->pubkey);
-    if (it == m_state.service_nodes_infos.end())
+    if (!is_registered(proof->pubkey))
       REJECT_PROOF("no such service node is currently registered");
 
-    auto &iproof = proofs[proof->pubkey];
+    return true;
+  }
 
-    if (now <= std::chrono::system_clock::from_time_t(iproof.timestamp) + std::chrono::seconds{netconf.UPTIME_PROOF_FREQUENCY} / 2)
+  // Called with m_x25519_map_mutex held
+  bool service_node_list::apply_btencoded_uptime_proof(std::unique_ptr<uptime_proof::Proof> proof, std::chrono::system_clock::time_point now, const crypto::x25519_public_key &derived_x25519_pubkey, bool &my_uptime_proof_confirmation, crypto::x25519_public_key &x25519_pkey, std::optional<proof_info> &to_store)
+  {
+    auto& netconf = get_config(m_blockchain.nettype());
+
+    // `proof` gets moved into our proof_info, below
+    const auto pubkey = proof->pubkey;
+    const auto pubkey_ed25519 = proof->pubkey_ed25519;
+    crypto::x25519_public_key old_x25519;
+    bool recent = proofs.update(pubkey, [&](proof_info &iproof) {
+      if (now <= std::chrono::system_clock::from_time_t(iproof.timestamp) + std::chrono::seconds{netconf.UPTIME_PROOF_FREQUENCY} / 2)
+        return true;
+      old_x25519 = iproof.pubkey_x25519;
+      if (iproof.update(std::chrono::system_clock::to_time_t(now), std::move(proof), derived_x25519_pubkey))
+        to_store = iproof.stored_copy();
+      return false;
+    });
+    if (recent)
       REJECT_PROOF("already received one uptime proof for this node recently");
 
-    if (m_service_node_keys && proof->pubkey == m_service_node_keys->pub)
+    if (m_service_node_keys && pubkey == m_service_node_keys->pub)
     {
       my_uptime_proof_confirmation = true;
-      MGINFO("Received uptime-proof confirmation back from network for Service Node (yours): " << proof->pubkey);
+      MGINFO("Received uptime-proof confirmation back from network for Service Node (yours): " << pubkey);
     }
     else
     {
       my_uptime_proof_confirmation = false;
-      LOG_PRINT_L2("Accepted uptime proof from " << proof->pubkey);
+      LOG_PRINT_L2("Accepted uptime proof from " << pubkey);
 
-      if (m_service_node_keys && proof->pubkey_ed25519 == m_service_node_keys->pub_ed25519)
-        MGINFO_RED("Uptime proof from SN " << proof->pubkey << " is not us, but is using our ed/x25519 keys; "
+      if (m_service_node_keys && pubkey_ed25519 == m_service_node_keys->pub_ed25519)
+        MGINFO_RED("Uptime proof from SN " << pubkey << " is not us, but is using our ed/x25519 keys; "
             "this is likely to lead to deregistration of one or both service nodes.");
     }
 
-    auto old_x25519 = iproof.pubkey_x25519;
-    if (iproof.update(std::chrono::system_clock::to_time_t(now), std::move(proof), derived_x25519_pubkey))
-    {
-      iproof.store(iproof.proof->pubkey, m_blockchain);
-    }
-
     if (now - x25519_map_last_pruned >= X25519_MAP_PRUNING_INTERVAL)
     {
       time_t cutoff = std::chrono::system_clock::to_time_t(now - X25519_MAP_PRUNING_LAG);
@@ -3090,7 +3570,7 @@ namespace service_nodes
       x25519_to_pub.erase(old_x25519);
 
     if (derived_x25519_pubkey)
-      x25519_to_pub[derived_x25519_pubkey] = {iproof.proof->pubkey, std::chrono::system_clock::to_time_t(now)};
+      x25519_to_pub[derived_x25519_pubkey] = {pubkey, std::chrono::system_clock::to_time_t(now)};
 
     if (derived_x25519_pubkey && (old_x25519 != derived_x25519_pubkey))
       x25519_pkey = derived_x25519_pubkey;
@@ -3098,28 +3578,134 @@ namespace service_nodes
     return true;
   }
 
+  bool service_node_list::handle_btencoded_uptime_proof(std::unique_ptr<uptime_proof::Proof> proof, bool &my_uptime_proof_confirmation, crypto::x25519_public_key &x25519_pkey)
+  {
+    auto vers = get_network_version_revision(m_blockchain.nettype(), m_blockchain.get_current_blockchain_height());
+    auto now = std::chrono::system_clock::now();
+    crypto::x25519_public_key derived_x25519_pubkey;
+    if (!verify_btencoded_uptime_proof(proof, vers, now, derived_x25519_pubkey))
+      return false;
+
+    const auto pubkey = proof->pubkey;
+    std::optional<proof_info> to_store;
+    {
+      std::unique_lock x25519_lock{m_x25519_map_mutex};
+      if (!apply_btencoded_uptime_proof(std::move(proof), now, derived_x25519_pubkey, my_uptime_proof_confirmation, x25519_pkey, to_store))
+        return false;
+    }
+    if (to_store)
+      to_store->store(pubkey, m_blockchain);
+    return true;
+  }
+
+  std::vector<service_node_list::uptime_proof_result> service_node_list::handle_btencoded_uptime_proofs(std::vector<std::unique_ptr<uptime_proof::Proof>> proofs)
+  {
+    std::vector<uptime_proof_result> results(proofs.size());
+    std::vector<crypto::x25519_public_key> derived(proofs.size());
+    auto vers = get_network_version_revision(m_blockchain.nettype(), m_blockchain.get_current_blockchain_height());
+    auto now = std::chrono::system_clock::now();
+
+    // The signature checks are most of the work, and independent of each other
+    std::vector<char> verified(proofs.size());
+    auto verify = [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++)
+        verified[i] = verify_btencoded_uptime_proof(proofs[i], vers, now, derived[i]);
+    };
+    constexpr size_t MIN_PROOFS_PER_THREAD = 8;
+    auto &tpool = tools::threadpool::getInstance();
+    size_t threads = std::min<size_t>(tpool.get_max_concurrency(), proofs.size() / MIN_PROOFS_PER_THREAD);
+    if (threads > 1)
+    {
+      tools::threadpool::waiter waiter;
+      for (size_t c = 0; c < threads; c++)
+        tpool.submit(&waiter, [&verify, c, threads, n=proofs.size()] { verify(n * c / threads, n * (c + 1) / threads); }, true);
+      waiter.wait(&tpool);
+    }
+    else
+      verify(0, proofs.size());
+
+    // Applied in order, so that a second proof for the same node in this batch is refused just as
+    // it would have been had it arrived separately.
+    std::vector<std::pair<crypto::public_key, proof_info>> to_store;
+    {
+      std::unique_lock x25519_lock{m_x25519_map_mutex};
+      for (size_t i = 0; i < proofs.size(); i++)
+      {
+        if (!verified[i])
+          continue;
+        auto &result = results[i];
+        const auto pubkey = proofs[i]->pubkey;
+        std::optional<proof_info> store;
+        result.accepted = apply_btencoded_uptime_proof(std::move(proofs[i]), now, derived[i], result.my_uptime_proof_confirmation, result.x25519_pkey, store);
+        if (store)
+          to_store.emplace_back(pubkey, std::move(*store));
+      }
+    }
+
+    m_blockchain.get_db().set_service_node_proofs(to_store);
+    return results;
+  }
+
   void service_node_list::cleanup_proofs()
   {
     MDEBUG("Cleaning up expired SN proofs");
-    auto locks = tools::unique_locks(m_sn_mutex, m_blockchain);
+    std::unique_lock sn_lock{m_sn_mutex};
     uint64_t now = std::time(nullptr);
-    auto& db = m_blockchain.get_db();
-    cryptonote::db_wtxn_guard guard{db};
-    for (auto it = proofs.begin(); it != proofs.end(); )
-    {
-      auto& pubkey = it->first;
-      auto& proof = it->second;
+    std::vector<crypto::public_key> expired;
+    proofs.erase_if([&](const crypto::public_key &pubkey, const proof_info &proof) {
       // 6h here because there's no harm in leaving proofs around a bit longer (they aren't big, and
       // we only store one per SN), and it's possible that we could reorg a few blocks and resurrect
       // a service node but don't want to prematurely expire the proof.
-      if (!m_state.service_nodes_infos.count(pubkey) && proof.timestamp + 6*60*60 < now)
-      {
-        db.remove_service_node_proof(pubkey);
-        it = proofs.erase(it);
-      }
-      else
-        ++it;
+      if (m_state.service_nodes_infos.count(pubkey) || proof.timestamp + 6*60*60 >= now)
+        return false;
+      expired.push_back(pubkey);
+      return true;
+    });
+    m_blockchain.get_db().remove_service_node_proofs(expired);
+
+    std::lock_guard lock{m_prepared_keys_mutex};
+    erase_if(m_prepared_keys, [this](const auto &key) { return !m_state.service_nodes_infos.count(key.first); });
+  }
+
+  bool service_node_list::check_service_node_signature(const crypto::hash &hash, const crypto::public_key &pubkey, const crypto::signature &sig) const
+  {
+    std::optional<crypto::prepared_public_key> prepared;
+    {
+      std::lock_guard lock{m_prepared_keys_mutex};
+      if (auto it = m_prepared_keys.find(pubkey); it != m_prepared_keys.end())
+        prepared = it->second;
+    }
+
+    if (!prepared)
+    {
+      // Only registered nodes' keys get cached, so that signatures by made-up keys can't fill it up
+      if (!is_registered(pubkey) || !(prepared = crypto::prepared_public_key::prepare(pubkey)))
+        return crypto::check_signature(hash, pubkey, sig);
+
+      std::lock_guard lock{m_prepared_keys_mutex};
+      m_prepared_keys.emplace(pubkey, *prepared);
+    }
+
+    return crypto::check_signature(hash, *prepared, sig);
+  }
+
+  void service_node_list::publish_registered()
+  {
+    if (!m_state.locked_key_images)
+      m_state.locked_key_images = make_locked_key_image_index(m_state.service_nodes_infos);
+    auto registered = std::make_shared<const service_nodes_infos_t>(m_state.service_nodes_infos);
+    std::lock_guard lock{m_registered_mutex};
+    m_registered = std::move(registered);
+  }
+
+  bool service_node_list::is_registered(const crypto::public_key &pubkey) const
+  {
+    std::shared_ptr<const service_nodes_infos_t> registered;
+    {
+      std::lock_guard lock{m_registered_mutex};
+      registered = m_registered;
     }
+    return registered->count(pubkey);
   }
 
   crypto::public_key service_node_list::get_pubkey_from_x25519(const crypto::x25519_public_key &x25519) const {
@@ -3146,11 +3732,10 @@ namespace service_nodes
     auto now = std::time(nullptr);
     for (const auto &pk_info : m_state.service_nodes_infos)
     {
-      auto it = proofs.find(pk_info.first);
-      if (it == proofs.end())
-       continue;
-      if (const auto &x2_pk = it->second.pubkey_x25519)
-        x25519_to_pub.emplace(x2_pk, std::make_pair(pk_info.first, now));
+      proofs.access(pk_info.first, [&](const proof_info &proof) {
+        if (const auto &x2_pk = proof.pubkey_x25519)
+          x25519_to_pub.emplace(x2_pk, std::make_pair(pk_info.first, now));
+      });
     }
   }
 
@@ -3189,22 +3774,19 @@ namespace service_nodes
 
   void service_node_list::record_checkpoint_participation(crypto::public_key const &pubkey, uint64_t height, bool participated)
   {
-    std::lock_guard lock(m_sn_mutex);
-    if (!m_state.service_nodes_infos.count(pubkey))
+    if (!is_registered(pubkey))
       return;
 
     participation_entry entry  = {};
     entry.height               = height;
     entry.voted                = participated;
 
-    auto &info = proofs[pubkey];
-    info.checkpoint_participation.add(entry);
+    proofs.update(pubkey, [&entry](proof_info &info) { info.checkpoint_participation.add(entry); });
   }
 
   void service_node_list::record_pulse_participation(crypto::public_key const &pubkey, uint64_t height, uint8_t round, bool participated)
   {
-    std::lock_guard lock(m_sn_mutex);
-    if (!m_state.service_nodes_infos.count(pubkey))
+    if (!is_registered(pubkey))
       return;
 
     participation_entry entry  = {};
@@ -3213,34 +3795,29 @@ namespace service_nodes
     entry.voted                = participated;
     entry.pulse.round          = round;
 
-    auto &info = proofs[pubkey];
-    info.pulse_participation.add(entry);
+    proofs.update(pubkey, [&entry](proof_info &info) { info.pulse_participation.add(entry); });
   }
 
   void service_node_list::record_timestamp_participation(crypto::public_key const &pubkey, bool participated)
   {
-    std::lock_guard lock(m_sn_mutex);
-    if (!m_state.service_nodes_infos.count(pubkey))
+    if (!is_registered(pubkey))
       return;
 
     timestamp_participation_entry entry  = {};
     entry.participated                = participated;
 
-    auto &info = proofs[pubkey];
-    info.timestamp_participation.add(entry);
+    proofs.update(pubkey, [&entry](proof_info &info) { info.timestamp_participation.add(entry); });
   }
 
   void service_node_list::record_timesync_status(crypto::public_key const &pubkey, bool synced)
   {
-    std::lock_guard lock(m_sn_mutex);
-    if (!m_state.service_nodes_infos.count(pubkey))
+    if (!is_registered(pubkey))
       return;
 
     timesync_entry entry  = {};
     entry.in_sync                = synced;
 
-    auto &info = proofs[pubkey];
-    info.timesync_status.add(entry);
+    proofs.update(pubkey, [&entry](proof_info &info) { info.timesync_status.add(entry); });
   }
 
   std::optional<bool> proof_info::reachable_stats::reachable(const std::chrono::steady_clock::time_point& now) const {
@@ -3265,11 +3842,9 @@ namespace service_nodes
 
     // (See .h for overview description)
 
-    std::lock_guard lock(m_sn_mutex);
-
     const auto type = storage_server ? "storage server"sv : "lokinet"sv;
 
-    if (!m_state.service_nodes_infos.count(pubkey)) {
+    if (!is_registered(pubkey)) {
       MDEBUG("Dropping " << type << " reachable report: " << pubkey << " is not a registered SN pubkey");
       return false;
     }
@@ -3278,15 +3853,17 @@ namespace service_nodes
 
     const auto now = std::chrono::steady_clock::now();
 
-    auto& reach = storage_server ? proofs[pubkey].ss_reachable : proofs[pubkey].lokinet_reachable;
-    if (reachable) {
-      reach.last_reachable = now;
-      reach.first_unreachable = NEVER;
-    } else {
-      reach.last_unreachable = now;
-      if (reach.first_unreachable == NEVER)
-        reach.first_unreachable = now;
-    }
+    proofs.update(pubkey, [&](proof_info &proof) {
+      auto& reach = storage_server ? proof.ss_reachable : proof.lokinet_reachable;
+      if (reachable) {
+        reach.last_reachable = now;
+        reach.first_unreachable = NEVER;
+      } else {
+        reach.last_unreachable = now;
+        if (reach.first_unreachable == NEVER)
+          reach.first_unreachable = now;
+      }
+    });
 
     return true;
 
@@ -3379,10 +3956,137 @@ namespace service_nodes
       return false;
     }
 
-    // NOTE: Deserialize long term state history
     uint64_t bytes_loaded = 0;
     auto &db = m_blockchain.get_db();
     cryptonote::db_rtxn_guard txn_guard{db};
+
+    bool have_records = false;
+    db.for_each_service_node_record(static_cast<uint8_t>(record_type::short_term_state), [&have_records](uint64_t, std::string_view) {
+      have_records = true;
+      return false;
+    });
+    if (!(have_records ? load_records(db, current_height, bytes_loaded) : load_legacy_data(db, current_height, bytes_loaded)))
+      return false;
+    m_transient.records_stored = have_records;
+
+    // NOTE: Load uptime proof data
+    proofs.assign(db.get_all_service_node_proofs());
+    if (m_service_node_keys)
+    {
+      // Reset our own proof timestamp to zero so that we aggressively try to resend proofs on
+      // startup (in case we are restarting because the last proof that we think went out didn't
+      // actually make it to the network).
+      proofs.update(m_service_node_keys->pub, [](proof_info &mine) {
+        mine.timestamp = mine.effective_timestamp = 0;
+      });
+    }
+
+    initialize_x25519_map();
+
+    MGINFO("Service node data loaded successfully, height: " << m_state.height);
+    MGINFO(m_state.service_nodes_infos.size()
+           << " nodes and " << m_transient.state_history.size() << " recent states loaded, " << m_transient.state_archive.size()
+           << " historical states loaded, (" << tools::get_human_readable_bytes(bytes_loaded) << ")");
+
+    LOG_PRINT_L1("service_node_list::load() returning success");
+    return true;
+  }
+
+  bool service_node_list::load_records(cryptonote::BlockchainDB &db, const uint64_t current_height, uint64_t &bytes_loaded)
+  {
+    try
+    {
+      const uint64_t hist_state_from_height = current_height - m_store_quorum_history;
+      db.for_each_service_node_record(static_cast<uint8_t>(record_type::quorums), [&](uint64_t height, std::string_view data) {
+        bytes_loaded += data.size();
+        quorum_for_serialization quorums = {};
+        serialization::parse_binary(data, quorums);
+        m_transient.stored_quorum_heights.insert(height);
+        if (height >= hist_state_from_height)
+          m_transient.old_quorum_states.emplace_back(height, quorum_for_serialization_to_quorum_manager(quorums));
+        return true;
+      });
+
+      db.for_each_service_node_record(static_cast<uint8_t>(record_type::archive_state), [&](uint64_t height, std::string_view data) {
+        bytes_loaded += data.size();
+        state_serialized serialized = {};
+        serialization::parse_binary(data, serialized);
+        if (serialized.height != height)
+          throw std::runtime_error{"archived state at height " + std::to_string(height) + " has height " + std::to_string(serialized.height)};
+        auto it = m_transient.state_archive.emplace_hint(m_transient.state_archive.end(), this, std::move(serialized));
+        m_transient.stored_archive.emplace(height, stored_state_record{it->block_hash, it->only_loaded_quorums, false, false});
+        return true;
+      });
+
+      // NOTE: Rebuild the service node list from the last base record and the deltas following
+      // it; as with the states, only the last one is loaded in full, the rest with just quorums.
+      auto &stored = m_transient.stored_short_term;
+      std::vector<state_t> states;
+      service_nodes_infos_t infos;
+      uint64_t history_start = 0;
+      db.for_each_service_node_record(static_cast<uint8_t>(record_type::short_term_state), [&](uint64_t height, std::string_view data) {
+        bytes_loaded += data.size();
+        state_delta_serialized record = {};
+        serialization::parse_binary(data, record);
+        if (record.state.height != height)
+          throw std::runtime_error{"short term state at height " + std::to_string(height) + " has height " + std::to_string(record.state.height)};
+        if (record.state.block_hash == crypto::null_hash)
+          record.state.block_hash = m_blockchain.get_block_id_by_height(height);
+
+        auto prev    = stored.empty() ? stored.end() : std::prev(stored.end());
+        bool chained = record.base || (!record.state.only_stored_quorums && prev != stored.end() && prev->first == height - 1 && prev->second.chained);
+        stored.emplace_hint(stored.end(), height, stored_state_record{record.state.block_hash, record.state.only_stored_quorums, record.base, chained});
+        history_start = record.history_start;
+
+        state_t &state = states.emplace_back(this, std::move(record.state));
+        if (record.base)
+        {
+          infos = std::move(state.service_nodes_infos);
+        }
+        else if (chained)
+        {
+          for (const crypto::public_key &pubkey : record.removed)
+            infos.erase(pubkey);
+          for (const auto &kv_pair : state.service_nodes_infos)
+            infos[kv_pair.first] = kv_pair.second;
+        }
+        state.service_nodes_infos = {};
+        state.only_loaded_quorums = true;
+        return true;
+      });
+
+      if (states.empty())
+        return false;
+
+      if (!stored.rbegin()->second.chained)
+      {
+        LOG_PRINT_L0("Unexpected last serialized state only has quorums loaded");
+        return false;
+      }
+
+      for (size_t i = 0; i + 1 < states.size(); i++)
+        if (states[i].height >= history_start)
+          m_transient.state_history.emplace_hint(m_transient.state_history.end(), std::move(states[i]));
+
+      m_state                     = std::move(states.back());
+      m_state.service_nodes_infos = std::move(infos);
+      m_state.only_loaded_quorums = false;
+      m_state.sorted_active       = std::make_shared<const std::vector<pubkey_and_sninfo>>(m_state.active_service_nodes_infos());
+      m_state.leader_queue        = make_block_leader_queue(m_state.service_nodes_infos);
+    }
+    catch (const std::exception &e)
+    {
+      LOG_ERROR("Failed to load service node data from db records: " << e.what());
+      return false;
+    }
+    return true;
+  }
+
+  // Loads the state stored as the two blobs (long term archive and short term history) written
+  // before the per-height records.  The next store() replaces them with records.
+  bool service_node_list::load_legacy_data(cryptonote::BlockchainDB &db, const uint64_t current_height, uint64_t &bytes_loaded)
+  {
+    // NOTE: Deserialize long term state history
     std::string blob;
     if (db.get_service_node_data(blob, true /*long_term*/))
     {
@@ -3529,25 +4233,6 @@ namespace service_nodes
       }
     }
 
-    // NOTE: Load uptime proof data
-    proofs = db.get_all_service_node_proofs();
-    if (m_service_node_keys)
-    {
-      // Reset our own proof timestamp to zero so that we aggressively try to resend proofs on
-      // startup (in case we are restarting because the last proof that we think went out didn't
-      // actually make it to the network).
-      auto &mine = proofs[m_service_node_keys->pub];
-      mine.timestamp = mine.effective_timestamp = 0;
-    }
-
-    initialize_x25519_map();
-
-    MGINFO("Service node data loaded successfully, height: " << m_state.height);
-    MGINFO(m_state.service_nodes_infos.size()
-           << " nodes and " << m_transient.state_history.size() << " recent states loaded, " << m_transient.state_archive.size()
-           << " historical states loaded, (" << tools::get_human_readable_bytes(bytes_loaded) << ")");
-
-    LOG_PRINT_L1("service_node_list::load() returning success");
     return true;
   }
 
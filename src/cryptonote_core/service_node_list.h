@@ -29,15 +29,23 @@
 #pragma once
 
 #include <chrono>
+#include <deque>
+#include <map>
 #include <mutex>
+#include <set>
 #include <shared_mutex>
 #include <string_view>
+#include <tuple>
+#include <unordered_set>
 #include "serialization/serialization.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 #include "cryptonote_core/service_node_rules.h"
 #include "cryptonote_core/service_node_voting.h"
 #include "cryptonote_core/service_node_quorum_cop.h"
+#include "cryptonote_core/service_node_swarm.h"
 #include "common/util.h"
+#include "common/cow_hash_map.h"
+#include "common/instrumented_mutex.h"
 
 namespace cryptonote
 {
@@ -120,12 +128,12 @@ namespace service_nodes
       write_index++;
     }
 
-    bool check_participation(uint16_t threshold)
+    bool check_participation(uint16_t threshold) const
     {
       if (this->write_index >= Count)
       {
         int failed_counter = 0;
-        for (ValueType &entry : array)
+        for (const ValueType &entry : array)
           if (!entry.pass()) failed_counter++;
 
         if (failed_counter > threshold)
@@ -200,6 +208,70 @@ namespace service_nodes
 
     // Stores this record in the database.
     void store(const crypto::public_key &pubkey, cryptonote::Blockchain &blockchain);
+
+    // Returns a copy of the parts of this that store() writes, for storing once the lock on this
+    // has been released.
+    proof_info stored_copy() const;
+  };
+
+  /// The proof_infos of the service nodes.  These are kept apart from the consensus state (and its
+  /// m_sn_mutex) so that taking in proofs and reachability reports never waits on block processing,
+  /// and are sharded by pubkey so that updates of different nodes don't wait on each other.
+  ///
+  /// The callbacks run with a shard locked, so they should be quick, and must not take any other
+  /// locks (m_sn_mutex may already be held when a shard gets locked, never the other way around).
+  class proof_map
+  {
+  public:
+    /// Calls `f(proof_info&)` with the proof of `pubkey` (default constructed if there is none
+    /// yet), and returns what it returns.
+    template <typename Func>
+    decltype(auto) update(const crypto::public_key &pubkey, Func &&f) {
+      auto &s = shard_for(pubkey);
+      std::lock_guard lock{s.mutex};
+      return f(s.proofs[pubkey]);
+    }
+
+    /// Calls `f(const proof_info&)` with the proof of `pubkey`, if there is one.  Returns whether
+    /// there was.
+    template <typename Func>
+    bool access(const crypto::public_key &pubkey, Func &&f) const {
+      auto &s = shard_for(pubkey);
+      std::lock_guard lock{s.mutex};
+      auto it = s.proofs.find(pubkey);
+      if (it == s.proofs.end())
+        return false;
+      f(it->second);
+      return true;
+    }
+
+    /// Calls `f(pubkey, proof_info&)` for each proof, a shard at a time, and removes the ones it
+    /// returns true for.
+    template <typename Func>
+    void erase_if(Func &&f) {
+      for (auto &s : m_shards) {
+        std::lock_guard lock{s.mutex};
+        for (auto it = s.proofs.begin(); it != s.proofs.end(); )
+          if (f(it->first, it->second))
+            it = s.proofs.erase(it);
+          else
+            ++it;
+      }
+    }
+
+    /// Replaces all the proofs, e.g. with those loaded from the database.
+    void assign(std::unordered_map<crypto::public_key, proof_info> proofs);
+
+  private:
+    static constexpr size_t SHARDS = 16;
+    struct shard {
+      mutable std::mutex mutex;
+      std::unordered_map<crypto::public_key, proof_info> proofs;
+    };
+    std::array<shard, SHARDS> m_shards;
+
+    shard &shard_for(const crypto::public_key &pubkey) { return m_shards[std::hash<crypto::public_key>{}(pubkey) % SHARDS]; }
+    const shard &shard_for(const crypto::public_key &pubkey) const { return m_shards[std::hash<crypto::public_key>{}(pubkey) % SHARDS]; }
   };
 
   struct pulse_sort_key
@@ -367,7 +439,14 @@ namespace service_nodes
   };
 
   using pubkey_and_sninfo     =          std::pair<crypto::public_key, std::shared_ptr<const service_node_info>>;
-  using service_nodes_infos_t = std::unordered_map<crypto::public_key, std::shared_ptr<const service_node_info>>;
+  // Copy-on-write so that the states kept in the state history share all of the entries that didn't
+  // change between them (the service_node_info values themselves are additionally shared via the
+  // shared_ptr and duplicated with duplicate_info() on modification).
+  using service_nodes_infos_t = tools::cow_hash_map<crypto::public_key, std::shared_ptr<const service_node_info>>;
+  using locked_key_image_index = std::unordered_map<crypto::key_image, crypto::public_key>;
+  // The active nodes in the order they become block leader: by (last_reward_block_height,
+  // last_reward_transaction_index, pubkey), so the first one is the next block's leader.
+  using block_leader_queue = std::set<std::tuple<uint64_t, uint32_t, crypto::public_key>>;
 
   struct service_node_pubkey_info
   {
@@ -486,10 +565,7 @@ namespace service_nodes
     /// at all for the given pubkey then Func will not be called.
     template <typename Func>
     void access_proof(const crypto::public_key &pubkey, Func f) const {
-      std::unique_lock lock{m_sn_mutex};
-      auto it = proofs.find(pubkey);
-      if (it != proofs.end())
-        f(it->second);
+      proofs.access(pubkey, f);
     }
 
     /// Returns the (monero curve) pubkey associated with a x25519 pubkey.  Returns a null public
@@ -518,8 +594,8 @@ namespace service_nodes
       for (auto sni_end = m_state.service_nodes_infos.end(); begin != end; ++begin) {
         auto it = m_state.service_nodes_infos.find(*begin);
         if (it != sni_end) {
-          auto pit = proofs.find(it->first);
-          f(it->first, *it->second, (pit != proofs.end() ? pit->second : empty_proof));
+          if (!proofs.access(it->first, [&](const proof_info &proof) { f(it->first, *it->second, proof); }))
+            f(it->first, *it->second, empty_proof);
         }
       }
     }
@@ -531,15 +607,19 @@ namespace service_nodes
       for (const auto& pk_info : m_state.service_nodes_infos) {
         if (!pk_info.second->is_active())
           continue;
-        auto it = proofs.find(pk_info.first);
-        if (it == proofs.end())
-          continue;
-        if (const auto& x2_pk = it->second.pubkey_x25519)
-          *out++ = std::string{reinterpret_cast<const char*>(&x2_pk), sizeof(x2_pk)};
+        proofs.access(pk_info.first, [&](const proof_info &proof) {
+          if (const auto& x2_pk = proof.pubkey_x25519)
+            *out++ = std::string{reinterpret_cast<const char*>(&x2_pk), sizeof(x2_pk)};
+        });
       }
     }
 
+    /// Returns the swarm that storage servers put `pubkey` (a 32-byte user pubkey) in; nullopt if
+    /// there are no swarms.
+    std::optional<swarm_index::swarm> get_swarm_for_pubkey(std::string_view pubkey) const;
+
     std::vector<pubkey_and_sninfo> active_service_nodes_infos() const {
+      std::lock_guard lock{m_sn_mutex};
       return m_state.active_service_nodes_infos();
     }
 
@@ -564,6 +644,22 @@ namespace service_nodes
 
     bool handle_btencoded_uptime_proof(std::unique_ptr<uptime_proof::Proof> proof, bool &my_uptime_proof_confirmation, crypto::x25519_public_key &x25519_pkey);
 
+    struct uptime_proof_result
+    {
+      bool accepted = false;
+      bool my_uptime_proof_confirmation = false;
+      crypto::x25519_public_key x25519_pkey = crypto::x25519_public_key::null();
+    };
+    /// Handles a batch of proofs as handle_btencoded_uptime_proof would one at a time, but with the
+    /// signatures verified in parallel and the accepted proofs written to the database in one
+    /// transaction.  Returns the result of each proof, in order.
+    std::vector<uptime_proof_result> handle_btencoded_uptime_proofs(std::vector<std::unique_ptr<uptime_proof::Proof>> proofs);
+
+    /// Checks a signature by a service node's primary key: the same as crypto::check_signature, but
+    /// for registered service nodes using a cached precomputed form of the key (see
+    /// crypto::prepared_public_key) rather than decompressing the key for every signature.
+    bool check_service_node_signature(const crypto::hash &hash, const crypto::public_key &pubkey, const crypto::signature &sig) const;
+
     void record_checkpoint_participation(crypto::public_key const &pubkey, uint64_t height, bool participated);
 
     // Called every hour to remove proofs for expired SNs from memory and the database.
@@ -672,6 +768,31 @@ namespace service_nodes
       END_SERIALIZE()
     };
 
+    // A record of one short-term state in the db: the state's quorums and key image blacklist plus
+    // either all of its service nodes (`base`) or just those added or changed since the record at
+    // the previous height, with `removed` listing the ones that went away.  `history_start` is the
+    // oldest height of the stored short-term history at the time the record was written; records
+    // below it are only kept for the deltas building on them.
+    struct state_delta_serialized
+    {
+      enum struct version_t : uint8_t { version_0, count, };
+      static version_t get_version(uint8_t /*hf_version*/) { return version_t::version_0; }
+
+      version_t                       version;
+      bool                            base;
+      uint64_t                        history_start;
+      state_serialized                state;
+      std::vector<crypto::public_key> removed;
+
+      BEGIN_SERIALIZE()
+        ENUM_FIELD(version, version < version_t::count)
+        FIELD(base)
+        VARINT_FIELD(history_start)
+        FIELD(state)
+        FIELD(removed)
+      END_SERIALIZE()
+    };
+
     struct state_t;
     using state_set = std::set<state_t, std::less<>>;
     using block_height = uint64_t;
@@ -684,6 +805,24 @@ namespace service_nodes
       block_height                           height{0};
       mutable quorum_manager                 quorums;          // Mutable because we are allowed to (and need to) change it via std::set iterator
       service_node_list*                     sn_list;
+      // The active nodes of service_nodes_infos, sorted by pubkey.  Built once the infos settle at
+      // the end of update_from_block (or loading), and shared by everything that needs the list
+      // (quorums, pulse, the next block's pulse quorum) until the next block changes the infos.
+      std::shared_ptr<const std::vector<pubkey_and_sninfo>> sorted_active;
+      // The quorums other than pulse are only generated when first asked for (see get_quorums()),
+      // since most are never looked at.  Until then this is the hard fork version to generate them
+      // for; 0 once they have been generated (or loaded), or if there are none.
+      mutable uint8_t                        quorums_pending_hf{0};
+      cryptonote::network_type               quorums_nettype{cryptonote::UNDEFINED};
+      // The swarms of the active nodes.  Only rebuilt by update_from_block when a block changes the
+      // swarms; otherwise the next state shares it.
+      std::shared_ptr<const swarm_index>     swarms;
+      // The locked stake key images of service_nodes_infos, mapped to the node that has each one
+      // locked.  Like `swarms`, carried over to the next state unless its block changes the stakes.
+      std::shared_ptr<const locked_key_image_index> locked_key_images;
+      // The active nodes in block leader order.  Like `locked_key_images`, updated from the infos a
+      // block changed (which always includes the leader that got paid) rather than rebuilt.
+      std::shared_ptr<const block_leader_queue> leader_queue;
 
       state_t(service_node_list* snl) : sn_list{snl} {}
       state_t(service_node_list* snl, state_serialized &&state);
@@ -693,6 +832,14 @@ namespace service_nodes
       friend bool operator<(block_height h, const state_t &s)   { return        h < s.height; }
 
       std::vector<pubkey_and_sninfo>  active_service_nodes_infos() const;
+      // Like the above, but shares `sorted_active` instead of copying it, when it is there
+      std::shared_ptr<const std::vector<pubkey_and_sninfo>> active_nodes() const;
+      // Returns the state's quorums, generating them first if they are still pending.
+      const quorum_manager&           get_quorums() const;
+      // Returns `swarms`, or builds it if it isn't there
+      std::shared_ptr<const swarm_index> get_swarms() const;
+      // Returns `locked_key_images`, or builds it if it isn't there
+      std::shared_ptr<const locked_key_image_index> get_locked_key_images() const;
       std::vector<pubkey_and_sninfo>  decommissioned_service_nodes_infos() const; // return: All nodes that are fully funded *and* decommissioned.
       std::vector<crypto::public_key> get_expired_nodes(cryptonote::BlockchainDB const &db, cryptonote::network_type nettype, uint8_t hf_version, uint64_t block_height) const;
       void update_from_block(
@@ -739,8 +886,11 @@ namespace service_nodes
 
     void reset(bool delete_db_entry = false);
     bool load(uint64_t current_height);
+    bool rewind_to_chain(uint64_t current_height);
+    bool load_records(cryptonote::BlockchainDB &db, uint64_t current_height, uint64_t &bytes_loaded);
+    bool load_legacy_data(cryptonote::BlockchainDB &db, uint64_t current_height, uint64_t &bytes_loaded);
 
-    mutable std::recursive_mutex  m_sn_mutex;
+    mutable tools::instrumented_mutex<> m_sn_mutex{"service_node_list"};
     cryptonote::Blockchain&       m_blockchain;
     const service_node_keys      *m_service_node_keys;
     uint64_t                      m_store_quorum_history = 0;
@@ -749,7 +899,47 @@ namespace service_nodes
     /// Maps x25519 pubkeys to registration pubkeys + last block seen value (used for expiry)
     std::unordered_map<crypto::x25519_public_key, std::pair<crypto::public_key, time_t>> x25519_to_pub;
     std::chrono::system_clock::time_point x25519_map_last_pruned = std::chrono::system_clock::from_time_t(0);
-    std::unordered_map<crypto::public_key, proof_info> proofs;
+    proof_map proofs;
+
+    /// A copy (cheap, as it shares m_state's shards) of m_state.service_nodes_infos, republished by
+    /// publish_registered() whenever m_state changes, so that proofs and reachability reports can be
+    /// checked against the registered nodes without m_sn_mutex, which block processing holds.
+    std::shared_ptr<const service_nodes_infos_t> m_registered = std::make_shared<service_nodes_infos_t>();
+    mutable std::mutex m_registered_mutex;
+    // The checks of a proof that don't depend on (or change) our proof data, i.e. all but whether
+    // we already have a recent one from the node; safe to call from several threads at once.
+    bool verify_btencoded_uptime_proof(const std::unique_ptr<uptime_proof::Proof> &proof, std::pair<uint8_t, uint8_t> vers, std::chrono::system_clock::time_point now, crypto::x25519_public_key &derived_x25519_pubkey) const;
+    // Takes in a verified proof; `to_store` is set if it needs to be written to the database.
+    bool apply_btencoded_uptime_proof(std::unique_ptr<uptime_proof::Proof> proof, std::chrono::system_clock::time_point now, const crypto::x25519_public_key &derived_x25519_pubkey, bool &my_uptime_proof_confirmation, crypto::x25519_public_key &x25519_pkey, std::optional<proof_info> &to_store);
+
+    // Called with m_sn_mutex held
+    void publish_registered();
+    bool is_registered(const crypto::public_key &pubkey) const;
+
+    /// Checkpoints verify_block has already verified (by checkpoint_digest, which covers the quorum
+    /// too), so that one that comes by again, e.g. with blocks we are given again or when switching
+    /// to an alt chain, doesn't have its signatures checked again.
+    bool verify_checkpoint_cached(uint8_t hf_version, const cryptonote::checkpoint_t &checkpoint, const quorum &quorum);
+    static constexpr size_t MAX_VERIFIED_CHECKPOINTS = 256;
+    std::mutex m_verified_checkpoints_mutex;
+    std::unordered_set<crypto::hash> m_verified_checkpoints;
+    std::deque<crypto::hash> m_verified_checkpoints_order; // oldest first, for evicting
+
+    /// Precomputed forms of registered service nodes' primary keys, for check_service_node_signature;
+    /// those of nodes no longer registered are dropped by cleanup_proofs().
+    mutable std::mutex m_prepared_keys_mutex;
+    mutable std::unordered_map<crypto::public_key, crypto::prepared_public_key> m_prepared_keys;
+
+    // Types of the per-height service node records in the db
+    enum struct record_type : uint8_t { quorums = 1, archive_state = 2, short_term_state = 3, };
+
+    struct stored_state_record
+    {
+      crypto::hash block_hash;
+      bool         only_quorums;
+      bool         base;
+      bool         chained; // Whether this record and those before it that it builds on make up the full state
+    };
 
     struct quorums_by_height
     {
@@ -765,10 +955,14 @@ namespace service_nodes
       state_set                                 state_history; // Store state_t's from MIN(2nd oldest checkpoint | height - DEFAULT_SHORT_TERM_STATE_HISTORY) up to the block height
       state_set                                 state_archive; // Store state_t's where ((height < m_state_history.first()) && (height % STORE_LONG_TERM_STATE_INTERVAL))
       std::unordered_map<crypto::hash, state_t> alt_state;
-      bool                                      state_added_to_archive;
-      data_for_serialization                    cache_long_term_data;
-      data_for_serialization                    cache_short_term_data;
-      std::string                               cache_data_blob;
+
+      // What store() has written to the db, so that it only writes what changed since.  Until
+      // records_stored is set the db holds nothing to build on (or only the pre-record blobs) and
+      // the next store() rewrites everything.
+      bool                                      records_stored;
+      std::set<uint64_t>                        stored_quorum_heights;
+      std::map<uint64_t, stored_state_record>   stored_archive;
+      std::map<uint64_t, stored_state_record>   stored_short_term;
     } m_transient = {};
 
     state_t m_state; // NOTE: Not in m_transient due to the non-trivial constructor. We can't blanket initialise using = {}; needs to be reset in ::reset(...) manually
@@ -35,6 +35,7 @@
 #include "cryptonote_basic/hardfork.h"
 #include "version.h"
 #include "common/oxen.h"
+#include "common/threadpool.h"
 #include "common/util.h"
 #include "epee/net/local_ip.h"
 #include <boost/endian/conversion.hpp>
@@ -74,13 +75,10 @@ namespace service_nodes
     m_last_checkpointed_height = 0;
   }
 
-  // Perform service node tests -- this returns true is the server node is in a good state, that is,
-  // has submitted uptime proofs, participated in required quorums, etc.
-  service_node_test_results quorum_cop::check_service_node(uint8_t hf_version, const crypto::public_key &pubkey, const service_node_info &info) const
+  // The proof data (and the like) that check_service_node looks at, copied out of the service node
+  // list so that the checks themselves don't need its lock.
+  struct quorum_cop::node_test_data
   {
-    const auto& netconf = m_core.get_net_config();
-
-    service_node_test_results result; // Defaults to true for individual tests
     bool ss_reachable = true, lokinet_reachable = true;
     uint64_t timestamp = 0;
     decltype(std::declval<proof_info>().public_ips) ips{};
@@ -90,22 +88,63 @@ namespace service_nodes
     service_nodes::participation_history<service_nodes::timestamp_participation_entry> timestamp_participation{};
     service_nodes::participation_history<service_nodes::timesync_entry> timesync_status{};
 
-    constexpr std::array<uint16_t, 3> MIN_TIMESTAMP_VERSION{9,1,0};
+    // The timestamp of the block of the node's last IP change penalty (or registration); only
+    // looked up for nodes that have been seen on two IPs.
+    std::optional<uint64_t> last_ip_change_timestamp;
+  };
 
+  std::unordered_map<crypto::public_key, quorum_cop::node_test_data> quorum_cop::get_test_data(const std::vector<crypto::public_key> &pubkeys) const
+  {
+    const auto& netconf = m_core.get_net_config();
     const auto unreachable_threshold = netconf.UPTIME_PROOF_VALIDITY - netconf.UPTIME_PROOF_FREQUENCY;
 
-    m_core.get_service_node_list().access_proof(pubkey, [&](const proof_info &proof) {
-      ss_reachable             = !proof.ss_reachable.unreachable_for(unreachable_threshold);
-      lokinet_reachable        = !proof.lokinet_reachable.unreachable_for(unreachable_threshold);
-      timestamp                = std::max(proof.timestamp, proof.effective_timestamp);
-      ips                      = proof.public_ips;
-      checkpoint_participation = proof.checkpoint_participation;
-      pulse_participation      = proof.pulse_participation;
+    std::unordered_map<crypto::public_key, node_test_data> result;
+    std::vector<std::pair<node_test_data*, uint64_t>> ip_changes;
+    m_core.get_service_node_list().for_each_service_node_info_and_proof(pubkeys.begin(), pubkeys.end(),
+        [&](const crypto::public_key &pubkey, const service_node_info &info, const proof_info &proof) {
+      auto& data = result[pubkey];
+      data.ss_reachable             = !proof.ss_reachable.unreachable_for(unreachable_threshold);
+      data.lokinet_reachable        = !proof.lokinet_reachable.unreachable_for(unreachable_threshold);
+      data.timestamp                = std::max(proof.timestamp, proof.effective_timestamp);
+      data.ips                      = proof.public_ips;
+      data.checkpoint_participation = proof.checkpoint_participation;
+      data.pulse_participation      = proof.pulse_participation;
+
+      data.timestamp_participation  = proof.timestamp_participation;
+      data.timesync_status          = proof.timesync_status;
+      if (data.ips[0].first && data.ips[1].first)
+        ip_changes.emplace_back(&data, info.last_ip_change_height);
+    });
+
+    // Outside the service node list lock:
+    std::vector<cryptonote::block> blocks;
+    for (auto& [data, height] : ip_changes)
+    {
+      blocks.clear();
+      if (m_core.get_blocks(height, 1, blocks))
+        data->last_ip_change_timestamp = blocks[0].timestamp;
+    }
+    return result;
+  }
 
-      timestamp_participation  = proof.timestamp_participation;
-      timesync_status          = proof.timesync_status;
+  service_node_test_results quorum_cop::check_service_node(uint8_t hf_version, const crypto::public_key &pubkey, const service_node_info &info) const
+  {
+    auto data = get_test_data({pubkey});
+    auto it = data.find(pubkey);
+    return check_service_node(hf_version, pubkey, info, it != data.end() ? it->second : node_test_data{});
+  }
+
+  // Perform service node tests -- this returns true is the server node is in a good state, that is,
+  // has submitted uptime proofs, participated in required quorums, etc.
+  service_node_test_results quorum_cop::check_service_node(uint8_t hf_version, const crypto::public_key &pubkey, const service_node_info &info, const node_test_data &data) const
+  {
+    const auto& netconf = m_core.get_net_config();
+
+    service_node_test_results result; // Defaults to true for individual tests
+    const auto& [ss_reachable, lokinet_reachable, timestamp, ips,
+          checkpoint_participation, pulse_participation, timestamp_participation, timesync_status,
+          last_ip_change_timestamp] = data;
 
-    });
     std::chrono::seconds time_since_last_uptime_proof{std::time(nullptr) - timestamp};
 
     bool check_uptime_obligation     = true;
@@ -142,11 +181,10 @@ namespace service_nodes
     if (ips[0].first && ips[1].first) {
       // Figure out when we last had a blockchain-level IP change penalty (or when we registered);
       // we only consider IP changes starting two hours after the last IP penalty.
-      std::vector<cryptonote::block> blocks;
-      if (m_core.get_blocks(info.last_ip_change_height, 1, blocks)) {
+      if (last_ip_change_timestamp) {
         uint64_t find_ips_used_since = std::max(
             uint64_t(std::time(nullptr)) - std::chrono::seconds{IP_CHANGE_WINDOW}.count(),
-            uint64_t(blocks[0].timestamp) + std::chrono::seconds{IP_CHANGE_BUFFER}.count());
+            *last_ip_change_timestamp + std::chrono::seconds{IP_CHANGE_BUFFER}.count());
         if (ips[0].second > find_ips_used_since && ips[1].second > find_ips_used_since)
           result.single_ip = false;
       }
@@ -338,27 +376,67 @@ namespace service_nodes
               // NOTE: I am in the quorum
               //
               auto worker_states = m_core.get_service_node_list_state(quorum->workers);
+
+              // Test all the workers first: their proof data is copied out in one go, and then the
+              // tests (which don't need any locks) are spread over the threadpool.
+              struct worker_test
+              {
+                size_t node_index;
+                const service_node_pubkey_info* state;
+                service_node_test_results results;
+              };
+              std::vector<worker_test> tests;
+              tests.reserve(worker_states.size());
               auto worker_it = worker_states.begin();
-              std::unique_lock lock{m_lock};
-              int good = 0, total = 0;
-              for (size_t node_index = 0; node_index < quorum->workers.size(); ++worker_it, ++node_index)
+              int total = 0;
+              for (size_t node_index = 0; node_index < quorum->workers.size() && worker_it != worker_states.end(); ++worker_it, ++node_index)
               {
                 // If the SN no longer exists then it'll be omitted from the worker_states vector,
                 // so if the elements don't line up skip ahead.
-                while (worker_it->pubkey != quorum->workers[node_index] && node_index < quorum->workers.size())
+                while (node_index < quorum->workers.size() && worker_it->pubkey != quorum->workers[node_index])
                   node_index++;
                 if (node_index == quorum->workers.size())
                   break;
                 total++;
 
-                const auto &node_key = worker_it->pubkey;
-                const auto &info = *worker_it->info;
+                if (worker_it->info->can_be_voted_on(m_obligations_height))
+                  tests.push_back({node_index, &*worker_it, {}});
+              }
 
-                if (!info.can_be_voted_on(m_obligations_height))
-                  continue;
+              std::vector<crypto::public_key> tested_keys;
+              tested_keys.reserve(tests.size());
+              for (auto& t : tests)
+                tested_keys.push_back(t.state->pubkey);
+              const auto test_data = get_test_data(tested_keys);
+              static const node_test_data no_test_data{};
+              auto run_tests = [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                {
+                  auto& t = tests[i];
+                  auto it = test_data.find(t.state->pubkey);
+                  t.results = check_service_node(obligations_height_hf_version, t.state->pubkey, *t.state->info, it != test_data.end() ? it->second : no_test_data);
+                }
+              };
 
-                auto test_results = check_service_node(obligations_height_hf_version, node_key, info);
-                bool passed       = test_results.passed();
+              auto& tpool = tools::threadpool::getInstance();
+              const size_t chunks = std::min<size_t>(tpool.get_max_concurrency(), (tests.size() + MIN_TESTS_PER_THREAD - 1) / MIN_TESTS_PER_THREAD);
+              if (chunks > 1)
+              {
+                tools::threadpool::waiter waiter;
+                for (size_t c = 1; c < chunks; c++)
+                  tpool.submit(&waiter, [&run_tests, c, chunks, n=tests.size()] { run_tests(n * c / chunks, n * (c + 1) / chunks); }, true);
+                run_tests(0, tests.size() / chunks);
+                waiter.wait(&tpool);
+              }
+              else
+                run_tests(0, tests.size());
+
+              std::unique_lock lock{m_lock};
+              int good = 0;
+              for (auto& [node_index, state, test_results] : tests)
+              {
+                const auto &info = *state->info;
+                bool passed      = test_results.passed();
 
                 new_state vote_for_state;
                 uint16_t reason = 0;
@@ -671,6 +749,10 @@ namespace service_nodes
     if (!verify_vote_age(vote, m_core.get_current_blockchain_height(), vvc))
       return false;
 
+    // The same vote tends to arrive from several peers; only the first copy needs verifying.
+    if (m_vote_pool.has_vote(vote))
+      return true;
+
     std::shared_ptr<const quorum> quorum = m_core.get_quorum(vote.type, vote.block_height);
     if (!quorum)
     {
@@ -678,7 +760,7 @@ namespace service_nodes
       return false;
     }
 
-    if (!verify_vote_signature(get_network_version(m_core.get_nettype(), vote.block_height), vote, vvc, *quorum))
+    if (!verify_vote_signature(get_network_version(m_core.get_nettype(), vote.block_height), vote, vvc, *quorum, &m_core.get_service_node_list()))
       return false;
 
     std::vector<pool_vote_entry> votes = m_vote_pool.add_pool_vote_if_unique(vote, vvc);
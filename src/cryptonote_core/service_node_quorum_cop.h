@@ -34,6 +34,7 @@
 #include "cryptonote_core/service_node_voting.h"
 #include <cassert>
 #include <mutex>
+#include <unordered_map>
 
 namespace cryptonote
 {
@@ -129,8 +130,17 @@ namespace service_nodes
 
   private:
     void process_quorums(cryptonote::block const &block);
+
+    struct node_test_data;
+    // Copies out what the tests need to know of each of the given (registered) nodes in one pass
+    // over the service node list.
+    std::unordered_map<crypto::public_key, node_test_data> get_test_data(const std::vector<crypto::public_key> &pubkeys) const;
+    service_node_test_results check_service_node(uint8_t hf_version, const crypto::public_key &pubkey, const service_node_info &info, const node_test_data &data) const;
     service_node_test_results check_service_node(uint8_t hf_version, const crypto::public_key &pubkey, const service_node_info &info) const;
 
+    // Obligation quorum tests are only spread over the threadpool in chunks of at least this many
+    static constexpr size_t MIN_TESTS_PER_THREAD = 16;
+
     cryptonote::core& m_core;
     voting_pool       m_vote_pool;
     uint64_t          m_obligations_height;
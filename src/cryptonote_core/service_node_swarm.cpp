@@ -1,6 +1,9 @@
 #include "service_node_swarm.h"
 #include "common/random.h"
 
+#include <boost/endian/conversion.hpp>
+#include <cstring>
+
 #undef OXEN_DEFAULT_LOG_CATEGORY
 #define OXEN_DEFAULT_LOG_CATEGORY "service_nodes"
 
@@ -320,4 +323,54 @@ namespace service_nodes
       LOG_PRINT_L2(entry.first << ": " << entry.second.size());
     }
   }
+
+  const swarm_index::swarm* swarm_index::closest(uint64_t point) const
+  {
+    if (swarms.empty()) return nullptr;
+
+    auto it = std::lower_bound(swarms.begin(), swarms.end(), point, [](const swarm& s, uint64_t p) { return s.id < p; });
+    if (it == swarms.end())
+    {
+      // Past the largest id: that one, or (wrapping around) the smallest
+      const uint64_t dist = point - swarms.back().id;
+      const uint64_t wrapped = (MAX_ID + 1 - point) + swarms.front().id;
+      return wrapped < dist ? &swarms.front() : &swarms.back();
+    }
+    if (it == swarms.begin())
+    {
+      const uint64_t dist = it->id - point;
+      const uint64_t wrapped = point + (MAX_ID + 1 - swarms.back().id);
+      return wrapped < dist ? &swarms.back() : &*it;
+    }
+    auto prev = std::prev(it);
+    return (point - prev->id <= it->id - point) ? &*prev : &*it;
+  }
+
+  std::shared_ptr<const swarm_index> make_swarm_index(const swarm_snode_map_t& swarm_to_snodes)
+  {
+    auto index = std::make_shared<swarm_index>();
+    index->swarms.reserve(swarm_to_snodes.size());
+    for (const auto& [id, snodes] : swarm_to_snodes)
+    {
+      if (id == UNASSIGNED_SWARM_ID || snodes.empty()) continue;
+      auto& swarm = index->swarms.emplace_back();
+      swarm.id = id;
+      swarm.members = snodes;
+      std::sort(swarm.members.begin(), swarm.members.end());
+    }
+    return index;
+  }
+
+  uint64_t pubkey_to_swarm_space(std::string_view pubkey)
+  {
+    assert(pubkey.size() == 32);
+    uint64_t res = 0;
+    for (size_t i = 0; i < 4; i++)
+    {
+      uint64_t buf;
+      std::memcpy(&buf, pubkey.data() + i * 8, 8);
+      res ^= buf;
+    }
+    return boost::endian::big_to_native(res);
+  }
 }
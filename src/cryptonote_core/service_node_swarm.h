@@ -3,6 +3,8 @@
 #include "service_node_rules.h"
 
 #include <map>
+#include <memory>
+#include <string_view>
 #include <vector>
 #include <random>
 
@@ -23,6 +25,29 @@ namespace service_nodes {
 
     void calc_swarm_changes(swarm_snode_map_t& swarm_to_snodes, uint64_t seed);
 
+    /// The swarms of the active service nodes, sorted by id, for looking up the swarm of a pubkey
+    /// without going through all the nodes.
+    struct swarm_index {
+        struct swarm {
+            swarm_id_t id;
+            std::vector<crypto::public_key> members; // sorted
+        };
+        std::vector<swarm> swarms;
+
+        /// Returns the swarm a storage server puts `point` (see pubkey_to_swarm_space) in: the one
+        /// with the closest id, wrapping around from the largest id to the smallest, and the smaller
+        /// id of two equally close.  nullptr if there are no swarms.
+        const swarm* closest(uint64_t point) const;
+    };
+
+    /// Builds the index from swarm_to_snodes (e.g. as left by calc_swarm_changes), leaving out
+    /// unassigned nodes.
+    std::shared_ptr<const swarm_index> make_swarm_index(const swarm_snode_map_t& swarm_to_snodes);
+
+    /// Maps a 32-byte (user) pubkey into swarm id space, as storage servers do: the xor of its four
+    /// 8-byte pieces, as a big-endian integer.
+    uint64_t pubkey_to_swarm_space(std::string_view pubkey);
+
 #ifdef UNIT_TEST
     size_t calc_excess(const swarm_snode_map_t &swarm_to_snodes);
     size_t calc_threshold(const swarm_snode_map_t &swarm_to_snodes);
@@ -194,6 +194,8 @@ namespace service_nodes
     crypto::hash const hash = make_state_change_vote_hash(state_change.block_height, state_change.service_node_index, state_change.state);
     std::array<int, service_nodes::STATE_CHANGE_QUORUM_SIZE> validator_set = {};
     int validator_index_tracker                                            = -1;
+    std::vector<crypto::public_key> keys;
+    std::vector<crypto::signature> sigs;
     for (const auto &vote : state_change.votes)
     {
       if (hf_version >= cryptonote::network_version_13_enforce_checkpoints) // NOTE: After HF13, votes must be stored in ascending order
@@ -218,10 +220,16 @@ namespace service_nodes
         return bad_tx(tvc);
       }
 
-      crypto::public_key const &key = quorum.validators[vote.validator_index];
-      if (!crypto::check_signature(hash, key, vote.signature))
+      keys.push_back(quorum.validators[vote.validator_index]);
+      sigs.push_back(vote.signature);
+    }
+
+    auto valid = crypto::check_signatures(hash, keys, sigs);
+    for (size_t i = 0; i < valid.size(); i++)
+    {
+      if (!valid[i])
       {
-        LOG_PRINT_L1("Invalid signature for voter " << vote.validator_index << "/" << key);
+        LOG_PRINT_L1("Invalid signature for voter " << state_change.votes[i].validator_index << "/" << keys[i]);
         vvc.m_signature_not_valid = true;
         return bad_tx(tvc);
       }
@@ -287,6 +295,10 @@ namespace service_nodes
       break;
     }
 
+    std::vector<crypto::public_key> keys;
+    std::vector<crypto::signature> sigs;
+    keys.reserve(signatures.size());
+    sigs.reserve(signatures.size());
     for (size_t i = 0; i < signatures.size(); i++)
     {
       service_nodes::quorum_signature const &quorum_signature = signatures[i];
@@ -334,9 +346,17 @@ namespace service_nodes
         return false;
       }
 
-      if (!crypto::check_signature(hash, key, quorum_signature.signature))
+      keys.push_back(key);
+      sigs.push_back(quorum_signature.signature);
+    }
+
+    // All checked at once, which is cheaper than one at a time (see crypto::check_signatures)
+    auto valid = crypto::check_signatures(hash, keys, sigs);
+    for (size_t i = 0; i < valid.size(); i++)
+    {
+      if (!valid[i])
       {
-        MGINFO("Incorrect signature for vote, failed verification at height: " << height << " for voter: " << key << "\n" << quorum);
+        MGINFO("Incorrect signature for vote, failed verification at height: " << height << " for voter: " << keys[i] << "\n" << quorum);
         return false;
       }
     }
@@ -441,7 +461,7 @@ namespace service_nodes
     return result;
   }
 
-  bool verify_vote_signature(uint8_t hf_version, const quorum_vote_t &vote, cryptonote::vote_verification_context &vvc, const service_nodes::quorum &quorum)
+  bool verify_vote_signature(uint8_t hf_version, const quorum_vote_t &vote, cryptonote::vote_verification_context &vvc, const service_nodes::quorum &quorum, const service_node_list *sn_list)
   {
     bool result = true;
     if (vote.type > tools::enum_top<quorum_type>)
@@ -516,7 +536,7 @@ namespace service_nodes
     if (!result)
       return result;
 
-    result = crypto::check_signature(hash, key, vote.signature);
+    result = sn_list ? sn_list->check_service_node_signature(hash, key, vote.signature) : crypto::check_signature(hash, key, vote.signature);
     if (result)
       MDEBUG("Signature accepted for " << vote.type << " voter " << vote.index_in_group << "/" << key
               << (vote.type == quorum_type::obligations ? " voting for worker " + std::to_string(vote.state_change.worker_index) : "")
@@ -643,6 +663,18 @@ namespace service_nodes
     return *votes;
   }
 
+  bool voting_pool::has_vote(const quorum_vote_t& vote)
+  {
+    std::unique_lock lock{m_lock};
+    auto *votes = find_vote_pool(vote);
+    if (!votes)
+      return false;
+
+    return std::any_of(votes->begin(), votes->end(), [&vote](pool_vote_entry const &entry) {
+      return entry.vote.index_in_group == vote.index_in_group && entry.vote.signature == vote.signature;
+    });
+  }
+
   void voting_pool::remove_used_votes(std::vector<cryptonote::transaction> const &txs, uint8_t hard_fork_version)
   {
     // TODO(doyle): Cull checkpoint votes
@@ -656,7 +688,7 @@ namespace service_nodes
         continue;
 
       cryptonote::tx_extra_service_node_state_change state_change;
-      if (!get_service_node_state_change_from_tx_extra(tx.extra, state_change, hard_fork_version))
+      if (!get_service_node_state_change_from_tx_extra(tx, state_change, hard_fork_version))
       {
         LOG_ERROR("Could not get state change from tx, possibly corrupt tx");
         continue;
@@ -0,0 +1,301 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <boost/endian/conversion.hpp>
+#include <sqlite3.h>
+
+#include "blockchain_db/blockchain_db.h"
+#include "checkpoints/checkpoints.h"
+#include "common/hex.h"
+#include "common/string_util.h"
+#include "common/threadpool.h"
+#include "service_node_rules.h"
+
+extern "C" {
+#include "crypto/keccak.h"
+}
+
+#undef OXEN_DEFAULT_LOG_CATEGORY
+#define OXEN_DEFAULT_LOG_CATEGORY "snapshot"
+
+namespace cryptonote::snapshot
+{
+
+namespace
+{
+
+// The same as cn_fast_hash() over the whole chunk, but read a piece at a time so that hashing a
+// chunk on each threadpool thread doesn't need a CHUNK_SIZE buffer per thread.
+crypto::hash hash_chunk(const fs::path& path, uint64_t offset, uint64_t size)
+{
+  constexpr size_t READ_SIZE = 1024 * 1024;
+
+  fs::ifstream in{path, std::ios::binary};
+  if (!in || !in.seekg(offset))
+    throw std::runtime_error{"Failed to open " + path.u8string()};
+
+  KECCAK_CTX ctx;
+  keccak_init(&ctx);
+  std::vector<char> buf(std::min<uint64_t>(size, READ_SIZE));
+  for (uint64_t left = size; left > 0;)
+  {
+    size_t n = std::min<uint64_t>(left, buf.size());
+    if (!in.read(buf.data(), n))
+      throw std::runtime_error{"Failed to read " + path.u8string()};
+    keccak_update(&ctx, reinterpret_cast<const uint8_t*>(buf.data()), n);
+    left -= n;
+  }
+  crypto::hash hash;
+  keccak_finish(&ctx, reinterpret_cast<uint8_t*>(hash.data));
+  return hash;
+}
+
+// Hashes every chunk in `chunks` (each task storing into `hashes` at the chunk's index), rethrowing
+// the first failure once they have all finished.
+void hash_all(const fs::path& dir, const std::vector<chunk>& chunks, std::vector<crypto::hash>& hashes)
+{
+  hashes.resize(chunks.size());
+  std::vector<std::string> errors(chunks.size());
+
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter;
+  for (size_t i = 0; i < chunks.size(); ++i)
+  {
+    tpool.submit(&waiter, [&, i] {
+      try { hashes[i] = hash_chunk(dir / fs::u8path(chunks[i].file), chunks[i].offset, chunks[i].size); }
+      catch (const std::exception& e) { errors[i] = e.what(); }
+    }, true);
+  }
+  waiter.wait(&tpool);
+
+  for (auto& e : errors)
+    if (!e.empty())
+      throw std::runtime_error{e};
+}
+
+bool safe_relative_path(std::string_view file)
+{
+  if (file.empty() || file.front() == '/' || file.find('\\') != std::string_view::npos)
+    return false;
+  for (auto part : tools::split(file, "/"))
+    if (part.empty() || part == "." || part == "..")
+      return false;
+  return true;
+}
+
+}
+
+std::vector<chunk> hash_chunks(const fs::path& dir, const std::vector<std::string>& files)
+{
+  std::vector<chunk> chunks;
+  for (const auto& file : files)
+  {
+    uint64_t size = fs::file_size(dir / fs::u8path(file));
+    for (uint64_t offset = 0; offset < size || (offset == 0 && size == 0); offset += CHUNK_SIZE)
+      chunks.push_back({file, offset, std::min(CHUNK_SIZE, size - offset), crypto::null_hash});
+  }
+
+  std::vector<crypto::hash> hashes;
+  hash_all(dir, chunks, hashes);
+  for (size_t i = 0; i < chunks.size(); ++i)
+    chunks[i].hash = hashes[i];
+  return chunks;
+}
+
+void copy_sqlite(sqlite3* db, const fs::path& file)
+{
+  if (fs::exists(file))
+    throw std::runtime_error{"Refusing to overwrite " + file.u8string()};
+
+  sqlite3* dest = nullptr;
+  int result = sqlite3_open_v2(file.u8string().c_str(), &dest, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
+  if (result == SQLITE_OK)
+  {
+    if (sqlite3_backup* backup = sqlite3_backup_init(dest, "main", db, "main"))
+    {
+      sqlite3_backup_step(backup, -1);
+      result = sqlite3_backup_finish(backup);
+    }
+    else
+      result = sqlite3_errcode(dest);
+  }
+  std::string error = dest ? sqlite3_errmsg(dest) : "out of memory";
+  sqlite3_close_v2(dest);
+  if (result != SQLITE_OK)
+    throw std::runtime_error{"Failed to copy the sqlite database to " + file.u8string() + ": " + error};
+}
+
+void write_manifest(const fs::path& dir, const manifest& m)
+{
+  fs::ofstream out{dir / fs::u8path(MANIFEST_FILENAME), std::ios::trunc};
+  out << "nettype " << network_type_str(m.nettype) << '\n'
+      << "height " << m.height << '\n'
+      << "top_hash " << tools::type_to_hex(m.top_hash) << '\n'
+      << "ons_height " << m.ons_height << '\n';
+  for (const auto& c : m.chunks)
+    out << "chunk " << c.file << ' ' << c.offset << ' ' << c.size << ' ' << tools::type_to_hex(c.hash) << '\n';
+  if (!out.flush())
+    throw std::runtime_error{"Failed to write " + (dir / fs::u8path(MANIFEST_FILENAME)).u8string()};
+}
+
+manifest read_manifest(const fs::path& dir)
+{
+  const auto path = dir / fs::u8path(MANIFEST_FILENAME);
+  fs::ifstream in{path};
+  if (!in)
+    throw std::runtime_error{"Failed to open " + path.u8string()};
+
+  manifest m;
+  bool have_nettype = false, have_height = false, have_top_hash = false;
+  std::string line;
+  for (size_t lineno = 1; std::getline(in, line); ++lineno)
+  {
+    auto parts = tools::split(line, " ", true);
+    if (parts.empty())
+      continue;
+
+    bool good = false;
+    if (parts[0] == "nettype" && parts.size() == 2)
+    {
+      for (auto type : {MAINNET, TESTNET, DEVNET, FAKECHAIN})
+      {
+        if (parts[1] == network_type_str(type))
+        {
+          m.nettype = type;
+          good = have_nettype = true;
+        }
+      }
+    }
+    else if (parts[0] == "height" && parts.size() == 2)
+      good = have_height = tools::parse_int(parts[1], m.height);
+    else if (parts[0] == "top_hash" && parts.size() == 2)
+      good = have_top_hash = tools::hex_to_type(parts[1], m.top_hash);
+    else if (parts[0] == "ons_height" && parts.size() == 2)
+      good = tools::parse_int(parts[1], m.ons_height);
+    else if (parts[0] == "chunk" && parts.size() == 5)
+    {
+      auto& c = m.chunks.emplace_back();
+      c.file = parts[1];
+      good = safe_relative_path(c.file) && c.file != MANIFEST_FILENAME &&
+        tools::parse_int(parts[2], c.offset) && tools::parse_int(parts[3], c.size) &&
+        c.size <= CHUNK_SIZE && tools::hex_to_type(parts[4], c.hash);
+    }
+
+    if (!good)
+      throw std::runtime_error{path.u8string() + ":" + std::to_string(lineno) + ": invalid line"};
+  }
+
+  if (!have_nettype || !have_height || !have_top_hash || m.chunks.empty())
+    throw std::runtime_error{path.u8string() + " is incomplete"};
+  return m;
+}
+
+std::vector<std::string> verify_chunks(const fs::path& dir, const manifest& m)
+{
+  std::vector<std::string> bad;
+
+  // Every file must be exactly covered by its chunks, in order, so that a truncated or extended
+  // file can't pass.
+  std::vector<std::pair<std::string, uint64_t>> sizes;
+  for (const auto& c : m.chunks)
+  {
+    auto it = std::find_if(sizes.begin(), sizes.end(), [&](const auto& s) { return s.first == c.file; });
+    if (it == sizes.end())
+      it = sizes.emplace(sizes.end(), c.file, 0);
+    if (c.offset != it->second)
+      bad.push_back(c.file + ": chunk at " + std::to_string(c.offset) + " is out of order");
+    it->second = c.offset + c.size;
+  }
+  for (const auto& [file, size] : sizes)
+  {
+    std::error_code ec;
+    auto actual = fs::file_size(dir / fs::u8path(file), ec);
+    if (ec)
+      bad.push_back(file + ": missing");
+    else if (actual != size)
+      bad.push_back(file + ": size is " + std::to_string(actual) + ", expected " + std::to_string(size));
+  }
+  if (!bad.empty())
+    return bad;
+
+  std::vector<crypto::hash> hashes;
+  hash_all(dir, m.chunks, hashes);
+  for (size_t i = 0; i < m.chunks.size(); ++i)
+    if (hashes[i] != m.chunks[i].hash)
+      bad.push_back(m.chunks[i].file + ": chunk at " + std::to_string(m.chunks[i].offset) + " doesn't match");
+  return bad;
+}
+
+uint64_t check_hash_of_hashes(const BlockchainDB& db, std::string_view blocks_dat, std::string& error)
+{
+  if (blocks_dat.size() < 4)
+    return 0;
+
+  uint32_t nblocks;
+  std::memcpy(&nblocks, blocks_dat.data(), 4);
+  boost::endian::little_to_native_inplace(nblocks);
+  blocks_dat.remove_prefix(4);
+  if (blocks_dat.size() != uint64_t{nblocks} * sizeof(crypto::hash))
+  {
+    error = "compiled-in block hash data has an unexpected size";
+    return 0;
+  }
+
+  const uint64_t groups = std::min<uint64_t>(nblocks, db.height() / HASH_OF_HASHES_STEP);
+  for (uint64_t n = 0; n < groups; ++n)
+  {
+    auto hashes = db.get_hashes_range(n * HASH_OF_HASHES_STEP, n * HASH_OF_HASHES_STEP + HASH_OF_HASHES_STEP - 1);
+    crypto::hash expected, hash;
+    std::memcpy(expected.data, blocks_dat.data() + n * sizeof(crypto::hash), sizeof(crypto::hash));
+    crypto::cn_fast_hash(hashes.data(), hashes.size() * sizeof(crypto::hash), hash);
+    if (hash != expected)
+    {
+      error = "blocks " + std::to_string(n * HASH_OF_HASHES_STEP) + " - " + std::to_string(n * HASH_OF_HASHES_STEP + HASH_OF_HASHES_STEP - 1) +
+        " don't match the compiled-in block hashes";
+      return 0;
+    }
+  }
+  return groups * HASH_OF_HASHES_STEP;
+}
+
+uint64_t check_checkpoints(const BlockchainDB& db, network_type nettype, std::string& error)
+{
+  const uint64_t height = db.height();
+  uint64_t checked = 0;
+
+  for (const auto& cp : get_hardcoded_checkpoints(nettype))
+  {
+    if (cp.height >= height)
+      continue;
+    crypto::hash expected;
+    if (!tools::hex_to_type(cp.hash, expected) || db.get_block_hash_from_height(cp.height) != expected)
+    {
+      error = "block " + std::to_string(cp.height) + " doesn't match its hardcoded checkpoint";
+      return 0;
+    }
+    ++checked;
+  }
+
+  if (height == 0)
+    return checked;
+  for (const auto& cp : db.get_checkpoints_range(0, height - 1))
+  {
+    if (cp.height >= height || db.get_block_hash_from_height(cp.height) != cp.block_hash)
+    {
+      error = "block " + std::to_string(cp.height) + " doesn't match its stored checkpoint";
+      return 0;
+    }
+    if (cp.type == checkpoint_type::service_node && cp.signatures.size() < service_nodes::CHECKPOINT_MIN_VOTES)
+    {
+      error = "the stored checkpoint for block " + std::to_string(cp.height) + " doesn't have enough votes";
+      return 0;
+    }
+    ++checked;
+  }
+  return checked;
+}
+
+}
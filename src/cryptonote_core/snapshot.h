@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common/fs.h"
+#include "crypto/hash.h"
+#include "cryptonote_config.h"
+
+struct sqlite3;
+
+namespace cryptonote
+{
+class BlockchainDB;
+}
+
+namespace cryptonote::snapshot
+{
+
+// A snapshot (core::create_snapshot()) is a directory laid out like the data directory: a compacted
+// copy of the LMDB environment (which includes the service node list state) in lmdb/data.mdb, a
+// copy of the ONS database in ons.db, and a manifest.txt describing them: the chain height and top
+// block hash of the copy, and the cn_fast_hash of each CHUNK_SIZE piece of every file, so that a
+// receiver can check chunks as they arrive (and re-fetch only the bad ones) before restoring it
+// with --restore-snapshot.
+
+constexpr std::string_view MANIFEST_FILENAME = "manifest.txt";
+constexpr std::string_view ONS_FILENAME = "ons.db";
+constexpr uint64_t CHUNK_SIZE = 64 * 1024 * 1024;
+
+struct chunk
+{
+  std::string file; // relative to the snapshot directory
+  uint64_t offset;
+  uint64_t size;
+  crypto::hash hash;
+};
+
+struct manifest
+{
+  network_type nettype = UNDEFINED;
+  uint64_t height = 0; // the number of blocks in the snapshot
+  crypto::hash top_hash = crypto::null_hash;
+  uint64_t ons_height = 0;
+  std::vector<chunk> chunks;
+};
+
+// Hashes every file (given relative to `dir`) in CHUNK_SIZE chunks, in parallel on the threadpool.
+// Throws on an I/O error.
+std::vector<chunk> hash_chunks(const fs::path& dir, const std::vector<std::string>& files);
+
+// Copies the open sqlite database `db` into `file`, which must not already exist, with sqlite's online
+// backup API.  The caller must keep `db` from being written meanwhile.  Throws on failure.
+void copy_sqlite(sqlite3* db, const fs::path& file);
+
+// Writes or reads `dir`/manifest.txt.  Both throw on an I/O error; read_manifest() also throws if the
+// file is malformed, or names a file outside of `dir`.
+void write_manifest(const fs::path& dir, const manifest& m);
+manifest read_manifest(const fs::path& dir);
+
+// Re-hashes the chunks in `m`, returning a description of each one that is missing or doesn't match.
+std::vector<std::string> verify_chunks(const fs::path& dir, const manifest& m);
+
+// Checks the block hashes in `db` against the hash-of-hashes data compiled into the daemon
+// (blocks.dat, as given by blocks::GetCheckpointsData()), for every full HASH_OF_HASHES_STEP group of
+// blocks in both.  Returns the number of blocks checked, or sets `error` and returns 0 on a mismatch.
+uint64_t check_hash_of_hashes(const BlockchainDB& db, std::string_view blocks_dat, std::string& error);
+
+// Checks the block hashes in `db` against the hardcoded checkpoints of `nettype`, and against every
+// checkpoint stored in `db` itself (which also need enough votes, for service node checkpoints).
+// Returns the number of checkpoints checked, or sets `error` and returns 0 on a mismatch.
+uint64_t check_checkpoints(const BlockchainDB& db, network_type nettype, std::string& error);
+
+}
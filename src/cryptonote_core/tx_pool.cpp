@@ -30,6 +30,8 @@
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
 #include <algorithm>
+#include <iterator>
+#include <limits>
 #include <unordered_set>
 #include <vector>
 
@@ -69,6 +71,7 @@ namespace cryptonote
     time_t const MIN_RELAY_TIME = (60 * 5); // only start re-relaying transactions after that many seconds
     time_t const MAX_RELAY_TIME = (60 * 60 * 4); // at most that many seconds between resends
     float const ACCEPT_THRESHOLD = 1.0f;
+    size_t const MAX_POOL_CHANGES = 10000; // changes get_pool_changes() can go back over; a full pool takes minutes to churn through that many
 
     // a kind of increasing backoff within min/max bounds
     uint64_t get_relay_delay(time_t now, time_t received)
@@ -90,9 +93,33 @@ namespace cryptonote
   }
   //---------------------------------------------------------------------------------
   // warning: bchs is passed here uninitialized, so don't do anything but store it
-  tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_blockchain(bchs), m_txpool_max_weight(DEFAULT_TXPOOL_MAX_WEIGHT), m_txpool_weight(0), m_cookie(0)
+  tx_memory_pool::tx_memory_pool(Blockchain& bchs): m_blockchain(bchs), m_txpool_max_weight(DEFAULT_TXPOOL_MAX_WEIGHT), m_txpool_weight(0), m_cookie(0), m_pool_id(crypto::rand<uint64_t>() | 1)
   {
-
+    m_cache_budget = tools::cache_budget::add("txpool_parsed", tools::cache_budget::priority::txpool_parsed, [this](size_t) {
+      // Both are cheap to rebuild, and only last until the next block anyway
+      std::unique_lock lock{m_transactions_lock};
+      clear_caches();
+    });
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::cache_parsed_tx(const crypto::hash &id, const transaction &tx, size_t blob_size)
+  {
+    if (m_parsed_tx_cache.emplace(id, tx).second)
+      m_parsed_tx_cache_bytes += blob_size + tools::cache_budget::node_bytes<decltype(m_parsed_tx_cache)>;
+    update_cache_size();
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::clear_caches()
+  {
+    m_input_cache.clear();
+    m_parsed_tx_cache.clear();
+    m_parsed_tx_cache_bytes = 0;
+    update_cache_size();
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::update_cache_size() const
+  {
+    m_cache_budget.set_size(m_parsed_tx_cache_bytes + m_input_cache.size() * tools::cache_budget::node_bytes<decltype(m_input_cache)>);
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::have_duplicated_non_standard_tx(transaction const &tx, uint8_t hard_fork_version) const
@@ -101,7 +128,7 @@ namespace cryptonote
     if (tx.type == txtype::state_change)
     {
       tx_extra_service_node_state_change state_change;
-      if (!get_service_node_state_change_from_tx_extra(tx.extra, state_change, hard_fork_version))
+      if (!get_service_node_state_change_from_tx_extra(tx, state_change, hard_fork_version))
       {
         MERROR("Could not get service node state change from tx: " << get_transaction_hash(tx) << ", possibly corrupt tx in your blockchain, rejecting malformed state change");
         return false;
@@ -158,7 +185,7 @@ namespace cryptonote
     else if (tx.type == txtype::key_image_unlock)
     {
       tx_extra_tx_key_image_unlock unlock;
-      if (!cryptonote::get_field_from_tx_extra(tx.extra, unlock))
+      if (!cryptonote::get_field_from_tx_extra(tx, unlock))
       {
         MERROR("Could not get key image unlock from tx: " << get_transaction_hash(tx) << ", tx to add is possibly invalid, rejecting");
         return true;
@@ -189,7 +216,7 @@ namespace cryptonote
     else if (tx.type == txtype::oxen_name_system)
     {
       tx_extra_oxen_name_system data;
-      if (!cryptonote::get_field_from_tx_extra(tx.extra, data))
+      if (!cryptonote::get_field_from_tx_extra(tx, data))
       {
         MERROR("Could not get acquire name service from tx: " << get_transaction_hash(tx) << ", tx to add is possibly invalid, rejecting");
         return true;
@@ -388,7 +415,7 @@ namespace cryptonote
         memset(meta.padding, 0, sizeof(meta.padding));
         try
         {
-          m_parsed_tx_cache.insert(std::make_pair(id, tx));
+          cache_parsed_tx(id, tx, blob.size());
           std::unique_lock b_lock{m_blockchain};
           LockedTXN lock(m_blockchain);
           m_blockchain.add_txpool_tx(id, blob, meta);
@@ -433,7 +460,7 @@ namespace cryptonote
       try
       {
         if (opts.kept_by_block)
-          m_parsed_tx_cache.insert(std::make_pair(id, tx));
+          cache_parsed_tx(id, tx, blob.size());
         std::unique_lock b_lock{m_blockchain};
         LockedTXN lock(m_blockchain);
         m_blockchain.remove_txpool_tx(id);
@@ -458,6 +485,7 @@ namespace cryptonote
     m_txpool_weight += tx_weight;
 
     ++m_cookie;
+    log_change(id, opts.do_not_relay);
 
     MINFO("Transaction added to pool: txid " << id << " weight: " << tx_weight << " fee/byte: " << (fee / (double)(tx_weight ? tx_weight : 1)));
 
@@ -503,6 +531,9 @@ namespace cryptonote
     {
       auto lock = blink_unique_lock();
       m_blinks[txhash] = blink_ptr;
+      // Unresolved rather than the mempool: it could get mined before we got the lock
+      set_blink_height(txhash, std::nullopt);
+      log_change(txhash, false);
     }
     else if (!result)
     {
@@ -522,6 +553,8 @@ namespace cryptonote
       return false;
 
     ptr = blink_ptr;
+    set_blink_height(blink_ptr->get_txhash(), std::nullopt);
+    log_change(blink_ptr->get_txhash(), false);
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -547,71 +580,88 @@ namespace cryptonote
         tx_hashes.end());
   }
 
-  std::pair<std::vector<crypto::hash>, std::vector<uint64_t>> tx_memory_pool::get_blink_hashes_and_mined_heights() const
+  void tx_memory_pool::set_blink_height(const crypto::hash &txhash, std::optional<uint64_t> height) const
   {
-    std::pair<std::vector<crypto::hash>, std::vector<uint64_t>> hnh;
-    auto &hashes = hnh.first;
-    auto &heights = hnh.second;
+    auto [it, inserted] = m_blink_heights.emplace(txhash, 0);
+    if (!inserted)
     {
-      auto lock = blink_shared_lock();
-      if (!m_blinks.empty())
+      if (m_blinks_unresolved.count(txhash))
       {
-        hashes.reserve(m_blinks.size());
-        for (auto &b : m_blinks)
-          hashes.push_back(b.first);
+        if (!height)
+          return;
       }
-    }
-
-    heights = m_blockchain.get_transactions_heights(hashes);
-
-    // Filter out (and delete from the blink pool) any blinks that are in immutable blocks
-    const uint64_t immutable_height = m_blockchain.get_immutable_height();
-    size_t next_good = 0;
-    for (size_t i = 0; i < hashes.size(); i++)
-    {
-      if (heights[i] > immutable_height || heights[i] == 0 /* unmined mempool blink */)
+      else if (height && *height == it->second)
+        return;
+      else
       {
-        // Swap elements into the "good" part of the list so that when we're we'll have divided the
-        // vector into [0, ..., next_good-1] elements containing the parts we want to return, and
-        // [next_good, ...] containing the elements to remove from blink storage.
-        if (i != next_good)
+        auto sum = m_blink_sums.find(it->second);
+        if (sum != m_blink_sums.end())
         {
-          using std::swap;
-          swap(heights[i], heights[next_good]);
-          swap(hashes[i], hashes[next_good]);
+          sum->second.checksum ^= txhash;
+          sum->second.txs.erase(txhash);
+          if (sum->second.txs.empty())
+            m_blink_sums.erase(sum);
         }
-        next_good++;
       }
     }
 
-    if (next_good < hashes.size())
+    if (!height)
     {
-      auto lock = blink_unique_lock();
-      for (size_t i = next_good; i < hashes.size(); i++)
-        m_blinks.erase(hashes[i]);
+      m_blinks_unresolved.insert(txhash);
+      return;
     }
-    hashes.resize(next_good);
-    heights.resize(next_good);
-
-    return hnh;
+    m_blinks_unresolved.erase(txhash);
+    it->second = *height;
+    auto &sum = m_blink_sums[*height];
+    sum.checksum ^= txhash;
+    sum.txs.insert(txhash);
   }
 
-  std::map<uint64_t, crypto::hash> tx_memory_pool::get_blink_checksums() const
+  std::shared_lock<std::shared_mutex> tx_memory_pool::update_blink_heights() const
   {
-    std::map<uint64_t, crypto::hash> result;
+    // Holding the blockchain lock throughout means no block gets added or popped (moving blinks
+    // around) between looking up heights and recording them.  (Blockchain takes the blink lock
+    // while holding its own, so we have to take them in the same order).
+    std::unique_lock bc_lock{m_blockchain};
+    const uint64_t immutable_height = m_blockchain.get_immutable_height();
 
-    auto hnh = get_blink_hashes_and_mined_heights();
-    auto &hashes = hnh.first;
-    auto &heights = hnh.second;
+    std::vector<crypto::hash> unresolved;
+    {
+      auto lock = blink_shared_lock();
+      bool need_pruning = m_blink_sums.lower_bound(1) != m_blink_sums.end() &&
+        m_blink_sums.lower_bound(1)->first <= immutable_height;
+      if (m_blinks_unresolved.empty() && !need_pruning)
+        return lock;
+      unresolved.assign(m_blinks_unresolved.begin(), m_blinks_unresolved.end());
+    }
+    auto heights = m_blockchain.get_transactions_heights(unresolved);
 
-    for (size_t i = 0; i < hashes.size(); i++)
     {
-      auto it = result.lower_bound(heights[i]);
-      if (it == result.end() || it->first != heights[i])
-        result.emplace_hint(it, heights[i], hashes[i]);
-      else
-        it->second ^= hashes[i];
+      auto lock = blink_unique_lock();
+      for (size_t i = 0; i < unresolved.size(); i++)
+        if (m_blinks_unresolved.count(unresolved[i]))
+          set_blink_height(unresolved[i], heights[i]);
+
+      // Delete from the blink pool any blinks that are in immutable blocks
+      auto end = m_blink_sums.upper_bound(immutable_height);
+      for (auto it = m_blink_sums.lower_bound(1); it != end; it = m_blink_sums.erase(it))
+      {
+        for (auto &txhash : it->second.txs)
+        {
+          m_blinks.erase(txhash);
+          m_blink_heights.erase(txhash);
+        }
+      }
     }
+    return blink_shared_lock();
+  }
+
+  std::map<uint64_t, crypto::hash> tx_memory_pool::get_blink_checksums() const
+  {
+    std::map<uint64_t, crypto::hash> result;
+    auto lock = update_blink_heights();
+    for (auto &[height, sum] : m_blink_sums)
+      result.emplace_hint(result.end(), height, sum.checksum);
     return result;
   }
 
@@ -619,14 +669,12 @@ namespace cryptonote
   std::vector<crypto::hash> tx_memory_pool::get_mined_blinks(const std::set<uint64_t> &want_heights) const
   {
     std::vector<crypto::hash> result;
-
-    auto hnh = get_blink_hashes_and_mined_heights();
-    auto &hashes = hnh.first;
-    auto &heights = hnh.second;
-    for (size_t i = 0; i < heights.size(); i++)
+    auto lock = update_blink_heights();
+    for (auto height : want_heights)
     {
-      if (want_heights.count(heights[i]))
-        result.push_back(hashes[i]);
+      auto it = m_blink_sums.find(height);
+      if (it != m_blink_sums.end())
+        result.insert(result.end(), it->second.txs.begin(), it->second.txs.end());
     }
     return result;
   }
@@ -722,8 +770,8 @@ namespace cryptonote
     }
 
     cryptonote::blobdata tx_blob = m_blockchain.get_txpool_tx_blob(txid);
-    cryptonote::transaction_prefix tx;
-    if (!parse_and_validate_tx_prefix_from_blob(tx_blob, tx))
+    std::optional<transaction_view> tx;
+    if (!parse_tx_view_from_blob(tx_blob, tx))
     {
       MERROR("Failed to parse tx from txpool");
       return false;
@@ -746,8 +794,9 @@ namespace cryptonote
     MINFO("Removing tx " << txid << " from txpool: weight: " << meta->weight << ", fee/byte: " << tx_fee);
     m_blockchain.remove_txpool_tx(txid);
     m_txpool_weight -= meta->weight;
-    remove_transaction_keyimages(tx, txid);
+    remove_transaction_keyimages(*tx, txid);
     m_txs_by_fee_and_receive_time.erase(it);
+    log_change(txid, meta->do_not_relay);
 
     return true;
   }
@@ -824,14 +873,44 @@ namespace cryptonote
       MINFO("Pool weight after pruning is still larger than limit: " << m_txpool_weight << "/" << m_txpool_max_weight);
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::insert_key_images(const transaction_prefix &tx, const crypto::hash &id, bool kept_by_block)
+  // Gets the key images of a tx's inputs, failing if any input isn't a txin_to_key
+  static bool get_key_images(const transaction_prefix &tx, std::vector<crypto::key_image> &key_images)
   {
+    key_images.reserve(tx.vin.size());
     for(const auto& in: tx.vin)
     {
       CHECKED_GET_SPECIFIC_VARIANT(in, txin_to_key, txin, false);
-      std::unordered_set<crypto::hash>& kei_image_set = m_spent_key_images[txin.k_image];
+      key_images.push_back(txin.k_image);
+    }
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  static bool get_key_images(const transaction_view &view, const std::vector<crypto::key_image> *&key_images)
+  {
+    CHECK_AND_ASSERT_MES(view.only_key_inputs(), false, "wrong variant type: expected txin_to_key for all " << view.vin_count << " inputs");
+    key_images = &view.key_images;
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::insert_key_images(const transaction_prefix &tx, const crypto::hash &id, bool kept_by_block)
+  {
+    std::vector<crypto::key_image> key_images;
+    return get_key_images(tx, key_images) && insert_key_images(key_images, id, kept_by_block);
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::insert_key_images(const transaction_view &view, const crypto::hash &id, bool kept_by_block)
+  {
+    const std::vector<crypto::key_image> *key_images;
+    return get_key_images(view, key_images) && insert_key_images(*key_images, id, kept_by_block);
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::insert_key_images(const std::vector<crypto::key_image> &key_images, const crypto::hash &id, bool kept_by_block)
+  {
+    for(const auto& k_image: key_images)
+    {
+      std::unordered_set<crypto::hash>& kei_image_set = m_spent_key_images[k_image];
       CHECK_AND_ASSERT_MES(kept_by_block || kei_image_set.size() == 0, false, "internal error: kept_by_block=" << kept_by_block
-                                          << ",  kei_image_set.size()=" << kei_image_set.size() << "\ntxin.k_image=" << txin.k_image
+                                          << ",  kei_image_set.size()=" << kei_image_set.size() << "\ntxin.k_image=" << k_image
                                           << "\ntx_id=" << id );
       auto ins_res = kei_image_set.insert(id);
       CHECK_AND_ASSERT_MES(ins_res.second, false, "internal error: try to insert duplicate iterator in key_image set");
@@ -844,22 +923,33 @@ namespace cryptonote
   //       At the least, need to make sure that a false return here
   //       is treated properly.  Should probably not return early, however.
   bool tx_memory_pool::remove_transaction_keyimages(const transaction_prefix& tx, const crypto::hash &actual_hash)
+  {
+    std::vector<crypto::key_image> key_images;
+    return get_key_images(tx, key_images) && remove_transaction_keyimages(key_images, actual_hash);
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::remove_transaction_keyimages(const transaction_view& view, const crypto::hash &actual_hash)
+  {
+    const std::vector<crypto::key_image> *key_images;
+    return get_key_images(view, key_images) && remove_transaction_keyimages(*key_images, actual_hash);
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::remove_transaction_keyimages(const std::vector<crypto::key_image>& key_images, const crypto::hash &actual_hash)
   {
     auto locks = tools::unique_locks(m_transactions_lock, m_blockchain);
 
     // ND: Speedup
-    for(const txin_v& vi: tx.vin)
+    for(const auto& k_image: key_images)
     {
-      CHECKED_GET_SPECIFIC_VARIANT(vi, txin_to_key, txin, false);
-      auto it = m_spent_key_images.find(txin.k_image);
-      CHECK_AND_ASSERT_MES(it != m_spent_key_images.end(), false, "failed to find transaction input in key images. img=" << txin.k_image
+      auto it = m_spent_key_images.find(k_image);
+      CHECK_AND_ASSERT_MES(it != m_spent_key_images.end(), false, "failed to find transaction input in key images. img=" << k_image
                                     << "\ntransaction id = " << actual_hash);
       std::unordered_set<crypto::hash>& key_image_set =  it->second;
-      CHECK_AND_ASSERT_MES(key_image_set.size(), false, "empty key_image set, img=" << txin.k_image
+      CHECK_AND_ASSERT_MES(key_image_set.size(), false, "empty key_image set, img=" << k_image
         << "\ntransaction id = " << actual_hash);
 
       auto it_in_set = key_image_set.find(actual_hash);
-      CHECK_AND_ASSERT_MES(it_in_set != key_image_set.end(), false, "transaction id not found in key_image set, img=" << txin.k_image
+      CHECK_AND_ASSERT_MES(it_in_set != key_image_set.end(), false, "transaction id not found in key_image set, img=" << k_image
         << "\ntransaction id = " << actual_hash);
       key_image_set.erase(it_in_set);
       if(!key_image_set.size())
@@ -869,6 +959,8 @@ namespace cryptonote
       }
 
     }
+    m_ready_txs.erase(actual_hash);
+    m_not_ready_txs.erase(actual_hash);
     ++m_cookie;
     return true;
   }
@@ -889,12 +981,15 @@ namespace cryptonote
         return false;
       }
       txblob = m_blockchain.get_txpool_tx_blob(id);
+      // Parsing with the hash, while we have the blob, also caches the prunable hash that the db
+      // needs when this tx goes into a block.
       auto ci = m_parsed_tx_cache.find(id);
+      crypto::hash parsed_id;
       if (ci != m_parsed_tx_cache.end())
       {
         tx = ci->second;
       }
-      else if (!parse_and_validate_tx_from_blob(txblob, tx))
+      else if (!parse_and_validate_tx_from_blob(txblob, tx, parsed_id))
       {
         MERROR("Failed to parse tx from txpool");
         return false;
@@ -924,6 +1019,7 @@ namespace cryptonote
     if (sorted_it != m_txs_by_fee_and_receive_time.end())
       m_txs_by_fee_and_receive_time.erase(sorted_it);
     ++m_cookie;
+    log_change(id, do_not_relay);
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -953,7 +1049,7 @@ namespace cryptonote
   {
     auto locks = tools::unique_locks(m_transactions_lock, m_blockchain);
 
-    std::list<std::pair<crypto::hash, uint64_t>> remove;
+    std::list<std::tuple<crypto::hash, uint64_t, bool>> remove;
     m_blockchain.for_all_txpool_txes([this, &remove](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata*) {
       uint64_t tx_age = time(nullptr) - meta.receive_time;
 
@@ -971,7 +1067,7 @@ namespace cryptonote
           m_txs_by_fee_and_receive_time.erase(sorted_it);
         }
         m_timed_out_transactions.insert(txid);
-        remove.push_back(std::make_pair(txid, meta.weight));
+        remove.emplace_back(txid, meta.weight, meta.do_not_relay);
       }
       return true;
     }, false);
@@ -979,14 +1075,13 @@ namespace cryptonote
     if (!remove.empty())
     {
       LockedTXN lock(m_blockchain);
-      for (const std::pair<crypto::hash, uint64_t> &entry: remove)
+      for (const auto &[txid, weight, do_not_relay]: remove)
       {
-        const crypto::hash &txid = entry.first;
         try
         {
           cryptonote::blobdata bd = m_blockchain.get_txpool_tx_blob(txid);
-          cryptonote::transaction_prefix tx;
-          if (!parse_and_validate_tx_prefix_from_blob(bd, tx))
+          std::optional<transaction_view> tx;
+          if (!parse_tx_view_from_blob(bd, tx))
           {
             MERROR("Failed to parse tx from txpool");
             // continue
@@ -995,8 +1090,9 @@ namespace cryptonote
           {
             // remove first, so we only remove key images if the tx removal succeeds
             m_blockchain.remove_txpool_tx(txid);
-            m_txpool_weight -= entry.second;
-            remove_transaction_keyimages(tx, txid);
+            m_txpool_weight -= weight;
+            remove_transaction_keyimages(*tx, txid);
+            log_change(txid, do_not_relay);
           }
         }
         catch (const std::exception &e)
@@ -1078,6 +1174,7 @@ namespace cryptonote
         {
           meta.do_not_relay = false;
           m_blockchain.update_txpool_tx(tx, meta);
+          log_change(tx, false);
           ++updated;
         }
       } catch (const std::exception &e) {
@@ -1154,74 +1251,107 @@ namespace cryptonote
     }, false, include_unrelayed_txes);
   }
   //------------------------------------------------------------------
-  void tx_memory_pool::get_transaction_backlog(std::vector<rpc::tx_backlog_entry>& backlog, bool include_unrelayed_txes) const
+  void tx_memory_pool::log_change(const crypto::hash &txid, bool do_not_relay)
   {
-    auto locks = tools::unique_locks(m_transactions_lock, m_blockchain);
+    std::lock_guard lock{m_changes_mutex};
+    m_changes.emplace_back(txid, do_not_relay);
+    if (m_changes.size() > MAX_POOL_CHANGES)
+    {
+      m_changes.pop_front();
+      ++m_changes_begin;
+    }
+  }
+  //------------------------------------------------------------------
+  tx_memory_pool::pool_changes tx_memory_pool::get_pool_changes(uint64_t pool_id, uint64_t since, bool include_unrelayed_txes) const
+  {
+    auto blink_lock = blink_shared_lock(std::defer_lock);
+    std::unique_lock tx_lock{*this, std::defer_lock};
+    std::unique_lock bc_lock{m_blockchain, std::defer_lock};
+    std::lock(blink_lock, tx_lock, bc_lock);
+
+    pool_changes changes{};
+    changes.pool_id = m_pool_id;
+    // Anything that changes from here on is logged past seq, and so is in the next changes too
+    std::unordered_set<crypto::hash> changed;
+    {
+      std::lock_guard lock{m_changes_mutex};
+      changes.seq = m_changes_begin + m_changes.size();
+      changes.full = pool_id != m_pool_id || since < m_changes_begin || since > changes.seq;
+      if (!changes.full)
+        for (auto it = m_changes.begin() + (since - m_changes_begin); it != m_changes.end(); ++it)
+          if (include_unrelayed_txes || !it->second)
+            changed.insert(it->first);
+    }
+
+    if (changes.full)
+    {
+      m_blockchain.for_all_txpool_txes([&changes, this](const crypto::hash &txid, const txpool_tx_meta_t &, const cryptonote::blobdata *) {
+        (has_blink(txid) ? changes.blinks : changes.txs).push_back(txid);
+        return true;
+      }, false, include_unrelayed_txes);
+      return changes;
+    }
 
+    for (auto &txid : changed)
+    {
+      txpool_tx_meta_t meta;
+      if (!m_blockchain.get_txpool_tx_meta(txid, meta) || (meta.do_not_relay && !include_unrelayed_txes))
+        changes.removed.push_back(txid);
+      else
+        (has_blink(txid) ? changes.blinks : changes.txs).push_back(txid);
+    }
+    return changes;
+  }
+  //------------------------------------------------------------------
+  void tx_memory_pool::get_transaction_backlog(std::vector<rpc::tx_backlog_entry>& backlog, bool include_unrelayed_txes) const
+  {
     const uint64_t now = time(NULL);
-    backlog.reserve(m_blockchain.get_txpool_tx_count(include_unrelayed_txes));
-    m_blockchain.for_all_txpool_txes([&backlog, now](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
-      backlog.push_back({meta.weight, meta.fee, meta.receive_time - now});
-      return true;
-    }, false, include_unrelayed_txes);
+    m_blockchain.get_txpool_store().with_totals(include_unrelayed_txes, [&backlog, now](const txpool_store::totals& totals) {
+      backlog.reserve(totals.txs);
+      for (auto& [receive_time, weight, fee] : totals.by_receive_time)
+        backlog.push_back({weight, fee, receive_time - now});
+    });
   }
   //------------------------------------------------------------------
   void tx_memory_pool::get_transaction_stats(struct rpc::txpool_stats& stats, bool include_unrelayed_txes) const
   {
-    auto locks = tools::unique_locks(m_transactions_lock, m_blockchain);
-
     const uint64_t now = time(NULL);
-    std::map<uint64_t, rpc::txpool_histo> agebytes;
-    stats.txs_total = m_blockchain.get_txpool_tx_count(include_unrelayed_txes);
-    std::vector<uint32_t> weights;
-    weights.reserve(stats.txs_total);
-    m_blockchain.for_all_txpool_txes([&stats, &weights, now, &agebytes](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
-      weights.push_back(meta.weight);
-      stats.bytes_total += meta.weight;
-      if (!stats.bytes_min || meta.weight < stats.bytes_min)
-        stats.bytes_min = meta.weight;
-      if (meta.weight > stats.bytes_max)
-        stats.bytes_max = meta.weight;
-      if (!meta.relayed)
-        stats.num_not_relayed++;
-      stats.fee_total += meta.fee;
-      if (!stats.oldest || meta.receive_time < stats.oldest)
-        stats.oldest = meta.receive_time;
-      if (meta.receive_time < now - 600)
+    m_blockchain.get_txpool_store().with_totals(include_unrelayed_txes, [&stats, now](const txpool_store::totals& totals) {
+      stats.txs_total = totals.txs;
+      stats.bytes_total = totals.bytes;
+      stats.bytes_min = totals.min_weight();
+      stats.bytes_max = totals.max_weight();
+      stats.bytes_med = totals.median_weight();
+      stats.fee_total = totals.fees;
+      stats.num_not_relayed = totals.not_relayed;
+      stats.num_failing = totals.failing;
+      stats.num_double_spends = totals.double_spends;
+      if (totals.by_receive_time.empty())
+        return;
+      stats.oldest = std::get<0>(*totals.by_receive_time.begin());
+
+      auto age_of = [now](uint64_t receive_time) { return now - receive_time + (now == receive_time); };
+      for (auto it = totals.by_receive_time.begin(); it != totals.by_receive_time.end() && std::get<0>(*it) < now - 600; ++it)
         stats.num_10m++;
-      if (meta.last_failed_height)
-        stats.num_failing++;
-      uint64_t age = now - meta.receive_time + (now == meta.receive_time);
-      agebytes[age].txs++;
-      agebytes[age].bytes += meta.weight;
-      if (meta.double_spend_seen)
-        ++stats.num_double_spends;
-      return true;
-    }, false, include_unrelayed_txes);
-    stats.bytes_med = epee::misc_utils::median(weights);
-    if (stats.txs_total > 1)
-    {
+
+      if (stats.txs_total <= 1)
+        return;
+
       /* looking for 98th percentile */
       size_t end = stats.txs_total * 0.02;
       uint64_t delta, factor;
-      std::map<uint64_t, rpc::txpool_histo>::iterator it, i2;
+      uint64_t last_bin_age = std::numeric_limits<uint64_t>::max(); // txes this old or older go in the last bin
       if (end)
       {
         /* If enough txs, spread the first 98% of results across
          * the first 9 bins, drop final 2% in last bin.
          */
-        it = agebytes.end();
-        size_t cumulative_num = 0;
-        /* Since agebytes is not empty and end is nonzero, the
-         * below loop can always run at least once.
-         */
-        do {
-          --it;
-          cumulative_num += it->second.txs;
-        } while (it != agebytes.begin() && cumulative_num < end);
-        stats.histo_98pc = it->first;
+        auto it = totals.by_receive_time.begin();
+        std::advance(it, end - 1);
+        last_bin_age = age_of(std::get<0>(*it));
+        stats.histo_98pc = last_bin_age;
         factor = 9;
-        delta = it->first;
+        delta = last_bin_age;
         stats.histo.resize(10);
       } else
       {
@@ -1229,25 +1359,20 @@ namespace cryptonote
          * spread evenly across all 10 bins.
          */
         stats.histo_98pc = 0;
-        it = agebytes.end();
         factor = stats.txs_total > 9 ? 10 : stats.txs_total;
         delta = now - stats.oldest;
         stats.histo.resize(factor);
       }
       if (!delta)
         delta = 1;
-      for (i2 = agebytes.begin(); i2 != it; i2++)
-      {
-        size_t i = (i2->first * factor - 1) / delta;
-        stats.histo[i].txs += i2->second.txs;
-        stats.histo[i].bytes += i2->second.bytes;
-      }
-      for (; i2 != agebytes.end(); i2++)
+      for (auto& [receive_time, weight, fee] : totals.by_receive_time)
       {
-        stats.histo[factor].txs += i2->second.txs;
-        stats.histo[factor].bytes += i2->second.bytes;
+        uint64_t age = age_of(receive_time);
+        auto& bin = stats.histo[age >= last_bin_age ? factor : (age * factor - 1) / delta];
+        bin.txs++;
+        bin.bytes += weight;
       }
-    }
+    });
   }
   //------------------------------------------------------------------
   //TODO: investigate whether boolean return is appropriate
@@ -1332,15 +1457,31 @@ namespace cryptonote
     return true;
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent) const
+  bool tx_memory_pool::check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent, bool include_unrelayed) const
   {
     auto locks = tools::unique_locks(m_transactions_lock, m_blockchain);
 
     spent.clear();
+    spent.reserve(key_images.size());
 
+    txpool_tx_meta_t meta;
     for (const auto& image : key_images)
     {
-      spent.push_back(m_spent_key_images.find(image) == m_spent_key_images.end() ? false : true);
+      auto it = m_spent_key_images.find(image);
+      bool found = it != m_spent_key_images.end();
+      if (found && !include_unrelayed)
+      {
+        found = false;
+        for (const crypto::hash& txid : it->second)
+        {
+          if (m_blockchain.get_txpool_tx_meta(txid, meta) && meta.relayed)
+          {
+            found = true;
+            break;
+          }
+        }
+      }
+      spent.push_back(found);
     }
 
     return true;
@@ -1380,9 +1521,21 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_inc(block const &blk)
   {
+    {
+      // Blinks mined in the block move to its height
+      auto blink_lock = blink_unique_lock();
+      if (!m_blink_heights.empty())
+      {
+        uint64_t const height = cryptonote::get_block_height(blk);
+        for (auto &txhash : blk.tx_hashes)
+          if (m_blink_heights.count(txhash))
+            set_blink_height(txhash, height);
+      }
+    }
+
     std::unique_lock lock{m_transactions_lock};
-    m_input_cache.clear();
-    m_parsed_tx_cache.clear();
+    clear_caches();
+    update_ready_txs(blk);
 
     std::vector<transaction> pool_txs;
     get_transactions(pool_txs);
@@ -1459,20 +1612,157 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::on_blockchain_dec()
   {
+    {
+      // Blinks in popped blocks could be back in the mempool, or gone (if they couldn't be
+      // re-added); update_blink_heights() will find out which.
+      auto blink_lock = blink_unique_lock();
+      auto popped = m_blink_sums.lower_bound(m_blockchain.get_current_blockchain_height());
+      std::vector<crypto::hash> unresolve;
+      for (auto it = popped; it != m_blink_sums.end(); ++it)
+        unresolve.insert(unresolve.end(), it->second.txs.begin(), it->second.txs.end());
+      for (auto &txhash : unresolve)
+        set_blink_height(txhash, std::nullopt);
+    }
+
     std::unique_lock lock{m_transactions_lock};
-    m_input_cache.clear();
-    m_parsed_tx_cache.clear();
+    clear_caches();
+    m_ready_txs.clear();
+    m_not_ready_txs.clear();
+    m_ready_txs_top = crypto::null_hash;
     return true;
   }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::revalidate()
+  {
+    std::vector<std::pair<crypto::hash, cryptonote::blobdata>> txs;
+    crypto::hash top;
+    {
+      auto locks = tools::unique_locks(m_transactions_lock, m_blockchain);
+      top = m_blockchain.get_tail_id();
+
+      std::unordered_set<crypto::hash> double_spends;
+      for (const auto& [k_image, txids] : m_spent_key_images)
+        if (m_blockchain.have_tx_keyimg_as_spent(k_image))
+          double_spends.insert(txids.begin(), txids.end());
+
+      LockedTXN lock(m_blockchain);
+      for (const crypto::hash& txid : double_spends)
+      {
+        txpool_tx_meta_t meta;
+        if (!m_blockchain.get_txpool_tx_meta(txid, meta) || meta.double_spend_seen)
+          continue;
+        MDEBUG("Marking " << txid << " as double spending the chain");
+        meta.double_spend_seen = true;
+        try
+        {
+          m_blockchain.update_txpool_tx(txid, meta);
+        }
+        catch (const std::exception &e)
+        {
+          MERROR("Failed to update tx meta: " << e.what());
+          // continue, not fatal
+        }
+      }
+      lock.commit();
+      if (!double_spends.empty())
+        ++m_cookie;
+
+      m_blockchain.for_all_txpool_txes([this, &txs, &double_spends](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd) {
+        if (!double_spends.count(txid) && !m_input_cache.count(txid))
+          txs.emplace_back(txid, *bd);
+        return true;
+      }, true);
+    }
+    if (txs.empty())
+      return;
+
+    std::vector<const cryptonote::blobdata*> blobs;
+    blobs.reserve(txs.size());
+    for (const auto& tx : txs)
+      blobs.push_back(&tx.second);
+    auto results = m_blockchain.verify_ring_signatures(blobs);
+
+    auto locks = tools::unique_locks(m_transactions_lock, m_blockchain);
+    if (m_blockchain.get_tail_id() != top)
+    {
+      MDEBUG("Chain changed while revalidating the tx pool, leaving the rest to the next block template");
+      return;
+    }
+    m_blockchain.add_ring_signature_results(std::move(results));
+    for (const auto& [txid, blob] : txs)
+    {
+      if (m_input_cache.count(txid) || !m_blockchain.txpool_has_tx(txid))
+        continue;
+      transaction tx;
+      bool parsed = false;
+      auto get_tx = [&]() -> cryptonote::transaction& {
+        if (!parsed)
+        {
+          if (!parse_and_validate_tx_from_blob(blob, tx))
+            throw std::runtime_error("failed to parse transaction blob");
+          tx.set_hash(txid);
+          parsed = true;
+        }
+        return tx;
+      };
+      uint64_t max_used_block_height = 0;
+      crypto::hash max_used_block_id = null_hash;
+      tx_verification_context tvc;
+      try
+      {
+        check_tx_inputs(get_tx, txid, max_used_block_height, max_used_block_id, tvc);
+      }
+      catch (const std::exception &e)
+      {
+        MDEBUG("Failed to revalidate " << txid << ": " << e.what());
+      }
+    }
+    MDEBUG("Revalidated " << txs.size() << " pool txes");
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::update_ready_txs(block const &blk)
+  {
+    // Txs not ready to go might be now, so they get checked again.  A standard tx that was ready
+    // stays ready on top of the new block unless the block spends one of its key images (tx
+    // inputs and unlock times only become more usable as the chain grows); other tx types depend
+    // on the service node list, so they get checked again too.
+    m_not_ready_txs.clear();
+    crypto::hash const prev_top = m_ready_txs_top;
+    m_ready_txs_top = get_block_hash(blk);
+    if (m_ready_txs.empty())
+      return;
+
+    std::vector<transaction> txs;
+    std::vector<crypto::hash> missed_txs;
+    if (blk.prev_id != prev_top || !m_blockchain.get_transactions(blk.tx_hashes, txs, missed_txs) || !missed_txs.empty())
+    {
+      m_ready_txs.clear();
+      return;
+    }
+
+    std::unordered_set<crypto::key_image> spent;
+    for (const auto& tx : txs)
+      for (const auto& in : tx.vin)
+        if (auto* ttk = std::get_if<txin_to_key>(&in))
+          spent.insert(ttk->k_image);
+
+    for (auto it = m_ready_txs.begin(); it != m_ready_txs.end(); )
+    {
+      auto& key_images = it->second.key_images;
+      if (!it->second.standard || std::any_of(key_images.begin(), key_images.end(), [&spent](const auto& ki) { return spent.count(ki); }))
+        it = m_ready_txs.erase(it);
+      else
+        ++it;
+    }
+  }
   //------------------------------------------------------------------
   std::vector<uint8_t> tx_memory_pool::have_txs(const std::vector<crypto::hash> &hashes) const
   {
     std::vector<uint8_t> result(hashes.size(), false);
     auto locks = tools::unique_locks(m_transactions_lock, m_blockchain);
 
-    auto &db = m_blockchain.get_db();
     for (size_t i = 0; i < hashes.size(); i++)
-      result[i] = db.txpool_has_tx(hashes[i]);
+      result[i] = m_blockchain.txpool_has_tx(hashes[i]);
 
     return result;
   }
@@ -1605,31 +1895,34 @@ end:
     }
 
     if (!kept_by_block)
+    {
       m_input_cache.insert(std::make_pair(txid, std::make_tuple(ret, tvc, max_used_block_height, max_used_block_id)));
+      update_cache_size();
+    }
     return ret;
   }
   //---------------------------------------------------------------------------------
-  bool tx_memory_pool::is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const cryptonote::blobdata &txblob, transaction &tx) const
+  bool tx_memory_pool::is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const transaction_view &view, transaction &tx) const
   {
     struct transction_parser
     {
-      transction_parser(const cryptonote::blobdata &txblob, const crypto::hash &txid, transaction &tx): txblob(txblob), txid(txid), tx(tx), parsed(false) {}
+      transction_parser(const transaction_view &view, const crypto::hash &txid, transaction &tx): view(view), txid(txid), tx(tx), parsed(false) {}
       cryptonote::transaction &operator()()
       {
         if (!parsed)
         {
-          if (!parse_and_validate_tx_from_blob(txblob, tx))
+          if (!view.materialise(tx))
             throw std::runtime_error("failed to parse transaction blob");
           tx.set_hash(txid);
           parsed = true;
         }
         return tx;
       }
-      const cryptonote::blobdata &txblob;
+      const transaction_view &view;
       const crypto::hash &txid;
       transaction &tx;
       bool parsed;
-    } lazy_tx(txblob, txid, tx);
+    } lazy_tx(view, txid, tx);
 
     //not the best implementation at this time, sorry :(
     //check is ring_signature already checked ?
@@ -1666,7 +1959,8 @@ end:
       }
     }
     //if we here, transaction seems valid, but, anyway, check for key_images collisions with blockchain, just to be sure
-    if(m_blockchain.have_tx_keyimges_as_spent(lazy_tx()))
+    // (from the view: when check_tx_inputs() hits the input cache, the tx never has to be parsed)
+    if(m_blockchain.have_tx_keyimges_as_spent(view))
     {
       txd.double_spend_seen = true;
       return false;
@@ -1679,38 +1973,34 @@ end:
   /**
    * @brief check if any of a transaction's spent key images are present in a given set
    *
-   * @param kic the set of key images to check against
-   * @param tx the transaction to check
+   * @param k_images the set of key images to check against
+   * @param tx_key_images the key images spent by the transaction
    *
    * @return true if any key images present in the set, otherwise false
    */
-  static bool have_key_images(const std::unordered_set<crypto::key_image>& k_images, const transaction_prefix& tx)
+  static bool have_key_images(const std::unordered_set<crypto::key_image>& k_images, const std::vector<crypto::key_image>& tx_key_images)
   {
-    for(size_t i = 0; i!= tx.vin.size(); i++)
-    {
-      CHECKED_GET_SPECIFIC_VARIANT(tx.vin[i], txin_to_key, itk, false);
-      if(k_images.count(itk.k_image))
+    for (const auto& ki : tx_key_images)
+      if (k_images.count(ki))
         return true;
-    }
     return false;
   }
   //---------------------------------------------------------------------------------
 
   /**
-   * @brief append the key images from a transaction to the given set
+   * @brief append a transaction's spent key images to the given set
    *
-   * @param kic the set of key images to append to
-   * @param tx the transaction
+   * @param k_images the set of key images to append to
+   * @param tx_key_images the key images spent by the transaction
    *
    * @return false if any append fails, otherwise true
    */
-  static bool append_key_images(std::unordered_set<crypto::key_image>& k_images, const transaction_prefix& tx)
+  static bool append_key_images(std::unordered_set<crypto::key_image>& k_images, const std::vector<crypto::key_image>& tx_key_images)
   {
-    for(size_t i = 0; i!= tx.vin.size(); i++)
+    for (const auto& ki : tx_key_images)
     {
-      CHECKED_GET_SPECIFIC_VARIANT(tx.vin[i], txin_to_key, itk, false);
-      auto i_res = k_images.insert(itk.k_image);
-      CHECK_AND_ASSERT_MES(i_res.second, false, "internal error: key images pool cache - inserted duplicate image in set: " << itk.k_image);
+      auto i_res = k_images.insert(ki);
+      CHECK_AND_ASSERT_MES(i_res.second, false, "internal error: key images pool cache - inserted duplicate image in set: " << ki);
     }
     return true;
   }
@@ -1787,6 +2077,17 @@ end:
 
     LOG_PRINT_L2("Filling block template, median weight " << median_weight << ", " << m_txs_by_fee_and_receive_time.size() << " txes in the pool");
 
+    // Readiness found by earlier calls holds as long as the chain (and the rules) haven't changed
+    // since; on_blockchain_inc carries it over to the next block where it can.
+    crypto::hash const top = m_blockchain.get_tail_id();
+    if (top != m_ready_txs_top || version != m_ready_txs_version)
+    {
+      m_ready_txs.clear();
+      m_not_ready_txs.clear();
+      m_ready_txs_top = top;
+      m_ready_txs_version = version;
+    }
+
     LockedTXN lock(m_blockchain);
 
     uint64_t next_reward = 0;
@@ -1841,41 +2142,59 @@ end:
         continue;
       }
 
-      cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(sorted_it.second);
-      cryptonote::transaction tx;
-
-      // Skip transactions that are not ready to be
-      // included into the blockchain or that are
-      // missing key images
-      const cryptonote::txpool_tx_meta_t original_meta = meta;
-      bool ready = false;
-      try
+      const std::vector<crypto::key_image>* tx_key_images = nullptr;
+      if (auto ready_it = m_ready_txs.find(sorted_it.second); ready_it != m_ready_txs.end())
+        tx_key_images = &ready_it->second.key_images;
+      else if (m_not_ready_txs.count(sorted_it.second))
       {
-        ready = is_transaction_ready_to_go(meta, sorted_it.second, txblob, tx);
-      }
-      catch (const std::exception &e)
-      {
-        MERROR("Failed to check transaction readiness: " << e.what());
-        // continue, not fatal
+        LOG_PRINT_L2("  not ready to go");
+        continue;
       }
-      if (memcmp(&original_meta, &meta, sizeof(meta)))
+      else
       {
+        cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(sorted_it.second);
+        std::optional<transaction_view> view;
+        cryptonote::transaction tx;
+
+        // Skip transactions that are not ready to be
+        // included into the blockchain or that are
+        // missing key images
+        const cryptonote::txpool_tx_meta_t original_meta = meta;
+        bool ready = false;
         try
         {
-          m_blockchain.update_txpool_tx(sorted_it.second, meta);
+          ready = parse_tx_view_from_blob(txblob, view) && is_transaction_ready_to_go(meta, sorted_it.second, *view, tx);
         }
         catch (const std::exception &e)
         {
-          MERROR("Failed to update tx meta: " << e.what());
+          MERROR("Failed to check transaction readiness: " << e.what());
           // continue, not fatal
         }
+        if (memcmp(&original_meta, &meta, sizeof(meta)))
+        {
+          try
+          {
+            m_blockchain.update_txpool_tx(sorted_it.second, meta);
+          }
+          catch (const std::exception &e)
+          {
+            MERROR("Failed to update tx meta: " << e.what());
+            // continue, not fatal
+          }
+        }
+        if (!ready)
+        {
+          LOG_PRINT_L2("  not ready to go");
+          m_not_ready_txs.insert(sorted_it.second);
+          continue;
+        }
+
+        auto& ready_tx = m_ready_txs[sorted_it.second];
+        ready_tx.standard = view->type == txtype::standard;
+        ready_tx.key_images = view->key_images;
+        tx_key_images = &ready_tx.key_images;
       }
-      if (!ready)
-      {
-        LOG_PRINT_L2("  not ready to go");
-        continue;
-      }
-      if (have_key_images(k_images, tx))
+      if (have_key_images(k_images, *tx_key_images))
       {
         LOG_PRINT_L2("  key images already seen");
         continue;
@@ -1886,7 +2205,7 @@ end:
       raw_fee      += meta.fee;
       net_fee       = next_reward_parts.miner_fee;
       best_reward   = next_reward;
-      append_key_images(k_images, tx);
+      append_key_images(k_images, *tx_key_images);
       LOG_PRINT_L2("  added, new block weight " << total_weight << "/" << max_total_weight << ", reward " << print_money(best_reward));
     }
     lock.commit();
@@ -1934,10 +2253,13 @@ end:
             MERROR("Failed to parse tx from txpool");
             continue;
           }
+          txpool_tx_meta_t meta;
+          const bool do_not_relay = m_blockchain.get_txpool_tx_meta(txid, meta) && meta.do_not_relay;
           // remove tx from db first
           m_blockchain.remove_txpool_tx(txid);
           m_txpool_weight -= get_transaction_weight(tx, txblob.size());
           remove_transaction_keyimages(tx, txid);
+          log_change(txid, do_not_relay);
           auto sorted_it = find_tx_in_sorted_container(txid);
           if (sorted_it == m_txs_by_fee_and_receive_time.end())
           {
@@ -1969,6 +2291,9 @@ end:
     m_txpool_max_weight = max_txpool_weight ? max_txpool_weight : DEFAULT_TXPOOL_MAX_WEIGHT;
     m_txs_by_fee_and_receive_time.clear();
     m_spent_key_images.clear();
+    m_ready_txs.clear();
+    m_not_ready_txs.clear();
+    m_ready_txs_top = crypto::null_hash;
     m_txpool_weight = 0;
     std::vector<crypto::hash> remove;
 
@@ -1980,20 +2305,20 @@ end:
       bool r = m_blockchain.for_all_txpool_txes([this, &remove, kept](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd) {
         if (kept != (bool)meta.kept_by_block)
           return true;
-        cryptonote::transaction_prefix tx;
-        if (!parse_and_validate_tx_prefix_from_blob(*bd, tx))
+        std::optional<transaction_view> tx;
+        if (!parse_tx_view_from_blob(*bd, tx))
         {
           MWARNING("Failed to parse tx from txpool, removing");
           remove.push_back(txid);
           return true;
         }
-        if (!insert_key_images(tx, txid, meta.kept_by_block))
+        if (!insert_key_images(*tx, txid, meta.kept_by_block))
         {
           MFATAL("Failed to insert key images from txpool tx");
           return false;
         }
 
-        const bool non_standard_tx = !tx.is_transfer();
+        const bool non_standard_tx = !tx->is_transfer();
         m_txs_by_fee_and_receive_time.emplace(std::tuple<bool, double, time_t>(non_standard_tx, meta.fee / (double)meta.weight, meta.receive_time), txid);
         m_txpool_weight += meta.weight;
         return true;
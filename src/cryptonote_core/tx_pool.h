@@ -30,17 +30,24 @@
 
 #pragma once
 
+#include <deque>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
 #include <queue>
 #include <boost/serialization/version.hpp>
 #include <functional>
+#include <map>
+#include <optional>
+#include <shared_mutex>
 
 #include "epee/string_tools.h"
 #include "common/periodic_task.h"
+#include "common/cache_budget.h"
+#include "common/instrumented_mutex.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 #include "cryptonote_basic/verification_context.h"
+#include "cryptonote_basic/tx_view.h"
 #include "blockchain_db/blockchain_db.h"
 #include "crypto/hash.h"
 #include "rpc/core_rpc_server_commands_defs.h"
@@ -310,6 +317,17 @@ namespace cryptonote
      */
     bool on_blockchain_dec();
 
+    /**
+     * @brief re-checks the inputs of the pool's txes after the chain has been rolled back (a
+     * reorg, blink rollback or pop_blocks)
+     *
+     * Txes spending a key image that is now spent in the chain are found up front from the key
+     * image index and marked as double spends; the ring signatures of the rest are verified across
+     * the threadpool without holding the pool lock, then their input checks are cached in one go.
+     * Does nothing (beyond the double spend marking) if the chain changes in the meantime.
+     */
+    void revalidate();
+
     /**
      * @brief action to take periodically
      *
@@ -447,10 +465,11 @@ namespace cryptonote
      *
      * @param key_images [in] vector of key images to check
      * @param spent [out] vector of bool to return
+     * @param include_unrelayed if false, only txes that have been relayed count as spending
      *
      * @return true
      */
-    bool check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent) const;
+    bool check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool>& spent, bool include_unrelayed = true) const;
 
     /**
      * @brief get a specific transaction from the pool
@@ -525,6 +544,36 @@ namespace cryptonote
      */
     size_t validate(uint8_t version);
 
+    /// What has changed in the pool since a previous get_pool_changes(), see there
+    struct pool_changes
+    {
+      uint64_t pool_id; //!< random, for each run of the daemon
+      uint64_t seq;     //!< what to pass as `since` next time
+      bool full;        //!< if true, `txs` and `blinks` are the whole pool, and `removed` is empty
+      std::vector<crypto::hash> txs;     //!< txs (other than approved blinks) added, or changed
+      std::vector<crypto::hash> blinks;  //!< approved blink txs added, or approved
+      std::vector<crypto::hash> removed; //!< txs no longer in the pool
+    };
+
+    /**
+     * @brief gets what has changed in the pool since an earlier call
+     *
+     * The pool keeps a bounded log of the txs it adds and removes (and those whose blink is
+     * approved, or which become relayable), numbered in sequence, so that a client that keeps its
+     * own copy of the pool's tx hashes can bring it up to date with the txs that changed since the
+     * state it has.  When `pool_id` isn't this pool's, or `since` is older than the log, the whole
+     * pool is returned instead.
+     *
+     * The state of a tx that changed is its state now, which may also be in the next changes.
+     *
+     * @param pool_id the pool_id of the changes the client has, or 0
+     * @param since the seq of the changes the client has
+     * @param include_unrelayed_txes include do-not-relay txs (which are otherwise never mentioned)
+     *
+     * @return the changes
+     */
+    pool_changes get_pool_changes(uint64_t pool_id, uint64_t since, bool include_unrelayed_txes) const;
+
      /**
       * @brief return the cookie
       *
@@ -554,6 +603,8 @@ namespace cryptonote
      * @return true on success, false on error
      */
     bool insert_key_images(const transaction_prefix &tx, const crypto::hash &txid, bool kept_by_block);
+    bool insert_key_images(const transaction_view &view, const crypto::hash &txid, bool kept_by_block);
+    bool insert_key_images(const std::vector<crypto::key_image> &key_images, const crypto::hash &txid, bool kept_by_block);
 
     /**
      * @brief remove old transactions from the pool
@@ -611,18 +662,21 @@ namespace cryptonote
      * @return false if any key images to be removed cannot be found, otherwise true
      */
     bool remove_transaction_keyimages(const transaction_prefix& tx, const crypto::hash &txid);
+    bool remove_transaction_keyimages(const transaction_view& view, const crypto::hash &txid);
+    bool remove_transaction_keyimages(const std::vector<crypto::key_image>& key_images, const crypto::hash &txid);
 
     /**
      * @brief check if a transaction is a valid candidate for inclusion in a block
      *
      * @param txd the transaction to check (and info about it)
      * @param txid the txid of the transaction to check
-     * @param txblob the transaction blob to check
-     * @param tx the parsed transaction, if successful
+     * @param view a view of the transaction blob to check
+     * @param tx the parsed transaction, if it had to be parsed (the input checks are cached, so it
+     * often doesn't)
      *
      * @return true if the transaction is good to go, otherwise false
      */
-    bool is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const cryptonote::blobdata &txblob, transaction&tx) const;
+    bool is_transaction_ready_to_go(txpool_tx_meta_t& txd, const crypto::hash &txid, const transaction_view &view, transaction&tx) const;
 
     /**
      * @brief mark all transactions double spending the one passed
@@ -693,7 +747,7 @@ namespace cryptonote
      */
     typedef std::unordered_map<crypto::key_image, std::unordered_set<crypto::hash> > key_images_container;
 
-    mutable std::recursive_mutex m_transactions_lock;  //!< mutex for the pool
+    mutable tools::instrumented_mutex<> m_transactions_lock{"tx_pool"};  //!< mutex for the pool
 
     //! container for spent key images from the transactions in the pool
     key_images_container m_spent_key_images;  
@@ -708,6 +762,16 @@ namespace cryptonote
 
     std::atomic<uint64_t> m_cookie; //!< incremented at each change
 
+    //! the log of get_pool_changes(): the txs that changed, and whether each was do-not-relay
+    //! (hidden) when it did.  m_changes.front() has the sequence number m_changes_begin.
+    std::deque<std::pair<crypto::hash, bool>> m_changes;
+    uint64_t m_changes_begin = 0;
+    const uint64_t m_pool_id;
+    mutable std::mutex m_changes_mutex; //!< innermost: may be locked with any other pool lock held
+
+    //! adds a tx to the log of changes
+    void log_change(const crypto::hash &txid, bool do_not_relay);
+
     /// Callbacks for new tx notifications
     std::vector<std::function<void(const crypto::hash&, const transaction&, const std::string& blob, const tx_pool_options&)>> m_tx_notify;
 
@@ -737,15 +801,64 @@ namespace cryptonote
     mutable std::unordered_map<crypto::hash, std::tuple<bool, tx_verification_context, uint64_t, crypto::hash>> m_input_cache;
 
     std::unordered_map<crypto::hash, transaction> m_parsed_tx_cache;
+    size_t m_parsed_tx_cache_bytes = 0; //!< the blob sizes of the txes in m_parsed_tx_cache
+
+    //! adds a tx to m_parsed_tx_cache; call with m_transactions_lock held
+    void cache_parsed_tx(const crypto::hash &id, const transaction &tx, size_t blob_size);
+    //! empties m_input_cache and m_parsed_tx_cache; call with m_transactions_lock held
+    void clear_caches();
+    //! reports the size of the two caches above to m_cache_budget
+    void update_cache_size() const;
+
+    //! a tx found ready to go by fill_block_template, with the key images it spends
+    struct ready_tx
+    {
+      std::vector<crypto::key_image> key_images;
+      bool standard; //!< whether the tx is txtype::standard, whose readiness survives new blocks
+    };
+    //! txs found ready/not ready to go on top of m_ready_txs_top under m_ready_txs_version rules,
+    //! so that fill_block_template only checks txs it hasn't seen yet
+    std::unordered_map<crypto::hash, ready_tx> m_ready_txs;
+    std::unordered_set<crypto::hash> m_not_ready_txs;
+    crypto::hash m_ready_txs_top = crypto::null_hash;
+    uint8_t m_ready_txs_version = 0;
+
+    //! carries m_ready_txs over to a new top block
+    void update_ready_txs(block const &blk);
 
     mutable std::shared_mutex m_blinks_mutex;
 
     // Contains blink metadata for approved blink transactions. { txhash => blink_tx, ... }.
     mutable std::unordered_map<crypto::hash, std::shared_ptr<cryptonote::blink_tx>> m_blinks;
 
-    // Helper method: retrieves hashes and mined heights of blink txes since the immutable block;
-    // mempool blinks are included with a height of 0.  Also takes care of cleaning up any blinks
-    // that have become immutable.  Blink lock must not be already held.
-    std::pair<std::vector<crypto::hash>, std::vector<uint64_t>> get_blink_hashes_and_mined_heights() const;
+    // The mined height of each blink in m_blinks (0 for the mempool), kept up to date as blocks
+    // are added and popped so that the per-height checksums below don't need a db lookup of every
+    // blink each time they are asked for.  New blinks (which could be in the mempool or already
+    // mined), and those in popped blocks, go in m_blinks_unresolved until update_blink_heights()
+    // looks up where they are.  All guarded by m_blinks_mutex.
+    mutable std::unordered_map<crypto::hash, uint64_t> m_blink_heights;
+    mutable std::unordered_set<crypto::hash> m_blinks_unresolved;
+
+    // The blinks at each mined height (0 for the mempool) with a known height: height => {xor of
+    // their tx hashes, the tx hashes}.  Heights without blinks are not included.
+    struct blink_height_sum
+    {
+      crypto::hash checksum = crypto::null_hash;
+      std::unordered_set<crypto::hash> txs;
+    };
+    mutable std::map<uint64_t, blink_height_sum> m_blink_sums;
+
+    // Moves a blink to the given mined height (nullopt: unresolved) in the above.  Blink unique lock
+    // must be held.
+    void set_blink_height(const crypto::hash &txhash, std::optional<uint64_t> height) const;
+
+    // Helper method: looks up the mined heights of unresolved blinks and cleans up any blinks that
+    // have become immutable, after which m_blink_sums is current.  Returns a blink shared lock held
+    // on that state.  Blink lock must not be already held.
+    std::shared_lock<std::shared_mutex> update_blink_heights() const;
+
+    //! registration of m_input_cache and m_parsed_tx_cache with the daemon's cache budget (last, so
+    //! that it goes before the caches do)
+    tools::cache_budget::handle m_cache_budget;
   };
 }
@@ -0,0 +1,299 @@
+#include "txpool_store.h"
+
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace cryptonote
+{
+
+uint64_t txpool_store::totals::median_weight() const
+{
+  if (low.empty())
+    return 0;
+  if (low.size() > high.size())
+    return *low.rbegin();
+  return (*low.rbegin() + *high.begin()) / 2;
+}
+
+void txpool_store::totals::add(const txpool_tx_meta_t& meta)
+{
+  txs++;
+  bytes += meta.weight;
+  fees += meta.fee;
+  if (!meta.relayed)
+    not_relayed++;
+  if (meta.last_failed_height)
+    failing++;
+  if (meta.double_spend_seen)
+    double_spends++;
+  by_receive_time.emplace(meta.receive_time, meta.weight, meta.fee);
+
+  if (low.empty() || meta.weight <= *low.rbegin())
+    low.insert(meta.weight);
+  else
+    high.insert(meta.weight);
+  if (low.size() > high.size() + 1)
+  {
+    high.insert(*low.rbegin());
+    low.erase(std::prev(low.end()));
+  }
+  else if (high.size() > low.size())
+  {
+    low.insert(*high.begin());
+    high.erase(high.begin());
+  }
+}
+
+void txpool_store::totals::remove(const txpool_tx_meta_t& meta)
+{
+  txs--;
+  bytes -= meta.weight;
+  fees -= meta.fee;
+  if (!meta.relayed)
+    not_relayed--;
+  if (meta.last_failed_height)
+    failing--;
+  if (meta.double_spend_seen)
+    double_spends--;
+  by_receive_time.erase(by_receive_time.find({meta.receive_time, meta.weight, meta.fee}));
+
+  if (meta.weight <= *low.rbegin())
+    low.erase(low.find(meta.weight));
+  else
+    high.erase(high.find(meta.weight));
+  if (high.size() > low.size())
+  {
+    low.insert(*high.begin());
+    high.erase(high.begin());
+  }
+  else if (low.size() > high.size() + 1)
+  {
+    high.insert(*low.rbegin());
+    low.erase(std::prev(low.end()));
+  }
+}
+
+void txpool_store::tally(const entry& e, bool add)
+{
+  auto f = add ? &totals::add : &totals::remove;
+  (m_totals.*f)(e.meta);
+  if (!e.meta.do_not_relay)
+    (m_relayable_totals.*f)(e.meta);
+}
+
+void txpool_store::recount()
+{
+  m_totals = {};
+  m_relayable_totals = {};
+  for (auto& [txid, e] : m_txs)
+    tally(e, true);
+}
+
+void txpool_store::load(const BlockchainDB& db)
+{
+  std::unordered_map<crypto::hash, entry> txs;
+  db.for_all_txpool_txes([&txs](const crypto::hash& txid, const txpool_tx_meta_t& meta, const blobdata* blob) {
+    txs.emplace(txid, entry{meta, std::make_shared<const blobdata>(*blob)});
+    return true;
+  }, true /*include_blob*/);
+
+  std::lock_guard lock{m_mutex};
+  m_txs = std::move(txs);
+  m_pending.clear();
+  m_in_group = false;
+  m_undo.clear();
+  recount();
+}
+
+void txpool_store::clear()
+{
+  std::lock_guard lock{m_mutex};
+  m_txs.clear();
+  m_pending.clear();
+  m_in_group = false;
+  m_undo.clear();
+  recount();
+}
+
+void txpool_store::changing(const crypto::hash& txid)
+{
+  auto it = m_txs.find(txid);
+  auto pending_it = m_pending.find(txid);
+  if (m_in_group && !m_undo.count(txid))
+  {
+    undo& u = m_undo[txid];
+    if (it != m_txs.end())
+      u.previous = it->second;
+    if (pending_it != m_pending.end())
+      u.previous_change = pending_it->second;
+  }
+  if (pending_it == m_pending.end())
+    m_pending.emplace(txid, change{it != m_txs.end(), false});
+}
+
+void txpool_store::add(const crypto::hash& txid, const blobdata& blob, const txpool_tx_meta_t& meta)
+{
+  std::lock_guard lock{m_mutex};
+  if (m_txs.count(txid))
+    throw std::runtime_error{"Attempting to add txpool tx that's already in the txpool"};
+  changing(txid);
+  auto it = m_txs.emplace(txid, entry{meta, std::make_shared<const blobdata>(blob)}).first;
+  tally(it->second, true);
+  if (auto& c = m_pending[txid]; c.in_db)
+    c.blob_changed = true;
+}
+
+void txpool_store::update(const crypto::hash& txid, const txpool_tx_meta_t& meta)
+{
+  std::lock_guard lock{m_mutex};
+  auto it = m_txs.find(txid);
+  if (it == m_txs.end())
+    throw std::runtime_error{"Error finding txpool tx meta to update"};
+  changing(txid);
+  tally(it->second, false);
+  it->second.meta = meta;
+  tally(it->second, true);
+}
+
+void txpool_store::remove(const crypto::hash& txid)
+{
+  std::lock_guard lock{m_mutex};
+  auto it = m_txs.find(txid);
+  if (it == m_txs.end())
+    return;
+  changing(txid);
+  tally(it->second, false);
+  m_txs.erase(it);
+}
+
+uint64_t txpool_store::count(bool include_unrelayed_txes) const
+{
+  std::lock_guard lock{m_mutex};
+  return include_unrelayed_txes ? m_txs.size() : m_relayable_totals.txs;
+}
+
+void txpool_store::with_totals(bool include_unrelayed_txes, const std::function<void(const totals&)>& f) const
+{
+  std::lock_guard lock{m_mutex};
+  f(include_unrelayed_txes ? m_totals : m_relayable_totals);
+}
+
+bool txpool_store::has(const crypto::hash& txid) const
+{
+  std::lock_guard lock{m_mutex};
+  return m_txs.count(txid);
+}
+
+bool txpool_store::get_meta(const crypto::hash& txid, txpool_tx_meta_t& meta) const
+{
+  std::lock_guard lock{m_mutex};
+  auto it = m_txs.find(txid);
+  if (it == m_txs.end())
+    return false;
+  meta = it->second.meta;
+  return true;
+}
+
+bool txpool_store::get_blob(const crypto::hash& txid, blobdata& blob) const
+{
+  std::lock_guard lock{m_mutex};
+  auto it = m_txs.find(txid);
+  if (it == m_txs.end())
+    return false;
+  blob = *it->second.blob;
+  return true;
+}
+
+bool txpool_store::for_all(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const blobdata*)> f,
+    bool include_blob, bool include_unrelayed_txes) const
+{
+  // Take a snapshot (the blobs are shared, not copied) so that the callback runs without the lock
+  // held and can look up or change the pool itself.
+  std::vector<std::pair<crypto::hash, entry>> txs;
+  {
+    std::lock_guard lock{m_mutex};
+    txs.reserve(m_txs.size());
+    for (auto& [txid, e] : m_txs)
+      if (include_unrelayed_txes || !e.meta.do_not_relay)
+        txs.emplace_back(txid, e);
+  }
+  for (auto& [txid, e] : txs)
+    if (!f(txid, e.meta, include_blob ? e.blob.get() : nullptr))
+      return false;
+  return true;
+}
+
+bool txpool_store::begin()
+{
+  std::lock_guard lock{m_mutex};
+  if (m_in_group)
+    return false;
+  m_in_group = true;
+  return true;
+}
+
+void txpool_store::commit()
+{
+  std::lock_guard lock{m_mutex};
+  m_in_group = false;
+  m_undo.clear();
+}
+
+void txpool_store::abort()
+{
+  std::lock_guard lock{m_mutex};
+  for (auto& [txid, u] : m_undo)
+  {
+    if (auto it = m_txs.find(txid); it != m_txs.end())
+    {
+      tally(it->second, false);
+      m_txs.erase(it);
+    }
+    if (u.previous)
+    {
+      tally(*u.previous, true);
+      m_txs.emplace(txid, std::move(*u.previous));
+    }
+    if (u.previous_change)
+      m_pending.insert_or_assign(txid, *u.previous_change);
+    else
+      m_pending.erase(txid);
+  }
+  m_in_group = false;
+  m_undo.clear();
+}
+
+size_t txpool_store::pending() const
+{
+  std::lock_guard lock{m_mutex};
+  return m_pending.size();
+}
+
+void txpool_store::flush(BlockchainDB& db)
+{
+  std::lock_guard lock{m_mutex};
+  if (m_in_group)
+    return;
+  for (auto& [txid, c] : m_pending)
+  {
+    auto it = m_txs.find(txid);
+    if (it == m_txs.end())
+    {
+      if (c.in_db)
+        db.remove_txpool_tx(txid);
+    }
+    else if (!c.in_db)
+      db.add_txpool_tx(txid, *it->second.blob, it->second.meta);
+    else if (c.blob_changed)
+    {
+      db.remove_txpool_tx(txid);
+      db.add_txpool_tx(txid, *it->second.blob, it->second.meta);
+    }
+    else
+      db.update_txpool_tx(txid, it->second.meta);
+  }
+  m_pending.clear();
+}
+
+}
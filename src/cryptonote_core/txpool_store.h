@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+
+#include "crypto/hash.h"
+#include "blockchain_db/blockchain_db.h"
+
+namespace cryptonote
+{
+
+// The tx pool's transactions (metadata and blobs), kept in memory, with the database's txpool_meta
+// and txpool_blob tables as a write-behind journal: changes are only recorded here, and carried
+// over to the database in a single write txn per flush() (see Blockchain::flush_txpool()), so that
+// pool churn (relay flags, ready-to-go checks, spam bursts) doesn't cost a write txn per change.
+// What wasn't flushed before a crash is lost, which only means the pool is somewhat out of date
+// after restarting.
+//
+// Changes can be grouped with begin()/commit()/abort() (used by LockedTXN), abort() undoing
+// everything since begin(), as the database txn the pool used to write in did.
+//
+// Thread-safe.  Pointers to blobs passed to a for_all() callback stay valid for the duration of
+// the callback, even if the callback removes the tx.
+class txpool_store
+{
+public:
+  // Running aggregates over the pool's txs, kept up to date by every change (including abort() and
+  // load()) so that the pool stats RPCs don't have to walk and copy the whole pool.
+  struct totals
+  {
+    uint64_t txs = 0;
+    uint64_t bytes = 0;
+    uint64_t fees = 0;
+    uint64_t not_relayed = 0;
+    uint64_t failing = 0;
+    uint64_t double_spends = 0;
+    // The tx weights split around the median: everything in `low` is <= everything in `high`, and
+    // low has the same number of elements as high, or one more.
+    std::multiset<uint64_t> low, high;
+    // [receive_time, weight, fee] of each tx, oldest first
+    std::multiset<std::tuple<uint64_t, uint64_t, uint64_t>> by_receive_time;
+
+    uint64_t min_weight() const { return low.empty() ? 0 : *low.begin(); }
+    uint64_t max_weight() const { return !high.empty() ? *high.rbegin() : low.empty() ? 0 : *low.rbegin(); }
+    // Same as epee::misc_utils::median of all the weights
+    uint64_t median_weight() const;
+
+    void add(const txpool_tx_meta_t& meta);
+    void remove(const txpool_tx_meta_t& meta);
+  };
+
+  // Replaces the contents (and forgets any unflushed changes) with the txs stored in `db`
+  void load(const BlockchainDB& db);
+  // Empties the store; the database is assumed to have been emptied as well
+  void clear();
+
+  // Throws if the tx is already present
+  void add(const crypto::hash& txid, const blobdata& blob, const txpool_tx_meta_t& meta);
+  // Throws if the tx is not present
+  void update(const crypto::hash& txid, const txpool_tx_meta_t& meta);
+  // Does nothing if the tx is not present
+  void remove(const crypto::hash& txid);
+
+  uint64_t count(bool include_unrelayed_txes = true) const;
+  // Calls `f` with the totals of all txs, or only of those not flagged do_not_relay, with the
+  // store locked (so `f` must not call back into the store).
+  void with_totals(bool include_unrelayed_txes, const std::function<void(const totals&)>& f) const;
+  bool has(const crypto::hash& txid) const;
+  bool get_meta(const crypto::hash& txid, txpool_tx_meta_t& meta) const;
+  bool get_blob(const crypto::hash& txid, blobdata& blob) const;
+  bool for_all(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const blobdata*)> f,
+      bool include_blob = false, bool include_unrelayed_txes = true) const;
+
+  // Starts a group of changes; returns false (and does nothing) if one is already in progress, in
+  // which case the changes become part of that one.
+  bool begin();
+  void commit();
+  void abort();
+
+  // Number of txs with changes not yet written to the database
+  size_t pending() const;
+
+  // Writes the changes since the last flush into `db`'s current write txn, which the caller must
+  // have started.  If this throws, the changes remain pending, so the caller must abort the txn.
+  // Does nothing while a group of changes is in progress (it could yet be aborted).
+  void flush(BlockchainDB& db);
+
+private:
+  struct entry
+  {
+    txpool_tx_meta_t meta;
+    std::shared_ptr<const blobdata> blob;
+  };
+  struct change
+  {
+    bool in_db;        // whether the database had the tx as of the last flush
+    bool blob_changed; // whether the tx was removed and re-added since the last flush
+  };
+  struct undo
+  {
+    std::optional<entry> previous;
+    std::optional<change> previous_change;
+  };
+
+  // Records the current state of `txid` for abort() and the database journal; must be called
+  // (with the lock held) before each modification.
+  void changing(const crypto::hash& txid);
+
+  // Adds `e`'s tx to, or removes it from, the totals it counts towards
+  void tally(const entry& e, bool add);
+  void recount();
+
+  mutable std::mutex m_mutex;
+  std::unordered_map<crypto::hash, entry> m_txs;
+  std::unordered_map<crypto::hash, change> m_pending;
+  bool m_in_group = false;
+  std::unordered_map<crypto::hash, undo> m_undo; // state of each tx changed since begin()
+  totals m_totals;           // all txs
+  totals m_relayable_totals; // txs not flagged do_not_relay
+};
+
+}
@@ -29,11 +29,13 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <cstring>
 #include <vector>
 #include <unordered_map>
 #include <boost/uuid/nil_generator.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include "epee/string_tools.h"
+#include "epee/storages/portable_storage_template_helper.h"
 #include "cryptonote_protocol_defs.h"
 #include "common/pruning.h"
 #include "block_queue.h"
@@ -55,6 +57,40 @@ struct hash<boost::uuids::uuid>
 namespace cryptonote
 {
 
+block_queue::span::span(uint64_t start_block_height, std::vector<cryptonote::block_complete_entry> bcel, const boost::uuids::uuid &connection_id, float rate, size_t size):
+  start_block_height(start_block_height),
+  blocks(bcel.empty() ? nullptr : std::make_shared<const std::vector<cryptonote::block_complete_entry>>(std::move(bcel))),
+  connection_id(connection_id), nblocks(blocks ? blocks->size() : 0), rate(rate), size(size),
+  time{std::chrono::steady_clock::now()}
+{}
+
+block_queue::~block_queue()
+{
+  close_spill();
+}
+
+void block_queue::set_spill(fs::path dir, size_t memory_budget)
+{
+  std::unique_lock lock{mutex};
+  CHECK_AND_ASSERT_THROW_MES(spilled_spans == 0, "Cannot change the spill file with spans spilled to it");
+  close_spill();
+  spill_budget = memory_budget;
+  if (spill_budget)
+    spill_path = dir / "block_queue.spill";
+}
+
+void block_queue::close_spill()
+{
+  if (spill_file.is_open())
+    spill_file.close();
+  if (!spill_path.empty())
+  {
+    std::error_code ec;
+    fs::remove(spill_path, ec);
+  }
+  spill_end = 0;
+}
+
 void block_queue::add_blocks(uint64_t height, std::vector<cryptonote::block_complete_entry> bcel, const boost::uuids::uuid &connection_id, float rate, size_t size)
 {
   std::unique_lock lock{mutex};
@@ -70,6 +106,90 @@ void block_queue::add_blocks(uint64_t height, std::vector<cryptonote::block_comp
     }
     set_span_hashes(height, connection_id, hashes);
   }
+  if (spill_budget)
+    spill_excess();
+}
+
+// Spills the highest spans held in memory until what's left fits the budget.  The lowest span
+// stays, as it's the next one to be added (or waits on the spans just below it).
+void block_queue::spill_excess()
+{
+  size_t in_memory = 0;
+  for (const auto &span: blocks)
+    if (span.blocks)
+      in_memory += span.size;
+
+  for (auto it = blocks.rbegin(); in_memory > spill_budget && it != blocks.rend() && std::next(it) != blocks.rend(); ++it)
+  {
+    if (!it->blocks)
+      continue;
+    if (!spill_file.is_open())
+    {
+      spill_file.open(spill_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+      if (!spill_file.is_open())
+      {
+        MERROR("Failed to open block queue spill file " << spill_path << "; keeping downloaded blocks in memory");
+        spill_budget = 0;
+        return;
+      }
+      spill_end = 0;
+    }
+
+    std::string data;
+    for (const auto &bce: *it->blocks)
+    {
+      std::string blob;
+      if (!epee::serialization::store_t_to_binary(bce, blob))
+        return;
+      uint64_t len = blob.size();
+      data.append(reinterpret_cast<const char*>(&len), sizeof(len));
+      data += blob;
+    }
+    spill_file.clear();
+    spill_file.seekp(spill_end);
+    spill_file.write(data.data(), data.size());
+    spill_file.flush();
+    if (!spill_file)
+    {
+      MERROR("Failed to write to block queue spill file " << spill_path << "; keeping downloaded blocks in memory");
+      spill_file.clear();
+      return;
+    }
+    MDEBUG("Spilled span " << it->start_block_height << " (" << it->nblocks << " blocks, " << it->size << " bytes) to disk");
+    // neither changes the span's sorting
+    auto &s = const_cast<span&>(*it);
+    s.spilled.emplace(spill_end, data.size());
+    s.blocks.reset();
+    spill_end += data.size();
+    ++spilled_spans;
+    in_memory -= it->size;
+  }
+}
+
+block_queue::span_blocks block_queue::load_spilled(const span &s) const
+{
+  const auto [offset, length] = *s.spilled;
+  std::string data(length, '\0');
+  spill_file.clear();
+  spill_file.seekg(offset);
+  spill_file.read(data.data(), data.size());
+  CHECK_AND_ASSERT_THROW_MES(spill_file, "Failed to read span " << s.start_block_height << " from block queue spill file");
+
+  std::vector<cryptonote::block_complete_entry> bcel;
+  bcel.reserve(s.nblocks);
+  std::string_view in{data};
+  while (!in.empty())
+  {
+    uint64_t len;
+    CHECK_AND_ASSERT_THROW_MES(in.size() >= sizeof(len), "Truncated spilled span");
+    std::memcpy(&len, in.data(), sizeof(len));
+    in.remove_prefix(sizeof(len));
+    CHECK_AND_ASSERT_THROW_MES(in.size() >= len, "Truncated spilled span");
+    CHECK_AND_ASSERT_THROW_MES(epee::serialization::load_t_from_binary(bcel.emplace_back(), in.substr(0, len)), "Invalid spilled block");
+    in.remove_prefix(len);
+  }
+  CHECK_AND_ASSERT_THROW_MES(bcel.size() == s.nblocks, "Spilled span has the wrong number of blocks");
+  return std::make_shared<const std::vector<cryptonote::block_complete_entry>>(std::move(bcel));
 }
 
 void block_queue::add_blocks(uint64_t height, uint64_t nblocks, const boost::uuids::uuid &connection_id, std::chrono::steady_clock::time_point time)
@@ -86,7 +206,7 @@ void block_queue::flush_spans(const boost::uuids::uuid &connection_id, bool all)
   while (i != blocks.end())
   {
     block_map::iterator j = i++;
-    if (j->connection_id == connection_id && (all || j->blocks.size() == 0))
+    if (j->connection_id == connection_id && (all || !j->filled()))
     {
       erase_block(j);
     }
@@ -101,7 +221,11 @@ void block_queue::erase_block(block_map::iterator j)
     requested_hashes.erase(h);
     have_blocks.erase(h);
   }
+  const bool spilled = j->spilled.has_value();
   blocks.erase(j);
+  // Start the spill file over once nothing in it is needed any more
+  if (spilled && --spilled_spans == 0)
+    close_spill();
 }
 
 void block_queue::flush_stale_spans(const std::set<boost::uuids::uuid> &live_connections)
@@ -111,7 +235,7 @@ void block_queue::flush_stale_spans(const std::set<boost::uuids::uuid> &live_con
   while (i != blocks.end())
   {
     block_map::iterator j = i++;
-    if (j->blocks.empty() && live_connections.find(j->connection_id) == live_connections.end())
+    if (!j->filled() && live_connections.find(j->connection_id) == live_connections.end())
     {
       erase_block(j);
     }
@@ -171,7 +295,7 @@ uint64_t block_queue::get_next_needed_height(uint64_t blockchain_height) const
   {
     if (span.start_block_height + span.nblocks - 1 < blockchain_height)
       continue;
-    if (span.start_block_height != last_needed_height || (first && span.blocks.empty()))
+    if (span.start_block_height != last_needed_height || (first && !span.filled()))
       return last_needed_height;
     last_needed_height = span.start_block_height + span.nblocks;
     first = false;
@@ -184,7 +308,7 @@ void block_queue::print() const
   std::unique_lock lock{mutex};
   MDEBUG("Block queue has " << blocks.size() << " spans");
   for (const auto &span: blocks)
-    MDEBUG("  " << span.start_block_height << " - " << (span.start_block_height+span.nblocks-1) << " (" << span.nblocks << ") - " << (span.blocks.empty() ? "scheduled" : "filled    ") << "  " << span.connection_id << " (" << ((unsigned)(span.rate*10/1024.f))/10.f << " kB/s)");
+    MDEBUG("  " << span.start_block_height << " - " << (span.start_block_height+span.nblocks-1) << " (" << span.nblocks << ") - " << (span.spilled ? "spilled   " : span.blocks ? "filled    " : "scheduled") << "  " << span.connection_id << " (" << ((unsigned)(span.rate*10/1024.f))/10.f << " kB/s)");
 }
 
 std::string block_queue::get_overview(uint64_t blockchain_height) const
@@ -205,7 +329,7 @@ std::string block_queue::get_overview(uint64_t blockchain_height) const
     {
       if (expected < i->start_block_height)
         s += std::string(std::max((uint64_t)1, (i->start_block_height - expected) / (i->nblocks ? i->nblocks : 1)), '_');
-      s += i->blocks.empty() ? "." : i->start_block_height == blockchain_height ? "m" : "o";
+      s += !i->filled() ? "." : i->start_block_height == blockchain_height ? "m" : "o";
       expected = i->start_block_height + i->nblocks;
     }
     ++i;
@@ -317,7 +441,7 @@ std::pair<uint64_t, uint64_t> block_queue::get_next_span_if_scheduled(std::vecto
   block_map::const_iterator i = blocks.begin();
   if (i == blocks.end())
     return std::make_pair(0, 0);
-  if (!i->blocks.empty())
+  if (i->filled())
     return std::make_pair(0, 0);
   hashes = i->hashes;
   connection_id = i->connection_id;
@@ -330,7 +454,7 @@ void block_queue::reset_next_span_time()
   CHECK_AND_ASSERT_THROW_MES(!blocks.empty(), "No next span to reset time");
   block_map::iterator i = blocks.begin();
   CHECK_AND_ASSERT_THROW_MES(i != blocks.end(), "No next span to reset time");
-  CHECK_AND_ASSERT_THROW_MES(i->blocks.empty(), "Next span is not empty");
+  CHECK_AND_ASSERT_THROW_MES(!i->filled(), "Next span is not empty");
   const_cast<std::chrono::steady_clock::time_point&>(i->time) // time doesn't influence sorting
       = std::chrono::steady_clock::now();
 }
@@ -344,6 +468,8 @@ void block_queue::set_span_hashes(uint64_t start_height, const boost::uuids::uui
     if (i->start_block_height == start_height && i->connection_id == connection_id)
     {
       span s = *i;
+      if (s.spilled)
+        ++spilled_spans; // it's going straight back in, so keep its spilled blocks
       erase_block(i);
       s.hashes = std::move(hashes);
       for (const crypto::hash &h: s.hashes)
@@ -354,7 +480,7 @@ void block_queue::set_span_hashes(uint64_t start_height, const boost::uuids::uui
   }
 }
 
-bool block_queue::get_next_span(uint64_t &height, std::vector<cryptonote::block_complete_entry> &bcel, boost::uuids::uuid &connection_id, bool filled) const
+bool block_queue::get_next_span(uint64_t &height, span_blocks &bcel, boost::uuids::uuid &connection_id, bool filled) const
 {
   std::unique_lock lock{mutex};
   if (blocks.empty())
@@ -362,10 +488,20 @@ bool block_queue::get_next_span(uint64_t &height, std::vector<cryptonote::block_
   block_map::const_iterator i = blocks.begin();
   for (; i != blocks.end(); ++i)
   {
-    if (!filled || !i->blocks.empty())
+    if (!filled || i->filled())
     {
+      if (i->spilled)
+      {
+        try { bcel = load_spilled(*i); }
+        catch (const std::exception &e)
+        {
+          MERROR(e.what());
+          return false;
+        }
+      }
+      else
+        bcel = i->blocks;
       height = i->start_block_height;
-      bcel = i->blocks;
       connection_id = i->connection_id;
       return true;
     }
@@ -373,6 +509,32 @@ bool block_queue::get_next_span(uint64_t &height, std::vector<cryptonote::block_
   return false;
 }
 
+bool block_queue::get_filled_span_at(uint64_t height, span_blocks &bcel) const
+{
+  std::unique_lock lock{mutex};
+  for (const span &s: blocks)
+  {
+    if (s.start_block_height > height)
+      break;
+    if (s.start_block_height == height && s.filled())
+    {
+      if (!s.spilled)
+        bcel = s.blocks;
+      else
+      {
+        try { bcel = load_spilled(s); }
+        catch (const std::exception &e)
+        {
+          MERROR(e.what());
+          return false;
+        }
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
 bool block_queue::has_next_span(uint64_t height, bool &filled, std::chrono::steady_clock::time_point& time, boost::uuids::uuid &connection_id) const
 {
   std::unique_lock lock{mutex};
@@ -383,7 +545,7 @@ bool block_queue::has_next_span(uint64_t height, bool &filled, std::chrono::stea
     return false;
   if (i->start_block_height > height)
     return false;
-  filled = !i->blocks.empty();
+  filled = i->filled();
   time = i->time;
   connection_id = i->connection_id;
   return true;
@@ -398,12 +560,22 @@ size_t block_queue::get_data_size() const
   return size;
 }
 
+size_t block_queue::get_memory_size() const
+{
+  std::unique_lock lock{mutex};
+  size_t size = 0;
+  for (const auto &span: blocks)
+    if (span.blocks)
+      size += span.size;
+  return size;
+}
+
 size_t block_queue::get_num_filled_spans() const
 {
   std::unique_lock lock{mutex};
   size_t size = 0;
   for (const auto &span: blocks)
-  if (!span.blocks.empty())
+  if (span.filled())
     ++size;
   return size;
 }
@@ -443,7 +615,7 @@ float block_queue::get_speed(const boost::uuids::uuid &connection_id) const
   std::unordered_map<boost::uuids::uuid, float> speeds;
   for (const auto &span: blocks)
   {
-    if (span.blocks.empty())
+    if (!span.filled())
       continue;
     // note that the average below does not average over the whole set, but over the
     // previous pseudo average and the latest rate: this gives much more importance
@@ -479,7 +651,7 @@ float block_queue::get_download_rate(const boost::uuids::uuid &connection_id) co
   float conn_rate = -1.f;
   for (const auto &span: blocks)
   {
-    if (span.blocks.empty())
+    if (!span.filled())
       continue;
     if (span.connection_id != connection_id)
       continue;
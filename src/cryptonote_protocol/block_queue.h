@@ -31,12 +31,16 @@
 
 #pragma once
 
+#include <fstream>
+#include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 #include <set>
 #include <unordered_set>
 #include <mutex>
 #include <boost/uuid/uuid.hpp>
+#include "common/fs.h"
 #include "crypto/hash.h"
 
 #undef OXEN_DEFAULT_LOG_CATEGORY
@@ -49,20 +53,26 @@ namespace cryptonote
   class block_queue
   {
   public:
+    // The downloaded blocks of a span.  These are never modified once queued, so they are shared
+    // (rather than copied, blobs and all) with whoever takes the span out of the queue to add it.
+    using span_blocks = std::shared_ptr<const std::vector<cryptonote::block_complete_entry>>;
+
     struct span
     {
       uint64_t start_block_height;
       std::vector<crypto::hash> hashes;
-      std::vector<cryptonote::block_complete_entry> blocks;
+      span_blocks blocks; // nullptr until the span has been downloaded, and while it is spilled
       boost::uuids::uuid connection_id;
       uint64_t nblocks;
       float rate;
       size_t size;
       std::chrono::steady_clock::time_point time;
+      // Offset and length of the span's blocks in the spill file, if they have been moved there
+      std::optional<std::pair<uint64_t, uint64_t>> spilled;
+
+      bool filled() const { return blocks || spilled; }
 
-      span(uint64_t start_block_height, std::vector<cryptonote::block_complete_entry> blocks, const boost::uuids::uuid &connection_id, float rate, size_t size):
-        start_block_height(start_block_height), blocks(std::move(blocks)), connection_id(connection_id), nblocks(this->blocks.size()), rate(rate), size(size),
-        time{std::chrono::steady_clock::now()} {}
+      span(uint64_t start_block_height, std::vector<cryptonote::block_complete_entry> blocks, const boost::uuids::uuid &connection_id, float rate, size_t size);
       span(uint64_t start_block_height, uint64_t nblocks, const boost::uuids::uuid &connection_id, std::chrono::steady_clock::time_point time):
         start_block_height(start_block_height), connection_id(connection_id), nblocks(nblocks), rate(0.0f), size(0), time(time) {}
 
@@ -71,6 +81,14 @@ namespace cryptonote
     typedef std::set<span> block_map;
 
   public:
+    ~block_queue();
+
+    // Once the downloaded spans held in memory add up to more than `memory_budget` bytes, moves the
+    // blocks of the furthest ones out to a temporary file in `dir` until they are next needed.
+    // Spilling is off by default (or with a 0 budget).
+    void set_spill(fs::path dir, size_t memory_budget);
+    bool spilling() const { return spill_budget > 0; }
+
     void add_blocks(uint64_t height, std::vector<cryptonote::block_complete_entry> bcel, const boost::uuids::uuid &connection_id, float rate, size_t size);
     void add_blocks(uint64_t height, uint64_t nblocks, const boost::uuids::uuid &connection_id, std::chrono::steady_clock::time_point time);
     void flush_spans(const boost::uuids::uuid &connection_id, bool all = false);
@@ -86,9 +104,12 @@ namespace cryptonote
     std::pair<uint64_t, uint64_t> get_next_span_if_scheduled(std::vector<crypto::hash> &hashes, boost::uuids::uuid &connection_id) const;
     void reset_next_span_time();
     void set_span_hashes(uint64_t start_height, const boost::uuids::uuid &connection_id, std::vector<crypto::hash> hashes);
-    bool get_next_span(uint64_t &height, std::vector<cryptonote::block_complete_entry> &bcel, boost::uuids::uuid &connection_id, bool filled = true) const;
+    bool get_next_span(uint64_t &height, span_blocks &bcel, boost::uuids::uuid &connection_id, bool filled = true) const;
+    bool get_filled_span_at(uint64_t height, span_blocks &bcel) const;
     bool has_next_span(uint64_t height, bool &filled, std::chrono::steady_clock::time_point& time, boost::uuids::uuid &connection_id) const;
     size_t get_data_size() const;
+    // Like get_data_size(), but without the spans spilled to disk
+    size_t get_memory_size() const;
     size_t get_num_filled_spans() const;
     crypto::hash get_last_known_hash(const boost::uuids::uuid &connection_id) const;
     bool has_spans(const boost::uuids::uuid &connection_id) const;
@@ -101,11 +122,20 @@ namespace cryptonote
   private:
     void erase_block(block_map::iterator j);
     inline bool requested_internal(const crypto::hash &hash) const;
+    void spill_excess();
+    span_blocks load_spilled(const span &s) const;
+    void close_spill();
 
   private:
     block_map blocks;
     mutable std::recursive_mutex mutex;
     std::unordered_set<crypto::hash> requested_hashes;
     std::unordered_set<crypto::hash> have_blocks;
+
+    fs::path spill_path;
+    size_t spill_budget = 0;
+    mutable fs::fstream spill_file;
+    uint64_t spill_end = 0;
+    size_t spilled_spans = 0;
   };
 }
@@ -0,0 +1,70 @@
+#include "compact_block.h"
+
+#include <cstring>
+#include <unordered_map>
+
+namespace cryptonote::compact_block
+{
+
+namespace
+{
+  uint64_t load_short_id(const char* p)
+  {
+    uint64_t id = 0;
+    for (size_t i = 0; i < SHORT_ID_SIZE; i++)
+      id |= uint64_t{static_cast<unsigned char>(p[i])} << (8 * i);
+    return id;
+  }
+
+  void store_short_id(uint64_t id, char* p)
+  {
+    for (size_t i = 0; i < SHORT_ID_SIZE; i++)
+      p[i] = static_cast<char>((id >> (8 * i)) & 0xff);
+  }
+}
+
+uint64_t short_id(uint64_t salt, const crypto::hash& tx_hash)
+{
+  unsigned char data[sizeof(salt) + sizeof(tx_hash)];
+  for (size_t i = 0; i < sizeof(salt); i++)
+    data[i] = static_cast<unsigned char>((salt >> (8 * i)) & 0xff);
+  std::memcpy(data + sizeof(salt), tx_hash.data, sizeof(tx_hash));
+  crypto::hash h = crypto::cn_fast_hash(data, sizeof(data));
+  return load_short_id(h.data);
+}
+
+std::string make_short_ids(uint64_t salt, const std::vector<crypto::hash>& tx_hashes)
+{
+  std::string result(tx_hashes.size() * SHORT_ID_SIZE, '\0');
+  for (size_t i = 0; i < tx_hashes.size(); i++)
+    store_short_id(short_id(salt, tx_hashes[i]), result.data() + i * SHORT_ID_SIZE);
+  return result;
+}
+
+std::optional<std::vector<crypto::hash>> resolve_short_ids(
+    uint64_t salt, std::string_view short_ids, const std::vector<crypto::hash>& candidates)
+{
+  if (short_ids.size() % SHORT_ID_SIZE)
+    return std::nullopt;
+
+  // Short ids shared by two different candidates map to null_hash: we can't tell which one is meant
+  std::unordered_map<uint64_t, crypto::hash> by_id;
+  by_id.reserve(candidates.size());
+  for (auto& h : candidates)
+  {
+    auto [it, inserted] = by_id.emplace(short_id(salt, h), h);
+    if (!inserted && it->second != h)
+      it->second = crypto::null_hash;
+  }
+
+  std::vector<crypto::hash> result;
+  result.reserve(short_ids.size() / SHORT_ID_SIZE);
+  for (size_t pos = 0; pos < short_ids.size(); pos += SHORT_ID_SIZE)
+  {
+    auto it = by_id.find(load_short_id(short_ids.data() + pos));
+    result.push_back(it == by_id.end() ? crypto::null_hash : it->second);
+  }
+  return result;
+}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "crypto/hash.h"
+
+namespace cryptonote::compact_block
+{
+
+// Compact blocks (NOTIFY_NEW_COMPACT_BLOCK) identify the block's txs by short ids instead of full
+// tx hashes: the first SHORT_ID_SIZE bytes of H(salt || tx hash), with a random salt chosen per
+// relayed block so that no one can construct txs whose short ids collide for every peer.
+constexpr size_t SHORT_ID_SIZE = 6;
+
+uint64_t short_id(uint64_t salt, const crypto::hash& tx_hash);
+
+// Returns the packed (SHORT_ID_SIZE bytes each) short ids of `tx_hashes`
+std::string make_short_ids(uint64_t salt, const std::vector<crypto::hash>& tx_hashes);
+
+// Matches packed short ids against the hashes of txs we have (typically the pool's).  Returns the
+// matching hash for each short id, or null_hash for short ids that match none or more than one of
+// `candidates`; returns nullopt if `short_ids` is not a whole number of short ids.
+std::optional<std::vector<crypto::hash>> resolve_short_ids(
+    uint64_t salt, std::string_view short_ids, const std::vector<crypto::hash>& candidates);
+
+}
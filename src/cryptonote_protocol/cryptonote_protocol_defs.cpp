@@ -38,6 +38,14 @@ KV_SERIALIZE_MAP_CODE_BEGIN(connection_info)
   KV_SERIALIZE(height)
   KV_SERIALIZE(pruning_seed)
   KV_SERIALIZE(address_type)
+  KV_SERIALIZE(span_blocks)
+  KV_SERIALIZE(span_rate)
+  uint64_t rtt = 0;
+  if (is_store)
+    rtt = this_ref.rtt.count();
+  KV_SERIALIZE_VALUE(rtt)
+  if constexpr (!is_store)
+    this_ref.rtt = std::chrono::milliseconds{rtt};
 KV_SERIALIZE_MAP_CODE_END()
 
 KV_SERIALIZE_MAP_CODE_BEGIN(serializable_blink_metadata)
@@ -104,6 +112,18 @@ KV_SERIALIZE_MAP_CODE_BEGIN(NOTIFY_REQUEST_FLUFFY_MISSING_TX::request)
   KV_SERIALIZE_CONTAINER_POD_AS_BLOB(missing_tx_indices)
 KV_SERIALIZE_MAP_CODE_END()
 
+KV_SERIALIZE_MAP_CODE_BEGIN(NOTIFY_NEW_COMPACT_BLOCK::request)
+  KV_SERIALIZE(b)
+  KV_SERIALIZE_VAL_POD_AS_BLOB(block_hash)
+  KV_SERIALIZE(salt)
+  KV_SERIALIZE(short_ids)
+  KV_SERIALIZE(current_blockchain_height)
+KV_SERIALIZE_MAP_CODE_END()
+
+KV_SERIALIZE_MAP_CODE_BEGIN(NOTIFY_NEW_TX_HASHES::request)
+  KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txs)
+KV_SERIALIZE_MAP_CODE_END()
+
 KV_SERIALIZE_MAP_CODE_BEGIN(NOTIFY_UPTIME_PROOF::request)
   KV_SERIALIZE_N(snode_version[0], "snode_version_major")
   KV_SERIALIZE_N(snode_version[1], "snode_version_minor")
@@ -140,4 +160,188 @@ KV_SERIALIZE_MAP_CODE_END()
 
 // NOTIFY_NEW_SERVICE_NODE_VOTE::request implementation is in service_node_voting.cpp
 
+// Direct binary codecs for the messages that carry blocks and txs; these must stay in sync with
+// the KV_SERIALIZE maps above (the protocol_pack unit tests compare the two).
+
+namespace {
+
+using epee::serialization::direct_reader;
+using epee::serialization::direct_writer;
+using epee::serialization::SERIALIZE_TYPE_TAG;
+using epee::serialization::section;
+
+void load_blobs(direct_reader& in, uint8_t type, std::vector<blobdata>& blobs)
+{
+  size_t n = in.read_array(type, SERIALIZE_TYPE_TAG<std::string>);
+  blobs.clear();
+  blobs.reserve(std::min<size_t>(n, 4096));
+  while (n--)
+    blobs.emplace_back(in.read_array_string());
+}
+
+template <typename T>
+void load_objects(direct_reader& in, uint8_t type, std::vector<T>& objs)
+{
+  size_t n = in.read_array(type, SERIALIZE_TYPE_TAG<section>);
+  objs.clear();
+  objs.reserve(std::min<size_t>(n, 4096));
+  while (n--)
+    objs.emplace_back().load_direct(in, in.read_section_size());
+}
+
+void store_blobs(direct_writer& out, std::string_view name, const std::vector<blobdata>& blobs)
+{
+  out.begin_array(name, SERIALIZE_TYPE_TAG<std::string>, blobs.size());
+  for (auto& blob : blobs)
+    out.write_array_string(blob);
+}
+
+template <typename T>
+void store_objects(direct_writer& out, std::string_view name, const std::vector<T>& objs)
+{
+  out.begin_array(name, SERIALIZE_TYPE_TAG<section>, objs.size());
+  for (auto& obj : objs)
+    obj.store_direct(out);
+}
+
+// Rough serialized size, for reserving the output buffer up front
+size_t blob_bytes(const block_complete_entry& b)
+{
+  size_t bytes = 64 + b.block.size() + b.checkpoint.size() + b.blinks.size() * 256;
+  for (auto& tx : b.txs)
+    bytes += 4 + tx.size();
+  return bytes;
+}
+
+}
+
+void serializable_blink_metadata::load_direct(direct_reader& in, size_t count)
+{
+  uint64_t seen = 0;
+  while (count--)
+  {
+    auto name = in.read_name();
+    auto type = in.read_type();
+    if (name == "#") { in.once(seen, 0); in.read_pod_blob(type, tx_hash); }
+    else if (name == "h") { in.once(seen, 1); height = in.read_integer<uint64_t>(type); }
+    else if (name == "q") { in.once(seen, 2); in.read_pod_blob_container(type, quorum); }
+    else if (name == "p") { in.once(seen, 3); in.read_pod_blob_container(type, position); }
+    else if (name == "s") { in.once(seen, 4); in.read_pod_blob_container(type, signature); }
+    else in.skip(type);
+  }
+}
+
+void serializable_blink_metadata::store_direct(direct_writer& out) const
+{
+  out.begin_section(2 + !position.empty() + !quorum.empty() + !signature.empty());
+  out.write_pod_blob("#", tx_hash);
+  out.write_integer("h", height);
+  if (!position.empty()) out.write_pod_blob_container("p", position);
+  if (!quorum.empty()) out.write_pod_blob_container("q", quorum);
+  if (!signature.empty()) out.write_pod_blob_container("s", signature);
+}
+
+void block_complete_entry::load_direct(direct_reader& in, size_t count)
+{
+  uint64_t seen = 0;
+  while (count--)
+  {
+    auto name = in.read_name();
+    auto type = in.read_type();
+    if (name == "block") { in.once(seen, 0); block = in.read_string(type); }
+    else if (name == "txs") { in.once(seen, 1); load_blobs(in, type, txs); }
+    else if (name == "checkpoint") { in.once(seen, 2); checkpoint = in.read_string(type); }
+    else if (name == "blinks") { in.once(seen, 3); load_objects(in, type, blinks); }
+    else in.skip(type);
+  }
+}
+
+void block_complete_entry::store_direct(direct_writer& out) const
+{
+  out.begin_section(2 + !blinks.empty() + !txs.empty());
+  if (!blinks.empty()) store_objects(out, "blinks", blinks);
+  out.write_string("block", block);
+  out.write_string("checkpoint", checkpoint);
+  if (!txs.empty()) store_blobs(out, "txs", txs);
+}
+
+void NOTIFY_NEW_TRANSACTIONS::request::load_direct(direct_reader& in, size_t count)
+{
+  uint64_t seen = 0;
+  requested = false;
+  while (count--)
+  {
+    auto name = in.read_name();
+    auto type = in.read_type();
+    if (name == "txs") { in.once(seen, 0); load_blobs(in, type, txs); }
+    else if (name == "blinks") { in.once(seen, 1); load_objects(in, type, blinks); }
+    else if (name == "requested") { in.once(seen, 2); requested = in.read_bool(type); }
+    else if (name == "_") { in.once(seen, 3); _ = in.read_string(type); }
+    else in.skip(type);
+  }
+}
+
+void NOTIFY_NEW_TRANSACTIONS::request::store_direct(direct_writer& out) const
+{
+  size_t bytes = _.size() + blinks.size() * 256;
+  for (auto& tx : txs)
+    bytes += 4 + tx.size();
+  out.reserve(bytes + 64);
+
+  out.begin_section(1 + !blinks.empty() + requested + !txs.empty());
+  out.write_string("_", _);
+  if (!blinks.empty()) store_objects(out, "blinks", blinks);
+  if (requested) out.write_bool("requested", requested);
+  if (!txs.empty()) store_blobs(out, "txs", txs);
+}
+
+void NOTIFY_RESPONSE_GET_BLOCKS::request::load_direct(direct_reader& in, size_t count)
+{
+  uint64_t seen = 0;
+  while (count--)
+  {
+    auto name = in.read_name();
+    auto type = in.read_type();
+    if (name == "blocks") { in.once(seen, 0); load_objects(in, type, blocks); }
+    else if (name == "missed_ids") { in.once(seen, 1); in.read_pod_blob_container(type, missed_ids); }
+    else if (name == "current_blockchain_height") { in.once(seen, 2); current_blockchain_height = in.read_integer<uint64_t>(type); }
+    else in.skip(type);
+  }
+}
+
+void NOTIFY_RESPONSE_GET_BLOCKS::request::store_direct(direct_writer& out) const
+{
+  size_t bytes = missed_ids.size() * sizeof(crypto::hash);
+  for (auto& b : blocks)
+    bytes += blob_bytes(b);
+  out.reserve(bytes + 64);
+
+  out.begin_section(1 + !blocks.empty() + !missed_ids.empty());
+  if (!blocks.empty()) store_objects(out, "blocks", blocks);
+  out.write_integer("current_blockchain_height", current_blockchain_height);
+  if (!missed_ids.empty()) out.write_pod_blob_container("missed_ids", missed_ids);
+}
+
+void NOTIFY_NEW_FLUFFY_BLOCK::request::load_direct(direct_reader& in, size_t count)
+{
+  uint64_t seen = 0;
+  while (count--)
+  {
+    auto name = in.read_name();
+    auto type = in.read_type();
+    if (name == "b") { in.once(seen, 0); b.load_direct(in, in.read_section(type)); }
+    else if (name == "current_blockchain_height") { in.once(seen, 1); current_blockchain_height = in.read_integer<uint64_t>(type); }
+    else in.skip(type);
+  }
+}
+
+void NOTIFY_NEW_FLUFFY_BLOCK::request::store_direct(direct_writer& out) const
+{
+  out.reserve(blob_bytes(b) + 64);
+  out.begin_section(2);
+  out.begin_object("b");
+  b.store_direct(out);
+  out.write_integer("current_blockchain_height", current_blockchain_height);
+}
+
 }
@@ -32,6 +32,7 @@
 
 #include <list>
 #include "epee/serialization/keyvalue_serialization.h"
+#include "epee/storages/portable_storage_direct.h"
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "epee/net/net_utils_base.h"
 #include "cryptonote_basic/blobdatatype.h"
@@ -93,6 +94,10 @@ namespace cryptonote
 
     uint8_t address_type;
 
+    uint64_t span_blocks; // blocks per span we currently request from this peer
+    uint64_t span_rate; // moving average of the rate this peer's spans arrive at, in bytes/s
+    std::chrono::milliseconds rtt; // shortest request round trip seen to this peer
+
     KV_MAP_SERIALIZABLE
   };
 
@@ -107,6 +112,7 @@ namespace cryptonote
     std::vector<uint8_t> position;
     std::vector<crypto::signature> signature;
     KV_MAP_SERIALIZABLE
+    KV_MAP_DIRECT_BINARY
   };
 
   /************************************************************************/
@@ -120,6 +126,7 @@ namespace cryptonote
     blobdata checkpoint;
     std::vector<serializable_blink_metadata> blinks;
     KV_MAP_SERIALIZABLE
+    KV_MAP_DIRECT_BINARY
   };
 
   /************************************************************************/
@@ -137,6 +144,7 @@ namespace cryptonote
       std::string _; // padding
 
       KV_MAP_SERIALIZABLE
+      KV_MAP_DIRECT_BINARY
     };
   };
   /************************************************************************/
@@ -165,6 +173,7 @@ namespace cryptonote
       uint64_t                           current_blockchain_height;
 
       KV_MAP_SERIALIZABLE
+      KV_MAP_DIRECT_BINARY
     };
   };
 
@@ -222,6 +231,7 @@ namespace cryptonote
       uint64_t current_blockchain_height;
 
       KV_MAP_SERIALIZABLE
+      KV_MAP_DIRECT_BINARY
     };
   };  
 
@@ -333,4 +343,43 @@ namespace cryptonote
       KV_MAP_SERIALIZABLE
     };
   };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  // A NOTIFY_NEW_FLUFFY_BLOCK for peers with P2P_SUPPORT_FLAG_COMPACT_BLOCKS: the block's tx hashes
+  // are replaced by short ids (see compact_block.h), which the receiver resolves against its pool.
+  // Txs it can't resolve are requested with NOTIFY_REQUEST_FLUFFY_MISSING_TX, which is answered
+  // with a regular fluffy block.
+  struct NOTIFY_NEW_COMPACT_BLOCK
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 17;
+    struct request
+    {
+      block_complete_entry b; // b.block has its tx_hashes removed
+      crypto::hash block_hash;
+      uint64_t salt;
+      std::string short_ids;  // compact_block::SHORT_ID_SIZE bytes per tx, in block order
+      uint64_t current_blockchain_height;
+
+      KV_MAP_SERIALIZABLE
+    };
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  // Announces new txs by hash, instead of sending them in full, to peers with
+  // P2P_SUPPORT_FLAG_TX_ANNOUNCE; the peer requests the ones it doesn't have yet with
+  // NOTIFY_REQUEST_GET_TXS (from just one of the peers announcing them).
+  struct NOTIFY_NEW_TX_HASHES
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 18;
+    struct request
+    {
+      std::vector<crypto::hash> txs;
+
+      KV_MAP_SERIALIZABLE
+    };
+  };
 }
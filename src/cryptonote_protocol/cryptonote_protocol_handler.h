@@ -36,7 +36,10 @@
 
 #include <boost/program_options/variables_map.hpp>
 #include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <string>
+#include <thread>
 #include <unordered_map>
 
 #include "common/periodic_task.h"
@@ -55,6 +58,7 @@ DISABLE_VS_WARNINGS(4355)
 
 #define CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT 500
 #define CURRENCY_PROTOCOL_MAX_TXS_REQUEST_COUNT 5000
+#define CURRENCY_PROTOCOL_MAX_QUEUED_TX_NOTIFICATIONS 100
 
 namespace cryptonote
 {
@@ -68,7 +72,7 @@ namespace cryptonote
 
     t_cryptonote_protocol_handler(t_core& rcore, bool offline = false);
 
-    virtual ~t_cryptonote_protocol_handler() = default;
+    virtual ~t_cryptonote_protocol_handler() { stop_tx_verify_threads(); }
 
     BEGIN_INVOKE_MAP2(cryptonote_protocol_handler)
       HANDLE_NOTIFY_T2(NOTIFY_NEW_TRANSACTIONS, handle_notify_new_transactions)
@@ -79,6 +83,8 @@ namespace cryptonote
       HANDLE_NOTIFY_T2(NOTIFY_RESPONSE_CHAIN_ENTRY, handle_response_chain_entry)
       HANDLE_NOTIFY_T2(NOTIFY_NEW_FLUFFY_BLOCK, handle_notify_new_fluffy_block)
       HANDLE_NOTIFY_T2(NOTIFY_REQUEST_FLUFFY_MISSING_TX, handle_request_fluffy_missing_tx)
+      HANDLE_NOTIFY_T2(NOTIFY_NEW_COMPACT_BLOCK, handle_notify_new_compact_block)
+      HANDLE_NOTIFY_T2(NOTIFY_NEW_TX_HASHES, handle_notify_new_tx_hashes)
       HANDLE_NOTIFY_T2(NOTIFY_UPTIME_PROOF, handle_uptime_proof)
       HANDLE_NOTIFY_T2(NOTIFY_BTENCODED_UPTIME_PROOF, handle_btencoded_uptime_proof)
       HANDLE_NOTIFY_T2(NOTIFY_NEW_SERVICE_NODE_VOTE, handle_notify_new_service_node_vote)
@@ -118,6 +124,8 @@ namespace cryptonote
     int handle_response_chain_entry(int command, NOTIFY_RESPONSE_CHAIN_ENTRY::request& arg, cryptonote_connection_context& context);
     int handle_notify_new_fluffy_block(int command, NOTIFY_NEW_FLUFFY_BLOCK::request& arg, cryptonote_connection_context& context);
     int handle_request_fluffy_missing_tx(int command, NOTIFY_REQUEST_FLUFFY_MISSING_TX::request& arg, cryptonote_connection_context& context);
+    int handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context);
+    int handle_notify_new_tx_hashes(int command, NOTIFY_NEW_TX_HASHES::request& arg, cryptonote_connection_context& context);
     int handle_uptime_proof(int command, NOTIFY_UPTIME_PROOF::request& arg, cryptonote_connection_context& context);
     int handle_btencoded_uptime_proof(int command, NOTIFY_BTENCODED_UPTIME_PROOF::request& arg, cryptonote_connection_context& context);
     int handle_notify_new_service_node_vote(int command, NOTIFY_NEW_SERVICE_NODE_VOTE::request& arg, cryptonote_connection_context& context);
@@ -163,13 +171,23 @@ namespace cryptonote
     size_t get_synchronizing_connections_count();
     bool on_connection_synchronized();
     bool should_download_next_span(cryptonote_connection_context& context, bool standby);
+    double get_best_span_rate(const cryptonote_connection_context& except);
+    bool hand_over_next_span(cryptonote_connection_context& context);
     void drop_connection(cryptonote_connection_context &context, bool add_fail, bool flush_all_spans);
     bool kick_idle_peers();
     bool check_standby_peers();
     bool update_sync_search();
+    bool expire_announced_tx_requests();
+    bool forget_announced_tx_request(const crypto::hash& tx_hash);
     int try_add_next_blocks(cryptonote_connection_context &context);
     void notify_new_stripe(cryptonote_connection_context &context, uint32_t stripe);
     void skip_unneeded_hashes(cryptonote_connection_context& context, bool check_block_queue) const;
+    // Verifies, adds and relays the txes (and blinks) of a NOTIFY_NEW_TRANSACTIONS; returns false if
+    // the sender should be dropped.  `context` is only used for logging and as the relay exclusion,
+    // and so can be a copy of the sender's context.
+    bool process_new_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& context, bool syncing);
+    void tx_verify_worker();
+    void stop_tx_verify_threads();
 
     t_core& m_core;
 
@@ -184,6 +202,25 @@ namespace cryptonote
     tools::periodic_task m_idle_peer_kicker{30s};
     tools::periodic_task m_standby_checker{100ms};
     tools::periodic_task m_sync_search_checker{101s};
+    tools::periodic_task m_announced_tx_request_expirer{30s};
+    // Announced txs we have requested (from the first peer announcing them), and when
+    std::mutex m_announced_tx_requests_lock;
+    std::unordered_map<crypto::hash, std::chrono::steady_clock::time_point> m_announced_tx_requests;
+    // Incoming NOTIFY_NEW_TRANSACTIONS waiting for the tx verification threads, so that checking
+    // them doesn't hold up the p2p thread they arrived on.  The queue is bounded: once it is full
+    // the txes are verified on the receiving thread, which stops further reads from that peer until
+    // they are done.
+    struct queued_txs
+    {
+      NOTIFY_NEW_TRANSACTIONS::request arg;
+      cryptonote_connection_context context; // copy of the sender's context when it was queued
+      bool syncing;
+    };
+    std::mutex m_tx_verify_lock;
+    std::condition_variable m_tx_verify_cv;
+    std::deque<queued_txs> m_tx_verify_queue;
+    std::vector<std::thread> m_tx_verify_threads;
+    bool m_tx_verify_stop = true; // true when not running verification threads
     std::atomic<unsigned int> m_max_out_peers;
     tools::PerformanceTimer m_sync_timer, m_add_timer;
     uint64_t m_last_add_end_time;
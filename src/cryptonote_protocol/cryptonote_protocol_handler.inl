@@ -47,12 +47,14 @@
 #include "cryptonote_basic/verification_context.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "cryptonote_core/tx_pool.h"
+#include "compact_block.h"
 #include "epee/profile_tools.h"
 #include "epee/net/network_throttle-detail.hpp"
 #include "common/pruning.h"
 #include "common/random.h"
 #include "common/lock.h"
 #include "common/util.h"
+#include "common/string_util.h"
 
 #undef OXEN_DEFAULT_LOG_CATEGORY
 #define OXEN_DEFAULT_LOG_CATEGORY "net.cn"
@@ -77,6 +79,7 @@ namespace cryptonote
 
   constexpr size_t BLOCK_QUEUE_NSPANS_THRESHOLD = 10; // chunks of N blocks
   constexpr size_t BLOCK_QUEUE_SIZE_THRESHOLD = 100*1024*1024; // bytes, i.e. 100 MB
+  constexpr size_t BLOCK_QUEUE_SPILL_SIZE_FACTOR = 4; // with spilling, how many times the threshold may be queued in total
   constexpr uint64_t BLOCK_QUEUE_FORCE_DOWNLOAD_NEAR_BLOCKS = 1000;
   constexpr auto REQUEST_NEXT_SCHEDULED_SPAN_THRESHOLD_STANDBY = 5s;
   constexpr auto REQUEST_NEXT_SCHEDULED_SPAN_THRESHOLD = 30s;
@@ -84,9 +87,47 @@ namespace cryptonote
   constexpr auto PASSIVE_PEER_KICK_TIME = 1min;
   constexpr auto DROP_ON_SYNC_WEDGE_THRESHOLD = 30s;
   constexpr auto LAST_ACTIVITY_STALL_THRESHOLD = 2s;
+  constexpr double SPAN_RATE_EWMA_WEIGHT = 0.3; // weight of the latest span in a peer's span rate
+  constexpr double SLOW_PEER_RATE_FACTOR = 4; // peers this many times slower than the best one are slow
+  constexpr uint32_t SLOW_PEER_DROP_SPANS = 5; // drop peers that stay slow for this many spans in a row
+  constexpr auto SPAN_TARGET_TIME = 2s; // size adaptive spans to take about this long to download...
+  constexpr double SPAN_TARGET_RTTS = 4; // ...or this many round trips to the peer, whichever is longer
+  constexpr size_t SPAN_MAX_BYTES = 16*1024*1024; // but never ask for more than this in one span
+  constexpr size_t SPAN_MIN_BLOCKS = 10;
 
   using seconds_f = std::chrono::duration<double>;
 
+  // Works out how many blocks to ask a peer for in its next span from how the last one (of
+  // `span_blocks` blocks and `span_bytes` bytes, which took `dt`) arrived: enough to keep the
+  // connection busy for SPAN_TARGET_TIME (or SPAN_TARGET_RTTS round trips, for distant peers) at the
+  // rate the peer can send, so that fast peers aren't held back by the per-request round trip while
+  // slow ones get short spans that don't cost much if they have to be abandoned.
+  inline size_t next_span_blocks(size_t prev_blocks, size_t span_blocks, size_t span_bytes, seconds_f dt, seconds_f rtt)
+  {
+    if (span_blocks == 0 || span_bytes == 0 || dt <= 0s)
+      return prev_blocks;
+    // Every request pays the round trip before any data arrives, so take that out of the rate (but
+    // don't let a stale rtt turn a single span into a huge bandwidth estimate).
+    const double transfer = std::max(dt.count() - rtt.count(), dt.count() / 4);
+    const double bandwidth = span_bytes / transfer;
+    const double avg_block_size = static_cast<double>(span_bytes) / span_blocks;
+    const double target = std::max(seconds_f{SPAN_TARGET_TIME}.count(), SPAN_TARGET_RTTS * rtt.count());
+
+    auto blocks = static_cast<size_t>(bandwidth * target / avg_block_size);
+    if (prev_blocks) // Move gradually so that one unusually fast or slow span doesn't swing it too far
+      blocks = std::clamp(blocks, prev_blocks / 2, prev_blocks * 2);
+    blocks = std::min(blocks, static_cast<size_t>(SPAN_MAX_BYTES / avg_block_size));
+    return std::clamp<size_t>(blocks, SPAN_MIN_BLOCKS, BLOCKS_SYNCHRONIZING_MAX_COUNT);
+  }
+
+  // Records a request round trip to the peer; we keep the shortest one seen as the peer's latency
+  // (longer ones include time spent sending the response or waiting on the peer).
+  inline void note_round_trip(cryptonote_connection_context& context, std::chrono::steady_clock::duration rtt)
+  {
+    if (context.m_rtt == 0s || rtt < context.m_rtt)
+      context.m_rtt = rtt;
+  }
+
   //-----------------------------------------------------------------------------------------------------------------------
   template<class t_core>
     t_cryptonote_protocol_handler<t_core>::t_cryptonote_protocol_handler(t_core& rcore, bool offline):m_core(rcore),
@@ -114,6 +155,16 @@ namespace cryptonote
     m_sync_download_objects_size = 0;
 
     m_block_download_max_size = command_line::get_arg(vm, cryptonote::arg_block_download_max_size);
+    if (command_line::get_arg(vm, cryptonote::arg_block_download_spill))
+      m_block_queue.set_spill(fs::u8path(command_line::get_arg(vm, cryptonote::arg_data_dir)),
+          m_block_download_max_size ? m_block_download_max_size : BLOCK_QUEUE_SIZE_THRESHOLD);
+
+    if (size_t threads = command_line::get_arg(vm, cryptonote::arg_tx_verify_threads); threads > 0 && m_tx_verify_threads.empty())
+    {
+      m_tx_verify_stop = false;
+      for (size_t i = 0; i < threads; ++i)
+        m_tx_verify_threads.emplace_back([this] { tx_verify_worker(); });
+    }
 
     return true;
   }
@@ -121,10 +172,55 @@ namespace cryptonote
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::deinit()
   {
+    stop_tx_verify_threads();
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::tx_verify_worker()
+  {
+    std::unique_lock lock{m_tx_verify_lock};
+    while (true)
+    {
+      m_tx_verify_cv.wait(lock, [this] { return m_tx_verify_stop || !m_tx_verify_queue.empty(); });
+      if (m_tx_verify_stop)
+        return;
+      auto queued = std::move(m_tx_verify_queue.front());
+      m_tx_verify_queue.pop_front();
+      lock.unlock();
+
+      try
+      {
+        if (!process_new_transactions(queued.arg, queued.context, queued.syncing))
+          m_p2p->for_connection(queued.context.m_connection_id, [this](cryptonote_connection_context& context, nodetool::peerid_type, uint32_t) {
+            drop_connection(context, false, false);
+            return true;
+          });
+      }
+      catch (const std::exception& e)
+      {
+        MERROR("Failed to handle queued NOTIFY_NEW_TRANSACTIONS: " << e.what());
+      }
+
+      lock.lock();
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::stop_tx_verify_threads()
+  {
+    {
+      std::lock_guard lock{m_tx_verify_lock};
+      m_tx_verify_stop = true;
+      m_tx_verify_queue.clear();
+    }
+    m_tx_verify_cv.notify_all();
+    for (auto& t : m_tx_verify_threads)
+      t.join();
+    m_tx_verify_threads.clear();
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   void t_cryptonote_protocol_handler<t_core>::set_p2p_endpoint(nodetool::i_p2p_endpoint<connection_context>* p2p)
   {
     if(p2p)
@@ -326,6 +422,10 @@ namespace cryptonote
       cnx.pruning_seed = cntxt.m_pruning_seed;
       cnx.address_type = (uint8_t)cntxt.m_remote_address.get_type_id();
 
+      cnx.span_blocks = cntxt.m_span_blocks;
+      cnx.span_rate = cntxt.m_span_rate;
+      cnx.rtt = std::chrono::duration_cast<std::chrono::milliseconds>(cntxt.m_rtt);
+
       connections.push_back(cnx);
 
       return true;
@@ -846,6 +946,83 @@ namespace cryptonote
         
     return 1;
   }  
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_NEW_COMPACT_BLOCK " << arg.block_hash << " (height " << arg.current_blockchain_height << ", "
+        << arg.short_ids.size() / compact_block::SHORT_ID_SIZE << " txes, " << arg.b.txs.size() << " prefilled)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+    if(!is_synchronized() || m_no_sync)
+    {
+      LOG_DEBUG_CC(context, "Received new compact block while syncing, ignored");
+      return 1;
+    }
+
+    block b;
+    if (!parse_and_validate_block_from_blob(arg.b.block, b) || !b.tx_hashes.empty())
+    {
+      LOG_ERROR_CCONTEXT("sent wrong compact block: failed to parse block, or block has tx hashes, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    // Resolve the short ids against the pool and the txs the peer sent along with the block
+    std::vector<crypto::hash> candidates;
+    m_core.get_pool().get_transaction_hashes(candidates);
+    for (auto& tx_blob : arg.b.txs)
+    {
+      transaction tx;
+      crypto::hash tx_hash;
+      if (!parse_and_validate_tx_from_blob(tx_blob, tx, tx_hash))
+      {
+        LOG_ERROR_CCONTEXT("sent wrong compact block: failed to parse prefilled transaction, dropping connection");
+        drop_connection(context, false, false);
+        return 1;
+      }
+      candidates.push_back(tx_hash);
+    }
+
+    auto tx_hashes = compact_block::resolve_short_ids(arg.salt, arg.short_ids, candidates);
+    if (!tx_hashes)
+    {
+      LOG_ERROR_CCONTEXT("sent wrong compact block: invalid short ids, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    std::vector<uint64_t> missing;
+    for (size_t i = 0; i < tx_hashes->size(); i++)
+      if ((*tx_hashes)[i] == crypto::null_hash)
+        missing.push_back(i);
+
+    b.tx_hashes = std::move(*tx_hashes);
+    // If we resolved everything but got the wrong block then some short id matched a different tx
+    // of ours; there's no telling which, so we request the block with its full tx hashes instead
+    // (by asking for no txs).
+    if (missing.empty() && get_block_hash(b) != arg.block_hash)
+      MDEBUG("Compact block " << arg.block_hash << " reconstructed with a short id collision, requesting full block");
+    else if (missing.empty())
+    {
+      MDEBUG("Reconstructed compact block " << arg.block_hash << " from the pool");
+      NOTIFY_NEW_FLUFFY_BLOCK::request fluffy{};
+      fluffy.b = std::move(arg.b);
+      fluffy.b.block = block_to_blob(b);
+      fluffy.current_blockchain_height = arg.current_blockchain_height;
+      return handle_notify_new_fluffy_block(NOTIFY_NEW_FLUFFY_BLOCK::ID, fluffy, context);
+    }
+
+    // The peer answers this with a fluffy block containing the txs we asked for (or, with no
+    // indices, just the block), which handle_notify_new_fluffy_block then takes from there.
+    NOTIFY_REQUEST_FLUFFY_MISSING_TX::request missing_tx_req;
+    missing_tx_req.block_hash = arg.block_hash;
+    missing_tx_req.current_blockchain_height = arg.current_blockchain_height;
+    missing_tx_req.missing_tx_indices = std::move(missing);
+    MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_FLUFFY_MISSING_TX: missing_tx_indices.size()=" << missing_tx_req.missing_tx_indices.size());
+    post_notify<NOTIFY_REQUEST_FLUFFY_MISSING_TX>(missing_tx_req, context);
+    return 1;
+  }
   //------------------------------------------------------------------------------------------------------------------------  
   template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_uptime_proof(int command, NOTIFY_UPTIME_PROOF::request& arg, cryptonote_connection_context& context)
@@ -894,21 +1071,11 @@ namespace cryptonote
     // submitted automatically by the daemon itself instead of
     // using my own proof relayed by other nodes.
 
+    //
+    // The proofs are handled (and relayed, back to the sender too, so that it knows we got it) in
+    // batches by the core; see core::flush_uptime_proofs().
     (void)context;
-    bool my_uptime_proof_confirmation = false;
-
-    if (m_core.handle_btencoded_uptime_proof(arg, my_uptime_proof_confirmation))
-    {
-      if (!my_uptime_proof_confirmation)
-      {
-        // NOTE: The default exclude context contains the peer who sent us this
-        // uptime proof, we want to ensure we relay it back so they know that the
-        // peer they relayed to received their uptime and confirm it, so send in an
-        // empty context so we don't omit the source peer from the relay back.
-        cryptonote_connection_context empty_context = {};
-        relay_btencoded_uptime_proof(arg, empty_context);
-      }
-    }
+    m_core.queue_btencoded_uptime_proof(std::move(arg));
     return 1;
   }
 
@@ -1077,6 +1244,27 @@ namespace cryptonote
       return 1;
     }
 
+    {
+      std::unique_lock lock{m_tx_verify_lock};
+      if (!m_tx_verify_stop && m_tx_verify_queue.size() < CURRENCY_PROTOCOL_MAX_QUEUED_TX_NOTIFICATIONS)
+      {
+        m_tx_verify_queue.push_back({std::move(arg), context, syncing});
+        lock.unlock();
+        m_tx_verify_cv.notify_one();
+        return 1;
+      }
+    }
+
+    // No verification threads, or they are backed up: verify them here, which holds up reading
+    // anything more from this peer until we're done.
+    if (!process_new_transactions(arg, context, syncing))
+      drop_connection(context, false, false);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::process_new_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& context, bool syncing)
+  {
     bool bad_blinks = false;
     auto parsed_blinks = m_core.parse_incoming_blinks(arg.blinks);
     auto &blinks = parsed_blinks.first;
@@ -1107,7 +1295,12 @@ namespace cryptonote
       auto &unknown_txs = parsed_blinks.second;
       for (size_t i = 0; i < arg.txs.size(); ++i)
       {
-        if (parsed_txs[i].tvc.m_should_be_relayed)
+        // If this is a response to a request for txes that we sent (.requested) then don't relay
+        // them on to our peers because they probably already have them: we just missed them
+        // somehow.  The exception are txs we requested because a peer announced them to us
+        // (NOTIFY_NEW_TX_HASHES), which are new to the network and need relaying as usual.
+        bool relay = !arg.requested || forget_announced_tx_request(parsed_txs[i].tx_hash);
+        if (relay && parsed_txs[i].tvc.m_should_be_relayed)
           newtxs.push_back(std::move(arg.txs[i]));
 
         if (parsed_txs[i].tvc.m_added_to_pool || parsed_txs[i].already_have)
@@ -1143,9 +1336,7 @@ namespace cryptonote
       }
     }
 
-    // If this is a response to a request for txes that we sent (.requested) then don't relay this
-    // on to our peers because they probably already have it: we just missed it somehow.
-    if(arg.txs.size() && !arg.requested)
+    if(arg.txs.size())
     {
       //TODO: add announce usage here
       relay_transactions(arg, context);
@@ -1157,10 +1348,10 @@ namespace cryptonote
     if (!syncing && (!all_okay || bad_blinks))
     {
       LOG_PRINT_CCONTEXT_L1((!all_okay && bad_blinks ? "Tx and Blink" : !all_okay ? "Tx" : "Blink") << " verification(s) failed, dropping connection");
-      drop_connection(context, false, false);
+      return false;
     }
 
-    return 1;
+    return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
@@ -1310,8 +1501,31 @@ namespace cryptonote
       // add that new span to the block queue
       seconds_f dt = now - request_time;
       const double rate = size / dt.count();
+      const size_t nblocks = arg.blocks.size();
       MDEBUG(context << " adding span: " << arg.blocks.size() << " at height " << start_height << ", " << dt.count() << " seconds, " << (rate/1024) << " kB/s, size now " << (m_block_queue.get_data_size() + blocks_size) / 1048576.f << " MB");
-      m_block_queue.add_blocks(start_height, arg.blocks, context.m_connection_id, rate, blocks_size);
+      m_block_queue.add_blocks(start_height, std::move(arg.blocks), context.m_connection_id, rate, blocks_size);
+
+      context.m_span_rate = context.m_span_rate > 0
+        ? SPAN_RATE_EWMA_WEIGHT * rate + (1 - SPAN_RATE_EWMA_WEIGHT) * context.m_span_rate
+        : rate;
+      note_round_trip(context, now - request_time);
+      if (m_core.get_block_sync_size(start_height) == 0)
+      {
+        context.m_span_blocks = next_span_blocks(context.m_span_blocks, nblocks, blocks_size, dt, context.m_rtt);
+        MDEBUG(context << " next span size " << context.m_span_blocks << " blocks (rtt " << tools::friendly_duration(context.m_rtt) << ")");
+      }
+      const double best_rate = get_best_span_rate(context);
+      if (context.m_span_rate * SLOW_PEER_RATE_FACTOR < best_rate)
+        ++context.m_slow_spans;
+      else
+        context.m_slow_spans = 0;
+      if (context.m_slow_spans >= SLOW_PEER_DROP_SPANS && !context.m_anchor)
+      {
+        MDEBUG(context << " dropping slow peer: " << context.m_span_rate / 1024 << " kB/s for the last " << context.m_slow_spans
+            << " spans, vs " << best_rate / 1024 << " kB/s for the best peer");
+        drop_connection(context, false, false);
+        return 1;
+      }
 
       const crypto::hash last_block_hash = cryptonote::get_block_hash(b);
       context.m_last_known_hash = last_block_hash;
@@ -1405,14 +1619,15 @@ namespace cryptonote
         {
           const uint64_t previous_height = m_core.get_current_blockchain_height();
           uint64_t start_height;
-          std::vector<cryptonote::block_complete_entry> blocks;
+          block_queue::span_blocks span_blocks;
           boost::uuids::uuid span_connection_id;
-          if (!m_block_queue.get_next_span(start_height, blocks, span_connection_id))
+          if (!m_block_queue.get_next_span(start_height, span_blocks, span_connection_id))
           {
             MDEBUG(context << " no next span found, going back to download");
             break;
           }
 
+          const std::vector<cryptonote::block_complete_entry> &blocks = *span_blocks;
           if (blocks.empty())
           {
             MERROR(context << "Next span has no blocks");
@@ -1526,6 +1741,13 @@ namespace cryptonote
               return 1;
             }
 
+            // Overlap the PoW hashing of the next span (if we already have it) with adding this one
+            {
+              block_queue::span_blocks next_blocks;
+              if (!pblocks.empty() && m_block_queue.get_filled_span_at(start_height + blocks.size(), next_blocks))
+                m_core.precompute_block_longhashes(start_height + blocks.size(), *next_blocks);
+            }
+
             uint64_t block_process_time_full = 0, transactions_process_time_full = 0;
             size_t num_txs = 0, blockidx = 0;
             for(const block_complete_entry& block_entry: blocks)
@@ -1734,11 +1956,84 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_new_tx_hashes(int command, NOTIFY_NEW_TX_HASHES::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_NEW_TX_HASHES (" << arg.txs.size() << " txes)");
+
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    if(!is_synchronized() || m_no_sync)
+    {
+      LOG_DEBUG_CC(context, "Received new tx hashes while syncing, ignored");
+      return 1;
+    }
+
+    if (arg.txs.size() > CURRENCY_PROTOCOL_MAX_TXS_REQUEST_COUNT)
+    {
+      LOG_ERROR_CCONTEXT(
+          "Announced txs count is too big (" << arg.txs.size() << ") expected not more than " << CURRENCY_PROTOCOL_MAX_TXS_REQUEST_COUNT);
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    auto in_pool = m_core.get_pool().have_txs(arg.txs);
+    auto& blockchain = m_core.get_blockchain_storage();
+
+    // Request what we don't have, unless another peer announced it first and should be sending it
+    NOTIFY_REQUEST_GET_TXS::request req;
+    {
+      const auto now = std::chrono::steady_clock::now();
+      std::lock_guard lock{m_announced_tx_requests_lock};
+      for (size_t i = 0; i < arg.txs.size(); i++)
+      {
+        if (in_pool[i] || blockchain.have_tx(arg.txs[i]))
+          continue;
+        auto [it, inserted] = m_announced_tx_requests.emplace(arg.txs[i], now);
+        if (!inserted && now - it->second < std::chrono::seconds{CRYPTONOTE_TX_ANNOUNCE_REQUEST_TIMEOUT})
+          continue;
+        it->second = now;
+        req.txs.push_back(arg.txs[i]);
+      }
+    }
+
+    if (!req.txs.empty())
+    {
+      MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_GET_TXS: txs[" << req.txs.size() << "] (announced)");
+      post_notify<NOTIFY_REQUEST_GET_TXS>(req, context);
+    }
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::forget_announced_tx_request(const crypto::hash& tx_hash)
+  {
+    std::lock_guard lock{m_announced_tx_requests_lock};
+    return m_announced_tx_requests.erase(tx_hash) > 0;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::expire_announced_tx_requests()
+  {
+    const auto expiry = std::chrono::steady_clock::now() - std::chrono::seconds{CRYPTONOTE_TX_ANNOUNCE_REQUEST_TIMEOUT};
+    std::lock_guard lock{m_announced_tx_requests_lock};
+    for (auto it = m_announced_tx_requests.begin(); it != m_announced_tx_requests.end(); )
+    {
+      if (it->second < expiry)
+        it = m_announced_tx_requests.erase(it);
+      else
+        ++it;
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::on_idle()
   {
     m_idle_peer_kicker.do_call([this] { return kick_idle_peers(); });
     m_standby_checker.do_call([this] { return check_standby_peers(); });
     m_sync_search_checker.do_call([this] { return update_sync_search(); });
+    m_announced_tx_request_expirer.do_call([this] { return expire_announced_tx_requests(); });
     return m_core.on_idle();
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -1781,6 +2076,9 @@ skip:
     {
       if (!peer_id || context.m_is_income) // only consider connected outgoing peers
         return true;
+      // Tor/I2P peers are there to relay our txs: rotating them would only cost us a new circuit
+      if (context.m_remote_address.get_zone() != epee::net_utils::zone::public_)
+        return true;
       if (context.m_state == cryptonote_connection_context::state_synchronizing)
         ++n_syncing;
       if (context.m_state == cryptonote_connection_context::state_normal)
@@ -1906,6 +2204,13 @@ skip:
                     );
               multiplier = std::min(max_multiplier, std::max(min_multiplier, multiplier));
             }
+            if (ctx.m_span_rate > 0 && context.m_span_rate > ctx.m_span_rate * SLOW_PEER_RATE_FACTOR)
+            {
+              MDEBUG(context << " we should download it as the downloading peer is slow (span rate " << ctx.m_span_rate
+                  << " vs our " << context.m_span_rate << ")");
+              download = true;
+              return true;
+            }
             if (dl_speed * .8f > ctx.m_current_speed_down * multiplier)
             {
               MDEBUG(context << " we should download it as we are substantially faster (" << dl_speed << " vs "
@@ -1932,6 +2237,63 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  double t_cryptonote_protocol_handler<t_core>::get_best_span_rate(const cryptonote_connection_context& except)
+  {
+    double best = 0;
+    m_p2p->for_each_connection([&](cryptonote_connection_context& ctx, nodetool::peerid_type peer_id, uint32_t support_flags)->bool{
+      if (ctx.m_connection_id != except.m_connection_id &&
+          (ctx.m_state == cryptonote_connection_context::state_synchronizing || ctx.m_state == cryptonote_connection_context::state_standby))
+        best = std::max(best, ctx.m_span_rate);
+      return true;
+    });
+    return best;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  // Called when a peer is about to take the span the block queue is waiting on: if it's slow and a
+  // much faster peer is idling in standby, wakes the faster one to download it instead.
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::hand_over_next_span(cryptonote_connection_context& context)
+  {
+    if (context.m_span_rate <= 0)
+      return false; // give peers we don't know yet a chance
+    const uint64_t next_height = m_block_queue.get_next_needed_height(m_core.get_current_blockchain_height());
+    std::optional<boost::uuids::uuid> fastest;
+    double fastest_rate = context.m_span_rate * SLOW_PEER_RATE_FACTOR;
+    m_p2p->for_each_connection([&](cryptonote_connection_context& ctx, nodetool::peerid_type peer_id, uint32_t support_flags)->bool{
+      if (ctx.m_connection_id != context.m_connection_id &&
+          ctx.m_state == cryptonote_connection_context::state_standby &&
+          ctx.m_callback_request_count == 0 &&
+          ctx.m_span_rate > fastest_rate &&
+          ctx.m_remote_blockchain_height > next_height &&
+          tools::has_unpruned_block(next_height, ctx.m_remote_blockchain_height, ctx.m_pruning_seed))
+      {
+        fastest = ctx.m_connection_id;
+        fastest_rate = ctx.m_span_rate;
+      }
+      return true;
+    });
+    if (!fastest)
+      return false;
+
+    // it may have woken up or gone away meanwhile, in which case we take the span after all
+    bool woken = false;
+    m_p2p->for_connection(*fastest, [&](cryptonote_connection_context& ctx, nodetool::peerid_type peer_id, uint32_t support_flags)->bool{
+      if (ctx.m_state == cryptonote_connection_context::state_standby && ctx.m_callback_request_count == 0)
+      {
+        ++ctx.m_callback_request_count;
+        m_p2p->request_callback(ctx);
+        woken = true;
+      }
+      return true;
+    });
+    if (!woken)
+      return false;
+
+    MDEBUG(context << " leaving the next span to a faster peer (span rate " << fastest_rate << " vs our " << context.m_span_rate << ")");
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::should_drop_connection(cryptonote_connection_context& context, uint32_t next_stripe)
   {
     if (context.m_anchor)
@@ -2028,7 +2390,9 @@ skip:
         const auto next_needed_pruning_stripe = get_next_needed_pruning_stripe();
         const uint32_t add_stripe = tools::get_pruning_stripe(bc_height, context.m_remote_blockchain_height, CRYPTONOTE_PRUNING_LOG_STRIPES);
         const uint32_t peer_stripe = tools::get_pruning_stripe(context.m_pruning_seed);
-        const size_t block_queue_size_threshold = m_block_download_max_size ? m_block_download_max_size : BLOCK_QUEUE_SIZE_THRESHOLD;
+        // Spans beyond the threshold go to disk when spilling, so we can queue more of them
+        const size_t block_queue_size_threshold = (m_block_download_max_size ? m_block_download_max_size : BLOCK_QUEUE_SIZE_THRESHOLD)
+          * (m_block_queue.spilling() ? BLOCK_QUEUE_SPILL_SIZE_FACTOR : 1);
         bool queue_proceed = nspans < BLOCK_QUEUE_NSPANS_THRESHOLD || size < block_queue_size_threshold;
         // get rid of blocks we already requested, or already have
         skip_unneeded_hashes(context, true);
@@ -2040,7 +2404,10 @@ skip:
           next_block_height = context.m_last_response_height - context.m_needed_objects.size() + 1;
         bool stripe_proceed_main = (add_stripe == 0 || peer_stripe == 0 || add_stripe == peer_stripe) && (next_block_height < bc_height + BLOCK_QUEUE_FORCE_DOWNLOAD_NEAR_BLOCKS || next_needed_height < bc_height + BLOCK_QUEUE_FORCE_DOWNLOAD_NEAR_BLOCKS);
         bool stripe_proceed_secondary = tools::has_unpruned_block(next_block_height, context.m_remote_blockchain_height, context.m_pruning_seed);
-        bool proceed = stripe_proceed_main || (queue_proceed && stripe_proceed_secondary);
+        // Spans near the chain tip are otherwise requested however much is queued: once over the
+        // threshold, only the span the chain needs next can go ahead.
+        const bool over_budget = size >= block_queue_size_threshold && next_block_height != next_needed_height;
+        bool proceed = (stripe_proceed_main && !over_budget) || (queue_proceed && stripe_proceed_secondary);
         if (!stripe_proceed_main && !stripe_proceed_secondary && should_drop_connection(context, tools::get_pruning_stripe(next_block_height, context.m_remote_blockchain_height, CRYPTONOTE_PRUNING_LOG_STRIPES)))
         {
           if (!context.m_is_income)
@@ -2048,7 +2415,7 @@ skip:
           return false; // drop outgoing connections
         }
 
-        MDEBUG(context << "proceed " << proceed << " (queue " << queue_proceed << ", stripe " << stripe_proceed_main << "/" <<
+        MDEBUG(context << "proceed " << proceed << " (queue " << queue_proceed << (over_budget ? ", over budget" : "") << ", stripe " << stripe_proceed_main << "/" <<
           stripe_proceed_secondary << "), " << next_needed_pruning_stripe.first << "-" << next_needed_pruning_stripe.second <<
           " needed, bc add stripe " << add_stripe << ", we have " << peer_stripe << "), bc_height " << bc_height);
         MDEBUG(context << "  - next_block_height " << next_block_height << ", seed " << epee::string_tools::to_string_hex(context.m_pruning_seed) <<
@@ -2133,7 +2500,9 @@ skip:
       NOTIFY_REQUEST_GET_BLOCKS::request req;
       bool is_next = false;
       size_t count = 0;
-      const size_t count_limit = m_core.get_block_sync_size(m_core.get_current_blockchain_height());
+      size_t count_limit = m_core.get_block_sync_size(m_core.get_current_blockchain_height());
+      if (count_limit == 0)
+        count_limit = context.m_span_blocks ? context.m_span_blocks : BLOCKS_SYNCHRONIZING_DEFAULT_COUNT;
       std::pair<uint64_t, uint64_t> span = std::make_pair(0, 0);
       if (force_next_span)
       {
@@ -2167,6 +2536,13 @@ skip:
         skip_unneeded_hashes(context, false);
 
         const uint64_t first_block_height = context.m_last_response_height - context.m_needed_objects.size() + 1;
+        if (!force_next_span && first_block_height <= m_block_queue.get_next_needed_height(m_core.get_current_blockchain_height())
+            && hand_over_next_span(context))
+        {
+          context.m_state = cryptonote_connection_context::state_standby;
+          MLOG_PEER_STATE("pausing");
+          return true;
+        }
         span = m_block_queue.reserve_span(first_block_height, context.m_last_response_height, count_limit, context.m_connection_id, context.m_pruning_seed, context.m_remote_blockchain_height, context.m_needed_objects);
         MDEBUG(context << " span from " << first_block_height << ": " << span.first << "/" << span.second);
         if (span.second > 0)
@@ -2277,7 +2653,7 @@ skip:
       if (sync)
       {
         uint64_t start_height;
-        std::vector<cryptonote::block_complete_entry> blocks;
+        block_queue::span_blocks blocks;
         boost::uuids::uuid span_connection_id;
         bool filled = false;
         if (m_block_queue.get_next_span(start_height, blocks, span_connection_id, filled) && filled)
@@ -2405,7 +2781,11 @@ skip:
       << ", m_start_height=" << arg.start_height << ", m_total_height=" << arg.total_height);
     MLOG_PEER_STATE("received chain");
 
-    context.m_last_request_time.reset();
+    if (context.m_last_request_time)
+    {
+      note_round_trip(context, std::chrono::steady_clock::now() - *context.m_last_request_time);
+      context.m_last_request_time.reset();
+    }
 
     m_sync_download_chain_size += arg.m_block_ids.size() * sizeof(crypto::hash);
 
@@ -2518,18 +2898,53 @@ skip:
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_FLUFFY_BLOCK::request& arg, cryptonote_connection_context& exclude_context)
   {
-    // sort peers between fluffy ones and others
-    std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> fluffyConnections;
-    m_p2p->for_each_connection([&exclude_context, &fluffyConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    // sort peers between compact block ones and others
+    std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> fluffyConnections, compactConnections;
+    m_p2p->for_each_connection([&exclude_context, &fluffyConnections, &compactConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
     {
       if (peer_id && exclude_context.m_connection_id != context.m_connection_id && context.m_remote_address.get_zone() == epee::net_utils::zone::public_)
       {
-        LOG_DEBUG_CC(context, "PEER FLUFFY BLOCKS - RELAYING THIN/COMPACT WHATEVER BLOCK");
-        fluffyConnections.push_back({context.m_remote_address.get_zone(), context.m_connection_id});
+        if (support_flags & P2P_SUPPORT_FLAG_COMPACT_BLOCKS)
+        {
+          LOG_DEBUG_CC(context, "PEER COMPACT BLOCKS - RELAYING COMPACT BLOCK");
+          compactConnections.push_back({context.m_remote_address.get_zone(), context.m_connection_id});
+        }
+        else
+        {
+          LOG_DEBUG_CC(context, "PEER FLUFFY BLOCKS - RELAYING THIN/COMPACT WHATEVER BLOCK");
+          fluffyConnections.push_back({context.m_remote_address.get_zone(), context.m_connection_id});
+        }
       }
       return true;
     });
 
+    if (!compactConnections.empty())
+    {
+      block b;
+      if (parse_and_validate_block_from_blob(arg.b.block, b))
+      {
+        NOTIFY_NEW_COMPACT_BLOCK::request compact{};
+        compact.block_hash = get_block_hash(b);
+        compact.salt = crypto::rand<uint64_t>();
+        compact.short_ids = compact_block::make_short_ids(compact.salt, b.tx_hashes);
+        b.tx_hashes.clear();
+        compact.b.block = block_to_blob(b);
+        compact.b.txs = arg.b.txs;
+        compact.current_blockchain_height = arg.current_blockchain_height;
+
+        std::string compactBlob;
+        epee::serialization::store_t_to_binary(compact, compactBlob);
+        m_p2p->relay_notify_to_list(NOTIFY_NEW_COMPACT_BLOCK::ID, epee::strspan<uint8_t>(compactBlob), std::move(compactConnections));
+      }
+      else
+      {
+        MERROR("relay_block called with an unparseable block, relaying it as a fluffy block");
+        fluffyConnections.insert(fluffyConnections.end(), compactConnections.begin(), compactConnections.end());
+      }
+    }
+    if (fluffyConnections.empty())
+      return true;
+
     std::string fluffyBlob;
     if (arg.b.txs.size())
     {
@@ -2610,8 +3025,13 @@ skip:
       }
     }
 
+    // Txs with blink signatures go out in full so that the signatures spread without a round trip;
+    // others are only announced to peers supporting that (if we have all their hashes).
+    if (!arg.blinks.empty() || std::find(relayed_txes.begin(), relayed_txes.end(), crypto::null_hash) != relayed_txes.end())
+      relayed_txes.clear();
+
     // no check for success, so tell core they're relayed unconditionally
-    m_p2p->send_txs(std::move(arg.txs), exclude_context.m_remote_address.get_zone(), exclude_context.m_connection_id, m_core.pad_transactions());
+    m_p2p->send_txs(std::move(arg.txs), exclude_context.m_remote_address.get_zone(), exclude_context.m_connection_id, m_core.pad_transactions(), std::move(relayed_txes));
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -2741,6 +3161,7 @@ skip:
   void t_cryptonote_protocol_handler<t_core>::stop()
   {
     m_stopping = true;
+    stop_tx_verify_threads();
     m_core.stop();
   }
 } // namespace
@@ -28,10 +28,12 @@
 
 #include "levin_notify.h"
 
+#include <algorithm>
 #include <boost/asio/steady_timer.hpp>
 #include <boost/system/system_error.hpp>
 #include <chrono>
 #include <deque>
+#include <map>
 #include <stdexcept>
 
 #include "common/expect.h"
@@ -60,6 +62,8 @@ namespace levin
     constexpr const std::chrono::seconds noise_min_delay{CRYPTONOTE_NOISE_MIN_DELAY};
     constexpr const std::chrono::seconds noise_delay_range{CRYPTONOTE_NOISE_DELAY_RANGE};
 
+    constexpr const std::chrono::milliseconds tx_announce_delay{CRYPTONOTE_TX_ANNOUNCE_DELAY};
+
     /*! Select a randomized duration from 0 to `range`. The precision will be to
         the systems `steady_clock`. As an example, supplying 3 seconds to this
         function will select a duration from [0, 3] seconds, and the increments
@@ -92,6 +96,21 @@ namespace levin
       return outs;
     }
 
+    //! \return (Slightly low) estimate of the serialized size of a `NOTIFY_NEW_TRANSACTIONS` of `txs`.
+    size_t tx_payload_size(const std::vector<blobdata>& txs)
+    {
+      size_t bytes = 9 /* header */ + 4 /* 1 + 'txs' */ + tools::get_varint_data(txs.size()).size();
+      for (const auto& tx : txs)
+        bytes += tools::get_varint_data(tx.size()).size() + tx.size();
+      return bytes;
+    }
+
+    //! \return Largest payload that `make_fragmented_notify` fits within `CRYPTONOTE_MAX_FRAGMENTS` noise messages.
+    constexpr size_t max_covert_payload(const size_t noise_size)
+    {
+      return CRYPTONOTE_MAX_FRAGMENTS * (noise_size - sizeof(epee::levin::bucket_head2)) - sizeof(epee::levin::bucket_head2);
+    }
+
     std::string make_tx_payload(std::vector<blobdata>&& txs, const bool pad)
     {
       NOTIFY_NEW_TRANSACTIONS::request request{};
@@ -99,9 +118,7 @@ namespace levin
 
       if (pad)
       {
-        size_t bytes = 9 /* header */ + 4 /* 1 + 'txs' */ + tools::get_varint_data(request.txs.size()).size();
-        for(auto tx_blob_it = request.txs.begin(); tx_blob_it!=request.txs.end(); ++tx_blob_it)
-          bytes += tools::get_varint_data(tx_blob_it->size()).size() + tx_blob_it->size();
+        size_t bytes = tx_payload_size(request.txs);
 
         // stuff some dummy bytes in to stay safe from traffic volume analysis
         static constexpr const size_t granularity = 1024;
@@ -161,11 +178,19 @@ namespace levin
        optimized further, it might be better to just use standard locks per
        channel. */
 
-    //! A queue of levin messages for a noise i2p/tor link
+    //! Txs from one `notify::send_txs` call, shared by every noise channel that queues them
+    struct covert_batch
+    {
+      std::shared_ptr<const std::vector<blobdata>> txs;
+      std::size_t size; //!< `tx_payload_size` of `txs`
+    };
+
+    //! A queue of txs for a noise i2p/tor link
     struct noise_channel
     {
       explicit noise_channel(boost::asio::io_service& io_service)
         : queue(),
+          active_batches(0),
           strand(io_service),
           next_noise(io_service),
           connection(boost::uuids::nil_uuid())
@@ -178,7 +203,8 @@ namespace levin
       // Only read/write these values "inside the strand"
 
       epee::shared_sv active;
-      std::deque<epee::shared_sv> queue;
+      std::deque<covert_batch> queue;
+      std::size_t active_batches; //!< Number of (leading) `queue` batches being sent in `active`
       boost::asio::io_service::strand strand;
       boost::asio::steady_timer next_noise;
       boost::uuids::uuid connection;
@@ -193,9 +219,11 @@ namespace levin
         : p2p(std::move(p2p)),
           noise(std::move(noise_in)),
           next_epoch(io_service),
+          next_announce(io_service),
           strand(io_service),
           map(),
           channels(),
+          announcements(),
           connection_count(0),
           is_public(is_public)
       {
@@ -206,9 +234,11 @@ namespace levin
       const std::shared_ptr<connections> p2p;
       const epee::shared_sv noise; //!< `!empty()` means zone is using noise channels
       boost::asio::steady_timer next_epoch;
+      boost::asio::steady_timer next_announce; //!< Only set in `strand`, while `announcements` is non-empty
       boost::asio::io_service::strand strand;
       net::dandelionpp::connection_map map;//!< Tracks outgoing uuid's for noise channels or Dandelion++ stems
       std::deque<noise_channel> channels;  //!< Never touch after init; only update elements on `noise_channel.strand`
+      std::map<boost::uuids::uuid, std::vector<crypto::hash>> announcements; //!< Tx hashes waiting to be announced to each connection; only touch in `strand`
       std::atomic<std::size_t> connection_count; //!< Only update in strand, can be read at any time
       const bool is_public;                      //!< Zone is public ipv4/ipv6 connections
     };
@@ -216,21 +246,21 @@ namespace levin
 
   namespace
   {
-    //! Adds a message to the sending queue of the channel.
+    //! Adds txs to the sending queue of the channel.
     class queue_covert_notify
     {
       std::shared_ptr<detail::zone> zone_;
-      epee::shared_sv message_; // Requires manual copy constructor
+      covert_batch batch_; // Requires manual copy constructor
       const std::size_t destination_;
 
     public:
-      queue_covert_notify(std::shared_ptr<detail::zone> zone, epee::shared_sv message, std::size_t destination)
-        : zone_(std::move(zone)), message_(std::move(message)), destination_(destination)
+      queue_covert_notify(std::shared_ptr<detail::zone> zone, covert_batch batch, std::size_t destination)
+        : zone_(std::move(zone)), batch_(std::move(batch)), destination_(destination)
       {}
 
       queue_covert_notify(queue_covert_notify&&) = default;
       queue_covert_notify(const queue_covert_notify& source)
-        : zone_(source.zone_), message_(source.message_), destination_(source.destination_)
+        : zone_(source.zone_), batch_(source.batch_), destination_(source.destination_)
       {}
 
       //! \pre Called within `zone_->channels[destionation_].strand`.
@@ -243,27 +273,59 @@ namespace levin
         assert(channel.strand.running_in_this_thread());
 
         if (!channel.connection.is_nil())
-          channel.queue.push_back(std::move(message_));
+          channel.queue.push_back(std::move(batch_));
         else if (destination_ == 0 && zone_->connection_count == 0)
           MWARNING("Unable to send transaction(s) over anonymity network - no available outbound connections");
       }
     };
 
-    //! Sends a message to every active connection
+    //! Sends the pending tx hash announcements of every connection
+    struct send_announcements
+    {
+      std::shared_ptr<detail::zone> zone_;
+
+      //! \pre Called within `zone_->strand`.
+      void operator()(boost::system::error_code error) const
+      {
+        if (!zone_ || !zone_->p2p)
+          return;
+
+        if (error && error != boost::system::errc::operation_canceled)
+          throw boost::system::system_error{error, "send_announcements timer failed"};
+
+        assert(zone_->strand.running_in_this_thread());
+
+        for (auto& [connection, hashes] : zone_->announcements)
+        {
+          NOTIFY_NEW_TX_HASHES::request request{};
+          request.txs = std::move(hashes);
+          std::string payload;
+          if (!epee::serialization::store_t_to_binary(request, payload))
+            throw std::runtime_error{"Failed to serialize to epee binary format"};
+          // fails (harmlessly) if the connection has gone away since
+          zone_->p2p->send(epee::shared_sv{epee::levin::make_notify(NOTIFY_NEW_TX_HASHES::ID, epee::strspan<std::uint8_t>(payload))}, connection);
+        }
+        zone_->announcements.clear();
+      }
+    };
+
+    //! Sends a message to every active connection, or (queues) just the tx hashes for those that
+    //! support tx announcements.
     class flood_notify
     {
       std::shared_ptr<detail::zone> zone_;
       epee::shared_sv message_; // Requires manual copy
       boost::uuids::uuid source_;
+      std::vector<crypto::hash> tx_hashes_;
 
     public:
-      explicit flood_notify(std::shared_ptr<detail::zone> zone, epee::shared_sv message, const boost::uuids::uuid& source)
-        : zone_(std::move(zone)), message_(message), source_(source)
+      explicit flood_notify(std::shared_ptr<detail::zone> zone, epee::shared_sv message, const boost::uuids::uuid& source, std::vector<crypto::hash> tx_hashes = {})
+        : zone_(std::move(zone)), message_(message), source_(source), tx_hashes_(std::move(tx_hashes))
       {}
 
       flood_notify(flood_notify&&) = default;
       flood_notify(const flood_notify& source)
-        : zone_(source.zone_), message_(source.message_), source_(source.source_)
+        : zone_(source.zone_), message_(source.message_), source_(source.source_), tx_hashes_(source.tx_hashes_)
       {}
 
       void operator()() const
@@ -279,19 +341,41 @@ namespace levin
            algorithm changes or the locking strategy within the levin config
            class changes. */
 
-        std::vector<boost::uuids::uuid> connections;
+        const bool announce = !tx_hashes_.empty();
+        std::vector<boost::uuids::uuid> connections, announce_connections;
         connections.reserve(connection_id_reserve_size);
-        zone_->p2p->foreach_connection([this, &connections] (detail::p2p_context& context) {
+        zone_->p2p->foreach_connection([this, announce, &connections, &announce_connections] (detail::p2p_context& context) {
           /* Only send to outgoing connections when "flooding" over i2p/tor.
              Otherwise this makes the tx linkable to a hidden service address,
              making things linkable across connections. */
           if (this->source_ != context.m_connection_id && (this->zone_->is_public || !context.m_is_income))
-            connections.emplace_back(context.m_connection_id);
+          {
+            if (announce && (context.support_flags & P2P_SUPPORT_FLAG_TX_ANNOUNCE))
+              announce_connections.emplace_back(context.m_connection_id);
+            else
+              connections.emplace_back(context.m_connection_id);
+          }
           return true;
         });
 
         for (const boost::uuids::uuid& connection : connections)
           zone_->p2p->send(message_, connection);
+
+        if (announce_connections.empty())
+          return;
+
+        // Batch the announcements, so that a burst of txs costs each peer one message
+        const bool timer_pending = !zone_->announcements.empty();
+        for (const boost::uuids::uuid& connection : announce_connections)
+        {
+          auto& hashes = zone_->announcements[connection];
+          hashes.insert(hashes.end(), tx_hashes_.begin(), tx_hashes_.end());
+        }
+        if (!timer_pending)
+        {
+          zone_->next_announce.expires_after(tx_announce_delay);
+          zone_->next_announce.async_wait(zone_->strand.wrap(send_announcements{zone_}));
+        }
       }
     };
 
@@ -322,6 +406,7 @@ namespace levin
 
         channel.connection = connection_;
         channel.active = {};
+        channel.active_batches = 0;
 
         if (connection_.is_nil())
           channel.queue.clear();
@@ -397,6 +482,48 @@ namespace levin
       std::shared_ptr<detail::zone> zone_;
       const std::size_t channel_;
 
+      /*! Combines as many queued batches as fit in one fragmented message into
+          `channel.active`, so that txs arriving between two sends cost the
+          link a single notification rather than one (padded) message each.
+
+          \pre Called within `channel.strand`, with `channel.active` empty. */
+      static void make_active(const detail::zone& zone, noise_channel& channel)
+      {
+        const std::size_t max_size = max_covert_payload(zone.noise.size());
+        while (!channel.queue.empty())
+        {
+          std::size_t count = 0, size = 0;
+          while (count < channel.queue.size() && (count == 0 || size + channel.queue[count].size <= max_size))
+            size += channel.queue[count++].size;
+
+          for (;;)
+          {
+            std::vector<blobdata> txs;
+            for (std::size_t i = 0; i < count; ++i)
+              txs.insert(txs.end(), channel.queue[i].txs->begin(), channel.queue[i].txs->end());
+            if (count > 1)
+              std::sort(txs.begin(), txs.end()); // don't leak the order they were queued in
+
+            const std::string payload = make_tx_payload(std::move(txs), false);
+            epee::shared_sv message{epee::levin::make_fragmented_notify(
+              zone.noise.view, NOTIFY_NEW_TRANSACTIONS::ID, epee::strspan<std::uint8_t>(payload)
+            )};
+            if (message.size() <= CRYPTONOTE_MAX_FRAGMENTS * zone.noise.size())
+            {
+              channel.active = std::move(message);
+              channel.active_batches = count;
+              return;
+            }
+            if (count == 1)
+              break;
+            count = 1; // size estimate was off; fall back to sending the oldest batch by itself
+          }
+
+          MERROR("Dropping queued transaction(s) exceeding covert fragment size");
+          channel.queue.pop_front();
+        }
+      }
+
       static void wait(const std::chrono::steady_clock::time_point start, std::shared_ptr<detail::zone> zone, const std::size_t index)
       {
         if (!zone)
@@ -425,25 +552,27 @@ namespace levin
 
         if (!channel.connection.is_nil())
         {
+          if (channel.active.view.empty())
+            make_active(*zone_, channel);
+
           epee::shared_sv message;
           if (!channel.active.view.empty())
             message = channel.active.extract_prefix(zone_->noise.size());
-          else if (!channel.queue.empty())
-          {
-            channel.active = channel.queue.front();
-            message = channel.active.extract_prefix(zone_->noise.size());
-          }
           else
             message = zone_->noise;
 
           if (zone_->p2p->send(std::move(message), channel.connection))
           {
-            if (!channel.queue.empty() && channel.active.view.empty())
-              channel.queue.pop_front();
+            if (channel.active_batches && channel.active.view.empty())
+            {
+              channel.queue.erase(channel.queue.begin(), channel.queue.begin() + channel.active_batches);
+              channel.active_batches = 0;
+            }
           }
           else
           {
             channel.active = {};
+            channel.active_batches = 0;
             channel.connection = boost::uuids::nil_uuid();
 
             auto connections = get_out_connections(*zone_->p2p);
@@ -540,13 +669,33 @@ namespace levin
       channel.next_noise.cancel();
   }
 
-  bool notify::send_txs(std::vector<blobdata> txs, const boost::uuids::uuid& source, const bool pad_txs)
+  bool notify::send_txs(std::vector<blobdata> txs, const boost::uuids::uuid& source, const bool pad_txs, std::vector<crypto::hash> tx_hashes)
   {
     if (!zone_)
       return false;
 
+    if (!tx_hashes.empty() && (tx_hashes.size() != txs.size() || !zone_->is_public || !zone_->noise.view.empty()))
+      tx_hashes.clear();
+
     if (zone_->is_public)
-        std::sort(txs.begin(), txs.end()); // don't leak receive order
+    {
+      // don't leak receive order
+      if (tx_hashes.empty())
+        std::sort(txs.begin(), txs.end());
+      else
+      {
+        std::vector<std::pair<blobdata, crypto::hash>> sorted;
+        sorted.reserve(txs.size());
+        for (size_t i = 0; i < txs.size(); ++i)
+          sorted.emplace_back(std::move(txs[i]), tx_hashes[i]);
+        std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        for (size_t i = 0; i < sorted.size(); ++i)
+        {
+          txs[i] = std::move(sorted[i].first);
+          tx_hashes[i] = sorted[i].second;
+        }
+      }
+    }
 
     if (!zone_->noise.view.empty() && !zone_->channels.empty())
     {
@@ -555,21 +704,21 @@ namespace levin
         CRYPTONOTE_MAX_FRAGMENTS * CRYPTONOTE_NOISE_BYTES <= LEVIN_DEFAULT_MAX_PACKET_SIZE, "most nodes will reject this fragment setting"
       );
 
-      // padding is not useful when using noise mode
-      const std::string payload = make_tx_payload(std::move(txs), false);
-      epee::shared_sv message{epee::levin::make_fragmented_notify(
-        zone_->noise.view, NOTIFY_NEW_TRANSACTIONS::ID, epee::strspan<std::uint8_t>(payload)
-      )};
-      if (CRYPTONOTE_MAX_FRAGMENTS * zone_->noise.size() < message.size())
+      /* The message itself is built by each channel when it next has room to
+         send, combining every batch queued since (padding is not useful when
+         using noise mode). */
+      covert_batch batch{nullptr, tx_payload_size(txs)};
+      if (max_covert_payload(zone_->noise.size()) < batch.size)
       {
         MERROR("notify::send_txs provided message exceeding covert fragment size");
         return false;
       }
+      batch.txs = std::make_shared<const std::vector<blobdata>>(std::move(txs));
 
       for (std::size_t channel = 0; channel < zone_->channels.size(); ++channel)
       {
         zone_->channels[channel].strand.dispatch(
-          queue_covert_notify{zone_, message, channel}
+          queue_covert_notify{zone_, batch, channel}
         );
       }
     }
@@ -580,7 +729,7 @@ namespace levin
         epee::levin::make_notify(NOTIFY_NEW_TRANSACTIONS::ID, epee::strspan<std::uint8_t>(payload))};
 
       // traditional monero send technique
-      zone_->strand.dispatch(flood_notify{zone_, std::move(message), source});
+      zone_->strand.dispatch(flood_notify{zone_, std::move(message), source, std::move(tx_hashes)});
     }
 
     return true;
@@ -35,6 +35,7 @@
 
 #include "epee/shared_sv.h"
 #include "cryptonote_basic/blobdatatype.h"
+#include "crypto/hash.h"
 #include "epee/net/enums.h"
 #include "epee/span.h"
 
@@ -124,9 +125,13 @@ namespace levin
         \param pad_txs A request to pad txs to help conceal origin via
           statistical analysis. Ignored if noise was enabled during
           construction.
+        \param tx_hashes The hashes of `txs`, in the same order. If given,
+          peers of a public zone flood that support
+          `P2P_SUPPORT_FLAG_TX_ANNOUNCE` are sent (batched) `NOTIFY_NEW_TX_HASHES`
+          instead, and request the txs they don't have.
 
       \return True iff the notification is queued for sending. */
-    bool send_txs(std::vector<blobdata> txs, const boost::uuids::uuid& source, bool pad_txs);
+    bool send_txs(std::vector<blobdata> txs, const boost::uuids::uuid& source, bool pad_txs, std::vector<crypto::hash> tx_hashes = {});
   };
 } // levin
 } // net
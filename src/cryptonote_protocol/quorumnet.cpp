@@ -38,6 +38,8 @@
 #include "quorumnet_conn_matrix.h"
 #include "cryptonote_config.h"
 #include "common/random.h"
+#include "common/metrics.h"
+#include "common/threadpool.h"
 
 #include <oxenmq/oxenmq.h>
 #include <oxenmq/hex.h>
@@ -84,6 +86,14 @@ struct QnetState {
         pending_signature_set pending_sigs;
         ConnectionID reply_conn;
         uint64_t reply_tag = 0;
+        quorum_array quorums;
+        uint64_t quorum_checksum = 0;
+        std::chrono::steady_clock::time_point submitted; // When we received the blink tx
+        // Signatures for the (known) tx waiting to be processed; whichever thread finds none being
+        // processed takes them all, and keeps taking what arrives meanwhile until there are none.
+        std::list<pending_signature> queued_sigs;
+        std::string queued_from; // x25519 pubkey of the peer that sent the queued signatures, empty if several did
+        bool processing_queued = false;
     };
     // { height => { txhash => {blink_tx,conn,reply}, ... }, ... }
     std::map<uint64_t, std::unordered_map<crypto::hash, blink_metadata>> blinks;
@@ -95,6 +105,14 @@ struct QnetState {
     std::condition_variable pulse_message_queue_cv;
     std::queue<pulse::message> pulse_message_queue;
 
+    // The chain height preconnect_quorums() last opened connections for
+    uint64_t preconnect_height = 0;
+
+    // Ids (see vote_id()) of the obligation votes we have verified or relayed, by vote height, so
+    // that we can tell peers which ones they needn't send us and skip copies that arrive anyway.
+    std::mutex known_votes_mutex;
+    std::map<uint64_t, std::unordered_set<crypto::hash>> known_votes;
+
     QnetState(cryptonote::core &core) : core{core} {}
 
     static QnetState &from(void* obj) {
@@ -350,10 +368,6 @@ private:
     // have a connection).
     template <typename QuorumIt>
     void compute_validator_peers(QuorumIt qbegin, QuorumIt qend, bool opportunistic) {
-
-        // TODO: when we receive a new block, if our quorum starts soon we can tell SNNetwork to
-        // pre-connect (to save the time in handshaking when we get an actual blink tx).
-
         strong_peers = 0;
 
         size_t i = 0;
@@ -489,12 +503,50 @@ quorum_vote_t deserialize_vote(std::string_view v) {
     return vote;
 }
 
+// Identifies a vote by the hash of its (deterministic) serialization, as sent in a quorum.vote_ob.
+crypto::hash vote_id(std::string_view serialized_vote) {
+    crypto::hash id;
+    crypto::cn_fast_hash(serialized_vote.data(), serialized_vote.size(), id);
+    return id;
+}
+
+bool is_known_vote(QnetState &qnet, const crypto::hash &id) {
+    std::lock_guard lock{qnet.known_votes_mutex};
+    for (auto &[height, ids] : qnet.known_votes)
+        if (ids.count(id))
+            return true;
+    return false;
+}
+
+void add_known_vote(QnetState &qnet, uint64_t vote_height, const crypto::hash &id) {
+    uint64_t height = qnet.core.get_current_blockchain_height();
+    uint64_t min_height = height > service_nodes::VOTE_LIFETIME ? height - service_nodes::VOTE_LIFETIME : 0;
+    std::lock_guard lock{qnet.known_votes_mutex};
+    qnet.known_votes.erase(qnet.known_votes.begin(), qnet.known_votes.lower_bound(min_height));
+    if (vote_height >= min_height)
+        qnet.known_votes[vote_height].insert(id);
+}
+
+constexpr auto VOTE_IDS_TIMEOUT = 10s;
+
+/// Relays obligation votes to the quorum peers of each.  Rather than sending each peer the votes,
+/// we first send it their ids (quorum.vote_ob_ids) and it replies with the ones it is missing;
+/// votes get relayed again every couple of minutes while they are in the pool, so most of the time
+/// peers already have them.  If a peer doesn't understand the request (or doesn't answer) we fall
+/// back to sending it all of them.
 void relay_obligation_votes(void *obj, const std::vector<service_nodes::quorum_vote_t> &votes) {
     auto &qnet = QnetState::from(obj);
 
     const auto& my_keys = qnet.core.get_service_keys();
     assert(qnet.core.service_node());
 
+    struct peer_votes {
+        std::string address; // empty for an opportunistic peer
+        bt_list ids;
+        std::vector<std::string> votes;
+    };
+    std::unordered_map<std::string, peer_votes> relays; // x25519 pubkey => votes to offer it
+
     MDEBUG("Starting relay of " << votes.size() << " votes");
     std::vector<service_nodes::quorum_vote_t> relayed_votes;
     relayed_votes.reserve(votes.size());
@@ -524,13 +576,88 @@ void relay_obligation_votes(void *obj, const std::vector<service_nodes::quorum_v
             continue;
         }
 
-        pinfo.relay_to_peers("quorum.vote_ob", serialize_vote(vote));
+        auto serialized = bt_serialize(serialize_vote(vote));
+        auto id = vote_id(serialized);
+        add_known_vote(qnet, vote.block_height, id);
+        for (auto &[x25519, address] : pinfo.peers) {
+            auto &relay = relays[x25519];
+            if (!address.empty())
+                relay.address = address;
+            relay.ids.push_back(get_data_as_string(id));
+            relay.votes.push_back(serialized);
+        }
         relayed_votes.push_back(vote);
     }
+
+    for (auto &[x25519, relay] : relays) {
+        auto on_reply = [&omq = qnet.omq, x25519 = x25519, votes = std::move(relay.votes)](bool success, std::vector<std::string> data) {
+            std::vector<size_t> missing;
+            if (success && data.size() == 1) {
+                try {
+                    bt_list_consumer wanted{data[0]};
+                    while (!wanted.is_finished()) {
+                        auto i = wanted.consume_integer<size_t>();
+                        if (i < votes.size())
+                            missing.push_back(i);
+                    }
+                } catch (const std::exception &e) {
+                    MDEBUG("Invalid quorum.vote_ob_ids reply from " << to_hex(x25519) << ": " << e.what());
+                    return;
+                }
+            } else {
+                MDEBUG("No quorum.vote_ob_ids reply from " << to_hex(x25519) << "; sending all " << votes.size() << " votes");
+                for (size_t i = 0; i < votes.size(); i++)
+                    missing.push_back(i);
+            }
+            MTRACE("Sending " << missing.size() << "/" << votes.size() << " votes to " << to_hex(x25519));
+            for (size_t i : missing)
+                omq.send(x25519, "quorum.vote_ob", votes[i], send_option::optional{});
+        };
+
+        auto ids = bt_serialize(relay.ids);
+        MTRACE("Relaying " << relay.ids.size() << " vote ids to peer " << to_hex(x25519) << (relay.address.empty() ? " (if connected)"s : " @ " + relay.address));
+        if (relay.address.empty())
+            qnet.omq.request(x25519, "quorum.vote_ob_ids", std::move(on_reply), ids, send_option::optional{}, send_option::request_timeout{VOTE_IDS_TIMEOUT});
+        else
+            qnet.omq.request(x25519, "quorum.vote_ob_ids", std::move(on_reply), ids, send_option::hint{relay.address}, send_option::request_timeout{VOTE_IDS_TIMEOUT});
+    }
+
     MDEBUG("Relayed " << relayed_votes.size() << " votes");
     qnet.core.set_service_node_votes_relayed(relayed_votes);
 }
 
+/// A "vote_ob_ids" request offers obligation votes by their ids: the one data part is a list of
+/// 32-byte vote ids, and the reply is the list of the (0-based) positions in it of the votes we
+/// don't have, which the sender then sends with quorum.vote_ob.
+void handle_obligation_vote_ids(Message& m, QnetState& qnet) {
+    constexpr size_t MAX_VOTE_IDS = 1000;
+    if (m.data.size() != 1) {
+        MINFO("Ignoring vote ids: expected 1 data part, not " << m.data.size());
+        return;
+    }
+
+    try {
+        bt_list wanted;
+        bt_list_consumer ids{m.data[0]};
+        for (size_t i = 0; !ids.is_finished(); i++) {
+            if (i >= MAX_VOTE_IDS)
+                throw std::invalid_argument("too many vote ids");
+            auto id_str = ids.consume_string_view();
+            if (id_str.size() != sizeof(crypto::hash))
+                throw std::invalid_argument("invalid vote id");
+            crypto::hash id;
+            std::memcpy(id.data, id_str.data(), sizeof(id));
+            if (!is_known_vote(qnet, id))
+                wanted.push_back(i);
+        }
+        MTRACE("Requesting " << wanted.size() << " offered votes from " << to_hex(m.conn.pubkey()));
+        m.send_reply(bt_serialize(wanted));
+    }
+    catch (const std::exception &e) {
+        MWARNING("Invalid vote ids from " << to_hex(m.conn.pubkey()) << ": " << e.what());
+    }
+}
+
 void handle_obligation_vote(Message& m, QnetState& qnet) {
     MDEBUG("Received a relayed obligation vote from " << to_hex(m.conn.pubkey()));
 
@@ -539,6 +666,12 @@ void handle_obligation_vote(Message& m, QnetState& qnet) {
         return;
     }
 
+    auto id = vote_id(m.data[0]);
+    if (is_known_vote(qnet, id)) {
+        MTRACE("Ignoring vote: already verified");
+        return;
+    }
+
     try {
         std::vector<quorum_vote_t> vvote;
         vvote.push_back(deserialize_vote(m.data[0]));
@@ -560,6 +693,7 @@ void handle_obligation_vote(Message& m, QnetState& qnet) {
             MWARNING("Vote verification failed; ignoring vote");
             return;
         }
+        add_known_vote(qnet, vote.block_height, id);
 
         if (vvc.m_added_to_pool)
             relay_obligation_votes(&qnet, std::move(vvote));
@@ -627,7 +761,7 @@ quorum_array get_blink_quorums(uint64_t blink_height, const service_node_list &s
 // Used when debugging is enabled to print known signatures.
 // Prints [x x x ...] [x x x ...] for the quorums where each "x" is either "A" for an approval
 // signature, "R" for a rejection signature, or "-" for no signature.
-std::string debug_known_signatures(blink_tx &btx, quorum_array &blink_quorums) {
+std::string debug_known_signatures(blink_tx &btx, const quorum_array &blink_quorums) {
     std::ostringstream os;
     bool first = true;
     for (uint8_t qi = 0; qi < blink_quorums.size(); qi++) {
@@ -648,9 +782,10 @@ std::string debug_known_signatures(blink_tx &btx, quorum_array &blink_quorums) {
 
 /// Processes blink signatures; called immediately upon receiving a signature if we know about the
 /// tx; otherwise signatures are stored until we learn about the tx and then processed.
-void process_blink_signatures(QnetState &qnet, const std::shared_ptr<blink_tx> &btxptr, quorum_array &blink_quorums, uint64_t quorum_checksum, std::list<pending_signature> &&signatures,
+void process_blink_signatures(QnetState &qnet, const std::shared_ptr<blink_tx> &btxptr, const quorum_array &blink_quorums, uint64_t quorum_checksum, std::list<pending_signature> &&signatures,
         uint64_t reply_tag, // > 0 if we are expected to send a status update if it becomes accepted/rejected
         ConnectionID reply_conn, // who we are supposed to send the status update to
+        std::chrono::steady_clock::time_point submitted, // when we received the blink tx, for the approval latency metrics
         const std::string &received_from = ""s /* x25519 of the peer that sent this, if available (to avoid trying to pointlessly relay back to them) */) {
 
     auto &btx = *btxptr;
@@ -679,23 +814,41 @@ void process_blink_signatures(QnetState &qnet, const std::shared_ptr<blink_tx> &
     if (signatures.empty())
         return;
 
-    // Now check and discard any invalid signatures (we can do this without holding a lock)
-    for (auto it = signatures.begin(); it != signatures.end(); ) {
-        auto &pending = *it;
-        auto &approval = std::get<bool>(pending);
-        auto &qi = std::get<uint8_t>(pending);
-        auto &position = std::get<int>(pending);
-        auto &signature = std::get<crypto::signature>(pending);
+    // Now check and discard any invalid signatures (we can do this without holding a lock).  A batch
+    // of queued signatures can be big enough to be worth spreading over the threadpool.
+    {
+        const crypto::hash signed_hash[2] = {btx.hash(false), btx.hash(true)};
+        std::vector<std::list<pending_signature>::iterator> to_check;
+        to_check.reserve(signatures.size());
+        for (auto it = signatures.begin(); it != signatures.end(); ++it)
+            to_check.push_back(it);
+        std::vector<char> valid(to_check.size());
+
+        auto verify = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                auto &[approval, qi, position, signature] = *to_check[i];
+                valid[i] = crypto::check_signature(signed_hash[approval], blink_quorums[qi]->validators[position], signature);
+            }
+        };
 
-        auto subquorum = static_cast<blink_tx::subquorum>(qi);
-        auto &validators = blink_quorums[qi]->validators;
+        constexpr size_t MIN_SIGNATURES_PER_THREAD = 8;
+        auto &tpool = tools::threadpool::getInstance();
+        size_t threads = std::min<size_t>(tpool.get_max_concurrency(), to_check.size() / MIN_SIGNATURES_PER_THREAD);
+        if (threads > 1) {
+            tools::threadpool::waiter waiter;
+            for (size_t c = 0; c < threads; c++)
+                tpool.submit(&waiter, [&verify, c, threads, n=to_check.size()] { verify(n * c / threads, n * (c + 1) / threads); }, true);
+            waiter.wait(&tpool);
+        } else {
+            verify(0, to_check.size());
+        }
 
-        if (!crypto::check_signature(btx.hash(approval), validators[position], signature)) {
-            MWARNING("Invalid blink signature: signature verification failed");
-            it = signatures.erase(it);
-            continue;
+        for (size_t i = 0; i < to_check.size(); i++) {
+            if (!valid[i]) {
+                MWARNING("Invalid blink signature: signature verification failed");
+                signatures.erase(to_check[i]);
+            }
         }
-        ++it;
     }
 
     if (signatures.empty())
@@ -745,6 +898,13 @@ void process_blink_signatures(QnetState &qnet, const std::shared_ptr<blink_tx> &
         }
     }
 
+    if (became_approved || became_rejected) {
+        static auto &approval_time = tools::metrics::get_histogram("blink_approval", OXEN_DEFAULT_LOG_CATEGORY);
+        static auto &rejection_time = tools::metrics::get_histogram("blink_rejection", OXEN_DEFAULT_LOG_CATEGORY);
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - submitted);
+        (became_approved ? approval_time : rejection_time).record(elapsed.count());
+    }
+
     if (became_approved) {
         MINFO("Accumulated enough signatures for blink tx: enabling tx relay");
         auto &pool = qnet.core.get_pool();
@@ -968,6 +1128,7 @@ void handle_blink(oxenmq::Message& m, QnetState& qnet) {
         return;
     }
 
+    auto submitted = std::chrono::steady_clock::now();
     auto btxptr = std::make_shared<blink_tx>(blink_height);
     auto &btx = *btxptr;
     auto &tx = var::get<cryptonote::transaction>(btx.tx);
@@ -1016,6 +1177,9 @@ void handle_blink(oxenmq::Message& m, QnetState& qnet) {
             return;
         }
         bl_info.btxptr = btxptr;
+        bl_info.quorums = blink_quorums;
+        bl_info.quorum_checksum = checksum;
+        bl_info.submitted = submitted;
         for (auto &sig : bl_info.pending_sigs)
             signatures.push_back(std::move(sig));
         bl_info.pending_sigs.clear();
@@ -1076,7 +1240,41 @@ void handle_blink(oxenmq::Message& m, QnetState& qnet) {
         if (pinfo.my_position[qi] >= 0)
             signatures.emplace_back(approved, qi, pinfo.my_position[qi], sig);
 
-    process_blink_signatures(qnet, btxptr, blink_quorums, checksum, std::move(signatures), tag, m.conn.pubkey());
+    process_blink_signatures(qnet, btxptr, blink_quorums, checksum, std::move(signatures), tag, m.conn.pubkey(), submitted);
+}
+
+/// Processes the signatures queued for a blink tx, in batches, until there are none left; called by
+/// whichever thread set `processing_queued`, which this clears when done.
+void process_queued_blink_signatures(QnetState &qnet, uint64_t blink_height, const crypto::hash &tx_hash) {
+    while (true) {
+        std::shared_ptr<blink_tx> btxptr;
+        quorum_array quorums;
+        uint64_t checksum, reply_tag;
+        ConnectionID reply_conn;
+        std::chrono::steady_clock::time_point submitted;
+        std::list<pending_signature> signatures;
+        std::string received_from;
+        {
+            std::unique_lock lock{qnet.mutex};
+            auto &b_meta = qnet.blinks[blink_height][tx_hash];
+            if (b_meta.queued_sigs.empty()) {
+                b_meta.processing_queued = false;
+                return;
+            }
+            signatures.swap(b_meta.queued_sigs);
+            received_from = std::move(b_meta.queued_from);
+            b_meta.queued_from.clear();
+            btxptr = b_meta.btxptr;
+            quorums = b_meta.quorums;
+            checksum = b_meta.quorum_checksum;
+            reply_tag = b_meta.reply_tag;
+            reply_conn = b_meta.reply_conn;
+            submitted = b_meta.submitted;
+        }
+
+        MDEBUG("Processing a batch of " << signatures.size() << " blink signatures for tx " << tx_hash);
+        process_blink_signatures(qnet, btxptr, quorums, checksum, std::move(signatures), reply_tag, reply_conn, submitted, received_from);
+    }
 }
 
 template <typename Consume>
@@ -1190,51 +1388,35 @@ void handle_blink_signature(Message& m, QnetState& qnet) {
         return convert_string_view_bytes_to_signature(l.consume_string_view());
     });
 
-    auto blink_quorums = get_blink_quorums(blink_height, qnet.core.get_service_node_list(), &checksum); // throws if bad quorum or checksum mismatch
-
-    uint64_t reply_tag = 0;
-    ConnectionID reply_conn;
-    std::shared_ptr<blink_tx> btxptr;
-    auto find_blink = [&]() {
-        auto height_it = qnet.blinks.find(blink_height);
-        if (height_it == qnet.blinks.end())
-            return;
-        auto &blinks_at_height = height_it->second;
-        auto it = blinks_at_height.find(tx_hash);
-        if (it == blinks_at_height.end())
-            return;
-        auto &b_meta = it->second;
-        btxptr = b_meta.btxptr;
-        reply_tag = b_meta.reply_tag;
-        reply_conn = b_meta.reply_conn;
-    };
+    get_blink_quorums(blink_height, qnet.core.get_service_node_list(), &checksum); // throws if bad quorum or checksum mismatch
 
     {
-        // Most of the time we'll already know about the blink and don't need a unique lock to
-        // extract info we need.  If we fail, we'll stash the signature to be processed when we get
-        // the blink tx itself.
-        std::shared_lock lock{qnet.mutex};
-        find_blink();
-    }
-
-    if (!btxptr) {
         std::unique_lock lock{qnet.mutex};
-        // We probably don't have it, so want to stash the signature until we received it.  There's
-        // a chance, however, that another thread processed it while we were waiting for this
-        // exclusive mutex, so check it again before we stash a delayed signature.
-        find_blink();
-        if (!btxptr) {
+        auto &b_meta = qnet.blinks[blink_height][tx_hash];
+        if (!b_meta.btxptr) {
+            // We don't have the blink tx yet, so stash the signatures to be processed when we get it.
             MINFO("Blink tx not found in local blink cache; delaying signature verification");
-            auto &delayed = qnet.blinks[blink_height][tx_hash].pending_sigs;
             for (auto &sig : signatures)
-                delayed.insert(std::move(sig));
+                b_meta.pending_sigs.insert(std::move(sig));
+            return;
+        }
+
+        if (b_meta.queued_sigs.empty())
+            b_meta.queued_from = m.conn.pubkey();
+        else if (b_meta.queued_from != m.conn.pubkey())
+            b_meta.queued_from.clear();
+        b_meta.queued_sigs.splice(b_meta.queued_sigs.end(), signatures);
+
+        if (b_meta.processing_queued) {
+            MTRACE("Queued blink signatures behind the batch being processed");
             return;
         }
+        b_meta.processing_queued = true;
     }
 
     MINFO("Found blink tx in local blink cache");
 
-    process_blink_signatures(qnet, btxptr, blink_quorums, checksum, std::move(signatures), reply_tag, reply_conn, m.conn.pubkey());
+    process_queued_blink_signatures(qnet, blink_height, tx_hash);
 }
 
 
@@ -1692,6 +1874,75 @@ void handle_pulse_signed_block(Message &m, QnetState &qnet)
 
 /// Sets the cryptonote::quorumnet_* function pointers (allowing core to avoid linking to
 /// cryptonote_protocol).  Called from daemon/daemon.cpp.  Also registers quorum command callbacks.
+// How often we check for a new block to open connections to our upcoming quorums' members for, how
+// long those connections are kept open, and how many pulse rounds of the next block are covered.
+constexpr auto PRECONNECT_INTERVAL = 5s;
+constexpr auto PRECONNECT_KEEP_ALIVE = 5min;
+constexpr uint8_t PRECONNECT_PULSE_ROUNDS = 2;
+
+// Connects ahead of time to the peers we will be relaying to in the pulse quorums of the next block
+// (its first rounds) and the blink quorums of the current and next blink interval, if we are in
+// them, so that the first messages of a round or blink don't have to wait for the connections to
+// be established.  The quorums are deterministic, so we know them as soon as the previous block
+// arrives.
+void preconnect_quorums(QnetState &qnet) {
+    auto &core = qnet.core;
+    auto &blockchain = core.get_blockchain_storage();
+    uint64_t top_height;
+    crypto::hash top_hash = blockchain.get_tail_id(top_height);
+    uint64_t height = top_height + 1;
+    if (height == qnet.preconnect_height)
+        return;
+    qnet.preconnect_height = height;
+
+    auto &snl = core.get_service_node_list();
+    auto &my_pubkey = core.get_service_keys().pub;
+    if (!snl.is_service_node(my_pubkey, true /*require_active*/))
+        return;
+
+    std::unordered_map<std::string, std::string> connect; // x25519 pubkey => address
+    auto add_peers = [&connect](const peer_info &pinfo) {
+        if (pinfo.my_position_count == 0)
+            return;
+        for (auto &[x25519, address] : pinfo.peers)
+            if (!address.empty())
+                connect.emplace(x25519, address);
+    };
+
+    uint8_t hf_version = blockchain.get_network_version();
+    if (hf_version >= cryptonote::network_version_16_pulse) {
+        auto active_nodes = snl.active_service_nodes_infos();
+        auto block_leader = snl.get_block_leader().key;
+        for (uint8_t round = 0; round < PRECONNECT_PULSE_ROUNDS; round++) {
+            auto entropy = get_pulse_entropy_for_next_block(blockchain.get_db(), top_hash, round);
+            auto quorum = generate_pulse_quorum(blockchain.nettype(), block_leader, hf_version, active_nodes, entropy, round);
+            if (!verify_pulse_quorum_sizes(quorum))
+                break;
+            // Validators relay to each other and to the block producer (see
+            // pulse_relay_message_to_quorum); the producer itself only sends to a few of them.
+            add_peers(peer_info{qnet, quorum_type::pulse, &quorum, false /*opportunistic*/, {}, true /*include_workers*/});
+        }
+    }
+
+    if (hf_version >= HF_VERSION_BLINK) {
+        for (uint64_t blink_height : {height, height + BLINK_QUORUM_INTERVAL}) {
+            try {
+                auto blink_quorums = get_blink_quorums(blink_height, snl, nullptr);
+                add_peers(peer_info{qnet, quorum_type::blink, blink_quorums.begin(), blink_quorums.end(), false /*opportunistic*/});
+            } catch (const std::exception &e) {
+                MTRACE("Not preconnecting to blink quorum peers for height " << blink_height << ": " << e.what());
+            }
+        }
+    }
+
+    for (auto &[x25519, address] : connect) {
+        MTRACE("Preconnecting to upcoming quorum peer " << to_hex(x25519) << " @ " << address);
+        qnet.omq.connect_sn(x25519, PRECONNECT_KEEP_ALIVE, address);
+    }
+    if (!connect.empty())
+        MDEBUG("Opened or refreshed connections to " << connect.size() << " upcoming quorum peers for height " << height);
+}
+
 void init_core_callbacks() {
     cryptonote::quorumnet_new = new_qnetstate;
     cryptonote::quorumnet_init = setup_endpoints;
@@ -1713,6 +1964,7 @@ void setup_endpoints(cryptonote::core& core, void* obj) {
         omq.add_category("quorum", Access{AuthLevel::none, true /*remote sn*/, true /*local sn*/}, 2 /*reserved threads*/)
             // Receives an obligation vote
             .add_command("vote_ob", [&qnet](Message& m) { handle_obligation_vote(m, qnet); })
+            .add_request_command("vote_ob_ids", [&qnet](Message& m) { handle_obligation_vote_ids(m, qnet); })
             // Receives blink tx signatures or rejections between quorum members (either original or
             // forwarded).  These are propagated by the receiver if new
             .add_command("blink_sign", [&qnet](Message& m) { handle_blink_signature(m, qnet); })
@@ -1735,6 +1987,8 @@ void setup_endpoints(cryptonote::core& core, void* obj) {
             .add_command(PULSE_CMD_RANDOM_VALUE, [&qnet](Message& m) { handle_pulse_random_value(m, qnet); })
             .add_command(PULSE_CMD_SIGNED_BLOCK, [&qnet](Message& m) { handle_pulse_signed_block(m, qnet); })
             ;
+
+        omq.add_timer([&qnet] { preconnect_quorums(qnet); }, PRECONNECT_INTERVAL);
     }
 
     // bl.*: responses to blinks sent from quorum members back to the node who submitted the blink
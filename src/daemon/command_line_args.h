@@ -56,6 +56,11 @@ namespace daemon_args
   , "Specify maximum number of rotated log files to be saved (no limit by setting to 0)"
   , MAX_LOG_FILES
   };
+  const command_line::arg_descriptor<bool> arg_log_synchronously = {
+    "log-synchronously"
+  , "Write log lines from the thread logging them instead of from a background log writer thread"
+  , false
+  };
   const command_line::arg_descriptor<std::string> arg_log_level = {
     "log-level"
   , ""
@@ -70,6 +75,31 @@ namespace daemon_args
   , "Max number of threads to use for a parallel job"
   , 0
   };
+  const command_line::arg_descriptor<unsigned> arg_verify_threads = {
+    "verify-threads"
+  , "Number of threads verifying blocks and transactions; 0 = max concurrency"
+  , 0
+  };
+  const command_line::arg_descriptor<unsigned> arg_background_threads = {
+    "background-threads"
+  , "Number of threads for background work such as DNS lookups and RPC queries; 0 = half of max concurrency"
+  , 0
+  };
+  const command_line::arg_descriptor<std::string> arg_numa_verify_nodes = {
+    "numa-verify-nodes"
+  , "Pin verification threads to the CPUs of these NUMA nodes, e.g. 0 or 0-1 or 0,2 (Linux only); empty = no pinning"
+  , ""
+  };
+  const command_line::arg_descriptor<std::string> arg_numa_background_nodes = {
+    "numa-background-nodes"
+  , "Pin background threads to the CPUs of these NUMA nodes (see --numa-verify-nodes)"
+  , ""
+  };
+  const command_line::arg_descriptor<std::string> arg_numa_p2p_nodes = {
+    "numa-p2p-nodes"
+  , "Pin p2p network threads to the CPUs of these NUMA nodes (see --numa-verify-nodes)"
+  , ""
+  };
 
 }  // namespace daemon_args
 
@@ -933,6 +933,13 @@ bool command_parser_executor::check_blockchain_pruning(const std::vector<std::st
   return m_executor.check_blockchain_pruning();
 }
 
+bool command_parser_executor::create_snapshot(const std::vector<std::string>& args)
+{
+  if (args.size() > 1) return false;
+
+  return m_executor.create_snapshot(args.empty() ? "" : args[0]);
+}
+
 bool command_parser_executor::set_bootstrap_daemon(const std::vector<std::string>& args)
 {
   const size_t args_count = args.size();
@@ -148,6 +148,8 @@ public:
 
   bool check_blockchain_pruning(const std::vector<std::string>& args);
 
+  bool create_snapshot(const std::vector<std::string>& args);
+
   bool print_net_stats(const std::vector<std::string>& args);
 
   bool print_sn_state_changes(const std::vector<std::string> &args);
@@ -358,6 +358,12 @@ void command_server::init_commands(cryptonote::rpc::core_rpc_server* rpc_server)
     , [this](const auto &x) { return m_parser.check_blockchain_pruning(x); }
     , "Check the blockchain pruning."
     );
+    m_command_lookup.set_handler(
+      "create_snapshot"
+    , [this](const auto &x) { return m_parser.create_snapshot(x); }
+    , "create_snapshot [<dir>]"
+    , "Write a snapshot of the blockchain and ONS databases to <dir> (default: \"snapshot\" in the data directory), from which a new node can be started with --restore-snapshot."
+    );
     m_command_lookup.set_handler(
       "print_checkpoints"
     , [this](const auto &x) { return m_parser.print_checkpoints(x); }
@@ -34,6 +34,8 @@
 #include "common/scoped_message_writer.h"
 #include "common/password.h"
 #include "common/util.h"
+#include "common/threadpool.h"
+#include "common/numa.h"
 #include "common/fs.h"
 #include "cryptonote_core/cryptonote_core.h"
 #include "daemonizer/daemonizer.h"
@@ -93,7 +95,13 @@ int main(int argc, char const * argv[])
       command_line::add_arg(core_settings, daemon_args::arg_log_level);
       command_line::add_arg(core_settings, daemon_args::arg_max_log_file_size);
       command_line::add_arg(core_settings, daemon_args::arg_max_log_files);
+      command_line::add_arg(core_settings, daemon_args::arg_log_synchronously);
       command_line::add_arg(core_settings, daemon_args::arg_max_concurrency);
+      command_line::add_arg(core_settings, daemon_args::arg_verify_threads);
+      command_line::add_arg(core_settings, daemon_args::arg_background_threads);
+      command_line::add_arg(core_settings, daemon_args::arg_numa_verify_nodes);
+      command_line::add_arg(core_settings, daemon_args::arg_numa_background_nodes);
+      command_line::add_arg(core_settings, daemon_args::arg_numa_p2p_nodes);
 
       daemonizer::init_options(hidden_options, visible_options);
       daemonize::daemon::init_options(core_settings, hidden_options);
@@ -299,6 +307,7 @@ int main(int argc, char const * argv[])
     if (log_file_path.is_relative())
       log_file_path = fs::absolute(data_dir / log_file_path);
     mlog_configure(log_file_path.string(), true, command_line::get_arg(vm, daemon_args::arg_max_log_file_size), command_line::get_arg(vm, daemon_args::arg_max_log_files));
+    mlog_set_async(!command_line::get_arg(vm, daemon_args::arg_log_synchronously));
 
     // Set log level
     if (!command_line::is_arg_defaulted(vm, daemon_args::arg_log_level))
@@ -309,6 +318,16 @@ int main(int argc, char const * argv[])
 
     if (!command_line::is_arg_defaulted(vm, daemon_args::arg_max_concurrency))
       tools::set_max_concurrency(command_line::get_arg(vm, daemon_args::arg_max_concurrency));
+    if (!command_line::is_arg_defaulted(vm, daemon_args::arg_verify_threads))
+      tools::threadpool::set_threads(tools::threadpool::domain::verify, command_line::get_arg(vm, daemon_args::arg_verify_threads));
+    if (!command_line::is_arg_defaulted(vm, daemon_args::arg_background_threads))
+      tools::threadpool::set_threads(tools::threadpool::domain::background, command_line::get_arg(vm, daemon_args::arg_background_threads));
+    if (auto nodes = command_line::get_arg(vm, daemon_args::arg_numa_verify_nodes); !nodes.empty())
+      tools::threadpool::set_numa_nodes(tools::threadpool::domain::verify, tools::numa::parse_list(nodes));
+    if (auto nodes = command_line::get_arg(vm, daemon_args::arg_numa_background_nodes); !nodes.empty())
+      tools::threadpool::set_numa_nodes(tools::threadpool::domain::background, tools::numa::parse_list(nodes));
+    if (auto nodes = command_line::get_arg(vm, daemon_args::arg_numa_p2p_nodes); !nodes.empty())
+      tools::numa::set_nodes(tools::numa::role::p2p, tools::numa::parse_list(nodes));
 
     // logging is now set up
     // FIXME: only print this when starting up as a daemon but not when running rpc commands
@@ -349,6 +368,8 @@ int main(int argc, char const * argv[])
       }
     }
 
+    MGINFO(tools::numa::describe());
+
     MINFO("Moving from main() into the daemonize now.");
 
     return daemonizer::daemonize<daemonize::daemon>("Oxen Daemon", argc, argv, std::move(vm))
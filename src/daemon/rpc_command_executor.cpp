@@ -1502,13 +1502,19 @@ bool rpc_command_executor::sync_info()
       tools::success_msg_writer() << address << "  " << p.info.peer_id << "  " <<
           epee::string_tools::pad_string(p.info.state, 16) << "  " <<
           epee::string_tools::pad_string(epee::string_tools::to_string_hex(p.info.pruning_seed), 8) << "  " << p.info.height << "  "  <<
-          p.info.current_download << " kB/s, " << nblocks << " blocks / " << size/1e6 << " MB queued";
+          p.info.current_download << " kB/s, " << nblocks << " blocks / " << size/1e6 << " MB queued, span " <<
+          p.info.span_blocks << " blocks, rtt " << p.info.rtt.count() << " ms";
     }
 
-    uint64_t total_size = 0;
+    uint64_t total_size = 0, spilled_size = 0;
     for (const auto &s: res.spans)
+    {
       total_size += s.size;
-    tools::success_msg_writer() << std::to_string(res.spans.size()) << " spans, " << total_size/1e6 << " MB";
+      if (s.spilled)
+        spilled_size += s.size;
+    }
+    tools::success_msg_writer() << std::to_string(res.spans.size()) << " spans, " << total_size/1e6 << " MB"
+      << (spilled_size ? " (" + std::to_string(spilled_size/1000000) + " MB on disk)" : "");
     tools::success_msg_writer() << res.overview;
     for (const auto &s: res.spans)
     {
@@ -1520,7 +1526,7 @@ bool rpc_command_executor::sync_info()
       }
       else
       {
-        tools::success_msg_writer() << address << "  " << s.nblocks << "/" << pruning_seed << " (" << s.start_block_height << " - " << (s.start_block_height + s.nblocks - 1) << ", " << (uint64_t)(s.size/1e3) << " kB)  " << (unsigned)(s.rate/1e3) << " kB/s (" << s.speed/100.0f << ")";
+        tools::success_msg_writer() << address << "  " << s.nblocks << "/" << pruning_seed << " (" << s.start_block_height << " - " << (s.start_block_height + s.nblocks - 1) << ", " << (uint64_t)(s.size/1e3) << " kB)  " << (unsigned)(s.rate/1e3) << " kB/s (" << s.speed/100.0f << ")" << (s.spilled ? ", on disk" : "");
       }
     }
 
@@ -2521,6 +2527,17 @@ bool rpc_command_executor::check_blockchain_pruning()
     return true;
 }
 
+bool rpc_command_executor::create_snapshot(const std::string& dir)
+{
+    CREATE_SNAPSHOT::response res{};
+    if (!invoke<CREATE_SNAPSHOT>({dir}, res, "Failed to create snapshot"))
+      return false;
+
+    tools::success_msg_writer() << "Snapshot of " << res.height << " blocks (top block " << res.top_hash << ", "
+      << res.chunks.size() << " chunks) written to " << res.dir;
+    return true;
+}
+
 bool rpc_command_executor::set_bootstrap_daemon(
   const std::string &address,
   const std::string &username,
@@ -193,6 +193,8 @@ public:
 
   bool check_blockchain_pruning();
 
+  bool create_snapshot(const std::string& dir);
+
   bool print_net_stats();
 
   bool set_bootstrap_daemon(
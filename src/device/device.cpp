@@ -102,4 +102,12 @@ namespace hw {
         return registry->register_device(device_name, hw_device);
     }
 
+    std::vector<bool> device::generate_key_derivations(const std::vector<crypto::public_key> &pubs, const crypto::secret_key &sec, std::vector<crypto::key_derivation> &derivations) {
+        std::vector<bool> ok(pubs.size());
+        derivations.resize(pubs.size());
+        for (size_t i = 0; i < pubs.size(); i++)
+            ok[i] = generate_key_derivation(pubs[i], sec, derivations[i]);
+        return ok;
+    }
+
 }
@@ -267,6 +267,7 @@ namespace hw {
 
     LEDGER_INS(SECRET_KEY_TO_PUBLIC_KEY,        0x30);
     LEDGER_INS(GEN_KEY_DERIVATION,              0x32);
+    LEDGER_INS(GEN_KEY_DERIVATIONS,             0x33);
     LEDGER_INS(DERIVATION_TO_SCALAR,            0x34);
     LEDGER_INS(DERIVE_PUBLIC_KEY,               0x36);
     LEDGER_INS(DERIVE_SECRET_KEY,               0x38);
@@ -314,12 +315,18 @@ namespace hw {
     constexpr size_t BLAKE2B_HASH_CHUNK_SIZE = 128;
     static_assert(BLAKE2B_HASH_CHUNK_SIZE <= 254, "Max BLAKE2b data chunk size exceeds the protocol limit");
 
+    // INS_GEN_KEY_DERIVATIONS sends the (encrypted) secret and then as many pubkeys as fit after
+    // the header and options byte, and gets back a derivation for each.
+    constexpr size_t DERIVATIONS_PER_EXCHANGE = (BUFFER_SEND_SIZE - 6 - 32) / 32;
+    static_assert(DERIVATIONS_PER_EXCHANGE * 32 + 2 <= BUFFER_RECV_SIZE, "Batched derivations exceed the receive buffer");
+
 
     device_ledger::device_ledger(): hw_device(0x0101, 0x05, 64, 2000) {
       id = device_id++;
       reset_buffer();
       mode = NONE;
       has_view_key = false;
+      batch_derivations = true;
       tx_in_progress = false;
       MDEBUG("Device " << id << " Created");
     }
@@ -560,6 +567,7 @@ namespace hw {
       disconnect();
       hw_device.connect(known_devices);
       reset();
+      batch_derivations = true;
 
       check_network_type();
 
@@ -1077,6 +1085,55 @@ namespace hw {
       return r;
     }
 
+    std::vector<bool> device_ledger::generate_key_derivations(const std::vector<crypto::public_key> &pubs, const crypto::secret_key &sec, std::vector<crypto::key_derivation> &derivations) {
+      auto lock = std::unique_lock{device_locker};
+
+      if (mode == TRANSACTION_PARSE && has_view_key) {
+        // As generate_key_derivation, without the device
+        assert(is_fake_view_key(sec));
+        return crypto::generate_key_derivations(pubs, viewkey, derivations);
+      }
+
+      // Secrets sent during a tx carry an hmac, which would leave room for fewer keys: that is not
+      // worth a second batched format, since refreshing is what needs this.
+      if (!batch_derivations || tx_in_progress)
+        return device::generate_key_derivations(pubs, sec, derivations);
+
+      std::vector<bool> ok(pubs.size(), true);
+      derivations.resize(pubs.size());
+      size_t begin = 0;
+      {
+        auto command_lock = std::unique_lock{command_locker};
+        for (; begin < pubs.size(); begin += DERIVATIONS_PER_EXCHANGE) {
+          const size_t n = std::min(DERIVATIONS_PER_EXCHANGE, pubs.size() - begin);
+          int offset = set_command_header_noopt(INS_GEN_KEY_DERIVATIONS, n);
+          send_secret(sec.data, offset);
+          for (size_t i = begin; i < begin + n; i++)
+            send_bytes(pubs[i].data, 32, offset);
+
+          try {
+            finish_and_exchange(offset);
+          } catch (const std::exception&) {
+            if (sw != SW_INS_NOT_SUPPORTED)
+              throw;
+            MINFO("Device app does not support batched key derivations; falling back to one at a time");
+            batch_derivations = false;
+            break;
+          }
+
+          CHECK_AND_ASSERT_THROW_MES(length_recv >= n * 32, "Communication error, too few derivations received");
+          offset = 0;
+          for (size_t i = begin; i < begin + n; i++)
+            receive_bytes(derivations[i].data, 32, offset);
+        }
+      }
+
+      // Whatever is left if the app turned out not to support batching
+      for (size_t i = begin; i < pubs.size(); i++)
+        ok[i] = generate_key_derivation(pubs[i], sec, derivations[i]);
+      return ok;
+    }
+
     bool device_ledger::conceal_derivation(crypto::key_derivation &derivation, const crypto::public_key &tx_pub_key, const std::vector<crypto::public_key> &additional_tx_pub_keys, const crypto::key_derivation &main_derivation, const std::vector<crypto::key_derivation> &additional_derivations) {
       const crypto::public_key *pkey = nullptr;
       if (derivation == main_derivation) {
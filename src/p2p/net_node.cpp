@@ -151,6 +151,8 @@ namespace nodetool
     const command_line::arg_descriptor<std::string> arg_igd = {"igd", "UPnP port mapping (disabled, enabled, delayed)", "disabled"};
     const command_line::arg_descriptor<bool>        arg_p2p_use_ipv6  = {"p2p-use-ipv6", "Enable IPv6 for p2p", false};
     const command_line::arg_descriptor<bool>        arg_p2p_ignore_ipv4  = {"p2p-ignore-ipv4", "Ignore unsuccessful IPv4 bind for p2p", false};
+    const command_line::arg_descriptor<uint32_t>    arg_p2p_io_shards  = {"p2p-io-shards", "Run p2p connections on this many extra threads, each with its own event loop, rather than on the shared p2p threads (0 to disable)", 0};
+    const command_line::arg_descriptor<uint32_t>    arg_p2p_connect_fanout  = {"p2p-connect-fanout", "Make up to this many outgoing connection attempts at once when filling outgoing peer slots", 4};
     const command_line::arg_descriptor<int64_t>     arg_out_peers = {"out-peers", "set max number of out peers", -1};
     const command_line::arg_descriptor<int64_t>     arg_in_peers = {"in-peers", "set max number of in peers", -1};
     const command_line::arg_descriptor<int> arg_tos_flag = {"tos-flag", "set TOS flag", -1};
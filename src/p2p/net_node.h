@@ -37,6 +37,8 @@
 #include <boost/program_options/variables_map.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <functional>
+#include <future>
+#include <set>
 #include <utility>
 #include <vector>
 #include <shared_mutex>
@@ -197,6 +199,11 @@ namespace nodetool
       std::atomic<unsigned int> m_current_number_of_in_peers;
       bool m_can_pingback;
 
+      // Proxy (i.e. tor/i2p circuit) setup stats, for zones that connect through m_proxy_address
+      std::atomic<uint64_t> m_proxy_connects{0};
+      std::atomic<uint64_t> m_proxy_connect_failures{0};
+      std::atomic<uint64_t> m_proxy_connect_ms{0}; // total time taken by the successful connects
+
     private:
       void set_config_defaults() noexcept
       {
@@ -305,7 +312,10 @@ namespace nodetool
     bool init_config();
     bool make_default_peer_id();
     bool make_default_config();
-    bool store_config();
+    // Saves the peerlists.  With `async` the lists are copied here but written out on another
+    // thread (and nothing is done if the previous asynchronous write is still going); otherwise
+    // this waits for any write in progress and then writes synchronously.
+    bool store_config(bool async = false);
 
 
     //----------------- levin_commands_handler -------------------------------------------------------------
@@ -314,7 +324,7 @@ namespace nodetool
     virtual void callback(p2p_connection_context& context);
     //----------------- i_p2p_endpoint -------------------------------------------------------------
     virtual bool relay_notify_to_list(int command, const epee::span<const uint8_t> data_buff, std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> connections);
-    virtual epee::net_utils::zone send_txs(std::vector<cryptonote::blobdata> txs, const epee::net_utils::zone origin, const boost::uuids::uuid& source, const bool pad_txs);
+    virtual epee::net_utils::zone send_txs(std::vector<cryptonote::blobdata> txs, const epee::net_utils::zone origin, const boost::uuids::uuid& source, const bool pad_txs, std::vector<crypto::hash> tx_hashes = {});
     virtual bool invoke_command_to_peer(int command, const epee::span<const uint8_t> req_buff, std::string& resp_buff, const epee::net_utils::connection_context_base& context);
     virtual bool invoke_notify_to_peer(int command, const epee::span<const uint8_t> req_buff, const epee::net_utils::connection_context_base& context);
     virtual bool drop_connection(const epee::net_utils::connection_context_base& context);
@@ -430,11 +440,14 @@ namespace nodetool
     bool m_offline;
     bool m_use_ipv6;
     bool m_require_ipv4;
+    uint32_t m_io_shards = 0;
+    uint32_t m_connect_fanout = 1;
     std::atomic<bool> is_closing;
     std::optional<std::thread> mPeersLoggerThread;
 
     t_payload_net_handler& m_payload_handler;
     peerlist_storage m_peerlist_storage;
+    std::future<bool> m_peerlist_store; // pending asynchronous store_config() write
 
     tools::periodic_task m_peer_handshake_idle_maker_interval{std::chrono::seconds{P2P_DEFAULT_HANDSHAKE_INTERVAL}};
     tools::periodic_task m_connections_maker_interval{1s};
@@ -468,6 +481,11 @@ namespace nodetool
     std::map<std::string, time_t> m_conn_fails_cache;
     std::shared_mutex m_conn_fails_cache_lock;
 
+    // Addresses we are currently making an outgoing connection to, so that concurrent connection
+    // attempts don't pick the same peer
+    std::mutex m_pending_connects_lock;
+    std::set<epee::net_utils::network_address> m_pending_connects;
+
     std::shared_mutex m_blocked_hosts_lock; // for both hosts and subnets
     std::map<std::string, time_t> m_blocked_hosts;
     std::map<epee::net_utils::ipv4_network_subnet, time_t> m_blocked_subnets;
@@ -490,6 +508,8 @@ namespace nodetool
     extern const command_line::arg_descriptor<std::string, false, true, 2> arg_p2p_bind_port_ipv6;
     extern const command_line::arg_descriptor<bool>        arg_p2p_use_ipv6;
     extern const command_line::arg_descriptor<bool>        arg_p2p_ignore_ipv4;
+    extern const command_line::arg_descriptor<uint32_t>    arg_p2p_io_shards;
+    extern const command_line::arg_descriptor<uint32_t>    arg_p2p_connect_fanout;
     extern const command_line::arg_descriptor<uint32_t>    arg_p2p_external_port;
     extern const command_line::arg_descriptor<bool>        arg_p2p_allow_local_ip;
     extern const command_line::arg_descriptor<std::vector<std::string> > arg_p2p_add_peer;
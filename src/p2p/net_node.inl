@@ -39,6 +39,7 @@
 #include <limits>
 #include <memory>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include "cryptonote_config.h"
@@ -47,6 +48,7 @@
 #include "common/file.h"
 #include "common/dns_utils.h"
 #include "common/pruning.h"
+#include "common/numa.h"
 #include "net/error.h"
 #include "common/periodic_task.h"
 #include "epee/misc_log_ex.h"
@@ -55,6 +57,7 @@
 #include "crypto/crypto.h"
 #include "epee/storages/levin_abstract_invoke2.h"
 #include "cryptonote_core/cryptonote_core.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "net/parse.h"
 
 #ifndef WITHOUT_MINIUPNPC
@@ -97,6 +100,8 @@ namespace nodetool
     command_line::add_arg(desc, arg_p2p_bind_port_ipv6, false);
     command_line::add_arg(desc, arg_p2p_use_ipv6);
     command_line::add_arg(desc, arg_p2p_ignore_ipv4);
+    command_line::add_arg(desc, arg_p2p_io_shards);
+    command_line::add_arg(desc, arg_p2p_connect_fanout);
     command_line::add_arg(desc, arg_p2p_external_port);
     command_line::add_arg(desc, arg_p2p_allow_local_ip);
     command_line::add_arg(desc, arg_p2p_add_peer);
@@ -387,6 +392,8 @@ namespace nodetool
     m_offline = command_line::get_arg(vm, cryptonote::arg_offline);
     m_use_ipv6 = command_line::get_arg(vm, arg_p2p_use_ipv6);
     m_require_ipv4 = !command_line::get_arg(vm, arg_p2p_ignore_ipv4);
+    m_io_shards = command_line::get_arg(vm, arg_p2p_io_shards);
+    m_connect_fanout = std::max<uint32_t>(command_line::get_arg(vm, arg_p2p_connect_fanout), 1);
     public_zone.m_notifier = cryptonote::levin::notify{
       public_zone.m_net_server.get_io_service(), public_zone.m_net_server.get_config_shared(), {}, true
     };
@@ -765,11 +772,17 @@ namespace nodetool
     if (m_offline)
       return res;
 
+    // Only the public zone: the other zones' servers run on its io_service
+    public_zone.m_net_server.set_io_shards(m_io_shards);
+
     //try to bind
     for (auto& zone : m_network_zones)
     {
       zone.second.m_net_server.get_config_object().set_handler(this);
       zone.second.m_net_server.get_config_object().m_invoke_timeout = P2P_DEFAULT_INVOKE_TIMEOUT;
+      // Sync responses go out behind block, tx and other relayed messages
+      zone.second.m_net_server.get_config_object().m_bulk_commands = {
+        cryptonote::NOTIFY_RESPONSE_GET_BLOCKS::ID, cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::ID};
 
       if (!zone.second.m_bind_ip.empty())
       {
@@ -859,6 +872,8 @@ namespace nodetool
     public_zone.m_net_server.add_idle_handler([this] { return idle_worker(); }, 1s);
     public_zone.m_net_server.add_idle_handler([this] { return m_payload_handler.on_idle(); }, 1s);
 
+    public_zone.m_net_server.set_thread_init([] { tools::numa::place_current_thread(tools::numa::role::p2p); });
+
     //here you can set worker threads count
     int thrds_count = 10;
     //go to loop
@@ -898,10 +913,20 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  bool node_server<t_payload_net_handler>::store_config()
+  bool node_server<t_payload_net_handler>::store_config(bool async)
   {
     TRY_ENTRY();
 
+    if (m_peerlist_store.valid())
+    {
+      if (async && m_peerlist_store.wait_for(0s) != std::future_status::ready)
+      {
+        MDEBUG("Previous peerlist store is still in progress, not storing again");
+        return true;
+      }
+      m_peerlist_store.get();
+    }
+
     std::error_code ec;
     if (fs::create_directories(m_config_folder); ec)
     {
@@ -913,7 +938,21 @@ namespace nodetool
     for (auto& zone : m_network_zones)
       zone.second.m_peerlist.get_peerlist(active);
 
-    const auto state_file_path = m_config_folder / P2P_NET_DATA_FILENAME;
+    auto state_file_path = m_config_folder / P2P_NET_DATA_FILENAME;
+    if (async)
+    {
+      // Copying the peers above is cheap; serializing and writing them is what takes time, so
+      // leave that to another thread rather than holding up the idle worker.
+      m_peerlist_store = std::async(std::launch::async, [this, active = std::move(active), state_file_path = std::move(state_file_path)] {
+        if (!m_peerlist_storage.store(state_file_path, active))
+        {
+          MWARNING("Failed to save config to file " << state_file_path);
+          return false;
+        }
+        return true;
+      });
+      return true;
+    }
     if (!m_peerlist_storage.store(state_file_path, active))
     {
       MWARNING("Failed to save config to file " << state_file_path);
@@ -1187,10 +1226,24 @@ namespace nodetool
     }
 
 
+    {
+      std::lock_guard lock{m_pending_connects_lock};
+      if (!m_pending_connects.insert(na).second)
+      {
+        MDEBUG("Already connecting to " << na.str());
+        return false;
+      }
+    }
+    OXEN_DEFER {
+      std::lock_guard lock{m_pending_connects_lock};
+      m_pending_connects.erase(na);
+    };
+
     MDEBUG("Connecting to " << na.str() << "(peer_type=" << peer_type << ", last_seen: "
         << (last_seen_stamp ? epee::misc_utils::get_time_interval_string(time(NULL) - last_seen_stamp):"never")
         << ")...");
 
+    const auto connect_start = std::chrono::steady_clock::now();
     auto con = zone.m_connect(zone, na);
     if(!con)
     {
@@ -1230,6 +1283,7 @@ namespace nodetool
     pe_local.last_seen = static_cast<int64_t>(last_seen);
     pe_local.pruning_seed = con->m_pruning_seed;
     pe_local.rpc_port = con->m_rpc_port;
+    pe_local.handshake_ms = std::max<uint32_t>(1, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - connect_start).count());
     zone.m_peerlist.append_with_peer_white(pe_local);
     //update last seen and push it to peerlist manager
 
@@ -1375,12 +1429,14 @@ namespace nodetool
       }
 
       std::deque<size_t> filtered;
+      size_t filtered_stripe_matches = 0; // how many at the front of `filtered` have the needed stripe
+      std::unordered_map<size_t, uint32_t> handshake_ms;
       const size_t limit = use_white_list ? 20 : std::numeric_limits<size_t>::max();
       for (int step = 0; step < 2; ++step)
       {
         bool skip_duplicate_class_B = step == 0 && m_nettype == cryptonote::MAINNET;
         size_t idx = 0, skipped = 0;
-        zone.m_peerlist.foreach (use_white_list, [&classB, &filtered, &idx, &skipped, skip_duplicate_class_B, limit, next_needed_pruning_stripe](const peerlist_entry &pe){
+        zone.m_peerlist.foreach (use_white_list, [&classB, &filtered, &filtered_stripe_matches, &handshake_ms, &idx, &skipped, skip_duplicate_class_B, limit, next_needed_pruning_stripe](const peerlist_entry &pe){
           if (filtered.size() >= limit)
             return false;
           bool skip = false;
@@ -1395,7 +1451,12 @@ namespace nodetool
           else if (next_needed_pruning_stripe == 0 || pe.pruning_seed == 0)
             filtered.push_back(idx);
           else if (next_needed_pruning_stripe == tools::get_pruning_stripe(pe.pruning_seed))
+          {
             filtered.push_front(idx);
+            ++filtered_stripe_matches;
+          }
+          if (!skip && pe.handshake_ms)
+            handshake_ms[idx] = pe.handshake_ms;
           ++idx;
           return true;
         });
@@ -1409,6 +1470,20 @@ namespace nodetool
         MDEBUG("No available peer in " << (use_white_list ? "white" : "gray") << " list filtered by " << next_needed_pruning_stripe);
         return false;
       }
+      if (use_white_list && !handshake_ms.empty())
+      {
+        // The pick below favours the front of the list, so move peers that were quick to connect and
+        // handshake with last time ahead of slower and untried ones.  Times are bucketed so that
+        // recency still decides between similar peers, and stripe matches stay at the front.
+        auto latency_bucket = [&handshake_ms](size_t idx) {
+          auto it = handshake_ms.find(idx);
+          return it == handshake_ms.end() ? std::numeric_limits<uint32_t>::max() : it->second / P2P_HANDSHAKE_LATENCY_BUCKET_MS;
+        };
+        auto by_latency = [&latency_bucket](size_t a, size_t b) { return latency_bucket(a) < latency_bucket(b); };
+        const auto stripe_end = filtered.begin() + std::min(filtered_stripe_matches, filtered.size());
+        std::stable_sort(filtered.begin(), stripe_end, by_latency);
+        std::stable_sort(stripe_end, filtered.end(), by_latency);
+      }
       if (use_white_list)
       {
         // if using the white list, we first pick in the set of peers we've already been using earlier
@@ -1651,12 +1726,26 @@ namespace nodetool
         return false;
       }
 
-      if (peer_type == white && !make_new_connection_from_peerlist(zone, true)) {
-        return false;
-      }
-
-      if (peer_type == gray && !make_new_connection_from_peerlist(zone, false)) {
-        return false;
+      if (peer_type == white || peer_type == gray)
+      {
+        const bool use_white_list = peer_type == white;
+        const size_t attempts = std::min<size_t>(m_connect_fanout, expected_connections - conn_count);
+        if (attempts <= 1)
+          return make_new_connection_from_peerlist(zone, use_white_list);
+
+        // Each attempt blocks on its connect and handshake, so run several side by side rather than
+        // waiting out slow or unreachable peers one after another.  Concurrent attempts don't pick
+        // the same peer (see m_pending_connects), and there are never more of them than free slots.
+        std::vector<std::future<bool>> results;
+        results.reserve(attempts);
+        for (size_t i = 0; i < attempts; ++i)
+          results.push_back(std::async(std::launch::async, [this, &zone, use_white_list] {
+            return make_new_connection_from_peerlist(zone, use_white_list);
+          }));
+        bool connected = false;
+        for (auto& r : results)
+          connected |= r.get();
+        return connected;
       }
     }
     return true;
@@ -1763,7 +1852,7 @@ namespace nodetool
     m_peer_handshake_idle_maker_interval.do_call([this] { return peer_sync_idle_maker(); });
     m_connections_maker_interval.do_call([this] { return connections_maker(); });
     m_gray_peerlist_housekeeping_interval.do_call([this] { return gray_peerlist_housekeeping(); });
-    m_peerlist_store_interval.do_call([this] { return store_config(); });
+    m_peerlist_store_interval.do_call([this] { return store_config(true); });
     m_incoming_connections_interval.do_call([this] { return check_incoming_connections(); });
     return true;
   }
@@ -1942,13 +2031,13 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  epee::net_utils::zone node_server<t_payload_net_handler>::send_txs(std::vector<cryptonote::blobdata> txs, const epee::net_utils::zone origin, const boost::uuids::uuid& source, const bool pad_txs)
+  epee::net_utils::zone node_server<t_payload_net_handler>::send_txs(std::vector<cryptonote::blobdata> txs, const epee::net_utils::zone origin, const boost::uuids::uuid& source, const bool pad_txs, std::vector<crypto::hash> tx_hashes)
   {
     namespace enet = epee::net_utils;
 
-    const auto send = [&txs, &source, pad_txs] (std::pair<const enet::zone, network_zone>& network)
+    const auto send = [&txs, &source, pad_txs, &tx_hashes] (std::pair<const enet::zone, network_zone>& network)
     {
-      if (network.second.m_notifier.send_txs(std::move(txs), source, (pad_txs || network.first != enet::zone::public_)))
+      if (network.second.m_notifier.send_txs(std::move(txs), source, (pad_txs || network.first != enet::zone::public_), std::move(tx_hashes)))
         return network.first;
       return enet::zone::invalid;
     };
@@ -2801,13 +2890,22 @@ namespace nodetool
   std::optional<p2p_connection_context_t<typename t_payload_net_handler::connection_context>>
   node_server<t_payload_net_handler>::socks_connect(network_zone& zone, const epee::net_utils::network_address& remote)
   {
+    const auto start = std::chrono::steady_clock::now();
     auto result = socks_connect_internal(zone.m_net_server.get_stop_signal(), zone.m_net_server.get_io_service(), zone.m_proxy_address, remote);
     if (result) // if no error
     {
+      const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+      const uint64_t connects = ++zone.m_proxy_connects;
+      const uint64_t total_ms = zone.m_proxy_connect_ms += ms;
+      MINFO("Connected to " << remote.str() << " via " << zone.m_proxy_address << " in " << ms << "ms (average " << total_ms / connects
+          << "ms over " << connects << " connections, " << zone.m_proxy_connect_failures << " failed)");
+
       p2p_connection_context context{};
       if (zone.m_net_server.add_connection(context, std::move(*result), remote))
         return {std::move(context)};
     }
+    else
+      ++zone.m_proxy_connect_failures;
     return std::nullopt;
   }
 
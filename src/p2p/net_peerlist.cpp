@@ -240,11 +240,22 @@ namespace nodetool
 
   bool peerlist_storage::store(const fs::path& path, const peerlist_types& other) const
   {
-    fs::ofstream dest_file{path, std::ios::binary | std::ios::trunc};
-    if(dest_file.fail())
-      return false;
+    // Write to a temporary file and move it into place so that an interrupted write doesn't clobber
+    // the previously stored peers.
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+    {
+      fs::ofstream dest_file{tmp_path, std::ios::binary | std::ios::trunc};
+      if(dest_file.fail() || !store(dest_file, other))
+        return false;
+      dest_file.close();
+      if (dest_file.fail())
+        return false;
+    }
 
-    return store(dest_file, other);
+    std::error_code ec;
+    fs::rename(tmp_path, path, ec);
+    return !ec;
   }
 
   peerlist_types peerlist_storage::take_zone(epee::net_utils::zone zone)
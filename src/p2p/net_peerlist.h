@@ -39,6 +39,7 @@
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/ranked_index.hpp>
 #include <boost/multi_index/identity.hpp>
 #include <boost/multi_index/member.hpp>
 
@@ -84,7 +85,9 @@ namespace nodetool
     //! Save peers from `this` and `other` in stream `dest`.
     bool store(std::ostream& dest, const peerlist_types& other) const;
 
-    //! Save peers from `this` and `other` in one file at `path`.
+    //! Save peers from `this` and `other` in one file at `path`, replacing it only once the new
+    //! contents have been written in full.  Only reads `this`, so it is safe to call from another
+    //! thread as long as `this` isn't being modified.
     bool store(const fs::path& path, const peerlist_types& other) const;
 
     //! \return Peers in `zone` and from remove from `this`.
@@ -165,8 +168,9 @@ namespace nodetool
       boost::multi_index::indexed_by<
       // access by peerlist_entry::net_adress
       boost::multi_index::ordered_unique<boost::multi_index::tag<by_addr>, boost::multi_index::member<peerlist_entry,epee::net_utils::network_address,&peerlist_entry::adr> >,
-      // sort by peerlist_entry::last_seen<
-      boost::multi_index::ordered_non_unique<boost::multi_index::tag<by_time>, boost::multi_index::member<peerlist_entry,int64_t,&peerlist_entry::last_seen> >
+      // sort by peerlist_entry::last_seen; ranked so that picking the n-th most recent peer is
+      // O(log n) rather than a walk along the index
+      boost::multi_index::ranked_non_unique<boost::multi_index::tag<by_time>, boost::multi_index::member<peerlist_entry,int64_t,&peerlist_entry::last_seen> >
       > 
     > peers_indexed;
 
@@ -234,8 +238,7 @@ namespace nodetool
     if(i >= m_peers_white.size())
       return false;
 
-    peers_indexed::index<by_time>::type& by_time_index = m_peers_white.get<by_time>();
-    p = *epee::misc_utils::move_it_backward(std::prev(by_time_index.end()), i);
+    p = *m_peers_white.get<by_time>().nth(m_peers_white.size() - 1 - i);
     return true;
   }
   //--------------------------------------------------------------------------------------------------
@@ -246,8 +249,7 @@ namespace nodetool
     if(i >= m_peers_gray.size())
       return false;
 
-    peers_indexed::index<by_time>::type& by_time_index = m_peers_gray.get<by_time>();
-    p = *epee::misc_utils::move_it_backward(std::prev(by_time_index.end()), i);
+    p = *m_peers_gray.get<by_time>().nth(m_peers_gray.size() - 1 - i);
     return true;
   }
   //--------------------------------------------------------------------------------------------------
@@ -356,6 +358,8 @@ namespace nodetool
       if (by_addr_it_wt->rpc_port && ple.rpc_port == 0) // guard against older nodes not passing RPC port around
         new_ple.rpc_port = by_addr_it_wt->rpc_port;
       new_ple.last_seen = by_addr_it_wt->last_seen; // do not overwrite the last seen timestamp, incoming peer list are untrusted
+      if (ple.handshake_ms == 0) // only set by our own outgoing connections
+        new_ple.handshake_ms = by_addr_it_wt->handshake_ms;
       m_peers_white.replace(by_addr_it_wt, new_ple);
     }
     //remove from gray list, if need
@@ -397,6 +401,7 @@ namespace nodetool
       if (by_addr_it_gr->rpc_port && ple.rpc_port == 0) // guard against older nodes not passing RPC port around
         new_ple.rpc_port = by_addr_it_gr->rpc_port;
       new_ple.last_seen = by_addr_it_gr->last_seen; // do not overwrite the last seen timestamp, incoming peer list are untrusted
+      new_ple.handshake_ms = by_addr_it_gr->handshake_ms;
       m_peers_gray.replace(by_addr_it_gr, new_ple);
     }
     return true;
@@ -434,8 +439,7 @@ namespace nodetool
 
     size_t random_index = crypto::rand_idx(m_peers_gray.size());
 
-    peers_indexed::index<by_time>::type& by_time_index = m_peers_gray.get<by_time>();
-    pe = *epee::misc_utils::move_it_backward(std::prev(by_time_index.end()), random_index);
+    pe = *m_peers_gray.get<by_time>().nth(m_peers_gray.size() - 1 - random_index);
 
     return true;
 
@@ -42,7 +42,7 @@
 #include "common/pruning.h"
 #endif
 
-BOOST_CLASS_VERSION(nodetool::peerlist_entry, 2)
+BOOST_CLASS_VERSION(nodetool::peerlist_entry, 3)
 
 namespace boost
 {
@@ -241,6 +241,13 @@ namespace boost
         return;
       }
       a & pl.rpc_port;
+      if (ver < 3)
+      {
+        if (!typename Archive::is_saving())
+          pl.handshake_ms = 0;
+        return;
+      }
+      a & pl.handshake_ms;
     }
 
     template <class Archive, class ver_type>
@@ -75,6 +75,9 @@ namespace nodetool
     int64_t last_seen;
     uint32_t pruning_seed;
     uint16_t rpc_port;
+    // How long (in ms) our last outgoing connect and handshake with this peer took, 0 if unknown.
+    // Only kept in our own stored peerlist: it isn't sent to (or accepted from) other peers.
+    uint32_t handshake_ms = 0;
 
     BEGIN_KV_SERIALIZE_MAP()
       KV_SERIALIZE(adr)
@@ -33,6 +33,7 @@
 #include "epee/misc_log_ex.h"
 #include "epee/span.h"
 #include "common/perf_timer.h"
+#include "common/threadpool.h"
 #include "common/varint.h"
 #include "cryptonote_config.h"
 extern "C"
@@ -41,6 +42,7 @@ extern "C"
 }
 #include "rctOps.h"
 #include "multiexp.h"
+#include "multiexp_backend.h"
 #include "bulletproofs.h"
 
 #undef OXEN_DEFAULT_LOG_CATEGORY
@@ -57,7 +59,10 @@ extern "C"
 #endif
 
 #define STRAUS_SIZE_LIMIT 232
-#define PIPPENGER_SIZE_LIMIT 0
+
+// Proving runs pairs of independent multiexps (and generator folds) of this many points or more
+// on two threads
+#define PROVE_PARALLEL_MIN_SIZE 64
 
 namespace rct
 {
@@ -71,8 +76,15 @@ static constexpr size_t maxN = 64;
 static constexpr size_t maxM = BULLETPROOF_MAX_OUTPUTS;
 static rct::key Hi[maxN*maxM], Gi[maxN*maxM];
 static ge_p3 Hi_p3[maxN*maxM], Gi_p3[maxN*maxM];
+
+// Precomputed forms of the (interleaved) Gi/Hi generators, covering the first *_HiGi_size of them.
+// They are grown as larger proofs (or batches) need them, up to what fits in cache_limit.
+static std::mutex cache_mutex;
+static size_t cache_limit = BULLETPROOF_DEFAULT_CACHE_SIZE;
 static std::shared_ptr<straus_cached_data> straus_HiGi_cache;
+static size_t straus_HiGi_size = 0;
 static std::shared_ptr<pippenger_cached_data> pippenger_HiGi_cache;
+static size_t pippenger_HiGi_size = 0;
 static const rct::key TWO = { {0x02, 0x00, 0x00,0x00 , 0x00, 0x00, 0x00,0x00 , 0x00, 0x00, 0x00,0x00 , 0x00, 0x00, 0x00,0x00 , 0x00, 0x00, 0x00,0x00 , 0x00, 0x00, 0x00,0x00 , 0x00, 0x00, 0x00,0x00 , 0x00, 0x00, 0x00,0x00  } };
 static const rct::key MINUS_ONE = { { 0xec, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58, 0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10 } };
 static const rct::key MINUS_INV_EIGHT = { { 0x74, 0xa4, 0x19, 0x7a, 0xf0, 0x7d, 0x0b, 0xf7, 0x05, 0xc2, 0xda, 0x25, 0x2b, 0x5c, 0x0b, 0x0d, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0a } };
@@ -81,12 +93,65 @@ static const rct::keyV twoN = vector_powers(TWO, maxN);
 static const rct::key ip12 = inner_product(oneN, twoN);
 static std::mutex init_mutex;
 
+static std::vector<MultiexpData> HiGi_data(size_t size)
+{
+  std::vector<MultiexpData> data;
+  data.reserve(size);
+  for (size_t i = 0; i < size; ++i)
+    data.push_back({rct::zero(), i % 2 ? Hi_p3[i / 2] : Gi_p3[i / 2]});
+  return data;
+}
+
+// How many of the Gi/Hi generators each cache may cover within cache_limit.  The Pippenger one
+// comes first: it is what batch verification, and so the daemon, uses, and it takes 1/15 of the
+// space per generator.
+static size_t pippenger_HiGi_limit()
+{
+  return std::min(2*maxN*maxM, cache_limit / pippenger_cache_bytes(1));
+}
+
+static size_t straus_HiGi_limit()
+{
+  return std::min<size_t>(STRAUS_SIZE_LIMIT, (cache_limit - pippenger_cache_bytes(pippenger_HiGi_limit())) / straus_cache_bytes(1));
+}
+
+static void grow_HiGi_caches(size_t HiGi_size, bool straus)
+{
+  const size_t pippenger_size = std::min(HiGi_size, pippenger_HiGi_limit());
+  if (pippenger_size > pippenger_HiGi_size)
+  {
+    pippenger_HiGi_cache = pippenger_init_cache(HiGi_data(pippenger_size));
+    pippenger_HiGi_size = pippenger_size;
+    MDEBUG("Pippenger Hi/Gi cache grown to " << pippenger_HiGi_size << " generators (" << pippenger_cache_bytes(pippenger_HiGi_size)/1024 << " kB)");
+  }
+  if (straus && HiGi_size > straus_HiGi_size && HiGi_size <= straus_HiGi_limit())
+  {
+    straus_HiGi_cache = straus_init_cache(HiGi_data(HiGi_size));
+    straus_HiGi_size = HiGi_size;
+    MDEBUG("Straus Hi/Gi cache grown to " << straus_HiGi_size << " generators (" << straus_cache_bytes(straus_HiGi_size)/1024 << " kB)");
+  }
+}
+
 static inline rct::key multiexp(const std::vector<MultiexpData> &data, size_t HiGi_size)
 {
   if (HiGi_size > 0)
   {
-    static_assert(232 <= STRAUS_SIZE_LIMIT, "Straus in precalc mode can only be calculated till STRAUS_SIZE_LIMIT");
-    return HiGi_size <= 232 && data.size() == HiGi_size ? straus(data, straus_HiGi_cache, 0) : pippenger(data, pippenger_HiGi_cache, HiGi_size, get_pippenger_c(data.size()));
+    std::shared_ptr<straus_cached_data> straus_cache;
+    std::shared_ptr<pippenger_cached_data> pippenger_cache;
+    size_t pippenger_size;
+    {
+      std::lock_guard lock{cache_mutex};
+      grow_HiGi_caches(HiGi_size, data.size() == HiGi_size);
+      if (straus_HiGi_size >= HiGi_size)
+        straus_cache = straus_HiGi_cache;
+      pippenger_cache = pippenger_HiGi_cache;
+      pippenger_size = std::min(HiGi_size, pippenger_HiGi_size);
+    }
+    if (straus_cache && data.size() == HiGi_size)
+      return straus(data, straus_cache, 0);
+    if (pippenger_size == 0)
+      pippenger_cache.reset();
+    return pippenger(data, pippenger_cache, pippenger_size, get_pippenger_c(data.size()));
   }
   else
     return data.size() <= 95 ? straus(data, NULL, 0) : pippenger(data, NULL, 0, get_pippenger_c(data.size()));
@@ -116,31 +181,35 @@ static void init_exponents()
   static bool init_done = false;
   if (init_done)
     return;
-  std::vector<MultiexpData> data;
-  data.reserve(maxN*maxM*2);
   for (size_t i = 0; i < maxN*maxM; ++i)
   {
     Hi[i] = get_exponent(rct::H, i * 2);
     CHECK_AND_ASSERT_THROW_MES(ge_frombytes_vartime(&Hi_p3[i], Hi[i].bytes) == 0, "ge_frombytes_vartime failed");
     Gi[i] = get_exponent(rct::H, i * 2 + 1);
     CHECK_AND_ASSERT_THROW_MES(ge_frombytes_vartime(&Gi_p3[i], Gi[i].bytes) == 0, "ge_frombytes_vartime failed");
-
-    data.push_back({rct::zero(), Gi_p3[i]});
-    data.push_back({rct::zero(), Hi_p3[i]});
   }
 
-  straus_HiGi_cache = straus_init_cache(data, STRAUS_SIZE_LIMIT);
-  pippenger_HiGi_cache = pippenger_init_cache(data, 0, PIPPENGER_SIZE_LIMIT);
-
   MINFO("Hi/Gi cache size: " << (sizeof(Hi)+sizeof(Gi))/1024 << " kB");
   MINFO("Hi_p3/Gi_p3 cache size: " << (sizeof(Hi_p3)+sizeof(Gi_p3))/1024 << " kB");
-  MINFO("Straus cache size: " << straus_get_cache_size(straus_HiGi_cache)/1024 << " kB");
-  MINFO("Pippenger cache size: " << pippenger_get_cache_size(pippenger_HiGi_cache)/1024 << " kB");
-  size_t cache_size = (sizeof(Hi)+sizeof(Hi_p3))*2 + straus_get_cache_size(straus_HiGi_cache) + pippenger_get_cache_size(pippenger_HiGi_cache);
-  MINFO("Total cache size: " << cache_size/1024 << "kB");
   init_done = true;
 }
 
+void bulletproof_set_cache_size(size_t bytes)
+{
+  std::lock_guard lock{cache_mutex};
+  cache_limit = bytes;
+  if (pippenger_HiGi_size > pippenger_HiGi_limit())
+  {
+    pippenger_HiGi_cache.reset();
+    pippenger_HiGi_size = 0;
+  }
+  if (straus_HiGi_size > straus_HiGi_limit())
+  {
+    straus_HiGi_cache.reset();
+    straus_HiGi_size = 0;
+  }
+}
+
 /* Given two scalar arrays, construct a vector commitment */
 static rct::key vector_exponent(const rct::keyV &a, const rct::keyV &b)
 {
@@ -255,18 +324,6 @@ static rct::key inner_product(const rct::keyV &a, const rct::keyV &b)
   return inner_product(epee::span<const rct::key>(a.data(), a.size()), epee::span<const rct::key>(b.data(), b.size()));
 }
 
-/* Given two scalar arrays, construct the Hadamard product */
-static rct::keyV hadamard(const rct::keyV &a, const rct::keyV &b)
-{
-  CHECK_AND_ASSERT_THROW_MES(a.size() == b.size(), "Incompatible sizes of a and b");
-  rct::keyV res(a.size());
-  for (size_t i = 0; i < a.size(); ++i)
-  {
-    sc_mul(res[i].bytes, a[i].bytes, b[i].bytes);
-  }
-  return res;
-}
-
 /* folds a curvepoint array using a two way scaled Hadamard product */
 static void hadamard_fold(std::vector<ge_p3> &v, const rct::keyV *scale, const rct::key &a, const rct::key &b)
 {
@@ -285,29 +342,6 @@ static void hadamard_fold(std::vector<ge_p3> &v, const rct::keyV *scale, const r
   v.resize(sz);
 }
 
-/* Add two vectors */
-static rct::keyV vector_add(const rct::keyV &a, const rct::keyV &b)
-{
-  CHECK_AND_ASSERT_THROW_MES(a.size() == b.size(), "Incompatible sizes of a and b");
-  rct::keyV res(a.size());
-  for (size_t i = 0; i < a.size(); ++i)
-  {
-    sc_add(res[i].bytes, a[i].bytes, b[i].bytes);
-  }
-  return res;
-}
-
-/* Add a scalar to all elements of a vector */
-static rct::keyV vector_add(const rct::keyV &a, const rct::key &b)
-{
-  rct::keyV res(a.size());
-  for (size_t i = 0; i < a.size(); ++i)
-  {
-    sc_add(res[i].bytes, a[i].bytes, b.bytes);
-  }
-  return res;
-}
-
 /* Subtract a scalar from all elements of a vector */
 static rct::keyV vector_subtract(const rct::keyV &a, const rct::key &b)
 {
@@ -319,22 +353,6 @@ static rct::keyV vector_subtract(const rct::keyV &a, const rct::key &b)
   return res;
 }
 
-/* Multiply a scalar and a vector */
-static rct::keyV vector_scalar(const epee::span<const rct::key> &a, const rct::key &x)
-{
-  rct::keyV res(a.size());
-  for (size_t i = 0; i < a.size(); ++i)
-  {
-    sc_mul(res[i].bytes, a[i].bytes, x.bytes);
-  }
-  return res;
-}
-
-static rct::keyV vector_scalar(const rct::keyV &a, const rct::key &x)
-{
-  return vector_scalar(epee::span<const rct::key>(a.data(), a.size()), x);
-}
-
 /* Create a vector from copies of a single value */
 static rct::keyV vector_dup(const rct::key &x, size_t N)
 {
@@ -431,6 +449,40 @@ static rct::keyV invert(rct::keyV x)
   return x;
 }
 
+/* Runs a and b, concurrently if `parallel` and the threadpool has more than one thread */
+template <typename A, typename B>
+static void run_pair(bool parallel, A&& a, B&& b)
+{
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  if (!parallel || tpool.get_max_concurrency() < 2)
+  {
+    a();
+    b();
+    return;
+  }
+  std::exception_ptr a_error;
+  tools::threadpool::waiter waiter;
+  tpool.submit(&waiter, [&] { try { a(); } catch (...) { a_error = std::current_exception(); } }, true);
+  b();
+  waiter.wait(&tpool);
+  if (a_error)
+    std::rethrow_exception(a_error);
+}
+
+/* Folds the two halves of a scalar vector into its first half: a[i] = a[i]*x + a[n+i]*y */
+static void fold(rct::keyV &a, const rct::key &x, const rct::key &y)
+{
+  CHECK_AND_ASSERT_THROW_MES((a.size() & 1) == 0, "Vector size should be even");
+  const size_t sz = a.size() / 2;
+  rct::key tmp;
+  for (size_t i = 0; i < sz; ++i)
+  {
+    sc_mul(tmp.bytes, a[sz + i].bytes, y.bytes);
+    sc_muladd(a[i].bytes, a[i].bytes, x.bytes, tmp.bytes);
+  }
+  a.resize(sz);
+}
+
 /* Compute the slice of a vector */
 static epee::span<const rct::key> slice(const rct::keyV &a, size_t start, size_t stop)
 {
@@ -569,17 +621,19 @@ try_again:
   PERF_TIMER_START_BP(PROVE_step1);
   // PAPER LINES 43-44
   rct::key alpha = rct::skGen();
-  rct::key ve = vector_exponent(aL8, aR8);
-  rct::key A;
-  sc_mul(tmp.bytes, alpha.bytes, INV_EIGHT.bytes);
-  rct::addKeys(A, ve, rct::scalarmultBase(tmp));
-
   // PAPER LINES 45-47
   rct::keyV sL = rct::skvGen(MN), sR = rct::skvGen(MN);
   rct::key rho = rct::skGen();
-  ve = vector_exponent(sL, sR);
+  rct::key ve_a, ve_s;
+  run_pair(MN >= PROVE_PARALLEL_MIN_SIZE,
+      [&] { ve_a = vector_exponent(aL8, aR8); },
+      [&] { ve_s = vector_exponent(sL, sR); });
+  rct::key A;
+  sc_mul(tmp.bytes, alpha.bytes, INV_EIGHT.bytes);
+  rct::addKeys(A, ve_a, rct::scalarmultBase(tmp));
+
   rct::key S;
-  rct::addKeys(S, ve, rct::scalarmultBase(rho));
+  rct::addKeys(S, ve_s, rct::scalarmultBase(rho));
   S = rct::scalarmultKey(S, INV_EIGHT);
 
   // PAPER LINES 48-50
@@ -603,24 +657,23 @@ try_again:
   rct::keyV l0 = vector_subtract(aL, z);
   const rct::keyV &l1 = sL;
 
-  rct::keyV zero_twos(MN);
+  // r0 = (aR + z) o y^MN + zpow[j+2] * 2^i, r1 = y^MN o sR
   const rct::keyV zpow = vector_powers(z, M+2);
+  const auto yMN = vector_powers(y, MN);
+  rct::keyV r0(MN), r1(MN);
   for (size_t j = 0; j < M; ++j)
   {
+      CHECK_AND_ASSERT_THROW_MES(j+2 < zpow.size(), "invalid zpow index");
       for (size_t i = 0; i < N; ++i)
       {
-          CHECK_AND_ASSERT_THROW_MES(j+2 < zpow.size(), "invalid zpow index");
-          CHECK_AND_ASSERT_THROW_MES(i < twoN.size(), "invalid twoN index");
-          sc_mul(zero_twos[j*N+i].bytes,zpow[j+2].bytes,twoN[i].bytes);
+          const size_t k = j*N+i;
+          sc_mul(tmp2.bytes, zpow[j+2].bytes, twoN[i].bytes);
+          sc_add(tmp.bytes, aR[k].bytes, z.bytes);
+          sc_muladd(r0[k].bytes, tmp.bytes, yMN[k].bytes, tmp2.bytes);
+          sc_mul(r1[k].bytes, yMN[k].bytes, sR[k].bytes);
       }
   }
 
-  rct::keyV r0 = vector_add(aR, z);
-  const auto yMN = vector_powers(y, MN);
-  r0 = hadamard(r0, yMN);
-  r0 = vector_add(r0, zero_twos);
-  rct::keyV r1 = hadamard(yMN, sR);
-
   // Polynomial construction before PAPER LINE 51
   rct::key t1_1 = inner_product(l0, r1);
   rct::key t1_2 = inner_product(l1, r0);
@@ -669,10 +722,12 @@ try_again:
   sc_muladd(mu.bytes, x.bytes, rho.bytes, alpha.bytes);
 
   // PAPER LINES 58-60
-  rct::keyV l = l0;
-  l = vector_add(l, vector_scalar(l1, x));
-  rct::keyV r = r0;
-  r = vector_add(r, vector_scalar(r1, x));
+  rct::keyV l(MN), r(MN);
+  for (size_t i = 0; i < MN; ++i)
+  {
+    sc_muladd(l[i].bytes, l1[i].bytes, x.bytes, l0[i].bytes);
+    sc_muladd(r[i].bytes, r1[i].bytes, x.bytes, r0[i].bytes);
+  }
   PERF_TIMER_STOP_BP(PROVE_step2);
 
   PERF_TIMER_START_BP(PROVE_step3);
@@ -698,23 +753,16 @@ try_again:
 
   // These are used in the inner product rounds
   size_t nprime = MN;
-  std::vector<ge_p3> Gprime(MN);
-  std::vector<ge_p3> Hprime(MN);
-  rct::keyV aprime(MN);
-  rct::keyV bprime(MN);
+  std::vector<ge_p3> Gprime(Gi_p3, Gi_p3 + MN);
+  std::vector<ge_p3> Hprime(Hi_p3, Hi_p3 + MN);
+  rct::keyV aprime = std::move(l);
+  rct::keyV bprime = std::move(r);
   const rct::key yinv = invert(y);
   rct::keyV yinvpow(MN);
   yinvpow[0] = rct::identity();
   yinvpow[1] = yinv;
-  for (size_t i = 0; i < MN; ++i)
-  {
-    Gprime[i] = Gi_p3[i];
-    Hprime[i] = Hi_p3[i];
-    if (i > 1)
-      sc_mul(yinvpow[i].bytes, yinvpow[i-1].bytes, yinv.bytes);
-    aprime[i] = l[i];
-    bprime[i] = r[i];
-  }
+  for (size_t i = 2; i < MN; ++i)
+    sc_mul(yinvpow[i].bytes, yinvpow[i-1].bytes, yinv.bytes);
   rct::keyV L(logMN);
   rct::keyV R(logMN);
   int round = 0;
@@ -736,10 +784,12 @@ try_again:
 
     // PAPER LINES 23-24
     PERF_TIMER_START_BP(PROVE_LR);
+    const bool parallel = nprime >= PROVE_PARALLEL_MIN_SIZE;
     sc_mul(tmp.bytes, cL.bytes, x_ip.bytes);
-    L[round] = cross_vector_exponent8(nprime, Gprime, nprime, Hprime, 0, aprime, 0, bprime, nprime, scale, &ge_p3_H, &tmp);
-    sc_mul(tmp.bytes, cR.bytes, x_ip.bytes);
-    R[round] = cross_vector_exponent8(nprime, Gprime, 0, Hprime, nprime, aprime, nprime, bprime, 0, scale, &ge_p3_H, &tmp);
+    sc_mul(tmp2.bytes, cR.bytes, x_ip.bytes);
+    run_pair(parallel,
+        [&] { L[round] = cross_vector_exponent8(nprime, Gprime, nprime, Hprime, 0, aprime, 0, bprime, nprime, scale, &ge_p3_H, &tmp); },
+        [&] { R[round] = cross_vector_exponent8(nprime, Gprime, 0, Hprime, nprime, aprime, nprime, bprime, 0, scale, &ge_p3_H, &tmp2); });
     PERF_TIMER_STOP_BP(PROVE_LR);
 
     // PAPER LINES 25-27
@@ -756,15 +806,16 @@ try_again:
     if (nprime > 1)
     {
       PERF_TIMER_START_BP(PROVE_hadamard2);
-      hadamard_fold(Gprime, NULL, winv, w[round]);
-      hadamard_fold(Hprime, scale, w[round], winv);
+      run_pair(parallel,
+          [&] { hadamard_fold(Gprime, NULL, winv, w[round]); },
+          [&] { hadamard_fold(Hprime, scale, w[round], winv); });
       PERF_TIMER_STOP_BP(PROVE_hadamard2);
     }
 
     // PAPER LINES 33-34
     PERF_TIMER_START_BP(PROVE_prime);
-    aprime = vector_add(vector_scalar(slice(aprime, 0, nprime), w[round]), vector_scalar(slice(aprime, nprime, aprime.size()), winv));
-    bprime = vector_add(vector_scalar(slice(bprime, 0, nprime), winv), vector_scalar(slice(bprime, nprime, bprime.size()), w[round]));
+    fold(aprime, w[round], winv);
+    fold(bprime, winv, w[round]);
     PERF_TIMER_STOP_BP(PROVE_prime);
 
     scale = NULL;
@@ -1068,7 +1119,9 @@ bool bulletproof_VERIFY(const std::vector<const Bulletproof*> &proofs)
     multiexp_data[i * 2] = {m_z4[i], Gi_p3[i]};
     multiexp_data[i * 2 + 1] = {m_z5[i], Hi_p3[i]};
   }
-  if (!(multiexp(multiexp_data, 2 * maxMN) == rct::identity()))
+  // The one multiexp worth handing to another backend (e.g. a GPU): see multiexp_backend.h
+  const rct::key check = backend_multiexp(multiexp_data, [&] { return multiexp(multiexp_data, 2 * maxMN); });
+  if (!(check == rct::identity()))
   {
     PERF_TIMER_STOP_BP(VERIFY_step2_check);
     MERROR("Verification failure");
@@ -46,6 +46,11 @@ bool bulletproof_VERIFY(const Bulletproof &proof);
 bool bulletproof_VERIFY(const std::vector<const Bulletproof*> &proofs);
 bool bulletproof_VERIFY(const std::vector<Bulletproof> &proofs);
 
+// Sets how much memory (in bytes) the precomputed Gi/Hi multiexp tables may use.  They are built as
+// proofs need them, up to the size needed for the largest possible batch; larger limits are
+// allowed but have no use beyond that.  Tables over a lowered limit are dropped (and regrown within it).
+void bulletproof_set_cache_size(size_t bytes);
+
 }
 
 #endif
@@ -0,0 +1,116 @@
+#include "multiexp_backend.h"
+
+#include <mutex>
+#include <stdexcept>
+
+#include "epee/misc_log_ex.h"
+
+#undef OXEN_DEFAULT_LOG_CATEGORY
+#define OXEN_DEFAULT_LOG_CATEGORY "multiexp"
+
+namespace rct
+{
+
+namespace
+{
+  std::mutex backends_mutex;
+  std::vector<std::shared_ptr<multiexp_backend>> backends;
+  std::shared_ptr<multiexp_backend> selected; // null for the CPU
+  size_t selected_check_every = 0;
+
+  // Drops `backend` if it is still the one selected (several threads can find the same mismatch)
+  void drop_backend(const std::shared_ptr<multiexp_backend> &backend)
+  {
+    std::lock_guard lock{backends_mutex};
+    if (selected == backend)
+      selected.reset();
+  }
+}
+
+void register_multiexp_backend(std::shared_ptr<multiexp_backend> backend)
+{
+  auto name = backend->name();
+  std::lock_guard lock{backends_mutex};
+  if (name == "cpu")
+    throw std::invalid_argument{"multiexp backend name 'cpu' is reserved"};
+  for (const auto &b : backends)
+    if (b->name() == name)
+      throw std::invalid_argument{"multiexp backend '" + name + "' is already registered"};
+  backends.push_back(std::move(backend));
+}
+
+std::vector<std::string> multiexp_backend_names()
+{
+  std::vector<std::string> names{{"cpu"}};
+  std::lock_guard lock{backends_mutex};
+  for (const auto &b : backends)
+    names.push_back(b->name());
+  return names;
+}
+
+void select_multiexp_backend(std::string_view name, size_t check_every)
+{
+  std::lock_guard lock{backends_mutex};
+  if (name == "cpu")
+  {
+    selected.reset();
+    return;
+  }
+  for (const auto &b : backends)
+  {
+    if (b->name() == name)
+    {
+      selected = b;
+      selected_check_every = check_every;
+      MGINFO("Using multiexp backend '" << name << "' for batch verification" <<
+          (check_every ? ", checking 1 in " + std::to_string(check_every) + " results on the CPU" : ""));
+      return;
+    }
+  }
+  throw std::invalid_argument{"unknown multiexp backend '" + std::string{name} + "'"};
+}
+
+std::string selected_multiexp_backend()
+{
+  std::lock_guard lock{backends_mutex};
+  return selected ? selected->name() : "cpu";
+}
+
+rct::key backend_multiexp(const std::vector<MultiexpData> &data, const std::function<rct::key()> &cpu)
+{
+  std::shared_ptr<multiexp_backend> backend;
+  size_t check_every;
+  {
+    std::lock_guard lock{backends_mutex};
+    backend = selected;
+    check_every = selected_check_every;
+  }
+  if (!backend || data.size() < backend->min_size())
+    return cpu();
+
+  std::optional<rct::key> result;
+  try
+  {
+    result = backend->multiexp(data);
+  }
+  catch (const std::exception &e)
+  {
+    MWARNING("Multiexp backend '" << backend->name() << "' failed: " << e.what() << "; using the CPU");
+  }
+  if (!result)
+    return cpu();
+
+  if (check_every > 0 && crypto::rand<uint64_t>() % check_every == 0)
+  {
+    rct::key expected = cpu();
+    if (!(*result == expected))
+    {
+      MERROR("Multiexp backend '" << backend->name() << "' gave a wrong result for " << data.size() << " terms; dropping it and using the CPU from now on");
+      drop_backend(backend);
+      return expected;
+    }
+  }
+  return *result;
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "multiexp.h"
+
+namespace rct
+{
+
+// Pluggable implementations of the large multiexp that bulletproof batch verification ends in (the
+// Gi/Hi generators plus every proof's points, all in one sum), which is what bounds a full
+// verification resync.  The built-in CPU implementation (straus/pippenger, see multiexp.h) is the
+// default; other backends, e.g. for a GPU, register themselves with register_multiexp_backend() and
+// get picked at startup with select_multiexp_backend().
+//
+// A wrong answer from a backend would mean accepting invalid proofs (or rejecting valid ones), so a
+// sample of its results are recomputed on the CPU; on any mismatch the backend is dropped and all
+// multiexps go back to the CPU.
+class multiexp_backend
+{
+public:
+  virtual ~multiexp_backend() = default;
+
+  // The name it is selected by
+  virtual std::string name() const = 0;
+
+  // The smallest multiexp (in terms) worth handing to this backend; smaller ones stay on the CPU
+  virtual size_t min_size() const { return 0; }
+
+  // Computes the multiexp of `data`, or returns nullopt if it can't right now (e.g. the device
+  // failed), in which case the CPU computes it instead.  May be called from several threads at once.
+  virtual std::optional<rct::key> multiexp(const std::vector<MultiexpData> &data) = 0;
+};
+
+// Makes a backend available for selection; throws std::invalid_argument if the name is taken
+void register_multiexp_backend(std::shared_ptr<multiexp_backend> backend);
+
+// The names of the available backends, starting with the built-in "cpu"
+std::vector<std::string> multiexp_backend_names();
+
+// Selects the backend named `name` ("cpu" for the built-in one), with 1 in `check_every` of its
+// results (0: none) checked against the CPU.  Throws std::invalid_argument for an unknown name.
+void select_multiexp_backend(std::string_view name, size_t check_every);
+
+// The name of the backend in use: "cpu" unless another was selected (and hasn't been dropped)
+std::string selected_multiexp_backend();
+
+// Computes the multiexp of `data` with the selected backend if `data` is big enough for it, and
+// otherwise (or if it declines) with `cpu`, which is also what sampled checks compare with.
+rct::key backend_multiexp(const std::vector<MultiexpData> &data, const std::function<rct::key()> &cpu);
+
+}
@@ -34,6 +34,7 @@
 #include "common/util.h"
 #include "rctSigs.h"
 #include "bulletproofs.h"
+#include "crypto/hash_to_point_cache.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_config.h"
 
@@ -337,7 +338,7 @@ namespace rct {
 
                 // Compute R directly
                 ge_p3 hash8_p3;
-                hash_to_p3(hash8_p3, pk[i][j]);
+                crypto::hash_to_point_cached(rct2pk(pk[i][j]), hash8_p3);
                 ge_p2 R_p2;
                 ge_double_scalarmult_precomp_vartime(&R_p2, rv.ss[i][j].bytes, &hash8_p3, c_old.bytes, Ip[j].k);
                 ge_tobytes(R.bytes, &R_p2);
@@ -605,42 +606,43 @@ namespace rct {
             precomp(I_precomp.k,sig.I);
             precomp(D_precomp.k,D_8);
 
-            // Aggregation hashes
-            keyV mu_P_to_hash(2*n+4); // domain, I, D, P, C, C_offset
-            keyV mu_C_to_hash(2*n+4); // domain, I, D, P, C, C_offset
-            sc_0(mu_P_to_hash[0].bytes);
-            memcpy(mu_P_to_hash[0].bytes, config::HASH_KEY_CLSAG_AGG_0.data(), config::HASH_KEY_CLSAG_AGG_0.size());
-            sc_0(mu_C_to_hash[0].bytes);
-            memcpy(mu_C_to_hash[0].bytes, config::HASH_KEY_CLSAG_AGG_1.data(), config::HASH_KEY_CLSAG_AGG_1.size());
-            for (size_t i = 1; i < n+1; ++i) {
-                mu_P_to_hash[i] = pubs[i-1].dest;
-                mu_C_to_hash[i] = pubs[i-1].dest;
-            }
-            for (size_t i = n+1; i < 2*n+1; ++i) {
-                mu_P_to_hash[i] = pubs[i-n-1].mask;
-                mu_C_to_hash[i] = pubs[i-n-1].mask;
+            // Aggregation hashes, of domain, P, C, I, D, C_offset.  The two differ only in their
+            // domain, so they are hashed from the same buffer (on the stack for common ring sizes).
+            constexpr size_t STACK_RING_SIZE = 16;
+            key to_hash_stack[2*STACK_RING_SIZE+4];
+            std::unique_ptr<key[]> to_hash_heap;
+            key* to_hash = to_hash_stack;
+            if (n > STACK_RING_SIZE)
+            {
+                to_hash_heap.reset(new key[2*n+4]);
+                to_hash = to_hash_heap.get();
             }
-            mu_P_to_hash[2*n+1] = sig.I;
-            mu_P_to_hash[2*n+2] = sig.D;
-            mu_P_to_hash[2*n+3] = C_offset;
-            mu_C_to_hash[2*n+1] = sig.I;
-            mu_C_to_hash[2*n+2] = sig.D;
-            mu_C_to_hash[2*n+3] = C_offset;
-            key mu_P, mu_C;
-            mu_P = hash_to_scalar(mu_P_to_hash);
-            mu_C = hash_to_scalar(mu_C_to_hash);
-
-            // Set up round hash
-            keyV c_to_hash(2*n+5); // domain, P, C, C_offset, message, L, R
-            sc_0(c_to_hash[0].bytes);
-            memcpy(c_to_hash[0].bytes, config::HASH_KEY_CLSAG_ROUND.data(), config::HASH_KEY_CLSAG_ROUND.size());
-            for (size_t i = 1; i < n+1; ++i)
+            for (size_t i = 0; i < n; ++i)
             {
-                c_to_hash[i] = pubs[i-1].dest;
-                c_to_hash[i+n] = pubs[i-1].mask;
+                to_hash[i+1] = pubs[i].dest;
+                to_hash[i+n+1] = pubs[i].mask;
             }
-            c_to_hash[2*n+1] = C_offset;
-            c_to_hash[2*n+2] = message;
+            to_hash[2*n+1] = sig.I;
+            to_hash[2*n+2] = sig.D;
+            to_hash[2*n+3] = C_offset;
+            key mu_P, mu_C;
+            sc_0(to_hash[0].bytes);
+            memcpy(to_hash[0].bytes, config::HASH_KEY_CLSAG_AGG_0.data(), config::HASH_KEY_CLSAG_AGG_0.size());
+            hash_to_scalar(mu_P, to_hash, (2*n+4)*sizeof(key));
+            sc_0(to_hash[0].bytes);
+            memcpy(to_hash[0].bytes, config::HASH_KEY_CLSAG_AGG_1.data(), config::HASH_KEY_CLSAG_AGG_1.size());
+            hash_to_scalar(mu_C, to_hash, (2*n+4)*sizeof(key));
+
+            // Set up round hash, of domain, P, C, C_offset, message, L, R: everything but L and R is
+            // the same for every round, so is absorbed once and the state copied for each round.
+            KECCAK_CTX round_prefix;
+            keccak_init(&round_prefix);
+            sc_0(to_hash[0].bytes);
+            memcpy(to_hash[0].bytes, config::HASH_KEY_CLSAG_ROUND.data(), config::HASH_KEY_CLSAG_ROUND.size());
+            keccak_update(&round_prefix, to_hash[0].bytes, (2*n+1)*sizeof(key));
+            keccak_update(&round_prefix, C_offset.bytes, sizeof(key));
+            keccak_update(&round_prefix, message.bytes, sizeof(key));
+            KECCAK_CTX round;
             key c_p; // = c[i]*mu_P
             key c_c; // = c[i]*mu_C
             key c_new;
@@ -672,13 +674,15 @@ namespace rct {
                 addKeys_aGbBcC(L,sig.s[i],c_p,P_precomp.k,c_c,C_precomp.k);
 
                 // Compute R
-                hash_to_p3(hash8_p3,pubs[i].dest);
+                crypto::hash_to_point_cached(rct2pk(pubs[i].dest), hash8_p3);
                 ge_dsm_precomp(hash_precomp.k, &hash8_p3);
                 addKeys_aAbBcC(R,sig.s[i],hash_precomp.k,c_p,I_precomp.k,c_c,D_precomp.k);
 
-                c_to_hash[2*n+3] = L;
-                c_to_hash[2*n+4] = R;
-                c_new = hash_to_scalar(c_to_hash);
+                round = round_prefix;
+                keccak_update(&round, L.bytes, sizeof(key));
+                keccak_update(&round, R.bytes, sizeof(key));
+                keccak_finish(&round, c_new.bytes);
+                sc_reduce32(c_new.bytes);
                 CHECK_AND_ASSERT_MES(!(c_new == rct::zero()), false, "Bad signature hash");
                 copy(c,c_new);
 
@@ -1131,6 +1135,101 @@ namespace rct {
       }
     }
 
+    //ver RingCT simple, batched
+    //verifies the ring signatures of many simple rctSigs as a single work queue so that txes with only one or
+    //two inputs still keep every thread busy.  Returns true only if every rctSig verified; if `valid` is given
+    //it is set to the per-rctSig result.
+    bool verRctNonSemanticsSimple(const std::vector<const rctSig*> & rvv, std::vector<bool> *valid) {
+      PERF_TIMER(verRctNonSemanticsSimpleBatch);
+
+      // per-rctSig message and starting offset into the flattened per-input results
+      std::vector<key> messages(rvv.size());
+      std::vector<size_t> offsets(rvv.size() + 1, 0);
+      std::deque<bool> prepared(rvv.size(), false);
+      for (size_t t = 0; t < rvv.size(); ++t)
+        offsets[t + 1] = offsets[t] + (rvv[t] ? rvv[t]->mixRing.size() : 0);
+
+      tools::threadpool& tpool = tools::threadpool::getInstance();
+      {
+        tools::threadpool::waiter waiter;
+        for (size_t t = 0; t < rvv.size(); ++t)
+        {
+          tpool.submit(&waiter, [&, t] {
+            try
+            {
+              const rctSig *rvp = rvv[t];
+              if (!rvp || !rct::is_rct_simple(rvp->type))
+                return;
+              const rctSig &rv = *rvp;
+              const keyV &pseudoOuts = is_rct_bulletproof(rv.type) ? rv.p.pseudoOuts : rv.pseudoOuts;
+              const size_t n_sigs = rv.type == RCTType::CLSAG ? rv.p.CLSAGs.size() : rv.p.MGs.size();
+              if (pseudoOuts.size() != rv.mixRing.size() || n_sigs != rv.mixRing.size())
+                return;
+              messages[t] = get_pre_clsag_hash(rv, hw::get_device("default"));
+              prepared[t] = true;
+            }
+            catch (const std::exception &e)
+            {
+              LOG_PRINT_L1("Error in verRctNonSemanticsSimple: " << e.what());
+            }
+            catch (...)
+            {
+              LOG_PRINT_L1("Error in verRctNonSemanticsSimple, but not an actual exception");
+            }
+          }, true);
+        }
+        waiter.wait(&tpool);
+      }
+
+      std::deque<bool> results(offsets.back(), false);
+      {
+        tools::threadpool::waiter waiter;
+        for (size_t t = 0; t < rvv.size(); ++t)
+        {
+          if (!prepared[t])
+            continue;
+          for (size_t i = 0; i < rvv[t]->mixRing.size(); ++i)
+          {
+            tpool.submit(&waiter, [&, t, i] {
+              // we can get deep throws from ge_frombytes_vartime if input isn't valid
+              try
+              {
+                const rctSig &rv = *rvv[t];
+                const keyV &pseudoOuts = is_rct_bulletproof(rv.type) ? rv.p.pseudoOuts : rv.pseudoOuts;
+                if (rv.type == RCTType::CLSAG)
+                  results[offsets[t] + i] = verRctCLSAGSimple(messages[t], rv.p.CLSAGs[i], rv.mixRing[i], pseudoOuts[i]);
+                else
+                  results[offsets[t] + i] = verRctMGSimple(messages[t], rv.p.MGs[i], rv.mixRing[i], pseudoOuts[i]);
+              }
+              catch (...)
+              {
+                results[offsets[t] + i] = false;
+              }
+            }, true);
+          }
+        }
+        waiter.wait(&tpool);
+      }
+
+      bool all_valid = true;
+      if (valid)
+        valid->assign(rvv.size(), false);
+      for (size_t t = 0; t < rvv.size(); ++t)
+      {
+        bool ok = prepared[t];
+        for (size_t i = offsets[t]; ok && i < offsets[t + 1]; ++i)
+          ok = results[i];
+        if (!ok)
+        {
+          LOG_PRINT_L1("verRctMGSimple/verRctCLSAGSimple failed for rctSig " << t << " of batch");
+          all_valid = false;
+        }
+        if (valid)
+          (*valid)[t] = ok;
+      }
+      return all_valid;
+    }
+
     //RingCT protocol
     //genRct: 
     //   creates an rctSig with all data necessary to verify the rangeProofs and that the signer owns one of the
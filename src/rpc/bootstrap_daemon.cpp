@@ -13,6 +13,35 @@
 namespace cryptonote
 {
 
+  namespace bootstrap_detail
+  {
+    bool immutable(const rpc::GET_TRANSACTIONS::response& res)
+    {
+      if (!res.missed_tx.empty())
+        return false;
+      for (auto& tx : res.txs)
+        if (tx.in_pool)
+          return false;
+      return true;
+    }
+
+    bool immutable(const rpc::GET_OUTPUTS_BIN::response& res)
+    {
+      for (auto& out : res.outs)
+        if (!out.unlocked)
+          return false;
+      return true;
+    }
+
+    bool immutable(const rpc::GET_OUTPUTS::response& res)
+    {
+      for (auto& out : res.outs)
+        if (!out.unlocked)
+          return false;
+      return true;
+    }
+  }
+
   bootstrap_daemon::bootstrap_daemon(std::function<std::optional<std::string>()> get_next_public_node)
     : m_get_next_public_node(get_next_public_node)
   {
@@ -53,13 +82,15 @@ namespace cryptonote
   {
     if (!tools::starts_with(url, "http://") && !tools::starts_with(url, "https://"))
       url.insert(0, "http://");
+    MINFO("Changed bootstrap daemon address to " << url);
     m_http_client.set_base_url(std::move(url));
     if (credentials)
       m_http_client.set_auth(credentials->first, credentials->second);
     else
       m_http_client.set_auth();
 
-    MINFO("Changed bootstrap daemon address to " << url);
+    // What we have cached came from the old server
+    cache_clear();
     return true;
   }
 
@@ -69,6 +100,11 @@ namespace cryptonote
     if (!m_failed || !m_get_next_public_node)
       return true;
 
+    // Several requests may have failed at once; only the first one here picks another server
+    std::lock_guard lock{m_server_mutex};
+    if (!m_failed)
+      return true;
+
     const std::optional<std::string> address = m_get_next_public_node();
     if (address) {
       m_failed = false;
@@ -78,4 +114,86 @@ namespace cryptonote
     return false;
   }
 
+  bootstrap_daemon::pooled_client bootstrap_daemon::get_client()
+  {
+    std::unique_ptr<rpc::http_client> client;
+    {
+      std::unique_lock lock{m_pool_mutex};
+      m_pool_cv.wait(lock, [this] { return !m_idle_clients.empty() || m_clients < MAX_CONNECTIONS; });
+      if (!m_idle_clients.empty())
+      {
+        client = std::move(m_idle_clients.back());
+        m_idle_clients.pop_back();
+      }
+      else
+        m_clients++;
+    }
+    if (!client)
+      client = std::make_unique<rpc::http_client>();
+    // The server may have changed since this connection was last used
+    client->copy_params_from(m_http_client);
+    return pooled_client{*this, std::move(client)};
+  }
+
+  void bootstrap_daemon::return_client(std::unique_ptr<rpc::http_client> client)
+  {
+    {
+      std::lock_guard lock{m_pool_mutex};
+      m_idle_clients.push_back(std::move(client));
+    }
+    m_pool_cv.notify_one();
+  }
+
+  std::optional<std::string> bootstrap_daemon::cache_get(const std::string& key)
+  {
+    std::lock_guard lock{m_cache_mutex};
+    auto it = m_cache.find(key);
+    if (it == m_cache.end())
+      return std::nullopt;
+    if (it->second.expiry < std::chrono::steady_clock::now())
+    {
+      m_cache_size -= it->first.size() + it->second.value.size();
+      m_cache_lru.erase(it->second.lru_it);
+      m_cache.erase(it);
+      return std::nullopt;
+    }
+    m_cache_lru.splice(m_cache_lru.begin(), m_cache_lru, it->second.lru_it);
+    return it->second.value;
+  }
+
+  void bootstrap_daemon::cache_put(std::string key, std::string value)
+  {
+    const size_t size = key.size() + value.size();
+    if (size > CACHE_MAX_SIZE / 4)
+      return;
+
+    std::lock_guard lock{m_cache_mutex};
+    if (auto it = m_cache.find(key); it != m_cache.end())
+    {
+      m_cache_size -= it->first.size() + it->second.value.size();
+      m_cache_lru.erase(it->second.lru_it);
+      m_cache.erase(it);
+    }
+    // Expired entries are left where they are until they cost us space: when we need room, evict
+    // from the least recently used end.
+    while (m_cache_size + size > CACHE_MAX_SIZE && !m_cache_lru.empty())
+    {
+      auto it = m_cache.find(m_cache_lru.back());
+      m_cache_size -= it->first.size() + it->second.value.size();
+      m_cache.erase(it);
+      m_cache_lru.pop_back();
+    }
+    m_cache_lru.push_front(key);
+    m_cache_size += size;
+    m_cache.emplace(std::move(key), cache_entry{std::move(value), std::chrono::steady_clock::now() + CACHE_LIFETIME, m_cache_lru.begin()});
+  }
+
+  void bootstrap_daemon::cache_clear()
+  {
+    std::lock_guard lock{m_cache_mutex};
+    m_cache.clear();
+    m_cache_lru.clear();
+    m_cache_size = 0;
+  }
+
 }
@@ -1,6 +1,13 @@
 #pragma  once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <vector>
 
 #include "rpc/http_client.h"
@@ -9,9 +16,42 @@
 namespace cryptonote
 {
 
+  namespace bootstrap_detail
+  {
+    // Requests whose responses don't change once the remote has them (blocks by height, txs,
+    // outputs by index: none of them change short of a reorg), and so are cached for a little while
+    // after they are first fetched: a wallet refreshing against a syncing node tends to ask for the
+    // same ones repeatedly.
+    template <typename RPC> constexpr bool cacheable = false;
+    template <> inline constexpr bool cacheable<rpc::GET_BLOCKS_BY_HEIGHT> = true;
+    template <> inline constexpr bool cacheable<rpc::GET_BLOCK_HEADER_BY_HASH> = true;
+    template <> inline constexpr bool cacheable<rpc::GET_TRANSACTIONS> = true;
+    template <> inline constexpr bool cacheable<rpc::GET_TX_GLOBAL_OUTPUTS_INDEXES> = true;
+    template <> inline constexpr bool cacheable<rpc::GET_OUTPUTS_BIN> = true;
+    template <> inline constexpr bool cacheable<rpc::GET_OUTPUTS> = true;
+
+    // Some responses of the above can still change: a tx that is in the pool (or not found at all)
+    // may be mined any time, and a locked output will unlock.
+    template <typename Response>
+    bool immutable(const Response&) { return true; }
+    bool immutable(const rpc::GET_TRANSACTIONS::response& res);
+    bool immutable(const rpc::GET_OUTPUTS_BIN::response& res);
+    bool immutable(const rpc::GET_OUTPUTS::response& res);
+  }
+
+  /// Forwards requests to a remote node while we are syncing.  This is thread-safe, and requests
+  /// from different threads run at the same time, each over its own connection (up to
+  /// MAX_CONNECTIONS of them, kept open between requests).
   class bootstrap_daemon
   {
   public:
+    /// The most requests that are sent to the bootstrap daemon at once; further requests wait for
+    /// one of these to finish.
+    static constexpr size_t MAX_CONNECTIONS = 4;
+    /// How long, and how much of, the responses of `bootstrap_detail::cacheable` requests are kept
+    static constexpr auto CACHE_LIFETIME = std::chrono::seconds{30};
+    static constexpr size_t CACHE_MAX_SIZE = 16 * 1024 * 1024;
+
     bootstrap_daemon(std::function<std::optional<std::string>()> get_next_public_node);
     bootstrap_daemon(const std::string &address, const std::optional<std::pair<std::string_view, std::string_view>> &credentials);
 
@@ -27,21 +67,36 @@ namespace cryptonote
       if (!switch_server_if_needed())
         return false;
 
+      std::string cache_key;
+      if constexpr (bootstrap_detail::cacheable<RPC>)
+      {
+        cache_key = RPC::names().front();
+        cache_key += '\0';
+        cache_key += epee::serialization::store_t_to_binary(req);
+        if (auto cached = cache_get(cache_key); cached && epee::serialization::load_t_from_binary(res, *cached))
+          return true;
+      }
+
       try {
+        auto client = get_client();
         if constexpr (std::is_base_of_v<rpc::LEGACY, RPC>)
           // TODO: post-8.x hard fork we can remove this one and let everything go through the
           // non-binary json_rpc version instead (because all legacy json commands are callable via
           // json_rpc as of daemon 8.x).
-          res = m_http_client.json<RPC>(RPC::names().front(), req);
+          res = client->json<RPC>(RPC::names().front(), req);
         else if constexpr (std::is_base_of_v<rpc::BINARY, RPC>)
-          res = m_http_client.binary<RPC>(RPC::names().front(), req);
+          res = client->binary<RPC>(RPC::names().front(), req);
         else
-          res = m_http_client.json_rpc<RPC>(RPC::names().front(), req);
+          res = client->json_rpc<RPC>(RPC::names().front(), req);
       } catch (const std::exception& e) {
         MWARNING("bootstrap daemon request failed: " << e.what());
         set_failed();
         return false;
       }
+
+      if constexpr (bootstrap_detail::cacheable<RPC>)
+        if (res.status == rpc::STATUS_OK && bootstrap_detail::immutable(res))
+          cache_put(std::move(cache_key), epee::serialization::store_t_to_binary(res));
       return true;
     }
 
@@ -49,10 +104,50 @@ namespace cryptonote
     bool set_server(std::string address, const std::optional<std::pair<std::string_view, std::string_view>> &credentials = std::nullopt);
     bool switch_server_if_needed();
 
+    // A connection checked out of the pool, which goes back to it when destroyed
+    class pooled_client
+    {
+    public:
+      pooled_client(bootstrap_daemon& daemon, std::unique_ptr<rpc::http_client> client)
+        : m_daemon{daemon}, m_client{std::move(client)} {}
+      pooled_client(const pooled_client&) = delete;
+      ~pooled_client() { m_daemon.return_client(std::move(m_client)); }
+      rpc::http_client* operator->() { return m_client.get(); }
+    private:
+      bootstrap_daemon& m_daemon;
+      std::unique_ptr<rpc::http_client> m_client;
+    };
+    // Waits for a connection if MAX_CONNECTIONS are in use.  The connection gets the current
+    // server and settings of `m_http_client`.
+    pooled_client get_client();
+    void return_client(std::unique_ptr<rpc::http_client> client);
+
+    std::optional<std::string> cache_get(const std::string& key);
+    void cache_put(std::string key, std::string value);
+    void cache_clear();
+
   private:
+    // Holds the settings (server, login) of the pooled connections, which copy them from here.
     rpc::http_client m_http_client;
     std::function<std::optional<std::string>()> m_get_next_public_node;
-    bool m_failed = false;
+    std::atomic<bool> m_failed = false;
+    std::mutex m_server_mutex;
+
+    std::mutex m_pool_mutex;
+    std::condition_variable m_pool_cv;
+    std::vector<std::unique_ptr<rpc::http_client>> m_idle_clients;
+    size_t m_clients = 0; // idle or in use
+
+    struct cache_entry
+    {
+      std::string value;
+      std::chrono::steady_clock::time_point expiry;
+      std::list<std::string>::iterator lru_it;
+    };
+    std::mutex m_cache_mutex;
+    std::unordered_map<std::string, cache_entry> m_cache;
+    std::list<std::string> m_cache_lru; // most recently used first
+    size_t m_cache_size = 0;
   };
 
 }
@@ -34,8 +34,10 @@
 #include <boost/preprocessor/stringize.hpp>
 #include <boost/endian/conversion.hpp>
 #include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <iterator>
+#include <map>
 #include <type_traits>
 #include <variant>
 #include <oxenmq/base64.h>
@@ -50,11 +52,14 @@
 #include "common/command_line.h"
 #include "common/oxen.h"
 #include "common/sha256sum.h"
+#include "common/threadpool.h"
 #include "common/perf_timer.h"
 #include "common/random.h"
 #include "common/hex.h"
+#include "common/rules.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_basic/account.h"
+#include "cryptonote_basic/block_digest.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 #include "cryptonote_core/tx_sanity_check.h"
 #include "cryptonote_core/uptime_proof.h"
@@ -150,6 +155,22 @@ namespace cryptonote { namespace rpc {
       }
     };
 
+    // The name, the caller's admin status (which some commands answer differently) and the request
+    // body.  JSON-RPC params that went through the generic parser are re-serialized from what epee
+    // parsed; those the HTTP server read directly are keyed on their text as sent.
+    std::string response_cache_key(std::string_view name, const rpc_request& request) {
+      std::string key{name};
+      key += request.context.admin ? "\0a\0"sv : "\0p\0"sv;
+      if (auto body = request.body_view())
+        key += *body;
+      else {
+        std::ostringstream o;
+        epee::serialization::dump_as_json(o, var::get<jsonrpc_params>(request.body).second, 0 /*indent*/, false /*newlines*/);
+        key += o.str();
+      }
+      return key;
+    }
+
     template <typename RPC, std::enable_if_t<std::is_base_of_v<RPC_COMMAND, RPC>, int> = 0>
     void register_rpc_command(std::unordered_map<std::string, std::shared_ptr<const rpc_command>>& regs)
     {
@@ -164,11 +185,22 @@ namespace cryptonote { namespace rpc {
       cmd->is_public = std::is_base_of_v<PUBLIC, RPC>;
       cmd->is_binary = std::is_base_of_v<BINARY, RPC>;
       cmd->is_legacy = std::is_base_of_v<LEGACY, RPC>;
-      cmd->invoke = [](rpc_request&& request, core_rpc_server& server) {
-        reg_helper<RPC> helper;
-        Response res = server.invoke(helper.load(request), std::move(request.context));
-        return helper.serialize(std::move(res));
-      };
+      cmd->is_cacheable = std::is_base_of_v<CACHEABLE, RPC>;
+      if constexpr (std::is_base_of_v<CACHEABLE, RPC>) {
+        cmd->invoke = [](rpc_request&& request, core_rpc_server& server) {
+          return server.cached_response(response_cache_key(RPC::names()[0], request), [&] {
+            reg_helper<RPC> helper;
+            Response res = server.invoke(helper.load(request), std::move(request.context));
+            return helper.serialize(std::move(res));
+          });
+        };
+      } else {
+        cmd->invoke = [](rpc_request&& request, core_rpc_server& server) {
+          reg_helper<RPC> helper;
+          Response res = server.invoke(helper.load(request), std::move(request.context));
+          return helper.serialize(std::move(res));
+        };
+      }
 
       for (const auto& name : RPC::names())
         regs.emplace(name, cmd);
@@ -225,7 +257,14 @@ namespace cryptonote { namespace rpc {
     , m_p2p(p2p)
     , m_should_use_bootstrap_daemon(false)
     , m_was_bootstrap_ever_used(false)
-  {}
+  {
+    m_response_cache_budget = tools::cache_budget::add("rpc_response", tools::cache_budget::priority::rpc_response, [this](size_t) {
+      std::unique_lock lock{m_response_cache_mutex};
+      m_response_cache.clear();
+      m_response_cache_bytes = 0;
+      m_response_cache_budget.set_size(0);
+    });
+  }
   bool core_rpc_server::set_bootstrap_daemon(const std::string &address, std::string_view username_password)
   {
     std::string_view username, password;
@@ -311,7 +350,92 @@ namespace cryptonote { namespace rpc {
   {
     return m_p2p.get_payload_object().is_synchronized();
   }
+  //------------------------------------------------------------------------------------------------------------------------------
+  template <typename F>
+  void core_rpc_server::parallel_read(const rpc_context& context, size_t n, size_t min_chunk, F&& f)
+  {
+    size_t chunks = std::min(n / std::max<size_t>(min_chunk, 1), MAX_PARALLEL_READS_PER_CLIENT);
+    size_t extra = 0;
+    if (chunks > 1)
+    {
+      std::lock_guard lock{m_parallel_reads_mutex};
+      auto& in_use = m_parallel_reads[context.remote];
+      extra = std::min(chunks - 1, MAX_PARALLEL_READS_PER_CLIENT - 1 - std::min(in_use, MAX_PARALLEL_READS_PER_CLIENT - 1));
+      in_use += extra;
+      if (!in_use)
+        m_parallel_reads.erase(context.remote);
+    }
+    if (extra == 0)
+    {
+      f(size_t{0}, n);
+      return;
+    }
+    OXEN_DEFER {
+      std::lock_guard lock{m_parallel_reads_mutex};
+      if (auto it = m_parallel_reads.find(context.remote); it != m_parallel_reads.end() && (it->second -= extra) == 0)
+        m_parallel_reads.erase(it);
+    };
+
+    chunks = extra + 1;
+    auto& db = m_core.get_blockchain_storage().get_db();
+    std::mutex error_mutex;
+    std::exception_ptr error;
+    auto run_chunk = [&](size_t c) {
+      try {
+        db_rtxn_guard rtxn_guard{db};
+        f(n * c / chunks, n * (c + 1) / chunks);
+      } catch (...) {
+        std::lock_guard lock{error_mutex};
+        if (!error)
+          error = std::current_exception();
+      }
+    };
+
+    auto& tpool = tools::threadpool::getInstance(tools::threadpool::domain::background);
+    tools::threadpool::waiter waiter;
+    for (size_t c = 1; c < chunks; c++)
+      tpool.submit(&waiter, [&run_chunk, c] { run_chunk(c); }, true);
+    run_chunk(0);
+    waiter.wait(&tpool);
+
+    if (error)
+      std::rethrow_exception(error);
+  }
 
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::string core_rpc_server::cached_response(std::string key, const std::function<std::string()>& make)
+  {
+    // Taken before making the response, so that one made across a change gets replaced by the
+    // next request rather than served as current
+    const crypto::hash tip = m_core.get_blockchain_storage().get_chain_tip_snapshot()->top_hash;
+    const uint64_t pool_cookie = m_core.get_pool().cookie();
+    const auto now = std::chrono::steady_clock::now();
+    {
+      std::shared_lock lock{m_response_cache_mutex};
+      if (auto it = m_response_cache.find(key); it != m_response_cache.end()
+          && it->second.tip == tip && it->second.pool_cookie == pool_cookie && now - it->second.created < RESPONSE_CACHE_MAX_AGE)
+        return it->second.body;
+    }
+
+    std::string body = make();
+
+    // The entry's node, key and body
+    auto entry_bytes = [](const std::string& key, const std::string& body) {
+      return tools::cache_budget::node_bytes<decltype(m_response_cache)> + key.size() + body.size();
+    };
+    std::unique_lock lock{m_response_cache_mutex};
+    if (auto it = m_response_cache.find(key); it != m_response_cache.end())
+      m_response_cache_bytes -= entry_bytes(it->first, it->second.body);
+    else if (m_response_cache.size() >= RESPONSE_CACHE_MAX_ENTRIES)
+    {
+      m_response_cache.clear();
+      m_response_cache_bytes = 0;
+    }
+    m_response_cache_bytes += entry_bytes(key, body);
+    m_response_cache.insert_or_assign(std::move(key), cached_response_entry{tip, pool_cookie, now, body});
+    m_response_cache_budget.set_size(m_response_cache_bytes);
+    return body;
+  }
 
 #define CHECK_CORE_READY() do { if(!check_core_ready()){ res.status =  STATUS_BUSY; return res; } } while(0)
 
@@ -324,10 +448,9 @@ namespace cryptonote { namespace rpc {
     if (use_bootstrap_daemon_if_necessary<GET_HEIGHT>(req, res))
       return res;
 
-    crypto::hash hash;
-    m_core.get_blockchain_top(res.height, hash);
-    ++res.height; // block height to chain height
-    res.hash = tools::type_to_hex(hash);
+    auto tip = m_core.get_blockchain_storage().get_chain_tip_snapshot();
+    res.height = tip->height;
+    res.hash = tools::type_to_hex(tip->top_hash);
     res.status = STATUS_OK;
 
     res.immutable_height = 0;
@@ -364,11 +487,12 @@ namespace cryptonote { namespace rpc {
       return res;
     }
 
-    crypto::hash top_hash;
-    m_core.get_blockchain_top(res.height, top_hash);
-    auto prev_ts = m_core.get_blockchain_storage().get_db().get_block_timestamp(res.height);
-    ++res.height; // turn top block height into blockchain height
-    res.top_block_hash = tools::type_to_hex(top_hash);
+    // Everything about the tip comes from one snapshot so that this doesn't need (or wait for) the
+    // blockchain lock, and so that the values are consistent with each other.
+    auto tip = m_core.get_blockchain_storage().get_chain_tip_snapshot();
+    auto prev_ts = tip->top_timestamp;
+    res.height = tip->height;
+    res.top_block_hash = tools::type_to_hex(tip->top_hash);
     res.target_height = m_core.get_target_blockchain_height();
 
     bool next_block_is_pulse = false;
@@ -386,9 +510,9 @@ namespace cryptonote { namespace rpc {
       res.immutable_block_hash = tools::type_to_hex(checkpoint.block_hash);
     }
 
-    res.difficulty = m_core.get_blockchain_storage().get_difficulty_for_next_block(next_block_is_pulse);
+    res.difficulty = next_block_is_pulse ? m_core.get_blockchain_storage().get_difficulty_for_next_block(true /*pulse*/) : tip->next_difficulty;
     res.target = tools::to_seconds(TARGET_BLOCK_TIME);
-    res.tx_count = m_core.get_blockchain_storage().get_total_transactions() - res.height; //without coinbase
+    res.tx_count = tip->tx_count - res.height; //without coinbase
     res.tx_pool_size = m_core.get_pool().get_transactions_count();
     if (context.admin)
     {
@@ -406,18 +530,9 @@ namespace cryptonote { namespace rpc {
     res.devnet = nettype == DEVNET;
     res.nettype = nettype == MAINNET ? "mainnet" : nettype == TESTNET ? "testnet" : nettype == DEVNET ? "devnet" : "fakechain";
 
-    try
-    {
-      res.cumulative_difficulty = m_core.get_blockchain_storage().get_db().get_block_cumulative_difficulty(res.height - 1);
-    }
-    catch(std::exception const &e)
-    {
-      res.status = "Error retrieving cumulative difficulty at height " + std::to_string(res.height - 1);
-      return res;
-    }
-
-    res.block_size_limit = res.block_weight_limit = m_core.get_blockchain_storage().get_current_cumulative_block_weight_limit();
-    res.block_size_median = res.block_weight_median = m_core.get_blockchain_storage().get_current_cumulative_block_weight_median();
+    res.cumulative_difficulty = tip->cumulative_difficulty;
+    res.block_size_limit = res.block_weight_limit = tip->block_weight_limit;
+    res.block_size_median = res.block_weight_median = tip->block_weight_median;
 
     auto ons_counts = m_core.get_blockchain_storage().name_system_db().get_mapping_counts(res.height);
     res.ons_counts = {
@@ -505,8 +620,8 @@ namespace cryptonote { namespace rpc {
     for(auto& bd: bs)
     {
       res.blocks.resize(res.blocks.size()+1);
-      res.blocks.back().block = bd.first.first;
       size += bd.first.first.size();
+      res.blocks.back().block = std::move(bd.first.first);
       res.output_indices.push_back(GET_BLOCKS_FAST::block_output_indices());
       ntxes += bd.second.size();
       res.output_indices.back().indices.reserve(1 + bd.second.size());
@@ -520,26 +635,111 @@ namespace cryptonote { namespace rpc {
         i->second.shrink_to_fit();
         size += res.blocks.back().txs.back().size();
       }
+    }
 
-      const size_t n_txes_to_lookup = bd.second.size() + (req.no_miner_tx ? 0 : 1);
-      if (n_txes_to_lookup > 0)
+    // The output indices are one lookup and scan per chunk of blocks, spread over several read
+    // txns.  The chunk's txs have consecutive IDs, so we find them from the first block's miner tx
+    // or, without miner tx hashes, from the first other tx (the blocks before it having only their
+    // miner txs).
+    std::atomic<bool> failed{false};
+    parallel_read(context, bs.size(), 50, [&](size_t begin, size_t end) {
+      std::vector<size_t> block_txes;
+      block_txes.reserve(end - begin);
+      const crypto::hash* first = nullptr;
+      size_t first_offset = 0;
+      for (size_t b = begin; b < end; b++)
       {
-        std::vector<std::vector<uint64_t>> indices;
-        bool r = m_core.get_tx_outputs_gindexs(req.no_miner_tx ? bd.second.front().first : bd.first.second, n_txes_to_lookup, indices);
-        if (!r || indices.size() != n_txes_to_lookup || res.output_indices.back().indices.size() != (req.no_miner_tx ? 1 : 0))
+        block_txes.push_back(bs[b].second.size());
+        if (first)
+          continue;
+        if (!req.no_miner_tx)
+          first = &bs[b].first.second;
+        else if (!bs[b].second.empty())
         {
-          res.status = "Failed";
-          return res;
+          first = &bs[b].second.front().first;
+          first_offset = b - begin + 1;
         }
-        for (size_t i = 0; i < indices.size(); ++i)
-          res.output_indices.back().indices.push_back({std::move(indices[i])});
       }
+      if (!first)
+        return;
+      std::vector<std::vector<std::vector<uint64_t>>> indices;
+      if (!m_core.get_blocks_tx_outputs_gindexs(*first, first_offset, block_txes, !req.no_miner_tx, indices) || indices.size() != block_txes.size())
+      {
+        failed = true;
+        return;
+      }
+      for (size_t b = begin; b < end; b++)
+        for (auto& tx_indices : indices[b - begin])
+          res.output_indices[b].indices.push_back({std::move(tx_indices)});
+    });
+    if (failed)
+    {
+      res.status = "Failed";
+      return res;
     }
 
     MDEBUG("on_get_blocks: " << bs.size() << " blocks, " << ntxes << " txes, size " << size);
     res.status = STATUS_OK;
     return res;
   }
+  //------------------------------------------------------------------------------------------------------------------------------
+  GET_BLOCK_DIGESTS::response core_rpc_server::invoke(GET_BLOCK_DIGESTS::request&& req, rpc_context context)
+  {
+    GET_BLOCK_DIGESTS::response res{};
+
+    PERF_TIMER(on_get_block_digests);
+    if (use_bootstrap_daemon_if_necessary<GET_BLOCK_DIGESTS>(req, res))
+      return res;
+
+    std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > > bs;
+    const size_t max_count = req.max_count ? std::min<uint64_t>(req.max_count, GET_BLOCK_DIGESTS::MAX_COUNT) : GET_BLOCK_DIGESTS::MAX_COUNT;
+    if (!m_core.find_blockchain_supplement(req.start_height, req.block_ids, bs, res.current_height, res.start_height, true /*pruned*/, true /*miner tx hash*/, max_count))
+    {
+      res.status = "Failed";
+      return res;
+    }
+
+    // Parsing the txs is the bulk of the work; the miner tx output indices are one lookup per block
+    res.blocks.resize(bs.size());
+    res.digests.resize(bs.size());
+    std::atomic<bool> failed{false};
+    parallel_read(context, bs.size(), 50, [&](size_t begin, size_t end) {
+      for (size_t b = begin; b < end && !failed; b++)
+      {
+        auto& bd = bs[b];
+        block_digest::digest digest;
+        std::vector<std::vector<uint64_t>> indices;
+        if (!m_core.get_tx_outputs_gindexs(bd.first.second, 1, indices) || indices.size() != 1)
+        {
+          failed = true;
+          return;
+        }
+        digest.miner_tx_output_indices = std::move(indices[0]);
+
+        digest.txs.reserve(bd.second.size());
+        for (auto& [tx_hash, tx_blob] : bd.second)
+        {
+          transaction tx;
+          if (!parse_and_validate_tx_base_from_blob(tx_blob, tx))
+          {
+            failed = true;
+            return;
+          }
+          digest.txs.push_back(block_digest::make_tx_digest(tx));
+        }
+        res.blocks[b] = std::move(bd.first.first);
+        res.digests[b] = block_digest::pack(digest);
+      }
+    });
+    if (failed)
+    {
+      res.status = "Failed";
+      return res;
+    }
+
+    res.status = STATUS_OK;
+    return res;
+  }
   GET_ALT_BLOCKS_HASHES::response core_rpc_server::invoke(GET_ALT_BLOCKS_HASHES::request&& req, rpc_context context)
   {
     GET_ALT_BLOCKS_HASHES::response res{};
@@ -631,11 +831,32 @@ namespace cryptonote { namespace rpc {
       return res;
 
     if (!context.admin && req.outputs.size() > GET_OUTPUTS_BIN::MAX_COUNT)
+    {
       res.status = "Too many outs requested";
-    else if (m_core.get_outs(req, res))
-      res.status = STATUS_OK;
-    else
+      return res;
+    }
+
+    // Big requests (rings for many inputs) get split over several read txns
+    std::atomic<bool> failed{false};
+    res.outs.resize(req.outputs.size());
+    parallel_read(context, req.outputs.size(), 200, [&](size_t begin, size_t end) {
+      GET_OUTPUTS_BIN::request part_req{};
+      part_req.outputs.assign(req.outputs.begin() + begin, req.outputs.begin() + end);
+      part_req.get_txid = req.get_txid;
+      GET_OUTPUTS_BIN::response part_res{};
+      if (!m_core.get_outs(part_req, part_res) || part_res.outs.size() != end - begin)
+        failed = true;
+      else
+        std::move(part_res.outs.begin(), part_res.outs.end(), res.outs.begin() + begin);
+    });
+
+    if (failed)
+    {
+      res.outs.clear();
       res.status = "Failed";
+    }
+    else
+      res.status = STATUS_OK;
 
     return res;
   }
@@ -856,11 +1077,32 @@ namespace cryptonote { namespace rpc {
     }
     std::vector<crypto::hash> missed_txs;
     std::vector<std::tuple<crypto::hash, cryptonote::blobdata, crypto::hash, cryptonote::blobdata>> txs;
-    bool r = m_core.get_split_transactions_blobs(vh, txs, missed_txs);
-    if(!r)
     {
-      res.status = "Failed";
-      return res;
+      // Looked up in chunks over several read txns, then reassembled in request order
+      struct chunk_result {
+        std::vector<std::tuple<crypto::hash, cryptonote::blobdata, crypto::hash, cryptonote::blobdata>> txs;
+        std::vector<crypto::hash> missed;
+      };
+      std::map<size_t, chunk_result> chunks;
+      std::mutex chunks_mutex;
+      std::atomic<bool> failed{false};
+      parallel_read(context, vh.size(), 100, [&](size_t begin, size_t end) {
+        chunk_result result;
+        if (!m_core.get_split_transactions_blobs({vh.begin() + begin, vh.begin() + end}, result.txs, result.missed))
+          failed = true;
+        std::lock_guard lock{chunks_mutex};
+        chunks.emplace(begin, std::move(result));
+      });
+      if (failed)
+      {
+        res.status = "Failed";
+        return res;
+      }
+      for (auto& [begin, chunk] : chunks)
+      {
+        std::move(chunk.txs.begin(), chunk.txs.end(), std::back_inserter(txs));
+        missed_txs.insert(missed_txs.end(), chunk.missed.begin(), chunk.missed.end());
+      }
     }
     LOG_PRINT_L2("Found " << txs.size() << "/" << vh.size() << " transactions on the blockchain");
 
@@ -1038,16 +1280,19 @@ namespace cryptonote { namespace rpc {
         e.blink = pool.has_blink(tx_hash);
       }
 
-      // output indices too if not in pool
-      if (!e.in_pool)
-      {
-        bool r = m_core.get_tx_outputs_gindexs(tx_hash, e.output_indices);
-        if (!r)
-        {
-          res.status = "Failed";
-          return res;
-        }
-      }
+    }
+
+    // output indices too for those not in the pool
+    std::atomic<bool> indices_failed{false};
+    parallel_read(context, res.txs.size(), 100, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end && !indices_failed; i++)
+        if (!res.txs[i].in_pool && !m_core.get_tx_outputs_gindexs(std::get<0>(txs[i]), res.txs[i].output_indices))
+          indices_failed = true;
+    });
+    if (indices_failed)
+    {
+      res.status = "Failed";
+      return res;
     }
 
     LOG_PRINT_L2(res.txs.size() << " transactions found, " << res.missed_tx.size() << " not found");
@@ -1090,36 +1335,51 @@ namespace cryptonote { namespace rpc {
       res.spent_status.push_back(spent_status[n] ? IS_KEY_IMAGE_SPENT::SPENT_IN_BLOCKCHAIN : IS_KEY_IMAGE_SPENT::UNSPENT);
 
     // check the pool too
-    std::vector<tx_info> txs;
-    std::vector<spent_key_image_info> ki;
-    r = m_core.get_pool().get_transactions_and_spent_keys_info(txs, ki, nullptr, context.admin);
+    r = m_core.are_key_images_spent_in_pool(key_images, spent_status, context.admin);
     if(!r)
     {
       res.status = "Failed";
       return res;
     }
-    for (std::vector<spent_key_image_info>::const_iterator i = ki.begin(); i != ki.end(); ++i)
+    for (size_t n = 0; n < spent_status.size(); ++n)
+      if (spent_status[n] && res.spent_status[n] == IS_KEY_IMAGE_SPENT::UNSPENT)
+        res.spent_status[n] = IS_KEY_IMAGE_SPENT::SPENT_IN_POOL;
+
+    res.status = STATUS_OK;
+    return res;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  static std::string pack_bitmap(const std::vector<bool>& bits)
+  {
+    std::string bitmap((bits.size() + 7) / 8, '\0');
+    for (size_t i = 0; i < bits.size(); ++i)
+      if (bits[i])
+        bitmap[i / 8] |= 1 << (i % 8);
+    return bitmap;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  IS_KEY_IMAGE_SPENT_BIN::response core_rpc_server::invoke(IS_KEY_IMAGE_SPENT_BIN::request&& req, rpc_context context)
+  {
+    IS_KEY_IMAGE_SPENT_BIN::response res{};
+
+    PERF_TIMER(on_is_key_image_spent_bin);
+    if (use_bootstrap_daemon_if_necessary<IS_KEY_IMAGE_SPENT_BIN>(req, res))
+      return res;
+
+    std::vector<bool> spent;
+    if (!m_core.are_key_images_spent(req.key_images, spent))
     {
-      crypto::hash hash;
-      crypto::key_image spent_key_image;
-      if (tools::hex_to_type(i->id_hash, hash))
-      {
-        memcpy(&spent_key_image, &hash, sizeof(hash)); // a bit dodgy, should be other parse functions somewhere
-        for (size_t n = 0; n < res.spent_status.size(); ++n)
-        {
-          if (res.spent_status[n] == IS_KEY_IMAGE_SPENT::UNSPENT)
-          {
-            if (key_images[n] == spent_key_image)
-            {
-              res.spent_status[n] = IS_KEY_IMAGE_SPENT::SPENT_IN_POOL;
-              break;
-            }
-          }
-        }
-      }
-      else
-        MERROR("Invalid hash: " << i->id_hash);
+      res.status = "Failed";
+      return res;
+    }
+    res.spent = pack_bitmap(spent);
+
+    if (!m_core.are_key_images_spent_in_pool(req.key_images, spent, context.admin))
+    {
+      res.status = "Failed";
+      return res;
     }
+    res.spent_in_pool = pack_bitmap(spent);
 
     res.status = STATUS_OK;
     return res;
@@ -1503,6 +1763,25 @@ namespace cryptonote { namespace rpc {
     return res;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  GET_TRANSACTION_POOL_CHANGES_BIN::response core_rpc_server::invoke(GET_TRANSACTION_POOL_CHANGES_BIN::request&& req, rpc_context context)
+  {
+    GET_TRANSACTION_POOL_CHANGES_BIN::response res{};
+
+    PERF_TIMER(on_get_transaction_pool_changes);
+    if (use_bootstrap_daemon_if_necessary<GET_TRANSACTION_POOL_CHANGES_BIN>(req, res))
+      return res;
+
+    auto changes = m_core.get_pool().get_pool_changes(req.pool_id, req.since, context.admin);
+    res.pool_id        = changes.pool_id;
+    res.seq            = changes.seq;
+    res.full           = changes.full;
+    res.tx_hashes      = std::move(changes.txs);
+    res.blink_hashes   = std::move(changes.blinks);
+    res.removed_hashes = std::move(changes.removed);
+    res.status         = STATUS_OK;
+    return res;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   GET_TRANSACTION_POOL_HASHES::response core_rpc_server::invoke(GET_TRANSACTION_POOL_HASHES::request&& req, rpc_context context)
   {
     GET_TRANSACTION_POOL_HASHES::response res{};
@@ -1668,7 +1947,8 @@ namespace cryptonote { namespace rpc {
       if (!tools::hex_to_type(req.prev_block, prev_block))
         throw rpc_error{ERROR_INTERNAL, "Invalid prev_block"};
     }
-    if(!m_core.create_miner_block_template(b, req.prev_block.empty() ? NULL : &prev_block, info.address, diff, res.height, res.expected_reward, blob_reserve))
+    Blockchain::block_template_blobs blobs;
+    if(!m_core.create_miner_block_template(b, req.prev_block.empty() ? NULL : &prev_block, info.address, diff, res.height, res.expected_reward, blob_reserve, &blobs))
     {
       LOG_ERROR("Failed to create block template");
       throw rpc_error{ERROR_INTERNAL, "Internal error: failed to create block template"};
@@ -1688,7 +1968,7 @@ namespace cryptonote { namespace rpc {
     }
     res.difficulty = diff;
 
-    blobdata block_blob = t_serializable_object_to_blob(b);
+    const blobdata& block_blob = blobs.block_blob;
     crypto::public_key tx_pub_key = cryptonote::get_tx_pub_key_from_extra(b.miner_tx);
     if(tx_pub_key == crypto::null_pkey)
     {
@@ -1710,10 +1990,9 @@ namespace cryptonote { namespace rpc {
       LOG_ERROR("Failed to calculate offset for ");
       throw rpc_error{ERROR_INTERNAL, "Internal error: failed to create block template"};
     }
-    blobdata hashing_blob = get_block_hashing_blob(b);
     res.prev_hash = tools::type_to_hex(b.prev_id);
     res.blocktemplate_blob = oxenmq::to_hex(block_blob);
-    res.blockhashing_blob =  oxenmq::to_hex(hashing_blob);
+    res.blockhashing_blob =  oxenmq::to_hex(blobs.hashing_blob);
     res.status = STATUS_OK;
     return res;
   }
@@ -1850,54 +2129,56 @@ namespace cryptonote { namespace rpc {
 
   /// All the common (untemplated) code for use_bootstrap_daemon_if_necessary.  Returns a held lock
   /// if we need to bootstrap, an unheld one if we don't.
-  std::unique_lock<std::shared_mutex> core_rpc_server::should_bootstrap_lock()
+  std::shared_lock<std::shared_mutex> core_rpc_server::should_bootstrap_lock()
   {
     // TODO - support bootstrapping via a remote LMQ RPC; requires some argument fiddling
 
     if (!m_should_use_bootstrap_daemon)
         return {};
 
-    std::unique_lock lock{m_bootstrap_daemon_mutex};
-    if (!m_bootstrap_daemon)
-    {
-      lock.unlock();
-      return lock;
-    }
-
-    auto current_time = std::chrono::system_clock::now();
-    if (!m_p2p.get_payload_object().no_sync() &&
-        current_time - m_bootstrap_height_check_time > 30s)  // update every 30s
     {
-      m_bootstrap_height_check_time = current_time;
+      std::unique_lock lock{m_bootstrap_daemon_mutex};
+      if (!m_bootstrap_daemon)
+        return {};
 
-      std::optional<uint64_t> bootstrap_daemon_height = m_bootstrap_daemon->get_height();
-      if (!bootstrap_daemon_height)
+      auto current_time = std::chrono::system_clock::now();
+      if (!m_p2p.get_payload_object().no_sync() &&
+          current_time - m_bootstrap_height_check_time > 30s)  // update every 30s
       {
-        MERROR("Failed to fetch bootstrap daemon height");
-        lock.unlock();
-        return lock;
+        m_bootstrap_height_check_time = current_time;
+
+        std::optional<uint64_t> bootstrap_daemon_height = m_bootstrap_daemon->get_height();
+        if (!bootstrap_daemon_height)
+        {
+          MERROR("Failed to fetch bootstrap daemon height");
+          return {};
+        }
+
+        uint64_t target_height = m_core.get_target_blockchain_height();
+        if (bootstrap_daemon_height < target_height)
+        {
+          MINFO("Bootstrap daemon is out of sync");
+          m_bootstrap_daemon->set_failed();
+          return {};
+        }
+
+        uint64_t top_height           = m_core.get_current_blockchain_height();
+        m_should_use_bootstrap_daemon = top_height + 10 < bootstrap_daemon_height;
+        MINFO((m_should_use_bootstrap_daemon ? "Using" : "Not using") << " the bootstrap daemon (our height: " << top_height << ", bootstrap daemon's height: " << *bootstrap_daemon_height << ")");
       }
 
-      uint64_t target_height = m_core.get_target_blockchain_height();
-      if (bootstrap_daemon_height < target_height)
+      if (!m_should_use_bootstrap_daemon)
       {
-        MINFO("Bootstrap daemon is out of sync");
-        lock.unlock();
-        m_bootstrap_daemon->set_failed();
-        return lock;
+        MINFO("The local daemon is fully synced; disabling bootstrap daemon requests");
+        return {};
       }
-
-      uint64_t top_height           = m_core.get_current_blockchain_height();
-      m_should_use_bootstrap_daemon = top_height + 10 < bootstrap_daemon_height;
-      MINFO((m_should_use_bootstrap_daemon ? "Using" : "Not using") << " the bootstrap daemon (our height: " << top_height << ", bootstrap daemon's height: " << *bootstrap_daemon_height << ")");
     }
 
-    if (!m_should_use_bootstrap_daemon)
-    {
-      MINFO("The local daemon is fully synced; disabling bootstrap daemon requests");
+    // The requests themselves only need the bootstrap daemon to stay put while they run, so they
+    // share the lock and go out in parallel
+    std::shared_lock lock{m_bootstrap_daemon_mutex};
+    if (!m_bootstrap_daemon)
       lock.unlock();
-    }
-
     return lock;
   }
 
@@ -1935,9 +2216,9 @@ namespace cryptonote { namespace rpc {
       return res;
 
     CHECK_CORE_READY();
-    uint64_t last_block_height;
-    crypto::hash last_block_hash;
-    m_core.get_blockchain_top(last_block_height, last_block_hash);
+    auto tip = m_core.get_blockchain_storage().get_chain_tip_snapshot();
+    uint64_t last_block_height = tip->height - 1;
+    const crypto::hash& last_block_hash = tip->top_hash;
     block last_block;
     bool have_last_block = m_core.get_block_by_height(last_block_height, last_block);
     if (!have_last_block)
@@ -2019,7 +2300,7 @@ namespace cryptonote { namespace rpc {
     if (use_bootstrap_daemon_if_necessary<GET_BLOCK_HEADER_BY_HEIGHT>(req, res))
       return res;
 
-    auto get = [this, curr_height=m_core.get_current_blockchain_height(), pow=req.fill_pow_hash && context.admin, tx_hashes=req.get_tx_hashes]
+    auto get = [this, curr_height=m_core.get_blockchain_storage().get_chain_tip_snapshot()->height, pow=req.fill_pow_hash && context.admin, tx_hashes=req.get_tx_hashes]
         (uint64_t height, block_header_response& bhr) {
       if (height >= curr_height)
         throw rpc_error{ERROR_TOO_BIG_HEIGHT,
@@ -2325,6 +2606,30 @@ namespace cryptonote { namespace rpc {
     return res;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  GET_SWARM::response core_rpc_server::invoke(GET_SWARM::request&& req, rpc_context context)
+  {
+    GET_SWARM::response res{};
+
+    PERF_TIMER(on_get_swarm);
+    std::string_view hex{req.pubkey};
+    if (hex.size() == 66)
+      hex.remove_prefix(2);
+    if (hex.size() != 64 || !oxenmq::is_hex(hex))
+      throw rpc_error{ERROR_WRONG_PARAM, "Invalid pubkey: expected 32 (or 33) hex-encoded bytes"};
+    auto pubkey = oxenmq::from_hex(hex);
+
+    auto swarm = m_core.get_service_node_list().get_swarm_for_pubkey(pubkey);
+    if (!swarm)
+      throw rpc_error{ERROR_INTERNAL, "There are no swarms"};
+
+    res.swarm_id = swarm->id;
+    res.service_node_pubkeys.reserve(swarm->members.size());
+    for (const auto &member : swarm->members)
+      res.service_node_pubkeys.push_back(tools::type_to_hex(member));
+    res.status = STATUS_OK;
+    return res;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   GET_SERVICE_NODE_STATUS::response core_rpc_server::invoke(GET_SERVICE_NODE_STATUS::request&& req, rpc_context context)
   {
     GET_SERVICE_NODE_STATUS::response res{};
@@ -2552,9 +2857,7 @@ namespace cryptonote { namespace rpc {
 
     PERF_TIMER(on_sync_info);
 
-    crypto::hash top_hash;
-    m_core.get_blockchain_top(res.height, top_hash);
-    ++res.height; // turn top block height into blockchain height
+    res.height = m_core.get_blockchain_storage().get_chain_tip_snapshot()->height;
     res.target_height = m_core.get_target_blockchain_height();
     res.next_needed_pruning_seed = m_p2p.get_payload_object().get_next_needed_pruning_stripe().second;
 
@@ -2568,7 +2871,7 @@ namespace cryptonote { namespace rpc {
       for (const auto &c: m_p2p.get_payload_object().get_connections())
         if (c.connection_id == span_connection_id)
           address = c.address;
-      res.spans.push_back({span.start_block_height, span.nblocks, span_connection_id, (uint32_t)(span.rate + 0.5f), speed, span.size, address});
+      res.spans.push_back({span.start_block_height, span.nblocks, span_connection_id, (uint32_t)(span.rate + 0.5f), speed, span.size, address, span.spilled.has_value()});
       return true;
     });
     res.overview = block_queue.get_overview(res.height);
@@ -2606,77 +2909,22 @@ namespace cryptonote { namespace rpc {
 
       return {std::move(distribution), start_height, base};
     }
-
-    static struct {
-      std::mutex mutex;
-      std::vector<std::uint64_t> cached_distribution;
-      std::uint64_t cached_from = 0, cached_to = 0, cached_start_height = 0, cached_base = 0;
-      crypto::hash cached_m10_hash = crypto::null_hash;
-      crypto::hash cached_top_hash = crypto::null_hash;
-      bool cached = false;
-    } output_dist_cache;
   }
 
   namespace detail {
+    // The amount 0 (i.e. rct) distribution, which is what wallets ask for, comes straight out of
+    // the in-memory block info in the db, so there's nothing to gain from caching it here.
     std::optional<output_distribution_data> get_output_distribution(
         const std::function<bool(uint64_t, uint64_t, uint64_t, uint64_t&, std::vector<uint64_t>&, uint64_t&)>& f,
         uint64_t amount,
         uint64_t from_height,
         uint64_t to_height,
-        const std::function<crypto::hash(uint64_t)>& get_hash,
-        bool cumulative,
-        uint64_t blockchain_height)
+        bool cumulative)
     {
-      auto& d = output_dist_cache;
-      const std::unique_lock lock{d.mutex};
-
-      crypto::hash top_hash = crypto::null_hash;
-      if (d.cached_to < blockchain_height)
-        top_hash = get_hash(d.cached_to);
-      if (d.cached && amount == 0 && d.cached_from == from_height && d.cached_to == to_height && d.cached_top_hash == top_hash)
-        return process_distribution(cumulative, d.cached_start_height, d.cached_distribution, d.cached_base);
-
       std::vector<std::uint64_t> distribution;
       std::uint64_t start_height, base;
-
-      // see if we can extend the cache - a common case
-      bool can_extend = d.cached && amount == 0 && d.cached_from == from_height && to_height > d.cached_to && top_hash == d.cached_top_hash;
-      if (!can_extend)
-      {
-        // we kept track of the hash 10 blocks below, if it exists, so if it matches,
-        // we can still pop the last 10 cached slots and try again
-        if (d.cached && amount == 0 && d.cached_from == from_height && d.cached_to - d.cached_from >= 10 && to_height > d.cached_to - 10)
-        {
-          crypto::hash hash10 = get_hash(d.cached_to - 10);
-          if (hash10 == d.cached_m10_hash)
-          {
-            d.cached_to -= 10;
-            d.cached_top_hash = hash10;
-            d.cached_m10_hash = crypto::null_hash;
-            CHECK_AND_ASSERT_MES(d.cached_distribution.size() >= 10, std::nullopt, "Cached distribution size does not match cached bounds");
-            for (int p = 0; p < 10; ++p)
-              d.cached_distribution.pop_back();
-            can_extend = true;
-          }
-        }
-      }
-      if (can_extend)
-      {
-        std::vector<std::uint64_t> new_distribution;
-        if (!f(amount, d.cached_to + 1, to_height, start_height, new_distribution, base))
-          return std::nullopt;
-        distribution = d.cached_distribution;
-        distribution.reserve(distribution.size() + new_distribution.size());
-        for (const auto &e: new_distribution)
-          distribution.push_back(e);
-        start_height = d.cached_start_height;
-        base = d.cached_base;
-      }
-      else
-      {
-        if (!f(amount, from_height, to_height, start_height, distribution, base))
-          return std::nullopt;
-      }
+      if (!f(amount, from_height, to_height, start_height, distribution, base))
+        return std::nullopt;
 
       if (to_height > 0 && to_height >= from_height)
       {
@@ -2685,18 +2933,6 @@ namespace cryptonote { namespace rpc {
           distribution.resize(to_height - offset + 1);
       }
 
-      if (amount == 0)
-      {
-        d.cached_from = from_height;
-        d.cached_to = to_height;
-        d.cached_top_hash = get_hash(d.cached_to);
-        d.cached_m10_hash = d.cached_to >= 10 ? get_hash(d.cached_to - 10) : crypto::null_hash;
-        d.cached_distribution = distribution;
-        d.cached_start_height = start_height;
-        d.cached_base = base;
-        d.cached = true;
-      }
-
       return process_distribution(cumulative, start_height, std::move(distribution), base);
     }
   }
@@ -2710,20 +2946,33 @@ namespace cryptonote { namespace rpc {
     if (use_bootstrap_daemon_if_necessary<GET_OUTPUT_DISTRIBUTION>(req, res))
       return res;
 
+    crypto::hash known_hash = crypto::null_hash;
+    if (!req.known_hash.empty() && !tools::hex_to_type(req.known_hash, known_hash))
+      throw rpc_error{ERROR_WRONG_PARAM, "Invalid known_hash"};
+
     try
     {
       // 0 is placeholder for the whole chain
       const uint64_t req_to_height = req.to_height ? req.to_height : (m_core.get_current_blockchain_height() - 1);
+      uint64_t from_height = req.from_height;
+      // The client already has the distribution below from_height; if that isn't on our chain any
+      // more it needs all of it again.
+      if (from_height > 0 && !req.known_hash.empty() && m_core.get_block_id_by_height(from_height - 1) != known_hash)
+        from_height = 0;
+      res.top_hash = tools::type_to_hex(m_core.get_block_id_by_height(req_to_height));
+
       for (uint64_t amount: req.amounts)
       {
-        auto data = detail::get_output_distribution(
-            [this](auto&&... args) { return m_core.get_output_distribution(std::forward<decltype(args)>(args)...); },
-            amount,
-            req.from_height,
-            req_to_height,
-            [this](uint64_t height) { return m_core.get_blockchain_storage().get_db().get_block_hash_from_height(height); },
-            req.cumulative,
-            m_core.get_current_blockchain_height());
+        std::optional<output_distribution_data> data;
+        if (from_height == req_to_height + 1 && !req.known_hash.empty())
+          data = output_distribution_data{{}, from_height, 0}; // Client is already up to date
+        else
+          data = detail::get_output_distribution(
+              [this](auto&&... args) { return m_core.get_output_distribution(std::forward<decltype(args)>(args)...); },
+              amount,
+              from_height,
+              req_to_height,
+              req.cumulative);
         if (!data)
           throw rpc_error{ERROR_INTERNAL, "Failed to get output distribution"};
 
@@ -2766,8 +3015,13 @@ namespace cryptonote { namespace rpc {
 
     try
     {
-      if (!(req.check ? m_core.check_blockchain_pruning() : m_core.prune_blockchain()))
-        throw rpc_error{ERROR_INTERNAL, req.check ? "Failed to check blockchain pruning" : "Failed to prune blockchain"};
+      if (req.check)
+      {
+        if (!m_core.check_blockchain_pruning())
+          throw rpc_error{ERROR_INTERNAL, "Failed to check blockchain pruning"};
+      }
+      else if (!(req.background ? m_core.start_background_pruning() : m_core.prune_blockchain()))
+        throw rpc_error{ERROR_INTERNAL, "Failed to prune blockchain"};
       res.pruning_seed = m_core.get_blockchain_pruning_seed();
       res.pruned = res.pruning_seed != 0;
     }
@@ -2779,6 +3033,26 @@ namespace cryptonote { namespace rpc {
     res.status = STATUS_OK;
     return res;
   }
+  //------------------------------------------------------------------------------------------------------------------------------
+  CREATE_SNAPSHOT::response core_rpc_server::invoke(CREATE_SNAPSHOT::request&& req, rpc_context context)
+  {
+    CREATE_SNAPSHOT::response res{};
+
+    fs::path dir = req.dir.empty() ? m_core.get_config_directory() / "snapshot" : fs::u8path(req.dir);
+    snapshot::manifest manifest;
+    if (!m_core.create_snapshot(dir, manifest))
+      throw rpc_error{ERROR_INTERNAL, "Failed to create snapshot"};
+
+    res.dir = dir.u8string();
+    res.height = manifest.height;
+    res.top_hash = tools::type_to_hex(manifest.top_hash);
+    res.chunks.reserve(manifest.chunks.size());
+    for (const auto& c : manifest.chunks)
+      res.chunks.push_back({c.file, c.offset, c.size, tools::type_to_hex(c.hash)});
+
+    res.status = STATUS_OK;
+    return res;
+  }
 
 
   GET_QUORUM_STATE::response core_rpc_server::invoke(GET_QUORUM_STATE::request&& req, rpc_context context)
@@ -2937,6 +3211,242 @@ namespace cryptonote { namespace rpc {
     return res;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  namespace {
+    light_wallet_scanner& get_light_wallet_scanner(core& c)
+    {
+      auto* scanner = c.get_light_wallet_scanner();
+      if (!scanner)
+        throw rpc_error{ERROR_UNSUPPORTED_RPC, "Light wallet support is not enabled on this node (see --light-wallet-scanner)"};
+      return *scanner;
+    }
+
+    std::pair<account_public_address, crypto::secret_key> parse_light_wallet_keys(network_type nettype, const std::string& address, const std::string& view_key)
+    {
+      address_parse_info info;
+      if (!get_account_address_from_str(info, nettype, address))
+        throw rpc_error{ERROR_WRONG_WALLET_ADDRESS, "Failed to parse wallet address"};
+      if (info.is_subaddress)
+        throw rpc_error{ERROR_WRONG_WALLET_ADDRESS, "Light wallet accounts must be primary addresses"};
+      crypto::secret_key key;
+      if (!tools::hex_to_type(view_key, key))
+        throw rpc_error{ERROR_WRONG_PARAM, "Failed to parse view key"};
+      return {info.address, key};
+    }
+
+    light_wallet_scanner::account_info get_light_wallet_account(core& c, const std::string& address, const std::string& view_key)
+    {
+      auto [addr, key] = parse_light_wallet_keys(c.get_nettype(), address, view_key);
+      auto account = get_light_wallet_scanner(c).get_account(addr, key);
+      if (!account)
+        throw rpc_error{ERROR_WRONG_PARAM, "No light wallet account for this address and view key; log in first"};
+      return std::move(*account);
+    }
+
+    // The account's RingCT outputs, by global index: spends only know the outputs by that
+    std::unordered_map<uint64_t, const light_wallet_scanner::output*> light_wallet_outputs_by_index(const light_wallet_scanner::account_info& account)
+    {
+      std::unordered_map<uint64_t, const light_wallet_scanner::output*> result;
+      for (auto& o : account.outputs)
+        if (o.rct)
+          result.emplace(o.global_index, &o);
+      return result;
+    }
+
+    bool light_wallet_output_locked(const light_wallet_scanner::output& o, uint64_t chain_height)
+    {
+      return o.height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE > chain_height || !rules::is_output_unlocked(o.unlock_time, chain_height);
+    }
+
+    template <typename SpentOutput>
+    SpentOutput light_wallet_spent_output(const light_wallet_scanner::spend& s, const light_wallet_scanner::output& o)
+    {
+      SpentOutput so{};
+      so.amount = o.amount;
+      so.key_image = tools::type_to_hex(s.key_image);
+      so.tx_pub_key = tools::type_to_hex(o.tx_pub_key);
+      so.out_index = o.index;
+      so.mixin = s.mixin;
+      return so;
+    }
+
+    uint64_t last_scanned_block(const light_wallet_scanner::account_info& account)
+    {
+      return account.scanned_height ? account.scanned_height - 1 : 0;
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  LIGHT_WALLET_LOGIN::response core_rpc_server::invoke(LIGHT_WALLET_LOGIN::request&& req, rpc_context context)
+  {
+    LIGHT_WALLET_LOGIN::response res{};
+    auto& scanner = get_light_wallet_scanner(m_core);
+    auto [address, view_key] = parse_light_wallet_keys(nettype(), req.address, req.view_key);
+
+    using result = light_wallet_scanner::login_result;
+    switch (scanner.login(address, view_key, req.create_account))
+    {
+      case result::found: res.status = "success"; break;
+      case result::created: res.status = "success"; res.new_address = true; break;
+      case result::not_found: res.status = "error"; res.reason = "Account does not exist"; break;
+      case result::wrong_view_key: res.status = "error"; res.reason = "Invalid view key for this address"; break;
+    }
+    return res;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  LIGHT_WALLET_GET_ADDRESS_INFO::response core_rpc_server::invoke(LIGHT_WALLET_GET_ADDRESS_INFO::request&& req, rpc_context context)
+  {
+    LIGHT_WALLET_GET_ADDRESS_INFO::response res{};
+    auto account = get_light_wallet_account(m_core, req.address, req.view_key);
+    const uint64_t chain_height = m_core.get_current_blockchain_height();
+
+    for (auto& o : account.outputs)
+    {
+      res.total_received += o.amount;
+      if (light_wallet_output_locked(o, chain_height))
+        res.locked_funds += o.amount;
+    }
+    auto outputs = light_wallet_outputs_by_index(account);
+    for (auto& s : account.spends)
+    {
+      auto it = outputs.find(s.out_global_index);
+      if (it == outputs.end())
+        continue;
+      res.total_sent += it->second->amount;
+      res.spent_outputs.push_back(light_wallet_spent_output<tools::light_rpc::GET_ADDRESS_INFO::spent_output>(s, *it->second));
+    }
+    res.scanned_height = res.scanned_block_height = last_scanned_block(account);
+    res.start_height = account.start_height;
+    res.transaction_height = res.blockchain_height = chain_height;
+    return res;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  LIGHT_WALLET_GET_ADDRESS_TXS::response core_rpc_server::invoke(LIGHT_WALLET_GET_ADDRESS_TXS::request&& req, rpc_context context)
+  {
+    LIGHT_WALLET_GET_ADDRESS_TXS::response res{};
+    auto account = get_light_wallet_account(m_core, req.address, req.view_key);
+    const uint64_t chain_height = m_core.get_current_blockchain_height();
+
+    // Outputs and spends are both in chain order: merge them into txs in chain order
+    std::unordered_map<crypto::hash, size_t> tx_pos;
+    auto get_tx = [&](const crypto::hash& hash, uint64_t height, uint64_t timestamp) -> auto& {
+      auto [it, inserted] = tx_pos.emplace(hash, res.transactions.size());
+      if (inserted)
+      {
+        auto& t = res.transactions.emplace_back();
+        t.id = it->second;
+        t.hash = tools::type_to_hex(hash);
+        t.height = height;
+        t.timestamp = timestamp;
+      }
+      return res.transactions[it->second];
+    };
+
+    auto outputs = light_wallet_outputs_by_index(account);
+    auto next_spend = account.spends.begin();
+    auto add_spends_before = [&](uint64_t height) {
+      for (; next_spend != account.spends.end() && next_spend->height < height; ++next_spend)
+      {
+        auto it = outputs.find(next_spend->out_global_index);
+        if (it == outputs.end())
+          continue;
+        auto& t = get_tx(next_spend->tx_hash, next_spend->height, next_spend->timestamp);
+        t.total_sent += it->second->amount;
+        t.mixin = next_spend->mixin;
+        t.spent_outputs.push_back(light_wallet_spent_output<tools::light_rpc::GET_ADDRESS_TXS::spent_output>(*next_spend, *it->second));
+      }
+    };
+    for (auto& o : account.outputs)
+    {
+      add_spends_before(o.height + 1);
+      auto& t = get_tx(o.tx_hash, o.height, o.timestamp);
+      t.total_received += o.amount;
+      t.unlock_time = o.tx_unlock_time;
+      t.coinbase = o.coinbase;
+      t.mixin = o.mixin;
+      res.total_received += o.amount;
+      if (!light_wallet_output_locked(o, chain_height))
+        res.total_received_unlocked += o.amount;
+    }
+    add_spends_before(std::numeric_limits<uint64_t>::max());
+
+    res.scanned_height = res.scanned_block_height = last_scanned_block(account);
+    res.blockchain_height = chain_height;
+    res.status = "success";
+    return res;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  LIGHT_WALLET_GET_UNSPENT_OUTS::response core_rpc_server::invoke(LIGHT_WALLET_GET_UNSPENT_OUTS::request&& req, rpc_context context)
+  {
+    LIGHT_WALLET_GET_UNSPENT_OUTS::response res{};
+    auto account = get_light_wallet_account(m_core, req.address, req.view_key);
+
+    // Without the spend key we can't tell which of the outputs are spent: each comes with the key
+    // images of the inputs that might spend it, for the wallet to check.
+    std::unordered_map<uint64_t, std::vector<std::string>> key_images;
+    for (auto& s : account.spends)
+      key_images[s.out_global_index].push_back(tools::type_to_hex(s.key_image));
+
+    for (auto& o : account.outputs)
+    {
+      auto& out = res.outputs.emplace_back();
+      out.amount = o.amount;
+      out.public_key = tools::type_to_hex(o.key);
+      out.index = o.index;
+      out.global_index = o.global_index;
+      if (o.rct)
+      {
+        out.rct = tools::type_to_hex(o.commitment) + tools::type_to_hex(o.ecdh_info.mask) + tools::type_to_hex(o.ecdh_info.amount);
+        if (auto it = key_images.find(o.global_index); it != key_images.end())
+          out.spend_key_images = it->second;
+      }
+      out.tx_hash = tools::type_to_hex(o.tx_hash);
+      out.tx_pub_key = tools::type_to_hex(o.tx_pub_key);
+      out.tx_prefix_hash = tools::type_to_hex(o.tx_prefix_hash);
+      out.timestamp = o.timestamp;
+      out.height = o.height;
+      res.amount += o.amount;
+    }
+    // Valid for as many blocks as the wallet's own estimates (wallet2's FEE_ESTIMATE_GRACE_BLOCKS)
+    res.per_kb_fee = m_core.get_blockchain_storage().get_dynamic_base_fee_estimate(10).first * 1024;
+    res.status = "success";
+    return res;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  LIGHT_WALLET_IMPORT_WALLET_REQUEST::response core_rpc_server::invoke(LIGHT_WALLET_IMPORT_WALLET_REQUEST::request&& req, rpc_context context)
+  {
+    LIGHT_WALLET_IMPORT_WALLET_REQUEST::response res{};
+    auto& scanner = get_light_wallet_scanner(m_core);
+    auto [address, view_key] = parse_light_wallet_keys(nettype(), req.address, req.view_key);
+    if (!scanner.rescan(address, view_key))
+      throw rpc_error{ERROR_WRONG_PARAM, "No light wallet account for this address and view key; log in first"};
+
+    // Imports are free, and done as soon as the rescan catches up
+    res.import_fee = 0;
+    res.new_request = true;
+    res.request_fulfilled = true;
+    res.status = "success";
+    return res;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  LIGHT_WALLET_SUBMIT_RAW_TX::response core_rpc_server::invoke(LIGHT_WALLET_SUBMIT_RAW_TX::request&& req, rpc_context context)
+  {
+    LIGHT_WALLET_SUBMIT_RAW_TX::response res{};
+    get_light_wallet_scanner(m_core);
+
+    SEND_RAW_TX::request send{};
+    send.tx_as_hex = std::move(req.tx);
+    send.do_sanity_checks = true;
+    send.blink = req.blink;
+    auto sent = invoke(std::move(send), std::move(context));
+    if (sent.status == STATUS_OK)
+      res.status = "success";
+    else
+    {
+      res.status = "error";
+      res.error = sent.reason.empty() ? sent.status : sent.reason;
+    }
+    return res;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   GET_SERVICE_NODE_REGISTRATION_CMD_RAW::response core_rpc_server::invoke(GET_SERVICE_NODE_REGISTRATION_CMD_RAW::request&& req, rpc_context context)
   {
     GET_SERVICE_NODE_REGISTRATION_CMD_RAW::response res{};
@@ -3138,16 +3648,56 @@ namespace cryptonote { namespace rpc {
 
   }
 
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::shared_ptr<const core_rpc_server::sn_snapshot> core_rpc_server::get_sn_snapshot()
+  {
+    auto tip = m_core.get_blockchain_storage().get_chain_tip_snapshot();
+    // Held while we remake it, so that concurrent requests wait for the new one rather than each
+    // making their own
+    std::lock_guard lock{m_sn_snapshot_mutex};
+    const auto now = std::chrono::steady_clock::now();
+    if (m_sn_snapshot && m_sn_snapshot->block_hash == tip->top_hash && now - m_sn_snapshot->created < SN_SNAPSHOT_MAX_AGE)
+      return m_sn_snapshot;
+
+    auto snap = std::make_shared<sn_snapshot>();
+    snap->block_hash = tip->top_hash;
+    snap->height = tip->height - 1;
+    snap->created = now;
+    snap->infos = m_core.get_service_node_list_state();
+    snap->entries.resize(snap->infos.size());
+    snap->index.reserve(snap->infos.size());
+    for (size_t i = 0; i < snap->infos.size(); i++)
+    {
+      fill_sn_response_entry(snap->entries[i], snap->infos[i], snap->height);
+      snap->index.emplace(snap->infos[i].pubkey, i);
+    }
+
+    if (m_sn_snapshot_history.empty() || m_sn_snapshot_history.back().first != snap->block_hash)
+    {
+      auto& [hash, states] = m_sn_snapshot_history.emplace_back();
+      hash = snap->block_hash;
+      states.reserve(snap->infos.size());
+      for (auto& sn : snap->infos)
+        states.emplace(sn.pubkey, sn.info);
+      while (m_sn_snapshot_history.size() > SN_SNAPSHOT_HISTORY)
+        m_sn_snapshot_history.pop_front();
+    }
+
+    m_sn_snapshot = snap;
+    return snap;
+  }
+
   static constexpr GET_SERVICE_NODES::requested_fields_t all_fields{true};
   //------------------------------------------------------------------------------------------------------------------------------
   GET_SERVICE_NODES::response core_rpc_server::invoke(GET_SERVICE_NODES::request&& req, rpc_context context)
   {
     GET_SERVICE_NODES::response res{};
 
+    auto snap = get_sn_snapshot();
     res.status = STATUS_OK;
-    res.height = m_core.get_current_blockchain_height() - 1;
+    res.height = snap->height;
     res.target_height = m_core.get_target_blockchain_height();
-    res.block_hash = tools::type_to_hex(m_core.get_block_id_by_height(res.height));
+    res.block_hash = tools::type_to_hex(snap->block_hash);
     auto [hf, snode_rev] = get_network_version_revision(nettype(), res.height);
     res.hardfork = hf;
     res.snode_revision = snode_rev;
@@ -3161,29 +3711,63 @@ namespace cryptonote { namespace rpc {
       }
     }
 
-    std::vector<crypto::public_key> pubkeys(req.service_node_pubkeys.size());
-    for (size_t i = 0; i < req.service_node_pubkeys.size(); i++)
+    // Indices into snap->infos/entries of the nodes to return
+    std::vector<size_t> selected;
+    if (req.service_node_pubkeys.empty())
     {
-      if (!tools::hex_to_type(req.service_node_pubkeys[i], pubkeys[i]))
-        throw rpc_error{ERROR_WRONG_PARAM,
-          "Could not convert to a public key, arg: " + std::to_string(i)
-            + " which is pubkey: " + req.service_node_pubkeys[i]};
+      selected.resize(snap->infos.size());
+      std::iota(selected.begin(), selected.end(), 0);
+    }
+    else
+    {
+      selected.reserve(req.service_node_pubkeys.size());
+      for (size_t i = 0; i < req.service_node_pubkeys.size(); i++)
+      {
+        crypto::public_key pubkey;
+        if (!tools::hex_to_type(req.service_node_pubkeys[i], pubkey))
+          throw rpc_error{ERROR_WRONG_PARAM,
+            "Could not convert to a public key, arg: " + std::to_string(i)
+              + " which is pubkey: " + req.service_node_pubkeys[i]};
+        if (auto it = snap->index.find(pubkey); it != snap->index.end())
+          selected.push_back(it->second);
+      }
     }
 
-    auto sn_infos = m_core.get_service_node_list_state(pubkeys);
+    crypto::hash since;
+    if (!req.changed_since_block_hash.empty() && tools::hex_to_type(req.changed_since_block_hash, since)) {
+      std::lock_guard lock{m_sn_snapshot_mutex};
+      auto it = std::find_if(m_sn_snapshot_history.begin(), m_sn_snapshot_history.end(), [&since](const auto& h) { return h.first == since; });
+      if (it != m_sn_snapshot_history.end()) {
+        const auto& then = it->second;
+        res.delta = true;
+        selected.erase(std::remove_if(selected.begin(), selected.end(), [&](size_t i) {
+              auto& sn = snap->infos[i];
+              auto old = then.find(sn.pubkey);
+              return old != then.end() && old->second == sn.info;
+            }), selected.end());
+        if (req.service_node_pubkeys.empty()) {
+          for (auto& [pubkey, info] : then)
+            if (!snap->index.count(pubkey))
+              res.removed.push_back(tools::type_to_hex(pubkey));
+        } else {
+          for (auto& pk : req.service_node_pubkeys) {
+            crypto::public_key pubkey;
+            if (tools::hex_to_type(pk, pubkey) && then.count(pubkey) && !snap->index.count(pubkey))
+              res.removed.push_back(pk);
+          }
+        }
+      }
+    }
 
     if (req.active_only) {
-      const auto end =
-        std::remove_if(sn_infos.begin(), sn_infos.end(), [](const service_nodes::service_node_pubkey_info& snpk_info) {
-          return !snpk_info.info->is_active();
-        });
-
-      sn_infos.erase(end, sn_infos.end());
+      selected.erase(std::remove_if(selected.begin(), selected.end(), [&snap](size_t i) {
+            return !snap->infos[i].info->is_active();
+          }), selected.end());
     }
 
     if (req.limit != 0) {
 
-      const auto limit = std::min(sn_infos.size(), static_cast<size_t>(req.limit));
+      const auto limit = std::min(selected.size(), static_cast<size_t>(req.limit));
 
       // We need to select N random elements, in random order, from yyyyyyyy.  We could (and used
       // to) just shuffle the entire list and return the first N, but that is quite inefficient when
@@ -3195,30 +3779,34 @@ namespace cryptonote { namespace rpc {
       // of the y's to just be left with [xxx], and only required N swaps in total.
       for (size_t i = 0; i < limit; i++)
       {
-        size_t j = std::uniform_int_distribution<size_t>{i, sn_infos.size()-1}(tools::rng);
+        size_t j = std::uniform_int_distribution<size_t>{i, selected.size()-1}(tools::rng);
         using std::swap;
         if (i != j)
-          swap(sn_infos[i], sn_infos[j]);
+          swap(selected[i], selected[j]);
       }
 
-      sn_infos.resize(limit);
+      selected.resize(limit);
     }
 
-    res.service_node_states.reserve(sn_infos.size());
+    res.service_node_states.reserve(selected.size());
     res.fields = req.fields.value_or(all_fields);
 
     if (req.include_json)
     {
-      if (sn_infos.empty())
+      if (selected.empty())
         res.as_json = "{}";
       else
+      {
+        std::vector<service_nodes::service_node_pubkey_info> sn_infos;
+        sn_infos.reserve(selected.size());
+        for (size_t i : selected)
+          sn_infos.push_back(snap->infos[i]);
         res.as_json = cryptonote::obj_to_json_str(sn_infos);
+      }
     }
 
-    for (auto &pubkey_info : sn_infos) {
-      res.service_node_states.emplace_back();
-      fill_sn_response_entry(res.service_node_states.back(), pubkey_info, res.height);
-    }
+    for (size_t i : selected)
+      res.service_node_states.push_back(snap->entries[i]);
 
     return res;
   }
@@ -3400,7 +3988,7 @@ namespace cryptonote { namespace rpc {
         if (tx.type == cryptonote::txtype::state_change)
         {
           cryptonote::tx_extra_service_node_state_change state_change;
-          if (!cryptonote::get_service_node_state_change_from_tx_extra(tx.extra, state_change, hard_fork_version))
+          if (!cryptonote::get_service_node_state_change_from_tx_extra(tx, state_change, hard_fork_version))
           {
             LOG_ERROR("Could not get state change from tx, possibly corrupt tx, hf_version "<< std::to_string(hard_fork_version));
             continue;
@@ -3628,5 +4216,48 @@ namespace cryptonote { namespace rpc {
     }
     return res;
   }
+  //------------------------------------------------------------------------------------------------------------------------------
+  ONS_RESOLVE_BATCH::response core_rpc_server::invoke(ONS_RESOLVE_BATCH::request&& req, rpc_context context)
+  {
+    ONS_RESOLVE_BATCH::response res{};
+
+    if (!context.admin)
+      check_quantity_limit(req.entries.size(), ONS_RESOLVE_BATCH::MAX_REQUEST_ENTRIES);
+
+    uint8_t hf_version = m_core.get_blockchain_storage().get_network_version();
+    std::vector<std::pair<ons::mapping_type, std::string>> names;
+    names.reserve(req.entries.size());
+    for (size_t i = 0; i < req.entries.size(); i++)
+    {
+      auto& entry = req.entries[i];
+      if (entry.type >= tools::enum_count<ons::mapping_type>)
+        throw rpc_error{ERROR_WRONG_PARAM, "Unable to resolve ONS address: 'type' parameter not specified in entry " + std::to_string(i)};
+
+      auto name_hash = ons::name_hash_input_to_base64(entry.name_hash);
+      if (!name_hash)
+        throw rpc_error{ERROR_WRONG_PARAM, "Unable to resolve ONS address: invalid 'name_hash' value '" + entry.name_hash + "'"};
+
+      auto type = static_cast<ons::mapping_type>(entry.type);
+      if (!ons::mapping_type_allowed(hf_version, type))
+        throw rpc_error{ERROR_WRONG_PARAM, "Invalid lokinet type '" + std::to_string(entry.type) + "'"};
+
+      names.emplace_back(type, std::move(*name_hash));
+    }
+
+    auto mappings = m_core.get_blockchain_storage().name_system_db().resolve(names, m_core.get_current_blockchain_height());
+    res.entries.resize(mappings.size());
+    for (size_t i = 0; i < mappings.size(); i++)
+    {
+      if (!mappings[i])
+        continue;
+      auto [val, nonce] = mappings[i]->value_nonce(names[i].first);
+      res.entries[i].encrypted_value = oxenmq::to_hex(val);
+      if (val.size() < mappings[i]->to_view().size())
+        res.entries[i].nonce = oxenmq::to_hex(nonce);
+    }
+
+    res.status = STATUS_OK;
+    return res;
+  }
 
 } }  // namespace cryptonote
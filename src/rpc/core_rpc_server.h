@@ -31,8 +31,11 @@
 
 #pragma once
 
+#include <deque>
 #include <variant>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
@@ -45,6 +48,7 @@
 
 #if defined(OXEN_ENABLE_INTEGRATION_TEST_HOOKS)
 #include "common/oxen_integration_test_hooks.h"
+#include "common/cache_budget.h"
 #endif
 
 #undef OXEN_DEFAULT_LOG_CATEGORY
@@ -140,6 +144,7 @@ namespace cryptonote::rpc {
     bool is_public; // callable via restricted RPC
     bool is_binary; // only callable at /name (for HTTP RPC), and binary data, not JSON.
     bool is_legacy; // callable at /name (for HTTP RPC), even though it is JSON (for backwards compat).
+    bool is_cacheable; // invoke() answers repeated requests from core_rpc_server::cached_response()
   };
 
   /// RPC command registration; to add a new command, define it in core_rpc_server_commands_defs.h
@@ -149,7 +154,7 @@ namespace cryptonote::rpc {
   // Function used for getting an output distribution; this is non-static because we need to get at
   // it from the test suite, but should be considered internal.
   namespace detail {
-    std::optional<output_distribution_data> get_output_distribution(const std::function<bool(uint64_t, uint64_t, uint64_t, uint64_t&, std::vector<uint64_t>&, uint64_t&)>& f, uint64_t amount, uint64_t from_height, uint64_t to_height, const std::function<crypto::hash(uint64_t)>& get_hash, bool cumulative, uint64_t blockchain_height);
+    std::optional<output_distribution_data> get_output_distribution(const std::function<bool(uint64_t, uint64_t, uint64_t, uint64_t&, std::vector<uint64_t>&, uint64_t&)>& f, uint64_t amount, uint64_t from_height, uint64_t to_height, bool cumulative);
   }
 
   /**
@@ -192,11 +197,13 @@ namespace cryptonote::rpc {
 
     GET_HEIGHT::response                                invoke(GET_HEIGHT::request&& req, rpc_context context);
     GET_BLOCKS_FAST::response                           invoke(GET_BLOCKS_FAST::request&& req, rpc_context context);
+    GET_BLOCK_DIGESTS::response                         invoke(GET_BLOCK_DIGESTS::request&& req, rpc_context context);
     GET_ALT_BLOCKS_HASHES::response                     invoke(GET_ALT_BLOCKS_HASHES::request&& req, rpc_context context);
     GET_BLOCKS_BY_HEIGHT::response                      invoke(GET_BLOCKS_BY_HEIGHT::request&& req, rpc_context context);
     GET_HASHES_FAST::response                           invoke(GET_HASHES_FAST::request&& req, rpc_context context);
     GET_TRANSACTIONS::response                          invoke(GET_TRANSACTIONS::request&& req, rpc_context context);
     IS_KEY_IMAGE_SPENT::response                        invoke(IS_KEY_IMAGE_SPENT::request&& req, rpc_context context);
+    IS_KEY_IMAGE_SPENT_BIN::response                    invoke(IS_KEY_IMAGE_SPENT_BIN::request&& req, rpc_context context);
     GET_TX_GLOBAL_OUTPUTS_INDEXES::response             invoke(GET_TX_GLOBAL_OUTPUTS_INDEXES::request&& req, rpc_context context);
     SEND_RAW_TX::response                               invoke(SEND_RAW_TX::request&& req, rpc_context context);
     START_MINING::response                              invoke(START_MINING::request&& req, rpc_context context);
@@ -214,6 +221,7 @@ namespace cryptonote::rpc {
     SET_LOG_CATEGORIES::response                        invoke(SET_LOG_CATEGORIES::request&& req, rpc_context context);
     GET_TRANSACTION_POOL::response                      invoke(GET_TRANSACTION_POOL::request&& req, rpc_context context);
     GET_TRANSACTION_POOL_HASHES_BIN::response           invoke(GET_TRANSACTION_POOL_HASHES_BIN::request&& req, rpc_context context);
+    GET_TRANSACTION_POOL_CHANGES_BIN::response          invoke(GET_TRANSACTION_POOL_CHANGES_BIN::request&& req, rpc_context context);
     GET_TRANSACTION_POOL_HASHES::response               invoke(GET_TRANSACTION_POOL_HASHES::request&& req, rpc_context context);
     GET_TRANSACTION_POOL_STATS::response                invoke(GET_TRANSACTION_POOL_STATS::request&& req, rpc_context context);
     SET_BOOTSTRAP_DAEMON::response                      invoke(SET_BOOTSTRAP_DAEMON::request&& req, rpc_context context);
@@ -250,6 +258,7 @@ namespace cryptonote::rpc {
     SYNC_INFO::response                                 invoke(SYNC_INFO::request&& req, rpc_context context);
     GET_TRANSACTION_POOL_BACKLOG::response              invoke(GET_TRANSACTION_POOL_BACKLOG::request&& req, rpc_context context);
     PRUNE_BLOCKCHAIN::response                          invoke(PRUNE_BLOCKCHAIN::request&& req, rpc_context context);
+    CREATE_SNAPSHOT::response                           invoke(CREATE_SNAPSHOT::request&& req, rpc_context context);
     GET_OUTPUT_BLACKLIST::response                      invoke(GET_OUTPUT_BLACKLIST::request&& req, rpc_context context);
     GET_QUORUM_STATE::response                          invoke(GET_QUORUM_STATE::request&& req, rpc_context context);
     GET_SERVICE_NODE_REGISTRATION_CMD_RAW::response     invoke(GET_SERVICE_NODE_REGISTRATION_CMD_RAW::request&& req, rpc_context context);
@@ -258,6 +267,7 @@ namespace cryptonote::rpc {
     GET_SERVICE_KEYS::response                          invoke(GET_SERVICE_KEYS::request&& req, rpc_context context);
     GET_SERVICE_PRIVKEYS::response                      invoke(GET_SERVICE_PRIVKEYS::request&& req, rpc_context context);
     GET_SERVICE_NODE_STATUS::response                   invoke(GET_SERVICE_NODE_STATUS::request&& req, rpc_context context);
+    GET_SWARM::response                                 invoke(GET_SWARM::request&& req, rpc_context context);
     GET_SERVICE_NODES::response                         invoke(GET_SERVICE_NODES::request&& req, rpc_context context);
     GET_STAKING_REQUIREMENT::response                   invoke(GET_STAKING_REQUIREMENT::request&& req, rpc_context context);
     STORAGE_SERVER_PING::response                       invoke(STORAGE_SERVER_PING::request&& req, rpc_context context);
@@ -270,7 +280,19 @@ namespace cryptonote::rpc {
     ONS_NAMES_TO_OWNERS::response                       invoke(ONS_NAMES_TO_OWNERS::request&& req, rpc_context context);
     ONS_OWNERS_TO_NAMES::response                       invoke(ONS_OWNERS_TO_NAMES::request&& req, rpc_context context);
     ONS_RESOLVE::response                               invoke(ONS_RESOLVE::request&& req, rpc_context context);
+    ONS_RESOLVE_BATCH::response                         invoke(ONS_RESOLVE_BATCH::request&& req, rpc_context context);
     FLUSH_CACHE::response                               invoke(FLUSH_CACHE::request&& req, rpc_context);
+    LIGHT_WALLET_LOGIN::response                        invoke(LIGHT_WALLET_LOGIN::request&& req, rpc_context context);
+    LIGHT_WALLET_GET_ADDRESS_INFO::response             invoke(LIGHT_WALLET_GET_ADDRESS_INFO::request&& req, rpc_context context);
+    LIGHT_WALLET_GET_ADDRESS_TXS::response              invoke(LIGHT_WALLET_GET_ADDRESS_TXS::request&& req, rpc_context context);
+    LIGHT_WALLET_GET_UNSPENT_OUTS::response             invoke(LIGHT_WALLET_GET_UNSPENT_OUTS::request&& req, rpc_context context);
+    LIGHT_WALLET_IMPORT_WALLET_REQUEST::response        invoke(LIGHT_WALLET_IMPORT_WALLET_REQUEST::request&& req, rpc_context context);
+    LIGHT_WALLET_SUBMIT_RAW_TX::response                invoke(LIGHT_WALLET_SUBMIT_RAW_TX::request&& req, rpc_context context);
+
+    /// Returns the response cached under `key` if it was made at the current chain tip and pool and
+    /// isn't too old, otherwise calls `make` and caches what it returns.  Used by the invoke() of
+    /// CACHEABLE commands, with a key made of the command, the caller's admin status and the request.
+    std::string cached_response(std::string key, const std::function<std::string()>& make);
 
 #if defined(OXEN_ENABLE_INTEGRATION_TEST_HOOKS)
     void on_relay_uptime_and_votes()
@@ -315,16 +337,65 @@ private:
 
     void fill_sn_response_entry(GET_SERVICE_NODES::response::entry& entry, const service_nodes::service_node_pubkey_info &sn_info, uint64_t current_height);
 
+    // The service node list at a block, with every node's GET_SERVICE_NODES entry filled out, which
+    // GET_SERVICE_NODES answers from (rather than filling out the entries for each request).
+    struct sn_snapshot {
+      crypto::hash block_hash;
+      uint64_t height; // of the block
+      std::chrono::steady_clock::time_point created;
+      std::vector<service_nodes::service_node_pubkey_info> infos;
+      std::vector<GET_SERVICE_NODES::response::entry> entries; // entries[i] is that of infos[i]
+      std::unordered_map<crypto::public_key, size_t> index; // pubkey -> index in infos/entries
+    };
+    // Returns the snapshot, remade if the chain has moved on or it is older than SN_SNAPSHOT_MAX_AGE
+    // (for the proof and reachability fields, which change without blocks)
+    std::shared_ptr<const sn_snapshot> get_sn_snapshot();
+    static constexpr std::chrono::seconds SN_SNAPSHOT_MAX_AGE{5};
+    std::mutex m_sn_snapshot_mutex;
+    std::shared_ptr<const sn_snapshot> m_sn_snapshot;
+    // The service node states of the last SN_SNAPSHOT_HISTORY blocks' snapshots, for
+    // changed_since_block_hash.  A node's service_node_info is copied on modification, so a node
+    // changed between two blocks iff its info pointer did.
+    static constexpr size_t SN_SNAPSHOT_HISTORY = 30;
+    std::deque<std::pair<crypto::hash, std::unordered_map<crypto::public_key, std::shared_ptr<const service_nodes::service_node_info>>>> m_sn_snapshot_history;
+
     //utils
     uint64_t get_block_reward(const block& blk);
     std::optional<std::string> get_random_public_node();
     bool set_bootstrap_daemon(const std::string &address, std::string_view username_password);
     bool set_bootstrap_daemon(const std::string &address, std::string_view username, std::string_view password);
     void fill_block_header_response(const block& blk, bool orphan_status, uint64_t height, const crypto::hash& hash, block_header_response& response, bool fill_pow_hash, bool get_tx_hashes);
-    std::unique_lock<std::shared_mutex> should_bootstrap_lock();
+    std::shared_lock<std::shared_mutex> should_bootstrap_lock();
 
     template <typename COMMAND_TYPE>
     bool use_bootstrap_daemon_if_necessary(const typename COMMAND_TYPE::request& req, typename COMMAND_TYPE::response& res);
+
+    // Splits [0, n) into chunks of at least `min_chunk` elements and calls `f(begin, end)` for each
+    // chunk, concurrently on the calling thread plus up to MAX_PARALLEL_READS_PER_CLIENT - 1
+    // threadpool workers, each with its own LMDB read txn.  `f` must only do thread-safe reads
+    // (i.e. via the blockchain db, not under the blockchain lock).  The first exception thrown by
+    // `f`, if any, is rethrown once all chunks have finished.
+    template <typename F>
+    void parallel_read(const rpc_context& context, size_t n, size_t min_chunk, F&& f);
+
+    // Caps the threads a single remote can occupy with parallel_read() across all of its
+    // concurrent requests, so that one client can't tie up the threadpool
+    static constexpr size_t MAX_PARALLEL_READS_PER_CLIENT = 4;
+    std::mutex m_parallel_reads_mutex;
+    std::unordered_map<std::string, size_t> m_parallel_reads; // remote -> extra threads in use
+
+    struct cached_response_entry {
+      crypto::hash tip;
+      uint64_t pool_cookie;
+      std::chrono::steady_clock::time_point created;
+      std::string body;
+    };
+    static constexpr std::chrono::seconds RESPONSE_CACHE_MAX_AGE{5};
+    // Requests are up to the caller, so this is bounded: when full, the cache is cleared
+    static constexpr size_t RESPONSE_CACHE_MAX_ENTRIES = 1000;
+    std::shared_mutex m_response_cache_mutex;
+    std::unordered_map<std::string, cached_response_entry> m_response_cache;
+    size_t m_response_cache_bytes = 0;
     
     core& m_core;
     nodetool::node_server<cryptonote::t_cryptonote_protocol_handler<cryptonote::core> >& m_p2p;
@@ -333,6 +404,10 @@ private:
     std::unique_ptr<bootstrap_daemon> m_bootstrap_daemon;
     std::chrono::system_clock::time_point m_bootstrap_height_check_time;
     bool m_was_bootstrap_ever_used;
+
+    // Registration of m_response_cache with the daemon's cache budget, which empties it (last, so
+    // that it goes before the cache does)
+    tools::cache_budget::handle m_response_cache_budget;
   };
 
 } // namespace cryptonote::rpc
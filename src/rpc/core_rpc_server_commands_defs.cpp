@@ -26,6 +26,7 @@ KV_SERIALIZE_MAP_CODE_BEGIN(GET_BLOCKS_FAST::request)
   KV_SERIALIZE(start_height)
   KV_SERIALIZE(prune)
   KV_SERIALIZE_OPT(no_miner_tx, false)
+  KV_SERIALIZE_OPT(long_poll, false)
 KV_SERIALIZE_MAP_CODE_END()
 
 
@@ -49,6 +50,23 @@ KV_SERIALIZE_MAP_CODE_BEGIN(GET_BLOCKS_FAST::response)
 KV_SERIALIZE_MAP_CODE_END()
 
 
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_BLOCK_DIGESTS::request)
+  KV_SERIALIZE_CONTAINER_POD_AS_BLOB(block_ids)
+  KV_SERIALIZE(start_height)
+  KV_SERIALIZE_OPT(max_count, (uint64_t)0)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_BLOCK_DIGESTS::response)
+  KV_SERIALIZE(blocks)
+  KV_SERIALIZE(digests)
+  KV_SERIALIZE(start_height)
+  KV_SERIALIZE(current_height)
+  KV_SERIALIZE(status)
+  KV_SERIALIZE(untrusted)
+KV_SERIALIZE_MAP_CODE_END()
+
+
 KV_SERIALIZE_MAP_CODE_BEGIN(GET_BLOCKS_BY_HEIGHT::request)
   KV_SERIALIZE(heights)
 KV_SERIALIZE_MAP_CODE_END()
@@ -188,6 +206,19 @@ KV_SERIALIZE_MAP_CODE_BEGIN(IS_KEY_IMAGE_SPENT::response)
 KV_SERIALIZE_MAP_CODE_END()
 
 
+KV_SERIALIZE_MAP_CODE_BEGIN(IS_KEY_IMAGE_SPENT_BIN::request)
+  KV_SERIALIZE_CONTAINER_POD_AS_BLOB(key_images)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(IS_KEY_IMAGE_SPENT_BIN::response)
+  KV_SERIALIZE(spent)
+  KV_SERIALIZE(spent_in_pool)
+  KV_SERIALIZE(status)
+  KV_SERIALIZE(untrusted)
+KV_SERIALIZE_MAP_CODE_END()
+
+
 KV_SERIALIZE_MAP_CODE_BEGIN(GET_TX_GLOBAL_OUTPUTS_INDEXES::request)
   KV_SERIALIZE_VAL_POD_AS_BLOB(txid)
 KV_SERIALIZE_MAP_CODE_END()
@@ -438,6 +469,19 @@ KV_SERIALIZE_MAP_CODE_BEGIN(GET_LAST_BLOCK_HEADER::request)
   KV_SERIALIZE_OPT(get_tx_hashes, false);
 KV_SERIALIZE_MAP_CODE_END()
 
+void GET_LAST_BLOCK_HEADER::request::load_direct_json(epee::serialization::direct_json_reader& in)
+{
+  fill_pow_hash = false;
+  get_tx_hashes = false;
+  while (auto key = in.next_key())
+  {
+    if (in.read_null()) continue;
+    if (*key == "fill_pow_hash") fill_pow_hash = in.read_bool();
+    else if (*key == "get_tx_hashes") get_tx_hashes = in.read_bool();
+    else in.skip();
+  }
+}
+
 
 KV_SERIALIZE_MAP_CODE_BEGIN(GET_LAST_BLOCK_HEADER::response)
   KV_SERIALIZE(block_header)
@@ -453,6 +497,22 @@ KV_SERIALIZE_MAP_CODE_BEGIN(GET_BLOCK_HEADER_BY_HASH::request)
   KV_SERIALIZE_OPT(get_tx_hashes, false);
 KV_SERIALIZE_MAP_CODE_END()
 
+void GET_BLOCK_HEADER_BY_HASH::request::load_direct_json(epee::serialization::direct_json_reader& in)
+{
+  hashes.clear();
+  fill_pow_hash = false;
+  get_tx_hashes = false;
+  while (auto key = in.next_key())
+  {
+    if (in.read_null()) continue;
+    if (*key == "hash") hash = in.read_string();
+    else if (*key == "hashes") in.read_array([&] { hashes.emplace_back(in.read_string()); });
+    else if (*key == "fill_pow_hash") fill_pow_hash = in.read_bool();
+    else if (*key == "get_tx_hashes") get_tx_hashes = in.read_bool();
+    else in.skip();
+  }
+}
+
 
 KV_SERIALIZE_MAP_CODE_BEGIN(GET_BLOCK_HEADER_BY_HASH::response)
   KV_SERIALIZE(block_header)
@@ -469,6 +529,23 @@ KV_SERIALIZE_MAP_CODE_BEGIN(GET_BLOCK_HEADER_BY_HEIGHT::request)
   KV_SERIALIZE_OPT(get_tx_hashes, false);
 KV_SERIALIZE_MAP_CODE_END()
 
+void GET_BLOCK_HEADER_BY_HEIGHT::request::load_direct_json(epee::serialization::direct_json_reader& in)
+{
+  height.reset();
+  heights.clear();
+  fill_pow_hash = false;
+  get_tx_hashes = false;
+  while (auto key = in.next_key())
+  {
+    if (in.read_null()) continue;
+    if (*key == "height") height = in.read_integer<uint64_t>();
+    else if (*key == "heights") in.read_array([&] { heights.push_back(in.read_integer<uint64_t>()); });
+    else if (*key == "fill_pow_hash") fill_pow_hash = in.read_bool();
+    else if (*key == "get_tx_hashes") get_tx_hashes = in.read_bool();
+    else in.skip();
+  }
+}
+
 
 KV_SERIALIZE_MAP_CODE_BEGIN(GET_BLOCK_HEADER_BY_HEIGHT::response)
   KV_SERIALIZE(block_header)
@@ -484,6 +561,19 @@ KV_SERIALIZE_MAP_CODE_BEGIN(GET_BLOCK::request)
   KV_SERIALIZE_OPT(fill_pow_hash, false);
 KV_SERIALIZE_MAP_CODE_END()
 
+void GET_BLOCK::request::load_direct_json(epee::serialization::direct_json_reader& in)
+{
+  fill_pow_hash = false;
+  while (auto key = in.next_key())
+  {
+    if (in.read_null()) continue;
+    if (*key == "hash") hash = in.read_string();
+    else if (*key == "height") height = in.read_integer<uint64_t>();
+    else if (*key == "fill_pow_hash") fill_pow_hash = in.read_bool();
+    else in.skip();
+  }
+}
+
 
 KV_SERIALIZE_MAP_CODE_BEGIN(GET_BLOCK::response)
   KV_SERIALIZE(block_header)
@@ -610,6 +700,24 @@ KV_SERIALIZE_MAP_CODE_BEGIN(GET_TRANSACTION_POOL_HASHES_BIN::response)
 KV_SERIALIZE_MAP_CODE_END()
 
 
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_TRANSACTION_POOL_CHANGES_BIN::request)
+  KV_SERIALIZE_OPT(pool_id, (uint64_t)0)
+  KV_SERIALIZE_OPT(since, (uint64_t)0)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_TRANSACTION_POOL_CHANGES_BIN::response)
+  KV_SERIALIZE(status)
+  KV_SERIALIZE(pool_id)
+  KV_SERIALIZE(seq)
+  KV_SERIALIZE(full)
+  KV_SERIALIZE_CONTAINER_POD_AS_BLOB(tx_hashes)
+  KV_SERIALIZE_CONTAINER_POD_AS_BLOB(blink_hashes)
+  KV_SERIALIZE_CONTAINER_POD_AS_BLOB(removed_hashes)
+  KV_SERIALIZE(untrusted)
+KV_SERIALIZE_MAP_CODE_END()
+
+
 KV_SERIALIZE_MAP_CODE_BEGIN(GET_TRANSACTION_POOL_HASHES::response)
   KV_SERIALIZE(status)
   KV_SERIALIZE(tx_hashes)
@@ -667,6 +775,21 @@ KV_SERIALIZE_MAP_CODE_BEGIN(GET_BLOCK_HEADERS_RANGE::request)
   KV_SERIALIZE_OPT(get_tx_hashes, false);
 KV_SERIALIZE_MAP_CODE_END()
 
+void GET_BLOCK_HEADERS_RANGE::request::load_direct_json(epee::serialization::direct_json_reader& in)
+{
+  fill_pow_hash = false;
+  get_tx_hashes = false;
+  while (auto key = in.next_key())
+  {
+    if (in.read_null()) continue;
+    if (*key == "start_height") start_height = in.read_integer<uint64_t>();
+    else if (*key == "end_height") end_height = in.read_integer<uint64_t>();
+    else if (*key == "fill_pow_hash") fill_pow_hash = in.read_bool();
+    else if (*key == "get_tx_hashes") get_tx_hashes = in.read_bool();
+    else in.skip();
+  }
+}
+
 
 KV_SERIALIZE_MAP_CODE_BEGIN(GET_BLOCK_HEADERS_RANGE::response)
   KV_SERIALIZE(status)
@@ -880,6 +1003,7 @@ KV_SERIALIZE_MAP_CODE_BEGIN(SYNC_INFO::span)
   KV_SERIALIZE(speed)
   KV_SERIALIZE(size)
   KV_SERIALIZE(remote_address)
+  KV_SERIALIZE_OPT(spilled, false)
 KV_SERIALIZE_MAP_CODE_END()
 
 
@@ -901,6 +1025,7 @@ KV_SERIALIZE_MAP_CODE_BEGIN(GET_OUTPUT_DISTRIBUTION::request)
   KV_SERIALIZE_OPT(cumulative, false)
   KV_SERIALIZE_OPT(binary, true)
   KV_SERIALIZE_OPT(compress, false)
+  KV_SERIALIZE(known_hash)
 KV_SERIALIZE_MAP_CODE_END()
 
 
@@ -967,6 +1092,7 @@ KV_SERIALIZE_MAP_CODE_END()
 KV_SERIALIZE_MAP_CODE_BEGIN(GET_OUTPUT_DISTRIBUTION::response)
   KV_SERIALIZE(status)
   KV_SERIALIZE(distributions)
+  KV_SERIALIZE(top_hash)
   KV_SERIALIZE(untrusted)
 KV_SERIALIZE_MAP_CODE_END()
 
@@ -984,6 +1110,7 @@ KV_SERIALIZE_MAP_CODE_END()
 
 KV_SERIALIZE_MAP_CODE_BEGIN(PRUNE_BLOCKCHAIN::request)
   KV_SERIALIZE_OPT(check, false)
+  KV_SERIALIZE_OPT(background, false)
 KV_SERIALIZE_MAP_CODE_END()
 
 
@@ -994,6 +1121,28 @@ KV_SERIALIZE_MAP_CODE_BEGIN(PRUNE_BLOCKCHAIN::response)
 KV_SERIALIZE_MAP_CODE_END()
 
 
+KV_SERIALIZE_MAP_CODE_BEGIN(CREATE_SNAPSHOT::request)
+  KV_SERIALIZE(dir)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(CREATE_SNAPSHOT::chunk)
+  KV_SERIALIZE(file)
+  KV_SERIALIZE(offset)
+  KV_SERIALIZE(size)
+  KV_SERIALIZE(hash)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(CREATE_SNAPSHOT::response)
+  KV_SERIALIZE(status)
+  KV_SERIALIZE(dir)
+  KV_SERIALIZE(height)
+  KV_SERIALIZE(top_hash)
+  KV_SERIALIZE(chunks)
+KV_SERIALIZE_MAP_CODE_END()
+
+
 KV_SERIALIZE_MAP_CODE_BEGIN(GET_QUORUM_STATE::request)
   KV_SERIALIZE_OPT(start_height, HEIGHT_SENTINEL_VALUE)
   KV_SERIALIZE_OPT(end_height, HEIGHT_SENTINEL_VALUE)
@@ -1139,6 +1288,7 @@ KV_SERIALIZE_MAP_CODE_BEGIN(GET_SERVICE_NODES::request)
   KV_SERIALIZE(active_only)
   KV_SERIALIZE(fields)
   KV_SERIALIZE(poll_block_hash)
+  KV_SERIALIZE(changed_since_block_hash)
 KV_SERIALIZE_MAP_CODE_END()
 
 
@@ -1201,6 +1351,22 @@ KV_SERIALIZE_MAP_CODE_BEGIN(GET_SERVICE_NODES::response)
   if (fields.snode_revision || fields.all) KV_SERIALIZE(snode_revision)
   if (!as_json.empty()) KV_SERIALIZE(as_json)
   if (polling_mode) KV_SERIALIZE(unchanged);
+  if (delta) {
+    KV_SERIALIZE(delta)
+    KV_SERIALIZE(removed)
+  }
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_SWARM::request)
+  KV_SERIALIZE(pubkey)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(GET_SWARM::response)
+  KV_SERIALIZE(swarm_id)
+  KV_SERIALIZE(service_node_pubkeys)
+  KV_SERIALIZE(status)
 KV_SERIALIZE_MAP_CODE_END()
 
 
@@ -1384,6 +1550,29 @@ KV_SERIALIZE_MAP_CODE_BEGIN(ONS_RESOLVE::response)
 KV_SERIALIZE_MAP_CODE_END()
 
 
+KV_SERIALIZE_MAP_CODE_BEGIN(ONS_RESOLVE_BATCH::request_entry)
+  KV_SERIALIZE(name_hash)
+  KV_SERIALIZE_OPT(type, static_cast<uint16_t>(-1))
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(ONS_RESOLVE_BATCH::request)
+  KV_SERIALIZE(entries)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(ONS_RESOLVE_BATCH::response_entry)
+  KV_SERIALIZE(encrypted_value)
+  KV_SERIALIZE(nonce)
+KV_SERIALIZE_MAP_CODE_END()
+
+
+KV_SERIALIZE_MAP_CODE_BEGIN(ONS_RESOLVE_BATCH::response)
+  KV_SERIALIZE(entries)
+  KV_SERIALIZE(status)
+KV_SERIALIZE_MAP_CODE_END()
+
+
 KV_SERIALIZE_MAP_CODE_BEGIN(FLUSH_CACHE::request)
   KV_SERIALIZE_OPT(bad_txs, false)
   KV_SERIALIZE_OPT(bad_blocks, false)
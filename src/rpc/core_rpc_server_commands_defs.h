@@ -33,6 +33,7 @@
 
 #include "crypto/crypto.h"
 #include "epee/string_tools.h"
+#include "epee/storages/portable_storage_direct_json.h"
 
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "cryptonote_basic/cryptonote_basic.h"
@@ -50,6 +51,7 @@
 #include "cryptonote_core/service_node_quorum_cop.h"
 #include "cryptonote_core/service_node_list.h"
 #include "common/oxen.h"
+#include "wallet/wallet_light_rpc.h"
 
 namespace cryptonote {
 
@@ -66,7 +68,7 @@ namespace rpc {
 // has its own version, and that clients can just test major to see
 // whether they can talk to a given daemon without having to know in
 // advance which version they will stop working with
-  constexpr version_t VERSION = {4, 0};
+  constexpr version_t VERSION = {4, 1};
 
   /// Makes a version array from a packed 32-bit integer version
   constexpr version_t make_version(uint32_t version)
@@ -121,6 +123,12 @@ namespace rpc {
   /// if specified).
   struct LEGACY : RPC_COMMAND {};
 
+  /// Specifies that the command's response depends only on the request, the chain tip and the tx
+  /// pool (and on whether the caller is an admin), so that the serialized response can be reused
+  /// for identical requests until one of those changes (or the entry gets a few seconds old, for
+  /// the odd field such as a connection count that changes without either).
+  struct CACHEABLE : RPC_COMMAND {};
+
 
   /// (Not a tag). Generic, serializable, no-argument request type, use as `struct request : EMPTY {};`
   struct EMPTY { KV_MAP_SERIALIZABLE };
@@ -160,6 +168,7 @@ namespace rpc {
     static constexpr auto names() { return NAMES("get_blocks.bin", "getblocks.bin"); }
 
     static constexpr size_t MAX_COUNT = 1000;
+    static constexpr std::chrono::seconds long_poll_timeout{15};
 
     struct request
     {
@@ -167,6 +176,7 @@ namespace rpc {
       uint64_t    start_height;          // The starting block's height.
       bool        prune;                 // Prunes the blockchain, drops off 7/8 off the block iirc.
       bool        no_miner_tx;           // Optional (false by default).
+      bool        long_poll;             // Optional: If true, and the first of `block_ids` is the current top block, this call blocks until a new block is added (or until the timeout) before answering.  Ignored when using LMQ RPC.
 
       KV_MAP_SERIALIZABLE
     };
@@ -198,6 +208,38 @@ namespace rpc {
     };
   };
 
+  OXEN_RPC_DOC_INTROSPECT
+  // Get the blocks following the given chain, as GET_BLOCKS_FAST does, but with a digest of their
+  // txs (their tx public keys, output keys and key images) instead of the txs themselves, for a
+  // wallet to fetch only those of the txs that concern it.  Binary request.
+  struct GET_BLOCK_DIGESTS : PUBLIC, BINARY
+  {
+    static constexpr auto names() { return NAMES("get_block_digests.bin"); }
+
+    static constexpr size_t MAX_COUNT = 1000;
+
+    struct request
+    {
+      std::list<crypto::hash> block_ids; // As for GET_BLOCKS_FAST
+      uint64_t    start_height;          // The starting block's height.
+      uint64_t    max_count;             // Optional: the most blocks to return (capped at MAX_COUNT, which is also what 0 means).  Lets wallets syncing on low-power devices take smaller steps.
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct response
+    {
+      std::vector<std::string> blocks;  // Block blobs, which include the miner tx and the tx hashes
+      std::vector<std::string> digests; // The packed cryptonote::block_digest::digest of each block
+      uint64_t    start_height;         // The starting block's height.
+      uint64_t    current_height;       // The current block height.
+      std::string status;               // General RPC error code. "OK" means everything looks good.
+      bool untrusted;                   // States if the result is obtained using the bootstrap mode, and is therefore not trusted (`true`), or when the daemon is fully synced (`false`).
+
+      KV_MAP_SERIALIZABLE
+    };
+  };
+
   OXEN_RPC_DOC_INTROSPECT
   // Get blocks by height. Binary request.
   struct GET_BLOCKS_BY_HEIGHT : PUBLIC, BINARY
@@ -412,6 +454,32 @@ namespace rpc {
     };
   };
 
+  OXEN_RPC_DOC_INTROSPECT
+  // Check if outputs have been spent, as IS_KEY_IMAGE_SPENT, for many key images at a time: the key
+  // images go as packed 32-byte values and the statuses come back as bitmaps, with bit `i % 8` of
+  // byte `i / 8` for the i-th key image.  Binary request.
+  struct IS_KEY_IMAGE_SPENT_BIN : PUBLIC, BINARY
+  {
+    static constexpr auto names() { return NAMES("is_key_image_spent.bin"); }
+
+    struct request
+    {
+      std::vector<crypto::key_image> key_images; // Key images to check.
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct response
+    {
+      std::string spent;         // Bitmap of the key images spent in the blockchain.
+      std::string spent_in_pool; // Bitmap of the key images spent by a transaction in the pool (whether or not also spent in the blockchain).
+      std::string status;        // General RPC error code. "OK" means everything looks good.
+      bool untrusted;            // States if the result is obtained using the bootstrap mode, and is therefore not trusted (`true`), or when the daemon is fully synced (`false`).
+
+      KV_MAP_SERIALIZABLE
+    };
+  };
+
 
   OXEN_RPC_DOC_INTROSPECT
   // Get global outputs of transactions. Binary request.
@@ -607,7 +675,7 @@ namespace rpc {
   // Retrieve general information about the state of your node and the network.
   // Note that all of the std::optional<> fields here are not included if the request is a public
   // (restricted) RPC request.
-  struct GET_INFO : PUBLIC, LEGACY
+  struct GET_INFO : PUBLIC, LEGACY, CACHEABLE
   {
     static constexpr auto names() { return NAMES("get_info", "getinfo"); }
 
@@ -830,7 +898,7 @@ namespace rpc {
 
   OXEN_RPC_DOC_INTROSPECT
   // Block header information for the most recent block is easily retrieved with this method. No inputs are needed.
-  struct GET_LAST_BLOCK_HEADER : PUBLIC
+  struct GET_LAST_BLOCK_HEADER : PUBLIC, CACHEABLE
   {
     static constexpr auto names() { return NAMES("get_last_block_header", "getlastblockheader"); }
 
@@ -840,6 +908,7 @@ namespace rpc {
       bool get_tx_hashes; // If true (default false) then include the hashes of non-coinbase transactions
 
       KV_MAP_SERIALIZABLE
+      KV_MAP_DIRECT_JSON
     };
 
     struct response
@@ -866,6 +935,7 @@ namespace rpc {
       bool get_tx_hashes; // If true (default false) then include the hashes of non-coinbase transactions
 
       KV_MAP_SERIALIZABLE
+      KV_MAP_DIRECT_JSON
     };
 
     struct response
@@ -893,6 +963,7 @@ namespace rpc {
       bool get_tx_hashes; // If true (default false) then include the hashes of non-coinbase transactions
 
       KV_MAP_SERIALIZABLE
+      KV_MAP_DIRECT_JSON
     };
 
     struct response
@@ -920,6 +991,7 @@ namespace rpc {
       bool fill_pow_hash; // Tell the daemon if it should fill out pow_hash field.
 
       KV_MAP_SERIALIZABLE
+      KV_MAP_DIRECT_JSON
     };
 
     struct response
@@ -1173,6 +1245,37 @@ namespace rpc {
     };
   };
 
+  OXEN_RPC_DOC_INTROSPECT
+  // Get the changes to the transaction pool since an earlier call, for a client that keeps a copy
+  // of the pool's tx hashes (as the wallet does) to update it without getting all the hashes each
+  // time.  Binary request.
+  struct GET_TRANSACTION_POOL_CHANGES_BIN : PUBLIC, BINARY
+  {
+    static constexpr auto names() { return NAMES("get_transaction_pool_changes.bin"); }
+
+    struct request
+    {
+      uint64_t pool_id; // The `pool_id` of the last response, or 0 to get the whole pool.
+      uint64_t since;   // The `seq` of the last response.
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct response
+    {
+      std::string status;                // General RPC error code. "OK" means everything looks good.
+      uint64_t pool_id;                  // Identifies the daemon's pool (for this run of the daemon): to pass to the next request.
+      uint64_t seq;                      // To pass as `since` to the next request.
+      bool full;                         // If true, `tx_hashes` and `blink_hashes` are the whole pool (the request's pool_id or since was unknown, or too old), and what the client had should be dropped.
+      std::vector<crypto::hash> tx_hashes;      // Transactions added to the pool since (or changed), other than approved blinks.
+      std::vector<crypto::hash> blink_hashes;   // Approved blink transactions added since (or approved since).
+      std::vector<crypto::hash> removed_hashes; // Transactions no longer in the pool.
+      bool untrusted;                    // States if the result is obtained using the bootstrap mode, and is therefore not trusted (`true`), or when the daemon is fully synced (`false`).
+
+      KV_MAP_SERIALIZABLE
+    };
+  };
+
   OXEN_RPC_DOC_INTROSPECT
   // Get hashes from transaction pool.
   struct GET_TRANSACTION_POOL_HASHES : PUBLIC, LEGACY
@@ -1298,6 +1401,7 @@ namespace rpc {
       bool get_tx_hashes;    // If true (default false) then include the hashes or txes in the block details
 
       KV_MAP_SERIALIZABLE
+      KV_MAP_DIRECT_JSON
     };
 
     struct response
@@ -1423,7 +1527,7 @@ namespace rpc {
 
   OXEN_RPC_DOC_INTROSPECT
   // Look up information regarding hard fork voting and readiness.
-  struct HARD_FORK_INFO : PUBLIC
+  struct HARD_FORK_INFO : PUBLIC, CACHEABLE
   {
     static constexpr auto names() { return NAMES("hard_fork_info"); }
 
@@ -1626,7 +1730,7 @@ namespace rpc {
 
   OXEN_RPC_DOC_INTROSPECT
   // Gives an estimation of per-output + per-byte fees
-  struct GET_BASE_FEE_ESTIMATE : PUBLIC
+  struct GET_BASE_FEE_ESTIMATE : PUBLIC, CACHEABLE
   {
     static constexpr auto names() { return NAMES("get_fee_estimate"); }
 
@@ -1721,6 +1825,7 @@ namespace rpc {
       uint32_t speed;              // Connection speed.
       uint64_t size;               // Total number of bytes in that span's blocks (including txes).
       std::string remote_address;  // Peer address the node is downloading (or has downloaded) than span from.
+      bool spilled;                // True if the span's blocks are waiting in the block download spill file rather than in memory.
 
       KV_MAP_SERIALIZABLE
     };
@@ -1760,6 +1865,7 @@ namespace rpc {
       bool cumulative;               // (optional, default is false) States if the result should be cumulative (true) or not (false).
       bool binary;
       bool compress;
+      std::string known_hash;        // (optional) Hash of the block at from_height - 1, for a client that already has the distribution up to there and only wants what follows.  If that block is no longer in the chain, from_height is ignored and the whole distribution is returned (i.e. with start_height 0).
 
       KV_MAP_SERIALIZABLE
     };
@@ -1779,6 +1885,7 @@ namespace rpc {
     {
       std::string status;                      // General RPC error code. "OK" means everything looks good.
       std::vector<distribution> distributions; //
+      std::string top_hash;                    // Hash of the block at the last height of the distributions; pass it as known_hash to later fetch only newer blocks.
       bool untrusted;                          // States if the result is obtained using the bootstrap mode, and is therefore not trusted (`true`), or when the daemon is fully synced (`false`).
 
       KV_MAP_SERIALIZABLE
@@ -1824,6 +1931,7 @@ namespace rpc {
     struct request
     {
       bool check;
+      bool background; // Prune a batch at a time while the daemon is idle, rather than all at once
 
       KV_MAP_SERIALIZABLE
     };
@@ -1839,6 +1947,44 @@ namespace rpc {
   };
 
 
+  OXEN_RPC_DOC_INTROSPECT
+  // Writes a snapshot of the blockchain (including the service node list) and ONS databases to a
+  // directory on the daemon's host, along with a manifest of hashes of each piece of them.  A new
+  // node can be started from a copy of the directory with --restore-snapshot.  Blocks keep being
+  // processed while the snapshot is written.
+  struct CREATE_SNAPSHOT : RPC_COMMAND
+  {
+    static constexpr auto names() { return NAMES("create_snapshot"); }
+
+    struct request
+    {
+      std::string dir; // Directory to write the snapshot to; must not already hold one.  Defaults to "snapshot" in the data directory.
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct chunk
+    {
+      std::string file;    // File, relative to the snapshot directory.
+      uint64_t offset;     // Offset of the chunk in the file.
+      uint64_t size;       // Size of the chunk.
+      std::string hash;    // cn_fast_hash of the chunk.
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct response
+    {
+      std::string status;        // General RPC error code. "OK" means everything looks good.
+      std::string dir;           // Directory the snapshot was written to.
+      uint64_t height;           // Number of blocks in the snapshot.
+      std::string top_hash;      // Hash of the snapshot's top block.
+      std::vector<chunk> chunks; // The chunks of the snapshot's files, as listed in its manifest.
+
+      KV_MAP_SERIALIZABLE
+    };
+  };
+
   OXEN_RPC_DOC_INTROSPECT
   // Accesses the list of public keys of the nodes who are participating or being tested in a quorum.
   struct GET_QUORUM_STATE : PUBLIC
@@ -2009,7 +2155,7 @@ namespace rpc {
 
   OXEN_RPC_DOC_INTROSPECT
   // Get information on some, all, or a random subset of Service Nodes.
-  struct GET_SERVICE_NODES : PUBLIC
+  struct GET_SERVICE_NODES : PUBLIC, CACHEABLE
   {
     static constexpr auto names() { return NAMES("get_service_nodes", "get_n_service_nodes", "get_all_service_nodes"); }
 
@@ -2078,6 +2224,7 @@ namespace rpc {
       std::optional<requested_fields_t> fields;      // If omitted return all fields; otherwise return only the specified fields
 
       std::string poll_block_hash;                   // If specified this changes the behaviour to only return service node records if the block hash is *not* equal to the given hash; otherwise it omits the records and instead sets `"unchanged": true` in the response. This is primarily used to poll for new results where the requested results only change with new blocks.
+      std::string changed_since_block_hash;          // If specified, and one of the last few blocks, only return the service nodes whose registration, contributions or state changed since that block, and list those that have since left the list in `removed` (`delta` is set in the response).  Otherwise every requested service node is returned, as without it.  Proof and reachability fields don't count as changes, though returned nodes have them up to date.
 
       KV_MAP_SERIALIZABLE
     };
@@ -2143,6 +2290,8 @@ namespace rpc {
       uint64_t    target_height;              // Blockchain's target height.
       std::string block_hash;                 // Current block's hash.
       bool        unchanged;                  // Will be true (and `service_node_states` omitted) if you gave the current block hash to poll_block_hash
+      bool        delta;                      // Will be true (and `removed` given) if `service_node_states` only has the service nodes changed since changed_since_block_hash
+      std::vector<std::string> removed;       // With `delta`: the public keys of service nodes that are no longer registered
       uint8_t     hardfork;                   // Current hardfork version.
       uint8_t     snode_revision;             // snode revision for non-hardfork but mandatory snode updates
       std::string status;                     // Generic RPC error code. "OK" is the success value.
@@ -2153,6 +2302,30 @@ namespace rpc {
     };
   };
 
+  OXEN_RPC_DOC_INTROSPECT
+  // Get the swarm that storage servers store a user's messages in: the one with the swarm id
+  // closest to the user's pubkey, mapped into swarm id space.
+  struct GET_SWARM : PUBLIC
+  {
+    static constexpr auto names() { return NAMES("get_swarm"); }
+
+    struct request
+    {
+      std::string pubkey; // The user's pubkey, in hex: 32 bytes, or 33 with a network prefix byte (as in Session ids), which is ignored.
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct response
+    {
+      uint64_t swarm_id;                             // The swarm's id.
+      std::vector<std::string> service_node_pubkeys; // The (active) service nodes in the swarm.
+      std::string status;                            // Generic RPC error code. "OK" is the success value.
+
+      KV_MAP_SERIALIZABLE
+    };
+  };
+
   OXEN_RPC_DOC_INTROSPECT
   // Get information on the queried daemon's Service Node state.
   struct GET_SERVICE_NODE_STATUS : RPC_COMMAND
@@ -2212,7 +2385,7 @@ namespace rpc {
   // Get the required amount of Loki to become a Service Node at the queried height.
   // For devnet and testnet values, ensure the daemon is started with the
   // `--devnet` or `--testnet` flags respectively.
-  struct GET_STAKING_REQUIREMENT : PUBLIC
+  struct GET_STAKING_REQUIREMENT : PUBLIC, CACHEABLE
   {
     static constexpr auto names() { return NAMES("get_staking_requirement"); }
 
@@ -2555,6 +2728,46 @@ namespace rpc {
     };
   };
 
+  OXEN_RPC_DOC_INTROSPECT
+  // Performs ONS_RESOLVE lookups of many names at once.  The values are returned in the order of
+  // the request's entries, and are decrypted as described in ONS_RESOLVE.
+  struct ONS_RESOLVE_BATCH : PUBLIC
+  {
+    static constexpr auto names() { return NAMES("ons_resolve_batch"); }
+
+    static constexpr size_t MAX_REQUEST_ENTRIES = 256;
+    struct request_entry
+    {
+      uint16_t type;         // The ONS type (mandatory); as for ONS_RESOLVE.
+      std::string name_hash; // The hash of the name to look up, encoded as for ONS_RESOLVE.
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct request
+    {
+      std::vector<request_entry> entries; // The names to look up
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct response_entry
+    {
+      std::optional<std::string> encrypted_value; // The encrypted ONS value, in hex.  Omitted if the name_hash is not registered.
+      std::optional<std::string> nonce; // The nonce value used for encryption, in hex.
+
+      KV_MAP_SERIALIZABLE
+    };
+
+    struct response
+    {
+      std::vector<response_entry> entries; // One for each of the request's entries, in the same order
+      std::string status; // Generic RPC error code. "OK" is the success value.
+
+      KV_MAP_SERIALIZABLE
+    };
+  };
+
   OXEN_RPC_DOC_INTROSPECT
   // Clear TXs from the daemon cache, currently only the cache storing TX hashes that were previously verified bad by the daemon.
   struct FLUSH_CACHE : RPC_COMMAND
@@ -2570,6 +2783,64 @@ namespace rpc {
     struct response : STATUS { };
   };
 
+  /// Light wallet (MyMonero-style) API, served by the daemon's light wallet scanner when it is
+  /// enabled with --light-wallet-scanner.  The request and response types are those of
+  /// wallet/wallet_light_rpc.h, which the light wallet client side (wallet2) uses.
+
+  OXEN_RPC_DOC_INTROSPECT
+  // Logs in to (optionally registering) the light wallet account of an address and its view key.
+  struct LIGHT_WALLET_LOGIN : PUBLIC, LEGACY
+  {
+    static constexpr auto names() { return NAMES("login"); }
+    using request = tools::light_rpc::LOGIN::request;
+    using response = tools::light_rpc::LOGIN::response;
+  };
+
+  OXEN_RPC_DOC_INTROSPECT
+  // Returns the totals and candidate spends found so far for a light wallet account.
+  struct LIGHT_WALLET_GET_ADDRESS_INFO : PUBLIC, LEGACY
+  {
+    static constexpr auto names() { return NAMES("get_address_info"); }
+    using request = tools::light_rpc::GET_ADDRESS_INFO::request;
+    using response = tools::light_rpc::GET_ADDRESS_INFO::response;
+  };
+
+  OXEN_RPC_DOC_INTROSPECT
+  // Returns the txs found so far for a light wallet account.
+  struct LIGHT_WALLET_GET_ADDRESS_TXS : PUBLIC, LEGACY
+  {
+    static constexpr auto names() { return NAMES("get_address_txs"); }
+    using request = tools::light_rpc::GET_ADDRESS_TXS::request;
+    using response = tools::light_rpc::GET_ADDRESS_TXS::response;
+  };
+
+  OXEN_RPC_DOC_INTROSPECT
+  // Returns the outputs found so far for a light wallet account, with the key images that might spend them.
+  struct LIGHT_WALLET_GET_UNSPENT_OUTS : PUBLIC, LEGACY
+  {
+    static constexpr auto names() { return NAMES("get_unspent_outs"); }
+    using request = tools::light_rpc::GET_UNSPENT_OUTS::request;
+    using response = tools::light_rpc::GET_UNSPENT_OUTS::response;
+  };
+
+  OXEN_RPC_DOC_INTROSPECT
+  // Rescans a light wallet account from the genesis block (at no charge).
+  struct LIGHT_WALLET_IMPORT_WALLET_REQUEST : PUBLIC, LEGACY
+  {
+    static constexpr auto names() { return NAMES("import_wallet_request"); }
+    using request = tools::light_rpc::IMPORT_WALLET_REQUEST::request;
+    using response = tools::light_rpc::IMPORT_WALLET_REQUEST::response;
+  };
+
+  OXEN_RPC_DOC_INTROSPECT
+  // Submits a tx made by a light wallet, as send_raw_transaction does.
+  struct LIGHT_WALLET_SUBMIT_RAW_TX : PUBLIC, LEGACY
+  {
+    static constexpr auto names() { return NAMES("submit_raw_tx"); }
+    using request = tools::light_rpc::SUBMIT_RAW_TX::request;
+    using response = tools::light_rpc::SUBMIT_RAW_TX::response;
+  };
+
   /// List of all supported rpc command structs to allow compile-time enumeration of all supported
   /// RPC types.  Every type added above that has an RPC endpoint needs to be added here, and needs
   /// a core_rpc_server::invoke() overload that takes a <TYPE>::request and returns a
@@ -2578,11 +2849,13 @@ namespace rpc {
   using core_rpc_types = tools::type_list<
     GET_HEIGHT,
     GET_BLOCKS_FAST,
+    GET_BLOCK_DIGESTS,
     GET_BLOCKS_BY_HEIGHT,
     GET_ALT_BLOCKS_HASHES,
     GET_HASHES_FAST,
     GET_TRANSACTIONS,
     IS_KEY_IMAGE_SPENT,
+    IS_KEY_IMAGE_SPENT_BIN,
     GET_TX_GLOBAL_OUTPUTS_INDEXES,
     GET_OUTPUTS_BIN,
     GET_OUTPUTS,
@@ -2609,6 +2882,7 @@ namespace rpc {
     SET_LOG_CATEGORIES,
     GET_TRANSACTION_POOL,
     GET_TRANSACTION_POOL_HASHES_BIN,
+    GET_TRANSACTION_POOL_CHANGES_BIN,
     GET_TRANSACTION_POOL_HASHES,
     GET_TRANSACTION_POOL_BACKLOG,
     GET_TRANSACTION_POOL_STATS,
@@ -2636,6 +2910,7 @@ namespace rpc {
     GET_OUTPUT_DISTRIBUTION_BIN,
     POP_BLOCKS,
     PRUNE_BLOCKCHAIN,
+    CREATE_SNAPSHOT,
     GET_QUORUM_STATE,
     GET_SERVICE_NODE_REGISTRATION_CMD_RAW,
     GET_SERVICE_NODE_REGISTRATION_CMD,
@@ -2643,6 +2918,7 @@ namespace rpc {
     GET_SERVICE_PRIVKEYS,
     GET_SERVICE_NODES,
     GET_SERVICE_NODE_STATUS,
+    GET_SWARM,
     STORAGE_SERVER_PING,
     LOKINET_PING,
     GET_STAKING_REQUIREMENT,
@@ -2656,7 +2932,14 @@ namespace rpc {
     ONS_NAMES_TO_OWNERS,
     ONS_OWNERS_TO_NAMES,
     ONS_RESOLVE,
-    FLUSH_CACHE
+    ONS_RESOLVE_BATCH,
+    FLUSH_CACHE,
+    LIGHT_WALLET_LOGIN,
+    LIGHT_WALLET_GET_ADDRESS_INFO,
+    LIGHT_WALLET_GET_ADDRESS_TXS,
+    LIGHT_WALLET_GET_UNSPENT_OUTS,
+    LIGHT_WALLET_IMPORT_WALLET_REQUEST,
+    LIGHT_WALLET_SUBMIT_RAW_TX
   >;
 
 } } // namespace cryptonote::rpc
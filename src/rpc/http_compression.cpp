@@ -0,0 +1,276 @@
+#include "http_compression.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#ifdef ENABLE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace cryptonote::rpc {
+
+  using namespace std::literals;
+
+  namespace {
+    constexpr size_t COMPRESSED_PIECE_SIZE = 256 * 1024;
+    // Lower than either library's default: these are compressed per response, on an RPC worker
+    constexpr int GZIP_LEVEL = 4;
+    constexpr int ZSTD_LEVEL = 3;
+
+    std::string_view trim(std::string_view s) {
+      while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+      while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+      return s;
+    }
+
+    bool iequals(std::string_view a, std::string_view b) {
+      return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+          [](char x, char y) { return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y)); });
+    }
+
+    // Parses the q value out of the parameters following a coding, e.g. ";q=0.5"; 1 if absent
+    double parse_q(std::string_view params) {
+      while (!params.empty()) {
+        auto semi = params.find(';', 1);
+        auto param = trim(params.substr(1, semi == std::string_view::npos ? std::string_view::npos : semi - 1));
+        if (param.size() >= 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+          double q = 0;
+          double scale = 1;
+          bool fraction = false;
+          for (char c : param.substr(2)) {
+            if (c == '.' && !fraction) fraction = true;
+            else if (c >= '0' && c <= '9') {
+              if (fraction) q += (c - '0') * (scale /= 10);
+              else q = q * 10 + (c - '0');
+            }
+            else break;
+          }
+          return q;
+        }
+        if (semi == std::string_view::npos) break;
+        params.remove_prefix(semi);
+      }
+      return 1;
+    }
+
+    // Collects the compressor output into pieces of up to COMPRESSED_PIECE_SIZE
+    struct piece_output {
+      std::vector<std::string> pieces;
+      std::string current;
+      size_t used = 0;
+
+      // Space to write the next output into
+      std::pair<char*, size_t> space() {
+        if (current.empty() || used == current.size()) {
+          if (!current.empty()) pieces.push_back(std::move(current));
+          current.assign(COMPRESSED_PIECE_SIZE, '\0');
+          used = 0;
+        }
+        return {current.data() + used, current.size() - used};
+      }
+
+      std::vector<std::string> finish() {
+        current.resize(used);
+        if (!current.empty()) pieces.push_back(std::move(current));
+        return std::move(pieces);
+      }
+    };
+
+#ifdef ENABLE_ZLIB
+    std::vector<std::string> gzip_compress(std::vector<std::string>& pieces) {
+      z_stream zs{};
+      // windowBits 15 + 16 selects the gzip wrapper rather than raw zlib
+      if (deflateInit2(&zs, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        throw std::runtime_error{"Failed to initialize gzip compression"};
+      std::unique_ptr<z_stream, int(*)(z_stream*)> end{&zs, deflateEnd};
+
+      piece_output out;
+      auto run = [&](int flush) {
+        int ret;
+        do {
+          auto [buf, avail] = out.space();
+          zs.next_out = reinterpret_cast<Bytef*>(buf);
+          zs.avail_out = static_cast<uInt>(avail);
+          ret = deflate(&zs, flush);
+          if (ret == Z_STREAM_ERROR)
+            throw std::runtime_error{"gzip compression failed"};
+          out.used += avail - zs.avail_out;
+        } while (zs.avail_in > 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+      };
+      for (auto& piece : pieces) {
+        zs.next_in = reinterpret_cast<Bytef*>(piece.data());
+        zs.avail_in = static_cast<uInt>(piece.size());
+        if (zs.avail_in > 0)
+          run(Z_NO_FLUSH);
+        std::string{}.swap(piece);
+      }
+      run(Z_FINISH);
+      return out.finish();
+    }
+#endif
+
+#ifdef ENABLE_ZSTD
+    std::vector<std::string> zstd_compress(std::vector<std::string>& pieces) {
+      thread_local std::unique_ptr<ZSTD_CCtx, size_t(*)(ZSTD_CCtx*)> cctx{ZSTD_createCCtx(), ZSTD_freeCCtx};
+      if (!cctx)
+        throw std::runtime_error{"Failed to create zstd compression context"};
+      size_t total = 0;
+      for (const auto& piece : pieces)
+        total += piece.size();
+      ZSTD_CCtx_reset(cctx.get(), ZSTD_reset_session_only);
+      ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_compressionLevel, ZSTD_LEVEL);
+      ZSTD_CCtx_setPledgedSrcSize(cctx.get(), total);
+
+      piece_output out;
+      auto run = [&](ZSTD_inBuffer& in, ZSTD_EndDirective mode) {
+        size_t remaining;
+        do {
+          auto [buf, avail] = out.space();
+          ZSTD_outBuffer o{buf, avail, 0};
+          remaining = ZSTD_compressStream2(cctx.get(), &o, &in, mode);
+          if (ZSTD_isError(remaining))
+            throw std::runtime_error{"zstd compression failed: "s + ZSTD_getErrorName(remaining)};
+          out.used += o.pos;
+        } while (in.pos < in.size || (mode == ZSTD_e_end && remaining != 0));
+      };
+      for (auto& piece : pieces) {
+        ZSTD_inBuffer in{piece.data(), piece.size(), 0};
+        if (in.size > 0)
+          run(in, ZSTD_e_continue);
+        std::string{}.swap(piece);
+      }
+      ZSTD_inBuffer end{nullptr, 0, 0};
+      run(end, ZSTD_e_end);
+      return out.finish();
+    }
+#endif
+
+    // Hashes the size and the first and last kB of the body made of `pieces`: enough to tell apart
+    // the bodies that aren't the same response, without reading through all of a large one (the
+    // cache compares the full body to confirm a match anyway).
+    template <typename Pieces>
+    uint64_t body_hash(content_encoding enc, const Pieces& pieces) {
+      constexpr size_t EDGE = 1024;
+      size_t total = 0;
+      for (std::string_view piece : pieces)
+        total += piece.size();
+      const size_t tail_start = total > EDGE ? total - EDGE : total;
+      std::string edges;
+      size_t pos = 0;
+      for (std::string_view piece : pieces) {
+        if (pos < EDGE)
+          edges.append(piece.substr(0, EDGE - pos));
+        if (pos + piece.size() > tail_start)
+          edges.append(piece.substr(tail_start > pos ? tail_start - pos : 0));
+        pos += piece.size();
+      }
+      return std::hash<std::string>{}(edges) ^ (total * 0x9E3779B97F4A7C15ULL) ^ static_cast<uint64_t>(enc);
+    }
+  }
+
+  content_encoding negotiate_encoding(std::string_view accept_encoding) {
+    constexpr double unset = -1;
+    [[maybe_unused]] double q_gzip = unset, q_zstd = unset, q_any = unset;
+    while (!accept_encoding.empty()) {
+      auto comma = accept_encoding.find(',');
+      auto item = accept_encoding.substr(0, comma);
+      accept_encoding.remove_prefix(comma == std::string_view::npos ? accept_encoding.size() : comma + 1);
+
+      auto semi = item.find(';');
+      auto coding = trim(item.substr(0, semi));
+      double q = semi == std::string_view::npos ? 1 : parse_q(item.substr(semi));
+      if (iequals(coding, "zstd")) q_zstd = q;
+      else if (iequals(coding, "gzip") || iequals(coding, "x-gzip")) q_gzip = q;
+      else if (coding == "*") q_any = q;
+    }
+    [[maybe_unused]] auto acceptable = [&](double q) { return q == unset ? q_any > 0 : q > 0; };
+#ifdef ENABLE_ZSTD
+    if (acceptable(q_zstd))
+      return content_encoding::zstd;
+#endif
+#ifdef ENABLE_ZLIB
+    if (acceptable(q_gzip))
+      return content_encoding::gzip;
+#endif
+    return content_encoding::identity;
+  }
+
+  std::string_view encoding_name(content_encoding enc) {
+    switch (enc) {
+      case content_encoding::gzip: return "gzip";
+      case content_encoding::zstd: return "zstd";
+      default: return "identity";
+    }
+  }
+
+  std::vector<std::string> compress_body(content_encoding enc, [[maybe_unused]] std::vector<std::string>&& pieces) {
+#ifdef ENABLE_ZLIB
+    if (enc == content_encoding::gzip)
+      return gzip_compress(pieces);
+#endif
+#ifdef ENABLE_ZSTD
+    if (enc == content_encoding::zstd)
+      return zstd_compress(pieces);
+#endif
+    throw std::invalid_argument{"Unsupported content encoding " + std::string{encoding_name(enc)}};
+  }
+
+  compressed_response_cache::compressed_response_cache() {
+    m_budget = tools::cache_budget::add("rpc_compressed", tools::cache_budget::priority::rpc_compressed, [this](size_t) {
+      std::lock_guard lock{m_mutex};
+      m_entries.clear();
+      m_bytes = 0;
+      m_budget.set_size(0);
+    });
+  }
+
+  std::optional<std::vector<std::string>> compressed_response_cache::find(content_encoding enc, const std::vector<std::string>& pieces) const {
+    const auto hash = body_hash(enc, pieces);
+    std::lock_guard lock{m_mutex};
+    auto [begin, end] = m_entries.equal_range(hash);
+    for (auto it = begin; it != end; ++it) {
+      const auto& e = it->second;
+      if (e.enc != enc)
+        continue;
+      size_t pos = 0;
+      bool same = true;
+      for (const auto& piece : pieces) {
+        if (e.body.size() - pos < piece.size() || std::memcmp(e.body.data() + pos, piece.data(), piece.size()) != 0) {
+          same = false;
+          break;
+        }
+        pos += piece.size();
+      }
+      if (same && pos == e.body.size())
+        return e.compressed;
+    }
+    return std::nullopt;
+  }
+
+  void compressed_response_cache::insert(content_encoding enc, std::string body, const std::vector<std::string>& compressed) {
+    size_t size = body.size();
+    for (const auto& piece : compressed)
+      size += piece.size();
+    if (size > MAX_BYTES / 4)
+      return;
+
+    const auto hash = body_hash(enc, std::array<std::string_view, 1>{body});
+    entry e{enc, std::move(body), compressed};
+    std::lock_guard lock{m_mutex};
+    if (m_bytes + size > MAX_BYTES) {
+      m_entries.clear();
+      m_bytes = 0;
+    }
+    m_entries.emplace(hash, std::move(e));
+    m_bytes += size;
+    m_budget.set_size(m_bytes);
+  }
+
+}
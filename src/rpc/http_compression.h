@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "common/cache_budget.h"
+
+namespace cryptonote::rpc {
+
+  /// Content-Encodings we can send HTTP response bodies with.  gzip needs zlib and zstd needs zstd
+  /// support compiled in; without them, negotiate_encoding() never picks them.
+  enum class content_encoding : uint8_t { identity, gzip, zstd };
+
+  /// Bodies smaller than this are sent as they are whatever the client accepts: they're a packet or
+  /// two either way, and not worth the CPU.
+  constexpr size_t COMPRESSED_RESPONSE_MIN_SIZE = 2048;
+
+  /// Picks the encoding for a response from the request's Accept-Encoding header value: zstd if
+  /// acceptable, then gzip, then identity.  Honours q=0 (including "*;q=0") exclusions.
+  content_encoding negotiate_encoding(std::string_view accept_encoding);
+
+  /// The Content-Encoding header value for `enc`.
+  std::string_view encoding_name(content_encoding enc);
+
+  /// Compresses the concatenation of `pieces` with `enc` (which must not be identity), streaming
+  /// through them and releasing each one once it has been consumed, so that a large response isn't
+  /// held uncompressed and compressed in full at the same time.  The compressed body comes back in
+  /// pieces of up to ~256kB (to be written out with the existing streamed-response path).
+  std::vector<std::string> compress_body(content_encoding enc, std::vector<std::string>&& pieces);
+
+  /// Compressed copies of recent response bodies, so that repeated identical responses (typically
+  /// the ones core_rpc_server answers from its response cache) aren't compressed again for every
+  /// client.  Entries are keyed by a hash of the body's size and ends, and confirmed by comparing the
+  /// full body; the cache is bounded by total size, and emptied when it is full (or to make room
+  /// for the daemon's other caches, see tools::cache_budget).  Thread safe.
+  class compressed_response_cache {
+  public:
+    compressed_response_cache();
+
+    /// Returns the compressed pieces of the body made of `pieces`, if cached.
+    std::optional<std::vector<std::string>> find(content_encoding enc, const std::vector<std::string>& pieces) const;
+
+    /// Caches `compressed` as the compression of `body`.
+    void insert(content_encoding enc, std::string body, const std::vector<std::string>& compressed);
+
+  private:
+    static constexpr size_t MAX_BYTES = 64 * 1024 * 1024;
+
+    struct entry {
+      content_encoding enc;
+      std::string body;
+      std::vector<std::string> compressed;
+    };
+
+    mutable std::mutex m_mutex;
+    std::unordered_multimap<uint64_t, entry> m_entries;
+    size_t m_bytes = 0;
+    tools::cache_budget::handle m_budget;
+  };
+
+}
@@ -1,5 +1,6 @@
 
 #include "http_server.h"
+#include <atomic>
 #include <chrono>
 #include <exception>
 #include <oxenmq/base64.h>
@@ -11,6 +12,7 @@
 #include "cryptonote_core/cryptonote_core.h"
 #include "epee/net/jsonrpc_structs.h"
 #include "rpc/core_rpc_server_commands_defs.h"
+#include "rpc/http_compression.h"
 #include "rpc/rpc_args.h"
 #include "version.h"
 
@@ -87,80 +89,106 @@ namespace cryptonote::rpc {
       rpc_args rpc_config,
       bool restricted,
       std::vector<std::tuple<std::string, uint16_t, bool>> bind)
-    : m_server{server}, m_restricted{restricted}
+    : m_server{server}, m_restricted{restricted}, m_max_batch_size{rpc_config.max_batch_size}
   {
+    if (m_restricted)
+    {
+      fair_queue::config conf;
+      conf.max_in_flight = std::max(1u, std::thread::hardware_concurrency());
+      m_queue = std::make_shared<fair_queue>(conf, [&server=m_server](std::function<void()> job) {
+        server.get_core().get_omq().inject_task("rpc", "http:queued", "", std::move(job));
+      });
+    }
+
+    m_login = rpc_config.login;
+
+    m_cors = {rpc_config.access_control_origins.begin(), rpc_config.access_control_origins.end()};
+
     // uWS is designed to work from a single thread, which is good (we pull off the requests and
     // then stick them into the LMQ job queue to be scheduled along with other jobs).  But as a
     // consequence, we need to create everything inside that thread.  We *also* need to get the
     // (thread local) event loop pointer back from the thread so that we can shut it down later
     // (injecting a callback into it is one of the few thread-safe things we can do across threads).
     //
-    // Things we need in the owning thread, fulfilled from the http thread:
-
-    // - the uWS::Loop* for the event loop thread (which is thread_local).  We can get this during
-    //   thread startup, after the thread does basic initialization.
-    std::promise<uWS::Loop*> loop_promise;
-    auto loop_future = loop_promise.get_future();
-
-    // - the us_listen_socket_t* on which the server is listening.  We can't get this until we
-    //   actually start listening, so wait until `start()` for it.  (We also double-purpose it to
-    //   send back an exception if one fires during startup).
-    std::promise<std::vector<us_listen_socket_t*>> startup_success_promise;
-    m_startup_success = startup_success_promise.get_future();
-
-    // Things we need to send from the owning thread to the event loop thread:
-    // - a signal when the thread should bind to the port and start the event loop (when we call
-    //   start()).
-    //m_startup_promise
-
-    m_rpc_thread = std::thread{[this, rpc_config=std::move(rpc_config), bind=std::move(bind)] (
-        std::promise<uWS::Loop*> loop_promise,
-        std::future<bool> startup_future,
-        std::promise<std::vector<us_listen_socket_t*>> startup_success) {
-      uWS::App http;
-      try {
-        create_rpc_endpoints(http);
-      } catch (...) {
-        loop_promise.set_exception(std::current_exception());
-        return;
-      }
-      loop_promise.set_value(uWS::Loop::get());
-      if (!startup_future.get())
-        // False means cancel, i.e. we got destroyed/shutdown without start() being called
-        return;
-
-      m_login = rpc_config.login;
+    // With --rpc-http-threads we run several such threads, each with its own App, listening on the
+    // same addresses.
+    std::shared_future<bool> startup_future = m_startup_promise.get_future().share();
+    m_loops.resize(std::max<size_t>(rpc_config.http_threads, 1));
+    for (auto& l : m_loops)
+    {
+      // Things we need in the owning thread, fulfilled from the http thread:
+
+      // - the uWS::Loop* for the event loop thread (which is thread_local).  We can get this during
+      //   thread startup, after the thread does basic initialization.
+      std::promise<uWS::Loop*> loop_promise;
+      auto loop_future = loop_promise.get_future();
+
+      // - the us_listen_socket_t* on which the server is listening.  We can't get this until we
+      //   actually start listening, so wait until `start()` for it.  (We also double-purpose it to
+      //   send back an exception if one fires during startup).
+      std::promise<std::vector<us_listen_socket_t*>> startup_success_promise;
+      l.startup_success = startup_success_promise.get_future();
+
+      // Things we need to send from the owning thread to the event loop thread:
+      // - a signal when the thread should bind to the port and start the event loop (when we call
+      //   start()): startup_future.
+
+      l.thread = std::thread{[this, bind, index=&l - m_loops.data()] (
+          std::promise<uWS::Loop*> loop_promise,
+          std::shared_future<bool> startup_future,
+          std::promise<std::vector<us_listen_socket_t*>> startup_success) {
+        MLOG_SET_THREAD_NAME("[RPC" + std::to_string(index) + "]");
+        uWS::App http;
+        try {
+          create_rpc_endpoints(http);
+        } catch (...) {
+          loop_promise.set_exception(std::current_exception());
+          return;
+        }
+        loop_promise.set_value(uWS::Loop::get());
+        if (!startup_future.get())
+          // False means cancel, i.e. we got destroyed/shutdown without start() being called
+          return;
+
+        std::vector<us_listen_socket_t*> listening;
+        try {
+          bool required_bind_failed = false;
+          for (const auto& [addr, port, required] : bind)
+            http.listen(addr, port, [&listening, req=required, &required_bind_failed](us_listen_socket_t* sock) {
+              if (sock) listening.push_back(sock);
+              else if (req) required_bind_failed = true;
+            });
+
+          if (listening.empty() || required_bind_failed) {
+            std::ostringstream error;
+            error << "RPC HTTP server failed to bind; ";
+            if (listening.empty()) error << "no valid bind address(es) given";
+            error << "tried to bind to:";
+            for (const auto& [addr, port, required] : bind)
+              error << ' ' << addr << ':' << port;
+            throw std::runtime_error(error.str());
+          }
+        } catch (...) {
+          startup_success.set_exception(std::current_exception());
+          return;
+        }
+        startup_success.set_value(std::move(listening));
 
-      m_cors = {rpc_config.access_control_origins.begin(), rpc_config.access_control_origins.end()};
+        http.run();
+      }, std::move(loop_promise), startup_future, std::move(startup_success_promise)};
 
-      std::vector<us_listen_socket_t*> listening;
       try {
-        bool required_bind_failed = false;
-        for (const auto& [addr, port, required] : bind)
-          http.listen(addr, port, [&listening, req=required, &required_bind_failed](us_listen_socket_t* sock) {
-            if (sock) listening.push_back(sock);
-            else if (req) required_bind_failed = true;
-          });
-
-        if (listening.empty() || required_bind_failed) {
-          std::ostringstream error;
-          error << "RPC HTTP server failed to bind; ";
-          if (listening.empty()) error << "no valid bind address(es) given";
-          error << "tried to bind to:";
-          for (const auto& [addr, port, required] : bind)
-            error << ' ' << addr << ':' << port;
-          throw std::runtime_error(error.str());
-        }
+        l.loop = loop_future.get();
       } catch (...) {
-        startup_success.set_exception(std::current_exception());
-        return;
+        // Let the threads already waiting for startup go before we bail out
+        m_startup_promise.set_value(false);
+        for (auto& t : m_loops)
+          if (t.thread.joinable())
+            t.thread.join();
+        throw;
       }
-      startup_success.set_value(std::move(listening));
-
-      http.run();
-    }, std::move(loop_promise), m_startup_promise.get_future(), std::move(startup_success_promise)};
-
-    m_loop = loop_future.get();
+    }
+    m_loop = m_loops.front().loop;
   }
 
   void http_server::create_rpc_endpoints(uWS::App& http)
@@ -210,14 +238,18 @@ namespace cryptonote::rpc {
     bool replied{false};
     bool jsonrpc{false};
     std::string jsonrpc_id; // pre-formatted json value
+    bool long_polled{false}; // set once a long poll request has waited, so that it doesn't again
     std::vector<std::pair<std::string, std::string>> extra_headers; // Extra headers to send
+    content_encoding encoding{content_encoding::identity}; // negotiated from Accept-Encoding
+    // The event loop of the thread that accepted the connection; all writes to `res` go through it
+    uWS::Loop* loop{uWS::Loop::get()};
 
     // If we have to drop the request because we are overloaded we want to reply with an error (so
     // that we close the connection instead of leaking it and leaving it hanging).  We don't do
     // this, of course, if the request got aborted and replied to.
     ~call_data() {
       if (replied || aborted) return;
-      http.loop_defer([&http=http, &res=res, jsonrpc=jsonrpc] {
+      loop->defer([&http=http, &res=res, jsonrpc=jsonrpc] {
         if (jsonrpc)
           http.jsonrpc_error_response(res, -32003, "Server busy, try again later");
         else
@@ -247,23 +279,128 @@ namespace cryptonote::rpc {
     }
   };
 
+  // Bodies at least this big get sent with stream_response() rather than written in one go
+  constexpr size_t STREAMED_RESPONSE_MIN_SIZE = 256 * 1024;
+
+  struct streamed_response {
+    std::vector<std::string> pieces;
+    size_t total;
+    size_t next = 0;           // the first piece not yet all handed to uWS
+    uintmax_t next_offset = 0; // the body offset at which pieces[next] starts
+  };
+
+  // Sends as much of a large body as the socket will take now, and the rest from onWritable as it
+  // drains.  (uWS's write() copies whatever the socket doesn't take right away into its own
+  // buffer, which for a big response would be a second copy of nearly all of it.)  Pieces are
+  // freed once sent.  Returns false if it is waiting on the socket.
+  bool stream_response(const std::shared_ptr<call_data>& data, const std::shared_ptr<streamed_response>& s)
+  {
+    auto& res = data->res;
+    while (s->next < s->pieces.size())
+    {
+      auto& piece = s->pieces[s->next];
+      const size_t skip = res.getWriteOffset() - s->next_offset;
+      auto [ok, done] = res.tryEnd(std::string_view{piece}.substr(skip), s->total);
+      if (done)
+      {
+        if (data->http.closing()) res.close();
+        return true;
+      }
+      if (!ok)
+      {
+        res.onWritable([data, s](uintmax_t) { return data->aborted || stream_response(data, s); });
+        return false;
+      }
+      s->next_offset += piece.size();
+      std::string{}.swap(piece);
+      s->next++;
+    }
+    return true;
+  }
+
+  compressed_response_cache compressed_responses;
+
+  // Compresses `body` with the client's negotiated encoding, if it is big enough to bother; returns
+  // false (leaving `body` alone) if it goes uncompressed.  Bodies of cacheable commands go through
+  // compressed_responses, as they are likely to be sent again.
+  bool compress_response(const call_data& data, std::vector<std::string>& body)
+  {
+    if (data.encoding == content_encoding::identity)
+      return false;
+    size_t total = 0;
+    for (const auto& piece : body)
+      total += piece.size();
+    if (total < COMPRESSED_RESPONSE_MIN_SIZE)
+      return false;
+
+    const bool cacheable = data.call && data.call->is_cacheable;
+    if (cacheable)
+    {
+      if (auto cached = compressed_responses.find(data.encoding, body))
+      {
+        body = std::move(*cached);
+        return true;
+      }
+    }
+
+    std::string uncompressed;
+    if (cacheable)
+    {
+      uncompressed.reserve(total);
+      for (const auto& piece : body)
+        uncompressed += piece;
+    }
+    body = compress_body(data.encoding, std::move(body));
+    if (cacheable)
+      compressed_responses.insert(data.encoding, std::move(uncompressed), body);
+    return true;
+  }
+
   // Queues a response for the HTTP thread to handle; the response can be in multiple string pieces
-  // to be concatenated together.
+  // to be concatenated together.  Compresses it first, here on the calling (worker) thread, if the
+  // client accepts a compressed response.
   void queue_response(std::shared_ptr<call_data> data, std::vector<std::string> body)
   {
-    auto& http = data->http;
+    bool compressed = false;
+    try {
+      compressed = compress_response(*data, body);
+    } catch (const std::exception& e) {
+      // The pieces are consumed as they are compressed, so there's nothing left to send instead
+      MERROR("Failed to compress HTTP RPC " << data->uri << " response: " << e.what());
+      auto* loop = data->loop;
+      loop->defer([data=std::move(data)] {
+        if (data->jsonrpc)
+          data->jsonrpc_error_response(data->res, -32603, "Internal error");
+        else
+          data->error_response(data->res, http_server::HTTP_ERROR, std::nullopt);
+      });
+      return;
+    }
+
+    auto* loop = data->loop;
     data->replied = true;
-    http.loop_defer([data=std::move(data), body=std::move(body)] {
+    loop->defer([data=std::move(data), body=std::move(body), compressed]() mutable {
       if (data->aborted)
         return;
-      data->res.cork([data=std::move(data), body=std::move(body)] {
+      data->res.cork([data=std::move(data), body=std::move(body), compressed]() mutable {
         auto& res = data->res;
         res.writeHeader("Server", data->http.server_header());
-        res.writeHeader("Content-Type", data->call->is_binary ? "application/octet-stream"sv : "application/json"sv);
+        res.writeHeader("Content-Type", data->call && data->call->is_binary ? "application/octet-stream"sv : "application/json"sv);
+        if (compressed) res.writeHeader("Content-Encoding", encoding_name(data->encoding));
+        res.writeHeader("Vary", "Accept-Encoding");
         if (data->http.closing()) res.writeHeader("Connection", "close");
         for (const auto& [name, value] : data->extra_headers)
           res.writeHeader(name, value);
 
+        size_t total = 0;
+        for (const auto& piece : body)
+          total += piece.size();
+        if (total >= STREAMED_RESPONSE_MIN_SIZE)
+        {
+          stream_response(data, std::make_shared<streamed_response>(streamed_response{std::move(body), total}));
+          return;
+        }
+
         for (const auto& piece : body)
           res.write(piece);
 
@@ -281,7 +418,41 @@ namespace cryptonote::rpc {
     queue_response(std::move(data), std::move(b));
   }
 
+  struct call_result {
+    std::string body; // the serialized response, if json_error is 0
+    int json_error = -32603;
+    std::string json_message = "Internal error";
+    std::string http_message;
+  };
+
+  // Invokes `call`, catching and logging whatever it throws; `uri` is for the log messages.
+  call_result invoke_call(const rpc_command& call, rpc_request&& request, core_rpc_server& core_rpc, std::string_view uri)
+  {
+    call_result r;
+    try {
+      r.body = call.invoke(std::move(request), core_rpc);
+      r.json_error = 0;
+    } catch (const parse_error& e) {
+      // This isn't really WARNable as it's the client fault; log at info level instead.
+      MINFO("HTTP RPC request '" << uri << "' called with invalid/unparseable data: " << e.what());
+      r.json_error = -32602;
+      r.http_message = "Unable to parse request: "s + e.what();
+      r.json_message = "Invalid params";
+    } catch (const rpc_error& e) {
+      MWARNING("HTTP RPC request '" << uri << "' failed with: " << e.what());
+      r.json_error = e.code;
+      r.json_message = e.message;
+      r.http_message = e.message;
+    } catch (const std::exception& e) {
+      MWARNING("HTTP RPC request '" << uri << "' raised an exception: " << e.what());
+    } catch (...) {
+      MWARNING("HTTP RPC request '" << uri << "' raised an unknown exception");
+    }
+    return r;
+  }
+
   void invoke_txpool_hashes_bin(std::shared_ptr<call_data> data);
+  bool defer_blocks_long_poll(std::shared_ptr<call_data>& data);
 
   // Invokes the actual RPC request; this is called (via oxenmq) from some random LMQ worker thread,
   // which means we can't just write our reply; instead we have to post it to the uWS loop.
@@ -291,8 +462,12 @@ namespace cryptonote::rpc {
     if (data.aborted) return;
 
     // Replace the default tx pool hashes callback with our own (which adds long poll support):
-    if (std::string_view{data.uri}.substr(1) == rpc::GET_TRANSACTION_POOL_HASHES_BIN::names()[0])
+    const auto name = std::string_view{data.uri}.substr(1);
+    if (name == rpc::GET_TRANSACTION_POOL_HASHES_BIN::names()[0])
       return invoke_txpool_hashes_bin(std::move(dataptr));
+    // get_blocks.bin long polls wait here until there's a new block
+    if ((name == rpc::GET_BLOCKS_FAST::names()[0] || name == rpc::GET_BLOCKS_FAST::names()[1]) && defer_blocks_long_poll(dataptr))
+      return;
 
     const bool time_logging = LOG_ENABLED(Debug);
     std::chrono::steady_clock::time_point start;
@@ -308,32 +483,9 @@ namespace cryptonote::rpc {
       result.back() += R"(,"result":)";
     }
 
-    int json_error = -32603;
-    std::string json_message = "Internal error";
-    std::string http_message;
-
-    try {
-      result.push_back(data.call->invoke(std::move(data.request), data.core_rpc));
-      json_error = 0;
-    } catch (const parse_error& e) {
-      // This isn't really WARNable as it's the client fault; log at info level instead.
-      MINFO("HTTP RPC request '" << data.uri << "' called with invalid/unparseable data: " << e.what());
-      json_error = -32602;
-      http_message = "Unable to parse request: "s + e.what();
-      json_message = "Invalid params";
-    } catch (const rpc_error& e) {
-      MWARNING("HTTP RPC request '" << data.uri << "' failed with: " << e.what());
-      json_error = e.code;
-      json_message = e.message;
-      http_message = e.message;
-    } catch (const std::exception& e) {
-      MWARNING("HTTP RPC request '" << data.uri << "' raised an exception: " << e.what());
-    } catch (...) {
-      MWARNING("HTTP RPC request '" << data.uri << "' raised an unknown exception");
-    }
-
-    if (json_error != 0) {
-      data.http.loop_defer([data=std::move(dataptr), json_error, msg=std::move(data.jsonrpc ? json_message : http_message)] {
+    auto r = invoke_call(*data.call, std::move(data.request), data.core_rpc, data.uri);
+    if (r.json_error != 0) {
+      data.loop->defer([data=std::move(dataptr), json_error=r.json_error, msg=std::move(data.jsonrpc ? r.json_message : r.http_message)] {
         if (data->jsonrpc)
           data->jsonrpc_error_response(data->res, json_error, msg);
         else
@@ -342,6 +494,7 @@ namespace cryptonote::rpc {
       return;
     }
 
+    result.push_back(std::move(r.body));
     if (data.jsonrpc)
       result.emplace_back("}\n");
 
@@ -350,7 +503,7 @@ namespace cryptonote::rpc {
       call_duration = " in " + tools::friendly_duration(std::chrono::steady_clock::now() - start);
     if (LOG_ENABLED(Info)) {
       size_t bytes = 0;
-      for (const auto& r : result) bytes += r.size();
+      for (const auto& piece : result) bytes += piece.size();
       MINFO("HTTP RPC " << data.uri << " [" << data.request.context.remote << "] OK (" << bytes << " bytes)" << call_duration);
     }
 
@@ -432,11 +585,77 @@ namespace cryptonote::rpc {
     long_pollers.clear();
   }
 
+  // get_blocks.bin long polls from clients that already have the top block, waiting for a new one
+  // (or their timeout).  Guarded by long_poll_mutex.
+  struct block_long_poll {
+    std::shared_ptr<call_data> data;
+    crypto::hash top;
+    std::chrono::steady_clock::time_point expiry;
+  };
+  std::list<block_long_poll> block_long_pollers;
+
+  // Returns true (having taken `data` into block_long_pollers) if `data` is a get_blocks.bin long
+  // poll request whose top block is the current top block.
+  bool defer_blocks_long_poll(std::shared_ptr<call_data>& data) {
+    auto body = data->request.body_view();
+    // The field names are in epee binary requests, so this skips parsing ordinary requests twice
+    if (data->long_polled || !body || body->find("long_poll"sv) == std::string_view::npos)
+      return false;
+    GET_BLOCKS_FAST::request req{};
+    // (A request that doesn't parse gets its error from the actual invoke)
+    if (!epee::serialization::load_t_from_binary(req, *body) || !req.long_poll || req.block_ids.empty())
+      return false;
+    const auto top = data->core_rpc.get_core().get_blockchain_storage().get_tail_id();
+    if (req.block_ids.front() != top)
+      return false;
+
+    std::lock_guard lock{long_poll_mutex};
+    MTRACE("Deferring get_blocks.bin long poll request from " << data->request.context.remote << " until a block after " << top);
+    block_long_pollers.push_back({std::move(data), top, std::chrono::steady_clock::now() + GET_BLOCKS_FAST::long_poll_timeout});
+    return true;
+  }
+
+  // Sends the get_blocks.bin long polls back to the workers once there's a new top block, or they
+  // time out; either way they then answer with whatever blocks there are.
+  void process_block_long_polls() {
+    std::vector<std::shared_ptr<call_data>> ready;
+    {
+      std::lock_guard lock{long_poll_mutex};
+      if (block_long_pollers.empty())
+        return;
+
+      const auto top = block_long_pollers.front().data->core_rpc.get_core().get_blockchain_storage().get_tail_id();
+      const auto now = std::chrono::steady_clock::now();
+      for (auto it = block_long_pollers.begin(); it != block_long_pollers.end(); )
+      {
+        if (it->top != top || it->expiry < now || it->data->aborted)
+        {
+          ready.push_back(std::move(it->data));
+          it = block_long_pollers.erase(it);
+        }
+        else
+          ++it;
+      }
+    }
+
+    if (!ready.empty())
+      MDEBUG("Resuming " << ready.size() << " get_blocks.bin long poll requests");
+    for (auto& data : ready)
+    {
+      data->long_polled = true;
+      auto& omq = data->core_rpc.get_core().get_omq();
+      std::string remote{data->request.context.remote};
+      omq.inject_task("rpc", "http:get_blocks.bin", remote, [data=std::move(data)] { invoke_rpc(std::move(data)); });
+    }
+  }
+
   std::string long_poll_timeout_body;
 
   // Called periodically to clear expired Starts up a periodic timer for checking for expired long poll requests.  We run this only once
   // a second because we don't really care if we time out at *precisely* 15 seconds.
   void long_poll_process_timeouts() {
+    process_block_long_polls();
+
     std::lock_guard lock{long_poll_mutex};
 
     if (long_pollers.empty())
@@ -470,6 +689,290 @@ namespace cryptonote::rpc {
       MTRACE("None of " << long_pollers.size() << " established long poll connections reached timeout");
   }
 
+  struct jsonrpc_envelope
+  {
+    std::string method;
+    epee::serialization::storage_entry id{std::string{}};
+    std::optional<std::string_view> params;
+  };
+
+  // Pulls "method", "id" and the text of the "params" object out of a JSON-RPC request without
+  // building an epee tree of the whole request: the params then only get parsed once, by the
+  // command's loader (which can load them directly into the request struct).  Returns nullopt if
+  // the request isn't one the direct reader handles (including any invalid request), which should
+  // then be parsed the generic way.
+  std::optional<jsonrpc_envelope> read_jsonrpc_envelope(std::string_view body)
+  {
+    try
+    {
+      epee::serialization::direct_json_reader in{body};
+      in.begin();
+      jsonrpc_envelope env;
+      bool have_method = false;
+      while (auto key = in.next_key())
+      {
+        if (in.read_null())
+          continue;
+        if (*key == "method")
+        {
+          env.method = in.read_string();
+          have_method = true;
+        }
+        else if (*key == "id")
+        {
+          const char c = in.peek();
+          if (c == '"')
+            env.id = std::string{in.read_string()};
+          else if (c == '-')
+            env.id = in.read_integer<int64_t>();
+          else if (epee::misc_utils::parse::isdigit(c))
+            env.id = in.read_integer<uint64_t>();
+          else
+            env.id = in.read_bool();
+        }
+        else if (*key == "params")
+        {
+          if (in.peek() != '{')
+            return std::nullopt;
+          env.params = in.skip();
+        }
+        else
+          in.skip();
+      }
+      in.end();
+      if (have_method)
+        return env;
+    }
+    catch (const std::exception& e)
+    {
+      MTRACE("Direct JSON-RPC envelope parse failed (" << e.what() << "), using the generic parser");
+    }
+    return std::nullopt;
+  }
+
+  // Loads a JSON-RPC request object into `request.body` and looks up its method, setting `call`,
+  // `method` and `id` from it.  Returns the error to reply with if it isn't a valid request, or is
+  // for a restricted method and `restricted` is set.
+  std::optional<std::pair<int, std::string>> parse_jsonrpc_request(
+      std::string_view body,
+      bool restricted,
+      rpc_request& request,
+      const rpc_command*& call,
+      std::string& method,
+      std::optional<epee::serialization::storage_entry>& id)
+  {
+    if (auto env = read_jsonrpc_envelope(body))
+    {
+      method = std::move(env->method);
+      id.emplace(std::move(env->id));
+      // An empty string body (rather than an empty object) signals that no params were given
+      if (env->params)
+        request.body = std::string{*env->params};
+      else
+        request.body = ""sv;
+    }
+    else
+    {
+      auto& [ps, st_entry] = var::get<jsonrpc_params>(request.body = jsonrpc_params{});
+      if(!ps.load_from_json(body))
+        return std::make_pair(-32700, "Parse error"s);
+
+      id.emplace(std::string{});
+      ps.get_value("id", *id, nullptr);
+
+      if(!ps.get_value("method", method, nullptr))
+      {
+        MINFO("Invalid JSON RPC request from " << request.context.remote << ": no 'method' in request");
+        return std::make_pair(-32600, "Invalid Request"s);
+      }
+
+      // Try to load "params" into a generic epee value; if it fails (because there is no "params")
+      // then we replace request.body with an empty string (instead of the epee jsonrpc_params
+      // alternative) to signal that no params were provided at all.
+      if (!ps.get_value("params", st_entry, nullptr))
+        request.body = ""sv;
+    }
+
+    auto it = rpc_commands.find(method);
+    if (it == rpc_commands.end() || it->second->is_binary)
+    {
+      MINFO("Invalid JSON RPC request from " << request.context.remote << ": method '" << method << "' is invalid");
+      return std::make_pair(-32601, "Method not found"s);
+    }
+
+    call = it->second.get();
+    if (restricted && !call->is_public)
+    {
+      MWARNING("Invalid JSON RPC request from " << request.context.remote << ": method '" << method << "' is restricted");
+      return std::make_pair(403, "Forbidden; this command is not available over public RPC"s);
+    }
+
+    return std::nullopt;
+  }
+
+  std::string dump_json(const epee::serialization::storage_entry& value)
+  {
+    std::ostringstream o;
+    epee::serialization::dump_as_json(o, value, 0 /*indent*/, false /*newlines*/);
+    return o.str();
+  }
+
+  // Splits a JSON array into its (unparsed) elements, or returns nullopt if `json` isn't an array.
+  // This only follows the nesting and strings far enough to find the elements' commas: the
+  // elements themselves get checked when they are parsed.
+  std::optional<std::vector<std::string_view>> split_json_array(std::string_view json)
+  {
+    constexpr auto whitespace = " \t\r\n"sv;
+    auto trim = [whitespace](std::string_view s) {
+      auto b = s.find_first_not_of(whitespace);
+      if (b == std::string_view::npos)
+        return std::string_view{};
+      return s.substr(b, s.find_last_not_of(whitespace) - b + 1);
+    };
+
+    json = trim(json);
+    if (json.size() < 2 || json.front() != '[' || json.back() != ']')
+      return std::nullopt;
+    json = json.substr(1, json.size() - 2);
+
+    std::vector<std::string_view> elements;
+    if (trim(json).empty())
+      return elements;
+    int depth = 0;
+    bool in_string = false;
+    size_t start = 0;
+    for (size_t i = 0; i < json.size(); i++)
+    {
+      const char c = json[i];
+      if (in_string)
+      {
+        if (c == '\\')
+          i++;
+        else if (c == '"')
+          in_string = false;
+      }
+      else if (c == '"')
+        in_string = true;
+      else if (c == '[' || c == '{')
+        depth++;
+      else if (c == ']' || c == '}')
+      {
+        if (--depth < 0)
+          return std::nullopt;
+      }
+      else if (c == ',' && depth == 0)
+      {
+        elements.push_back(trim(json.substr(start, i - start)));
+        start = i + 1;
+      }
+    }
+    if (in_string || depth != 0)
+      return std::nullopt;
+    elements.push_back(trim(json.substr(start)));
+    return elements;
+  }
+
+  // A JSON-RPC batch request.  Each of its entries is a separate job, filling in its response, and
+  // whichever finishes last sends them all.  If a job gets dropped the batch never completes, and
+  // `data` replies that the server is busy once the other jobs have let go of it.
+  struct jsonrpc_batch {
+    struct entry {
+      const rpc_command* call{nullptr};
+      std::string method;
+      rpc_request request;
+      std::optional<epee::serialization::storage_entry> id;
+    };
+    std::shared_ptr<call_data> data;
+    std::vector<entry> entries;
+    std::vector<std::string> responses; // one per entry
+    std::atomic<size_t> remaining;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  };
+
+  void finish_batch_entry(std::shared_ptr<jsonrpc_batch> batch)
+  {
+    if (batch->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+      return;
+
+    std::vector<std::string> body;
+    body.reserve(2 * batch->responses.size() + 1);
+    size_t bytes = 0;
+    for (auto& r : batch->responses)
+    {
+      body.emplace_back(body.empty() ? "[" : ",");
+      bytes += r.size();
+      body.push_back(std::move(r));
+    }
+    body.emplace_back("]\n");
+    MINFO("HTTP RPC batch of " << batch->entries.size() << " [" << batch->data->request.context.remote << "] done (" <<
+        bytes << " bytes) in " << tools::friendly_duration(std::chrono::steady_clock::now() - batch->start));
+    queue_response(std::move(batch->data), std::move(body));
+  }
+
+  void invoke_batch_entry(std::shared_ptr<jsonrpc_batch> batch, size_t i)
+  {
+    auto& e = batch->entries[i];
+    auto& response = batch->responses[i];
+    if (batch->data->aborted)
+      response.clear();
+    else if (auto r = invoke_call(*e.call, std::move(e.request), batch->data->core_rpc, e.method); r.json_error == 0)
+    {
+      response.reserve(r.body.size() + 64);
+      response += R"({"jsonrpc":"2.0","id":)";
+      response += dump_json(*e.id);
+      response += R"(,"result":)";
+      response += r.body;
+      response += '}';
+    }
+    else
+      response = http_server::jsonrpc_error_body(r.json_error, std::move(r.json_message), std::move(e.id));
+    finish_batch_entry(std::move(batch));
+  }
+
+  using queue_job_func = std::function<bool(const rpc_command& call, std::string_view method, size_t body_size, std::function<void()> job)>;
+
+  // Handles a JSON-RPC batch, i.e. an array of requests: the requests are queued as separate jobs,
+  // so that they run in parallel on the workers, and answered together with an array of their
+  // responses (in the same order).
+  void handle_jsonrpc_batch(std::shared_ptr<call_data> data, std::string_view body, size_t max_size, bool restricted, const queue_job_func& queue)
+  {
+    auto elements = split_json_array(body);
+    if (!elements)
+      return data->jsonrpc_error_response(data->res, -32700, "Parse error");
+    if (elements->empty())
+      return data->jsonrpc_error_response(data->res, -32600, "Invalid Request");
+    if (elements->size() > max_size)
+    {
+      MINFO("Invalid JSON RPC request from " << data->request.context.remote << ": batch of " << elements->size() << " requests");
+      return data->jsonrpc_error_response(data->res, -32600, "Invalid Request: batches are limited to " + std::to_string(max_size) + " requests");
+    }
+
+    MDEBUG("Incoming JSON RPC batch of " << elements->size() << " requests from " << data->request.context.remote);
+    auto batch = std::make_shared<jsonrpc_batch>();
+    batch->entries.resize(elements->size());
+    batch->responses.resize(elements->size());
+    // One more than the entries, held until they are all queued
+    batch->remaining = elements->size() + 1;
+    auto& context = data->request.context;
+    batch->data = std::move(data);
+
+    for (size_t i = 0; i < elements->size(); i++)
+    {
+      auto& e = batch->entries[i];
+      e.request.context = context;
+      std::optional<std::pair<int, std::string>> error;
+      if (auto err = parse_jsonrpc_request((*elements)[i], restricted, e.request, e.call, e.method, e.id))
+        error = std::move(err);
+      else if (!queue(*e.call, e.method, (*elements)[i].size(), [batch, i] { invoke_batch_entry(std::move(batch), i); }))
+        error = std::make_pair(-32003, "Too many requests, try again later"s);
+      else
+        continue;
+      batch->responses[i] = http_server::jsonrpc_error_body(error->first, std::move(error->second), std::move(e.id));
+      finish_batch_entry(batch);
+    }
+    finish_batch_entry(std::move(batch));
+  }
+
   } // anonymous namespace
 
   void http_server::handle_base_request(
@@ -484,19 +987,25 @@ namespace cryptonote::rpc {
     request.context.source = rpc_source::http;
     request.context.remote = get_remote_address(res);
     handle_cors(req, data->extra_headers);
+    data->encoding = negotiate_encoding(req.getHeader("accept-encoding"));
     MTRACE("Received " << req.getMethod() << " " << req.getUrl() << " request from " << request.context.remote);
 
     res.onAborted([data] { data->aborted = true; });
-    res.onData([data=std::move(data)](std::string_view d, bool done) mutable {
+    res.onData([this, data=std::move(data)](std::string_view d, bool done) mutable {
       var::get<std::string>(data->request.body) += d;
       if (!done)
         return;
 
-      auto& omq = data->core_rpc.get_core().get_omq();
-      std::string cat{data->call->is_public ? "rpc" : "admin"};
-      std::string cmd{"http:" + data->uri}; // Used for LMQ job logging; prefixed with http: so we can distinguish it
+      // The job must hold the only other reference, so that if OMQ drops it, the call_data
+      // destructor replies; `refused` only lives long enough to reply if the queue refuses it
+      auto refused = data;
+      auto& call = *data->call;
+      std::string name = data->uri.substr(1);
       std::string remote{data->request.context.remote};
-      omq.inject_task(std::move(cat), std::move(cmd), std::move(remote), [data=std::move(data)] { invoke_rpc(std::move(data)); });
+      size_t body_size = var::get<std::string>(data->request.body).size();
+      if (queue_job(call, name, false, remote, body_size, [data=std::move(data)] { invoke_rpc(std::move(data)); }))
+        return;
+      refused->error_response(refused->res, HTTP_TOO_MANY_REQUESTS, "Too many requests, try again later"sv);
     });
   }
 
@@ -509,9 +1018,10 @@ namespace cryptonote::rpc {
     request.context.source = rpc_source::http;
     request.context.remote = get_remote_address(res);
     handle_cors(req, data->extra_headers);
+    data->encoding = negotiate_encoding(req.getHeader("accept-encoding"));
 
     res.onAborted([data] { data->aborted = true; });
-    res.onData([buffer=""s, data, restricted=m_restricted](std::string_view d, bool done) mutable {
+    res.onData([this, buffer=""s, data, restricted=m_restricted, max_batch_size=m_max_batch_size](std::string_view d, bool done) mutable {
       if (!done) {
         buffer += d;
         return;
@@ -523,56 +1033,71 @@ namespace cryptonote::rpc {
       else
         body = (buffer += d);
 
-      auto& [ps, st_entry] = var::get<jsonrpc_params>(data->request.body = jsonrpc_params{});
-      if(!ps.load_from_json(body))
-        return data->jsonrpc_error_response(data->res, -32700, "Parse error");
-
-      epee::serialization::storage_entry id{std::string{}};
-      ps.get_value("id", id, nullptr);
-
-      std::string method;
-      if(!ps.get_value("method", method, nullptr))
+      if (auto start = body.find_first_not_of(" \t\r\n"sv); start != std::string_view::npos && body[start] == '[')
       {
-        MINFO("Invalid JSON RPC request from " << data->request.context.remote << ": no 'method' in request");
-        return data->jsonrpc_error_response(data->res, -32600, "Invalid Request", id);
+        auto queue = [this, remote=std::string{data->request.context.remote}](const rpc_command& call, std::string_view method, size_t body_size, std::function<void()> job) {
+          return queue_job(call, method, true, remote, body_size, std::move(job));
+        };
+        return handle_jsonrpc_batch(std::move(data), body, max_batch_size, restricted, queue);
       }
 
-      auto it = rpc_commands.find(method);
-      if (it == rpc_commands.end() || it->second->is_binary)
-      {
-        MINFO("Invalid JSON RPC request from " << data->request.context.remote << ": method '" << method << "' is invalid");
-        return data->jsonrpc_error_response(data->res, -32601, "Method not found", id);
-      }
-
-      data->call = it->second.get();
-      if (restricted && !data->call->is_public)
-      {
-        MWARNING("Invalid JSON RPC request from " << data->request.context.remote << ": method '" << method << "' is restricted");
-        return data->jsonrpc_error_response(data->res, 403, "Forbidden; this command is not available over public RPC", id);
-      }
+      std::string method;
+      std::optional<epee::serialization::storage_entry> id;
+      if (auto error = parse_jsonrpc_request(body, restricted, data->request, data->call, method, id))
+        return data->jsonrpc_error_response(data->res, error->first, std::move(error->second), std::move(id));
 
       MDEBUG("Incoming JSON RPC request for " << method << " from " << data->request.context.remote);
+      data->jsonrpc_id = dump_json(*id);
 
-      {
-        std::ostringstream o;
-        epee::serialization::dump_as_json(o, id, 0 /*indent*/, false /*newlines*/);
-        data->jsonrpc_id = o.str();
-      }
-
-      // Try to load "params" into a generic epee value; if it fails (because there is no "params")
-      // then we replace request.body with an empty string (instead of the epee jsonrpc_params
-      // alternative) to signal that no params were provided at all.
-      if (!ps.get_value("params", st_entry, nullptr))
-        data->request.body = ""sv;
-
-      auto& omq = data->core_rpc.get_core().get_omq();
-      std::string cat{data->call->is_public ? "rpc" : "admin"};
-      std::string cmd{"jsonrpc:" + method}; // Used for LMQ job logging; prefixed with jsonrpc: so we can distinguish it
+      auto refused = data; // As in handle_base_request
+      auto& call = *data->call;
       std::string remote{data->request.context.remote};
-      omq.inject_task(std::move(cat), std::move(cmd), std::move(remote), [data=std::move(data)] { invoke_rpc(std::move(data)); });
+      if (queue_job(call, method, true, remote, body.size(), [data=std::move(data)] { invoke_rpc(std::move(data)); }))
+        return;
+      refused->jsonrpc_error_response(refused->res, -32003, "Too many requests, try again later", id);
     });
   }
 
+  namespace {
+    // Rough costs of the public commands that are much heavier than an ordinary one (cost 1); on top
+    // of this, a request costs 1 per kB of request body, for requests (e.g. for outputs or txs)
+    // whose work grows with what they ask for.
+    const std::unordered_map<std::string_view, double> heavy_commands{
+      {"get_outs.bin"sv, 10},
+      {"get_outs"sv, 10},
+      {"get_blocks.bin"sv, 20},
+      {"getblocks.bin"sv, 20},
+      {"get_block_digests.bin"sv, 10},
+      {"get_blocks_by_height.bin"sv, 10},
+      {"getblocks_by_height.bin"sv, 10},
+      {"get_transactions"sv, 5},
+      {"gettransactions"sv, 5},
+      {"get_block_headers_range"sv, 10},
+      {"getblockheadersrange"sv, 10},
+      {"get_output_histogram"sv, 20},
+      {"get_output_distribution"sv, 20},
+      {"get_output_distribution.bin"sv, 20},
+      {"get_transaction_pool"sv, 10},
+      {"get_service_nodes"sv, 5},
+    };
+
+    double request_cost(std::string_view name, size_t body_size) {
+      auto it = heavy_commands.find(name);
+      return (it == heavy_commands.end() ? 1 : it->second) + body_size / 1024.0;
+    }
+  }
+
+  bool http_server::queue_job(const rpc_command& call, std::string_view name, bool jsonrpc, const std::string& remote, size_t body_size, std::function<void()> job)
+  {
+    if (m_queue && call.is_public)
+      return m_queue->submit(remote, name, request_cost(name, body_size), std::move(job));
+
+    auto& omq = m_server.get_core().get_omq();
+    // The command is used for LMQ job logging; prefixed with http: or jsonrpc: so we can distinguish it
+    omq.inject_task(call.is_public ? "rpc" : "admin", (jsonrpc ? "jsonrpc:"s : "http:"s) + std::string{name}, remote, std::move(job));
+    return true;
+  }
+
   static std::unordered_set<oxenmq::OxenMQ*> timer_started;
 
   void http_server::start()
@@ -586,16 +1111,36 @@ namespace cryptonote::rpc {
 
     m_startup_promise.set_value(true);
     m_sent_startup = true;
-    m_listen_socks = m_startup_success.get();
+    // If one of the threads failed to bind we still want the others' sockets, so that shutdown()
+    // can close them
+    std::exception_ptr failed;
+    for (auto& l : m_loops)
+    {
+      try {
+        l.listen_socks = l.startup_success.get();
+      } catch (...) {
+        if (!failed)
+          failed = std::current_exception();
+      }
+    }
+    if (failed)
+      std::rethrow_exception(failed);
 
     auto& omq = m_server.get_core().get_omq();
     if (timer_started.insert(&omq).second)
       omq.add_timer(long_poll_process_timeouts, 1s);
+    if (m_queue)
+      omq.add_timer([queue=m_queue] {
+        for (const auto& [command, s] : queue->take_stats())
+          MINFO("Public RPC " << command << ": " << s.count << " requests, queued "
+              << tools::friendly_duration(s.total_wait / s.count) << " on average, "
+              << tools::friendly_duration(s.max_wait) << " at most");
+      }, 5min);
   }
 
   void http_server::shutdown(bool join)
   {
-    if (!m_rpc_thread.joinable())
+    if (m_loops.empty() || !m_loops.front().thread.joinable())
       return;
 
     if (!m_sent_shutdown)
@@ -606,37 +1151,60 @@ namespace cryptonote::rpc {
         m_startup_promise.set_value(false);
         m_sent_startup = true;
       }
-      else if (!m_listen_socks.empty())
+      else
       {
-        loop_defer([this] {
-          MTRACE("closing " << m_listen_socks.size() << " listening sockets");
-          for (auto* s : m_listen_socks)
-            us_listen_socket_close(/*ssl=*/false, s);
-          m_listen_socks.clear();
-
-          m_closing = true;
-
-          {
-            // Destroy any pending long poll connections as well
-            MTRACE("closing pending long poll requests");
-            std::lock_guard lock{long_poll_mutex};
-            for (auto it = long_pollers.begin(); it != long_pollers.end(); )
+        for (auto& l : m_loops)
+        {
+          if (l.listen_socks.empty())
+            continue;
+          l.loop->defer([this, &l] {
+            MTRACE("closing " << l.listen_socks.size() << " listening sockets");
+            for (auto* s : l.listen_socks)
+              us_listen_socket_close(/*ssl=*/false, s);
+            l.listen_socks.clear();
+
+            m_closing = true;
+
             {
-              if (&it->first->http != this)
-                continue; // Belongs to some other http_server instance
-              it->first->aborted = true;
-              it->first->res.close();
-              it = long_pollers.erase(it);
+              // Destroy any pending long poll connections as well: the ones of this loop, since
+              // they can only be touched from the loop that owns them (the other loops of this
+              // http_server get their own callback).
+              MTRACE("closing pending long poll requests");
+              std::lock_guard lock{long_poll_mutex};
+              for (auto it = long_pollers.begin(); it != long_pollers.end(); )
+              {
+                if (it->first->loop != l.loop)
+                {
+                  ++it;
+                  continue; // Belongs to some other event loop
+                }
+                it->first->aborted = true;
+                it->first->res.close();
+                it = long_pollers.erase(it);
+              }
+              for (auto it = block_long_pollers.begin(); it != block_long_pollers.end(); )
+              {
+                if (it->data->loop != l.loop)
+                {
+                  ++it;
+                  continue;
+                }
+                it->data->aborted = true;
+                it->data->res.close();
+                it = block_long_pollers.erase(it);
+              }
             }
-          }
-        });
+          });
+        }
       }
       m_sent_shutdown = true;
     }
 
-    MTRACE("joining rpc thread");
+    MTRACE("joining rpc threads");
     if (join)
-      m_rpc_thread.join();
+      for (auto& l : m_loops)
+        if (l.thread.joinable())
+          l.thread.join();
     MTRACE("done shutdown");
   }
 
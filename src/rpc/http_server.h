@@ -35,6 +35,7 @@
 #include "common/password.h"
 #include "core_rpc_server.h"
 #include "http_server_base.h"
+#include "rpc_fair_queue.h"
 #include "rpc/rpc_args.h"
 
 namespace cryptonote::rpc {
@@ -88,22 +89,41 @@ namespace cryptonote::rpc {
         HttpRequest& req,
         const rpc_command& call);
 
-    /// Handles a POST request to /json_rpc.
+    /// Handles a POST request to /json_rpc: a single request, or a batch (array) of them.
     void handle_json_rpc_request(HttpResponse& res, HttpRequest& req);
 
+    /// Queues a request's job onto the OMQ worker threads: directly, or through m_queue for
+    /// public commands on a restricted server.  Returns false if m_queue refused it.
+    bool queue_job(const rpc_command& call, std::string_view name, bool jsonrpc, const std::string& remote, size_t body_size, std::function<void()> job);
+
     // The core rpc server which handles the internal requests
     core_rpc_server& m_server;
-    // A promise we send from outside into the event loop thread to signal it to start.  We sent
-    // "true" to go ahead with binding + starting the event loop, or false to abort.
+    // A promise we send from outside into the event loop threads to signal them to start.  We send
+    // "true" to go ahead with binding + starting the event loops, or false to abort.
     std::promise<bool> m_startup_promise;
-    // A future (promise held by the thread) that delivers us the listening uSockets sockets so
-    // that, when we want to shut down, we can tell uWebSockets to close them (which will then run
-    // off the end of the event loop).  This also doubles to propagate listen exceptions back to us.
-    std::future<std::vector<us_listen_socket_t*>> m_startup_success;
+    // Each event loop thread runs its own uWS::App, listening on the same addresses (uSockets sets
+    // SO_REUSEPORT on the listening sockets, so that the kernel spreads incoming connections over
+    // them); each connection is handled entirely by the thread that accepted it.
+    struct event_loop
+    {
+      std::thread thread;
+      uWS::Loop* loop{nullptr};
+      // A future (promise held by the thread) that delivers us the listening uSockets sockets so
+      // that, when we want to shut down, we can tell uWebSockets to close them (which will then run
+      // off the end of the event loop).  This also doubles to propagate listen exceptions back to
+      // us.
+      std::future<std::vector<us_listen_socket_t*>> startup_success;
+      std::vector<us_listen_socket_t*> listen_socks;
+    };
+    std::vector<event_loop> m_loops;
     // Whether we have sent the startup/shutdown signals
     bool m_sent_startup{false}, m_sent_shutdown{false};
     // Whether this is restricted, i.e. public.  Unrestricted allows admin commands.
     bool m_restricted;
+    // The most requests accepted in one JSON-RPC batch
+    size_t m_max_batch_size;
+    // Rate limits and fairly queues the requests of a restricted server, by remote address
+    std::shared_ptr<fair_queue> m_queue;
   };
 
 } // namespace cryptonote::rpc
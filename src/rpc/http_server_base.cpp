@@ -74,16 +74,22 @@ namespace cryptonote::rpc {
   }
 
   // Similar to the above, but for JSON errors (which are 200 OK + error embedded in JSON)
-  void http_server_base::jsonrpc_error_response(HttpResponse& res, int code, std::string message, std::optional<epee::serialization::storage_entry> id) const
+  std::string http_server_base::jsonrpc_error_body(int code, std::string message, std::optional<epee::serialization::storage_entry> id)
   {
     epee::json_rpc::error_response rsp;
     rsp.jsonrpc = "2.0";
     if (id)
-      rsp.id = *id;
+      rsp.id = std::move(*id);
     rsp.error.code = code;
     rsp.error.message = std::move(message);
     std::string body;
     epee::serialization::store_t_to_json(rsp, body);
+    return body;
+  }
+
+  void http_server_base::jsonrpc_error_response(HttpResponse& res, int code, std::string message, std::optional<epee::serialization::storage_entry> id) const
+  {
+    std::string body = jsonrpc_error_body(code, std::move(message), std::move(id));
     if (body.capacity() > body.size())
       body += '\n';
     res.writeStatus("200 OK"sv);
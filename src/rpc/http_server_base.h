@@ -1,6 +1,7 @@
 #pragma once
 
 #include <uWebSockets/App.h>
+#include <atomic>
 #include <future>
 #include <unordered_set>
 #include "epee/storages/portable_storage.h"
@@ -42,6 +43,12 @@ namespace cryptonote::rpc {
         std::string message,
         std::optional<epee::serialization::storage_entry> = std::nullopt) const;
 
+    // The JSON body of the above, e.g. for an entry of a batch response.
+    static std::string jsonrpc_error_body(
+        int code,
+        std::string message,
+        std::optional<epee::serialization::storage_entry> id = std::nullopt);
+
     // Posts a callback to the uWebSockets thread loop controlling this connection; all writes must
     // be done from that thread, and so this method is provided to defer a callback from another
     // thread into that one.  The function should have signature `void ()`.
@@ -59,6 +66,7 @@ namespace cryptonote::rpc {
       HTTP_BAD_REQUEST{400, "Bad Request"sv},
       HTTP_FORBIDDEN{403, "Forbidden"sv},
       HTTP_NOT_FOUND{404, "Not Found"sv},
+      HTTP_TOO_MANY_REQUESTS{429, "Too Many Requests"sv},
       HTTP_ERROR{500, "Internal Server Error"sv},
       HTTP_SERVICE_UNAVAILABLE{503, "Service Unavailable"sv};
 
@@ -85,8 +93,8 @@ namespace cryptonote::rpc {
     // we return it in the ACAO header; otherwise (or if this is empty) we omit the header entirely.
     std::unordered_set<std::string> m_cors;
     // Will be set to true when we're trying to shut down which closes any connections as we reply
-    // to them.  Should only be read/write from inside the uWS loop.
-    bool m_closing = false;
+    // to them.  Should only be set from inside the uWS loop (any of them, if there are several).
+    std::atomic<bool> m_closing = false;
     // If true then always reply with 'Access-Control-Allow-Origin: *' to allow anything.
     bool m_cors_any = false;
   };
@@ -1,6 +1,14 @@
 
 #include "lmq_server.h"
 #include "oxenmq/oxenmq.h"
+#include "oxenmq/bt_serialize.h"
+#include "oxenmq/hex.h"
+#include "common/metrics.h"
+#include "common/profiler.h"
+#include "common/string_util.h"
+#include "cryptonote_basic/block_digest.h"
+#include "cryptonote_core/pulse.h"
+#include "core_rpc_server_error_codes.h"
 
 #undef OXEN_DEFAULT_LOG_CATEGORY
 #define OXEN_DEFAULT_LOG_CATEGORY "daemon.rpc"
@@ -80,6 +88,176 @@ constexpr std::string_view
   LMQ_BAD_REQUEST{"400"sv},
   LMQ_ERROR{"500"sv};
 
+// OMQ's worker threads aren't ours to name when they start, so name the ones that run our commands
+// when they first do, for the logs and the profiler.
+void name_omq_thread() {
+  if (!epee::this_thread_info().name[0])
+    MLOG_SET_THREAD_NAME("[OMQ]");
+}
+
+// Helpers for the bt-encoded variants of the heavier public commands, [rpc.NAME.bt].  These take a
+// bt-encoded dict, go through the same core_rpc_server::invoke() as the JSON command, and reply
+// with a bt-encoded dict, in which hashes, keys and blobs are their raw bytes rather than hex.
+
+using oxenmq::bt_dict;
+using oxenmq::bt_list;
+using oxenmq::bt_value;
+
+// Raw bytes from one of the hex values in the responses
+std::string unhex(std::string_view hex) { return oxenmq::from_hex(hex); }
+
+uint64_t bt_bool(bool b) { return b ? 1 : 0; }
+
+// The values of a bt-encoded request dict; the data part can also be omitted (or empty), to use
+// the defaults for everything.  Throws parse_error if a value is missing or has the wrong type.
+class bt_request {
+  bt_dict d_;
+
+  const bt_value* find(const std::string& key) const {
+    auto it = d_.find(key);
+    return it == d_.end() ? nullptr : &it->second;
+  }
+
+public:
+  explicit bt_request(const oxenmq::Message& m) {
+    if (m.data.size() > 1)
+      throw parse_error{"RPC commands must have at most one data part (received " + std::to_string(m.data.size()) + ")"};
+    try {
+      if (!m.data.empty() && !m.data[0].empty())
+        d_ = oxenmq::bt_deserialize<bt_dict>(m.data[0]);
+    } catch (const std::exception& e) {
+      throw parse_error{"request is not a bt-encoded dict: "s + e.what()};
+    }
+  }
+
+  template <typename I>
+  I integer(const std::string& key, I fallback = 0) const {
+    auto* v = find(key);
+    if (!v)
+      return fallback;
+    try { return oxenmq::get_int<I>(*v); }
+    catch (const std::exception& e) { throw parse_error{"invalid '" + key + "' value: " + e.what()}; }
+  }
+
+  bool flag(const std::string& key) const { return integer<int>(key) != 0; }
+
+  // A binary value of `size` bytes (e.g. a hash), in hex, or an empty string if omitted
+  std::string bytes_hex(const std::string& key, size_t size) const {
+    auto* v = find(key);
+    if (!v)
+      return {};
+    auto* s = std::get_if<std::string>(v);
+    if (!s || s->size() != size)
+      throw parse_error{"invalid '" + key + "' value: expected " + std::to_string(size) + " bytes"};
+    return oxenmq::to_hex(*s);
+  }
+
+  // A list of binary values of `size` bytes each, in hex
+  std::vector<std::string> list_hex(const std::string& key, size_t size) const {
+    std::vector<std::string> result;
+    for (auto& v : list(key)) {
+      auto* s = std::get_if<std::string>(&v);
+      if (!s || s->size() != size)
+        throw parse_error{"invalid '" + key + "' value: expected a list of " + std::to_string(size) + "-byte values"};
+      result.push_back(oxenmq::to_hex(*s));
+    }
+    return result;
+  }
+
+  // The list value at `key`, or an empty list if omitted
+  const bt_list& list(const std::string& key) const {
+    static const bt_list empty;
+    auto* v = find(key);
+    if (!v)
+      return empty;
+    auto* l = std::get_if<bt_list>(v);
+    if (!l)
+      throw parse_error{"invalid '" + key + "' value: expected a list"};
+    return *l;
+  }
+};
+
+// Responses with a non-OK status (e.g. busy, or a bootstrap daemon failure) become errors
+template <typename Response>
+void check_status(const Response& res) {
+  if (res.status != STATUS_OK)
+    throw rpc_error{ERROR_INTERNAL, res.status};
+}
+
+bt_dict bt_block_header(block_header_response& h) {
+  bt_dict d{
+    {"hash", unhex(h.hash)},
+    {"prev_hash", unhex(h.prev_hash)},
+    {"height", h.height},
+    {"depth", h.depth},
+    {"timestamp", h.timestamp},
+    {"major_version", h.major_version},
+    {"minor_version", h.minor_version},
+    {"nonce", h.nonce},
+    {"difficulty", h.difficulty},
+    {"cumulative_difficulty", h.cumulative_difficulty},
+    {"reward", h.reward},
+    {"miner_reward", h.miner_reward},
+    {"size", h.block_size},
+    {"weight", h.block_weight},
+    {"long_term_weight", h.long_term_weight},
+    {"num_txes", h.num_txes},
+    {"miner_tx_hash", unhex(h.miner_tx_hash)},
+  };
+  if (!h.service_node_winner.empty())
+    d["service_node_winner"] = unhex(h.service_node_winner);
+  if (!h.tx_hashes.empty()) {
+    bt_list hashes;
+    for (auto& tx_hash : h.tx_hashes)
+      hashes.push_back(unhex(tx_hash));
+    d["tx_hashes"] = std::move(hashes);
+  }
+  return d;
+}
+
+bt_dict bt_service_node(GET_SERVICE_NODES::response::entry& e) {
+  bt_list contributors;
+  for (auto& c : e.contributors)
+    contributors.push_back(bt_dict{
+      {"address", std::move(c.address)},
+      {"amount", c.amount},
+      {"reserved", c.reserved},
+    });
+  auto version = [](const std::array<uint16_t, 3>& v) { return bt_list{{v[0], v[1], v[2]}}; };
+  return bt_dict{
+    {"pubkey", unhex(e.service_node_pubkey)},
+    {"pubkey_ed25519", unhex(e.pubkey_ed25519)},
+    {"pubkey_x25519", unhex(e.pubkey_x25519)},
+    {"registration_height", e.registration_height},
+    {"registration_hf_version", e.registration_hf_version},
+    {"requested_unlock_height", e.requested_unlock_height},
+    {"last_reward_block_height", e.last_reward_block_height},
+    {"last_reward_transaction_index", e.last_reward_transaction_index},
+    {"active", bt_bool(e.active)},
+    {"funded", bt_bool(e.funded)},
+    {"state_height", e.state_height},
+    {"decommission_count", e.decommission_count},
+    {"earned_downtime_blocks", e.earned_downtime_blocks},
+    {"service_node_version", version(e.service_node_version)},
+    {"lokinet_version", version(e.lokinet_version)},
+    {"storage_server_version", version(e.storage_server_version)},
+    {"contributors", std::move(contributors)},
+    {"total_contributed", e.total_contributed},
+    {"total_reserved", e.total_reserved},
+    {"staking_requirement", e.staking_requirement},
+    {"portions_for_operator", e.portions_for_operator},
+    {"swarm_id", e.swarm_id},
+    {"operator_address", std::move(e.operator_address)},
+    {"public_ip", std::move(e.public_ip)},
+    {"storage_port", e.storage_port},
+    {"storage_lmq_port", e.storage_lmq_port},
+    {"quorumnet_port", e.quorumnet_port},
+    {"last_uptime_proof", e.last_uptime_proof},
+    {"storage_server_reachable", bt_bool(e.storage_server_reachable)},
+    {"lokinet_reachable", bt_bool(e.lokinet_reachable)},
+  };
+}
+
 } // end anonymous namespace
 
 
@@ -189,6 +367,7 @@ omq_rpc::omq_rpc(cryptonote::core& core, core_rpc_server& rpc, const boost::prog
   for (auto& cmd : rpc_commands) {
     omq.add_request_command(cmd.second->is_public ? "rpc" : "admin", cmd.first,
         [name=std::string_view{cmd.first}, &call=*cmd.second, this](oxenmq::Message& m) {
+      name_omq_thread();
       if (m.data.size() > 1)
         m.send_reply(LMQ_BAD_REQUEST, "Bad request: RPC commands must have at most one data part "
             "(received " + std::to_string(m.data.size()) + ")");
@@ -230,6 +409,269 @@ omq_rpc::omq_rpc(cryptonote::core& core, core_rpc_server& rpc, const boost::prog
     });
   }
 
+  // [admin.get_metrics] returns the PERF_TIMER latency histograms and event counters in
+  // Prometheus text exposition format (as a single reply part after the status).
+  omq.add_request_command("admin", "get_metrics", [](oxenmq::Message& m) {
+    m.send_reply(LMQ_OK, tools::metrics::prometheus());
+  });
+
+  // [admin.get_pulse_traces] returns the timings of the last Pulse rounds this node took part in,
+  // oldest first, as a bt-encoded list of dicts:
+  // - height, round, node (e.g. "V[3]"), start -- when the round was due to start, in ms since epoch
+  // - stages -- list of [NAME, ENTER, EXIT], in ms relative to `start`
+  // - arrivals -- list of [MESSAGE_TYPE, QUORUM_POSITION, RECEIVED, LATE], with RECEIVED relative to
+  //   `start` and LATE 1 if the message arrived after its stage ended
+  // - stale -- how many valid messages for earlier rounds came in during the round
+  omq.add_request_command("admin", "get_pulse_traces", [](oxenmq::Message& m) {
+    using namespace std::chrono;
+    bt_list traces;
+    for (auto& t : pulse::get_round_traces()) {
+      auto rel = [&t](pulse::time_point when) -> int64_t {
+        return duration_cast<milliseconds>(when - t.start_time).count(); };
+      bt_list stages;
+      for (auto& s : t.stages)
+        stages.push_back(bt_list{std::string{s.name}, rel(s.enter), rel(s.exit)});
+      bt_list arrivals;
+      for (auto& a : t.arrivals)
+        arrivals.push_back(bt_list{std::string{pulse::message_type_string(a.type)}, a.quorum_position, rel(a.received), a.late});
+      traces.push_back(bt_dict{
+        {"height", t.height},
+        {"round", t.round},
+        {"node", std::move(t.node_name)},
+        {"start", duration_cast<milliseconds>(t.start_time.time_since_epoch()).count()},
+        {"stages", std::move(stages)},
+        {"arrivals", std::move(arrivals)},
+        {"stale", t.stale_messages},
+      });
+    }
+    m.send_reply(LMQ_OK, oxenmq::bt_serialize(traces));
+  });
+
+  // [admin.profiler_start, HZ] starts the built-in sampling profiler at HZ samples per second of
+  // CPU time (default 99).  [admin.profiler_collect] replies with the samples taken since the start
+  // or last collect, as collapsed stacks for flamegraph.pl, and keeps sampling;
+  // [admin.profiler_stop] does the same and stops.  See common/profiler.h.
+  omq.add_request_command("admin", "profiler_start", [](oxenmq::Message& m) {
+    unsigned int hz = 99;
+    if (!m.data.empty() && !tools::parse_int(m.data[0], hz))
+      return m.send_reply(LMQ_BAD_REQUEST, "Invalid sampling rate: expected an integer");
+    if (tools::profiler::running())
+      return m.send_reply(LMQ_ERROR, "The profiler is already running");
+    if (!tools::profiler::start(hz))
+      return m.send_reply(LMQ_ERROR, "Unable to start the profiler (it may not be supported on this platform)");
+    m.send_reply(LMQ_OK);
+  });
+  omq.add_request_command("admin", "profiler_collect", [](oxenmq::Message& m) {
+    if (!tools::profiler::running())
+      return m.send_reply(LMQ_ERROR, "The profiler is not running");
+    m.send_reply(LMQ_OK, tools::profiler::collect());
+  });
+  omq.add_request_command("admin", "profiler_stop", [](oxenmq::Message& m) {
+    if (!tools::profiler::running())
+      return m.send_reply(LMQ_ERROR, "The profiler is not running");
+    m.send_reply(LMQ_OK, tools::profiler::stop());
+  });
+
+  // bt-encoded variants of the heavier public commands, for clients that would rather not go
+  // through JSON: [rpc.NAME.bt, DICT] replies [200, DICT], with hashes, keys and blobs as raw bytes.
+  // Errors are replied as for the JSON commands.
+  auto add_bt_command = [&omq, this](std::string name, auto handler) {
+    omq.add_request_command("rpc", name + ".bt", [name, handler=std::move(handler), this](oxenmq::Message& m) {
+      name_omq_thread();
+      try {
+        bt_request req{m};
+        rpc_context context{};
+        context.admin = m.access.auth >= AuthLevel::admin;
+        context.source = rpc_source::omq;
+        context.remote = m.remote;
+        m.send_reply(LMQ_OK, oxenmq::bt_serialize(handler(req, std::move(context))));
+        return;
+      } catch (const parse_error& e) {
+        MINFO("LMQ RPC request 'rpc." << name << ".bt' called with invalid/unparseable data: " << e.what());
+        m.send_reply(LMQ_BAD_REQUEST, "Unable to parse request: "s + e.what());
+        return;
+      } catch (const rpc_error& e) {
+        MWARNING("LMQ RPC request 'rpc." << name << ".bt' failed with: " << e.what());
+        m.send_reply(LMQ_ERROR, e.what());
+        return;
+      } catch (const std::exception& e) {
+        MWARNING("LMQ RPC request 'rpc." << name << ".bt' raised an exception: " << e.what());
+      } catch (...) {
+        MWARNING("LMQ RPC request 'rpc." << name << ".bt' raised an unknown exception");
+      }
+      m.send_reply(LMQ_ERROR, "An exception occured while processing your request");
+    });
+  };
+
+  // [rpc.get_transactions.bt]: {txs: [HASH, ...], prune: 0|1} replies {txs: [TX, ...], missed:
+  // [HASH, ...]}, where each TX has the tx's hash, its non-prunable part ("pruned") and, unless
+  // pruned, its prunable part, along with the details of get_transactions.
+  add_bt_command("get_transactions", [this](const bt_request& req, rpc_context context) {
+    GET_TRANSACTIONS::request r{};
+    r.txs_hashes = req.list_hex("txs", sizeof(crypto::hash));
+    r.prune = req.flag("prune");
+    r.split = true;
+    auto res = rpc_.invoke(std::move(r), std::move(context));
+    check_status(res);
+
+    bt_list txs, missed;
+    for (auto& e : res.txs) {
+      bt_dict tx{
+        {"hash", unhex(e.tx_hash)},
+        {"pruned", unhex(e.pruned_as_hex.value_or(""))},
+        {"size", e.size},
+        {"in_pool", bt_bool(e.in_pool)},
+        {"blink", bt_bool(e.blink)},
+      };
+      if (e.prunable_as_hex)
+        tx["prunable"] = unhex(*e.prunable_as_hex);
+      if (e.prunable_hash)
+        tx["prunable_hash"] = unhex(*e.prunable_hash);
+      if (e.in_pool) {
+        tx["received_timestamp"] = e.received_timestamp;
+        tx["relayed"] = bt_bool(e.relayed);
+        tx["double_spend_seen"] = bt_bool(e.double_spend_seen);
+      } else {
+        tx["block_height"] = e.block_height;
+        tx["block_timestamp"] = e.block_timestamp;
+        tx["output_indices"] = bt_list{e.output_indices.begin(), e.output_indices.end()};
+      }
+      txs.push_back(std::move(tx));
+    }
+    for (auto& hash : res.missed_tx)
+      missed.push_back(unhex(hash));
+    return bt_dict{{"txs", std::move(txs)}, {"missed", std::move(missed)}};
+  });
+
+  // [rpc.get_block_headers_range.bt]: {start: HEIGHT, end: HEIGHT, tx_hashes: 0|1} replies
+  // {headers: [HEADER, ...]}, with the fields of get_block_headers_range's headers (but pow_hash).
+  add_bt_command("get_block_headers_range", [this](const bt_request& req, rpc_context context) {
+    GET_BLOCK_HEADERS_RANGE::request r{};
+    r.start_height = req.integer<uint64_t>("start");
+    r.end_height = req.integer<uint64_t>("end");
+    r.get_tx_hashes = req.flag("tx_hashes");
+    auto res = rpc_.invoke(std::move(r), std::move(context));
+    check_status(res);
+
+    bt_list headers;
+    for (auto& h : res.headers)
+      headers.push_back(bt_block_header(h));
+    return bt_dict{{"headers", std::move(headers)}};
+  });
+
+  // [rpc.get_service_nodes.bt]: {pubkeys: [PUBKEY, ...], active_only: 0|1, changed_since: HASH}
+  // replies {service_nodes: [SN, ...], height: HEIGHT, block_hash: HASH, hardfork: HF}, plus
+  // {delta: 1, removed: [PUBKEY, ...]} for a `changed_since` block the node still has the list of
+  // (see get_service_nodes).  Each SN has the main fields of get_service_nodes, but not the
+  // participation histories.
+  add_bt_command("get_service_nodes", [this](const bt_request& req, rpc_context context) {
+    GET_SERVICE_NODES::request r{};
+    r.service_node_pubkeys = req.list_hex("pubkeys", sizeof(crypto::public_key));
+    r.active_only = req.flag("active_only");
+    r.changed_since_block_hash = req.bytes_hex("changed_since", sizeof(crypto::hash));
+    auto res = rpc_.invoke(std::move(r), std::move(context));
+    check_status(res);
+
+    bt_list sns;
+    for (auto& e : res.service_node_states)
+      sns.push_back(bt_service_node(e));
+    bt_dict d{
+      {"service_nodes", std::move(sns)},
+      {"height", res.height},
+      {"block_hash", unhex(res.block_hash)},
+      {"hardfork", res.hardfork},
+    };
+    if (res.delta) {
+      bt_list removed;
+      for (auto& pk : res.removed)
+        removed.push_back(unhex(pk));
+      d["delta"] = bt_bool(true);
+      d["removed"] = std::move(removed);
+    }
+    return d;
+  });
+
+  // [rpc.get_outs.bt]: {outputs: [INDEX or [AMOUNT, INDEX], ...], txid: 0|1} replies {outs: [OUT,
+  // ...]}, each OUT being {key: KEY, mask: KEY, unlocked: 0|1, height: HEIGHT} (and txid: HASH, if
+  // requested).  A bare INDEX is of the amount 0 (i.e. RingCT) outputs.
+  add_bt_command("get_outs", [this](const bt_request& req, rpc_context context) {
+    GET_OUTPUTS_BIN::request r{};
+    for (auto& o : req.list("outputs")) {
+      auto& out = r.outputs.emplace_back();
+      if (auto* pair = std::get_if<bt_list>(&o)) {
+        if (pair->size() != 2)
+          throw parse_error{"invalid 'outputs' value: expected [AMOUNT, INDEX] pairs"};
+        out.amount = oxenmq::get_int<uint64_t>(pair->front());
+        out.index = oxenmq::get_int<uint64_t>(pair->back());
+      } else {
+        out.amount = 0;
+        out.index = oxenmq::get_int<uint64_t>(o);
+      }
+    }
+    r.get_txid = req.flag("txid");
+    auto res = rpc_.invoke(std::move(r), std::move(context));
+    check_status(res);
+
+    bt_list outs;
+    for (auto& o : res.outs) {
+      bt_dict out{
+        {"key", tools::copy_guts(o.key)},
+        {"mask", tools::copy_guts(o.mask)},
+        {"unlocked", bt_bool(o.unlocked)},
+        {"height", o.height},
+      };
+      if (r.get_txid)
+        out["txid"] = tools::copy_guts(o.txid);
+      outs.push_back(std::move(out));
+    }
+    return bt_dict{{"outs", std::move(outs)}};
+  });
+
+  // [rpc.ons_resolve.bt]: {type: TYPE, name_hash: HASH} replies {encrypted_value: VALUE, nonce:
+  // NONCE}, or an empty dict if the name isn't registered.
+  add_bt_command("ons_resolve", [this](const bt_request& req, rpc_context context) {
+    ONS_RESOLVE::request r{};
+    r.type = req.integer<uint16_t>("type");
+    r.name_hash = req.bytes_hex("name_hash", sizeof(crypto::hash));
+    auto res = rpc_.invoke(std::move(r), std::move(context));
+
+    bt_dict d;
+    if (res.encrypted_value)
+      d["encrypted_value"] = unhex(*res.encrypted_value);
+    if (res.nonce)
+      d["nonce"] = unhex(*res.nonce);
+    return d;
+  });
+
+  // [rpc.ons_resolve_batch.bt]: {names: [[TYPE, HASH], ...]} replies {values: [...]}, with an
+  // {encrypted_value: VALUE, nonce: NONCE} dict (empty if the name isn't registered) for each name,
+  // in order.
+  add_bt_command("ons_resolve_batch", [this](const bt_request& req, rpc_context context) {
+    ONS_RESOLVE_BATCH::request r{};
+    for (auto& n : req.list("names")) {
+      auto* pair = std::get_if<bt_list>(&n);
+      auto* hash = pair && pair->size() == 2 ? std::get_if<std::string>(&pair->back()) : nullptr;
+      if (!hash || hash->size() != sizeof(crypto::hash))
+        throw parse_error{"invalid 'names' value: expected [TYPE, HASH] pairs"};
+      auto& name = r.entries.emplace_back();
+      name.type = oxenmq::get_int<uint16_t>(pair->front());
+      name.name_hash = oxenmq::to_hex(*hash);
+    }
+    auto res = rpc_.invoke(std::move(r), std::move(context));
+    check_status(res);
+
+    bt_list values;
+    for (auto& v : res.entries) {
+      bt_dict d;
+      if (v.encrypted_value)
+        d["encrypted_value"] = unhex(*v.encrypted_value);
+      if (v.nonce)
+        d["nonce"] = unhex(*v.nonce);
+      values.push_back(std::move(d));
+    }
+    return bt_dict{{"values", std::move(values)}};
+  });
+
   // Subscription commands
 
   // The "subscribe" category is for public subscriptions; i.e. anyone on a public RPC node, or
@@ -288,27 +730,61 @@ omq_rpc::omq_rpc(cryptonote::core& core, core_rpc_server& rpc, const boost::prog
     }
   });
 
-  // New block subscriptions: [sub.block].  This sends a notification every time a new block is
-  // added to the blockchain.
+  // New block subscriptions: [sub.block] or [sub.block, full].  This sends a notification every
+  // time a new block is added to the blockchain.
   //
   // TODO: make this support [sub.block, sn] so that we can receive notification only for blocks
   // that change the SN composition.
   //
-  // The subscription request returns the current [height, blockhash] as a reply.
+  // Replies "OK" or, for a renewal of the same type, "ALREADY".
   //
   // The block notification for new blocks consists of a message [notify.block, height, blockhash]
   // containing the latest height/hash.  (Note that blockhash is the hash in bytes, *not* the hex
-  // encoded block hash).
+  // encoded block hash).  For a "full" subscription the same message also has the block blob and
+  // then the blobs of the block's txs, in order: [notify.block, height, blockhash, block, tx...],
+  // so that the subscriber has the whole block without having to go and fetch it.
   omq.add_request_command("sub", "block", [this](oxenmq::Message& m) {
-      std::unique_lock lock{subs_mutex_};
+    bool full = false;
+    if (!m.data.empty()) {
+      if (m.data.size() > 1 || m.data[0] != "full"sv) {
+        m.send_reply("Invalid block subscription type '" + std::string{m.data[0]} + "'");
+        return;
+      }
+      full = true;
+    }
+
+    std::unique_lock lock{subs_mutex_};
     auto expiry = std::chrono::steady_clock::now() + 30min;
-    auto result = block_subs_.emplace(m.conn, block_sub{expiry});
+    auto result = block_subs_.emplace(m.conn, block_sub{expiry, full});
     if (!result.second) {
       result.first->second.expiry = expiry;
-      MTRACE("Renewed block subscription request from conn id " << m.conn << " @ " << m.remote);
+      if (result.first->second.full == full) {
+        MTRACE("Renewed block subscription request from conn id " << m.conn << " @ " << m.remote);
+        m.send_reply("ALREADY");
+        return;
+      }
+      result.first->second.full = full;
+    }
+    MDEBUG("New " << (full ? "full " : "") << "block subscription request from conn " << m.conn << " @ " << m.remote);
+    m.send_reply("OK");
+  });
+
+  // New block digest subscriptions: [sub.block_digest].  Like [sub.block], but each notification
+  // carries what a wallet syncing from block digests needs to scan the block (see
+  // GET_BLOCK_DIGESTS): [notify.block_digest, height, block, digest], where block is the block
+  // blob and digest the packed cryptonote::block_digest::digest of its txs.
+  //
+  // Replies "OK" or, for a renewal, "ALREADY".
+  omq.add_request_command("sub", "block_digest", [this](oxenmq::Message& m) {
+    std::unique_lock lock{subs_mutex_};
+    auto expiry = std::chrono::steady_clock::now() + 30min;
+    auto result = block_digest_subs_.emplace(m.conn, block_sub{expiry});
+    if (!result.second) {
+      result.first->second.expiry = expiry;
+      MTRACE("Renewed block digest subscription request from conn id " << m.conn << " @ " << m.remote);
       m.send_reply("ALREADY");
     } else {
-      MDEBUG("New block subscription request from conn " << m.conn << " @ " << m.remote);
+      MDEBUG("New block digest subscription request from conn " << m.conn << " @ " << m.remote);
       m.send_reply("OK");
     }
   });
@@ -359,8 +835,43 @@ bool omq_rpc::block_added(const block& block, const std::vector<transaction>& tx
 {
   auto& omq = core_.get_omq();
   std::string height = std::to_string(get_block_height(block));
+  std::string_view hash{block.hash.data, sizeof(block.hash.data)};
+  // Serialized on the first full subscriber, from the block and txs we were given (rather than
+  // read back from the db), and then sent to every full subscriber
+  std::vector<std::string> blobs;
   send_notifies(subs_mutex_, block_subs_, "block", [&](auto& conn, auto& sub) {
-    omq.send(conn, "notify.block", height, std::string_view{block.hash.data, sizeof(block.hash.data)});
+    if (!sub.full) {
+      omq.send(conn, "notify.block", height, hash);
+      return;
+    }
+    if (blobs.empty()) {
+      blobs.reserve(1 + txs.size());
+      blobs.push_back(block_to_blob(block));
+      for (auto& tx : txs)
+        blobs.push_back(tx_to_blob(tx));
+    }
+    omq.send(conn, "notify.block", height, hash, oxenmq::send_option::data_parts(blobs.begin(), blobs.end()));
+  });
+
+  // Built on the first subscriber: the miner tx output indices are looked up from the db, which
+  // (hooks being called once the block is added) already has them
+  std::optional<std::pair<std::string, std::string>> blob_digest;
+  bool failed = false;
+  send_notifies(subs_mutex_, block_digest_subs_, "block digest", [&](auto& conn, auto& sub) {
+    if (!blob_digest && !failed) {
+      block_digest::digest digest;
+      if (!core_.get_tx_outputs_gindexs(get_transaction_hash(block.miner_tx), digest.miner_tx_output_indices)) {
+        MERROR("Failed to get the miner tx output indices of block " << block.hash << ", not sending block digest notifications");
+        failed = true;
+        return;
+      }
+      digest.txs.reserve(txs.size());
+      for (auto& tx : txs)
+        digest.txs.push_back(block_digest::make_tx_digest(tx));
+      blob_digest.emplace(block_to_blob(block), block_digest::pack(digest));
+    }
+    if (blob_digest)
+      omq.send(conn, "notify.block_digest", height, blob_digest->first, blob_digest->second);
   });
 
   return true;
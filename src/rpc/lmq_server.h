@@ -54,6 +54,7 @@ class omq_rpc final : public cryptonote::BlockAddedHook {
 
   struct block_sub {
     std::chrono::steady_clock::time_point expiry;
+    bool full = false; // [sub.block, full]: the notifications carry the block and tx blobs
   };
 
   cryptonote::core& core_;
@@ -61,6 +62,7 @@ class omq_rpc final : public cryptonote::BlockAddedHook {
   std::shared_timed_mutex subs_mutex_;
   std::unordered_map<oxenmq::ConnectionID, mempool_sub> mempool_subs_;
   std::unordered_map<oxenmq::ConnectionID, block_sub> block_subs_;
+  std::unordered_map<oxenmq::ConnectionID, block_sub> block_digest_subs_;
 
 public:
   omq_rpc(cryptonote::core& core, core_rpc_server& rpc, const boost::program_options::variables_map& vm);
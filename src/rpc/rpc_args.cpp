@@ -47,6 +47,8 @@ namespace cryptonote
      , rpc_login({"rpc-login", rpc_args::tr("Specify username[:password] required for RPC server"), "", true})
      , confirm_external_bind({"confirm-external-bind", rpc_args::tr("Confirm rpc bind IP value is NOT a loopback (local) IP")})
      , rpc_access_control_origins({"rpc-access-control-origins", rpc_args::tr("Specify a comma separated list of origins to allow cross origin resource sharing"), ""})
+     , rpc_max_batch_size({"rpc-max-batch-size", rpc_args::tr("Maximum number of requests accepted in one JSON-RPC batch request"), 100})
+     , rpc_http_threads({"rpc-http-threads", rpc_args::tr("Number of threads handling HTTP RPC connections (parsing requests and sending responses); the requests themselves run on the worker threads"), 1})
      , zmq_rpc_bind_ip({"zmq-rpc-bind-ip", rpc_args::tr("Deprecated option, ignored."), ""})
      , zmq_rpc_bind_port({"zmq-rpc-bind-port", rpc_args::tr("Deprecated option, ignored."), ""})
   {}
@@ -63,6 +65,8 @@ namespace cryptonote
     command_line::add_arg(desc, arg.rpc_login);
     command_line::add_arg(desc, arg.confirm_external_bind);
     command_line::add_arg(desc, arg.rpc_access_control_origins);
+    command_line::add_arg(desc, arg.rpc_max_batch_size);
+    command_line::add_arg(desc, arg.rpc_http_threads);
     command_line::add_arg(hidden, arg.zmq_rpc_bind_ip);
     command_line::add_arg(hidden, arg.zmq_rpc_bind_port);
   }
@@ -129,6 +133,14 @@ namespace cryptonote
       for (auto& aco : aco_entries) access_control_origins.emplace_back(aco);
     }
 
+    config.max_batch_size = command_line::get_arg(vm, arg.rpc_max_batch_size);
+    if (config.max_batch_size == 0)
+      throw std::runtime_error{"--"s + arg.rpc_max_batch_size.name + tr(" must be at least 1")};
+
+    config.http_threads = command_line::get_arg(vm, arg.rpc_http_threads);
+    if (config.http_threads == 0)
+      throw std::runtime_error{"--"s + arg.rpc_http_threads.name + tr(" must be at least 1")};
+
     return config;
   }
 }
@@ -57,6 +57,8 @@ namespace cryptonote
       const command_line::arg_descriptor<std::string> rpc_login;
       const command_line::arg_descriptor<bool> confirm_external_bind;
       const command_line::arg_descriptor<std::string> rpc_access_control_origins;
+      const command_line::arg_descriptor<size_t> rpc_max_batch_size;
+      const command_line::arg_descriptor<size_t> rpc_http_threads;
       const command_line::arg_descriptor<std::string> zmq_rpc_bind_ip;   // Deprecated & ignored
       const command_line::arg_descriptor<std::string> zmq_rpc_bind_port; // Deprecated & ignored
     };
@@ -73,6 +75,8 @@ namespace cryptonote
     bool use_ipv6;
     bool require_ipv4;
     std::vector<std::string> access_control_origins;
+    size_t max_batch_size; // the most requests accepted in one JSON-RPC batch
+    size_t http_threads; // event loop threads of the HTTP RPC server
     std::optional<tools::login> login; // currently `std::nullopt` if unspecified by user
   };
 }
@@ -0,0 +1,153 @@
+#include "rpc_fair_queue.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace cryptonote::rpc {
+
+  fair_queue::fair_queue(config conf, std::function<void(job)> dispatch)
+    : m_conf{std::move(conf)}, m_dispatch{std::move(dispatch)}
+  {}
+
+  bool fair_queue::submit(const std::string& remote, std::string_view command, double cost, job j)
+  {
+    std::vector<pending> jobs;
+    {
+      std::lock_guard lock{m_mutex};
+      const auto now = std::chrono::steady_clock::now();
+      if (++m_submits_since_prune >= 1000)
+        prune(now);
+
+      auto [it, inserted] = m_remotes.try_emplace(remote);
+      auto& r = it->second;
+      if (inserted)
+      {
+        r.tokens = m_conf.bucket_size;
+        r.refilled = now;
+      }
+      else
+      {
+        r.tokens = std::min(m_conf.bucket_size,
+            r.tokens + m_conf.refill_rate * std::chrono::duration<double>(now - r.refilled).count());
+        r.refilled = now;
+      }
+
+      // A request costing more than the bucket holds still gets in when the bucket isn't empty; the
+      // remote is then in debt until it refills.
+      if (r.tokens <= 0 || r.queue.size() >= m_conf.max_queued_per_remote || m_queued >= m_conf.max_queued)
+        return false;
+      r.tokens -= cost;
+
+      r.queue.push_back({std::move(j), cost, std::string{command}, now});
+      m_queued++;
+      if (!r.active)
+      {
+        r.active = true;
+        m_active.push_back(remote);
+      }
+      jobs = next_jobs();
+    }
+    dispatch_jobs(std::move(jobs));
+    return true;
+  }
+
+  std::vector<fair_queue::pending> fair_queue::next_jobs()
+  {
+    std::vector<pending> jobs;
+    while (m_in_flight < m_conf.max_in_flight && !m_active.empty())
+    {
+      auto& r = m_remotes[m_active.front()];
+      if (r.deficit < r.queue.front().cost)
+      {
+        r.deficit += m_conf.quantum;
+        m_active.splice(m_active.end(), m_active, m_active.begin());
+        continue;
+      }
+      r.deficit -= r.queue.front().cost;
+      jobs.push_back(std::move(r.queue.front()));
+      r.queue.pop_front();
+      m_queued--;
+      m_in_flight++;
+      if (r.queue.empty())
+      {
+        r.deficit = 0;
+        r.active = false;
+        m_active.pop_front();
+      }
+    }
+    return jobs;
+  }
+
+  namespace {
+    // Frees the job's slot once the job has run, or been dropped unrun
+    struct slot_guard {
+      std::function<void()> release;
+      explicit slot_guard(std::function<void()> release) : release{std::move(release)} {}
+      slot_guard(const slot_guard&) = delete;
+      slot_guard& operator=(const slot_guard&) = delete;
+      ~slot_guard() { release(); }
+    };
+  }
+
+  void fair_queue::dispatch_jobs(std::vector<pending> jobs)
+  {
+    for (auto& p : jobs)
+    {
+      auto guard = std::make_shared<slot_guard>([self = shared_from_this()] { self->finished(); });
+      m_dispatch([self = shared_from_this(), guard = std::move(guard), p = std::make_shared<pending>(std::move(p))] {
+        const auto wait = std::chrono::steady_clock::now() - p->queued;
+        {
+          std::lock_guard lock{self->m_mutex};
+          auto& s = self->m_stats[p->command];
+          s.count++;
+          s.total_wait += wait;
+          s.max_wait = std::max(s.max_wait, wait);
+        }
+        p->j();
+      });
+    }
+  }
+
+  void fair_queue::finished()
+  {
+    std::vector<pending> jobs;
+    {
+      std::lock_guard lock{m_mutex};
+      m_in_flight--;
+      jobs = next_jobs();
+    }
+    dispatch_jobs(std::move(jobs));
+  }
+
+  void fair_queue::prune(std::chrono::steady_clock::time_point now)
+  {
+    m_submits_since_prune = 0;
+    for (auto it = m_remotes.begin(); it != m_remotes.end(); )
+    {
+      auto& r = it->second;
+      if (r.queue.empty() && r.tokens + m_conf.refill_rate * std::chrono::duration<double>(now - r.refilled).count() >= m_conf.bucket_size)
+        it = m_remotes.erase(it);
+      else
+        ++it;
+    }
+  }
+
+  std::unordered_map<std::string, fair_queue::command_stats> fair_queue::take_stats()
+  {
+    std::lock_guard lock{m_mutex};
+    return std::exchange(m_stats, {});
+  }
+
+  size_t fair_queue::queued() const
+  {
+    std::lock_guard lock{m_mutex};
+    return m_queued;
+  }
+
+  size_t fair_queue::in_flight() const
+  {
+    std::lock_guard lock{m_mutex};
+    return m_in_flight;
+  }
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cryptonote::rpc {
+
+  /// Sits in front of the worker threads for public RPC requests, so that one remote sending heavy
+  /// requests can't crowd everyone else out.  Each remote has a token bucket of request cost
+  /// (requests over it are refused), and its own queue; at most `max_in_flight` jobs are handed to
+  /// the workers at once, taken from the remotes' queues in turn, weighted by cost (deficit round
+  /// robin), so that a remote with a backlog gets no more than its share of the workers.
+  ///
+  /// Jobs are handed over with the `dispatch` callback, which must eventually invoke or destroy the
+  /// function it is given (e.g. OxenMQ::inject_task); either one frees the job's slot.  The jobs
+  /// hold a reference to the queue, so it must be owned by a shared_ptr.
+  class fair_queue : public std::enable_shared_from_this<fair_queue> {
+  public:
+    struct config {
+      double bucket_size = 200; // the cost a remote can send at once
+      double refill_rate = 50;  // per second
+      size_t max_queued_per_remote = 100;
+      size_t max_queued = 1000;
+      size_t max_in_flight = 4;
+      double quantum = 10; // cost a remote gets to send per round when others are waiting too
+    };
+
+    using job = std::function<void()>;
+
+    fair_queue(config conf, std::function<void(job)> dispatch);
+
+    /// Queues `j` for `remote`, or returns false (dropping it) if the remote is over its rate limit
+    /// or has too many requests queued, or the queue is full.  `command` is for stats only.
+    bool submit(const std::string& remote, std::string_view command, double cost, job j);
+
+    struct command_stats {
+      uint64_t count = 0;
+      std::chrono::steady_clock::duration total_wait{0};
+      std::chrono::steady_clock::duration max_wait{0};
+    };
+    /// Returns the time requests of each command waited between submit() and starting, since the
+    /// last call.
+    std::unordered_map<std::string, command_stats> take_stats();
+
+    size_t queued() const;
+    size_t in_flight() const;
+
+  private:
+    struct pending {
+      job j;
+      double cost;
+      std::string command;
+      std::chrono::steady_clock::time_point queued;
+    };
+    struct remote_state {
+      double tokens;
+      std::chrono::steady_clock::time_point refilled;
+      std::deque<pending> queue;
+      double deficit = 0;
+      bool active = false; // in `m_active`
+    };
+
+    // Takes whatever jobs can run now off the queues; called with the lock held.  The jobs are
+    // dispatched by the caller, after releasing it.
+    std::vector<pending> next_jobs();
+    void dispatch_jobs(std::vector<pending> jobs);
+    void finished();
+    // Forgets remotes with nothing queued and a full bucket (i.e. the same as a new one)
+    void prune(std::chrono::steady_clock::time_point now);
+
+    const config m_conf;
+    const std::function<void(job)> m_dispatch;
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, remote_state> m_remotes;
+    std::list<std::string> m_active; // remotes with something queued, in round robin order
+    size_t m_queued = 0;
+    size_t m_in_flight = 0;
+    size_t m_submits_since_prune = 0;
+    std::unordered_map<std::string, command_stats> m_stats;
+  };
+
+}
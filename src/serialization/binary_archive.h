@@ -35,9 +35,11 @@
 #pragma once
 
 #include <cassert>
+#include <cstring>
 #include <ostream>
 #include <istream>
 #include <iterator>
+#include <stdexcept>
 #include <type_traits>
 #include <string>
 #include <string_view>
@@ -81,19 +83,23 @@ struct binary_archive_nested_object {
 /* \struct binary_unarchiver
  *
  * \brief the deserializer class for a binary archive
+ *
+ * Reads directly from a pointer/length span (rather than going through a std::istream), with
+ * every read bounds-checked against the end of the data.  Running out of data or a malformed
+ * varint throws a std::runtime_error.
  */
 class binary_unarchiver : public deserializer
 {
 public:
   using variant_tag_type = binary_variant_tag_type;
 
-  explicit binary_unarchiver(std::istream& s) : stream_{s} {
-    auto pos = stream_.tellg();
-    stream_.seekg(0, std::ios_base::end);
-    eof_pos_ = stream_.tellg();
-    stream_.seekg(pos);
-    enable_stream_exceptions();
-  }
+  /// Constructs from the data to deserialize.  The caller must keep the referenced data alive for
+  /// the lifetime of the unarchiver!
+  explicit binary_unarchiver(std::string_view s)
+    : begin_{s.data()}, pos_{s.data()}, end_{s.data() + s.size()} {}
+
+  /// Constructing from a std::string temporary is not allowed.
+  binary_unarchiver(const std::string&& s) = delete;
 
   /// Serializes a signed integer (by reinterpreting it as unsigned on the wire)
   template <class T, std::enable_if_t<std::is_integral_v<T> && std::is_signed_v<T>, int> = 0>
@@ -106,7 +112,9 @@ public:
   template <class T, std::enable_if_t<std::is_integral_v<T> && std::is_unsigned_v<T>, int> = 0>
   void serialize_int(T &v)
   {
-    stream_.read(reinterpret_cast<char*>(&v), sizeof(T));
+    require(sizeof(T));
+    std::memcpy(&v, pos_, sizeof(T));
+    pos_ += sizeof(T);
     if constexpr (sizeof(T) > 1)
       boost::endian::little_to_native_inplace(v);
   }
@@ -114,7 +122,9 @@ public:
   /// Serializes binary data of a given size by reading it directly into the given buffer
   void serialize_blob(void* buf, size_t len, [[maybe_unused]] std::string_view delimiter=""sv)
   {
-    stream_.read(static_cast<char*>(buf), len);
+    require(len);
+    std::memcpy(buf, pos_, len);
+    pos_ += len;
   }
 
   /// Serializes an integer using varint encoding
@@ -127,8 +137,13 @@ public:
   template <class T>
   void serialize_uvarint(T &v)
   {
-    using It = std::istreambuf_iterator<char>;
-    if (tools::read_varint(It{stream_}, It{}, v) < 0)
+    // Most varints (sizes, indices, tags) fit in one byte, so decode those without the loop
+    if (pos_ != end_ && static_cast<unsigned char>(*pos_) < 0b1000'0000)
+    {
+      v = static_cast<unsigned char>(*pos_++);
+      return;
+    }
+    if (tools::read_varint(pos_, end_, v) < 0)
       throw std::runtime_error{"deserialization of varint failed"};
   }
 
@@ -155,35 +170,30 @@ public:
   }
 
   /// Returns the number of remaining serialization bytes.  If the given `min_required` is non-zero
-  /// then we also ensure that at least that many bytes are available (and otherwise set the
-  /// stream's failbit to raise an exception).
+  /// then we also ensure that at least that many bytes are available (and otherwise throw).
   size_t remaining_bytes(size_t min_required = 0) {
-    assert(stream_.tellg() <= eof_pos_);
-    size_t remaining = eof_pos_ - stream_.tellg();
+    size_t remaining = end_ - pos_;
     if (remaining < min_required)
-      stream_.setstate(std::istream::eofbit);
+      throw_truncated();
     return remaining;
   }
 
-  // Returns the current position (i.e. stream.tellg()) of the input stream.
-  unsigned int streampos() { return static_cast<unsigned int>(stream_.tellg()); }
+  // Returns the current position (i.e. the number of bytes read so far).
+  unsigned int streampos() { return static_cast<unsigned int>(pos_ - begin_); }
 
-protected:
-  // Protected constructor used by binary_string_unarchiver to avoid the seek (because the istream
-  // hasn't been set up yet when this gets called, and because we know the eof position in advance).
-  // You must call enable_stream_exceptions() in the derived constructor.
-  binary_unarchiver(std::istream& s, std::streamoff eof_pos) : stream_{s}, eof_pos_{eof_pos} {}
+private:
+  void require(size_t len) {
+    if (static_cast<size_t>(end_ - pos_) < len)
+      throw_truncated();
+  }
 
-  // Set up stream exceptions; called during construction.
-  void enable_stream_exceptions() {
-    exc_restore_ = stream_.exceptions();
-    stream_.exceptions(std::istream::badbit | std::istream::failbit | std::istream::eofbit);
+  [[noreturn]] static void throw_truncated() {
+    throw std::runtime_error{"deserialization failed: unexpected end of data"};
   }
 
-private:
-  std::istream& stream_;
-  std::ios_base::iostate exc_restore_;
-  std::streamoff eof_pos_;
+  const char* begin_;
+  const char* pos_;
+  const char* end_;
 };
 
 /* \struct binary_archiver
@@ -259,8 +269,7 @@ public:
 protected:
   // Protected constructor used by binary_string_archiver; this doesn't enable stream exceptions
   // (because they need to be deferred until after the subclass is initialized).  The streamoff
-  // argument is ignored (but mirrors the binary_unarchiver protected constructor).  You must call
-  // enable_stream_exceptions() in the derived constructor.
+  // argument is ignored.  You must call enable_stream_exceptions() in the derived constructor.
   binary_archiver(std::ostream& s, std::streamoff) : stream_{s} {}
 
   // Set up stream exceptions; called during construction.
@@ -31,7 +31,10 @@
 
 #pragma once
 
+#include <stdexcept>
+#include <vector>
 #include "serialization.h"
+#include "binary_archive.h"
 
 namespace serialization
 {
@@ -70,6 +73,18 @@ constexpr bool has_value_insert = false;
 template <typename T>
 constexpr bool has_value_insert<T, std::void_t<decltype(std::declval<T>().insert(typename T::value_type{}))>> = true;
 
+template <typename T>
+constexpr bool is_std_vector = false;
+template <typename T, typename A>
+constexpr bool is_std_vector<std::vector<T, A>> = true;
+
+// True if a C of elements is written by a binary archive as the varint size followed by the
+// elements' bytes back to back, and so can be read or written with a single copy rather than
+// element-by-element: that is, for vectors of binary-serializable (hash, key, etc.) values.
+template <typename Archive, typename C>
+constexpr bool is_bulk_blob_container = is_binary<Archive> && is_std_vector<C> &&
+    binary_serializable<std::remove_cv_t<typename C::value_type>>;
+
 template <typename Archive, class T>
 void serialize_container_element(Archive& ar, T& e)
 {
@@ -89,6 +104,17 @@ void serialize_container(Archive& ar, C& v)
   size_t cnt;
   auto arr = ar.begin_array(cnt);
 
+  if constexpr (detail::is_bulk_blob_container<Archive, C>)
+  {
+    // Unlike the general case below we know exactly how many bytes the elements take, so check
+    // that they are all there before allocating anything.
+    if (cnt > ar.remaining_bytes() / sizeof(T))
+      throw std::runtime_error{"deserialization failed: unexpected end of data"};
+    v.resize(cnt);
+    ar.serialize_blob(v.data(), cnt * sizeof(T));
+    return;
+  }
+
   // very basic sanity check
   // disabled because it is wrong: a type could, for example, pack multiple values into a byte (e.g.
   // something like std::vector<bool> does), in which cases values >= bytes need not be true.
@@ -118,8 +144,11 @@ void serialize_container(Archive& ar, C& v)
 {
   size_t cnt = v.size();
   auto arr = ar.begin_array(cnt);
-  for (auto& e : v)
-    serialize_container_element(arr.element(), e);
+  if constexpr (detail::is_bulk_blob_container<Archive, C>)
+    ar.serialize_blob(v.data(), cnt * sizeof(typename C::value_type));
+  else
+    for (auto& e : v)
+      serialize_container_element(arr.element(), e);
 }
 
 } // namespace detail
@@ -39,9 +39,11 @@
 #include "serialization.h"
 #include "base.h"
 #include <cassert>
-#include <iostream>
-#include <iomanip>
+#include <charconv>
 #include <exception>
+#include <limits>
+#include <string>
+#include <vector>
 #include <oxenmq/hex.h>
 
 namespace serialization {
@@ -52,26 +54,25 @@ using json_variant_tag_type = std::string_view;
  * 
  * \brief a archive using the JSON standard
  *
- * \detailed there is no deserializing counterpart; we only support JSON serializing here.
+ * \detailed there is no deserializing counterpart; we only support JSON serializing here.  Output
+ * is appended directly to a std::string (rather than going through a std::ostream) so that integer
+ * and hex formatting don't pay for stream state (or depend on the stream's locale).
  */
 struct json_archiver : public serializer
 {
   using variant_tag_type = std::string_view;
 
-  json_archiver(std::ostream& s, bool indent = false)
-    : stream_{s}, indent_{indent}
-  {
-    exc_restore_ = stream_.exceptions();
-    stream_.exceptions(std::istream::badbit | std::istream::failbit | std::istream::eofbit);
-  }
-
-  ~json_archiver() { stream_.exceptions(exc_restore_); }
+  explicit json_archiver(std::string& out, bool indent = false)
+    : out_{out}, indent_{indent}
+  {}
 
   void tag(std::string_view tag) {
     if (!object_begin)
-      stream_ << (indent_ ? ", "sv : ","sv);
+      out_ += indent_ ? ", "sv : ","sv;
     make_indent();
-    stream_ << '"' << tag << (indent_ ? "\": "sv : "\":");
+    out_ += '"';
+    out_ += tag;
+    out_ += indent_ ? "\": "sv : "\":"sv;
 
     object_begin = false;
   }
@@ -81,7 +82,7 @@ struct json_archiver : public serializer
     ~nested_object() {
       --ar.depth_;
       ar.make_indent();
-      ar.stream_ << '}';
+      ar.out_ += '}';
     }
 
     nested_object(const nested_object&) = delete;
@@ -92,7 +93,7 @@ struct json_archiver : public serializer
 
   [[nodiscard]] nested_object begin_object()
   {
-    stream_ << '{';
+    out_ += '{';
     ++depth_;
     object_begin = true;
     return nested_object{*this};
@@ -109,14 +110,16 @@ struct json_archiver : public serializer
   template <class T>
   void serialize_int(T v)
   {
-    stream_ << std::dec << promote_to_printable_integer_type(v);
+    write_integer(promote_to_printable_integer_type(v));
   }
 
-  void serialize_blob(void *buf, size_t len, std::string_view delimiter="\""sv) {
-    stream_ << delimiter;
-    auto* begin = static_cast<unsigned char*>(buf);
-    oxenmq::to_hex(begin, begin + len, std::ostreambuf_iterator{stream_});
-    stream_ << delimiter;
+  void serialize_blob(const void *buf, size_t len, std::string_view delimiter="\""sv) {
+    out_ += delimiter;
+    auto* begin = static_cast<const unsigned char*>(buf);
+    const size_t pos = out_.size();
+    out_.resize(pos + 2*len);
+    oxenmq::to_hex(begin, begin + len, out_.data() + pos);
+    out_ += delimiter;
   }
 
   template <typename T>
@@ -127,12 +130,11 @@ struct json_archiver : public serializer
   template <class T>
   void serialize_varint(T &v)
   {
-    stream_ << std::dec << promote_to_printable_integer_type(v);
+    write_integer(promote_to_printable_integer_type(v));
   }
 
   struct nested_array {
     json_archiver& ar;
-    int exc_count = std::uncaught_exceptions();
     bool first = true;
 
     // Call before writing an element to add a delimiter.  The first element() call adds no
@@ -148,15 +150,11 @@ struct json_archiver : public serializer
       return ar;
     }
 
-    ~nested_array() noexcept(false) {
-      if (std::uncaught_exceptions() == exc_count) { // Normal destruction
-        --ar.depth_;
-        if (ar.inner_array_contents_)
-          ar.make_indent();
-        ar.stream_ << ']';
-      }
-      // else we're destructing during a stack unwind so some other serialization failed, thus don't
-      // try terminating the array (since it might *also* throw if an IO error occurs).
+    ~nested_array() {
+      --ar.depth_;
+      if (ar.inner_array_contents_)
+        ar.make_indent();
+      ar.out_ += ']';
     }
 
     // Non-copyable, non-moveable
@@ -172,33 +170,42 @@ struct json_archiver : public serializer
   {
     inner_array_contents_ = s > 0;
     ++depth_;
-    stream_ << '[';
+    out_ += '[';
     return {*this};
   }
 
-  void delimit_array() { stream_ << (indent_ ? ", "sv : ","sv); }
+  void delimit_array() { out_ += indent_ ? ", "sv : ","sv; }
 
   void write_variant_tag(std::string_view t) { tag(t); }
 
-  // Returns the current position (i.e. stream.tellp()) of the output stream.
-  unsigned int streampos() { return static_cast<unsigned int>(stream_.tellp()); }
+  // Returns the current position (i.e. the size of the output written so far, including anything
+  // that was already in the string when the archiver was constructed).
+  unsigned int streampos() { return static_cast<unsigned int>(out_.size()); }
 
 private:
+  template <typename T>
+  void write_integer(T v)
+  {
+    char buf[std::numeric_limits<T>::digits10 + 3]; // +1 for the partial digit, +1 for a sign, +1 spare
+    auto [end, ec] = std::to_chars(std::begin(buf), std::end(buf), v);
+    assert(ec == std::errc{});
+    out_.append(buf, end);
+  }
+
   static constexpr std::string_view indents{"                                "};
   void make_indent()
   {
     if (indent_)
     {
-      stream_ << '\n';
+      out_ += '\n';
       auto in = 2 * depth_;
       for (; in > indents.size(); in -= indents.size())
-        stream_ << indents;
-      stream_ << indents.substr(0, in);
+        out_ += indents;
+      out_ += indents.substr(0, in);
     }
   }
 
-  std::ostream& stream_;
-  std::ios_base::iostate exc_restore_;
+  std::string& out_;
   bool indent_ = false;
   bool object_begin = false;
   bool inner_array_contents_ = false;
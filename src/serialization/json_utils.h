@@ -30,21 +30,23 @@
 
 #pragma once
 
-#include <sstream>
+#include <string>
 #include "json_archive.h"
 
 namespace serialization {
 
-/// Subclass of json_archiver that writes to a std::ostringstream and returns the string on
-/// demand.
+/// Subclass of json_archiver that writes into its own string and returns it on demand.
 class json_string_archiver : public json_archiver {
-  std::ostringstream oss;
+  std::string buf;
 public:
-  /// Constructor; takes no arguments.
-  json_string_archiver() : json_archiver{oss} {}
+  /// Constructor; takes an optional indent argument.
+  explicit json_string_archiver(bool indent = false) : json_archiver{buf, indent} {}
 
-  /// Returns the string from the std::ostringstream
-  std::string str() { return oss.str(); }
+  /// Returns a copy of the output written so far
+  std::string str() const & { return buf; }
+
+  /// Returns the output, moving it out of the archiver
+  std::string str() && { return std::move(buf); }
 };
 
 /*! serializes the data in v to a string.  Throws on error.
@@ -54,7 +56,7 @@ std::string dump_json(T& v)
 {
   json_string_archiver oar;
   serialize(oar, v);
-  return oar.str();
+  return std::move(oar).str();
 }
 
 } // namespace serialization
@@ -101,6 +101,7 @@ using sw = cryptonote::simple_wallet;
 #define EXTENDED_LOGS_FILE "wallet_details.log"
 
 #define OUTPUT_EXPORT_FILE_MAGIC "Loki output export\003"
+#define OUTPUT_EXPORT_STREAM_MAGIC "Loki output export\004"
 
 #define LOCK_IDLE_SCOPE() \
   bool auto_refresh_enabled = m_auto_refresh_enabled.load(std::memory_order_relaxed); \
@@ -201,7 +202,7 @@ namespace
   const char* USAGE_IMPORT_KEY_IMAGES("import_key_images <filename>");
   const char* USAGE_HW_KEY_IMAGES_SYNC("hw_key_images_sync");
   const char* USAGE_HW_RECONNECT("hw_reconnect");
-  const char* USAGE_EXPORT_OUTPUTS("export_outputs [all] <filename>");
+  const char* USAGE_EXPORT_OUTPUTS("export_outputs [all|since=<N>] <filename>");
   const char* USAGE_IMPORT_OUTPUTS("import_outputs <filename>");
   const char* USAGE_SHOW_TRANSFER("show_transfer <txid>");
   const char* USAGE_MAKE_MULTISIG("make_multisig <threshold> <string1> [<string>...]");
@@ -2510,6 +2511,32 @@ bool simple_wallet::set_track_uses(const std::vector<std::string> &args/* = std:
   return true;
 }
 
+bool simple_wallet::set_incremental_cache(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
+{
+  const auto pwd_container = get_and_verify_password();
+  if (pwd_container)
+  {
+    parse_bool_and_use(args[1], [&](bool r) {
+      m_wallet->incremental_cache(r);
+      m_wallet->rewrite(m_wallet_file, pwd_container->password());
+    });
+  }
+  return true;
+}
+
+bool simple_wallet::set_sync_from_digests(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
+{
+  const auto pwd_container = get_and_verify_password();
+  if (pwd_container)
+  {
+    parse_bool_and_use(args[1], [&](bool r) {
+      m_wallet->sync_from_digests(r);
+      m_wallet->rewrite(m_wallet_file, pwd_container->password());
+    });
+  }
+  return true;
+}
+
 bool simple_wallet::set_inactivity_lock_timeout(const std::vector<std::string> &args/* = std::vector<std::string>()*/)
 {
 #ifdef _WIN32
@@ -2797,6 +2824,10 @@ simple_wallet::simple_wallet()
    Ignore outputs of amount below this threshold when spending.
  track-uses <1|0>
    Whether to keep track of owned outputs uses.
+ incremental-cache <1|0>
+   Whether to keep the wallet cache in a database that saving only updates with what changed, rather than rewriting the whole wallet file each time (for very large wallets).
+ sync-from-digests <1|0>
+   Whether to refresh from block digests, fetching only the transactions that concern the wallet rather than every transaction of every block. Needs a daemon that supports it.
  device-name <device_name[:device_spec]>
    Device name for hardware wallet.
  export-format <binary"|"ascii">
@@ -2931,7 +2962,7 @@ Pending or Failed: "failed"|"pending",  "out", Lock, Checkpointed, Time, Amount*
   m_cmd_binder.set_handler("export_outputs",
                            [this](const auto& x) { return export_outputs(x); },
                            tr(USAGE_EXPORT_OUTPUTS),
-                           tr("Export a set of outputs owned by this wallet."));
+                           tr("Export a set of outputs owned by this wallet. With since=<N>, only exports the outputs from the Nth on, where N is the count an earlier export_outputs printed: the wallet importing them must have imported that export already."));
   m_cmd_binder.set_handler("import_outputs",
                            [this](const auto& x) { return import_outputs(x); },
                            tr(USAGE_IMPORT_OUTPUTS),
@@ -3234,6 +3265,8 @@ bool simple_wallet::set_variable(const std::vector<std::string> &args)
     success_msg_writer() << "ignore-outputs-above = " << cryptonote::print_money(m_wallet->ignore_outputs_above());
     success_msg_writer() << "ignore-outputs-below = " << cryptonote::print_money(m_wallet->ignore_outputs_below());
     success_msg_writer() << "track-uses = " << m_wallet->track_uses();
+    success_msg_writer() << "incremental-cache = " << m_wallet->incremental_cache();
+    success_msg_writer() << "sync-from-digests = " << m_wallet->sync_from_digests();
     success_msg_writer() << "device_name = " << m_wallet->device_name();
     success_msg_writer() << "export-format = " << (m_wallet->export_format() == tools::wallet2::ExportFormat::Ascii ? "ascii" : "binary");
     success_msg_writer() << "inactivity-lock-timeout = " << m_wallet->inactivity_lock_timeout().count()
@@ -3292,6 +3325,8 @@ bool simple_wallet::set_variable(const std::vector<std::string> &args)
     CHECK_SIMPLE_VARIABLE("ignore-outputs-above", set_ignore_outputs_above, tr("amount"));
     CHECK_SIMPLE_VARIABLE("ignore-outputs-below", set_ignore_outputs_below, tr("amount"));
     CHECK_SIMPLE_VARIABLE("track-uses", set_track_uses, tr("0 or 1"));
+    CHECK_SIMPLE_VARIABLE("incremental-cache", set_incremental_cache, tr("0 or 1"));
+    CHECK_SIMPLE_VARIABLE("sync-from-digests", set_sync_from_digests, tr("0 or 1"));
     CHECK_SIMPLE_VARIABLE("inactivity-lock-timeout", set_inactivity_lock_timeout, tr("unsigned integer (seconds, 0 to disable)"));
     CHECK_SIMPLE_VARIABLE("device-name", set_device_name, tr("<device_name[:device_spec]>"));
     CHECK_SIMPLE_VARIABLE("export-format", set_export_format, tr("\"binary\" or \"ascii\""));
@@ -9931,10 +9966,19 @@ bool simple_wallet::export_outputs(const std::vector<std::string> &args)
 
   int filename_index = 0;
   bool all           = false;
-  if (args.size() == 2 && args[0] == "all")
+  std::optional<size_t> since;
+  if (args.size() == 2)
   {
     filename_index++;
-    all = true;
+    if (args[0] == "all")
+      all = true;
+    else if (size_t n; tools::starts_with(args[0], "since=") && tools::parse_int(args[0].substr(6), n))
+      since = n;
+    else
+    {
+      PRINT_USAGE(USAGE_EXPORT_OUTPUTS);
+      return true;
+    }
   }
 
   const fs::path filename = fs::u8path(args[filename_index]);
@@ -9943,11 +9987,18 @@ bool simple_wallet::export_outputs(const std::vector<std::string> &args)
 
   SCOPED_WALLET_UNLOCK();
 
+  size_t n_outputs;
   try
   {
-    std::string data = m_wallet->export_outputs_to_str(all);
-    bool r = m_wallet->save_to_file(filename, data);
-    if (!r)
+    fs::ofstream file{filename, std::ios_base::binary | std::ios_base::trunc};
+    if (!file)
+    {
+      fail_msg_writer() << tr("failed to save file ") << filename.u8string();
+      return true;
+    }
+    n_outputs = m_wallet->export_outputs_to_stream(file, all, since);
+    file.close();
+    if (!file)
     {
       fail_msg_writer() << tr("failed to save file ") << filename.u8string();
       return true;
@@ -9960,7 +10011,8 @@ bool simple_wallet::export_outputs(const std::vector<std::string> &args)
     return true;
   }
 
-  success_msg_writer() << tr("Outputs exported to ") << filename.u8string();
+  success_msg_writer() << tr("Outputs exported to ") << filename.u8string()
+    << " (" << n_outputs << tr(" outputs in all; export_outputs since=") << n_outputs << tr(" exports only newer ones)");
   return true;
 }
 //----------------------------------------------------------------------------------------------------
@@ -9978,9 +10030,8 @@ bool simple_wallet::import_outputs(const std::vector<std::string> &args)
   }
   const fs::path filename = fs::u8path(args[0]);
 
-  std::string data;
-  bool r = m_wallet->load_from_file(filename, data);
-  if (!r)
+  fs::ifstream file{filename, std::ios_base::binary};
+  if (!file)
   {
     fail_msg_writer() << tr("failed to read file ") << filename.u8string();
     return true;
@@ -9989,7 +10040,25 @@ bool simple_wallet::import_outputs(const std::vector<std::string> &args)
   try
   {
     SCOPED_WALLET_UNLOCK();
-    size_t n_outputs = m_wallet->import_outputs_from_str(data);
+    size_t n_outputs;
+    // Streamed exports are imported as they are read; older ones all at once
+    std::string magic(sizeof(OUTPUT_EXPORT_STREAM_MAGIC) - 1, '\0');
+    if (file.read(&magic[0], magic.size()) && magic == OUTPUT_EXPORT_STREAM_MAGIC)
+    {
+      file.seekg(0);
+      n_outputs = m_wallet->import_outputs_from_stream(file);
+    }
+    else
+    {
+      file.close();
+      std::string data;
+      if (!m_wallet->load_from_file(filename, data))
+      {
+        fail_msg_writer() << tr("failed to read file ") << filename.u8string();
+        return true;
+      }
+      n_outputs = m_wallet->import_outputs_from_str(data);
+    }
     success_msg_writer() << boost::lexical_cast<std::string>(n_outputs) << " outputs imported";
   }
   catch (const std::exception &e)
@@ -44,6 +44,7 @@
 #include "common_defines.h"
 #include "common/util.h"
 #include "common/fs.h"
+#include "common/threadpool.h"
 
 #include "mnemonics/electrum-words.h"
 #include "mnemonics/english.h"
@@ -300,6 +301,20 @@ struct Wallet2CallbackImpl : public tools::i_wallet2_callback
       }
     }
 
+    void on_import_key_images_progress(size_t verified, size_t checked, size_t total) override
+    {
+      if (m_listener) {
+        m_listener->onImportKeyImagesProgress(verified, checked, total);
+      }
+    }
+
+    void on_sign_tx_progress(size_t done, size_t total) override
+    {
+      if (m_listener) {
+        m_listener->onSignTxProgress(done, total);
+      }
+    }
+
     WalletListener * m_listener;
     WalletImpl     * m_wallet;
 };
@@ -453,6 +468,7 @@ WalletImpl::WalletImpl(NetworkType nettype, uint64_t kdf_rounds)
     , m_rebuildWalletCache(false)
     , m_is_connected(false)
     , m_refreshShouldRescan(false)
+    , m_backgroundSync(false)
 {
     m_wallet.reset(new tools::wallet2(static_cast<cryptonote::network_type>(nettype), kdf_rounds, true));
     m_history.reset(new TransactionHistoryImpl(this));
@@ -1214,6 +1230,50 @@ int WalletImpl::autoRefreshInterval() const
     return m_refreshIntervalMillis;
 }
 
+EXPORT
+void WalletImpl::setBackgroundSync(bool enable, unsigned maxThreads, uint64_t batchBlocks)
+{
+    // Not while a refresh is using the settings (or the threadpool)
+    std::lock_guard guard{m_refreshMutex2};
+    if (enable) {
+        if (!m_backgroundSync)
+            m_syncFromDigestsBeforeBackgroundSync = m_wallet->sync_from_digests();
+        // Only in memory: store() doesn't rewrite the keys file this setting lives in
+        m_wallet->sync_from_digests(true);
+        m_wallet->refresh_max_blocks(batchBlocks);
+        m_wallet->sync_batch_size(batchBlocks);
+        if (maxThreads > 0) {
+            tools::threadpool::set_threads(tools::threadpool::domain::verify, maxThreads);
+            m_backgroundSyncThreads = true;
+        }
+        LOG_PRINT_L1(__FUNCTION__ << ": background sync on, " << batchBlocks << " blocks per batch, "
+                << (maxThreads > 0 ? std::to_string(maxThreads) : "default") << " worker threads");
+    } else if (m_backgroundSync) {
+        m_wallet->sync_from_digests(m_syncFromDigestsBeforeBackgroundSync);
+        m_wallet->refresh_max_blocks(0);
+        m_wallet->sync_batch_size(0);
+        if (m_backgroundSyncThreads) {
+            tools::threadpool::set_threads(tools::threadpool::domain::verify, 0);
+            m_backgroundSyncThreads = false;
+        }
+        LOG_PRINT_L1(__FUNCTION__ << ": background sync off");
+    }
+    m_backgroundSync = enable;
+}
+
+EXPORT
+bool WalletImpl::backgroundSync() const
+{
+    return m_backgroundSync;
+}
+
+EXPORT
+BackgroundSyncProgress WalletImpl::backgroundSyncProgress() const
+{
+    std::lock_guard lock{m_backgroundSyncMutex};
+    return m_backgroundSyncProgress;
+}
+
 UnsignedTransaction* WalletImpl::loadUnsignedTx(std::string_view unsigned_filename_) {
   auto unsigned_filename = fs::u8path(unsigned_filename_);
   clearStatus();
@@ -2266,7 +2326,10 @@ void WalletImpl::doRefresh()
             if (m_wallet->light_wallet() || daemonSynced()) {
                 if(rescan)
                     m_wallet->rescan_blockchain(false);
-                m_wallet->refresh(trustedDaemon());
+                if (m_backgroundSync)
+                    doBackgroundSyncRefresh();
+                else
+                    m_wallet->refresh(trustedDaemon());
                 if (!m_synchronized) {
                     m_synchronized = true;
                 }
@@ -2292,6 +2355,38 @@ void WalletImpl::doRefresh()
 }
 
 
+void WalletImpl::doBackgroundSyncRefresh()
+{
+    const uint64_t batch = m_wallet->refresh_max_blocks();
+    for (;;) {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t fetched = 0;
+        bool received_money = false;
+        m_wallet->refresh(trustedDaemon(), 0, fetched, received_money);
+        // Checkpoint, so that being killed before the next batch costs at most one batch
+        if (fetched > 0)
+            m_wallet->store();
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::string err;
+        const uint64_t daemon_height = m_wallet->get_daemon_blockchain_height(err);
+        const uint64_t height = m_wallet->get_blockchain_current_height();
+        {
+            std::lock_guard lock{m_backgroundSyncMutex};
+            auto& p = m_backgroundSyncProgress;
+            p.blocksRemaining = err.empty() && daemon_height > height ? daemon_height - height : 0;
+            if (p.blocksRemaining == 0)
+                p.secondsRemaining = 0;
+            else if (fetched > 0 && elapsed > 0)
+                p.secondsRemaining = p.blocksRemaining * elapsed / fetched;
+        }
+
+        // Fewer blocks than the limit means refresh got to the top (or was stopped)
+        if (batch == 0 || fetched < batch || !m_backgroundSync || m_refreshThreadDone)
+            break;
+    }
+}
+
 EXPORT
 void WalletImpl::startRefresh()
 {
@@ -111,6 +111,9 @@ public:
     void rescanBlockchainAsync() override;    
     void setAutoRefreshInterval(int millis) override;
     int autoRefreshInterval() const override;
+    void setBackgroundSync(bool enable, unsigned maxThreads, uint64_t batchBlocks) override;
+    bool backgroundSync() const override;
+    BackgroundSyncProgress backgroundSyncProgress() const override;
     void setRefreshFromBlockHeight(uint64_t refresh_from_block_height) override;
     uint64_t getRefreshFromBlockHeight() const override { return m_wallet->get_refresh_from_block_height(); };
     void setRecoveringFromSeed(bool recoveringFromSeed) override;
@@ -213,6 +216,8 @@ private:
     bool setStatus(int status, std::string message) const;
     void refreshThreadFunc();
     void doRefresh();
+    // Refreshes in batches of the background sync block limit, storing the wallet after each
+    void doBackgroundSyncRefresh();
     bool daemonSynced() const;
     void stopRefresh();
     bool isNewWallet() const;
@@ -252,6 +257,13 @@ private:
     std::thread       m_refreshThread;
     std::thread       m_longPollThread;
 
+    // low-power background sync; the settings are changed under m_refreshMutex2
+    std::atomic<bool> m_backgroundSync;
+    bool              m_backgroundSyncThreads = false; // true if we limited the worker threads
+    bool              m_syncFromDigestsBeforeBackgroundSync = false;
+    mutable std::mutex m_backgroundSyncMutex;
+    BackgroundSyncProgress m_backgroundSyncProgress;
+
     // flag indicating wallet is recovering from seed
     // so it shouldn't be considered as new and pull blocks (slow-refresh)
     // instead of pulling hashes (fast-refresh)
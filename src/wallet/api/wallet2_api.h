@@ -330,6 +330,16 @@ protected:
     bool m_indeterminate;
 };
 
+/**
+ * @brief Where a background sync (see Wallet::setBackgroundSync) stands, as of its last batch
+ */
+struct BackgroundSyncProgress {
+    BackgroundSyncProgress() : blocksRemaining(0), secondsRemaining(-1) {}
+
+    uint64_t blocksRemaining;   // blocks between the wallet and the daemon's height
+    double secondsRemaining;    // estimated from the speed of the last batch; negative if unknown
+};
+
 struct Wallet;
 struct WalletListener
 {
@@ -402,6 +412,19 @@ struct WalletListener
      */
     virtual void onDeviceProgress(const DeviceProgress & event) { (void)event; };
 
+    /**
+     * @brief Signalizes the progress of a key image import: how many of the `total` key images have
+     *        had their signature verified, and have been checked for being spent
+     */
+    virtual void onImportKeyImagesProgress(uint64_t verified, uint64_t checked, uint64_t total) { (void)verified; (void)checked; (void)total; };
+
+    /**
+     * @brief Signalizes the progress of signing an unsigned tx set: `done` of its `total` txs are
+     *        signed.  Txs may be signed in parallel, so this can come from several threads (though
+     *        never at the same time).
+     */
+    virtual void onSignTxProgress(uint64_t done, uint64_t total) { (void)done; (void)total; };
+
     /**
      * @brief If the listener is created before the wallet this enables to set created wallet object
      */
@@ -713,6 +736,31 @@ struct Wallet
      */
     virtual int autoRefreshInterval() const = 0;
 
+    /**
+     * @brief setBackgroundSync - switches refreshing to (or back from) a low-power mode, for a
+     *        mobile app syncing while in the background.  In it, the wallet syncs from block digests
+     *        (pulling only the txs that concern it), uses at most `maxThreads` worker threads, and
+     *        syncs `batchBlocks` blocks at a time, storing the wallet after each batch so that
+     *        little work is lost if the OS kills the app.  Leaving the mode restores the previous
+     *        settings.  The thread limit applies to the whole process, and should be changed while
+     *        nothing else uses the wallet.
+     * @param enable - true to enter the mode, false to leave it
+     * @param maxThreads - the most worker threads to scan with; 0 leaves the thread count alone
+     * @param batchBlocks - blocks per daemon request and between stores; 0 for no limit
+     */
+    virtual void setBackgroundSync(bool enable, unsigned maxThreads = 1, uint64_t batchBlocks = 100) = 0;
+
+    /**
+     * @brief backgroundSync - returns true if refreshing is in the low-power mode
+     */
+    virtual bool backgroundSync() const = 0;
+
+    /**
+     * @brief backgroundSyncProgress - how much is left to sync, as of the last batch of a refresh
+     *        in the low-power mode
+     */
+    virtual BackgroundSyncProgress backgroundSyncProgress() const = 0;
+
     /**
      * @brief addSubaddressAccount - appends a new subaddress account at the end of the last major index of existing subaddress accounts
      * @param label - the label for the new account (which is the as the label of the primary address (accountIndex,0))
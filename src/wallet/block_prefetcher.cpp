@@ -0,0 +1,176 @@
+// Copyright (c) 2021, The Oxen Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "block_prefetcher.h"
+
+#undef OXEN_DEFAULT_LOG_CATEGORY
+#define OXEN_DEFAULT_LOG_CATEGORY "wallet.wallet2"
+
+namespace tools
+{
+
+block_prefetcher::block_prefetcher(wallet2& wallet, std::list<crypto::hash> short_chain_history, size_t max_ahead)
+  : m_wallet{wallet}, m_short_chain_history{std::move(short_chain_history)},
+    // Matching digests takes the view key, which a device doesn't give out
+    m_digests{wallet.sync_from_digests() && wallet.get_account().get_device().get_type() == hw::device::SOFTWARE},
+    m_max_ahead{std::max<size_t>(1, max_ahead)}
+{
+  m_thread = std::thread{[this] { run(); }};
+}
+
+block_prefetcher::~block_prefetcher()
+{
+  {
+    std::lock_guard lock{m_mutex};
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  m_thread.join();
+  // The tx parsing jobs of the spans nobody took refer to them
+  for (auto& s : m_ready)
+    s->parsing.wait(nullptr);
+}
+
+std::unique_ptr<block_prefetcher::span> block_prefetcher::next()
+{
+  std::unique_ptr<span> s;
+  {
+    std::unique_lock lock{m_mutex};
+    m_cv.wait(lock, [this] { return !m_ready.empty() || m_done; });
+    if (m_ready.empty())
+      return nullptr;
+    s = std::move(m_ready.front());
+    m_ready.pop_front();
+  }
+  m_cv.notify_all();
+
+  s->parsing.wait(&threadpool::getInstance());
+  if (s->error)
+    std::rethrow_exception(s->error);
+  THROW_WALLET_EXCEPTION_IF(s->parse_error, error::wallet_internal_error,
+      "Failed to parse transactions of blocks from height " + std::to_string(s->start_height));
+  return s;
+}
+
+void block_prefetcher::run()
+{
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  bool first = true;
+  uint64_t prev_start_height = 0;
+  std::vector<crypto::hash> prev_tail;
+  while (true)
+  {
+    {
+      std::unique_lock lock{m_mutex};
+      m_cv.wait(lock, [this] { return m_stop || m_ready.size() < m_max_ahead; });
+      if (m_stop)
+        break;
+    }
+
+    auto s = std::make_unique<span>();
+    bool done = false;
+    try
+    {
+      // the last 3 blocks of the previous span should be enough to guard against a block or two's reorg
+      wallet2::drop_from_short_history(m_short_chain_history, 3);
+      for (const auto& h : prev_tail)
+        m_short_chain_history.push_front(h);
+
+      std::vector<cryptonote::rpc::GET_BLOCKS_FAST::block_output_indices> o_indices;
+      uint64_t current_height;
+      if (m_digests)
+      {
+        m_wallet.pull_block_digests(s->start_height, m_short_chain_history, s->blocks, s->digests, current_height);
+        o_indices.resize(s->blocks.size()); // the miner tx's come with the digests
+      }
+      else
+        m_wallet.pull_blocks(0, s->start_height, m_short_chain_history, s->blocks, o_indices, current_height);
+      THROW_WALLET_EXCEPTION_IF(s->blocks.size() != o_indices.size(), error::wallet_internal_error, "Mismatched sizes of blocks and o_indices");
+
+      // Nothing (new) from the daemon: the previous span was the last one
+      if (s->blocks.empty() || (!first && s->start_height == prev_start_height))
+      {
+        std::lock_guard lock{m_mutex};
+        m_done = true;
+        m_cv.notify_all();
+        break;
+      }
+
+      // The block hashes are all the next request needs, so we parse the blocks here and leave
+      // their txes to the threadpool while we fetch the next span.
+      threadpool::waiter waiter;
+      s->parsed_blocks.resize(s->blocks.size());
+      for (size_t i = 0; i < s->blocks.size(); ++i)
+        tpool.submit(&waiter, [&, i] {
+          auto& pb = s->parsed_blocks[i];
+          m_wallet.parse_block_round(s->blocks[i].block, pb.block, pb.hash, pb.error);
+        }, true);
+      waiter.wait(&tpool);
+      for (size_t i = 0; i < s->blocks.size(); ++i)
+      {
+        THROW_WALLET_EXCEPTION_IF(s->parsed_blocks[i].error, error::wallet_internal_error,
+            "Failed to parse block at height " + std::to_string(s->start_height + i));
+        s->parsed_blocks[i].o_indices = std::move(o_indices[i]);
+      }
+      s->last = cryptonote::get_block_height(s->parsed_blocks.back().block) + 1 == current_height;
+
+      prev_tail.clear();
+      for (auto it = s->parsed_blocks.begin() + (s->parsed_blocks.size() - std::min<size_t>(3, s->parsed_blocks.size())); it != s->parsed_blocks.end(); ++it)
+        prev_tail.push_back(it->hash);
+      prev_start_height = s->start_height;
+      first = false;
+
+      span* sp = s.get();
+      for (size_t i = 0; i < sp->blocks.size(); ++i)
+      {
+        sp->parsed_blocks[i].txes.resize(sp->blocks[i].txs.size());
+        for (size_t j = 0; j < sp->blocks[i].txs.size(); ++j)
+          tpool.submit(&sp->parsing, [sp, i, j] {
+            if (!cryptonote::parse_and_validate_tx_base_from_blob(sp->blocks[i].txs[j], sp->parsed_blocks[i].txes[j]))
+              sp->parse_error = true;
+          }, true);
+      }
+      done = s->last;
+    }
+    catch (...)
+    {
+      s->error = std::current_exception();
+      done = true;
+    }
+
+    std::lock_guard lock{m_mutex};
+    m_ready.push_back(std::move(s));
+    m_done = done;
+    m_cv.notify_all();
+    if (done)
+      break;
+  }
+}
+
+}
@@ -0,0 +1,104 @@
+// Copyright (c) 2021, The Oxen Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "common/threadpool.h"
+#include "wallet2.h"
+
+namespace tools
+{
+  // Fetches the spans of blocks of a refresh on a thread of its own, so that there is always a
+  // request to the daemon in flight: while span N is being scanned, the txes of span N+1 are being
+  // parsed (on the threadpool) and span N+2 is being fetched.  At most `max_ahead` fetched spans
+  // wait for the scanner, which bounds the memory used when scanning is the slower side.
+  //
+  // The daemon chooses how many blocks a span holds (up to GET_BLOCKS_FAST::MAX_COUNT, or less
+  // once the response gets large), so it is the number of requests kept in flight, rather than the
+  // size of each, that hides the latency of a remote daemon.
+  class block_prefetcher
+  {
+  public:
+    struct span
+    {
+      uint64_t start_height = 0;
+      std::vector<cryptonote::block_complete_entry> blocks;
+      std::vector<wallet2::parsed_block> parsed_blocks;
+      // One per block if the span was pulled as block digests (see wallet2::sync_from_digests()), in
+      // which case `blocks` and `parsed_blocks` have no txes
+      std::vector<cryptonote::block_digest::digest> digests;
+      // True if the span reaches the daemon's height
+      bool last = false;
+
+    private:
+      friend class block_prefetcher;
+      std::exception_ptr error;
+      threadpool::waiter parsing;
+      std::atomic<bool> parse_error{false};
+    };
+
+    // Starts fetching from the blocks following `short_chain_history`, through `wallet`.  The
+    // wallet's blockchain is not consulted: each span is requested from the hashes of the last
+    // blocks of the previous one, as wallet2::refresh() always did.
+    block_prefetcher(wallet2& wallet, std::list<crypto::hash> short_chain_history, size_t max_ahead = 2);
+    // Stops fetching, waiting for the request in flight (if any)
+    ~block_prefetcher();
+    block_prefetcher(const block_prefetcher&) = delete;
+    block_prefetcher& operator=(const block_prefetcher&) = delete;
+
+    // Waits for the next span, with its txes parsed.  Returns nullptr once there are no more
+    // blocks; rethrows whatever fetching or parsing the span threw (after which it returns
+    // nullptr).
+    std::unique_ptr<span> next();
+
+  private:
+    void run();
+
+    wallet2& m_wallet;
+    std::list<crypto::hash> m_short_chain_history;
+    const bool m_digests;
+    const size_t m_max_ahead;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<std::unique_ptr<span>> m_ready;
+    bool m_done = false;
+    bool m_stop = false;
+    std::thread m_thread;
+  };
+}
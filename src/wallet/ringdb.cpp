@@ -143,18 +143,10 @@ static std::string decrypt(const std::string &ciphertext, const crypto::key_imag
   return plaintext;
 }
 
-static void store_relative_ring(MDB_txn *txn, MDB_dbi &dbi, const crypto::key_image &key_image, const std::vector<uint64_t> &relative_ring, const crypto::chacha_key &chacha_key)
+static void add_relative_ring(std::map<std::string, std::string> &rings, const crypto::key_image &key_image, const std::vector<uint64_t> &relative_ring, const crypto::chacha_key &chacha_key)
 {
-  MDB_val key, data;
-  std::string key_ciphertext = encrypt(key_image, chacha_key, 0);
-  key.mv_data = (void*)key_ciphertext.data();
-  key.mv_size = key_ciphertext.size();
   std::string compressed_ring = compress_ring(relative_ring, V1TAG);
-  std::string data_ciphertext = encrypt(compressed_ring, key_image, chacha_key, 1);
-  data.mv_size = data_ciphertext.size();
-  data.mv_data = (void*)data_ciphertext.c_str();
-  int dbr = mdb_put(txn, dbi, &key, &data, 0);
-  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to set ring for key image in LMDB table: " + std::string(mdb_strerror(dbr)));
+  rings[encrypt(key_image, chacha_key, 0)] = encrypt(compressed_ring, key_image, chacha_key, 1);
 }
 
 static int resize_env(MDB_env *env, const fs::path& db_path, size_t needed)
@@ -200,7 +192,7 @@ static size_t get_ring_data_size(size_t n_entries)
   return n_entries * (32 + 1024); // highball 1kB for the ring data to make sure
 }
 
-enum { BLACKBALL_BLACKBALL, BLACKBALL_UNBLACKBALL, BLACKBALL_QUERY, BLACKBALL_CLEAR};
+enum { BLACKBALL_BLACKBALL, BLACKBALL_UNBLACKBALL, BLACKBALL_CLEAR};
 
 namespace tools
 {
@@ -240,6 +232,8 @@ ringdb::ringdb(fs::path fn_, const std::string &genesis) : filename_{std::move(f
   dbr = mdb_txn_commit(txn);
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to commit txn creating/opening database: " + std::string(mdb_strerror(dbr)));
   tx_active = false;
+
+  sync_blackballs();
 }
 
 ringdb::~ringdb()
@@ -251,6 +245,11 @@ void ringdb::close()
 {
   if (env)
   {
+    if (batch_)
+    {
+      try { end_batch(); }
+      catch (const std::exception &e) { MERROR("Failed to write pending rings: " << e.what()); }
+    }
     mdb_dbi_close(env, dbi_rings);
     mdb_dbi_close(env, dbi_blackballs);
     mdb_env_close(env);
@@ -258,19 +257,65 @@ void ringdb::close()
   }
 }
 
-bool ringdb::add_rings(const crypto::chacha_key &chacha_key, const cryptonote::transaction_prefix &tx)
+void ringdb::begin_batch()
+{
+  batch_ = true;
+}
+
+void ringdb::end_batch()
+{
+  batch_ = false;
+  auto rings = std::move(batch_rings_);
+  batch_rings_.clear();
+  if (!rings.empty())
+    write_rings(rings);
+}
+
+void ringdb::put_rings(std::map<std::string, std::string> &&rings)
+{
+  if (!batch_)
+    return write_rings(rings);
+  if (batch_rings_.empty())
+    batch_rings_ = std::move(rings);
+  else
+    for (auto &[key, data]: rings)
+      batch_rings_[key] = std::move(data);
+}
+
+void ringdb::write_rings(const std::map<std::string, std::string> &rings)
 {
   MDB_txn *txn;
   int dbr;
   bool tx_active = false;
 
-  dbr = resize_env(env, filename_, get_ring_data_size(tx.vin.size()));
+  dbr = resize_env(env, filename_, get_ring_data_size(rings.size()));
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to set env map size");
   dbr = mdb_txn_begin(env, NULL, 0, &txn);
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
   OXEN_DEFER { if (tx_active) mdb_txn_abort(txn); };
   tx_active = true;
 
+  for (const auto &[key_ciphertext, data_ciphertext]: rings)
+  {
+    MDB_val key, data;
+    key.mv_data = (void*)key_ciphertext.data();
+    key.mv_size = key_ciphertext.size();
+    data.mv_data = (void*)data_ciphertext.data();
+    data.mv_size = data_ciphertext.size();
+    dbr = mdb_put(txn, dbi_rings, &key, &data, 0);
+    THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to set ring for key image in LMDB table: " + std::string(mdb_strerror(dbr)));
+  }
+
+  const mdb_size_t txnid = mdb_txn_id(txn);
+  dbr = mdb_txn_commit(txn);
+  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to commit txn adding ring to database: " + std::string(mdb_strerror(dbr)));
+  tx_active = false;
+  committed(txnid);
+}
+
+bool ringdb::add_rings(const crypto::chacha_key &chacha_key, const cryptonote::transaction_prefix &tx)
+{
+  std::map<std::string, std::string> rings;
   for (const auto &in: tx.vin)
   {
     if (!std::holds_alternative<cryptonote::txin_to_key>(in))
@@ -280,12 +325,11 @@ bool ringdb::add_rings(const crypto::chacha_key &chacha_key, const cryptonote::t
     if (ring_size == 1)
       continue;
 
-    store_relative_ring(txn, dbi_rings, txin.k_image, txin.key_offsets, chacha_key);
+    add_relative_ring(rings, txin.k_image, txin.key_offsets, chacha_key);
   }
 
-  dbr = mdb_txn_commit(txn);
-  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to commit txn adding ring to database: " + std::string(mdb_strerror(dbr)));
-  tx_active = false;
+  if (!rings.empty())
+    put_rings(std::move(rings));
   return true;
 }
 
@@ -308,6 +352,7 @@ bool ringdb::remove_rings(const crypto::chacha_key &chacha_key, const std::vecto
     std::string key_ciphertext = encrypt(key_image, chacha_key, 0);
     key.mv_data = (void*)key_ciphertext.data();
     key.mv_size = key_ciphertext.size();
+    batch_rings_.erase(key_ciphertext);
 
     dbr = mdb_get(txn, dbi_rings, &key, &data);
     THROW_WALLET_EXCEPTION_IF(dbr && dbr != MDB_NOTFOUND, tools::error::wallet_internal_error, "Failed to look for key image in LMDB table: " + std::string(mdb_strerror(dbr)));
@@ -320,9 +365,11 @@ bool ringdb::remove_rings(const crypto::chacha_key &chacha_key, const std::vecto
     THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to remove ring to database: " + std::string(mdb_strerror(dbr)));
   }
 
+  const mdb_size_t txnid = mdb_txn_id(txn);
   dbr = mdb_txn_commit(txn);
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to commit txn removing ring to database: " + std::string(mdb_strerror(dbr)));
   tx_active = false;
+  committed(txnid);
   return true;
 }
 
@@ -345,65 +392,55 @@ bool ringdb::remove_rings(const crypto::chacha_key &chacha_key, const cryptonote
 
 bool ringdb::get_ring(const crypto::chacha_key &chacha_key, const crypto::key_image &key_image, std::vector<uint64_t> &outs)
 {
-  MDB_txn *txn;
-  int dbr;
-  bool tx_active = false;
+  std::string key_ciphertext = encrypt(key_image, chacha_key, 0);
+  std::string data_ciphertext;
+  if (auto it = batch_rings_.find(key_ciphertext); it != batch_rings_.end())
+    data_ciphertext = it->second;
+  else
+  {
+    MDB_txn *txn;
+    int dbr;
+    bool tx_active = false;
 
-  dbr = resize_env(env, filename_, 0);
-  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to set env map size: " + std::string(mdb_strerror(dbr)));
-  dbr = mdb_txn_begin(env, NULL, 0, &txn);
-  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
-  OXEN_DEFER { if (tx_active) mdb_txn_abort(txn); };
-  tx_active = true;
+    dbr = resize_env(env, filename_, 0);
+    THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to set env map size: " + std::string(mdb_strerror(dbr)));
+    dbr = mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
+    THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+    OXEN_DEFER { if (tx_active) mdb_txn_abort(txn); };
+    tx_active = true;
 
-  MDB_val key, data;
-  std::string key_ciphertext = encrypt(key_image, chacha_key, 0);
-  key.mv_data = (void*)key_ciphertext.data();
-  key.mv_size = key_ciphertext.size();
-  dbr = mdb_get(txn, dbi_rings, &key, &data);
-  THROW_WALLET_EXCEPTION_IF(dbr && dbr != MDB_NOTFOUND, tools::error::wallet_internal_error, "Failed to look for key image in LMDB table: " + std::string(mdb_strerror(dbr)));
-  if (dbr == MDB_NOTFOUND)
-    return false;
-  THROW_WALLET_EXCEPTION_IF(data.mv_size <= 0, tools::error::wallet_internal_error, "Invalid ring data size");
+    MDB_val key, data;
+    key.mv_data = (void*)key_ciphertext.data();
+    key.mv_size = key_ciphertext.size();
+    dbr = mdb_get(txn, dbi_rings, &key, &data);
+    THROW_WALLET_EXCEPTION_IF(dbr && dbr != MDB_NOTFOUND, tools::error::wallet_internal_error, "Failed to look for key image in LMDB table: " + std::string(mdb_strerror(dbr)));
+    if (dbr == MDB_NOTFOUND)
+      return false;
+    THROW_WALLET_EXCEPTION_IF(data.mv_size <= 0, tools::error::wallet_internal_error, "Invalid ring data size");
+    data_ciphertext.assign((const char*)data.mv_data, data.mv_size);
+  }
 
   bool try_v0 = false;
-  std::string data_plaintext = decrypt(std::string((const char*)data.mv_data, data.mv_size), key_image, chacha_key, 1);
+  std::string data_plaintext = decrypt(data_ciphertext, key_image, chacha_key, 1);
   try { outs = decompress_ring(data_plaintext, V1TAG); if (outs.empty()) try_v0 = true; }
   catch(...) { try_v0 = true; }
   if (try_v0)
   {
-    data_plaintext = decrypt(std::string((const char*)data.mv_data, data.mv_size), key_image, chacha_key, 0);
+    data_plaintext = decrypt(data_ciphertext, key_image, chacha_key, 0);
     outs = decompress_ring(data_plaintext, 0);
   }
   MDEBUG("Found ring for key image " << key_image << ":");
   MDEBUG("Relative: " << tools::join(" ", outs));
   outs = cryptonote::relative_output_offsets_to_absolute(outs);
   MDEBUG("Absolute: " << tools::join(" ", outs));
-
-  dbr = mdb_txn_commit(txn);
-  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to commit txn getting ring from database: " + std::string(mdb_strerror(dbr)));
-  tx_active = false;
   return true;
 }
 
 bool ringdb::set_ring(const crypto::chacha_key &chacha_key, const crypto::key_image &key_image, const std::vector<uint64_t> &outs, bool relative)
 {
-  MDB_txn *txn;
-  int dbr;
-  bool tx_active = false;
-
-  dbr = resize_env(env, filename_, outs.size() * 64);
-  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to set env map size: " + std::string(mdb_strerror(dbr)));
-  dbr = mdb_txn_begin(env, NULL, 0, &txn);
-  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
-  OXEN_DEFER { if (tx_active) mdb_txn_abort(txn); };
-  tx_active = true;
-
-  store_relative_ring(txn, dbi_rings, key_image, relative ? outs : cryptonote::absolute_output_offsets_to_relative(outs), chacha_key);
-
-  dbr = mdb_txn_commit(txn);
-  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to commit txn setting ring to database: " + std::string(mdb_strerror(dbr)));
-  tx_active = false;
+  std::map<std::string, std::string> rings;
+  add_relative_ring(rings, key_image, relative ? outs : cryptonote::absolute_output_offsets_to_relative(outs), chacha_key);
+  put_rings(std::move(rings));
   return true;
 }
 
@@ -413,9 +450,6 @@ bool ringdb::blackball_worker(const std::vector<std::pair<uint64_t, uint64_t>> &
   MDB_cursor *cursor;
   int dbr;
   bool tx_active = false;
-  bool ret = true;
-
-  THROW_WALLET_EXCEPTION_IF(outputs.size() > 1 && op == BLACKBALL_QUERY, tools::error::wallet_internal_error, "Blackball query only makes sense for a single output");
 
   dbr = resize_env(env, filename_, 32 * 2 * outputs.size()); // a pubkey, and some slack
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to set env map size: " + std::string(mdb_strerror(dbr)));
@@ -449,13 +483,6 @@ bool ringdb::blackball_worker(const std::vector<std::pair<uint64_t, uint64_t>> &
         if (dbr == 0)
           dbr = mdb_cursor_del(cursor, 0);
         break;
-      case BLACKBALL_QUERY:
-        dbr = mdb_cursor_get(cursor, &key, &data, MDB_GET_BOTH);
-        THROW_WALLET_EXCEPTION_IF(dbr && dbr != MDB_NOTFOUND, tools::error::wallet_internal_error, "Failed to lookup in blackballs table: " + std::string(mdb_strerror(dbr)));
-        ret = dbr != MDB_NOTFOUND;
-        if (dbr == MDB_NOTFOUND)
-          dbr = 0;
-        break;
       case BLACKBALL_CLEAR:
         break;
       default:
@@ -472,10 +499,64 @@ bool ringdb::blackball_worker(const std::vector<std::pair<uint64_t, uint64_t>> &
     THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to clear blackballs table: " + std::string(mdb_strerror(dbr)));
   }
 
+  const mdb_size_t txnid = mdb_txn_id(txn);
   dbr = mdb_txn_commit(txn);
   THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to commit txn blackballing output to database: " + std::string(mdb_strerror(dbr)));
   tx_active = false;
-  return ret;
+
+  if (op == BLACKBALL_CLEAR)
+    blackballs_.clear();
+  for (const std::pair<uint64_t, uint64_t> &output: outputs)
+  {
+    if (op == BLACKBALL_BLACKBALL)
+      blackballs_.insert(output);
+    else if (op == BLACKBALL_UNBLACKBALL)
+      blackballs_.erase(output);
+  }
+  committed(txnid);
+  return true;
+}
+
+void ringdb::sync_blackballs()
+{
+  MDB_envinfo mei;
+  int dbr = mdb_env_info(env, &mei);
+  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to get env info: " + std::string(mdb_strerror(dbr)));
+  if (mei.me_last_txnid == blackballs_txnid_)
+    return;
+
+  MDB_txn *txn;
+  MDB_cursor *cursor;
+  bool tx_active = false;
+
+  dbr = mdb_txn_begin(env, NULL, MDB_RDONLY, &txn);
+  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to create LMDB transaction: " + std::string(mdb_strerror(dbr)));
+  OXEN_DEFER { if (tx_active) mdb_txn_abort(txn); };
+  tx_active = true;
+
+  dbr = mdb_cursor_open(txn, dbi_blackballs, &cursor);
+  THROW_WALLET_EXCEPTION_IF(dbr, tools::error::wallet_internal_error, "Failed to create cursor for blackballs table: " + std::string(mdb_strerror(dbr)));
+  OXEN_DEFER { mdb_cursor_close(cursor); };
+
+  blackballs_.clear();
+  MDB_val key, data;
+  for (dbr = mdb_cursor_get(cursor, &key, &data, MDB_FIRST); dbr == 0; dbr = mdb_cursor_get(cursor, &key, &data, MDB_NEXT))
+  {
+    THROW_WALLET_EXCEPTION_IF(key.mv_size != sizeof(uint64_t) || data.mv_size != sizeof(uint64_t), tools::error::wallet_internal_error, "Invalid blackballs table entry");
+    uint64_t amount, index;
+    memcpy(&amount, key.mv_data, sizeof(amount));
+    memcpy(&index, data.mv_data, sizeof(index));
+    blackballs_.emplace(amount, index);
+  }
+  THROW_WALLET_EXCEPTION_IF(dbr != MDB_NOTFOUND, tools::error::wallet_internal_error, "Failed to read blackballs table: " + std::string(mdb_strerror(dbr)));
+  blackballs_txnid_ = mdb_txn_id(txn);
+  MDEBUG("Loaded " << blackballs_.size() << " blackballed outputs");
+}
+
+void ringdb::committed(mdb_size_t txnid)
+{
+  if (txnid == blackballs_txnid_ + 1)
+    blackballs_txnid_ = txnid;
 }
 
 bool ringdb::blackball(const std::vector<std::pair<uint64_t, uint64_t>> &outputs)
@@ -497,8 +578,8 @@ bool ringdb::unblackball(const std::pair<uint64_t, uint64_t> &output)
 
 bool ringdb::blackballed(const std::pair<uint64_t, uint64_t> &output)
 {
-  std::vector<std::pair<uint64_t, uint64_t>> outputs(1, output);
-  return blackball_worker(outputs, BLACKBALL_QUERY);
+  sync_blackballs();
+  return blackballs_.count(output) > 0;
 }
 
 bool ringdb::clear_blackballs()
@@ -28,7 +28,9 @@
 
 #pragma once
 
+#include <map>
 #include <string>
+#include <unordered_set>
 #include <vector>
 #include <lmdb.h>
 #include "epee/wipeable_string.h"
@@ -47,6 +49,12 @@ namespace tools
 
     const fs::path& filename() { return filename_; }
 
+    // Between these, rings are kept in memory rather than written, and are all written by
+    // end_batch() in a single LMDB txn (or dropped, if end_batch throws).  For callers that add
+    // the rings of many txs in a row, as a refresh does for each batch of blocks.
+    void begin_batch();
+    void end_batch();
+
     bool add_rings(const crypto::chacha_key &chacha_key, const cryptonote::transaction_prefix &tx);
     bool remove_rings(const crypto::chacha_key &chacha_key, const std::vector<crypto::key_image> &key_images);
     bool remove_rings(const crypto::chacha_key &chacha_key, const cryptonote::transaction_prefix &tx);
@@ -61,11 +69,34 @@ namespace tools
 
   private:
     bool blackball_worker(const std::vector<std::pair<uint64_t, uint64_t>> &outputs, int op);
+    void put_rings(std::map<std::string, std::string> &&rings);
+    void write_rings(const std::map<std::string, std::string> &rings);
+    // Reloads blackballs_ if anything (another wallet sharing the db, say) committed since it was
+    // loaded
+    void sync_blackballs();
+    // Called with the id of a committed write txn: if blackballs_ was up to date before it, and the
+    // txn's blackball changes were applied to it, it still is
+    void committed(mdb_size_t txnid);
+
+    struct output_hash
+    {
+      size_t operator()(const std::pair<uint64_t, uint64_t> &output) const
+      {
+        return std::hash<uint64_t>{}(output.first * 0x9e3779b97f4a7c15ull ^ output.second);
+      }
+    };
 
   private:
     fs::path filename_;
     MDB_env *env = nullptr;
     MDB_dbi dbi_rings;
     MDB_dbi dbi_blackballs;
+    // A copy of the blackballs table, as of the txn blackballs_txnid_, so that decoy selection can
+    // check each candidate without an LMDB txn
+    std::unordered_set<std::pair<uint64_t, uint64_t>, output_hash> blackballs_;
+    mdb_size_t blackballs_txnid_ = -1;
+    // Encrypted rings (by encrypted key image) waiting for end_batch(), while in a batch
+    bool batch_ = false;
+    std::map<std::string, std::string> batch_rings_;
   };
 }
@@ -0,0 +1,89 @@
+#include "subaddress_table.h"
+
+#include <cstring>
+
+namespace tools
+{
+
+uint64_t subaddress_table::tag(const crypto::public_key& key)
+{
+  uint64_t t;
+  std::memcpy(&t, key.data, sizeof(t));
+  return t | 1;
+}
+
+void subaddress_table::clear()
+{
+  slots_.clear();
+  slots_.shrink_to_fit();
+  size_ = 0;
+  shift_ = 64;
+}
+
+void subaddress_table::reserve(size_t n)
+{
+  // Kept at most half full, so that probes stay short
+  size_t capacity = 16;
+  while (capacity < 2 * n)
+    capacity *= 2;
+  if (capacity > slots_.size())
+    rehash(capacity);
+}
+
+void subaddress_table::rehash(size_t capacity)
+{
+  std::vector<slot> old;
+  old.swap(slots_);
+  slots_.resize(capacity);
+  shift_ = 64;
+  for (size_t c = capacity; c > 1; c /= 2)
+    --shift_;
+
+  const size_t mask = capacity - 1;
+  for (const auto& s : old)
+  {
+    if (!s.tag)
+      continue;
+    size_t i = first_slot(s.tag);
+    while (slots_[i].tag)
+      i = (i + 1) & mask;
+    slots_[i] = s;
+  }
+}
+
+void subaddress_table::insert(const crypto::public_key& key, const cryptonote::subaddress_index& index)
+{
+  if (2 * (size_ + 1) > slots_.size())
+    reserve(size_ + 1);
+
+  const uint64_t t = tag(key);
+  const size_t mask = slots_.size() - 1;
+  size_t i = first_slot(t);
+  for (; slots_[i].tag; i = (i + 1) & mask)
+  {
+    if (slots_[i].tag == t && slots_[i].key == key)
+    {
+      slots_[i].index = index;
+      return;
+    }
+  }
+  slots_[i].tag = t;
+  slots_[i].key = key;
+  slots_[i].index = index;
+  ++size_;
+}
+
+const cryptonote::subaddress_index* subaddress_table::find(const crypto::public_key& key) const
+{
+  if (slots_.empty())
+    return nullptr;
+
+  const uint64_t t = tag(key);
+  const size_t mask = slots_.size() - 1;
+  for (size_t i = first_slot(t); slots_[i].tag; i = (i + 1) & mask)
+    if (slots_[i].tag == t && slots_[i].key == key)
+      return &slots_[i].index;
+  return nullptr;
+}
+
+}
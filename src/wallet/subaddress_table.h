@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "cryptonote_basic/subaddress_index.h"
+
+namespace tools
+{
+  // The wallet's subaddress spend keys, for looking up the subaddress (if any) of the spend key
+  // derived from each output scanned.  Open addressing in one flat array, probed linearly, with the
+  // first 8 bytes of each key kept next to it: the keys are uniformly random, so those bytes make a
+  // hash, and a probe only reads the rest of the key when they match.
+  //
+  // Keys are only ever added (the wallet's subaddresses don't go away until it is cleared).
+  class subaddress_table
+  {
+  public:
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    void clear();
+    // Makes room for `n` keys in all, so that adding up to that many doesn't rehash
+    void reserve(size_t n);
+
+    // Adds `key`, or sets its index if it is already there
+    void insert(const crypto::public_key& key, const cryptonote::subaddress_index& index);
+
+    // Returns the index of `key`, or nullptr if it isn't a subaddress key
+    const cryptonote::subaddress_index* find(const crypto::public_key& key) const;
+
+  private:
+    struct slot
+    {
+      uint64_t tag = 0; // the key's first 8 bytes, with the low bit set; 0 for an empty slot
+      cryptonote::subaddress_index index;
+      crypto::public_key key;
+    };
+
+    static uint64_t tag(const crypto::public_key& key);
+    size_t first_slot(uint64_t tag) const { return (tag * 0x9e3779b97f4a7c15ull) >> shift_; }
+    void rehash(size_t capacity);
+
+    std::vector<slot> slots_; // empty, or a power of 2 in size
+    size_t size_ = 0;
+    unsigned shift_ = 64;
+  };
+}
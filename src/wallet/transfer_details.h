@@ -67,6 +67,45 @@ struct transfer_details
   }
 };
 
+// The fields of a transfer_details that balance and output selection scans look at, copied into
+// a contiguous array (see wallet2::get_transfer_summaries()) so that those scans don't have to walk
+// the transfer_details themselves: those are several hundred bytes each plus the heap allocations
+// of their tx prefix (which is needed just to look up the output's unlock time).
+struct transfer_summary
+{
+  uint64_t amount;
+  uint64_t block_height;
+  uint64_t unlock_time; // of this output, i.e. m_tx.get_unlock_time(m_internal_output_index)
+  uint64_t tx_unlock_time; // m_tx.unlock_time
+  crypto::key_image key_image;
+  cryptonote::subaddress_index subaddr_index;
+  cryptonote::txversion tx_version;
+  bool spent;
+  bool spent_confirmed; // spent in a mined tx (m_spent_height > 0)
+  bool frozen;
+  bool unmined_blink;
+  bool key_image_partial;
+  bool rct;
+
+  explicit transfer_summary(const transfer_details& td)
+    : amount{td.amount()},
+      block_height{td.m_block_height},
+      unlock_time{td.m_tx.get_unlock_time(td.m_internal_output_index)},
+      tx_unlock_time{td.m_tx.unlock_time},
+      key_image{td.m_key_image},
+      subaddr_index{td.m_subaddr_index},
+      tx_version{td.m_tx.version},
+      spent{td.m_spent},
+      spent_confirmed{td.m_spent && td.m_spent_height > 0},
+      frozen{td.m_frozen},
+      unmined_blink{td.m_unmined_blink},
+      key_image_partial{td.m_key_image_partial},
+      rct{td.m_rct}
+  {}
+
+  bool is_spent(bool strict) const { return strict ? spent_confirmed : spent; }
+};
+
 
 template <class Archive>
 void serialize_value(Archive& ar, transfer_details& x) {
@@ -34,6 +34,9 @@
 #include <tuple>
 #include <optional>
 #include <mutex>
+#include <condition_variable>
+#include <future>
+#include <thread>
 #include <boost/format.hpp>
 #include <openssl/evp.h>
 #include <openssl/pem.h>
@@ -49,6 +52,7 @@
 #include "cryptonote_core/tx_sanity_check.h"
 #include "wallet/wallet_errors.h"
 #include "wallet2.h"
+#include "block_prefetcher.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "epee/misc_language.h"
@@ -129,12 +133,18 @@ namespace {
   constexpr std::string_view KEY_IMAGE_EXPORT_FILE_MAGIC = "Loki key image export\002"sv;
   constexpr std::string_view MULTISIG_EXPORT_FILE_MAGIC = "Loki multisig export\001"sv;
   constexpr std::string_view OUTPUT_EXPORT_FILE_MAGIC = "Loki output export\003"sv;
+  constexpr std::string_view OUTPUT_EXPORT_STREAM_MAGIC = "Loki output export\004"sv;
 
   constexpr uint64_t SEGREGATION_FORK_HEIGHT = 99999999;
   constexpr uint64_t SEGREGATION_FORK_VICINITY = 1500; // blocks
 
   constexpr uint64_t FIRST_REFRESH_GRANULARITY = 1024;
 
+  // Key image import: how many key images are checked for being spent per request, and how many
+  // signatures are verified between progress callbacks
+  constexpr size_t KEY_IMAGE_SPENT_CHUNK = 5000;
+  constexpr size_t KEY_IMAGE_VERIFY_ROUND = 4096;
+
   constexpr double GAMMA_SHAPE = 19.28;
   constexpr double GAMMA_SCALE = 1/1.61;
 
@@ -706,19 +716,6 @@ bool emplace_or_replace(std::unordered_multimap<crypto::hash, tools::wallet2::po
   return true;
 }
 
-void drop_from_short_history(std::list<crypto::hash> &short_chain_history, size_t N)
-{
-  std::list<crypto::hash>::iterator right;
-  // drop early N off, skipping the genesis block
-  if (short_chain_history.size() > N) {
-    right = short_chain_history.end();
-    std::advance(right,-1);
-    std::list<crypto::hash>::iterator left = right;
-    std::advance(left, -N);
-    short_chain_history.erase(left, right);
-  }
-}
-
 size_t estimate_rct_tx_size(int n_inputs, int mixin, int n_outputs, size_t extra_size, bool clsag)
 {
   size_t size = 0;
@@ -1053,6 +1050,10 @@ wallet2::wallet2(network_type nettype, uint64_t kdf_rounds, bool unattended):
   m_ignore_outputs_above(MONEY_SUPPLY),
   m_ignore_outputs_below(0),
   m_track_uses(false),
+  m_incremental_cache(false),
+  m_sync_from_digests(false),
+  m_refresh_max_blocks(0),
+  m_sync_batch_size(0),
   m_inactivity_lock_timeout(m_nettype == MAINNET ? DEFAULT_INACTIVITY_LOCK_TIMEOUT : 0s),
   m_is_initialized(false),
   m_kdf_rounds(kdf_rounds),
@@ -1244,6 +1245,10 @@ bool wallet2::set_daemon(std::string daemon_address, std::optional<tools::login>
   m_http_client.set_proxy(std::move(proxy));
 
   m_trusted_daemon = trusted_daemon;
+  m_rct_distribution.clear();
+  m_rct_distribution_top_hash.clear();
+  m_pool_id = 0;
+  m_pool_changes_unsupported = false;
 
   // Copy everything to the long poll client as well:
   m_long_poll_client.copy_params_from(m_http_client);
@@ -1415,10 +1420,10 @@ cryptonote::account_public_address wallet2::get_subaddress(const cryptonote::sub
 //----------------------------------------------------------------------------------------------------
 std::optional<cryptonote::subaddress_index> wallet2::get_subaddress_index(const cryptonote::account_public_address& address) const
 {
-  auto index = m_subaddresses.find(address.m_spend_public_key);
-  if (index == m_subaddresses.end())
+  auto* index = m_subaddress_table.find(address.m_spend_public_key);
+  if (!index)
     return std::nullopt;
-  return index->second;
+  return *index;
 }
 //----------------------------------------------------------------------------------------------------
 crypto::public_key wallet2::get_subaddress_spend_public_key(const cryptonote::subaddress_index& index) const
@@ -1468,21 +1473,52 @@ bool wallet2::should_expand(const cryptonote::subaddress_index &index) const
 void wallet2::expand_subaddresses(const cryptonote::subaddress_index& index)
 {
   hw::device &hwdev = m_account.get_device();
+  // Derives and adds the keys of subaddresses [begin, end) of account `major`: in batches on the
+  // threadpool if the keys are ours to derive (a big lookahead being many thousands of them)
+  auto add_keys = [&](uint32_t major, uint32_t begin, uint32_t end) {
+    std::vector<crypto::public_key> pkeys;
+    constexpr uint32_t BATCH = 1024;
+    if (hwdev.get_type() == hw::device::SOFTWARE && end - begin > BATCH)
+    {
+      pkeys.resize(end - begin);
+      tools::threadpool& tpool = tools::threadpool::getInstance();
+      tools::threadpool::waiter waiter;
+      std::atomic<bool> failed{false};
+      for (uint32_t b = begin; b < end; b += BATCH)
+      {
+        const uint32_t e = b + std::min(BATCH, end - b);
+        tpool.submit(&waiter, [&, b, e] {
+          try
+          {
+            auto keys = hwdev.get_subaddress_spend_public_keys(m_account.get_keys(), major, b, e);
+            std::copy(keys.begin(), keys.end(), pkeys.begin() + (b - begin));
+          }
+          catch (...) { failed = true; }
+        }, true);
+      }
+      waiter.wait(&tpool);
+      THROW_WALLET_EXCEPTION_IF(failed, error::wallet_internal_error, "Failed to derive subaddress keys");
+    }
+    else
+      pkeys = hwdev.get_subaddress_spend_public_keys(m_account.get_keys(), major, begin, end);
+
+    m_subaddresses.reserve(m_subaddresses.size() + pkeys.size());
+    m_subaddress_table.reserve(m_subaddress_table.size() + pkeys.size());
+    cryptonote::subaddress_index index2 = {major, begin};
+    for (const crypto::public_key &D: pkeys)
+    {
+      m_subaddresses[D] = index2;
+      m_subaddress_table.insert(D, index2);
+      ++index2.minor;
+    }
+  };
+
   if (m_subaddress_labels.size() <= index.major)
   {
     // add new accounts
-    cryptonote::subaddress_index index2;
     const uint32_t major_end = get_subaddress_clamped_sum(index.major, m_subaddress_lookahead_major);
-    for (index2.major = m_subaddress_labels.size(); index2.major < major_end; ++index2.major)
-    {
-      const uint32_t end = get_subaddress_clamped_sum((index2.major == index.major ? index.minor : 0), m_subaddress_lookahead_minor);
-      const std::vector<crypto::public_key> pkeys = hwdev.get_subaddress_spend_public_keys(m_account.get_keys(), index2.major, 0, end);
-      for (index2.minor = 0; index2.minor < end; ++index2.minor)
-      {
-         const crypto::public_key &D = pkeys[index2.minor];
-         m_subaddresses[D] = index2;
-      }
-    }
+    for (uint32_t major = m_subaddress_labels.size(); major < major_end; ++major)
+      add_keys(major, 0, get_subaddress_clamped_sum((major == index.major ? index.minor : 0), m_subaddress_lookahead_minor));
     m_subaddress_labels.resize(index.major + 1, {"Untitled account"});
     m_subaddress_labels[index.major].resize(index.minor + 1);
     get_account_tags();
@@ -1490,15 +1526,7 @@ void wallet2::expand_subaddresses(const cryptonote::subaddress_index& index)
   else if (m_subaddress_labels[index.major].size() <= index.minor)
   {
     // add new subaddresses
-    const uint32_t end = get_subaddress_clamped_sum(index.minor, m_subaddress_lookahead_minor);
-    const uint32_t begin = m_subaddress_labels[index.major].size();
-    cryptonote::subaddress_index index2 = {index.major, begin};
-    const std::vector<crypto::public_key> pkeys = hwdev.get_subaddress_spend_public_keys(m_account.get_keys(), index2.major, index2.minor, end);
-    for (; index2.minor < end; ++index2.minor)
-    {
-       const crypto::public_key &D = pkeys[index2.minor - begin];
-       m_subaddresses[D] = index2;
-    }
+    add_keys(index.major, m_subaddress_labels[index.major].size(), get_subaddress_clamped_sum(index.minor, m_subaddress_lookahead_minor));
     m_subaddress_labels[index.major].resize(index.minor + 1);
   }
 }
@@ -1540,6 +1568,7 @@ bool wallet2::is_deprecated() const
 //----------------------------------------------------------------------------------------------------
 void wallet2::set_spent(size_t idx, uint64_t height)
 {
+  m_transfers_cache.reset();
   CHECK_AND_ASSERT_THROW_MES(idx < m_transfers.size(), "Invalid index");
   transfer_details &td = m_transfers[idx];
   LOG_PRINT_L2("Setting SPENT at " << height << ": ki " << td.m_key_image << ", amount " << print_money(td.m_amount));
@@ -1549,6 +1578,7 @@ void wallet2::set_spent(size_t idx, uint64_t height)
 //----------------------------------------------------------------------------------------------------
 void wallet2::set_unspent(size_t idx)
 {
+  m_transfers_cache.reset();
   CHECK_AND_ASSERT_THROW_MES(idx < m_transfers.size(), "Invalid index");
   transfer_details &td = m_transfers[idx];
   LOG_PRINT_L2("Setting UNSPENT: ki " << td.m_key_image << ", amount " << print_money(td.m_amount));
@@ -1577,6 +1607,7 @@ bool wallet2::is_spent(size_t idx, bool strict) const
 //----------------------------------------------------------------------------------------------------
 void wallet2::freeze(size_t idx)
 {
+  m_transfers_cache.reset();
   CHECK_AND_ASSERT_THROW_MES(idx < m_transfers.size(), "Invalid transfer_details index");
   transfer_details &td = m_transfers[idx];
   td.m_frozen = true;
@@ -1584,6 +1615,7 @@ void wallet2::freeze(size_t idx)
 //----------------------------------------------------------------------------------------------------
 void wallet2::thaw(size_t idx)
 {
+  m_transfers_cache.reset();
   CHECK_AND_ASSERT_THROW_MES(idx < m_transfers.size(), "Invalid transfer_details index");
   transfer_details &td = m_transfers[idx];
   td.m_frozen = false;
@@ -1820,6 +1852,8 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
     uint64_t height, uint8_t block_version, uint64_t ts, bool miner_tx, bool pool, bool blink, bool double_spend_seen,
     const tx_cache_data &tx_cache_data, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache)
 {
+  wait_for_history();
+  m_transfers_cache.reset();
   if (!tx.is_transfer() || tx.version <= txversion::v1)
     return;
 
@@ -2483,7 +2517,10 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
           m_callback->on_unconfirmed_money_received(height, txid, tx, payment.m_amount, payment.m_subaddr_index);
       }
       else
+      {
         m_payments.emplace(payment_id, payment);
+        m_transfer_history.reset();
+      }
       LOG_PRINT_L2("Payment found in " << (pool ? blink ? "blink pool" : "pool" : "block") << ": " << payment_id << " / " << payment.m_tx_hash << " / " << payment.m_amount);
     }
 
@@ -2539,6 +2576,8 @@ void wallet2::process_new_transaction(const crypto::hash &txid, const cryptonote
 //----------------------------------------------------------------------------------------------------
 void wallet2::process_unconfirmed(const crypto::hash &txid, const cryptonote::transaction& tx, uint64_t height)
 {
+  wait_for_history();
+  m_transfers_cache.reset();
   if (m_unconfirmed_txs.empty())
     return;
 
@@ -2547,6 +2586,7 @@ void wallet2::process_unconfirmed(const crypto::hash &txid, const cryptonote::tr
     if (store_tx_info()) {
       try {
         m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details(unconf_it->second, height)));
+        m_transfer_history.reset();
       }
       catch (...) {
         // can fail if the tx has unexpected input types
@@ -2559,6 +2599,8 @@ void wallet2::process_unconfirmed(const crypto::hash &txid, const cryptonote::tr
 //----------------------------------------------------------------------------------------------------
 void wallet2::process_outgoing(const crypto::hash &txid, const cryptonote::transaction &tx, uint64_t height, uint64_t ts, uint64_t spent, uint64_t received, uint32_t subaddr_account, const std::set<uint32_t>& subaddr_indices)
 {
+  wait_for_history();
+  m_transfer_history.reset();
   std::pair<std::unordered_map<crypto::hash, confirmed_transfer_details>::iterator, bool> entry = m_confirmed_txs.insert(std::make_pair(txid, confirmed_transfer_details()));
   // fill with the info we know, some info might already be there
   if (entry.second)
@@ -2650,6 +2692,19 @@ void wallet2::process_new_blockchain_entry(const cryptonote::block& b, const cry
     m_callback->on_new_block(height, b);
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::drop_from_short_history(std::list<crypto::hash> &short_chain_history, size_t N)
+{
+  std::list<crypto::hash>::iterator right;
+  // drop early N off, skipping the genesis block
+  if (short_chain_history.size() > N) {
+    right = short_chain_history.end();
+    std::advance(right,-1);
+    std::list<crypto::hash>::iterator left = right;
+    std::advance(left, -N);
+    short_chain_history.erase(left, right);
+  }
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::get_short_chain_history(std::list<crypto::hash>& ids, uint64_t granularity) const
 {
   size_t i = 0;
@@ -2683,6 +2738,11 @@ void wallet2::get_short_chain_history(std::list<crypto::hash>& ids, uint64_t gra
     ids.push_back(m_blockchain.genesis());
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::get_refresh_short_chain_history(std::list<crypto::hash>& ids, bool trusted_daemon) const
+{
+  get_short_chain_history(ids, (m_first_refresh_done || trusted_daemon) ? 1 : FIRST_REFRESH_GRANULARITY);
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::parse_block_round(const cryptonote::blobdata &blob, cryptonote::block &bl, crypto::hash &bl_id, bool &error) const
 {
   error = !cryptonote::parse_and_validate_block_from_blob(blob, bl, bl_id);
@@ -2716,6 +2776,41 @@ void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height,
       << ", height " << blocks_start_height + blocks.size() << ", node height " << res.current_height);
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::pull_block_digests(uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::block_digest::digest> &digests, uint64_t &current_height)
+{
+  cryptonote::rpc::GET_BLOCK_DIGESTS::request req{};
+  cryptonote::rpc::GET_BLOCK_DIGESTS::response res{};
+  req.block_ids = short_chain_history;
+  req.start_height = 0;
+  req.max_count = m_sync_batch_size;
+
+  bool r = invoke_http<rpc::GET_BLOCK_DIGESTS>(req, res);
+  THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "get_block_digests.bin");
+  THROW_WALLET_EXCEPTION_IF(res.status == rpc::STATUS_BUSY, error::daemon_busy, "get_block_digests.bin");
+  THROW_WALLET_EXCEPTION_IF(res.status != rpc::STATUS_OK, error::get_blocks_error, get_rpc_status(res.status));
+  THROW_WALLET_EXCEPTION_IF(res.blocks.size() != res.digests.size(), error::wallet_internal_error,
+      "mismatched blocks (" + std::to_string(res.blocks.size()) + ") and digests (" +
+      std::to_string(res.digests.size()) + ") sizes from daemon");
+
+  blocks.clear();
+  blocks.resize(res.blocks.size());
+  digests.clear();
+  digests.reserve(res.digests.size());
+  for (size_t i = 0; i < res.blocks.size(); ++i)
+  {
+    blocks[i].block = std::move(res.blocks[i]);
+    auto digest = cryptonote::block_digest::unpack(res.digests[i]);
+    THROW_WALLET_EXCEPTION_IF(!digest, error::wallet_internal_error,
+        "Invalid block digest from daemon at height " + std::to_string(res.start_height + i));
+    digests.push_back(std::move(*digest));
+  }
+  blocks_start_height = res.start_height;
+  current_height = res.current_height;
+
+  MDEBUG("Pulled block digests: blocks_start_height " << blocks_start_height << ", count " << blocks.size()
+      << ", height " << blocks_start_height + blocks.size() << ", node height " << res.current_height);
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::pull_hashes(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<crypto::hash> &hashes)
 {
   cryptonote::rpc::GET_HASHES_FAST::request req{};
@@ -2743,6 +2838,8 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
   tools::threadpool& tpool = tools::threadpool::getInstance();
   tools::threadpool::waiter waiter;
 
+  // Deriving and matching output keys for the whole span, then adding the blocks' txes one by one
+  PERF_TIMER_START(process_parsed_blocks_scan);
   size_t num_txes = 0;
   std::vector<tx_cache_data> tx_cache_data;
   for (size_t i = 0; i < blocks.size(); ++i)
@@ -2775,30 +2872,145 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
   hwdev.set_mode(hw::device::TRANSACTION_PARSE);
   const cryptonote::account_keys &keys = m_account.get_keys();
 
-  auto gender = [&](wallet2::is_out_data &iod) {
-    if (!hwdev.generate_key_derivation(iod.pkey, keys.m_view_secret_key, iod.derivation))
-    {
-      MWARNING("Failed to generate key derivation from tx pubkey, skipping");
-      static_assert(sizeof(iod.derivation) == sizeof(rct::key), "Mismatched sizes of key_derivation and rct::key");
-      memcpy(&iod.derivation, rct::identity().bytes, sizeof(iod.derivation));
-    }
-  };
+  static_assert(sizeof(wallet2::is_out_data::derivation) == sizeof(rct::key), "Mismatched sizes of key_derivation and rct::key");
 
-  for (size_t i = 0; i < tx_cache_data.size(); ++i)
+  // The software device needs neither the device lock nor one call per derivation: we batch up the
+  // derivations of the whole span and split them between the threads.
+  const bool batch = hwdev.get_type() == hw::device::SOFTWARE;
+  if (batch)
   {
-    if (tx_cache_data[i].empty())
-      continue;
-    tpool.submit(&waiter, [&hwdev, &gender, &tx_cache_data, i]() {
-      auto &slot = tx_cache_data[i];
-      std::unique_lock hwdev_lock{hwdev};
+    std::vector<wallet2::is_out_data*> iods;
+    for (auto &slot: tx_cache_data)
+    {
       for (auto &iod: slot.primary)
-        gender(iod);
+        iods.push_back(&iod);
       for (auto &iod: slot.additional)
-        gender(iod);
-    }, true);
+        iods.push_back(&iod);
+    }
+    const size_t chunk = std::max<size_t>(64, (iods.size() + tpool.get_max_concurrency() - 1) / std::max<size_t>(1, tpool.get_max_concurrency()));
+    for (size_t begin = 0; begin < iods.size(); begin += chunk)
+    {
+      const size_t end = std::min(begin + chunk, iods.size());
+      tpool.submit(&waiter, [&iods, &keys, begin, end]() {
+        std::vector<crypto::public_key> pkeys;
+        pkeys.reserve(end - begin);
+        for (size_t i = begin; i < end; ++i)
+          pkeys.push_back(iods[i]->pkey);
+        std::vector<crypto::key_derivation> derivations;
+        const auto ok = crypto::generate_key_derivations(pkeys, keys.m_view_secret_key, derivations);
+        for (size_t i = begin; i < end; ++i)
+        {
+          if (ok[i - begin])
+            iods[i]->derivation = derivations[i - begin];
+          else
+          {
+            MWARNING("Failed to generate key derivation from tx pubkey, skipping");
+            memcpy(&iods[i]->derivation, rct::identity().bytes, sizeof(iods[i]->derivation));
+          }
+        }
+      }, true);
+    }
+  }
+  else
+  {
+    // A hardware device is one round trip per call, so it gets the derivations of a block at a
+    // time, which a device that can batch them (see hw::device::generate_key_derivations) does in
+    // a few exchanges rather than one per tx pubkey.
+    std::unique_lock hwdev_lock{hwdev};
+    std::vector<wallet2::is_out_data*> iods;
+    std::vector<crypto::public_key> pkeys;
+    std::vector<crypto::key_derivation> derivations;
+    txidx = 0;
+    for (size_t i = 0; i < blocks.size(); ++i)
+    {
+      iods.clear();
+      pkeys.clear();
+      for (size_t end = txidx + 1 + parsed_blocks[i].txes.size(); txidx < end; ++txidx)
+      {
+        for (auto &iod: tx_cache_data[txidx].primary)
+          iods.push_back(&iod);
+        for (auto &iod: tx_cache_data[txidx].additional)
+          iods.push_back(&iod);
+      }
+      if (iods.empty())
+        continue;
+      for (auto *iod: iods)
+        pkeys.push_back(iod->pkey);
+      const auto ok = hwdev.generate_key_derivations(pkeys, keys.m_view_secret_key, derivations);
+      for (size_t k = 0; k < iods.size(); ++k)
+      {
+        if (ok[k])
+          iods[k]->derivation = derivations[k];
+        else
+        {
+          MWARNING("Failed to generate key derivation from tx pubkey, skipping");
+          memcpy(&iods[k]->derivation, rct::identity().bytes, sizeof(iods[k]->derivation));
+        }
+      }
+    }
   }
   waiter.wait(&tpool);
 
+  // Batched equivalent of calling is_out_to_acc_precomp() for each output of a tx
+  auto scan_outputs = [&](const cryptonote::transaction &tx, size_t n_vouts, size_t txidx) {
+    auto &slot = tx_cache_data[txidx];
+    std::vector<crypto::public_key> out_keys;
+    std::vector<size_t> indices;
+    for (size_t k = 0; k < n_vouts; ++k)
+    {
+      if (auto* out = std::get_if<cryptonote::txout_to_key>(&tx.vout[k].target))
+      {
+        out_keys.push_back(out->key);
+        indices.push_back(k);
+      }
+    }
+    if (out_keys.empty())
+      return;
+
+    std::vector<crypto::public_key> spend_keys;
+    for (size_t l = 0; l < slot.primary.size(); ++l)
+    {
+      auto &primary = slot.primary[l];
+      THROW_WALLET_EXCEPTION_IF(primary.received.size() != n_vouts,
+          error::wallet_internal_error, "Unexpected received array size");
+      // as in geniod, only the first tx pubkey gets to try the additional ones
+      const bool try_additional = l == 0 && !slot.additional.empty();
+      std::vector<crypto::key_derivation> derivations(out_keys.size(), primary.derivation);
+      auto ok = crypto::derive_subaddress_public_keys(out_keys, derivations, indices, spend_keys);
+      std::vector<crypto::public_key> retry_keys;
+      std::vector<size_t> retry_indices;
+      for (size_t n = 0; n < out_keys.size(); ++n)
+      {
+        auto* found = ok[n] ? m_subaddress_table.find(spend_keys[n]) : nullptr;
+        if (found)
+          primary.received[indices[n]] = cryptonote::subaddress_receive_info{*found, primary.derivation};
+        else if (try_additional)
+        {
+          if (indices[n] >= slot.additional.size())
+          {
+            MERROR("wrong number of additional derivations");
+            continue;
+          }
+          retry_keys.push_back(out_keys[n]);
+          retry_indices.push_back(indices[n]);
+        }
+      }
+      if (retry_keys.empty())
+        continue;
+      // try additional tx pubkeys (one per output) for the outputs the shared one didn't match
+      derivations.clear();
+      for (size_t k: retry_indices)
+        derivations.push_back(slot.additional[k].derivation);
+      ok = crypto::derive_subaddress_public_keys(retry_keys, derivations, retry_indices, spend_keys);
+      for (size_t n = 0; n < retry_keys.size(); ++n)
+      {
+        auto* found = ok[n] ? m_subaddress_table.find(spend_keys[n]) : nullptr;
+        if (found)
+          primary.received[retry_indices[n]] = cryptonote::subaddress_receive_info{*found, derivations[n]};
+      }
+    }
+  };
+
   auto geniod = [&](const cryptonote::transaction &tx, size_t n_vouts, size_t txidx) {
     for (size_t k = 0; k < n_vouts; ++k)
     {
@@ -2834,20 +3046,32 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
     {
       THROW_WALLET_EXCEPTION_IF(txidx >= tx_cache_data.size(), error::wallet_internal_error, "txidx out of range");
       const size_t n_vouts = m_refresh_type == RefreshType::RefreshOptimizeCoinbase ? 1 : parsed_blocks[i].block.miner_tx.vout.size();
-      tpool.submit(&waiter, [&, i, n_vouts, txidx](){ geniod(parsed_blocks[i].block.miner_tx, n_vouts, txidx); }, true);
+      tpool.submit(&waiter, [&, i, n_vouts, txidx](){
+        if (batch)
+          scan_outputs(parsed_blocks[i].block.miner_tx, n_vouts, txidx);
+        else
+          geniod(parsed_blocks[i].block.miner_tx, n_vouts, txidx);
+      }, true);
     }
     ++txidx;
     for (size_t j = 0; j < parsed_blocks[i].txes.size(); ++j)
     {
       THROW_WALLET_EXCEPTION_IF(txidx >= tx_cache_data.size(), error::wallet_internal_error, "txidx out of range");
-      tpool.submit(&waiter, [&, i, j, txidx](){ geniod(parsed_blocks[i].txes[j], parsed_blocks[i].txes[j].vout.size(), txidx); }, true);
+      tpool.submit(&waiter, [&, i, j, txidx](){
+        if (batch)
+          scan_outputs(parsed_blocks[i].txes[j], parsed_blocks[i].txes[j].vout.size(), txidx);
+        else
+          geniod(parsed_blocks[i].txes[j], parsed_blocks[i].txes[j].vout.size(), txidx);
+      }, true);
       ++txidx;
     }
   }
   THROW_WALLET_EXCEPTION_IF(txidx != tx_cache_data.size(), error::wallet_internal_error, "txidx did not reach expected value");
   waiter.wait(&tpool);
   hwdev.set_mode(hw::device::NONE);
+  PERF_TIMER_STOP(process_parsed_blocks_scan);
 
+  PERF_TIMER(process_parsed_blocks_add);
   size_t tx_cache_data_offset = 0;
   for (size_t i = 0; i < blocks.size(); ++i)
   {
@@ -2879,85 +3103,184 @@ void wallet2::process_parsed_blocks(uint64_t start_height, const std::vector<cry
   }
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::refresh(bool trusted_daemon)
-{
-  uint64_t blocks_fetched = 0;
-  refresh(trusted_daemon, 0, blocks_fetched);
-}
-//----------------------------------------------------------------------------------------------------
-void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blocks_fetched)
-{
-  bool received_money = false;
-  refresh(trusted_daemon, start_height, blocks_fetched, received_money);
-}
-//----------------------------------------------------------------------------------------------------
-void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception)
-{
-  error = false;
-  last = false;
-  exception = NULL;
+void wallet2::match_block_digest(const parsed_block &pb, const cryptonote::block_digest::digest &digest, std::vector<size_t> &matches, bool &incoming) const
+{
+  // All the derivations of the block, then all of its outputs, in one batch each: the same work as
+  // scanning the txs themselves, minus fetching and parsing them
+  std::vector<crypto::public_key> tx_keys;
+  std::vector<std::pair<size_t, size_t>> tx_key_ranges; // [begin, end) of each tx's keys in tx_keys
+  for (auto &tx : digest.txs)
+  {
+    const size_t begin = tx_keys.size();
+    tx_keys.insert(tx_keys.end(), tx.tx_pub_keys.begin(), tx.tx_pub_keys.end());
+    // as cache_tx_data(), additional keys are only of use if there is one for each output
+    if (tx.additional_tx_pub_keys.size() == tx.output_keys.size())
+      tx_keys.insert(tx_keys.end(), tx.additional_tx_pub_keys.begin(), tx.additional_tx_pub_keys.end());
+    tx_key_ranges.emplace_back(begin, tx_keys.size());
+  }
+  std::vector<crypto::key_derivation> derivations;
+  const auto derived = crypto::generate_key_derivations(tx_keys, m_account.get_keys().m_view_secret_key, derivations);
+
+  std::vector<crypto::public_key> out_keys;
+  std::vector<crypto::key_derivation> out_derivations;
+  std::vector<size_t> out_indices, out_txs;
+  for (size_t j = 0; j < digest.txs.size(); ++j)
+  {
+    auto &tx = digest.txs[j];
+    auto [begin, end] = tx_key_ranges[j];
+    const size_t n_primary = tx.tx_pub_keys.size();
+    for (size_t k = 0; k < tx.output_keys.size(); ++k)
+    {
+      if (tx.output_keys[k] == crypto::null_pkey)
+        continue;
+      auto add = [&](size_t d) {
+        if (!derived[d])
+          return;
+        out_keys.push_back(tx.output_keys[k]);
+        out_derivations.push_back(derivations[d]);
+        out_indices.push_back(k);
+        out_txs.push_back(j);
+      };
+      for (size_t l = 0; l < n_primary; ++l)
+        add(begin + l);
+      if (end - begin > n_primary)
+        add(begin + n_primary + k);
+    }
+  }
+  std::vector<crypto::public_key> spend_keys;
+  const auto ok = crypto::derive_subaddress_public_keys(out_keys, out_derivations, out_indices, spend_keys);
 
-  try
+  std::vector<bool> matched(digest.txs.size(), false);
+  for (size_t o = 0; o < out_keys.size(); ++o)
   {
-    drop_from_short_history(short_chain_history, 3);
-
-    THROW_WALLET_EXCEPTION_IF(prev_blocks.size() != prev_parsed_blocks.size(), error::wallet_internal_error, "size mismatch");
-
-    // prepend the last 3 blocks, should be enough to guard against a block or two's reorg
-    auto s = std::next(prev_parsed_blocks.rbegin(), std::min((size_t)3, prev_parsed_blocks.size())).base();
-    for (; s != prev_parsed_blocks.end(); ++s)
+    if (ok[o] && m_subaddress_table.find(spend_keys[o]))
+      matched[out_txs[o]] = incoming = true;
+  }
+  for (size_t j = 0; j < digest.txs.size(); ++j)
+  {
+    if (!matched[j])
     {
-      short_chain_history.push_front(s->hash);
+      matched[j] = m_unconfirmed_txs.count(pb.block.tx_hashes[j]) > 0;
+      for (auto &ki : digest.txs[j].key_images)
+      {
+        if (matched[j])
+          break;
+        matched[j] = m_key_images.count(ki) > 0;
+      }
     }
+    if (matched[j])
+      matches.push_back(j);
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::process_digest_blocks(uint64_t start_height, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, const std::vector<cryptonote::block_digest::digest> &digests, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache)
+{
+  blocks_added = 0;
+  THROW_WALLET_EXCEPTION_IF(blocks.size() != parsed_blocks.size() || blocks.size() != digests.size(), error::wallet_internal_error, "size mismatch");
+  for (size_t i = 0; i < blocks.size(); ++i)
+    THROW_WALLET_EXCEPTION_IF(digests[i].txs.size() != parsed_blocks[i].block.tx_hashes.size(), error::wallet_internal_error,
+        "Block digest at height " + std::to_string(start_height + i) + " doesn't match its block's txs");
 
-    // pull the new blocks
-    std::vector<cryptonote::rpc::GET_BLOCKS_FAST::block_output_indices> o_indices;
-    uint64_t current_height;
-    pull_blocks(start_height, blocks_start_height, short_chain_history, blocks, o_indices, current_height);
-    THROW_WALLET_EXCEPTION_IF(blocks.size() != o_indices.size(), error::wallet_internal_error, "Mismatched sizes of blocks and o_indices");
-
-    tools::threadpool& tpool = tools::threadpool::getInstance();
-    tools::threadpool::waiter waiter;
-    parsed_blocks.resize(blocks.size());
-    for (size_t i = 0; i < blocks.size(); ++i)
-      tpool.submit(&waiter,
-              [&, i] { return parse_block_round(blocks[i].block, parsed_blocks[i].block, parsed_blocks[i].hash, parsed_blocks[i].error); },
-              true);
-    waiter.wait(&tpool);
-    for (size_t i = 0; i < blocks.size(); ++i)
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  // The last block of the previous slice, without its txs: process_parsed_blocks() wants each slice
+  // to start from a block we have
+  std::optional<std::pair<cryptonote::block_complete_entry, parsed_block>> prev;
+  size_t begin = 0;
+  while (begin < blocks.size())
+  {
+    std::vector<std::vector<size_t>> matches(blocks.size() - begin);
+    auto incoming = std::make_unique<bool[]>(matches.size());
     {
-      if (parsed_blocks[i].error)
+      tools::threadpool::waiter waiter;
+      for (size_t i = begin; i < blocks.size(); ++i)
       {
-        error = true;
-        break;
+        const uint64_t height = start_height + i;
+        if (should_skip_block(parsed_blocks[i].block, height) ||
+            (m_blockchain.is_in_bounds(height) && m_blockchain[height] == parsed_blocks[i].hash))
+          continue;
+        tpool.submit(&waiter, [&, i] { match_block_digest(parsed_blocks[i], digests[i], matches[i - begin], incoming[i - begin]); }, true);
       }
-      parsed_blocks[i].o_indices = std::move(o_indices[i]);
+      waiter.wait(&tpool);
     }
 
-    std::mutex error_lock;
-    for (size_t i = 0; i < blocks.size(); ++i)
-    {
-      parsed_blocks[i].txes.resize(blocks[i].txs.size());
-      for (size_t j = 0; j < blocks[i].txs.size(); ++j)
+    // What a tx we receive adds (its key images, and maybe more subaddresses to look out for)
+    // changes what later blocks match, so the blocks after the first such one are matched again
+    // once it has been processed.
+    size_t end = begin;
+    while (end < blocks.size() && !incoming[end++ - begin])
+      ;
+
+    std::vector<crypto::hash> txids;
+    for (size_t i = begin; i < end; ++i)
+      for (size_t j : matches[i - begin])
+        txids.push_back(parsed_blocks[i].block.tx_hashes[j]);
+    rpc::GET_TRANSACTIONS::response res{};
+    if (!txids.empty())
+      res = request_transactions(txids);
+
+    std::vector<cryptonote::block_complete_entry> slice_blocks;
+    std::vector<parsed_block> slice_parsed;
+    slice_blocks.reserve(end - begin + 1);
+    slice_parsed.reserve(end - begin + 1);
+    if (prev)
+    {
+      slice_blocks.push_back(std::move(prev->first));
+      slice_parsed.push_back(std::move(prev->second));
+    }
+    size_t t = 0;
+    for (size_t i = begin; i < end; ++i)
+    {
+      auto &bche = slice_blocks.emplace_back();
+      auto &pb = slice_parsed.emplace_back();
+      bche.block = std::move(blocks[i].block);
+      pb.hash = parsed_blocks[i].hash;
+      pb.block = std::move(parsed_blocks[i].block);
+      pb.error = false;
+      pb.block.tx_hashes.clear();
+      pb.o_indices.indices.resize(1);
+      pb.o_indices.indices[0].indices = digests[i].miner_tx_output_indices;
+      for (size_t n = 0; n < matches[i - begin].size(); ++n, ++t)
       {
-        tpool.submit(&waiter, [&, i, j](){
-          if (!parse_and_validate_tx_base_from_blob(blocks[i].txs[j], parsed_blocks[i].txes[j]))
-          {
-            std::lock_guard lock{error_lock};
-            error = true;
-          }
-        }, true);
+        auto &entry = res.txs[t];
+        const crypto::hash &txid = txids[t];
+        THROW_WALLET_EXCEPTION_IF(entry.tx_hash != tools::type_to_hex(txid) || entry.in_pool || !entry.pruned_as_hex,
+            error::wallet_internal_error, "Unexpected tx " + entry.tx_hash + " from daemon, expected " + tools::type_to_hex(txid) + " of block " + std::to_string(start_height + i));
+        cryptonote::blobdata blob;
+        cryptonote::transaction tx;
+        THROW_WALLET_EXCEPTION_IF(!epee::string_tools::parse_hexstr_to_binbuff(*entry.pruned_as_hex, blob) || !cryptonote::parse_and_validate_tx_base_from_blob(blob, tx),
+            error::wallet_internal_error, "Failed to parse tx " + entry.tx_hash + " from daemon");
+        bche.txs.push_back(std::move(blob));
+        pb.block.tx_hashes.push_back(txid);
+        pb.txes.push_back(std::move(tx));
+        pb.o_indices.indices.emplace_back().indices = std::move(entry.output_indices);
       }
     }
-    waiter.wait(&tpool);
-    last = !blocks.empty() && cryptonote::get_block_height(parsed_blocks.back().block) + 1 == current_height;
-  }
-  catch(...)
-  {
-    error = true;
+
+    uint64_t added = 0;
+    process_parsed_blocks(start_height + begin - (prev ? 1 : 0), slice_blocks, slice_parsed, added, output_tracker_cache);
+    blocks_added += added;
+
+    prev.emplace(std::move(slice_blocks.back()), std::move(slice_parsed.back()));
+    prev->first.txs.clear();
+    prev->second.block.tx_hashes.clear();
+    prev->second.txes.clear();
+    prev->second.o_indices.indices.resize(1);
+    begin = end;
   }
 }
-
+//----------------------------------------------------------------------------------------------------
+void wallet2::refresh(bool trusted_daemon)
+{
+  uint64_t blocks_fetched = 0;
+  refresh(trusted_daemon, 0, blocks_fetched);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blocks_fetched)
+{
+  bool received_money = false;
+  refresh(trusted_daemon, start_height, blocks_fetched, received_money);
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::remove_obsolete_pool_txs(const std::vector<crypto::hash> &tx_hashes)
 {
   // remove pool txes to us that aren't in the pool anymore
@@ -3075,12 +3398,57 @@ rpc::GET_TRANSACTIONS::response wallet2::request_transactions(const std::vector<
 }
 
 
+//----------------------------------------------------------------------------------------------------
+bool wallet2::update_pool_hashes()
+{
+  if (m_pool_changes_unsupported)
+    return false;
+
+  rpc::GET_TRANSACTION_POOL_CHANGES_BIN::request req{};
+  rpc::GET_TRANSACTION_POOL_CHANGES_BIN::response res{};
+  req.pool_id = m_pool_id;
+  req.since = m_pool_seq;
+  bool r = invoke_http<rpc::GET_TRANSACTION_POOL_CHANGES_BIN>(req, res);
+  if (!r || res.status != rpc::STATUS_OK)
+  {
+    THROW_WALLET_EXCEPTION_IF(r && res.status == rpc::STATUS_BUSY, error::daemon_busy, "get_transaction_pool_changes.bin");
+    // An old daemon, or no daemon: the full requests will tell
+    m_pool_id = 0;
+    return false;
+  }
+
+  if (res.full)
+    m_pool_hashes.clear();
+  for (const auto& txid : res.removed_hashes)
+    m_pool_hashes.erase(txid);
+  for (const auto& txid : res.tx_hashes)
+    m_pool_hashes[txid] = false;
+  for (const auto& txid : res.blink_hashes)
+    m_pool_hashes[txid] = true;
+  m_pool_id = res.pool_id;
+  m_pool_seq = res.seq;
+  MDEBUG("Pool changes: " << (res.full ? "full, " : "") << res.tx_hashes.size() << " txs, " << res.blink_hashes.size()
+      << " blinks, " << res.removed_hashes.size() << " removed; " << m_pool_hashes.size() << " txs in the pool");
+  return true;
+}
 //----------------------------------------------------------------------------------------------------
 std::vector<wallet2::get_pool_state_tx> wallet2::get_pool_state(bool refreshed)
 {
   std::vector<wallet2::get_pool_state_tx> process_txs;
   MTRACE("get_pool_state: take hashes from cache");
   std::vector<crypto::hash> blink_hashes, pool_hashes;
+  if (update_pool_hashes())
+  {
+    MTRACE("get_pool_state got pool changes");
+    pool_hashes.reserve(m_pool_hashes.size());
+    for (const auto& [txid, blink] : m_pool_hashes)
+    {
+      pool_hashes.push_back(txid);
+      if (blink)
+        blink_hashes.push_back(txid);
+    }
+  }
+  else
   {
     // We make two requests here: one for all pool txes, and then (assuming there are any) a second
     // one for blink txes.
@@ -3105,6 +3473,8 @@ std::vector<wallet2::get_pool_state_tx> wallet2::get_pool_state(bool refreshed)
     THROW_WALLET_EXCEPTION_IF(res.status != rpc::STATUS_OK, error::get_tx_pool_error);
     MTRACE("get_pool_state got blinks");
     blink_hashes = std::move(res.tx_hashes);
+    // The daemon answers these but not GET_TRANSACTION_POOL_CHANGES_BIN, so don't bother asking again
+    m_pool_changes_unsupported = true;
   }
 
   OXEN_DEFER {
@@ -3134,11 +3504,13 @@ std::vector<wallet2::get_pool_state_tx> wallet2::get_pool_state(bool refreshed)
       {
         LOG_PRINT_L1("Pending txid " << txid << " not in pool, marking as not in pool");
         pit->second.m_state = wallet2::unconfirmed_transfer_details::pending_not_in_pool;
+        m_transfers_cache.reset();
       }
       else if (pit->second.m_state == wallet2::unconfirmed_transfer_details::pending_not_in_pool && refreshed)
       {
         LOG_PRINT_L1("Pending txid " << txid << " not in pool, marking as failed");
         pit->second.m_state = wallet2::unconfirmed_transfer_details::failed;
+        m_transfers_cache.reset();
 
         // the inputs aren't spent anymore, since the tx failed
         for (size_t vini = 0; vini < pit->second.m_tx.vin.size(); ++vini)
@@ -3464,16 +3836,12 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   size_t try_count = 0;
   crypto::hash last_tx_hash_id = m_transfers.size() ? m_transfers.back().m_txid : null_hash;
   std::list<crypto::hash> short_chain_history;
-  tools::threadpool& tpool = tools::threadpool::getInstance();
-  tools::threadpool::waiter waiter;
   uint64_t blocks_start_height;
-  std::vector<cryptonote::block_complete_entry> blocks;
-  std::vector<parsed_block> parsed_blocks;
   std::shared_ptr<std::map<std::pair<uint64_t, uint64_t>, size_t>> output_tracker_cache;
   hw::device &hwdev = m_account.get_device();
 
   // pull the first set of blocks
-  get_short_chain_history(short_chain_history, (m_first_refresh_done || trusted_daemon) ? 1 : FIRST_REFRESH_GRANULARITY);
+  get_refresh_short_chain_history(short_chain_history, trusted_daemon);
   m_run.store(true, std::memory_order_relaxed);
   if (start_height > m_blockchain.size() || m_refresh_from_block_height > m_blockchain.size()) {
     if (!start_height)
@@ -3482,7 +3850,7 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
     fast_refresh(start_height, blocks_start_height, short_chain_history);
     // regenerate the history now that we've got a full set of hashes
     short_chain_history.clear();
-    get_short_chain_history(short_chain_history, (m_first_refresh_done || trusted_daemon) ? 1 : FIRST_REFRESH_GRANULARITY);
+    get_refresh_short_chain_history(short_chain_history, trusted_daemon);
     start_height = 0;
     // and then fall through to regular refresh processing
   }
@@ -3505,6 +3873,8 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   };
 
 
+  publish_balance_snapshot();
+
   // get updated pool state first, but do not process those txes just yet,
   // since that might cause a password prompt, which would introduce a data
   // leak allowing a passive adversary with traffic analysis capability to
@@ -3513,104 +3883,90 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   if (check_pool)
     process_pool_txs = get_pool_state(true /*refreshed*/);
 
-  bool first = true, last = false;
+  // fetching and parsing the next spans of blocks happens while we're processing the current one
+  std::unique_ptr<block_prefetcher> prefetcher;
   while(m_run.load(std::memory_order_relaxed))
   {
-    uint64_t next_blocks_start_height;
-    std::vector<cryptonote::block_complete_entry> next_blocks;
-    std::vector<parsed_block> next_parsed_blocks;
-    bool error;
-    std::exception_ptr exception;
+    added_blocks = 0;
     try
     {
-      // pull the next set of blocks while we're processing the current one
-      error = false;
-      next_blocks.clear();
-      next_parsed_blocks.clear();
-      added_blocks = 0;
-      if (!first && blocks.empty())
-        break;
-      if (!last)
-        tpool.submit(&waiter, [&]{pull_and_parse_next_blocks(start_height, next_blocks_start_height, short_chain_history, blocks, parsed_blocks, next_blocks, next_parsed_blocks, last, error, exception);});
-
-      if (!first)
-      {
-        try
-        {
-          process_parsed_blocks(blocks_start_height, blocks, parsed_blocks, added_blocks, output_tracker_cache.get());
-        }
-        catch (const tools::error::out_of_hashchain_bounds_error&)
-        {
-          MINFO("Daemon claims next refresh block is out of hash chain bounds, resetting hash chain");
-          uint64_t stop_height = m_blockchain.offset();
-          std::vector<crypto::hash> tip(m_blockchain.size() - m_blockchain.offset());
-          for (size_t i = m_blockchain.offset(); i < m_blockchain.size(); ++i)
-            tip[i - m_blockchain.offset()] = m_blockchain[i];
-          cryptonote::block b;
-          generate_genesis(b);
-          m_blockchain.clear();
-          m_blockchain.push_back(get_block_hash(b));
-          short_chain_history.clear();
-          get_short_chain_history(short_chain_history);
-          fast_refresh(stop_height, blocks_start_height, short_chain_history, true);
-          THROW_WALLET_EXCEPTION_IF((m_blockchain.size() == stop_height || (m_blockchain.size() == 1 && stop_height == 0) ? false : true), error::wallet_internal_error, "Unexpected hashchain size");
-          THROW_WALLET_EXCEPTION_IF(m_blockchain.offset() != 0, error::wallet_internal_error, "Unexpected hashchain offset");
-          for (const auto &h: tip)
-            m_blockchain.push_back(h);
-          short_chain_history.clear();
-          get_short_chain_history(short_chain_history);
-          start_height = stop_height;
-          throw std::runtime_error(""); // loop again
-        }
-        catch (const std::exception &e)
-        {
-          MERROR("Error parsing blocks: " << e.what());
-          error = true;
-        }
-        blocks_fetched += added_blocks;
-      }
-      waiter.wait(&tpool);
-      if(!first && blocks_start_height == next_blocks_start_height)
+      if (!prefetcher)
+        prefetcher = std::make_unique<block_prefetcher>(*this, short_chain_history);
+      auto span = prefetcher->next();
+      if (!span)
       {
         m_node_rpc_proxy.set_height(m_blockchain.size());
         break;
       }
 
-      first = false;
-
-      // handle error from async fetching thread
-      if (error)
-      {
-        throw std::runtime_error("proxy exception in refresh thread");
-      }
-
       // if we've got at least 10 blocks to refresh, assume we're starting
       // a long refresh, and setup a tracking output cache if we need to
-      if (m_track_uses && (!output_tracker_cache || output_tracker_cache->empty()) && next_blocks.size() >= 10)
+      if (m_track_uses && (!output_tracker_cache || output_tracker_cache->empty()) && span->blocks.size() >= 10)
         output_tracker_cache = create_output_tracker_cache();
 
-      // switch to the new blocks from the daemon
-      blocks_start_height = next_blocks_start_height;
-      blocks = std::move(next_blocks);
-      parsed_blocks = std::move(next_parsed_blocks);
+      try
+      {
+        // One ringdb write for the rings of all of the span's outgoing txs, rather than one per tx
+        if (m_ringdb)
+          m_ringdb->begin_batch();
+        OXEN_DEFER {
+          if (m_ringdb)
+          {
+            try { m_ringdb->end_batch(); }
+            catch (const std::exception &e) { MERROR("Failed to save rings: " << e.what()); }
+          }
+        };
+        if (span->digests.empty())
+          process_parsed_blocks(span->start_height, span->blocks, span->parsed_blocks, added_blocks, output_tracker_cache.get());
+        else
+          process_digest_blocks(span->start_height, span->blocks, span->parsed_blocks, span->digests, added_blocks, output_tracker_cache.get());
+      }
+      catch (const tools::error::out_of_hashchain_bounds_error&)
+      {
+        MINFO("Daemon claims next refresh block is out of hash chain bounds, resetting hash chain");
+        uint64_t stop_height = m_blockchain.offset();
+        std::vector<crypto::hash> tip(m_blockchain.size() - m_blockchain.offset());
+        for (size_t i = m_blockchain.offset(); i < m_blockchain.size(); ++i)
+          tip[i - m_blockchain.offset()] = m_blockchain[i];
+        cryptonote::block b;
+        generate_genesis(b);
+        m_blockchain.clear();
+        m_blockchain.push_back(get_block_hash(b));
+        short_chain_history.clear();
+        get_short_chain_history(short_chain_history);
+        fast_refresh(stop_height, blocks_start_height, short_chain_history, true);
+        THROW_WALLET_EXCEPTION_IF((m_blockchain.size() == stop_height || (m_blockchain.size() == 1 && stop_height == 0) ? false : true), error::wallet_internal_error, "Unexpected hashchain size");
+        THROW_WALLET_EXCEPTION_IF(m_blockchain.offset() != 0, error::wallet_internal_error, "Unexpected hashchain offset");
+        for (const auto &h: tip)
+          m_blockchain.push_back(h);
+        throw std::runtime_error(""); // loop again
+      }
+      catch (const std::exception &e)
+      {
+        MERROR("Error parsing blocks: " << e.what());
+        throw std::runtime_error("failed to process blocks");
+      }
+      blocks_fetched += added_blocks;
+      if (added_blocks > 0)
+        publish_balance_snapshot();
+      if (m_refresh_max_blocks > 0 && blocks_fetched >= m_refresh_max_blocks)
+      {
+        MDEBUG("Refreshed " << blocks_fetched << " blocks, stopping for now at the refresh block limit");
+        break;
+      }
     }
     catch (const tools::error::password_needed&)
     {
       blocks_fetched += added_blocks;
-      waiter.wait(&tpool);
       throw;
     }
     catch (const std::exception&)
     {
       blocks_fetched += added_blocks;
-      waiter.wait(&tpool);
+      prefetcher.reset();
       if(try_count < 3)
       {
         LOG_PRINT_L1("Another try pull_blocks (try_count=" << try_count << ")...");
-        first = true;
-        start_height = 0;
-        blocks.clear();
-        parsed_blocks.clear();
         short_chain_history.clear();
         get_short_chain_history(short_chain_history, 1);
         ++try_count;
@@ -3641,6 +3997,7 @@ void wallet2::refresh(bool trusted_daemon, uint64_t start_height, uint64_t & blo
   }
 
   m_first_refresh_done = true;
+  publish_balance_snapshot();
 
   LOG_PRINT_L1("Refresh done, blocks received: " << blocks_fetched << ", balance (all accounts): " << print_money(balance_all(false)) << ", unlocked: " << print_money(unlocked_balance_all(false)));
 }
@@ -3659,7 +4016,7 @@ bool wallet2::refresh(bool trusted_daemon, uint64_t & blocks_fetched, bool& rece
   return ok;
 }
 //----------------------------------------------------------------------------------------------------
-bool wallet2::get_rct_distribution(uint64_t &start_height, std::vector<uint64_t> &distribution)
+bool wallet2::update_rct_distribution()
 {
   rpc::version_t rpc_version;
   if (!m_node_rpc_proxy.get_rpc_version(rpc_version))
@@ -3676,6 +4033,13 @@ bool wallet2::get_rct_distribution(uint64_t &start_height, std::vector<uint64_t>
   cryptonote::rpc::GET_OUTPUT_DISTRIBUTION_BIN::response res{};
   req.amounts.push_back(0);
   req.from_height = 0;
+  // Daemons since 4.1 can send just the blocks after the ones we already have
+  const bool incremental = rpc_version >= rpc::version_t{4, 1} && !m_rct_distribution.empty() && !m_rct_distribution_top_hash.empty();
+  if (incremental)
+  {
+    req.from_height = m_rct_distribution_start_height + m_rct_distribution.size();
+    req.known_hash = m_rct_distribution_top_hash;
+  }
   req.cumulative = false;
   req.binary = true;
   req.compress = true;
@@ -3705,10 +4069,27 @@ bool wallet2::get_rct_distribution(uint64_t &start_height, std::vector<uint64_t>
     MWARNING("Failed to request output distribution: results are not for amount 0");
     return false;
   }
-  for (size_t i = 1; i < res.distributions[0].data.distribution.size(); ++i)
-    res.distributions[0].data.distribution[i] += res.distributions[0].data.distribution[i-1];
-  start_height = res.distributions[0].data.start_height;
-  distribution = std::move(res.distributions[0].data.distribution);
+  auto& data = res.distributions[0].data;
+  if (incremental && data.start_height == req.from_height)
+  {
+    if (!data.distribution.empty())
+      m_gamma_picker.reset();
+    // Just the new blocks (if any): extend what we have
+    uint64_t cumulative = m_rct_distribution.back();
+    m_rct_distribution.reserve(m_rct_distribution.size() + data.distribution.size());
+    for (uint64_t count : data.distribution)
+      m_rct_distribution.push_back(cumulative += count);
+  }
+  else
+  {
+    // A full distribution (first request, old daemon, or the daemon no longer has our top block)
+    for (size_t i = 1; i < data.distribution.size(); ++i)
+      data.distribution[i] += data.distribution[i-1];
+    m_rct_distribution_start_height = data.start_height;
+    m_rct_distribution = std::move(data.distribution);
+    m_gamma_picker.reset();
+  }
+  m_rct_distribution_top_hash = std::move(res.top_hash);
   return true;
 }
 //----------------------------------------------------------------------------------------------------
@@ -3741,7 +4122,10 @@ bool wallet2::get_output_blacklist(std::vector<uint64_t> &blacklist)
 //----------------------------------------------------------------------------------------------------
 void wallet2::detach_blockchain(uint64_t height, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache)
 {
+  wait_for_history();
+  m_transfers_cache.reset();
   LOG_PRINT_L0("Detaching blockchain on height " << height);
+  m_transfer_history.reset();
 
   // size  1 2 3 4 5 6 7 8 9
   // block 0 1 2 3 4 5 6 7 8
@@ -3824,12 +4208,20 @@ bool wallet2::deinit()
 //----------------------------------------------------------------------------------------------------
 bool wallet2::clear()
 {
+  // Whatever became of the background history load, it's all being dropped
+  if (m_history_load.valid())
+    m_history_load.wait();
+  m_history_load = {};
+  m_history_error = nullptr;
   m_blockchain.clear();
   m_transfers.clear();
   m_key_images.clear();
   m_pub_keys.clear();
   m_unconfirmed_txs.clear();
   m_payments.clear();
+  m_transfer_history.reset();
+  m_transfers_cache.reset();
+  m_multisig_partial_key_images.clear();
   m_tx_keys.clear();
   m_additional_tx_keys.clear();
   m_confirmed_txs.clear();
@@ -3838,14 +4230,17 @@ bool wallet2::clear()
   m_scanned_pool_txs[1].clear();
   m_address_book.clear();
   m_subaddresses.clear();
+  m_subaddress_table.clear();
   m_subaddress_labels.clear();
   m_multisig_rounds_passed = 0;
   m_device_last_key_image_sync = 0;
+  m_cache_db.reset();
   return true;
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::clear_soft(bool keep_key_images)
 {
+  wait_for_history();
   m_blockchain.clear();
   m_transfers.clear();
   if (!keep_key_images)
@@ -3853,6 +4248,8 @@ void wallet2::clear_soft(bool keep_key_images)
   m_pub_keys.clear();
   m_unconfirmed_txs.clear();
   m_payments.clear();
+  m_transfer_history.reset();
+  m_transfers_cache.reset();
   m_confirmed_txs.clear();
   m_unconfirmed_payments.clear();
   m_scanned_pool_txs[0].clear();
@@ -4048,6 +4445,12 @@ std::optional<wallet2::keys_file_data> wallet2::get_keys_file_data(const epee::w
   value2.SetInt(m_track_uses ? 1 : 0);
   json.AddMember("track_uses", value2, json.GetAllocator());
 
+  value2.SetInt(m_incremental_cache ? 1 : 0);
+  json.AddMember("incremental_cache", value2, json.GetAllocator());
+
+  value2.SetInt(m_sync_from_digests ? 1 : 0);
+  json.AddMember("sync_from_digests", value2, json.GetAllocator());
+
   value2.SetInt(m_inactivity_lock_timeout.count());
   json.AddMember("inactivity_lock_timeout", value2, json.GetAllocator());
 
@@ -4215,6 +4618,8 @@ bool wallet2::load_keys_buf(const std::string& keys_buf, const epee::wipeable_st
     m_ignore_outputs_above = MONEY_SUPPLY;
     m_ignore_outputs_below = 0;
     m_track_uses = false;
+    m_incremental_cache = false;
+    m_sync_from_digests = false;
     m_inactivity_lock_timeout = DEFAULT_INACTIVITY_LOCK_TIMEOUT;
     m_subaddress_lookahead_major = SUBADDRESS_LOOKAHEAD_MAJOR;
     m_subaddress_lookahead_minor = SUBADDRESS_LOOKAHEAD_MINOR;
@@ -4374,6 +4779,10 @@ bool wallet2::load_keys_buf(const std::string& keys_buf, const epee::wipeable_st
     m_ignore_outputs_below = field_ignore_outputs_below;
     GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, track_uses, int, Int, false, false);
     m_track_uses = field_track_uses;
+    GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, incremental_cache, int, Int, false, false);
+    m_incremental_cache = field_incremental_cache;
+    GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, sync_from_digests, int, Int, false, false);
+    m_sync_from_digests = field_sync_from_digests;
     GET_FIELD_FROM_JSON_RETURN_ON_ERROR(json, inactivity_lock_timeout, uint32_t, Uint, false,
             m_nettype == MAINNET ? std::chrono::seconds{DEFAULT_INACTIVITY_LOCK_TIMEOUT}.count() : 0);
     m_inactivity_lock_timeout = std::chrono::seconds{field_inactivity_lock_timeout};
@@ -5227,6 +5636,7 @@ std::string wallet2::exchange_multisig_keys(const epee::wipeable_string &passwor
     }
 
     m_subaddresses.clear();
+    m_subaddress_table.clear();
     m_subaddress_labels.clear();
     add_subaddress_account(tr("Primary account"));
 
@@ -5635,6 +6045,7 @@ bool wallet2::check_connection(rpc::version_t *version, bool *ssl, bool throw_on
 //----------------------------------------------------------------------------------------------------
 void wallet2::set_offline(bool offline)
 {
+  m_transfers_cache.reset();
   m_offline = offline;
   m_node_rpc_proxy.set_offline(offline);
 }
@@ -5690,6 +6101,10 @@ void wallet2::load(const fs::path& wallet_, const epee::wipeable_string& passwor
     LOG_PRINT_L0("file not found: " << m_wallet_file << ", starting with empty blockchain");
     m_account_public_address = m_account.get_keys().m_account_address;
   }
+  else if (use_fs && wallet_cache_db::is_cache_db(m_wallet_file))
+  {
+    load_cache_db();
+  }
   else if (use_fs || !cache_buf.empty())
   {
     wallet2::cache_file_data cache_file_data;
@@ -5800,6 +6215,9 @@ void wallet2::load(const fs::path& wallet_, const epee::wipeable_string& passwor
 
   trim_hashchain();
 
+  m_subaddress_table.reserve(m_subaddresses.size());
+  for (const auto& [key, index] : m_subaddresses)
+    m_subaddress_table.insert(key, index);
   if (get_num_subaddress_accounts() == 0)
     add_subaddress_account(tr("Primary account"));
 
@@ -5877,6 +6295,7 @@ void wallet2::store()
 //----------------------------------------------------------------------------------------------------
 void wallet2::store_to(const fs::path &path, const epee::wipeable_string &password)
 {
+  wait_for_history();
   trim_hashchain();
 
   // if file is the same, we do:
@@ -5898,9 +6317,13 @@ void wallet2::store_to(const fs::path &path, const epee::wipeable_string &passwo
       fs::create_directories(parent_path);
   }
 
-  // get wallet cache data
-  std::optional<wallet2::cache_file_data> cache_file_data = get_cache_file_data(password);
-  THROW_WALLET_EXCEPTION_IF(!cache_file_data, error::wallet_internal_error, "failed to generate wallet cache data");
+  // get wallet cache data (unless we are only updating the cache database)
+  std::optional<wallet2::cache_file_data> cache_file_data;
+  if (!same_file || !m_incremental_cache)
+  {
+    cache_file_data = get_cache_file_data(password);
+    THROW_WALLET_EXCEPTION_IF(!cache_file_data, error::wallet_internal_error, "failed to generate wallet cache data");
+  }
 
   const auto& old_file = m_wallet_file;
   const auto& old_keys_file = m_keys_file;
@@ -5926,6 +6349,7 @@ void wallet2::store_to(const fs::path &path, const epee::wipeable_string &passwo
         LOG_ERROR("error removing file: " << old_address_file << ": " << ec.message());
     }
     // remove old wallet file
+    m_cache_db.reset();
     if (!fs::remove(old_file, ec))
       LOG_ERROR("error removing file: " << old_file << ": " << ec.message());
     // remove old keys file
@@ -5934,7 +6358,12 @@ void wallet2::store_to(const fs::path &path, const epee::wipeable_string &passwo
     // remove old message store file
     if (fs::exists(old_mms_file, ec) && !fs::remove(old_mms_file, ec))
       LOG_ERROR("error removing file: " << old_mms_file << ": " << ec.message());
+  } else if (m_incremental_cache) {
+    store_cache_db();
   } else {
+    // the single file cache replaces the cache database, if we had one
+    m_cache_db.reset();
+
     // save to new file
     fs::path new_file = m_wallet_file;
     new_file += ".new";
@@ -5969,6 +6398,7 @@ void wallet2::store_to(const fs::path &path, const epee::wipeable_string &passwo
 //----------------------------------------------------------------------------------------------------
 std::optional<wallet2::cache_file_data> wallet2::get_cache_file_data(const epee::wipeable_string &passwords)
 {
+  wait_for_history();
   trim_hashchain();
   try
   {
@@ -5991,19 +6421,291 @@ std::optional<wallet2::cache_file_data> wallet2::get_cache_file_data(const epee:
   }
 }
 //----------------------------------------------------------------------------------------------------
-uint64_t wallet2::balance(uint32_t index_major, bool strict) const
-{
-  uint64_t amount = 0;
-  if(m_light_wallet)
-    return m_light_wallet_unlocked_balance;
-  for (const auto& i : balance_per_subaddress(index_major, strict))
-    amount += i.second;
-  return amount;
-}
-//----------------------------------------------------------------------------------------------------
-uint64_t wallet2::unlocked_balance(uint32_t index_major, bool strict, uint64_t *blocks_to_unlock, uint64_t *time_to_unlock) const
-{
-  uint64_t amount = 0;
+namespace {
+  // Records per page of the wallet cache database: small enough that a change rewrites little,
+  // large enough that there aren't too many pages.  The hash chain is pages of hashes.
+  constexpr size_t CACHE_PAGE_RECORDS = 256;
+  constexpr size_t CACHE_PAGE_HASHES = 4096;
+
+  // Each page is a portable binary archive of a record count followed by the records
+  template <typename F>
+  std::string write_cache_page(uint64_t count, F&& write_records)
+  {
+    std::ostringstream oss;
+    {
+      boost::archive::portable_binary_oarchive ar{oss};
+      ar << count;
+      write_records(ar);
+    }
+    return oss.str();
+  }
+
+  template <typename F>
+  void read_cache_pages(const std::vector<std::string>& pages, F&& read_record)
+  {
+    for (const auto& page : pages)
+    {
+      std::istringstream iss{page};
+      boost::archive::portable_binary_iarchive ar{iss};
+      uint64_t count;
+      ar >> count;
+      for (uint64_t i = 0; i < count; i++)
+        read_record(ar);
+    }
+  }
+
+  // Stores the records of a vector-like container, CACHE_PAGE_RECORDS (or `per_page`) per page.
+  // Returns the number of pages written.
+  template <typename Get>
+  size_t store_sequence(wallet_cache_db& db, const crypto::chacha_key& key, std::string_view section,
+      size_t size, size_t per_page, Get&& get)
+  {
+    size_t pages = (size + per_page - 1) / per_page, written = 0;
+    for (size_t p = 0; p < pages; p++)
+    {
+      size_t begin = p * per_page, end = std::min(size, begin + per_page);
+      written += db.put(key, section, p, write_cache_page(end - begin, [&](auto& ar) {
+        for (size_t i = begin; i < end; i++)
+          ar << get(i);
+      }));
+    }
+    db.truncate(section, pages);
+    return written;
+  }
+
+  // Stores the entries of a map.  Entries go to the page selected by `page_of` (so that adding or
+  // changing one only changes its page) and are sorted with `less` within the page (so that the
+  // page's contents don't depend on the map's iteration order).  The number of pages is a power of
+  // two, kept as it is until the map is more than twice or less than a quarter of the size it suits.
+  // Returns the number of pages written.
+  template <typename Map, typename PageOf, typename Less>
+  size_t store_map(wallet_cache_db& db, const crypto::chacha_key& key, std::string_view section,
+      const Map& map, PageOf&& page_of, Less&& less)
+  {
+    size_t pages = db.pages(section);
+    if (pages == 0 || map.size() > 2 * CACHE_PAGE_RECORDS * pages || 4 * map.size() < CACHE_PAGE_RECORDS * pages)
+      for (pages = 1; pages * CACHE_PAGE_RECORDS < map.size(); pages <<= 1) {}
+
+    std::vector<std::vector<const typename Map::value_type*>> by_page(pages);
+    for (const auto& kv : map)
+      by_page[page_of(kv) & (pages - 1)].push_back(&kv);
+
+    size_t written = 0;
+    for (size_t p = 0; p < pages; p++)
+    {
+      auto& entries = by_page[p];
+      std::sort(entries.begin(), entries.end(), [&](auto* a, auto* b) { return less(*a, *b); });
+      written += db.put(key, section, p, write_cache_page(entries.size(), [&](auto& ar) {
+        for (auto* kv : entries)
+        {
+          ar << kv->first;
+          ar << kv->second;
+        }
+      }));
+    }
+    db.truncate(section, pages);
+    return written;
+  }
+
+  template <typename Map>
+  size_t store_map(wallet_cache_db& db, const crypto::chacha_key& key, std::string_view section, const Map& map)
+  {
+    using value_type = typename Map::value_type;
+    return store_map(db, key, section, map,
+        [](const value_type& kv) { return std::hash<typename Map::key_type>{}(kv.first); },
+        [](const value_type& a, const value_type& b) { return a.first < b.first; });
+  }
+
+  template <typename Map>
+  void load_map(wallet_cache_db& db, const crypto::chacha_key& key, std::string_view section, Map& map)
+  {
+    read_cache_pages(db.load(key, section), [&](auto& ar) {
+      typename Map::key_type k;
+      typename Map::mapped_type v;
+      ar >> k;
+      ar >> v;
+      map.emplace(std::move(k), std::move(v));
+    });
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::load_cache_db()
+{
+  m_transfers_cache.reset();
+  try
+  {
+    m_cache_db = std::make_unique<wallet_cache_db>(m_wallet_file);
+    auto& db = *m_cache_db;
+
+    // The wallet itself, stored without the containers that get their own sections below
+    auto wallet = db.load(m_cache_key, "wallet");
+    THROW_WALLET_EXCEPTION_IF(wallet.size() != 1, error::wallet_internal_error, "no wallet data in the wallet cache database");
+    {
+      std::istringstream iss{wallet[0]};
+      boost::archive::portable_binary_iarchive ar{iss};
+      ar >> *this;
+    }
+
+    read_cache_pages(db.load(m_cache_key, "hashchain"), [&](auto& ar) {
+      crypto::hash h;
+      ar >> h;
+      m_blockchain.push_back(h);
+    });
+    auto transfer_pages = db.load(m_cache_key, "transfers");
+    m_transfers.reserve(transfer_pages.size() * CACHE_PAGE_RECORDS);
+    read_cache_pages(transfer_pages, [&](auto& ar) {
+      ar >> m_transfers.emplace_back();
+    });
+    load_map(db, m_cache_key, "key_images", m_key_images);
+    load_map(db, m_cache_key, "pub_keys", m_pub_keys);
+    load_map(db, m_cache_key, "subaddresses", m_subaddresses);
+  }
+  catch (const error::wallet_internal_error&)
+  {
+    m_cache_db.reset();
+    throw;
+  }
+  catch (const std::exception& e)
+  {
+    m_cache_db.reset();
+    THROW_WALLET_EXCEPTION(error::wallet_internal_error, "failed to load wallet cache database " + m_wallet_file.u8string() + ": " + e.what());
+  }
+
+  THROW_WALLET_EXCEPTION_IF(
+    m_account_public_address.m_spend_public_key != m_account.get_keys().m_account_address.m_spend_public_key ||
+    m_account_public_address.m_view_public_key  != m_account.get_keys().m_account_address.m_view_public_key,
+    error::wallet_files_doesnt_correspond, m_keys_file, m_wallet_file);
+
+  // Nothing needs the history to scan or to give balances, so it loads in the background, and
+  // opening a wallet with a long history doesn't wait for it
+  m_history_load = std::async(std::launch::async, [this, &db = *m_cache_db, key = m_cache_key] {
+    load_map(db, key, "payments", m_payments);
+    load_map(db, key, "confirmed_txs", m_confirmed_txs);
+    load_map(db, key, "tx_keys", m_tx_keys);
+    load_map(db, key, "additional_tx_keys", m_additional_tx_keys);
+    MDEBUG("Loaded transfer history: " << m_payments.size() << " payments, " << m_confirmed_txs.size() << " outgoing txs");
+  });
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::wait_for_history() const
+{
+  if (m_history_load.valid())
+  {
+    try { m_history_load.get(); }
+    catch (...) { m_history_error = std::current_exception(); }
+  }
+  if (!m_history_error)
+    return;
+  // Sticky, so that a store can't overwrite the history with what little of it got loaded
+  try { std::rethrow_exception(m_history_error); }
+  catch (const error::wallet_internal_error&) { throw; }
+  catch (const std::exception& e)
+  {
+    THROW_WALLET_EXCEPTION(error::wallet_internal_error, "failed to load transfer history from " + m_wallet_file.u8string() + ": " + e.what());
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::store_cache_db()
+{
+  wait_for_history();
+  trim_hashchain();
+
+  // Storing to a wallet that still has a single file cache (or none yet) writes a complete database
+  // next to it and then replaces the file with it
+  const bool replacing = !m_cache_db;
+  if (replacing)
+  {
+    fs::path new_file = m_wallet_file;
+    new_file += ".new";
+    std::error_code ec;
+    fs::remove(new_file, ec);
+    m_cache_db = std::make_unique<wallet_cache_db>(new_file);
+  }
+  auto& db = *m_cache_db;
+
+  size_t written = 0;
+  db.begin();
+  try
+  {
+    written += store_sequence(db, m_cache_key, "hashchain", m_blockchain.size() - m_blockchain.offset(), CACHE_PAGE_HASHES,
+        [this](size_t i) -> const crypto::hash& { return m_blockchain[m_blockchain.offset() + i]; });
+    written += store_sequence(db, m_cache_key, "transfers", m_transfers.size(), CACHE_PAGE_RECORDS,
+        [this](size_t i) -> const transfer_details& { return m_transfers[i]; });
+    written += store_map(db, m_cache_key, "key_images", m_key_images);
+    written += store_map(db, m_cache_key, "pub_keys", m_pub_keys);
+    // Most payments have the same (null) payment id, so page them by tx hash instead
+    written += store_map(db, m_cache_key, "payments", m_payments,
+        [](const auto& kv) { return std::hash<crypto::hash>{}(kv.second.m_tx_hash); },
+        [](const auto& a, const auto& b) {
+          return std::tie(a.second.m_tx_hash, a.first, a.second.m_subaddr_index.major, a.second.m_subaddr_index.minor)
+               < std::tie(b.second.m_tx_hash, b.first, b.second.m_subaddr_index.major, b.second.m_subaddr_index.minor);
+        });
+    written += store_map(db, m_cache_key, "confirmed_txs", m_confirmed_txs);
+    written += store_map(db, m_cache_key, "tx_keys", m_tx_keys);
+    written += store_map(db, m_cache_key, "additional_tx_keys", m_additional_tx_keys);
+    written += store_map(db, m_cache_key, "subaddresses", m_subaddresses);
+
+    // Everything else: serialize the wallet with the containers stored above moved out of the way
+    std::deque<crypto::hash> hashes;
+    transfer_container transfers;
+    payment_container payments;
+    decltype(m_key_images) key_images;
+    decltype(m_pub_keys) pub_keys;
+    decltype(m_confirmed_txs) confirmed_txs;
+    decltype(m_tx_keys) tx_keys;
+    decltype(m_additional_tx_keys) additional_tx_keys;
+    decltype(m_subaddresses) subaddresses;
+    auto swap_out = [&] {
+      m_blockchain.swap_hashes(hashes);
+      m_transfers.swap(transfers);
+      m_payments.swap(payments);
+      m_key_images.swap(key_images);
+      m_pub_keys.swap(pub_keys);
+      m_confirmed_txs.swap(confirmed_txs);
+      m_tx_keys.swap(tx_keys);
+      m_additional_tx_keys.swap(additional_tx_keys);
+      m_subaddresses.swap(subaddresses);
+    };
+    std::ostringstream oss;
+    swap_out();
+    {
+      OXEN_DEFER { swap_out(); }; // swaps them back in
+      boost::archive::portable_binary_oarchive ar{oss};
+      ar << *this;
+    }
+    written += db.put(m_cache_key, "wallet", 0, oss.str());
+
+    db.commit();
+  }
+  catch (...)
+  {
+    db.rollback();
+    if (replacing)
+      m_cache_db.reset();
+    THROW_WALLET_EXCEPTION(error::file_save_error, m_wallet_file);
+  }
+
+  if (replacing)
+  {
+    try { db.rename(m_wallet_file); }
+    catch (...) { m_cache_db.reset(); throw; }
+  }
+  MDEBUG("Stored wallet cache database, " << written << " page(s) changed");
+}
+//----------------------------------------------------------------------------------------------------
+uint64_t wallet2::balance(uint32_t index_major, bool strict) const
+{
+  uint64_t amount = 0;
+  if(m_light_wallet)
+    return m_light_wallet_unlocked_balance;
+  for (const auto& i : balance_per_subaddress(index_major, strict))
+    amount += i.second;
+  return amount;
+}
+//----------------------------------------------------------------------------------------------------
+uint64_t wallet2::unlocked_balance(uint32_t index_major, bool strict, uint64_t *blocks_to_unlock, uint64_t *time_to_unlock) const
+{
+  uint64_t amount = 0;
   if (blocks_to_unlock)
     *blocks_to_unlock = 0;
   if (time_to_unlock)
@@ -6021,79 +6723,132 @@ uint64_t wallet2::unlocked_balance(uint32_t index_major, bool strict, uint64_t *
   return amount;
 }
 //----------------------------------------------------------------------------------------------------
-std::map<uint32_t, uint64_t> wallet2::balance_per_subaddress(uint32_t index_major, bool strict) const
+void wallet2::update_transfers_cache(bool unlocked) const
 {
-  std::map<uint32_t, uint64_t> amount_per_subaddr;
-  for (const auto& td: m_transfers)
+  if (!m_transfers_cache)
   {
-    if (td.m_subaddr_index.major == index_major && !is_spent(td, strict) && !td.m_frozen)
+    auto& cache = m_transfers_cache.emplace();
+    cache.summaries.reserve(m_transfers.size());
+    for (const auto& td: m_transfers)
+      cache.summaries.emplace_back(td);
+    for (const auto& ts: cache.summaries)
     {
-      auto found = amount_per_subaddr.find(td.m_subaddr_index.minor);
-      if (found == amount_per_subaddr.end())
-        amount_per_subaddr[td.m_subaddr_index.minor] = td.amount();
-      else
-        found->second += td.amount();
+      if (ts.frozen)
+        continue;
+      for (bool strict : {false, true})
+        if (!ts.is_spent(strict))
+          cache.balance[strict][ts.subaddr_index.major][ts.subaddr_index.minor] += ts.amount;
+    }
+    for (const auto& utx: m_unconfirmed_txs)
+    {
+      // all changes go to 0-th subaddress (in the current subaddress account)
+      if (utx.second.m_state != wallet2::unconfirmed_transfer_details::failed)
+        cache.balance[false][utx.second.m_subaddr_account][0] += utx.second.m_change;
     }
   }
-  if (!strict)
+  if (!unlocked)
+    return;
+
+  auto& cache = *m_transfers_cache;
+  const uint64_t blockchain_height = get_blockchain_current_height();
+  uint64_t daemon_height = 0;
+  if (!m_offline)
+    m_node_rpc_proxy.get_height(daemon_height);
+  const uint64_t now = time(NULL);
+  if (cache.have_unlocked && cache.unlocked_height == blockchain_height && cache.daemon_height == daemon_height && now < cache.recheck_time)
+    return;
+
+  cache.unlocked[0].clear();
+  cache.unlocked[1].clear();
+  cache.recheck_time = std::numeric_limits<uint64_t>::max();
+  const auto locked_key_images = get_locked_key_images();
+  for (const auto& ts: cache.summaries)
   {
-   for (const auto& utx: m_unconfirmed_txs)
-   {
-    if (utx.second.m_subaddr_account == index_major && utx.second.m_state != wallet2::unconfirmed_transfer_details::failed)
+    if (ts.frozen)
+      continue;
+    const bool is_unlocked = is_transfer_age_unlocked(ts.unlock_time, ts.block_height, ts.unmined_blink) &&
+      locked_key_images.count(ts.key_image) == 0;
+    uint64_t unlock_height = 0, unlock_time = 0;
+    if (!is_unlocked)
+    {
+      unlock_height = ts.unmined_blink && ts.block_height == 0 ? blockchain_height : ts.block_height;
+      unlock_height += std::max<uint64_t>(CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE, CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
+      if (ts.tx_unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER && ts.tx_unlock_time > unlock_height)
+        unlock_height = ts.tx_unlock_time;
+      unlock_time = ts.tx_unlock_time >= CRYPTONOTE_MAX_BLOCK_NUMBER ? ts.tx_unlock_time : 0;
+      // a time lock can expire before the next block
+      if (ts.unlock_time >= CRYPTONOTE_MAX_BLOCK_NUMBER)
+      {
+        const uint64_t delta = tools::to_seconds(CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_SECONDS_V2);
+        cache.recheck_time = std::min(cache.recheck_time, ts.unlock_time > delta ? ts.unlock_time - delta : 0);
+      }
+    }
+    for (bool strict : {false, true})
     {
-      // all changes go to 0-th subaddress (in the current subaddress account)
-      auto found = amount_per_subaddr.find(0);
-      if (found == amount_per_subaddr.end())
-        amount_per_subaddr[0] = utx.second.m_change;
-      else
-        found->second += utx.second.m_change;
+      if (ts.is_spent(strict))
+        continue;
+      auto& b = cache.unlocked[strict][ts.subaddr_index.major][ts.subaddr_index.minor];
+      if (is_unlocked)
+        b.amount += ts.amount;
+      b.unlock_height = std::max(b.unlock_height, unlock_height);
+      b.unlock_time = std::max(b.unlock_time, unlock_time);
     }
-   }
   }
-  return amount_per_subaddr;
+  cache.have_unlocked = true;
+  cache.unlocked_height = blockchain_height;
+  cache.daemon_height = daemon_height;
 }
 //----------------------------------------------------------------------------------------------------
-std::map<uint32_t, std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> wallet2::unlocked_balance_per_subaddress(uint32_t index_major, bool strict) const
+const std::vector<wallet::transfer_summary>& wallet2::get_transfer_summaries() const
+{
+  std::lock_guard lock{m_transfers_cache_mutex};
+  update_transfers_cache(false);
+  return m_transfers_cache->summaries;
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::is_transfer_available(const wallet::transfer_summary& ts, const std::unordered_set<crypto::key_image>& locked_key_images) const
+{
+  return !ts.spent && !ts.frozen && !ts.key_image_partial &&
+    is_transfer_age_unlocked(ts.unlock_time, ts.block_height, ts.unmined_blink) &&
+    locked_key_images.count(ts.key_image) == 0;
+}
+//----------------------------------------------------------------------------------------------------
+std::map<uint32_t, uint64_t> wallet2::balance_per_subaddress(uint32_t index_major, bool strict) const
+{
+  std::lock_guard lock{m_transfers_cache_mutex};
+  update_transfers_cache(false);
+  auto& balances = m_transfers_cache->balance[strict];
+  auto it = balances.find(index_major);
+  return it != balances.end() ? it->second : std::map<uint32_t, uint64_t>{};
+}
+//----------------------------------------------------------------------------------------------------
+// Converts the cached unlocked balances of an account to unlocked_balance_per_subaddress()'s
+// (amount, (blocks to unlock, time to unlock)) as of `blockchain_height` and now
+template <typename UnlockedBalances>
+static std::map<uint32_t, std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> unlocked_amounts_per_subaddress(
+    const UnlockedBalances& balances, uint32_t index_major, uint64_t blockchain_height)
 {
   std::map<uint32_t, std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> amount_per_subaddr;
-  const uint64_t blockchain_height = get_blockchain_current_height();
+  auto it = balances.find(index_major);
+  if (it == balances.end())
+    return amount_per_subaddr;
   const uint64_t now = time(NULL);
-  for(const transfer_details& td: m_transfers)
+  for (const auto& [minor, b] : it->second)
   {
-    if(td.m_subaddr_index.major == index_major && !is_spent(td, strict) && !td.m_frozen)
-    {
-      uint64_t amount = 0, blocks_to_unlock = 0, time_to_unlock = 0;
-      if (is_transfer_unlocked(td))
-      {
-        amount = td.amount();
-        blocks_to_unlock = 0;
-        time_to_unlock = 0;
-      }
-      else
-      {
-        uint64_t unlock_height = td.m_unmined_blink && td.m_block_height == 0 ? blockchain_height : td.m_block_height;
-        unlock_height += std::max<uint64_t>(CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE, CRYPTONOTE_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
-        if (td.m_tx.unlock_time < CRYPTONOTE_MAX_BLOCK_NUMBER && td.m_tx.unlock_time > unlock_height)
-          unlock_height = td.m_tx.unlock_time;
-        uint64_t unlock_time = td.m_tx.unlock_time >= CRYPTONOTE_MAX_BLOCK_NUMBER ? td.m_tx.unlock_time : 0;
-        blocks_to_unlock = unlock_height > blockchain_height ? unlock_height - blockchain_height : 0;
-        time_to_unlock = unlock_time > now ? unlock_time - now : 0;
-        amount = 0;
-      }
-      auto found = amount_per_subaddr.find(td.m_subaddr_index.minor);
-      if (found == amount_per_subaddr.end())
-        amount_per_subaddr[td.m_subaddr_index.minor] = std::make_pair(amount, std::make_pair(blocks_to_unlock, time_to_unlock));
-      else
-      {
-        found->second.first += amount;
-        found->second.second.first = std::max(found->second.second.first, blocks_to_unlock);
-        found->second.second.second = std::max(found->second.second.second, time_to_unlock);
-      }
-    }
+    const uint64_t blocks_to_unlock = b.unlock_height > blockchain_height ? b.unlock_height - blockchain_height : 0;
+    const uint64_t time_to_unlock = b.unlock_time > now ? b.unlock_time - now : 0;
+    amount_per_subaddr.emplace_hint(amount_per_subaddr.end(), minor, std::make_pair(b.amount, std::make_pair(blocks_to_unlock, time_to_unlock)));
   }
   return amount_per_subaddr;
 }
 //----------------------------------------------------------------------------------------------------
+std::map<uint32_t, std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> wallet2::unlocked_balance_per_subaddress(uint32_t index_major, bool strict) const
+{
+  std::lock_guard lock{m_transfers_cache_mutex};
+  update_transfers_cache(true);
+  return unlocked_amounts_per_subaddress(m_transfers_cache->unlocked[strict], index_major, m_transfers_cache->unlocked_height);
+}
+//----------------------------------------------------------------------------------------------------
 uint64_t wallet2::balance_all(bool strict) const
 {
   uint64_t r = 0;
@@ -6121,6 +6876,174 @@ uint64_t wallet2::unlocked_balance_all(bool strict, uint64_t *blocks_to_unlock,
   return r;
 }
 //----------------------------------------------------------------------------------------------------
+size_t wallet2::get_num_unspent_outputs(const cryptonote::subaddress_index& index) const
+{
+  const auto& summaries = get_transfer_summaries();
+  return std::count_if(summaries.begin(), summaries.end(), [&](const wallet::transfer_summary& ts) { return !ts.spent && ts.subaddr_index == index; });
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::is_subaddress_used(const cryptonote::subaddress_index& index) const
+{
+  const auto& summaries = get_transfer_summaries();
+  return std::any_of(summaries.begin(), summaries.end(), [&](const wallet::transfer_summary& ts) { return ts.subaddr_index == index; });
+}
+//----------------------------------------------------------------------------------------------------
+std::shared_ptr<const wallet2::balance_snapshot> wallet2::get_balance_snapshot() const
+{
+  std::lock_guard lock{m_balance_snapshot_mutex};
+  return m_balance_snapshot;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::publish_balance_snapshot()
+{
+  if (m_light_wallet)
+    return;
+  auto snapshot = std::make_shared<balance_snapshot>();
+  auto previous = get_balance_snapshot();
+
+  snapshot->m_immutable_height = m_immutable_height;
+  snapshot->m_multisig = multisig();
+  {
+    std::lock_guard lock{m_transfers_cache_mutex};
+    update_transfers_cache(true);
+    for (bool strict : {false, true})
+    {
+      snapshot->m_balance[strict] = m_transfers_cache->balance[strict];
+      snapshot->m_unlocked[strict] = m_transfers_cache->unlocked[strict];
+    }
+    snapshot->m_height = m_transfers_cache->unlocked_height;
+  }
+
+  snapshot->m_subaddresses.resize(m_subaddress_labels.size());
+  for (uint32_t major = 0; major < m_subaddress_labels.size(); ++major)
+  {
+    auto& subaddrs = snapshot->m_subaddresses[major];
+    subaddrs.resize(m_subaddress_labels[major].size());
+    for (uint32_t minor = 0; minor < subaddrs.size(); ++minor)
+    {
+      // An index's address never changes, so take it from the last snapshot when it has it
+      auto* prev = previous ? previous->find({major, minor}) : nullptr;
+      subaddrs[minor].address = prev ? prev->address : get_subaddress_as_str({major, minor});
+      subaddrs[minor].label = m_subaddress_labels[major][minor];
+    }
+  }
+  for (const auto& ts : get_transfer_summaries())
+  {
+    if (ts.subaddr_index.major >= snapshot->m_subaddresses.size() || ts.subaddr_index.minor >= snapshot->m_subaddresses[ts.subaddr_index.major].size())
+      continue;
+    auto& subaddr = snapshot->m_subaddresses[ts.subaddr_index.major][ts.subaddr_index.minor];
+    subaddr.used = true;
+    if (!ts.spent)
+      ++subaddr.num_unspent_outputs;
+    if (ts.key_image_partial && snapshot->m_multisig)
+      snapshot->m_multisig_partial_key_images = true;
+  }
+
+  std::lock_guard lock{m_balance_snapshot_mutex};
+  m_balance_snapshot = std::move(snapshot);
+}
+//----------------------------------------------------------------------------------------------------
+const wallet2::balance_snapshot::subaddress* wallet2::balance_snapshot::find(const cryptonote::subaddress_index& index) const
+{
+  if (index.major >= m_subaddresses.size() || index.minor >= m_subaddresses[index.major].size())
+    return nullptr;
+  return &m_subaddresses[index.major][index.minor];
+}
+//----------------------------------------------------------------------------------------------------
+std::string wallet2::balance_snapshot::get_subaddress_as_str(const cryptonote::subaddress_index& index) const
+{
+  auto* subaddr = find(index);
+  return subaddr ? subaddr->address : "";
+}
+//----------------------------------------------------------------------------------------------------
+std::string wallet2::balance_snapshot::get_subaddress_label(const cryptonote::subaddress_index& index) const
+{
+  auto* subaddr = find(index);
+  if (!subaddr)
+  {
+    MERROR("Subaddress label doesn't exist");
+    return "";
+  }
+  return subaddr->label;
+}
+//----------------------------------------------------------------------------------------------------
+size_t wallet2::balance_snapshot::get_num_unspent_outputs(const cryptonote::subaddress_index& index) const
+{
+  auto* subaddr = find(index);
+  return subaddr ? subaddr->num_unspent_outputs : 0;
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::balance_snapshot::is_subaddress_used(const cryptonote::subaddress_index& index) const
+{
+  auto* subaddr = find(index);
+  return subaddr && subaddr->used;
+}
+//----------------------------------------------------------------------------------------------------
+std::map<uint32_t, uint64_t> wallet2::balance_snapshot::balance_per_subaddress(uint32_t index_major, bool strict) const
+{
+  auto it = m_balance[strict].find(index_major);
+  return it != m_balance[strict].end() ? it->second : std::map<uint32_t, uint64_t>{};
+}
+//----------------------------------------------------------------------------------------------------
+std::map<uint32_t, std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> wallet2::balance_snapshot::unlocked_balance_per_subaddress(uint32_t index_major, bool strict) const
+{
+  return unlocked_amounts_per_subaddress(m_unlocked[strict], index_major, m_height);
+}
+//----------------------------------------------------------------------------------------------------
+uint64_t wallet2::balance_snapshot::balance(uint32_t index_major, bool strict) const
+{
+  uint64_t amount = 0;
+  if (auto it = m_balance[strict].find(index_major); it != m_balance[strict].end())
+    for (const auto& i : it->second)
+      amount += i.second;
+  return amount;
+}
+//----------------------------------------------------------------------------------------------------
+uint64_t wallet2::balance_snapshot::unlocked_balance(uint32_t index_major, bool strict, uint64_t *blocks_to_unlock, uint64_t *time_to_unlock) const
+{
+  uint64_t amount = 0;
+  if (blocks_to_unlock)
+    *blocks_to_unlock = 0;
+  if (time_to_unlock)
+    *time_to_unlock = 0;
+  for (const auto& i : unlocked_balance_per_subaddress(index_major, strict))
+  {
+    amount += i.second.first;
+    if (blocks_to_unlock && i.second.second.first > *blocks_to_unlock)
+      *blocks_to_unlock = i.second.second.first;
+    if (time_to_unlock && i.second.second.second > *time_to_unlock)
+      *time_to_unlock = i.second.second.second;
+  }
+  return amount;
+}
+//----------------------------------------------------------------------------------------------------
+uint64_t wallet2::balance_snapshot::balance_all(bool strict) const
+{
+  uint64_t r = 0;
+  for (uint32_t index_major = 0; index_major < get_num_subaddress_accounts(); ++index_major)
+    r += balance(index_major, strict);
+  return r;
+}
+//----------------------------------------------------------------------------------------------------
+uint64_t wallet2::balance_snapshot::unlocked_balance_all(bool strict, uint64_t *blocks_to_unlock, uint64_t *time_to_unlock) const
+{
+  uint64_t r = 0;
+  if (blocks_to_unlock)
+    *blocks_to_unlock = 0;
+  if (time_to_unlock)
+    *time_to_unlock = 0;
+  for (uint32_t index_major = 0; index_major < get_num_subaddress_accounts(); ++index_major)
+  {
+    uint64_t local_blocks_to_unlock, local_time_to_unlock;
+    r += unlocked_balance(index_major, strict, blocks_to_unlock ? &local_blocks_to_unlock : NULL, time_to_unlock ? &local_time_to_unlock : NULL);
+    if (blocks_to_unlock)
+      *blocks_to_unlock = std::max(*blocks_to_unlock, local_blocks_to_unlock);
+    if (time_to_unlock)
+      *time_to_unlock = std::max(*time_to_unlock, local_time_to_unlock);
+  }
+  return r;
+}
+//----------------------------------------------------------------------------------------------------
 void wallet2::get_transfers(wallet2::transfer_container& incoming_transfers) const
 {
   incoming_transfers = m_transfers;
@@ -6265,6 +7188,30 @@ wallet::transfer_view wallet2::make_transfer_view(const crypto::hash &payment_id
   return result;
 }
 //----------------------------------------------------------------------------------------------------
+const wallet2::transfer_history_index& wallet2::get_transfer_history_index()
+{
+  wait_for_history();
+  if (!m_transfer_history)
+  {
+    auto& index = m_transfer_history.emplace();
+    index.all.reserve(m_payments.size() + m_confirmed_txs.size());
+    for (const auto& p : m_payments)
+      index.all.push_back({p.second.m_block_height, p.second.m_timestamp, p.second.m_tx_hash, &p, nullptr});
+    for (const auto& c : m_confirmed_txs)
+      index.all.push_back({c.second.m_block_height, c.second.m_timestamp, c.first, nullptr, &c});
+    std::sort(index.all.begin(), index.all.end(), [](const auto& a, const auto& b) {
+      if (a.height != b.height)
+        return a.height < b.height;
+      if (a.timestamp != b.timestamp)
+        return a.timestamp < b.timestamp;
+      return a.txid < b.txid;
+    });
+    for (const auto& e : index.all)
+      index.by_account[e.in ? e.in->second.m_subaddr_index.major : e.out->second.m_subaddr_account].push_back(e);
+  }
+  return *m_transfer_history;
+}
+
 void wallet2::get_transfers(get_transfers_args_t args, std::vector<wallet::transfer_view>& transfers)
 {
   std::optional<uint32_t> account_index = args.account_index;
@@ -6282,64 +7229,88 @@ void wallet2::get_transfers(get_transfers_args_t args, std::vector<wallet::trans
   int args_count = args.in + args.out + args.stake + args.pending + args.failed + args.pool + args.coinbase;
   if (args_count == 0) args.in = args.out = args.stake = args.pending = args.failed = args.pool = args.coinbase = true;
 
-  std::list<std::pair<crypto::hash, tools::wallet2::payment_details>> in;
-  std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> out;
-  std::list<std::pair<crypto::hash, tools::wallet2::unconfirmed_transfer_details>> pending_or_failed;
-  std::list<std::pair<crypto::hash, tools::wallet2::pool_payment_details>> pool;
-
   MDEBUG("Getting transfers of type(s) " << (args.in ? "in " : "") << (args.out ? "out " : "") << (args.pending ? "pending " : "") << (args.failed ? "failed " : "")
       << (args.pool ? "pool " : "") << " for heights in [" << args.min_height << "," << args.max_height << "]");
 
-  size_t size = 0;
-  if (args.in)
-  {
-    get_payments(in, args.min_height, args.max_height, account_index, args.subaddr_indices);
-    size += in.size();
-  }
+  // Only the transfers of the requested page get a transfer_view built
+  size_t skip = args.offset;
+  size_t left = args.limit ? args.limit : std::numeric_limits<size_t>::max();
+  auto wanted = [&] {
+    if (skip == 0)
+      return true;
+    --skip;
+    return false;
+  };
 
-  if (args.out || args.stake)
+  // Confirmed transfers come first, in (height, timestamp, txid) order, which the index already has
+  if (args.in || args.out || args.stake)
   {
-    get_payments_out(out, args.min_height, args.max_height, account_index, args.subaddr_indices);
-    size += out.size();
+    const auto& index = get_transfer_history_index();
+    const std::vector<transfer_history_entry>* entries = &index.all;
+    if (account_index)
+    {
+      auto it = index.by_account.find(*account_index);
+      entries = it == index.by_account.end() ? nullptr : &it->second;
+    }
+    if (entries)
+    {
+      auto it = std::lower_bound(entries->begin(), entries->end(), args.min_height,
+          [](const transfer_history_entry& e, uint64_t height) { return e.height < height; });
+      for (; it != entries->end() && it->height <= args.max_height && left > 0; ++it)
+      {
+        if (it->in)
+        {
+          const auto& pd = it->in->second;
+          if (!args.in || (!args.subaddr_indices.empty() && args.subaddr_indices.count(pd.m_subaddr_index.minor) == 0))
+            continue;
+          if (!wanted())
+            continue;
+          transfers.push_back(make_transfer_view(pd.m_tx_hash, it->in->first, pd));
+        }
+        else
+        {
+          const auto& ctd = it->out->second;
+          if (!args.out && !args.stake)
+            continue;
+          if (!args.subaddr_indices.empty() && std::none_of(ctd.m_subaddr_indices.begin(), ctd.m_subaddr_indices.end(),
+                [&](uint32_t index) { return args.subaddr_indices.count(index) == 1; }))
+            continue;
+          bool add_entry = true;
+          if (args.stake && args_count == 1)
+            add_entry = ctd.m_pay_type == wallet::pay_type::stake;
+          if (args.ons && args_count == 1)
+            add_entry = ctd.m_pay_type == wallet::pay_type::ons;
+          if (!add_entry || !wanted())
+            continue;
+          transfers.push_back(make_transfer_view(it->out->first, ctd));
+        }
+        --left;
+      }
+    }
   }
+  if (left == 0)
+    return;
 
+  // Then the (few) unconfirmed ones
+  std::list<std::pair<crypto::hash, tools::wallet2::unconfirmed_transfer_details>> pending_or_failed;
+  std::list<std::pair<crypto::hash, tools::wallet2::pool_payment_details>> pool;
   if (args.pending || args.failed)
-  {
     get_unconfirmed_payments_out(pending_or_failed, account_index, args.subaddr_indices);
-    size += pending_or_failed.size();
-  }
-
   if (args.pool)
-  {
     get_unconfirmed_payments(pool, account_index, args.subaddr_indices);
-    size += pool.size();
-  }
-
-  // Fill transfers
-  transfers.reserve(size);
-  for (const auto &i : in)
-    transfers.push_back(make_transfer_view(i.second.m_tx_hash, i.first, i.second));
-  for (const auto &o : out)
-  {
-    bool add_entry = true;
-    if (args.stake && args_count == 1)
-      add_entry = o.second.m_pay_type == wallet::pay_type::stake;
-    if (args.ons && args_count == 1)
-      add_entry = o.second.m_pay_type == wallet::pay_type::ons;
 
-    if (add_entry)
-      transfers.push_back(make_transfer_view(o.first, o.second));
-  }
+  std::vector<wallet::transfer_view> unconfirmed;
+  unconfirmed.reserve(pending_or_failed.size() + pool.size());
   for (const auto &pof : pending_or_failed)
   {
     bool is_failed = pof.second.m_state == tools::wallet2::unconfirmed_transfer_details::failed;
     if (is_failed ? args.failed : args.pending)
-      transfers.push_back(make_transfer_view(pof.first, pof.second));
+      unconfirmed.push_back(make_transfer_view(pof.first, pof.second));
   }
   for (const auto &p : pool)
-    transfers.push_back(make_transfer_view(p.first, p.second));
+    unconfirmed.push_back(make_transfer_view(p.first, p.second));
 
-  std::sort(transfers.begin(), transfers.end(), [](const auto& a, const auto& b) -> bool {
+  std::sort(unconfirmed.begin(), unconfirmed.end(), [](const auto& a, const auto& b) -> bool {
     if (a.confirmed != b.confirmed)
       return a.confirmed;
     if (a.blink_mempool != b.blink_mempool)
@@ -6350,6 +7321,15 @@ void wallet2::get_transfers(get_transfers_args_t args, std::vector<wallet::trans
       return a.timestamp < b.timestamp;
     return a.hash < b.hash;
   });
+  for (auto& t : unconfirmed)
+  {
+    if (left == 0)
+      break;
+    if (!wanted())
+      continue;
+    transfers.push_back(std::move(t));
+    --left;
+  }
 }
 
 std::string wallet2::transfers_to_csv(const std::vector<wallet::transfer_view>& transfers, bool formatting) const
@@ -6467,6 +7447,7 @@ std::string wallet2::transfers_to_csv(const std::vector<wallet::transfer_view>&
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_payments(const crypto::hash& payment_id, std::list<wallet2::payment_details>& payments, uint64_t min_height, const std::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices) const
 {
+  wait_for_history();
   auto range = m_payments.equal_range(payment_id);
   std::for_each(range.first, range.second, [&payments, &min_height, &subaddr_account, &subaddr_indices](const payment_container::value_type& x) {
       if (min_height <= x.second.m_block_height &&
@@ -6480,6 +7461,7 @@ void wallet2::get_payments(const crypto::hash& payment_id, std::list<wallet2::pa
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_payments(std::list<std::pair<crypto::hash,wallet2::payment_details>>& payments, uint64_t min_height, uint64_t max_height, const std::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices) const
 {
+  wait_for_history();
   auto range = std::make_pair(m_payments.begin(), m_payments.end());
   std::for_each(range.first, range.second, [&payments, &min_height, &max_height, &subaddr_account, &subaddr_indices](const payment_container::value_type& x) {
       if (min_height <= x.second.m_block_height && max_height >= x.second.m_block_height &&
@@ -6494,6 +7476,7 @@ void wallet2::get_payments(std::list<std::pair<crypto::hash,wallet2::payment_det
 void wallet2::get_payments_out(std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>>& confirmed_payments,
     uint64_t min_height, uint64_t max_height, const std::optional<uint32_t>& subaddr_account, const std::set<uint32_t>& subaddr_indices) const
 {
+  wait_for_history();
   for (auto i = m_confirmed_txs.begin(); i != m_confirmed_txs.end(); ++i) {
     if (i->second.m_block_height < min_height || i->second.m_block_height > max_height)
       continue;
@@ -6564,29 +7547,75 @@ void wallet2::get_unconfirmed_payments(std::list<std::pair<crypto::hash,wallet2:
   }
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::rescan_spent()
+bool wallet2::get_spent_status_bin(std::vector<int> &spent_status)
 {
-  // This is RPC call that can take a long time if there are many outputs,
-  // so we call it several times, in stripes, so we don't time out spuriously
-  std::vector<int> spent_status;
+  // 32 bytes of request per key image, at most: the daemon checks each chunk in one read txn
+  const size_t chunk_size = 10000;
+  spent_status.clear();
   spent_status.reserve(m_transfers.size());
-  const size_t chunk_size = 1000;
   for (size_t start_offset = 0; start_offset < m_transfers.size(); start_offset += chunk_size)
   {
     const size_t n_outputs = std::min<size_t>(chunk_size, m_transfers.size() - start_offset);
-    MDEBUG("Calling is_key_image_spent on " << start_offset << " - " << (start_offset + n_outputs - 1) << ", out of " << m_transfers.size());
-    rpc::IS_KEY_IMAGE_SPENT::request req{};
-    rpc::IS_KEY_IMAGE_SPENT::response daemon_resp{};
+    MDEBUG("Calling is_key_image_spent.bin on " << start_offset << " - " << (start_offset + n_outputs - 1) << ", out of " << m_transfers.size());
+    rpc::IS_KEY_IMAGE_SPENT_BIN::request req{};
+    rpc::IS_KEY_IMAGE_SPENT_BIN::response daemon_resp{};
+    req.key_images.reserve(n_outputs);
     for (size_t n = start_offset; n < start_offset + n_outputs; ++n)
-      req.key_images.push_back(tools::type_to_hex(m_transfers[n].m_key_image));
-    bool r = invoke_http<rpc::IS_KEY_IMAGE_SPENT>(req, daemon_resp);
-    THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "is_key_image_spent");
-    THROW_WALLET_EXCEPTION_IF(daemon_resp.status == rpc::STATUS_BUSY, error::daemon_busy, "is_key_image_spent");
+      req.key_images.push_back(m_transfers[n].m_key_image);
+    bool r = invoke_http<rpc::IS_KEY_IMAGE_SPENT_BIN>(req, daemon_resp);
+    if (start_offset == 0 && (!r || (daemon_resp.status != rpc::STATUS_OK && daemon_resp.status != rpc::STATUS_BUSY)))
+    {
+      // An old daemon, or no daemon: the JSON requests will tell
+      MDEBUG("is_key_image_spent.bin failed, falling back to is_key_image_spent");
+      return false;
+    }
+    THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "is_key_image_spent.bin");
+    THROW_WALLET_EXCEPTION_IF(daemon_resp.status == rpc::STATUS_BUSY, error::daemon_busy, "is_key_image_spent.bin");
     THROW_WALLET_EXCEPTION_IF(daemon_resp.status != rpc::STATUS_OK, error::is_key_image_spent_error, get_rpc_status(daemon_resp.status));
-    THROW_WALLET_EXCEPTION_IF(daemon_resp.spent_status.size() != n_outputs, error::wallet_internal_error,
-        "daemon returned wrong response for is_key_image_spent, wrong amounts count = " +
-        std::to_string(daemon_resp.spent_status.size()) + ", expected " +  std::to_string(n_outputs));
-    std::copy(daemon_resp.spent_status.begin(), daemon_resp.spent_status.end(), std::back_inserter(spent_status));
+    const size_t bitmap_size = (n_outputs + 7) / 8;
+    THROW_WALLET_EXCEPTION_IF(daemon_resp.spent.size() != bitmap_size || daemon_resp.spent_in_pool.size() != bitmap_size, error::wallet_internal_error,
+        "daemon returned wrong response for is_key_image_spent.bin, wrong bitmap sizes " +
+        std::to_string(daemon_resp.spent.size()) + "/" + std::to_string(daemon_resp.spent_in_pool.size()) + ", expected " + std::to_string(bitmap_size));
+    for (size_t i = 0; i < n_outputs; ++i)
+    {
+      const uint8_t bit = 1 << (i % 8);
+      if (daemon_resp.spent[i / 8] & bit)
+        spent_status.push_back(rpc::IS_KEY_IMAGE_SPENT::SPENT_IN_BLOCKCHAIN);
+      else if (daemon_resp.spent_in_pool[i / 8] & bit)
+        spent_status.push_back(rpc::IS_KEY_IMAGE_SPENT::SPENT_IN_POOL);
+      else
+        spent_status.push_back(rpc::IS_KEY_IMAGE_SPENT::UNSPENT);
+    }
+  }
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::rescan_spent()
+{
+  std::vector<int> spent_status;
+  if (!get_spent_status_bin(spent_status))
+  {
+    // This is RPC call that can take a long time if there are many outputs,
+    // so we call it several times, in stripes, so we don't time out spuriously
+    spent_status.reserve(m_transfers.size());
+    const size_t chunk_size = 1000;
+    for (size_t start_offset = 0; start_offset < m_transfers.size(); start_offset += chunk_size)
+    {
+      const size_t n_outputs = std::min<size_t>(chunk_size, m_transfers.size() - start_offset);
+      MDEBUG("Calling is_key_image_spent on " << start_offset << " - " << (start_offset + n_outputs - 1) << ", out of " << m_transfers.size());
+      rpc::IS_KEY_IMAGE_SPENT::request req{};
+      rpc::IS_KEY_IMAGE_SPENT::response daemon_resp{};
+      for (size_t n = start_offset; n < start_offset + n_outputs; ++n)
+        req.key_images.push_back(tools::type_to_hex(m_transfers[n].m_key_image));
+      bool r = invoke_http<rpc::IS_KEY_IMAGE_SPENT>(req, daemon_resp);
+      THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "is_key_image_spent");
+      THROW_WALLET_EXCEPTION_IF(daemon_resp.status == rpc::STATUS_BUSY, error::daemon_busy, "is_key_image_spent");
+      THROW_WALLET_EXCEPTION_IF(daemon_resp.status != rpc::STATUS_OK, error::is_key_image_spent_error, get_rpc_status(daemon_resp.status));
+      THROW_WALLET_EXCEPTION_IF(daemon_resp.spent_status.size() != n_outputs, error::wallet_internal_error,
+          "daemon returned wrong response for is_key_image_spent, wrong amounts count = " +
+          std::to_string(daemon_resp.spent_status.size()) + ", expected " +  std::to_string(n_outputs));
+      std::copy(daemon_resp.spent_status.begin(), daemon_resp.spent_status.end(), std::back_inserter(spent_status));
+    }
   }
 
   // update spent status
@@ -6645,6 +7674,20 @@ bool wallet2::is_transfer_unlocked(const transfer_details& td) const
 }
 //----------------------------------------------------------------------------------------------------
 bool wallet2::is_transfer_unlocked(uint64_t unlock_time, uint64_t block_height, bool unmined_blink, crypto::key_image const *key_image) const
+{
+  if (!is_transfer_age_unlocked(unlock_time, block_height, unmined_blink))
+    return false;
+
+  if (m_offline)
+    return true;
+
+  if (!key_image) // TODO(oxen): Try make all callees always pass in a key image for accuracy
+    return true;
+
+  return get_locked_key_images().count(*key_image) == 0;
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::is_transfer_age_unlocked(uint64_t unlock_time, uint64_t block_height, bool unmined_blink) const
 {
   auto blockchain_height = get_blockchain_current_height();
   if (block_height == 0 && unmined_blink)
@@ -6664,21 +7707,22 @@ bool wallet2::is_transfer_unlocked(uint64_t unlock_time, uint64_t block_height,
   if(block_height + CRYPTONOTE_DEFAULT_TX_SPENDABLE_AGE > blockchain_height)
     return false;
 
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+std::unordered_set<crypto::key_image> wallet2::get_locked_key_images() const
+{
+  std::unordered_set<crypto::key_image> result;
   if (m_offline)
-    return true;
-
-  if (!key_image) // TODO(oxen): Try make all callees always pass in a key image for accuracy
-    return true;
+    return result;
 
   {
-    std::optional<std::string> failed;
-    // FIXME: can just check one here by adding a is_key_image_blacklisted
     auto [success, blacklist] = m_node_rpc_proxy.get_service_node_blacklisted_key_images();
     if (!success)
     {
       // We'll already have a log message printed containing the request failure reason
       LOG_PRINT_L1("Failed to query service node for blacklisted transfers, assuming transfer not blacklisted");
-      return true;
+      return result;
     }
 
     for (cryptonote::rpc::GET_SERVICE_NODE_BLACKLISTED_KEY_IMAGES::entry const &entry : blacklist)
@@ -6689,20 +7733,17 @@ bool wallet2::is_transfer_unlocked(uint64_t unlock_time, uint64_t block_height,
         MERROR("Failed to parse hex representation of key image: " << entry.key_image);
         break;
       }
-
-      if (*key_image == check_image)
-        return false;
+      result.insert(check_image);
     }
   }
 
   {
     const std::string primary_address = get_address_as_str();
-    std::optional<std::string> failed;
     auto [success, service_nodes_states] = m_node_rpc_proxy.get_contributed_service_nodes(primary_address);
     if (!success)
     {
       LOG_PRINT_L1("Failed to query service node for locked transfers, assuming transfer not locked");
-      return true;
+      return result;
     }
 
     for (cryptonote::rpc::GET_SERVICE_NODES::response::entry const &entry : service_nodes_states)
@@ -6720,15 +7761,13 @@ bool wallet2::is_transfer_unlocked(uint64_t unlock_time, uint64_t block_height,
             MERROR("Failed to parse hex representation of key image: " << contribution.key_image);
             break;
           }
-
-          if (*key_image == check_image)
-            return false;
+          result.insert(check_image);
         }
       }
     }
   }
 
-  return true;
+  return result;
 }
 //----------------------------------------------------------------------------------------------------
 bool wallet2::is_tx_spendtime_unlocked(uint64_t unlock_time, uint64_t block_height) const
@@ -6894,6 +7933,7 @@ uint64_t wallet2::select_transfers(uint64_t needed_money, std::vector<size_t> un
 //----------------------------------------------------------------------------------------------------
 void wallet2::add_unconfirmed_tx(const cryptonote::transaction& tx, uint64_t amount_in, const std::vector<cryptonote::tx_destination_entry> &dests, const crypto::hash &payment_id, uint64_t change_amount, uint32_t subaddr_account, const std::set<uint32_t>& subaddr_indices)
 {
+  m_transfers_cache.reset();
   unconfirmed_transfer_details& utd = m_unconfirmed_txs[cryptonote::get_transaction_hash(tx)];
   utd.m_amount_in = amount_in;
   utd.m_amount_out = 0;
@@ -6952,6 +7992,7 @@ crypto::hash wallet2::get_payment_id(const pending_tx &ptx) const
 // take a pending tx and actually send it to the daemon
 void wallet2::commit_tx(pending_tx& ptx, bool blink)
 {
+  wait_for_history();
   if(m_light_wallet)
   {
     light_rpc::SUBMIT_RAW_TX::request oreq{};
@@ -7165,19 +8206,28 @@ bool wallet2::sign_tx(const fs::path& unsigned_filename, const fs::path& signed_
 //----------------------------------------------------------------------------------------------------
 bool wallet2::sign_tx(unsigned_tx_set &exported_txs, std::vector<wallet2::pending_tx> &txs, signed_tx_set &signed_txes)
 {
+  wait_for_history();
   import_outputs(exported_txs.transfers);
 
-  // sign the transactions
-  for (size_t n = 0; n < exported_txs.txes.size(); ++n)
+  // sign the transactions.  They don't depend on each other, so (keys permitting, see
+  // construct_txs) they get signed in parallel, each into its own slot so that the signed txs come
+  // out in the order of the unsigned ones whatever order they finish in.
+  const size_t num_txes = exported_txs.txes.size();
+  const size_t first_ptx = signed_txes.ptx.size();
+  signed_txes.ptx.resize(first_ptx + num_txes);
+  std::vector<crypto::secret_key> tx_keys(num_txes);
+  std::vector<std::vector<crypto::secret_key>> all_additional_tx_keys(num_txes);
+  std::mutex progress_mutex;
+  size_t num_signed = 0;
+  construct_txs(num_txes, [&](size_t n)
   {
     auto &sd = exported_txs.txes[n];
     THROW_WALLET_EXCEPTION_IF(sd.sources.empty(), error::wallet_internal_error, "Empty sources");
     LOG_PRINT_L1(" " << (n+1) << ": " << sd.sources.size() << " inputs, ring size " << sd.sources[0].outputs.size());
-    signed_txes.ptx.push_back(pending_tx());
-    tools::wallet2::pending_tx &ptx = signed_txes.ptx.back();
+    tools::wallet2::pending_tx &ptx = signed_txes.ptx[first_ptx + n];
     rct::RCTConfig rct_config = sd.rct_config;
-    crypto::secret_key tx_key;
-    std::vector<crypto::secret_key> additional_tx_keys;
+    crypto::secret_key &tx_key = tx_keys[n];
+    std::vector<crypto::secret_key> &additional_tx_keys = all_additional_tx_keys[n];
     rct::multisig_out msout;
 
     oxen_construct_tx_params tx_params;
@@ -7190,16 +8240,6 @@ bool wallet2::sign_tx(unsigned_tx_set &exported_txs, std::vector<wallet2::pendin
     // and if we really go over limit, the daemon will reject when it gets submitted. Chances are it's
     // OK anyway since it was generated in the first place, and rerolling should be within a few bytes.
 
-    // normally, the tx keys are saved in commit_tx, when the tx is actually sent to the daemon.
-    // we can't do that here since the tx will be sent from the compromised wallet, which we don't want
-    // to see that info, so we save it here
-    if (store_tx_info() && tx_key != crypto::null_skey)
-    {
-      const crypto::hash txid = get_transaction_hash(ptx.tx);
-      m_tx_keys.insert(std::make_pair(txid, tx_key));
-      m_additional_tx_keys.insert(std::make_pair(txid, additional_tx_keys));
-    }
-
     std::ostringstream key_images;
     bool all_are_txin_to_key = std::all_of(ptx.tx.vin.begin(), ptx.tx.vin.end(), [&](const txin_v& s_e) -> bool
     {
@@ -7221,11 +8261,32 @@ bool wallet2::sign_tx(unsigned_tx_set &exported_txs, std::vector<wallet2::pendin
     ptx.dests = sd.dests;
     ptx.construction_data = sd;
 
+    if (m_callback)
+    {
+      std::lock_guard lock{progress_mutex};
+      m_callback->on_sign_tx_progress(++num_signed, num_txes);
+    }
+  });
+
+  for (size_t n = 0; n < num_txes; ++n)
+  {
+    const tools::wallet2::pending_tx &ptx = signed_txes.ptx[first_ptx + n];
+
+    // normally, the tx keys are saved in commit_tx, when the tx is actually sent to the daemon.
+    // we can't do that here since the tx will be sent from the compromised wallet, which we don't want
+    // to see that info, so we save it here
+    if (store_tx_info() && tx_keys[n] != crypto::null_skey)
+    {
+      const crypto::hash txid = get_transaction_hash(ptx.tx);
+      m_tx_keys.insert(std::make_pair(txid, tx_keys[n]));
+      m_additional_tx_keys.insert(std::make_pair(txid, all_additional_tx_keys[n]));
+    }
+
     txs.push_back(ptx);
 
     // add tx keys only to ptx
-    txs.back().tx_key = tx_key;
-    txs.back().additional_tx_keys = additional_tx_keys;
+    txs.back().tx_key = tx_keys[n];
+    txs.back().additional_tx_keys = std::move(all_additional_tx_keys[n]);
   }
 
   // add key image mapping for these txes
@@ -7570,6 +8631,7 @@ bool wallet2::parse_multisig_tx_from_str(std::string_view multisig_tx_st, multis
 //----------------------------------------------------------------------------------------------------
 bool wallet2::load_multisig_tx(cryptonote::blobdata s, multisig_tx_set &exported_txs, std::function<bool(const multisig_tx_set&)> accept_func)
 {
+  wait_for_history();
   if(!parse_multisig_tx_from_str(s, exported_txs))
   {
     LOG_PRINT_L0("Failed to parse multisig transaction from string");
@@ -7627,6 +8689,7 @@ bool wallet2::load_multisig_tx_from_file(const fs::path& filename, multisig_tx_s
 //----------------------------------------------------------------------------------------------------
 bool wallet2::sign_multisig_tx(multisig_tx_set &exported_txs, std::vector<crypto::hash> &txids)
 {
+  wait_for_history();
   THROW_WALLET_EXCEPTION_IF(exported_txs.m_ptx.empty(), error::wallet_internal_error, "No tx found");
 
   const crypto::public_key local_signer = get_multisig_signer_public_key();
@@ -7938,6 +9001,7 @@ bool wallet2::get_ring(const crypto::chacha_key &key, const crypto::key_image &k
 
 bool wallet2::get_rings(const crypto::hash &txid, std::vector<std::pair<crypto::key_image, std::vector<uint64_t>>> &outs)
 {
+  wait_for_history();
   for (auto i: m_confirmed_txs)
   {
     if (txid == i.first)
@@ -9231,32 +10295,45 @@ std::pair<std::set<uint64_t>, size_t> outs_unique(const std::vector<std::vector<
 
 void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>> &outs, const std::vector<size_t> &selected_transfers, size_t fake_outputs_count, bool has_rct)
 {
-  std::vector<uint64_t> rct_offsets;
+  if (outs.size() > selected_transfers.size())
+    outs.clear();
+  if (outs.size() == selected_transfers.size())
+    return;
+  uint64_t num_rct_outputs = 0;
   for (size_t attempts = 3; attempts > 0; --attempts)
   {
-    get_outs(outs, selected_transfers, fake_outputs_count, rct_offsets, has_rct);
+    std::vector<size_t> missing{selected_transfers.begin() + outs.size(), selected_transfers.end()};
+    std::vector<std::vector<get_outs_entry>> new_outs;
+    get_outs(new_outs, missing, fake_outputs_count, num_rct_outputs, has_rct);
+    const size_t kept = outs.size();
+    outs.insert(outs.end(), std::make_move_iterator(new_outs.begin()), std::make_move_iterator(new_outs.end()));
 
     const auto unique = outs_unique(outs);
-    if (tx_sanity_check(unique.first, unique.second, rct_offsets.empty() ? 0 : rct_offsets.back()))
+    if (tx_sanity_check(unique.first, unique.second, num_rct_outputs))
     {
       return;
     }
 
+    // Start over with new rings for all the inputs, in case it's the kept ones that fail the check
     std::vector<crypto::key_image> key_images;
     key_images.reserve(selected_transfers.size());
     std::for_each(selected_transfers.begin(), selected_transfers.end(), [this, &key_images](size_t index) {
       key_images.push_back(m_transfers[index].m_key_image);
     });
     unset_ring(key_images);
+    if (kept > 0)
+      MDEBUG("Sanity check failed with " << kept << " previously gathered rings, gathering new ones for all inputs");
+    outs.clear();
   }
 
   THROW_WALLET_EXCEPTION(error::wallet_internal_error, tr("Transaction sanity check failed"));
 }
 
-void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>> &outs, const std::vector<size_t> &selected_transfers, size_t fake_outputs_count, std::vector<uint64_t> &rct_offsets, bool has_rct)
+void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>> &outs, const std::vector<size_t> &selected_transfers, size_t fake_outputs_count, uint64_t &num_rct_outputs, bool has_rct)
 {
   LOG_PRINT_L2("fake_outputs_count: " << fake_outputs_count);
   outs.clear();
+  num_rct_outputs = 0;
 
   if(m_light_wallet && fake_outputs_count > 0) {
     light_wallet_get_outs(outs, selected_transfers, fake_outputs_count);
@@ -9275,9 +10352,10 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
     bool is_after_segregation_fork = height >= segregation_fork_height;
 
     // if we have at least one rct out, get the distribution, or fall back to the previous system
-    uint64_t rct_start_height;
-    std::vector<uint64_t> rct_offsets;
-    const bool has_rct_distribution = has_rct && get_rct_distribution(rct_start_height, rct_offsets);
+    const bool has_rct_distribution = has_rct && update_rct_distribution() && !m_rct_distribution.empty();
+    const std::vector<uint64_t> &rct_offsets = m_rct_distribution;
+    if (has_rct_distribution)
+      num_rct_outputs = rct_offsets.back();
 
     // get histogram for the amounts we need
     cryptonote::rpc::GET_OUTPUT_HISTOGRAM::request req_t{};
@@ -9387,9 +10465,9 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
     rpc::GET_OUTPUTS_BIN::request req{};
     decltype(req.outputs) get_outputs;
 
-    std::unique_ptr<gamma_picker> gamma;
-    if (has_rct_distribution)
-      gamma.reset(new gamma_picker(rct_offsets));
+    if (has_rct_distribution && !m_gamma_picker)
+      m_gamma_picker = std::make_unique<gamma_picker>(m_rct_distribution);
+    gamma_picker* gamma = has_rct_distribution ? m_gamma_picker.get() : nullptr;
 
     size_t num_selected_transfers = 0;
     for(size_t idx: selected_transfers)
@@ -9973,8 +11051,7 @@ void wallet2::transfer_selected_rct(std::vector<cryptonote::tx_destination_entry
   LOG_PRINT_L2("wanted " << print_money(needed_money) << ", found " << print_money(found_money) << ", fee " << print_money(fee));
   THROW_WALLET_EXCEPTION_IF(found_money < needed_money, error::not_enough_unlocked_money, found_money, needed_money - fee, fee);
 
-  if (outs.empty())
-    get_outs(outs, selected_transfers, fake_outputs_count, has_rct); // may throw
+  get_outs(outs, selected_transfers, fake_outputs_count, has_rct); // may throw
 
   //prepare inputs
   LOG_PRINT_L2("preparing outputs");
@@ -10212,7 +11289,7 @@ void wallet2::transfer_selected_rct(std::vector<cryptonote::tx_destination_entry
   ptx.construction_data.hf_version = tx_params.hf_version;
   ptx.construction_data.rct_config = {
     tx.rct_signatures.p.bulletproofs.empty() ? rct::RangeProofType::Borromean : rct::RangeProofType::PaddedBulletproof,
-    use_fork_rules(HF_VERSION_CLSAG, 0) ? 3 : 2
+    rct_config.bp_version
   };
   ptx.construction_data.dests = dsts;
   // record which subaddress indices are being used as inputs
@@ -10223,6 +11300,39 @@ void wallet2::transfer_selected_rct(std::vector<cryptonote::tx_destination_entry
   LOG_PRINT_L2("transfer_selected_rct done");
 }
 
+void wallet2::for_each_in_parallel(size_t n, const std::function<void(size_t)>& f) const
+{
+  auto& tpool = tools::threadpool::getInstance();
+  // Hardware devices take one request at a time
+  if (n < 2 || m_account.get_device().get_type() != hw::device::SOFTWARE || tpool.get_max_concurrency() < 2)
+  {
+    for (size_t i = 0; i < n; ++i)
+      f(i);
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(n);
+  tpool.parallel_for(0, n, [&](size_t i) {
+    try { f(i); }
+    catch (...) { errors[i] = std::current_exception(); }
+  });
+  for (auto& e : errors)
+    if (e)
+      std::rethrow_exception(e);
+}
+
+void wallet2::construct_txs(size_t n, const std::function<void(size_t)>& build)
+{
+  // Multisig construction keeps track of the L values used across txs
+  if (m_multisig)
+  {
+    for (size_t i = 0; i < n; ++i)
+      build(i);
+    return;
+  }
+  for_each_in_parallel(n, build);
+}
+//----------------------------------------------------------------------------------------------------
 std::vector<size_t> wallet2::pick_preferred_rct_inputs(uint64_t needed_money, uint32_t subaddr_account, const std::set<uint32_t> &subaddr_indices) const
 {
   std::vector<size_t> picks;
@@ -10230,18 +11340,28 @@ std::vector<size_t> wallet2::pick_preferred_rct_inputs(uint64_t needed_money, ui
 
   LOG_PRINT_L2("pick_preferred_rct_inputs: needed_money " << print_money(needed_money));
 
+  const auto& summaries = get_transfer_summaries();
+  const auto locked_key_images = get_locked_key_images();
+  std::vector<bool> usable(summaries.size());
+  for (size_t i = 0; i < summaries.size(); ++i)
+  {
+    const auto& ts = summaries[i];
+    usable[i] = ts.rct && ts.subaddr_index.major == subaddr_account && subaddr_indices.count(ts.subaddr_index.minor) == 1 &&
+      is_transfer_available(ts, locked_key_images);
+  }
+
   // try to find a rct input of enough size
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  for (size_t i = 0; i < summaries.size(); ++i)
   {
-    const transfer_details& td = m_transfers[i];
-    if (!is_spent(td, false) && !td.m_frozen && td.is_rct() && td.amount() >= needed_money && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
+    const auto& ts = summaries[i];
+    if (usable[i] && ts.amount >= needed_money)
     {
-      if (td.amount() > m_ignore_outputs_above || td.amount() < m_ignore_outputs_below)
+      if (ts.amount > m_ignore_outputs_above || ts.amount < m_ignore_outputs_below)
       {
-        MDEBUG("Ignoring output " << i << " of amount " << print_money(td.amount()) << " which is outside prescribed range [" << print_money(m_ignore_outputs_below) << ", " << print_money(m_ignore_outputs_above) << "]");
+        MDEBUG("Ignoring output " << i << " of amount " << print_money(ts.amount) << " which is outside prescribed range [" << print_money(m_ignore_outputs_below) << ", " << print_money(m_ignore_outputs_above) << "]");
         continue;
       }
-      LOG_PRINT_L2("We can use " << i << " alone: " << print_money(td.amount()));
+      LOG_PRINT_L2("We can use " << i << " alone: " << print_money(ts.amount));
       picks.push_back(i);
       return picks;
     }
@@ -10251,32 +11371,32 @@ std::vector<size_t> wallet2::pick_preferred_rct_inputs(uint64_t needed_money, ui
   // this could be made better by picking one of the outputs to be a small one, since those
   // are less useful since often below the needed money, so if one can be used in a pair,
   // it gets rid of it for the future
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  for (size_t i = 0; i < summaries.size(); ++i)
   {
-    const transfer_details& td = m_transfers[i];
-    if (!is_spent(td, false) && !td.m_frozen && !td.m_key_image_partial && td.is_rct() && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
+    const auto& ts = summaries[i];
+    if (usable[i])
     {
-      if (td.amount() > m_ignore_outputs_above || td.amount() < m_ignore_outputs_below)
+      if (ts.amount > m_ignore_outputs_above || ts.amount < m_ignore_outputs_below)
       {
-        MDEBUG("Ignoring output " << i << " of amount " << print_money(td.amount()) << " which is outside prescribed range [" << print_money(m_ignore_outputs_below) << ", " << print_money(m_ignore_outputs_above) << "]");
+        MDEBUG("Ignoring output " << i << " of amount " << print_money(ts.amount) << " which is outside prescribed range [" << print_money(m_ignore_outputs_below) << ", " << print_money(m_ignore_outputs_above) << "]");
         continue;
       }
-      LOG_PRINT_L2("Considering input " << i << ", " << print_money(td.amount()));
-      for (size_t j = i + 1; j < m_transfers.size(); ++j)
+      LOG_PRINT_L2("Considering input " << i << ", " << print_money(ts.amount));
+      for (size_t j = i + 1; j < summaries.size(); ++j)
       {
-        const transfer_details& td2 = m_transfers[j];
-        if (td2.amount() > m_ignore_outputs_above || td2.amount() < m_ignore_outputs_below)
+        const auto& ts2 = summaries[j];
+        if (ts2.amount > m_ignore_outputs_above || ts2.amount < m_ignore_outputs_below)
         {
-          MDEBUG("Ignoring output " << j << " of amount " << print_money(td2.amount()) << " which is outside prescribed range [" << print_money(m_ignore_outputs_below) << ", " << print_money(m_ignore_outputs_above) << "]");
+          MDEBUG("Ignoring output " << j << " of amount " << print_money(ts2.amount) << " which is outside prescribed range [" << print_money(m_ignore_outputs_below) << ", " << print_money(m_ignore_outputs_above) << "]");
           continue;
         }
-        if (!is_spent(td2, false) && !td2.m_frozen && !td.m_key_image_partial && td2.is_rct() && td.amount() + td2.amount() >= needed_money && is_transfer_unlocked(td2) && td2.m_subaddr_index == td.m_subaddr_index)
+        if (usable[j] && ts.amount + ts2.amount >= needed_money && ts2.subaddr_index == ts.subaddr_index)
         {
           // update our picks if those outputs are less related than any we
           // already found. If the same, don't update, and oldest suitable outputs
           // will be used in preference.
-          float relatedness = get_output_relatedness(td, td2);
-          LOG_PRINT_L2("  with input " << j << ", " << print_money(td2.amount()) << ", relatedness " << relatedness);
+          float relatedness = get_output_relatedness(m_transfers[i], m_transfers[j]);
+          LOG_PRINT_L2("  with input " << j << ", " << print_money(ts2.amount) << ", relatedness " << relatedness);
           if (relatedness < current_output_relatdness)
           {
             // reset the current picks with those, and return them directly
@@ -10352,6 +11472,7 @@ static uint32_t get_count_above(const std::vector<wallet2::transfer_details> &tr
 
 bool wallet2::light_wallet_login(bool &new_address)
 {
+  wait_for_history();
   MDEBUG("Light wallet login request");
   m_light_wallet_connected = false;
   light_rpc::LOGIN::request request{};
@@ -10392,6 +11513,7 @@ bool wallet2::light_wallet_import_wallet_request(light_rpc::IMPORT_WALLET_REQUES
 
 void wallet2::light_wallet_get_unspent_outs()
 {
+  m_transfers_cache.reset();
   MDEBUG("Getting unspent outs");
 
   light_rpc::GET_UNSPENT_OUTS::request oreq{};
@@ -10560,6 +11682,8 @@ bool wallet2::light_wallet_get_address_info(light_rpc::GET_ADDRESS_INFO::respons
 
 void wallet2::light_wallet_get_address_txs()
 {
+  wait_for_history();
+  m_transfers_cache.reset();
   MDEBUG("Refreshing light wallet");
 
   light_rpc::GET_ADDRESS_TXS::request ireq{};
@@ -10667,6 +11791,7 @@ void wallet2::light_wallet_get_address_txs()
       } else {
         if (std::find(payments_txs.begin(), payments_txs.end(), tx_hash) == payments_txs.end()) {
           m_payments.emplace(tx_hash, payment);
+          m_transfer_history.reset();
           if (0 != m_callback) {
             m_callback->on_lw_money_received(t.height, payment.m_tx_hash, payment.m_amount);
           }
@@ -10715,6 +11840,7 @@ void wallet2::light_wallet_get_address_txs()
             ctd.m_block_height = t.height;
             ctd.m_timestamp = t.timestamp;
             m_confirmed_txs.emplace(tx_hash,ctd);
+            m_transfer_history.reset();
           }
           if (0 != m_callback)
           {
@@ -10986,19 +12112,21 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(std::vector<cryp
   // gather all dust and non-dust outputs belonging to specified subaddresses
   size_t num_nondust_outputs = 0;
   size_t num_dust_outputs = 0;
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  const auto& summaries = get_transfer_summaries();
+  const auto locked_key_images = get_locked_key_images();
+  for (size_t i = 0; i < summaries.size(); ++i)
   {
-    const transfer_details& td = m_transfers[i];
-    if (!is_spent(td, false) && !td.m_frozen && !td.m_key_image_partial && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && subaddr_indices.count(td.m_subaddr_index.minor) == 1)
+    const auto& ts = summaries[i];
+    if (ts.subaddr_index.major == subaddr_account && subaddr_indices.count(ts.subaddr_index.minor) == 1 && is_transfer_available(ts, locked_key_images))
     {
-      if (td.amount() > m_ignore_outputs_above || td.amount() < m_ignore_outputs_below)
+      if (ts.amount > m_ignore_outputs_above || ts.amount < m_ignore_outputs_below)
       {
-        MDEBUG("Ignoring output " << i << " of amount " << print_money(td.amount()) << " which is outside prescribed range [" << print_money(m_ignore_outputs_below) << ", " << print_money(m_ignore_outputs_above) << "]");
+        MDEBUG("Ignoring output " << i << " of amount " << print_money(ts.amount) << " which is outside prescribed range [" << print_money(m_ignore_outputs_below) << ", " << print_money(m_ignore_outputs_above) << "]");
         continue;
       }
-      const uint32_t index_minor = td.m_subaddr_index.minor;
+      const uint32_t index_minor = ts.subaddr_index.minor;
       auto find_predicate = [&index_minor](const std::pair<uint32_t, std::vector<size_t>>& x) { return x.first == index_minor; };
-      if (td.is_rct())
+      if (ts.rct)
       {
         auto found = std::find_if(unused_transfers_indices_per_subaddr.begin(), unused_transfers_indices_per_subaddr.end(), find_predicate);
         if (found == unused_transfers_indices_per_subaddr.end())
@@ -11175,8 +12303,7 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(std::vector<cryp
     uint64_t available_amount = td.amount();
     accumulated_outputs += available_amount;
 
-    // clear any fake outs we'd already gathered, since we'll need a new set
-    outs.clear();
+    // the fake outs we've already gathered are kept: get_outs() only needs to add a ring for this one
 
     if (adding_fee)
     {
@@ -11300,7 +12427,8 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_2(std::vector<cryp
         tx.tx = test_tx;
         tx.ptx = test_ptx;
         tx.weight = get_transaction_weight(test_tx, txBlob.size());
-        tx.outs = outs;
+        tx.outs = std::move(outs);
+        outs.clear(); // the next tx's inputs need rings of their own
         tx.needed_fee = test_ptx.fee;
         accumulated_fee += test_ptx.fee;
         accumulated_change += test_ptx.change_dts.amount;
@@ -11342,13 +12470,15 @@ skip_tx:
     " total fee, " << print_money(accumulated_change) << " total change");
 
   hwdev.set_mode(hw::device::TRANSACTION_CREATE_REAL);
-  for (auto &tx : txes)
+  construct_txs(txes.size(), [&](size_t i)
   {
+    auto& tx = txes[i];
+    auto tx_params_i = tx_params;
     // Convert burn percent into a fixed burn amount because this is the last place we can back out
     // the base fee that would apply at 100% (the actual fee here is that times the priority-based
     // fee percent)
     if (burning)
-      tx_params.burn_fixed = burn_fixed + (tx.needed_fee - burn_fixed) * burn_percent / fee_percent;
+      tx_params_i.burn_fixed = burn_fixed + (tx.needed_fee - burn_fixed) * burn_percent / fee_percent;
 
     cryptonote::transaction test_tx;
     pending_tx test_ptx;
@@ -11362,12 +12492,12 @@ skip_tx:
                             test_tx,                    /* OUT   cryptonote::transaction& tx, */
                             test_ptx,                   /* OUT   cryptonote::transaction& tx, */
                             rct_config,
-                            tx_params);
+                            tx_params_i);
     auto txBlob = t_serializable_object_to_blob(test_ptx.tx);
     tx.tx = test_tx;
     tx.ptx = test_ptx;
     tx.weight = get_transaction_weight(test_tx, txBlob.size());
-  }
+  });
 
   std::vector<wallet2::pending_tx> ptx_vector;
   for (std::vector<TX>::iterator i = txes.begin(); i != txes.end(); ++i)
@@ -11467,21 +12597,23 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_all(uint64_t below
 
   // gather all dust and non-dust outputs of specified subaddress (if any) and below specified threshold (if any)
   bool fund_found = false;
-  for (size_t i = 0; i < m_transfers.size(); ++i)
+  const auto& summaries = get_transfer_summaries();
+  const auto locked_key_images = get_locked_key_images();
+  for (size_t i = 0; i < summaries.size(); ++i)
   {
-    const transfer_details& td = m_transfers[i];
-    if (!is_spent(td, false) && !td.m_frozen && !td.m_key_image_partial && is_transfer_unlocked(td) && td.m_subaddr_index.major == subaddr_account && (subaddr_indices.empty() || subaddr_indices.count(td.m_subaddr_index.minor) == 1))
+    const auto& ts = summaries[i];
+    if (ts.subaddr_index.major == subaddr_account && (subaddr_indices.empty() || subaddr_indices.count(ts.subaddr_index.minor) == 1) && is_transfer_available(ts, locked_key_images))
     {
       fund_found = true;
-      if (below == 0 || td.amount() < below)
+      if (below == 0 || ts.amount < below)
       {
-        if (td.m_tx.version <= txversion::v1)
+        if (ts.tx_version <= txversion::v1)
           continue;
 
-        if (td.is_rct())
-          unused_transfer_dust_indices_per_subaddr[td.m_subaddr_index.minor].first.push_back(i);
+        if (ts.rct)
+          unused_transfer_dust_indices_per_subaddr[ts.subaddr_index.minor].first.push_back(i);
         else
-          unused_transfer_dust_indices_per_subaddr[td.m_subaddr_index.minor].second.push_back(i);
+          unused_transfer_dust_indices_per_subaddr[ts.subaddr_index.minor].second.push_back(i);
       }
     }
   }
@@ -11628,8 +12760,7 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_from(const crypton
     uint64_t available_amount = td.amount();
     accumulated_outputs += available_amount;
 
-    // clear any fake outs we'd already gathered, since we'll need a new set
-    outs.clear();
+    // the fake outs we've already gathered are kept: get_outs() only needs to add a ring for this one
 
     // here, check if we need to sent tx and start a new one
     LOG_PRINT_L2("Considering whether to create a tx now, " << tx.selected_transfers.size() << " inputs, tx limit "
@@ -11697,7 +12828,8 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_from(const crypton
       tx.tx = test_tx;
       tx.ptx = test_ptx;
       tx.weight = get_transaction_weight(test_tx, txBlob.size());
-      tx.outs = outs;
+      tx.outs = std::move(outs);
+      outs.clear(); // the next tx's inputs need rings of their own
       tx.needed_fee = test_ptx.fee;
       accumulated_fee += test_ptx.fee;
       accumulated_change += test_ptx.change_dts.amount;
@@ -11713,22 +12845,24 @@ std::vector<wallet2::pending_tx> wallet2::create_transactions_from(const crypton
     " total fee, " << print_money(accumulated_change) << " total change");
 
   hwdev.set_mode(hw::device::TRANSACTION_CREATE_REAL);
-  for (auto &tx : txes)
+  construct_txs(txes.size(), [&](size_t i)
   {
+    auto& tx = txes[i];
+    auto tx_params = oxen_tx_params;
     // Convert burn percent into a fixed burn amount because this is the last place we can back out
     // the base fee that would apply at 100% (the actual fee here is that times the priority-based
     // fee percent)
     if (burning)
-      oxen_tx_params.burn_fixed = burn_fixed + tx.needed_fee * burn_percent / fee_percent;
+      tx_params.burn_fixed = burn_fixed + tx.needed_fee * burn_percent / fee_percent;
 
     cryptonote::transaction test_tx;
     pending_tx test_ptx;
-    transfer_selected_rct(tx.dsts, tx.selected_transfers, fake_outs_count, tx.outs, unlock_time, tx.needed_fee, extra, test_tx, test_ptx, rct_config, oxen_tx_params);
+    transfer_selected_rct(tx.dsts, tx.selected_transfers, fake_outs_count, tx.outs, unlock_time, tx.needed_fee, extra, test_tx, test_ptx, rct_config, tx_params);
     auto txBlob = t_serializable_object_to_blob(test_ptx.tx);
     tx.tx = test_tx;
     tx.ptx = test_ptx;
     tx.weight = get_transaction_weight(test_tx, txBlob.size());
-  }
+  });
 
   std::vector<wallet2::pending_tx> ptx_vector;
   for (std::vector<TX>::iterator i = txes.begin(); i != txes.end(); ++i)
@@ -11871,18 +13005,11 @@ uint64_t wallet2::get_upper_transaction_weight_limit() const
 std::vector<size_t> wallet2::select_available_outputs(const std::function<bool(const transfer_details &td)> &f) const
 {
   std::vector<size_t> outputs;
-  size_t n = 0;
-  for (transfer_container::const_iterator i = m_transfers.begin(); i != m_transfers.end(); ++i, ++n)
+  const auto& summaries = get_transfer_summaries();
+  const auto locked_key_images = get_locked_key_images();
+  for (size_t n = 0; n < summaries.size(); ++n)
   {
-    if (is_spent(*i, false))
-      continue;
-    if (i->m_frozen)
-      continue;
-    if (i->m_key_image_partial)
-      continue;
-    if (!is_transfer_unlocked(*i))
-      continue;
-    if (f(*i))
+    if (is_transfer_available(summaries[n], locked_key_images) && f(m_transfers[n]))
       outputs.push_back(n);
   }
   return outputs;
@@ -11891,10 +13018,10 @@ std::vector<size_t> wallet2::select_available_outputs(const std::function<bool(c
 std::vector<uint64_t> wallet2::get_unspent_amounts_vector(bool strict) const
 {
   std::set<uint64_t> set;
-  for (const auto &td: m_transfers)
+  for (const auto &ts: get_transfer_summaries())
   {
-    if (!is_spent(td, strict) && !td.m_frozen)
-      set.insert(td.is_rct() ? 0 : td.amount());
+    if (!ts.is_spent(strict) && !ts.frozen)
+      set.insert(ts.rct ? 0 : ts.amount);
   }
   std::vector<uint64_t> vector;
   vector.reserve(set.size());
@@ -12019,6 +13146,7 @@ void wallet2::discard_unmixable_outputs()
 
 bool wallet2::get_tx_key_cached(const crypto::hash &txid, crypto::secret_key &tx_key, std::vector<crypto::secret_key> &additional_tx_keys) const
 {
+  wait_for_history();
   additional_tx_keys.clear();
   const std::unordered_map<crypto::hash, crypto::secret_key>::const_iterator i = m_tx_keys.find(txid);
   if (i == m_tx_keys.end())
@@ -12108,6 +13236,7 @@ bool wallet2::get_tx_key(const crypto::hash &txid, crypto::secret_key &tx_key, s
 //----------------------------------------------------------------------------------------------------
 void wallet2::set_tx_key(const crypto::hash &txid, const crypto::secret_key &tx_key, const std::vector<crypto::secret_key> &additional_tx_keys)
 {
+  wait_for_history();
   // fetch tx from daemon and check if secret keys agree with corresponding public keys
   auto res = request_transaction(txid);
   cryptonote::transaction tx;
@@ -13443,9 +14572,9 @@ uint64_t wallet2::import_key_images_from_file(const fs::path& filename, uint64_t
 //----------------------------------------------------------------------------------------------------
 uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_image, crypto::signature>> &signed_key_images, size_t offset, uint64_t &spent, uint64_t &unspent, bool check_spent)
 {
+  wait_for_history();
+  m_transfers_cache.reset();
   PERF_TIMER(import_key_images_lots);
-  rpc::IS_KEY_IMAGE_SPENT::request req{};
-  rpc::IS_KEY_IMAGE_SPENT::response daemon_resp{};
 
   THROW_WALLET_EXCEPTION_IF(offset > m_transfers.size(), error::wallet_internal_error, "Offset larger than known outputs");
   THROW_WALLET_EXCEPTION_IF(signed_key_images.size() > m_transfers.size() - offset, error::wallet_internal_error,
@@ -13458,11 +14587,84 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
     return 0;
   }
 
-  req.key_images.reserve(signed_key_images.size());
-
-  PERF_TIMER_START(import_key_images_A_validate_and_extract_key_images);
-  for (size_t n = 0; n < signed_key_images.size(); ++n)
+  // The daemon doesn't need the signatures checked to tell us whether the key images are spent, so
+  // we ask it (in chunks, on a thread of its own) while we check them.
+  std::vector<int> spent_status;
+  std::mutex query_mutex;
+  std::condition_variable query_cv;
+  size_t queried = 0;
+  bool query_done = !check_spent, query_stop = false;
+  std::exception_ptr query_error;
+  std::thread query_thread;
+  if (check_spent)
   {
+    spent_status.reserve(signed_key_images.size());
+    query_thread = std::thread{[&] {
+      try
+      {
+        for (size_t begin = 0; begin < signed_key_images.size(); begin += KEY_IMAGE_SPENT_CHUNK)
+        {
+          {
+            std::lock_guard lock{query_mutex};
+            if (query_stop)
+              break;
+          }
+          const size_t end = std::min(begin + KEY_IMAGE_SPENT_CHUNK, signed_key_images.size());
+          rpc::IS_KEY_IMAGE_SPENT::request req{};
+          rpc::IS_KEY_IMAGE_SPENT::response daemon_resp{};
+          req.key_images.reserve(end - begin);
+          for (size_t n = begin; n < end; ++n)
+            req.key_images.push_back(tools::type_to_hex(signed_key_images[n].first));
+
+          PERF_TIMER(import_key_images_RPC);
+          bool r = invoke_http<rpc::IS_KEY_IMAGE_SPENT>(req, daemon_resp);
+          THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "is_key_image_spent");
+          THROW_WALLET_EXCEPTION_IF(daemon_resp.status == rpc::STATUS_BUSY, error::daemon_busy, "is_key_image_spent");
+          THROW_WALLET_EXCEPTION_IF(daemon_resp.status != rpc::STATUS_OK, error::is_key_image_spent_error, daemon_resp.status);
+          THROW_WALLET_EXCEPTION_IF(daemon_resp.spent_status.size() != end - begin, error::wallet_internal_error,
+            "daemon returned wrong response for is_key_image_spent, wrong amounts count = " +
+            std::to_string(daemon_resp.spent_status.size()) + ", expected " +  std::to_string(end - begin));
+          spent_status.insert(spent_status.end(), daemon_resp.spent_status.begin(), daemon_resp.spent_status.end());
+
+          std::lock_guard lock{query_mutex};
+          queried = end;
+          query_cv.notify_all();
+        }
+      }
+      catch (...)
+      {
+        std::lock_guard lock{query_mutex};
+        query_error = std::current_exception();
+      }
+      std::lock_guard lock{query_mutex};
+      query_done = true;
+      query_cv.notify_all();
+    }};
+  }
+  OXEN_DEFER {
+    if (query_thread.joinable())
+    {
+      {
+        std::lock_guard lock{query_mutex};
+        query_stop = true;
+      }
+      query_thread.join();
+    }
+  };
+
+  auto report_progress = [&](size_t verified) {
+    if (!m_callback)
+      return;
+    size_t checked;
+    {
+      std::lock_guard lock{query_mutex};
+      checked = queried;
+    }
+    m_callback->on_import_key_images_progress(verified, checked, signed_key_images.size());
+  };
+
+  // Throws if the signature of the nth key image doesn't check out
+  auto verify = [&](size_t n) {
     const transfer_details &td = m_transfers[n + offset];
     const crypto::key_image &key_image = signed_key_images[n].first;
     const crypto::signature &signature = signed_key_images[n].second;
@@ -13473,12 +14675,11 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
       "Non txout_to_key output found");
     const auto& pkey = var::get<cryptonote::txout_to_key>(out.target).key;
 
-    std::string const key_image_str = tools::type_to_hex(key_image);
     if (!td.m_key_image_known || !(key_image == td.m_key_image))
     {
       THROW_WALLET_EXCEPTION_IF(!(rct::scalarmultKey(rct::ki2rct(key_image), rct::curveOrder()) == rct::identity()),
           error::wallet_internal_error, "Key image out of validity domain: input " + std::to_string(n + offset) + "/"
-          + std::to_string(signed_key_images.size()) + ", key image " + key_image_str);
+          + std::to_string(signed_key_images.size()) + ", key image " + tools::type_to_hex(key_image));
 
       // TODO(oxen): This can fail in a worse-case scenario. We re-sort blinks
       // when they arrive out of order (i.e. blink is confirmed in mempool and
@@ -13491,10 +14692,40 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
       // canonical ordering.
       THROW_WALLET_EXCEPTION_IF(!crypto::check_key_image_signature(key_image, pkey, signature),
           error::signature_check_failed, std::to_string(n + offset) + "/"
-          + std::to_string(signed_key_images.size()) + ", key image " + key_image_str
+          + std::to_string(signed_key_images.size()) + ", key image " + tools::type_to_hex(key_image)
           + ", signature " + tools::type_to_hex(signature) + ", pubkey " + tools::type_to_hex(pkey));
     }
-    req.key_images.push_back(key_image_str);
+  };
+
+  PERF_TIMER_START(import_key_images_A_validate_and_extract_key_images);
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  const size_t chunk = std::max<size_t>(64, KEY_IMAGE_VERIFY_ROUND / std::max<size_t>(1, tpool.get_max_concurrency()));
+  for (size_t round = 0; round < signed_key_images.size(); round += KEY_IMAGE_VERIFY_ROUND)
+  {
+    const size_t round_end = std::min(round + KEY_IMAGE_VERIFY_ROUND, signed_key_images.size());
+    std::atomic<size_t> first_failed{round_end};
+    tools::threadpool::waiter waiter;
+    for (size_t begin = round; begin < round_end; begin += chunk)
+    {
+      const size_t end = std::min(begin + chunk, round_end);
+      tpool.submit(&waiter, [&, begin, end] {
+        for (size_t n = begin; n < end; ++n)
+        {
+          try { verify(n); }
+          catch (const std::exception&)
+          {
+            for (size_t f = first_failed; n < f && !first_failed.compare_exchange_weak(f, n); )
+              ;
+            return;
+          }
+        }
+      }, true);
+    }
+    waiter.wait(&tpool);
+    // Again here, to throw what the first failure threw
+    if (first_failed < round_end)
+      verify(first_failed);
+    report_progress(round_end);
   }
   PERF_TIMER_STOP(import_key_images_A_validate_and_extract_key_images);
 
@@ -13509,21 +14740,30 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
   }
   PERF_TIMER_STOP(import_key_images_B_update_wallet_key_images);
 
-  if(check_spent)
+  if (check_spent)
   {
-    PERF_TIMER(import_key_images_RPC);
-    bool r = invoke_http<rpc::IS_KEY_IMAGE_SPENT>(req, daemon_resp);
-    THROW_WALLET_EXCEPTION_IF(!r, error::no_connection_to_daemon, "is_key_image_spent");
-    THROW_WALLET_EXCEPTION_IF(daemon_resp.status == rpc::STATUS_BUSY, error::daemon_busy, "is_key_image_spent");
-    THROW_WALLET_EXCEPTION_IF(daemon_resp.status != rpc::STATUS_OK, error::is_key_image_spent_error, daemon_resp.status);
-    THROW_WALLET_EXCEPTION_IF(daemon_resp.spent_status.size() != signed_key_images.size(), error::wallet_internal_error,
-      "daemon returned wrong response for is_key_image_spent, wrong amounts count = " +
-      std::to_string(daemon_resp.spent_status.size()) + ", expected " +  std::to_string(signed_key_images.size()));
-    for (size_t n = 0; n < daemon_resp.spent_status.size(); ++n)
+    std::unique_lock lock{query_mutex};
+    while (!query_done)
     {
-      transfer_details &td = m_transfers[n + offset];
-      td.m_spent = daemon_resp.spent_status[n] != rpc::IS_KEY_IMAGE_SPENT::UNSPENT;
+      query_cv.wait(lock);
+      if (m_callback && !query_error)
+      {
+        const size_t checked = queried;
+        lock.unlock();
+        m_callback->on_import_key_images_progress(signed_key_images.size(), checked, signed_key_images.size());
+        lock.lock();
+      }
     }
+    lock.unlock();
+    query_thread.join();
+    if (query_error)
+      std::rethrow_exception(query_error);
+  }
+
+  for (size_t n = 0; n < spent_status.size(); ++n)
+  {
+    transfer_details &td = m_transfers[n + offset];
+    td.m_spent = spent_status[n] != rpc::IS_KEY_IMAGE_SPENT::UNSPENT;
   }
   std::unordered_set<crypto::hash> spent_txids;   // For each spent key image, search for a tx in m_transfers that uses it as input.
   std::vector<size_t> swept_transfers;            // If such a spending tx wasn't found in m_transfers, this means the spending tx
@@ -13566,9 +14806,9 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
     else
       unspent += amount;
     LOG_PRINT_L2("Transfer " << i << ": " << print_money(amount) << " (" << td.m_global_output_index << "): "
-        << (td.m_spent ? "spent" : "unspent") << " (key image " << req.key_images[i] << ")");
+        << (td.m_spent ? "spent" : "unspent") << " (key image " << td.m_key_image << ")");
 
-    if (i < daemon_resp.spent_status.size() && daemon_resp.spent_status[i] == rpc::IS_KEY_IMAGE_SPENT::SPENT_IN_BLOCKCHAIN)
+    if (i < spent_status.size() && spent_status[i] == rpc::IS_KEY_IMAGE_SPENT::SPENT_IN_BLOCKCHAIN)
     {
       const std::unordered_map<crypto::key_image, crypto::hash>::const_iterator skii = spent_key_images.find(td.m_key_image);
       if (skii == spent_key_images.end())
@@ -13682,6 +14922,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
         if (j->second.m_tx_hash == *spent_txid)
         {
           m_payments.erase(j);
+          m_transfer_history.reset();
           break;
         }
       }
@@ -13702,6 +14943,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
       bool stake                       = service_nodes::tx_get_staking_components(td.m_tx, nullptr /*stake*/, td.m_txid);
       pd.m_pay_type = stake ? wallet::pay_type::stake : wallet::pay_type::out;
       m_confirmed_txs.insert(std::make_pair(spent_txid, pd));
+      m_transfer_history.reset();
     }
     PERF_TIMER_STOP(import_key_images_G);
   }
@@ -13712,6 +14954,7 @@ uint64_t wallet2::import_key_images(const std::vector<std::pair<crypto::key_imag
 
 bool wallet2::import_key_images(std::vector<crypto::key_image> key_images, size_t offset, std::optional<std::unordered_set<size_t>> selected_transfers)
 {
+  m_transfers_cache.reset();
   if (key_images.size() + offset > m_transfers.size())
   {
     LOG_PRINT_L1("More key images returned that we know outputs for");
@@ -13750,6 +14993,7 @@ bool wallet2::import_key_images(signed_tx_set & signed_tx, size_t offset, bool o
 
 wallet2::payment_container wallet2::export_payments() const
 {
+  wait_for_history();
   payment_container payments;
   for (auto const &p : m_payments)
   {
@@ -13759,6 +15003,8 @@ wallet2::payment_container wallet2::export_payments() const
 }
 void wallet2::import_payments(const payment_container &payments)
 {
+  wait_for_history();
+  m_transfer_history.reset();
   m_payments.clear();
   for (auto const &p : payments)
   {
@@ -13767,6 +15013,8 @@ void wallet2::import_payments(const payment_container &payments)
 }
 void wallet2::import_payments_out(const std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>> &confirmed_payments)
 {
+  wait_for_history();
+  m_transfer_history.reset();
   m_confirmed_txs.clear();
   for (auto const &p : confirmed_payments)
   {
@@ -13847,48 +15095,175 @@ std::string wallet2::export_outputs_to_str(bool all) const
   return ciphertext;
 }
 //----------------------------------------------------------------------------------------------------
+namespace {
+  // The streamed output export is OUTPUT_EXPORT_STREAM_MAGIC followed by chunks, each a 4-byte
+  // little endian length and then the chunk's IV, ciphertext and signature.  The signature (with
+  // the view key) is of the chunk's ciphertext and its position in the stream, so that chunks
+  // can't be reordered, dropped or taken from another export without it showing.  The first chunk
+  // is the header (the account's public keys, the index of the first output and the number of
+  // outputs), each of the others holds up to OUTPUT_EXPORT_CHUNK outputs, and an empty chunk ends
+  // the stream.
+  constexpr size_t OUTPUT_EXPORT_CHUNK = 256;
+  // Outputs are a few kB each (with the tx they are in): anything much bigger than a chunk of them
+  // is garbage
+  constexpr uint32_t OUTPUT_EXPORT_MAX_CHUNK_SIZE = 256 << 20;
+
+  struct output_export_cipher
+  {
+    crypto::chacha_key key;
+    const crypto::secret_key& skey;
+    crypto::public_key pkey;
+    uint64_t seq = 0;
+
+    crypto::hash chunk_hash(const char* data, size_t size) const
+    {
+      std::string buf;
+      buf.reserve(sizeof(seq) + size);
+      uint64_t seq_le = boost::endian::native_to_little(seq);
+      buf.append(reinterpret_cast<const char*>(&seq_le), sizeof(seq_le));
+      buf.append(data, size);
+      crypto::hash hash;
+      crypto::cn_fast_hash(buf.data(), buf.size(), hash);
+      return hash;
+    }
+
+    void write(std::ostream& out, std::string_view plaintext)
+    {
+      const auto iv = crypto::rand<crypto::chacha_iv>();
+      std::string chunk;
+      chunk.resize(sizeof(iv) + plaintext.size() + sizeof(crypto::signature));
+      memcpy(&chunk[0], &iv, sizeof(iv));
+      crypto::chacha20(plaintext.data(), plaintext.size(), key, iv, &chunk[sizeof(iv)]);
+      auto& signature = *reinterpret_cast<crypto::signature*>(&chunk[chunk.size() - sizeof(crypto::signature)]);
+      crypto::generate_signature(chunk_hash(chunk.data(), chunk.size() - sizeof(signature)), pkey, skey, signature);
+      ++seq;
+
+      const uint32_t len = boost::endian::native_to_little(static_cast<uint32_t>(chunk.size()));
+      out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+      out.write(chunk.data(), chunk.size());
+    }
+
+    epee::wipeable_string read(std::istream& in)
+    {
+      uint32_t len;
+      in.read(reinterpret_cast<char*>(&len), sizeof(len));
+      THROW_WALLET_EXCEPTION_IF(!in, error::wallet_internal_error, "Truncated outputs");
+      boost::endian::little_to_native_inplace(len);
+      THROW_WALLET_EXCEPTION_IF(len < sizeof(crypto::chacha_iv) + sizeof(crypto::signature) || len > OUTPUT_EXPORT_MAX_CHUNK_SIZE,
+          error::wallet_internal_error, "Bad chunk size in outputs");
+      std::string chunk(len, '\0');
+      in.read(&chunk[0], len);
+      THROW_WALLET_EXCEPTION_IF(!in, error::wallet_internal_error, "Truncated outputs");
+
+      const auto& signature = *reinterpret_cast<const crypto::signature*>(&chunk[len - sizeof(crypto::signature)]);
+      THROW_WALLET_EXCEPTION_IF(!crypto::check_signature(chunk_hash(chunk.data(), len - sizeof(signature)), pkey, signature),
+          error::wallet_internal_error, "Failed to authenticate outputs (from a different account?)");
+      ++seq;
+
+      const auto& iv = *reinterpret_cast<const crypto::chacha_iv*>(chunk.data());
+      epee::wipeable_string plaintext;
+      plaintext.resize(len - sizeof(iv) - sizeof(signature));
+      crypto::chacha20(chunk.data() + sizeof(iv), plaintext.size(), key, iv, plaintext.data());
+      return plaintext;
+    }
+  };
+}
+//----------------------------------------------------------------------------------------------------
+size_t wallet2::export_outputs_to_stream(std::ostream &out, bool all, std::optional<size_t> start) const
+{
+  PERF_TIMER(export_outputs_to_stream);
+
+  size_t offset = 0;
+  if (start)
+    offset = std::min(*start, m_transfers.size());
+  else if (!all)
+    while (offset < m_transfers.size() && (m_transfers[offset].m_key_image_known && !m_transfers[offset].m_key_image_request))
+      ++offset;
+
+  const auto& view_skey = get_account().get_keys().m_view_secret_key;
+  output_export_cipher cipher{{}, view_skey};
+  crypto::generate_chacha_key(&view_skey, sizeof(view_skey), cipher.key, m_kdf_rounds);
+  THROW_WALLET_EXCEPTION_IF(!crypto::secret_key_to_public_key(view_skey, cipher.pkey), error::wallet_internal_error, "Failed to get view public key");
+
+  out.write(OUTPUT_EXPORT_STREAM_MAGIC.data(), OUTPUT_EXPORT_STREAM_MAGIC.size());
+
+  const cryptonote::account_public_address &keys = get_account().get_keys().m_account_address;
+  std::string header;
+  header += tools::view_guts(keys.m_spend_public_key);
+  header += tools::view_guts(keys.m_view_public_key);
+  for (uint64_t n : {uint64_t{offset}, uint64_t{m_transfers.size()}})
+  {
+    boost::endian::native_to_little_inplace(n);
+    header += tools::view_guts(n);
+  }
+  cipher.write(out, header);
+
+  for (size_t begin = offset; begin < m_transfers.size(); begin += OUTPUT_EXPORT_CHUNK)
+  {
+    const size_t end = std::min(begin + OUTPUT_EXPORT_CHUNK, m_transfers.size());
+    std::ostringstream oss;
+    {
+      boost::archive::portable_binary_oarchive ar(oss);
+      const uint64_t count = end - begin;
+      ar << count;
+      for (size_t i = begin; i < end; ++i)
+        ar << m_transfers[i];
+    }
+    cipher.write(out, oss.str());
+  }
+  cipher.write(out, {});
+
+  THROW_WALLET_EXCEPTION_IF(!out, error::wallet_internal_error, "Failed to write outputs");
+  return m_transfers.size();
+}
+//----------------------------------------------------------------------------------------------------
 size_t wallet2::import_outputs(const std::pair<size_t, std::vector<tools::wallet2::transfer_details>> &outputs)
 {
+  m_transfers_cache.reset();
   PERF_TIMER(import_outputs);
 
   THROW_WALLET_EXCEPTION_IF(outputs.first > m_transfers.size(), error::wallet_internal_error,
       "Imported outputs omit more outputs that we know of");
 
   const size_t offset = outputs.first;
-  const size_t original_size = m_transfers.size();
-  m_transfers.resize(offset + outputs.second.size());
+  if (m_transfers.size() > offset + outputs.second.size())
+    m_transfers.resize(offset + outputs.second.size());
   for (size_t i = 0; i < offset; ++i)
     m_transfers[i].m_key_image_request = false;
   for (size_t i = 0; i < outputs.second.size(); ++i)
-  {
-    transfer_details td = outputs.second[i];
+    import_output(i + offset, outputs.second[i]);
 
-    // skip those we've already imported, or which have different data
-    if (i + offset < original_size)
-    {
-      // compare the data used to create the key image below
-      const transfer_details &org_td = m_transfers[i + offset];
-      if (!org_td.m_key_image_known)
-        goto process;
+  return m_transfers.size();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::import_output(size_t index, transfer_details td)
+{
+  // skip those we've already imported, or which have different data
+  if (index < m_transfers.size())
+  {
+    // compare the data used to create the key image below
+    const transfer_details &org_td = m_transfers[index];
+    if (!org_td.m_key_image_known)
+      goto process;
 #define CMPF(f) if (!(td.f == org_td.f)) goto process
-      CMPF(m_txid);
-      CMPF(m_key_image);
-      CMPF(m_internal_output_index);
+    CMPF(m_txid);
+    CMPF(m_key_image);
+    CMPF(m_internal_output_index);
 #undef CMPF
-      if (!(get_transaction_prefix_hash(td.m_tx) == get_transaction_prefix_hash(org_td.m_tx)))
-        goto process;
+    if (!(get_transaction_prefix_hash(td.m_tx) == get_transaction_prefix_hash(org_td.m_tx)))
+      goto process;
 
-      // copy anyway, since the comparison does not include ancillary fields which may have changed
-      m_transfers[i + offset] = std::move(td);
-      continue;
-    }
+    // copy anyway, since the comparison does not include ancillary fields which may have changed
+    m_transfers[index] = std::move(td);
+    return;
+  }
 
 process:
-
+  {
     // the hot wallet wouldn't have known about key images (except if we already exported them)
     cryptonote::keypair in_ephemeral;
 
-    THROW_WALLET_EXCEPTION_IF(td.m_tx.vout.empty(), error::wallet_internal_error, "tx with no outputs at index " + std::to_string(i + offset));
+    THROW_WALLET_EXCEPTION_IF(td.m_tx.vout.empty(), error::wallet_internal_error, "tx with no outputs at index " + std::to_string(index));
     crypto::public_key tx_pub_key;
     if (!try_get_tx_pub_key_using_td(td, tx_pub_key))
     {
@@ -13911,19 +15286,25 @@ process:
     td.m_key_image_request = true;
     td.m_key_image_partial = false;
     THROW_WALLET_EXCEPTION_IF(in_ephemeral.pub != out_key,
-        error::wallet_internal_error, "key_image generated ephemeral public key not matched with output_key at index " + std::to_string(i + offset));
+        error::wallet_internal_error, "key_image generated ephemeral public key not matched with output_key at index " + std::to_string(index));
 
-    m_key_images[td.m_key_image] = i + offset;
-    m_pub_keys[td.get_public_key()] = i + offset;
-    m_transfers[i + offset] = std::move(td);
+    m_key_images[td.m_key_image] = index;
+    m_pub_keys[td.get_public_key()] = index;
+    if (index == m_transfers.size())
+      m_transfers.push_back(std::move(td));
+    else
+      m_transfers[index] = std::move(td);
   }
-
-  return m_transfers.size();
 }
 //----------------------------------------------------------------------------------------------------
 size_t wallet2::import_outputs_from_str(std::string data)
 {
   PERF_TIMER(import_outputs_from_str);
+  if (tools::starts_with(data, OUTPUT_EXPORT_STREAM_MAGIC))
+  {
+    std::istringstream iss{std::move(data)};
+    return import_outputs_from_stream(iss);
+  }
   if (!tools::starts_with(data, OUTPUT_EXPORT_FILE_MAGIC))
   {
     THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Bad magic from outputs"));
@@ -13949,7 +15330,7 @@ size_t wallet2::import_outputs_from_str(std::string data)
   const cryptonote::account_public_address &keys = get_account().get_keys().m_account_address;
   if (public_spend_key != keys.m_spend_public_key || public_view_key != keys.m_view_public_key)
   {
-    THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Outputs from are for a different account"));
+    THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Outputs are for a different account"));
   }
 
   size_t imported_outputs = 0;
@@ -13983,6 +15364,80 @@ size_t wallet2::import_outputs_from_str(std::string data)
   return imported_outputs;
 }
 //----------------------------------------------------------------------------------------------------
+size_t wallet2::import_outputs_from_stream(std::istream &in)
+{
+  PERF_TIMER(import_outputs_from_stream);
+  m_transfers_cache.reset();
+
+  std::string magic(OUTPUT_EXPORT_STREAM_MAGIC.size(), '\0');
+  in.read(&magic[0], magic.size());
+  THROW_WALLET_EXCEPTION_IF(!in || magic != OUTPUT_EXPORT_STREAM_MAGIC, error::wallet_internal_error, "Bad magic from outputs");
+
+  const auto& view_skey = get_account().get_keys().m_view_secret_key;
+  output_export_cipher cipher{{}, view_skey};
+  crypto::generate_chacha_key(&view_skey, sizeof(view_skey), cipher.key, m_kdf_rounds);
+  THROW_WALLET_EXCEPTION_IF(!crypto::secret_key_to_public_key(view_skey, cipher.pkey), error::wallet_internal_error, "Failed to get view public key");
+
+  const auto header = cipher.read(in);
+  THROW_WALLET_EXCEPTION_IF(header.size() != 2 * sizeof(crypto::public_key) + 2 * sizeof(uint64_t), error::wallet_internal_error, "Bad header in outputs");
+  crypto::public_key public_spend_key, public_view_key;
+  uint64_t offset, total;
+  const char* p = header.data();
+  memcpy(&public_spend_key, p, sizeof(public_spend_key));
+  p += sizeof(public_spend_key);
+  memcpy(&public_view_key, p, sizeof(public_view_key));
+  p += sizeof(public_view_key);
+  memcpy(&offset, p, sizeof(offset));
+  p += sizeof(offset);
+  memcpy(&total, p, sizeof(total));
+  boost::endian::little_to_native_inplace(offset);
+  boost::endian::little_to_native_inplace(total);
+  const cryptonote::account_public_address &keys = get_account().get_keys().m_account_address;
+  THROW_WALLET_EXCEPTION_IF(public_spend_key != keys.m_spend_public_key || public_view_key != keys.m_view_public_key,
+      error::wallet_internal_error, "Outputs are for a different account");
+  THROW_WALLET_EXCEPTION_IF(offset > m_transfers.size(), error::wallet_internal_error,
+      "Imported outputs omit more outputs that we know of");
+  THROW_WALLET_EXCEPTION_IF(offset > total, error::wallet_internal_error, "Bad header in outputs");
+
+  if (m_transfers.size() > total)
+    m_transfers.resize(total);
+  for (size_t i = 0; i < offset; ++i)
+    m_transfers[i].m_key_image_request = false;
+
+  size_t index = offset;
+  try
+  {
+    for (;;)
+    {
+      const auto chunk = cipher.read(in);
+      if (chunk.empty())
+        break;
+      std::istringstream iss{std::string{chunk.view()}};
+      boost::archive::portable_binary_iarchive ar(iss);
+      uint64_t count;
+      ar >> count;
+      THROW_WALLET_EXCEPTION_IF(count > OUTPUT_EXPORT_CHUNK || index + count > total, error::wallet_internal_error, "Bad output count in outputs");
+      for (uint64_t i = 0; i < count; ++i, ++index)
+      {
+        transfer_details td;
+        ar >> td;
+        import_output(index, std::move(td));
+      }
+    }
+  }
+  catch (const error::wallet_internal_error&)
+  {
+    throw;
+  }
+  catch (const std::exception &e)
+  {
+    THROW_WALLET_EXCEPTION(error::wallet_internal_error, std::string("Failed to import outputs: ") + e.what());
+  }
+  THROW_WALLET_EXCEPTION_IF(index != total, error::wallet_internal_error, "Truncated outputs");
+
+  return m_transfers.size();
+}
+//----------------------------------------------------------------------------------------------------
 crypto::public_key wallet2::get_multisig_signer_public_key(const crypto::secret_key &spend_skey) const
 {
   crypto::public_key pkey;
@@ -14073,6 +15528,17 @@ crypto::key_image wallet2::get_multisig_composite_key_image(size_t n) const
 {
   CHECK_AND_ASSERT_THROW_MES(n < m_transfers.size(), "Bad output index");
 
+  std::vector<crypto::key_image> pkis;
+  for (const auto &info: m_transfers[n].m_multisig_info)
+    for (const auto &pki: info.m_partial_key_images)
+      pkis.push_back(pki);
+  return get_multisig_composite_key_image(n, pkis);
+}
+//----------------------------------------------------------------------------------------------------
+crypto::key_image wallet2::get_multisig_composite_key_image(size_t n, const std::vector<crypto::key_image> &pkis) const
+{
+  CHECK_AND_ASSERT_THROW_MES(n < m_transfers.size(), "Bad output index");
+
   const transfer_details &td = m_transfers[n];
   crypto::public_key tx_key;
   if (!try_get_tx_pub_key_using_td(td, tx_key))
@@ -14085,10 +15551,6 @@ crypto::key_image wallet2::get_multisig_composite_key_image(size_t n) const
   }
   const std::vector<crypto::public_key> additional_tx_keys = cryptonote::get_additional_tx_pub_keys_from_extra(td.m_tx);
   crypto::key_image ki;
-  std::vector<crypto::key_image> pkis;
-  for (const auto &info: td.m_multisig_info)
-    for (const auto &pki: info.m_partial_key_images)
-      pkis.push_back(pki);
   bool r = cryptonote::generate_multisig_composite_key_image(get_account().get_keys(), m_subaddresses, td.get_public_key(), tx_key, additional_tx_keys, td.m_internal_output_index, pkis, ki);
   THROW_WALLET_EXCEPTION_IF(!r, error::wallet_internal_error, "Failed to generate key image");
   return ki;
@@ -14101,26 +15563,41 @@ cryptonote::blobdata wallet2::export_multisig()
   const crypto::public_key signer = get_multisig_signer_public_key();
 
   info.resize(m_transfers.size());
+
+  // Our partial key images of an output never change, so each output's are only computed for its
+  // first export; the L/R pairs need new k's every time.
+  const size_t num_multisig_keys = get_account().get_multisig_keys().size();
   for (size_t n = 0; n < m_transfers.size(); ++n)
+  {
+    auto it = m_multisig_partial_key_images.find(m_transfers[n].get_public_key());
+    if (it != m_multisig_partial_key_images.end() && it->second.size() == num_multisig_keys)
+      info[n].m_partial_key_images = it->second;
+  }
+
+  // Wallet tries to create as many transactions as many signers combinations. We calculate the maximum number here as follows:
+  // if we have 2/4 wallet with signers: A, B, C, D and A is a transaction creator it will need to pick up 1 signer from 3 wallets left.
+  // That means counting combinations for excluding 2-of-3 wallets (k = total signers count - threshold, n = total signers count - 1).
+  const size_t nlr = tools::combinations_count(m_multisig_signers.size() - m_multisig_threshold, m_multisig_signers.size() - 1);
+
+  // Outputs are independent of each other
+  for_each_in_parallel(m_transfers.size(), [&](size_t n)
   {
     transfer_details &td = m_transfers[n];
-    crypto::key_image ki;
     memwipe(td.m_multisig_k.data(), td.m_multisig_k.size() * sizeof(td.m_multisig_k[0]));
-    info[n].m_LR.clear();
-    info[n].m_partial_key_images.clear();
 
-    for (size_t m = 0; m < get_account().get_multisig_keys().size(); ++m)
+    if (info[n].m_partial_key_images.size() != num_multisig_keys)
     {
-      // we want to export the partial key image, not the full one, so we can't use td.m_key_image
-      bool r = generate_multisig_key_image(get_account().get_keys(), m, td.get_public_key(), ki);
-      CHECK_AND_ASSERT_THROW_MES(r, "Failed to generate key image");
-      info[n].m_partial_key_images.push_back(ki);
+      info[n].m_partial_key_images.clear();
+      for (size_t m = 0; m < num_multisig_keys; ++m)
+      {
+        // we want to export the partial key image, not the full one, so we can't use td.m_key_image
+        crypto::key_image ki;
+        bool r = generate_multisig_key_image(get_account().get_keys(), m, td.get_public_key(), ki);
+        CHECK_AND_ASSERT_THROW_MES(r, "Failed to generate key image");
+        info[n].m_partial_key_images.push_back(ki);
+      }
     }
 
-    // Wallet tries to create as many transactions as many signers combinations. We calculate the maximum number here as follows:
-    // if we have 2/4 wallet with signers: A, B, C, D and A is a transaction creator it will need to pick up 1 signer from 3 wallets left.
-    // That means counting combinations for excluding 2-of-3 wallets (k = total signers count - threshold, n = total signers count - 1).
-    size_t nlr = tools::combinations_count(m_multisig_signers.size() - m_multisig_threshold, m_multisig_signers.size() - 1);
     for (size_t m = 0; m < nlr; ++m)
     {
       td.m_multisig_k.push_back(rct::skGen());
@@ -14129,7 +15606,10 @@ cryptonote::blobdata wallet2::export_multisig()
     }
 
     info[n].m_signer = signer;
-  }
+  });
+
+  for (size_t n = 0; n < m_transfers.size(); ++n)
+    m_multisig_partial_key_images[m_transfers[n].get_public_key()] = info[n].m_partial_key_images;
 
   std::stringstream oss;
   boost::archive::portable_binary_oarchive ar(oss);
@@ -14145,24 +15625,42 @@ cryptonote::blobdata wallet2::export_multisig()
   return ciphertext;
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::update_multisig_rescan_info(const std::vector<std::vector<rct::key>> &multisig_k, const std::vector<std::vector<wallet::multisig_info>> &info, size_t n)
+bool wallet2::multisig_partial_key_images_unchanged(const std::vector<std::vector<wallet::multisig_info>> &info, size_t n) const
 {
+  const transfer_details &td = m_transfers[n];
+  if (!td.m_key_image_known || td.m_key_image_partial || td.m_multisig_info.size() != info.size())
+    return false;
+  for (size_t i = 0; i < info.size(); ++i)
+    if (n >= info[i].size() || td.m_multisig_info[i].m_signer != info[i][n].m_signer
+        || td.m_multisig_info[i].m_partial_key_images != info[i][n].m_partial_key_images)
+      return false;
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::update_multisig_rescan_info(const std::vector<std::vector<rct::key>> &multisig_k, const std::vector<std::vector<wallet::multisig_info>> &info, size_t n, const crypto::key_image *key_image)
+{
+  m_transfers_cache.reset();
   CHECK_AND_ASSERT_THROW_MES(n < m_transfers.size(), "Bad index in update_multisig_info");
   CHECK_AND_ASSERT_THROW_MES(multisig_k.size() >= m_transfers.size(), "Mismatched sizes of multisig_k and info");
 
   MDEBUG("update_multisig_rescan_info: updating index " << n);
   transfer_details &td = m_transfers[n];
+  // The composite key image only depends on the partial key images, so it stays what it is if they do
+  const bool keep_key_image = !key_image && multisig_partial_key_images_unchanged(info, n);
   td.m_multisig_info.clear();
   for (const auto &pi: info)
   {
     CHECK_AND_ASSERT_THROW_MES(n < pi.size(), "Bad pi size");
     td.m_multisig_info.push_back(pi[n]);
   }
-  m_key_images.erase(td.m_key_image);
-  td.m_key_image = get_multisig_composite_key_image(n);
-  td.m_key_image_known = true;
-  td.m_key_image_request = false;
-  td.m_key_image_partial = false;
+  if (!keep_key_image)
+  {
+    m_key_images.erase(td.m_key_image);
+    td.m_key_image = key_image ? *key_image : get_multisig_composite_key_image(n);
+    td.m_key_image_known = true;
+    td.m_key_image_request = false;
+    td.m_key_image_partial = false;
+  }
   td.m_multisig_k = multisig_k[n];
   m_key_images[td.m_key_image] = n;
 }
@@ -14262,9 +15760,24 @@ size_t wallet2::import_multisig(std::vector<cryptonote::blobdata> blobs)
     break;
   }
 
-  for (size_t n = 0; n < n_outputs && n < m_transfers.size(); ++n)
+  // The composite key images are the expensive part.  Outputs whose partial key images are the
+  // same as at the last import keep theirs (update_multisig_rescan_info checks that again), and
+  // the others are computed in parallel before being put in place one by one.
+  const size_t n_update = std::min<size_t>(n_outputs, m_transfers.size());
+  std::vector<std::optional<crypto::key_image>> key_images(n_update);
+  for_each_in_parallel(n_update, [&](size_t n)
+  {
+    if (multisig_partial_key_images_unchanged(info, n))
+      return;
+    std::vector<crypto::key_image> pkis;
+    for (const auto &pi: info)
+      for (const auto &pki: pi[n].m_partial_key_images)
+        pkis.push_back(pki);
+    key_images[n] = get_multisig_composite_key_image(n, pkis);
+  });
+  for (size_t n = 0; n < n_update; ++n)
   {
-    update_multisig_rescan_info(k, info, n);
+    update_multisig_rescan_info(k, info, n, key_images[n] ? &*key_images[n] : nullptr);
   }
 
   m_multisig_rescan_k = &k;
@@ -14879,6 +16392,7 @@ bool parse_priority(const std::string& arg, uint32_t& priority)
 //----------------------------------------------------------------------------------------------------
 void wallet2::finish_rescan_bc_keep_key_images(uint64_t transfer_height, const crypto::hash &hash)
 {
+  m_transfers_cache.reset();
   // Compute hash of m_transfers, if differs there had to be BC reorg.
   crypto::hash new_transfers_hash{};
   hash_m_transfers((int64_t) transfer_height, new_transfers_hash);
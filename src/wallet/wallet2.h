@@ -39,10 +39,12 @@
 #include <boost/serialization/list.hpp>
 #include <boost/serialization/deque.hpp>
 #include <atomic>
+#include <future>
 #include <random>
 
 #include "cryptonote_basic/account.h"
 #include "cryptonote_basic/account_boost_serialization.h"
+#include "cryptonote_basic/block_digest.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
@@ -61,6 +63,8 @@
 #include "common/password.h"
 #include "node_rpc_proxy.h"
 #include "message_store.h"
+#include "wallet_cache_db.h"
+#include "subaddress_table.h"
 #include "wallet_light_rpc.h"
 
 #include "tx_construction_data.h"
@@ -85,6 +89,7 @@
 
 class Serialization_portability_wallet_Test;
 class wallet_accessor_test;
+class wallet_refresh_benchmark;
 
 OXEN_RPC_DOC_INTROSPECT
 namespace tools
@@ -158,6 +163,12 @@ private:
     virtual std::optional<epee::wipeable_string> on_device_pin_request() { return std::nullopt; }
     virtual std::optional<epee::wipeable_string> on_device_passphrase_request(bool& on_device) { on_device = true; return std::nullopt; }
     virtual void on_device_progress(const hw::device_progress& event) {};
+    // Signed key image import: how many of the `total` key images have had their signature verified,
+    // and have been checked for being spent (when the import checks that)
+    virtual void on_import_key_images_progress(size_t verified, size_t checked, size_t total) {}
+    // Signing an unsigned tx set: `done` of its `total` txs are signed.  Called from whichever
+    // thread signed the tx, but one call at a time and with `done` going up by one each call.
+    virtual void on_sign_tx_progress(size_t done, size_t total) {}
     // Common callbacks
     virtual void on_pool_tx_removed(const crypto::hash &txid) {}
     virtual ~i_wallet2_callback() {}
@@ -201,6 +212,8 @@ private:
     bool empty() const { return m_blockchain.empty() && m_offset == 0; }
     void trim(size_t height) { while (height > m_offset && m_blockchain.size() > 1) { m_blockchain.pop_front(); ++m_offset; } m_blockchain.shrink_to_fit(); }
     void refill(const crypto::hash &hash) { m_blockchain.push_back(hash); --m_offset; }
+    // Exchanges the hashes from offset() on with `hashes`, keeping the offset and genesis hash
+    void swap_hashes(std::deque<crypto::hash> &hashes) { m_blockchain.swap(hashes); }
 
     template <class t_archive>
     void serialize(t_archive &a, const unsigned int ver)
@@ -234,8 +247,11 @@ private:
   {
     friend class ::Serialization_portability_wallet_Test;
     friend class ::wallet_accessor_test;
+    friend class ::wallet_refresh_benchmark;
     friend class wallet_keys_unlocker;
     friend class wallet_device_callback;
+    friend class wallet_scan_group;
+    friend class block_prefetcher;
   public:
     static constexpr std::chrono::seconds rpc_timeout = 30s;
     enum RefreshType {
@@ -732,6 +748,17 @@ private:
     // all locked & unlocked balances of all subaddress accounts
     uint64_t balance_all(bool strict) const;
     uint64_t unlocked_balance_all(bool strict, uint64_t *blocks_to_unlock = NULL, uint64_t *time_to_unlock = NULL) const;
+    // number of unspent outputs of a subaddress, and whether it ever received any output
+    size_t get_num_unspent_outputs(const cryptonote::subaddress_index& index) const;
+    bool is_subaddress_used(const cryptonote::subaddress_index& index) const;
+
+    class balance_snapshot;
+    // Returns the snapshot last published by publish_balance_snapshot() (null if none was yet).
+    // Unlike the rest of wallet2 this may be called from any thread at any time, including while
+    // a refresh is running: refresh() publishes a snapshot when it starts and after each batch of
+    // blocks it processes.
+    std::shared_ptr<const balance_snapshot> get_balance_snapshot() const;
+    void publish_balance_snapshot();
     void transfer_selected_rct(std::vector<cryptonote::tx_destination_entry> dsts, const std::vector<size_t>& selected_transfers, size_t fake_outputs_count,
       std::vector<std::vector<tools::wallet2::get_outs_entry>> &outs,
       uint64_t unlock_time, uint64_t fee, const std::vector<uint8_t>& extra, cryptonote::transaction& tx, pending_tx &ptx, const rct::RCTConfig &rct_config, const cryptonote::oxen_construct_tx_params &oxen_tx_params);
@@ -798,6 +825,9 @@ private:
       std::set<uint32_t> subaddr_indices;
       uint32_t account_index;
       bool all_accounts;
+      // Skips the first `offset` matching transfers, and returns at most `limit` (0 for no limit)
+      size_t offset = 0;
+      size_t limit = 0;
     };
     void get_transfers(get_transfers_args_t args, std::vector<wallet::transfer_view>& transfers);
     std::string transfers_to_csv(const std::vector<wallet::transfer_view>& transfers, bool formatting = false) const;
@@ -840,6 +870,12 @@ private:
     void rescan_blockchain(bool hard, bool refresh = true, bool keep_key_images = false);
     bool is_transfer_unlocked(const transfer_details &td) const;
     bool is_transfer_unlocked(uint64_t unlock_time, uint64_t block_height, bool unmined_blink, crypto::key_image const *key_image = nullptr) const;
+    // The unlock_time, spendable age and unmined blink checks of is_transfer_unlocked(), without the
+    // check that the network doesn't hold the output (see get_locked_key_images())
+    bool is_transfer_age_unlocked(uint64_t unlock_time, uint64_t block_height, bool unmined_blink) const;
+    // Key images that the network keeps from being spent: blacklisted ones and those of our locked
+    // service node contributions.  Empty when offline or when the daemon can't tell us.
+    std::unordered_set<crypto::key_image> get_locked_key_images() const;
 
     uint64_t get_last_block_reward() const { return m_last_block_reward; }
     uint64_t get_device_last_key_image_sync() const { return m_device_last_key_image_sync; }
@@ -1013,6 +1049,26 @@ private:
     void ignore_outputs_below(uint64_t value) { m_ignore_outputs_below = value; }
     bool track_uses() const { return m_track_uses; }
     void track_uses(bool value) { m_track_uses = value; }
+    // When enabled, the wallet cache is kept in an SQLite database that store() updates with just
+    // the records that changed, rather than rewriting a single encrypted file.  Takes effect on the
+    // next store().
+    bool incremental_cache() const { return m_incremental_cache; }
+    void incremental_cache(bool value) { m_incremental_cache = value; }
+    // When enabled, refresh pulls block digests (GET_BLOCK_DIGESTS: the blocks, and the keys of
+    // their txs) instead of the blocks' txs, and fetches just the txs that turn out to concern us.
+    // Needs a daemon that serves digests, and a wallet whose view key isn't on a device (others
+    // refresh as usual).  Txs that aren't fetched aren't seen by track_uses().
+    bool sync_from_digests() const { return m_sync_from_digests; }
+    void sync_from_digests(bool value) { m_sync_from_digests = value; }
+    // Limits for syncing in small steps, e.g. in the background on a phone; not stored with the
+    // wallet.  With a refresh block limit, refresh() returns once it has added that many blocks
+    // (or more, as it stops between spans), leaving the caller to store the wallet and call it
+    // again.  The sync batch size caps the blocks per daemon request when syncing from digests.
+    // 0 for either means no limit.
+    uint64_t refresh_max_blocks() const { return m_refresh_max_blocks; }
+    void refresh_max_blocks(uint64_t blocks) { m_refresh_max_blocks = blocks; }
+    uint64_t sync_batch_size() const { return m_sync_batch_size; }
+    void sync_batch_size(uint64_t blocks) { m_sync_batch_size = blocks; }
     std::chrono::seconds inactivity_lock_timeout() const { return m_inactivity_lock_timeout; }
     void inactivity_lock_timeout(std::chrono::seconds seconds) { m_inactivity_lock_timeout = seconds; }
     const std::string & device_name() const { return m_device_name; }
@@ -1160,6 +1216,14 @@ private:
     std::string export_outputs_to_str(bool all = false) const;
     size_t import_outputs(const std::pair<size_t, std::vector<transfer_details>> &outputs);
     size_t import_outputs_from_str(std::string outputs_st);
+    // As export_outputs_to_str and import_outputs_from_str, but streamed: the outputs are written
+    // and read in separately encrypted chunks, so that neither wallet needs them all in memory at
+    // once.  If `start` is given, only the outputs from that index on are exported (the wallet
+    // importing them must already have the ones before); passing the count an earlier export
+    // returned exports only the outputs received since.  Returns the number of outputs the wallet
+    // has, i.e. the `start` for the next export.  import_outputs_from_str also reads this format.
+    size_t export_outputs_to_stream(std::ostream &out, bool all = false, std::optional<size_t> start = std::nullopt) const;
+    size_t import_outputs_from_stream(std::istream &in);
     payment_container export_payments() const;
     void import_payments(const payment_container &payments);
     void import_payments_out(const std::list<std::pair<crypto::hash,wallet2::confirmed_transfer_details>> &confirmed_payments);
@@ -1487,14 +1551,33 @@ private:
     bool should_skip_block(const cryptonote::block &b, uint64_t height) const;
     void process_new_blockchain_entry(const cryptonote::block& b, const cryptonote::block_complete_entry& bche, const parsed_block &parsed_block, const crypto::hash& bl_id, uint64_t height, const std::vector<tx_cache_data> &tx_cache_data, size_t tx_cache_data_offset, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL);
     void detach_blockchain(uint64_t height, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL);
+    // Drops the N oldest entries of a short chain history, other than the genesis block
+    static void drop_from_short_history(std::list<crypto::hash> &short_chain_history, size_t N);
     void get_short_chain_history(std::list<crypto::hash>& ids, uint64_t granularity = 1) const;
+    // The short chain history a refresh starts from: a coarse one on the first refresh from an
+    // untrusted daemon, so as not to reveal exactly which blocks we already have
+    void get_refresh_short_chain_history(std::list<crypto::hash>& ids, bool trusted_daemon) const;
     bool clear();
     void clear_soft(bool keep_key_images=false);
     void pull_blocks(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::rpc::GET_BLOCKS_FAST::block_output_indices> &o_indices, uint64_t &current_height);
+    // Like pull_blocks() (from start height 0), but with a digest of its txs for each block, and no txs
+    void pull_block_digests(uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::block_digest::digest> &digests, uint64_t &current_height);
+    // Brings m_pool_hashes up to date with the daemon's pool; returns false if the daemon can't do
+    // that (and so get_pool_state() has to get all the pool's hashes)
+    bool update_pool_hashes();
+    // Gets the IS_KEY_IMAGE_SPENT status of each of m_transfers' key images with
+    // IS_KEY_IMAGE_SPENT_BIN; returns false if the daemon doesn't have it
+    bool get_spent_status_bin(std::vector<int> &spent_status);
     void pull_hashes(uint64_t start_height, uint64_t& blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<crypto::hash> &hashes);
     void fast_refresh(uint64_t stop_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, bool force = false);
-    void pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks_start_height, std::list<crypto::hash> &short_chain_history, const std::vector<cryptonote::block_complete_entry> &prev_blocks, const std::vector<parsed_block> &prev_parsed_blocks, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, bool &last, bool &error, std::exception_ptr &exception);
     void process_parsed_blocks(uint64_t start_height, const std::vector<cryptonote::block_complete_entry> &blocks, const std::vector<parsed_block> &parsed_blocks, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL);
+    // process_parsed_blocks() for blocks pulled with pull_block_digests(): fetches the txs whose
+    // digests match, and processes the blocks with just those.  Takes the blocks apart.
+    void process_digest_blocks(uint64_t start_height, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<parsed_block> &parsed_blocks, const std::vector<cryptonote::block_digest::digest> &digests, uint64_t& blocks_added, std::map<std::pair<uint64_t, uint64_t>, size_t> *output_tracker_cache = NULL);
+    // Appends to `matches` the indices of the txs of the digest that spend one of our key images,
+    // are ours and still unconfirmed, or have an output to one of our subaddresses, in which case
+    // `incoming` is set.
+    void match_block_digest(const parsed_block &pb, const cryptonote::block_digest::digest &digest, std::vector<size_t> &matches, bool &incoming) const;
     uint64_t select_transfers(uint64_t needed_money, std::vector<size_t> unused_transfers_indices, std::vector<size_t>& selected_transfers) const;
     bool prepare_file_names(const fs::path& file_path);
     void process_unconfirmed(const crypto::hash &txid, const cryptonote::transaction& tx, uint64_t height);
@@ -1518,18 +1601,45 @@ private:
     void set_unspent(size_t idx);
     bool is_spent(const transfer_details &td, bool strict = true) const;
     bool is_spent(size_t idx, bool strict = true) const;
+    // Fills in `outs` with a ring for each of `selected_transfers`.  Rings already in `outs` (for
+    // the first outs.size() transfers) are kept, so that a tx built up one input at a time only
+    // fetches decoys for the new inputs.
     void get_outs(std::vector<std::vector<get_outs_entry>> &outs, const std::vector<size_t> &selected_transfers, size_t fake_outputs_count, bool has_rct);
-    void get_outs(std::vector<std::vector<get_outs_entry>> &outs, const std::vector<size_t> &selected_transfers, size_t fake_outputs_count, std::vector<uint64_t> &rct_offsets, bool has_rct);
+    // Sets `num_rct_outputs` to the number of rct outputs in the chain if the rct distribution was
+    // used, 0 otherwise
+    void get_outs(std::vector<std::vector<get_outs_entry>> &outs, const std::vector<size_t> &selected_transfers, size_t fake_outputs_count, uint64_t &num_rct_outputs, bool has_rct);
+    // Calls `f(i)` for each i in [0, n): on the threadpool with a software device, one after the
+    // other otherwise.  Rethrows the first exception thrown by an `f` call (by index), after all of
+    // them have finished.
+    void for_each_in_parallel(size_t n, const std::function<void(size_t)>& f) const;
+    // for_each_in_parallel() for building independent txs, except for multisig wallets which build
+    // them one after the other
+    void construct_txs(size_t n, const std::function<void(size_t)>& build);
     bool tx_add_fake_output(std::vector<std::vector<tools::wallet2::get_outs_entry>> &outs, uint64_t global_index, const crypto::public_key& tx_public_key, const rct::key& mask, uint64_t real_index, bool unlocked) const;
     bool should_pick_a_second_output(size_t n_transfers, const std::vector<size_t> &unused_transfers_indices, const std::vector<size_t> &unused_dust_indices) const;
     std::vector<size_t> get_only_rct(const std::vector<size_t> &unused_dust_indices, const std::vector<size_t> &unused_transfers_indices) const;
     void scan_output(const cryptonote::transaction &tx, bool miner_tx, const crypto::public_key &tx_pub_key, size_t vout_index, tx_scan_info_t &tx_scan_info, std::vector<tx_money_got_in_out> &tx_money_got_in_outs, std::vector<size_t> &outs, bool pool, bool blink);
     void trim_hashchain();
+    void load_cache_db();
+    void store_cache_db();
+    // Waits for load_cache_db()'s background load of the transfer history (m_payments,
+    // m_confirmed_txs, m_tx_keys and m_additional_tx_keys), if it is still going; anything that
+    // touches those calls this first.  Throws if the load failed.
+    void wait_for_history() const;
     crypto::key_image get_multisig_composite_key_image(size_t n) const;
+    // As above, but from the other signers' partial key images `pkis` rather than the transfer's
+    // current m_multisig_info
+    crypto::key_image get_multisig_composite_key_image(size_t n, const std::vector<crypto::key_image> &pkis) const;
+    // True if transfer `n` has a composite key image made from the same signers' partial key images
+    // as those in `info` (the signers' imported infos, sorted by signer), i.e. which `info` would
+    // not change
+    bool multisig_partial_key_images_unchanged(const std::vector<std::vector<wallet::multisig_info>> &info, size_t n) const;
     rct::multisig_kLRki get_multisig_composite_kLRki(size_t n,  const std::unordered_set<crypto::public_key> &ignore_set, std::unordered_set<rct::key> &used_L, std::unordered_set<rct::key> &new_used_L) const;
     rct::multisig_kLRki get_multisig_kLRki(size_t n, const rct::key &k) const;
     rct::key get_multisig_k(size_t idx, const std::unordered_set<rct::key> &used_L) const;
-    void update_multisig_rescan_info(const std::vector<std::vector<rct::key>> &multisig_k, const std::vector<std::vector<wallet::multisig_info>> &info, size_t n);
+    // Puts the imported multisig info of transfer `n` in place, with its composite key image set to
+    // `key_image` if given, or else computed (unless its partial key images haven't changed)
+    void update_multisig_rescan_info(const std::vector<std::vector<rct::key>> &multisig_k, const std::vector<std::vector<wallet::multisig_info>> &info, size_t n, const crypto::key_image *key_image = nullptr);
     bool add_rings(const crypto::chacha_key &key, const cryptonote::transaction_prefix &tx);
     bool add_rings(const cryptonote::transaction_prefix &tx);
     bool remove_rings(const cryptonote::transaction_prefix &tx);
@@ -1541,7 +1651,8 @@ private:
     void register_devices();
     hw::device& lookup_device(const std::string & device_descriptor);
 
-    bool get_rct_distribution(uint64_t &start_height, std::vector<uint64_t> &distribution);
+    // Brings m_rct_distribution up to date with the daemon
+    bool update_rct_distribution();
     bool get_output_blacklist(std::vector<uint64_t> &blacklist);
 
     uint64_t get_segregation_fork_height() const;
@@ -1569,6 +1680,9 @@ private:
     std::string get_rpc_status(const std::string &s) const;
 
     bool should_expand(const cryptonote::subaddress_index &index) const;
+    // Imports one output of an output export as m_transfers[index] (index is at most
+    // m_transfers.size()), generating its key image unless we already have it
+    void import_output(size_t index, transfer_details td);
 
     cryptonote::account_base m_account;
     fs::path m_wallet_file;
@@ -1592,6 +1706,9 @@ private:
     std::unordered_map<crypto::public_key, size_t> m_pub_keys;
     cryptonote::account_public_address m_account_public_address;
     std::unordered_map<crypto::public_key, cryptonote::subaddress_index> m_subaddresses;
+    // The same keys as m_subaddresses, for the lookups of scanning (m_subaddresses being what gets
+    // stored, and what the tx construction and key image functions take)
+    subaddress_table m_subaddress_table;
     std::vector<std::vector<std::string>> m_subaddress_labels;
     std::unordered_map<crypto::hash, std::string> m_tx_notes;
     std::unordered_map<std::string, std::string> m_attributes;
@@ -1600,6 +1717,9 @@ private:
     uint64_t m_upper_transaction_weight_limit; //TODO: auto-calc this value or request from daemon, now use some fixed value
     const std::vector<std::vector<wallet::multisig_info>> *m_multisig_rescan_info;
     const std::vector<std::vector<rct::key>> *m_multisig_rescan_k;
+    // Our own partial key images of each output (by output public key) that has been in a multisig
+    // export: they only depend on the output and our multisig keys.  Not stored with the wallet.
+    std::unordered_map<crypto::public_key, std::vector<crypto::key_image>> m_multisig_partial_key_images;
     std::unordered_map<crypto::public_key, crypto::key_image> m_cold_key_images;
 
     std::atomic<bool> m_run;
@@ -1643,6 +1763,71 @@ private:
     uint64_t m_ignore_outputs_above;
     uint64_t m_ignore_outputs_below;
     bool m_track_uses;
+    bool m_incremental_cache;
+    bool m_sync_from_digests;
+    uint64_t m_refresh_max_blocks;
+    uint64_t m_sync_batch_size;
+
+    // Our copy of the daemon's pool tx hashes (the value is true for approved blinks), and where it
+    // is in the daemon's GET_TRANSACTION_POOL_CHANGES_BIN sequence (pool id 0: no copy)
+    std::unordered_map<crypto::hash, bool> m_pool_hashes;
+    uint64_t m_pool_id = 0;
+    uint64_t m_pool_seq = 0;
+    bool m_pool_changes_unsupported = false;
+
+    // The confirmed transfers (entries of m_payments and m_confirmed_txs) in get_transfers() order,
+    // as a whole and by account.  Built by get_transfers() when first needed, and dropped by
+    // whatever adds or removes entries of either.
+    struct transfer_history_entry
+    {
+      uint64_t height;
+      uint64_t timestamp;
+      crypto::hash txid;
+      // One of these is set
+      const payment_container::value_type* in;
+      const std::pair<const crypto::hash, confirmed_transfer_details>* out;
+    };
+    struct transfer_history_index
+    {
+      std::vector<transfer_history_entry> all;
+      std::unordered_map<uint32_t, std::vector<transfer_history_entry>> by_account;
+    };
+    const transfer_history_index& get_transfer_history_index();
+    std::optional<transfer_history_index> m_transfer_history;
+
+    // A transfer_summary of each of m_transfers and the balances per (account, subaddress), built
+    // in one pass over m_transfers (and m_unconfirmed_txs) when first asked for, and dropped by
+    // whatever changes either.  Unlocked
+    // balances also depend on the chain height, the daemon's locked key images and (for time
+    // locked outputs) the clock, so they are tallied again when the heights change or the earliest
+    // time lock expires.
+    struct subaddress_unlocked_balance
+    {
+      uint64_t amount = 0;
+      uint64_t unlock_height = 0; // highest unlock height of the locked outputs
+      uint64_t unlock_time = 0;   // latest unlock time of the time locked outputs
+    };
+    struct transfers_cache
+    {
+      std::vector<wallet::transfer_summary> summaries; // parallel to m_transfers
+      std::unordered_map<uint32_t, std::map<uint32_t, uint64_t>> balance[2]; // [strict]
+      bool have_unlocked = false;
+      uint64_t unlocked_height = 0;
+      uint64_t daemon_height = 0;
+      uint64_t recheck_time = 0;
+      std::unordered_map<uint32_t, std::map<uint32_t, subaddress_unlocked_balance>> unlocked[2]; // [strict]
+    };
+    // Caller must hold m_transfers_cache_mutex
+    void update_transfers_cache(bool unlocked) const;
+    // The summaries of m_transfers, valid until m_transfers next changes
+    const std::vector<wallet::transfer_summary>& get_transfer_summaries() const;
+    // Whether a transfer can be spent now: unspent, not frozen, complete (multisig) and unlocked,
+    // where `locked_key_images` is get_locked_key_images(), fetched once for a whole scan.
+    bool is_transfer_available(const wallet::transfer_summary& ts, const std::unordered_set<crypto::key_image>& locked_key_images) const;
+    mutable std::optional<transfers_cache> m_transfers_cache;
+    mutable std::mutex m_transfers_cache_mutex;
+    std::shared_ptr<const balance_snapshot> m_balance_snapshot;
+    mutable std::mutex m_balance_snapshot_mutex;
     std::chrono::seconds m_inactivity_lock_timeout;
     bool m_is_initialized;
     NodeRPCProxy m_node_rpc_proxy;
@@ -1679,6 +1864,15 @@ private:
 
     uint64_t m_last_block_reward;
     std::unique_ptr<tools::file_locker> m_keys_file_locker;
+
+    // Cumulative rct output distribution (from m_rct_distribution_start_height) as of the last
+    // update_rct_distribution() call, which only asks the daemon for blocks after
+    // m_rct_distribution_top_hash when it can.
+    std::vector<uint64_t> m_rct_distribution;
+    uint64_t m_rct_distribution_start_height = 0;
+    std::string m_rct_distribution_top_hash;
+    // Picks decoys from m_rct_distribution; dropped whenever that changes
+    std::unique_ptr<gamma_picker> m_gamma_picker;
     
     mms::message_store m_message_store;
     bool m_original_keys_available;
@@ -1686,6 +1880,9 @@ private:
     crypto::secret_key m_original_view_secret_key;
 
     crypto::chacha_key m_cache_key;
+    std::unique_ptr<wallet_cache_db> m_cache_db; // open while the wallet cache is a database
+    mutable std::future<void> m_history_load;
+    mutable std::exception_ptr m_history_error;
     std::optional<epee::wipeable_string> m_encrypt_keys_after_refresh;
     std::mutex m_decrypt_keys_mutex;
     unsigned int m_decrypt_keys_lockers;
@@ -1702,6 +1899,50 @@ private:
     inline static std::string default_daemon_address;
   };
 
+  // A copy of a wallet's balances, addresses and heights (see wallet2::get_balance_snapshot()); its
+  // accessors mirror wallet2's.
+  class wallet2::balance_snapshot
+  {
+  public:
+    uint64_t get_blockchain_current_height() const { return m_height; }
+    uint64_t get_immutable_height() const { return m_immutable_height; }
+    bool multisig() const { return m_multisig; }
+    bool has_multisig_partial_key_images() const { return m_multisig_partial_key_images; }
+    size_t get_num_subaddress_accounts() const { return m_subaddresses.size(); }
+    size_t get_num_subaddresses(uint32_t index_major) const { return index_major < m_subaddresses.size() ? m_subaddresses[index_major].size() : 0; }
+    std::string get_subaddress_as_str(const cryptonote::subaddress_index& index) const;
+    std::string get_subaddress_label(const cryptonote::subaddress_index& index) const;
+    size_t get_num_unspent_outputs(const cryptonote::subaddress_index& index) const;
+    bool is_subaddress_used(const cryptonote::subaddress_index& index) const;
+
+    uint64_t balance(uint32_t subaddr_index_major, bool strict) const;
+    uint64_t unlocked_balance(uint32_t subaddr_index_major, bool strict, uint64_t *blocks_to_unlock = NULL, uint64_t *time_to_unlock = NULL) const;
+    std::map<uint32_t, uint64_t> balance_per_subaddress(uint32_t subaddr_index_major, bool strict) const;
+    std::map<uint32_t, std::pair<uint64_t, std::pair<uint64_t, uint64_t>>> unlocked_balance_per_subaddress(uint32_t subaddr_index_major, bool strict) const;
+    uint64_t balance_all(bool strict) const;
+    uint64_t unlocked_balance_all(bool strict, uint64_t *blocks_to_unlock = NULL, uint64_t *time_to_unlock = NULL) const;
+
+  private:
+    friend class wallet2;
+
+    struct subaddress
+    {
+      std::string address;
+      std::string label;
+      size_t num_unspent_outputs = 0;
+      bool used = false;
+    };
+    const subaddress* find(const cryptonote::subaddress_index& index) const;
+
+    uint64_t m_height = 0;
+    uint64_t m_immutable_height = 0;
+    bool m_multisig = false;
+    bool m_multisig_partial_key_images = false;
+    std::vector<std::vector<subaddress>> m_subaddresses; // [major][minor]
+    std::unordered_map<uint32_t, std::map<uint32_t, uint64_t>> m_balance[2]; // [strict]
+    std::unordered_map<uint32_t, std::map<uint32_t, subaddress_unlocked_balance>> m_unlocked[2]; // [strict]
+  };
+
   // TODO(oxen): Hmm. We need this here because we make register_service_node do
   // parsing on the wallet2 side instead of simplewallet. This is so that
   // register_service_node RPC command doesn't make it the wallet_rpc's
@@ -0,0 +1,258 @@
+// Copyright (c) 2021, The Oxen Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <cstring>
+#include <fstream>
+#include <sqlite3.h>
+#include <sodium/crypto_generichash.h>
+#include "epee/misc_log_ex.h"
+#include "epee/misc_language.h"
+#include "crypto/crypto.h"
+#include "wallet_errors.h"
+#include "wallet_cache_db.h"
+
+#undef OXEN_DEFAULT_LOG_CATEGORY
+#define OXEN_DEFAULT_LOG_CATEGORY "wallet.cachedb"
+
+namespace tools
+{
+
+namespace
+{
+  constexpr std::string_view SQLITE_MAGIC{"SQLite format 3\0", 16};
+
+  struct statement
+  {
+    sqlite3_stmt* st = nullptr;
+    statement(sqlite3* db, const char* sql)
+    {
+      int r = sqlite3_prepare_v2(db, sql, -1, &st, nullptr);
+      THROW_WALLET_EXCEPTION_IF(r != SQLITE_OK, error::wallet_internal_error,
+          "Failed to prepare wallet cache query: " + std::string(sqlite3_errmsg(db)));
+    }
+    ~statement() { sqlite3_finalize(st); }
+    statement(const statement&) = delete;
+    statement& operator=(const statement&) = delete;
+
+    void bind(int i, std::string_view text) { sqlite3_bind_text(st, i, text.data(), text.size(), SQLITE_STATIC); }
+    void bind(int i, size_t val) { sqlite3_bind_int64(st, i, val); }
+    void bind_blob(int i, std::string_view blob) { sqlite3_bind_blob(st, i, blob.data(), blob.size(), SQLITE_STATIC); }
+  };
+
+  crypto::hash fingerprint(std::string_view data)
+  {
+    crypto::hash h;
+    crypto_generichash(reinterpret_cast<unsigned char*>(h.data), sizeof(h),
+        reinterpret_cast<const unsigned char*>(data.data()), data.size(), nullptr, 0);
+    return h;
+  }
+}
+
+bool wallet_cache_db::is_cache_db(const fs::path& filename)
+{
+  fs::ifstream in{filename, std::ios::binary};
+  char magic[SQLITE_MAGIC.size()];
+  return in && in.read(magic, sizeof(magic)) && std::string_view{magic, sizeof(magic)} == SQLITE_MAGIC;
+}
+
+wallet_cache_db::wallet_cache_db(fs::path filename) : filename_{std::move(filename)}
+{
+  int r = sqlite3_open_v2(filename_.u8string().c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr);
+  if (r != SQLITE_OK)
+  {
+    std::string err = db ? sqlite3_errmsg(db) : sqlite3_errstr(r);
+    close();
+    THROW_WALLET_EXCEPTION(error::wallet_internal_error, "Failed to open wallet cache database " + filename_.u8string() + ": " + err);
+  }
+  try
+  {
+    exec("CREATE TABLE IF NOT EXISTS pages ("
+        " section TEXT NOT NULL,"
+        " page INTEGER NOT NULL,"
+        " data BLOB NOT NULL,"
+        " PRIMARY KEY (section, page)"
+        ") WITHOUT ROWID");
+  }
+  catch (...)
+  {
+    close();
+    throw;
+  }
+}
+
+wallet_cache_db::~wallet_cache_db()
+{
+  if (in_store)
+    rollback();
+  close();
+}
+
+void wallet_cache_db::close()
+{
+  sqlite3_close_v2(db);
+  db = nullptr;
+}
+
+void wallet_cache_db::exec(const char* sql)
+{
+  char* err = nullptr;
+  int r = sqlite3_exec(db, sql, nullptr, nullptr, &err);
+  OXEN_DEFER { sqlite3_free(err); };
+  THROW_WALLET_EXCEPTION_IF(r != SQLITE_OK, error::wallet_internal_error,
+      "Wallet cache database error: " + std::string(err ? err : sqlite3_errstr(r)));
+}
+
+void wallet_cache_db::rename(const fs::path& filename)
+{
+  THROW_WALLET_EXCEPTION_IF(in_store, error::wallet_internal_error, "Cannot rename the wallet cache database during a store");
+  close();
+  std::error_code ec;
+#ifdef WIN32
+  // See wallet2::store_to: renaming over an existing file fails on Windows
+  fs::remove(filename, ec);
+#endif
+  fs::rename(filename_, filename, ec);
+  if (!ec)
+    filename_ = filename;
+  // Reopen whichever file we now have, so that we stay usable even if the rename failed
+  int r = sqlite3_open_v2(filename_.u8string().c_str(), &db, SQLITE_OPEN_READWRITE, nullptr);
+  if (r != SQLITE_OK)
+  {
+    close();
+    THROW_WALLET_EXCEPTION(error::wallet_internal_error, "Failed to reopen wallet cache database " + filename_.u8string());
+  }
+  THROW_WALLET_EXCEPTION_IF(ec, error::file_save_error, filename, ec);
+}
+
+std::vector<std::string> wallet_cache_db::load(const crypto::chacha_key& key, std::string_view section)
+{
+  std::vector<std::string> pages;
+  std::vector<crypto::hash> prints;
+  statement select{db, "SELECT page, data FROM pages WHERE section = ? ORDER BY page"};
+  select.bind(1, section);
+  int r;
+  while ((r = sqlite3_step(select.st)) == SQLITE_ROW)
+  {
+    THROW_WALLET_EXCEPTION_IF(static_cast<uint64_t>(sqlite3_column_int64(select.st, 0)) != pages.size(),
+        error::wallet_internal_error, "Wallet cache section " + std::string{section} + " is missing pages");
+    auto* blob = static_cast<const char*>(sqlite3_column_blob(select.st, 1));
+    size_t size = sqlite3_column_bytes(select.st, 1);
+    THROW_WALLET_EXCEPTION_IF(size < sizeof(crypto::chacha_iv), error::wallet_internal_error,
+        "Invalid page in wallet cache section " + std::string{section});
+    crypto::chacha_iv iv;
+    std::memcpy(&iv, blob, sizeof(iv));
+    auto& page = pages.emplace_back(size - sizeof(iv), '\0');
+    crypto::chacha20(blob + sizeof(iv), page.size(), key, iv, page.data());
+    prints.push_back(fingerprint(page));
+  }
+  THROW_WALLET_EXCEPTION_IF(r != SQLITE_DONE, error::wallet_internal_error,
+      "Failed to read wallet cache section " + std::string{section} + ": " + sqlite3_errmsg(db));
+
+  if (auto it = fingerprints.find(section); it != fingerprints.end())
+    it->second = std::move(prints);
+  else
+    fingerprints.emplace(section, std::move(prints));
+  return pages;
+}
+
+size_t wallet_cache_db::pages(std::string_view section) const
+{
+  auto it = fingerprints.find(section);
+  return it == fingerprints.end() ? 0 : it->second.size();
+}
+
+void wallet_cache_db::begin()
+{
+  THROW_WALLET_EXCEPTION_IF(in_store, error::wallet_internal_error, "Wallet cache store already in progress");
+  exec("BEGIN");
+  committed_fingerprints = fingerprints;
+  in_store = true;
+}
+
+void wallet_cache_db::commit()
+{
+  THROW_WALLET_EXCEPTION_IF(!in_store, error::wallet_internal_error, "No wallet cache store in progress");
+  exec("COMMIT");
+  committed_fingerprints.clear();
+  in_store = false;
+}
+
+void wallet_cache_db::rollback()
+{
+  if (!in_store)
+    return;
+  in_store = false;
+  fingerprints = std::move(committed_fingerprints);
+  committed_fingerprints.clear();
+  if (sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr) != SQLITE_OK)
+    MERROR("Failed to roll back wallet cache store: " << sqlite3_errmsg(db));
+}
+
+bool wallet_cache_db::put(const crypto::chacha_key& key, std::string_view section, size_t page, std::string_view data)
+{
+  THROW_WALLET_EXCEPTION_IF(!in_store, error::wallet_internal_error, "No wallet cache store in progress");
+  auto it = fingerprints.find(section);
+  if (it == fingerprints.end())
+    it = fingerprints.emplace(section, std::vector<crypto::hash>{}).first;
+  auto& prints = it->second;
+  auto print = fingerprint(data);
+  if (page < prints.size() && prints[page] == print)
+    return false;
+
+  std::string blob(sizeof(crypto::chacha_iv) + data.size(), '\0');
+  auto iv = crypto::rand<crypto::chacha_iv>();
+  std::memcpy(blob.data(), &iv, sizeof(iv));
+  crypto::chacha20(data.data(), data.size(), key, iv, blob.data() + sizeof(iv));
+
+  statement insert{db, "INSERT OR REPLACE INTO pages (section, page, data) VALUES (?, ?, ?)"};
+  insert.bind(1, section);
+  insert.bind(2, page);
+  insert.bind_blob(3, blob);
+  THROW_WALLET_EXCEPTION_IF(sqlite3_step(insert.st) != SQLITE_DONE, error::wallet_internal_error,
+      "Failed to write wallet cache page: " + std::string(sqlite3_errmsg(db)));
+
+  if (page >= prints.size())
+    prints.resize(page + 1, crypto::null_hash);
+  prints[page] = print;
+  return true;
+}
+
+void wallet_cache_db::truncate(std::string_view section, size_t pages)
+{
+  THROW_WALLET_EXCEPTION_IF(!in_store, error::wallet_internal_error, "No wallet cache store in progress");
+  statement del{db, "DELETE FROM pages WHERE section = ? AND page >= ?"};
+  del.bind(1, section);
+  del.bind(2, pages);
+  THROW_WALLET_EXCEPTION_IF(sqlite3_step(del.st) != SQLITE_DONE, error::wallet_internal_error,
+      "Failed to truncate wallet cache section: " + std::string(sqlite3_errmsg(db)));
+  if (auto it = fingerprints.find(section); it != fingerprints.end() && it->second.size() > pages)
+    it->second.resize(pages);
+}
+
+}
@@ -0,0 +1,97 @@
+// Copyright (c) 2021, The Oxen Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "crypto/chacha.h"
+#include "crypto/hash.h"
+#include "common/fs.h"
+
+struct sqlite3;
+
+namespace tools
+{
+  // An SQLite database holding a wallet cache as separately encrypted pages, grouped into named
+  // sections.  It remembers what each page contained when last loaded or stored, so that storing
+  // the cache only writes the pages that changed; the writes of a store are a single transaction,
+  // so a crash leaves either the old or the new cache, never a mix.
+  class wallet_cache_db
+  {
+  public:
+    // Returns true if `filename` is an SQLite database (as opposed to an old, single blob wallet
+    // cache file)
+    static bool is_cache_db(const fs::path& filename);
+
+    // Opens the database, creating it if it doesn't exist.  Throws on error.
+    explicit wallet_cache_db(fs::path filename);
+    ~wallet_cache_db();
+    wallet_cache_db(const wallet_cache_db&) = delete;
+    wallet_cache_db& operator=(const wallet_cache_db&) = delete;
+
+    const fs::path& filename() const { return filename_; }
+
+    // Renames the database file, which must not be in the middle of a store.  Throws on error.
+    void rename(const fs::path& filename);
+
+    // Returns the decrypted pages of `section`, in order.  Throws if the section's pages are not
+    // numbered 0, 1, 2, ... or fail to decrypt.
+    std::vector<std::string> load(const crypto::chacha_key& key, std::string_view section);
+
+    // Number of pages `section` had when last loaded or stored
+    size_t pages(std::string_view section) const;
+
+    // Starts a store: put() and truncate() calls until the next commit() take effect together, or
+    // not at all after rollback().
+    void begin();
+    void commit();
+    void rollback();
+
+    // Writes page `page` of `section`, unless it is the same as it was when last loaded or stored.
+    // Returns true if the page was written.
+    bool put(const crypto::chacha_key& key, std::string_view section, size_t page, std::string_view data);
+
+    // Drops the pages of `section` from `pages` on
+    void truncate(std::string_view section, size_t pages);
+
+  private:
+    void exec(const char* sql);
+    void close();
+
+    fs::path filename_;
+    sqlite3* db = nullptr;
+    bool in_store = false;
+    // Fingerprints of the pages of each section as of the last load or store (and, during a store,
+    // as of the previous store, to restore on rollback)
+    std::map<std::string, std::vector<crypto::hash>, std::less<>> fingerprints, committed_fingerprints;
+  };
+}
@@ -39,6 +39,7 @@
 #include "wallet_rpc_server_error_codes.h"
 #include "wallet_rpc_server.h"
 #include "wallet/wallet_args.h"
+#include "wallet/wallet_scan_group.h"
 #include "common/command_line.h"
 #include "common/i18n.h"
 #include "common/signal_handler.h"
@@ -72,6 +73,7 @@ namespace
   const command_line::arg_descriptor<bool> arg_restricted = {"restricted-rpc", "Restricts to view-only commands", false};
   const command_line::arg_descriptor<std::string> arg_wallet_dir = {"wallet-dir", "Directory for newly created wallets"};
   const command_line::arg_descriptor<bool> arg_prompt_for_password = {"prompt-for-password", "Prompts for password when not provided", false};
+  const command_line::arg_descriptor<size_t> arg_max_resident_wallets = {"max-resident-wallets", "With --wallet-dir, keep up to this many opened wallets loaded and refreshed together; requests pick one with a \"wallet\" member naming its file, and the least recently used are stored and closed beyond this", 1};
 
   constexpr const char default_rpc_username[] = "oxen";
 
@@ -85,8 +87,9 @@ namespace
     return pwd_container;
   }
 
-  using rpc_func_data = std::pair<
+  using rpc_func_data = std::tuple<
     bool, // restricted
+    bool, // snapshot read
     std::string(*)( // function to invoke
       epee::serialization::portable_storage& ps,
       epee::serialization::storage_entry id,
@@ -105,6 +108,7 @@ namespace
         "Unable to register RPC command: wallet_rpc_server::invoke(Request) is not defined or does not return a Response");
     rpc_func_data invoke = {
       std::is_base_of_v<RESTRICTED, RPC>,
+      std::is_base_of_v<SNAPSHOT_READ, RPC>,
       []( epee::serialization::portable_storage& ps,
           epee::serialization::storage_entry id,
           std::optional<epee::serialization::storage_entry> params,
@@ -241,7 +245,7 @@ namespace tools
       }
       MDEBUG("Incoming JSON RPC request for " << method << " from " << get_remote_address(res));
 
-      const auto& [restricted, invoke_ptr] = it->second;
+      const auto& [restricted, snapshot_read, invoke_ptr] = it->second;
 
       // If it's a restricted command and we're in restricted mode then deny it
       if (restricted && m_restricted) {
@@ -255,10 +259,29 @@ namespace tools
       if (!ps.get_value("params", *params, nullptr))
         params.reset();
 
+      // With --max-resident-wallets the request can name the (already opened) wallet it is for
+      std::string wallet_name;
+      ps.get_value("wallet", wallet_name, nullptr);
+      const bool same_wallet = wallet_name.empty() || wallet_name == m_wallet_name;
+
+      // If a refresh has the wallet then commands that can make do with its last balance snapshot
+      // use that, and everything else has to wait.
+      std::unique_lock wallet_lock{m_wallet_mutex, std::try_to_lock};
+      if (!wallet_lock.owns_lock())
+      {
+        if (snapshot_read && same_wallet && m_wallet)
+          m_busy_snapshot = m_wallet->get_balance_snapshot();
+        if (!m_busy_snapshot)
+          wallet_lock.lock();
+      }
+      OXEN_DEFER { m_busy_snapshot.reset(); };
+
       std::string result;
       wallet_rpc_error json_error{-32603, "Internal error"};
 
       try {
+        if (!same_wallet)
+          select_wallet(wallet_name);
         result = invoke_ptr(ps, std::move(id), std::move(params), *this);
         json_error.code = 0;
       } catch (const parse_error& e) {
@@ -376,34 +399,34 @@ namespace tools
     if (m_wallet)
       start_long_poll_thread();
 
-    // Used to prevent queuing up multiple refreshes at once
-    std::atomic<bool> refreshing = false;
-
     // Now we just hang around and twiddle our thumbs until we're told to quit.  (And once in a
-    // while we inject a wallet refresh into the uWS loop).
+    // while we refresh the wallet: here rather than in the uWS thread, so that SNAPSHOT_READ
+    // requests don't have to wait for it).
     while (!m_stop.load(std::memory_order_relaxed))
     {
-      bool refresh_now = !refreshing && m_wallet && (
-          (m_auto_refresh_period > 0s && std::chrono::steady_clock::now() > m_last_auto_refresh_time + m_auto_refresh_period)
-          || m_long_poll_new_changes);
-
-      if (refresh_now)
       {
-        refreshing = true;
+        std::lock_guard lock{m_wallet_mutex};
+        bool refresh_now = (m_wallet || !m_resident_wallets.empty()) && (
+            (m_auto_refresh_period > 0s && std::chrono::steady_clock::now() > m_last_auto_refresh_time + m_auto_refresh_period)
+            || m_long_poll_new_changes);
 
-        // Queue the refresh to run in the uWS thread loop
-        loop_defer([this, &refreshing] {
+        if (refresh_now)
+        {
           m_long_poll_new_changes = false; // Always consume the change, if we miss one due to thread race, not the end of the world.
 
-          try {
-            if (m_wallet) m_wallet->refresh(m_wallet->is_trusted_daemon());
-          } catch (const std::exception& ex) {
-            LOG_ERROR("Exception while refreshing: " << ex.what());
+          if (m_resident_wallets.empty())
+          {
+            try {
+              m_wallet->refresh(m_wallet->is_trusted_daemon());
+            } catch (const std::exception& ex) {
+              LOG_ERROR("Exception while refreshing: " << ex.what());
+            }
           }
+          else
+            refresh_resident_wallets();
 
           m_last_auto_refresh_time = std::chrono::steady_clock::now();
-          refreshing = false;
-        });
+        }
       }
 
       std::this_thread::sleep_for(250ms);
@@ -426,6 +449,49 @@ namespace tools
       m_wallet->store();
     MGINFO("Wallet stopped.");
   }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::refresh_resident_wallets()
+  {
+    std::vector<wallet2*> wallets;
+    if (m_wallet)
+      wallets.push_back(m_wallet.get());
+    for (auto& r : m_resident_wallets)
+      wallets.push_back(r.wallet.get());
+
+    // Scan the new blocks for all of them at once, so that each block gets fetched from the daemon
+    // and parsed once rather than once per wallet.  Wallets the group can't take (or that fail in
+    // it) are left for their own refresh below.
+    wallet_scan_group group;
+    for (auto* w : wallets)
+    {
+      try {
+        group.add(*w);
+      } catch (const std::exception& e) {
+        MDEBUG("Refreshing " << w->get_wallet_file() << " on its own: " << e.what());
+      }
+    }
+    if (group.size() > 1)
+    {
+      try {
+        for (const auto& r : group.refresh(wallets.front()->is_trusted_daemon()))
+          if (r.error)
+            MWARNING("Shared refresh failed for " << r.wallet->get_wallet_file());
+      } catch (const std::exception& ex) {
+        LOG_ERROR("Exception while refreshing resident wallets: " << ex.what());
+      }
+    }
+
+    // Each wallet's own refresh then finds itself (almost) at the top already, and just updates its
+    // pool state and balance snapshot.
+    for (auto* w : wallets)
+    {
+      try {
+        w->refresh(w->is_trusted_daemon());
+      } catch (const std::exception& ex) {
+        LOG_ERROR("Exception while refreshing " << w->get_wallet_file() << ": " << ex.what());
+      }
+    }
+  }
   void wallet_rpc_server::start_long_poll_thread()
   {
     assert(m_wallet);
@@ -525,6 +591,18 @@ namespace tools
       }
     }
 
+    m_max_resident_wallets = command_line::get_arg(m_vm, arg_max_resident_wallets);
+    if (m_max_resident_wallets == 0)
+    {
+      MERROR(arg_max_resident_wallets.name << " must be at least 1");
+      return false;
+    }
+    if (m_max_resident_wallets > 1 && m_wallet_dir.empty())
+    {
+      MERROR(arg_max_resident_wallets.name << " requires " << arg_wallet_dir.name);
+      return false;
+    }
+
     if (disable_auth)
     {
       if (rpc_config.login)
@@ -598,35 +676,90 @@ namespace tools
       }
       m_wallet->deinit();
       m_wallet.reset();
+      m_wallet_name.clear();
       MINFO(tools::wallet_rpc_server::tr("Wallet closed"));
     }
   }
   //------------------------------------------------------------------------------------------------------------------------------
-  GET_BALANCE::response wallet_rpc_server::invoke(GET_BALANCE::request&& req)
+  void wallet_rpc_server::retire_current_wallet(bool save_current)
+  {
+    if (m_max_resident_wallets <= 1)
+      return close_wallet(save_current);
+
+    if (m_wallet)
+    {
+      stop_long_poll_thread();
+      m_resident_wallets.push_front({std::move(m_wallet_name), std::move(m_wallet)});
+      m_wallet_name.clear();
+    }
+    // Make room for the wallet about to become current
+    close_resident_wallets(m_max_resident_wallets - 1);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::close_resident_wallets(size_t keep)
+  {
+    while (m_resident_wallets.size() > keep)
+    {
+      auto& r = m_resident_wallets.back();
+      MDEBUG("Closing least recently used wallet " << r.name);
+      try {
+        r.wallet->store();
+      } catch (const std::exception& e) {
+        LOG_ERROR("Failed to store wallet " << r.name << ": " << e.what());
+      }
+      r.wallet->deinit();
+      m_resident_wallets.pop_back();
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  wallet2* wallet_rpc_server::find_resident_wallet(std::string_view name)
+  {
+    if (m_wallet && name == m_wallet_name)
+      return m_wallet.get();
+    for (auto& r : m_resident_wallets)
+      if (r.name == name)
+        return r.wallet.get();
+    return nullptr;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void wallet_rpc_server::select_wallet(std::string_view name)
+  {
+    if (m_wallet && name == m_wallet_name)
+      return;
+    auto it = std::find_if(m_resident_wallets.begin(), m_resident_wallets.end(), [&name](const auto& r) { return r.name == name; });
+    if (it == m_resident_wallets.end())
+      throw wallet_rpc_error{error_code::NOT_OPEN, "Wallet " + std::string{name} + " is not open"};
+    auto wal = std::move(it->wallet);
+    m_resident_wallets.erase(it);
+    retire_current_wallet(true);
+    m_wallet = std::move(wal);
+    m_wallet_name = name;
+    start_long_poll_thread();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  template <typename Wallet>
+  static GET_BALANCE::response get_balance(const Wallet& wallet, const GET_BALANCE::request& req)
   {
-    require_open();
     GET_BALANCE::response res{};
     {
-      res.balance = req.all_accounts ? m_wallet->balance_all(req.strict) : m_wallet->balance(req.account_index, req.strict);
-      res.unlocked_balance = req.all_accounts ? m_wallet->unlocked_balance_all(req.strict, &res.blocks_to_unlock, &res.time_to_unlock) : m_wallet->unlocked_balance(req.account_index, req.strict, &res.blocks_to_unlock, &res.time_to_unlock);
-      res.multisig_import_needed = m_wallet->multisig() && m_wallet->has_multisig_partial_key_images();
+      res.balance = req.all_accounts ? wallet.balance_all(req.strict) : wallet.balance(req.account_index, req.strict);
+      res.unlocked_balance = req.all_accounts ? wallet.unlocked_balance_all(req.strict, &res.blocks_to_unlock, &res.time_to_unlock) : wallet.unlocked_balance(req.account_index, req.strict, &res.blocks_to_unlock, &res.time_to_unlock);
+      res.multisig_import_needed = wallet.multisig() && wallet.has_multisig_partial_key_images();
       std::map<uint32_t, std::map<uint32_t, uint64_t>> balance_per_subaddress_per_account;
       std::map<uint32_t, std::map<uint32_t, std::pair<uint64_t, std::pair<uint64_t, uint64_t>>>> unlocked_balance_per_subaddress_per_account;
       if (req.all_accounts)
       {
-        for (uint32_t account_index = 0; account_index < m_wallet->get_num_subaddress_accounts(); ++account_index)
+        for (uint32_t account_index = 0; account_index < wallet.get_num_subaddress_accounts(); ++account_index)
         {
-          balance_per_subaddress_per_account[account_index] = m_wallet->balance_per_subaddress(account_index, req.strict);
-          unlocked_balance_per_subaddress_per_account[account_index] = m_wallet->unlocked_balance_per_subaddress(account_index, req.strict);
+          balance_per_subaddress_per_account[account_index] = wallet.balance_per_subaddress(account_index, req.strict);
+          unlocked_balance_per_subaddress_per_account[account_index] = wallet.unlocked_balance_per_subaddress(account_index, req.strict);
         }
       }
       else
       {
-        balance_per_subaddress_per_account[req.account_index] = m_wallet->balance_per_subaddress(req.account_index, req.strict);
-        unlocked_balance_per_subaddress_per_account[req.account_index] = m_wallet->unlocked_balance_per_subaddress(req.account_index, req.strict);
+        balance_per_subaddress_per_account[req.account_index] = wallet.balance_per_subaddress(req.account_index, req.strict);
+        unlocked_balance_per_subaddress_per_account[req.account_index] = wallet.unlocked_balance_per_subaddress(req.account_index, req.strict);
       }
-      std::vector<wallet::transfer_details> transfers;
-      m_wallet->get_transfers(transfers);
       for (const auto& p : balance_per_subaddress_per_account)
       {
         uint32_t account_index = p.first;
@@ -648,54 +781,66 @@ namespace tools
           info.account_index = account_index;
           info.address_index = i;
           cryptonote::subaddress_index index = {info.account_index, info.address_index};
-          info.address = m_wallet->get_subaddress_as_str(index);
+          info.address = wallet.get_subaddress_as_str(index);
           info.balance = balance_per_subaddress[i];
           info.unlocked_balance = unlocked_balance_per_subaddress[i].first;
           info.blocks_to_unlock = unlocked_balance_per_subaddress[i].second.first;
           info.time_to_unlock = unlocked_balance_per_subaddress[i].second.second;
-          info.label = m_wallet->get_subaddress_label(index);
-          info.num_unspent_outputs = std::count_if(transfers.begin(), transfers.end(), [&](const wallet::transfer_details& td) { return !td.m_spent && td.m_subaddr_index == index; });
+          info.label = wallet.get_subaddress_label(index);
+          info.num_unspent_outputs = wallet.get_num_unspent_outputs(index);
           res.per_subaddress.emplace_back(std::move(info));
         }
       }
     }
     return res;
   }
-  //------------------------------------------------------------------------------------------------------------------------------
-  GET_ADDRESS::response wallet_rpc_server::invoke(GET_ADDRESS::request&& req)
+  GET_BALANCE::response wallet_rpc_server::invoke(GET_BALANCE::request&& req)
   {
     require_open();
+    if (m_busy_snapshot)
+      return get_balance(*m_busy_snapshot, req);
+    return get_balance(*m_wallet, req);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  template <typename Wallet>
+  static GET_ADDRESS::response get_address(const Wallet& wallet, const GET_ADDRESS::request& req)
+  {
     GET_ADDRESS::response res{};
     {
-      THROW_WALLET_EXCEPTION_IF(req.account_index >= m_wallet->get_num_subaddress_accounts(), error::account_index_outofbound);
+      THROW_WALLET_EXCEPTION_IF(req.account_index >= wallet.get_num_subaddress_accounts(), error::account_index_outofbound);
       res.addresses.clear();
       std::vector<uint32_t> req_address_index;
       if (req.address_index.empty())
       {
-        for (uint32_t i = 0; i < m_wallet->get_num_subaddresses(req.account_index); ++i)
+        for (uint32_t i = 0; i < wallet.get_num_subaddresses(req.account_index); ++i)
           req_address_index.push_back(i);
       }
       else
       {
         req_address_index = req.address_index;
       }
-      tools::wallet2::transfer_container transfers;
-      m_wallet->get_transfers(transfers);
       for (uint32_t i : req_address_index)
       {
-        THROW_WALLET_EXCEPTION_IF(i >= m_wallet->get_num_subaddresses(req.account_index), error::address_index_outofbound);
+        THROW_WALLET_EXCEPTION_IF(i >= wallet.get_num_subaddresses(req.account_index), error::address_index_outofbound);
         res.addresses.resize(res.addresses.size() + 1);
         auto& info = res.addresses.back();
         const cryptonote::subaddress_index index = {req.account_index, i};
-        info.address = m_wallet->get_subaddress_as_str(index);
-        info.label = m_wallet->get_subaddress_label(index);
+        info.address = wallet.get_subaddress_as_str(index);
+        info.label = wallet.get_subaddress_label(index);
         info.address_index = index.minor;
-        info.used = std::find_if(transfers.begin(), transfers.end(), [&](const wallet::transfer_details& td) { return td.m_subaddr_index == index; }) != transfers.end();
+        info.used = wallet.is_subaddress_used(index);
       }
-      res.address = m_wallet->get_subaddress_as_str({req.account_index, 0});
+      res.address = wallet.get_subaddress_as_str({req.account_index, 0});
     }
     return res;
   }
+  GET_ADDRESS::response wallet_rpc_server::invoke(GET_ADDRESS::request&& req)
+  {
+    require_open();
+    if (m_busy_snapshot)
+      return get_address(*m_busy_snapshot, req);
+    return get_address(*m_wallet, req);
+  }
   //------------------------------------------------------------------------------------------------------------------------------
   GET_ADDRESS_INDEX::response wallet_rpc_server::invoke(GET_ADDRESS_INDEX::request&& req)
   {
@@ -859,6 +1004,12 @@ namespace tools
   {
     require_open();
     GET_HEIGHT::response res{};
+    if (m_busy_snapshot)
+    {
+      res.height           = m_busy_snapshot->get_blockchain_current_height();
+      res.immutable_height = m_busy_snapshot->get_immutable_height();
+    }
+    else
     {
       res.height           = m_wallet->get_blockchain_current_height();
       res.immutable_height = m_wallet->get_immutable_height();
@@ -2002,6 +2153,8 @@ namespace tools
     args.subaddr_indices  = req.subaddr_indices;
     args.account_index    = req.account_index;
     args.all_accounts     = req.all_accounts;
+    args.offset           = req.offset;
+    args.limit            = req.limit;
 
     std::vector<wallet::transfer_view> transfers;
     m_wallet->get_transfers(args, transfers);
@@ -2057,6 +2210,8 @@ namespace tools
     args.subaddr_indices = req.subaddr_indices;
     args.account_index = req.account_index;
     args.all_accounts = req.all_accounts;
+    args.offset = req.offset;
+    args.limit = req.limit;
 
     std::vector<wallet::transfer_view> transfers;
     m_wallet->get_transfers(args, transfers);
@@ -2475,8 +2630,9 @@ namespace {
     else
       wal->generate(wallet_file, req.password);
 
-    close_wallet(true);
+    retire_current_wallet(true);
     m_wallet = std::move(wal);
+    m_wallet_name = req.filename;
     return {};
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -2495,7 +2651,19 @@ namespace {
     if (ptr)
       throw wallet_rpc_error{error_code::UNKNOWN_ERROR, "Invalid filename"};
 
-    close_wallet(req.autosave_current);
+    // A resident wallet just becomes the current one again, without reloading it
+    if (m_max_resident_wallets > 1)
+    {
+      if (auto* resident = find_resident_wallet(req.filename))
+      {
+        if (!resident->verify_password(req.password))
+          throw wallet_rpc_error{error_code::INVALID_PASSWORD, "Invalid password."};
+        select_wallet(req.filename);
+        return {};
+      }
+    }
+
+    retire_current_wallet(req.autosave_current);
 
     fs::path wallet_file = m_wallet_dir / fs::u8path(req.filename);
     auto vm2 = password_arg_hack(req.password, m_vm);
@@ -2504,6 +2672,7 @@ namespace {
       throw wallet_rpc_error{error_code::UNKNOWN_ERROR, "Failed to open wallet"};
 
     m_wallet = std::move(wal);
+    m_wallet_name = req.filename;
     start_long_poll_thread();
 
     return {};
@@ -2573,7 +2742,7 @@ namespace {
     if (!viewkey_string.hex_to_pod(unwrap(unwrap(viewkey))))
       throw wallet_rpc_error{error_code::UNKNOWN_ERROR, "Failed to parse view key secret key"};
 
-    close_wallet(req.autosave_current);
+    retire_current_wallet(req.autosave_current);
 
     {
       if (!req.spendkey.empty())
@@ -2601,6 +2770,7 @@ namespace {
     wal->rewrite(wallet_file, password);
 
     m_wallet = std::move(wal);
+    m_wallet_name = req.filename;
     res.address = m_wallet->get_account().get_public_address_str(m_wallet->nettype());
     return res;
   }
@@ -2626,7 +2796,7 @@ namespace {
       if (!crypto::ElectrumWords::words_to_bytes(req.seed, recovery_key, old_language))
         throw wallet_rpc_error{error_code::UNKNOWN_ERROR, "Electrum-style word list failed verification"};
     }
-    close_wallet(req.autosave_current);
+    retire_current_wallet(req.autosave_current);
 
     // process seed_offset if given
     {
@@ -2688,6 +2858,7 @@ namespace {
     wal->rewrite(wallet_file, password);
 
     m_wallet = std::move(wal);
+    m_wallet_name = req.filename;
     res.address = m_wallet->get_account().get_public_address_str(m_wallet->nettype());
     res.info = "Wallet has been restored successfully.";
     return res;
@@ -3563,6 +3734,7 @@ namespace {
     try
     {
       close_wallet(true);
+      close_resident_wallets(0);
     }
     catch (const std::exception& e)
     {
@@ -3601,6 +3773,7 @@ int main(int argc, char **argv)
   command_line::add_arg(desc_params, arg_from_json);
   command_line::add_arg(desc_params, arg_wallet_dir);
   command_line::add_arg(desc_params, arg_prompt_for_password);
+  command_line::add_arg(desc_params, arg_max_resident_wallets);
 
   daemonizer::init_options(hidden_params, desc_params);
 
@@ -33,7 +33,9 @@
 
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
+#include <list>
 #include <string>
+#include <string_view>
 
 #include <uWebSockets/App.h>
 
@@ -180,6 +182,24 @@ namespace tools
       // Safely and cleanly closes the currently open wallet (if one is open)
       void close_wallet(bool save_current);
 
+      // Gets the current wallet out of the way of one about to be opened: with
+      // --max-resident-wallets it stays loaded (in m_resident_wallets, evicting the least recently
+      // used ones as needed), otherwise it gets closed.
+      void retire_current_wallet(bool save_current);
+
+      // Stores and closes the least recently used resident wallets until at most `keep` are left
+      void close_resident_wallets(size_t keep);
+
+      // Returns the open (current or resident) wallet with the given file name, or nullptr
+      wallet2* find_resident_wallet(std::string_view name);
+
+      // Makes the open wallet with the given file name the current one; throws a NOT_OPEN error if
+      // there isn't one.
+      void select_wallet(std::string_view name);
+
+      // Refreshes the current and resident wallets, scanning new blocks for all of them together
+      void refresh_resident_wallets();
+
       template<typename Ts, typename Tu>
       void fill_response(std::vector<tools::wallet2::pending_tx> &ptx_vector,
           bool get_tx_key, Ts& tx_key, Tu &amount, Tu &fee, std::string &multisig_txset, std::string &unsigned_txset, bool do_not_relay, bool blink,
@@ -210,6 +230,21 @@ namespace tools
       void stop_long_poll_thread();
 
       std::unique_ptr<wallet2> m_wallet;
+      std::string m_wallet_name; // File name (in m_wallet_dir) of m_wallet, if opened from there
+      struct resident_wallet
+      {
+        std::string name;
+        std::unique_ptr<wallet2> wallet;
+      };
+      // Opened wallets other than m_wallet, most recently used first; always empty unless
+      // m_max_resident_wallets > 1.
+      std::list<resident_wallet> m_resident_wallets;
+      size_t m_max_resident_wallets = 1;
+      // Held by whichever thread is using m_wallet (or the resident wallets): the uWS thread while handling a request, the
+      // main thread while refreshing.
+      std::mutex m_wallet_mutex;
+      // Set while handling a SNAPSHOT_READ request that found the wallet busy refreshing
+      std::shared_ptr<const wallet2::balance_snapshot> m_busy_snapshot;
       fs::path m_wallet_dir;
       std::vector<std::tuple<std::string /*ip*/, uint16_t /*port*/, bool /*required*/>> m_bind;
       tools::private_file rpc_login_file;
@@ -649,6 +649,8 @@ KV_SERIALIZE_MAP_CODE_BEGIN(GET_TRANSFERS::request)
   KV_SERIALIZE(account_index);
   KV_SERIALIZE(subaddr_indices);
   KV_SERIALIZE_OPT(all_accounts, false);
+  KV_SERIALIZE_OPT(offset, (uint64_t)0);
+  KV_SERIALIZE_OPT(limit, (uint64_t)0);
 KV_SERIALIZE_MAP_CODE_END()
 
 
@@ -69,6 +69,11 @@ namespace tools::wallet_rpc {
   /// restricted mode).
   struct RESTRICTED : RPC_COMMAND {};
 
+  /// Base class for read-only commands which, when a refresh is busy with the wallet, are answered
+  /// from the balance snapshot it last published (see wallet2::get_balance_snapshot()) instead of
+  /// waiting for the refresh to finish.  Use as `struct X : RPC_COMMAND, SNAPSHOT_READ`.
+  struct SNAPSHOT_READ {};
+
   /// Generic, serializable, no-argument request or response type, use as
   /// `struct request : EMPTY {};` or `using response = EMPTY;`
   struct EMPTY { KV_MAP_SERIALIZABLE };
@@ -88,7 +93,7 @@ namespace tools::wallet_rpc {
 
   OXEN_RPC_DOC_INTROSPECT
   // Return the wallet's balance.
-  struct GET_BALANCE : RPC_COMMAND
+  struct GET_BALANCE : RPC_COMMAND, SNAPSHOT_READ
   {
     static constexpr auto names() { return NAMES("get_balance", "getbalance"); }
 
@@ -132,7 +137,7 @@ namespace tools::wallet_rpc {
 
   OXEN_RPC_DOC_INTROSPECT
   // Return the wallet's addresses for an account. Optionally filter for specific set of subaddresses.
-  struct GET_ADDRESS : RPC_COMMAND
+  struct GET_ADDRESS : RPC_COMMAND, SNAPSHOT_READ
   {
     static constexpr auto names() { return NAMES("get_address", "getaddress"); }
 
@@ -379,7 +384,7 @@ namespace tools::wallet_rpc {
 
   OXEN_RPC_DOC_INTROSPECT
   // Returns the wallet's current block height and blockchain immutable height
-  struct GET_HEIGHT : RPC_COMMAND
+  struct GET_HEIGHT : RPC_COMMAND, SNAPSHOT_READ
   {
     static constexpr auto names() { return NAMES("get_height", "getheight"); }
 
@@ -1215,6 +1220,8 @@ namespace tools::wallet_rpc {
       uint32_t account_index;             // (Optional) Index of the account to query for transfers. (defaults to 0)
       std::set<uint32_t> subaddr_indices; // (Optional) List of subaddress indices to query for transfers. (defaults to 0)
       bool all_accounts;                  // If true, return transfers for all accounts, subaddr_indices and account_index are ignored
+      uint64_t offset;                    // (Optional) Number of matching transfers to skip, for fetching the transfers a page at a time. Transfers are ordered confirmed ones first by height, then unconfirmed ones.
+      uint64_t limit;                     // (Optional) Maximum number of transfers to return. (defaults to 0, for no limit)
 
       KV_MAP_SERIALIZABLE
     };
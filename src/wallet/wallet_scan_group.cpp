@@ -0,0 +1,169 @@
+// Copyright (c) 2021, The Oxen Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "wallet_scan_group.h"
+#include "wallet2.h"
+#include "block_prefetcher.h"
+
+#include <algorithm>
+#include <list>
+
+#undef OXEN_DEFAULT_LOG_CATEGORY
+#define OXEN_DEFAULT_LOG_CATEGORY "wallet.wallet2"
+
+namespace tools
+{
+
+void wallet_scan_group::add(wallet2& wallet)
+{
+  THROW_WALLET_EXCEPTION_IF(wallet.m_light_wallet, error::wallet_internal_error, "light wallets can't join a scan group");
+  THROW_WALLET_EXCEPTION_IF(wallet.m_offline, error::wallet_internal_error, "offline wallets can't join a scan group");
+  if (std::find(m_wallets.begin(), m_wallets.end(), &wallet) != m_wallets.end())
+    return;
+  if (!m_wallets.empty())
+  {
+    // The blocks are fetched for (and by) one of the wallets, so they have to agree on what to fetch
+    const wallet2& first = *m_wallets.front();
+    THROW_WALLET_EXCEPTION_IF(wallet.nettype() != first.nettype(), error::wallet_internal_error,
+        "wallet network differs from the scan group's");
+    THROW_WALLET_EXCEPTION_IF(wallet.m_refresh_type != first.m_refresh_type, error::wallet_internal_error,
+        "wallet refresh type differs from the scan group's");
+  }
+  m_wallets.push_back(&wallet);
+}
+
+void wallet_scan_group::remove(wallet2& wallet)
+{
+  m_wallets.erase(std::remove(m_wallets.begin(), m_wallets.end(), &wallet), m_wallets.end());
+}
+
+std::vector<wallet_scan_group::result> wallet_scan_group::refresh(bool trusted_daemon)
+{
+  std::vector<result> results;
+  results.reserve(m_wallets.size());
+  std::vector<crypto::hash> last_tx_hash_ids;
+  for (auto* w : m_wallets)
+  {
+    results.push_back({w});
+    last_tx_hash_ids.push_back(w->m_transfers.empty() ? crypto::null_hash : w->m_transfers.back().m_txid);
+  }
+
+  m_run.store(true, std::memory_order_relaxed);
+  auto running = [this] { return m_run.load(std::memory_order_relaxed); };
+
+  // Wallets that start scanning above their current height only need the hashes up to there,
+  // which we get for each separately as wallet2::refresh() would.
+  std::vector<size_t> active;
+  for (size_t i = 0; i < m_wallets.size() && running(); ++i)
+  {
+    wallet2& w = *m_wallets[i];
+    try
+    {
+      if (w.m_refresh_from_block_height > w.m_blockchain.size())
+      {
+        std::list<crypto::hash> short_chain_history;
+        w.get_refresh_short_chain_history(short_chain_history, trusted_daemon);
+        uint64_t blocks_start_height;
+        w.m_run.store(true, std::memory_order_relaxed);
+        w.fast_refresh(w.m_refresh_from_block_height, blocks_start_height, short_chain_history);
+      }
+      active.push_back(i);
+    }
+    catch (const std::exception& e)
+    {
+      MERROR("Scan group failed to fetch block hashes for a wallet: " << e.what());
+      results[i].error = std::current_exception();
+    }
+  }
+  if (active.empty() || !running())
+    return results;
+
+  wallet2& lead = *m_wallets[*std::min_element(active.begin(), active.end(), [this](size_t a, size_t b) {
+    return m_wallets[a]->m_blockchain.size() < m_wallets[b]->m_blockchain.size(); })];
+  std::list<crypto::hash> short_chain_history;
+  lead.get_refresh_short_chain_history(short_chain_history, trusted_daemon);
+
+  auto process = [&](uint64_t blocks_start_height, const std::vector<cryptonote::block_complete_entry>& blocks,
+      const std::vector<wallet2::parsed_block>& parsed_blocks) {
+    if (blocks.empty())
+      return;
+    const uint64_t end_height = blocks_start_height + blocks.size();
+    for (auto it = active.begin(); it != active.end(); )
+    {
+      wallet2& w = *m_wallets[*it];
+      // A wallet ahead of the lead has nothing to do unless the span reaches past (or forks off)
+      // what it already has.  Hashes below the hashchain offset are assumed not to change.
+      const auto& chain = w.m_blockchain;
+      if (chain.size() >= end_height && (end_height - 1 < chain.offset() || chain[end_height - 1] == parsed_blocks.back().hash))
+      {
+        ++it;
+        continue;
+      }
+      try
+      {
+        uint64_t added_blocks = 0;
+        w.process_parsed_blocks(blocks_start_height, blocks, parsed_blocks, added_blocks);
+        results[*it].blocks_fetched += added_blocks;
+        ++it;
+      }
+      catch (const std::exception& e)
+      {
+        MERROR("Scan group failed to process blocks " << blocks_start_height << "-" << end_height - 1 << " for a wallet: " << e.what());
+        results[*it].error = std::current_exception();
+        it = active.erase(it);
+      }
+    }
+  };
+
+  // As in wallet2::refresh(), the next spans are fetched and parsed while the wallets process the
+  // current one.
+  block_prefetcher prefetcher{lead, std::move(short_chain_history)};
+  while (running() && !active.empty())
+  {
+    auto span = prefetcher.next();
+    if (!span)
+      break;
+    process(span->start_height, span->blocks, span->parsed_blocks);
+  }
+
+  uint64_t immutable_height = 0;
+  const bool have_immutable_height = lead.m_node_rpc_proxy.get_immutable_height(immutable_height);
+  for (size_t i : active)
+  {
+    wallet2& w = *m_wallets[i];
+    results[i].received_money = last_tx_hash_ids[i] != (w.m_transfers.empty() ? crypto::null_hash : w.m_transfers.back().m_txid);
+    if (have_immutable_height)
+      w.m_immutable_height = immutable_height;
+    w.m_node_rpc_proxy.set_height(w.m_blockchain.size());
+    w.m_first_refresh_done = true;
+  }
+  return results;
+}
+
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2021, The Oxen Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <vector>
+
+namespace tools
+{
+  class wallet2;
+
+  // Refreshes many wallets (typically view-only wallets of different accounts, all kept up to date
+  // by one process) in a single pass over the chain: each span of blocks is fetched from the daemon
+  // and parsed once, and each wallet then only does what is specific to its keys (deriving the tx
+  // keys with its view key and matching the outputs against its subaddresses).
+  //
+  // The blocks are fetched through the wallet that is furthest behind, so its daemon connection is
+  // used for the whole group.  Wallets that are ahead skip the spans they already have.  Only the
+  // chain is scanned: the pool is left to each wallet (see wallet2::get_pool_state()).
+  //
+  // Not thread-safe; the wallets must not be used by anything else during refresh().
+  class wallet_scan_group
+  {
+  public:
+    struct result
+    {
+      wallet2* wallet;
+      uint64_t blocks_fetched = 0;
+      bool received_money = false;
+      // Set if scanning failed for this wallet, which was then left out of the rest of the pass;
+      // a wallet2::refresh() of its own will pick up from where it stopped.
+      std::exception_ptr error;
+    };
+
+    // Registers a wallet, which must outlive its registration.  Throws if the wallet is a light
+    // or offline wallet, or if its network or refresh type differs from the group's.
+    void add(wallet2& wallet);
+    // Does nothing if the wallet isn't registered
+    void remove(wallet2& wallet);
+    size_t size() const { return m_wallets.size(); }
+
+    // Brings all the registered wallets up to the daemon's height.  Returns a result for each
+    // wallet, in the order they were added.  Throws if the blocks couldn't be fetched.
+    std::vector<result> refresh(bool trusted_daemon);
+
+    // Makes a refresh() in progress stop after the current span of blocks
+    void stop() { m_run.store(false, std::memory_order_relaxed); }
+
+  private:
+    std::vector<wallet2*> m_wallets;
+    std::atomic<bool> m_run{false};
+  };
+}
@@ -186,14 +186,14 @@ oxen_chain_generator::oxen_chain_generator(std::vector<test_event_entry> &events
 
 service_nodes::quorum_manager oxen_chain_generator::top_quorum() const
 {
-  service_nodes::quorum_manager result = top().service_node_state.quorums;
+  service_nodes::quorum_manager result = top().service_node_state.get_quorums();
   return result;
 }
 
 service_nodes::quorum_manager oxen_chain_generator::quorum(uint64_t height) const
 {
   assert(height > 0 && height < db_.blocks.size());
-  service_nodes::quorum_manager result = db_.blocks[height].service_node_state.quorums;
+  service_nodes::quorum_manager result = db_.blocks[height].service_node_state.get_quorums();
   return result;
 }
 
@@ -207,7 +207,7 @@ std::shared_ptr<const service_nodes::quorum> oxen_chain_generator::get_quorum(se
   }
 
   assert(height > 0 && height < db_.blocks.size());
-  service_nodes::quorum_manager manager = db_.blocks[height].service_node_state.quorums;
+  service_nodes::quorum_manager manager = db_.blocks[height].service_node_state.get_quorums();
   std::shared_ptr<const service_nodes::quorum> result = manager.get(type);
   return result;
 }
@@ -33,6 +33,7 @@
 #include <iomanip>
 #include <ios>
 #include <string>
+#include <vector>
 #include <cfenv>
 
 #include "epee/misc_log_ex.h"
@@ -132,6 +133,10 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
+  // The heavy hashes also get checked all at once through cn_slow_hash_multi
+  std::vector<std::vector<char>> multi_inputs;
+  std::vector<chash> multi_expected;
+
   input.open(argv[2], std::ios_base::in);
   for (;;) {
     ++test;
@@ -162,8 +167,8 @@ int main(int argc, char *argv[]) {
       case hash_type::extra_groestl:   hash_extra_groestl(buf, len, actual_byte_ptr); break;
       case hash_type::extra_jh:        hash_extra_jh     (buf, len, actual_byte_ptr); break;
       case hash_type::extra_skein:     hash_extra_skein  (buf, len, actual_byte_ptr); break;
-      case hash_type::heavy_v1:        cn_slow_hash      (buf, len, actual, cn_slow_hash_type::heavy_v1); break;
-      case hash_type::heavy_v2:        cn_slow_hash      (buf, len, actual, cn_slow_hash_type::heavy_v2); break;
+      case hash_type::heavy_v1:        cn_slow_hash      (buf, len, actual, cn_slow_hash_type::heavy_v1); multi_inputs.push_back(data); multi_expected.push_back(expected); break;
+      case hash_type::heavy_v2:        cn_slow_hash      (buf, len, actual, cn_slow_hash_type::heavy_v2); multi_inputs.push_back(data); multi_expected.push_back(expected); break;
       case hash_type::turtle_light_v2: cn_slow_hash      (buf, len, actual, cn_slow_hash_type::turtle_lite_v2); break;
 
       default:
@@ -195,6 +200,23 @@ int main(int argc, char *argv[]) {
       error = true;
     }
   }
+
+  if (!multi_inputs.empty())
+  {
+    std::vector<std::string_view> views;
+    for (auto &data : multi_inputs)
+      views.emplace_back(data.data(), data.size());
+    std::vector<chash> actual(views.size());
+    cn_slow_hash_multi(views.data(), actual.data(), views.size(), type == hash_type::heavy_v1 ? cn_slow_hash_type::heavy_v1 : cn_slow_hash_type::heavy_v2);
+    for (size_t i = 0; i < actual.size(); i++)
+    {
+      if (actual[i] != multi_expected[i])
+      {
+        cerr << "Hash mismatch on test " << (i + 1) << " with cn_slow_hash_multi" << endl;
+        error = true;
+      }
+    }
+  }
   return error ? 1 : 0;
   CATCH_ENTRY_L0("main", 1);
 }
@@ -61,6 +61,34 @@ private:
   rct::Bulletproof proof;
 };
 
+// Proving time alone for a bulletproof over n_amounts outputs (the amounts and masks are drawn
+// beforehand), as a wallet pays for each tx it constructs
+template<size_t n_amounts>
+class test_bulletproof_prove
+{
+public:
+  static const size_t loop_count = n_amounts >= 8 ? 10 : 40 / n_amounts;
+
+  bool init()
+  {
+    amounts.resize(n_amounts);
+    for (size_t i = 0; i < n_amounts; ++i)
+      amounts[i] = 749327532984 + i;
+    masks = rct::skvGen(n_amounts);
+    return true;
+  }
+
+  bool test()
+  {
+    const rct::Bulletproof proof = rct::bulletproof_PROVE(amounts, masks);
+    return proof.V.size() == n_amounts;
+  }
+
+private:
+  std::vector<uint64_t> amounts;
+  rct::keyV masks;
+};
+
 template<bool batch, size_t start, size_t repeat, size_t mul, size_t add, size_t N>
 class test_aggregated_bulletproof
 {
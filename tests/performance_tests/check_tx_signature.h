@@ -173,7 +173,23 @@ public:
     return rct::verRctSemanticsSimple(rvv);
   }
 
-private:
+protected:
   cryptonote::account_base m_alice;
   std::vector<cryptonote::transaction> m_txes;
 };
+
+// As above, but with the CLSAGs verified as one batch (spread over the threadpool) the way a block's
+// txes are, rather than one tx at a time.
+template<size_t a_ring_size, size_t a_outputs, size_t a_num_txes>
+class test_check_tx_signature_batch : public test_check_tx_signature_aggregated_bulletproofs<a_ring_size, a_outputs, a_num_txes>
+{
+public:
+  bool test()
+  {
+    std::vector<const rct::rctSig*> rvv;
+    rvv.reserve(this->m_txes.size());
+    for (const auto& tx : this->m_txes)
+      rvv.push_back(&tx.rct_signatures);
+    return rct::verRctNonSemanticsSimple(rvv) && rct::verRctSemanticsSimple(rvv);
+  }
+};
@@ -66,7 +66,27 @@ public:
     return hash == m_expected_hash;
   }
 
-private:
+protected:
   data_t m_data;
   crypto::hash m_expected_hash;
 };
+
+class test_cn_slow_hash_multi : public test_cn_slow_hash
+{
+public:
+  static const size_t loop_count = 10;
+  static const size_t count = cn_heavy_hash_v2::MAX_LANES;
+
+  bool test()
+  {
+    std::string_view data[count];
+    for (auto &d : data)
+      d = {m_data.data, sizeof(m_data.data)};
+    crypto::hash hashes[count];
+    crypto::cn_slow_hash_multi(data, hashes, count, crypto::cn_slow_hash_type::heavy_v1);
+    for (auto &h : hashes)
+      if (h != m_expected_hash)
+        return false;
+    return true;
+  }
+};
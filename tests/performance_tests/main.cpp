@@ -58,6 +58,7 @@
 #include "crypto_ops.h"
 #include "multiexp.h"
 #include "sig_clsag.h"
+#include "parse_from_blob.h"
 
 namespace po = boost::program_options;
 
@@ -76,11 +77,17 @@ int main(int argc, char** argv)
   const command_line::arg_descriptor<bool> arg_stats = { "stats", "Including statistics (min/median)", false };
   const command_line::arg_descriptor<unsigned> arg_loop_multiplier = { "loop-multiplier", "Run for that many times more loops", 1 };
   const command_line::arg_descriptor<std::string> arg_timings_database = { "timings-database", "Keep timings history in a file" };
+  const command_line::arg_descriptor<std::string> arg_json = { "json", "Write per-test statistics to this file as JSON (implies --stats)" };
+  const command_line::arg_descriptor<std::string> arg_baseline = { "baseline", "Compare against the results in this --json file and exit with an error if any test got significantly slower (implies --stats)" };
+  const command_line::arg_descriptor<double> arg_regression_threshold = { "regression-threshold", "Smallest median slowdown, in percent, that --baseline treats as a regression", 5.0 };
   command_line::add_arg(desc_options, arg_filter);
   command_line::add_arg(desc_options, arg_verbose);
   command_line::add_arg(desc_options, arg_stats);
   command_line::add_arg(desc_options, arg_loop_multiplier);
   command_line::add_arg(desc_options, arg_timings_database);
+  command_line::add_arg(desc_options, arg_json);
+  command_line::add_arg(desc_options, arg_baseline);
+  command_line::add_arg(desc_options, arg_regression_threshold);
 
   po::variables_map vm;
   bool r = command_line::handle_error_helper(desc_options, [&]()
@@ -101,6 +108,17 @@ int main(int argc, char** argv)
   p.stats = command_line::get_arg(vm, arg_stats);
   p.loop_multiplier = command_line::get_arg(vm, arg_loop_multiplier);
 
+  const std::string json = command_line::get_arg(vm, arg_json);
+  const std::string baseline_file = command_line::get_arg(vm, arg_baseline);
+  perf_results baseline;
+  if (!baseline_file.empty() && !load_results(baseline_file, baseline))
+  {
+    std::cerr << "Failed to load baseline results from " << baseline_file << std::endl;
+    return 1;
+  }
+  if (!json.empty() || !baseline_file.empty())
+    p.stats = true;
+
   auto started = std::chrono::steady_clock::now();
 
   TEST_PERFORMANCE3(filter, p, test_construct_tx, 1, 1, false);
@@ -178,6 +196,12 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE4(filter, p, test_check_tx_signature_aggregated_bulletproofs, 2, 2, 56, 16);
   TEST_PERFORMANCE4(filter, p, test_check_tx_signature_aggregated_bulletproofs, 10, 2, 56, 16);
 
+  TEST_PERFORMANCE3(filter, p, test_check_tx_signature_batch, 11, 2, 1); // batched CLSAG verification
+  TEST_PERFORMANCE3(filter, p, test_check_tx_signature_batch, 11, 2, 16);
+  TEST_PERFORMANCE3(filter, p, test_check_tx_signature_batch, 11, 2, 64);
+  TEST_PERFORMANCE3(filter, p, test_check_tx_signature_aggregated_bulletproofs, 11, 2, 16); // the same, unbatched
+  TEST_PERFORMANCE3(filter, p, test_check_tx_signature_aggregated_bulletproofs, 11, 2, 64);
+
   TEST_PERFORMANCE0(filter, p, test_is_out_to_acc);
   TEST_PERFORMANCE0(filter, p, test_is_out_to_acc_precomp);
   TEST_PERFORMANCE0(filter, p, test_generate_key_image_helper);
@@ -196,12 +220,22 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE2(filter, p, test_wallet2_expand_subaddresses, 50, 200);
 
   TEST_PERFORMANCE0(filter, p, test_cn_slow_hash);
+  TEST_PERFORMANCE0(filter, p, test_cn_slow_hash_multi);
   TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 32);
   TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 16384);
 
+  TEST_PERFORMANCE2(filter, p, test_parse_tx_from_blob, 10, 2);
+  TEST_PERFORMANCE2(filter, p, test_parse_tx_from_blob, 10, 16);
+  TEST_PERFORMANCE2(filter, p, test_serialize_tx_to_blob, 10, 2);
+  TEST_PERFORMANCE2(filter, p, test_serialize_tx_to_blob, 10, 16);
+  TEST_PERFORMANCE1(filter, p, test_parse_block_from_blob, 0);
+  TEST_PERFORMANCE1(filter, p, test_parse_block_from_blob, 100);
+
   TEST_PERFORMANCE3(filter, p, test_sig_clsag, 4, 2, 2); // CLSAG verification
   TEST_PERFORMANCE3(filter, p, test_sig_clsag, 8, 2, 2);
+  TEST_PERFORMANCE3(filter, p, test_sig_clsag, 10, 2, 2);
   TEST_PERFORMANCE3(filter, p, test_sig_clsag, 16, 2, 2);
+  TEST_PERFORMANCE3(filter, p, test_sig_clsag, 17, 2, 2);
   TEST_PERFORMANCE3(filter, p, test_sig_clsag, 32, 2, 2);
   TEST_PERFORMANCE3(filter, p, test_sig_clsag, 64, 2, 2);
   TEST_PERFORMANCE3(filter, p, test_sig_clsag, 128, 2, 2);
@@ -221,6 +255,12 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE2(filter, p, test_bulletproof, true, 15); // 1 bulletproof with 15 amounts
   TEST_PERFORMANCE2(filter, p, test_bulletproof, false, 15);
 
+  TEST_PERFORMANCE1(filter, p, test_bulletproof_prove, 1); // proving time per number of outputs
+  TEST_PERFORMANCE1(filter, p, test_bulletproof_prove, 2);
+  TEST_PERFORMANCE1(filter, p, test_bulletproof_prove, 4);
+  TEST_PERFORMANCE1(filter, p, test_bulletproof_prove, 8);
+  TEST_PERFORMANCE1(filter, p, test_bulletproof_prove, 16);
+
   TEST_PERFORMANCE6(filter, p, test_aggregated_bulletproof, false, 2, 1, 1, 0, 4);
   TEST_PERFORMANCE6(filter, p, test_aggregated_bulletproof, true, 2, 1, 1, 0, 4); // 4 proofs, each with 2 amounts
   TEST_PERFORMANCE6(filter, p, test_aggregated_bulletproof, false, 8, 1, 1, 0, 4);
@@ -231,6 +271,12 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE6(filter, p, test_aggregated_bulletproof, true, 1, 8, 1, 1, 4); // 32 proofs, with 1, 2, 3, 4 amounts, 8 of each
   TEST_PERFORMANCE6(filter, p, test_aggregated_bulletproof, false, 2, 1, 1, 0, 64);
   TEST_PERFORMANCE6(filter, p, test_aggregated_bulletproof, true, 2, 1, 1, 0, 64); // 64 proof, each with 2 amounts
+  TEST_PERFORMANCE6(filter, p, test_aggregated_bulletproof, true, 2, 1, 1, 0, 1); // batch verification of 1..128 proofs, each with 2 amounts
+  TEST_PERFORMANCE6(filter, p, test_aggregated_bulletproof, true, 2, 1, 1, 0, 2);
+  TEST_PERFORMANCE6(filter, p, test_aggregated_bulletproof, true, 2, 1, 1, 0, 8);
+  TEST_PERFORMANCE6(filter, p, test_aggregated_bulletproof, true, 2, 1, 1, 0, 16);
+  TEST_PERFORMANCE6(filter, p, test_aggregated_bulletproof, true, 2, 1, 1, 0, 32);
+  TEST_PERFORMANCE6(filter, p, test_aggregated_bulletproof, true, 2, 1, 1, 0, 128);
 
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_sc_add);
   TEST_PERFORMANCE1(filter, p, test_crypto_ops, op_sc_sub);
@@ -542,8 +588,26 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE3(filter, p, test_multiexp, multiexp_pippenger, 4096, 9);
 #endif
 
+  // batch bulletproof verification multiexps (Gi/Hi generators followed by the proofs' points) at
+  // various Gi/Hi cache sizes
+  TEST_PERFORMANCE2(filter, p, test_multiexp_partial_cache, 320, 0);
+  TEST_PERFORMANCE2(filter, p, test_multiexp_partial_cache, 320, 128);
+  TEST_PERFORMANCE2(filter, p, test_multiexp_partial_cache, 320, 256);
+  TEST_PERFORMANCE2(filter, p, test_multiexp_partial_cache, 2304, 0);
+  TEST_PERFORMANCE2(filter, p, test_multiexp_partial_cache, 2304, 512);
+  TEST_PERFORMANCE2(filter, p, test_multiexp_partial_cache, 2304, 1024);
+  TEST_PERFORMANCE2(filter, p, test_multiexp_partial_cache, 2304, 2048);
+
   std::cout << "Tests finished. Elapsed time: " << elapsed_str(std::chrono::steady_clock::now() - started) << std::endl;
 
+  if (!json.empty() && !save_results(json, p.results))
+  {
+    std::cerr << "Failed to write results to " << json << std::endl;
+    return 1;
+  }
+  if (!baseline_file.empty() && compare_results(baseline, p.results, command_line::get_arg(vm, arg_regression_threshold)) > 0)
+    return 2;
+
   return 0;
   CATCH_ENTRY_L0("main", 1);
 }
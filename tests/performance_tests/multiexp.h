@@ -92,3 +92,40 @@ private:
   std::shared_ptr<rct::pippenger_cached_data> pippenger_cache;
   rct::key res;
 };
+
+// Pippenger over npoints points of which only the first cached_points have precomputed forms, as in
+// batch bulletproof verification when the Gi/Hi cache (--bp-cache-mb) doesn't cover the batch.
+template<size_t npoints, size_t cached_points>
+class test_multiexp_partial_cache
+{
+public:
+  static const size_t loop_count = npoints >= 1024 ? 10 : npoints < 256 ? 1000 : 100;
+
+  bool init()
+  {
+    data.resize(npoints);
+    res = rct::identity();
+    for (size_t n = 0; n < npoints; ++n)
+    {
+      data[n].scalar = rct::skGen();
+      rct::key point = rct::scalarmultBase(rct::skGen());
+      if (ge_frombytes_vartime(&data[n].point, point.bytes))
+        return false;
+      rct::key kn = rct::scalarmultKey(point, data[n].scalar);
+      res = rct::addKeys(res, kn);
+    }
+    if (cached_points > 0)
+      cache = rct::pippenger_init_cache(data, 0, cached_points);
+    return true;
+  }
+
+  bool test()
+  {
+    return res == pippenger(data, cache, cached_points);
+  }
+
+private:
+  std::vector<rct::MultiexpData> data;
+  std::shared_ptr<rct::pippenger_cached_data> cache;
+  rct::key res;
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vector>
+
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_basic.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_tx_utils.h"
+#include "crypto/crypto.h"
+
+#include "multi_tx_test_base.h"
+#include "single_tx_test_base.h"
+
+// Parse throughput of the binary unarchiver, via the parse_and_validate_*_from_blob helpers.  Use
+// with --timings-database to compare runs across builds.
+
+template<size_t a_ring_size, size_t a_outputs>
+class test_parse_tx_from_blob : private multi_tx_test_base<a_ring_size>
+{
+  static_assert(0 < a_ring_size, "ring_size must be greater than 0");
+  static_assert(0 < a_outputs, "outputs must be greater than 0");
+
+public:
+  static const size_t loop_count = 10000;
+
+  typedef multi_tx_test_base<a_ring_size> base_class;
+
+  bool init()
+  {
+    using namespace cryptonote;
+
+    if (!base_class::init())
+      return false;
+
+    m_alice.generate();
+
+    std::vector<tx_destination_entry> destinations;
+    destinations.push_back(tx_destination_entry(this->m_source_amount - a_outputs + 1, m_alice.get_keys().m_account_address, false));
+    for (size_t n = 1; n < a_outputs; ++n)
+      destinations.push_back(tx_destination_entry(1, m_alice.get_keys().m_account_address, false));
+
+    crypto::secret_key tx_key;
+    std::vector<crypto::secret_key> additional_tx_keys;
+    std::unordered_map<crypto::public_key, cryptonote::subaddress_index> subaddresses;
+    subaddresses[this->m_miners[this->real_source_idx].get_keys().m_account_address.m_spend_public_key] = {0,0};
+    oxen_construct_tx_params tx_params;
+    tx_params.hf_version = cryptonote::network_version_count - 1;
+    rct::RCTConfig rct_config{rct::RangeProofType::PaddedBulletproof, 2};
+    transaction tx;
+    if (!construct_tx_and_get_tx_key(this->m_miners[this->real_source_idx].get_keys(), subaddresses, this->m_sources, destinations, cryptonote::tx_destination_entry{}, std::vector<uint8_t>(), tx, 0, tx_key, additional_tx_keys, rct_config, nullptr, tx_params))
+      return false;
+
+    m_blob = tx_to_blob(tx);
+    return true;
+  }
+
+  bool test()
+  {
+    cryptonote::transaction tx;
+    return cryptonote::parse_and_validate_tx_from_blob(m_blob, tx);
+  }
+
+protected:
+  cryptonote::account_base m_alice;
+  cryptonote::blobdata m_blob;
+};
+
+template<size_t a_ring_size, size_t a_outputs>
+class test_serialize_tx_to_blob : public test_parse_tx_from_blob<a_ring_size, a_outputs>
+{
+public:
+  bool init()
+  {
+    return test_parse_tx_from_blob<a_ring_size, a_outputs>::init() &&
+      cryptonote::parse_and_validate_tx_from_blob(this->m_blob, m_tx);
+  }
+
+  bool test()
+  {
+    cryptonote::blobdata blob;
+    return cryptonote::tx_to_blob(m_tx, blob) && blob.size() == this->m_blob.size();
+  }
+
+private:
+  cryptonote::transaction m_tx;
+};
+
+template<size_t a_txes>
+class test_parse_block_from_blob : private single_tx_test_base
+{
+public:
+  static const size_t loop_count = 10000;
+
+  bool init()
+  {
+    if (!single_tx_test_base::init())
+      return false;
+
+    cryptonote::block b{};
+    b.major_version = cryptonote::network_version_count - 1;
+    b.miner_tx = m_tx;
+    b.tx_hashes.resize(a_txes);
+    for (auto& h : b.tx_hashes)
+      crypto::rand(sizeof(h), reinterpret_cast<uint8_t*>(h.data));
+
+    m_blob = cryptonote::block_to_blob(b);
+    return true;
+  }
+
+  bool test()
+  {
+    cryptonote::block b;
+    return cryptonote::parse_and_validate_block_from_blob(m_blob, b);
+  }
+
+private:
+  cryptonote::blobdata m_blob;
+};
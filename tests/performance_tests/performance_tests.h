@@ -35,11 +35,13 @@
 #include <cstdint>
 #include <regex>
 #include <chrono>
+#include <algorithm>
 
 #include "epee/misc_language.h"
 #include "epee/stats.h"
 #include "common/perf_timer.h"
 #include "timings.h"
+#include "results.h"
 
 struct Params
 {
@@ -47,6 +49,7 @@ struct Params
   bool verbose;
   bool stats;
   unsigned loop_multiplier;
+  perf_results results; // per-test statistics of this run (when `stats` is set), for --json/--baseline
 };
 
 using namespace std::literals;
@@ -109,6 +112,23 @@ public:
   double get_non_parametric_skew() const { return m_stats->get_non_parametric_skew(); }
   std::vector<double> get_quantiles(size_t n) const { return m_stats->get_quantiles(n); }
 
+  // Median absolute deviation of the per-call times from their median
+  double get_mad() const
+  {
+    const double med = get_median();
+    std::vector<double> dev;
+    dev.reserve(m_per_call_timers.size());
+    for (const auto& t : m_per_call_timers)
+      dev.push_back(std::abs(static_cast<double>(static_cast<uint64_t>(t)) - med));
+    if (dev.empty())
+      return 0;
+    auto mid = dev.begin() + dev.size() / 2;
+    std::nth_element(dev.begin(), mid, dev.end());
+    if (dev.size() % 2)
+      return *mid;
+    return (*mid + *std::max_element(dev.begin(), mid)) / 2;
+  }
+
   bool is_same_distribution(size_t npoints, double mean, double stddev) const
   {
     return m_stats->is_same_distribution_99(npoints, mean, stddev);
@@ -170,10 +190,10 @@ void run_test(const std::string &filter, Params &params, const char* test_name)
       std::cout << "  elapsed:       " << elapsed_str(runner.elapsed_time()) << '\n';
       if (params.stats)
       {
-        std::cout << "  min:       " << elapsed_str(runner.get_min()) << '\n';
-        std::cout << "  max:       " << elapsed_str(runner.get_max()) << '\n';
-        std::cout << "  median:    " << elapsed_str(runner.get_median()) << '\n';
-        std::cout << "  std dev:   " << elapsed_str(runner.get_stddev()) << '\n';
+        std::cout << "  min:       " << elapsed_str(runner.get_min() / 1e9) << '\n';
+        std::cout << "  max:       " << elapsed_str(runner.get_max() / 1e9) << '\n';
+        std::cout << "  median:    " << elapsed_str(runner.get_median() / 1e9) << '\n';
+        std::cout << "  std dev:   " << elapsed_str(runner.get_stddev() / 1e9) << '\n';
       }
     }
     else
@@ -205,8 +225,12 @@ void run_test(const std::string &filter, Params &params, const char* test_name)
         }
         cmp += "  -- " + std::to_string(prev_instance.mean);
       }
-      std::cout << " (min " << elapsed_str(min) << ", 90th " << elapsed_str(quantiles[9]) <<
-        ", median " << elapsed_str(med) << ", std dev " << elapsed_str(stddev) << ")" << cmp;
+      std::cout << " (min " << elapsed_str(min / 1e9) << ", 90th " << elapsed_str(quantiles[9] / 1e9) <<
+        ", median " << elapsed_str(med / 1e9) << ", std dev " << elapsed_str(stddev / 1e9) << ")" << cmp;
+
+      const auto percentiles = runner.get_quantiles(100);
+      params.results.results.push_back({test_name, runner.get_size(), mean, med, runner.get_mad(), stddev,
+          min, max, percentiles[10], percentiles[90], percentiles[99]});
     }
     std::cout << std::endl;
   }
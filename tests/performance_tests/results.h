@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "epee/serialization/keyvalue_serialization.h"
+#include "epee/storages/portable_storage_template_helper.h"
+#include "common/file.h"
+
+// Machine-readable results of a run (written with --json) and the comparison of a run against the
+// results of an earlier one (--baseline), for gating changes on performance regressions.
+
+struct perf_result
+{
+  std::string name;
+  uint64_t calls;                // timed calls the statistics are over
+  double mean_ns, median_ns;
+  double mad_ns;                 // median absolute deviation from the median
+  double stddev_ns, min_ns, max_ns;
+  double p10_ns, p90_ns, p99_ns;
+
+  BEGIN_KV_SERIALIZE_MAP()
+    KV_SERIALIZE(name)
+    KV_SERIALIZE(calls)
+    KV_SERIALIZE(mean_ns)
+    KV_SERIALIZE(median_ns)
+    KV_SERIALIZE(mad_ns)
+    KV_SERIALIZE(stddev_ns)
+    KV_SERIALIZE(min_ns)
+    KV_SERIALIZE(max_ns)
+    KV_SERIALIZE(p10_ns)
+    KV_SERIALIZE(p90_ns)
+    KV_SERIALIZE(p99_ns)
+  END_KV_SERIALIZE_MAP()
+};
+
+struct perf_results
+{
+  std::vector<perf_result> results;
+
+  BEGIN_KV_SERIALIZE_MAP()
+    KV_SERIALIZE(results)
+  END_KV_SERIALIZE_MAP()
+};
+
+inline bool save_results(const std::string& filename, perf_results& results)
+{
+  std::string json;
+  return epee::serialization::store_t_to_json(results, json) && tools::dump_file(filename, json);
+}
+
+inline bool load_results(const std::string& filename, perf_results& results)
+{
+  std::string json;
+  return tools::slurp_file(filename, json) && epee::serialization::load_t_from_json(results, json);
+}
+
+// How many standard errors apart two medians are.  The standard error of a median is taken as
+// 1.2533 sigma / sqrt(n), with sigma estimated from the MAD (1.4826 MAD for normal data), which
+// unlike the mean and standard deviation isn't thrown off by the odd call that got descheduled.
+inline double median_z(const perf_result& base, const perf_result& cur)
+{
+  const double k = 1.2533 * 1.4826;
+  const double se = k * std::sqrt(base.mad_ns * base.mad_ns / std::max<uint64_t>(1, base.calls)
+      + cur.mad_ns * cur.mad_ns / std::max<uint64_t>(1, cur.calls));
+  const double diff = cur.median_ns - base.median_ns;
+  if (se == 0)
+    return diff == 0 ? 0 : std::copysign(INFINITY, diff);
+  return diff / se;
+}
+
+// Prints how each test of `current` compares to the same test in `baseline`, and returns the number
+// of regressions: tests whose median got slower by more than `threshold_pct` percent with the
+// difference more than 3 standard errors (about 99.9% confidence, one-sided) from no change.
+inline size_t compare_results(const perf_results& baseline, const perf_results& current, double threshold_pct)
+{
+  std::map<std::string, const perf_result*> base;
+  for (const auto& r : baseline.results)
+    base[r.name] = &r;
+
+  size_t regressions = 0;
+  std::cout << "\nComparison with baseline (medians):\n";
+  for (const auto& cur : current.results)
+  {
+    auto it = base.find(cur.name);
+    if (it == base.end())
+    {
+      std::cout << "  " << cur.name << ": not in baseline\n";
+      continue;
+    }
+    const perf_result& b = *it->second;
+    const double change_pct = b.median_ns > 0 ? 100. * (cur.median_ns - b.median_ns) / b.median_ns : 0;
+    const double z = median_z(b, cur);
+    const bool significant = std::abs(z) > 3 && std::abs(change_pct) > threshold_pct;
+    const bool regression = significant && change_pct > 0;
+    if (regression)
+      ++regressions;
+    std::cout << "  " << cur.name << ": " << std::fixed << std::setprecision(0) << b.median_ns << "ns -> "
+      << cur.median_ns << "ns (" << std::showpos << std::setprecision(1) << change_pct << "%" << std::noshowpos << ")"
+      << (regression ? "  SLOWER" : significant ? "  faster" : "") << "\n";
+  }
+  std::cout << std::defaultfloat;
+  if (regressions)
+    std::cout << regressions << " test(s) regressed by more than " << threshold_pct << "%\n";
+  return regressions;
+}
@@ -0,0 +1,450 @@
+// Load generator for the daemon's RPC interfaces: replays a weighted mix of RPC commands against the
+// HTTP RPC server or the OMQ RPC endpoint at a fixed target rate (open loop: requests are scheduled
+// by the clock, not by when the previous reply came back, so a slow server shows up as latency
+// rather than as a lower request rate) and reports latency percentiles per command.
+//
+// Example, a few hundred wallets refreshing against a local node:
+//
+//     rpc_load_tests --http http://127.0.0.1:22023 --mix wallet --rate 200 --clients 32 --duration 60
+//
+// or explorer traffic over OMQ:
+//
+//     rpc_load_tests --omq tcp://127.0.0.1:22025 --mix explorer --rate 500
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include <boost/program_options.hpp>
+#include <oxenmq/oxenmq.h>
+
+#include "common/command_line.h"
+#include "common/hex.h"
+#include "common/metrics.h"
+#include "common/string_util.h"
+#include "common/util.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "rpc/http_client.h"
+#include "epee/storages/portable_storage_template_helper.h"
+
+namespace po = boost::program_options;
+using namespace cryptonote::rpc;
+using namespace std::literals;
+
+namespace
+{
+  using clock = std::chrono::steady_clock;
+
+  const command_line::arg_descriptor<std::string> arg_http = {"http", "HTTP RPC base URL to load, e.g. http://127.0.0.1:22023"};
+  const command_line::arg_descriptor<std::string> arg_omq = {"omq", "OMQ RPC address to load, e.g. tcp://127.0.0.1:22025 or curve://HOST:PORT/PUBKEY"};
+  const command_line::arg_descriptor<std::string> arg_mix = {"mix",
+    "Traffic mix: wallet, explorer, sn, or a custom list of COMMAND=WEIGHT pairs such as get_info=3,get_outs.bin=1", "wallet"};
+  const command_line::arg_descriptor<double> arg_rate = {"rate", "Target requests per second across all clients", 100};
+  const command_line::arg_descriptor<unsigned> arg_clients = {"clients", "Number of concurrent client connections", 16};
+  const command_line::arg_descriptor<unsigned> arg_duration = {"duration", "Seconds to run for", 30};
+  const command_line::arg_descriptor<unsigned> arg_timeout = {"timeout", "Per-request timeout, in seconds", 30};
+
+  // Sends one RPC command and waits for the reply.  Each client thread has its own transport.
+  class transport
+  {
+  public:
+    virtual ~transport() = default;
+
+    // `body` is the binary-serialized request for ".bin" commands and the JSON params otherwise.
+    // Returns false on a transport failure or an error reply; `response` is set to the reply body.
+    virtual bool call(const std::string& command, const std::string& body, std::string& response) = 0;
+
+    // True if JSON replies are wrapped in a JSON-RPC envelope (i.e. the result is in "result")
+    virtual bool jsonrpc_envelope() const = 0;
+  };
+
+  bool is_binary(std::string_view command) { return tools::ends_with(command, ".bin"); }
+
+  class http_transport : public transport
+  {
+  public:
+    http_transport(const std::string& url, std::chrono::seconds timeout) : m_client{url}
+    {
+      m_client.set_timeout(timeout);
+    }
+
+    bool call(const std::string& command, const std::string& body, std::string& response) override
+    {
+      try {
+        cpr::Response res;
+        if (is_binary(command))
+          res = m_client.post(command, body, {{"Content-Type", "application/octet-stream"}});
+        else
+          res = m_client.post("json_rpc",
+              R"({"jsonrpc":"2.0","id":")" + std::to_string(m_id++) + R"(","method":")" + command + R"(","params":)" + body + "}",
+              {{"Content-Type", "application/json; charset=utf-8"}});
+        response = std::move(res.text);
+        // A JSON-RPC error comes back as a 200 with an "error" object instead of "result"
+        return res.status_code == 200 && (is_binary(command) || response.find(R"("error":)") == std::string::npos);
+      } catch (const http_client_error& e) {
+        response = e.what();
+        return false;
+      }
+    }
+
+    bool jsonrpc_envelope() const override { return true; }
+
+  private:
+    http_client m_client;
+    uint64_t m_id = 0;
+  };
+
+  class omq_transport : public transport
+  {
+  public:
+    omq_transport(oxenmq::OxenMQ& omq, oxenmq::ConnectionID conn, std::chrono::seconds timeout)
+      : m_omq{omq}, m_conn{std::move(conn)}, m_timeout{timeout} {}
+
+    bool call(const std::string& command, const std::string& body, std::string& response) override
+    {
+      std::promise<std::pair<bool, std::vector<std::string>>> reply;
+      auto result = reply.get_future();
+      m_omq.request(m_conn, "rpc." + command,
+          [&reply](bool success, std::vector<std::string> data) { reply.set_value({success, std::move(data)}); },
+          body, oxenmq::send_option::request_timeout{m_timeout});
+      auto [success, data] = result.get();
+      response = data.size() >= 2 ? std::move(data[1]) : data.empty() ? "" : std::move(data[0]);
+      return success && data.size() == 2 && data[0] == "200";
+    }
+
+    bool jsonrpc_envelope() const override { return false; }
+
+  private:
+    oxenmq::OxenMQ& m_omq;
+    oxenmq::ConnectionID m_conn;
+    std::chrono::milliseconds m_timeout;
+  };
+
+  template <typename RPC>
+  typename RPC::response call_json(transport& t, const std::string& command, const typename RPC::request& req)
+  {
+    std::string body, response;
+    epee::serialization::store_t_to_json(req, body);
+    if (!t.call(command, body, response))
+      throw std::runtime_error{command + " failed: " + response};
+
+    typename RPC::response res{};
+    bool loaded;
+    if (t.jsonrpc_envelope())
+    {
+      epee::json_rpc::response_with_error<typename RPC::response> wrapped{};
+      loaded = epee::serialization::load_t_from_json(wrapped, response);
+      res = std::move(wrapped.result);
+    }
+    else
+      loaded = epee::serialization::load_t_from_json(res, response);
+    if (!loaded)
+      throw std::runtime_error{"Failed to parse " + command + " response"};
+    return res;
+  }
+
+  // What the request generators need to know about the chain being loaded
+  struct chain_info
+  {
+    uint64_t height = 0;
+    crypto::hash genesis{};
+    uint64_t rct_outputs = 0;
+  };
+
+  chain_info fetch_chain_info(transport& t)
+  {
+    chain_info info;
+    info.height = call_json<GET_INFO>(t, "get_info", {}).height;
+
+    GET_BLOCK_HEADER_BY_HEIGHT::request hreq{};
+    hreq.height = 0;
+    auto header = call_json<GET_BLOCK_HEADER_BY_HEIGHT>(t, "get_block_header_by_height", hreq).block_header;
+    if (!header || !tools::hex_to_type(header->hash, info.genesis))
+      throw std::runtime_error{"Failed to get the genesis block hash"};
+
+    GET_OUTPUT_HISTOGRAM::request oreq{};
+    oreq.amounts = {0};
+    for (auto& e : call_json<GET_OUTPUT_HISTOGRAM>(t, "get_output_histogram", oreq).histogram)
+      if (e.amount == 0)
+        info.rct_outputs = e.total_instances;
+    return info;
+  }
+
+  using request_generator = std::function<std::string(const chain_info& chain, std::mt19937_64& rng)>;
+
+  template <typename Request>
+  std::string binary(const Request& req)
+  {
+    std::string body;
+    epee::serialization::store_t_to_binary(req, body);
+    return body;
+  }
+
+  // A random height among the last `n` blocks (wallets that are refreshing are nearly always close to
+  // the top of the chain)
+  uint64_t recent_height(const chain_info& chain, std::mt19937_64& rng, uint64_t n)
+  {
+    uint64_t top = chain.height > 0 ? chain.height - 1 : 0;
+    return top - std::uniform_int_distribution<uint64_t>{0, std::min(n, top)}(rng);
+  }
+
+  uint64_t any_height(const chain_info& chain, std::mt19937_64& rng)
+  {
+    return std::uniform_int_distribution<uint64_t>{0, chain.height > 0 ? chain.height - 1 : 0}(rng);
+  }
+
+  // Builds the request body for each command the mixes can use.  The requests are shaped like the
+  // ones the wallet, the block explorer and service node tooling actually make.
+  const std::map<std::string, request_generator, std::less<>> generators{
+    {"get_blocks.bin", [](const chain_info& chain, std::mt19937_64& rng) {
+      GET_BLOCKS_FAST::request req{};
+      req.block_ids.push_back(chain.genesis);
+      req.start_height = recent_height(chain, rng, 1000);
+      req.prune = true;
+      return binary(req);
+    }},
+    {"get_outs.bin", [](const chain_info& chain, std::mt19937_64& rng) {
+      // One ring's worth of decoys, as the wallet fetches when building a transaction
+      GET_OUTPUTS_BIN::request req{};
+      std::uniform_int_distribution<uint64_t> index{0, chain.rct_outputs > 0 ? chain.rct_outputs - 1 : 0};
+      for (int i = 0; i < 10; ++i)
+        req.outputs.push_back({0, index(rng)});
+      req.get_txid = true;
+      return binary(req);
+    }},
+    {"get_output_distribution.bin", [](const chain_info& chain, std::mt19937_64& rng) {
+      GET_OUTPUT_DISTRIBUTION_BIN::request req{};
+      req.amounts = {0};
+      req.from_height = recent_height(chain, rng, 1000);
+      req.cumulative = true;
+      req.binary = true;
+      req.compress = true;
+      return binary(req);
+    }},
+    {"get_transaction_pool_hashes.bin", [](const chain_info&, std::mt19937_64&) {
+      return binary(GET_TRANSACTION_POOL_HASHES_BIN::request{});
+    }},
+    {"get_info", [](const chain_info&, std::mt19937_64&) { return "{}"s; }},
+    {"get_last_block_header", [](const chain_info&, std::mt19937_64&) { return "{}"s; }},
+    {"get_block", [](const chain_info& chain, std::mt19937_64& rng) {
+      return R"({"height":)" + std::to_string(any_height(chain, rng)) + "}";
+    }},
+    {"get_block_header_by_height", [](const chain_info& chain, std::mt19937_64& rng) {
+      return R"({"height":)" + std::to_string(any_height(chain, rng)) + "}";
+    }},
+    {"get_block_headers_range", [](const chain_info& chain, std::mt19937_64& rng) {
+      // An explorer's front page: the latest few blocks
+      uint64_t end = recent_height(chain, rng, 10);
+      return R"({"start_height":)" + std::to_string(end >= 9 ? end - 9 : 0) + R"(,"end_height":)" + std::to_string(end) + "}";
+    }},
+    {"get_transaction_pool_stats", [](const chain_info&, std::mt19937_64&) { return "{}"s; }},
+    {"get_service_nodes", [](const chain_info&, std::mt19937_64&) { return "{}"s; }},
+    {"get_quorum_state", [](const chain_info&, std::mt19937_64&) { return "{}"s; }},
+  };
+
+  const std::map<std::string_view, std::string_view> builtin_mixes{
+    {"wallet", "get_blocks.bin=4,get_outs.bin=3,get_output_distribution.bin=1,get_transaction_pool_hashes.bin=2"},
+    {"explorer", "get_info=3,get_last_block_header=2,get_block=3,get_block_header_by_height=2,get_block_headers_range=1,get_transaction_pool_stats=1"},
+    {"sn", "get_service_nodes=3,get_quorum_state=1,get_info=1"},
+  };
+
+  struct command_stats
+  {
+    std::string name;
+    const request_generator* generate;
+    tools::metrics::histogram latency;
+    std::atomic<uint64_t> errors{0};
+  };
+
+  using mix = std::vector<std::pair<std::unique_ptr<command_stats>, unsigned>>;
+
+  mix parse_mix(std::string_view spec)
+  {
+    if (auto it = builtin_mixes.find(spec); it != builtin_mixes.end())
+      spec = it->second;
+
+    mix m;
+    for (auto& part : tools::split(spec, ","))
+    {
+      auto eq = part.find('=');
+      auto name = part.substr(0, eq);
+      unsigned weight = 1;
+      if (eq != std::string_view::npos && !tools::parse_int(part.substr(eq + 1), weight))
+        throw std::invalid_argument{"Invalid weight in mix entry '" + std::string{part} + "'"};
+      auto gen = generators.find(name);
+      if (gen == generators.end())
+        throw std::invalid_argument{"Unknown command '" + std::string{name} + "' in mix"};
+      auto stats = std::make_unique<command_stats>();
+      stats->name = name;
+      stats->generate = &gen->second;
+      m.emplace_back(std::move(stats), weight);
+    }
+    if (m.empty())
+      throw std::invalid_argument{"Empty mix"};
+    return m;
+  }
+
+  std::string ms(uint64_t ns)
+  {
+    std::ostringstream s;
+    s << std::fixed << std::setprecision(2) << ns / 1e6;
+    return s.str();
+  }
+
+  void print_report(const mix& m, std::chrono::duration<double> elapsed)
+  {
+    std::cout << "\n" << std::left << std::setw(34) << "command" << std::right << std::setw(9) << "requests"
+      << std::setw(8) << "errors" << std::setw(9) << "req/s" << std::setw(10) << "p50 ms" << std::setw(10) << "p90 ms"
+      << std::setw(10) << "p99 ms" << std::setw(10) << "p99.9 ms" << std::setw(10) << "max ms" << "\n";
+    uint64_t total = 0, total_errors = 0;
+    for (auto& [stats, weight] : m)
+    {
+      auto& h = stats->latency;
+      total += h.count();
+      total_errors += stats->errors;
+      std::cout << std::left << std::setw(34) << stats->name << std::right << std::setw(9) << h.count()
+        << std::setw(8) << stats->errors << std::setw(9) << std::fixed << std::setprecision(1) << h.count() / elapsed.count()
+        << std::setw(10) << ms(h.quantile(0.5)) << std::setw(10) << ms(h.quantile(0.9))
+        << std::setw(10) << ms(h.quantile(0.99)) << std::setw(10) << ms(h.quantile(0.999))
+        << std::setw(10) << ms(h.max()) << "\n";
+    }
+    std::cout << "\n" << total << " requests (" << total_errors << " errors) in " << std::setprecision(1)
+      << elapsed.count() << "s: " << total / elapsed.count() << " req/s\n";
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+  tools::on_startup();
+  mlog_configure("", true);
+  mlog_set_log_level(0);
+
+  po::options_description desc_options("Command line options");
+  command_line::add_arg(desc_options, arg_http);
+  command_line::add_arg(desc_options, arg_omq);
+  command_line::add_arg(desc_options, arg_mix);
+  command_line::add_arg(desc_options, arg_rate);
+  command_line::add_arg(desc_options, arg_clients);
+  command_line::add_arg(desc_options, arg_duration);
+  command_line::add_arg(desc_options, arg_timeout);
+  command_line::add_arg(desc_options, command_line::arg_help);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  const auto http_url = command_line::get_arg(vm, arg_http);
+  const auto omq_addr = command_line::get_arg(vm, arg_omq);
+  if (command_line::get_arg(vm, command_line::arg_help) || http_url.empty() == omq_addr.empty())
+  {
+    std::cout << "Usage: " << argv[0] << " (--http URL | --omq ADDRESS) [options]\n\n" << desc_options << "\n";
+    return command_line::get_arg(vm, command_line::arg_help) ? 0 : 1;
+  }
+
+  const double rate = command_line::get_arg(vm, arg_rate);
+  const unsigned clients = std::max(1u, command_line::get_arg(vm, arg_clients));
+  const std::chrono::seconds duration{command_line::get_arg(vm, arg_duration)};
+  const std::chrono::seconds timeout{command_line::get_arg(vm, arg_timeout)};
+  if (rate <= 0)
+  {
+    std::cerr << "--rate must be positive\n";
+    return 1;
+  }
+
+  mix m;
+  try {
+    m = parse_mix(command_line::get_arg(vm, arg_mix));
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  std::unique_ptr<oxenmq::OxenMQ> omq;
+  std::optional<oxenmq::ConnectionID> omq_conn;
+  if (!omq_addr.empty())
+  {
+    omq = std::make_unique<oxenmq::OxenMQ>();
+    omq->start();
+    std::promise<std::optional<std::string>> connected;
+    omq_conn = omq->connect_remote(oxenmq::address{omq_addr},
+        [&](oxenmq::ConnectionID) { connected.set_value(std::nullopt); },
+        [&](oxenmq::ConnectionID, std::string_view reason) { connected.set_value(std::string{reason}); });
+    if (auto err = connected.get_future().get())
+    {
+      std::cerr << "Failed to connect to " << omq_addr << ": " << *err << "\n";
+      return 1;
+    }
+  }
+  auto make_transport = [&]() -> std::unique_ptr<transport> {
+    if (omq)
+      return std::make_unique<omq_transport>(*omq, *omq_conn, timeout);
+    return std::make_unique<http_transport>(http_url, timeout);
+  };
+
+  chain_info chain;
+  try {
+    chain = fetch_chain_info(*make_transport());
+  } catch (const std::exception& e) {
+    std::cerr << "Failed to query the node: " << e.what() << "\n";
+    return 1;
+  }
+  std::cout << "Loading " << (omq ? omq_addr : http_url) << " (height " << chain.height << ", "
+    << chain.rct_outputs << " RingCT outputs) at " << rate << " req/s from " << clients << " clients for "
+    << duration.count() << "s\n";
+
+  std::vector<double> weights;
+  for (auto& [stats, weight] : m)
+    weights.push_back(weight);
+
+  // Request i is due at start + i/rate.  Each client claims the next due request, sleeps until then
+  // and measures latency from the due time, so time spent waiting for a free client counts against
+  // the server just as it would for real users arriving at that rate.
+  const auto interval = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>{1 / rate});
+  const auto start = clock::now();
+  const auto end = start + duration;
+  std::atomic<uint64_t> next{0};
+
+  std::vector<std::thread> threads;
+  for (unsigned c = 0; c < clients; ++c)
+    threads.emplace_back([&, c] {
+      auto t = make_transport();
+      std::mt19937_64 rng{std::random_device{}() ^ c};
+      std::discrete_distribution<size_t> pick{weights.begin(), weights.end()};
+      std::string response;
+      while (true)
+      {
+        auto due = start + interval * next++;
+        if (due >= end)
+          break;
+        auto& stats = *m[pick(rng)].first;
+        auto body = (*stats.generate)(chain, rng);
+        std::this_thread::sleep_until(due);
+        if (t->call(stats.name, body, response))
+          stats.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - due).count());
+        else
+          stats.errors++;
+      }
+    });
+  for (auto& t : threads)
+    t.join();
+
+  print_report(m, clock::now() - start);
+  return 0;
+  CATCH_ENTRY_L0("main", 1);
+}
@@ -0,0 +1,78 @@
+#include "gtest/gtest.h"
+
+#include <random>
+#include <string>
+#include <vector>
+#include "blockchain_db/blob_compression.h"
+
+using cryptonote::blob_compressor;
+using namespace std::literals;
+
+// Fake "tx prefixes": mostly shared structure with a few random bytes mixed in
+static std::vector<std::string> sample_blobs(size_t count)
+{
+  std::mt19937_64 rng{42};
+  std::vector<std::string> result;
+  for (size_t i = 0; i < count; i++)
+  {
+    std::string blob = "\x04\x00\x02\x02\x00\x0b"s;
+    for (int j = 0; j < 8; j++)
+    {
+      blob += "\x02\x00\x00\x00\x00\x00\x00\x00\x01\x23\x45\x67"s;
+      for (int k = 0; k < 8; k++)
+        blob += static_cast<char>(rng());
+    }
+    blob += "\x74\x01\x9e\x5a\x8b\x2c\x01\x00\x00"s + std::to_string(i);
+    result.push_back(std::move(blob));
+  }
+  return result;
+}
+
+TEST(blob_compression, round_trip)
+{
+  blob_compressor c;
+  auto blobs = sample_blobs(10);
+  if (!blob_compressor::supported())
+  {
+    ASSERT_THROW(c.compress(blobs[0]), std::runtime_error);
+    return;
+  }
+
+  for (auto& blob : blobs)
+    EXPECT_EQ(c.decompress(c.compress(blob)), blob);
+  EXPECT_EQ(c.decompress(c.compress("")), "");
+  EXPECT_THROW(c.decompress("not a zstd frame"), std::runtime_error);
+
+  // Without a dictionary use_dictionary is a no-op
+  EXPECT_FALSE(c.has_dictionary());
+  EXPECT_EQ(c.decompress(c.compress(blobs[0], true)), blobs[0]);
+}
+
+TEST(blob_compression, dictionary)
+{
+  if (!blob_compressor::supported())
+    return;
+
+  auto samples = sample_blobs(2000);
+  auto dict = blob_compressor::train_dictionary(samples, 4096);
+  ASSERT_FALSE(dict.empty());
+  EXPECT_LE(dict.size(), 4096);
+
+  blob_compressor c, other;
+  auto plain = c.compress(samples[0]);
+  c.set_dictionary(dict);
+  ASSERT_TRUE(c.has_dictionary());
+
+  auto with_dict = c.compress(samples[0], true);
+  EXPECT_LT(with_dict.size(), plain.size());
+  EXPECT_EQ(c.decompress(with_dict), samples[0]);
+  // Values compressed before the dictionary existed still decompress
+  EXPECT_EQ(c.decompress(plain), samples[0]);
+
+  // Decompressing a dictionary frame requires the matching dictionary
+  EXPECT_THROW(other.decompress(with_dict), std::runtime_error);
+  other.set_dictionary(dict);
+  EXPECT_EQ(other.decompress(with_dict), samples[0]);
+
+  EXPECT_THROW(c.set_dictionary("garbage"), std::runtime_error);
+}
@@ -0,0 +1,76 @@
+#include "gtest/gtest.h"
+
+#include "cryptonote_basic/block_digest.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+
+namespace block_digest = cryptonote::block_digest;
+
+static crypto::public_key make_pkey(uint8_t n)
+{
+  crypto::public_key k{};
+  k.data[0] = n;
+  return k;
+}
+
+static crypto::key_image make_key_image(uint8_t n)
+{
+  crypto::key_image k{};
+  k.data[31] = n;
+  return k;
+}
+
+TEST(block_digest, make_tx_digest)
+{
+  cryptonote::transaction tx;
+  cryptonote::add_tx_extra<cryptonote::tx_extra_pub_key>(tx, make_pkey(1));
+  cryptonote::add_tx_extra<cryptonote::tx_extra_pub_key>(tx, make_pkey(2));
+  cryptonote::add_additional_tx_pub_keys_to_extra(tx.extra, {make_pkey(3), make_pkey(4)});
+  tx.vout.push_back(cryptonote::tx_out{0, cryptonote::txout_to_key{make_pkey(5)}});
+  tx.vout.push_back(cryptonote::tx_out{0, cryptonote::txout_to_script{}});
+  cryptonote::txin_to_key in{};
+  in.k_image = make_key_image(6);
+  tx.vin.push_back(in);
+  tx.vin.push_back(cryptonote::txin_gen{});
+
+  auto d = block_digest::make_tx_digest(tx);
+  EXPECT_EQ(d.tx_pub_keys, (std::vector<crypto::public_key>{make_pkey(1), make_pkey(2)}));
+  EXPECT_EQ(d.additional_tx_pub_keys, (std::vector<crypto::public_key>{make_pkey(3), make_pkey(4)}));
+  EXPECT_EQ(d.output_keys, (std::vector<crypto::public_key>{make_pkey(5), crypto::null_pkey}));
+  EXPECT_EQ(d.key_images, (std::vector<crypto::key_image>{make_key_image(6)}));
+}
+
+TEST(block_digest, pack_unpack)
+{
+  block_digest::digest d;
+  d.miner_tx_output_indices = {0, 127, 128, 123456789};
+  d.txs.resize(3);
+  d.txs[0].tx_pub_keys = {make_pkey(1)};
+  d.txs[0].output_keys = {make_pkey(2), make_pkey(3)};
+  d.txs[0].key_images = {make_key_image(4)};
+  d.txs[2].tx_pub_keys = {make_pkey(5)};
+  d.txs[2].additional_tx_pub_keys = {make_pkey(6), make_pkey(7)};
+  d.txs[2].output_keys = {make_pkey(8), make_pkey(9)};
+
+  std::string packed = block_digest::pack(d);
+  auto unpacked = block_digest::unpack(packed);
+  ASSERT_TRUE(unpacked);
+  EXPECT_EQ(*unpacked, d);
+
+  auto empty = block_digest::unpack(block_digest::pack({}));
+  ASSERT_TRUE(empty);
+  EXPECT_EQ(*empty, block_digest::digest{});
+
+  // Truncated, or with trailing data
+  for (size_t n = 0; n < packed.size(); n++)
+    EXPECT_FALSE(block_digest::unpack(std::string_view{packed}.substr(0, n)));
+  EXPECT_FALSE(block_digest::unpack(packed + '\0'));
+}
+
+TEST(block_digest, unpack_bounds_counts)
+{
+  // A count way beyond what follows doesn't get allocated
+  std::string packed;
+  packed += '\0'; // no miner tx outputs
+  packed += "\xff\xff\xff\xff\x0f"; // 2^32 - 1 txs
+  EXPECT_FALSE(block_digest::unpack(packed));
+}
@@ -0,0 +1,151 @@
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <vector>
+#include "blockchain_db/block_info_cache.h"
+
+using cryptonote::block_info_cache;
+
+static block_info_cache::entry make_entry(uint64_t height)
+{
+  return {1000 + height, 10 * height, 20 * height, 100 * height, 5 * height, 2 * height};
+}
+
+static crypto::hash make_hash(uint64_t height, uint8_t fork = 0)
+{
+  crypto::hash h{};
+  std::memcpy(h.data, &height, sizeof(height));
+  h.data[31] = fork;
+  return h;
+}
+
+static void append_heights(block_info_cache& cache, uint64_t begin, uint64_t end, uint8_t fork = 0)
+{
+  for (uint64_t h = begin; h < end; h++)
+    cache.append(make_entry(h), make_hash(h, fork));
+}
+
+TEST(block_info_cache, staged_until_commit)
+{
+  block_info_cache cache;
+  append_heights(cache, 0, 10);
+  EXPECT_EQ(cache.size(false), 0);
+  EXPECT_EQ(cache.size(true), 10);
+  EXPECT_FALSE(cache.get(block_info_cache::timestamp, 3, false));
+  EXPECT_EQ(cache.get(block_info_cache::timestamp, 3, true), 1003);
+
+  cache.commit();
+  EXPECT_EQ(cache.size(false), 10);
+  EXPECT_EQ(cache.get(block_info_cache::weight, 9, false), 90);
+  EXPECT_EQ(cache.get(block_info_cache::cumulative_rct_outs, 9, false), 18);
+  EXPECT_FALSE(cache.get(block_info_cache::weight, 10, false));
+}
+
+TEST(block_info_cache, abort_discards)
+{
+  block_info_cache cache;
+  append_heights(cache, 0, 10);
+  cache.commit();
+
+  cache.pop();
+  cache.pop();
+  append_heights(cache, 8, 12);
+  EXPECT_EQ(cache.size(true), 12);
+  EXPECT_EQ(cache.size(false), 10);
+  cache.abort();
+  EXPECT_EQ(cache.size(true), 10);
+  EXPECT_EQ(cache.get(block_info_cache::coins, 9, true), 45);
+}
+
+TEST(block_info_cache, pop_then_replace)
+{
+  block_info_cache cache;
+  append_heights(cache, 0, 10);
+  cache.commit();
+
+  // Readers keep seeing the committed chain until the reorg commits
+  for (int i = 0; i < 3; i++)
+    cache.pop();
+  cache.append({1, 2, 3, 4, 5, 6}, make_hash(7, 1));
+  EXPECT_EQ(cache.size(true), 8);
+  EXPECT_EQ(cache.get(block_info_cache::timestamp, 7, true), 1);
+  EXPECT_EQ(cache.get(block_info_cache::timestamp, 7, false), 1007);
+  EXPECT_EQ(cache.get(block_info_cache::timestamp, 8, false), 1008);
+  EXPECT_FALSE(cache.get(block_info_cache::timestamp, 8, true));
+
+  cache.commit();
+  EXPECT_EQ(cache.size(false), 8);
+  EXPECT_EQ(cache.get(block_info_cache::timestamp, 7, false), 1);
+  EXPECT_EQ(cache.get(block_info_cache::timestamp, 6, false), 1006);
+}
+
+TEST(block_info_cache, ranges)
+{
+  block_info_cache cache;
+  append_heights(cache, 0, 10);
+  cache.commit();
+  append_heights(cache, 10, 15);
+
+  std::vector<uint64_t> out;
+  ASSERT_TRUE(cache.get_range(block_info_cache::cumulative_difficulty, 8, 100, out, false));
+  EXPECT_EQ(out, (std::vector<uint64_t>{800, 900}));
+
+  out.clear();
+  ASSERT_TRUE(cache.get_range(block_info_cache::cumulative_difficulty, 8, 4, out, true));
+  EXPECT_EQ(out, (std::vector<uint64_t>{800, 900, 1000, 1100}));
+
+  out.clear();
+  EXPECT_FALSE(cache.get_range(block_info_cache::cumulative_difficulty, 10, 4, out, false));
+  EXPECT_FALSE(cache.get_range(block_info_cache::cumulative_difficulty, 15, 4, out, true));
+  EXPECT_TRUE(out.empty());
+
+  cache.clear();
+  EXPECT_EQ(cache.size(true), 0);
+  EXPECT_FALSE(cache.get_range(block_info_cache::timestamp, 0, 1, out, false));
+}
+
+TEST(block_info_cache, hashes)
+{
+  block_info_cache cache;
+  append_heights(cache, 0, 10);
+  cache.commit();
+
+  uint64_t height = 0;
+  EXPECT_EQ(cache.find_hash(make_hash(6), &height, false), true);
+  EXPECT_EQ(height, 6);
+  EXPECT_EQ(cache.find_hash(make_hash(10), &height, false), false);
+  EXPECT_EQ(cache.get_hash(9, false), make_hash(9));
+  EXPECT_FALSE(cache.get_hash(10, false));
+
+  // Reorg the top 3 blocks: the writer sees the new chain, readers the old one until commit
+  for (int i = 0; i < 3; i++)
+    cache.pop();
+  append_heights(cache, 7, 11, 1);
+  EXPECT_EQ(cache.find_hash(make_hash(8), nullptr, true), false);
+  EXPECT_EQ(cache.find_hash(make_hash(8), nullptr, false), true);
+  EXPECT_EQ(cache.find_hash(make_hash(10, 1), &height, true), true);
+  EXPECT_EQ(height, 10);
+  EXPECT_EQ(cache.find_hash(make_hash(10, 1), nullptr, false), false);
+
+  std::vector<crypto::hash> out;
+  ASSERT_TRUE(cache.get_hashes(5, 4, out, true));
+  EXPECT_EQ(out, (std::vector<crypto::hash>{make_hash(5), make_hash(6), make_hash(7, 1), make_hash(8, 1)}));
+
+  cache.commit();
+  EXPECT_EQ(cache.find_hash(make_hash(8), nullptr, false), false);
+  EXPECT_EQ(cache.find_hash(make_hash(8, 1), &height, false), true);
+  EXPECT_EQ(height, 8);
+  EXPECT_EQ(cache.get_hash(7, false), make_hash(7, 1));
+
+  // A block whose hash prefix collides with another's isn't indexed, so misses become inconclusive
+  crypto::hash collides = make_hash(3);
+  collides.data[31] = 9;
+  cache.append(make_entry(11), collides);
+  cache.commit();
+  EXPECT_EQ(cache.find_hash(make_hash(3), &height, false), true);
+  EXPECT_EQ(height, 3);
+  EXPECT_EQ(cache.find_hash(collides, nullptr, false), std::nullopt);
+
+  cache.clear();
+  EXPECT_EQ(cache.find_hash(make_hash(3), nullptr, false), false);
+}
@@ -85,3 +85,76 @@ TEST(block_queue, flush_uuid)
   bq.add_blocks(0, 200, uuid1(), std::chrono::steady_clock::now());
   ASSERT_EQ(bq.get_max_block_height(), 399);
 }
+
+TEST(block_queue, shared_span_blocks)
+{
+  cryptonote::block_queue bq;
+  std::vector<cryptonote::block_complete_entry> bcel(2);
+  bcel[0].block = "block 0";
+  bcel[1].block = "block 1";
+  bcel[1].txs = {"tx"};
+
+  bq.add_blocks(10, 2, uuid1(), std::chrono::steady_clock::now());
+  uint64_t height;
+  cryptonote::block_queue::span_blocks blocks;
+  boost::uuids::uuid connection_id;
+  ASSERT_FALSE(bq.get_next_span(height, blocks, connection_id));
+  ASSERT_TRUE(bq.get_next_span(height, blocks, connection_id, false));
+  ASSERT_FALSE(blocks);
+
+  bq.add_blocks(10, std::move(bcel), uuid1(), 1.0f, 100);
+  ASSERT_TRUE(bq.get_next_span(height, blocks, connection_id));
+  ASSERT_EQ(height, 10);
+  ASSERT_EQ(connection_id, uuid1());
+  ASSERT_TRUE(blocks);
+  ASSERT_EQ(blocks->size(), 2);
+  ASSERT_EQ((*blocks)[1].block, "block 1");
+  ASSERT_EQ((*blocks)[1].txs.size(), 1);
+
+  // Later lookups get the same blocks, not a copy of them
+  cryptonote::block_queue::span_blocks again;
+  ASSERT_TRUE(bq.get_filled_span_at(10, again));
+  ASSERT_EQ(again, blocks);
+
+  // ... which stay valid after the span is removed from the queue
+  bq.remove_spans(uuid1(), 10);
+  ASSERT_FALSE(bq.get_next_span(height, again, connection_id, false));
+  ASSERT_EQ((*blocks)[0].block, "block 0");
+}
+
+TEST(block_queue, spill)
+{
+  const fs::path dir = fs::temp_directory_path();
+  cryptonote::block_queue bq;
+  bq.set_spill(dir, 150);
+  ASSERT_TRUE(bq.spilling());
+
+  auto make_span = [](uint64_t height) {
+    std::vector<cryptonote::block_complete_entry> bcel(2);
+    bcel[0].block = "block " + std::to_string(height);
+    bcel[1].block = "block " + std::to_string(height + 1);
+    bcel[1].txs = {"tx " + std::to_string(height + 1)};
+    return bcel;
+  };
+  for (uint64_t height : {10, 12, 14})
+    bq.add_blocks(height, make_span(height), uuid1(), 1.0f, 100);
+
+  // The highest spans go to disk until the rest fit, but the lowest always stays
+  EXPECT_EQ(bq.get_data_size(), 300);
+  EXPECT_EQ(bq.get_memory_size(), 100);
+  EXPECT_EQ(bq.get_num_filled_spans(), 3);
+  EXPECT_TRUE(fs::exists(dir / "block_queue.spill"));
+
+  for (uint64_t height : {10, 12, 14})
+  {
+    cryptonote::block_queue::span_blocks blocks;
+    ASSERT_TRUE(bq.get_filled_span_at(height, blocks));
+    ASSERT_EQ(blocks->size(), 2);
+    EXPECT_EQ((*blocks)[0].block, "block " + std::to_string(height));
+    EXPECT_EQ((*blocks)[1].txs, std::vector<std::string>{"tx " + std::to_string(height + 1)});
+  }
+
+  bq.remove_spans(uuid1(), 14);
+  EXPECT_EQ(bq.get_data_size(), 0);
+  EXPECT_FALSE(fs::exists(dir / "block_queue.spill"));
+}
@@ -335,4 +335,45 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1].first), hashes[1]);
 }
 
+TYPED_TEST(BlockchainDBTest, BlocksTxOutputIndices)
+{
+  fs::path tempPath = random_tmp_file();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath, cryptonote::FAKECHAIN));
+  this->get_filenames();
+
+  db_wtxn_guard guard(this->m_db);
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+  uint64_t first_tx_id;
+  ASSERT_TRUE(this->m_db->tx_exists(get_transaction_hash(this->m_blocks[0].first.miner_tx), first_tx_id));
+  const std::vector<size_t> block_txes{this->m_txs[0].size(), this->m_txs[1].size()};
+  const auto all = this->m_db->get_tx_amount_output_indices(first_tx_id, 2 + block_txes[0] + block_txes[1]);
+
+  for (bool miner_txes : {true, false})
+  {
+    std::vector<std::vector<std::vector<uint64_t>>> blocks;
+    ASSERT_NO_THROW(blocks = this->m_db->get_blocks_tx_amount_output_indices(first_tx_id, block_txes, miner_txes));
+    ASSERT_EQ(2, blocks.size());
+    size_t tx = 0;
+    for (size_t b = 0; b < 2; b++)
+    {
+      ASSERT_EQ(block_txes[b] + miner_txes, blocks[b].size());
+      if (!miner_txes)
+        tx++;
+      for (auto& indices : blocks[b])
+        ASSERT_EQ(all[tx++], indices);
+    }
+  }
+
+  // Asking for more txs than there are
+  const std::vector<size_t> too_many{block_txes[0], block_txes[1] + 1};
+  ASSERT_THROW(this->m_db->get_blocks_tx_amount_output_indices(first_tx_id, too_many, true), TX_DNE);
+}
+
 }  // anonymous namespace
@@ -163,6 +163,23 @@ TEST(bulletproofs, valid_aggregated)
   ASSERT_TRUE(rct::bulletproof_VERIFY(proofs));
 }
 
+TEST(bulletproofs, cache_sizes)
+{
+  std::vector<rct::Bulletproof> proofs;
+  for (size_t outputs : {1, 2, 16})
+    proofs.push_back(bulletproof_PROVE(std::vector<uint64_t>(outputs, crypto::rand<uint64_t>()), rct::skvGen(outputs)));
+
+  // none, part of the Gi/Hi generators, all of them but without the Straus tables, and everything
+  for (size_t bytes : {0, 64*1024, 400*1024, BULLETPROOF_DEFAULT_CACHE_SIZE})
+  {
+    rct::bulletproof_set_cache_size(bytes);
+    ASSERT_TRUE(rct::bulletproof_VERIFY(bulletproof_PROVE(std::vector<uint64_t>(1, 749327532984), rct::skvGen(1))));
+    ASSERT_TRUE(rct::bulletproof_VERIFY(proofs));
+    for (const auto& proof : proofs)
+      ASSERT_TRUE(rct::bulletproof_VERIFY(proof));
+  }
+  rct::bulletproof_set_cache_size(BULLETPROOF_DEFAULT_CACHE_SIZE);
+}
 
 TEST(bulletproofs, invalid_8)
 {
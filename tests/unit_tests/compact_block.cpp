@@ -0,0 +1,41 @@
+#include "gtest/gtest.h"
+
+#include "cryptonote_protocol/compact_block.h"
+
+namespace compact_block = cryptonote::compact_block;
+
+static crypto::hash make_hash(uint8_t n)
+{
+  crypto::hash h{};
+  h.data[0] = n;
+  return h;
+}
+
+TEST(compact_block, short_ids)
+{
+  std::vector<crypto::hash> txs{make_hash(1), make_hash(2), make_hash(3)};
+  std::string ids = compact_block::make_short_ids(123, txs);
+  ASSERT_EQ(ids.size(), txs.size() * compact_block::SHORT_ID_SIZE);
+  EXPECT_LT(compact_block::short_id(123, txs[0]), uint64_t{1} << (8 * compact_block::SHORT_ID_SIZE));
+  EXPECT_NE(compact_block::short_id(123, txs[0]), compact_block::short_id(124, txs[0]));
+  EXPECT_NE(ids, compact_block::make_short_ids(124, txs));
+
+  // Resolves against a pool holding some of the txs (and others), in block order
+  auto resolved = compact_block::resolve_short_ids(123, ids, {make_hash(9), make_hash(3), make_hash(1), make_hash(3)});
+  ASSERT_TRUE(resolved);
+  ASSERT_EQ(resolved->size(), 3);
+  EXPECT_EQ((*resolved)[0], make_hash(1));
+  EXPECT_EQ((*resolved)[1], crypto::null_hash);
+  EXPECT_EQ((*resolved)[2], make_hash(3));
+
+  // A pool with another salt's ids doesn't match
+  resolved = compact_block::resolve_short_ids(124, ids, txs);
+  ASSERT_TRUE(resolved);
+  for (auto& h : *resolved)
+    EXPECT_EQ(h, crypto::null_hash);
+
+  EXPECT_FALSE(compact_block::resolve_short_ids(123, ids.substr(1), txs));
+  resolved = compact_block::resolve_short_ids(123, "", txs);
+  ASSERT_TRUE(resolved);
+  EXPECT_TRUE(resolved->empty());
+}
@@ -0,0 +1,81 @@
+#include "gtest/gtest.h"
+
+#include <map>
+#include <string>
+#include "common/cow_hash_map.h"
+
+using map_t = tools::cow_hash_map<int, std::string, std::hash<int>, 8>;
+
+static std::map<int, std::string> contents(const map_t& m)
+{
+  std::map<int, std::string> result;
+  for (auto& [k, v] : m)
+    result.emplace(k, v);
+  return result;
+}
+
+TEST(cow_hash_map, basic)
+{
+  map_t m;
+  ASSERT_TRUE(m.empty());
+  ASSERT_EQ(m.begin(), m.end());
+
+  for (int i = 0; i < 100; i++)
+    m[i] = std::to_string(i);
+  ASSERT_EQ(m.size(), 100);
+  ASSERT_EQ(std::distance(m.begin(), m.end()), 100);
+  ASSERT_EQ(m.count(42), 1);
+  ASSERT_EQ(m.count(100), 0);
+  ASSERT_EQ(m.at(42), "42");
+  ASSERT_THROW(m.at(100), std::out_of_range);
+
+  auto [it, inserted] = m.emplace(100, "hundred");
+  ASSERT_TRUE(inserted);
+  ASSERT_EQ(it->second, "hundred");
+  ASSERT_FALSE(m.emplace(100, "again").second);
+  ASSERT_EQ(m.size(), 101);
+
+  auto found = m.find(7);
+  ASSERT_NE(found, m.end());
+  found->second = "seven";
+  ASSERT_EQ(m.at(7), "seven");
+  m.erase(found);
+  ASSERT_EQ(m.find(7), m.end());
+  ASSERT_EQ(m.erase(8), 1);
+  ASSERT_EQ(m.erase(8), 0);
+  ASSERT_EQ(m.size(), 99);
+  ASSERT_EQ(std::distance(m.begin(), m.end()), 99);
+
+  m.clear();
+  ASSERT_TRUE(m.empty());
+  ASSERT_EQ(m.begin(), m.end());
+}
+
+TEST(cow_hash_map, copies_are_independent)
+{
+  map_t a;
+  for (int i = 0; i < 50; i++)
+    a[i] = std::to_string(i);
+  auto const original = contents(a);
+
+  map_t b = a;
+  b[3] = "changed";
+  b.erase(4);
+  b.emplace(1000, "new");
+  if (auto it = b.find(5); it != b.end())
+    it->second = "also changed";
+
+  ASSERT_EQ(contents(a), original);
+  ASSERT_EQ(b.at(3), "changed");
+  ASSERT_EQ(b.at(5), "also changed");
+  ASSERT_EQ(b.count(4), 0);
+  ASSERT_EQ(b.size(), 50);
+
+  // An iterator obtained before copying must not modify the copy when erasing
+  auto it = a.find(10);
+  map_t c = a;
+  a.erase(it);
+  ASSERT_EQ(a.count(10), 0);
+  ASSERT_EQ(c.count(10), 1);
+  ASSERT_EQ(contents(c), original);
+}
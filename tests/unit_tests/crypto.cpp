@@ -33,6 +33,7 @@
 #include <string>
 
 #include "cryptonote_basic/cryptonote_basic_impl.h"
+#include "crypto/hash_to_point_cache.h"
 
 namespace
 {
@@ -99,3 +100,195 @@ TEST(Crypto, verify_32)
     }
   }
 }
+
+TEST(Crypto, batch_derivations)
+{
+  crypto::public_key view_pub;
+  crypto::secret_key view_sec;
+  crypto::generate_keys(view_pub, view_sec);
+
+  std::vector<crypto::public_key> tx_keys;
+  for (int i = 0; i < 9; i++)
+  {
+    crypto::secret_key sec;
+    crypto::generate_keys(tx_keys.emplace_back(), sec);
+  }
+  // Not a point: fails both ways
+  std::memset(tx_keys[4].data, 0xff, sizeof(tx_keys[4].data));
+
+  std::vector<crypto::key_derivation> derivations;
+  auto ok = crypto::generate_key_derivations(tx_keys, view_sec, derivations);
+  ASSERT_EQ(ok.size(), tx_keys.size());
+  ASSERT_EQ(derivations.size(), tx_keys.size());
+  for (size_t i = 0; i < tx_keys.size(); i++)
+  {
+    crypto::key_derivation d;
+    ASSERT_EQ(ok[i], crypto::generate_key_derivation(tx_keys[i], view_sec, d));
+    if (ok[i])
+      EXPECT_EQ(derivations[i], d);
+  }
+
+  std::vector<crypto::public_key> out_keys;
+  std::vector<crypto::key_derivation> out_derivations;
+  std::vector<size_t> out_indices;
+  for (size_t i = 0; i < tx_keys.size(); i++)
+  {
+    if (!ok[i])
+      continue;
+    for (size_t k = 0; k < 3; k++)
+    {
+      crypto::derive_public_key(derivations[i], k, view_pub, out_keys.emplace_back());
+      out_derivations.push_back(derivations[i]);
+      out_indices.push_back(k);
+    }
+  }
+  out_keys.push_back(tx_keys[4]);
+  out_derivations.push_back(derivations[0]);
+  out_indices.push_back(0);
+
+  std::vector<crypto::public_key> spend_keys;
+  auto ok2 = crypto::derive_subaddress_public_keys(out_keys, out_derivations, out_indices, spend_keys);
+  ASSERT_EQ(spend_keys.size(), out_keys.size());
+  for (size_t i = 0; i < out_keys.size(); i++)
+  {
+    crypto::public_key spend;
+    ASSERT_EQ(ok2[i], crypto::derive_subaddress_public_key(out_keys[i], out_derivations[i], out_indices[i], spend));
+    if (ok2[i])
+    {
+      EXPECT_EQ(spend_keys[i], spend);
+      EXPECT_EQ(spend_keys[i], view_pub);
+    }
+  }
+  EXPECT_FALSE(ok2.back());
+
+  EXPECT_TRUE(crypto::generate_key_derivations({}, view_sec, derivations).empty());
+  EXPECT_TRUE(derivations.empty());
+}
+
+TEST(Crypto, cn_fast_hash_multi)
+{
+  // Lengths around the 136-byte keccak block size, and enough buffers to refill every lane
+  std::vector<std::string> data;
+  for (size_t len : {0, 1, 32, 64, 135, 136, 137, 271, 272, 273, 1000, 64, 64, 5000, 0, 64, 200, 17, 136, 9})
+  {
+    data.emplace_back(len, '\0');
+    for (auto& c : data.back())
+      c = crypto::rand<char>();
+  }
+  std::vector<std::string_view> views(data.begin(), data.end());
+
+  for (size_t count : {size_t{0}, size_t{1}, size_t{2}, size_t{5}, views.size()})
+  {
+    std::vector<crypto::hash> hashes(count);
+    crypto::cn_fast_hash_multi(views.data(), hashes.data(), count);
+    for (size_t i = 0; i < count; i++)
+      EXPECT_EQ(hashes[i], crypto::cn_fast_hash(views[i].data(), views[i].size())) << "buffer " << i << " of " << count;
+  }
+}
+
+TEST(Crypto, batch_signatures)
+{
+  crypto::hash prefix;
+  crypto::cn_fast_hash("quorum vote", 11, prefix);
+
+  std::vector<crypto::public_key> pubs;
+  std::vector<crypto::signature> sigs;
+  for (size_t i = 0; i < 8; i++)
+  {
+    crypto::secret_key sec;
+    crypto::generate_keys(pubs.emplace_back(), sec);
+    crypto::generate_signature(prefix, pubs.back(), sec, sigs.emplace_back());
+  }
+  // A signature by the wrong key, a corrupted one, and one with a non-canonical scalar
+  std::swap(pubs[2], pubs[3]);
+  sigs[5].c.data[0] ^= 1;
+  std::memset(sigs[7].r.data, 0xff, sizeof(sigs[7].r.data));
+
+  auto ok = crypto::check_signatures(prefix, pubs, sigs);
+  ASSERT_EQ(ok.size(), pubs.size());
+  for (size_t i = 0; i < pubs.size(); i++)
+    EXPECT_EQ(ok[i], crypto::check_signature(prefix, pubs[i], sigs[i])) << "signature " << i;
+  EXPECT_EQ(std::count(ok.begin(), ok.end(), false), 4);
+
+  EXPECT_TRUE(crypto::check_signatures(prefix, {}, {}).empty());
+}
+
+TEST(Crypto, prepared_public_key)
+{
+  crypto::hash prefix;
+  crypto::cn_fast_hash("uptime proof", 12, prefix);
+
+  crypto::public_key pub, other;
+  crypto::secret_key sec, other_sec;
+  crypto::generate_keys(pub, sec);
+  crypto::generate_keys(other, other_sec);
+  crypto::signature sig;
+  crypto::generate_signature(prefix, pub, sec, sig);
+
+  auto prepared = crypto::prepared_public_key::prepare(pub);
+  ASSERT_TRUE(prepared);
+  EXPECT_EQ(prepared->key(), pub);
+  EXPECT_TRUE(crypto::check_signature(prefix, *prepared, sig));
+
+  auto prepared_other = crypto::prepared_public_key::prepare(other);
+  ASSERT_TRUE(prepared_other);
+  EXPECT_FALSE(crypto::check_signature(prefix, *prepared_other, sig));
+
+  crypto::signature bad = sig;
+  bad.r.data[3] ^= 0x10;
+  EXPECT_FALSE(crypto::check_signature(prefix, *prepared, bad));
+
+  crypto::public_key invalid;
+  std::memset(invalid.data, 0xff, sizeof(invalid.data));
+  EXPECT_FALSE(crypto::prepared_public_key::prepare(invalid));
+}
+
+TEST(Crypto, hash_to_point_cache)
+{
+  crypto::clear_hash_to_point_cache(16);
+
+  // A key image is sec * Hp(pub), so check the cached points against generate_key_image
+  std::vector<crypto::public_key> pubs(100);
+  std::vector<crypto::key_image> images(pubs.size());
+  for (size_t i = 0; i < pubs.size(); i++)
+  {
+    crypto::secret_key sec;
+    crypto::generate_keys(pubs[i], sec);
+    crypto::generate_key_image(pubs[i], sec, images[i]);
+    for (int pass = 0; pass < 2; pass++)
+    {
+      ge_p3 point;
+      crypto::hash_to_point_cached(pubs[i], point);
+      ge_p2 image_p2;
+      ge_scalarmult(&image_p2, reinterpret_cast<const unsigned char*>(&unwrap(unwrap(sec))), &point);
+      crypto::key_image image;
+      ge_tobytes(reinterpret_cast<unsigned char*>(&image), &image_p2);
+      ASSERT_EQ(image, images[i]);
+    }
+  }
+
+  auto stats = crypto::get_hash_to_point_cache_stats();
+  EXPECT_EQ(stats.hits, 100);
+  EXPECT_EQ(stats.misses, 100);
+  EXPECT_EQ(stats.capacity, 16);
+  EXPECT_LE(stats.size, 16);
+
+  // Push plenty more through (so that the first key's part of the cache has certainly moved on):
+  // the most recently used key is still there, the first isn't
+  ge_p3 point;
+  crypto::public_key pub;
+  crypto::secret_key sec;
+  for (int i = 0; i < 500; i++)
+  {
+    crypto::generate_keys(pub, sec);
+    crypto::hash_to_point_cached(pub, point);
+  }
+  crypto::hash_to_point_cached(pub, point);
+  EXPECT_EQ(crypto::get_hash_to_point_cache_stats().hits, 101);
+  crypto::hash_to_point_cached(pubs.front(), point);
+  EXPECT_EQ(crypto::get_hash_to_point_cache_stats().misses, 601);
+
+  crypto::clear_hash_to_point_cache();
+  stats = crypto::get_hash_to_point_cache_stats();
+  EXPECT_EQ(stats.hits + stats.misses + stats.size, 0);
+}
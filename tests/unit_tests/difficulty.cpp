@@ -72,3 +72,49 @@ TEST(difficulty, check_hash)
   ASSERT_TRUE(cryptonote::check_hash(MKHASH(0xffffffffffffffff, 1), MKDIFF(0xffffffffffffffff, 1)));
   ASSERT_FALSE(cryptonote::check_hash(MKHASH(0xffffffffffffffff, 1), MKDIFF(0xffffffffffffffff, 2)));
 }
+
+TEST(difficulty, window)
+{
+  constexpr size_t cap = cryptonote::difficulty_window::CAPACITY;
+  std::vector<uint64_t> timestamps, cumulative_difficulties;
+  cryptonote::difficulty_window window;
+  uint64_t cumulative = 0;
+  for (uint64_t i = 0; i < 3 * cap; i++)
+  {
+    const uint64_t timestamp = 1000 + i * 120 + (i * 7919) % 97;
+    cumulative += 1000 + (i * 104729) % 500;
+    timestamps.push_back(timestamp);
+    cumulative_difficulties.push_back(cumulative);
+    window.push_back(timestamp, cumulative);
+
+    const size_t n = std::min(timestamps.size(), cap);
+    ASSERT_EQ(window.size(), n);
+    ASSERT_EQ(window.timestamp(0), timestamps[timestamps.size() - n]);
+    ASSERT_EQ(window.cumulative_difficulty(n - 1), cumulative);
+    ASSERT_EQ(window.next_difficulty(120, cryptonote::difficulty_calc_mode::normal),
+        cryptonote::next_difficulty_v2(
+          std::vector<uint64_t>(timestamps.end() - n, timestamps.end()),
+          std::vector<uint64_t>(cumulative_difficulties.end() - n, cumulative_difficulties.end()),
+          120, cryptonote::difficulty_calc_mode::normal));
+  }
+
+  // Popping the newest and refilling the oldest gives the window one block back
+  window.pop_back();
+  ASSERT_EQ(window.size(), cap - 1);
+  window.push_front(timestamps[timestamps.size() - cap - 1], cumulative_difficulties[timestamps.size() - cap - 1]);
+  ASSERT_EQ(window.size(), cap);
+  for (size_t i = 0; i < cap; i++)
+  {
+    ASSERT_EQ(window.timestamp(i), timestamps[timestamps.size() - cap - 1 + i]);
+    ASSERT_EQ(window.cumulative_difficulty(i), cumulative_difficulties[timestamps.size() - cap - 1 + i]);
+  }
+
+  // A full window ignores push_front
+  window.push_front(0, 0);
+  ASSERT_EQ(window.timestamp(0), timestamps[timestamps.size() - cap - 1]);
+
+  window.trim(5);
+  ASSERT_EQ(window.size(), 5);
+  ASSERT_EQ(window.timestamp(0), timestamps[timestamps.size() - 6]);
+  ASSERT_EQ(window.timestamp(4), timestamps[timestamps.size() - 2]);
+}
@@ -81,6 +81,44 @@ namespace
   };
 
   typedef epee::net_utils::boosted_tcp_server<test_protocol_handler> test_tcp_server;
+
+  // Answers anything received with a burst of small messages
+  struct test_burst_protocol_handler
+  {
+    typedef test_connection_context connection_context;
+    typedef test_protocol_handler_config config_type;
+
+    static constexpr size_t count = 500;
+    static std::string message(size_t i) { return "message " + std::to_string(10000 + i) + "\n"; }
+
+    epee::net_utils::i_service_endpoint* m_send_handler;
+
+    test_burst_protocol_handler(epee::net_utils::i_service_endpoint* psnd_hndlr, config_type& /*config*/, connection_context& /*conn_context*/)
+      : m_send_handler{psnd_hndlr}
+    {
+    }
+
+    void after_init_connection()
+    {
+    }
+
+    void handle_qued_callback()
+    {
+    }
+
+    bool release_protocol()
+    {
+      return true;
+    }
+
+    bool handle_recv(const void* /*data*/, size_t /*size*/)
+    {
+      for (size_t i = 0; i < count; ++i)
+        if (!m_send_handler->do_send(epee::shared_sv{message(i)}))
+          return false;
+      return true;
+    }
+  };
 }
 
 TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
@@ -130,3 +168,61 @@ TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
   ASSERT_TRUE(srv.server_stop());
   ASSERT_TRUE(srv.deinit_server());
 }
+
+TEST(boosted_tcp_server, queued_sends_arrive_in_order)
+{
+  epee::net_utils::boosted_tcp_server<test_burst_protocol_handler> srv(epee::net_utils::e_connection_type_RPC);
+  ASSERT_TRUE(srv.init_server(test_server_port + 1, test_server_host));
+  ASSERT_TRUE(srv.run_server(2, false));
+
+  boost::asio::io_service io_service;
+  boost::asio::ip::tcp::socket sock{io_service};
+  sock.connect({boost::asio::ip::make_address(test_server_host), test_server_port + 1});
+  boost::asio::write(sock, boost::asio::buffer("x", 1));
+
+  // The messages get coalesced into fewer writes, but must arrive complete and in order
+  std::string expected;
+  for (size_t i = 0; i < test_burst_protocol_handler::count; ++i)
+    expected += test_burst_protocol_handler::message(i);
+  std::string received(expected.size(), '\0');
+  boost::asio::read(sock, boost::asio::buffer(received.data(), received.size()));
+  EXPECT_EQ(expected, received);
+
+  sock.close();
+  srv.send_stop_signal();
+  ASSERT_TRUE(srv.server_stop());
+  ASSERT_TRUE(srv.deinit_server());
+}
+
+TEST(boosted_tcp_server, io_shards)
+{
+  epee::net_utils::boosted_tcp_server<test_burst_protocol_handler> srv(epee::net_utils::e_connection_type_RPC);
+  srv.set_io_shards(2);
+  ASSERT_TRUE(srv.init_server(test_server_port + 2, test_server_host));
+  ASSERT_TRUE(srv.run_server(1, false));
+
+  std::string expected;
+  for (size_t i = 0; i < test_burst_protocol_handler::count; ++i)
+    expected += test_burst_protocol_handler::message(i);
+
+  // Connections are spread over the shards, and each still gets served
+  boost::asio::io_service io_service;
+  std::vector<boost::asio::ip::tcp::socket> socks;
+  for (int i = 0; i < 3; ++i)
+  {
+    auto& sock = socks.emplace_back(io_service);
+    sock.connect({boost::asio::ip::make_address(test_server_host), test_server_port + 2});
+    boost::asio::write(sock, boost::asio::buffer("x", 1));
+  }
+  for (auto& sock : socks)
+  {
+    std::string received(expected.size(), '\0');
+    boost::asio::read(sock, boost::asio::buffer(received.data(), received.size()));
+    EXPECT_EQ(expected, received);
+    sock.close();
+  }
+
+  srv.send_stop_signal();
+  ASSERT_TRUE(srv.server_stop());
+  ASSERT_TRUE(srv.deinit_server());
+}
@@ -512,6 +512,42 @@ TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_process
 }
 
 
+TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_sends_bulk_command_as_fragments)
+{
+  // Setup
+  const int bulk_command = 46733;
+  const int expected_command = 4673261;
+  const std::string bulk_data(100 * 1024, 'b');
+  const std::string in_data(256, 'e');
+
+  m_handler_config.m_bulk_commands = {bulk_command};
+  test_connection_ptr conn = create_connection();
+
+  // Test
+  ASSERT_LT(0, m_handler_config.notify(bulk_command, epee::strspan<std::uint8_t>(bulk_data), conn->m_protocol_handler.get_connection_id()));
+  ASSERT_EQ(4u, conn->send_counter());
+  const std::string fragmented = conn->last_send_data();
+  ASSERT_EQ(bulk_data.size() + 5 * sizeof(epee::levin::bucket_head2), fragmented.size());
+
+  ASSERT_LT(0, m_handler_config.notify(expected_command, epee::strspan<std::uint8_t>(in_data), conn->m_protocol_handler.get_connection_id()));
+  ASSERT_EQ(5u, conn->send_counter());
+
+  // Another message arriving between the fragments is handled right away
+  const size_t half = 2 * (32 * 1024 + sizeof(epee::levin::bucket_head2)); // two whole fragments
+  ASSERT_TRUE(conn->m_protocol_handler.handle_recv(fragmented.data(), half));
+  ASSERT_TRUE(conn->m_protocol_handler.handle_recv(conn->last_send_data().data() + fragmented.size(), conn->last_send_data().size() - fragmented.size()));
+  ASSERT_EQ(1u, m_commands_handler.notify_counter());
+  ASSERT_EQ(expected_command, m_commands_handler.last_command());
+  ASSERT_EQ(in_data, m_commands_handler.last_in_buf());
+
+  ASSERT_TRUE(conn->m_protocol_handler.handle_recv(fragmented.data() + half, fragmented.size() - half));
+  ASSERT_EQ(2u, m_commands_handler.notify_counter());
+  ASSERT_EQ(bulk_command, m_commands_handler.last_command());
+  ASSERT_EQ(bulk_data, m_commands_handler.last_in_buf());
+  ASSERT_EQ(5u, conn->send_counter());
+}
+
+
 TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_big_packet_1)
 {
   std::string buf("yyyyyy");
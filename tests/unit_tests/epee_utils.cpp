@@ -55,6 +55,8 @@
 #include "epee/span.h"
 #include "epee/string_tools.h"
 #include "epee/storages/parserse_base_utils.h"
+#include "epee/storages/portable_storage_template_helper.h"
+#include "epee/serialization/keyvalue_serialization.h"
 
 namespace
 {
@@ -856,6 +858,37 @@ TEST(net_buffer, move)
   ASSERT_TRUE(!memcmp(span.data() + 1, std::string(4000, '0').c_str(), 4000));
 }
 
+TEST(net_buffer, reserve_and_trim)
+{
+  epee::net_utils::buffer buf;
+
+  buf.append("abc", 3);
+  buf.erase(1);
+  buf.reserve(1024 * 1024);
+  const uint8_t* data = buf.span(2).data();
+  ASSERT_TRUE(!memcmp(data, "bc", 2));
+  const std::string big(1024 * 1024, 'x');
+  buf.append(big.data(), big.size());
+  ASSERT_EQ(buf.size(), big.size() + 2);
+  epee::span<const uint8_t> span = buf.span(buf.size());
+  EXPECT_EQ(span.data(), data); // nothing got moved
+  ASSERT_TRUE(!memcmp(span.data() + 2, big.data(), big.size()));
+
+  buf.trim(); // not empty, so nothing happens
+  ASSERT_EQ(buf.size(), big.size() + 2);
+  span = buf.carve(buf.size());
+  ASSERT_TRUE(!memcmp(span.data(), "bc", 2));
+  buf.trim();
+  EXPECT_EQ(buf.size(), 0);
+
+  // The storage gets reused by the next large buffer
+  epee::net_utils::buffer buf2;
+  buf2.reserve(1024 * 1024);
+  buf2.append("def", 3);
+  EXPECT_EQ(buf2.span(3).data(), data);
+  ASSERT_TRUE(!memcmp(buf2.span(3).data(), "def", 3));
+}
+
 TEST(parsing, isspace)
 {
   ASSERT_FALSE(epee::misc_utils::parse::isspace(0));
@@ -955,3 +988,85 @@ TEST(parsing, unicode)
   s = "\"foo\\u1234bar\""; si = s.begin(); ASSERT_TRUE(epee::misc_utils::parse::match_string(si, s.cend(), bs)); ASSERT_EQ(bs, "fooሴbar");
   s = "\"\\u3042\\u307e\\u3084\\u304b\\u3059\""; si = s.begin(); ASSERT_TRUE(epee::misc_utils::parse::match_string(si, s.cend(), bs)); ASSERT_EQ(bs, "あまやかす");
 }
+
+namespace
+{
+  struct direct_json_test
+  {
+    std::optional<uint64_t> height;
+    std::vector<uint64_t> heights;
+    std::string hash;
+    bool flag;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(height)
+      KV_SERIALIZE(heights)
+      KV_SERIALIZE(hash)
+      KV_SERIALIZE_OPT(flag, false)
+    END_KV_SERIALIZE_MAP()
+
+    void load_direct_json(epee::serialization::direct_json_reader& in)
+    {
+      height.reset();
+      heights.clear();
+      flag = false;
+      while (auto key = in.next_key())
+      {
+        if (in.read_null()) continue;
+        if (*key == "height") height = in.read_integer<uint64_t>();
+        else if (*key == "heights") in.read_array([&] { heights.push_back(in.read_integer<uint64_t>()); });
+        else if (*key == "hash") hash = in.read_string();
+        else if (*key == "flag") flag = in.read_bool();
+        else in.skip();
+      }
+    }
+
+    bool operator==(const direct_json_test& o) const
+    {
+      return height == o.height && heights == o.heights && hash == o.hash && flag == o.flag;
+    }
+  };
+}
+
+TEST(parsing, direct_json)
+{
+  using namespace std::literals;
+
+  // Each of these must load directly, to the same as the generic parser gives
+  for (std::string_view json : {
+      ""sv,
+      " \n "sv,
+      "{}"sv,
+      R"({"height": 123, "flag": true})"sv,
+      R"({ "heights" : [1, 2,3], "hash": "abc", "flag": false } )"sv,
+      R"({"height": null, "heights": [], "hash": ""})"sv,
+      R"({"extra": {"a": [{"b": -1}, {}], "c": ["x", "y"], "d": [-1, -2], "e": null}, "height": 18446744073709551615})"sv})
+  {
+    direct_json_test direct{}, generic{};
+    EXPECT_TRUE(epee::serialization::load_direct_json(direct, json)) << json;
+    epee::serialization::portable_storage ps;
+    ASSERT_TRUE(ps.load_from_json(json)) << json;
+    ASSERT_TRUE(generic.load(ps)) << json;
+    EXPECT_EQ(direct, generic) << json;
+  }
+
+  // And these (which the generic parser may or may not accept) have to be left to it
+  for (std::string_view json : {
+      R"({"hash": "a\"b"})"sv,
+      R"({"height": 1.5})"sv,
+      R"({"height": -1})"sv,
+      R"({"height": 18446744073709551616})"sv,
+      R"({"height": "5"})"sv,
+      R"({"height": 1, "height": 2})"sv,
+      R"({"height": 1,})"sv,
+      R"({"height": 1} x)"sv,
+      R"({"extra": [1, -1]})"sv,
+      R"({"extra": [true]})"sv,
+      R"({"extra": [[1]]})"sv,
+      R"({"extra": nil})"sv,
+      R"([1])"sv})
+  {
+    direct_json_test direct{};
+    EXPECT_FALSE(epee::serialization::load_direct_json(direct, json)) << json;
+  }
+}
@@ -127,3 +127,22 @@ TEST(hashchain, trim)
   ASSERT_FALSE(hashchain.empty());
   ASSERT_EQ(hashchain.genesis(), make_hash(1));
 }
+
+TEST(hashchain, swap_hashes)
+{
+  tools::hashchain hashchain;
+  hashchain.push_back(make_hash(1));
+  hashchain.push_back(make_hash(2));
+  hashchain.push_back(make_hash(3));
+  hashchain.trim(1);
+  std::deque<crypto::hash> hashes;
+  hashchain.swap_hashes(hashes);
+  ASSERT_EQ(hashes, (std::deque<crypto::hash>{make_hash(2), make_hash(3)}));
+  ASSERT_EQ(hashchain.offset(), 1);
+  ASSERT_EQ(hashchain.size(), 1);
+  ASSERT_EQ(hashchain.genesis(), make_hash(1));
+  hashchain.swap_hashes(hashes);
+  ASSERT_TRUE(hashes.empty());
+  ASSERT_EQ(hashchain.size(), 3);
+  ASSERT_EQ(hashchain[2], make_hash(3));
+}
@@ -0,0 +1,49 @@
+#include "gtest/gtest.h"
+
+#include "rpc/http_compression.h"
+
+using namespace cryptonote::rpc;
+
+TEST(http_compression, negotiate)
+{
+  EXPECT_EQ(negotiate_encoding(""), content_encoding::identity);
+  EXPECT_EQ(negotiate_encoding("identity"), content_encoding::identity);
+  EXPECT_EQ(negotiate_encoding("br, deflate"), content_encoding::identity);
+  EXPECT_EQ(negotiate_encoding("*;q=0"), content_encoding::identity);
+  EXPECT_EQ(negotiate_encoding("gzip;q=0, zstd;q=0.000, *"), content_encoding::identity);
+
+  // Which of these we get depends on what the build supports, but never one the client refused
+  auto enc = negotiate_encoding("gzip, deflate, br");
+  EXPECT_TRUE(enc == content_encoding::gzip || enc == content_encoding::identity);
+  enc = negotiate_encoding("zstd;q=0, GZip ; Q=0.5");
+  EXPECT_TRUE(enc == content_encoding::gzip || enc == content_encoding::identity);
+  enc = negotiate_encoding("gzip;q=0, *");
+  EXPECT_NE(enc, content_encoding::gzip);
+}
+
+TEST(http_compression, cache)
+{
+  compressed_response_cache cache;
+  std::vector<std::string> body{"{\"status\":", std::string(5000, 'x'), "\"OK\"}"};
+  std::string joined;
+  for (auto& piece : body)
+    joined += piece;
+  const std::vector<std::string> compressed{"abc", "def"};
+
+  EXPECT_FALSE(cache.find(content_encoding::gzip, body));
+  cache.insert(content_encoding::gzip, joined, compressed);
+
+  auto found = cache.find(content_encoding::gzip, body);
+  ASSERT_TRUE(found);
+  EXPECT_EQ(*found, compressed);
+  // Piece boundaries don't matter, only the content
+  EXPECT_TRUE(cache.find(content_encoding::gzip, {joined}));
+  EXPECT_FALSE(cache.find(content_encoding::zstd, body));
+
+  // Same size and ends, different middle
+  auto other = body;
+  other[1][2500] = 'y';
+  EXPECT_FALSE(cache.find(content_encoding::gzip, other));
+  other.pop_back();
+  EXPECT_FALSE(cache.find(content_encoding::gzip, other));
+}
@@ -0,0 +1,62 @@
+#include "gtest/gtest.h"
+
+#include "cryptonote_core/incoming_tx_cache.h"
+
+using cryptonote::incoming_tx_cache;
+
+static crypto::hash make_hash(uint8_t n, uint8_t shard = 0)
+{
+  crypto::hash h{};
+  h.data[0] = shard;
+  h.data[1] = n;
+  return h;
+}
+
+TEST(incoming_tx_cache, add_and_reject)
+{
+  incoming_tx_cache cache{1000};
+  auto blob = incoming_tx_cache::blob_hash("abc");
+  EXPECT_NE(blob, incoming_tx_cache::blob_hash("abd"));
+  EXPECT_FALSE(cache.find(blob));
+
+  cache.add(blob, make_hash(1));
+  auto e = cache.find(blob);
+  ASSERT_TRUE(e);
+  EXPECT_EQ(e->tx_hash, make_hash(1));
+  EXPECT_FALSE(e->rejected);
+
+  cache.reject(blob, make_hash(1));
+  e = cache.find(blob);
+  ASSERT_TRUE(e);
+  EXPECT_TRUE(e->rejected);
+
+  // A blob once rejected stays rejected
+  cache.add(blob, make_hash(1));
+  EXPECT_TRUE(cache.find(blob)->rejected);
+
+  cache.clear();
+  EXPECT_FALSE(cache.find(blob));
+}
+
+TEST(incoming_tx_cache, generations)
+{
+  // 16 shards, two generations: 2 entries per generation per shard
+  incoming_tx_cache cache{64};
+  cache.add(make_hash(1), make_hash(1));
+  cache.add(make_hash(2), make_hash(2)); // fills the first generation; 1 and 2 become the old one
+  cache.add(make_hash(3), make_hash(3));
+  EXPECT_TRUE(cache.find(make_hash(1)));
+  EXPECT_TRUE(cache.find(make_hash(2)));
+  EXPECT_TRUE(cache.find(make_hash(3)));
+
+  // Refreshing 1 moves it into the new generation, so it survives the next rotation, but 2 doesn't
+  cache.add(make_hash(1), make_hash(1));
+  EXPECT_TRUE(cache.find(make_hash(1)));
+  EXPECT_FALSE(cache.find(make_hash(2)));
+  EXPECT_TRUE(cache.find(make_hash(3)));
+
+  // Other shards are unaffected
+  cache.add(make_hash(1, 1), make_hash(1, 1));
+  EXPECT_TRUE(cache.find(make_hash(1, 1)));
+  EXPECT_TRUE(cache.find(make_hash(3)));
+}
@@ -0,0 +1,40 @@
+#include "gtest/gtest.h"
+
+#include <random>
+#include <vector>
+#include "blockchain_db/key_image_filter.h"
+
+static std::vector<crypto::key_image> random_key_images(size_t count, uint64_t seed)
+{
+  std::mt19937_64 rng{seed};
+  std::vector<crypto::key_image> result(count);
+  for (auto& ki : result)
+    for (auto& c : ki.data)
+      c = static_cast<char>(rng());
+  return result;
+}
+
+TEST(key_image_filter, no_false_negatives)
+{
+  cryptonote::key_image_filter filter{1000};
+  auto kis = random_key_images(5000, 1); // also past capacity
+  for (auto& ki : kis)
+    filter.insert(ki);
+  EXPECT_EQ(filter.size(), 5000);
+  for (auto& ki : kis)
+    ASSERT_TRUE(filter.maybe_contains(ki));
+}
+
+TEST(key_image_filter, false_positive_rate)
+{
+  constexpr size_t capacity = 100000;
+  cryptonote::key_image_filter filter{capacity};
+  for (auto& ki : random_key_images(capacity, 2))
+    filter.insert(ki);
+
+  size_t false_positives = 0;
+  for (auto& ki : random_key_images(capacity, 3))
+    false_positives += filter.maybe_contains(ki);
+  // ~0.1% expected at 16 bits per key image
+  EXPECT_LT(false_positives, capacity / 200);
+}
@@ -120,13 +120,14 @@ namespace
         epee::levin::async_protocol_handler<cryptonote::levin::detail::p2p_context> handler_;
 
     public:
-        test_connection(boost::asio::io_service& io_service, cryptonote::levin::connections& connections, boost::uuids::random_generator& random_generator, const bool is_incoming)
+        test_connection(boost::asio::io_service& io_service, cryptonote::levin::connections& connections, boost::uuids::random_generator& random_generator, const bool is_incoming, const uint32_t support_flags = 0)
           : endpoint_(io_service),
             context_(),
             handler_(std::addressof(endpoint_), connections, context_)
         {
             using base_type = epee::net_utils::connection_context_base;
             static_cast<base_type&>(context_) = base_type{random_generator(), {}, is_incoming};
+            context_.support_flags = support_flags;
             handler_.after_init_connection();
         }
 
@@ -264,9 +265,9 @@ namespace
             EXPECT_EQ(0u, receiver_.notified_size());
         }
 
-        void add_connection(const bool is_incoming)
+        void add_connection(const bool is_incoming, const uint32_t support_flags = 0)
         {
-            contexts_.emplace_back(io_service_, *connections_, random_generator_, is_incoming);
+            contexts_.emplace_back(io_service_, *connections_, random_generator_, is_incoming, support_flags);
             EXPECT_TRUE(connection_ids_.emplace(contexts_.back().get_id()).second);
             EXPECT_EQ(connection_ids_.size(), connections_->get_connections_count());
         }
@@ -504,6 +505,50 @@ TEST_F(levin_notify, flood)
     }
 }
 
+TEST_F(levin_notify, flood_announce)
+{
+    cryptonote::levin::notify notifier = make_notifier(0, true);
+
+    for (unsigned count = 0; count < 10; ++count)
+        add_connection(count % 2 == 0, count < 6 ? P2P_SUPPORT_FLAG_TX_ANNOUNCE : 0);
+
+    std::vector<cryptonote::blobdata> txs(2);
+    txs[0].resize(200, 'e');
+    txs[1].resize(100, 'f');
+    std::vector<crypto::hash> hashes(2);
+    hashes[0].data[0] = 'e';
+    hashes[1].data[0] = 'f';
+
+    ASSERT_EQ(10u, contexts_.size());
+    {
+        auto context = contexts_.begin();
+        EXPECT_TRUE(notifier.send_txs({txs[1], txs[0]}, context->get_id(), false, {hashes[1], hashes[0]}));
+        EXPECT_TRUE(notifier.send_txs({txs[0]}, context->get_id(), false, {hashes[0]}));
+
+        // Peers without the flag get the txs right away, the others nothing yet
+        io_service_.reset();
+        ASSERT_LT(0u, io_service_.poll());
+        for (unsigned count = 0; count < 10; ++count, ++context)
+            EXPECT_EQ(count < 6 ? 0u : 2u, context->process_send_queue());
+        ASSERT_EQ(8u, receiver_.notified_size());
+        for (unsigned count = 0; count < 4; ++count)
+        {
+            EXPECT_EQ(txs, receiver_.get_notification<cryptonote::NOTIFY_NEW_TRANSACTIONS>().second.txs);
+            EXPECT_EQ(std::vector<cryptonote::blobdata>{txs[0]}, receiver_.get_notification<cryptonote::NOTIFY_NEW_TRANSACTIONS>().second.txs);
+        }
+
+        // ... until the batch of hashes goes to the others (except the source), in one message
+        io_service_.reset();
+        ASSERT_EQ(1u, io_service_.run_one());
+        context = contexts_.begin();
+        for (unsigned count = 0; count < 10; ++count, ++context)
+            EXPECT_EQ(count > 0 && count < 6 ? 1u : 0u, context->process_send_queue());
+        ASSERT_EQ(5u, receiver_.notified_size());
+        for (unsigned count = 0; count < 5; ++count)
+            EXPECT_EQ((std::vector<crypto::hash>{hashes[0], hashes[1], hashes[0]}), receiver_.get_notification<cryptonote::NOTIFY_NEW_TX_HASHES>().second.txs);
+    }
+}
+
 TEST_F(levin_notify, private_flood)
 {
     cryptonote::levin::notify notifier = make_notifier(0, false);
@@ -659,3 +704,55 @@ TEST_F(levin_notify, noise)
         }
     }
 }
+
+TEST_F(levin_notify, noise_batched)
+{
+    for (unsigned count = 0; count < 10; ++count)
+        add_connection(count % 2 == 0);
+
+    std::vector<cryptonote::blobdata> txs(2);
+    txs[0].resize(500, 'z');
+    txs[1].resize(500, 'a');
+
+    const boost::uuids::uuid incoming_id = random_generator_();
+    cryptonote::levin::notify notifier = make_notifier(2048, false);
+
+    ASSERT_LT(0u, io_service_.poll());
+    {
+        const auto status = notifier.get_status();
+        EXPECT_TRUE(status.has_noise);
+        EXPECT_TRUE(status.connections_filled);
+    }
+
+    // txs queued before a channel next sends go out together, in one notification
+    EXPECT_TRUE(notifier.send_txs({txs[0]}, incoming_id, false));
+    EXPECT_TRUE(notifier.send_txs({txs[1]}, incoming_id, false));
+    notifier.run_stems();
+    io_service_.reset();
+    ASSERT_LT(0u, io_service_.poll());
+    {
+        std::size_t sent = 0;
+        for (auto& context : contexts_)
+            sent += context.process_send_queue();
+
+        ASSERT_EQ(2u, sent);
+        while (sent--)
+        {
+            auto notification = receiver_.get_notification<cryptonote::NOTIFY_NEW_TRANSACTIONS>().second;
+            EXPECT_EQ((std::vector<cryptonote::blobdata>{txs[1], txs[0]}), notification.txs);
+            EXPECT_TRUE(notification._.empty());
+        }
+    }
+
+    notifier.run_stems();
+    io_service_.reset();
+    ASSERT_LT(0u, io_service_.poll());
+    {
+        std::size_t sent = 0;
+        for (auto& context : contexts_)
+            sent += context.process_send_queue();
+
+        EXPECT_EQ(2u, sent);
+        EXPECT_EQ(0u, receiver_.notified_size());
+    }
+}
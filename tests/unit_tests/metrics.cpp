@@ -0,0 +1,114 @@
+#include "gtest/gtest.h"
+
+#include "common/cache_budget.h"
+#include "common/metrics.h"
+
+using tools::metrics::histogram;
+
+TEST(metrics, histogram_buckets)
+{
+  // Small values are exact
+  for (uint64_t v = 0; v < histogram::SUB_BUCKETS; v++)
+  {
+    ASSERT_EQ(histogram::bucket_index(v), v);
+    ASSERT_EQ(histogram::bucket_lower_bound(v), v);
+  }
+
+  // Every value falls within its bucket, and the bucket is no wider than 1/SUB_BUCKETS of it
+  for (uint64_t v : {16ull, 17ull, 31ull, 32ull, 33ull, 1000ull, 123456789ull, 1ull << 40, (1ull << 45) + 12345})
+  {
+    size_t i = histogram::bucket_index(v);
+    ASSERT_LT(i, histogram::NUM_BUCKETS);
+    ASSERT_LE(histogram::bucket_lower_bound(i), v);
+    ASSERT_GT(histogram::bucket_lower_bound(i) + histogram::bucket_width(i), v);
+    ASSERT_LE(histogram::bucket_width(i) * histogram::SUB_BUCKETS, v);
+  }
+
+  // Bucket indices are monotonic
+  for (size_t i = 1; i < histogram::NUM_BUCKETS; i++)
+    ASSERT_EQ(histogram::bucket_lower_bound(i - 1) + histogram::bucket_width(i - 1), histogram::bucket_lower_bound(i));
+
+  // Huge values are clamped into the last bucket
+  ASSERT_EQ(histogram::bucket_index(UINT64_MAX), histogram::NUM_BUCKETS - 1);
+}
+
+TEST(metrics, histogram_quantiles)
+{
+  histogram h;
+  ASSERT_EQ(h.quantile(0.5), 0);
+
+  for (uint64_t v = 1; v <= 1000; v++)
+    h.record(v * 1000);
+
+  ASSERT_EQ(h.count(), 1000);
+  ASSERT_EQ(h.sum(), 500500 * 1000);
+  ASSERT_EQ(h.max(), 1000000);
+
+  auto near = [](uint64_t actual, uint64_t expected) {
+    return actual >= expected - expected / histogram::SUB_BUCKETS && actual <= expected + expected / histogram::SUB_BUCKETS;
+  };
+  ASSERT_TRUE(near(h.quantile(0.5), 500000));
+  ASSERT_TRUE(near(h.quantile(0.99), 990000));
+  ASSERT_LE(h.quantile(1.0), h.max());
+}
+
+TEST(metrics, prometheus_output)
+{
+  auto& h = tools::metrics::get_histogram("unit_test_timer", "unit.tests");
+  ASSERT_EQ(&h, &tools::metrics::get_histogram("unit_test_timer", "unit.tests"));
+  h.record(2'000'000);
+  tools::metrics::get_counter("unit_test_event", "unit.tests").inc(3);
+
+  std::string out = tools::metrics::prometheus();
+  EXPECT_NE(out.find("# TYPE oxen_perf_timer_seconds summary\n"), std::string::npos);
+  EXPECT_NE(out.find("oxen_perf_timer_seconds_count{category=\"unit.tests\",timer=\"unit_test_timer\"} 1\n"), std::string::npos);
+  EXPECT_NE(out.find("oxen_perf_timer_seconds{category=\"unit.tests\",timer=\"unit_test_timer\",quantile=\"0.99\"} "), std::string::npos);
+  EXPECT_NE(out.find("oxen_events_total{category=\"unit.tests\",event=\"unit_test_event\"} 3\n"), std::string::npos);
+}
+
+TEST(metrics, cache_budget)
+{
+  namespace cb = tools::cache_budget;
+  std::vector<std::string> evicted;
+  size_t low_size = 600, high_size = 500;
+  cb::handle low, high, fixed;
+  low = cb::add("unit_test_low", 1, [&](size_t bytes) {
+    evicted.push_back("low");
+    low_size -= std::min(bytes, low_size);
+    low.set_size(low_size);
+  });
+  high = cb::add("unit_test_high", 2, [&](size_t) {
+    evicted.push_back("high");
+    high_size = 0;
+    high.set_size(0);
+  });
+  fixed = cb::add("unit_test_fixed", 0, nullptr);
+  low.set_size(low_size);
+  high.set_size(high_size);
+  fixed.set_size(100);
+  ASSERT_EQ(cb::total(), 1200);
+
+  // No limit by default
+  ASSERT_EQ(cb::enforce(), 0);
+
+  // The lowest priority evictable cache goes first, and is only asked for what's needed
+  cb::set_limit(1000);
+  ASSERT_EQ(cb::enforce(), 200);
+  ASSERT_EQ(evicted, std::vector<std::string>{"low"});
+  ASSERT_EQ(low.size(), 400);
+  ASSERT_EQ(tools::metrics::get_gauge("unit_test_low", "cache_bytes").value(), 400);
+
+  // Then the next one once the first is empty; the unevictable one is never asked
+  cb::set_limit(50);
+  ASSERT_EQ(cb::enforce(), 900);
+  ASSERT_EQ(evicted, (std::vector<std::string>{"low", "low", "high"}));
+  ASSERT_EQ(cb::total(), 100);
+
+  fixed.reset();
+  ASSERT_EQ(cb::total(), 0);
+  auto caches = cb::caches();
+  ASSERT_EQ(caches.size(), 2);
+  ASSERT_EQ(caches[0].name, "unit_test_low");
+  ASSERT_TRUE(caches[1].evictable);
+  cb::set_limit(0);
+}
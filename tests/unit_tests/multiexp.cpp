@@ -31,6 +31,7 @@
 #include "crypto/crypto.h"
 #include "ringct/rctOps.h"
 #include "ringct/multiexp.h"
+#include "ringct/multiexp_backend.h"
 
 namespace {
 
@@ -327,3 +328,71 @@ TEST(multiexp, scalarmult_triple)
     }
   }
 }
+
+namespace {
+
+// A backend answering with straus(), or with garbage if `wrong` is set
+struct test_backend : rct::multiexp_backend
+{
+  std::string m_name;
+  bool wrong;
+  size_t calls = 0;
+  test_backend(std::string name, bool wrong) : m_name{std::move(name)}, wrong{wrong} {}
+  std::string name() const override { return m_name; }
+  size_t min_size() const override { return 4; }
+  std::optional<rct::key> multiexp(const std::vector<rct::MultiexpData> &data) override
+  {
+    calls++;
+    return wrong ? rct::skGen() : straus(data);
+  }
+};
+
+std::vector<rct::MultiexpData> random_terms(size_t n)
+{
+  std::vector<rct::MultiexpData> data;
+  for (size_t i = 0; i < n; ++i)
+    data.push_back({rct::skGen(), get_p3(rct::scalarmultBase(rct::skGen()))});
+  return data;
+}
+
+}
+
+TEST(multiexp, backend_selection)
+{
+  auto backend = std::make_shared<test_backend>("test-good", false);
+  rct::register_multiexp_backend(backend);
+  ASSERT_THROW(rct::register_multiexp_backend(std::make_shared<test_backend>("test-good", false)), std::invalid_argument);
+  ASSERT_THROW(rct::select_multiexp_backend("no-such-backend", 0), std::invalid_argument);
+
+  rct::select_multiexp_backend("test-good", 1);
+  ASSERT_EQ(rct::selected_multiexp_backend(), "test-good");
+
+  auto data = random_terms(8);
+  ASSERT_TRUE(rct::backend_multiexp(data, [&] { return basic(data); }) == basic(data));
+  ASSERT_EQ(backend->calls, 1);
+
+  // Too small for the backend: stays on the CPU
+  auto small = random_terms(2);
+  ASSERT_TRUE(rct::backend_multiexp(small, [&] { return basic(small); }) == basic(small));
+  ASSERT_EQ(backend->calls, 1);
+
+  rct::select_multiexp_backend("cpu", 0);
+  ASSERT_EQ(rct::selected_multiexp_backend(), "cpu");
+  ASSERT_TRUE(rct::backend_multiexp(data, [&] { return basic(data); }) == basic(data));
+  ASSERT_EQ(backend->calls, 1);
+}
+
+TEST(multiexp, backend_mismatch_drops_backend)
+{
+  auto backend = std::make_shared<test_backend>("test-wrong", true);
+  rct::register_multiexp_backend(backend);
+  rct::select_multiexp_backend("test-wrong", 1);
+
+  auto data = random_terms(8);
+  ASSERT_TRUE(rct::backend_multiexp(data, [&] { return basic(data); }) == basic(data));
+  ASSERT_EQ(backend->calls, 1);
+  ASSERT_EQ(rct::selected_multiexp_backend(), "cpu");
+
+  ASSERT_TRUE(rct::backend_multiexp(data, [&] { return basic(data); }) == basic(data));
+  ASSERT_EQ(backend->calls, 1);
+}
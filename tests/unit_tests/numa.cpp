@@ -0,0 +1,31 @@
+#include <stdexcept>
+#include "gtest/gtest.h"
+#include "common/numa.h"
+
+TEST(numa, parse_list)
+{
+  using tools::numa::parse_list;
+  EXPECT_EQ(parse_list(""), std::vector<int>{});
+  EXPECT_EQ(parse_list("0"), std::vector<int>{0});
+  EXPECT_EQ(parse_list("0-3"), (std::vector<int>{0, 1, 2, 3}));
+  EXPECT_EQ(parse_list("8-9,0,2"), (std::vector<int>{0, 2, 8, 9}));
+  EXPECT_EQ(parse_list("1,0-2"), (std::vector<int>{0, 1, 2}));
+  EXPECT_THROW(parse_list("a"), std::invalid_argument);
+  EXPECT_THROW(parse_list("0,"), std::invalid_argument);
+  EXPECT_THROW(parse_list("3-1"), std::invalid_argument);
+  EXPECT_THROW(parse_list("-1"), std::invalid_argument);
+  EXPECT_THROW(parse_list("1-"), std::invalid_argument);
+}
+
+TEST(numa, placement)
+{
+  using namespace tools::numa;
+  EXPECT_THROW(set_nodes(role::p2p, {1 << 20}), std::invalid_argument);
+  EXPECT_TRUE(place_current_thread(role::p2p)); // nothing set: nothing to do
+  EXPECT_FALSE(describe().empty());
+  if (nodes().empty())
+    return;
+  set_nodes(role::p2p, {nodes().front().id});
+  EXPECT_NE(describe().find("p2p threads on node(s) " + std::to_string(nodes().front().id)), std::string::npos);
+  set_nodes(role::p2p, {});
+}
@@ -0,0 +1,66 @@
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include "blockchain_db/parsed_block_cache.h"
+
+using cryptonote::parsed_block_cache;
+
+static crypto::hash make_hash(uint64_t n)
+{
+  crypto::hash h{};
+  std::memcpy(h.data, &n, sizeof(n));
+  return h;
+}
+
+static std::shared_ptr<const cryptonote::block> make_block(uint64_t timestamp)
+{
+  auto b = std::make_shared<cryptonote::block>();
+  b->timestamp = timestamp;
+  return b;
+}
+
+TEST(parsed_block_cache, evicts_least_recently_used)
+{
+  parsed_block_cache cache{3, 0};
+  for (uint64_t i = 0; i < 3; i++)
+    cache.add_block(make_hash(i), make_block(i), 100);
+  ASSERT_TRUE(cache.find_block(make_hash(0))); // now the most recently used
+
+  cache.add_block(make_hash(3), make_block(3), 100);
+  EXPECT_EQ(cache.num_blocks(), 3);
+  EXPECT_FALSE(cache.find_block(make_hash(1)));
+  ASSERT_TRUE(cache.find_block(make_hash(0)));
+  EXPECT_EQ(cache.find_block(make_hash(0))->timestamp, 0);
+  EXPECT_EQ(cache.find_block(make_hash(3))->timestamp, 3);
+  EXPECT_EQ(cache.bytes(), 300);
+
+  // Disabled tx side
+  cache.add_tx(make_hash(0), std::make_shared<cryptonote::transaction>(), 100);
+  EXPECT_EQ(cache.num_txs(), 0);
+}
+
+TEST(parsed_block_cache, remove_and_evict)
+{
+  parsed_block_cache cache{10, 10};
+  for (uint64_t i = 0; i < 4; i++)
+  {
+    cache.add_block(make_hash(i), make_block(i), 100);
+    cache.add_tx(make_hash(i), std::make_shared<cryptonote::transaction>(), 10);
+  }
+  cache.remove_block(make_hash(2));
+  cache.remove_tx(make_hash(2));
+  EXPECT_FALSE(cache.find_block(make_hash(2)));
+  EXPECT_FALSE(cache.find_tx(make_hash(2)));
+  EXPECT_EQ(cache.bytes(), 330);
+
+  // Txs go first, then the oldest blocks
+  cache.evict(30);
+  EXPECT_EQ(cache.num_txs(), 0);
+  EXPECT_EQ(cache.num_blocks(), 3);
+  cache.evict(150);
+  EXPECT_EQ(cache.num_blocks(), 1);
+  EXPECT_TRUE(cache.find_block(make_hash(3)));
+
+  cache.clear();
+  EXPECT_EQ(cache.bytes(), 0);
+}
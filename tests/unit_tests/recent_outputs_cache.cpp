@@ -0,0 +1,90 @@
+#include "gtest/gtest.h"
+
+#include "cryptonote_core/recent_outputs_cache.h"
+
+using cryptonote::recent_outputs_cache;
+
+// Outputs whose height is their index, to check which one came back
+static std::vector<recent_outputs_cache::output> make_outputs(uint64_t first, size_t count)
+{
+  std::vector<recent_outputs_cache::output> outputs(count);
+  for (size_t i = 0; i < count; i++)
+    outputs[i].data.height = first + i;
+  return outputs;
+}
+
+static std::vector<std::optional<uint64_t>> heights(const recent_outputs_cache& cache, const std::vector<uint64_t>& indices)
+{
+  std::vector<std::optional<uint64_t>> result;
+  for (auto& o : cache.find(indices))
+    result.push_back(o ? std::optional<uint64_t>{o->data.height} : std::nullopt);
+  return result;
+}
+
+TEST(recent_outputs_cache, append_and_find)
+{
+  recent_outputs_cache cache{10};
+  EXPECT_EQ(cache.size(), 0);
+  EXPECT_EQ(heights(cache, {0}), (std::vector<std::optional<uint64_t>>{std::nullopt}));
+
+  cache.append(100, make_outputs(100, 4));
+  cache.append(104, make_outputs(104, 3));
+  EXPECT_EQ(cache.size(), 7);
+  EXPECT_EQ(cache.end_index(), 107);
+  EXPECT_EQ(heights(cache, {99, 100, 106, 107, 103}),
+      (std::vector<std::optional<uint64_t>>{std::nullopt, 100, 106, std::nullopt, 103}));
+
+  // Over the maximum: the oldest go
+  cache.append(107, make_outputs(107, 5));
+  EXPECT_EQ(cache.size(), 10);
+  EXPECT_EQ(heights(cache, {101, 102, 111}), (std::vector<std::optional<uint64_t>>{std::nullopt, 102, 111}));
+
+  // A batch larger than the whole cache keeps its last outputs
+  cache.append(112, make_outputs(112, 25));
+  EXPECT_EQ(cache.size(), 10);
+  EXPECT_EQ(heights(cache, {126, 127, 136}), (std::vector<std::optional<uint64_t>>{std::nullopt, 127, 136}));
+
+  // A gap restarts the cache
+  cache.append(200, make_outputs(200, 2));
+  EXPECT_EQ(cache.size(), 2);
+  EXPECT_EQ(heights(cache, {136, 200, 201}), (std::vector<std::optional<uint64_t>>{std::nullopt, 200, 201}));
+}
+
+TEST(recent_outputs_cache, truncate)
+{
+  recent_outputs_cache cache{100};
+  cache.append(50, make_outputs(50, 20));
+
+  // Popping a block with outputs 65-69, then adding one whose outputs reuse those indices
+  cache.truncate(65);
+  EXPECT_EQ(cache.end_index(), 65);
+  EXPECT_EQ(heights(cache, {64, 65}), (std::vector<std::optional<uint64_t>>{64, std::nullopt}));
+  auto replacement = make_outputs(1065, 3);
+  cache.append(65, replacement);
+  EXPECT_EQ(heights(cache, {65, 67, 68}), (std::vector<std::optional<uint64_t>>{1065, 1067, std::nullopt}));
+
+  cache.truncate(1000);
+  EXPECT_EQ(cache.size(), 18);
+  cache.truncate(50);
+  EXPECT_EQ(cache.size(), 0);
+}
+
+TEST(recent_outputs_cache, shrink)
+{
+  recent_outputs_cache cache{100};
+  cache.append(0, make_outputs(0, 50));
+  cache.drop_oldest(20);
+  EXPECT_EQ(cache.size(), 30);
+  EXPECT_EQ(heights(cache, {19, 20}), (std::vector<std::optional<uint64_t>>{std::nullopt, 20}));
+  // Appending carries on from where it was
+  cache.append(50, make_outputs(50, 1));
+  EXPECT_EQ(cache.end_index(), 51);
+
+  cache.set_max_outputs(5);
+  EXPECT_EQ(heights(cache, {45, 46, 50}), (std::vector<std::optional<uint64_t>>{std::nullopt, 46, 50}));
+
+  cache.set_max_outputs(0);
+  EXPECT_EQ(cache.size(), 0);
+  cache.append(51, make_outputs(51, 1));
+  EXPECT_EQ(cache.size(), 0);
+}
@@ -204,6 +204,39 @@ TEST(ringct, CLSAG)
   ASSERT_TRUE(rct::verRctCLSAGSimple(message,clsag,pubs,Cout));
 }
 
+TEST(ringct, CLSAG_ring_sizes)
+{
+  // The verifier keeps its hashing scratch on the stack for small rings and on the heap for larger
+  // ones; check both sides of that
+  for (size_t N : {1, 2, 16, 17, 40})
+  {
+    const size_t idx = N / 2;
+    const key message = skGen();
+    ctkeyV pubs(N);
+    key sk;
+    for (auto& pub : pubs)
+    {
+      skpkGen(sk, pub.dest);
+      skpkGen(sk, pub.mask);
+    }
+    ctkey insk;
+    skpkGen(insk.dest, pubs[idx].dest);
+    insk.mask = skGen();
+    key u = skGen();
+    addKeys2(pubs[idx].mask, insk.mask, u, H);
+    key Cout;
+    key t2 = skGen();
+    addKeys2(Cout, t2, u, H);
+
+    clsag sig = rct::proveRctCLSAGSimple(message,pubs,insk,t2,Cout,NULL,NULL,NULL,idx,hw::get_device("default"));
+    ASSERT_TRUE(rct::verRctCLSAGSimple(message,sig,pubs,Cout)) << "ring size " << N;
+    ASSERT_FALSE(rct::verRctCLSAGSimple(skGen(),sig,pubs,Cout)) << "ring size " << N;
+    pubs[N-1].mask = scalarmultBase(skGen());
+    if (N - 1 != idx)
+      ASSERT_FALSE(rct::verRctCLSAGSimple(message,sig,pubs,Cout)) << "ring size " << N;
+  }
+}
+
 TEST(ringct, range_proofs)
 {
   //Ring CT Stuff
@@ -131,6 +131,24 @@ TEST(ringdb, different_genesis)
   ASSERT_FALSE(ringdb.get_ring(get_context().KEY_2, get_context().KEY_IMAGE_1, outs2));
 }
 
+TEST(ringdb, batch)
+{
+  RingDB ringdb;
+  std::vector<uint64_t> outs, outs2;
+  outs.push_back(43); outs.push_back(7320); outs.push_back(8429);
+  ringdb.begin_batch();
+  ASSERT_TRUE(ringdb.set_ring(get_context().KEY_1, get_context().KEY_IMAGE_1, outs, false));
+  ASSERT_TRUE(ringdb.get_ring(get_context().KEY_1, get_context().KEY_IMAGE_1, outs2));
+  ASSERT_EQ(outs, outs2);
+  ringdb.end_batch();
+  ringdb.close();
+
+  tools::ringdb reopened(ringdb.filename(), "");
+  outs2.clear();
+  ASSERT_TRUE(reopened.get_ring(get_context().KEY_1, get_context().KEY_IMAGE_1, outs2));
+  ASSERT_EQ(outs, outs2);
+}
+
 TEST(spent_outputs, not_found)
 {
   RingDB ringdb;
@@ -0,0 +1,54 @@
+#include "gtest/gtest.h"
+
+#include <thread>
+#include <vector>
+#include "common/scratch.h"
+
+using vec_t = std::vector<int>;
+
+TEST(scratch, reuse)
+{
+  const int* data;
+  {
+    tools::scratch<vec_t> v;
+    v->assign(100, 1);
+    data = v->data();
+  }
+  {
+    tools::scratch<vec_t> v;
+    EXPECT_EQ(v->size(), 100); // not cleared...
+    v->clear();
+    EXPECT_EQ(v->data(), data); // ...and the allocation is kept
+    EXPECT_GE(v->capacity(), 100);
+
+    // A nested scratch gets its own object
+    tools::scratch<vec_t> w;
+    EXPECT_TRUE(w->empty());
+    EXPECT_NE(&*v, &*w);
+  }
+}
+
+TEST(scratch, release)
+{
+  {
+    tools::scratch<vec_t> v;
+    v->assign(10, 1);
+  }
+  tools::release_scratch();
+  tools::scratch<vec_t> v;
+  EXPECT_EQ(v->capacity(), 0);
+}
+
+TEST(scratch, per_thread)
+{
+  {
+    tools::scratch<vec_t> v;
+    v->assign(10, 1);
+  }
+  std::thread{[] {
+    tools::scratch<vec_t> v;
+    EXPECT_TRUE(v->empty());
+  }}.join();
+  tools::scratch<vec_t> v;
+  EXPECT_EQ(v->size(), 10);
+}
@@ -93,7 +93,7 @@ struct Blob
 
   constexpr bool operator==(const Blob& r) const
   {
-    return std::tie(a, b, c, d, e) == std::tie(r.a, r.b, r.c, r.d, r.d);
+    return std::tie(a, b, c, d, e) == std::tie(r.a, r.b, r.c, r.d, r.e);
   }
 };
 // If the type has padding then it isn't binary serializable:
@@ -128,6 +128,19 @@ TEST(serialization, binary_archive_integers_fixed) {
   ASSERT_EQ(x, x1);
 }
 
+TEST(serialization, json_archive) {
+  Struct1 s1;
+  s1.si.push_back(whatever::Struct{-1, 2147483647, {'\xde', '\xad', '\xbe', '\xef', 0, 1, 2, 3}});
+  s1.si.push_back(42);
+  s1.vi = {-32768, 0, 7};
+
+  std::string json = "prefix:";
+  serialization::json_archiver ar{json};
+  ASSERT_NO_THROW(serialization::serialize(ar, s1));
+  ASSERT_EQ(json, R"(prefix:{"si":[{"struct":{"a":-1,"b":2147483647,"blob":"deadbeef00010203"}},{"int":42}],"vi":[-32768,0,7]})");
+  ASSERT_EQ(ar.streampos(), json.size());
+}
+
 TEST(serialization, binary_archive_integers_variable) {
   uint64_t x = 0xff00000000, x1;
 
@@ -144,6 +157,22 @@ TEST(serialization, binary_archive_integers_variable) {
   ASSERT_EQ(x, x1);
 }
 
+TEST(serialization, binary_archive_truncated) {
+  uint64_t x;
+  std::string str;
+  std::string data = "\x01\x02\x03"s;
+  serialization::binary_string_unarchiver iar{data};
+  ASSERT_THROW(iar.serialize_int(x), std::runtime_error);
+
+  data = "\x80\x80"s; // varint with its continuation bit set on the last byte
+  serialization::binary_string_unarchiver iar2{data};
+  ASSERT_THROW(varint(iar2, x), std::runtime_error);
+
+  data = "\x05" "abc"s; // string claiming 5 bytes with only 3 present
+  serialization::binary_string_unarchiver iar3{data};
+  ASSERT_THROW(serialization::value(iar3, str), std::runtime_error);
+}
+
 TEST(serialization, custom_type_serialization) {
   Struct1 s1;
   s1.si.push_back(0);
@@ -284,6 +313,40 @@ TEST(serialization, serializes_vector_int64_as_fixed_int)
   ASSERT_EQ(57, blob.size());
 }
 
+TEST(serialization, serializes_vector_of_blobs_contiguously)
+{
+  std::vector<Blob> v;
+  std::string blob;
+
+  ASSERT_NO_THROW(blob = serialization::dump_binary(v));
+  ASSERT_EQ(oxenmq::to_hex(blob), "00");
+
+  v = {Blob{0x0102030405060708, 0x090a0b0c, 0x0d, 0x0e, 0x0f10}, Blob{1, 2, 3, 4, 5}};
+  ASSERT_NO_THROW(blob = serialization::dump_binary(v));
+  ASSERT_EQ(oxenmq::to_hex(blob),
+      "02"
+      "0807060504030201" "0c0b0a09" "0d" "0e" "100f"
+      "0100000000000000" "02000000" "03" "04" "0500");
+
+  std::vector<Blob> v1;
+  ASSERT_NO_THROW(serialization::parse_binary(blob, v1));
+  ASSERT_EQ(v, v1);
+
+  // A count that the remaining data can't hold fails without allocating for it
+  blob[0] = 0x03;
+  ASSERT_THROW(serialization::parse_binary(blob, v1), std::runtime_error);
+  blob = oxenmq::from_hex("ffffffffffffffff7f") + blob.substr(1);
+  ASSERT_THROW(serialization::parse_binary(blob, v1), std::runtime_error);
+
+  // Non-binary archives still serialize each element
+  std::vector<crypto::hash> hashes(2);
+  hashes[1].data[0] = 0xff;
+  std::string json;
+  serialization::json_archiver ar{json};
+  ASSERT_NO_THROW(serialization::serialize(ar, hashes));
+  ASSERT_EQ(json, "[\"" + std::string(64, '0') + "\",\"ff" + std::string(62, '0') + "\"]");
+}
+
 namespace
 {
   template<typename T>
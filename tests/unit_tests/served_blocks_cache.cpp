@@ -0,0 +1,63 @@
+#include "gtest/gtest.h"
+
+#include "cryptonote_core/served_blocks_cache.h"
+
+using cryptonote::served_blocks_cache;
+
+static crypto::hash make_hash(uint8_t n)
+{
+  crypto::hash h{};
+  h.data[0] = n;
+  return h;
+}
+
+static cryptonote::block_complete_entry make_block(size_t block_size, size_t tx_size)
+{
+  cryptonote::block_complete_entry block;
+  block.block.assign(block_size, 'b');
+  block.txs.emplace_back(tx_size, 't');
+  return block;
+}
+
+TEST(served_blocks_cache, find)
+{
+  served_blocks_cache cache{1000};
+  EXPECT_EQ(cache.find(make_hash(1)), nullptr);
+
+  cache.insert(make_hash(1), 42, make_block(100, 50));
+  auto* e = cache.find(make_hash(1));
+  ASSERT_NE(e, nullptr);
+  EXPECT_EQ(e->height, 42);
+  EXPECT_EQ(e->block.block.size(), 100);
+  ASSERT_EQ(e->block.txs.size(), 1);
+  EXPECT_EQ(e->block.txs[0].size(), 50);
+  EXPECT_EQ(cache.bytes(), 150);
+
+  cache.clear();
+  EXPECT_EQ(cache.find(make_hash(1)), nullptr);
+  EXPECT_EQ(cache.size(), 0);
+  EXPECT_EQ(cache.bytes(), 0);
+}
+
+TEST(served_blocks_cache, evicts_least_recently_used)
+{
+  served_blocks_cache cache{1000};
+  for (uint8_t i = 0; i < 4; i++)
+    cache.insert(make_hash(i), i, make_block(200, 50));
+  EXPECT_EQ(cache.size(), 4);
+  EXPECT_EQ(cache.bytes(), 1000);
+
+  // Using 0 makes 1 the oldest, so that's the one to go
+  EXPECT_NE(cache.find(make_hash(0)), nullptr);
+  cache.insert(make_hash(4), 4, make_block(100, 100));
+  EXPECT_EQ(cache.size(), 4);
+  EXPECT_EQ(cache.bytes(), 950);
+  EXPECT_EQ(cache.find(make_hash(1)), nullptr);
+  for (uint8_t i : {0, 2, 3, 4})
+    EXPECT_NE(cache.find(make_hash(i)), nullptr);
+
+  // Too big to ever fit
+  cache.insert(make_hash(5), 5, make_block(1000, 1));
+  EXPECT_EQ(cache.find(make_hash(5)), nullptr);
+  EXPECT_EQ(cache.size(), 4);
+}
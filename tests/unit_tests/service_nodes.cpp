@@ -30,6 +30,7 @@
 
 #include "gtest/gtest.h"
 #include "cryptonote_core/service_node_list.h"
+#include "cryptonote_core/uptime_proof.h"
 #include "cryptonote_core/service_node_voting.h"
 #include "cryptonote_core/cryptonote_tx_utils.h"
 #include "cryptonote_basic/cryptonote_basic.h"
@@ -552,3 +553,34 @@ TEST(service_nodes, service_node_get_locked_key_image_unlock_height)
     ASSERT_EQ(unlock_height, expected);
   }
 }
+
+TEST(service_nodes, proof_map)
+{
+  service_nodes::proof_map proofs;
+  std::vector<crypto::public_key> keys(40);
+  for (size_t i = 0; i < keys.size(); i++)
+    keys[i].data[0] = i;
+
+  ASSERT_FALSE(proofs.access(keys[0], [](const service_nodes::proof_info &) {}));
+  for (size_t i = 0; i < keys.size(); i++)
+    proofs.update(keys[i], [i](service_nodes::proof_info &proof) { proof.timestamp = i; });
+
+  for (size_t i = 0; i < keys.size(); i++)
+  {
+    uint64_t timestamp = 0;
+    ASSERT_TRUE(proofs.access(keys[i], [&](const service_nodes::proof_info &proof) { timestamp = proof.timestamp; }));
+    ASSERT_EQ(timestamp, i);
+  }
+
+  proofs.erase_if([](const crypto::public_key &, const service_nodes::proof_info &proof) { return proof.timestamp % 2; });
+  for (size_t i = 0; i < keys.size(); i++)
+    ASSERT_EQ(proofs.access(keys[i], [](const service_nodes::proof_info &) {}), i % 2 == 0);
+
+  std::unordered_map<crypto::public_key, service_nodes::proof_info> loaded;
+  loaded[keys[1]].timestamp = 123;
+  proofs.assign(std::move(loaded));
+  ASSERT_FALSE(proofs.access(keys[0], [](const service_nodes::proof_info &) {}));
+  uint64_t timestamp = 0;
+  ASSERT_TRUE(proofs.access(keys[1], [&](const service_nodes::proof_info &proof) { timestamp = proof.timestamp; }));
+  ASSERT_EQ(timestamp, 123);
+}
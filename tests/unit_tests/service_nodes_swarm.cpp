@@ -626,3 +626,34 @@ TEST(swarm_to_snodes, deterministic_swarm_ids)
   EXPECT_EQ(ids[5046], 18442592317803069438ULL);
   EXPECT_EQ(ids[5047], 18445442251942264830ULL);
 }
+
+TEST(swarm_index, closest)
+{
+  swarm_snode_map_t swarm_map;
+  for (swarm_id_t id : {100ULL, 200ULL, 1000ULL})
+    swarm_map[id] = {newPubKey()};
+  swarm_map[UNASSIGNED_SWARM_ID] = {newPubKey()};
+  auto index = make_swarm_index(swarm_map);
+  ASSERT_EQ(index->swarms.size(), 3);
+
+  EXPECT_EQ(index->closest(120)->id, 100);
+  EXPECT_EQ(index->closest(150)->id, 100); // ties go to the smaller id
+  EXPECT_EQ(index->closest(151)->id, 200);
+  EXPECT_EQ(index->closest(700)->id, 1000);
+  EXPECT_EQ(index->closest(0)->id, 100);
+  // Past the largest id, the distance wraps around to the smallest
+  EXPECT_EQ(index->closest(5000)->id, 1000);
+  EXPECT_EQ(index->closest(UINT64_MAX - 10)->id, 100);
+  EXPECT_EQ(index->closest(UINT64_MAX / 2)->id, 1000);
+
+  EXPECT_EQ(make_swarm_index({})->closest(123), nullptr);
+}
+
+TEST(swarm_index, pubkey_to_swarm_space)
+{
+  std::string pubkey(32, '\0');
+  pubkey[7] = 1;
+  pubkey[15] = 2;
+  pubkey[24] = 0x10;
+  EXPECT_EQ(pubkey_to_swarm_space(pubkey), 0x1000000000000003ULL);
+}
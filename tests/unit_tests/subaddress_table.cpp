@@ -0,0 +1,60 @@
+#include "gtest/gtest.h"
+
+#include <unordered_map>
+
+#include "crypto/random.h"
+#include "wallet/subaddress_table.h"
+
+TEST(subaddress_table, empty)
+{
+  tools::subaddress_table table;
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(table.find(crypto::rand<crypto::public_key>()), nullptr);
+}
+
+TEST(subaddress_table, insert_find)
+{
+  tools::subaddress_table table;
+  std::unordered_map<crypto::public_key, cryptonote::subaddress_index> keys;
+  for (uint32_t i = 0; i < 5000; ++i)
+  {
+    auto key = crypto::rand<crypto::public_key>();
+    cryptonote::subaddress_index index{i / 100, i % 100};
+    keys[key] = index;
+    table.insert(key, index);
+  }
+  ASSERT_EQ(table.size(), keys.size());
+  for (const auto& [key, index] : keys)
+  {
+    auto* found = table.find(key);
+    ASSERT_NE(found, nullptr);
+    EXPECT_EQ(*found, index);
+  }
+  for (int i = 0; i < 1000; ++i)
+    EXPECT_EQ(table.find(crypto::rand<crypto::public_key>()), nullptr);
+
+  // Re-inserting a key replaces its index
+  const auto& key = keys.begin()->first;
+  table.insert(key, {7, 7});
+  EXPECT_EQ(table.size(), keys.size());
+  EXPECT_EQ(*table.find(key), (cryptonote::subaddress_index{7, 7}));
+
+  table.clear();
+  EXPECT_TRUE(table.empty());
+  EXPECT_EQ(table.find(key), nullptr);
+}
+
+TEST(subaddress_table, same_first_bytes)
+{
+  // Keys that only differ after the 8 bytes used as the tag, and so are in the same probe chain
+  tools::subaddress_table table;
+  crypto::public_key a = crypto::rand<crypto::public_key>(), b = a, c = a;
+  b.data[31] ^= 1;
+  c.data[8] ^= 1;
+  table.insert(a, {0, 1});
+  table.insert(b, {0, 2});
+  ASSERT_EQ(table.size(), 2);
+  EXPECT_EQ(*table.find(a), (cryptonote::subaddress_index{0, 1}));
+  EXPECT_EQ(*table.find(b), (cryptonote::subaddress_index{0, 2}));
+  EXPECT_EQ(table.find(c), nullptr);
+}
@@ -71,6 +71,38 @@ TEST(peer_list, peer_list_general)
   ASSERT_EQ(plm.get_white_peers_count(), 4);
 }
 
+TEST(peer_list, peer_by_index)
+{
+  nodetool::peerlist_manager plm;
+  plm.init(nodetool::peerlist_types{}, false);
+  for (uint8_t i = 1; i <= 50; ++i)
+  {
+    nodetool::peerlist_entry ple;
+    ple.adr = MAKE_IPV4_ADDRESS(123,43,12,i, 8080);
+    ple.id = i;
+    ple.last_seen = 1000 + (i * 37) % 50; // distinct, but not inserted in time order
+    plm.append_with_peer_gray(ple);
+    ple.adr = MAKE_IPV4_ADDRESS(123,43,13,i, 8080);
+    plm.append_with_peer_white(ple);
+  }
+  ASSERT_EQ(plm.get_gray_peers_count(), 50);
+  ASSERT_EQ(plm.get_white_peers_count(), 50);
+
+  // Index 0 is the most recently seen peer
+  nodetool::peerlist_entry pe;
+  for (size_t i = 0; i < 50; ++i)
+  {
+    ASSERT_TRUE(plm.get_gray_peer_by_index(pe, i));
+    EXPECT_EQ(pe.last_seen, 1049 - i);
+    ASSERT_TRUE(plm.get_white_peer_by_index(pe, i));
+    EXPECT_EQ(pe.last_seen, 1049 - i);
+  }
+  EXPECT_FALSE(plm.get_gray_peer_by_index(pe, 50));
+  EXPECT_FALSE(plm.get_white_peer_by_index(pe, 50));
+
+  ASSERT_TRUE(plm.get_random_gray_peer(pe));
+  EXPECT_TRUE(pe.last_seen >= 1000 && pe.last_seen < 1050);
+}
 
 TEST(peer_list, merge_peer_lists)
 {
@@ -254,3 +286,34 @@ TEST(peerlist_storage, store)
   EXPECT_EQ(24u, types.anchor[1].id);
   EXPECT_EQ(22u, types.anchor[1].first_seen);
 }
+
+TEST(peer_list, handshake_time)
+{
+  nodetool::peerlist_manager plm;
+  plm.init(nodetool::peerlist_types{}, false);
+
+  nodetool::peerlist_entry ple{};
+  ple.adr = epee::net_utils::ipv4_network_address{MAKE_IP(123,43,12,1), 8080};
+  ple.id = 1;
+  ple.last_seen = 1000;
+  ple.handshake_ms = 123;
+  plm.append_with_peer_white(ple);
+
+  // Updates from peers' peerlists (which never carry a handshake time) keep ours
+  ple.handshake_ms = 0;
+  plm.append_with_peer_white(ple);
+  nodetool::peerlist_entry pe;
+  ASSERT_TRUE(plm.get_white_peer_by_index(pe, 0));
+  EXPECT_EQ(pe.handshake_ms, 123);
+
+  nodetool::peerlist_types types;
+  plm.get_peerlist(types);
+  std::ostringstream out;
+  ASSERT_TRUE(nodetool::peerlist_storage{}.store(out, types));
+  std::istringstream in{out.str()};
+  auto stored = nodetool::peerlist_storage::open(in, true);
+  ASSERT_TRUE(stored);
+  types = stored->take_zone(epee::net_utils::zone::public_);
+  ASSERT_EQ(types.white.size(), 1);
+  EXPECT_EQ(types.white[0].handshake_ms, 123);
+}
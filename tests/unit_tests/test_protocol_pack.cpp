@@ -53,3 +53,116 @@ TEST(protocol_pack, protocol_pack_command)
     ASSERT_TRUE(r.total_height == 3);
   }
 }
+
+namespace
+{
+  template <typename T>
+  std::string generic_store(const T& val)
+  {
+    epee::serialization::portable_storage ps;
+    val.store(ps);
+    std::string buff;
+    ps.store_to_binary(buff);
+    return buff;
+  }
+
+  template <typename T>
+  bool generic_load(T& val, const std::string& buff)
+  {
+    epee::serialization::portable_storage ps;
+    return ps.load_from_binary(buff) && val.load(ps);
+  }
+
+  cryptonote::block_complete_entry make_block_entry(size_t ntxs, bool blink)
+  {
+    cryptonote::block_complete_entry b;
+    b.block = std::string(300, 'b');
+    for (size_t i = 0; i < ntxs; i++)
+      b.txs.push_back(std::string(100 + i, 'a' + i % 26));
+    if (blink)
+    {
+      auto& bm = b.blinks.emplace_back();
+      bm.tx_hash.data[0] = 42;
+      bm.height = 123456;
+      bm.quorum = {0, 1};
+      bm.position = {3, 4};
+      bm.signature.resize(2);
+      bm.signature[1].c.data[5] = 7;
+    }
+    return b;
+  }
+}
+
+TEST(protocol_pack, direct_codecs_match_generic)
+{
+  cryptonote::NOTIFY_NEW_TRANSACTIONS::request txs;
+  EXPECT_EQ(epee::serialization::store_t_to_binary(txs), generic_store(txs));
+  txs.txs = make_block_entry(3, false).txs;
+  txs.requested = true;
+  txs._ = "xyz";
+  EXPECT_EQ(epee::serialization::store_t_to_binary(txs), generic_store(txs));
+  txs.blinks = make_block_entry(0, true).blinks;
+  EXPECT_EQ(epee::serialization::store_t_to_binary(txs), generic_store(txs));
+
+  cryptonote::NOTIFY_NEW_FLUFFY_BLOCK::request fluffy{};
+  EXPECT_EQ(epee::serialization::store_t_to_binary(fluffy), generic_store(fluffy));
+  fluffy.b = make_block_entry(5, true);
+  fluffy.b.checkpoint = "cp";
+  fluffy.current_blockchain_height = 1000;
+  EXPECT_EQ(epee::serialization::store_t_to_binary(fluffy), generic_store(fluffy));
+
+  cryptonote::NOTIFY_RESPONSE_GET_BLOCKS::request blocks{};
+  EXPECT_EQ(epee::serialization::store_t_to_binary(blocks), generic_store(blocks));
+  blocks.blocks = {make_block_entry(0, false), make_block_entry(70, true)};
+  blocks.missed_ids.resize(3);
+  blocks.missed_ids[2].data[0] = 1;
+  blocks.current_blockchain_height = uint64_t{1} << 40;
+  std::string buff = epee::serialization::store_t_to_binary(blocks);
+  ASSERT_EQ(buff, generic_store(blocks));
+
+  cryptonote::NOTIFY_RESPONSE_GET_BLOCKS::request loaded{}, generic_loaded{};
+  ASSERT_TRUE(epee::serialization::load_direct_binary(loaded, buff));
+  ASSERT_TRUE(generic_load(generic_loaded, buff));
+  EXPECT_EQ(generic_store(loaded), generic_store(generic_loaded));
+  EXPECT_EQ(generic_store(loaded), buff);
+  ASSERT_EQ(loaded.blocks.size(), 2);
+  EXPECT_EQ(loaded.blocks[1].txs, blocks.blocks[1].txs);
+  EXPECT_EQ(loaded.blocks[1].blinks[0].signature[1], blocks.blocks[1].blinks[0].signature[1]);
+  EXPECT_EQ(loaded.missed_ids, blocks.missed_ids);
+  EXPECT_EQ(loaded.current_blockchain_height, blocks.current_blockchain_height);
+}
+
+TEST(protocol_pack, direct_codecs_fall_back)
+{
+  // Values of other integer types, and unknown keys, are handled directly, as the generic path
+  // would
+  epee::serialization::portable_storage ps;
+  ps.set_value("current_blockchain_height", uint32_t{77}, nullptr);
+  ps.set_value("unknown", std::string{"x"}, nullptr);
+  auto* sec = ps.open_section("b", nullptr, true);
+  ps.set_value("block", std::string{"blk"}, sec);
+  ps.set_value("extra", uint64_t{5}, ps.open_section("nested", sec, true));
+  std::string buff;
+  ps.store_to_binary(buff);
+
+  cryptonote::NOTIFY_NEW_FLUFFY_BLOCK::request fluffy{};
+  ASSERT_TRUE(epee::serialization::load_direct_binary(fluffy, buff));
+  EXPECT_EQ(fluffy.current_blockchain_height, 77);
+  EXPECT_EQ(fluffy.b.block, "blk");
+
+  // Wrongly typed values are left to the generic path
+  ps.set_value("current_blockchain_height", std::string{"77"}, nullptr);
+  ps.store_to_binary(buff);
+  fluffy = {};
+  EXPECT_FALSE(epee::serialization::load_direct_binary(fluffy, buff));
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(fluffy, buff));
+  EXPECT_EQ(fluffy.current_blockchain_height, 77);
+  EXPECT_EQ(fluffy.b.block, "blk");
+
+  // As are truncated messages, which it then rejects
+  buff = epee::serialization::store_t_to_binary(fluffy);
+  buff.resize(buff.size() - 3);
+  fluffy = {};
+  EXPECT_FALSE(epee::serialization::load_direct_binary(fluffy, buff));
+  EXPECT_FALSE(epee::serialization::load_t_from_binary(fluffy, buff));
+}
@@ -162,6 +162,75 @@ TEST(parse_and_validate_tx_extra, fails_on_wrong_size_in_extra_nonce)
   std::vector<cryptonote::tx_extra_field> tx_extra_fields;
   ASSERT_FALSE(cryptonote::parse_tx_extra(tx.extra, tx_extra_fields));
 }
+TEST(parse_and_validate_tx_extra, memoised_fields_follow_extra)
+{
+  cryptonote::transaction tx{};
+  crypto::public_key pk1{}, pk2{};
+  pk1.data[0] = 1;
+  pk2.data[0] = 2;
+  cryptonote::add_tx_extra<cryptonote::tx_extra_pub_key>(tx, pk1);
+
+  auto fields = cryptonote::get_tx_extra_fields(tx);
+  ASSERT_TRUE(fields);
+  ASSERT_EQ(fields->size(), 1);
+  ASSERT_EQ(cryptonote::get_tx_extra_fields(tx), fields); // reused while extra is unchanged
+  ASSERT_EQ(cryptonote::get_tx_pub_key_from_extra(tx), pk1);
+
+  // Modifying extra directly must not give back the old fields
+  tx.extra.clear();
+  cryptonote::add_tx_extra<cryptonote::tx_extra_pub_key>(tx, pk2);
+  ASSERT_EQ(cryptonote::get_tx_pub_key_from_extra(tx), pk2);
+  ASSERT_EQ(fields->size(), 1); // the old result stays valid for whoever still holds it
+
+  cryptonote::transaction copy{tx};
+  ASSERT_EQ(cryptonote::get_tx_extra_fields(copy), cryptonote::get_tx_extra_fields(tx));
+
+  tx.extra.push_back(cryptonote::TX_EXTRA_NONCE);
+  ASSERT_FALSE(cryptonote::get_tx_extra_fields(tx));
+  ASSERT_EQ(cryptonote::get_tx_pub_key_from_extra(tx), crypto::null_pkey);
+}
+TEST(parse_and_validate_tx_from_blob, hashes_from_blob)
+{
+  cryptonote::transaction tx{};
+  tx.version = cryptonote::txversion::v4_tx_types;
+  cryptonote::txin_to_key in{};
+  in.key_offsets = {1, 2};
+  in.k_image.data[0] = 1;
+  tx.vin.push_back(in);
+  tx.vout.push_back(cryptonote::tx_out{0, cryptonote::txout_to_key{}});
+  tx.output_unlock_times = {0};
+  cryptonote::add_tx_extra<cryptonote::tx_extra_pub_key>(tx, crypto::public_key{});
+
+  cryptonote::transaction state_change{};
+  state_change.version = cryptonote::txversion::v4_tx_types;
+  state_change.type = cryptonote::txtype::state_change;
+
+  for (auto* t : {&tx, &state_change})
+  {
+    const auto blob = cryptonote::tx_to_blob(*t);
+    cryptonote::transaction parsed;
+    crypto::hash hash, prefix_hash;
+    ASSERT_TRUE(cryptonote::parse_and_validate_tx_from_blob(blob, parsed, hash, prefix_hash));
+    ASSERT_TRUE(parsed.is_hash_valid());
+    ASSERT_TRUE(parsed.is_blob_size_valid());
+
+    // Must match what reserializing the tx gives
+    crypto::hash expected, expected_prunable;
+    size_t expected_size;
+    ASSERT_TRUE(cryptonote::calculate_transaction_hash(*t, expected, &expected_size));
+    ASSERT_EQ(hash, expected);
+    ASSERT_EQ(parsed.blob_size, expected_size);
+    ASSERT_EQ(prefix_hash, cryptonote::get_transaction_prefix_hash(*t));
+    ASSERT_TRUE(cryptonote::calculate_transaction_prunable_hash(*t, nullptr, expected_prunable));
+    ASSERT_EQ(cryptonote::get_transaction_prunable_hash(parsed), expected_prunable);
+
+    // and the caches follow copies of the tx
+    cryptonote::transaction copy{parsed};
+    ASSERT_TRUE(copy.is_hash_valid());
+    ASSERT_EQ(copy.is_prunable_hash_valid(), parsed.is_prunable_hash_valid());
+    ASSERT_EQ(cryptonote::get_transaction_hash(copy), expected);
+  }
+}
 TEST(validate_parse_amount_case, validate_parse_amount)
 {
   uint64_t res = 0;
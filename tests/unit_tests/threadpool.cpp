@@ -26,7 +26,9 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <array>
 #include <atomic>
+#include <vector>
 #include "gtest/gtest.h"
 #include "epee/misc_language.h"
 #include "common/threadpool.h"
@@ -144,3 +146,60 @@ TEST(threadpool, leaf_reentrancy)
   waiter.wait(tpool.get());
   ASSERT_EQ(counter, 500000);
 }
+
+TEST(threadpool, large_task)
+{
+  std::shared_ptr<tools::threadpool> tpool(tools::threadpool::getNewForUnitTests(4));
+  tools::threadpool::waiter waiter;
+
+  // Bigger than the task's inline storage, so it gets allocated
+  std::array<uint64_t, 32> values;
+  for (size_t i = 0; i < values.size(); ++i)
+    values[i] = i;
+  std::atomic<uint64_t> sum(0);
+  for (int i = 0; i < 100; ++i)
+    tpool->submit(&waiter, [values, &sum](){ for (auto v : values) sum += v; });
+  waiter.wait(tpool.get());
+  ASSERT_EQ(sum, 100 * 31 * 32 / 2);
+}
+
+TEST(threadpool, parallel_for)
+{
+  std::shared_ptr<tools::threadpool> tpool(tools::threadpool::getNewForUnitTests(4));
+
+  std::vector<std::atomic<int>> called(10000);
+  tpool->parallel_for(5, called.size(), [&](size_t i){ ++called[i]; }, 10);
+  for (size_t i = 0; i < called.size(); ++i)
+    ASSERT_EQ(called[i], i < 5 ? 0 : 1) << "at " << i;
+
+  // Nested inside a job
+  std::atomic<int> counter(0);
+  tools::threadpool::waiter waiter;
+  for (int i = 0; i < 100; ++i)
+    tpool->submit(&waiter, [&](){ tpool->parallel_for(0, 100, [&](size_t){ ++counter; }); });
+  waiter.wait(tpool.get());
+  ASSERT_EQ(counter, 10000);
+
+  tpool->parallel_for(0, 0, [&](size_t){ ++counter; });
+  ASSERT_EQ(counter, 10000);
+}
+
+TEST(threadpool, domains)
+{
+  auto& verify = tools::threadpool::getInstance();
+  auto& background = tools::threadpool::getInstance(tools::threadpool::domain::background);
+  ASSERT_EQ(&verify, &tools::threadpool::getInstance(tools::threadpool::domain::verify));
+  ASSERT_NE(&verify, &background);
+
+  tools::threadpool::set_threads(tools::threadpool::domain::background, 3);
+  ASSERT_EQ(background.get_max_concurrency(), 3);
+
+  tools::threadpool::waiter waiter;
+  std::atomic<int> counter(0);
+  for (int i = 0; i < 100; ++i)
+    background.submit(&waiter, [&](){ ++counter; });
+  waiter.wait(&background);
+  ASSERT_EQ(counter, 100);
+
+  tools::threadpool::set_threads(tools::threadpool::domain::background, 0);
+}
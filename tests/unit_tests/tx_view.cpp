@@ -0,0 +1,108 @@
+#include "gtest/gtest.h"
+
+#include <sstream>
+
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_basic/tx_view.h"
+#include "serialization/binary_archive.h"
+
+static crypto::public_key make_pkey(uint8_t n)
+{
+  crypto::public_key k{};
+  k.data[0] = n;
+  return k;
+}
+
+static crypto::key_image make_key_image(uint8_t n)
+{
+  crypto::key_image k{};
+  k.data[31] = n;
+  return k;
+}
+
+static cryptonote::transaction make_tx()
+{
+  cryptonote::transaction tx;
+  tx.version = cryptonote::txversion::v4_tx_types;
+  tx.type = cryptonote::txtype::stake;
+  tx.unlock_time = 1234;
+  for (uint8_t i = 1; i <= 2; ++i)
+  {
+    cryptonote::txin_to_key in{};
+    in.amount = 0;
+    in.key_offsets = {100000, 2, 300};
+    in.k_image = make_key_image(i);
+    tx.vin.push_back(in);
+  }
+  tx.vout.push_back(cryptonote::tx_out{0, cryptonote::txout_to_key{make_pkey(5)}});
+  tx.vout.push_back(cryptonote::tx_out{0, cryptonote::txout_to_scripthash{}});
+  tx.vout.push_back(cryptonote::tx_out{0, cryptonote::txout_to_key{make_pkey(6)}});
+  tx.output_unlock_times = {0, 10, 20};
+  cryptonote::add_tx_extra<cryptonote::tx_extra_pub_key>(tx, make_pkey(7));
+  return tx;
+}
+
+TEST(tx_view, prefix)
+{
+  auto tx = make_tx();
+  const auto blob = cryptonote::tx_to_blob(tx);
+
+  cryptonote::transaction_view view{blob};
+  EXPECT_EQ(view.version, tx.version);
+  EXPECT_EQ(view.type, tx.type);
+  EXPECT_EQ(view.unlock_time, tx.unlock_time);
+  EXPECT_EQ(view.vin_count, 2);
+  EXPECT_EQ(view.vout_count, 3);
+  EXPECT_TRUE(view.only_key_inputs());
+  EXPECT_EQ(view.key_images, (std::vector<crypto::key_image>{make_key_image(1), make_key_image(2)}));
+  EXPECT_EQ(view.output_key(0), make_pkey(5));
+  EXPECT_EQ(view.output_key(1), crypto::null_pkey);
+  EXPECT_EQ(view.output_key(2), make_pkey(6));
+  EXPECT_EQ(view.output_key(3), crypto::null_pkey);
+  EXPECT_EQ(view.extra(), std::string_view(reinterpret_cast<const char*>(tx.extra.data()), tx.extra.size()));
+  EXPECT_EQ(view.prefix_hash(), cryptonote::get_transaction_prefix_hash(tx));
+  EXPECT_EQ(view.rct_type, rct::RCTType::Null);
+  EXPECT_EQ(view.rct_base().size(), 1);
+  EXPECT_TRUE(view.prunable().empty());
+
+  cryptonote::transaction parsed;
+  ASSERT_TRUE(view.materialise(parsed));
+  EXPECT_EQ(cryptonote::get_transaction_hash(parsed), cryptonote::get_transaction_hash(tx));
+}
+
+TEST(tx_view, rct_base)
+{
+  auto tx = make_tx();
+  tx.rct_signatures.type = rct::RCTType::CLSAG;
+  tx.rct_signatures.txnFee = 123456789;
+  tx.rct_signatures.ecdhInfo.resize(tx.vout.size());
+  tx.rct_signatures.outPk.resize(tx.vout.size());
+
+  std::ostringstream out;
+  serialization::binary_archiver ar{out};
+  tx.serialize_base(ar);
+  const auto blob = out.str();
+
+  cryptonote::transaction_view view{blob};
+  EXPECT_EQ(view.rct_type, rct::RCTType::CLSAG);
+  EXPECT_EQ(view.rct_fee, 123456789);
+  EXPECT_EQ(view.prefix().size() + view.rct_base().size(), blob.size());
+  EXPECT_EQ(view.rct_base().size(), 1 + 4 + 3 * (8 + 32));
+  EXPECT_TRUE(view.prunable().empty());
+}
+
+TEST(tx_view, malformed)
+{
+  auto blob = cryptonote::tx_to_blob(make_tx());
+  std::optional<cryptonote::transaction_view> view;
+  ASSERT_TRUE(cryptonote::parse_tx_view_from_blob(blob, view));
+
+  // Truncated anywhere in the prefix or rct base
+  for (size_t size = 0; size < blob.size(); ++size)
+    EXPECT_FALSE(cryptonote::parse_tx_view_from_blob(std::string_view{blob}.substr(0, size), view)) << "at size " << size;
+  EXPECT_FALSE(view);
+
+  // A bad input variant tag (the first input's tag follows the version, unlock times and input count)
+  blob[1 + 1 + 3 + 2 + 1] = 0x7f;
+  EXPECT_FALSE(cryptonote::parse_tx_view_from_blob(blob, view));
+}
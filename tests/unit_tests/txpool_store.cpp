@@ -0,0 +1,212 @@
+#include "gtest/gtest.h"
+
+#include "cryptonote_core/txpool_store.h"
+#include "cryptonote_core/blockchain.h"
+#include "cryptonote_core/uptime_proof.h"
+#include "blockchain_db/testdb.h"
+
+#include <map>
+
+using cryptonote::txpool_store;
+using cryptonote::txpool_tx_meta_t;
+
+namespace
+{
+
+crypto::hash make_hash(uint8_t n)
+{
+  crypto::hash h{};
+  h.data[0] = n;
+  return h;
+}
+
+txpool_tx_meta_t make_meta(uint64_t fee, bool do_not_relay = false)
+{
+  txpool_tx_meta_t meta{};
+  meta.fee = fee;
+  meta.do_not_relay = do_not_relay;
+  return meta;
+}
+
+// Keeps the txpool tables in a map, counting the writes made to them
+class TestDB : public cryptonote::BaseTestDB
+{
+public:
+  void add_txpool_tx(const crypto::hash& txid, const cryptonote::blobdata& blob, const txpool_tx_meta_t& meta) override
+  {
+    if (!txs.emplace(txid, std::make_pair(meta, blob)).second)
+      throw cryptonote::DB_ERROR("tx already exists");
+    writes++;
+  }
+  void update_txpool_tx(const crypto::hash& txid, const txpool_tx_meta_t& meta) override
+  {
+    txs.at(txid).first = meta;
+    writes++;
+  }
+  void remove_txpool_tx(const crypto::hash& txid) override
+  {
+    txs.erase(txid);
+    writes++;
+  }
+  bool for_all_txpool_txes(std::function<bool(const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata*)> f,
+      bool include_blob, bool include_unrelayed_txes) const override
+  {
+    for (auto& [txid, tx] : txs)
+      if (!f(txid, tx.first, include_blob ? &tx.second : nullptr))
+        return false;
+    return true;
+  }
+
+  std::map<crypto::hash, std::pair<txpool_tx_meta_t, cryptonote::blobdata>> txs;
+  int writes = 0;
+};
+
+}
+
+TEST(txpool_store, add_update_remove)
+{
+  txpool_store store;
+  store.add(make_hash(1), "one", make_meta(10));
+  store.add(make_hash(2), "two", make_meta(20, true));
+  EXPECT_THROW(store.add(make_hash(1), "one", make_meta(10)), std::exception);
+  EXPECT_THROW(store.update(make_hash(3), make_meta(30)), std::exception);
+  EXPECT_EQ(store.count(), 2);
+  EXPECT_EQ(store.count(false), 1);
+
+  store.update(make_hash(1), make_meta(11));
+  txpool_tx_meta_t meta;
+  ASSERT_TRUE(store.get_meta(make_hash(1), meta));
+  EXPECT_EQ(meta.fee, 11);
+  cryptonote::blobdata blob;
+  ASSERT_TRUE(store.get_blob(make_hash(2), blob));
+  EXPECT_EQ(blob, "two");
+
+  int seen = 0;
+  store.for_all([&](const crypto::hash&, const txpool_tx_meta_t&, const cryptonote::blobdata* bd) {
+    EXPECT_EQ(bd, nullptr);
+    seen++;
+    return true;
+  }, false, false);
+  EXPECT_EQ(seen, 1);
+
+  store.remove(make_hash(1));
+  store.remove(make_hash(3));
+  EXPECT_FALSE(store.has(make_hash(1)));
+  EXPECT_TRUE(store.has(make_hash(2)));
+  EXPECT_EQ(store.count(), 1);
+}
+
+TEST(txpool_store, abort_undoes_group)
+{
+  txpool_store store;
+  store.add(make_hash(1), "one", make_meta(10));
+  store.add(make_hash(2), "two", make_meta(20));
+
+  ASSERT_TRUE(store.begin());
+  EXPECT_FALSE(store.begin());
+  store.update(make_hash(1), make_meta(11));
+  store.update(make_hash(1), make_meta(12));
+  store.remove(make_hash(2));
+  store.add(make_hash(3), "three", make_meta(30));
+  store.abort();
+
+  txpool_tx_meta_t meta;
+  ASSERT_TRUE(store.get_meta(make_hash(1), meta));
+  EXPECT_EQ(meta.fee, 10);
+  EXPECT_TRUE(store.has(make_hash(2)));
+  EXPECT_FALSE(store.has(make_hash(3)));
+  EXPECT_EQ(store.pending(), 2);
+
+  ASSERT_TRUE(store.begin());
+  store.remove(make_hash(1));
+  store.commit();
+  EXPECT_FALSE(store.has(make_hash(1)));
+}
+
+TEST(txpool_store, totals)
+{
+  auto meta = [](uint64_t weight, uint64_t fee, uint64_t receive_time, bool do_not_relay = false) {
+    txpool_tx_meta_t m = make_meta(fee, do_not_relay);
+    m.weight = weight;
+    m.receive_time = receive_time;
+    return m;
+  };
+  auto check = [](const txpool_store& store, bool include_unrelayed, uint64_t txs, uint64_t bytes, uint64_t min, uint64_t med, uint64_t max, uint64_t oldest) {
+    store.with_totals(include_unrelayed, [&](const txpool_store::totals& t) {
+      EXPECT_EQ(t.txs, txs);
+      EXPECT_EQ(t.bytes, bytes);
+      EXPECT_EQ(t.min_weight(), min);
+      EXPECT_EQ(t.median_weight(), med);
+      EXPECT_EQ(t.max_weight(), max);
+      EXPECT_EQ(t.by_receive_time.size(), txs);
+      if (txs)
+        EXPECT_EQ(std::get<0>(*t.by_receive_time.begin()), oldest);
+    });
+  };
+
+  txpool_store store;
+  check(store, true, 0, 0, 0, 0, 0, 0);
+  store.add(make_hash(1), "one", meta(100, 1, 50));
+  store.add(make_hash(2), "two", meta(300, 2, 40, true));
+  store.add(make_hash(3), "three", meta(200, 3, 60));
+  check(store, true, 3, 600, 100, 200, 300, 40);
+  check(store, false, 2, 300, 100, 150, 200, 50);
+
+  // Becoming relayable moves a tx into the relayable totals
+  store.update(make_hash(2), meta(300, 2, 40));
+  check(store, false, 3, 600, 100, 200, 300, 40);
+
+  ASSERT_TRUE(store.begin());
+  store.remove(make_hash(1));
+  store.add(make_hash(4), "four", meta(50, 4, 10));
+  store.update(make_hash(3), meta(250, 3, 60));
+  check(store, true, 3, 600, 50, 250, 300, 10);
+  store.abort();
+  check(store, true, 3, 600, 100, 200, 300, 40);
+
+  store.remove(make_hash(2));
+  store.remove(make_hash(3));
+  check(store, true, 1, 100, 100, 100, 100, 50);
+  store.with_totals(true, [](const txpool_store::totals& t) { EXPECT_EQ(t.fees, 1); });
+  store.clear();
+  check(store, true, 0, 0, 0, 0, 0, 0);
+}
+
+TEST(txpool_store, flush)
+{
+  TestDB db;
+  db.txs.emplace(make_hash(1), std::make_pair(make_meta(10), "one"));
+  db.txs.emplace(make_hash(2), std::make_pair(make_meta(20), "two"));
+
+  txpool_store store;
+  store.load(db);
+  EXPECT_EQ(store.count(), 2);
+  EXPECT_EQ(store.pending(), 0);
+
+  // Several changes to a tx are written once; a tx added and removed since the last flush isn't
+  // written at all
+  store.update(make_hash(1), make_meta(11));
+  store.update(make_hash(1), make_meta(12));
+  store.add(make_hash(3), "three", make_meta(30));
+  store.remove(make_hash(3));
+  store.remove(make_hash(2));
+  store.add(make_hash(2), "deux", make_meta(21));
+  store.add(make_hash(4), "four", make_meta(40));
+
+  // Not while a group could still be aborted
+  ASSERT_TRUE(store.begin());
+  store.flush(db);
+  EXPECT_EQ(db.writes, 0);
+  store.commit();
+
+  store.flush(db);
+  EXPECT_EQ(store.pending(), 0);
+  EXPECT_EQ(db.writes, 4); // update 1, remove + add 2, add 4
+  ASSERT_EQ(db.txs.size(), 3);
+  EXPECT_EQ(db.txs[make_hash(1)].first.fee, 12);
+  EXPECT_EQ(db.txs[make_hash(2)].second, "deux");
+  EXPECT_EQ(db.txs[make_hash(4)].second, "four");
+
+  store.flush(db);
+  EXPECT_EQ(db.writes, 4);
+}
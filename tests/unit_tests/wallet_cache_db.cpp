@@ -0,0 +1,158 @@
+// Copyright (c) 2021, The Oxen Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <fstream>
+#include <iterator>
+
+#include "gtest/gtest.h"
+
+#include "crypto/chacha.h"
+#include "crypto/crypto.h"
+#include "wallet/wallet_cache_db.h"
+
+#include "random_path.h"
+
+namespace {
+
+crypto::chacha_key generate_chacha_key()
+{
+  crypto::chacha_key chacha_key;
+  uint64_t password = crypto::rand<uint64_t>();
+  crypto::generate_chacha_key(std::string((const char*)&password, sizeof(password)), chacha_key, 1);
+  return chacha_key;
+}
+
+struct temp_file
+{
+  fs::path path = random_tmp_file();
+  ~temp_file() { std::error_code ec; fs::remove(path, ec); }
+};
+
+}
+
+TEST(wallet_cache_db, store_and_load)
+{
+  temp_file file;
+  auto key = generate_chacha_key();
+  {
+    tools::wallet_cache_db db{file.path};
+    db.begin();
+    EXPECT_TRUE(db.put(key, "transfers", 0, "page zero"));
+    EXPECT_TRUE(db.put(key, "transfers", 1, "page one"));
+    EXPECT_TRUE(db.put(key, "transfers", 2, "page two"));
+    EXPECT_TRUE(db.put(key, "wallet", 0, std::string(1000, 'w')));
+    db.commit();
+    EXPECT_EQ(db.pages("transfers"), 3);
+    EXPECT_EQ(db.pages("other"), 0);
+
+    // Unchanged pages aren't written again
+    db.begin();
+    EXPECT_FALSE(db.put(key, "transfers", 0, "page zero"));
+    EXPECT_TRUE(db.put(key, "transfers", 1, "page one, changed"));
+    db.truncate("transfers", 2);
+    db.commit();
+    EXPECT_EQ(db.pages("transfers"), 2);
+  }
+  EXPECT_TRUE(tools::wallet_cache_db::is_cache_db(file.path));
+
+  tools::wallet_cache_db db{file.path};
+  EXPECT_EQ(db.load(key, "transfers"), (std::vector<std::string>{"page zero", "page one, changed"}));
+  EXPECT_EQ(db.load(key, "wallet"), std::vector<std::string>{std::string(1000, 'w')});
+  EXPECT_TRUE(db.load(key, "other").empty());
+
+  // Loading remembers the pages, too
+  db.begin();
+  EXPECT_FALSE(db.put(key, "transfers", 1, "page one, changed"));
+  EXPECT_TRUE(db.put(key, "transfers", 2, "page two, again"));
+  db.commit();
+}
+
+TEST(wallet_cache_db, rollback)
+{
+  temp_file file;
+  auto key = generate_chacha_key();
+  tools::wallet_cache_db db{file.path};
+  db.begin();
+  db.put(key, "s", 0, "a");
+  db.commit();
+
+  db.begin();
+  EXPECT_TRUE(db.put(key, "s", 0, "b"));
+  EXPECT_TRUE(db.put(key, "s", 1, "c"));
+  db.rollback();
+  EXPECT_EQ(db.pages("s"), 1);
+  EXPECT_EQ(db.load(key, "s"), std::vector<std::string>{"a"});
+
+  // The rolled back contents aren't mistaken for what is stored
+  db.begin();
+  EXPECT_TRUE(db.put(key, "s", 0, "b"));
+  db.commit();
+  EXPECT_EQ(db.load(key, "s"), std::vector<std::string>{"b"});
+}
+
+TEST(wallet_cache_db, encrypted_and_renamed)
+{
+  temp_file file, renamed;
+  auto key = generate_chacha_key(), other_key = generate_chacha_key();
+  {
+    tools::wallet_cache_db db{file.path};
+    db.begin();
+    db.put(key, "s", 0, "some secret wallet data");
+    db.commit();
+    db.rename(renamed.path);
+    EXPECT_EQ(db.filename(), renamed.path);
+    // Still usable after the rename, and still knows what it holds
+    db.begin();
+    EXPECT_FALSE(db.put(key, "s", 0, "some secret wallet data"));
+    db.commit();
+  }
+  EXPECT_FALSE(fs::exists(file.path));
+
+  std::string contents;
+  {
+    fs::ifstream in{renamed.path, std::ios::binary};
+    contents.assign(std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{});
+  }
+  EXPECT_EQ(contents.find("secret"), std::string::npos);
+
+  tools::wallet_cache_db db{renamed.path};
+  EXPECT_EQ(db.load(key, "s"), std::vector<std::string>{"some secret wallet data"});
+  EXPECT_NE(db.load(other_key, "s"), std::vector<std::string>{"some secret wallet data"});
+}
+
+TEST(wallet_cache_db, not_a_cache_db)
+{
+  temp_file file;
+  EXPECT_FALSE(tools::wallet_cache_db::is_cache_db(file.path));
+  {
+    fs::ofstream out{file.path, std::ios::binary};
+    out << "an old style wallet cache file";
+  }
+  EXPECT_FALSE(tools::wallet_cache_db::is_cache_db(file.path));
+}
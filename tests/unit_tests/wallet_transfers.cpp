@@ -0,0 +1,177 @@
+// Copyright (c) 2021, The Oxen Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "gtest/gtest.h"
+
+#include "wallet/wallet2.h"
+
+namespace
+{
+  crypto::hash make_txid(uint8_t n)
+  {
+    crypto::hash h = crypto::null_hash;
+    h.data[0] = n;
+    return h;
+  }
+
+  // Incoming transfers at heights 10, 11, ..., alternately to accounts 0 and 1, and outgoing
+  // ones from account 0 at heights 12 and 20
+  void make_history(tools::wallet2& w, size_t incoming)
+  {
+    tools::wallet2::payment_container payments;
+    for (size_t i = 0; i < incoming; ++i)
+    {
+      tools::wallet2::payment_details pd{};
+      pd.m_tx_hash = make_txid(i);
+      pd.m_amount = 1000 + i;
+      pd.m_block_height = 10 + i;
+      pd.m_timestamp = 1000 + i;
+      pd.m_type = wallet::pay_type::in;
+      pd.m_subaddr_index = {static_cast<uint32_t>(i % 2), 0};
+      payments.emplace(crypto::null_hash, pd);
+    }
+    w.import_payments(payments);
+
+    std::list<std::pair<crypto::hash, tools::wallet2::confirmed_transfer_details>> out;
+    for (uint64_t height : {12, 20})
+    {
+      tools::wallet2::confirmed_transfer_details ctd;
+      ctd.m_block_height = height;
+      ctd.m_timestamp = 2000 + height;
+      ctd.m_subaddr_account = 0;
+      ctd.m_subaddr_indices = {0};
+      out.emplace_back(make_txid(100 + height), ctd);
+    }
+    w.import_payments_out(out);
+  }
+
+  std::vector<uint64_t> heights(const std::vector<wallet::transfer_view>& transfers)
+  {
+    std::vector<uint64_t> result;
+    for (const auto& t : transfers)
+      result.push_back(t.height);
+    return result;
+  }
+}
+
+TEST(wallet_transfers, order_and_paging)
+{
+  tools::wallet2 w{cryptonote::TESTNET};
+  w.set_subaddress_lookahead(1, 1);
+  w.generate("", "");
+  make_history(w, 6);
+
+  tools::wallet2::get_transfers_args_t args{};
+  args.all_accounts = true;
+  std::vector<wallet::transfer_view> all;
+  w.get_transfers(args, all);
+  ASSERT_EQ(heights(all), (std::vector<uint64_t>{10, 11, 12, 12, 13, 14, 15, 20}));
+  // same height: ordered by timestamp, so the incoming one first
+  EXPECT_EQ(all[2].pay_type, wallet::pay_type::in);
+  EXPECT_EQ(all[3].pay_type, wallet::pay_type::out);
+
+  // pages make up the full result
+  std::vector<wallet::transfer_view> paged;
+  args.limit = 3;
+  for (args.offset = 0; args.offset < all.size() + 3; args.offset += args.limit)
+  {
+    std::vector<wallet::transfer_view> page;
+    w.get_transfers(args, page);
+    EXPECT_LE(page.size(), args.limit);
+    paged.insert(paged.end(), page.begin(), page.end());
+  }
+  ASSERT_EQ(paged.size(), all.size());
+  for (size_t i = 0; i < all.size(); ++i)
+    EXPECT_EQ(paged[i].hash, all[i].hash);
+}
+
+TEST(wallet_transfers, filters)
+{
+  tools::wallet2 w{cryptonote::TESTNET};
+  w.set_subaddress_lookahead(1, 1);
+  w.generate("", "");
+  make_history(w, 6);
+
+  tools::wallet2::get_transfers_args_t args{};
+  args.account_index = 1;
+  std::vector<wallet::transfer_view> transfers;
+  w.get_transfers(args, transfers);
+  EXPECT_EQ(heights(transfers), (std::vector<uint64_t>{11, 13, 15}));
+
+  args.account_index = 0;
+  args.filter_by_height = true;
+  args.min_height = 12;
+  args.max_height = 14;
+  transfers.clear();
+  w.get_transfers(args, transfers);
+  EXPECT_EQ(heights(transfers), (std::vector<uint64_t>{12, 12, 14}));
+
+  args.in = true;
+  transfers.clear();
+  w.get_transfers(args, transfers);
+  EXPECT_EQ(heights(transfers), (std::vector<uint64_t>{12, 14}));
+
+  // the index follows changes to the history
+  make_history(w, 8);
+  args = {};
+  args.all_accounts = true;
+  args.in = true;
+  transfers.clear();
+  w.get_transfers(args, transfers);
+  EXPECT_EQ(heights(transfers), (std::vector<uint64_t>{10, 11, 12, 13, 14, 15, 16, 17}));
+}
+
+TEST(wallet_transfers, summary)
+{
+  wallet::transfer_details td{};
+  td.m_block_height = 100;
+  td.m_tx.version = cryptonote::txversion::v4_tx_types;
+  td.m_tx.unlock_time = 0;
+  td.m_tx.output_unlock_times = {0, 250};
+  td.m_internal_output_index = 1;
+  td.m_amount = 1234;
+  td.m_spent = true;
+  td.m_spent_height = 0;
+  td.m_rct = true;
+  td.m_subaddr_index = {2, 3};
+
+  wallet::transfer_summary ts{td};
+  EXPECT_EQ(ts.amount, 1234);
+  EXPECT_EQ(ts.block_height, 100);
+  EXPECT_EQ(ts.unlock_time, 250);
+  EXPECT_EQ(ts.tx_unlock_time, 0);
+  EXPECT_EQ(ts.subaddr_index, (cryptonote::subaddress_index{2, 3}));
+  EXPECT_TRUE(ts.rct);
+  // spent in a tx that isn't mined yet
+  EXPECT_TRUE(ts.is_spent(false));
+  EXPECT_FALSE(ts.is_spent(true));
+
+  td.m_spent_height = 101;
+  EXPECT_TRUE(wallet::transfer_summary{td}.is_spent(true));
+}
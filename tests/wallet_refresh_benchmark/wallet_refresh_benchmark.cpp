@@ -0,0 +1,408 @@
+// Benchmark of the wallet's refresh (scanning) path without a daemon: feeds wallet2 a sequence of
+// recorded GET_BLOCKS_FAST responses, taking each through the same stages as refresh() does (the
+// block_prefetcher's deserialization and parsing, then process_parsed_blocks()), and reports the
+// blocks/s of each stage.
+//
+// The responses are synthetic, generated with a chosen number of txs per block and a chosen
+// fraction of them paying one of the wallet's subaddresses, or loaded from a file written by an
+// earlier --save-responses run (the wallet is always generated from the same seed, so a saved
+// recording still has outputs to find).
+//
+//     wallet_refresh_benchmark --blocks 2000 --txs-per-block 20 --owned 0.01 --subaddresses 1000
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#include <boost/program_options.hpp>
+
+#include "common/command_line.h"
+#include "common/metrics.h"
+#include "common/threadpool.h"
+#include "common/util.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "epee/storages/portable_storage_template_helper.h"
+#include "oxen_economy.h"
+#include "ringct/rctOps.h"
+#include "wallet/wallet2.h"
+
+namespace po = boost::program_options;
+using namespace cryptonote;
+
+namespace
+{
+  using clock = std::chrono::steady_clock;
+
+  const command_line::arg_descriptor<uint64_t> arg_blocks = {"blocks", "Number of blocks to scan", 1000};
+  const command_line::arg_descriptor<unsigned> arg_txs_per_block = {"txs-per-block", "Non-coinbase txs per block", 10};
+  const command_line::arg_descriptor<unsigned> arg_outputs_per_tx = {"outputs-per-tx", "Outputs per tx", 2};
+  const command_line::arg_descriptor<double> arg_owned = {"owned", "Fraction of txs that pay the wallet", 0.01};
+  const command_line::arg_descriptor<unsigned> arg_accounts = {"accounts", "Wallet accounts (subaddress major indices) paid and looked ahead for", 1};
+  const command_line::arg_descriptor<unsigned> arg_subaddresses = {"subaddresses", "Subaddresses per account paid and looked ahead for", SUBADDRESS_LOOKAHEAD_MINOR};
+  const command_line::arg_descriptor<unsigned> arg_span = {"span", "Blocks per GET_BLOCKS_FAST response", 100};
+  const command_line::arg_descriptor<unsigned> arg_runs = {"runs", "Number of times to scan the blocks, each with a fresh wallet", 3};
+  const command_line::arg_descriptor<std::string> arg_save = {"save-responses", "Write the generated responses to this file"};
+  const command_line::arg_descriptor<std::string> arg_load = {"load-responses", "Scan the responses in this file instead of generating them"};
+
+  struct params
+  {
+    uint64_t blocks;
+    unsigned txs_per_block;
+    unsigned outputs_per_tx;
+    double owned;
+    unsigned accounts;
+    unsigned subaddresses;
+    unsigned span;
+  };
+
+  // Every run uses the same wallet keys, so that recorded responses keep paying it
+  crypto::secret_key wallet_seed()
+  {
+    crypto::secret_key seed;
+    crypto::hash_to_scalar("wallet refresh benchmark", 24, seed);
+    return seed;
+  }
+
+  crypto::public_key random_pubkey() { return rct::rct2pk(rct::pkGen()); }
+}
+
+// Friend of wallet2 (like core_tests' wallet_accessor_test), for the internals refresh() uses
+class wallet_refresh_benchmark
+{
+public:
+  static std::unique_ptr<tools::wallet2> make_wallet(const params& p)
+  {
+    auto w = std::make_unique<tools::wallet2>(MAINNET);
+    w->set_subaddress_lookahead(p.accounts, p.subaddresses);
+    w->generate("", "", wallet_seed(), true /*recover*/, false, false);
+    w->set_refresh_from_block_height(0);
+    w->set_offline(true);
+    return w;
+  }
+
+  static crypto::hash genesis_hash(const tools::wallet2& w) { return w.m_blockchain[0]; }
+  static size_t transfers(const tools::wallet2& w) { return w.m_transfers.size(); }
+
+  static void process_parsed_blocks(tools::wallet2& w, uint64_t start_height, const std::vector<block_complete_entry>& blocks,
+      const std::vector<tools::wallet2::parsed_block>& parsed_blocks, uint64_t& blocks_added)
+  {
+    w.process_parsed_blocks(start_height, blocks, parsed_blocks, blocks_added);
+  }
+
+  static void parse_block_round(const tools::wallet2& w, const blobdata& blob, block& bl, crypto::hash& id, bool& error)
+  {
+    w.parse_block_round(blob, bl, id, error);
+  }
+};
+
+namespace
+{
+  // A pruned CLSAG tx (as GET_BLOCKS_FAST returns with prune=true) with `n_outputs` outputs; if
+  // `to` is given the first output pays it `amount`, the rest (and all the outputs otherwise) pay
+  // random keys.
+  transaction make_tx(unsigned n_outputs, const account_public_address* to, bool to_subaddress, uint64_t amount)
+  {
+    transaction tx;
+    tx.version = txversion::v4_tx_types;
+    tx.type = txtype::standard;
+    for (int i = 0; i < 2; ++i)
+    {
+      txin_to_key in{};
+      in.key_offsets.assign(10, 1000);
+      in.k_image = rct::rct2ki(rct::pkGen());
+      tx.vin.push_back(in);
+    }
+
+    crypto::public_key tx_pub;
+    crypto::secret_key tx_sec;
+    crypto::generate_keys(tx_pub, tx_sec);
+    crypto::key_derivation derivation{};
+    if (to)
+    {
+      if (to_subaddress)
+        tx_pub = rct::rct2pk(rct::scalarmultKey(rct::pk2rct(to->m_spend_public_key), rct::sk2rct(tx_sec)));
+      crypto::generate_key_derivation(to->m_view_public_key, tx_sec, derivation);
+    }
+    add_tx_extra<tx_extra_pub_key>(tx, tx_pub);
+
+    tx.rct_signatures.type = rct::RCTType::CLSAG;
+    tx.rct_signatures.txnFee = 20000000;
+    for (unsigned i = 0; i < n_outputs; ++i)
+    {
+      rct::ecdhTuple ecdh{};
+      rct::key commitment;
+      if (to && i == 0)
+      {
+        crypto::public_key key;
+        crypto::derive_public_key(derivation, i, to->m_spend_public_key, key);
+        tx.vout.push_back(tx_out{0, txout_to_key{key}});
+        crypto::secret_key amount_key;
+        crypto::derivation_to_scalar(derivation, i, amount_key);
+        ecdh.amount = rct::d2h(amount);
+        rct::ecdhEncode(ecdh, rct::sk2rct(amount_key), true);
+        commitment = rct::commit(amount, rct::genCommitmentMask(rct::sk2rct(amount_key)));
+      }
+      else
+      {
+        tx.vout.push_back(tx_out{0, txout_to_key{random_pubkey()}});
+        ecdh.amount = rct::skGen();
+        commitment = rct::pkGen();
+      }
+      tx.output_unlock_times.push_back(0);
+      tx.rct_signatures.ecdhInfo.push_back(ecdh);
+      tx.rct_signatures.outPk.push_back({rct::key{}, commitment});
+    }
+    tx.pruned = true;
+    return tx;
+  }
+
+  transaction make_miner_tx(uint64_t height)
+  {
+    transaction tx;
+    tx.version = txversion::v4_tx_types;
+    tx.type = txtype::standard;
+    tx.vin.push_back(txin_gen{height});
+    tx.vout.push_back(tx_out{16 * COIN, txout_to_key{random_pubkey()}});
+    tx.output_unlock_times.push_back(height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW);
+    add_tx_extra<tx_extra_pub_key>(tx, random_pubkey());
+    return tx;
+  }
+
+  // Serialized GET_BLOCKS_FAST::responses for blocks 1 to p.blocks, following `genesis`
+  std::vector<std::string> generate_responses(const params& p, const tools::wallet2& w, crypto::hash genesis)
+  {
+    std::mt19937_64 rng{42};
+    std::bernoulli_distribution owned{p.owned};
+    std::uniform_int_distribution<uint32_t> major{0, p.accounts - 1}, minor{0, p.subaddresses - 1};
+
+    std::vector<std::string> responses;
+    crypto::hash prev = genesis;
+    uint64_t next_output = 0;
+    const uint64_t now = time(nullptr);
+    for (uint64_t start = 1; start <= p.blocks; start += p.span)
+    {
+      rpc::GET_BLOCKS_FAST::response res{};
+      res.start_height = start;
+      res.current_height = p.blocks + 1;
+      res.status = rpc::STATUS_OK;
+      for (uint64_t height = start; height < std::min(start + p.span, p.blocks + 1); ++height)
+      {
+        block b{};
+        b.major_version = network_version_count - 1;
+        b.minor_version = b.major_version;
+        b.timestamp = now - (p.blocks - height) * TARGET_BLOCK_TIME / 1s;
+        b.prev_id = prev;
+        b.miner_tx = make_miner_tx(height);
+
+        auto& entry = res.blocks.emplace_back();
+        auto& indices = res.output_indices.emplace_back();
+        indices.indices.push_back({{next_output++}});
+        for (unsigned i = 0; i < p.txs_per_block; ++i)
+        {
+          std::optional<subaddress_index> to;
+          if (owned(rng))
+            to = subaddress_index{major(rng), minor(rng)};
+          auto addr = to ? w.get_subaddress(*to) : account_public_address{};
+          auto tx = make_tx(p.outputs_per_tx, to ? &addr : nullptr, to && !to->is_zero(), 1 + rng() % (100 * COIN));
+          entry.txs.push_back(tx_to_blob(tx));
+          // The wallet takes tx hashes from the block rather than hashing the (pruned) txs itself
+          b.tx_hashes.push_back(crypto::rand<crypto::hash>());
+          auto& tx_indices = indices.indices.emplace_back();
+          for (unsigned o = 0; o < p.outputs_per_tx; ++o)
+            tx_indices.indices.push_back(next_output++);
+        }
+        entry.block = block_to_blob(b);
+        prev = get_block_hash(b);
+      }
+      std::string blob;
+      epee::serialization::store_t_to_binary(res, blob);
+      responses.push_back(std::move(blob));
+    }
+    return responses;
+  }
+
+  void save_responses(const std::string& path, const std::vector<std::string>& responses)
+  {
+    std::ofstream out{path, std::ios::binary};
+    for (auto& r : responses)
+    {
+      uint64_t size = r.size();
+      out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+      out.write(r.data(), r.size());
+    }
+    if (!out)
+      throw std::runtime_error{"Failed to write " + path};
+  }
+
+  std::vector<std::string> load_responses(const std::string& path)
+  {
+    std::ifstream in{path, std::ios::binary};
+    if (!in)
+      throw std::runtime_error{"Failed to open " + path};
+    std::vector<std::string> responses;
+    uint64_t size;
+    while (in.read(reinterpret_cast<char*>(&size), sizeof(size)))
+    {
+      auto& r = responses.emplace_back(size, '\0');
+      if (!in.read(r.data(), size))
+        throw std::runtime_error{"Truncated response in " + path};
+    }
+    return responses;
+  }
+
+  struct run_result
+  {
+    uint64_t blocks = 0;
+    std::chrono::nanoseconds total{0}, parse{0}, scan{0}, add{0};
+    size_t transfers = 0;
+  };
+
+  run_result run(const params& p, const std::vector<std::string>& responses)
+  {
+    run_result r;
+    auto w = wallet_refresh_benchmark::make_wallet(p);
+    auto& tpool = tools::threadpool::getInstance();
+    // process_parsed_blocks() times its two halves; we take the difference over the run
+    auto& scan_hist = tools::metrics::get_histogram("process_parsed_blocks_scan", "wallet.wallet2");
+    auto& add_hist = tools::metrics::get_histogram("process_parsed_blocks_add", "wallet.wallet2");
+    const uint64_t scan_before = scan_hist.sum(), add_before = add_hist.sum();
+
+    const auto start = clock::now();
+    for (const auto& blob : responses)
+    {
+      const auto parse_start = clock::now();
+      rpc::GET_BLOCKS_FAST::response res{};
+      if (!epee::serialization::load_t_from_binary(res, blob))
+        throw std::runtime_error{"Failed to deserialize a GET_BLOCKS_FAST response"};
+      std::vector<tools::wallet2::parsed_block> parsed(res.blocks.size());
+      std::atomic<bool> error{false};
+      tools::threadpool::waiter waiter;
+      for (size_t i = 0; i < res.blocks.size(); ++i)
+      {
+        tpool.submit(&waiter, [&, i] {
+          bool e;
+          wallet_refresh_benchmark::parse_block_round(*w, res.blocks[i].block, parsed[i].block, parsed[i].hash, e);
+          if (e)
+            error = true;
+        }, true);
+        parsed[i].txes.resize(res.blocks[i].txs.size());
+        for (size_t j = 0; j < res.blocks[i].txs.size(); ++j)
+          tpool.submit(&waiter, [&, i, j] {
+            if (!parse_and_validate_tx_base_from_blob(res.blocks[i].txs[j], parsed[i].txes[j]))
+              error = true;
+          }, true);
+        parsed[i].o_indices = std::move(res.output_indices[i]);
+      }
+      waiter.wait(&tpool);
+      if (error)
+        throw std::runtime_error{"Failed to parse blocks from height " + std::to_string(res.start_height)};
+      r.parse += clock::now() - parse_start;
+
+      uint64_t added = 0;
+      wallet_refresh_benchmark::process_parsed_blocks(*w, res.start_height, res.blocks, parsed, added);
+      r.blocks += added;
+    }
+    r.total = clock::now() - start;
+    r.scan = std::chrono::nanoseconds{scan_hist.sum() - scan_before};
+    r.add = std::chrono::nanoseconds{add_hist.sum() - add_before};
+    r.transfers = wallet_refresh_benchmark::transfers(*w);
+    return r;
+  }
+
+  std::string rate(uint64_t blocks, std::chrono::nanoseconds t)
+  {
+    std::ostringstream s;
+    s << std::fixed << std::setprecision(1);
+    if (t.count() > 0)
+      s << blocks / std::chrono::duration<double>{t}.count();
+    else
+      s << "-";
+    return s.str();
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  TRY_ENTRY();
+  tools::on_startup();
+  mlog_configure("", true);
+  mlog_set_log_level(0);
+
+  po::options_description desc_options("Command line options");
+  command_line::add_arg(desc_options, arg_blocks);
+  command_line::add_arg(desc_options, arg_txs_per_block);
+  command_line::add_arg(desc_options, arg_outputs_per_tx);
+  command_line::add_arg(desc_options, arg_owned);
+  command_line::add_arg(desc_options, arg_accounts);
+  command_line::add_arg(desc_options, arg_subaddresses);
+  command_line::add_arg(desc_options, arg_span);
+  command_line::add_arg(desc_options, arg_runs);
+  command_line::add_arg(desc_options, arg_save);
+  command_line::add_arg(desc_options, arg_load);
+  command_line::add_arg(desc_options, command_line::arg_help);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << desc_options << "\n";
+    return 0;
+  }
+
+  params p;
+  p.blocks = command_line::get_arg(vm, arg_blocks);
+  p.txs_per_block = command_line::get_arg(vm, arg_txs_per_block);
+  p.outputs_per_tx = std::max(1u, command_line::get_arg(vm, arg_outputs_per_tx));
+  p.owned = std::clamp(command_line::get_arg(vm, arg_owned), 0.0, 1.0);
+  p.accounts = std::max(1u, command_line::get_arg(vm, arg_accounts));
+  p.subaddresses = std::max(1u, command_line::get_arg(vm, arg_subaddresses));
+  p.span = std::max(1u, command_line::get_arg(vm, arg_span));
+  const unsigned runs = std::max(1u, command_line::get_arg(vm, arg_runs));
+
+  std::vector<std::string> responses;
+  try {
+    if (auto load = command_line::get_arg(vm, arg_load); !load.empty())
+      responses = load_responses(load);
+    else
+    {
+      std::cout << "Generating " << p.blocks << " blocks of " << p.txs_per_block << " txs (" << p.owned * 100
+        << "% paying one of " << p.accounts * p.subaddresses << " subaddresses)..." << std::endl;
+      auto w = wallet_refresh_benchmark::make_wallet(p);
+      responses = generate_responses(p, *w, wallet_refresh_benchmark::genesis_hash(*w));
+    }
+    if (auto save = command_line::get_arg(vm, arg_save); !save.empty())
+      save_responses(save, responses);
+  } catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  std::cout << "\n" << std::left << std::setw(6) << "run" << std::right << std::setw(10) << "blocks"
+    << std::setw(12) << "blocks/s" << std::setw(12) << "parse" << std::setw(12) << "derive" << std::setw(12) << "process"
+    << std::setw(12) << "transfers" << "\n";
+  for (unsigned i = 1; i <= runs; ++i)
+  {
+    auto res = run(p, responses);
+    std::cout << std::left << std::setw(6) << i << std::right << std::setw(10) << res.blocks
+      << std::setw(12) << rate(res.blocks, res.total) << std::setw(12) << rate(res.blocks, res.parse)
+      << std::setw(12) << rate(res.blocks, res.scan) << std::setw(12) << rate(res.blocks, res.add)
+      << std::setw(12) << res.transfers << std::endl;
+  }
+  std::cout << "\n(parse, derive and process are each stage's own rate in blocks/s: GET_BLOCKS_FAST\n"
+    "deserialization and block/tx parsing, key derivations and output matching, and\n"
+    "process_new_transaction() for the blocks' txes)\n";
+  return 0;
+  CATCH_ENTRY_L0("main", 1);
+}